@@ -0,0 +1,40 @@
+find_package(Threads REQUIRED)
+
+include(ExternalProject)
+# google benchmark for micro benchmarks (NebulaBench)
+ExternalProject_Add(benchmark
+    PREFIX benchmark
+    GIT_REPOSITORY https://github.com/google/benchmark.git
+    GIT_TAG v1.6.1
+    UPDATE_COMMAND ""
+    INSTALL_COMMAND ""
+    CMAKE_ARGS
+      -DCMAKE_BUILD_TYPE=Release
+      -DBENCHMARK_ENABLE_TESTING=OFF
+      -DBENCHMARK_ENABLE_GTEST_TESTS=OFF
+    LOG_DOWNLOAD ON
+    LOG_CONFIGURE ON
+    LOG_BUILD ON)
+
+ExternalProject_Get_Property(benchmark SOURCE_DIR)
+ExternalProject_Get_Property(benchmark BINARY_DIR)
+set(BENCHMARK_INCLUDE_DIRS ${SOURCE_DIR}/include)
+file(MAKE_DIRECTORY ${BENCHMARK_INCLUDE_DIRS})
+
+set(BENCHMARK_LIBRARY_PATH ${BINARY_DIR}/src/libbenchmark.a)
+set(BENCHMARK_LIBRARY libbenchmark)
+add_library(${BENCHMARK_LIBRARY} UNKNOWN IMPORTED)
+set_target_properties(${BENCHMARK_LIBRARY} PROPERTIES
+    "IMPORTED_LOCATION" "${BENCHMARK_LIBRARY_PATH}"
+    "IMPORTED_LINK_INTERFACE_LIBRARIES" "${CMAKE_THREAD_LIBS_INIT}"
+    "INTERFACE_INCLUDE_DIRECTORIES" "${BENCHMARK_INCLUDE_DIRS}")
+add_dependencies(${BENCHMARK_LIBRARY} benchmark)
+
+set(BENCHMARK_MAIN_LIBRARY_PATH ${BINARY_DIR}/src/libbenchmark_main.a)
+set(BENCHMARK_MAIN_LIBRARY benchmark_main)
+add_library(${BENCHMARK_MAIN_LIBRARY} UNKNOWN IMPORTED)
+set_target_properties(${BENCHMARK_MAIN_LIBRARY} PROPERTIES
+    "IMPORTED_LOCATION" "${BENCHMARK_MAIN_LIBRARY_PATH}"
+    "IMPORTED_LINK_INTERFACE_LIBRARIES" "${CMAKE_THREAD_LIBS_INIT}"
+    "INTERFACE_INCLUDE_DIRECTORIES" "${BENCHMARK_INCLUDE_DIRS}")
+add_dependencies(${BENCHMARK_MAIN_LIBRARY} benchmark)
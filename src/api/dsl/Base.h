@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <array>
 #include <glog/logging.h>
+#include <vector>
 
 #include "common/Errors.h"
 #include "common/Hash.h"
@@ -80,6 +81,11 @@ struct ExpressionData {
   // extra flags
   bool flag;
   bool flag2;
+
+  // values of an IN list by storage type: integral and bool values are longs, floating values are doubles
+  std::vector<int64_t> i_longs;
+  std::vector<double> i_doubles;
+  std::vector<std::string> i_strings;
 };
 
 // a type info structure for all expressions
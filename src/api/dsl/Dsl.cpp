@@ -17,7 +17,10 @@
 #include "Dsl.h"
 
 #include <algorithm>
+#include <msgpack.hpp>
+#include <optional>
 
+#include "Serde.h"
 #include "common/Cursor.h"
 #include "surface/DataSurface.h"
 #include "type/Serde.h"
@@ -33,12 +36,16 @@ using nebula::execution::FinalPhase;
 using nebula::execution::NodePhase;
 using nebula::execution::PlanPtr;
 using nebula::execution::QueryContext;
+using nebula::execution::Rolling;
+using nebula::execution::Rollings;
+using nebula::execution::TimeBucket;
 using nebula::meta::AccessType;
 using nebula::meta::ActionType;
 using nebula::meta::NNode;
 using nebula::meta::Table;
 using nebula::meta::TypeLookup;
 using nebula::surface::RowData;
+using nebula::surface::eval::UDFType;
 using nebula::surface::eval::ValueEval;
 using nebula::type::Kind;
 using nebula::type::RowType;
@@ -73,6 +80,105 @@ std::vector<std::shared_ptr<Expression>> Query::preprocess(
 }
 
 // execute current query to get result list
+using TimeRange = std::pair<int64_t, int64_t>;
+
+// narrow time range by a predicate "time op value"
+static bool narrow(TimeRange& range, LogicalOp op, int64_t value) {
+  constexpr auto MIN = std::numeric_limits<int64_t>::min();
+  constexpr auto MAX = std::numeric_limits<int64_t>::max();
+  switch (op) {
+  case LogicalOp::EQ: range = { std::max(range.first, value), std::min(range.second, value) }; return true;
+  case LogicalOp::GE: range.first = std::max(range.first, value); return true;
+  case LogicalOp::LE: range.second = std::min(range.second, value); return true;
+  case LogicalOp::GT: return value < MAX && narrow(range, LogicalOp::GE, value + 1);
+  case LogicalOp::LT: return value > MIN && narrow(range, LogicalOp::LE, value - 1);
+  default: return false;
+  }
+}
+
+static inline bool isTime(const ExpressionData& data) {
+  return data.type == ExpressionType::COLUMN && data.c_name == Table::TIME_COLUMN;
+}
+
+// strip predicates on time column joined by AND at top level of a filter, return the rest (null if nothing left).
+// time range required by the stripped predicates is narrowed into range, so any block with all its time
+// in the range gets the same result from the rest of the filter, no matter what query window it is.
+static std::unique_ptr<ExpressionData> stripTime(std::unique_ptr<ExpressionData> data, TimeRange& range) {
+  if (data->type == ExpressionType::LOGICAL) {
+    if (data->b_lop == LogicalOp::AND) {
+      auto left = stripTime(std::move(data->b_left), range);
+      auto right = stripTime(std::move(data->b_right), range);
+      if (!left || !right) {
+        return left ? std::move(left) : std::move(right);
+      }
+
+      data->b_left = std::move(left);
+      data->b_right = std::move(right);
+      return data;
+    }
+
+    // time compared with an integer constant
+    const auto& right = *data->b_right;
+    if (isTime(*data->b_left) && right.type == ExpressionType::CONSTANT) {
+      auto value = folly::tryTo<int64_t>(right.c_value);
+      if (value.hasValue() && narrow(range, data->b_lop, value.value())) {
+        return nullptr;
+      }
+    }
+
+    return data;
+  }
+
+  // time between [min, max], refer BetweenExpression for its serialized form
+  if (data->type == ExpressionType::FUNCTION && data->u_type == UDFType::BETWEEN && isTime(*data->inner)) {
+    auto oh = msgpack::unpack(data->custom.data(), data->custom.size());
+    auto bounds = oh.get().as<std::tuple<std::string, std::string, std::string>>();
+    auto min = folly::tryTo<int64_t>(std::get<1>(bounds));
+    auto max = folly::tryTo<int64_t>(std::get<2>(bounds));
+    if (min.hasValue() && max.hasValue()) {
+      narrow(range, LogicalOp::GE, min.value());
+      narrow(range, LogicalOp::LE, max.value());
+      return nullptr;
+    }
+  }
+
+  return data;
+}
+
+// match a time bucket expression "(_time_ - begin) / window * window" such as timeline window,
+// window of the returned bucket is 0 if not matched
+static TimeBucket timeBucket(const ExpressionData& data) {
+  auto isOp = [](const ExpressionData* d, ArthmeticOp op) {
+    return d != nullptr && d->type == ExpressionType::ARTHMETIC && d->b_aop == op;
+  };
+  auto constant = [](const ExpressionData* d) -> std::optional<int64_t> {
+    if (d != nullptr && d->type == ExpressionType::CONSTANT) {
+      auto value = folly::tryTo<int64_t>(d->c_value);
+      if (value.hasValue()) {
+        return value.value();
+      }
+    }
+
+    return {};
+  };
+
+  TimeBucket bucket;
+  const auto div = data.b_left.get();
+  if (isOp(&data, ArthmeticOp::MUL) && isOp(div, ArthmeticOp::DIV)) {
+    const auto sub = div->b_left.get();
+    if (isOp(sub, ArthmeticOp::SUB) && isTime(*sub->b_left)) {
+      auto begin = constant(sub->b_right.get());
+      auto window = constant(data.b_right.get());
+      if (begin && window && window.value() > 0 && constant(div->b_right.get()) == window) {
+        bucket.begin = begin.value();
+        bucket.window = window.value();
+      }
+    }
+  }
+
+  return bucket;
+}
+
 PlanPtr Query::compile(std::unique_ptr<QueryContext> qc) {
   // compile the query into an execution plan
   // a valid query (single data source query - no join support at the moment) should be
@@ -270,6 +376,32 @@ PlanPtr Query::compile(std::unique_ptr<QueryContext> qc) {
     zbSorts.push_back(zbIndex);
   }
 
+  // window functions apply on numeric metric columns, convert 1-based columns into 0-based
+  std::vector<Rolling> zbRollings;
+  zbRollings.reserve(rollings_.size());
+  for (auto rolling : rollings_) {
+    const auto index = rolling.field;
+    if (index == 0 || index > numOutputFields || !aggColumns[index - 1]) {
+      LOG(ERROR) << "rolling column should be a metric column: " << index;
+      END_ERROR(Error::INVALID_QUERY)
+    }
+
+    const auto kind = nebula::type::TypeBase::k(finalNodes.at(index - 1));
+    if (kind < Kind::TINYINT || kind > Kind::DOUBLE) {
+      LOG(ERROR) << "rolling column should be numeric: " << index;
+      END_ERROR(Error::INVALID_QUERY)
+    }
+
+    rolling.field = index - 1;
+    zbRollings.push_back(rolling);
+  }
+
+  std::vector<bool> descs;
+  descs.reserve(zbSorts.size());
+  for (size_t i = 0, size = zbSorts.size(); i < size; ++i) {
+    descs.push_back(sortType(i) == SortType::DESC);
+  }
+
   // build block level compute phase
   // TODO(cao) - for some query or aggregate type such as AVG
   // we need to revise the plan to use sum and count to replace.
@@ -338,8 +470,47 @@ PlanPtr Query::compile(std::unique_ptr<QueryContext> qc) {
     .keys(std::move(zbKeys))
     .compute(std::move(fields))
     .aggregate(numAggColumns, std::move(aggColumns))
-    .sort(std::move(zbSorts), sortType_ == SortType::DESC)
-    .limit(limit_);
+    .sort(std::move(zbSorts), std::move(descs))
+    .limit(limit_)
+    .share();
+
+  // a time bucket key is computed from time column directly by block compute
+  for (auto key : block->keys()) {
+    auto bucket = timeBucket(*selects_.at(key)->serialize());
+    if (bucket.window > 0) {
+      bucket.field = key;
+      block->timeBucket(bucket);
+      break;
+    }
+  }
+
+  // compute signature identifies the same block compute, on blocks within the time range
+  // (value eval signatures don't carry UDF parameters, so the signature is built from serialized expressions)
+  {
+    TimeRange range{ std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max() };
+    auto rest = stripTime(filter_->serialize(), range);
+    std::string orders;
+    for (auto desc : block->descs()) {
+      orders.push_back(desc ? '1' : '0');
+    }
+
+    auto signature = fmt::format("{0}|{1}|{2}|{3}|{4}|{5}|{6}",
+                                 table_->name(),
+                                 rest ? Serde::serialize(*rest) : "",
+                                 Serde::serialize(customs_),
+                                 nebula::execution::join(groups_),
+                                 nebula::execution::join(sorts_),
+                                 orders,
+                                 limit_);
+    for (const auto& s : selects_) {
+      signature.append("|").append(Serde::serialize(*s));
+    }
+
+    block->signature(std::move(signature), range);
+  }
+
+  // window functions run along the time bucket key
+  Rollings rollings{ block->timeBucket(), std::move(zbRollings) };
 
   // partial aggrgation, keys and agg methods
   auto node = std::make_unique<NodePhase>(std::move(block));
@@ -354,11 +525,17 @@ PlanPtr Query::compile(std::unique_ptr<QueryContext> qc) {
   LOG(INFO) << "Nodes to execute the query: " << nodeList.size();
 
   // make an execution plan from a few phases
-  return std::make_shared<ExecutionPlan>(
+  auto plan = std::make_shared<ExecutionPlan>(
     std::move(qc),
     std::move(server),
     std::move(nodeList),
     differentSchema ? output : tempOutput);
+  plan->setSample(sample_);
+  if (!rollings.empty()) {
+    plan->setRollings(std::move(rollings));
+  }
+
+  return plan;
 
 #undef END_ERROR
 }
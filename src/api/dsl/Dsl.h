@@ -94,9 +94,13 @@ static UDFExpression<nebula::surface::eval::UDFType::AVG> avg(const T& expr) {
   return UDFExpression<nebula::surface::eval::UDFType::AVG>(std::shared_ptr<Expression>(new T(expr)));
 }
 
+// percentile of the expression, relative error percentile (ddsketch) uses much less memory per group
 template <typename T>
-static UDFExpression<nebula::surface::eval::UDFType::PCT, double> pct(const T& expr, double percentile) {
-  return UDFExpression<nebula::surface::eval::UDFType::PCT, double>(std::shared_ptr<Expression>(new T(expr)), percentile);
+static UDFExpression<nebula::surface::eval::UDFType::PCT, double, bool> pct(const T& expr,
+                                                                            double percentile,
+                                                                            bool relative = false) {
+  return UDFExpression<nebula::surface::eval::UDFType::PCT, double, bool>(
+    std::shared_ptr<Expression>(new T(expr)), percentile, relative);
 }
 
 template <typename T>
@@ -109,6 +113,26 @@ static UDFExpression<nebula::surface::eval::UDFType::CARD, bool> card(const T& e
   return UDFExpression<nebula::surface::eval::UDFType::CARD, bool>(std::shared_ptr<Expression>(new T(expr)), est);
 }
 
+// approximate top k most frequent values of the expression
+template <typename T>
+static UDFExpression<nebula::surface::eval::UDFType::TOPK, size_t> topk(const T& expr, size_t k = 10) {
+  return UDFExpression<nebula::surface::eval::UDFType::TOPK, size_t>(std::shared_ptr<Expression>(new T(expr)), k);
+}
+
+// value of the expression in a lookup table, null if not found
+template <typename T>
+static LookupExpression lookup(nebula::meta::LookupTablePtr table, const T& expr) {
+  return LookupExpression(std::shared_ptr<Expression>(new T(expr)), table);
+}
+
+// lookup table by its registered name
+template <typename T>
+static LookupExpression lookup(const std::string& name, const T& expr) {
+  auto table = nebula::meta::Lookups::singleton().get(name);
+  N_ENSURE_NOT_NULL(table, fmt::format("lookup table not found: {0}", name));
+  return lookup(table, expr);
+}
+
 template <typename T>
 static UDFExpression<nebula::surface::eval::UDFType::NOT> reverse(const T& expr) {
   return UDFExpression<nebula::surface::eval::UDFType::NOT>(std::shared_ptr<Expression>(new T(expr)));
@@ -162,6 +186,11 @@ static InExpression<U> nin(const T& expr, nebula::common::Zip&& values) {
   return InExpression<U>(std::shared_ptr<Expression>(new T(expr)), std::move(values), false);
 }
 
+template <typename T, typename U>
+static ContainsExpression<U> contains(const T& expr, std::vector<U>&& values) {
+  return ContainsExpression(std::shared_ptr<Expression>(new T(expr)), std::move(values));
+}
+
 template <typename T, typename U>
 static BetweenExpression<U> between(const T& expr, U min, U max) {
   return BetweenExpression<U>(std::shared_ptr<Expression>(new T(expr)), min, max);
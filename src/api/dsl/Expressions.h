@@ -19,15 +19,15 @@
 #include <folly/Conv.h>
 #include <glog/logging.h>
 #include <msgpack.hpp>
-#include <rapidjson/stringbuffer.h>
-#include <rapidjson/writer.h>
 
 #include "Base.h"
 #include "api/udf/UDFFactory.h"
 #include "common/Delta.h"
 #include "common/Errors.h"
 #include "common/Likely.h"
+#include "common/ValueSet.h"
 #include "common/Zip.h"
+#include "meta/Lookup.h"
 #include "meta/Table.h"
 #include "surface/eval/UDF.h"
 #include "surface/eval/ValueEval.h"
@@ -696,20 +696,22 @@ public:
     using VT = typename std::conditional<
       nebula::type::TypeDetect<T>::kind == nebula::type::Kind::VARCHAR, std::string_view, T>::type;
 
-    auto set = std::make_shared<nebula::common::unordered_set<VT>>(values_.begin(), values_.end());
+    // UDF In accepts a shared set for faster access and sharing, its layout is picked by values
+    std::shared_ptr<nebula::common::ValueSet<VT>> set;
     if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t>) {
-      // UDF In accepts a shared_ptr<unordered_set> now for faster access and sharing
       if (zip_.format() == nebula::common::ZipFormat::DELTA) {
         N_ENSURE_EQ(values_.size(), 0, "vector should be empty when use zip content");
         auto bin = zip_.data();
         auto list = nebula::common::delta_decode<VT>((int8_t*)bin.data(), bin.size());
-        VT* vp = (VT*)list.slice->ptr();
-        for (size_t i = 0, size = list.written / sizeof(VT); i < size; ++i) {
-          set->emplace(*(vp + i));
-        }
+        const VT* vp = (const VT*)list.slice->ptr();
+        set = std::make_shared<nebula::common::ValueSet<VT>>(vp, vp + list.written / sizeof(VT));
       }
     }
 
+    if (!set) {
+      set = std::make_shared<nebula::common::ValueSet<VT>>(values_.begin(), values_.end());
+    }
+
     return in_ ?
              nebula::api::udf::UDFFactory::createUDF<
                nebula::surface::eval::UDFType::IN, nebula::type::TypeDetect<T>::kind>(expr_, set) :
@@ -717,62 +719,90 @@ public:
                nebula::surface::eval::UDFType::IN, nebula::type::TypeDetect<T>::kind>(expr_, set, false);
   }
 
-#define TYPE_BRANCH(CPP, FUNC)            \
-  if constexpr (std::is_same_v<T, CPP>) { \
-    for (auto v : values_) {              \
-      json.FUNC(v);                       \
-    }                                     \
-  }
-
   virtual std::unique_ptr<ExpressionData> serialize() const noexcept override {
     auto data = InBase::serialize();
-    // itself is a simple JSON - better to use JSON library to serialize it
-    // fmt provides join function as
-    //   fmt::format("{0:.{1}f}", fmt::join(std::begin(test), std::end(test), ", ");
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> json(buffer);
-    json.StartObject();
-    json.Key("in");
-    json.Bool(in_);
-    auto dtype = nebula::type::TypeDetect<T>::tid();
-    json.Key("dtype");
-    json.String(dtype.data(), dtype.size());
-    json.Key("zip-data");
-    auto zipData = zip_.data();
-    json.String(zipData.data(), zipData.size());
-    json.Key("zip-format");
-    json.Int((int)zip_.format());
-    json.Key("values");
-    json.StartArray();
-    TYPE_BRANCH(bool, Bool)
-    TYPE_BRANCH(int8_t, Int)
-    TYPE_BRANCH(int16_t, Int)
-    TYPE_BRANCH(int32_t, Int)
-    TYPE_BRANCH(int64_t, Int64)
-    TYPE_BRANCH(float, Double)
-    TYPE_BRANCH(double, Double)
-
-    // string is different
-    if constexpr (std::is_same_v<T, std::string>) {
-      for (auto& v : values_) {
-        json.String(v.data(), v.size());
+    // custom packs (in, value type, zip data, zip format), values are kept typed rather than in text
+    // since a list of thousands of values costs more to parse than to evaluate.
+    // a large list of integers is sorted and delta packed, which takes a byte or two per value of a cohort of ids.
+    const std::string dtype{ nebula::type::TypeDetect<T>::tid() };
+    std::string zipData{ zip_.data() };
+    auto zipFormat = zip_.format();
+    if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t>) {
+      if (zipFormat == nebula::common::ZipFormat::UNKNOWN && values_.size() >= ZIP_VALUES) {
+        auto sorted = values_;
+        auto buf = nebula::common::delta_encode<T>(sorted.data(), sorted.size());
+        zipData.assign((const char*)buf.slice->ptr(), buf.written);
+        zipFormat = nebula::common::ZipFormat::DELTA;
       }
     }
 
-    json.EndArray();
-    json.EndObject();
-    data->custom = buffer.GetString();
+    std::stringstream buffer;
+    msgpack::pack(buffer, std::make_tuple(in_, dtype, zipData, (int)zipFormat));
+    data->custom = buffer.str();
+    if (zipFormat != nebula::common::ZipFormat::UNKNOWN) {
+      return data;
+    }
+
+    if constexpr (std::is_same_v<T, std::string>) {
+      data->i_strings = values_;
+    } else if constexpr (std::is_floating_point_v<T>) {
+      data->i_doubles.assign(values_.begin(), values_.end());
+    } else {
+      data->i_longs.assign(values_.begin(), values_.end());
+    }
+
     return data;
   }
 
-#undef TYPE_BRANCH
-
 private:
+  // integer lists of at least this many values are serialized delta packed
+  static constexpr size_t ZIP_VALUES = 1024;
+
   nebula::common::Zip zip_;
   std::vector<T> values_;
   bool in_;
 };
 
+// contains(column, [values]) on an array column is true if any element of the list is one of the values
+using ContainsBase = BoolUDF<nebula::surface::eval::UDFType::CONTAINS>;
+template <typename T>
+class ContainsExpression : public ContainsBase {
+public:
+  ContainsExpression(std::shared_ptr<Expression> left, std::vector<T>&& values)
+    : ContainsBase(left), values_{ std::move(values) } {}
+
+public:
+  ALL_LOGICAL_OPS()
+  ALIAS()
+
+  virtual std::unique_ptr<nebula::surface::eval::ValueEval> asEval() const override {
+    using VT = typename std::conditional<
+      nebula::type::TypeDetect<T>::kind == nebula::type::Kind::VARCHAR, std::string_view, T>::type;
+    N_ENSURE(expr_->typeInfo().native == nebula::type::Kind::ARRAY, "contains applies to an array column");
+
+    auto set = std::make_shared<nebula::common::ValueSet<VT>>(values_.begin(), values_.end());
+    return nebula::api::udf::UDFFactory::createUDF<
+      nebula::surface::eval::UDFType::CONTAINS, nebula::type::TypeDetect<T>::kind>(expr_, set);
+  }
+
+  virtual std::unique_ptr<ExpressionData> serialize() const noexcept override {
+    auto data = ContainsBase::serialize();
+    data->custom = nebula::type::TypeDetect<T>::tid();
+    if constexpr (std::is_same_v<T, std::string>) {
+      data->i_strings = values_;
+    } else if constexpr (std::is_floating_point_v<T>) {
+      data->i_doubles.assign(values_.begin(), values_.end());
+    } else {
+      data->i_longs.assign(values_.begin(), values_.end());
+    }
+
+    return data;
+  }
+
+private:
+  std::vector<T> values_;
+};
+
 using BetweenBase = BoolUDF<nebula::surface::eval::UDFType::BETWEEN>;
 template <typename T>
 class BetweenExpression : public BetweenBase {
@@ -836,6 +866,78 @@ public:
   }
 };
 
+// look up the value of the inner expression (key) in a lookup table.
+// the whole table is serialized with the expression, so every node evaluating it gets the table.
+class LookupExpression : public Expression {
+public:
+  LookupExpression(std::shared_ptr<Expression> inner, nebula::meta::LookupTablePtr table)
+    : inner_{ inner }, table_{ table }, input_{ nebula::type::Kind::INVALID } {}
+  virtual ~LookupExpression() = default;
+
+public:
+  ALL_LOGICAL_OPS()
+  ALIAS()
+
+  IS_AGG(false)
+
+  virtual TypeInfo type(const nebula::meta::TypeLookup& lookup) override {
+    input_ = inner_->type(lookup).native;
+    N_ENSURE(nebula::surface::eval::udfNativeKind<nebula::surface::eval::UDFType::LOOKUP>(input_)
+               == nebula::type::Kind::VARCHAR,
+             "lookup key should be an integer or a string");
+    type_ = TypeInfo{ nebula::type::Kind::VARCHAR };
+    return type_;
+  }
+
+  inline virtual std::vector<std::string> columnRefs() const override {
+    return inner_->columnRefs();
+  }
+
+#define CASE_KIND_LOOKUP(KIND)                       \
+  case nebula::type::Kind::KIND: {                   \
+    return nebula::api::udf::UDFFactory::createUDF<  \
+      nebula::surface::eval::UDFType::LOOKUP,        \
+      nebula::type::Kind::KIND>(inner_, table_);     \
+  }
+
+  virtual std::unique_ptr<nebula::surface::eval::ValueEval> asEval() const override {
+    switch (input_) {
+      CASE_KIND_LOOKUP(TINYINT)
+      CASE_KIND_LOOKUP(SMALLINT)
+      CASE_KIND_LOOKUP(INTEGER)
+      CASE_KIND_LOOKUP(BIGINT)
+      CASE_KIND_LOOKUP(VARCHAR)
+    default:
+      throw NException("Please call type() first to evalue the key type of lookup");
+    }
+  }
+
+#undef CASE_KIND_LOOKUP
+
+  virtual std::unique_ptr<ExpressionData> serialize() const noexcept override {
+    auto data = Expression::serialize();
+    data->type = ExpressionType::FUNCTION;
+    data->u_type = nebula::surface::eval::UDFType::LOOKUP;
+    data->inner = std::move(inner_->serialize());
+
+    // serialize the table as tuple (name, keys, values) without copying it
+    std::stringstream buffer;
+    msgpack::packer<std::stringstream> packer(buffer);
+    packer.pack_array(3);
+    packer.pack(table_->name());
+    packer.pack(table_->keys());
+    packer.pack(table_->values());
+    buffer.seekg(0);
+    data->custom = buffer.str();
+    return data;
+  }
+
+private:
+  std::shared_ptr<Expression> inner_;
+  nebula::meta::LookupTablePtr table_;
+  nebula::type::Kind input_;
+};
+
 #undef ARTHMETIC_OP_CONST
 #undef ARTHMETIC_OP_GENERIC
 #undef LOGICAL_OP_CONST
@@ -67,7 +67,7 @@ struct CustomColumn {
 class Query {
 public:
   Query(const std::string& table, const std::shared_ptr<nebula::meta::MetaService> ms)
-    : ms_{ ms }, table_{ ms_->query(table).table() }, filter_{ nullptr }, limit_{ 0 } {}
+    : ms_{ ms }, table_{ ms_->query(table).table() }, filter_{ nullptr }, limit_{ 0 }, sample_{ 1 } {}
 
   // The copy constructor is actually a move constructor
   // We do this is to favor DSL chain method
@@ -79,7 +79,10 @@ public:
                     groups_{ std::move(q.groups_) },
                     sorts_{ std::move(q.sorts_) },
                     sortType_{ q.sortType_ },
-                    limit_{ q.limit_ } {}
+                    sortTypes_{ std::move(q.sortTypes_) },
+                    limit_{ q.limit_ },
+                    sample_{ q.sample_ },
+                    rollings_{ std::move(q.rollings_) } {}
   Query(Query&&) = default;
   Query(const Query&) = delete;
   virtual ~Query() = default;
@@ -125,14 +128,44 @@ public:
   Query& sortby(std::vector<size_t> sorts, SortType type = SortType::ASC) {
     sorts_ = sorts;
     sortType_ = type;
+    sortTypes_.clear();
     return *this;
   }
 
+  // sort by a list of columns, each column has its own order
+  Query& sortby(std::vector<size_t> sorts, std::vector<SortType> types) {
+    N_ENSURE_EQ(sorts.size(), types.size(), "every sort column needs an order");
+    sorts_ = std::move(sorts);
+    sortType_ = types.empty() ? SortType::ASC : types.front();
+    sortTypes_ = std::move(types);
+    return *this;
+  }
+
+  // order of the sort column at given position
+  inline SortType sortType(size_t i) const {
+    return sortTypes_.empty() ? sortType_ : sortTypes_.at(i);
+  }
+
   Query& limit(size_t l) {
     limit_ = l;
     return *this;
   }
 
+  // approximate query: scan only given fraction of matched blocks on every node,
+  // COUNT and SUM are scaled up by rows of all matched blocks over rows scanned.
+  Query& sample(double fraction) {
+    N_ENSURE(fraction > 0 && fraction <= 1, "sample fraction should be in (0, 1]");
+    sample_ = fraction;
+    return *this;
+  }
+
+  // window functions on metric columns (1-based select index) along the time bucket key of a timeline query,
+  // they are evaluated by server on the final result, rolled columns are DOUBLE.
+  Query& roll(std::vector<nebula::execution::Rolling> rollings) {
+    rollings_ = std::move(rollings);
+    return *this;
+  }
+
 public:
   // compile the query into an execution plan
   nebula::execution::PlanPtr compile(std::unique_ptr<nebula::execution::QueryContext>);
@@ -155,10 +188,18 @@ public:
   // sorting information
   std::vector<size_t> sorts_;
   SortType sortType_;
+  // order of every sort column, empty if all in sortType_
+  std::vector<SortType> sortTypes_;
 
   // limit the results to return
   size_t limit_;
 
+  // fraction of blocks to scan, 1 for exact query
+  double sample_;
+
+  // window functions on the final result
+  std::vector<nebula::execution::Rolling> rollings_;
+
 private:
   static std::vector<std::shared_ptr<Expression>> preprocess(
     const nebula::type::Schema&, const std::vector<std::shared_ptr<Expression>>&);
@@ -102,6 +102,34 @@ std::string ser(const ExpressionData& data) {
     json.Key("flag2");
     json.Bool(data.flag2);
     addstring(json, "c_type", data.c_type);
+
+    // values of an IN list
+    if (!data.i_longs.empty()) {
+      json.Key("longs");
+      json.StartArray();
+      for (auto v : data.i_longs) {
+        json.Int64(v);
+      }
+      json.EndArray();
+    }
+
+    if (!data.i_doubles.empty()) {
+      json.Key("doubles");
+      json.StartArray();
+      for (auto v : data.i_doubles) {
+        json.Double(v);
+      }
+      json.EndArray();
+    }
+
+    if (!data.i_strings.empty()) {
+      json.Key("strings");
+      json.StartArray();
+      for (const auto& v : data.i_strings) {
+        json.String(v.data(), v.size());
+      }
+      json.EndArray();
+    }
     break;
   }
 
@@ -131,6 +159,10 @@ std::string Serde::serialize(const Expression& expr) {
   return ser(*ptr);
 }
 
+std::string Serde::serialize(const ExpressionData& data) {
+  return ser(data);
+}
+
 #define TYPED_CONST(T)                                                             \
   if (type == TypeDetect<T>::tid()) {                                              \
     using ST = TypeDetect<T>::StandardType;                                        \
@@ -237,15 +269,15 @@ std::shared_ptr<Expression> a_expr(const std::string& alias,
 
 #undef ARTH_FORM
 
-std::shared_ptr<Expression> u_expr(const std::string& alias,
-                                   UDFType ut,
-                                   std::shared_ptr<Expression> inner,
-                                   const std::string& custom,
-                                   bool flag,
-                                   bool flag2,
-                                   const std::string& inputType) {
+std::shared_ptr<Expression> u_expr(const ExpressionData& data, std::shared_ptr<Expression> inner) {
+  const auto& alias = data.alias;
+  const auto& custom = data.custom;
+  const auto& inputType = data.c_type;
+  const auto flag = data.flag;
+  const auto flag2 = data.flag2;
+
   // like, prefix
-  switch (ut) {
+  switch (data.u_type) {
   case UDFType::LIKE: {
     return as(alias, std::make_shared<LikeExpression>(inner, custom, flag, flag2));
   }
@@ -255,51 +287,64 @@ std::shared_ptr<Expression> u_expr(const std::string& alias,
   }
 
   case UDFType::IN: {
-#define TYPE_IN_EXPR(T, F)                                                              \
+#define TYPE_IN_EXPR(T, V)                                                              \
   if (valueType == TypeDetect<T>::tid()) {                                              \
     if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, int64_t>) {           \
       if (zip.format() != ZipFormat::UNKNOWN) {                                         \
         return as(alias, std::make_shared<InExpression<T>>(inner, std::move(zip), in)); \
       }                                                                                 \
     }                                                                                   \
-    std::vector<T> values;                                                              \
-    values.reserve(size);                                                               \
-    for (rapidjson::SizeType i = 0; i < size; ++i) {                                    \
-      values.push_back(v[i].F());                                                       \
-    }                                                                                   \
+    std::vector<T> values(data.V.begin(), data.V.end());                                \
     return as(alias, std::make_shared<InExpression<T>>(inner, std::move(values), in));  \
   }
 
-    rapidjson::Document cd;
-    if (cd.Parse(custom.c_str()).HasParseError()) {
-      throw NException(fmt::format("Error parsing UDF custom data: {0}", custom));
-    }
-
-    bool in = cd["in"].GetBool();
-    const auto valueType = cd["dtype"].GetString();
-    Zip zip{ cd["zip-data"].GetString(), (ZipFormat)cd["zip-format"].GetInt() };
-    const rapidjson::Value& v = cd["values"];
-    rapidjson::SizeType size = v.Size();
-
     // reference InExpression serialize method
-    TYPE_IN_EXPR(bool, GetBool)
-    TYPE_IN_EXPR(int8_t, GetInt)
-    TYPE_IN_EXPR(int16_t, GetInt)
-    TYPE_IN_EXPR(int32_t, GetInt)
-    TYPE_IN_EXPR(int64_t, GetInt64)
-    TYPE_IN_EXPR(float, GetFloat)
-    TYPE_IN_EXPR(double, GetDouble)
-    TYPE_IN_EXPR(std::string, GetString)
+    msgpack::object_handle oh = msgpack::unpack(custom.data(), custom.size());
+    auto deser = oh.get();
+    auto dst = deser.as<std::tuple<bool, std::string, std::string, int>>();
+    const auto in = std::get<0>(dst);
+    const auto& valueType = std::get<1>(dst);
+    Zip zip{ std::move(std::get<2>(dst)), (ZipFormat)std::get<3>(dst) };
+
+    TYPE_IN_EXPR(bool, i_longs)
+    TYPE_IN_EXPR(int8_t, i_longs)
+    TYPE_IN_EXPR(int16_t, i_longs)
+    TYPE_IN_EXPR(int32_t, i_longs)
+    TYPE_IN_EXPR(int64_t, i_longs)
+    TYPE_IN_EXPR(float, i_doubles)
+    TYPE_IN_EXPR(double, i_doubles)
+    TYPE_IN_EXPR(std::string, i_strings)
 
     throw NException(fmt::format("Unrecognized value type: {0}", valueType));
 #undef TYPE_IN_EXPR
+  }
+  case UDFType::CONTAINS: {
+#define TYPE_CONTAINS_EXPR(T, V)                                                         \
+  if (custom == TypeDetect<T>::tid()) {                                                  \
+    std::vector<T> values(data.V.begin(), data.V.end());                                 \
+    return as(alias, std::make_shared<ContainsExpression<T>>(inner, std::move(values))); \
+  }
+
+    // reference ContainsExpression serialize method, custom is the value type
+    TYPE_CONTAINS_EXPR(bool, i_longs)
+    TYPE_CONTAINS_EXPR(int8_t, i_longs)
+    TYPE_CONTAINS_EXPR(int16_t, i_longs)
+    TYPE_CONTAINS_EXPR(int32_t, i_longs)
+    TYPE_CONTAINS_EXPR(int64_t, i_longs)
+    TYPE_CONTAINS_EXPR(float, i_doubles)
+    TYPE_CONTAINS_EXPR(double, i_doubles)
+    TYPE_CONTAINS_EXPR(std::string, i_strings)
+
+    throw NException(fmt::format("Unrecognized value type: {0}", custom));
+#undef TYPE_CONTAINS_EXPR
   }
   case UDFType::PCT: {
     msgpack::object_handle oh = msgpack::unpack(custom.data(), custom.size());
     auto deser = oh.get();
-    auto dst = deser.as<std::tuple<double>>();
+    auto dst = deser.as<std::tuple<double, bool>>();
     auto pct = std::get<0>(dst);
-    return as(alias, std::make_shared<UDFExpression<UDFType::PCT, double>>(inner, pct));
+    auto relative = std::get<1>(dst);
+    return as(alias, std::make_shared<UDFExpression<UDFType::PCT, double, bool>>(inner, pct, relative));
   }
   case UDFType::CARD: {
     msgpack::object_handle oh = msgpack::unpack(custom.data(), custom.size());
@@ -308,6 +353,22 @@ std::shared_ptr<Expression> u_expr(const std::string& alias,
     auto est = std::get<0>(dst);
     return as(alias, std::make_shared<UDFExpression<UDFType::CARD, bool>>(inner, est));
   }
+  case UDFType::TOPK: {
+    msgpack::object_handle oh = msgpack::unpack(custom.data(), custom.size());
+    auto deser = oh.get();
+    auto dst = deser.as<std::tuple<size_t>>();
+    auto k = std::get<0>(dst);
+    return as(alias, std::make_shared<UDFExpression<UDFType::TOPK, size_t>>(inner, k));
+  }
+  case UDFType::LOOKUP: {
+    // the table is carried by the expression, see LookupExpression::serialize
+    msgpack::object_handle oh = msgpack::unpack(custom.data(), custom.size());
+    auto deser = oh.get();
+    auto dst = deser.as<std::tuple<std::string, std::vector<std::string>, std::vector<std::string>>>();
+    auto table = std::make_shared<const nebula::meta::LookupTable>(
+      std::get<0>(dst), std::move(std::get<1>(dst)), std::move(std::get<2>(dst)));
+    return as(alias, std::make_shared<LookupExpression>(inner, table));
+  }
   case UDFType::BETWEEN: {
     msgpack::object_handle oh = msgpack::unpack(custom.data(), custom.size());
     auto deser = oh.get();
@@ -368,52 +429,105 @@ std::shared_ptr<Expression> u_expr(const std::string& alias,
 #undef COM_UDF
 
   default:
-    throw NException(fmt::format("Unrecognized UDF type: {0}", static_cast<int>(ut)));
+    throw NException(fmt::format("Unrecognized UDF type: {0}", static_cast<int>(data.u_type)));
   }
 }
 
-std::shared_ptr<Expression> Serde::deserialize(const std::string& data) {
+// a json string value with all its bytes
+inline std::string str(const rapidjson::Value& v) {
+  return std::string(v.GetString(), v.GetStringLength());
+}
+
+// parse an expression data tree from json, reference ser
+std::unique_ptr<ExpressionData> parse(const std::string& json) {
   rapidjson::Document document;
+  if (document.Parse(json.data(), json.size()).HasParseError()) {
+    throw NException(fmt::format("Invaid expression serialization data: {0}", json));
+  }
 
-  if (document.Parse(data.c_str()).HasParseError()) {
-    throw NException(fmt::format("Invaid expression serialization data: {0}", data));
+  auto data = std::make_unique<ExpressionData>();
+  data->type = static_cast<ExpressionType>(document["type"].GetInt());
+  data->alias = str(document["alias"]);
+  switch (data->type) {
+  case ExpressionType::CONSTANT:
+  case ExpressionType::SCRIPT: {
+    data->c_type = str(document["c_type"]);
+    data->c_value = str(document["c_value"]);
+    break;
+  }
+  case ExpressionType::COLUMN: {
+    data->c_name = str(document["c_name"]);
+    break;
+  }
+  case ExpressionType::LOGICAL: {
+    data->b_lop = static_cast<LogicalOp>(document["op"].GetInt());
+    data->b_left = parse(str(document["left"]));
+    data->b_right = parse(str(document["right"]));
+    break;
+  }
+  case ExpressionType::ARTHMETIC: {
+    data->b_aop = static_cast<ArthmeticOp>(document["op"].GetInt());
+    data->b_left = parse(str(document["left"]));
+    data->b_right = parse(str(document["right"]));
+    break;
+  }
+  case ExpressionType::FUNCTION: {
+    data->u_type = static_cast<UDFType>(document["udf"].GetInt());
+    data->inner = parse(str(document["inner"]));
+    data->custom = str(document["custom"]);
+    data->flag = document["flag"].GetBool();
+    data->flag2 = document["flag2"].GetBool();
+    data->c_type = str(document["c_type"]);
+    if (document.HasMember("longs")) {
+      for (const auto& v : document["longs"].GetArray()) {
+        data->i_longs.push_back(v.GetInt64());
+      }
+    }
+
+    if (document.HasMember("doubles")) {
+      for (const auto& v : document["doubles"].GetArray()) {
+        data->i_doubles.push_back(v.GetDouble());
+      }
+    }
+
+    if (document.HasMember("strings")) {
+      for (const auto& v : document["strings"].GetArray()) {
+        data->i_strings.push_back(str(v));
+      }
+    }
+    break;
+  }
+  default:
+    throw NException("Not recognized expression!");
   }
 
-  // fetching data from document
-  ExpressionType type = static_cast<ExpressionType>(document["type"].GetInt());
-  const auto alias = document["alias"].GetString();
-  switch (type) {
+  return data;
+}
+
+std::shared_ptr<Expression> Serde::deserialize(const std::string& data) {
+  return deserialize(*parse(data));
+}
+
+std::shared_ptr<Expression> Serde::deserialize(const ExpressionData& data) {
+  const auto& alias = data.alias;
+  switch (data.type) {
   case ExpressionType::CONSTANT: {
-    return c_expr(alias, document["c_type"].GetString(), document["c_value"].GetString());
+    return c_expr(alias, data.c_type, data.c_value);
   }
   case ExpressionType::SCRIPT: {
-    return s_expr(alias, document["c_type"].GetString(), document["c_value"].GetString());
+    return s_expr(alias, data.c_type, data.c_value);
   }
   case ExpressionType::COLUMN: {
-    return as(alias, std::make_shared<ColumnExpression>(document["c_name"].GetString()));
+    return as(alias, std::make_shared<ColumnExpression>(data.c_name));
   }
   case ExpressionType::LOGICAL: {
-    return l_expr(alias,
-                  static_cast<LogicalOp>(document["op"].GetInt()),
-                  deserialize(document["left"].GetString()),
-                  deserialize(document["right"].GetString()));
+    return l_expr(alias, data.b_lop, deserialize(*data.b_left), deserialize(*data.b_right));
   }
   case ExpressionType::ARTHMETIC: {
-    return a_expr(alias,
-                  static_cast<ArthmeticOp>(document["op"].GetInt()),
-                  deserialize(document["left"].GetString()),
-                  deserialize(document["right"].GetString()));
+    return a_expr(alias, data.b_aop, deserialize(*data.b_left), deserialize(*data.b_right));
   }
   case ExpressionType::FUNCTION: {
-    const auto& c = document["custom"];
-    const auto& inputType = document["c_type"];
-    return u_expr(alias,
-                  static_cast<UDFType>(document["udf"].GetInt()),
-                  deserialize(document["inner"].GetString()),
-                  std::string(c.GetString(), c.GetStringLength()),
-                  document["flag"].GetBool(),
-                  document["flag2"].GetBool(),
-                  inputType.GetString());
+    return u_expr(data, deserialize(*data.inner));
   }
   default:
     throw NException("Not recognized expression!");
@@ -29,7 +29,10 @@ class Serde {
 public:
   // expression serde
   static std::string serialize(const Expression&);
+  static std::string serialize(const ExpressionData&);
   static std::shared_ptr<Expression> deserialize(const std::string&);
+  // expression built from its data tree, which is decoded from json or flat buffers
+  static std::shared_ptr<Expression> deserialize(const ExpressionData&);
 
   // custom column object serde
   static std::string serialize(const std::vector<CustomColumn>&);
@@ -179,6 +179,39 @@ TEST(ApiTest, TestSortingAndTop) {
   }
 }
 
+TEST(ApiTest, TestProgressiveQuery) {
+  auto data = genData();
+  auto ms = TableService::singleton();
+  auto query = table(std::get<0>(data), ms)
+                 .where(like(col("event"), "N%"))
+                 .select(col("event"), count(1).as("count"))
+                 .groupby({ 1 })
+                 .sortby({ 2 }, SortType::DESC)
+                 .limit(10);
+
+  // a progressive query returns the same final result, early results come only before the last node responds
+  folly::CPUThreadPoolExecutor pool{ 8 };
+  auto expected = ServerExecutor(nebula::meta::NNode::local().toString()).execute(pool, query.compile(QueryContext::def()));
+
+  auto plan = query.compile(QueryContext::def());
+  size_t early = 0;
+  auto result = ServerExecutor(nebula::meta::NNode::local().toString())
+                  .execute(pool, plan, std::make_shared<nebula::execution::core::NodeConnector>(),
+                           [&early, total = plan->getNodes().size()](nebula::surface::RowCursorPtr, size_t done, size_t nodes) {
+                             EXPECT_LT(done, nodes);
+                             EXPECT_EQ(nodes, total);
+                             ++early;
+                           });
+
+  EXPECT_LT(early, plan->getNodes().size());
+  ASSERT_EQ(result->size(), expected->size());
+  while (result->hasNext()) {
+    const auto& row = result->next();
+    const auto& other = expected->next();
+    EXPECT_EQ(row.readInt("count"), other.readInt("count"));
+  }
+}
+
 class MockRow : public nebula::surface::MockAccessor {
 public:
   MockRow() = default;
@@ -39,6 +39,7 @@ namespace test {
 
 using nebula::api::dsl::between;
 using nebula::api::dsl::col;
+using nebula::api::dsl::lookup;
 using nebula::api::dsl::Serde;
 using nebula::execution::meta::TableService;
 using nebula::surface::MockAccessor;
@@ -641,6 +642,60 @@ TEST(ExpressionsTest, TestBetweenExpression) {
   }
 }
 
+TEST(ExpressionsTest, TestLookupExpression) {
+  auto ms = TableService::singleton();
+  auto tbl = ms->query("nebula.test").table();
+
+  // keys which are integers are also found by integer columns
+  nebula::meta::Lookups::singleton().put(std::make_shared<const nebula::meta::LookupTable>(
+    "names", std::vector<std::string>{ "3", "5", "abcdefg", "5" }, std::vector<std::string>{ "c", "e", "x", "f" }));
+
+  // integer key
+  {
+    MockRow3 rowData;
+    EvalContext ctx{ false };
+    ctx.reset(rowData);
+
+    auto expr = lookup("names", col("id")).as("name");
+    auto type = expr.type(tbl->lookup());
+    EXPECT_EQ(type.native, nebula::type::Kind::VARCHAR);
+
+    // the first value wins for duplicate keys
+    EXPECT_CALL(rowData, readInt("id")).WillRepeatedly(testing::Return(5));
+    auto result = expr.asEval()->eval<std::string_view>(ctx);
+    EXPECT_TRUE(result != std::nullopt);
+    EXPECT_EQ(result.value(), "e");
+
+    // missing key is null
+    EXPECT_CALL(rowData, readInt("id")).WillRepeatedly(testing::Return(4));
+    EXPECT_TRUE(expr.asEval()->eval<std::string_view>(ctx) == std::nullopt);
+
+    // the table goes with the serialized expression
+    EXPECT_CALL(rowData, readInt("id")).WillRepeatedly(testing::Return(3));
+    auto x = Serde::deserialize(Serde::serialize(expr));
+    EXPECT_EQ(x->alias(), "name");
+    x->type(tbl->lookup());
+    result = x->asEval()->eval<std::string_view>(ctx);
+    EXPECT_TRUE(result != std::nullopt);
+    EXPECT_EQ(result.value(), "c");
+  }
+
+  // string key
+  {
+    MockRow2 rowData;
+    EvalContext ctx{ false };
+    ctx.reset(rowData);
+
+    auto expr = lookup("names", col("event"));
+    expr.type(tbl->lookup());
+    auto result = expr.asEval()->eval<std::string_view>(ctx);
+    EXPECT_TRUE(result != std::nullopt);
+    EXPECT_EQ(result.value(), "x");
+  }
+
+  EXPECT_THROW(lookup("unknown", col("id")), NException);
+}
+
 } // namespace test
 } // namespace api
 } // namespace nebula
\ No newline at end of file
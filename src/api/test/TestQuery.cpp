@@ -15,6 +15,7 @@
  */
 
 #include <fmt/format.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -29,6 +30,7 @@
 #include "common/Folly.h"
 #include "common/Likely.h"
 #include "common/Memory.h"
+#include "execution/core/BlockCache.h"
 #include "execution/core/ServerExecutor.h"
 #include "execution/meta/TableService.h"
 #include "meta/NBlock.h"
@@ -36,6 +38,9 @@
 #include "surface/MockSurface.h"
 #include "type/Serde.h"
 
+DECLARE_uint64(BLOCK_CACHE_MB);
+DECLARE_bool(TIME_BUCKET_SLOTS);
+
 namespace nebula {
 namespace api {
 namespace test {
@@ -43,6 +48,7 @@ namespace test {
 using namespace nebula::api::dsl;
 using nebula::common::Cursor;
 using nebula::common::Evidence;
+using nebula::execution::PhaseType;
 using nebula::execution::QueryContext;
 using nebula::execution::core::ServerExecutor;
 using nebula::execution::meta::TableService;
@@ -171,6 +177,145 @@ TEST(ApiTest, TestBlockSkipByBloomfilter) {
   EXPECT_EQ(result->size(), 1);
 }
 
+TEST(ApiTest, TestSampledCount) {
+  auto data = genData(8);
+
+  auto ms = TableService::singleton();
+  auto tableName = std::get<0>(data);
+  auto start = std::get<1>(data);
+  auto end = std::get<2>(data);
+  auto run = [&](double fraction) {
+    auto query = table(tableName, ms)
+                   .where(col("_time_") > start && col("_time_") < end)
+                   .select(count(1).as("total"))
+                   .sample(fraction);
+    auto plan = query.compile(QueryContext::def());
+    plan->setWindow({ start, end });
+
+    folly::CPUThreadPoolExecutor pool{ 8 };
+    auto result = ServerExecutor(nebula::meta::NNode::local().toString()).execute(pool, plan);
+    EXPECT_EQ(result->size(), 1);
+    const auto& row = result->next();
+    return std::make_pair(row.readLong("total"), plan->ctx().stats());
+  };
+
+  auto exact = run(1);
+  EXPECT_FALSE(exact.second.sampled());
+  EXPECT_EQ(exact.second.blocksScan, exact.second.blocksTotal);
+
+  // half of blocks are scanned and the count is scaled up to all rows
+  auto approx = run(0.5);
+  const auto& stats = approx.second;
+  EXPECT_EQ(stats.blocksTotal, exact.second.blocksTotal);
+  if (stats.blocksTotal > 1) {
+    EXPECT_LT(stats.blocksScan, stats.blocksTotal);
+    EXPECT_TRUE(stats.sampled());
+    EXPECT_NEAR(approx.first, exact.first, exact.first * 0.01 + 1);
+    EXPECT_GT(stats.margin(), 0);
+  }
+
+  // sample fraction must be in (0, 1]
+  EXPECT_THROW(table(tableName, ms).sample(0), nebula::common::NException);
+}
+
+TEST(ApiTest, TestBlockCache) {
+  auto data = genData();
+
+  auto ms = TableService::singleton();
+  auto tableName = std::get<0>(data);
+  auto start = std::get<1>(data);
+  auto end = std::get<2>(data);
+
+  // sliding windows covering all blocks share the same block results
+  auto run = [&](int64_t shift) {
+    auto query = table(tableName, ms)
+                   .where(col("_time_") > start - shift && col("_time_") < end + shift && col("id") > 100)
+                   .select(
+                     col("event"),
+                     count(col("value")).as("total"),
+                     sum(col("value")).as("sum"))
+                   .groupby({ 1 })
+                   .sortby({ 1 });
+    auto plan = query.compile(QueryContext::def());
+    plan->setWindow({ start - shift, end + shift });
+
+    folly::CPUThreadPoolExecutor pool{ 8 };
+    auto result = ServerExecutor(nebula::meta::NNode::local().toString()).execute(pool, plan);
+    std::vector<std::string> rows;
+    while (result->hasNext()) {
+      const auto& row = result->next();
+      rows.push_back(fmt::format("{0}-{1}-{2}", row.readString("event"), row.readInt("total"), row.readLong("sum")));
+    }
+
+    return rows;
+  };
+
+  auto& cache = nebula::execution::core::BlockCache::singleton();
+  auto first = run(1);
+  const auto cached = cache.size();
+  EXPECT_GT(cached, 0);
+
+  // the second query reuses all cached blocks
+  auto second = run(2);
+  EXPECT_EQ(cache.size(), cached);
+  EXPECT_EQ(first, second);
+  EXPECT_GT(first.size(), 0);
+}
+
+TEST(ApiTest, TestTimeBucketSlots) {
+  auto data = genData();
+
+  auto ms = TableService::singleton();
+  auto tableName = std::get<0>(data);
+  auto start = (int64_t)std::get<1>(data);
+  auto end = (int64_t)std::get<2>(data);
+  const int32_t window = 10;
+
+  // timeline window aggregated by bucket slots or by hash flat gives the same result
+  auto run = [&](bool slots) {
+    auto query = table(tableName, ms)
+                   .where(col("_time_") > start && col("_time_") < end)
+                   .select(
+                     ((col("_time_") - start) / window * window).as(nebula::meta::Table::WINDOW_COLUMN),
+                     col("flag"),
+                     count(col("value")).as("total"),
+                     sum(col("value")).as("sum"))
+                   .groupby({ 1, 2 });
+    auto plan = query.compile(QueryContext::def());
+    plan->setWindow({ start, end });
+
+    const auto& bucket = plan->fetch<PhaseType::COMPUTE>().timeBucket();
+    EXPECT_EQ(bucket.field, 0);
+    EXPECT_EQ(bucket.begin, start);
+    EXPECT_EQ(bucket.window, window);
+
+    const auto cache = FLAGS_BLOCK_CACHE_MB;
+    FLAGS_BLOCK_CACHE_MB = 0;
+    FLAGS_TIME_BUCKET_SLOTS = slots;
+    folly::CPUThreadPoolExecutor pool{ 8 };
+    auto result = ServerExecutor(nebula::meta::NNode::local().toString()).execute(pool, plan);
+    FLAGS_TIME_BUCKET_SLOTS = true;
+    FLAGS_BLOCK_CACHE_MB = cache;
+
+    std::vector<std::string> rows;
+    while (result->hasNext()) {
+      const auto& row = result->next();
+      rows.push_back(fmt::format("{0}-{1}-{2}-{3}",
+                                 row.readLong(nebula::meta::Table::WINDOW_COLUMN),
+                                 row.readBool("flag"),
+                                 row.readLong("total"),
+                                 row.readLong("sum")));
+    }
+
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  };
+
+  auto direct = run(true);
+  EXPECT_GT(direct.size(), 0);
+  EXPECT_EQ(direct, run(false));
+}
+
 TEST(ApiTest, TestBlockSkipByPartitionColumn) {
   auto data = genData();
 
@@ -22,23 +22,31 @@
 #include "api/udf/Avg.h"
 #include "api/udf/Between.h"
 #include "api/udf/Cardinality.h"
+#include "api/udf/Contains.h"
 #include "api/udf/Count.h"
 #include "api/udf/In.h"
 #include "api/udf/Like.h"
+#include "api/udf/Max.h"
+#include "api/udf/Min.h"
 #include "api/udf/Not.h"
 #include "api/udf/Pct.h"
 #include "api/udf/Prefix.h"
+#include "api/udf/Sum.h"
+#include "api/udf/TopK.h"
 #include "api/udf/Tpm.h"
 #include "api/udf/Histogram.h"
+#include "memory/Batch.h"
+#include "meta/TestTable.h"
 #include "surface/DataSurface.h"
 #include "surface/MockSurface.h"
 #include "surface/eval/ValueEval.h"
+#include "type/Serde.h"
 
 namespace nebula {
 namespace api {
 namespace test {
 
-using nebula::common::unordered_set;
+using nebula::common::ValueSet;
 
 TEST(UDFTest, TestNot) {
   nebula::surface::MockAccessor row;
@@ -187,6 +195,160 @@ TEST(UDFTest, TestPrefixContext) {
   }
 }
 
+TEST(UDFTest, TestLikeDictionary) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  nebula::memory::Batch batch(test, size);
+  nebula::surface::MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch.add(row);
+  }
+
+  // event column is dictionary encoded, tag column is not
+  EXPECT_GT(batch.dictSize("event"), 0);
+  EXPECT_EQ(batch.dictSize("tag"), 0);
+
+  auto accessor = batch.makeAccessor();
+  const nebula::surface::eval::Seeker seeker = [&accessor](size_t row) -> const nebula::surface::Accessor& {
+    return accessor->seek(row);
+  };
+
+  // batch selection (by dictionary codes or compiled matcher) should be the same as row by row evaluation
+  nebula::surface::eval::EvalContext ctx{ false };
+  auto verify = [&](const nebula::surface::eval::ValueEval& filter) {
+    nebula::surface::eval::Selection selection;
+    selection.reset(0, size);
+    filter.select(ctx, batch, seeker, selection);
+
+    std::vector<size_t> expected;
+    for (auto i = 0; i < size; ++i) {
+      ctx.reset(seeker(i));
+      if (filter.eval<bool>(ctx).value_or(false)) {
+        expected.push_back(i);
+      }
+    }
+
+    EXPECT_EQ(std::vector<size_t>(selection.begin(), selection.end()), expected);
+  };
+
+  using nebula::surface::eval::column;
+  for (auto col : { "event", "tag" }) {
+    for (auto p : { "a%", "%a", "%a%", "%a%b%", "a" }) {
+      verify(nebula::api::udf::Like("l", column<std::string_view>(col), p));
+      verify(nebula::api::udf::Like("l", column<std::string_view>(col), p, false, true));
+    }
+
+    verify(nebula::api::udf::Prefix("p", column<std::string_view>(col), "a"));
+    verify(nebula::api::udf::Prefix("p", column<std::string_view>(col), "A", false, true));
+  }
+}
+
+TEST(UDFTest, TestLikeTokens) {
+  nebula::meta::ColumnProps props;
+  props.emplace("msg", nebula::meta::Column{ false, false, false, "", "", {}, {}, false, {}, false, true });
+  nebula::meta::Table table("logs", nebula::type::TypeSerializer::from("ROW<_time_:bigint, msg:string>"), props, {});
+
+  // every message is distinct so the column is not dictionary encoded, every 10th row is NULL
+  const size_t size = 1000;
+  const std::vector<std::string> words{ "disk error", "error: timeout", "terror alert", "ok", "Error_code 42" };
+  std::vector<int64_t> times(size, 1);
+  std::vector<std::string> messages;
+  std::vector<uint8_t> valid(size / 8 + 1, 0xFF);
+  for (size_t i = 0; i < size; ++i) {
+    messages.push_back(fmt::format("req-{0} {1} on host{2}", i, words.at(i % words.size()), i % 7));
+    if (i % 10 == 0) {
+      valid[i >> 3] &= ~(1 << (i & 7));
+    }
+  }
+
+  const std::vector<std::string_view> views(messages.begin(), messages.end());
+  nebula::memory::Batch batch(table, size);
+  batch.add({ { times.data(), nullptr }, { views.data(), valid.data() } }, size);
+  batch.seal();
+  EXPECT_EQ(batch.dictSize("msg"), 0);
+  EXPECT_GT(batch.terms("msg"), size);
+  EXPECT_EQ(batch.terms("_time_"), 0);
+
+  auto accessor = batch.makeAccessor();
+  const nebula::surface::eval::Seeker seeker = [&accessor](size_t row) -> const nebula::surface::Accessor& {
+    return accessor->seek(row);
+  };
+
+  // rows selected through the token index should be the same as row by row evaluation
+  nebula::surface::eval::EvalContext ctx{ false };
+  auto verify = [&](const nebula::surface::eval::ValueEval& filter) {
+    nebula::surface::eval::Selection selection;
+    selection.reset(0, size);
+    filter.select(ctx, batch, seeker, selection);
+
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < size; ++i) {
+      ctx.reset(seeker(i));
+      if (filter.eval<bool>(ctx).value_or(false)) {
+        expected.push_back(i);
+      }
+    }
+
+    EXPECT_EQ(std::vector<size_t>(selection.begin(), selection.end()), expected);
+  };
+
+  using nebula::surface::eval::column;
+  for (auto p : { "%error%", "%rror%", "%error: t%", "%req-12 %", "req-1%", "%host3", "%Error%", "%none%", "%: %" }) {
+    verify(nebula::api::udf::Like("l", column<std::string_view>("msg"), p));
+    verify(nebula::api::udf::Like("l", column<std::string_view>("msg"), p, false));
+    verify(nebula::api::udf::Like("l", column<std::string_view>("msg"), p, true, true));
+  }
+
+  for (auto p : { "req-9", "req", "host", " req" }) {
+    verify(nebula::api::udf::Prefix("p", column<std::string_view>("msg"), p));
+  }
+}
+
+TEST(UDFTest, TestContains) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  nebula::memory::Batch batch(test, size);
+  nebula::surface::MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch.add(row);
+  }
+
+  // items is an array column, its elements are read as one column
+  auto list = batch.list("items");
+  EXPECT_TRUE(list.has_value());
+  EXPECT_EQ(list->rows, static_cast<size_t>(size));
+  EXPECT_EQ(list->kind, nebula::type::Kind::VARCHAR);
+  EXPECT_FALSE(batch.list("event").has_value());
+
+  auto accessor = batch.makeAccessor();
+  const nebula::surface::eval::Seeker seeker = [&accessor](size_t row) -> const nebula::surface::Accessor& {
+    return accessor->seek(row);
+  };
+
+  // lists selected by the element column should be the same as row by row evaluation
+  nebula::surface::eval::EvalContext ctx{ false };
+  for (const auto& values : std::vector<std::vector<std::string_view>>{ { "NN" }, { "N", "NNNNN" }, { "x" } }) {
+    auto set = std::make_shared<ValueSet<std::string_view>>(values.begin(), values.end());
+    nebula::api::udf::Contains<nebula::type::Kind::VARCHAR> contains("c", "items", set);
+
+    // a window in the middle of the batch
+    nebula::surface::eval::Selection selection;
+    selection.reset(100, size - 100);
+    contains.select(ctx, batch, seeker, selection);
+
+    std::vector<size_t> expected;
+    for (auto i = 100; i < size - 100; ++i) {
+      ctx.reset(seeker(i));
+      if (contains.eval<bool>(ctx).value_or(false)) {
+        expected.push_back(i);
+      }
+    }
+
+    EXPECT_EQ(std::vector<size_t>(selection.begin(), selection.end()), expected);
+    EXPECT_EQ(expected.empty(), values.front() == "x");
+  }
+}
+
 TEST(UDFTest, TestBetween) {
   nebula::surface::MockAccessor row;
   nebula::surface::eval::EvalContext ctx{ false };
@@ -226,7 +388,7 @@ TEST(UDFTest, TestIn) {
 
     for (const auto& item : data) {
       const auto& sv = std::get<0>(item);
-      auto s = std::make_shared<unordered_set<std::string_view>>(sv.begin(), sv.end());
+      auto s = std::make_shared<ValueSet<std::string_view>>(sv.begin(), sv.end());
       const auto& t = std::get<1>(item);
       const auto& f = std::get<2>(item);
       const auto& r = std::get<3>(item);
@@ -260,7 +422,7 @@ TEST(UDFTest, TestIn) {
 
     for (const auto& item : data) {
       const auto& sv = std::get<0>(item);
-      auto s = std::make_shared<unordered_set<int32_t>>(sv.begin(), sv.end());
+      auto s = std::make_shared<ValueSet<int32_t>>(sv.begin(), sv.end());
 
       const auto& t = std::get<1>(item);
       const auto& f = std::get<2>(item);
@@ -389,6 +551,27 @@ TEST(UDFTest, TestSum128) {
   EXPECT_TRUE(sum4 == expected);
 }
 
+TEST(UDFTest, TestSumOverflow) {
+  using CType = nebula::api::udf::Sum<nebula::type::Kind::BIGINT>;
+  constexpr auto MAX = std::numeric_limits<int64_t>::max();
+  auto v = std::make_shared<nebula::api::dsl::ConstExpression<int64_t>>(0);
+  CType sf("sum", v->asEval());
+
+  // a total out of BIGINT range is clamped rather than wrapped to a negative number
+  auto sum1 = sf.sketch();
+  sum1->merge(MAX);
+  sum1->merge(MAX);
+  EXPECT_EQ(sum1->finalize(), MAX);
+
+  // an overflowed partial sum coming back into range is exact
+  auto sum2 = sf.sketch();
+  sum2->merge(-MAX);
+  sum1->mix(*sum2);
+  EXPECT_EQ(sum1->finalize(), MAX);
+  sum1->merge(-10);
+  EXPECT_EQ(sum1->finalize(), MAX - 10);
+}
+
 TEST(UDFTest, TestMin) {
   auto v9 = std::make_shared<nebula::api::dsl::ConstExpression<int32_t>>(0);
   using CType = nebula::api::udf::Min<nebula::type::Kind::INTEGER>;
@@ -460,6 +643,60 @@ TEST(UDFTest, TestMax) {
   LOG(INFO) << "max=" << max4 << ", expected=" << expected;
 }
 
+TEST(UDFTest, TestSummarize) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  nebula::memory::Batch batch(test, size);
+  nebula::surface::MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch.add(row);
+  }
+
+  // expected values from reading every row
+  int64_t sum = 0;
+  int32_t min = std::numeric_limits<int32_t>::max();
+  int32_t max = std::numeric_limits<int32_t>::min();
+  size_t values = 0;
+  auto accessor = batch.makeAccessor();
+  for (auto i = 0; i < size; ++i) {
+    const auto& r = accessor->seek(i);
+    auto v = r.readByte("value");
+    sum += v.value_or(0);
+    auto id = r.readInt("id");
+    if (id) {
+      min = std::min(min, id.value());
+      max = std::max(max, id.value());
+      ++values;
+    }
+  }
+
+  using nebula::surface::eval::column;
+  nebula::api::udf::Count<nebula::type::Kind::INTEGER> count("count", column<int32_t>("id"));
+  auto cs = count.summarize(batch);
+  EXPECT_EQ(std::static_pointer_cast<decltype(count.sketch())::element_type>(cs)->finalize(), size);
+
+  nebula::api::udf::Sum<nebula::type::Kind::TINYINT> s("sum", column<int8_t>("value"));
+  auto ss = s.summarize(batch);
+  EXPECT_EQ(std::static_pointer_cast<decltype(s.sketch())::element_type>(ss)->finalize(), sum);
+
+  // min/max are answered only if no null values in the column
+  nebula::api::udf::Min<nebula::type::Kind::INTEGER> mn("min", column<int32_t>("id"));
+  nebula::api::udf::Max<nebula::type::Kind::INTEGER> mx("max", column<int32_t>("id"));
+  auto mns = mn.summarize(batch);
+  auto mxs = mx.summarize(batch);
+  if (values == (size_t)size) {
+    EXPECT_EQ(std::static_pointer_cast<decltype(mn.sketch())::element_type>(mns)->finalize(), min);
+    EXPECT_EQ(std::static_pointer_cast<decltype(mx.sketch())::element_type>(mxs)->finalize(), max);
+  } else {
+    EXPECT_EQ(mns, nullptr);
+    EXPECT_EQ(mxs, nullptr);
+  }
+
+  // expressions other than column are not answered by metadata
+  nebula::api::udf::Sum<nebula::type::Kind::TINYINT> cv("sum", nebula::surface::eval::constant<int8_t>(1));
+  EXPECT_EQ(cv.summarize(batch), nullptr);
+}
+
 TEST(UDFTest, TestAvg) {
   auto v9 = std::make_shared<nebula::api::dsl::ConstExpression<int32_t>>(0);
   using CType = nebula::api::udf::Avg<nebula::type::Kind::INTEGER>;
@@ -607,6 +844,27 @@ TEST(UDFTest, TestPct) {
   EXPECT_NEAR(td4, 217, 1);
   auto json = static_cast<CType::Aggregator*>(td1.get())->jsonfy();
   LOG(INFO) << "sketch in json: " << json;
+
+  // relative error percentile by a ddsketch
+  CType tr("tr", v9->asEval(), percentile, true);
+  auto tr1 = tr.sketch();
+  auto tr2 = tr.sketch();
+  for (auto i = 0; i < 220; ++i) {
+    if (i < 110) {
+      tr1->merge(i);
+    }
+    tr2->merge(i);
+  }
+
+  // the sketch goes through serde as partial aggregation between nodes
+  nebula::common::ExtendableSlice slice(1024);
+  auto bytes = tr2->serialize(slice, 0);
+  EXPECT_LT(bytes, 256);
+  auto tr3 = tr.sketch();
+  EXPECT_EQ(tr3->load(slice, 0), bytes);
+
+  tr1->mix(*tr3);
+  EXPECT_NEAR(tr1->finalize(), 215, 215 * 0.02);
 }
 
 TEST(UDFTest, TestHist) {
@@ -640,10 +898,24 @@ TEST(UDFTest, TestHist) {
   // we will ask itself for finalize
   auto jsonStr = (std::string)(th1->finalize());
   nebula::common::ExtendableSlice slice(1024);
-  EXPECT_EQ(th1->serialize(slice, 12), 287);
-  EXPECT_EQ(th1->load(slice, 12), 287);
+  // 10 buckets of the range plus 2 out of it
+  EXPECT_EQ(th1->serialize(slice, 12), 8 + 12 * 16);
+  EXPECT_EQ(th1->load(slice, 12), 8 + 12 * 16);
   CType::NativeType load = th1->finalize();
   EXPECT_EQ(load, jsonStr);
+
+  // values out of range go to the buckets below min and above max
+  using IType = nebula::api::udf::Hist<nebula::type::Kind::INTEGER>;
+  auto v0 = std::make_shared<nebula::api::dsl::ConstExpression<int32_t>>(0);
+  IType ih("ih", v0->asEval(), 0, 10, 5);
+  auto ih1 = ih.sketch();
+  for (auto v : { -1, 0, 1, 9, 10, 11 }) {
+    ih1->merge(v);
+  }
+
+  EXPECT_EQ((std::string)ih1->finalize(),
+            "{\"b\":[[-9223372036854775808,0,1,-1.0],[0,2,2,1.0],[2,4,0,0.0],[4,6,0,0.0],[6,8,0,0.0],"
+            "[8,10,1,9.0],[10,9223372036854775807,2,21.0]]}");
 }
 
 TEST(UDFTest, TestTpm) {
@@ -803,6 +1075,88 @@ TEST(UDFTest, TestCardinality) {
   LOG(INFO) << "cardinality: " << cardinality_est;
 }
 
+TEST(UDFTest, TestCardinalityExact) {
+  using SType = nebula::api::udf::Cardinality<nebula::type::Kind::VARCHAR>;
+  using LType = nebula::api::udf::Cardinality<nebula::type::Kind::BIGINT>;
+  auto v1 = std::make_shared<nebula::api::dsl::ConstExpression<std::string_view>>("");
+  auto v2 = std::make_shared<nebula::api::dsl::ConstExpression<int64_t>>(0);
+  SType scard("scard", v1->asEval(), false);
+  LType lcard("lcard", v2->asEval(), false);
+
+  // [0, 60000) and [40000, 100000) overlap by 20000 values
+  auto s1 = scard.sketch();
+  auto s2 = scard.sketch();
+  auto l1 = lcard.sketch();
+  auto l2 = lcard.sketch();
+  for (int64_t i = 0; i < 60000; ++i) {
+    auto value = fmt::format("v{0}", i);
+    s1->merge(value);
+    s1->merge(value);
+    s2->merge(fmt::format("v{0}", i + 40000));
+    l1->merge(i);
+    l2->merge(i + 40000);
+  }
+
+  EXPECT_EQ(s1->finalize(), 60000);
+  EXPECT_EQ(l2->finalize(), 60000);
+
+  // partial results go through serialization before mixed
+  nebula::common::ExtendableSlice slice(1024);
+  auto bytes = s2->serialize(slice, 8);
+  auto loaded = scard.sketch();
+  EXPECT_EQ(loaded->load(slice, 8), bytes);
+  s1->mix(*loaded);
+  EXPECT_EQ(s1->finalize(), 100000);
+
+  bytes = l2->serialize(slice, 8);
+  auto lloaded = lcard.sketch();
+  EXPECT_EQ(lloaded->load(slice, 8), bytes);
+  l1->mix(*lloaded);
+  EXPECT_EQ(l1->finalize(), 100000);
+}
+
+TEST(UDFTest, TestTopK) {
+  using CType = nebula::api::udf::TopK<nebula::type::Kind::VARCHAR>;
+  nebula::surface::eval::EvalContext ctx{ false };
+  auto v1 = std::make_shared<nebula::api::dsl::ConstExpression<std::string_view>>("");
+  CType topk("topk", v1->asEval(), 2);
+
+  // "a" x 30, "b" x 20, "c" x 10 spread over two sketches, plus 500 distinct values appearing once
+  auto sketch = topk.sketch();
+  auto sketch2 = topk.sketch();
+  for (size_t i = 0; i < 60; ++i) {
+    auto& target = i % 2 == 0 ? sketch : sketch2;
+    target->merge(i < 30 ? "a" : (i < 50 ? "b" : "c"));
+  }
+
+  for (size_t i = 0; i < 500; ++i) {
+    auto value = fmt::format("x{0}", i);
+    sketch2->merge(value);
+  }
+
+  // partial result goes through serialization before mixed
+  nebula::common::ExtendableSlice slice(1024);
+  auto bytes = sketch2->serialize(slice, 8);
+  auto loaded = topk.sketch();
+  EXPECT_EQ(loaded->load(slice, 8), bytes);
+  EXPECT_EQ(loaded->finalize(), sketch2->finalize());
+
+  sketch->mix(*loaded);
+  std::string json(sketch->finalize());
+  LOG(INFO) << "top k: " << json;
+
+  rapidjson::Document doc;
+  doc.Parse(json.data(), json.size());
+  auto list = doc.GetArray();
+  EXPECT_EQ(list.Size(), 2);
+  EXPECT_EQ(list[0]["value"], "a");
+  EXPECT_EQ(list[1]["value"], "b");
+
+  // count min never under-estimates
+  EXPECT_GE(list[0]["count"].GetUint64(), 30);
+  EXPECT_GE(list[1]["count"].GetUint64(), 20);
+}
+
 } // namespace test
 } // namespace api
 } // namespace nebula
\ No newline at end of file
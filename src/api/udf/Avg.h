@@ -118,7 +118,7 @@ public:
     : BaseType(name,
                std::move(expr),
                []() -> std::shared_ptr<Aggregator> {
-                 return std::make_shared<Aggregator>();
+                 return nebula::common::Arena::make<Aggregator>();
                }) {}
 
   virtual ~Avg() = default;
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "surface/eval/Kernel.h"
 #include "surface/eval/UDF.h"
 
 namespace nebula {
@@ -48,11 +49,39 @@ public:
         auto v = source.value();
         return v >= min && v <= max;
       },
-      buildEvalBlock(expr, min, max)) {}
+      buildEvalBlock(expr, min, max)) {
+    this->selector(buildSelector(expr, min, max));
+  }
 
   virtual ~Between() = default;
 
 private:
+  // batch "column in []" running kernel on raw column data
+  static nebula::surface::eval::Selector buildSelector(std::shared_ptr<nebula::api::dsl::Expression> expr,
+                                                       InputType min,
+                                                       InputType max) {
+    if constexpr (nebula::surface::eval::hasKernel(IK)) {
+      auto ve = expr->asEval();
+      if (ve->expressionType() == nebula::surface::eval::ExpressionType::COLUMN) {
+        std::string colName(ve->signature().substr(2));
+        return [name = std::move(colName), min, max](nebula::surface::eval::EvalContext&,
+                                                     const nebula::surface::eval::Block& b,
+                                                     const nebula::surface::eval::Seeker&,
+                                                     nebula::surface::eval::Selection& selection) -> bool {
+          // integers run on packed values if the column is bit packed
+          if constexpr (std::is_integral_v<InputType> && !std::is_same_v<InputType, bool>) {
+            return nebula::surface::eval::selectRange<InputType>(b, name, selection, min, max);
+          }
+
+          return nebula::surface::eval::selectScalar<InputType>(
+            b, name, selection, [min, max](const InputType v) { return (v >= min) & (v <= max); });
+        };
+      }
+    }
+
+    return {};
+  }
+
   static EvalBlock buildEvalBlock(std::shared_ptr<nebula::api::dsl::Expression> expr,
                                   InputType min,
                                   InputType max) {
@@ -95,7 +124,7 @@ private:
 // we can skip the block
 #define DISPATCH_CASE(HT)                                        \
   auto histo = std::dynamic_pointer_cast<HT>(b.histogram(name)); \
-  if (histo->min() > max || min > histo->max()) {                \
+  if (histo && (histo->min() > max || min > histo->max())) {     \
     return N;                                                    \
   }
 
@@ -16,8 +16,10 @@
 
 #pragma once
 
+#include <cstring>
 #include <lz4.h>
 
+#include "common/DistinctSet.h"
 #include "common/HyperLogLog.h"
 #include "surface/eval/UDF.h"
 
@@ -33,7 +35,8 @@
  * #1 is bounded with error rate in consider, default settings work for major scenarios. 
  * support user customization for precision adjust.
  * 
- * In the version 1 implementation, it only supports #1.
+ * #2 is backed by a hash partitioned distinct set (see DistinctSet), so that merging two big sets
+ * works on one small partition at a time rather than rehashing a whole set.
  *
  * HLL in chosen precision might be large (default log-size 20 implies 1MB store for each sketch).
  * In a group by aggregation scenario, we may have thousands of this for each key.
@@ -43,6 +46,7 @@
  *    unless the set outgrows the store size (1MB). This makes HLL used only when it's needed.
  * 2. we reserve by the log-size because we want to support some level of scale, but it's not flexible
  *    so we should looking for algo to make it dynamic grow instead of allocating fixed memory.
+ *    (HLL now starts sparse and allocates its registers only when it sees enough distinct values)
  * 3. the major concern is to serialize data across boundary, we should use compress to reduce its size.
  */
 namespace nebula {
@@ -66,17 +70,29 @@ public:
     // good for cardinality around 1M numbers, otherwise merge degrades accruacy
     static constexpr auto LOG_SIZE = 16;
 
+    // precise cardinality keeps values of up to 8 bytes as they are, others by 16 bytes
+    static constexpr bool WIDE = std::is_same_v<InputType, std::string_view> || sizeof(InputType) > sizeof(uint64_t);
+    using Set = nebula::common::DistinctSet<std::conditional_t<WIDE, nebula::common::Key128, uint64_t>>;
+
   public:
     explicit Aggregator(bool est, uint32_t logSize = LOG_SIZE)
       : est_{ est },
-        logSize_{ logSize },
-        log_{ std::make_unique<nebula::common::HyperLogLog>(logSize_) } {
-      N_ENSURE(est, "supporting estimated cardinality only for now.");
+        logSize_{ logSize } {
+      if (est_) {
+        log_ = std::make_unique<nebula::common::HyperLogLog>(logSize_);
+      } else {
+        set_ = std::make_unique<Set>();
+      }
     }
     virtual ~Aggregator() = default;
 
     // aggregate an value in
     inline virtual void merge(InputType v) override {
+      if (!est_) {
+        set_->add(Set::key(v));
+        return;
+      }
+
       // get bytes of the input type value
       log_->add(v);
     }
@@ -85,15 +101,40 @@ public:
     inline virtual void mix(const nebula::surface::eval::Sketch& another) override {
       // merge another tree
       const auto& right = static_cast<const Aggregator&>(another);
+      if (!est_) {
+        set_->merge(*right.set_);
+        return;
+      }
+
       log_->merge(*right.log_);
     }
 
     inline virtual NativeType finalize() override {
+      if (!est_) {
+        return (NativeType)set_->size();
+      }
+
       return (NativeType)log_->estimate();
     }
 
     // serialize into a buffer
     inline virtual size_t serialize(nebula::common::ExtendableSlice& slice, size_t offset) override {
+      if (!est_) {
+        return set_->serialize(slice, offset);
+      }
+
+      const auto origin = offset;
+
+      // a sparse sketch is written as its entries
+      const auto dense = log_->dense();
+      offset += slice.write(offset, dense);
+      if (!dense) {
+        const auto& entries = log_->entries();
+        offset += slice.write(offset, entries.size());
+        offset += slice.write(offset, (const char*)entries.data(), entries.size() * sizeof(uint32_t));
+        return offset - origin;
+      }
+
       auto data = log_->data();
       auto src = data.data();
       size_t size = data.size();
@@ -110,8 +151,6 @@ public:
         size = bytes;
       }
 
-      const auto origin = offset;
-
       offset += slice.write(offset, bytes > 0);
       offset += slice.write(offset, size);
       offset += slice.write(offset, src, size);
@@ -122,7 +161,24 @@ public:
 
     // deserialize from a given buffer, and bin size
     inline virtual size_t load(nebula::common::ExtendableSlice& slice, size_t offset) override {
+      if (!est_) {
+        return set_->load(slice, offset);
+      }
+
       const auto origin = offset;
+      auto dense = slice.read<bool>(offset);
+      offset += sizeof(dense);
+      if (!dense) {
+        auto count = slice.read<size_t>(offset);
+        offset += sizeof(count);
+        auto bytes = slice.read(offset, count * sizeof(uint32_t));
+        offset += bytes.size();
+        std::vector<uint32_t> entries(count);
+        std::memcpy(entries.data(), bytes.data(), bytes.size());
+        log_->set(std::move(entries));
+        return offset - origin;
+      }
+
       auto flag = slice.read<bool>(offset);
       offset += sizeof(flag);
       auto size = slice.read<size_t>(offset);
@@ -161,8 +217,9 @@ public:
     bool est_;
     uint32_t logSize_;
 
-    // mutual exclusive - converted when needed
+    // mutual exclusive - decided by est
     std::unique_ptr<nebula::common::HyperLogLog> log_;
+    std::unique_ptr<Set> set_;
   };
 
 public:
@@ -173,7 +230,7 @@ public:
     : BaseType(name,
                std::move(expr),
                [est]() -> std::shared_ptr<Aggregator> {
-                 return std::make_shared<Aggregator>(est);
+                 return nebula::common::Arena::make<Aggregator>(est);
                }) {}
 
   virtual ~Cardinality() = default;
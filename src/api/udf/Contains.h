@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#include "common/ValueSet.h"
+#include "surface/eval/Kernel.h"
+#include "surface/eval/UDF.h"
+
+/**
+ * Define expressions used in the nebula DSL.
+ */
+namespace nebula {
+namespace api {
+namespace udf {
+/**
+ * This UDF tells if a list of an array column has any element in given set, such as a tag of a row in given tags.
+ * Elements of all lists are stored in one flat element column, so a batch runs the membership test of the set
+ * on the element column as IN does on a column, and a row is selected if any element in its span is selected.
+ * NULL and empty lists contain nothing, values are of the element type.
+ */
+template <nebula::type::Kind IK>
+class Contains : public nebula::surface::eval::TypeValueEval<bool> {
+  using InputType = typename nebula::type::TypeTraits<IK>::CppType;
+  using SetType = typename std::shared_ptr<nebula::common::ValueSet<InputType>>;
+
+public:
+  Contains(const std::string& name, const std::string& column, SetType values)
+    : nebula::surface::eval::TypeValueEval<bool>(
+      fmt::format("{0}(F:{1})", name, column),
+      nebula::surface::eval::ExpressionType::FUNCTION,
+      [column, values](nebula::surface::eval::EvalContext& ctx,
+                       const std::vector<std::unique_ptr<nebula::surface::eval::ValueEval>>&) -> std::optional<bool> {
+        auto list = ctx.list(column);
+        if (N_UNLIKELY(list == nullptr)) {
+          return std::nullopt;
+        }
+
+        for (size_t i = 0, items = list->getItems(); i < items; ++i) {
+          if (!list->isNull(i) && values->contains(element(*list, i))) {
+            return true;
+          }
+        }
+
+        return false;
+      },
+      nebula::surface::eval::uncertain,
+      {},
+      children(column)) {
+    this->estimate(this->cost(), std::min(0.1 * values->size(), 0.9));
+    this->selector(buildSelector(column, values));
+  }
+
+  virtual ~Contains() = default;
+
+private:
+  // the array column is the only child, so that it is known to be read
+  static std::vector<std::unique_ptr<nebula::surface::eval::ValueEval>> children(const std::string& column) {
+    std::vector<std::unique_ptr<nebula::surface::eval::ValueEval>> children;
+    children.push_back(nebula::surface::eval::list(column));
+    return children;
+  }
+
+  static InputType element(const nebula::surface::ListData& list, size_t index) {
+    if constexpr (IK == nebula::type::Kind::BOOLEAN) {
+      return list.readBool(index);
+    } else if constexpr (IK == nebula::type::Kind::TINYINT) {
+      return list.readByte(index);
+    } else if constexpr (IK == nebula::type::Kind::SMALLINT) {
+      return list.readShort(index);
+    } else if constexpr (IK == nebula::type::Kind::INTEGER) {
+      return list.readInt(index);
+    } else if constexpr (IK == nebula::type::Kind::BIGINT) {
+      return list.readLong(index);
+    } else if constexpr (IK == nebula::type::Kind::REAL) {
+      return list.readFloat(index);
+    } else if constexpr (IK == nebula::type::Kind::DOUBLE) {
+      return list.readDouble(index);
+    } else if constexpr (IK == nebula::type::Kind::INT128) {
+      return list.readInt128(index);
+    } else {
+      return list.readString(index);
+    }
+  }
+
+  // batch "contains(column, [])" selecting elements of the selected rows by the membership test of the set layout,
+  // or on distinct items of a dictionary encoded string element column, the set also identifies its code map
+  static nebula::surface::eval::Selector buildSelector(const std::string& column, SetType values) {
+    if constexpr (nebula::surface::eval::hasKernel(IK)) {
+      return [column, values](nebula::surface::eval::EvalContext&,
+                              const nebula::surface::eval::Block& b,
+                              const nebula::surface::eval::Seeker&,
+                              nebula::surface::eval::Selection& selection) -> bool {
+        return nebula::surface::eval::selectList(
+          b, column, selection, [&b, &values](const auto& list, nebula::surface::eval::Selection& elements) {
+            N_ENSURE(list.kind == IK, "contains values of the element type");
+            return values->apply([&](auto contains) {
+              return nebula::surface::eval::selectScalar<InputType>(
+                b, list.items, elements, [&contains](const InputType v) { return contains(v); });
+            });
+          });
+      };
+    }
+
+    if constexpr (IK == nebula::type::Kind::VARCHAR) {
+      return [column, values](nebula::surface::eval::EvalContext& ctx,
+                              const nebula::surface::eval::Block& b,
+                              const nebula::surface::eval::Seeker&,
+                              nebula::surface::eval::Selection& selection) -> bool {
+        auto pred = [&values](std::string_view v) { return values->contains(v); };
+        return nebula::surface::eval::selectList(
+          b, column, selection, [&](const auto& list, nebula::surface::eval::Selection& elements) {
+            N_ENSURE(list.kind == IK, "contains values of the element type");
+            return nebula::surface::eval::selectDict(ctx, values, b, list.items, elements, pred)
+                   || nebula::surface::eval::selectViews(b, list.items, elements, pred);
+          });
+      };
+    }
+
+    return {};
+  }
+};
+
+} // namespace udf
+} // namespace api
+} // namespace nebula
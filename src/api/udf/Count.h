@@ -40,7 +40,8 @@ public:
     static constexpr auto StoreSize = sizeof(NativeType);
 
   public:
-    Aggregator() : value_{ 0 } {}
+    Aggregator() : Aggregator(0) {}
+    explicit Aggregator(NativeType value) : value_{ value } {}
     virtual ~Aggregator() = default;
 
     // aggregate an value_ in
@@ -85,8 +86,13 @@ public:
     : BaseType(name,
                nebula::surface::eval::constant(1),
                []() -> std::shared_ptr<Aggregator> {
-                 return std::make_shared<Aggregator>();
-               }) {}
+                 return nebula::common::Arena::make<Aggregator>();
+               }) {
+    // every row is counted, so count of a block is its number of rows
+    this->summarizer([](const nebula::surface::eval::Block& b) -> std::shared_ptr<nebula::surface::eval::Sketch> {
+      return nebula::common::Arena::make<Aggregator>(b.getRows());
+    });
+  }
   virtual ~Count() = default;
 };
 
@@ -16,12 +16,24 @@
 
 #pragma once
 
-#include <atomic>
+#include <algorithm>
+#include <cstring>
 #include <fmt/format.h>
-#include <folly/stats/Histogram.h>
+#include <limits>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <vector>
 
 #include "surface/eval/UDF.h"
 
+/**
+ * Implement UDAF HIST to count values of a column in fixed width buckets over [min, max).
+ * Besides the buckets of the range, values below min and values at or above max have their own buckets.
+ * All buckets of a histogram are kept in one array, a value finds its bucket by arithmetic and selects
+ * without branches, so aggregating a value costs about the same no matter where the value falls.
+ *
+ * The output is a JSON object of all buckets: {"b": [[min, max, count, sum], ...]}.
+ */
 namespace nebula {
 namespace api {
 namespace udf {
@@ -45,76 +57,106 @@ public:
   class Aggregator : public BaseAggregator {
     static constexpr auto SIZE_SIZE = sizeof(size_t);
 
+    struct Bucket {
+      uint64_t count;
+      InputType sum;
+    };
+
   public:
     explicit Aggregator(InputType min, InputType max, size_t bucketNum)
       : min_{ min },
         max_{ max },
-        bucketNum_{ bucketNum },
         bucketSize_{ static_cast<InputType>((max_ - min_) / bucketNum) },
-        histogram_{ bucketSize_, min_, max_ } {
-    }
+        buckets_(buckets(min_, max_, bucketSize_), Bucket{ 0, 0 }),
+        last_{ buckets_.size() - 1 } {}
     virtual ~Aggregator() = default;
 
     inline virtual void merge(typename BaseType::InputType v) override {
-      histogram_.addValue(v);
+      auto& bucket = buckets_[index(v)];
+      ++bucket.count;
+      bucket.sum += v;
     }
 
     inline virtual void mix(const nebula::surface::eval::Sketch& another) override {
-      auto right = static_cast<const Aggregator&>(another);
-      histogram_.merge(right.histogram_);
+      const auto& right = static_cast<const Aggregator&>(another);
+      N_ENSURE_EQ(buckets_.size(), right.buckets_.size(), "mix histograms of the same buckets");
+      for (size_t i = 0, size = buckets_.size(); i < size; ++i) {
+        buckets_[i].count += right.buckets_[i].count;
+        buckets_[i].sum += right.buckets_[i].sum;
+      }
     }
 
     inline virtual NativeType finalize() override {
-      json_ = jsonfy(true);
+      json_ = jsonfy();
       return json_;
     }
 
-    // serialize into a buffer
+    // serialize into a buffer: [number of buckets, (count, sum)...]
     inline virtual size_t serialize(nebula::common::ExtendableSlice& slice, size_t offset) override {
-      auto jsonStr = jsonfy(false);
-      auto bin = slice.write(offset, jsonStr.size());
-      auto size = slice.write(offset + bin, jsonStr.data(), jsonStr.size());
+      const auto bytes = buckets_.size() * sizeof(Bucket);
+      auto bin = slice.write(offset, buckets_.size());
+      auto size = slice.write(offset + bin, reinterpret_cast<const char*>(buckets_.data()), bytes);
       return bin + size;
     }
 
     inline virtual size_t load(nebula::common::ExtendableSlice& slice, size_t offset) override {
       auto size = slice.read<size_t>(offset);
-      auto jsonStr = std::string(slice.read(offset + SIZE_SIZE, size));
-      histogram_ = folly::Histogram<InputType>(bucketSize_, min_, max_);
-      rapidjson::Document document;
-      if (document.Parse(jsonStr.c_str()).HasParseError()) {
-        throw NException(fmt::format("Error parsing histogram json: {0}", jsonStr));
+      N_ENSURE_EQ(size, buckets_.size(), "load histogram of the same buckets");
+      auto bytes = slice.read(offset + SIZE_SIZE, size * sizeof(Bucket));
+      std::memcpy(buckets_.data(), bytes.data(), bytes.size());
+      return SIZE_SIZE + bytes.size();
+    }
+
+    inline virtual bool fit(size_t) override {
+      return false;
+    }
+
+  private:
+    // buckets of the range rounding up the last one, plus one below min and one above max
+    static size_t buckets(InputType min, InputType max, InputType bucketSize) {
+      auto num = static_cast<int64_t>((max - min) / bucketSize);
+      if (num * bucketSize < max - min) {
+        ++num;
       }
-      for (auto& bucket : document["b"].GetArray()) {
-        int64_t idx = 0;
-        uint64_t bucketCount = 0;
-        InputType bucketSum = 0;
-        for (auto& v : bucket.GetArray()) {
-          if (idx == 2) {
-            bucketCount = v.GetInt64();
-          } else if (idx == 3) {
-            bucketSum = v.GetDouble();
-          }
-          idx++;
-        }
-        if (bucketCount != 0) {
-          histogram_.addRepeatedValue(bucketSum / bucketCount, bucketCount);
-        }
+
+      return num + 2;
+    }
+
+    // bucket 0 is below min, the last one is at or above max, otherwise 1 + (value - min) / size.
+    // value is clamped into the range before division, so no branch is needed to pick a bucket.
+    inline size_t index(InputType v) const noexcept {
+      const auto clamped = std::min(std::max(min_, v), max_);
+      size_t idx = static_cast<size_t>((clamped - min_) / bucketSize_) + 1;
+      idx = v < min_ ? 0 : idx;
+      return v >= max_ ? last_ : idx;
+    }
+
+    inline InputType bucketMin(size_t idx) const noexcept {
+      if (idx == 0) {
+        return std::numeric_limits<InputType>::min();
       }
 
-      return size + SIZE_SIZE;
+      if (idx == last_) {
+        return max_;
+      }
+
+      return min_ + static_cast<InputType>(idx - 1) * bucketSize_;
     }
 
-    inline virtual bool fit(size_t) override {
-      return false;
+    inline InputType bucketMax(size_t idx) const noexcept {
+      if (idx == last_) {
+        return std::numeric_limits<InputType>::max();
+      }
+
+      return min_ + static_cast<InputType>(idx) * bucketSize_;
     }
 
   private:
     InputType min_;
     InputType max_;
-    size_t bucketNum_;
     InputType bucketSize_;
-    folly::Histogram<InputType> histogram_;
+    std::vector<Bucket> buckets_;
+    size_t last_;
     std::string json_;
 
 #define SAVE_VALUE(value)                              \
@@ -123,7 +165,7 @@ public:
   } else {                                             \
     json.Int64(value);                                 \
   }
-    std::string jsonfy(bool finalize = false) const noexcept {
+    std::string jsonfy() const noexcept {
       // Save histogram in below json format:
       // {"b": [[minVal1, maxVal1, count1, sum1],[minVal2, maxVal2, count2, sum2]...]}
       // The size of the json array is the total number of buckets in histogram
@@ -132,24 +174,24 @@ public:
       json.StartObject();
       json.Key("b");
       json.StartArray();
-      auto numBuckets = histogram_.getNumBuckets();
-      for (size_t i = 0; i < numBuckets; ++i) {
-        const auto& bucket = histogram_.getBucketByIndex(i);
-        if (finalize && i == numBuckets - 2) {
-          if (histogram_.getBucketMax(i) > histogram_.getBucketMin(i + 1)) {
-            const auto& lastBucket = histogram_.getBucketByIndex(i + 1);
-            json.StartArray();
-            SAVE_VALUE(histogram_.getBucketMin(i));
-            SAVE_VALUE(histogram_.getBucketMax(i + 1));
-            json.Int64(bucket.count + lastBucket.count);
-            json.Double(bucket.sum + lastBucket.sum);
-            json.EndArray();
-            break;
-          }
+      for (size_t i = 0; i < buckets_.size(); ++i) {
+        const auto& bucket = buckets_[i];
+
+        // the last bucket of the range rounded up beyond max is reported along with the bucket above max
+        if (i == last_ - 1 && bucketMax(i) > bucketMin(last_)) {
+          const auto& lastBucket = buckets_[last_];
+          json.StartArray();
+          SAVE_VALUE(bucketMin(i));
+          SAVE_VALUE(bucketMax(last_));
+          json.Int64(bucket.count + lastBucket.count);
+          json.Double(bucket.sum + lastBucket.sum);
+          json.EndArray();
+          break;
         }
+
         json.StartArray();
-        SAVE_VALUE(histogram_.getBucketMin(i));
-        SAVE_VALUE(histogram_.getBucketMax(i));
+        SAVE_VALUE(bucketMin(i));
+        SAVE_VALUE(bucketMax(i));
         json.Int64(bucket.count);
         json.Double(bucket.sum);
         json.EndArray();
@@ -192,7 +234,7 @@ public:
                    }
                  }
 
-                 return std::make_shared<Aggregator>(lowbound, upbound, bucketNum);
+                 return nebula::common::Arena::make<Aggregator>(lowbound, upbound, bucketNum);
                }) {}
 
   virtual ~Hist() = default;
@@ -16,6 +16,10 @@
 
 #pragma once
 
+#include <algorithm>
+
+#include "common/ValueSet.h"
+#include "surface/eval/Kernel.h"
 #include "surface/eval/UDF.h"
 
 /**
@@ -26,13 +30,15 @@ namespace api {
 namespace udf {
 /**
  * This UDF provides logic operations to determine if a value is in given set.
+ * The set picks its layout by size (scan, bitmap or hash, see ValueSet), a batch over a scalar column runs
+ * the membership test of that layout, and a dictionary encoded string column tests every distinct item once.
  */
 template <nebula::type::Kind IK>
 class In : public nebula::surface::eval::UDF<nebula::type::Kind::BOOLEAN, IK> {
   using UdfInBase = nebula::surface::eval::UDF<nebula::type::Kind::BOOLEAN, IK>;
   using InputType = typename nebula::type::TypeTraits<IK>::CppType;
   using EvalBlock = typename UdfInBase::EvalBlock;
-  using SetType = typename std::shared_ptr<nebula::common::unordered_set<InputType>>;
+  using SetType = typename std::shared_ptr<nebula::common::ValueSet<InputType>>;
   using ValueType = typename std::conditional<
     IK == nebula::type::Kind::VARCHAR,
     std::string,
@@ -51,9 +57,12 @@ public:
           return std::nullopt;
         }
 
-        return values->find(source.value()) != values->end();
+        return values->contains(source.value());
       },
-      buildEvalBlock(expr, values, true)) {}
+      buildEvalBlock(expr, values, true)) {
+    this->estimate(this->cost(), selectivity(values->size()));
+    this->selector(buildSelector(expr, values, true));
+  }
 
   In(const std::string& name,
      std::shared_ptr<nebula::api::dsl::Expression> expr,
@@ -68,15 +77,65 @@ public:
           return std::nullopt;
         }
 
-        return values->find(source.value()) == values->end();
+        return !values->contains(source.value());
       },
       buildEvalBlock(expr, values, false)) {
     N_ENSURE(!in, "this constructor is designed for NOT IN clauase");
+    this->estimate(this->cost(), 1 - selectivity(values->size()));
+    this->selector(buildSelector(expr, values, false));
   }
 
   virtual ~In() = default;
 
 private:
+  // every value qualifies as many rows as an equality does
+  static double selectivity(size_t values) {
+    return std::min(0.1 * values, 0.9);
+  }
+
+  // batch "column in []" running kernel on raw column data with the membership test of the set layout,
+  // or on distinct items of a dictionary encoded string column, the set also identifies its code map
+  static nebula::surface::eval::Selector buildSelector(std::shared_ptr<nebula::api::dsl::Expression> expr,
+                                                       SetType values,
+                                                       bool in) {
+    auto ve = expr->asEval();
+    if (ve->expressionType() != nebula::surface::eval::ExpressionType::COLUMN) {
+      return {};
+    }
+
+    std::string colName(ve->signature().substr(2));
+    if constexpr (nebula::surface::eval::hasKernel(IK)) {
+      return [name = std::move(colName), values, in](nebula::surface::eval::EvalContext& ctx,
+                                                     const nebula::surface::eval::Block& b,
+                                                     const nebula::surface::eval::Seeker&,
+                                                     nebula::surface::eval::Selection& selection) -> bool {
+        auto pred = [&values, in](const InputType v) { return values->contains(v) == in; };
+        if (nebula::surface::eval::selectBitmap<InputType>(ctx, values, b, name, selection, pred)) {
+          return true;
+        }
+
+        return values->apply([&](auto contains) {
+          return nebula::surface::eval::selectScalar<InputType>(
+            b, name, selection, [&contains, in](const InputType v) { return contains(v) == in; });
+        });
+      };
+    }
+
+    if constexpr (IK == nebula::type::Kind::VARCHAR) {
+      return [name = std::move(colName), values, in](nebula::surface::eval::EvalContext& ctx,
+                                                     const nebula::surface::eval::Block& b,
+                                                     const nebula::surface::eval::Seeker& seek,
+                                                     nebula::surface::eval::Selection& selection) -> bool {
+        auto pred = [&values, in](std::string_view v) { return values->contains(v) == in; };
+        return nebula::surface::eval::selectBitmap<InputType>(ctx, values, b, name, selection, pred)
+               || nebula::surface::eval::selectDict(ctx, values, b, name, selection, pred)
+               || nebula::surface::eval::selectStrings(seek, name, selection, pred);
+      };
+    }
+
+    return {};
+  }
+
   static EvalBlock buildEvalBlock(std::shared_ptr<nebula::api::dsl::Expression> expr,
                                   SetType values,
                                   bool in) {
@@ -100,7 +159,7 @@ private:
           for (auto v : pv) {
             auto valueType = std::any_cast<ValueType>(v);
             InputType ev(valueType);
-            if (values->find(ev) != values->end()) {
+            if (values->contains(ev)) {
               covered++;
             }
           }
@@ -116,10 +175,21 @@ private:
           }
         }
 
+        // rows having the values are counted exactly in a bitmap indexed column, NULL rows have none of them
+        const auto counted = nebula::surface::eval::evalBitmap<InputType>(
+          b, name, [&values](const InputType& v) { return values->contains(v); });
+        if (counted == nebula::surface::eval::BlockEval::ALL) {
+          return A;
+        }
+
+        if (in && counted == nebula::surface::eval::BlockEval::NONE) {
+          return N;
+        }
+
         // check bloom filter
         // if none of the values has possibility
         bool possible = false;
-        for (const auto& v : *values) {
+        for (const auto& v : values->values()) {
           possible = possible || b.probably(name, v);
           if (possible) {
             break;
@@ -133,11 +203,10 @@ private:
 
 // check histogram  if the value range has no overlap with histogram [min, max]
 // we can skip the block
-#define DISPATCH_CASE(HT)                                                      \
-  const auto [min, max] = std::minmax_element(values->begin(), values->end()); \
-  auto histo = std::dynamic_pointer_cast<HT>(b.histogram(name));               \
-  if (histo->min() > *max || *min > histo->max()) {                            \
-    return N;                                                                  \
+#define DISPATCH_CASE(HT)                                                        \
+  auto histo = std::dynamic_pointer_cast<HT>(b.histogram(name));                 \
+  if (histo && (histo->min() > values->max() || values->min() > histo->max())) { \
+    return N;                                                                    \
   }
 
         // only enable for scalar types
@@ -159,6 +228,13 @@ private:
           }
         }
 
+        // lexicographic range of strings only covers stored values, not default value
+        if constexpr (IK == nebula::type::Kind::VARCHAR) {
+          if (b.exact(name)) {
+            DISPATCH_CASE(nebula::surface::eval::StringHistogram)
+          }
+        }
+
 #undef DISPATCH_CASE
 
         // by default - let's do row scan
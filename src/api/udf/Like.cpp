@@ -65,6 +65,49 @@ bool match(const char* sp, const size_t ss, size_t si,
   // when pattern is all done, can't have remaining source for a match
   return si == ss;
 }
+
+LikeMatcher::LikeMatcher(const std::string& pattern, bool caseSensitive)
+  : pattern_{ pattern }, caseSensitive_{ caseSensitive }, shape_{ Shape::GENERIC } {
+  const auto size = pattern.size();
+  const auto head = size > 0 && pattern.front() == '%';
+  const auto tail = size > 1 && pattern.back() == '%';
+  const auto start = head ? 1 : 0;
+  const auto end = tail ? size - 1 : size;
+  token_ = start <= end ? pattern.substr(start, end - start) : std::string();
+
+  // a run of token chars in a pattern segment is a substring of every matched value, which can't cross its words
+  if (caseSensitive) {
+    for (size_t i = 0; i < size;) {
+      while (i < size && !nebula::common::Chars::token(pattern[i])) {
+        ++i;
+      }
+
+      const auto from = i;
+      while (i < size && nebula::common::Chars::token(pattern[i])) {
+        ++i;
+      }
+
+      if (i - from > term_.size()) {
+        term_ = pattern.substr(from, i - from);
+      }
+    }
+  }
+
+  // wildcards in the middle need generic match
+  if (token_.find('%') != std::string::npos) {
+    return;
+  }
+
+  if (!head && !tail) {
+    shape_ = Shape::EXACT;
+  } else if (!head) {
+    shape_ = Shape::PREFIX;
+  } else if (!tail) {
+    shape_ = Shape::SUFFIX;
+  } else if (caseSensitive) {
+    shape_ = Shape::CONTAINS;
+  }
+}
 } // namespace udf
 } // namespace api
 } // namespace nebula
\ No newline at end of file
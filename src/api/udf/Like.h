@@ -18,6 +18,8 @@
 
 #include <fmt/format.h>
 
+#include "common/Chars.h"
+#include "surface/eval/Kernel.h"
 #include "surface/eval/UDF.h"
 
 /**
@@ -45,6 +47,66 @@ bool match(const char* sp, const size_t ss, size_t si,
            const char* pp, const size_t ps, size_t pi,
            bool caseSensitive = true);
 
+// a LIKE pattern compiled once into the cheapest matcher of its shape:
+// "abc" as equality, "abc%" as prefix, "%abc" as suffix, "%abc%" as substring search (memchr based).
+// other patterns (and case insensitive substring) use the generic match.
+class LikeMatcher {
+  enum class Shape {
+    EXACT,
+    PREFIX,
+    SUFFIX,
+    CONTAINS,
+    GENERIC
+  };
+
+public:
+  LikeMatcher(const std::string& pattern, bool caseSensitive);
+  virtual ~LikeMatcher() = default;
+
+  // pattern is matched by back tracking rather than a single comparison or search
+  inline bool generic() const noexcept {
+    return shape_ == Shape::GENERIC;
+  }
+
+  // longest run of token chars in a case sensitive pattern, every matched value has it within one of its terms.
+  // empty if there is none, see TokenIndex
+  inline const std::string& term() const noexcept {
+    return term_;
+  }
+
+  // values having the term are exactly the matched ones
+  inline bool exact() const noexcept {
+    return shape_ == Shape::CONTAINS && term_ == token_;
+  }
+
+  inline bool operator()(std::string_view v) const {
+    switch (shape_) {
+    case Shape::EXACT:
+      return caseSensitive_ ? v == token_ : nebula::common::Chars::same(v, token_);
+    case Shape::PREFIX:
+      return caseSensitive_ ? nebula::common::Chars::prefix(v, token_)
+                            : nebula::common::Chars::prefix(v.data(), v.size(), token_.data(), token_.size(), true);
+    case Shape::SUFFIX: {
+      const auto size = token_.size();
+      return v.size() >= size
+             && nebula::common::Chars::prefix(v.data() + v.size() - size, size, token_.data(), size, !caseSensitive_);
+    }
+    case Shape::CONTAINS:
+      return v.find(token_) != std::string_view::npos;
+    default:
+      return match(v.data(), v.size(), 0, pattern_.data(), pattern_.size(), 0, caseSensitive_);
+    }
+  }
+
+private:
+  std::string pattern_;
+  bool caseSensitive_;
+  Shape shape_;
+  // pattern without leading and trailing %
+  std::string token_;
+  std::string term_;
+};
+
 using UdfLikeBase = nebula::surface::eval::UDF<nebula::type::Kind::BOOLEAN, nebula::type::Kind::VARCHAR>;
 class Like : public UdfLikeBase {
 public:
@@ -53,22 +115,65 @@ public:
        const std::string& pattern,
        bool caseSensitive = true,
        bool unlike = false)
+    : Like(name, std::move(expr), std::make_shared<LikeMatcher>(pattern, caseSensitive), unlike) {}
+  virtual ~Like() = default;
+
+private:
+  Like(const std::string& name,
+       std::unique_ptr<nebula::surface::eval::ValueEval> expr,
+       std::shared_ptr<LikeMatcher> matcher,
+       bool unlike)
     : UdfLikeBase(
       name,
       std::move(expr),
-      [pattern, caseSensitive, unlike](const std::optional<InputType>& source)
+      [matcher, unlike](const std::optional<InputType>& source)
         -> std::optional<NativeType> {
         if (N_UNLIKELY(source == std::nullopt)) {
           return std::nullopt;
         }
 
-        auto v = source.value();
-        auto m = match(v.data(), v.size(), 0,
-                       pattern.data(), pattern.size(), 0,
-                       caseSensitive);
-        return unlike ? !m : m;
-      }) {}
-  virtual ~Like() = default;
+        return (*matcher)(source.value()) != unlike;
+      }) {
+    this->estimate(this->cost() + (matcher->generic() ? 8 : 1), unlike ? 0.75 : 0.25);
+    this->selector(buildSelector(this->expr(), std::move(matcher), unlike));
+  }
+
+  // batch "like(column)": dictionary encoded column matches every distinct item once and selects rows by codes,
+  // otherwise rows are narrowed by terms in token index of the column if any, then strings are matched directly
+  static nebula::surface::eval::Selector buildSelector(
+    const nebula::surface::eval::ValueEval& expr, std::shared_ptr<LikeMatcher> matcher, bool unlike) {
+    if (expr.expressionType() != nebula::surface::eval::ExpressionType::COLUMN) {
+      return {};
+    }
+
+    // column expr signature is composed by "F:{col}"
+    std::string colName(expr.signature().substr(2));
+    return [name = std::move(colName), matcher = std::move(matcher), unlike](
+             nebula::surface::eval::EvalContext& ctx,
+             const nebula::surface::eval::Block& b,
+             const nebula::surface::eval::Seeker& seek,
+             nebula::surface::eval::Selection& selection) -> bool {
+      auto pred = [&matcher, unlike](std::string_view v) {
+        return (*matcher)(v) != unlike;
+      };
+
+      if (nebula::surface::eval::selectDict(ctx, matcher, b, name, selection, pred)) {
+        return true;
+      }
+
+      // rows not having the term can't match, the rest are matched by values unless the term is the pattern
+      const auto& term = matcher->term();
+      if (!unlike && !term.empty()
+          && nebula::surface::eval::selectTerms(ctx, matcher, b, name, selection, [&term](std::string_view t) {
+               return t.find(term) != std::string_view::npos;
+             })
+          && (matcher->exact() || selection.empty())) {
+        return true;
+      }
+
+      return nebula::surface::eval::selectStrings(seek, name, selection, pred);
+    };
+  }
 };
 
 } // namespace udf
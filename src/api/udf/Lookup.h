@@ -0,0 +1,71 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include "meta/Lookup.h"
+#include "surface/eval/UDF.h"
+
+/**
+ * Implement UDF LOOKUP to map a key to its value in a lookup table.
+ * The table is held by the UDF, so looked up values are views of the table strings which outlive every row.
+ */
+namespace nebula {
+namespace api {
+namespace udf {
+
+template <nebula::type::Kind IK,
+          typename Traits = nebula::surface::eval::UdfTraits<nebula::surface::eval::UDFType::LOOKUP, IK>,
+          typename BaseType = nebula::surface::eval::UDF<Traits::Type, IK>>
+class Lookup : public BaseType {
+public:
+  using InputType = typename BaseType::InputType;
+  using NativeType = typename BaseType::NativeType;
+
+public:
+  // table name is part of the signature so that lookups of different tables are not cached as one
+  Lookup(const std::string& name,
+         std::unique_ptr<nebula::surface::eval::ValueEval> expr,
+         nebula::meta::LookupTablePtr table)
+    : BaseType(
+      fmt::format("{0}:{1}", name, table->name()),
+      std::move(expr),
+      [table](const std::optional<InputType>& key) -> std::optional<NativeType> {
+        if (N_UNLIKELY(key == std::nullopt)) {
+          return std::nullopt;
+        }
+
+        const std::string* value;
+        if constexpr (std::is_same_v<InputType, std::string_view>) {
+          value = table->find(key.value());
+        } else {
+          value = table->find(static_cast<int64_t>(key.value()));
+        }
+
+        if (value == nullptr) {
+          return std::nullopt;
+        }
+
+        return std::string_view(*value);
+      }) {}
+  virtual ~Lookup() = default;
+};
+
+} // namespace udf
+} // namespace api
+} // namespace nebula
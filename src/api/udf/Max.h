@@ -42,7 +42,8 @@ public:
     static constexpr auto StoreSize = sizeof(NativeType);
 
   public:
-    Aggregator() : value_{ std::numeric_limits<NativeType>::min() } {}
+    Aggregator() : Aggregator(std::numeric_limits<NativeType>::min()) {}
+    explicit Aggregator(NativeType value) : value_{ value } {}
     virtual ~Aggregator() = default;
 
     // aggregate an value in
@@ -84,8 +85,18 @@ public:
     : BaseType(name,
                std::move(expr),
                []() -> std::shared_ptr<Aggregator> {
-                 return std::make_shared<Aggregator>();
-               }) {}
+                 return nebula::common::Arena::make<Aggregator>();
+               }) {
+    // null values are aggregated as 0, so only a column without nulls is answered by its histogram
+    this->summarizer([this](const nebula::surface::eval::Block& b) -> std::shared_ptr<nebula::surface::eval::Sketch> {
+      auto stats = nebula::surface::eval::columnStats<InputType>(this->expr(), b);
+      if (!stats || stats->count == 0 || stats->count != b.getRows()) {
+        return nullptr;
+      }
+
+      return nebula::common::Arena::make<Aggregator>(stats->max());
+    });
+  }
   virtual ~Max() = default;
 };
 
@@ -41,7 +41,9 @@ public:
 
         // otherwise reverse
         return !origin.value();
-      }) {}
+      }) {
+    this->estimate(this->cost(), 1 - this->expr().selectivity());
+  }
   virtual ~Not() = default;
 };
 
@@ -16,22 +16,26 @@
 
 #pragma once
 
-#include <atomic>
-#include <folly/stats/TDigest.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include "common/DDSketch.h"
+#include "common/TDigest.h"
 #include "surface/eval/UDF.h"
 
 /**
- * Implement UDAF Pct to get quantiles of target values using folly/tdigest implementation
- * Internally this UDAF maintains a sketch binary stream with all numbers in double type.
+ * Implement UDAF Pct to get quantiles of target values using nebula tdigest implementation
+ * Internally this UDAF buffers input values in double type and merges them into the digest batch by batch.
+ *
+ * A relative error option uses a DDSketch instead: no buffer and no sort, a value is one bucket increment,
+ * and a group of values within a few orders of magnitude (latencies) is usually serialized in a few hundred bytes.
+ * It fits queries with many groups, each percentile is within 2% of the true value rather than of its rank.
  */
 namespace nebula {
 namespace api {
 namespace udf {
 
-// UDAF - percentile value through tdigest
+// UDAF - percentile value through tdigest, or ddsketch for relative error
 template <nebula::type::Kind IK,
           typename Traits = nebula::surface::eval::UdfTraits<nebula::surface::eval::UDFType::PCT, IK>,
           typename BaseType = nebula::surface::eval::UDAF<Traits::Type, IK>>
@@ -48,77 +52,75 @@ public:
 public:
   class Aggregator : public BaseAggregator {
   public:
-    explicit Aggregator(double percentile)
-      : percentile_{ percentile / DIGEST_SIZE },
+    explicit Aggregator(double percentile, bool relative = false)
+      : percentile_{ percentile / 100 },
         digest_{ DIGEST_SIZE },
+        sketch_{ relative ? std::make_unique<nebula::common::DDSketch>() : nullptr },
         serde_{} {
-      buffer_.reserve(BUFFER_SIZE);
+      if (!relative) {
+        buffer_.reserve(BUFFER_SIZE);
+      }
     }
     virtual ~Aggregator() = default;
     // aggregate an value in
     inline virtual void merge(InputType v) override {
-      if (N_LIKELY(buffer_.size() < BUFFER_SIZE)) {
-        buffer_.emplace_back(double(v));
+      if (sketch_) {
+        sketch_->add(double(v));
         return;
       }
 
-      flush();
+      buffer_.emplace_back(double(v));
+      if (N_UNLIKELY(buffer_.size() >= BUFFER_SIZE)) {
+        flush();
+      }
     }
 
-    // aggregate another aggregator
-    // TODO(cao): the current merge signature is strange requiring an array incuring copy
-    // We may use our own version of TDigest implementation
-    // with better interface to merge single item by pointer or reference
+    // aggregate another aggregator by reference, its buffered values are merged as inputs
     inline virtual void mix(const nebula::surface::eval::Sketch& another) override {
-      auto right = static_cast<const Aggregator&>(another);
-
-      // merge buffer
-      auto rightBufferSize = right.buffer_.size();
-      if (rightBufferSize > 0) {
-        if (rightBufferSize > buffer_.size()) {
-          std::swap(buffer_, right.buffer_);
-        }
-
-        for (auto v : right.buffer_) {
-          buffer_.emplace_back(v);
-        }
-
-        right.buffer_.clear();
+      const auto& right = static_cast<const Aggregator&>(another);
+      if (sketch_) {
+        sketch_->merge(*right.sketch_);
+        return;
       }
 
-      // only merge object only when it has value
-      if (right.digest_.count() > 0) {
-        digest_ = digest_.merge(std::array<folly::TDigest, 1>{ right.digest_ });
+      digest_.merge(right.digest_);
+      for (auto v : right.buffer_) {
+        merge(v);
       }
     }
 
     inline virtual NativeType finalize() override {
+      if (sketch_) {
+        return static_cast<NativeType>(sketch_->quantile(percentile_));
+      }
+
       flush();
-      return static_cast<NativeType>(digest_.estimateQuantile(percentile_));
+      return static_cast<NativeType>(digest_.quantile(percentile_));
     }
 
     std::string jsonfy() {
+      flush();
+
       // set up JSON writer to serialize each row
       rapidjson::StringBuffer buffer;
       rapidjson::Writer<rapidjson::StringBuffer> json(buffer);
       json.StartObject();
 #define KV(V, NAME) \
   json.Key(#NAME);  \
-  json.Double(V.NAME());
+  json.Double(V);
 
-      KV(digest_, sum)
-      KV(digest_, count)
-      KV(digest_, max)
-      KV(digest_, min)
-      KV(digest_, maxSize)
+      KV(digest_.sum(), sum)
+      KV(digest_.count(), count)
+      KV(digest_.max(), max)
+      KV(digest_.min(), min)
+      KV(digest_.compression(), compression)
 
       json.Key("centroids");
       json.StartArray();
-      const auto& centroids = digest_.getCentroids();
-      for (const auto& c : centroids) {
+      for (const auto& c : digest_.centroids()) {
         json.StartObject();
-        KV(c, mean)
-        KV(c, weight)
+        KV(c.mean, mean)
+        KV(c.weight, weight)
         json.EndObject();
       }
       json.EndArray();
@@ -133,60 +135,22 @@ public:
 
     // serialize into a buffer
     inline virtual size_t serialize(nebula::common::ExtendableSlice& slice, size_t offset) override {
-      flush();
-
-      // record first offset - final size will be delta of offset
-      size_t origin = offset;
-      // write sum
-      offset += slice.write(offset, digest_.sum());
-      // write count
-      offset += slice.write(offset, digest_.count());
-      // write max
-      offset += slice.write(offset, digest_.max());
-      // write min
-      offset += slice.write(offset, digest_.min());
-      // write max size
-      offset += slice.write(offset, digest_.maxSize());
-      // write all centroids
-      const auto& centroids = digest_.getCentroids();
-      // write count of centroids
-      offset += slice.write(offset, centroids.size());
-      for (const auto& c : centroids) {
-        offset += slice.write(offset, c.mean());
-        offset += slice.write(offset, c.weight());
+      if (sketch_) {
+        return sketch_->serialize(slice, offset);
       }
 
-      return offset - origin;
+      flush();
+      return digest_.serialize(slice, offset);
     }
 
     // deserialize from a given buffer, and bin size
     inline virtual size_t load(nebula::common::ExtendableSlice& slice, size_t offset) override {
-      static constexpr auto WIDTH = sizeof(double);
-
-      size_t origin = offset;
-#define READ(NAME)                          \
-  double NAME = slice.read<double>(offset); \
-  offset += WIDTH;
-
-      READ(sum)
-      READ(count)
-      READ(max)
-      READ(min)
-
-      size_t maxSize = slice.read<size_t>(offset);
-      offset += WIDTH;
-      size_t numCentroids = slice.read<size_t>(offset);
-      offset += WIDTH;
-      std::vector<folly::TDigest::Centroid> centroids;
-      centroids.reserve(numCentroids);
-      for (size_t i = 0; i < numCentroids; ++i) {
-        READ(mean)
-        READ(weight)
-        centroids.emplace_back(mean, weight);
+      if (sketch_) {
+        return sketch_->load(slice, offset);
       }
-#undef READ
-      digest_ = folly::TDigest(std::move(centroids), sum, count, max, min, maxSize);
-      return offset - origin;
+
+      buffer_.clear();
+      return digest_.load(slice, offset);
     }
 
     inline virtual bool fit(size_t) override {
@@ -196,7 +160,7 @@ public:
   private:
     inline void flush() {
       if (buffer_.size() > 0) {
-        digest_ = digest_.merge(buffer_);
+        digest_.add(buffer_);
         buffer_.clear();
       }
     }
@@ -204,16 +168,21 @@ public:
   private:
     double percentile_;
     std::vector<double> buffer_;
-    folly::TDigest digest_;
+    nebula::common::TDigest digest_;
+    // set for relative error percentiles, the digest is not used then
+    std::unique_ptr<nebula::common::DDSketch> sketch_;
     std::string serde_;
   };
 
 public:
-  Pct(const std::string& name, std::unique_ptr<nebula::surface::eval::ValueEval> expr, double percentile)
+  Pct(const std::string& name,
+      std::unique_ptr<nebula::surface::eval::ValueEval> expr,
+      double percentile,
+      bool relative = false)
     : BaseType(name,
                std::move(expr),
-               [p = percentile]() -> std::shared_ptr<Aggregator> {
-                 return std::make_shared<Aggregator>(p);
+               [p = percentile, relative]() -> std::shared_ptr<Aggregator> {
+                 return nebula::common::Arena::make<Aggregator>(p, relative);
                }) {}
 
   virtual ~Pct() = default;
@@ -19,6 +19,7 @@
 #include <glog/logging.h>
 
 #include "common/Chars.h"
+#include "surface/eval/Kernel.h"
 #include "surface/eval/UDF.h"
 
 /**
@@ -56,8 +57,68 @@ public:
           prefix.data(), prefix.size(),
           !caseSensitive);
         return opposite ? !p : p;
-      }) {}
+      }) {
+    this->selector(buildSelector(this->expr(), prefix, caseSensitive, opposite));
+  }
   virtual ~Prefix() = default;
+
+private:
+  // batch "prefix(column)": dictionary encoded column matches every distinct item once and selects rows by codes,
+  // otherwise rows are narrowed by terms in token index of the column if any, then strings are matched directly
+  static nebula::surface::eval::Selector buildSelector(
+    const nebula::surface::eval::ValueEval& expr, const std::string& prefix, bool caseSensitive, bool opposite) {
+    if (expr.expressionType() != nebula::surface::eval::ExpressionType::COLUMN) {
+      return {};
+    }
+
+    // column expr signature is composed by "F:{col}"
+    // the shared prefix also identifies this predicate for its dictionary code map in eval context
+    std::string colName(expr.signature().substr(2));
+
+    // a value starting with the prefix has its first word starting with the leading token chars of the prefix
+    size_t lead = 0;
+    while (lead < prefix.size() && nebula::common::Chars::token(prefix[lead])) {
+      ++lead;
+    }
+
+    return [name = std::move(colName),
+            pfx = std::make_shared<const std::string>(prefix),
+            word = prefix.substr(0, lead),
+            caseSensitive,
+            opposite](
+             nebula::surface::eval::EvalContext& ctx,
+             const nebula::surface::eval::Block& b,
+             const nebula::surface::eval::Seeker& seek,
+             nebula::surface::eval::Selection& selection) -> bool {
+      const auto& prefix = *pfx;
+      if (caseSensitive) {
+        auto pred = [&prefix, opposite](std::string_view v) {
+          return nebula::common::Chars::prefix(v, prefix) != opposite;
+        };
+
+        if (nebula::surface::eval::selectDict(ctx, pfx, b, name, selection, pred)) {
+          return true;
+        }
+
+        if (!opposite && !word.empty()
+            && nebula::surface::eval::selectTerms(ctx, pfx, b, name, selection, [&word](std::string_view t) {
+                 return nebula::common::Chars::prefix(t, word);
+               })
+            && selection.empty()) {
+          return true;
+        }
+
+        return nebula::surface::eval::selectStrings(seek, name, selection, pred);
+      }
+
+      auto pred = [&prefix, opposite](std::string_view v) {
+        return nebula::common::Chars::prefix(v.data(), v.size(), prefix.data(), prefix.size(), true) != opposite;
+      };
+
+      return nebula::surface::eval::selectDict(ctx, pfx, b, name, selection, pred)
+             || nebula::surface::eval::selectStrings(seek, name, selection, pred);
+    };
+  }
 };
 
 } // namespace udf
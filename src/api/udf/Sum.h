@@ -16,10 +16,13 @@
 
 #pragma once
 
+#include "common/Sum.h"
 #include "surface/eval/UDF.h"
 
 /**
  * Define expressions used in the nebula DSL.
+ * Integers are summed exactly with an int128 carry taken only on overflow, and the total is clamped into BIGINT
+ * rather than wrapped. Floating numbers are summed with compensation so that the total doesn't drift by order.
  */
 namespace nebula {
 namespace api {
@@ -37,33 +40,48 @@ public:
 
   class Aggregator : public BaseAggregator {
     static constexpr auto StoreSize = sizeof(NativeType);
+    static constexpr bool EXACT = std::is_same_v<NativeType, int64_t>;
+    static constexpr bool COMPENSATED = std::is_floating_point_v<NativeType>;
+    using Accumulator = std::conditional_t<
+      EXACT,
+      nebula::common::SafeSum,
+      std::conditional_t<COMPENSATED, nebula::common::FloatSum, NativeType>>;
 
   public:
-    Aggregator() : value_{ 0 } {}
+    Aggregator() : Aggregator(0) {}
+    explicit Aggregator(NativeType value) : sum_{ value } {}
     virtual ~Aggregator() = default;
-    // aggregate an value_ in
+    // aggregate an value in
     inline virtual void merge(InputType v) override {
-      value_ += v;
+      if constexpr (EXACT || COMPENSATED) {
+        sum_.add(static_cast<NativeType>(v));
+      } else {
+        sum_ += v;
+      }
     }
 
     // aggregate another aggregator
     inline virtual void mix(const nebula::surface::eval::Sketch& another) override {
-      auto v2 = static_cast<const Aggregator&>(another).value_;
-      value_ += v2;
+      const auto& v2 = static_cast<const Aggregator&>(another).sum_;
+      if constexpr (EXACT || COMPENSATED) {
+        sum_.add(v2);
+      } else {
+        sum_ += v2;
+      }
     }
 
     inline virtual NativeType finalize() override {
-      return value_;
+      return total();
     }
 
-    // serialize into a buffer
+    // serialize into a buffer, a partial sum is clamped into its native type too
     inline virtual size_t serialize(nebula::common::ExtendableSlice& slice, size_t offset) override {
-      return slice.write(offset, value_);
+      return slice.write(offset, total());
     }
 
     // deserialize from a given buffer, and bin size
     inline virtual size_t load(nebula::common::ExtendableSlice& slice, size_t offset) override {
-      value_ = slice.read<NativeType>(offset);
+      sum_ = Accumulator(slice.read<NativeType>(offset));
       return StoreSize;
     }
 
@@ -72,7 +90,18 @@ public:
     }
 
   private:
-    NativeType value_;
+    inline NativeType total() const noexcept {
+      if constexpr (EXACT) {
+        return sum_.narrow();
+      } else if constexpr (COMPENSATED) {
+        return sum_.value();
+      } else {
+        return sum_;
+      }
+    }
+
+  private:
+    Accumulator sum_;
   };
 
 public:
@@ -80,8 +109,18 @@ public:
     : BaseType(name,
                std::move(expr),
                []() -> std::shared_ptr<Aggregator> {
-                 return std::make_shared<Aggregator>();
-               }) {}
+                 return nebula::common::Arena::make<Aggregator>();
+               }) {
+    // null values are summed as 0, so sum of non-null values in histogram is the sum of the block
+    this->summarizer([this](const nebula::surface::eval::Block& b) -> std::shared_ptr<nebula::surface::eval::Sketch> {
+      auto stats = nebula::surface::eval::columnStats<InputType>(this->expr(), b);
+      if (!stats) {
+        return nullptr;
+      }
+
+      return nebula::common::Arena::make<Aggregator>(stats->sum());
+    });
+  }
   virtual ~Sum() = default;
 };
 
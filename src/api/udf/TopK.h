@@ -0,0 +1,290 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "common/CountMin.h"
+#include "surface/eval/UDF.h"
+
+/**
+ * Implement UDAF TOPK to find heavy hitters (most frequent values) of a column approximately.
+ * Every value is counted by a count-min sketch, and a small set of candidates with the highest estimated counts
+ * is kept along with it, so the cost is bounded no matter how many distinct values the column has.
+ * Two aggregators are mixed by merging their sketches and re-estimating the union of their candidates.
+ *
+ * The output is a JSON list of the top K values in descending order of count: [{"value": v, "count": c}, ...].
+ * Counts are upper bounds, over-estimated by at most about e/M of total count with high probability.
+ */
+namespace nebula {
+namespace api {
+namespace udf {
+
+template <nebula::type::Kind IK,
+          typename Traits = nebula::surface::eval::UdfTraits<nebula::surface::eval::UDFType::TOPK, IK>,
+          typename BaseType = nebula::surface::eval::UDAF<Traits::Type, IK>>
+class TopK : public BaseType {
+public:
+  using InputType = typename BaseType::InputType;
+  using NativeType = typename BaseType::NativeType;
+  using BaseAggregator = typename BaseType::BaseAggregator;
+
+public:
+  class Aggregator : public BaseAggregator {
+    // 4 x 1024 counters - 32KB per sketch
+    static constexpr size_t HASHES = 4;
+    using CMS = nebula::common::CountMin<HASHES, 1024, size_t>;
+    static constexpr bool STR = std::is_same_v<InputType, std::string_view>;
+
+    // candidates own their values since a string value doesn't outlive its row
+    using ValueType = std::conditional_t<STR, std::string, InputType>;
+    struct Candidate {
+      ValueType value;
+      size_t count;
+    };
+
+    // keep more candidates than K so that values ranking around K are not lost by estimation error
+    static constexpr size_t CANDIDATES = 4;
+
+  public:
+    explicit Aggregator(size_t k)
+      : k_{ k },
+        capacity_{ k * CANDIDATES },
+        sketch_{ std::make_unique<CMS>() },
+        floor_{ 0 } {}
+    virtual ~Aggregator() = default;
+
+    // aggregate an value in
+    inline virtual void merge(InputType v) override {
+      const auto hashes = hash(v);
+      const auto count = sketch_->add(hashes);
+
+      // a candidate is identified by the first hash of its value
+      auto found = candidates_.find(hashes[0]);
+      if (found != candidates_.end()) {
+        found->second.count = count;
+        return;
+      }
+
+      offer(hashes[0], v, count);
+    }
+
+    // aggregate another aggregator
+    inline virtual void mix(const nebula::surface::eval::Sketch& another) override {
+      const auto& right = static_cast<const Aggregator&>(another);
+      sketch_->merge(*right.sketch_);
+
+      // every candidate of both sides is re-estimated by the merged sketch
+      for (auto& item : candidates_) {
+        item.second.count = sketch_->query(hash(item.second.value));
+      }
+
+      for (const auto& item : right.candidates_) {
+        if (candidates_.find(item.first) == candidates_.end()) {
+          const auto& value = item.second.value;
+          candidates_.emplace(item.first, Candidate{ value, sketch_->query(hash(value)) });
+        }
+      }
+
+      // keep the top ones only
+      if (candidates_.size() > capacity_) {
+        auto list = ranked();
+        list.resize(capacity_);
+        candidates_.clear();
+        for (auto& c : list) {
+          const auto key = hash(c.value)[0];
+          candidates_.emplace(key, std::move(c));
+        }
+      }
+
+      floor_ = 0;
+    }
+
+    inline virtual NativeType finalize() override {
+      auto list = ranked();
+      if (list.size() > k_) {
+        list.resize(k_);
+      }
+
+      rapidjson::StringBuffer buffer;
+      rapidjson::Writer<rapidjson::StringBuffer> json(buffer);
+      json.StartArray();
+      for (const auto& c : list) {
+        json.StartObject();
+        json.Key("value");
+        if constexpr (STR) {
+          json.String(c.value.data(), c.value.size());
+        } else if constexpr (std::is_same_v<ValueType, bool>) {
+          json.Bool(c.value);
+        } else if constexpr (std::is_floating_point_v<ValueType>) {
+          json.Double(c.value);
+        } else {
+          json.Int64(c.value);
+        }
+
+        json.Key("count");
+        json.Uint64(c.count);
+        json.EndObject();
+      }
+      json.EndArray();
+
+      json_ = buffer.GetString();
+      return json_;
+    }
+
+    // serialize into a buffer: [total, sketch table, candidates size, (count, value)...]
+    inline virtual size_t serialize(nebula::common::ExtendableSlice& slice, size_t offset) override {
+      const auto origin = offset;
+      offset += slice.write(offset, sketch_->count());
+      const auto table = sketch_->data();
+      offset += slice.write(offset, table.data(), table.size());
+
+      offset += slice.write(offset, candidates_.size());
+      for (const auto& item : candidates_) {
+        const auto& c = item.second;
+        offset += slice.write(offset, c.count);
+        if constexpr (STR) {
+          offset += slice.write(offset, c.value.size());
+          offset += slice.write(offset, c.value.data(), c.value.size());
+        } else {
+          offset += slice.write(offset, c.value);
+        }
+      }
+
+      return offset - origin;
+    }
+
+    // deserialize from a given buffer, and bin size
+    inline virtual size_t load(nebula::common::ExtendableSlice& slice, size_t offset) override {
+      const auto origin = offset;
+      auto total = slice.read<size_t>(offset);
+      offset += sizeof(total);
+      auto table = slice.read(offset, sketch_->size());
+      offset += table.size();
+      sketch_->set(table, total);
+
+      auto size = slice.read<size_t>(offset);
+      offset += sizeof(size);
+      candidates_.clear();
+      for (size_t i = 0; i < size; ++i) {
+        auto count = slice.read<size_t>(offset);
+        offset += sizeof(count);
+        if constexpr (STR) {
+          auto length = slice.read<size_t>(offset);
+          offset += sizeof(length);
+          std::string value(slice.read(offset, length));
+          offset += length;
+          const auto key = hash(value)[0];
+          candidates_.emplace(key, Candidate{ std::move(value), count });
+        } else {
+          auto value = slice.read<ValueType>(offset);
+          offset += sizeof(value);
+          candidates_.emplace(hash(value)[0], Candidate{ value, count });
+        }
+      }
+
+      floor_ = 0;
+      return offset - origin;
+    }
+
+    inline virtual bool fit(size_t) override {
+      return false;
+    }
+
+  private:
+    template <typename T>
+    static inline std::array<size_t, HASHES> hash(const T& v) {
+      if constexpr (STR) {
+        return CMS::hashes(v.data(), v.size());
+      } else {
+        return CMS::hashes(&v, sizeof(T));
+      }
+    }
+
+    // take a value into candidates if there is room or it counts more than the smallest candidate
+    void offer(size_t key, const InputType& v, size_t count) {
+      if (candidates_.size() < capacity_) {
+        candidates_.emplace(key, Candidate{ ValueType(v), count });
+        floor_ = std::min(floor_, count);
+        return;
+      }
+
+      // floor is a lower bound of the smallest candidate count since counts only grow
+      if (count <= floor_) {
+        return;
+      }
+
+      auto min = candidates_.begin();
+      for (auto it = candidates_.begin(); it != candidates_.end(); ++it) {
+        if (it->second.count < min->second.count) {
+          min = it;
+        }
+      }
+
+      floor_ = min->second.count;
+      if (count <= floor_) {
+        return;
+      }
+
+      candidates_.erase(min);
+      candidates_.emplace(key, Candidate{ ValueType(v), count });
+    }
+
+    // all candidates in descending order of count, ties are ordered by value
+    std::vector<Candidate> ranked() const {
+      std::vector<Candidate> list;
+      list.reserve(candidates_.size());
+      for (const auto& item : candidates_) {
+        list.push_back(item.second);
+      }
+
+      std::sort(list.begin(), list.end(), [](const Candidate& left, const Candidate& right) {
+        return left.count > right.count || (left.count == right.count && left.value < right.value);
+      });
+
+      return list;
+    }
+
+  private:
+    size_t k_;
+    size_t capacity_;
+    std::unique_ptr<CMS> sketch_;
+    nebula::common::unordered_map<size_t, Candidate> candidates_;
+
+    // lower bound of the smallest candidate count
+    size_t floor_;
+    std::string json_;
+  };
+
+public:
+  TopK(const std::string& name, std::unique_ptr<nebula::surface::eval::ValueEval> expr, size_t k = 10)
+    : BaseType(name,
+               std::move(expr),
+               [k]() -> std::shared_ptr<Aggregator> {
+                 return nebula::common::Arena::make<Aggregator>(k);
+               }) {
+    N_ENSURE_GT(k, 0, "top k requires k > 0");
+  }
+
+  virtual ~TopK() = default;
+};
+
+} // namespace udf
+} // namespace api
+} // namespace nebula
@@ -80,7 +80,8 @@ public:
     inline virtual size_t serialize(nebula::common::ExtendableSlice& slice, size_t offset) override {
       // LZ4 Compression can reduce the data size massively.
       // Latency reduction at about 13%
-      auto json = stack_->jsonfy();
+      // frames below the threshold are pruned before transfer
+      auto json = stack_->jsonfy(threshold_);
       auto bin = slice.write(offset, json.size());
       auto size = slice.write(offset + bin, json.data(), json.size());
       return bin + size;
@@ -149,7 +150,7 @@ public:
     : BaseType(name,
                std::move(expr),
                [threshold]() -> std::shared_ptr<Aggregator> {
-                 return std::make_shared<Aggregator>(threshold);
+                 return nebula::common::Arena::make<Aggregator>(threshold);
                }) {}
 
   virtual ~Tpm() = default;
@@ -19,15 +19,18 @@
 #include "Avg.h"
 #include "Between.h"
 #include "Cardinality.h"
+#include "Contains.h"
 #include "Count.h"
 #include "In.h"
 #include "Like.h"
+#include "Lookup.h"
 #include "Max.h"
 #include "Min.h"
 #include "Not.h"
 #include "Pct.h"
 #include "Prefix.h"
 #include "Sum.h"
+#include "TopK.h"
 #include "Tpm.h"
 #include "Histogram.h"
 #include "api/dsl/Base.h"
@@ -48,6 +51,37 @@ public:
   template <UDFKind UKIND, nebula::type::Kind IK, typename... Args>
   static std::unique_ptr<nebula::surface::eval::ValueEval>
     createUDF(std::shared_ptr<nebula::api::dsl::Expression> expr, Args&&... args) {
+    if constexpr (sizeof...(Args) == 0) {
+      return make<UKIND, IK>(expr);
+    } else {
+      // expressions of the same function on the same inner expression differ by parameters
+      std::string params;
+      ((params += fmt::format(",{0}", param(args))), ...);
+      auto udf = make<UKIND, IK>(expr, std::forward<Args>(args)...);
+      udf->qualify(params);
+      return udf;
+    }
+  }
+
+private:
+  // a parameter in signature, a shared object (eg. value set) is identified by its address
+  template <typename T>
+  static std::string param(const T& value) {
+    using V = std::remove_cv_t<std::remove_reference_t<T>>;
+    if constexpr (std::is_convertible_v<const V&, std::string_view>) {
+      return std::string(std::string_view(value));
+    } else if constexpr (std::is_same_v<V, int128_t>) {
+      return nebula::common::Int128_U::to_string(value);
+    } else if constexpr (std::is_arithmetic_v<V>) {
+      return fmt::format("{0}", value);
+    } else {
+      return fmt::format("{0}", static_cast<const void*>(value.get()));
+    }
+  }
+
+  template <UDFKind UKIND, nebula::type::Kind IK, typename... Args>
+  static std::unique_ptr<nebula::surface::eval::ValueEval>
+    make(std::shared_ptr<nebula::api::dsl::Expression> expr, Args&&... args) {
 
     constexpr auto name = nebula::surface::eval::UdfTraits<UKIND, IK>::Name;
 
@@ -107,6 +141,19 @@ public:
       return std::make_unique<Hist<IK>>(name, expr->asEval(), std::forward<Args>(args)...);
     }
 
+    if constexpr (UKIND == UDFKind::TOPK) {
+      return std::make_unique<TopK<IK>>(name, expr->asEval(), std::forward<Args>(args)...);
+    }
+
+    if constexpr (UKIND == UDFKind::LOOKUP) {
+      return std::make_unique<Lookup<IK>>(name, expr->asEval(), std::forward<Args>(args)...);
+    }
+
+    if constexpr (UKIND == UDFKind::CONTAINS) {
+      // the array column is the only column referenced
+      return std::make_unique<Contains<IK>>(name, expr->columnRefs().at(0), std::forward<Args>(args)...);
+    }
+
     throw NException(fmt::format("Unimplemented UDF {0}", name));
   }
 };
@@ -0,0 +1,67 @@
+# micro benchmarks of hot paths, run "NebulaBench --benchmark_filter=<regex>" to pick some
+add_executable(NebulaBench
+  ${NEBULA_SRC}/bench/BenchExec.cpp
+  ${NEBULA_SRC}/bench/BenchMemory.cpp
+  ${NEBULA_SRC}/bench/BenchService.cpp
+  ${NEBULA_SRC}/bench/BenchSketch.cpp
+  ${NEBULA_SRC}/bench/BenchStorage.cpp)
+
+target_link_libraries(NebulaBench
+  PRIVATE ${GLOG_LIBRARY}
+  PRIVATE ${NEBULA_SERVICE}
+  PRIVATE ${BENCHMARK_LIBRARY}
+  PRIVATE ${BENCHMARK_MAIN_LIBRARY}
+  PRIVATE libgrpc++
+  PRIVATE libgrpc
+  PRIVATE libgpr
+  PRIVATE libaddress_sorting
+  PRIVATE ${CARES_LIBRARY}
+  PRIVATE ${ZLIB_LIBRARY}
+  PRIVATE ${XXH_LIBRARY}
+  PRIVATE ${JSON_LIBRARY}
+  PRIVATE ${PROTOBUF_LIBRARY}
+  PRIVATE ${FLATBUFFERS_LIBRARY}
+  PRIVATE ${AWS_LIBRARY})
+target_compile_options(NebulaBench PRIVATE -Wno-error=unused-parameter)
+if(APPLE)
+    target_compile_options(NebulaBench PRIVATE -Wno-error=unknown-warning-option)
+endif()
+
+# end to end benchmark of TPC-H lineitem on an in-process node, see bench/readme.md
+add_executable(TpchBench ${NEBULA_SRC}/bench/Tpch.cpp)
+
+target_link_libraries(TpchBench
+  PRIVATE ${GLOG_LIBRARY}
+  PRIVATE ${NEBULA_SERVICE}
+  PRIVATE libgrpc++
+  PRIVATE libgrpc
+  PRIVATE libgpr
+  PRIVATE libaddress_sorting
+  PRIVATE ${CARES_LIBRARY}
+  PRIVATE ${ZLIB_LIBRARY}
+  PRIVATE ${XXH_LIBRARY}
+  PRIVATE ${JSON_LIBRARY}
+  PRIVATE ${PROTOBUF_LIBRARY}
+  PRIVATE ${FLATBUFFERS_LIBRARY}
+  PRIVATE ${AWS_LIBRARY})
+target_compile_options(TpchBench PRIVATE -Wno-error=unused-parameter)
+
+# concurrent query stress of the whole stack, it starts NebulaServer and NodeServer built in the same folder
+add_executable(StressBench ${NEBULA_SRC}/bench/Stress.cpp)
+add_dependencies(StressBench NebulaServer NodeServer)
+
+target_link_libraries(StressBench
+  PRIVATE ${GLOG_LIBRARY}
+  PRIVATE ${NEBULA_SERVICE}
+  PRIVATE libgrpc++
+  PRIVATE libgrpc
+  PRIVATE libgpr
+  PRIVATE libaddress_sorting
+  PRIVATE ${CARES_LIBRARY}
+  PRIVATE ${ZLIB_LIBRARY}
+  PRIVATE ${XXH_LIBRARY}
+  PRIVATE ${JSON_LIBRARY}
+  PRIVATE ${PROTOBUF_LIBRARY}
+  PRIVATE ${FLATBUFFERS_LIBRARY}
+  PRIVATE ${AWS_LIBRARY})
+target_compile_options(StressBench PRIVATE -Wno-error=unused-parameter)
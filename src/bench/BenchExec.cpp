@@ -0,0 +1,146 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+
+#include "api/udf/Sum.h"
+#include "execution/ExecutionPlan.h"
+#include "execution/core/AggregationMerge.h"
+#include "execution/core/BlockExecutor.h"
+#include "memory/Batch.h"
+#include "memory/keyed/HashFlat.h"
+#include "meta/TestTable.h"
+#include "surface/MockSurface.h"
+#include "surface/StaticData.h"
+#include "surface/eval/ValueEval.h"
+#include "type/Serde.h"
+
+/**
+ * Benchmarks of block execution: block compute, hash flat update and aggregation merge.
+ */
+namespace nebula {
+namespace bench {
+
+using nebula::execution::BlockPhase;
+using nebula::memory::Batch;
+using nebula::memory::EvaledBlock;
+using nebula::meta::TestTable;
+using nebula::surface::eval::BlockEval;
+using nebula::surface::eval::column;
+using nebula::surface::eval::constant;
+using nebula::type::TypeSerializer;
+
+// a batch of the test table filled by mock rows
+static std::shared_ptr<Batch> mockBatch(const TestTable& table, size_t rows) {
+  auto batch = std::make_shared<Batch>(table, rows);
+  nebula::surface::MockRowData row;
+  for (size_t i = 0; i < rows; ++i) {
+    batch->add(row);
+  }
+
+  return batch;
+}
+
+// select event, sum(id) from test group by event
+static std::unique_ptr<BlockPhase> groupBy(const TestTable& table) {
+  auto plan = std::make_unique<BlockPhase>(table.schema(), TypeSerializer::from("ROW<key:string, agg:bigint>"));
+  nebula::surface::eval::Fields selects;
+  selects.reserve(2);
+  selects.push_back(column<std::string_view>("event"));
+  selects.push_back(std::make_unique<nebula::api::udf::Sum<nebula::type::Kind::INTEGER>>("agg", column<int32_t>("id")));
+  plan->scan(table.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .keys({ 0 })
+    .aggregate(1, { false, true });
+  return plan;
+}
+
+// aggregate a block of given rows
+static void BM_BlockCompute(benchmark::State& state) {
+  TestTable table;
+  const size_t rows = state.range(0);
+  EvaledBlock block{ mockBatch(table, rows), BlockEval::PARTIAL };
+  auto plan = groupBy(table);
+  for (auto _ : state) {
+    auto cursor = nebula::execution::core::compute(block, *plan);
+    benchmark::DoNotOptimize(cursor->size());
+  }
+
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_BlockCompute)->RangeMultiplier(4)->Range(1 << 10, 1 << 18);
+
+// update rows of given number of distinct keys into a hash flat
+static void BM_HashFlatUpdate(benchmark::State& state) {
+  constexpr size_t rows = 1 << 16;
+  const size_t keys = state.range(0);
+  auto schema = TypeSerializer::from("ROW<id:int, event:string>");
+  nebula::surface::eval::Fields fields;
+  fields.reserve(2);
+  fields.emplace_back(constant(1));
+  fields.emplace_back(constant("2"));
+
+  std::vector<std::string> events;
+  events.reserve(keys);
+  for (size_t i = 0; i < keys; ++i) {
+    events.push_back(std::to_string(i));
+  }
+
+  for (auto _ : state) {
+    nebula::memory::keyed::HashFlat hf(schema, fields);
+    for (size_t i = 0; i < rows; ++i) {
+      const auto key = i % keys;
+      nebula::surface::StaticRow row{ 0, static_cast<int>(key), events[key], nullptr, false, 'a', 1, 1.0 };
+      hf.update(row);
+    }
+
+    benchmark::DoNotOptimize(hf.getRows());
+  }
+
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_HashFlatUpdate)->RangeMultiplier(16)->Range(16, 1 << 16);
+
+// merge aggregated results of given number of blocks
+static void BM_AggregationMerge(benchmark::State& state) {
+  TestTable table;
+  const size_t blocks = state.range(0);
+  EvaledBlock block{ mockBatch(table, 1 << 14), BlockEval::PARTIAL };
+  auto plan = groupBy(table);
+  folly::CPUThreadPoolExecutor pool{ 4 };
+
+  for (auto _ : state) {
+    // block results are consumed by merge, so they're computed again out of timing
+    state.PauseTiming();
+    std::vector<folly::Try<nebula::surface::RowCursorPtr>> sources;
+    sources.reserve(blocks);
+    for (size_t i = 0; i < blocks; ++i) {
+      sources.emplace_back(nebula::execution::core::compute(block, *plan));
+    }
+    state.ResumeTiming();
+
+    auto merged = nebula::execution::core::merge(pool, plan->outputSchema(), plan->fields(), true, sources);
+    benchmark::DoNotOptimize(merged->size());
+  }
+
+  state.SetItemsProcessed(state.iterations() * blocks);
+}
+BENCHMARK(BM_AggregationMerge)->RangeMultiplier(4)->Range(4, 256);
+
+} // namespace bench
+} // namespace nebula
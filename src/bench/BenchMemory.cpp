@@ -0,0 +1,79 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include "common/Memory.h"
+#include "memory/encode/DictEncoder.h"
+#include "memory/encode/RleEncoder.h"
+
+/**
+ * Benchmarks of column encoders.
+ */
+namespace nebula {
+namespace bench {
+
+// encode strings of given number of distinct values by a dictionary
+static void BM_DictEncoder(benchmark::State& state) {
+  constexpr size_t items = 1 << 16;
+  const size_t distinct = state.range(0);
+  std::vector<std::string> values;
+  values.reserve(items);
+  for (size_t i = 0; i < items; ++i) {
+    values.push_back(fmt::format("value-{0}", (i * 7919) % distinct));
+  }
+
+  for (auto _ : state) {
+    nebula::memory::encode::DictEncoder dict;
+    for (const auto& v : values) {
+      benchmark::DoNotOptimize(dict.set(v));
+    }
+
+    benchmark::DoNotOptimize(dict.seal());
+  }
+
+  state.SetItemsProcessed(state.iterations() * items);
+}
+BENCHMARK(BM_DictEncoder)->RangeMultiplier(8)->Range(8, 1 << 15);
+
+// encode integers of runs of given length
+static void BM_RleEncoder(benchmark::State& state) {
+  constexpr size_t items = 1 << 16;
+  const size_t run = state.range(0);
+  std::vector<int64_t> values;
+  values.reserve(items);
+  for (size_t i = 0; i < items; ++i) {
+    values.push_back((i / run) * 31);
+  }
+
+  for (auto _ : state) {
+    nebula::common::ExtendableSlice slice(4096);
+    nebula::memory::encode::RleEncoder encoder(true, slice);
+    for (auto v : values) {
+      encoder.write(v);
+    }
+
+    encoder.flush();
+    benchmark::DoNotOptimize(slice.size());
+  }
+
+  state.SetItemsProcessed(state.iterations() * items);
+}
+BENCHMARK(BM_RleEncoder)->RangeMultiplier(8)->Range(1, 512);
+
+} // namespace bench
+} // namespace nebula
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "api/dsl/Dsl.h"
+#include "execution/meta/TableService.h"
+#include "memory/keyed/FlatBuffer.h"
+#include "meta/TestTable.h"
+#include "service/base/NebulaService.h"
+#include "surface/StaticData.h"
+
+/**
+ * Benchmarks of result batches serialized between nodes and server.
+ */
+namespace nebula {
+namespace bench {
+
+using nebula::service::Codec;
+using nebula::service::base::BatchSerde;
+
+// serialize and deserialize a result of given rows by codec of given index
+static void BM_BatchSerde(benchmark::State& state) {
+  using namespace nebula::api::dsl;
+  static const std::array<Codec, 3> codecs{ Codec::Codec_None, Codec::Codec_Lz4, Codec::Codec_Zstd };
+  const size_t rows = state.range(0);
+  const auto codec = codecs.at(state.range(1));
+
+  nebula::meta::TestTable testTable;
+  auto plan = table(testTable.name(), nebula::execution::meta::TableService::singleton())
+                .select(col("id"), col("event"))
+                .limit(10)
+                .compile(nebula::execution::QueryContext::def());
+
+  nebula::memory::keyed::FlatBuffer fb(testTable.schema(), testTable.testFields());
+  for (size_t i = 0; i < rows; ++i) {
+    nebula::surface::StaticRow row(1, i, "nebula", nullptr, i % 2 == 0, 3, 0, 1.5);
+    fb.add(row);
+  }
+
+  for (auto _ : state) {
+    auto batch = BatchSerde::serialize(fb, plan, true, codec);
+    nebula::execution::QueryStats stats;
+    auto cursor = BatchSerde::deserialize(&batch, testTable.testFields(), stats);
+    benchmark::DoNotOptimize(cursor->size());
+  }
+
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_BatchSerde)->ArgsProduct({ benchmark::CreateRange(1 << 10, 1 << 16, 8), { 0, 1, 2 } });
+
+} // namespace bench
+} // namespace nebula
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "api/dsl/Expressions.h"
+#include "api/udf/Pct.h"
+#include "common/HyperLogLog.h"
+
+/**
+ * Benchmarks of sketches: cardinality by hyper log log and percentile by t-digest.
+ */
+namespace nebula {
+namespace bench {
+
+// add given number of values into a hyper log log
+static void BM_HyperLogLog(benchmark::State& state) {
+  const size_t items = state.range(0);
+  for (auto _ : state) {
+    nebula::common::HyperLogLog hll;
+    for (size_t i = 0; i < items; ++i) {
+      hll.add(static_cast<int64_t>(i * 2654435761ULL));
+    }
+
+    benchmark::DoNotOptimize(hll.estimate());
+  }
+
+  state.SetItemsProcessed(state.iterations() * items);
+}
+BENCHMARK(BM_HyperLogLog)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+// merge given number of values into a percentile sketch and finalize it
+static void BM_Pct(benchmark::State& state) {
+  const size_t items = state.range(0);
+  auto v = std::make_shared<nebula::api::dsl::ConstExpression<int32_t>>(0);
+  nebula::api::udf::Pct<nebula::type::Kind::INTEGER> pct("p99", v->asEval(), 99.0);
+  for (auto _ : state) {
+    auto sketch = pct.sketch();
+    for (size_t i = 0; i < items; ++i) {
+      sketch->merge(static_cast<int32_t>((i * 7919) % 100000));
+    }
+
+    benchmark::DoNotOptimize(sketch->finalize());
+  }
+
+  state.SetItemsProcessed(state.iterations() * items);
+}
+BENCHMARK(BM_Pct)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+} // namespace bench
+} // namespace nebula
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <arrow/io/file.h>
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <parquet/api/writer.h>
+
+#include "storage/CsvReader.h"
+#include "storage/JsonReader.h"
+#include "storage/ParquetReader.h"
+#include "type/Serde.h"
+
+/**
+ * Benchmarks of file readers, each file of given rows is generated once into temp directory.
+ * Every row has the same columns (id:int, event:string, weight:double) in all formats.
+ */
+namespace nebula {
+namespace bench {
+
+static constexpr auto SCHEMA = "ROW<id:int, event:string, weight:double>";
+
+static std::string tempFile(const std::string& ext, size_t rows) {
+  return (std::filesystem::temp_directory_path() / fmt::format("nebula_bench_{0}.{1}", rows, ext)).string();
+}
+
+static std::string csvFile(size_t rows) {
+  auto file = tempFile("csv", rows);
+  if (!std::filesystem::exists(file)) {
+    std::ofstream out(file);
+    out << "id,event,weight\n";
+    for (size_t i = 0; i < rows; ++i) {
+      out << i << ",event-" << (i % 100) << "," << (i * 0.5) << "\n";
+    }
+  }
+
+  return file;
+}
+
+static std::string jsonFile(size_t rows) {
+  auto file = tempFile("json", rows);
+  if (!std::filesystem::exists(file)) {
+    std::ofstream out(file);
+    for (size_t i = 0; i < rows; ++i) {
+      out << fmt::format("{{\"id\": {0}, \"event\": \"event-{1}\", \"weight\": {2}}}\n", i, i % 100, i * 0.5);
+    }
+  }
+
+  return file;
+}
+
+static std::string parquetFile(size_t rows) {
+  using parquet::Repetition;
+  using parquet::Type;
+  using parquet::schema::GroupNode;
+  using parquet::schema::PrimitiveNode;
+
+  auto file = tempFile("parquet", rows);
+  if (std::filesystem::exists(file)) {
+    return file;
+  }
+
+  auto result = ::arrow::io::FileOutputStream::Open(file);
+  PARQUET_THROW_NOT_OK(result.status());
+  auto out = result.ValueOrDie();
+
+  parquet::schema::NodeVector fields;
+  fields.push_back(PrimitiveNode::Make("id", Repetition::REQUIRED, Type::INT32, parquet::ConvertedType::NONE));
+  fields.push_back(PrimitiveNode::Make("event", Repetition::REQUIRED, Type::BYTE_ARRAY, parquet::ConvertedType::UTF8));
+  fields.push_back(PrimitiveNode::Make("weight", Repetition::REQUIRED, Type::DOUBLE, parquet::ConvertedType::NONE));
+  auto schema = std::static_pointer_cast<GroupNode>(GroupNode::Make("schema", Repetition::REQUIRED, fields));
+
+  parquet::WriterProperties::Builder builder;
+  builder.compression(parquet::Compression::SNAPPY);
+  auto writer = parquet::ParquetFileWriter::Open(out, schema, builder.build());
+
+  // row groups of 64K rows
+  constexpr size_t GROUP = 1 << 16;
+  for (size_t start = 0; start < rows; start += GROUP) {
+    auto rg = writer->AppendRowGroup();
+    const auto end = std::min(rows, start + GROUP);
+
+    auto ids = static_cast<parquet::Int32Writer*>(rg->NextColumn());
+    for (size_t i = start; i < end; ++i) {
+      int32_t id = i;
+      ids->WriteBatch(1, nullptr, nullptr, &id);
+    }
+
+    auto events = static_cast<parquet::ByteArrayWriter*>(rg->NextColumn());
+    for (size_t i = start; i < end; ++i) {
+      const auto event = fmt::format("event-{0}", i % 100);
+      parquet::ByteArray value(event.size(), reinterpret_cast<const uint8_t*>(event.data()));
+      events->WriteBatch(1, nullptr, nullptr, &value);
+    }
+
+    auto weights = static_cast<parquet::DoubleWriter*>(rg->NextColumn());
+    for (size_t i = start; i < end; ++i) {
+      double weight = i * 0.5;
+      weights->WriteBatch(1, nullptr, nullptr, &weight);
+    }
+
+    rg->Close();
+  }
+
+  writer->Close();
+  PARQUET_THROW_NOT_OK(out->Close());
+  return file;
+}
+
+// read every column of every row of a cursor
+static void scan(nebula::surface::RowCursor& reader) {
+  while (reader.hasNext()) {
+    const auto& row = reader.next();
+    benchmark::DoNotOptimize(row.readInt("id"));
+    benchmark::DoNotOptimize(row.readString("event"));
+    benchmark::DoNotOptimize(row.readDouble("weight"));
+  }
+}
+
+static void BM_CsvReader(benchmark::State& state) {
+  const size_t rows = state.range(0);
+  const auto file = csvFile(rows);
+  nebula::meta::CsvProps csv{ true, false, "," };
+  for (auto _ : state) {
+    nebula::storage::CsvReader reader(file, csv, {});
+    scan(reader);
+  }
+
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_CsvReader)->RangeMultiplier(8)->Range(1 << 12, 1 << 18);
+
+static void BM_JsonReader(benchmark::State& state) {
+  const size_t rows = state.range(0);
+  const auto file = jsonFile(rows);
+  auto schema = nebula::type::TypeSerializer::from(SCHEMA);
+  for (auto _ : state) {
+    nebula::storage::LineJsonReader reader(file, {}, schema);
+    scan(reader);
+  }
+
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_JsonReader)->RangeMultiplier(8)->Range(1 << 12, 1 << 18);
+
+static void BM_ParquetReader(benchmark::State& state) {
+  const size_t rows = state.range(0);
+  const auto file = parquetFile(rows);
+  auto schema = nebula::type::TypeSerializer::from(SCHEMA);
+  for (auto _ : state) {
+    nebula::storage::ParquetReader reader(file, schema);
+    scan(reader);
+  }
+
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_ParquetReader)->RangeMultiplier(8)->Range(1 << 12, 1 << 18);
+
+} // namespace bench
+} // namespace nebula
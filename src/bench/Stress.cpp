@@ -0,0 +1,609 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/format.h>
+#include <folly/init/Init.h>
+#include <fstream>
+#include <functional>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <mutex>
+#include <random>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <signal.h>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "common/Errors.h"
+#include "common/Evidence.h"
+#include "service/base/NebulaService.h"
+#include "service/client/NebulaClient.h"
+
+/**
+ * Concurrent QPS stress test of the whole stack: a nebula server and N nodes are started as child processes
+ * from the binaries built along this one, the nodes load generated csv files through the regular spec path,
+ * then concurrent clients issue a weighted mix of queries back to back through the server's gRPC endpoint.
+ * Servers are separate processes rather than threads of this one, since each of them owns process wide
+ * singletons (block manager, table service, cluster info), the same as they run in a cluster.
+ * Every interval reports throughput, latency percentiles, cpu time per query and resident memory of the
+ * server and nodes, so that regressions of thread pools, locks and connections under load show up.
+ */
+DEFINE_uint32(STRESS_NODES, 2, "number of node servers to start");
+DEFINE_int32(STRESS_NODE_PORT, 9300, "port of the first node, nodes listen on consecutive ports");
+DEFINE_uint32(STRESS_FILES, 4, "data files generated per node, every file is loaded as a spec");
+DEFINE_uint64(STRESS_ROWS, 250000, "rows of every generated data file");
+DEFINE_uint32(STRESS_CLIENTS, 32, "concurrent clients issuing queries back to back");
+DEFINE_uint32(STRESS_CHANNELS, 4, "gRPC channels (connections) to server shared by clients round robin");
+DEFINE_string(STRESS_MIX, "groupby:4,filter:3,samples:1,percentile:1,distinct:1", "weighted query mix");
+DEFINE_uint32(STRESS_WARMUP, 5, "seconds to run queries before measuring");
+DEFINE_uint32(STRESS_SECONDS, 60, "seconds to measure queries");
+DEFINE_uint32(STRESS_INTERVAL, 5, "interval in seconds to report throughput, latency, cpu and memory");
+DEFINE_uint32(STRESS_LOAD_TIMEOUT, 600, "max seconds to wait for nodes to load all generated data");
+DEFINE_bool(STRESS_CACHE, false, "let server cache and coalesce identical queries, every query executes if false");
+DEFINE_string(STRESS_BIN, "", "directory of NebulaServer and NodeServer, the directory of this binary if empty");
+DEFINE_string(STRESS_OUT, "", "file to write results in JSON for comparison between runs");
+
+namespace nebula {
+namespace bench {
+
+using nebula::common::Evidence;
+using nebula::service::QueryRequest;
+using nebula::service::QueryResponse;
+using nebula::service::client::NebulaClient;
+
+static constexpr auto TABLE = "nebula.stress";
+static constexpr auto SCHEMA = "ROW<id:bigint, tag:string, event:string, value:int, weight:double>";
+static constexpr size_t TIME = 1600000000;
+static constexpr size_t TAGS = 16;
+static constexpr size_t EVENTS = 1000;
+
+// write csv files of given rows each into a directory, the same seed always generates the same files
+static std::string generate(size_t files, size_t rows) {
+  const auto dir = std::filesystem::temp_directory_path() / fmt::format("nebula_stress_{0}x{1}", files, rows);
+  const auto data = dir / "data";
+  if (std::filesystem::exists(data)) {
+    return dir.string();
+  }
+
+  const auto temp = dir / "tmp";
+  std::filesystem::create_directories(temp);
+  std::mt19937_64 rand{ 42 };
+  for (size_t f = 0; f < files; ++f) {
+    std::ofstream out{ temp / fmt::format("part-{0}.csv", f) };
+    for (size_t i = 0; i < rows; ++i) {
+      // events are skewed so that group by and top N see a long tail
+      const auto event = (rand() % EVENTS) * (rand() % EVENTS) / EVENTS;
+      out << fmt::format("{0},tag{1},event{2},{3},{4:.3f}\n",
+                         f * rows + i, rand() % TAGS, event, rand() % 1000, (rand() % 1'000'000) / 1000.0);
+    }
+  }
+
+  // files appear at once so an interrupted run doesn't leave partial data behind
+  std::filesystem::rename(temp, data);
+  return dir.string();
+}
+
+// cluster config of the server listing all nodes and the table loading every file of the data directory
+static std::string configure(const std::string& dir, size_t nodes) {
+  std::string list;
+  for (size_t i = 0; i < nodes; ++i) {
+    list += fmt::format("  - node:\n      host: localhost\n      port: {0}\n", FLAGS_STRESS_NODE_PORT + i);
+  }
+
+  const auto file = fmt::format("{0}/cluster_{1}.yml", dir, nodes);
+  std::ofstream out{ file };
+  out << fmt::format(R"(version: 1.0
+server:
+  anode: false
+  auth: false
+  meta:
+    db: none
+  discovery:
+    method: config
+nodes:
+{0}
+tables:
+  {1}:
+    retention:
+      max-mb: 100000
+      max-hr: 0
+    schema: "{2}"
+    data: local
+    loader: Swap
+    source: {3}/data/
+    backup: ""
+    format: csv
+    csv:
+      hasHeader: false
+      delimiter: ","
+    columns:
+      tag:
+        dict: true
+    time:
+      type: static
+      value: {4}
+)",
+                     list, TABLE, SCHEMA, dir, TIME);
+  return file;
+}
+
+// a child process of a server binary, its output goes to a log file, it is killed when destructed
+class Process {
+public:
+  Process(const std::string& binary, const std::vector<std::string>& args, const std::string& log)
+    : pid_{ fork() } {
+    N_ENSURE_NE(pid_, -1, "failed to fork");
+    if (pid_ == 0) {
+      const auto fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      dup2(fd, STDOUT_FILENO);
+      dup2(fd, STDERR_FILENO);
+      std::vector<char*> argv{ const_cast<char*>(binary.c_str()) };
+      for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+      }
+      argv.push_back(nullptr);
+      execv(binary.c_str(), argv.data());
+      _exit(127);
+    }
+  }
+
+  virtual ~Process() {
+    kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+  }
+
+  inline bool alive() const {
+    return waitpid(pid_, nullptr, WNOHANG) == 0;
+  }
+
+  // user and system cpu time in ms
+  size_t cpuMs() const {
+    std::ifstream in{ fmt::format("/proc/{0}/stat", pid_) };
+    std::string stat{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+
+    // fields after the command name in parentheses, utime and stime are the 14th and 15th fields
+    std::istringstream fields{ stat.substr(stat.rfind(')') + 2) };
+    std::string field;
+    size_t ticks = 0;
+    for (size_t i = 3; i <= 15 && fields >> field; ++i) {
+      if (i >= 14) {
+        ticks += std::stoul(field);
+      }
+    }
+
+    return ticks * 1000 / sysconf(_SC_CLK_TCK);
+  }
+
+  // resident memory in bytes
+  size_t rss() const {
+    std::ifstream in{ fmt::format("/proc/{0}/statm", pid_) };
+    size_t pages = 0;
+    size_t resident = 0;
+    in >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+  }
+
+private:
+  const pid_t pid_;
+};
+
+// queries of the mix, parameters are drawn per query so that neither plans nor results repeat exactly
+using Build = std::function<QueryRequest(std::mt19937_64&)>;
+static std::vector<std::pair<std::string, Build>> suite() {
+  using namespace nebula::service;
+  auto base = []() {
+    QueryRequest q;
+    q.set_table(TABLE);
+    q.set_start(TIME - 1);
+    q.set_end(TIME + 1);
+    return q;
+  };
+  auto metric = [](QueryRequest& q, const std::string& column, Rollup method) {
+    auto m = q.add_metric();
+    m->set_column(column);
+    m->set_method(method);
+  };
+  auto order = [](QueryRequest& q, const std::string& column, OrderType type) {
+    q.mutable_order()->set_column(column);
+    q.mutable_order()->set_type(type);
+  };
+
+  return {
+    { "groupby", [=](std::mt19937_64& rand) {
+       auto q = base();
+       q.add_dimension("event");
+       metric(q, "value", Rollup::SUM);
+       metric(q, "weight", Rollup::AVG);
+       order(q, "value", OrderType::DESC);
+       q.set_top(10 + rand() % 40);
+       return q;
+     } },
+    { "filter", [=](std::mt19937_64& rand) {
+       auto q = base();
+       auto p = q.mutable_filtera()->add_expression();
+       p->set_column("value");
+       p->set_op(Operation::LESS);
+       p->add_value(std::to_string(rand() % 1000));
+       auto t = q.mutable_filtera()->add_expression();
+       t->set_column("tag");
+       t->set_op(Operation::EQ);
+       t->add_value(fmt::format("tag{0}", rand() % TAGS));
+       q.add_dimension("event");
+       metric(q, "id", Rollup::COUNT);
+       q.set_top(100);
+       return q;
+     } },
+    { "samples", [=](std::mt19937_64& rand) {
+       auto q = base();
+       auto p = q.mutable_filtera()->add_expression();
+       p->set_column("value");
+       p->set_op(Operation::MORE);
+       p->add_value(std::to_string(rand() % 1000));
+       q.add_dimension("id");
+       q.add_dimension("event");
+       q.add_dimension("weight");
+       q.set_top(100);
+       return q;
+     } },
+    { "percentile", [=](std::mt19937_64& rand) {
+       auto q = base();
+       q.add_dimension("tag");
+       metric(q, "weight", Rollup::P50);
+       metric(q, "weight", Rollup::P99);
+       q.set_relativepct(rand() % 2 == 0);
+       return q;
+     } },
+    { "distinct", [=](std::mt19937_64& rand) {
+       auto q = base();
+       auto p = q.mutable_filtera()->add_expression();
+       p->set_column("event");
+       p->set_op(Operation::LIKE);
+       p->add_value(fmt::format("event{0}%", rand() % 10));
+       q.add_dimension("tag");
+       metric(q, "id", Rollup::CARD_EST);
+       return q;
+     } }
+  };
+}
+
+// parse the mix of "name:weight,..." into query index by weight
+static std::vector<size_t> mix(const std::vector<std::pair<std::string, Build>>& queries) {
+  std::vector<size_t> draws;
+  std::stringstream items{ FLAGS_STRESS_MIX };
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    const auto colon = item.find(':');
+    const auto name = item.substr(0, colon);
+    const size_t weight = colon == std::string::npos ? 1 : std::stoul(item.substr(colon + 1));
+    auto found = std::find_if(queries.begin(), queries.end(), [&name](const auto& q) { return q.first == name; });
+    N_ENSURE(found != queries.end(), fmt::format("unknown query in mix: {0}", name));
+    draws.insert(draws.end(), weight, std::distance(queries.begin(), found));
+  }
+
+  N_ENSURE(!draws.empty(), "no query in mix");
+  return draws;
+}
+
+// latencies in microseconds of every query by type, collected by all clients
+class Recorder {
+public:
+  explicit Recorder(size_t types) : latencies_(types), errors_{ 0 } {}
+  virtual ~Recorder() = default;
+
+  inline void add(size_t type, size_t us, bool ok) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!ok) {
+      ++errors_;
+      return;
+    }
+
+    latencies_[type].push_back(us);
+    interval_.push_back(us);
+  }
+
+  // latencies recorded since last call
+  std::vector<size_t> interval() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<size_t> list;
+    std::swap(list, interval_);
+    return list;
+  }
+
+  // all latencies recorded by type and number of errors
+  std::pair<std::vector<std::vector<size_t>>, size_t> all() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return { latencies_, errors_ };
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& list : latencies_) {
+      list.clear();
+    }
+    interval_.clear();
+    errors_ = 0;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<std::vector<size_t>> latencies_;
+  std::vector<size_t> interval_;
+  size_t errors_;
+};
+
+static size_t percentile(std::vector<size_t>& list, double p) {
+  if (list.empty()) {
+    return 0;
+  }
+
+  std::sort(list.begin(), list.end());
+  return list.at(std::min<size_t>(list.size() - 1, p * list.size()));
+}
+
+// one interval of the run: queries per second, latencies in ms, cpu ms per query and memory in MB
+struct Interval {
+  size_t second;
+  double qps;
+  double p50;
+  double p99;
+  double cpuPerQuery;
+  size_t serverMb;
+  size_t nodesMb;
+};
+
+static void report(const std::vector<std::pair<std::string, Build>>& queries,
+                   Recorder& recorder,
+                   const std::vector<Interval>& timeline,
+                   size_t cpuMs,
+                   double seconds) {
+  auto [latencies, errors] = recorder.all();
+  size_t total = 0;
+  for (const auto& list : latencies) {
+    total += list.size();
+  }
+
+  LOG(INFO) << fmt::format("Total: queries={0}, errors={1}, qps={2:.1f}, cpu ms per query={3:.2f}",
+                           total, errors, total / seconds, cpuMs * 1.0 / std::max<size_t>(1, total));
+  LOG(INFO) << fmt::format("{0:12} | {1:>8} | {2:>8} | {3:>8} | {4:>8} | {5:>8}",
+                           "query", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+  for (size_t i = 0; i < queries.size(); ++i) {
+    auto& list = latencies[i];
+    LOG(INFO) << fmt::format("{0:12} | {1:8} | {2:8.1f} | {3:8.1f} | {4:8.1f} | {5:8.1f}",
+                             queries[i].first, list.size(), percentile(list, 0.5) / 1000.0,
+                             percentile(list, 0.9) / 1000.0, percentile(list, 0.99) / 1000.0,
+                             percentile(list, 1) / 1000.0);
+  }
+
+  if (FLAGS_STRESS_OUT.empty()) {
+    return;
+  }
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> json(buffer);
+  json.StartObject();
+  json.Key("nodes");
+  json.Uint(FLAGS_STRESS_NODES);
+  json.Key("clients");
+  json.Uint(FLAGS_STRESS_CLIENTS);
+  json.Key("queries");
+  json.Uint64(total);
+  json.Key("errors");
+  json.Uint64(errors);
+  json.Key("qps");
+  json.Double(total / seconds);
+  json.Key("cpuPerQuery");
+  json.Double(cpuMs * 1.0 / std::max<size_t>(1, total));
+  json.Key("latency");
+  json.StartArray();
+  for (size_t i = 0; i < queries.size(); ++i) {
+    auto& list = latencies[i];
+    json.StartObject();
+    json.Key("name");
+    json.String(queries[i].first.data(), queries[i].first.size());
+    json.Key("count");
+    json.Uint64(list.size());
+    json.Key("p50");
+    json.Uint64(percentile(list, 0.5));
+    json.Key("p90");
+    json.Uint64(percentile(list, 0.9));
+    json.Key("p99");
+    json.Uint64(percentile(list, 0.99));
+    json.Key("max");
+    json.Uint64(percentile(list, 1));
+    json.EndObject();
+  }
+  json.EndArray();
+  json.Key("timeline");
+  json.StartArray();
+  for (const auto& t : timeline) {
+    json.StartObject();
+    json.Key("second");
+    json.Uint64(t.second);
+    json.Key("qps");
+    json.Double(t.qps);
+    json.Key("p50");
+    json.Double(t.p50);
+    json.Key("p99");
+    json.Double(t.p99);
+    json.Key("cpuPerQuery");
+    json.Double(t.cpuPerQuery);
+    json.Key("serverMb");
+    json.Uint64(t.serverMb);
+    json.Key("nodesMb");
+    json.Uint64(t.nodesMb);
+    json.EndObject();
+  }
+  json.EndArray();
+  json.EndObject();
+
+  std::ofstream out{ FLAGS_STRESS_OUT };
+  out << buffer.GetString();
+}
+
+static void run() {
+  N_ENSURE_GT(FLAGS_STRESS_NODES, 0, "requires at least one node");
+  N_ENSURE_GT(FLAGS_STRESS_CLIENTS, 0, "requires at least one client");
+  const auto queries = suite();
+  const auto draws = mix(queries);
+
+  const auto files = FLAGS_STRESS_NODES * FLAGS_STRESS_FILES;
+  const auto dir = generate(files, FLAGS_STRESS_ROWS);
+  const auto config = configure(dir, FLAGS_STRESS_NODES);
+  const auto bin = FLAGS_STRESS_BIN.empty()
+                     ? std::filesystem::read_symlink("/proc/self/exe").parent_path().string()
+                     : FLAGS_STRESS_BIN;
+
+  // nodes first so that server finds them on its first sync
+  std::vector<std::unique_ptr<Process>> nodes;
+  for (size_t i = 0; i < FLAGS_STRESS_NODES; ++i) {
+    nodes.push_back(std::make_unique<Process>(
+      bin + "/NodeServer",
+      std::vector<std::string>{ fmt::format("--NODE_PORT={0}", FLAGS_STRESS_NODE_PORT + i), "--METRICS_PORT=0" },
+      fmt::format("{0}/node_{1}.log", dir, i)));
+  }
+
+  std::vector<std::string> args{ fmt::format("--CLS_CONF={0}", config), "--METRICS_PORT=0" };
+  if (!FLAGS_STRESS_CACHE) {
+    args.push_back("--QUERY_CACHE_MB=0");
+    args.push_back("--QUERY_FLIGHTS=false");
+  }
+  Process server{ bin + "/NebulaServer", args, fmt::format("{0}/server.log", dir) };
+
+  // wait for all rows loaded by nodes
+  const auto address = fmt::format("localhost:{0}", nebula::service::base::ServiceProperties::PORT);
+  auto client = NebulaClient::make(address);
+  const size_t rows = files * FLAGS_STRESS_ROWS;
+  Evidence::Duration tick;
+  for (;;) {
+    N_ENSURE(server.alive(), fmt::format("server exited, see {0}/server.log", dir));
+    for (const auto& node : nodes) {
+      N_ENSURE(node->alive(), fmt::format("a node exited, see logs in {0}", dir));
+    }
+
+    auto state = client.state(TABLE);
+    if (state && (size_t)state->rowcount() >= rows) {
+      LOG(INFO) << fmt::format("Loaded {0} rows in {1} blocks by {2} nodes in {3} ms",
+                               state->rowcount(), state->blockcount(), nodes.size(), tick.elapsedMs());
+      break;
+    }
+
+    const size_t waited = tick.elapsedMs();
+    N_ENSURE_LT(waited, FLAGS_STRESS_LOAD_TIMEOUT * 1000, "timed out loading data");
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+
+  // clients share a few channels so that connections are contended as many users of one server
+  std::vector<NebulaClient> channels;
+  const auto size = std::max<size_t>(1, FLAGS_STRESS_CHANNELS);
+  channels.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    channels.push_back(NebulaClient(grpc::CreateCustomChannel(
+      address, grpc::InsecureChannelCredentials(), [i]() {
+        // a distinct channel argument keeps channels from sharing one connection
+        grpc::ChannelArguments arguments;
+        arguments.SetInt("nebula.stress.channel", i);
+        return arguments;
+      }())));
+  }
+
+  Recorder recorder{ queries.size() };
+  std::atomic<bool> stop{ false };
+  std::vector<std::thread> clients;
+  for (size_t i = 0; i < FLAGS_STRESS_CLIENTS; ++i) {
+    clients.emplace_back([&, i]() {
+      std::mt19937_64 rand{ i };
+      const auto& channel = channels.at(i % channels.size());
+      while (!stop) {
+        const auto type = draws[rand() % draws.size()];
+        const auto request = queries[type].second(rand);
+        QueryResponse response;
+        Evidence::Duration latency;
+        const auto status = channel.query(request, response);
+        recorder.add(type, latency.elapsedUs(), status.ok() && response.stats().error() == 0);
+      }
+    });
+  }
+
+  auto cpu = [&server, &nodes]() {
+    size_t ms = server.cpuMs();
+    for (const auto& node : nodes) {
+      ms += node->cpuMs();
+    }
+    return ms;
+  };
+
+  std::this_thread::sleep_for(std::chrono::seconds(FLAGS_STRESS_WARMUP));
+  recorder.clear();
+
+  // sample every interval until the end of the run
+  const auto interval = std::max<size_t>(1, FLAGS_STRESS_INTERVAL);
+  const auto startCpu = cpu();
+  std::vector<Interval> timeline;
+  Evidence::Duration run;
+  auto lastCpu = startCpu;
+  size_t lastMs = 0;
+  while (lastMs < FLAGS_STRESS_SECONDS * 1000) {
+    std::this_thread::sleep_for(std::chrono::seconds(interval));
+    auto latencies = recorder.interval();
+    const size_t ms = run.elapsedMs();
+    const auto cpuMs = cpu();
+    size_t nodesMb = 0;
+    for (const auto& node : nodes) {
+      nodesMb += node->rss() >> 20;
+    }
+
+    const auto count = std::max<size_t>(1, latencies.size());
+    Interval t{ ms / 1000,
+                latencies.size() * 1000.0 / std::max<size_t>(1, ms - lastMs),
+                percentile(latencies, 0.5) / 1000.0,
+                percentile(latencies, 0.99) / 1000.0,
+                (cpuMs - lastCpu) * 1.0 / count,
+                server.rss() >> 20,
+                nodesMb };
+    LOG(INFO) << fmt::format("[{0:4}s] qps={1:.1f}, p50={2:.1f}ms, p99={3:.1f}ms, cpu/query={4:.2f}ms, "
+                             "server={5}MB, nodes={6}MB",
+                             t.second, t.qps, t.p50, t.p99, t.cpuPerQuery, t.serverMb, t.nodesMb);
+    timeline.push_back(t);
+    lastCpu = cpuMs;
+    lastMs = ms;
+  }
+
+  const auto seconds = run.elapsedMs() / 1000.0;
+  stop = true;
+  for (auto& c : clients) {
+    c.join();
+  }
+
+  report(queries, recorder, timeline, lastCpu - startCpu, seconds);
+}
+
+} // namespace bench
+} // namespace nebula
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  FLAGS_logtostderr = 1;
+
+  nebula::bench::run();
+  return 0;
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <fmt/format.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/init/Init.h>
+#include <fstream>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <random>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <thread>
+
+#include "api/dsl/Dsl.h"
+#include "common/Errors.h"
+#include "common/Evidence.h"
+#include "execution/BlockManager.h"
+#include "execution/core/ServerExecutor.h"
+#include "execution/meta/TableService.h"
+#include "execution/serde/RowCursorSerde.h"
+#include "ingest/IngestSpec.h"
+#include "meta/NNode.h"
+#include "meta/TableSpec.h"
+
+/**
+ * End to end benchmark of TPC-H lineitem table on an in-process node.
+ * The table is loaded by the same ingest path and spec as bench/readme.md describes (csv delimited by "|"),
+ * from a given file (such as lineitem.tbl of dbgen) or from rows generated at given scale with a fixed seed.
+ * A fixed suite of queries is run repeatedly after warm up, latency percentiles, rows scanned per second
+ * and memory per block are reported, so that results of two releases are comparable run by run.
+ */
+DEFINE_string(TPCH_DATA, "", "lineitem file delimited by '|', rows are generated at TPCH_SCALE if not given");
+DEFINE_double(TPCH_SCALE, 0.1, "TPC-H scale factor of generated rows, 6M lineitem rows per scale 1");
+DEFINE_uint32(TPCH_WARMUP, 2, "number of runs of every query before timing");
+DEFINE_uint32(TPCH_ROUNDS, 10, "number of timed runs of every query");
+DEFINE_uint32(TPCH_THREADS, 0, "threads of query executor, 0 for all cores");
+DEFINE_string(TPCH_OUT, "", "file to write results in JSON for comparison between runs");
+
+namespace nebula {
+namespace bench {
+
+using namespace nebula::api::dsl;
+using nebula::common::Evidence;
+using nebula::execution::PlanPtr;
+using nebula::execution::QueryContext;
+using nebula::execution::meta::TableService;
+
+static constexpr auto TABLE = "nebula.bench";
+static constexpr auto SCHEMA = "ROW<l_orderkey:bigint, l_partkey:bigint, l_suppkey:bigint, l_linenumber:int, "
+                               "l_quantity:int, l_extendedprice:float, l_discount:float, l_tax:float, "
+                               "l_returnflag:string, l_linestatus:string, l_shipdate:string, l_commitdate:string, "
+                               "l_receiptdate:string, l_shipinstruct:string, l_shipmode:string, l_comment:string>";
+
+// write lineitem rows of given scale in dbgen layout, values follow TPC-H domains but not its exact distribution
+static std::string generate(double scale) {
+  const size_t rows = scale * 6'000'000;
+  const auto file = (std::filesystem::temp_directory_path() / fmt::format("nebula_lineitem_{0}.tbl", rows)).string();
+  if (std::filesystem::exists(file)) {
+    return file;
+  }
+
+  static const std::array<std::string_view, 3> flags{ "R", "A", "N" };
+  static const std::array<std::string_view, 4> instructs{
+    "DELIVER IN PERSON", "COLLECT COD", "NONE", "TAKE BACK RETURN"
+  };
+  static const std::array<std::string_view, 7> modes{ "REG AIR", "AIR", "RAIL", "SHIP", "TRUCK", "MAIL", "FOB" };
+  static const std::array<std::string_view, 8> words{
+    "furiously", "carefully", "quickly", "final", "regular", "pending", "ironic", "deposits"
+  };
+
+  const int64_t first = Evidence::time("1992-01-02", "%Y-%m-%d");
+  const int64_t last = Evidence::time("1998-12-01", "%Y-%m-%d");
+  const size_t days = (last - first) / Evidence::DAY_SECONDS;
+  const size_t parts = std::max<size_t>(1, scale * 200'000);
+  const size_t suppliers = std::max<size_t>(1, scale * 10'000);
+  auto date = [first](size_t day) { return Evidence::fmt_ymd_dash(first + day * Evidence::DAY_SECONDS); };
+
+  std::mt19937_64 rand{ 42 };
+  std::ofstream out{ file };
+  for (size_t i = 0; i < rows; ++i) {
+    // values are drawn in column order so that the same seed always generates the same file
+    const auto part = 1 + rand() % parts;
+    const auto supplier = 1 + rand() % suppliers;
+    const auto quantity = 1 + rand() % 50;
+    const auto price = quantity * (900 + rand() % 100'000 / 100.0);
+    const auto discount = (rand() % 11) / 100.0;
+    const auto tax = (rand() % 9) / 100.0;
+    const auto flag = flags[rand() % flags.size()];
+    const auto ship = rand() % days;
+    const auto commit = ship + rand() % 30;
+    const auto receipt = ship + 1 + rand() % 30;
+    const auto instruct = instructs[rand() % instructs.size()];
+    const auto mode = modes[rand() % modes.size()];
+    const auto word1 = words[rand() % words.size()];
+    const auto word2 = words[rand() % words.size()];
+    out << fmt::format("{0}|{1}|{2}|{3}|{4}|{5:.2f}|{6:.2f}|{7:.2f}|{8}|{9}|{10}|{11}|{12}|{13}|{14}|{15} {16}\n",
+                       i / 4 + 1, part, supplier, i % 4 + 1, quantity, price, discount, tax,
+                       flag, ship < days / 2 ? "F" : "O", date(ship), date(commit), date(receipt),
+                       instruct, mode, word1, word2);
+  }
+
+  return file;
+}
+
+// load the file into the in-process node through the ingest path, return the table spec
+static nebula::meta::TableSpecPtr load(const std::string& file) {
+  using namespace nebula::meta;
+  ColumnProps columns;
+  for (auto name : { "l_returnflag", "l_linestatus", "l_shipinstruct", "l_shipmode", "l_commitdate", "l_receiptdate" }) {
+    columns.emplace(name, Column{ false, true });
+  }
+
+  TimeSpec time{ TimeType::COLUMN, 0, "l_shipdate", "%Y-%m-%d" };
+  auto table = std::make_shared<TableSpec>(
+    TABLE, 100'000, 0, SCHEMA, DataSource::LOCAL,
+    "Swap", file, "",
+    DataFormat::CSV, CsvProps{ false, false, "|" }, JsonProps{}, ThriftProps{},
+    KafkaSerde{}, RocksetSerde{},
+    std::move(columns), std::move(time),
+    AccessSpec{}, BucketInfo::empty(), nebula::type::Settings{},
+    std::map<std::string, std::vector<std::string>>{}, std::vector<std::string>{}, -1);
+
+  const auto size = std::filesystem::file_size(file);
+  std::vector<SpecSplitPtr> splits{ std::make_shared<SpecSplit>(file, size, 0) };
+  nebula::ingest::IngestSpec spec(table, "1.0", "nebula", splits, SpecState::NEW);
+
+  Evidence::Duration tick;
+  const auto blocks = spec.work();
+  N_ENSURE_GT(blocks, 0, "no block loaded from file");
+  LOG(INFO) << fmt::format("Loaded {0} blocks of {1} bytes in {2} ms", blocks, size, tick.elapsedMs());
+  return table;
+}
+
+struct Result {
+  std::string name;
+  size_t rows;
+  std::vector<size_t> latencies;
+
+  inline size_t percentile(double p) const {
+    auto sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted.at(std::min<size_t>(sorted.size() - 1, p * sorted.size()));
+  }
+};
+
+// the fixed query suite, every query spans the whole table window
+static std::vector<std::pair<std::string, std::function<PlanPtr()>>> suite() {
+  auto ms = TableService::singleton();
+  auto plan = [](Query& query) { return query.compile(QueryContext::def()); };
+  return {
+    { "filter", [ms, plan]() {
+       auto q = table(TABLE, ms)
+                  .where(col("l_quantity") < 24 && col("l_shipmode") == "AIR")
+                  .select(col("l_orderkey"), col("l_extendedprice"))
+                  .limit(100);
+       return plan(q);
+     } },
+    { "groupby", [ms, plan]() {
+       auto q = table(TABLE, ms)
+                  .select(col("l_returnflag"),
+                          col("l_linestatus"),
+                          sum(col("l_quantity")).as("sum_qty"),
+                          avg(col("l_extendedprice")).as("avg_price"),
+                          count(col("l_orderkey")).as("count"))
+                  .groupby({ 1, 2 })
+                  .sortby({ 1, 2 });
+       return plan(q);
+     } },
+    { "topn", [ms, plan]() {
+       auto q = table(TABLE, ms)
+                  .where(col("l_returnflag") == "R")
+                  .select(col("l_suppkey"), sum(col("l_quantity")).as("qty"))
+                  .groupby({ 1 })
+                  .sortby({ 2 }, SortType::DESC)
+                  .limit(10);
+       return plan(q);
+     } },
+    { "distinct", [ms, plan]() {
+       auto q = table(TABLE, ms)
+                  .select(col("l_shipmode"), card(col("l_partkey")).as("parts"))
+                  .groupby({ 1 });
+       return plan(q);
+     } },
+    { "percentile", [ms, plan]() {
+       auto q = table(TABLE, ms)
+                  .select(col("l_shipinstruct"),
+                          pct(col("l_extendedprice"), 50).as("p50"),
+                          pct(col("l_extendedprice"), 99).as("p99"))
+                  .groupby({ 1 });
+       return plan(q);
+     } }
+  };
+}
+
+static void report(const std::vector<Result>& results, const nebula::execution::TableStateBase& metrics, size_t memory) {
+  const auto blocks = std::max<size_t>(1, metrics.numBlocks());
+  const auto rows = metrics.numRows();
+  LOG(INFO) << fmt::format("Table {0}: rows={1}, blocks={2}, raw bytes per block={3}, memory per block={4}",
+                           TABLE, rows, metrics.numBlocks(), metrics.rawBytes() / blocks, memory / blocks);
+  LOG(INFO) << fmt::format("{0:12} | {1:>8} | {2:>8} | {3:>8} | {4:>8} | {5:>14}",
+                           "query", "p50 ms", "p90 ms", "p99 ms", "max ms", "rows/sec");
+  for (const auto& r : results) {
+    const auto p50 = r.percentile(0.5);
+    LOG(INFO) << fmt::format("{0:12} | {1:8} | {2:8} | {3:8} | {4:8} | {5:14.0f}",
+                             r.name, p50, r.percentile(0.9), r.percentile(0.99), r.percentile(1),
+                             rows * 1000.0 / std::max<size_t>(1, p50));
+  }
+
+  if (FLAGS_TPCH_OUT.empty()) {
+    return;
+  }
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> json(buffer);
+  json.StartObject();
+  json.Key("rows");
+  json.Uint64(rows);
+  json.Key("blocks");
+  json.Uint64(metrics.numBlocks());
+  json.Key("blockMemory");
+  json.Uint64(memory / blocks);
+  json.Key("queries");
+  json.StartArray();
+  for (const auto& r : results) {
+    json.StartObject();
+    json.Key("name");
+    json.String(r.name.data(), r.name.size());
+    json.Key("results");
+    json.Uint64(r.rows);
+    json.Key("p50");
+    json.Uint64(r.percentile(0.5));
+    json.Key("p90");
+    json.Uint64(r.percentile(0.9));
+    json.Key("p99");
+    json.Uint64(r.percentile(0.99));
+    json.Key("max");
+    json.Uint64(r.percentile(1));
+    json.EndObject();
+  }
+  json.EndArray();
+  json.EndObject();
+
+  std::ofstream out{ FLAGS_TPCH_OUT };
+  out << buffer.GetString();
+}
+
+static void run() {
+  const auto file = FLAGS_TPCH_DATA.empty() ? generate(FLAGS_TPCH_SCALE) : FLAGS_TPCH_DATA;
+  auto table = load(file);
+
+  // metrics and memory of all loaded blocks of the table
+  auto bm = nebula::execution::BlockManager::init();
+  const auto metrics = bm->metrics(TABLE);
+  const auto states = bm->states();
+  size_t memory = 0;
+  auto state = states.find(TABLE);
+  if (state != states.end()) {
+    state->second->iterate([&memory](const nebula::execution::io::BatchBlock& block) {
+      memory += block.data()->getMemory();
+    });
+  }
+
+  const auto window = metrics.timeWindow();
+  const auto threads = FLAGS_TPCH_THREADS == 0 ? std::thread::hardware_concurrency() : FLAGS_TPCH_THREADS;
+  folly::CPUThreadPoolExecutor pool{ threads };
+  nebula::execution::core::ServerExecutor executor{ nebula::meta::NNode::local().toString() };
+
+  std::vector<Result> results;
+  for (const auto& query : suite()) {
+    Result result{ query.first, 0, {} };
+    for (size_t i = 0; i < FLAGS_TPCH_WARMUP + FLAGS_TPCH_ROUNDS; ++i) {
+      auto plan = query.second();
+      plan->setWindow(window);
+
+      Evidence::Duration tick;
+      auto cursor = executor.execute(pool, plan);
+      const auto ms = tick.elapsedMs();
+      if (i >= FLAGS_TPCH_WARMUP) {
+        result.latencies.push_back(ms);
+      }
+
+      result.rows = cursor->size();
+    }
+
+    results.push_back(std::move(result));
+  }
+
+  report(results, metrics, memory);
+}
+
+} // namespace bench
+} // namespace nebula
+
+int main(int argc, char** argv) {
+  nebula::execution::serde::init();
+  folly::init(&argc, &argv);
+  FLAGS_logtostderr = 1;
+
+  nebula::bench::run();
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Errors.h"
+#include "Likely.h"
+
+/**
+ * A bump pointer arena to allocate many small objects living in the same compute scope.
+ * Objects are never freed individually, all memory is released when the arena is destroyed.
+ * Arena is not thread safe, it is supposed to be used by the thread running the compute only.
+ */
+namespace nebula {
+namespace common {
+
+class Arena {
+  static constexpr size_t BLOCK = 64 * 1024;
+
+public:
+  explicit Arena(size_t block = BLOCK)
+    : block_{ block }, current_{ nullptr }, offset_{ 0 }, capacity_{ 0 }, allocated_{ 0 } {}
+  virtual ~Arena() = default;
+
+  // block memory is aligned by max_align_t, so aligning offset in block is enough
+  inline void* allocate(size_t size, size_t align) {
+    auto offset = (offset_ + align - 1) & ~(align - 1);
+    if (N_UNLIKELY(current_ == nullptr || offset + size > capacity_)) {
+      capacity_ = std::max(block_, size);
+      blocks_.push_back(std::make_unique<char[]>(capacity_));
+      current_ = blocks_.back().get();
+      offset = 0;
+    }
+
+    auto p = current_ + offset;
+    offset_ = offset + size;
+    allocated_ += size;
+    return p;
+  }
+
+  inline size_t allocated() const {
+    return allocated_;
+  }
+
+  // bind an arena to current thread, shared objects created by make() while it is bound are allocated from it
+  class Scope {
+  public:
+    explicit Scope(std::shared_ptr<Arena> arena) : last_{ std::move(current()) } {
+      current() = std::move(arena);
+    }
+
+    ~Scope() {
+      current() = std::move(last_);
+    }
+
+  private:
+    std::shared_ptr<Arena> last_;
+  };
+
+  // allocator used by std::allocate_shared, it holds the arena alive till all objects are gone
+  template <typename T>
+  class Allocator {
+  public:
+    using value_type = T;
+
+    explicit Allocator(std::shared_ptr<Arena> arena) : arena_{ std::move(arena) } {}
+
+    template <typename U>
+    Allocator(const Allocator<U>& other) : arena_{ other.arena_ } {}
+
+    inline T* allocate(size_t n) {
+      return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // memory is released with the arena
+    inline void deallocate(T*, size_t) noexcept {}
+
+    template <typename U>
+    inline bool operator==(const Allocator<U>& other) const noexcept {
+      return arena_ == other.arena_;
+    }
+
+    template <typename U>
+    inline bool operator!=(const Allocator<U>& other) const noexcept {
+      return arena_ != other.arena_;
+    }
+
+  private:
+    template <typename U>
+    friend class Allocator;
+    std::shared_ptr<Arena> arena_;
+  };
+
+  // make a shared object from the arena bound to current thread, or from heap if no arena bound
+  template <typename T, typename... Args>
+  static std::shared_ptr<T> make(Args&&... args) {
+    auto& arena = current();
+    if (arena) {
+      return std::allocate_shared<T>(Allocator<T>(arena), std::forward<Args>(args)...);
+    }
+
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  }
+
+private:
+  static std::shared_ptr<Arena>& current() {
+    static thread_local std::shared_ptr<Arena> arena;
+    return arena;
+  }
+
+private:
+  size_t block_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* current_;
+  size_t offset_;
+  size_t capacity_;
+  size_t allocated_;
+};
+
+} // namespace common
+} // namespace nebula
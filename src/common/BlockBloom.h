@@ -0,0 +1,121 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/**
+ * A split block bloom filter.
+ * Every key is mapped to a single 256-bit bucket (half of a cache line), and sets one bit
+ * in each of the 8 32-bit words of the bucket, so that an insert or a probe touches one cache line only.
+ * The 8 bit positions are computed together with SIMD instructions when AVX2 is available.
+ */
+namespace nebula {
+namespace common {
+
+class BlockBloom {
+  static constexpr size_t WORDS = 8;
+
+  // odd constants to derive 8 bit positions from one 32-bit key by multiply-shift
+  static constexpr uint32_t SALT[WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+  };
+
+  struct alignas(32) Bucket {
+    uint32_t words[WORDS];
+  };
+
+public:
+  // size the filter for expected number of items and false positive probability
+  explicit BlockBloom(size_t items, double fpp = 0.01)
+    : buckets_(std::max<size_t>(1, std::ceil(bits(items, fpp) / (WORDS * 32)))) {}
+  virtual ~BlockBloom() = default;
+
+public:
+  inline void insert(uint64_t hash) noexcept {
+    auto& bucket = buckets_[index(hash)];
+    const uint32_t key = static_cast<uint32_t>(hash);
+#ifdef __AVX2__
+    auto p = reinterpret_cast<__m256i*>(bucket.words);
+    _mm256_store_si256(p, _mm256_or_si256(_mm256_load_si256(p), mask(key)));
+#else
+    for (size_t i = 0; i < WORDS; ++i) {
+      bucket.words[i] |= bit(key, i);
+    }
+#endif
+  }
+
+  inline bool contains(uint64_t hash) const noexcept {
+    const auto& bucket = buckets_[index(hash)];
+    const uint32_t key = static_cast<uint32_t>(hash);
+#ifdef __AVX2__
+    // all mask bits are set in bucket if (~bucket & mask) == 0
+    auto words = _mm256_load_si256(reinterpret_cast<const __m256i*>(bucket.words));
+    return _mm256_testc_si256(words, mask(key));
+#else
+    for (size_t i = 0; i < WORDS; ++i) {
+      if ((bucket.words[i] & bit(key, i)) == 0) {
+        return false;
+      }
+    }
+
+    return true;
+#endif
+  }
+
+  // memory bytes used by this filter
+  inline size_t size() const noexcept {
+    return buckets_.size() * sizeof(Bucket);
+  }
+
+private:
+  // number of bits needed when every key sets 8 bits in a 256-bit bucket
+  static double bits(size_t items, double fpp) {
+    return -8.0 * std::max<size_t>(items, 1) / std::log(1 - std::pow(fpp, 1.0 / WORDS));
+  }
+
+  // higher 32 bits of the hash locate the bucket in range of [0, buckets) without modulo
+  inline size_t index(uint64_t hash) const noexcept {
+    return ((hash >> 32) * buckets_.size()) >> 32;
+  }
+
+  static inline uint32_t bit(uint32_t key, size_t i) noexcept {
+    return 1U << ((key * SALT[i]) >> 27);
+  }
+
+#ifdef __AVX2__
+  static inline __m256i mask(uint32_t key) noexcept {
+    const auto salt = _mm256_setr_epi32(SALT[0], SALT[1], SALT[2], SALT[3], SALT[4], SALT[5], SALT[6], SALT[7]);
+    auto shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(key), salt), 27);
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+  }
+#endif
+
+private:
+  std::vector<Bucket> buckets_;
+};
+
+} // namespace common
+} // namespace nebula
@@ -19,9 +19,10 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
+#include <string_view>
 #include <vector>
-#include "Bloom.h"
-#include "Evidence.h"
+#include "BlockBloom.h"
+#include "Hash.h"
 
 // #include "bf/bloom_filter/basic.hpp"
 // #include "cuckoofilter.h"
@@ -30,58 +31,51 @@
 
 /**
  * Define a bloom filter module.
- * Internally we're using cuckoo filter as initial implementation.
+ * Internally we're using split block bloom filter (BlockBloom.h) which touches one cache line per add or probe.
+ * The classic multi-probe implementation (Bloom.h) was used before.
  */
 namespace nebula {
 namespace common {
 template <typename T, size_t BITS = 16>
 class BloomFilter {
 public:
-  BloomFilter(size_t items) {
-    bloom_parameters parameters;
-    parameters.projected_element_count = items;
-    parameters.false_positive_probability = 0.01;
-    parameters.random_seed = Evidence::ticks();
-    parameters.compute_optimal_parameters();
-
-    //Instantiate Bloom Filter
-    filter_ = std::make_unique<bloom_filter>(parameters);
-  }
+  // split block filter has a higher false positive rate than classic one with the same bits,
+  // so it is sized for a tighter target by default to keep the actual rate at about 0.2%.
+  BloomFilter(size_t items, double fpp = 0.001) : filter_{ std::make_unique<BlockBloom>(items, fpp) } {}
   virtual ~BloomFilter() = default;
 
 public:
   // add an item in the set, if no more space or other issues
   // return false to indicate this item was not added
   bool add(const T& item) noexcept {
-    filter_->insert(item);
-    // filter_.add(item);
-    // auto x = filter_.Add(item);
-    // if (x != cuckoofilter::Ok) {
-    //   LOG(INFO) << (int)x;
-    // }
-    // return x == cuckoofilter::Ok;
+    filter_->insert(hash(item));
     return true;
   }
 
   // check if given item is probably in the set.
   // return false if absolutely not in the set
   bool probably(const T& item) const noexcept {
-    return filter_->contains(item);
-    // return filter_.lookup(item) == 1;
-    // return filter_.Contain(item) == cuckoofilter::Ok;
+    return filter_->contains(hash(item));
   }
 
   // memory bytes used by this filter
   size_t bytes() const noexcept {
     return filter_->size();
-    // return 0;
-    // return filter_.SizeInBytes();
   }
 
 private:
-  std::unique_ptr<bloom_filter> filter_;
-  // cuckoofilter::CuckooFilter<T, BITS> filter_;
+  // strings are hashed by their bytes rather than the view object
+  static inline uint64_t hash(const T& item) noexcept {
+    if constexpr (std::is_same_v<T, std::string_view>) {
+      return Hasher::hash64(item.data(), item.size());
+    } else {
+      return Hasher::hash64(&item, sizeof(T));
+    }
+  }
+
+private:
+  std::unique_ptr<BlockBloom> filter_;
 };
 
 } // namespace common
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
@@ -127,6 +127,12 @@ public:
     return a == b || std::tolower(a) == std::tolower(b);
   }
 
+  // a char of a word in text, words are maximal runs of letters, digits, '_' and non-ASCII (UTF-8) bytes
+  static inline bool token(char c) {
+    const auto u = static_cast<unsigned char>(c);
+    return std::isalnum(u) || c == '_' || u >= 0x80;
+  }
+
   // shortcut: two string views have the same value ignoring case
   static inline bool same(std::string_view v1, std::string_view v2, bool ignoreCase = true) {
     return v1.size() == v2.size() && prefix(v1.data(), v1.size(), v2.data(), v2.size(), ignoreCase);
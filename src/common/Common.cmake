@@ -5,6 +5,8 @@ set(NEBULA_COMMON NCommon)
 add_library(${NEBULA_COMMON} STATIC 
     ${NEBULA_SRC}/common/Errors.cpp
     ${NEBULA_SRC}/common/Memory.cpp
+    ${NEBULA_SRC}/common/Metrics.cpp
+    ${NEBULA_SRC}/common/Numa.cpp
     ${NEBULA_SRC}/common/Int128.cpp)
 target_link_libraries(${NEBULA_COMMON}
     PUBLIC ${DATE_LIBRARY}
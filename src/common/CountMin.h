@@ -16,9 +16,13 @@
 
 #pragma once
 
+#include <array>
+#include <cstring>
+#include <limits>
 #include <lz4.h>
 #include <zstd.h>
 
+#include "common/Errors.h"
 #include "common/Hash.h"
 #include "common/Memory.h"
 
@@ -50,25 +54,46 @@ public:
   ~CountMin() = default;
 
 public:
+  // add a value in by its bytes, strings are added by their content
+  // return the new count estimated for the value
   template <typename T = size_t>
-  void add(T v, CT count = 1) {
+  CT add(const T& v, CT count = 1) {
+    if constexpr (std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>) {
+      return add(hashes(v.data(), v.size()), count);
+    } else {
+      return add(hashes(&v, sizeof(T)), count);
+    }
+  }
+
+  // add a value in by its pre-computed hashes, return its new count estimated
+  CT add(const std::array<size_t, H>& hashes, CT count = 1) {
     // increment total counter
     total_ += count;
 
-    // get N hashes for given value
-    auto hashes = nebula::common::Hasher::hash64<H>(&v, sizeof(T));
-
     // distribute each hash to the table
+    CT min = std::numeric_limits<CT>::max();
     for (size_t i = 0; i < H; ++i) {
-      table_[i][hashes.at(i) % M] += count;
+      auto& cell = table_[i][hashes.at(i) % M];
+      cell += count;
+      if (cell < min) {
+        min = cell;
+      }
     }
+
+    return min;
   }
 
   // query given value
   template <typename T = size_t>
-  CT query(T v) const {
-    auto hashes = nebula::common::Hasher::hash64<H>(&v, sizeof(T));
-    // distribute each hash to the table
+  CT query(const T& v) const {
+    if constexpr (std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>) {
+      return query(hashes(v.data(), v.size()));
+    } else {
+      return query(hashes(&v, sizeof(T)));
+    }
+  }
+
+  CT query(const std::array<size_t, H>& hashes) const {
     CT min = std::numeric_limits<CT>::max();
     for (size_t i = 0; i < H; ++i) {
       auto x = table_[i][hashes.at(i) % M];
@@ -80,14 +105,20 @@ public:
     return min;
   }
 
+  // get N hashes for given bytes
+  static inline std::array<size_t, H> hashes(const void* data, size_t size) {
+    return nebula::common::Hasher::hash64<H>(data, size);
+  }
+
   // merge another sketch sharing the same spec HxM
   void merge(const CountMin<H, M, CT>& other) {
     for (size_t r = 0; r < H; ++r)
       for (size_t c = 0; c < M; ++c) {
-        auto cell = other.table_[r][c];
-        table_[r][c] += cell;
-        total_ += cell;
+        table_[r][c] += other.table_[r][c];
       }
+
+    // every value is counted once in each row
+    total_ += other.total_;
   }
 
   static inline std::string name() {
@@ -126,6 +157,18 @@ public:
     return fit;
   }
 
+  // raw bytes of the table
+  inline std::string_view data() const {
+    return std::string_view((const char*)&table_[0][0], SIZE);
+  }
+
+  // set the table by its raw bytes and total count
+  inline void set(const std::string_view& bytes, size_t total) {
+    N_ENSURE_EQ(bytes.size(), SIZE, "count min sketch size mismatches");
+    std::memcpy(&table_[0][0], bytes.data(), SIZE);
+    total_ = total;
+  }
+
 private:
   CT table_[H][M];
   size_t total_;
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "common/Memory.h"
+
+/**
+ * A DDSketch to estimate quantiles with relative error guarantee.
+ * A positive value v is counted in bucket ceil(log(v) / log(gamma)) where gamma = (1 + alpha) / (1 - alpha),
+ * so every value of a bucket is estimated by the bucket within relative error alpha.
+ * Negative values are counted by their magnitudes in another store, values near 0 are counted as 0.
+ *
+ * Buckets are dense counts over the range of indices seen, so a sketch is small as long as the values
+ * span a few orders of magnitude (latencies do), two sketches merge by adding counts of the same buckets.
+ * A store is bounded by collapsing its lowest buckets, which only loses accuracy of values closest to 0.
+ */
+namespace nebula {
+namespace common {
+
+class DDSketch {
+  // dense counts of consecutive bucket indices starting at offset
+  struct Store {
+    int32_t offset = 0;
+    uint64_t total = 0;
+    std::vector<uint32_t> counts;
+
+    inline void add(int32_t index, uint32_t count, size_t bins) {
+      if (counts.empty()) {
+        offset = index;
+        counts.push_back(0);
+      } else if (index < offset) {
+        counts.insert(counts.begin(), offset - index, 0);
+        offset = index;
+      } else if (index >= offset + static_cast<int32_t>(counts.size())) {
+        counts.resize(index - offset + 1, 0);
+      }
+
+      counts[index - offset] += count;
+      total += count;
+
+      // values closest to 0 are merged into the lowest bucket kept
+      if (N_UNLIKELY(counts.size() > bins)) {
+        const auto excess = counts.size() - bins;
+        uint32_t collapsed = 0;
+        for (size_t i = 0; i <= excess; ++i) {
+          collapsed += counts[i];
+        }
+
+        counts.erase(counts.begin(), counts.begin() + excess);
+        counts.front() = collapsed;
+        offset += excess;
+      }
+    }
+
+    inline void merge(const Store& other, size_t bins) {
+      for (size_t i = 0, size = other.counts.size(); i < size; ++i) {
+        if (other.counts[i] > 0) {
+          add(other.offset + i, other.counts[i], bins);
+        }
+      }
+    }
+
+    size_t serialize(ExtendableSlice& slice, size_t offset) const {
+      const auto origin = offset;
+      offset += slice.write(offset, this->offset);
+      offset += writeVarint(slice, offset, counts.size());
+      for (auto c : counts) {
+        offset += writeVarint(slice, offset, c);
+      }
+
+      return offset - origin;
+    }
+
+    size_t load(const ExtendableSlice& slice, size_t offset) {
+      const auto origin = offset;
+      this->offset = slice.read<int32_t>(offset);
+      offset += sizeof(int32_t);
+      counts.resize(readVarint(slice, offset));
+      total = 0;
+      for (auto& c : counts) {
+        c = readVarint(slice, offset);
+        total += c;
+      }
+
+      return offset - origin;
+    }
+  };
+
+public:
+  // 2% relative error, a bucket per 4% of value growth
+  explicit DDSketch(double alpha = 0.02, size_t bins = 1024)
+    : alpha_{ alpha },
+      gamma_{ (1 + alpha) / (1 - alpha) },
+      multiplier_{ 1 / std::log(gamma_) },
+      bins_{ bins },
+      zeros_{ 0 },
+      sum_{ 0 },
+      min_{ std::numeric_limits<double>::infinity() },
+      max_{ -std::numeric_limits<double>::infinity() } {}
+  virtual ~DDSketch() = default;
+
+  inline void add(double v) {
+    if (v > MIN_VALUE) {
+      positive_.add(index(v), 1, bins_);
+    } else if (v < -MIN_VALUE) {
+      negative_.add(index(-v), 1, bins_);
+    } else {
+      ++zeros_;
+    }
+
+    sum_ += v;
+    min_ = std::min(min_, v);
+    max_ = std::max(max_, v);
+  }
+
+  // merge another sketch of the same relative error
+  void merge(const DDSketch& other) {
+    N_ENSURE_EQ(alpha_, other.alpha_, "merge sketches of the same relative error");
+    positive_.merge(other.positive_, bins_);
+    negative_.merge(other.negative_, bins_);
+    zeros_ += other.zeros_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  // estimate value at quantile q in [0, 1]
+  double quantile(double q) const {
+    const auto total = count();
+    if (total == 0) {
+      return 0;
+    }
+
+    if (q <= 0) {
+      return min_;
+    }
+
+    if (q >= 1) {
+      return max_;
+    }
+
+    // values are ordered as negatives of descending magnitude, zeros and positives
+    auto rank = static_cast<uint64_t>(q * (total - 1));
+    double value = 0;
+    if (rank < negative_.total) {
+      uint64_t seen = 0;
+      for (size_t i = negative_.counts.size(); i > 0; --i) {
+        seen += negative_.counts[i - 1];
+        if (seen > rank) {
+          value = -estimate(negative_.offset + i - 1);
+          break;
+        }
+      }
+    } else if ((rank -= negative_.total) >= zeros_) {
+      rank -= zeros_;
+      uint64_t seen = 0;
+      for (size_t i = 0, size = positive_.counts.size(); i < size; ++i) {
+        seen += positive_.counts[i];
+        if (seen > rank) {
+          value = estimate(positive_.offset + i);
+          break;
+        }
+      }
+    }
+
+    return std::clamp(value, min_, max_);
+  }
+
+  inline uint64_t count() const noexcept {
+    return positive_.total + negative_.total + zeros_;
+  }
+
+  inline double sum() const noexcept {
+    return sum_;
+  }
+
+  inline double min() const noexcept {
+    return min_;
+  }
+
+  inline double max() const noexcept {
+    return max_;
+  }
+
+  inline double alpha() const noexcept {
+    return alpha_;
+  }
+
+  // number of buckets allocated
+  inline size_t buckets() const noexcept {
+    return positive_.counts.size() + negative_.counts.size();
+  }
+
+  // serialize into a slice at given offset, return bytes written
+  size_t serialize(ExtendableSlice& slice, size_t offset) const {
+    const auto origin = offset;
+    offset += slice.write(offset, sum_);
+    offset += slice.write(offset, min_);
+    offset += slice.write(offset, max_);
+    offset += writeVarint(slice, offset, zeros_);
+    offset += positive_.serialize(slice, offset);
+    offset += negative_.serialize(slice, offset);
+    return offset - origin;
+  }
+
+  // load from a slice at given offset, return bytes consumed
+  size_t load(const ExtendableSlice& slice, size_t offset) {
+    const auto origin = offset;
+
+#define READ(NAME)                   \
+  NAME = slice.read<double>(offset); \
+  offset += sizeof(double);
+
+    READ(sum_)
+    READ(min_)
+    READ(max_)
+
+#undef READ
+    zeros_ = readVarint(slice, offset);
+    offset += positive_.load(slice, offset);
+    offset += negative_.load(slice, offset);
+    return offset - origin;
+  }
+
+private:
+  // magnitudes below this are counted as 0
+  static constexpr double MIN_VALUE = 1e-9;
+
+  inline int32_t index(double v) const noexcept {
+    return static_cast<int32_t>(std::ceil(std::log(v) * multiplier_));
+  }
+
+  // value of a bucket within relative error alpha of every value in it
+  inline double estimate(int32_t index) const noexcept {
+    return 2 * std::pow(gamma_, index) / (gamma_ + 1);
+  }
+
+private:
+  double alpha_;
+  double gamma_;
+  double multiplier_;
+  size_t bins_;
+  Store positive_;
+  Store negative_;
+  uint64_t zeros_;
+  double sum_;
+  double min_;
+  double max_;
+};
+
+} // namespace common
+} // namespace nebula
@@ -179,7 +179,8 @@ auto delta_decode(int8_t* data, size_t size) -> std::enable_if_t<
     int64_t base;
     if constexpr (WIDTH == 8) {
       int64_t high = getVarInt(data, i);
-      int32_t low = getVarInt(data, i);
+      // low word is unsigned, otherwise its sign bit spreads into high word
+      uint32_t low = getVarInt(data, i);
       base = (high << 32) | low;
     }
 
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <xxh3.h>
+
+#include "common/Hash.h"
+#include "common/Memory.h"
+
+/**
+ * An exact distinct set backing precise COUNT DISTINCT.
+ * Values are hash partitioned into a fixed number of partitions, each one is a hash set of fixed width keys,
+ * so that a growing set rehashes one small partition at a time, and two sets are merged partition by partition
+ * with probes staying in a table of 1/PARTITIONS of the whole set.
+ *
+ * Numbers are kept by their own bytes, strings are kept by 128-bit hashes of their content,
+ * the chance of any collision is about n^2 / 2^129 (far below 1e-20 for a billion values).
+ * Serialized form: [size of partition, keys...] for every partition.
+ */
+namespace nebula {
+namespace common {
+
+// a 128-bit key, which is the key of strings (by hash) and 16 bytes integers
+struct Key128 {
+  uint64_t low;
+  uint64_t high;
+
+  inline bool operator==(const Key128& other) const noexcept {
+    return low == other.low && high == other.high;
+  }
+};
+
+template <typename K>
+class DistinctSet {
+  static_assert(std::is_same_v<K, uint64_t> || std::is_same_v<K, Key128>, "keys are 8 or 16 bytes");
+
+  struct KeyHash {
+    inline size_t operator()(const K& key) const noexcept {
+      if constexpr (std::is_same_v<K, Key128>) {
+        return robin_hood::hash_int(key.low ^ robin_hood::hash_int(key.high));
+      } else {
+        return robin_hood::hash_int(key);
+      }
+    }
+  };
+
+  using Partition = unordered_set<K, KeyHash>;
+
+public:
+  // number of partitions, picked by the top bits of key hash
+  static constexpr size_t BITS = 6;
+  static constexpr size_t PARTITIONS = 1 << BITS;
+
+  // key of a given value
+  template <typename T>
+  static inline K key(const T& v) noexcept {
+    K k{};
+    if constexpr (std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>) {
+      static_assert(std::is_same_v<K, Key128>, "strings are keyed by 128-bit hash");
+      const auto h = XXH3_128bits(v.data(), v.size());
+      k.low = h.low64;
+      k.high = h.high64;
+    } else {
+      static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(K), "value fits in the key");
+      // positive and negative zero are the same value
+      const T value = v == 0 ? T(0) : v;
+      std::memcpy(&k, &value, sizeof(T));
+    }
+
+    return k;
+  }
+
+public:
+  DistinctSet() = default;
+  virtual ~DistinctSet() = default;
+
+  inline void add(const K& key) {
+    const auto h = KeyHash()(key);
+    partitions_[index(h)].insert(key);
+  }
+
+  // merge another set into this one partition by partition
+  void merge(const DistinctSet& other) {
+    for (size_t i = 0; i < PARTITIONS; ++i) {
+      const auto& source = other.partitions_[i];
+      if (source.empty()) {
+        continue;
+      }
+
+      auto& target = partitions_[i];
+      if (target.empty()) {
+        target = source;
+        continue;
+      }
+
+      target.reserve(target.size() + source.size());
+      for (const auto& key : source) {
+        target.insert(key);
+      }
+    }
+  }
+
+  // number of distinct values
+  inline size_t size() const noexcept {
+    size_t size = 0;
+    for (const auto& p : partitions_) {
+      size += p.size();
+    }
+
+    return size;
+  }
+
+  // serialize into a slice at given offset, return bytes written
+  size_t serialize(ExtendableSlice& slice, size_t offset) const {
+    const auto origin = offset;
+    for (const auto& p : partitions_) {
+      offset += slice.write(offset, p.size());
+      for (const auto& key : p) {
+        if constexpr (std::is_same_v<K, Key128>) {
+          offset += slice.write(offset, key.low);
+          offset += slice.write(offset, key.high);
+        } else {
+          offset += slice.write(offset, key);
+        }
+      }
+    }
+
+    return offset - origin;
+  }
+
+  // load from a slice at given offset, return bytes consumed
+  size_t load(const ExtendableSlice& slice, size_t offset) {
+    const auto origin = offset;
+    for (auto& p : partitions_) {
+      p.clear();
+      const auto size = slice.read<size_t>(offset);
+      offset += sizeof(size);
+      p.reserve(size);
+      for (size_t i = 0; i < size; ++i) {
+        K key;
+        if constexpr (std::is_same_v<K, Key128>) {
+          key.low = slice.read<uint64_t>(offset);
+          key.high = slice.read<uint64_t>(offset + sizeof(uint64_t));
+        } else {
+          key = slice.read<uint64_t>(offset);
+        }
+
+        offset += sizeof(K);
+        p.insert(key);
+      }
+    }
+
+    return offset - origin;
+  }
+
+private:
+  // top bits are independent of the low bits used by the partition table
+  static inline size_t index(size_t hash) noexcept {
+    return hash >> (64 - BITS);
+  }
+
+private:
+  std::array<Partition, PARTITIONS> partitions_;
+};
+
+} // namespace common
+} // namespace nebula
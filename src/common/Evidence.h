@@ -38,6 +38,14 @@ namespace common {
 class Evidence {
 private:
   Evidence() = default;
+
+  // a read only stream buffer over a string view, so parsing doesn't copy it into a string
+  struct ViewBuffer : public std::streambuf {
+    explicit ViewBuffer(const std::string_view view) {
+      auto data = const_cast<char*>(view.data());
+      setg(data, data, data + view.size());
+    }
+  };
   ~Evidence() = default;
 
 public: /** only static methods */
@@ -133,7 +141,8 @@ public: /** only static methods */
   // given date time string and parsing pattern, return GMT unix time stamp
   static size_t time(const std::string_view datetime, const std::string& pattern) {
     date::sys_time<std::chrono::microseconds> tp;
-    std::istringstream value(datetime.data());
+    ViewBuffer buffer(datetime);
+    std::istream value(&buffer);
     value >> date::parse(pattern, tp);
     if (value.fail()) {
       LOG(ERROR) << "Failed to parse time: " << datetime;
@@ -266,6 +275,10 @@ public: /** only static methods */
       return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - tick_).count();
     }
 
+    auto elapsedUs() const noexcept {
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - tick_).count();
+    }
+
   private:
     std::chrono::time_point<std::chrono::high_resolution_clock> tick_;
   };
@@ -124,6 +124,9 @@ public:
 };
 
 class Hasher {
+  // xxh3 hashes inputs longer than this by stripes
+  static constexpr size_t LONG_BYTES = 240;
+
 public:
   XXH_FORCE_INLINE size_t hashString(const std::string_view& sv) noexcept {
     return hash64(sv.data(), sv.size());
@@ -139,6 +142,16 @@ public:
     return robin_hood::hash_bytes(p, len);
   }
 
+  // hash bytes living in memory only, such as keys of a hash table, it is never persisted or sent to others.
+  // long inputs run xxh3 whose accumulation of stripes is vectorized, short ones stay with hash64.
+  XXH_FORCE_INLINE size_t hashBytes(const void* p, const size_t len) noexcept {
+    if (len > LONG_BYTES) {
+      return XXH3_64bits(p, len);
+    }
+
+    return robin_hood::hash_bytes(p, len);
+  }
+
   template <size_t N>
   XXH_FORCE_INLINE std::array<size_t, N> hash64(const void* p, size_t len) noexcept {
     XXH3_state_t state;
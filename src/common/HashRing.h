@@ -18,6 +18,7 @@
 
 #include <forward_list>
 #include <glog/logging.h>
+#include <memory>
 #include <mutex>
 #include <numeric>
 
@@ -69,6 +70,11 @@ public:
     return *resource_;
   }
 
+  // the resource shared with ring views, so it outlives the node while a view refers to it
+  inline const std::shared_ptr<NT>& shared() const {
+    return resource_;
+  }
+
   // a shortcut method to resource().id()
   inline const std::string& resourceId() const {
     return resource_->id();
@@ -99,7 +105,7 @@ public:
 private:
   // represents the resource on the ring.
   // in the context of cluster management, it represents a node/host
-  std::unique_ptr<NT> resource_;
+  std::shared_ptr<NT> resource_;
 
   // every ring node could have multiple virtual nodes
   // which can be called "labels", or "placements" on the ring
@@ -129,6 +135,82 @@ struct Placement final {
   RN* node;
 };
 
+// An immutable snapshot of a ring for lookups (routing), it never changes once built.
+// Placement hashes are sorted in one contiguous array searched by a branchless binary search,
+// and the owner of every placement is an index into the distinct nodes, so a lookup touches a few cache lines only.
+// Readers share a snapshot without any lock while the ring builds and publishes a new one on membership change.
+template <typename NT, size_t M>
+class RingView final {
+public:
+  RingView(std::vector<size_t> hashes, std::vector<uint32_t> owners, std::vector<std::shared_ptr<NT>> nodes)
+    : hashes_{ std::move(hashes) }, owners_{ std::move(owners) }, nodes_{ std::move(nodes) } {
+    N_ENSURE_EQ(hashes_.size(), owners_.size(), "every placement has an owner");
+  }
+  ~RingView() = default;
+
+  // all key hash will be from here
+  static inline size_t hash(const std::string& key) {
+    return Hasher::hash64(key.data(), key.size()) % M;
+  }
+
+  // index of the placement hosting a key hash, the first one not below it or the first one if none
+  // it's the same placement as (previous, current] coverage search of the ring
+  inline size_t place(size_t hash) const noexcept {
+    const size_t* base = hashes_.data();
+    size_t n = hashes_.size();
+    while (n > 1) {
+      const auto half = n / 2;
+      base = base[half] < hash ? base + half : base;
+      n -= half;
+    }
+
+    const size_t i = (base - hashes_.data()) + (*base < hash);
+    return i == hashes_.size() ? 0 : i;
+  }
+
+  // node hosting the key, the ring must not be empty
+  inline const NT& node(const std::string& key) const {
+    return *nodes_[owners_[place(hash(key))]];
+  }
+
+  // up to count distinct nodes walking the ring clockwise from placement of the key
+  std::vector<const NT*> locate(const std::string& key, size_t count) const {
+    std::vector<const NT*> nodes;
+    const auto size = hashes_.size();
+    if (size == 0) {
+      return nodes;
+    }
+
+    const auto max = std::min(count, nodes_.size());
+    nodes.reserve(max);
+    const auto start = place(hash(key));
+    for (size_t i = 0; i < size && nodes.size() < max; ++i) {
+      const auto node = nodes_[owners_[(start + i) % size]].get();
+      if (std::find(nodes.begin(), nodes.end(), node) == nodes.end()) {
+        nodes.push_back(node);
+      }
+    }
+
+    return nodes;
+  }
+
+  inline size_t numPlacements() const {
+    return hashes_.size();
+  }
+
+  inline size_t numNodes() const {
+    return nodes_.size();
+  }
+
+private:
+  // sorted hashes of all placements
+  const std::vector<size_t> hashes_;
+  // node index of every placement
+  const std::vector<uint32_t> owners_;
+  // distinct nodes, shared so a view stays valid after the ring removes a node
+  const std::vector<std::shared_ptr<NT>> nodes_;
+};
+
 // side note: many facinating ways https://en.cppreference.com/w/cpp/types/enable_if
 // NT: represents NODE type or resource type
 // DT: represents DATA type, it is usually the key type to be distributed
@@ -150,6 +232,8 @@ class HashRing final {
   using TRingNode = RingNode<NT, RING_MAX, H>;
   // Placement Type
   using TPlacement = Placement<TRingNode>;
+  // View Type
+  using TView = RingView<NT, RING_MAX>;
 
 // this macro will lock data change for consistency
 #define DATA_LOCK const std::lock_guard<std::mutex> lock(mdata_);
@@ -170,6 +254,7 @@ public:
 
     // keep placements in sorting
     sort();
+    publish();
   }
   ~HashRing() = default;
 
@@ -183,7 +268,10 @@ public:
     {
       // LOCK data operation in current scope {} and sort at the end
       DATA_LOCK
-      Finally f([this]() { sort(); });
+      Finally f([this]() {
+        sort();
+        publish();
+      });
 
       auto high = placements_.back().hash;
       auto end = placements_.size();
@@ -250,6 +338,8 @@ public:
               placements_.erase(itr);
             }
           }
+
+          publish();
         }
 
         // placements all erased - since it's sorted, we don't need to sort again
@@ -292,6 +382,18 @@ public:
 
 #undef DATA_OP
 
+  // up to count distinct nodes to host copies of the data, walking the ring clockwise from its placement.
+  // the first one is the node attach() picks, data is not attached to any of them.
+  // it reads the current view without any lock, so routing never waits for membership change.
+  inline std::vector<const NT*> locate(const DT& data, size_t count) const {
+    return view()->locate(data.id(), count);
+  }
+
+  // current snapshot of the ring, callers doing many lookups hold it rather than asking the ring for each
+  inline std::shared_ptr<const TView> view() const {
+    return std::atomic_load(&view_);
+  }
+
   inline size_t numNodes() const {
     return nodes_.size();
   }
@@ -395,7 +497,7 @@ private:
 
   // all key hash will be from here
   inline size_t hash(const std::string& key) const {
-    return Hasher::hash64(key.data(), key.size()) % RING_MAX;
+    return TView::hash(key);
   }
 
   // find the proper node to host given key hash
@@ -438,6 +540,29 @@ private:
     });
   }
 
+  // build a view of sorted placements and publish it to readers, called on every membership change
+  void publish() {
+    std::vector<size_t> hashes;
+    std::vector<uint32_t> owners;
+    std::vector<std::shared_ptr<NT>> nodes;
+    unordered_map<const TRingNode*, uint32_t> index;
+    hashes.reserve(placements_.size());
+    owners.reserve(placements_.size());
+    for (const auto& p : placements_) {
+      auto found = index.find(p.node);
+      if (found == index.end()) {
+        found = index.emplace(p.node, static_cast<uint32_t>(nodes.size())).first;
+        nodes.push_back(p.node->shared());
+      }
+
+      hashes.push_back(p.hash);
+      owners.push_back(found->second);
+    }
+
+    std::atomic_store(&view_, std::shared_ptr<const TView>(
+                                std::make_shared<TView>(std::move(hashes), std::move(owners), std::move(nodes))));
+  }
+
 private:
   // data operation mutex, such as moving key around, add keys, remove keys, etc.
   std::mutex mdata_;
@@ -445,6 +570,8 @@ private:
   unordered_set<std::unique_ptr<TRingNode>> nodes_;
   // all placements in the ring, it maintains a sorted metadata for all placements
   std::vector<TPlacement> placements_;
+  // snapshot of placements for lock free lookups, replaced as a whole on membership change
+  std::shared_ptr<const TView> view_;
 
 #undef DATA_LOCK
 };
@@ -16,8 +16,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <numeric>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "Hash.h"
 #include "common/Errors.h"
 #include "common/Memory.h"
@@ -32,12 +37,24 @@ namespace common {
  * @brief HyperLogLog cardinality estimator
  * @date Created 2013/3/20
  * @author Hideaki Ohno
+ *
+ * A sketch starts in sparse mode holding only non-zero registers as sorted (index, rank) entries,
+ * it is upgraded to dense registers once the entries take more than 1/4 of dense size.
+ * Dense registers are merged by register-wise max with SIMD when AVX2 is available.
  */
 class HyperLogLog final {
   using byte_t = uint8_t;
   static constexpr double POW_2_32 = 4294967296.0;      ///< 2^32
   static constexpr double NEG_POW_2_32 = -4294967296.0; ///< -(2^32)
 
+  // a sparse entry packs register index and its rank (at most 33, 6 bits) in 32 bits
+  static constexpr byte_t RANK_BITS = 6;
+  static constexpr uint32_t RANK_MASK = (1 << RANK_BITS) - 1;
+  static constexpr byte_t MAX_SPARSE_WIDTH = 32 - RANK_BITS;
+
+  // sparse entries (4 bytes each) take at most 1/4 space of dense registers (1 byte each)
+  static constexpr uint32_t SPARSE_RATIO = 16;
+
 public:
   // b bit width (register size will be 2 to the b power).
   // This value must be in the range[4,30].
@@ -58,7 +75,8 @@ public:
     : width_{ width },
       left_{ static_cast<byte_t>(32 - width) },
       size_{ static_cast<uint32_t>(1 << width) },
-      data_(size_, 0),
+      dense_{ width > MAX_SPARSE_WIDTH },
+      data_(dense_ ? size_ : 0, 0),
       minIdx_{ size_ },
       maxIdx_{ 0 } {
 
@@ -121,17 +139,14 @@ public:
     uint32_t hash = (uint32_t)nebula::common::Hasher::hash64(data, size);
     uint32_t index = hash >> left_;
     byte_t rank = leadingZeros((hash << width_), left_);
+    if (N_UNLIKELY(!dense_)) {
+      addSparse(index, rank);
+      return;
+    }
+
     if (rank > data_[index]) {
       data_[index] = rank;
-
-      // update the range that seeing values
-      if (index > maxIdx_) {
-        maxIdx_ = index;
-      }
-
-      if (index < minIdx_) {
-        minIdx_ = index;
-      }
+      range(index);
     }
   }
 
@@ -139,11 +154,20 @@ public:
   double estimate() const {
     double sum = 0.0;
     uint32_t zeros = 0;
-    for (uint32_t i = 0; i < size_; ++i) {
-      auto v = data_[i];
-      sum += 1.0 / (1 << v);
-      if (v == 0) {
-        ++zeros;
+    if (!dense_) {
+      // every register not in sparse entries is zero
+      zeros = size_ - sparse_.size();
+      sum = zeros;
+      for (auto e : sparse_) {
+        sum += 1.0 / (1 << (e & RANK_MASK));
+      }
+    } else {
+      for (uint32_t i = 0; i < size_; ++i) {
+        auto v = data_[i];
+        sum += 1.0 / (1 << v);
+        if (v == 0) {
+          ++zeros;
+        }
       }
     }
 
@@ -163,10 +187,22 @@ public:
   // TODO(cao): merge degrades accuracy fast when size is not big enough
   void merge(const HyperLogLog& other) {
     N_ENSURE(size_ == other.size_, "can't merge different sized hll.");
-    for (uint32_t i = other.minIdx_; i < other.maxIdx_; ++i) {
-      if (data_[i] < other.data_[i]) {
-        data_[i] = other.data_[i];
+    if (other.minIdx_ > other.maxIdx_) {
+      return;
+    }
+
+    if (!other.dense_) {
+      if (!dense_) {
+        mergeSparse(other.sparse_);
+      } else {
+        for (auto e : other.sparse_) {
+          const uint32_t index = e >> RANK_BITS;
+          data_[index] = std::max<byte_t>(data_[index], e & RANK_MASK);
+        }
       }
+    } else {
+      densify();
+      maxRegisters(data_.data() + other.minIdx_, other.data_.data() + other.minIdx_, other.maxIdx_ - other.minIdx_ + 1);
     }
 
     // new range seeing values
@@ -174,9 +210,11 @@ public:
     maxIdx_ = std::max(maxIdx_, other.maxIdx_);
   }
 
-  // Clears all internal registers.
+  // Clears all internal registers, a sketch goes back to sparse mode if its width allows
   inline void clear() {
-    std::fill(data_.begin(), data_.end(), 0);
+    dense_ = width_ > MAX_SPARSE_WIDTH;
+    sparse_.clear();
+    data_.assign(dense_ ? size_ : 0, 0);
     minIdx_ = size_;
     maxIdx_ = 0;
   }
@@ -194,11 +232,22 @@ public:
     return maxIdx_;
   }
 
+  inline bool dense() const {
+    return dense_;
+  }
+
+  // non-zero registers as sorted entries of (index << 6 | rank) in sparse mode
+  inline const std::vector<uint32_t>& entries() const {
+    return sparse_;
+  }
+
   // Exchanges the content of the instance
   void swap(HyperLogLog& rhs) {
     std::swap(width_, rhs.width_);
     std::swap(left_, rhs.left_);
     std::swap(size_, rhs.size_);
+    std::swap(dense_, rhs.dense_);
+    std::swap(sparse_, rhs.sparse_);
     std::swap(alpha_, rhs.alpha_);
     std::swap(minIdx_, rhs.minIdx_);
     std::swap(maxIdx_, rhs.maxIdx_);
@@ -207,6 +256,8 @@ public:
 
   // Dump the current status to a stream
   void serialize(std::ostream& os) {
+    densify();
+
     // width recording
     os.write((char*)&width_, sizeof(byte_t));
     os.write((char*)data_.data(), size_);
@@ -218,6 +269,7 @@ public:
     byte_t width = 0;
     is.read((char*)&width, sizeof(byte_t));
     HyperLogLog tempHLL(width);
+    tempHLL.densify();
     is.read((char*)(tempHLL.data_.data()), tempHLL.size_);
     N_ENSURE(!is.fail(), "Failed to deserialize.");
 
@@ -227,7 +279,9 @@ public:
 public:
   // most of the time the matrix is pretty sparse
   // we want to compress it for storing.
+  // dense registers only, sparse sketch should be stored by its entries
   inline std::string_view data() const {
+    N_ENSURE(dense_, "sparse sketch has no dense registers");
     // you should compress at least half
     return std::string_view((char*)data_.data(), size_);
   }
@@ -235,15 +289,118 @@ public:
   // decompress the compressed binary into matrix
   inline void set(const std::string_view& sv, uint32_t minIdx, uint32_t maxIdx) {
     N_ENSURE_EQ(sv.size(), size_, "unexpected size of data to restore");
+    densify();
     std::memcpy((char*)data_.data(), sv.data(), sv.size());
     minIdx_ = minIdx;
     maxIdx_ = maxIdx;
   }
 
+  // restore a sparse sketch from its sorted entries
+  inline void set(std::vector<uint32_t> entries) {
+    N_ENSURE(width_ <= MAX_SPARSE_WIDTH, "sketch is too wide to be sparse");
+    clear();
+    sparse_ = std::move(entries);
+    if (!sparse_.empty()) {
+      minIdx_ = sparse_.front() >> RANK_BITS;
+      maxIdx_ = sparse_.back() >> RANK_BITS;
+    }
+  }
+
+private:
+  inline void range(uint32_t index) {
+    // update the range that seeing values
+    if (index > maxIdx_) {
+      maxIdx_ = index;
+    }
+
+    if (index < minIdx_) {
+      minIdx_ = index;
+    }
+  }
+
+  inline uint32_t limit() const {
+    return size_ / SPARSE_RATIO;
+  }
+
+  void addSparse(uint32_t index, byte_t rank) {
+    const uint32_t key = index << RANK_BITS;
+    auto it = std::lower_bound(sparse_.begin(), sparse_.end(), key);
+    if (it != sparse_.end() && (*it >> RANK_BITS) == index) {
+      // entries of same index are ordered by rank, keep the larger one
+      if (rank > (*it & RANK_MASK)) {
+        *it = key | rank;
+      }
+      return;
+    }
+
+    sparse_.insert(it, key | rank);
+    range(index);
+    if (sparse_.size() > limit()) {
+      densify();
+    }
+  }
+
+  // union two sorted entry lists keeping the max rank for every index
+  void mergeSparse(const std::vector<uint32_t>& other) {
+    std::vector<uint32_t> merged;
+    merged.reserve(sparse_.size() + other.size());
+    auto l = sparse_.cbegin();
+    auto r = other.cbegin();
+    while (l != sparse_.cend() || r != other.cend()) {
+      if (r == other.cend() || (l != sparse_.cend() && (*l >> RANK_BITS) < (*r >> RANK_BITS))) {
+        merged.push_back(*l++);
+      } else if (l == sparse_.cend() || (*r >> RANK_BITS) < (*l >> RANK_BITS)) {
+        merged.push_back(*r++);
+      } else {
+        merged.push_back(std::max(*l++, *r++));
+      }
+    }
+
+    std::swap(sparse_, merged);
+    if (sparse_.size() > limit()) {
+      densify();
+    }
+  }
+
+  // convert sparse entries to dense registers
+  void densify() {
+    if (dense_) {
+      return;
+    }
+
+    data_.assign(size_, 0);
+    for (auto e : sparse_) {
+      data_[e >> RANK_BITS] = e & RANK_MASK;
+    }
+
+    sparse_.clear();
+    sparse_.shrink_to_fit();
+    dense_ = true;
+  }
+
+  // dst[i] = max(dst[i], src[i]) for size registers
+  static inline void maxRegisters(byte_t* dst, const byte_t* src, size_t size) {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 32 <= size; i += 32) {
+      auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+      auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_max_epu8(d, s));
+    }
+#endif
+    for (; i < size; ++i) {
+      dst[i] = std::max(dst[i], src[i]);
+    }
+  }
+
 private:
   byte_t width_;
   byte_t left_;
   uint32_t size_;
+
+  // dense registers are allocated only when sparse entries grow beyond the limit
+  bool dense_;
+  std::vector<uint32_t> sparse_;
   std::vector<byte_t> data_;
 
   double alpha_;
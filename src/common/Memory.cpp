@@ -17,7 +17,12 @@
 #include "Memory.h"
 
 #include <algorithm>
+#include <atomic>
 #include <lz4.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
 
 #include "Bits.h"
 
@@ -29,6 +34,340 @@ Pool& Pool::getDefault() {
   return pool;
 }
 
+namespace {
+
+// set once the cache of current thread is destroyed, chunks freed after that at exit go to system directly
+thread_local bool cacheExited = false;
+
+// bytes of chunks kept by all thread caches
+std::atomic<size_t> cachedBytes{ 0 };
+
+// freed small chunks kept by a thread, up to 2MB in total
+struct ThreadCache {
+  static constexpr size_t CAPACITY = 2 * 1024 * 1024;
+
+  ~ThreadCache() {
+    cacheExited = true;
+    cachedBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    for (auto& list : lists) {
+      for (auto p : list) {
+        std::free(p);
+      }
+    }
+  }
+
+  // a cached chunk of given class, nullptr if none
+  inline void* take(size_t index) noexcept {
+    auto& list = lists[index];
+    if (list.empty()) {
+      return nullptr;
+    }
+
+    auto p = list.back();
+    list.pop_back();
+    const auto size = Pool::classSize(index);
+    bytes -= size;
+    cachedBytes.fetch_sub(size, std::memory_order_relaxed);
+    return p;
+  }
+
+  // keep a chunk of given class if there is room, otherwise return false
+  inline bool keep(void* p, size_t index) {
+    const auto size = Pool::classSize(index);
+    if (bytes + size > CAPACITY) {
+      return false;
+    }
+
+    lists[index].push_back(p);
+    bytes += size;
+    cachedBytes.fetch_add(size, std::memory_order_relaxed);
+    return true;
+  }
+
+  std::array<std::vector<void*>, Pool::CLASSES> lists;
+  size_t bytes = 0;
+};
+
+// nullptr if the cache of current thread is destroyed already
+ThreadCache* threadCache() {
+  if (N_UNLIKELY(cacheExited)) {
+    return nullptr;
+  }
+
+  static thread_local ThreadCache cache;
+  return &cache;
+}
+
+inline void* ensureAllocated(void* p) {
+  if (N_UNLIKELY(p == nullptr)) {
+    throw std::bad_alloc();
+  }
+
+  return p;
+}
+
+// huge chunks are anonymous mappings whose zero pages are mapped lazily by kernel,
+// they grow by remapping their pages on linux rather than copying them, so addresses of pages don't matter
+// and peak memory doesn't double while a large column grows.
+// mapped length of every chunk is kept here since a chunk may be freed with a smaller size.
+class Mappings {
+public:
+  void* map(size_t size, bool huge) {
+    const auto length = round(size);
+    auto p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (N_UNLIKELY(p == MAP_FAILED)) {
+      throw std::bad_alloc();
+    }
+
+    advise(p, length, huge);
+    std::lock_guard<std::mutex> lock(mutex_);
+    lengths_.emplace(p, length);
+    return p;
+  }
+
+  // grow a mapped chunk to hold new size, nullptr if p is not mapped.
+  // pages beyond the old size are never written so they are still zero.
+  void* remap(void* p, size_t size, size_t newSize, bool huge) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto found = lengths_.find(p);
+    if (found == lengths_.end()) {
+      return nullptr;
+    }
+
+    const auto length = found->second;
+    const auto newLength = round(newSize);
+    if (newLength <= length) {
+      return p;
+    }
+
+    lengths_.erase(found);
+    lock.unlock();
+
+#ifdef MREMAP_MAYMOVE
+    auto newP = mremap(p, length, newLength, MREMAP_MAYMOVE);
+    if (N_UNLIKELY(newP == MAP_FAILED)) {
+      munmap(p, length);
+      throw std::bad_alloc();
+    }
+
+    advise(newP, newLength, huge);
+    lock.lock();
+    lengths_.emplace(newP, newLength);
+#else
+    auto newP = map(newSize, huge);
+    std::memcpy(newP, p, size);
+    munmap(p, length);
+#endif
+    return newP;
+  }
+
+  // release pages of a mapped chunk beyond new size, return false if p is not mapped
+  bool trim(void* p, size_t newSize) {
+    size_t length;
+    const auto newLength = round(newSize);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto found = lengths_.find(p);
+      if (found == lengths_.end()) {
+        return false;
+      }
+
+      length = found->second;
+      found->second = std::min(length, newLength);
+    }
+
+    if (newLength < length) {
+      munmap(static_cast<NByte*>(p) + newLength, length - newLength);
+    }
+
+    return true;
+  }
+
+  // unmap a chunk, return false if p is not mapped
+  bool unmap(void* p) {
+    size_t length;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto found = lengths_.find(p);
+      if (found == lengths_.end()) {
+        return false;
+      }
+
+      length = found->second;
+      lengths_.erase(found);
+    }
+
+    munmap(p, length);
+    return true;
+  }
+
+private:
+  static inline size_t round(size_t size) noexcept {
+    static const size_t page = sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+  }
+
+  static inline void advise(void* p, size_t length, bool huge) noexcept {
+#ifdef MADV_HUGEPAGE
+    if (huge) {
+      madvise(p, length, MADV_HUGEPAGE);
+    }
+#endif
+  }
+
+  std::mutex mutex_;
+  std::unordered_map<void*, size_t> lengths_;
+};
+
+// never destructed as chunks may be freed by static objects at exit
+Mappings& mappings() {
+  static auto m = new Mappings();
+  return *m;
+}
+
+// return a chunk to thread cache or system without counting
+inline void release(void* p, size_t size) {
+  if (size > Pool::MAX_SMALL && mappings().unmap(p)) {
+    return;
+  }
+
+  if (size <= Pool::MAX_SMALL) {
+    auto cache = threadCache();
+    if (cache && cache->keep(p, Pool::sizeClass(size))) {
+      return;
+    }
+  }
+
+  std::free(p);
+}
+
+} // namespace
+
+void* Pool::chunk(size_t size) {
+  if (size <= MAX_SMALL) {
+    const auto index = sizeClass(size);
+    auto cache = threadCache();
+    auto p = cache ? cache->take(index) : nullptr;
+    if (p != nullptr) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return std::memset(p, 0, size);
+    }
+
+    return ensureAllocated(std::calloc(1, classSize(index)));
+  }
+
+  if (size >= HUGE_SIZE) {
+    return mappings().map(size, huge_.load(std::memory_order_relaxed));
+  }
+
+  return ensureAllocated(std::calloc(1, size));
+}
+
+void* Pool::allocate(size_t size) {
+  counters(category(size)).allocated.fetch_add(size, std::memory_order_relaxed);
+  return chunk(size);
+}
+
+void Pool::free(void* p, size_t size) {
+  if (p == nullptr) {
+    return;
+  }
+
+  counters(category(size)).freed.fetch_add(size, std::memory_order_relaxed);
+  release(p, size);
+}
+
+void* Pool::extend(void* p, size_t size, size_t newSize) {
+  N_ENSURE_GT(newSize, size, "new size should be larger than original size");
+
+  auto delta = newSize - size;
+  counters(category(newSize)).extended.fetch_add(delta, std::memory_order_relaxed);
+
+  // extend in place if the size class has room for the new size
+  if (size <= MAX_SMALL && newSize <= classSize(sizeClass(size))) {
+    std::memset(static_cast<NByte*>(p) + size, 0, delta);
+    return p;
+  }
+
+  // a huge chunk grows by remapping its pages
+  if (size >= HUGE_SIZE) {
+    auto newP = mappings().remap(p, size, newSize, huge_.load(std::memory_order_relaxed));
+    if (newP != nullptr) {
+      return newP;
+    }
+  }
+
+  // move into a new chunk if it is a small or huge one
+  if (newSize <= MAX_SMALL || newSize >= HUGE_SIZE) {
+    auto newP = chunk(newSize);
+    std::memcpy(newP, p, size);
+    release(p, size);
+    return newP;
+  }
+
+  // extend the memory if possible
+  NByte* newP = (NByte*)std::realloc(p, newSize);
+  if (N_UNLIKELY(!newP)) {
+    free(p, size);
+    throw std::bad_alloc();
+  }
+
+  std::memset(newP + size, 0, delta);
+  return newP;
+}
+
+void* Pool::shrink(void* p, size_t size, size_t newSize) {
+  N_ENSURE_LE(newSize, size, "new size should not be larger than original size");
+  counters(category(size)).freed.fetch_add(size - newSize, std::memory_order_relaxed);
+
+  // mapped pages are released in place
+  if (newSize >= HUGE_SIZE && mappings().trim(p, newSize)) {
+    return p;
+  }
+
+  // nothing saved by a small chunk of the same class
+  if (size <= MAX_SMALL && sizeClass(newSize) == sizeClass(size)) {
+    return p;
+  }
+
+  // a large chunk is usually resized in place
+  if (newSize > MAX_SMALL && size < HUGE_SIZE) {
+    auto newP = std::realloc(p, newSize);
+    return newP == nullptr ? p : newP;
+  }
+
+  auto newP = chunk(newSize);
+  std::memcpy(newP, p, newSize);
+  release(p, size);
+  return newP;
+}
+
+size_t Pool::cached() const noexcept {
+  return cachedBytes.load(std::memory_order_relaxed);
+}
+
+std::string Pool::report() const {
+  size_t allocated = 0;
+  size_t extended = 0;
+  size_t freed = 0;
+  std::string categories;
+  constexpr std::array<std::string_view, 3> NAMES{ "Small", "Large", "Huge" };
+  for (auto category : { PoolCategory::SMALL, PoolCategory::LARGE, PoolCategory::HUGE_PAGE }) {
+    const auto& c = counters(category);
+    const auto a = c.allocated.load(std::memory_order_relaxed);
+    const auto e = c.extended.load(std::memory_order_relaxed);
+    const auto f = c.freed.load(std::memory_order_relaxed);
+    allocated += a;
+    extended += e;
+    freed += f;
+    categories += fmt::format(", {0}:{1}/{2}/{3}", NAMES[static_cast<size_t>(category)], a, e, f);
+  }
+
+  // totals first, then allocated/extended/freed of every category
+  return fmt::format(
+    "Allocated:{0}, Extended:{1}, Freed:{2}, CacheHits:{3}{4}", allocated, extended, freed, hits(), categories);
+}
+
 // append a bytes array of length bytes to position
 size_t ExtendableSlice::write(size_t position, const NByte* data, size_t length) {
   if (N_UNLIKELY(length == 0)) {
@@ -53,18 +392,18 @@ size_t ExtendableSlice::copy(NByte* buffer, size_t offset, size_t length) const
 }
 
 void ExtendableSlice::seal(size_t usage) {
-  static constexpr auto MAX_WASTE = 4096;
-  if (ownbuffer_) {
-    auto wasted = size() - usage;
-    if (wasted >= usage || wasted >= MAX_WASTE) {
-      // Do we need alignment here to improvement fragmentation?
-      auto buffer = pool_.allocate(usage);
-      N_ENSURE_NOT_NULL(buffer, "buffer is null - allocation failed.");
-      std::memcpy(buffer, ptr_, usage);
-      pool_.free(static_cast<void*>(ptr_), size_);
-      ptr_ = static_cast<NByte*>(buffer);
-      size_ = usage;
-    }
+  // pool moves the values only if a smaller chunk saves memory
+  if (ownbuffer_ && ptr_ != nullptr && usage < size_) {
+    ptr_ = static_cast<NByte*>(pool_.shrink(ptr_, size_, usage));
+    size_ = usage;
+  }
+}
+
+void ExtendableSlice::release() {
+  if (ownbuffer_ && ptr_ != nullptr) {
+    pool_.free(static_cast<void*>(ptr_), size_);
+    ptr_ = nullptr;
+    size_ = 0;
   }
 }
 
@@ -124,6 +463,19 @@ size_t ExtendableSlice::readBits(size_t pos, int bits) const {
   return value;
 }
 
+// every paged slice gets a unique id, 0 is never used so an empty cursor matches no slice
+static size_t nextSliceId() {
+  static std::atomic<size_t> sequence{ 0 };
+  return ++sequence;
+}
+
+PagedSlice::PagedSlice(size_t size, folly::io::CodecType type)
+  : Slice{ size },
+    id_{ nextSliceId() },
+    write_{ 0, 0 },
+    type_{ type },
+    codec_{ folly::io::getCodec(type) } {}
+
 size_t PagedSlice::write(size_t position, const NByte* data, size_t size) {
   // case like empty string
   if (size == 0) {
@@ -144,7 +496,7 @@ size_t PagedSlice::write(size_t position, const NByte* data, size_t size) {
   return size;
 }
 
-std::string_view PagedSlice::read(size_t position, size_t size) const {
+std::string_view PagedSlice::read(Cursor& cursor, size_t position, size_t size) const {
   if (size == 0) {
     return PagedSlice::EMPTY_STRING;
   }
@@ -156,24 +508,38 @@ std::string_view PagedSlice::read(size_t position, size_t size) const {
     }
   }
 
-  // because we make sure every single element is captured in single block
-  // so we don't have single item across block
-  if (N_UNLIKELY(!bufferPtr_ || !blocks_.at(bid_).range.include(position))) {
-    uncompress(position);
+  // note that, we're returning a string view on top of the cursor buffer
+  // which is possible to be swapped by next read of the cursor
+  // hence it requires client to consume it before next read, or corrupted data may happen
+  const auto& range = load(cursor, position);
+  const auto offset = position - range.offset;
+  if (N_LIKELY(offset + size <= range.size)) {
+    return std::string_view((char*)cursor.ptr + offset, size);
   }
 
-  // build data using copy elision
-  // note that, we're returning a string view on top of current buffer
-  // which is possible to be swapped by next read
-  // hence it requires client to consume it before next read, or corrupted data may happen
-  return std::string_view((char*)bufferPtr_ + position - blocks_.at(bid_).range.offset, size);
+  // an item written in pieces may be laid across pages, copy its pieces into the spill buffer
+  auto& spill = cursor.spill;
+  spill.clear();
+  while (spill.size() < size) {
+    const auto pos = position + spill.size();
+    if (this->ptr_ != nullptr && write_.include(pos)) {
+      spill.append((char*)this->ptr_ + pos - write_.offset, size - spill.size());
+      break;
+    }
+
+    const auto& r = load(cursor, pos);
+    const auto from = pos - r.offset;
+    spill.append((char*)cursor.ptr + from, std::min<size_t>(size - spill.size(), r.size - from));
+  }
+
+  return spill;
 }
 
 // ensure the buffer is big enough to hold single item
 void PagedSlice::ensure(size_t size) {
-  if (N_UNLIKELY(size >= size_)) {
+  if (N_UNLIKELY(size > size_)) {
     size_t newSize = size_;
-    while (newSize <= size) {
+    while (newSize < size) {
       newSize *= 2;
     }
 
@@ -230,55 +596,36 @@ void PagedSlice::compress(size_t position) {
 }
 
 // uncompress the compression block covers given position
-// and load it into current buffer (ptr_)
-void PagedSlice::uncompress(size_t position) const {
-  // search the block that includes the position
-  // assuming we don't have a lot of blocks to iterate,
-  // otherwise this linear loop might require optimization for fast locating.
-  // LOG(INFO) << "search the block from " << blocks_.size() << " blocks for " << position;
-  // use binary search to locate the block
-  size_t low = 0;
-  size_t high = blocks_.size() - 1;
-  auto i = bid_;
-  auto pos = (int64_t)position;
-
-  while (low <= high) {
-    const auto& block = blocks_.at(i);
-    if (block.range.include(position)) {
-      break;
-    }
-
-    // search low band or high band
-    auto delta = pos - block.range.offset;
-    if (delta < 0) {
-      high = i - 1;
-    } else if (delta >= block.range.size) {
-      low = i + 1;
-    }
-
-    i = (high + low) / 2;
-  }
-
-  // TODO(cao) - sorry to use const_cast here as we want to keep read interfaces as const methods
-  N_ENSURE(high >= low, "position not found");
-  *const_cast<size_t*>(&bid_) = i;
-
-  const auto& block = blocks_.at(i);
+// and load it into the cursor, the slice itself is never changed by reads
+void PagedSlice::uncompress(Cursor& cursor, size_t position) const {
+  // blocks are ordered by offset, search the last block starting at or before the position
+  auto it = std::upper_bound(blocks_.begin(), blocks_.end(), position, [](size_t pos, const CompressionBlock& b) {
+    return pos < b.range.offset;
+  });
+  N_ENSURE(it != blocks_.begin() && (it - 1)->range.include(position), "position not found");
+
+  const auto& block = *(--it);
+  cursor.owner = id_;
+  cursor.bid = it - blocks_.begin();
   if (N_UNLIKELY(block.compressed)) {
     // prepare the read buffer for this block
-    if (buffer_ == nullptr || buffer_->size() < block.range.size) {
-      auto buffer = std::make_unique<OneSlice>(block.range.size);
-      buffer.swap(const_cast<std::unique_ptr<OneSlice>&>(buffer_));
+    auto& buffer = cursor.buffer;
+    if (buffer == nullptr || buffer->size() < block.range.size) {
+      buffer = std::make_unique<OneSlice>(block.range.size);
     }
 
-    auto ret = (uint32_t)LZ4_decompress_safe((char*)block.data->ptr(), (char*)buffer_->ptr(), block.data->size(), buffer_->size());
+    auto ret = (uint32_t)LZ4_decompress_safe((char*)block.data->ptr(), (char*)buffer->ptr(), block.data->size(), buffer->size());
     N_ENSURE_EQ(ret, block.range.size, "raw data size mismatches.");
-    *const_cast<NByte**>(&bufferPtr_) = buffer_->ptr();
+    cursor.ptr = buffer->ptr();
   } else {
-    *const_cast<NByte**>(&bufferPtr_) = block.data->ptr();
+    cursor.ptr = block.data->ptr();
   }
+}
 
-} // namespace common
+PagedSlice::Cursor& PagedSlice::cursor() const {
+  thread_local std::array<Cursor, CURSORS> cursors;
+  return cursors[id_ % CURSORS];
+}
 
 } // namespace common
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <folly/compression/Compression.h>
 #include <glog/logging.h>
 #include <iostream>
@@ -46,51 +48,125 @@
 namespace nebula {
 namespace common {
 
+// categories of pool chunks by size
+enum class PoolCategory : uint8_t {
+  // size classes served by per-thread caches of freed chunks
+  SMALL = 0,
+  // below huge page size, allocated by calloc which maps zero pages lazily
+  LARGE = 1,
+  // huge page size or larger, mapped pages advised to be transparent huge pages and remapped to grow
+  HUGE_PAGE = 2
+};
+
 // maintain a memory pool tracking memory chunks
-// it gurantees memory are set to 0 for all allocated chunks through `memset`.
+// it gurantees memory are set to 0 for all allocated chunks.
+// Small chunks are rounded up to size classes (4 classes per power of 2), a freed small chunk is cached
+// in the free list of its class by the freeing thread, to be reused by the next allocation of the class.
+// A chunk can be freed with a size equal to or smaller than its allocated (or extended) size.
 class Pool {
+  // counters of one category, updated by all threads
+  struct Counters {
+    std::atomic<size_t> allocated{ 0 };
+    std::atomic<size_t> extended{ 0 };
+    std::atomic<size_t> freed{ 0 };
+  };
+
 public:
+  // largest size served by size classes, and the number of classes (64B ~ 64KB)
+  static constexpr size_t MAX_SMALL = 64 * 1024;
+  static constexpr size_t CLASSES = 41;
+  // chunks of this size or larger are mapped pages
+  static constexpr size_t HUGE_SIZE = 2 * 1024 * 1024;
+
   virtual ~Pool() = default;
 
-  inline void* allocate(size_t size) {
-    allocated_ += size;
-    return std::memset(std::malloc(size), 0, size);
+  void* allocate(size_t size);
+
+  void free(void* p, size_t size);
+
+  void* extend(void* p, size_t size, size_t newSize);
+
+  // reduce a chunk to new size, the chunk is moved only if a smaller one saves memory
+  void* shrink(void* p, size_t size, size_t newSize);
+
+  // advise huge pages for huge chunks or not, enabled by default
+  inline void hugePages(bool enabled) noexcept {
+    huge_.store(enabled, std::memory_order_relaxed);
   }
 
-  inline void free(void* p, size_t size) {
-    freed_ += size;
-    std::free(p);
+  inline size_t allocated(PoolCategory category) const noexcept {
+    return counters(category).allocated.load(std::memory_order_relaxed);
   }
 
-  void* extend(void* p, size_t size, size_t newSize) {
-    N_ENSURE_GT(newSize, size, "new size should be larger than original size");
+  inline size_t extended(PoolCategory category) const noexcept {
+    return counters(category).extended.load(std::memory_order_relaxed);
+  }
+
+  inline size_t freed(PoolCategory category) const noexcept {
+    return counters(category).freed.load(std::memory_order_relaxed);
+  }
+
+  // number of small allocations served by thread caches
+  inline size_t hits() const noexcept {
+    return hits_.load(std::memory_order_relaxed);
+  }
+
+  // bytes of freed small chunks held by thread caches, allocated from system but not in use
+  size_t cached() const noexcept;
+
+  std::string report() const;
 
-    // extend the memory if possible
-    NByte* newP = (NByte*)std::realloc(p, newSize);
-    if (N_UNLIKELY(!newP)) {
-      free(p, size);
-      throw std::bad_alloc();
+  static Pool& getDefault();
+
+  // category of a chunk size
+  static inline PoolCategory category(size_t size) noexcept {
+    if (size <= MAX_SMALL) {
+      return PoolCategory::SMALL;
     }
 
-    auto delta = newSize - size;
-    extended_ += delta;
-    std::memset(newP + size, 0, delta);
-    return newP;
+    return size < HUGE_SIZE ? PoolCategory::LARGE : PoolCategory::HUGE_PAGE;
   }
 
-  std::string report() const {
-    return fmt::format("Allocated:{0}, Extended:{1}, Freed:{2}", allocated_, extended_, freed_);
+  // size class index of a small size: 64, 80, 96, 112, 128, 160, 192, 224, 256, 320...
+  static inline size_t sizeClass(size_t size) noexcept {
+    if (size <= 64) {
+      return 0;
+    }
+
+    // base < size <= 2 * base, every base is split into 4 steps
+    const size_t bits = 63 - __builtin_clzll(size - 1);
+    const size_t step = (size_t)1 << (bits - 2);
+    return (bits - 6) * 4 + ((size - ((size_t)1 << bits)) + step - 1) / step;
   }
 
-  static Pool& getDefault();
+  // chunk size of a size class
+  static inline size_t classSize(size_t index) noexcept {
+    if (index == 0) {
+      return 64;
+    }
+
+    const auto group = (index - 1) / 4;
+    const auto step = (index - 1) % 4 + 1;
+    return ((size_t)64 << group) + step * ((size_t)16 << group);
+  }
 
 private:
-  // TODO(cao): a start point of pool impl, need a better pool management
-  Pool() : allocated_{ 0 }, extended_{ 0 }, freed_{ 0 } {}
+  Pool() : huge_{ true }, hits_{ 0 } {}
+
+  inline Counters& counters(PoolCategory category) noexcept {
+    return counters_[static_cast<size_t>(category)];
+  }
 
-  size_t allocated_;
-  size_t extended_;
-  size_t freed_;
+  inline const Counters& counters(PoolCategory category) const noexcept {
+    return counters_[static_cast<size_t>(category)];
+  }
+
+  // a zeroed chunk of given size
+  void* chunk(size_t size);
+
+  std::array<Counters, 3> counters_;
+  std::atomic<bool> huge_;
+  std::atomic<size_t> hits_;
 };
 
 enum class SliceType {
@@ -241,9 +317,12 @@ public:
   // copy current slice data into a given buffer
   size_t copy(NByte*, size_t, size_t) const;
 
-  // seal the slice - reduce memory if unused
+  // seal the slice - reduce memory to its usage
   void seal(size_t);
 
+  // release all memory of the slice when its data is kept somewhere else
+  void release();
+
 private:
   // ensure capacity of memory allocation
   template <bool CHECK = false>
@@ -361,6 +440,30 @@ class PagedSlice;
 using PRange = Range<ExtendableSlice>;
 using CRange = Range<PagedSlice>;
 
+// write an unsigned integer in 7 bits per byte at given offset, return bytes written
+inline size_t writeVarint(ExtendableSlice& slice, size_t offset, uint64_t value) {
+  size_t bytes = 0;
+  while (value >= 0x80) {
+    bytes += slice.write(offset + bytes, static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+
+  bytes += slice.write(offset + bytes, static_cast<uint8_t>(value));
+  return bytes;
+}
+
+// read an unsigned integer written by writeVarint, offset is moved after it
+inline uint64_t readVarint(const ExtendableSlice& slice, size_t& offset) {
+  uint64_t value = 0;
+  for (size_t shift = 0;; shift += 7) {
+    const auto byte = slice.read<uint8_t>(offset++);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
 // compression buffer will manage a fixed size buffer
 // to receive input writes, when the buffer is full, it will compress it
 // and output the compressed bytes into the designated slice, reset the buffer.
@@ -373,20 +476,28 @@ struct CompressionBlock {
   std::unique_ptr<OneSlice> data;
 };
 
-// TODO(cao) - not thread-safe unless introducing thread-local state management
-// Or introduce special read interface to allow caller manager reading block state
+// A paged slice keeps its data in LZ4 compressed pages, it is written once and then sealed.
+// Pages are immutable once written, so a sealed slice can be read by many threads at the same time:
+// every reader decodes pages into its own cursor, either given by the caller or a thread local one by default.
 class PagedSlice : public Slice {
   static constexpr auto EMPTY_STRING = "";
 
 public:
-  PagedSlice(size_t size, folly::io::CodecType type = folly::io::CodecType::LZ4)
-    : Slice{ size },
-      write_{ 0, 0 },
-      bid_{ 0 },
-      bufferPtr_{ nullptr },
-      type_{ type },
-      codec_{ folly::io::getCodec(type) } {
-  }
+  // reader state of a paged slice: the page loaded and its raw bytes
+  struct Cursor {
+    // id of the slice which the loaded page belongs to
+    size_t owner = 0;
+    size_t bid = 0;
+    const NByte* ptr = nullptr;
+
+    // raw bytes of the loaded page if it is compressed
+    std::unique_ptr<OneSlice> buffer;
+
+    // bytes of an item laid across pages
+    std::string spill;
+  };
+
+  PagedSlice(size_t size, folly::io::CodecType type = folly::io::CodecType::LZ4);
   ~PagedSlice() = default;
 
 public:
@@ -413,34 +524,48 @@ public:
     return size;
   }
 
-  // total memory allocation for current slice
+  // total memory allocation for current slice, pages loaded by readers are owned by their cursors
   inline size_t size() const {
-    // 2*size_ to count for the read/write buffers
-    return std::accumulate(blocks_.begin(), blocks_.end(), 2 * size_, [](size_t init, const CompressionBlock& b) {
+    return std::accumulate(blocks_.begin(), blocks_.end(), ptr_ ? size_ : 0, [](size_t init, const CompressionBlock& b) {
       return init + b.data->size();
     });
   }
 
-  // read a scalar type
+  // read a scalar type through given cursor
   template <typename T>
-  typename std::enable_if<std::is_scalar<T>::value, T>::type read(size_t position) const {
+  typename std::enable_if<std::is_scalar<T>::value, T>::type read(Cursor& cursor, size_t position) const {
     if (N_UNLIKELY(this->ptr_ != nullptr)) {
       if (write_.include(position)) {
         return *reinterpret_cast<T*>(this->ptr_ + position - write_.offset);
       }
     }
 
-    // check if position is in current range
-    if (N_UNLIKELY(!bufferPtr_ || !blocks_.at(bid_).range.include(position))) {
-      uncompress(position);
+    // buffer index = position - range.offset
+    const auto& range = load(cursor, position);
+    const auto offset = position - range.offset;
+    if (N_LIKELY(offset + sizeof(T) <= range.size)) {
+      return *reinterpret_cast<const T*>(cursor.ptr + offset);
     }
 
-    // buffer index = position - range.offset
-    return *reinterpret_cast<T*>(bufferPtr_ + position - blocks_.at(bid_).range.offset);
+    // the value is laid across pages
+    T value;
+    std::memcpy(&value, read(cursor, position, sizeof(T)).data(), sizeof(T));
+    return value;
   }
 
-  // read a string
-  std::string_view read(size_t, size_t) const;
+  // read a scalar type through the cursor of current thread
+  template <typename T>
+  inline typename std::enable_if<std::is_scalar<T>::value, T>::type read(size_t position) const {
+    return read<T>(cursor(), position);
+  }
+
+  // read a string through given cursor, the view is valid until the cursor reads another page
+  std::string_view read(Cursor&, size_t, size_t) const;
+
+  // read a string through the cursor of current thread
+  inline std::string_view read(size_t position, size_t size) const {
+    return read(cursor(), position, size);
+  }
 
   // seal the slice and no more writes expected
   void seal();
@@ -453,11 +578,28 @@ private:
   // recording the data range for this block [x-index_, x]
   void compress(size_t);
 
-  // uncompress the compression block covers given position
-  // and load it into current buffer (ptr_)
-  void uncompress(size_t) const;
+  // the range of the page covering given position, the page is loaded into the cursor if not yet
+  inline const CRange& load(Cursor& cursor, size_t position) const {
+    if (N_UNLIKELY(cursor.owner != id_ || !cursor.ptr || !blocks_[cursor.bid].range.include(position))) {
+      uncompress(cursor, position);
+    }
+
+    return blocks_[cursor.bid].range;
+  }
+
+  // uncompress the compression block covers given position into the cursor
+  void uncompress(Cursor&, size_t) const;
+
+  // thread local cursor for this slice, shared with slices of the same slot only,
+  // so views of up to CURSORS slices created in a row can be held by a thread at the same time
+  Cursor& cursor() const;
 
 private:
+  static constexpr size_t CURSORS = 16;
+
+  // unique id of this slice to identify its pages in cursors
+  const size_t id_;
+
   // write index in current buffer
   CRange write_;
 
@@ -465,16 +607,6 @@ private:
   // we should keep number of blocks as small as possible, ideal size <32
   std::vector<CompressionBlock> blocks_;
 
-  // TODO(cao) - not thread-safe as every thread can modify it
-  // indicating a current block index in blocks_
-  size_t bid_;
-
-  // a buffer used for hold raw data of any uncompressed block
-  std::unique_ptr<OneSlice> buffer_;
-  // the buffer pointer may point to buffer_ which holds uncompressed data
-  // or pointing to the original buffer itself if it's not compressed
-  NByte* bufferPtr_;
-
   // the codec used to compress the buffer
   folly::io::CodecType type_;
   std::unique_ptr<folly::io::Codec> codec_;
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Metrics.h"
+
+#include <fmt/format.h>
+
+#include "Errors.h"
+
+/**
+ * Implement process metrics.
+ */
+namespace nebula {
+namespace common {
+
+Histogram::Histogram(std::vector<size_t> bounds)
+  : bounds_{ std::move(bounds) },
+    counts_{ std::make_unique<std::atomic<size_t>[]>(bounds_.size() + 1) },
+    sum_{ 0 } {
+  for (size_t i = 1; i < bounds_.size(); ++i) {
+    N_ENSURE_GT(bounds_[i], bounds_[i - 1], "histogram bounds are ascending");
+  }
+}
+
+void Histogram::expose(std::string& out, const std::string& name, const std::string& labels) const {
+  // bucket labels are appended to the series labels
+  const auto prefix = labels.empty() ? std::string{ "{" } : labels.substr(0, labels.size() - 1) + ",";
+  size_t total = 0;
+  for (size_t i = 0; i <= bounds_.size(); ++i) {
+    total += counts_[i].load(std::memory_order_relaxed);
+    const auto le = i < bounds_.size() ? std::to_string(bounds_[i]) : "+Inf";
+    out.append(fmt::format("{0}_bucket{1}le=\"{2}\"}} {3}\n", name, prefix, le, total));
+  }
+
+  out.append(fmt::format("{0}_sum{1} {2}\n", name, labels, sum_.load(std::memory_order_relaxed)));
+  out.append(fmt::format("{0}_count{1} {2}\n", name, labels, total));
+}
+
+const std::vector<size_t>& Metrics::latencyMs() {
+  static const std::vector<size_t> BOUNDS{ 1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000 };
+  return BOUNDS;
+}
+
+Metrics& Metrics::singleton() {
+  static Metrics METRICS;
+  return METRICS;
+}
+
+Metrics::Series& Metrics::series(const std::string& name,
+                                 const std::string& help,
+                                 const char* type,
+                                 const std::string& labels) {
+  // caller holds the lock
+  auto& family = families_[name];
+  if (family.type.empty()) {
+    family.help = help;
+    family.type = type;
+  }
+
+  N_ENSURE_EQ(family.type, type, fmt::format("metric {0} is registered as {1}", name, family.type));
+  auto& s = family.series[labels];
+  if (!s) {
+    s = std::make_unique<Series>();
+  }
+
+  return *s;
+}
+
+std::atomic<size_t>& Metrics::counter(const std::string& name, const std::string& help, const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return series(name, help, "counter", labels).counter;
+}
+
+void Metrics::counter(const std::string& name,
+                      const std::string& help,
+                      std::function<double()> value,
+                      const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  series(name, help, "counter", labels).read = std::move(value);
+}
+
+void Metrics::gauge(const std::string& name,
+                    const std::string& help,
+                    std::function<double()> value,
+                    const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  series(name, help, "gauge", labels).read = std::move(value);
+}
+
+Histogram& Metrics::histogram(const std::string& name,
+                              const std::string& help,
+                              const std::string& labels,
+                              const std::vector<size_t>& bounds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& s = series(name, help, "histogram", labels);
+  if (!s.histogram) {
+    s.histogram = std::make_unique<Histogram>(bounds);
+  }
+
+  return *s.histogram;
+}
+
+std::string Metrics::expose() const {
+  std::string out;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& [name, family] : families_) {
+    out.append(fmt::format("# HELP {0} {1}\n# TYPE {0} {2}\n", name, family.help, family.type));
+    for (const auto& [labels, s] : family.series) {
+      if (s->histogram) {
+        s->histogram->expose(out, name, labels);
+      } else if (s->read) {
+        out.append(fmt::format("{0}{1} {2}\n", name, labels, s->read()));
+      } else {
+        out.append(fmt::format("{0}{1} {2}\n", name, labels, s->counter.load(std::memory_order_relaxed)));
+      }
+    }
+  }
+
+  return out;
+}
+
+} // namespace common
+} // namespace nebula
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Process metrics in Prometheus text exposition format, scraped by monitoring for capacity planning and autoscaling.
+ * A metric is a family by its name having one series per label set, such as `{phase="filter"}`.
+ * Counters and histograms are updated by the code owning them, gauges are read by their callbacks at scrape.
+ * A counter kept by its owner elsewhere, such as memory pool counters, is read by its callback too.
+ * Series are registered once and never removed, so a reference to a counter or histogram can be held for fast updates.
+ */
+namespace nebula {
+namespace common {
+
+// histogram of values by fixed upper bounds, observed concurrently
+class Histogram {
+public:
+  explicit Histogram(std::vector<size_t> bounds);
+  virtual ~Histogram() = default;
+
+  inline void observe(size_t value) noexcept {
+    size_t i = 0;
+    while (i < bounds_.size() && value > bounds_[i]) {
+      ++i;
+    }
+
+    counts_[i].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  // buckets are cumulative, the last one (+Inf) is the total count
+  void expose(std::string& out, const std::string& name, const std::string& labels) const;
+
+private:
+  const std::vector<size_t> bounds_;
+  std::unique_ptr<std::atomic<size_t>[]> counts_;
+  std::atomic<size_t> sum_;
+};
+
+class Metrics final {
+public:
+  // default bounds of latency histograms in milliseconds
+  static const std::vector<size_t>& latencyMs();
+
+  static Metrics& singleton();
+
+public:
+  // counter of the name and labels, created at its first use
+  std::atomic<size_t>& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+
+  // counter of the name and labels kept elsewhere and read by the callback
+  void counter(const std::string& name,
+               const std::string& help,
+               std::function<double()> value,
+               const std::string& labels = "");
+
+  // gauge of the name and labels read by the callback, a later one replaces the former of the same series
+  void gauge(const std::string& name,
+             const std::string& help,
+             std::function<double()> value,
+             const std::string& labels = "");
+
+  // histogram of the name and labels, created at its first use with given bounds
+  Histogram& histogram(const std::string& name,
+                       const std::string& help,
+                       const std::string& labels = "",
+                       const std::vector<size_t>& bounds = latencyMs());
+
+  // all metrics in text exposition format
+  std::string expose() const;
+
+private:
+  struct Series {
+    std::atomic<size_t> counter{ 0 };
+    std::function<double()> read;
+    std::unique_ptr<Histogram> histogram;
+  };
+
+  struct Family {
+    std::string help;
+    std::string type;
+    // series by labels, in order for stable output
+    std::map<std::string, std::unique_ptr<Series>> series;
+  };
+
+  Series& series(const std::string&, const std::string&, const char*, const std::string&);
+
+private:
+  mutable std::mutex mutex_;
+  std::map<std::string, Family> families_;
+};
+
+} // namespace common
+} // namespace nebula
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Numa.h"
+
+#include <fmt/format.h>
+#include <fstream>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+DEFINE_bool(NUMA, true, "place blocks and their computes on NUMA nodes of a multi-socket machine");
+
+/**
+ * Implement NUMA topology and placement by linux sysfs and syscalls, no libnuma needed.
+ */
+namespace nebula {
+namespace common {
+
+namespace {
+
+// node preferred by memory policy of current thread
+thread_local int preferred = Numa::ANY;
+
+// parse a cpu or node list such as "0-3,8-11"
+std::vector<size_t> parseList(const std::string& text) {
+  std::vector<size_t> list;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    auto end = text.find(',', pos);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+
+    const auto item = text.substr(pos, end - pos);
+    const auto dash = item.find('-');
+    try {
+      if (dash == std::string::npos) {
+        list.push_back(std::stoul(item));
+      } else {
+        for (auto i = std::stoul(item.substr(0, dash)), last = std::stoul(item.substr(dash + 1)); i <= last; ++i) {
+          list.push_back(i);
+        }
+      }
+    } catch (const std::exception&) {
+      // malformed item is ignored
+    }
+
+    pos = end + 1;
+  }
+
+  return list;
+}
+
+std::string readLine(const std::string& file) {
+  std::ifstream input(file);
+  std::string line;
+  std::getline(input, line);
+  return line;
+}
+
+} // namespace
+
+Numa& Numa::singleton() {
+  static Numa NUMA;
+  return NUMA;
+}
+
+Numa::Numa() : next_{ 0 } {
+#ifdef __linux__
+  if (FLAGS_NUMA) {
+    constexpr auto SYS_NODE = "/sys/devices/system/node/";
+    for (auto node : parseList(readLine(fmt::format("{0}online", SYS_NODE)))) {
+      auto cpus = parseList(readLine(fmt::format("{0}node{1}/cpulist", SYS_NODE, node)));
+      // node ids are expected to be dense, a node without cpu (memory only) is not used
+      if (node != cpus_.size() || cpus.empty()) {
+        break;
+      }
+
+      cpus_.push_back(std::move(cpus));
+    }
+  }
+#endif
+
+  // a single node of all cpus otherwise
+  if (cpus_.size() < 2 || cpus_.size() > 64) {
+    cpus_.clear();
+    std::vector<size_t> all(std::max(1u, std::thread::hardware_concurrency()));
+    for (size_t i = 0; i < all.size(); ++i) {
+      all[i] = i;
+    }
+
+    cpus_.push_back(std::move(all));
+  }
+
+  for (size_t node = 0; node < cpus_.size(); ++node) {
+    for (auto cpu : cpus_[node]) {
+      if (cpu >= nodeOf_.size()) {
+        nodeOf_.resize(cpu + 1, 0);
+      }
+
+      nodeOf_[cpu] = node;
+    }
+  }
+
+  LOG(INFO) << "NUMA nodes: " << cpus_.size();
+}
+
+size_t Numa::current() const noexcept {
+#ifdef __linux__
+  if (enabled()) {
+    const auto cpu = sched_getcpu();
+    if (cpu >= 0 && static_cast<size_t>(cpu) < nodeOf_.size()) {
+      return nodeOf_[cpu];
+    }
+  }
+#endif
+
+  return 0;
+}
+
+size_t Numa::home() const noexcept {
+  return preferred == ANY ? current() : preferred;
+}
+
+bool Numa::pin(size_t node) const noexcept {
+#ifdef __linux__
+  if (enabled() && node < nodes()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus_[node]) {
+      CPU_SET(cpu, &set);
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+  }
+#endif
+
+  return false;
+}
+
+bool Numa::prefer(int node) const noexcept {
+#ifdef __linux__
+  if (enabled() && node < static_cast<int>(nodes())) {
+    unsigned long mask = node == ANY ? 0 : 1UL << node;
+    const auto done = node == ANY
+                        ? syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0) == 0
+                        : syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, nodes() + 1) == 0;
+    if (done) {
+      preferred = node;
+    }
+
+    return done;
+  }
+#endif
+
+  return false;
+}
+
+Numa::Scope::Scope(size_t node) : last_{ preferred } {
+  auto& numa = Numa::singleton();
+  if (!numa.enabled()) {
+    return;
+  }
+
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+    for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        affinity_.push_back(cpu);
+      }
+    }
+  }
+#endif
+
+  numa.prefer(node);
+  numa.pin(node);
+}
+
+Numa::Scope::~Scope() {
+  auto& numa = Numa::singleton();
+  if (!numa.enabled()) {
+    return;
+  }
+
+  numa.prefer(last_);
+#ifdef __linux__
+  if (!affinity_.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : affinity_) {
+      CPU_SET(cpu, &set);
+    }
+
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#endif
+}
+
+} // namespace common
+} // namespace nebula
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+/**
+ * NUMA topology of the machine and placement of the calling thread.
+ * On a multi-socket machine, memory of a block is placed on one NUMA node while it is built, and its block
+ * computes run on threads pinned to cpus of the same node, so that scans read local memory.
+ * Pages of a block are placed by the memory policy of the building thread: pool chunks are zero pages mapped
+ * lazily, they land on the preferred node when they are first written.
+ * It is a single node without any effect on a machine without NUMA, on a non-linux system, or if disabled (--NUMA).
+ */
+namespace nebula {
+namespace common {
+
+class Numa final {
+public:
+  static constexpr int ANY = -1;
+
+  static Numa& singleton();
+
+public:
+  // number of NUMA nodes
+  inline size_t nodes() const noexcept {
+    return cpus_.size();
+  }
+
+  inline bool enabled() const noexcept {
+    return nodes() > 1;
+  }
+
+  // cpus of a node
+  inline const std::vector<size_t>& cpus(size_t node) const {
+    return cpus_.at(node);
+  }
+
+  // node of the cpu the calling thread runs on
+  size_t current() const noexcept;
+
+  // node which new memory of the calling thread belongs to: the preferred one in a scope, otherwise current one
+  size_t home() const noexcept;
+
+  // next node in round robin to build a block on
+  inline size_t next() noexcept {
+    return nodes() > 1 ? next_.fetch_add(1, std::memory_order_relaxed) % nodes() : 0;
+  }
+
+  // pin the calling thread to cpus of a node, return false if not pinned
+  bool pin(size_t node) const noexcept;
+
+  // place new pages of the calling thread on the node, or by default policy if ANY
+  bool prefer(int node) const noexcept;
+
+  // memory of the calling thread is placed on a node and the thread runs on it within a scope,
+  // placements of the thread are restored when the scope ends
+  class Scope {
+  public:
+    explicit Scope(size_t node);
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope();
+
+  private:
+    int last_;
+    std::vector<size_t> affinity_;
+  };
+
+private:
+  Numa();
+
+  std::vector<std::vector<size_t>> cpus_;
+  // node of every cpu
+  std::vector<size_t> nodeOf_;
+  std::atomic<size_t> next_;
+};
+
+} // namespace common
+} // namespace nebula
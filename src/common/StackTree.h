@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <cstring>
 #include <fmt/format.h>
 #include <iostream>
 #include <queue>
@@ -23,6 +24,7 @@
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include "Arena.h"
 #include "Hash.h"
 
 namespace nebula {
@@ -32,130 +34,71 @@ namespace common {
 // it merges any given path (usually call stack) into a tree with weighted nodes
 // for example, [A, B, C] + [A, B, D] => (A.2, B.2, [C.1, D.1])
 // a stack is represented by a vector/list.
-// TODO(cao) - consider extending type/Tree.h to support this with efficient data structure
-// We provide two implementations: HashFrame and VectorFrame using hash table and vector each
-// VectorFrame can be optimized further by binary search with maintained order.
+// All frames of a tree are allocated from its own arena, and frame strings are interned in the tree,
+// so a frame is a few words linked to its first child and next sibling, siblings are sorted by data.
+// Two trees are merged by walking their sorted siblings side by side and recursing into matched frames.
+// When hash is set, the tree also keeps one index of (parent, data) => frame to find a child in constant time.
 template <typename T>
-struct HashFrame {
-  explicit HashFrame(const T& d, size_t dep, size_t c = 1)
-    : data{ d }, depth{ dep }, count{ c } {
-  }
-
-  using RAW_PTR = HashFrame<T>*;
-  using PTR = typename std::unique_ptr<HashFrame<T>>;
-  struct Hash {
-  public:
-    size_t operator()(const PTR& ptr) const {
-      return h_(ptr->data);
-    }
-
-  private:
-    std::hash<T> h_;
-  };
-
-  struct Equal {
-  public:
-    bool operator()(const PTR& p1, const PTR& p2) const {
-      return p1->data == p2->data;
-    }
-  };
+struct StackFrame {
+  StackFrame(const T& d, size_t dep, size_t c)
+    : data{ d }, depth{ dep }, count{ c }, child{ nullptr }, next{ nullptr } {}
 
   const T data;
   const size_t depth;
   size_t count;
-  unordered_set<PTR, Hash, Equal> children;
-
-  // add child if not found existing
-  RAW_PTR addIfNotFound(const T& d, size_t dep) {
-    auto ptr = std::make_unique<HashFrame>(d, dep, 0);
-    auto found = children.find(ptr);
-    if (found != children.end()) {
-      return (*found).get();
-    } else {
-      // insert this new node and set current to it
-      return (*children.insert(std::move(ptr)).first).get();
-    }
-  }
 
-  RAW_PTR find(const T& d) const noexcept {
-    auto ptr = std::make_unique<HashFrame>(d, 0);
-    auto found = children.find(ptr);
-
-    if (found != children.end()) {
-      return (*found).get();
-    }
-
-    return nullptr;
-  }
-
-  // insert a new child
-  void add(PTR p) {
-    children.insert(std::move(p));
-  }
+  // first child and next sibling
+  StackFrame* child;
+  StackFrame* next;
 };
 
-template <typename T>
-struct VectorFrame {
-  explicit VectorFrame(const T& d, size_t dep, size_t c = 1)
-    : data{ d }, depth{ dep }, count{ c } {
-  }
+// T - element type, usually string for stack trace
+// hash - index children by a hash table in addition to sorted siblings
+// rf - input stack is root first/top (icicle) or root bottom (flame)
+template <typename T, bool hash = false, bool rf = true>
+class StackTree {
+  static constexpr bool STR = std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+  using DT = std::conditional_t<STR, std::string_view, T>;
+  using FT = StackFrame<DT>;
+  using ST = typename std::vector<T>;
 
-  using RAW_PTR = VectorFrame<T>*;
-  using PTR = typename std::unique_ptr<VectorFrame<T>>;
+  // child index key, interned strings are identified by their address
+  struct Key {
+    const FT* parent;
+    DT data;
 
-  const T data;
-  const size_t depth;
-  size_t count;
-  std::vector<PTR> children;
-
-  // API
-  RAW_PTR addIfNotFound(const T& d, size_t dep) noexcept {
-    auto found = std::find_if(std::begin(children), std::end(children), [&d](const auto& i) {
-      return i->data == d;
-    });
-    if (found != children.end()) {
-      return (*found).get();
-    } else {
-      // insert this new node and set current to it
-      return (*children.insert(children.cend(), std::make_unique<VectorFrame>(d, dep, 0))).get();
+    inline bool operator==(const Key& other) const noexcept {
+      if constexpr (STR) {
+        return parent == other.parent && data.data() == other.data.data();
+      } else {
+        return parent == other.parent && data == other.data;
+      }
     }
-  }
+  };
 
-  RAW_PTR find(const T& d) const noexcept {
-    auto found = std::find_if(std::begin(children), std::end(children), [&d](const auto& i) {
-      return i->data == d;
-    });
+  struct KeyHash {
+    inline size_t operator()(const Key& key) const noexcept {
+      size_t h;
+      if constexpr (STR) {
+        h = std::hash<const void*>()(key.data.data());
+      } else {
+        h = std::hash<DT>()(key.data);
+      }
 
-    if (found != children.end()) {
-      return (*found).get();
+      return h ^ (std::hash<const void*>()(key.parent) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
     }
-
-    return nullptr;
-  }
-
-  // insert a new child
-  void add(PTR p) noexcept {
-    children.push_back(std::move(p));
-  }
-};
-
-// T - element type, usually string for stack trace
-// hash - use hash set or vector as internal store
-// rf - input stack is root first/top (icicle) or root bottom (flame)
-template <typename T, bool hash = false, bool rf = true>
-class StackTree {
-  using FT = std::conditional_t<hash, HashFrame<T>, VectorFrame<T>>;
-  using ST = typename std::vector<T>;
+  };
 
 public:
   // build a stack tree object from a json blob
-  StackTree(const std::string_view& json) {
+  StackTree(const std::string_view& json) : StackTree() {
     parse(json);
   }
 
   // construct a new stack tree
   StackTree()
-    : root_{ std::make_unique<FT>(T{}, 0, 0) } {}
+    : arena_{ std::make_unique<Arena>(ARENA_BLOCK) },
+      root_{ frame(intern(DT{}), 0, 0) } {}
   virtual ~StackTree() = default;
 
 public:
@@ -166,7 +109,7 @@ public:
 
     // layer by layer search, counting if found, otherwise a new frame added
     // for stack, root is at the bottom.
-    FT* current = root_.get();
+    FT* current = root_;
 
     if constexpr (rf) {
       for (size_t i = 0; i < stack.size(); ++i) {
@@ -195,7 +138,7 @@ public:
     // otherwise, for root first, we can process without buffer/copy
     // root always gets vote
     ++root_->count;
-    FT* current = root_.get();
+    FT* current = root_;
     std::string line;
     while (std::getline(text, line)) {
       current = visit(current, line);
@@ -217,19 +160,24 @@ public:
     return buffer.GetString();
   }
 
+  // bytes allocated for frames and strings of this tree
+  inline size_t allocated() const noexcept {
+    return arena_->allocated();
+  }
+
   // print as lines of strings in alphabatic order - debug/test purpose only
   friend std::ostream& operator<<(std::ostream& os, const StackTree& tree) noexcept {
-    std::queue<FT*> q;
-    q.push(tree.root_.get());
+    std::queue<const FT*> q;
+    q.push(tree.root_);
     std::vector<std::string> lines;
     while (!q.empty()) {
-      FT* p = q.front();
+      const FT* p = q.front();
       lines.push_back(fmt::format("NODE: d={0}, c={1}, l={2}", p->data, p->count, p->depth));
 
       // pop current and push all its children
       q.pop();
-      for (auto itr = p->children.begin(); itr != p->children.end(); ++itr) {
-        q.push((*itr).get());
+      for (auto c = p->child; c != nullptr; c = c->next) {
+        q.push(c);
       }
     }
 
@@ -243,8 +191,10 @@ public:
   }
 
 private:
+  static constexpr size_t ARENA_BLOCK = 16 * 1024;
+
   // jsonfy current object
-  void jsonfy(FT& obj, rapidjson::Writer<rapidjson::StringBuffer>& json, size_t threshold) const noexcept {
+  void jsonfy(const FT& obj, rapidjson::Writer<rapidjson::StringBuffer>& json, size_t threshold) const noexcept {
     // threshold indicates minial value to be serialized
     if (obj.count < threshold) {
       return;
@@ -255,7 +205,7 @@ private:
 
     // data field
     json.Key("name");
-    if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+    if constexpr (STR) {
       json.String(obj.data.data(), obj.data.size());
     } else if constexpr (std::is_integral_v<T>) {
       json.Int(obj.data);
@@ -268,11 +218,11 @@ private:
     json.Int(obj.count);
 
     // all children
-    if (obj.children.size() > 0) {
+    if (obj.child != nullptr) {
       json.Key("children");
       json.StartArray();
-      for (auto& item : obj.children) {
-        jsonfy(*item, json, threshold);
+      for (auto c = obj.child; c != nullptr; c = c->next) {
+        jsonfy(*c, json, threshold);
       }
       json.EndArray();
     }
@@ -281,22 +231,31 @@ private:
     json.EndObject();
   }
 
-  std::unique_ptr<FT> parse(const rapidjson::GenericObject<false, rapidjson::Value>& obj, size_t depth) {
-    std::unique_ptr<FT> ptr = nullptr;
-    if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
-      ptr = std::make_unique<FT>(obj["name"].GetString(), depth, obj["value"].GetInt());
+  FT* parse(const rapidjson::GenericObject<false, rapidjson::Value>& obj, FT* parent, size_t depth) {
+    FT* ptr = nullptr;
+    const size_t count = obj["value"].GetInt();
+    if constexpr (STR) {
+      const auto& name = obj["name"];
+      ptr = frame(intern(std::string_view(name.GetString(), name.GetStringLength())), depth, count);
     } else if constexpr (std::is_integral_v<T>) {
-      ptr = std::make_unique<FT>(obj["name"].GetInt(), depth, obj["value"].GetInt());
+      ptr = frame(obj["name"].GetInt(), depth, count);
     } else {
       throw NException("Type not supported for data");
     }
 
     if (obj.HasMember("children")) {
+      // children are serialized in order, so each is usually appended after the last
+      FT* last = nullptr;
       for (auto& child : obj["children"].GetArray()) {
-        ptr->add(parse(child.GetObject(), depth + 1));
+        auto c = parse(child.GetObject(), ptr, depth + 1);
+        last = link(ptr, c, last);
       }
     }
 
+    if (parent != nullptr) {
+      index(parent, ptr);
+    }
+
     return ptr;
   }
 
@@ -308,45 +267,146 @@ private:
     }
 
     const auto& root = cd.GetObject();
-    root_ = parse(root, 0);
+    root_ = parse(root, nullptr, 0);
+  }
+
+  // new frame allocated from the arena, frames are trivially destructible so they are released with the arena
+  inline FT* frame(const DT& data, size_t depth, size_t count) {
+    static_assert(std::is_trivially_destructible_v<FT>, "frames are never destructed");
+    return new (arena_->allocate(sizeof(FT), alignof(FT))) FT(data, depth, count);
+  }
+
+  // a copy of given string in the arena, shared by all frames having the same value
+  inline DT intern(const DT& data) {
+    if constexpr (STR) {
+      auto found = strings_.find(data);
+      if (found != strings_.end()) {
+        return *found;
+      }
+
+      auto chars = static_cast<char*>(arena_->allocate(data.size(), 1));
+      if (data.size() > 0) {
+        std::memcpy(chars, data.data(), data.size());
+      }
+      std::string_view interned(chars, data.size());
+      strings_.insert(interned);
+      return interned;
+    } else {
+      return data;
+    }
+  }
+
+  inline void index(FT* parent, FT* child) {
+    if constexpr (hash) {
+      children_.emplace(Key{ parent, child->data }, child);
+    }
+  }
+
+  // link child into sorted siblings of parent, search from hint (a sibling before child) if given
+  // return the child
+  static FT* link(FT* parent, FT* child, FT* hint = nullptr) {
+    FT** slot = &parent->child;
+    if (hint != nullptr && hint->data < child->data) {
+      slot = &hint->next;
+    }
+
+    while (*slot != nullptr && (*slot)->data < child->data) {
+      slot = &(*slot)->next;
+    }
+
+    child->next = *slot;
+    *slot = child;
+    return child;
   }
 
-  static FT* visit(FT* current, const T& data) {
-    current = current->addIfNotFound(data, current->depth + 1);
+  // find child of given data under parent, or a new child is added
+  FT* child(FT* parent, const DT& data) {
+    if constexpr (hash) {
+      // index is keyed by interned strings
+      const auto interned = intern(data);
+      auto found = children_.find(Key{ parent, interned });
+      if (found != children_.end()) {
+        return found->second;
+      }
+
+      auto c = frame(interned, parent->depth + 1, 0);
+      index(parent, c);
+      return link(parent, c);
+    } else {
+      FT** slot = &parent->child;
+      while (*slot != nullptr && (*slot)->data < data) {
+        slot = &(*slot)->next;
+      }
+
+      if (*slot != nullptr && (*slot)->data == data) {
+        return *slot;
+      }
+
+      auto c = frame(intern(data), parent->depth + 1, 0);
+      c->next = *slot;
+      *slot = c;
+      return c;
+    }
+  }
+
+  inline FT* visit(FT* current, const DT& data) {
+    current = child(current, data);
     ++current->count;
     return current;
   }
 
-  // copy the whole branch represented by child into target
-  static typename FT::PTR copy(const FT& child) {
-    auto node = std::make_unique<FT>(child.data, child.depth, child.count);
-    for (auto& n : child.children) {
-      node->add(copy(*n));
+  // copy the whole branch represented by source into this tree
+  FT* copy(const FT& source) {
+    auto node = frame(intern(source.data), source.depth, source.count);
+    FT** tail = &node->child;
+    for (auto c = source.child; c != nullptr; c = c->next) {
+      // source siblings are sorted already
+      auto n = copy(*c);
+      index(node, n);
+      *tail = n;
+      tail = &n->next;
     }
 
     return node;
   }
 
-  // merge frame source into target
-  static void merge(FT& target, const FT& source) {
+  // merge frame source into target by walking their sorted children side by side
+  void merge(FT& target, const FT& source) {
     N_ENSURE(target.depth == source.depth, "merge nodes at the same level");
     target.count += source.count;
 
-    // check all elements, if found in target, merge that nodes
-    // otherwies, build up the whole sub tree in target
-    for (auto& node : source.children) {
-      auto ptr = target.find(node->data);
-      if (ptr) {
-        merge(*ptr, *node);
+    // matched children are merged recursively
+    // otherwies, the whole sub tree is copied in place
+    FT** slot = &target.child;
+    for (auto s = source.child; s != nullptr; s = s->next) {
+      while (*slot != nullptr && (*slot)->data < s->data) {
+        slot = &(*slot)->next;
+      }
+
+      if (*slot != nullptr && (*slot)->data == s->data) {
+        merge(**slot, *s);
       } else {
-        target.add(copy(*node));
+        auto n = copy(*s);
+        index(&target, n);
+        n->next = *slot;
+        *slot = n;
       }
+
+      slot = &(*slot)->next;
     }
   }
 
 private:
-  std::unique_ptr<FT> root_;
+  std::unique_ptr<Arena> arena_;
+
+  // interned strings of all frames
+  unordered_set<std::string_view> strings_;
+
+  // (parent, data) => child when hash is set
+  unordered_map<Key, FT*, KeyHash> children_;
+
+  FT* root_;
 };
 
 } // namespace common
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * A 16 bytes head of a string value laid out as [size: 4 bytes][data: 12 bytes].
+ * A string of at most 12 bytes is stored in data as a whole, padded with zeros.
+ * Otherwise data keeps its first 4 bytes as prefix, followed by 8 bytes offset of the string in a heap.
+ * Equality and order of strings are mostly decided by their heads without touching the heap.
+ */
+namespace nebula {
+namespace common {
+
+struct StringHead {
+  static constexpr uint32_t INLINE = 12;
+  static constexpr uint32_t PREFIX = 4;
+
+  uint32_t size;
+  char data[INLINE];
+
+  static inline StringHead make(std::string_view value, uint64_t offset) noexcept {
+    StringHead head{};
+    head.size = value.size();
+    if (head.inlined()) {
+      std::memcpy(head.data, value.data(), value.size());
+    } else {
+      std::memcpy(head.data, value.data(), PREFIX);
+      std::memcpy(head.data + PREFIX, &offset, sizeof(offset));
+    }
+
+    return head;
+  }
+
+  inline bool inlined() const noexcept {
+    return size <= INLINE;
+  }
+
+  // the whole string if it is inlined
+  inline std::string_view view() const noexcept {
+    return { data, size };
+  }
+
+  // heap offset of a string not inlined
+  inline uint64_t offset() const noexcept {
+    uint64_t offset;
+    std::memcpy(&offset, data + PREFIX, sizeof(offset));
+    return offset;
+  }
+
+  // equals target whose head is given, heap returns a string not inlined by its head
+  template <typename H>
+  inline bool equals(const StringHead& target, std::string_view value, H&& heap) const {
+    // size and prefix are compared as one word, inlined strings are compared by the rest word
+    uint64_t left[2];
+    uint64_t right[2];
+    std::memcpy(left, this, sizeof(left));
+    std::memcpy(right, &target, sizeof(right));
+    if (left[0] != right[0]) {
+      return false;
+    }
+
+    return inlined() ? left[1] == right[1] : heap(*this) == value;
+  }
+
+  // three-way compare with target value, the heap is read only if prefix can't decide it
+  template <typename H>
+  inline int compare(std::string_view value, H&& heap) const {
+    const auto common = std::min<size_t>({ PREFIX, size, value.size() });
+    const auto c = common > 0 ? std::memcmp(data, value.data(), common) : 0;
+    if (c != 0) {
+      return c;
+    }
+
+    return inlined() ? view().compare(value) : heap(*this).compare(value);
+  }
+};
+
+static_assert(sizeof(StringHead) == 16, "string head is 16 bytes");
+
+} // namespace common
+} // namespace nebula
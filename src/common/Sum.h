@@ -0,0 +1,188 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "Int128.h"
+#include "Likely.h"
+
+/**
+ * Accumulators summing a stream of numbers correctly at native speed.
+ * - SafeSum adds integers in int64, an overflowed addition keeps its carry in int128, so the total is exact
+ *   and the wide type is only touched when a sum crosses int64 range.
+ * - FloatSum adds floating numbers with Neumaier compensation, so the total doesn't depend on the magnitude
+ *   or order of its parts as plain summation does.
+ * Both take a run of contiguous values by a kernel summing a block into independent lanes first,
+ * the loops are branch-free so that compiler can vectorize them.
+ */
+namespace nebula {
+namespace common {
+
+class SafeSum {
+  // values summed in lanes of a block before they are added to the total
+  static constexpr size_t LANES = 8;
+  static constexpr size_t BLOCK = 1024;
+  static constexpr int128_t WRAP = static_cast<int128_t>(1) << 64;
+
+public:
+  explicit SafeSum(int64_t value = 0) : sum_{ value }, carry_{ 0 } {}
+
+  inline void add(int64_t v) noexcept {
+    // a wrapped sum is off by 2^64 in the direction of the value
+    if (N_UNLIKELY(__builtin_add_overflow(sum_, v, &sum_))) {
+      carry_ += v > 0 ? WRAP : -WRAP;
+    }
+  }
+
+  inline void add(const SafeSum& other) noexcept {
+    add(other.sum_);
+    carry_ += other.carry_;
+  }
+
+  // sum a run of integers, null values are expected to be 0
+  template <typename T>
+  void add(const T* values, size_t size) noexcept {
+    static_assert(std::is_integral_v<T> && sizeof(T) <= sizeof(int64_t), "integers up to 64 bits");
+    for (size_t start = 0; start < size; start += BLOCK) {
+      const auto end = std::min(size, start + BLOCK);
+      int64_t lanes[LANES] = {};
+      bool overflow = false;
+      size_t i = start;
+      for (; i + LANES <= end; i += LANES) {
+        for (size_t l = 0; l < LANES; ++l) {
+          if constexpr (sizeof(T) < sizeof(int64_t)) {
+            // a block of narrow values never overflows a lane
+            lanes[l] += values[i + l];
+          } else {
+            overflow |= __builtin_add_overflow(lanes[l], static_cast<int64_t>(values[i + l]), &lanes[l]);
+          }
+        }
+      }
+
+      // a block overflowing its lanes adds its values one by one, it is rare enough
+      if (N_UNLIKELY(overflow)) {
+        for (size_t k = start; k < end; ++k) {
+          add(static_cast<int64_t>(values[k]));
+        }
+        continue;
+      }
+
+      for (size_t l = 0; l < LANES; ++l) {
+        add(lanes[l]);
+      }
+
+      for (; i < end; ++i) {
+        add(static_cast<int64_t>(values[i]));
+      }
+    }
+  }
+
+  // exact total
+  inline int128_t value() const noexcept {
+    return carry_ + sum_;
+  }
+
+  inline bool wide() const noexcept {
+    return carry_ != 0;
+  }
+
+  // total in int64, a total out of its range is clamped to the closest bound rather than wrapped
+  inline int64_t narrow() const noexcept {
+    if (N_LIKELY(carry_ == 0)) {
+      return sum_;
+    }
+
+    return carry_ > 0 ? std::numeric_limits<int64_t>::max() : std::numeric_limits<int64_t>::min();
+  }
+
+private:
+  int64_t sum_;
+  int128_t carry_;
+};
+
+class FloatSum {
+  static constexpr size_t LANES = 8;
+  static constexpr size_t BLOCK = 256;
+
+public:
+  explicit FloatSum(double value = 0) : sum_{ value }, comp_{ 0 } {}
+
+  // compensation is only correct if the compiler keeps order of floating operations, release builds may
+  // reassociate them for fast math
+#ifndef __clang__
+  __attribute__((optimize("no-fast-math")))
+#endif
+  inline void
+    add(double v) noexcept {
+    const auto t = sum_ + v;
+    if (std::fabs(sum_) >= std::fabs(v)) {
+      comp_ += (sum_ - t) + v;
+    } else {
+      comp_ += (v - t) + sum_;
+    }
+
+    sum_ = t;
+  }
+
+  inline void add(const FloatSum& other) noexcept {
+    add(other.sum_);
+    add(other.comp_);
+  }
+
+  // sum a run of floating numbers, a block is summed by lanes reduced pairwise and then added with compensation
+  template <typename T>
+  void add(const T* values, size_t size) noexcept {
+    static_assert(std::is_floating_point_v<T>, "floating numbers");
+    for (size_t start = 0; start < size; start += BLOCK) {
+      const auto end = std::min(size, start + BLOCK);
+      double lanes[LANES] = {};
+      size_t i = start;
+      for (; i + LANES <= end; i += LANES) {
+        for (size_t l = 0; l < LANES; ++l) {
+          lanes[l] += values[i + l];
+        }
+      }
+
+      for (size_t width = LANES / 2; width > 0; width /= 2) {
+        for (size_t l = 0; l < width; ++l) {
+          lanes[l] += lanes[l + width];
+        }
+      }
+
+      add(lanes[0]);
+      for (; i < end; ++i) {
+        add(static_cast<double>(values[i]));
+      }
+    }
+  }
+
+  inline double value() const noexcept {
+    return sum_ + comp_;
+  }
+
+private:
+  double sum_;
+  double comp_;
+};
+
+} // namespace common
+} // namespace nebula
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "common/Memory.h"
+
+/**
+ * A merging t-digest to estimate quantiles.
+ * It follows the same compression (scale function) as folly::TDigest, but:
+ * - values and other digests are merged in place by reference, two sorted streams are merged in one pass
+ *   into a scratch buffer which is swapped with centroids, so no temporary digest is built for every merge.
+ * - serialized form is compact: centroid weights are counts written as varint, count is derived from them.
+ */
+namespace nebula {
+namespace common {
+
+class TDigest {
+public:
+  struct Centroid {
+    double mean;
+    double weight;
+
+    inline void add(double m, double w) noexcept {
+      weight += w;
+      mean += w * (m - mean) / weight;
+    }
+  };
+
+public:
+  explicit TDigest(size_t compression = 100)
+    : compression_{ compression },
+      count_{ 0 },
+      sum_{ 0 },
+      min_{ std::numeric_limits<double>::infinity() },
+      max_{ -std::numeric_limits<double>::infinity() } {}
+  virtual ~TDigest() = default;
+
+  // merge a batch of values, the batch is sorted in place so caller can reuse it as a buffer
+  void add(std::vector<double>& values) {
+    if (values.empty()) {
+      return;
+    }
+
+    std::sort(values.begin(), values.end());
+    for (auto v : values) {
+      sum_ += v;
+    }
+
+    count_ += values.size();
+    min_ = std::min(min_, values.front());
+    max_ = std::max(max_, values.back());
+    compress(values.size(), [&values](size_t i) { return Centroid{ values[i], 1 }; });
+  }
+
+  // merge another digest by reference
+  void merge(const TDigest& other) {
+    if (other.empty()) {
+      return;
+    }
+
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    const auto& centroids = other.centroids_;
+    compress(centroids.size(), [&centroids](size_t i) { return centroids[i]; });
+  }
+
+  // estimate value at quantile q in [0, 1]
+  double quantile(double q) const {
+    if (empty()) {
+      return 0;
+    }
+
+    const auto size = centroids_.size();
+    const auto rank = q * count_;
+    size_t pos = 0;
+    double t = 0;
+    if (q > 0.5) {
+      if (q >= 1) {
+        return max_;
+      }
+
+      t = count_;
+      for (size_t i = size; i > 0; --i) {
+        t -= centroids_[i - 1].weight;
+        if (rank >= t) {
+          pos = i - 1;
+          break;
+        }
+      }
+    } else {
+      if (q <= 0) {
+        return min_;
+      }
+
+      pos = size - 1;
+      for (size_t i = 0; i < size; ++i) {
+        if (rank < t + centroids_[i].weight) {
+          pos = i;
+          break;
+        }
+
+        t += centroids_[i].weight;
+      }
+    }
+
+    // interpolate within the centroid by its neighbors
+    double delta = 0;
+    double low = min_;
+    double high = max_;
+    if (size > 1) {
+      if (pos == 0) {
+        delta = centroids_[1].mean - centroids_[0].mean;
+        high = centroids_[1].mean;
+      } else if (pos == size - 1) {
+        delta = centroids_[pos].mean - centroids_[pos - 1].mean;
+        low = centroids_[pos - 1].mean;
+      } else {
+        delta = (centroids_[pos + 1].mean - centroids_[pos - 1].mean) / 2;
+        low = centroids_[pos - 1].mean;
+        high = centroids_[pos + 1].mean;
+      }
+    }
+
+    const auto& c = centroids_[pos];
+    auto value = c.mean + ((rank - t) / c.weight - 0.5) * delta;
+    return std::clamp(value, low, high);
+  }
+
+  inline bool empty() const noexcept {
+    return centroids_.empty();
+  }
+
+  inline double count() const noexcept {
+    return count_;
+  }
+
+  inline double sum() const noexcept {
+    return sum_;
+  }
+
+  inline double min() const noexcept {
+    return min_;
+  }
+
+  inline double max() const noexcept {
+    return max_;
+  }
+
+  inline size_t compression() const noexcept {
+    return compression_;
+  }
+
+  inline const std::vector<Centroid>& centroids() const noexcept {
+    return centroids_;
+  }
+
+  // serialize into a slice at given offset, return bytes written
+  size_t serialize(ExtendableSlice& slice, size_t offset) const {
+    const auto origin = offset;
+    offset += slice.write(offset, static_cast<uint32_t>(compression_));
+    offset += slice.write(offset, static_cast<uint32_t>(centroids_.size()));
+    offset += slice.write(offset, sum_);
+    offset += slice.write(offset, min_);
+    offset += slice.write(offset, max_);
+    for (const auto& c : centroids_) {
+      offset += slice.write(offset, c.mean);
+      offset += writeVarint(slice, offset, static_cast<uint64_t>(c.weight));
+    }
+
+    return offset - origin;
+  }
+
+  // load from a slice at given offset, return bytes consumed
+  size_t load(const ExtendableSlice& slice, size_t offset) {
+    const auto origin = offset;
+    compression_ = slice.read<uint32_t>(offset);
+    offset += sizeof(uint32_t);
+    const auto size = slice.read<uint32_t>(offset);
+    offset += sizeof(uint32_t);
+
+#define READ(NAME)                   \
+  NAME = slice.read<double>(offset); \
+  offset += sizeof(double);
+
+    READ(sum_)
+    READ(min_)
+    READ(max_)
+
+    count_ = 0;
+    centroids_.resize(size);
+    for (auto& c : centroids_) {
+      READ(c.mean)
+      c.weight = readVarint(slice, offset);
+      count_ += c.weight;
+    }
+
+#undef READ
+    return offset - origin;
+  }
+
+private:
+  // folly's scale function: the k-th centroid can hold weights up to quantile k_to_q(k) of total count
+  inline double limit(size_t k) const noexcept {
+    const auto kd = static_cast<double>(k) / compression_;
+    if (kd >= 0.5) {
+      const auto base = 1 - kd;
+      return 1 - 2 * base * base;
+    }
+
+    return 2 * kd * kd;
+  }
+
+  // merge sorted centroids given by a reader with current centroids into scratch, then swap them
+  // count_ already includes weights of the new centroids
+  template <typename R>
+  void compress(size_t size, R read) {
+    scratch_.clear();
+    scratch_.reserve(std::min(compression_, centroids_.size() + size));
+
+    size_t k = 1;
+    double limitWeight = limit(k++) * count_;
+
+    const auto total = centroids_.size();
+    size_t left = 0;
+    size_t right = 0;
+    auto next = [&]() -> Centroid {
+      if (right >= size || (left < total && centroids_[left].mean <= read(right).mean)) {
+        return centroids_[left++];
+      }
+
+      return read(right++);
+    };
+
+    Centroid current = next();
+    double weightSoFar = current.weight;
+    while (left < total || right < size) {
+      const auto c = next();
+      weightSoFar += c.weight;
+      if (weightSoFar <= limitWeight) {
+        current.add(c.mean, c.weight);
+        continue;
+      }
+
+      scratch_.push_back(current);
+      current = c;
+      limitWeight = limit(k++) * count_;
+    }
+
+    scratch_.push_back(current);
+    std::swap(centroids_, scratch_);
+  }
+
+private:
+  size_t compression_;
+  double count_;
+  double sum_;
+  double min_;
+  double max_;
+  std::vector<Centroid> centroids_;
+
+  // buffer for the next compression, swapped with centroids so both allocations are reused
+  std::vector<Centroid> scratch_;
+};
+
+} // namespace common
+} // namespace nebula
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * A specialized time parser for fixed width time layouts such as "%Y-%m-%d %H:%M:%S" or ISO-8601 "%FT%T".
+ * A pattern is compiled once into a layout of digit fields and literal chars, then a value is validated
+ * 8 bytes at a time (SWAR) against the layout and converted to unix seconds by civil date arithmetic,
+ * no stream, locale or allocation is involved.
+ * Patterns with variable width or named fields (%b, %p, %z...) are not compiled, the caller falls back to
+ * Evidence::time for them as well as for values not matching the layout.
+ */
+namespace nebula {
+namespace common {
+
+class TimeParser {
+  // layouts wider than this are not worth a fixed layout
+  static constexpr size_t WIDTH = 32;
+  static constexpr size_t WORDS = WIDTH / sizeof(uint64_t);
+  static constexpr int8_t NONE = -1;
+
+public:
+  // compile a pattern into a fixed layout, return empty if the pattern is not supported
+  static std::optional<TimeParser> make(const std::string& pattern) noexcept {
+    TimeParser parser;
+    size_t width = 0;
+    auto digits = [&parser, &width](int8_t& field, size_t count) {
+      if (field != NONE || width + count > WIDTH) {
+        return false;
+      }
+
+      field = width;
+      for (size_t i = 0; i < count; ++i) {
+        parser.mask_[width] = (char)0xFF;
+        parser.text_[width++] = '0';
+      }
+
+      return true;
+    };
+
+    auto literal = [&parser, &width](char c) {
+      if (width >= WIDTH) {
+        return false;
+      }
+
+      parser.text_[width++] = c;
+      return true;
+    };
+
+    // expand short forms %F and %T
+    for (size_t i = 0, size = pattern.size(); i < size; ++i) {
+      const auto c = pattern[i];
+      if (c != '%') {
+        if (!literal(c)) {
+          return std::nullopt;
+        }
+        continue;
+      }
+
+      if (++i >= size) {
+        return std::nullopt;
+      }
+
+      bool ok = true;
+      switch (pattern[i]) {
+      case 'Y': ok = digits(parser.year_, 4); break;
+      case 'm': ok = digits(parser.month_, 2); break;
+      case 'd': ok = digits(parser.day_, 2); break;
+      case 'H': ok = digits(parser.hour_, 2); break;
+      case 'M': ok = digits(parser.minute_, 2); break;
+      case 'S': ok = digits(parser.second_, 2); break;
+      case 'F': {
+        ok = digits(parser.year_, 4) && literal('-') && digits(parser.month_, 2) && literal('-')
+             && digits(parser.day_, 2);
+        break;
+      }
+      case 'T': {
+        ok = digits(parser.hour_, 2) && literal(':') && digits(parser.minute_, 2) && literal(':')
+             && digits(parser.second_, 2);
+        break;
+      }
+      case '%': ok = literal('%'); break;
+      default: ok = false;
+      }
+
+      if (!ok) {
+        return std::nullopt;
+      }
+    }
+
+    // a date is required, time of day is optional
+    if (parser.year_ == NONE || parser.month_ == NONE || parser.day_ == NONE) {
+      return std::nullopt;
+    }
+
+    parser.width_ = width;
+    for (size_t w = 0; w < WORDS; ++w) {
+      std::memcpy(&parser.digitWords_[w], parser.mask_.data() + w * 8, 8);
+      uint64_t text;
+      std::memcpy(&text, parser.text_.data() + w * 8, 8);
+      parser.literalWords_[w] = text & ~parser.digitWords_[w];
+    }
+
+    return parser;
+  }
+
+  // parse a value into unix seconds (GMT), return false if it doesn't match the layout
+  // chars following the layout (such as fraction of seconds or 'Z') are ignored, as date::parse does
+  bool parse(const std::string_view value, int64_t& seconds) const noexcept {
+    if (value.size() < width_) {
+      return false;
+    }
+
+    // zero padded copy on stack so the whole layout is checked in full words
+    std::array<char, WIDTH> buffer{};
+    std::memcpy(buffer.data(), value.data(), width_);
+
+    constexpr uint64_t ZEROS = 0x3030303030303030ULL;
+    constexpr uint64_t HIGHS = 0x8080808080808080ULL;
+    constexpr uint64_t ABOVE = 0x4646464646464646ULL;
+    const auto words = (width_ + 7) / 8;
+    for (size_t w = 0; w < words; ++w) {
+      uint64_t word;
+      std::memcpy(&word, buffer.data() + w * 8, 8);
+      const auto digits = digitWords_[w];
+      if ((word & ~digits) != literalWords_[w]) {
+        return false;
+      }
+
+      // literal bytes are replaced by '0' so every byte of the word has to be in ['0', '9']
+      const auto check = (word & digits) | (ZEROS & ~digits);
+      if (((check + ABOVE) | (check - ZEROS)) & HIGHS) {
+        return false;
+      }
+    }
+
+    const auto* s = buffer.data();
+    const int64_t year = number(s + year_, 4);
+    const int64_t month = number(s + month_, 2);
+    const int64_t day = number(s + day_, 2);
+    const int64_t hour = hour_ == NONE ? 0 : number(s + hour_, 2);
+    const int64_t minute = minute_ == NONE ? 0 : number(s + minute_, 2);
+    const int64_t second = second_ == NONE ? 0 : number(s + second_, 2);
+    if (month < 1 || month > 12 || day < 1 || day > monthDays(year, month) || hour > 23 || minute > 59
+        || second > 59) {
+      return false;
+    }
+
+    seconds = ((days(year, month, day) * 24 + hour) * 60 + minute) * 60 + second;
+    return true;
+  }
+
+  inline size_t width() const noexcept {
+    return width_;
+  }
+
+  // days since 1970-01-01 of a civil date, from Howard Hinnant's days_from_civil
+  static constexpr int64_t days(int64_t y, int64_t m, int64_t d) noexcept {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+  }
+
+private:
+  TimeParser()
+    : width_{ 0 }, year_{ NONE }, month_{ NONE }, day_{ NONE }, hour_{ NONE }, minute_{ NONE }, second_{ NONE } {
+    text_.fill(0);
+    mask_.fill(0);
+  }
+
+  static inline int64_t number(const char* s, size_t count) noexcept {
+    int64_t v = 0;
+    for (size_t i = 0; i < count; ++i) {
+      v = v * 10 + (s[i] - '0');
+    }
+    return v;
+  }
+
+  static constexpr int64_t monthDays(int64_t y, int64_t m) noexcept {
+    constexpr int64_t DAYS[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    const bool leap = (y % 4 == 0) && (y % 100 != 0 || y % 400 == 0);
+    return DAYS[m - 1] + (m == 2 && leap);
+  }
+
+private:
+  size_t width_;
+
+  // offset of every field in the layout
+  int8_t year_;
+  int8_t month_;
+  int8_t day_;
+  int8_t hour_;
+  int8_t minute_;
+  int8_t second_;
+
+  // expected chars and digit positions of the layout
+  std::array<char, WIDTH> text_;
+  std::array<char, WIDTH> mask_;
+  std::array<uint64_t, WORDS> digitWords_;
+  std::array<uint64_t, WORDS> literalWords_;
+};
+
+} // namespace common
+} // namespace nebula
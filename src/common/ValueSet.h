@@ -0,0 +1,154 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "common/Hash.h"
+
+/**
+ * A read-only set of values for membership tests such as "column IN (...)".
+ * Its layout is picked by the number and density of values:
+ * - a few values are scanned linearly, the compare over a small array has no branch and is vectorized by compiler.
+ * - dense integers are bits of a bitmap over [min, max], a test is one subtraction and one bit read.
+ * - other values are in a hash set.
+ * Values are kept sorted and unique in any layout, so that min, max and every value can be visited too.
+ */
+namespace nebula {
+namespace common {
+
+template <typename T>
+class ValueSet {
+  static constexpr bool INTEGRAL = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+public:
+  enum class Layout : int8_t { SCAN = 0, BITMAP = 1, HASH = 2 };
+
+  // values scanned linearly at most
+  static constexpr size_t SCAN_MAX = 16;
+  // a bitmap takes no more bits per value than this, and 2^30 bits (128MB) in total
+  static constexpr size_t BITS_PER_VALUE = 64;
+  static constexpr uint64_t BITMAP_MAX_BITS = 1UL << 30;
+
+  template <typename I>
+  ValueSet(I begin, I end) : values_(begin, end), layout_{ Layout::SCAN } {
+    std::sort(values_.begin(), values_.end());
+    values_.erase(std::unique(values_.begin(), values_.end()), values_.end());
+    const auto size = values_.size();
+    if (size <= SCAN_MAX) {
+      return;
+    }
+
+    if constexpr (INTEGRAL) {
+      // span is max - min in unsigned arithmetic, values out of [min, max] wraps to a larger offset
+      const auto span = offset(values_.back());
+      if (span < BITMAP_MAX_BITS && span < BITS_PER_VALUE * size) {
+        layout_ = Layout::BITMAP;
+        bitmap_.resize((span >> 6) + 1);
+        for (const auto& v : values_) {
+          const auto o = offset(v);
+          bitmap_[o >> 6] |= 1UL << (o & 63);
+        }
+        return;
+      }
+    }
+
+    layout_ = Layout::HASH;
+    hash_.reserve(size);
+    hash_.insert(values_.begin(), values_.end());
+  }
+
+  virtual ~ValueSet() = default;
+
+  inline bool contains(const T& v) const noexcept {
+    switch (layout_) {
+    case Layout::SCAN: return scan(v);
+    case Layout::BITMAP: return bit(v);
+    default: return hash_.find(v) != hash_.end();
+    }
+  }
+
+  // call f with a membership test of current layout, so that a loop over many values has no layout switch
+  template <typename F>
+  inline auto apply(F&& f) const {
+    switch (layout_) {
+    case Layout::SCAN: return f([this](const T& v) { return scan(v); });
+    case Layout::BITMAP: return f([this](const T& v) { return bit(v); });
+    default: return f([this](const T& v) { return hash_.find(v) != hash_.end(); });
+    }
+  }
+
+  inline Layout layout() const noexcept {
+    return layout_;
+  }
+
+  inline size_t size() const noexcept {
+    return values_.size();
+  }
+
+  inline bool empty() const noexcept {
+    return values_.empty();
+  }
+
+  // sorted unique values
+  inline const std::vector<T>& values() const noexcept {
+    return values_;
+  }
+
+  inline T min() const {
+    return values_.front();
+  }
+
+  inline T max() const {
+    return values_.back();
+  }
+
+private:
+  inline uint64_t offset(const T& v) const noexcept {
+    return static_cast<uint64_t>(v) - static_cast<uint64_t>(values_.front());
+  }
+
+  inline bool scan(const T& v) const noexcept {
+    auto found = false;
+    for (const auto& x : values_) {
+      found |= (x == v);
+    }
+
+    return found;
+  }
+
+  inline bool bit(const T& v) const noexcept {
+    if constexpr (INTEGRAL) {
+      const auto o = offset(v);
+      return (o >> 6) < bitmap_.size() && ((bitmap_[o >> 6] >> (o & 63)) & 1);
+    } else {
+      return false;
+    }
+  }
+
+private:
+  std::vector<T> values_;
+  Layout layout_;
+  std::vector<uint64_t> bitmap_;
+  unordered_set<T> hash_;
+};
+
+} // namespace common
+} // namespace nebula
@@ -36,9 +36,14 @@
 #include "common/Int128.h"
 #include "common/Likely.h"
 #include "common/Memory.h"
+#include "common/Metrics.h"
+#include "common/Numa.h"
 #include "common/Params.h"
 #include "common/Spark.h"
 #include "common/StackTree.h"
+#include "common/Sum.h"
+#include "common/TimeParser.h"
+#include "common/ValueSet.h"
 
 namespace nebula {
 namespace common {
@@ -303,6 +308,39 @@ TEST(CommonTest, TestTimeParsing) {
   }
 }
 
+TEST(CommonTest, TestFastTimeParser) {
+  // layouts with named or variable width fields are left to the general parser
+  EXPECT_FALSE(nebula::common::TimeParser::make("%m/%d/%Y %I:%M:%S %p"));
+  EXPECT_FALSE(nebula::common::TimeParser::make("%FT%T%z"));
+  EXPECT_FALSE(nebula::common::TimeParser::make("%H:%M:%S"));
+
+  auto expect = [](const std::string& pattern, const std::vector<std::string>& values) {
+    auto parser = nebula::common::TimeParser::make(pattern);
+    ASSERT_TRUE(parser);
+    for (const auto& v : values) {
+      int64_t seconds = 0;
+      EXPECT_TRUE(parser->parse(v, seconds)) << v;
+      EXPECT_EQ(seconds, (int64_t)Evidence::time(v, pattern)) << v;
+    }
+  };
+
+  expect("%Y-%m-%d", { "2019-04-01", "1970-01-01", "2000-02-29", "2100-12-31" });
+  expect("%Y-%m-%d %H:%M:%S", { "2019-04-01 23:23:45", "2016-07-15 14:38:03", "2020-02-29 00:00:59" });
+  expect("%FT%T", { "2021-11-16T20:07:28.595Z", "2021-12-21T02:07:19.875000Z", "2038-01-19T03:14:08" });
+  expect("%Y/%m/%d %H:%M", { "2022-01-20 10:05", "1999-12-31 23:59" });
+  expect("%Y%m%d", { "20220120" });
+
+  // malformed values fail the fast path
+  auto parser = nebula::common::TimeParser::make("%Y-%m-%d %H:%M:%S");
+  ASSERT_TRUE(parser);
+  EXPECT_EQ(parser->width(), 19u);
+  int64_t seconds = 0;
+  for (auto v : { "2019-4-01 23:23:45", "2019-04-01", "2019-04-01T23:23:45", "2019-13-01 00:00:00",
+                  "2019-02-29 00:00:00", "2019-04-01 24:00:00", "ENDANGERED", "2019-0a-01 00:00:00" }) {
+    EXPECT_FALSE(parser->parse(v, seconds)) << v;
+  }
+}
+
 TEST(CommonTest, Test0AndOverflow) {
   int64_t min = 0, max = 0;
   size_t size = 100;
@@ -1381,6 +1419,38 @@ TEST(CommonTest, TestStackTree) {
   }
 }
 
+TEST(CommonTest, TestStackTreeMerge) {
+  // frames copied from another tree are found by later stacks in both child lookups
+  auto test = [](auto& stack, auto& stack2) {
+    stack.merge(std::vector<std::string>{ "A", "B", "C" });
+    stack2.merge(std::vector<std::string>{ "A", "E" });
+    stack2.merge(std::vector<std::string>{ "A", "B", "D" });
+    stack.merge(stack2);
+    stack.merge(std::vector<std::string>{ "A", "E" });
+
+    std::stringstream buffer;
+    buffer << stack;
+    EXPECT_EQ(buffer.str(),
+              "NODE: d=, c=4, l=0\n"
+              "NODE: d=A, c=4, l=1\n"
+              "NODE: d=B, c=2, l=2\n"
+              "NODE: d=C, c=1, l=3\n"
+              "NODE: d=D, c=1, l=3\n"
+              "NODE: d=E, c=2, l=2\n");
+
+    // children are sorted, and frames below threshold are pruned in json
+    EXPECT_EQ(stack.jsonfy(2),
+              "{\"name\":\"\",\"value\":4,\"children\":[{\"name\":\"A\",\"value\":4,\"children\":["
+              "{\"name\":\"B\",\"value\":2,\"children\":[]},{\"name\":\"E\",\"value\":2}]}]}");
+    EXPECT_GT(stack.allocated(), 0);
+  };
+
+  nebula::common::StackTree<std::string, true> hs1, hs2;
+  test(hs1, hs2);
+  nebula::common::StackTree<std::string, false> vs1, vs2;
+  test(vs1, vs2);
+}
+
 TEST(CommonTest, TestIStream) {
   std::string_view view = "abc\nxyz";
   nebula::common::IStream stream(view);
@@ -1532,6 +1602,162 @@ TEST(FormatTest, TestFormatComplexString) {
   LOG(INFO) << "formatted data: " << data;
 }
 
+TEST(CommonTest, TestMetrics) {
+  nebula::common::Metrics metrics;
+  auto& counter = metrics.counter("test_total", "test counter");
+  counter += 3;
+  EXPECT_EQ(&counter, &metrics.counter("test_total", "test counter"));
+  metrics.gauge("test_gauge", "test gauge", []() { return 1.5; }, "{kind=\"a\"}");
+
+  auto& h = metrics.histogram("test_ms", "test histogram", "{phase=\"f\"}", { 10, 100 });
+  h.observe(5);
+  h.observe(10);
+  h.observe(50);
+  h.observe(500);
+
+  const auto text = metrics.expose();
+  EXPECT_NE(text.find("# TYPE test_total counter\ntest_total 3\n"), std::string::npos);
+  EXPECT_NE(text.find("test_gauge{kind=\"a\"} 1.5\n"), std::string::npos);
+  EXPECT_NE(text.find("test_ms_bucket{phase=\"f\",le=\"10\"} 2\n"), std::string::npos);
+  EXPECT_NE(text.find("test_ms_bucket{phase=\"f\",le=\"100\"} 3\n"), std::string::npos);
+  EXPECT_NE(text.find("test_ms_bucket{phase=\"f\",le=\"+Inf\"} 4\n"), std::string::npos);
+  EXPECT_NE(text.find("test_ms_sum{phase=\"f\"} 565\n"), std::string::npos);
+  EXPECT_NE(text.find("test_ms_count{phase=\"f\"} 4\n"), std::string::npos);
+
+  // a name is of one type only
+  EXPECT_THROW(metrics.gauge("test_total", "test", []() { return 0; }), NException);
+}
+
+TEST(CommonTest, TestNuma) {
+  auto& numa = nebula::common::Numa::singleton();
+  EXPECT_GE(numa.nodes(), 1);
+  for (size_t i = 0; i < numa.nodes(); ++i) {
+    EXPECT_FALSE(numa.cpus(i).empty());
+  }
+
+  // placements are always valid nodes, and restored when a scope ends
+  const auto node = numa.next();
+  EXPECT_LT(node, numa.nodes());
+  {
+    nebula::common::Numa::Scope scope{ node };
+    EXPECT_LT(numa.current(), numa.nodes());
+    if (numa.enabled()) {
+      EXPECT_EQ(numa.home(), node);
+    }
+  }
+
+  EXPECT_LT(numa.home(), numa.nodes());
+}
+
+TEST(CommonTest, TestSafeSum) {
+  constexpr auto MAX = std::numeric_limits<int64_t>::max();
+
+  // sum crossing int64 range and coming back is exact
+  nebula::common::SafeSum sum;
+  sum.add(MAX);
+  sum.add(MAX);
+  EXPECT_TRUE(sum.wide());
+  EXPECT_EQ(sum.narrow(), MAX);
+  EXPECT_TRUE(sum.value() == static_cast<int128_t>(MAX) * 2);
+  sum.add(-MAX);
+  EXPECT_EQ(sum.narrow(), MAX);
+  sum.add(int64_t{ -1 });
+  EXPECT_EQ(sum.narrow(), MAX - 1);
+
+  // kernel gives the same total as adding values one by one
+  std::vector<int64_t> values;
+  nebula::common::SafeSum one;
+  for (int64_t i = 0; i < 5000; ++i) {
+    values.push_back(i % 7 == 0 ? MAX / 3 : -i);
+    one.add(values.back());
+  }
+
+  nebula::common::SafeSum run;
+  run.add(values.data(), values.size());
+  EXPECT_TRUE(run.value() == one.value());
+  EXPECT_TRUE(run.wide());
+
+  std::vector<int32_t> narrow(3001, std::numeric_limits<int32_t>::max());
+  nebula::common::SafeSum ints;
+  ints.add(narrow.data(), narrow.size());
+  EXPECT_EQ(ints.narrow(), 3001L * std::numeric_limits<int32_t>::max());
+}
+
+TEST(CommonTest, TestFloatSum) {
+  // small values are not lost by a large one in either order
+  nebula::common::FloatSum sum;
+  sum.add(1e16);
+  for (auto i = 0; i < 1000; ++i) {
+    sum.add(1.0);
+  }
+  sum.add(-1e16);
+  EXPECT_EQ(sum.value(), 1000);
+
+  std::vector<double> values;
+  for (auto i = 0; i < 1000; ++i) {
+    values.push_back(0.1);
+  }
+
+  nebula::common::FloatSum run;
+  run.add(values.data(), values.size());
+  EXPECT_NEAR(run.value(), 100, 1e-12);
+}
+
+TEST(CommonTest, TestValueSet) {
+  // a few values are scanned
+  std::vector<int64_t> few{ 9, -3, 7, 9 };
+  ValueSet<int64_t> scan(few.begin(), few.end());
+  EXPECT_EQ(scan.layout(), ValueSet<int64_t>::Layout::SCAN);
+  EXPECT_EQ(scan.size(), 3);
+  EXPECT_EQ(scan.min(), -3);
+  EXPECT_EQ(scan.max(), 9);
+  EXPECT_TRUE(scan.contains(-3));
+  EXPECT_FALSE(scan.contains(8));
+
+  // dense integers are in a bitmap, values out of range wrap to large offsets
+  std::vector<int32_t> dense;
+  for (int32_t i = -1000; i < 1000; i += 3) {
+    dense.push_back(i);
+  }
+
+  ValueSet<int32_t> bitmap(dense.begin(), dense.end());
+  EXPECT_EQ(bitmap.layout(), ValueSet<int32_t>::Layout::BITMAP);
+  for (int32_t i = -2000; i < 2000; ++i) {
+    EXPECT_EQ(bitmap.contains(i), i >= -1000 && i < 1000 && (i + 1000) % 3 == 0);
+  }
+
+  EXPECT_FALSE(bitmap.contains(std::numeric_limits<int32_t>::min()));
+  EXPECT_FALSE(bitmap.contains(std::numeric_limits<int32_t>::max()));
+
+  // sparse integers and strings are hashed
+  std::vector<int64_t> sparse;
+  for (int64_t i = 0; i < 100; ++i) {
+    sparse.push_back(i * 1000000007);
+  }
+
+  ValueSet<int64_t> hash(sparse.begin(), sparse.end());
+  EXPECT_EQ(hash.layout(), ValueSet<int64_t>::Layout::HASH);
+  EXPECT_TRUE(hash.contains(1000000007));
+  EXPECT_FALSE(hash.contains(1000000008));
+
+  std::vector<std::string> words;
+  for (auto i = 0; i < 20; ++i) {
+    words.push_back(fmt::format("w{0}", i));
+  }
+
+  ValueSet<std::string_view> strings(words.begin(), words.end());
+  EXPECT_EQ(strings.layout(), ValueSet<std::string_view>::Layout::HASH);
+  EXPECT_TRUE(strings.contains("w19"));
+  EXPECT_FALSE(strings.contains("w20"));
+
+  // every layout gives the same membership test to apply
+  for (auto v : { -3L, 8L, 9L }) {
+    EXPECT_EQ(scan.apply([v](auto contains) { return contains(v); }), scan.contains(v));
+  }
+  EXPECT_TRUE(bitmap.apply([](auto contains) { return contains(-1000); }));
+  EXPECT_FALSE(hash.apply([](auto contains) { return contains(1); }));
+}
+
 } // namespace test
 } // namespace common
 } // namespace nebula
\ No newline at end of file
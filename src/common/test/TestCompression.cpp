@@ -17,6 +17,8 @@
 #include <folly/compression/Compression.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <numeric>
+#include <thread>
 
 #include "common/Delta.h"
 #include "common/Evidence.h"
@@ -104,6 +106,51 @@ TEST(CompressionTest, TestStringPagedSlice) {
   LOG(INFO) << nebula::common::Pool::getDefault().report();
 }
 
+TEST(CompressionTest, TestConcurrentPagedSlice) {
+  // values written in pieces are laid across pages
+  constexpr auto page = 1004;
+  PagedSlice slice(page);
+  constexpr auto width = sizeof(int64_t);
+  constexpr auto total = 10000;
+  std::vector<int64_t> values(total);
+  std::iota(values.begin(), values.end(), 0);
+  const auto bytes = (const NByte*)values.data();
+  for (size_t pos = 0; pos < total * width; pos += page) {
+    slice.write(pos, bytes + pos, std::min<size_t>(page, total * width - pos));
+  }
+  slice.seal();
+
+  // every thread reads through its own cursor
+  std::vector<std::thread> threads;
+  std::atomic<size_t> errors{ 0 };
+  for (auto t = 0; t < 4; ++t) {
+    threads.emplace_back([&slice, &errors, t]() {
+      for (int64_t i = t; i < total; i += 3) {
+        if (slice.read<int64_t>(i * width) != i) {
+          ++errors;
+        }
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(errors.load(), 0);
+
+  // explicit cursors read the same slice independently
+  PagedSlice::Cursor c1;
+  PagedSlice::Cursor c2;
+  for (int64_t i = 0; i < total; ++i) {
+    EXPECT_EQ(slice.read<int64_t>(c1, i * width), i);
+    EXPECT_EQ(slice.read<int64_t>(c2, (total - i - 1) * width), total - i - 1);
+  }
+
+  // a string across pages
+  auto str = slice.read(c1, page - 4, 16);
+  EXPECT_EQ(std::memcmp(str.data(), bytes + page - 4, 16), 0);
+}
+
 TEST(CompressionTest, TestDeltaEncoding) {
 // generate 10K values range from 0 to 1000 and delta encoding them
 #define test_type(T)                                                                                      \
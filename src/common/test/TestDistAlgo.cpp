@@ -14,9 +14,12 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <fmt/format.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <set>
+#include <thread>
 
 #include "common/HashRing.h"
 
@@ -138,6 +141,31 @@ TEST(HashRingTest, TestDataReblanceWithNewNode) {
   ring.print();
 }
 
+TEST(HashRingTest, TestLocateReplicas) {
+  std::vector<std::unique_ptr<Machine>> machines;
+  for (auto i = 0; i < 5; ++i) {
+    machines.push_back(std::make_unique<Machine>(fmt::format("NODE-{0}", i)));
+  }
+
+  HashRing<Machine, Data, 20> ring(machines);
+  for (auto i = 0; i < 100; ++i) {
+    Data d{ fmt::format("DATA-{0}", i) };
+    auto nodes = ring.locate(d, 3);
+    EXPECT_EQ(nodes.size(), 3);
+
+    // copies land on distinct nodes, the first one is where the data is attached
+    std::set<std::string> ids;
+    for (auto n : nodes) {
+      ids.insert(n->id());
+    }
+    EXPECT_EQ(ids.size(), 3);
+    EXPECT_EQ(nodes.front()->id(), ring.attach(d).id());
+
+    // no more nodes than the ring has
+    EXPECT_EQ(ring.locate(d, 10).size(), 5);
+  }
+}
+
 TEST(HashRingTest, TestAddOneNodeEachTime) {
   std::vector<std::unique_ptr<Machine>> init;
   init.reserve(1);
@@ -172,6 +200,74 @@ TEST(HashRingTest, TestAddOneNodeEachTime) {
   }
 }
 
+TEST(HashRingTest, TestViewSnapshot) {
+  std::vector<std::unique_ptr<Machine>> machines;
+  for (auto i = 0; i < 10; ++i) {
+    machines.push_back(std::make_unique<Machine>(fmt::format("NODE-{0}", i)));
+  }
+
+  HashRing<Machine, Data, 20> ring(machines);
+  auto view = ring.view();
+  EXPECT_EQ(view->numNodes(), 10);
+
+  // lookups of the view find the same node as the ring attaches data to
+  for (auto i = 0; i < 1000; ++i) {
+    Data d{ fmt::format("DATA-{0}", i) };
+    EXPECT_EQ(view->node(d.id()).id(), ring.attach(d).id());
+  }
+
+  // a view is not changed by later membership change, and its nodes are still valid after removed from the ring
+  ring.add(std::make_unique<Machine>("NODE-10"));
+  ring.remove(Machine("NODE-0"));
+  EXPECT_EQ(view->numNodes(), 10);
+  EXPECT_EQ(ring.view()->numNodes(), 10);
+  EXPECT_EQ(view->locate("DATA-1", 20).size(), 10);
+  std::set<std::string> ids;
+  for (auto n : ring.locate(Data{ "DATA-1" }, 20)) {
+    ids.insert(n->id());
+  }
+  EXPECT_EQ(ids.count("NODE-0"), 0);
+  EXPECT_EQ(ids.count("NODE-10"), 1);
+}
+
+TEST(HashRingTest, TestConcurrentLookups) {
+  std::vector<std::unique_ptr<Machine>> machines;
+  for (auto i = 0; i < 10; ++i) {
+    machines.push_back(std::make_unique<Machine>(fmt::format("NODE-{0}", i)));
+  }
+
+  HashRing<Machine, Data, 20> ring(machines);
+
+  // readers route data while nodes join and leave, every lookup gets distinct nodes of one snapshot
+  std::atomic<bool> stop{ false };
+  std::atomic<size_t> lookups{ 0 };
+  std::vector<std::thread> readers;
+  for (auto t = 0; t < 4; ++t) {
+    readers.emplace_back([&ring, &stop, &lookups, t]() {
+      for (size_t i = 0; !stop || i < 1000; ++i) {
+        Data d{ fmt::format("DATA-{0}-{1}", t, i) };
+        auto nodes = ring.locate(d, 3);
+        std::set<const Machine*> distinct(nodes.begin(), nodes.end());
+        EXPECT_EQ(distinct.size(), 3);
+        lookups.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+
+  for (auto i = 10; i < 30; ++i) {
+    ring.add(std::make_unique<Machine>(fmt::format("NODE-{0}", i)));
+    ring.remove(Machine(fmt::format("NODE-{0}", i - 10)));
+  }
+
+  stop = true;
+  for (auto& r : readers) {
+    r.join();
+  }
+
+  EXPECT_EQ(ring.numNodes(), 10);
+  EXPECT_GE(lookups.load(), 4000);
+}
+
 } // namespace test
 } // namespace common
 } // namespace nebula
\ No newline at end of file
@@ -173,6 +173,41 @@ TEST(CuckooTest, TestCuckooFilter) {
             << " filter size: " << filter.bytes();
 }
 
+TEST(BloomTest, TestBlockBloom) {
+  size_t items = 100000;
+  nebula::common::BlockBloom bloom(items, 0.01);
+  // every bucket is 32 bytes
+  EXPECT_EQ(bloom.size() % 32, 0);
+
+  nebula::common::Hasher hasher;
+  for (size_t i = 0; i < items; ++i) {
+    bloom.insert(hasher.hash64(&i, sizeof(i)));
+  }
+
+  // no false negatives
+  for (size_t i = 0; i < items; ++i) {
+    EXPECT_TRUE(bloom.contains(hasher.hash64(&i, sizeof(i))));
+  }
+
+  size_t falsePositives = 0;
+  for (size_t i = items; i < 2 * items; ++i) {
+    if (bloom.contains(hasher.hash64(&i, sizeof(i)))) {
+      falsePositives++;
+    }
+  }
+
+  // split block filter is slightly worse than its target rate
+  LOG(INFO) << "block bloom false positive rate: " << 100.0 * falsePositives / items;
+  EXPECT_LT(falsePositives * 100.0 / items, 2.5);
+
+  // strings are filtered by their bytes
+  BloomFilter<std::string_view> filter(100);
+  std::string a = "nebula";
+  std::string b = "nebula";
+  filter.add(a);
+  EXPECT_TRUE(filter.probably(b));
+}
+
 // Testing yomm2 open multi-methods
 struct MMA {
   virtual ~MMA() {}
@@ -21,6 +21,7 @@
 #include <xxh3.h>
 
 #include "common/Evidence.h"
+#include "common/Hash.h"
 #include "common/robin_hood.h"
 
 /**
@@ -102,6 +103,27 @@ TEST(CommonTest, TestHashFunc) {
   run_test(XXH3_64bits, xxhash);
   run_test(robin_hood::hash_bytes, robinhood);
 
+  // long values are hashed by xxh3 in vectorized stripes
+  std::string y;
+  for (auto i = 0; i < 8; ++i) {
+    y.append(x);
+  }
+
+  EXPECT_EQ(Hasher::hashBytes(x.data(), x.size()), robin_hood::hash_bytes(x.data(), x.size()));
+  EXPECT_EQ(Hasher::hashBytes(y.data(), y.size()), XXH3_64bits(y.data(), y.size()));
+  {
+    Evidence::Duration duration;
+    for (size_t i = 0; i < size; ++i) {
+      XXH3_64bits(y.data(), y.size());
+    }
+    LOG(INFO) << "Hash 1M times of the long bytes using xxhash, taken: " << duration.elapsedMs();
+    duration.reset();
+    for (size_t i = 0; i < size; ++i) {
+      robin_hood::hash_bytes(y.data(), y.size());
+    }
+    LOG(INFO) << "Hash 1M times of the long bytes using robinhood, taken: " << duration.elapsedMs();
+  }
+
 #undef run_test
 }
 
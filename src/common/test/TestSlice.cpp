@@ -18,6 +18,7 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include "common/Arena.h"
 #include "common/Memory.h"
 
 namespace nebula {
@@ -40,6 +41,128 @@ TEST(SliceTest, TestWriteEmptySlice) {
 #undef WRITE_TO_EMTPY_SLICE
 }
 
+TEST(SliceTest, TestPoolSizeClass) {
+  using nebula::common::Pool;
+  EXPECT_EQ(Pool::classSize(Pool::sizeClass(0)), 64);
+  EXPECT_EQ(Pool::classSize(Pool::sizeClass(65)), 80);
+  EXPECT_EQ(Pool::classSize(Pool::sizeClass(4096)), 4096);
+  EXPECT_EQ(Pool::classSize(Pool::sizeClass(4097)), 5120);
+  EXPECT_EQ(Pool::sizeClass(Pool::MAX_SMALL), Pool::CLASSES - 1);
+
+  // every size fits in its class which is the smallest one holding it
+  for (size_t size = 1; size <= Pool::MAX_SMALL; ++size) {
+    const auto index = Pool::sizeClass(size);
+    EXPECT_GE(Pool::classSize(index), size);
+    if (index > 0) {
+      EXPECT_LT(Pool::classSize(index - 1), size);
+    }
+  }
+}
+
+TEST(SliceTest, TestPool) {
+  auto& pool = nebula::common::Pool::getDefault();
+  const auto small = pool.allocated(nebula::common::PoolCategory::SMALL);
+  const auto hits = pool.hits();
+
+  // a freed small chunk is reused by the same thread and zeroed again
+  auto p = static_cast<NByte*>(pool.allocate(1000));
+  std::memset(p, 1, 1000);
+  pool.free(p, 1000);
+  auto q = static_cast<NByte*>(pool.allocate(1010));
+  EXPECT_EQ(p, q);
+  EXPECT_EQ(pool.hits(), hits + 1);
+  EXPECT_EQ(pool.allocated(nebula::common::PoolCategory::SMALL), small + 2010);
+  for (size_t i = 0; i < 1010; ++i) {
+    EXPECT_EQ(q[i], 0);
+  }
+
+  // extended in place within its class, or moved into a bigger chunk
+  std::memset(q, 2, 1010);
+  auto r = static_cast<NByte*>(pool.extend(q, 1010, 1024));
+  EXPECT_EQ(q, r);
+  EXPECT_EQ(r[1013], 0);
+  r = static_cast<NByte*>(pool.extend(r, 1024, 100000));
+  EXPECT_EQ(r[1009], 2);
+  EXPECT_EQ(r[1010], 0);
+  EXPECT_EQ(r[99999], 0);
+  pool.free(r, 100000);
+
+  // huge chunks are mapped pages, growing by remapping keeps values and zeros new bytes
+  const auto huge = nebula::common::Pool::HUGE_SIZE;
+  const auto freed = pool.freed(nebula::common::PoolCategory::HUGE_PAGE);
+  auto h = static_cast<NByte*>(pool.allocate(huge + 10));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(h) % 4096, 0);
+  EXPECT_EQ(h[huge + 9], 0);
+  std::memset(h, 3, huge + 10);
+  h = static_cast<NByte*>(pool.extend(h, huge + 10, 8 * huge));
+  EXPECT_EQ(h[0], 3);
+  EXPECT_EQ(h[huge + 9], 3);
+  EXPECT_EQ(h[huge + 10], 0);
+  EXPECT_EQ(h[8 * huge - 1], 0);
+
+  // a large chunk moves into mapped pages once it grows huge
+  auto l = static_cast<NByte*>(pool.allocate(100000));
+  std::memset(l, 4, 100000);
+  l = static_cast<NByte*>(pool.extend(l, 100000, 2 * huge));
+  EXPECT_EQ(l[99999], 4);
+  EXPECT_EQ(l[100000], 0);
+  l = static_cast<NByte*>(pool.extend(l, 2 * huge, 4 * huge));
+  EXPECT_EQ(l[99999], 4);
+  pool.free(l, 4 * huge);
+
+  // shrinking releases the tail of mapped pages in place
+  auto s = static_cast<NByte*>(pool.shrink(h, 8 * huge, 2 * huge));
+  EXPECT_EQ(s, h);
+  EXPECT_EQ(s[huge + 9], 3);
+  pool.free(s, 2 * huge);
+  EXPECT_EQ(pool.freed(nebula::common::PoolCategory::HUGE_PAGE), freed + 12 * huge);
+
+  // a small chunk is moved into a smaller class, a large one is resized
+  auto c = static_cast<NByte*>(pool.allocate(100000));
+  std::memset(c, 5, 100000);
+  c = static_cast<NByte*>(pool.shrink(c, 100000, 70000));
+  EXPECT_EQ(c[69999], 5);
+  c = static_cast<NByte*>(pool.shrink(c, 70000, 100));
+  EXPECT_EQ(c[99], 5);
+  EXPECT_EQ(pool.shrink(c, 100, 98), c);
+  pool.free(c, 98);
+
+  nebula::common::ExtendableSlice slice(4096);
+  slice.write(0, 1L);
+  slice.seal(8);
+  EXPECT_EQ(slice.size(), 8);
+  EXPECT_EQ(slice.read<int64_t>(0), 1L);
+  LOG(INFO) << pool.report();
+}
+
+TEST(SliceTest, TestArena) {
+  struct Item {
+    explicit Item(int64_t v) : value{ v } {}
+    int64_t value;
+  };
+
+  // no arena bound, allocated from heap
+  auto heap = nebula::common::Arena::make<Item>(1);
+  EXPECT_EQ(heap->value, 1);
+
+  std::vector<std::shared_ptr<Item>> items;
+  {
+    auto arena = std::make_shared<nebula::common::Arena>(1024);
+    nebula::common::Arena::Scope scope(arena);
+    for (auto i = 0; i < 1000; ++i) {
+      items.push_back(nebula::common::Arena::make<Item>(i));
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(items.back().get()) % alignof(Item), 0);
+    }
+
+    EXPECT_GE(arena->allocated(), 1000 * sizeof(Item));
+  }
+
+  // objects outlive the scope since they hold the arena
+  for (auto i = 0; i < 1000; ++i) {
+    EXPECT_EQ(items.at(i)->value, i);
+  }
+}
+
 } // namespace test
 } // namespace common
 } // namespace nebula
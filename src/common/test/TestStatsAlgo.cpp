@@ -24,10 +24,12 @@
 #include <sstream>
 
 #include "common/CountMin.h"
+#include "common/DDSketch.h"
 #include "common/Evidence.h"
 #include "common/Hash.h"
 #include "common/HyperLogLog.h"
 #include "common/Memory.h"
+#include "common/TDigest.h"
 
 /**
  * Test all stats algorithms provided by folly/stats package
@@ -200,6 +202,107 @@ TEST(StatsTest, TestTDigest) {
   }
 }
 
+TEST(StatsTest, TestNebulaTDigest) {
+  nebula::common::TDigest digest(100);
+  EXPECT_TRUE(digest.empty());
+
+  // two digests of values ranging from 1 to 1000 in different orders, merge them by reference
+  constexpr auto numberOfValues = 1000;
+  std::vector<double> odds;
+  std::vector<double> evens;
+  for (int i = numberOfValues; i > 0; --i) {
+    (i % 2 ? odds : evens).push_back(i);
+  }
+
+  nebula::common::TDigest other(100);
+  digest.add(odds);
+  other.add(evens);
+  digest.merge(other);
+
+  EXPECT_FALSE(digest.empty());
+  EXPECT_LE(digest.centroids().size(), 100);
+  EXPECT_EQ(digest.count(), numberOfValues);
+  EXPECT_EQ(digest.max(), numberOfValues);
+  EXPECT_EQ(digest.min(), 1);
+  EXPECT_NEAR(digest.sum(), (1 + numberOfValues) * numberOfValues / 2, 1e-9);
+  EXPECT_NEAR(digest.quantile(0.1), 100, 1);
+  EXPECT_NEAR(digest.quantile(0.5), 500, 1);
+  EXPECT_NEAR(digest.quantile(0.99), 990, 1);
+
+  // serialized size is much smaller than 16 bytes per centroid
+  nebula::common::ExtendableSlice slice(1024);
+  auto bytes = digest.serialize(slice, 8);
+  EXPECT_LT(bytes, digest.centroids().size() * 10 + 32);
+
+  nebula::common::TDigest digest2;
+  EXPECT_EQ(digest2.load(slice, 8), bytes);
+  EXPECT_EQ(digest2.count(), numberOfValues);
+  EXPECT_EQ(digest2.max(), numberOfValues);
+  EXPECT_EQ(digest2.min(), 1);
+  EXPECT_EQ(digest2.compression(), 100);
+  for (auto i = 1; i < 10; ++i) {
+    auto percentile = i * 10.0 / 100;
+    EXPECT_NEAR(digest.quantile(percentile), digest2.quantile(percentile), 1e-14);
+  }
+}
+
+TEST(StatsTest, TestDDSketch) {
+  // latencies from 1 to 10000 in two sketches, merged by buckets
+  nebula::common::DDSketch sketch;
+  nebula::common::DDSketch other;
+  constexpr auto numberOfValues = 10000;
+  for (int i = 1; i <= numberOfValues; ++i) {
+    (i % 2 ? sketch : other).add(i);
+  }
+
+  sketch.merge(other);
+  EXPECT_EQ(sketch.count(), numberOfValues);
+  EXPECT_EQ(sketch.min(), 1);
+  EXPECT_EQ(sketch.max(), numberOfValues);
+  EXPECT_NEAR(sketch.sum(), (1 + numberOfValues) * numberOfValues / 2, 1e-9);
+
+  // every quantile is within relative error of its true value
+  for (auto q : { 0.1, 0.25, 0.5, 0.9, 0.99, 0.999 }) {
+    const auto expected = 1 + q * (numberOfValues - 1);
+    EXPECT_NEAR(sketch.quantile(q), expected, expected * sketch.alpha() + 1);
+  }
+
+  // 4 orders of magnitude fit in a few hundred buckets
+  EXPECT_LT(sketch.buckets(), 300);
+  nebula::common::ExtendableSlice slice(1024);
+  auto bytes = sketch.serialize(slice, 8);
+  EXPECT_LT(bytes, 600);
+
+  nebula::common::DDSketch sketch2;
+  EXPECT_EQ(sketch2.load(slice, 8), bytes);
+  EXPECT_EQ(sketch2.count(), numberOfValues);
+  EXPECT_EQ(sketch2.min(), 1);
+  EXPECT_EQ(sketch2.max(), numberOfValues);
+  for (auto i = 1; i < 10; ++i) {
+    EXPECT_EQ(sketch.quantile(i / 10.0), sketch2.quantile(i / 10.0));
+  }
+
+  // negative values and zeros are ordered before positives
+  nebula::common::DDSketch mixed;
+  for (auto v : { -100, -10, 0, 0, 10, 100 }) {
+    mixed.add(v);
+  }
+
+  EXPECT_NEAR(mixed.quantile(0.2), -10, 10 * mixed.alpha());
+  EXPECT_EQ(mixed.quantile(0.5), 0);
+  EXPECT_NEAR(mixed.quantile(0.9), 10, 10 * mixed.alpha());
+  EXPECT_EQ(mixed.quantile(1), 100);
+
+  // bounded buckets collapse values closest to 0 only
+  nebula::common::DDSketch bounded(0.02, 64);
+  for (int i = 1; i <= numberOfValues; ++i) {
+    bounded.add(i);
+  }
+
+  EXPECT_EQ(bounded.buckets(), 64);
+  EXPECT_NEAR(bounded.quantile(0.99), 9901, 9901 * bounded.alpha());
+}
+
 template <typename CM>
 void queryFrequency(const CM& sketch, bool top20Only = true) {
   LOG(INFO) << "Query top 20 items: ";
@@ -500,6 +603,50 @@ TEST(HyperLogLogTest, TestHLLSerde) {
   EXPECT_EQ(card1, card2);
 }
 
+TEST(HyperLogLogTest, TestHLLSparse) {
+  // sketches seeing a few values stay sparse, merged result is the same as a single sketch
+  for (size_t n : { 10, 1000, 5000, 100000 }) {
+    HyperLogLog hll1(16), hll2(16), all(16);
+    for (size_t i = 0; i < n; ++i) {
+      auto str = std::to_string(i);
+      (i % 2 ? hll1 : hll2).add(str.data(), str.size());
+      all.add(str.data(), str.size());
+    }
+
+    EXPECT_EQ(all.dense(), n > hll1.size() / 16);
+    hll1.merge(hll2);
+    EXPECT_EQ(hll1.dense(), all.dense());
+    EXPECT_EQ(hll1.estimate(), all.estimate());
+    LOG(INFO) << "N=" << n << " | dense=" << all.dense() << " | CARD=" << all.estimate();
+  }
+
+  // a sparse sketch merged with a dense one
+  HyperLogLog sparse(16), dense(16);
+  for (size_t i = 0; i < 100000; ++i) {
+    auto str = std::to_string(i);
+    dense.add(str.data(), str.size());
+    if (i < 10) {
+      sparse.add(str.data(), str.size());
+    }
+  }
+
+  EXPECT_FALSE(sparse.dense());
+  auto card = dense.estimate();
+  sparse.merge(dense);
+  EXPECT_TRUE(sparse.dense());
+  EXPECT_EQ(sparse.estimate(), card);
+
+  // restore a sparse sketch from its entries
+  HyperLogLog hll(16), restored(16);
+  for (size_t i = 0; i < 100; ++i) {
+    hll.add(i);
+  }
+
+  restored.set(hll.entries());
+  EXPECT_FALSE(restored.dense());
+  EXPECT_EQ(restored.estimate(), hll.estimate());
+}
+
 } // namespace test
 } // namespace common
 } // namespace nebula
\ No newline at end of file
@@ -16,7 +16,16 @@
 
 #include "BlockManager.h"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "common/Evidence.h"
 #include "common/Folly.h"
+#include "common/Numa.h"
+#include "execution/meta/TableService.h"
+#include "memory/BatchRow.h"
+#include "meta/TableSpec.h"
 #include "type/Tree.h"
 
 /**
@@ -27,13 +36,18 @@ namespace execution {
 
 using nebula::execution::io::BatchBlock;
 using nebula::execution::io::BlockList;
+using nebula::memory::Batch;
 using nebula::memory::BatchPtr;
+using nebula::memory::BatchRow;
 using nebula::meta::BlockSignature;
 using nebula::meta::NBlock;
 using nebula::meta::NNode;
 using nebula::meta::Table;
+using nebula::meta::TablePtr;
+using nebula::meta::TableSpec;
 using nebula::surface::eval::BlockEval;
 using nebula::surface::eval::Histogram;
+using nebula::surface::eval::SummaryView;
 using nebula::surface::eval::ValueEval;
 using nebula::type::Kind;
 using nebula::type::Schema;
@@ -54,11 +68,11 @@ std::shared_ptr<BlockManager> BlockManager::init() {
 
 // query all nodes that hold data for given table
 const std::vector<NNode> BlockManager::query(const std::string& table) {
-  std::lock_guard<std::mutex> lock(dmux_);
   std::vector<NNode> nodes;
 
   // go through all nodes's block set
-  for (auto n = data_.begin(); n != data_.end(); ++n) {
+  const auto snap = snapshot();
+  for (auto n = snap->begin(); n != snap->end(); ++n) {
     const auto& states = n->second;
     if (states.find(table) != states.end()) {
       nodes.push_back(n->first);
@@ -68,6 +82,49 @@ const std::vector<NNode> BlockManager::query(const std::string& table) {
   return nodes;
 }
 
+const std::vector<NNode> BlockManager::nodes(const Table& table, const PlanPtr plan) const {
+  const auto& window = plan->getWindow();
+  const auto& filter = plan->fetch<PhaseType::COMPUTE>().filter();
+  const auto schema = table.schema();
+  const auto summary = table.pod() == nullptr;
+
+  std::vector<NNode> nodes;
+  const auto snap = snapshot();
+  for (const auto& node : plan->getNodes()) {
+    auto found = snap->find(node);
+    if (found == snap->end()) {
+      continue;
+    }
+
+    auto ts = found->second.find(table.name());
+    if (ts == found->second.end()) {
+      continue;
+    }
+
+    const auto& skips = plan->skips(node);
+    for (const auto& b : ts->second->query(window)) {
+      if (!skips.empty() && skips.find(b->spec()) != skips.end()) {
+        continue;
+      }
+
+      // histograms are found by column name, or in schema order of the block if it has no column names,
+      // a block of another schema version without column names is kept
+      const auto& state = b->state();
+      const auto named = state.columns.size() == state.histograms.size();
+      if (summary && (named || state.histograms.size() == schema->size())
+          && filter.eval(SummaryView(schema, state.numRows, state.histograms, named ? &state.columns : nullptr))
+               == BlockEval::NONE) {
+        continue;
+      }
+
+      nodes.push_back(node);
+      break;
+    }
+  }
+
+  return nodes;
+}
+
 static constexpr auto BATCH_SIZE = 100;
 folly::Future<FilteredBlocks> batch(folly::ThreadPoolExecutor& pool,
                                     const ValueEval& filter,
@@ -94,6 +151,27 @@ folly::Future<FilteredBlocks> batch(folly::ThreadPoolExecutor& pool,
   return p->getFuture();
 }
 
+// keep given fraction of blocks (at least one) for an approximate query.
+// blocks are ranked by hash of their address, so a block lives in or out of the sample for all queries
+// of the same fraction, repeated queries get consistent results and the sample is not biased by block order.
+static void sample(FilteredBlocks& blocks, double fraction) {
+  const auto size = std::max<size_t>(1, std::ceil(blocks.size() * fraction));
+  if (size >= blocks.size()) {
+    return;
+  }
+
+  auto rank = [](const nebula::memory::EvaledBlock& block) {
+    const auto ptr = block.first.get();
+    return nebula::common::Hasher::hash64(&ptr, sizeof(ptr));
+  };
+
+  std::nth_element(blocks.begin(), blocks.begin() + size, blocks.end(), [&rank](const auto& left, const auto& right) {
+    return rank(left) < rank(right);
+  });
+
+  blocks.resize(size);
+}
+
 const FilteredBlocks BlockManager::query(const Table& table, const PlanPtr plan, folly::ThreadPoolExecutor& pool) {
   // 1. a table and a predicate should determined by meta service how many blocks we should query
   // 2. determine how many blocks are not in memory yet, if they are not, load them in
@@ -102,23 +180,66 @@ const FilteredBlocks BlockManager::query(const Table& table, const PlanPtr plan,
   const auto& window = plan->getWindow();
 
   // check if there are some predicates we can evaluate here
-  const auto& filter = plan->fetch<PhaseType::COMPUTE>().filter();
+  const auto& compute = plan->fetch<PhaseType::COMPUTE>();
+  const auto& filter = compute.filter();
+
+  // a cold block loads only the columns read by the query
+  const auto& columns = compute.columns();
+
+  // a query repeating by time, such as a dashboard, warms up its next window ahead of its next run
+  patterns_.record(table.name(), window, columns, nebula::common::Evidence::unix_timestamp());
 
   std::array<BatchPtr, BATCH_SIZE> list;
   std::vector<folly::Future<FilteredBlocks>> futures;
   futures.reserve(1024);
 
-  const auto& self = local();
+  const auto nodes = snapshot();
+  const auto& self = nodes->at(NNode::inproc());
   auto ts = self.find(table.name());
   if (ts == self.end()) {
     return {};
   }
 
+  // blocks of a replicated spec are scanned by the replica serving it in this query
+  const auto& skips = plan->skips(NNode::inproc());
+
+  // blocks of a partitioned table are pruned by their partition values once per partition rather than one by one
+  const auto partitioned = table.pod() != nullptr;
+  nebula::common::unordered_map<size_t, bool> partitions;
+  auto pruned = [&filter, &partitions](const Batch& batch) {
+    auto found = partitions.find(batch.getPid());
+    if (found == partitions.end()) {
+      const auto none = filter.eval(nebula::surface::eval::PartitionView(batch)) == BlockEval::NONE;
+      found = partitions.emplace(batch.getPid(), none).first;
+    }
+
+    return found->second;
+  };
+
   auto index = 0;
+  size_t prunedPartition = 0;
+  std::vector<std::shared_ptr<BatchBlock>> cold;
   for (auto& b : ts->second->query(window)) {
+    if (!skips.empty() && skips.find(b->spec()) != skips.end()) {
+      continue;
+    }
+
     ++total;
-    list[index++] = b;
+    if (b->data() == nullptr || !b->data()->resident(columns)) {
+      cold.push_back(b);
+      continue;
+    }
+
+    if (partitioned && pruned(*b->data())) {
+      ++prunedPartition;
+      continue;
+    }
+
+    if (tier_) {
+      tier_->touch(*b);
+    }
 
+    list[index++] = b->data();
     if (index == BATCH_SIZE) {
       futures.push_back(batch(pool, filter, list, index));
       index = 0;
@@ -129,6 +250,11 @@ const FilteredBlocks BlockManager::query(const Table& table, const PlanPtr plan,
     futures.push_back(batch(pool, filter, list, index));
   }
 
+  // cold blocks in the window are loaded back at lower priority than scanning blocks in memory
+  for (auto& b : cold) {
+    futures.push_back(promote(pool, filter, columns, ts->second, b));
+  }
+
   // collect futures
   FilteredBlocks tableBlocks;
   tableBlocks.reserve(total);
@@ -144,11 +270,210 @@ const FilteredBlocks BlockManager::query(const Table& table, const PlanPtr plan,
     }
   }
 
-  LOG(INFO) << fmt::format("Fetch blcoks {0} / {1} for table {2} in window [{3}, {4}]. ",
-                           tableBlocks.size(), total, table.name(), window.first, window.second);
+  // record all matched blocks before sampling them
+  // blocks evaluated by their metadata and not matched are pruned by metadata
+  auto& stats = plan->ctx().stats();
+  stats.profile.blocksPrunedPartition += prunedPartition;
+  const size_t scanned = total - prunedPartition;
+  if (scanned > tableBlocks.size()) {
+    stats.profile.blocksPrunedMeta += scanned - tableBlocks.size();
+  }
+
+  stats.blocksTotal += tableBlocks.size();
+  for (const auto& block : tableBlocks) {
+    stats.rowsTotal += block.first->getRows();
+  }
+
+  const auto fraction = plan->getSample();
+  if (fraction < 1) {
+    sample(tableBlocks, fraction);
+  }
+
+  LOG(INFO) << fmt::format(
+    "Fetch blcoks {0} / {1} for table {2} in window [{3}, {4}] by sample {5}, cold blocks: {6}, columns: {7}.",
+    tableBlocks.size(), total, table.name(), window.first, window.second, fraction, cold.size(), columns.size());
+
+  // loaded blocks may take memory over budget
+  if (!cold.empty()) {
+    balance();
+  }
+
   return tableBlocks;
 }
 
+folly::Future<FilteredBlocks> BlockManager::promote(folly::ThreadPoolExecutor& pool,
+                                                    const ValueEval& filter,
+                                                    const io::BlockSnapshot::Columns& columns,
+                                                    std::shared_ptr<TableState> state,
+                                                    std::shared_ptr<BatchBlock> block) {
+  auto p = std::make_shared<folly::Promise<FilteredBlocks>>();
+  pool.addWithPriority(
+    [this, &filter, &columns, state, block, p]() {
+      FilteredBlocks blocks;
+      auto loaded = reload(*state, block, columns);
+      if (loaded == nullptr) {
+        p->setValue(blocks);
+        return;
+      }
+
+      auto ptr = loaded->data();
+      auto eval = filter.eval(*ptr);
+      if (eval != BlockEval::NONE) {
+        blocks.emplace_back(ptr, eval);
+      }
+
+      p->setValue(blocks);
+    },
+    folly::Executor::MID_PRI);
+  return p->getFuture();
+}
+
+std::shared_ptr<BatchBlock> BlockManager::reload(TableState& state,
+                                                 std::shared_ptr<BatchBlock> block,
+                                                 const io::BlockSnapshot::Columns& columns) {
+  // columns loaded already stay when a block is loaded again for more columns
+  auto wanted = columns;
+  if (!wanted.empty() && block->data() != nullptr) {
+    const auto& data = *block->data();
+    const auto schema = data.schema();
+    for (size_t i = 0, size = schema->size(); i < size; ++i) {
+      const auto& name = schema->childType(i)->name();
+      if (data.resident(name)) {
+        wanted.emplace(name);
+      }
+    }
+  }
+
+  auto loaded = tier_ ? tier_->load(*block, wanted) : nullptr;
+
+  // a block registered by metadata only is hydrated from snapshot of its spec
+  auto snapshot = io::BlockSnapshot::local();
+  if (loaded == nullptr && snapshot) {
+    auto table = [](const std::string& name) {
+      return nebula::execution::meta::TableService::singleton()->query(name).table();
+    };
+    auto data = snapshot->hydrate(
+      *block, table, [](Batch& batch, const BlockSignature&) { batch.seal(); }, wanted);
+    if (data) {
+      loaded = std::make_shared<BatchBlock>(block->signature(), data->data(), block->state());
+    }
+  }
+
+  if (loaded == nullptr) {
+    LOG(WARNING) << "Failed to load cold block: " << block->signature().toString();
+    return nullptr;
+  }
+
+  // a concurrent query may have loaded it already, its data is good to use either way
+  state.replace(block, loaded);
+  return loaded;
+}
+
+size_t BlockManager::warmup(size_t now, size_t horizon) {
+  const auto predictions = patterns_.predict(now, horizon);
+  if (predictions.empty()) {
+    return 0;
+  }
+
+  size_t loaded = 0;
+  size_t resident = 0;
+  const auto nodes = snapshot();
+  const auto& self = nodes->at(NNode::inproc());
+  for (const auto& p : predictions) {
+    auto ts = self.find(p.table);
+    if (ts == self.end()) {
+      continue;
+    }
+
+    for (auto& b : ts->second->query(p.window)) {
+      auto block = b;
+      if (b->data() == nullptr || !b->data()->resident(p.columns)) {
+        block = reload(*ts->second, b, p.columns);
+        if (block == nullptr) {
+          continue;
+        }
+
+        ++loaded;
+      } else {
+        ++resident;
+      }
+
+      // blocks the next run will read rank hot, so they are the last to evict
+      if (tier_) {
+        tier_->touch(*block);
+      }
+    }
+  }
+
+  LOG(INFO) << "Warmed up " << predictions.size() << " recurring queries, blocks loaded: " << loaded
+            << ", resident: " << resident;
+
+  if (loaded > 0) {
+    balance();
+  }
+
+  return loaded;
+}
+
+void BlockManager::balance() {
+  if (!tier_) {
+    return;
+  }
+
+  // one balance at a time
+  std::unique_lock<std::mutex> guard(tmux_, std::try_to_lock);
+  if (!guard.owns_lock()) {
+    return;
+  }
+
+  struct Hot {
+    double cost;
+    std::shared_ptr<TableState> state;
+    std::shared_ptr<BatchBlock> block;
+  };
+
+  std::vector<Hot> hot;
+  size_t memory = 0;
+  const auto now = nebula::common::Evidence::unix_timestamp();
+  {
+    const auto nodes = snapshot();
+    for (auto& ts : nodes->at(NNode::inproc())) {
+      for (auto& b : ts.second->hot()) {
+        const auto bytes = b->data()->getMemory();
+        memory += bytes;
+        if (!b->signature().isEphemeral()) {
+          hot.push_back(Hot{ tier_->cost(*b, bytes, now), ts.second, b });
+        }
+      }
+    }
+  }
+
+  const auto budget = tier_->budget();
+  if (memory <= budget) {
+    return;
+  }
+
+  // blocks costing most to keep go first
+  std::sort(hot.begin(), hot.end(), [](const Hot& left, const Hot& right) {
+    return left.cost > right.cost;
+  });
+
+  size_t evicted = 0;
+  for (auto& h : hot) {
+    if (memory <= budget) {
+      break;
+    }
+
+    auto cold = tier_->evict(*h.block);
+    if (cold && h.state->replace(h.block, cold)) {
+      memory -= h.block->data()->getMemory();
+      ++evicted;
+    }
+  }
+
+  LOG(INFO) << "Evicted " << evicted << " blocks to cold tier, memory of blocks: " << memory << ", budget: " << budget;
+}
+
 // add block into the target table states
 // look for the correct table state object and add this block into it
 bool BlockManager::addBlock(TableStates& target, std::shared_ptr<io::BatchBlock> block) {
@@ -166,6 +491,23 @@ bool BlockManager::addBlock(TableStates& target, std::shared_ptr<io::BatchBlock>
   return ptr->add(block);
 }
 
+std::shared_ptr<TableState> BlockManager::state(const NNode& node, const std::string& table) {
+  auto itr = data_->find(node);
+  if (itr != data_->end()) {
+    auto found = itr->second.find(table);
+    if (found != itr->second.end()) {
+      return found->second;
+    }
+  }
+
+  // a new table state is published in a copy of current snapshot
+  auto next = std::make_shared<NodeStates>(*data_);
+  auto ptr = std::make_shared<TableState>(table);
+  (*next)[node].emplace(table, ptr);
+  publish(std::move(next));
+  return ptr;
+}
+
 bool BlockManager::add(std::shared_ptr<io::BatchBlock> block) {
   std::lock_guard<std::mutex> lock(dmux_);
   const auto& node = block->residence();
@@ -178,13 +520,67 @@ bool BlockManager::add(std::shared_ptr<io::BatchBlock> block) {
   // counter - note that this may be used for appromimate only, not for accurate internal state
   ++blocks_;
 
-  auto itr = data_.find(node);
-  if (itr != data_.end()) {
-    return addBlock(itr->second, block);
+  if (!state(node, block->table())->add(block)) {
+    return false;
+  }
+
+  if (node.isInProc()) {
+    index(*block);
   }
 
-  data_.emplace(node, TableStates{});
-  return addBlock(data_.at(node), block);
+  return true;
+}
+
+void BlockManager::retain(const std::string& table, size_t seconds) {
+  std::lock_guard<std::mutex> lock(emux_);
+  retentions_[table] = seconds;
+}
+
+void BlockManager::index(const BatchBlock& block) {
+  std::lock_guard<std::mutex> lock(emux_);
+
+  // rollup blocks are retained as long as their base table unless the rollup has its own retention
+  auto retention = retentions_.find(block.table());
+  if (retention == retentions_.end()) {
+    retention = retentions_.find(TableSpec::base(block.table()));
+  }
+
+  if (retention == retentions_.end() || retention->second == 0) {
+    return;
+  }
+
+  const auto time = block.end() + retention->second;
+  auto& current = expires_[std::make_pair(block.table(), block.spec())];
+  if (time > current) {
+    current = time;
+    dues_.push_back(Due{ time, block.table(), block.spec() });
+    std::push_heap(dues_.begin(), dues_.end(), std::greater<Due>());
+  }
+}
+
+TableSpecSet BlockManager::expire(size_t now) {
+  TableSpecSet expired;
+  {
+    std::lock_guard<std::mutex> lock(emux_);
+    while (!dues_.empty() && dues_.front().time <= now) {
+      std::pop_heap(dues_.begin(), dues_.end(), std::greater<Due>());
+      auto due = std::move(dues_.back());
+      dues_.pop_back();
+
+      auto key = std::make_pair(std::move(due.table), std::move(due.spec));
+      auto found = expires_.find(key);
+      if (found != expires_.end() && found->second == due.time) {
+        expires_.erase(found);
+        expired.emplace(std::move(key));
+      }
+    }
+  }
+
+  for (const auto& ts : expired) {
+    removeBySpec(ts.first, ts.second);
+  }
+
+  return expired;
 }
 
 size_t BlockManager::add(BlockList& range) {
@@ -198,39 +594,252 @@ size_t BlockManager::add(BlockList& range) {
     }
   }
 
+  // new blocks may take memory over budget
+  balance();
   return numAdded;
 }
 
 // remove all blocks that share the given spec
-// NOTE: thread-unsafe~!
 size_t BlockManager::removeBySpec(const std::string& table, const std::string& spec) {
   size_t count = 0;
-  auto& self = local();
+  const auto nodes = snapshot();
+  const auto& self = nodes->at(NNode::inproc());
   auto state = self.find(table);
   if (state != self.end()) {
+    // files of removed blocks in cold tier
+    if (tier_) {
+      state->second->iterate([this, &spec](const BatchBlock& block) {
+        if (block.spec() == spec) {
+          tier_->drop(block);
+        }
+      });
+    }
+
     count += state->second->remove(spec);
   }
 
+  // a removed spec is out of expiration index, its heap entry goes stale
+  {
+    std::lock_guard<std::mutex> lock(emux_);
+    expires_.erase(std::make_pair(table, spec));
+  }
+
   // decrement blocks counter
   blocks_ -= count;
 
   return count;
 }
 
-std::shared_ptr<Histogram> BlockManager::hist(const std::string& table, size_t col) const {
+size_t BlockManager::swap(const std::string& table,
+                          const std::string& spec,
+                          const std::function<bool(const BatchBlock&)>& drop,
+                          BlockList& range) {
+  size_t count = 0;
+  {
+    std::lock_guard<std::mutex> lock(dmux_);
+    auto target = state(NNode::inproc(), table);
+
+    // blocks of other tables (eg. rollups) are simply added
+    std::vector<std::shared_ptr<BatchBlock>> blocks;
+    for (auto& b : range) {
+      ++blocks_;
+      index(*b);
+      if (b->table() == table) {
+        blocks.push_back(b);
+      } else {
+        state(NNode::inproc(), b->table())->add(b);
+      }
+    }
+
+    // removed blocks drop their files in cold tier
+    count = target->swap(
+      spec,
+      [this, &drop](const BatchBlock& block) {
+        if (!drop(block)) {
+          return false;
+        }
+
+        if (tier_) {
+          tier_->drop(block);
+        }
+        return true;
+      },
+      blocks);
+    blocks_ -= count;
+  }
+
+  // new blocks may take memory over budget
+  balance();
+  return count;
+}
+
+size_t BlockManager::compact(size_t minRows,
+                             size_t maxRows,
+                             const std::function<TablePtr(const std::string&)>& lookup) {
+  struct Small {
+    std::shared_ptr<TableState> state;
+    std::vector<std::shared_ptr<BatchBlock>> blocks;
+  };
+
+  // small blocks in memory grouped by table and spec
+  nebula::common::unordered_map<std::string, Small> smalls;
+  {
+    std::lock_guard<std::mutex> lock(dmux_);
+    for (auto& ts : data_->at(NNode::inproc())) {
+      for (auto& b : ts.second->hot()) {
+        const auto& sign = b->signature();
+        if (b->state().numRows < minRows && !sign.isEphemeral() && held_.find(sign.spec) == held_.end()) {
+          auto& small = smalls[fmt::format("{0}@{1}", ts.first, sign.spec)];
+          small.state = ts.second;
+          small.blocks.push_back(b);
+        }
+      }
+    }
+  }
+
+  size_t reduced = 0;
+  for (auto& item : smalls) {
+    auto& blocks = item.second.blocks;
+    if (blocks.size() < 2) {
+      continue;
+    }
+
+    // partitioned batches keep their own partition, and compound columns can't be copied by rows
+    auto table = lookup(blocks.front()->table());
+    if (table == nullptr || table->pod() != nullptr || !BatchRow::supports(table->schema())) {
+      continue;
+    }
+
+    // blocks adjacent by time are merged together
+    std::sort(blocks.begin(), blocks.end(), [](const auto& left, const auto& right) {
+      return left->start() < right->start();
+    });
+
+    for (size_t first = 0, size = blocks.size(); first < size;) {
+      auto rows = blocks.at(first)->state().numRows;
+      auto last = first + 1;
+      while (last < size && rows + blocks.at(last)->state().numRows <= maxRows) {
+        rows += blocks.at(last++)->state().numRows;
+      }
+
+      if (last - first > 1) {
+        std::vector<std::shared_ptr<BatchBlock>> group(blocks.begin() + first, blocks.begin() + last);
+        if (merge(*table, *item.second.state, group)) {
+          reduced += group.size() - 1;
+        }
+      }
+
+      first = last;
+    }
+  }
+
+  if (reduced > 0) {
+    LOG(INFO) << "Compacted small blocks, number of blocks reduced: " << reduced;
+  }
+
+  return reduced;
+}
+
+bool BlockManager::merge(const Table& table, TableState& state, const std::vector<std::shared_ptr<BatchBlock>>& blocks) {
+  // blocks built by an older schema of the table are left as they are
+  const auto schema = table.schema();
+  size_t rows = 0;
+  size_t id = std::numeric_limits<size_t>::max();
+  std::pair<size_t, size_t> range{ std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() };
+  for (const auto& block : blocks) {
+    const auto& data = *block->data();
+    if (data.schema()->size() != schema->size() || data.getPid() != 0 || !data.complete()) {
+      return false;
+    }
+
+    for (size_t i = 0, size = schema->size(); i < size; ++i) {
+      const auto expected = schema->childType(i);
+      const auto actual = data.schema()->childType(i);
+      if (expected->name() != actual->name() || expected->k() != actual->k()) {
+        return false;
+      }
+    }
+
+    rows += data.getRows();
+    id = std::min(id, block->getId());
+    range.first = std::min(range.first, block->start());
+    range.second = std::max(range.second, block->end());
+  }
+
+  // merged block stays on the NUMA node of the blocks it replaces
+  std::shared_ptr<Batch> merged;
+  {
+    nebula::common::Numa::Scope numa{ blocks.front()->data()->numa() };
+    merged = std::make_shared<Batch>(table, rows);
+    for (const auto& block : blocks) {
+      const auto& data = *block->data();
+      BatchRow row(data);
+      for (size_t i = 0, size = data.getRows(); i < size; ++i) {
+        merged->add(row.seek(i));
+      }
+    }
+
+    merged->seal();
+  }
+
+  // ids of source blocks are released by the merge, so the smallest one is reused
+  const auto& spec = blocks.front()->spec();
+  auto block = io::BlockLoader::from(BlockSignature{ table.name(), id, range.first, range.second, spec }, merged);
   std::lock_guard<std::mutex> lock(dmux_);
+  if (held_.find(spec) != held_.end() || !state.merge(blocks, block)) {
+    return false;
+  }
+
+  blocks_ -= blocks.size() - 1;
+  if (tier_) {
+    for (const auto& b : blocks) {
+      tier_->drop(*b);
+    }
+  }
+
+  return true;
+}
+
+// fingerprint of all blocks of the table, blocks are combined by sum so it doesn't depend on iteration order,
+// and node states rebuilt by node sync with the same blocks get the same version.
+size_t BlockManager::version(const std::string& table) const {
+  size_t version = 0;
+  size_t blocks = 0;
+  const auto nodes = snapshot();
+  for (const auto& node : *nodes) {
+    const auto& states = node.second;
+    auto state = states.find(table);
+    if (state == states.end()) {
+      continue;
+    }
 
+    state->second->iterate([&version, &blocks](const io::BatchBlock& block) {
+      const size_t sign[] = { block.hash(), block.state().numRows };
+      version += nebula::common::Hasher::hash64(sign, sizeof(sign));
+      ++blocks;
+    });
+  }
+
+  return version ^ blocks;
+}
+
+std::shared_ptr<Histogram> BlockManager::hist(const std::string& table, const std::string& col) const {
   // go through all nodes's block set
   // TODO: wrong - first block histogram will be polllueted
   std::shared_ptr<Histogram> hist = nullptr;
-  for (auto n = data_.begin(); n != data_.end(); ++n) {
+  const auto nodes = snapshot();
+  for (auto n = nodes->begin(); n != nodes->end(); ++n) {
     const auto& states = n->second;
     auto state = states.find(table);
     if (state != states.end()) {
-      auto inst = state->second->hists().at(col);
+      auto inst = state->second->hist(col);
+      if (inst == nullptr) {
+        continue;
+      }
+
       if (hist == nullptr) {
         // make a copy
-        hist = nebula::surface::eval::from(inst->toString());
+        hist = inst->clone();
       } else {
         hist->merge(*inst);
       }
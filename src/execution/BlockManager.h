@@ -17,12 +17,16 @@
 #pragma once
 
 #include <forward_list>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include "ExecutionPlan.h"
+#include "QueryPatterns.h"
 #include "TableState.h"
 #include "common/Folly.h"
 #include "common/Hash.h"
+#include "execution/io/BlockTier.h"
 
 /**
  * Define nebula execution runtime.
@@ -50,6 +54,13 @@ using TableStates = nebula::common::unordered_map<std::string, std::shared_ptr<T
 using FilteredBlocks = std::vector<nebula::memory::EvaledBlock>;
 using StringSet = nebula::common::unordered_set<std::string>;
 
+// node to its table states mapping
+using NodeStates = nebula::common::unordered_map<
+  nebula::meta::NNode,
+  TableStates,
+  nebula::meta::NodeHash,
+  nebula::meta::NodeEqual>;
+
 class BlockManager {
 public:
   BlockManager(BlockManager&) = delete;
@@ -64,6 +75,10 @@ public:
   // query all nodes that hold data for given table
   const std::vector<nebula::meta::NNode> query(const std::string&);
 
+  // nodes of the plan holding blocks of the table which may match the query: in its window, not skipped
+  // by the query on the node, and not ruled out by the filter on block summaries unless the table is partitioned
+  const std::vector<nebula::meta::NNode> nodes(const nebula::meta::Table&, const PlanPtr) const;
+
   // add given block into the target table states repo
   static bool addBlock(TableStates&, std::shared_ptr<io::BatchBlock>);
 
@@ -86,6 +101,38 @@ public:
   // return number of blocks removed
   size_t removeBySpec(const std::string&, const std::string&);
 
+  // remove blocks of a spec in local node selected by the predicate and add a block list in one step,
+  // queries see either the removed blocks or the added ones of the table. Return number of blocks removed.
+  size_t swap(const std::string&,
+              const std::string&,
+              const std::function<bool(const io::BatchBlock&)>&,
+              io::BlockList&);
+
+  // blocks of a table (and its rollups) live for given seconds after their end time, 0 to keep them until
+  // their spec is taken offline. Local blocks added afterwards are indexed by their expiration time.
+  void retain(const std::string&, size_t);
+
+  // remove specs in local node whose blocks are all past retention at given unix time.
+  // specs are popped from a min-heap of expiration time, so it costs by number of expired specs only.
+  // return table-spec pairs removed.
+  TableSpecSet expire(size_t);
+
+  // merge small blocks in memory of the same spec, adjacent by time, into blocks of up to max rows.
+  // a merged block replaces its sources in one step for queries. Tables of blocks are provided by the lookup.
+  // return number of blocks reduced.
+  size_t compact(size_t, size_t, const std::function<nebula::meta::TablePtr(const std::string&)>&);
+
+  // a spec being ingested may publish and replace its own blocks, its blocks are not compacted until released
+  inline void hold(const std::string& spec) {
+    std::lock_guard<std::mutex> lock(dmux_);
+    held_.emplace(spec);
+  }
+
+  inline void release(const std::string& spec) {
+    std::lock_guard<std::mutex> lock(dmux_);
+    held_.erase(spec);
+  }
+
   inline void recordEmptySpec(const std::string& spec) noexcept {
     emptySpecs_.emplace(spec);
   }
@@ -100,33 +147,49 @@ public:
   }
 
   // get table state for given table name in local node
+  // table states are never removed from local node, so it lives as long as this object
   const TableStateBase& state(const std::string& table) const {
-    const auto& self = local();
-    if (self.find(table) == self.end()) {
+    const auto nodes = snapshot();
+    const auto& self = nodes->at(nebula::meta::NNode::inproc());
+    auto found = self.find(table);
+    if (found == self.end()) {
       return TableStateBase::empty();
     }
 
-    return *self.at(table);
+    return *found->second;
   }
 
-  // get all table states for given node
-  inline const TableStates& states(const nebula::meta::NNode& node = nebula::meta::NNode::inproc()) {
+  // get all table states for given node, it is empty if the node is not in
+  inline TableStates states(const nebula::meta::NNode& node = nebula::meta::NNode::inproc()) const {
+    const auto nodes = snapshot();
+    auto found = nodes->find(node);
+    return found == nodes->end() ? TableStates{} : found->second;
+  }
+
+  // swap table states for given node, along with the node's version of the states
+  inline void swap(const nebula::meta::NNode& node, TableStates states, size_t version = 0) {
     std::lock_guard<std::mutex> lock(dmux_);
-    // it may reutrn empty result if the node is not in
-    return data_[node];
+    auto next = std::make_shared<NodeStates>(*data_);
+    (*next)[node] = std::move(states);
+    publish(std::move(next));
+    versions_[node] = version;
   }
 
-  // swap table states for given node
-  inline void swap(const nebula::meta::NNode& node, TableStates states) {
+  // version of table states swapped in for given node, 0 if unknown
+  inline size_t synced(const nebula::meta::NNode& node) const {
     std::lock_guard<std::mutex> lock(dmux_);
-    data_[node] = states;
+    auto found = versions_.find(node);
+    return found == versions_.end() ? 0 : found->second;
   }
 
   inline void removeNode(const std::string& addr) {
     std::lock_guard<std::mutex> lock(dmux_);
-    for (auto itr = data_.begin(); itr != data_.end(); ++itr) {
+    for (auto itr = data_->begin(); itr != data_->end(); ++itr) {
       if (addr == itr->first.toString()) {
-        data_.erase(itr);
+        versions_.erase(itr->first);
+        auto next = std::make_shared<NodeStates>(*data_);
+        next->erase(itr->first);
+        publish(std::move(next));
         break;
       }
     }
@@ -138,9 +201,9 @@ public:
 
   // get table list of current node
   StringSet tables(const size_t limit) const noexcept {
-    std::lock_guard<std::mutex> lock(dmux_);
     StringSet tables;
-    for (const auto& node : data_) {
+    const auto nodes = snapshot();
+    for (const auto& node : *nodes) {
       for (const auto& ts : node.second) {
         tables.emplace(ts.first);
       }
@@ -158,15 +221,15 @@ public:
   bool hasSpec(const std::string& table,
                const std::string& spec,
                const nebula::meta::NNode& node = nebula::meta::NNode::inproc()) {
-    std::lock_guard<std::mutex> lock(dmux_);
     // if empty spec list includes it
     if (emptySpecs_.find(spec) != emptySpecs_.end()) {
       return true;
     }
 
     // search data list
-    auto entry = data_.find(node);
-    if (entry != data_.end()) {
+    const auto nodes = snapshot();
+    auto entry = nodes->find(node);
+    if (entry != nodes->end()) {
       const auto& states = entry->second;
       auto ts = states.find(table);
       if (ts != states.end()) {
@@ -178,10 +241,10 @@ public:
   }
 
   TableStateBase metrics(const std::string& table) const {
-    std::lock_guard<std::mutex> lock(dmux_);
     TableStateBase metricsOnly{ table };
     // aggregate all nodes for given table
-    for (auto& ts : data_) {
+    const auto nodes = snapshot();
+    for (auto& ts : *nodes) {
       const auto& states = ts.second;
       auto found = states.find(table);
       if (found != states.end()) {
@@ -194,12 +257,12 @@ public:
 
   // get all active specs
   StringSet activeSpecs() const {
-    std::lock_guard<std::mutex> lock(dmux_);
+    const auto states = snapshot();
     const auto nodes = nebula::meta::ClusterInfo::singleton().nodes();
     StringSet specs;
     for (const auto& node : nodes) {
-      auto entry = data_.find(node);
-      if (entry != data_.end()) {
+      auto entry = states->find(node);
+      if (entry != states->end()) {
         const auto& states = entry->second;
         for (auto& ts : states) {
           auto nodeSpecs = ts.second->specs();
@@ -213,37 +276,113 @@ public:
   }
 
   // get historgram of given table/column
-  std::shared_ptr<nebula::surface::eval::Histogram> hist(const std::string&, size_t) const;
+  std::shared_ptr<nebula::surface::eval::Histogram> hist(const std::string&, const std::string&) const;
+
+  // data version of given table across all nodes, it changes whenever a block of the table is added or expired
+  size_t version(const std::string&) const;
+
+  // evict blocks costing most to keep by size, hotness and age to cold tier until blocks in memory fit its budget
+  void balance();
+
+  // load blocks of windows predicted for recurring queries to run within given seconds from given unix time,
+  // and keep them hot in the cold tier. Return number of blocks loaded back.
+  size_t warmup(size_t, size_t);
+
+  inline const QueryPatterns& patterns() const noexcept {
+    return patterns_;
+  }
 
 private:
-  BlockManager() : blocks_{ 0 } {
-    data_.emplace(nebula::meta::NNode::inproc(), TableStates{});
+  BlockManager() : blocks_{ 0 }, tier_{ io::BlockTier::make() } {
+    auto nodes = std::make_shared<NodeStates>();
+    nodes->emplace(nebula::meta::NNode::inproc(), TableStates{});
+    publish(std::move(nodes));
   }
 
-  inline TableStates& local() {
-    return data_.at(nebula::meta::NNode::inproc());
+  // current snapshot of all node states, readers hold it without any lock
+  inline std::shared_ptr<const NodeStates> snapshot() const {
+    return std::atomic_load(&data_);
   }
 
-  inline const TableStates& local() const {
-    return data_.at(nebula::meta::NNode::inproc());
+  // publish a new snapshot, called by writers with dmux_ held
+  inline void publish(std::shared_ptr<const NodeStates> nodes) {
+    std::atomic_store(&data_, std::move(nodes));
   }
 
+  // table state of given table in given node, a new one is published if it's absent, called with dmux_ held
+  std::shared_ptr<TableState> state(const nebula::meta::NNode&, const std::string&);
+
+  // load a cold block, or a block missing some of given columns, back into memory and evaluate filter on it
+  // only given columns (all if empty) and columns loaded already are loaded
+  folly::Future<FilteredBlocks> promote(folly::ThreadPoolExecutor&,
+                                        const nebula::surface::eval::ValueEval&,
+                                        const io::BlockSnapshot::Columns&,
+                                        std::shared_ptr<TableState>,
+                                        std::shared_ptr<io::BatchBlock>);
+
+  // load a block back into memory with given columns and columns loaded already, and replace it in the table state
+  // return the loaded block, nullptr if it failed
+  std::shared_ptr<io::BatchBlock> reload(TableState&,
+                                         std::shared_ptr<io::BatchBlock>,
+                                         const io::BlockSnapshot::Columns&);
+
+  // index a local block by its expiration time, a spec expires with its latest block
+  void index(const io::BatchBlock&);
+
+  // merge given blocks of a table state into one, return true if they are replaced by the merged block
+  bool merge(const nebula::meta::Table&, TableState&, const std::vector<std::shared_ptr<io::BatchBlock>>&);
+
 private:
   // counter for in/out of blocks
   size_t blocks_;
 
-  // meta data for remote blocks
+  // meta data of blocks in every node, an immutable snapshot replaced by writers as a whole.
+  // a table state is shared by snapshots and changes its blocks by itself, so only new tables or nodes
+  // publish a new snapshot.
+  std::shared_ptr<const NodeStates> data_;
+
+  // versions of remote node states
   nebula::common::unordered_map<
     nebula::meta::NNode,
-    TableStates,
+    size_t,
     nebula::meta::NodeHash,
     nebula::meta::NodeEqual>
-    data_;
+    versions_;
 
   // empty specs
   StringSet emptySpecs_;
+
+  // specs being ingested, excluded from compaction
+  StringSet held_;
+
+  // serializes writers of data_ and guards other members
   mutable std::mutex dmux_;
 
+  // expiration time of local specs: a min-heap of (time, table, spec) and the current time of every spec.
+  // a heap entry not matching current time of its spec is stale and dropped when popped.
+  struct Due {
+    size_t time;
+    std::string table;
+    std::string spec;
+
+    inline bool operator>(const Due& other) const noexcept {
+      return time > other.time;
+    }
+  };
+  std::vector<Due> dues_;
+  nebula::common::unordered_map<std::pair<std::string, std::string>, size_t> expires_;
+
+  // retention seconds by table name
+  nebula::common::unordered_map<std::string, size_t> retentions_;
+  std::mutex emux_;
+
+  // cold tier of local blocks, nullptr if disabled
+  std::unique_ptr<io::BlockTier> tier_;
+  std::mutex tmux_;
+
+  // recurring queries served by this node
+  QueryPatterns patterns_;
+
 private:
   static std::mutex smux;
   static std::shared_ptr<BlockManager> inst;
@@ -16,6 +16,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "common/Hash.h"
 #include "meta/ClusterInfo.h"
 
@@ -37,7 +45,72 @@ enum class Error {
   COLUMN_PERM,
   NOT_SUPPORT,
   INVALID_QUERY,
-  INVALID_METRIC
+  INVALID_METRIC,
+  MEMORY_LIMIT
+};
+
+// time of a call to a node seen by server: round trip including the node's own compute, and bytes received
+struct NodeProfile {
+  std::string node;
+  size_t callUs;
+  size_t bytes;
+};
+
+// where time of a query goes phase by phase, all times are in microseconds.
+// block times are summed over all blocks (cpu time) while other times are wall time of each phase.
+struct QueryProfile {
+  // blocks in query window pruned by block metadata (histograms and bloom filters) or partition values
+  size_t blocksPrunedMeta = 0;
+  size_t blocksPrunedPartition = 0;
+  // block computes: filtering rows and computing (aggregating) selected rows
+  size_t filterUs = 0;
+  size_t aggregateUs = 0;
+  // merging block results on nodes
+  size_t nodeMergeUs = 0;
+  // node results serialized and sent to server, deserialize time on server is added up too
+  size_t serdeBytes = 0;
+  size_t serdeUs = 0;
+  // merging node results and finalizing them on server
+  size_t serverMergeUs = 0;
+  size_t finalizeUs = 0;
+  std::vector<NodeProfile> nodes;
+
+  inline void merge(const QueryProfile& other) {
+    blocksPrunedMeta += other.blocksPrunedMeta;
+    blocksPrunedPartition += other.blocksPrunedPartition;
+    filterUs += other.filterUs;
+    aggregateUs += other.aggregateUs;
+    nodeMergeUs += other.nodeMergeUs;
+    serdeBytes += other.serdeBytes;
+    serdeUs += other.serdeUs;
+    serverMergeUs += other.serverMergeUs;
+    finalizeUs += other.finalizeUs;
+    nodes.insert(nodes.end(), other.nodes.begin(), other.nodes.end());
+  }
+};
+
+// time spent by concurrent block computes of a query on a node
+class ComputeTime {
+public:
+  ComputeTime() : filterUs_{ 0 }, aggregateUs_{ 0 } {}
+  virtual ~ComputeTime() = default;
+
+  inline void add(size_t filterUs, size_t aggregateUs) noexcept {
+    filterUs_.fetch_add(filterUs, std::memory_order_relaxed);
+    aggregateUs_.fetch_add(aggregateUs, std::memory_order_relaxed);
+  }
+
+  inline size_t filterUs() const noexcept {
+    return filterUs_.load(std::memory_order_relaxed);
+  }
+
+  inline size_t aggregateUs() const noexcept {
+    return aggregateUs_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<size_t> filterUs_;
+  std::atomic<size_t> aggregateUs_;
 };
 
 // recording query stats
@@ -45,17 +118,267 @@ struct QueryStats {
   explicit QueryStats()
     : blocksScan{ 0 },
       rowsScan{ 0 },
-      rowsRet{ 0 } {}
+      rowsRet{ 0 },
+      blocksTotal{ 0 },
+      rowsTotal{ 0 },
+      nodesFailed{ 0 },
+      nodesTimeout{ 0 } {}
   // blocks scanned in given compute
   size_t blocksScan;
   // rows scanned in given compute
   size_t rowsScan;
   // rows returned in given compute
   size_t rowsRet;
+  // blocks and rows matched by the query before sampling, the same as scanned for an exact query
+  size_t blocksTotal;
+  size_t rowsTotal;
+  // calls to nodes which failed or timed out, their results are missing in the query result
+  size_t nodesFailed;
+  size_t nodesTimeout;
+  QueryProfile profile;
+
+  // add up stats of another compute such as a node call, calls to nodes complete concurrently
+  inline void merge(const QueryStats& other) {
+    std::lock_guard<std::mutex> lock(lock_);
+    blocksScan += other.blocksScan;
+    rowsScan += other.rowsScan;
+    rowsRet += other.rowsRet;
+    blocksTotal += other.blocksTotal;
+    rowsTotal += other.rowsTotal;
+    nodesFailed += other.nodesFailed;
+    nodesTimeout += other.nodesTimeout;
+    profile.merge(other.profile);
+  }
+
+  // the result misses results of some nodes
+  inline bool partial() const {
+    return nodesFailed > 0 || nodesTimeout > 0;
+  }
+
+  // an approximate query scans a sample of matched blocks
+  inline bool sampled() const {
+    return rowsScan > 0 && rowsTotal > rowsScan;
+  }
+
+  // factor to scale up COUNT and SUM computed on sampled rows
+  inline double scale() const {
+    return sampled() ? (double)rowsTotal / rowsScan : 1;
+  }
+
+  // 95% confidence margin of a scaled COUNT, it is within [-margin, +margin] of the exact value.
+  // scanned rows are taken as a simple random sample of all rows, so it's optimistic if blocks differ a lot.
+  // the worst case of a group having half of all rows is used, smaller groups have smaller margins.
+  inline double margin() const {
+    if (!sampled()) {
+      return 0;
+    }
+
+    const auto unsampled = 1 - (double)rowsScan / rowsTotal;
+    return Z95 * 0.5 * rowsTotal * std::sqrt(unsampled / rowsScan);
+  }
+
   inline std::string toString() const {
-    return fmt::format("blocks scan:{0}, rows scan: {1}, rows returned: {2}",
-                       blocksScan, rowsScan, rowsRet);
+    return fmt::format("blocks scan:{0}, rows scan: {1}, rows returned: {2}, blocks total: {3}, rows total: {4}, "
+                       "nodes failed: {5}, nodes timeout: {6}",
+                       blocksScan, rowsScan, rowsRet, blocksTotal, rowsTotal, nodesFailed, nodesTimeout);
+  }
+
+private:
+  static constexpr double Z95 = 1.96;
+  std::mutex lock_;
+};
+
+// cancellation token shared by all tasks of a query, such as block computes, merges and node RPCs.
+// a query is cancelled explicitly (e.g. its client disconnected) or when its deadline passes.
+// running tasks check it periodically and give up their work, pending tasks don't start at all.
+class Cancellation {
+public:
+  Cancellation() : cancelled_{ false }, deadline_{ 0 }, id_{ 0 } {}
+  virtual ~Cancellation() = default;
+
+  // cancel the query, every listener is notified once
+  void cancel() {
+    if (cancelled_.exchange(true)) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+    for (auto& listener : listeners_) {
+      listener.second();
+    }
+  }
+
+  // cheap enough to check in a loop: cancelled or deadline passed
+  inline bool cancelled() const noexcept {
+    return cancelled_.load(std::memory_order_relaxed) || (deadline_ > 0 && now() >= deadline_);
+  }
+
+  // check the external source of cancellation too, the query is cancelled if it says so
+  inline bool poll() {
+    if (cancelled()) {
+      return true;
+    }
+
+    if (probe_ && probe_()) {
+      cancel();
+      return true;
+    }
+
+    return false;
+  }
+
+  // deadline as unix time in milliseconds, 0 means no deadline.
+  // it's an absolute time so it keeps the same meaning when passed to nodes.
+  inline void deadline(size_t deadline) noexcept {
+    deadline_ = deadline;
+  }
+
+  inline size_t deadline() const noexcept {
+    return deadline_;
+  }
+
+  // milliseconds left before the deadline, 0 if passed already
+  inline size_t remaining() const noexcept {
+    const auto n = now();
+    return deadline_ > n ? deadline_ - n : 0;
+  }
+
+  // set an external source of cancellation such as a disconnected client, it's probed by poll.
+  // it should be set before any task starts.
+  inline void watch(std::function<bool()> probe) noexcept {
+    probe_ = std::move(probe);
+  }
+
+  // register a callback invoked when the query is cancelled, such as cancelling a pending RPC.
+  // it's invoked right away if the query is cancelled already, return an id to remove it.
+  size_t listen(std::function<void()> callback) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (cancelled_.load()) {
+      callback();
+      return 0;
+    }
+
+    listeners_.emplace(++id_, std::move(callback));
+    return id_;
   }
+
+  void unlisten(size_t id) {
+    std::lock_guard<std::mutex> guard(lock_);
+    listeners_.erase(id);
+  }
+
+  // unix time in milliseconds
+  inline static size_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+  }
+
+private:
+  std::atomic<bool> cancelled_;
+  size_t deadline_;
+  std::function<bool()> probe_;
+
+  std::mutex lock_;
+  size_t id_;
+  nebula::common::unordered_map<size_t, std::function<void()>> listeners_;
+};
+
+// memory used by a query, such as its aggregation results on a node.
+// the query is cancelled as soon as it uses more than its limit, so it fails fast rather than taking down the node.
+class MemoryBudget {
+public:
+  explicit MemoryBudget(std::shared_ptr<Cancellation> cancel)
+    : used_{ 0 }, limit_{ 0 }, exceeded_{ false }, cancel_{ std::move(cancel) } {}
+  virtual ~MemoryBudget() = default;
+
+  // limit in bytes, 0 means no limit
+  inline void limit(size_t limit) noexcept {
+    limit_ = limit;
+  }
+
+  inline size_t limit() const noexcept {
+    return limit_;
+  }
+
+  inline size_t used() const noexcept {
+    return used_.load(std::memory_order_relaxed);
+  }
+
+  inline bool exceeded() const noexcept {
+    return exceeded_.load(std::memory_order_relaxed);
+  }
+
+  // charge bytes to the query, return false if it goes beyond the limit and the query is cancelled
+  inline bool charge(size_t bytes) {
+    process().fetch_add(bytes, std::memory_order_relaxed);
+    const auto used = used_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (limit_ > 0 && used > limit_) {
+      if (!exceeded_.exchange(true)) {
+        cancel_->cancel();
+      }
+
+      return false;
+    }
+
+    return !exceeded();
+  }
+
+  inline void release(size_t bytes) noexcept {
+    process().fetch_sub(bytes, std::memory_order_relaxed);
+    used_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  // bytes charged by all queries running in this process
+  static inline size_t inUse() noexcept {
+    return process().load(std::memory_order_relaxed);
+  }
+
+private:
+  static inline std::atomic<size_t>& process() noexcept {
+    static std::atomic<size_t> PROCESS{ 0 };
+    return PROCESS;
+  }
+
+private:
+  std::atomic<size_t> used_;
+  size_t limit_;
+  std::atomic<bool> exceeded_;
+  std::shared_ptr<Cancellation> cancel_;
+};
+
+// bytes charged to a budget by one owner such as a block compute, they are released when it's destroyed
+class MemoryCharge {
+public:
+  explicit MemoryCharge(MemoryBudget* budget) : budget_{ budget }, bytes_{ 0 } {}
+  MemoryCharge(const MemoryCharge&) = delete;
+  MemoryCharge& operator=(const MemoryCharge&) = delete;
+  virtual ~MemoryCharge() {
+    if (budget_) {
+      budget_->release(bytes_);
+    }
+  }
+
+  // update the charge to current bytes held by the owner, return false if the budget is exceeded
+  inline bool update(size_t bytes) {
+    if (!budget_) {
+      return true;
+    }
+
+    if (bytes > bytes_) {
+      const auto delta = bytes - bytes_;
+      bytes_ = bytes;
+      return budget_->charge(delta);
+    }
+
+    budget_->release(bytes_ - bytes);
+    bytes_ = bytes;
+    return !budget_->exceeded();
+  }
+
+private:
+  MemoryBudget* budget_;
+  size_t bytes_;
 };
 
 class QueryContext {
@@ -64,7 +387,10 @@ public:
     : user_{ user },
       groups_{ std::move(groups) },
       error_{ Error::NONE },
-      stats_{} {}
+      stats_{},
+      cancellation_{ std::make_shared<Cancellation>() },
+      memory_{ std::make_shared<MemoryBudget>(cancellation_) },
+      computeTime_{ std::make_shared<ComputeTime>() } {}
 
   inline bool isAuth() const {
     // any authorized uesr will have at least one group regardless what the name is
@@ -96,9 +422,22 @@ public:
     return stats_;
   }
 
-  inline static std::unique_ptr<QueryContext> def() {
+  // shared by tasks which may outlive the context
+  inline const std::shared_ptr<Cancellation>& cancellation() const {
+    return cancellation_;
+  }
+
+  inline const std::shared_ptr<MemoryBudget>& memory() const {
+    return memory_;
+  }
+
+  inline const std::shared_ptr<ComputeTime>& computeTime() const {
+    return computeTime_;
+  }
+
+  inline static std::unique_ptr<QueryContext> def(const std::string& user = "nebula") {
     return std::make_unique<QueryContext>(
-      "nebula", nebula::common::unordered_set<std::string>{ "nebula-users" });
+      user, nebula::common::unordered_set<std::string>{ "nebula-users" });
   }
 
   inline static std::unique_ptr<QueryContext> create(
@@ -112,6 +451,9 @@ private:
   nebula::common::unordered_set<std::string> groups_;
   Error error_;
   QueryStats stats_;
+  std::shared_ptr<Cancellation> cancellation_;
+  std::shared_ptr<MemoryBudget> memory_;
+  std::shared_ptr<ComputeTime> computeTime_;
 };
 
 } // namespace execution
@@ -36,14 +36,38 @@ using nebula::type::TypeSerializer;
 
 ExecutionPlan::ExecutionPlan(
   std::unique_ptr<QueryContext> ctx,
-  std::unique_ptr<ExecutionPhase> plan,
+  std::shared_ptr<const ExecutionPhase> plan,
   std::vector<NNode> nodes,
   Schema output)
   : uuid_{ "<uuid>" },
     ctx_{ std::move(ctx) },
     plan_{ std::move(plan) },
     nodes_{ std::move(nodes) },
-    output_{ output } {}
+    output_{ output },
+    sample_{ 1 } {}
+
+std::shared_ptr<ExecutionPlan> ExecutionPlan::fork(std::unique_ptr<QueryContext> ctx) const {
+  auto plan = std::make_shared<ExecutionPlan>(std::move(ctx), plan_, nodes_, output_);
+  plan->setSample(sample_);
+  return plan;
+}
+
+void ExecutionPlan::setRollings(Rollings rollings) {
+  // rolled values are doubles no matter what type the metric is
+  std::vector<nebula::type::TreeNode> children;
+  children.reserve(output_->size());
+  for (size_t i = 0, size = output_->size(); i < size; ++i) {
+    children.push_back(output_->childAt(i));
+  }
+
+  for (const auto& r : rollings.columns) {
+    N_ENSURE_LT(r.field, children.size(), "rolling column out of range");
+    children.at(r.field) = nebula::type::DoubleType::createTree(output_->childType(r.field)->name());
+  }
+
+  output_ = std::static_pointer_cast<nebula::type::RowType>(nebula::type::RowType::create("", children));
+  rollings_ = std::move(rollings);
+}
 
 void ExecutionPlan::display() const {
   LOG(INFO) << "Query will be executed in nodes: " << nodes_.size();
@@ -16,11 +16,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <numeric>
 
 #include "Context.h"
 #include "common/Cursor.h"
+#include "common/Errors.h"
 #include "meta/NNode.h"
+#include "meta/Table.h"
 #include "surface/DataSurface.h"
 #include "surface/SchemaRow.h"
 #include "surface/eval/ValueEval.h"
@@ -68,12 +72,71 @@ using BlockPhase = Phase<PhaseType::COMPUTE>;
 using NodePhase = Phase<PhaseType::PARTIAL>;
 using FinalPhase = Phase<PhaseType::GLOBAL>;
 
+// a round of exact distributed top N asked by server, nodes return a subset of their results by it.
+// see core/TopThreshold.h for the protocol
+struct TopRound {
+  enum class Step : int8_t {
+    // nodes return whole results
+    NONE = 0,
+    // local top N groups by the sort column
+    TOP = 1,
+    // groups whose local sort value is no less than the threshold
+    THRESHOLD = 2,
+    // groups whose key hash is one of the keys
+    KEYS = 3
+  };
+
+  Step step = Step::NONE;
+  double threshold = 0;
+  nebula::common::unordered_set<size_t> keys;
+};
+
+// a key field of time bucket computed as (_time_ - begin) / window * window, such as window of timeline
+// window is 0 if there is no such key
+struct TimeBucket {
+  size_t field = 0;
+  int64_t begin = 0;
+  int64_t window = 0;
+};
+
+// a window function over a metric column along time buckets of every series of a timeline result,
+// a series is all rows of the same keys other than the time bucket.
+struct Rolling {
+  enum class Type : int8_t {
+    // average of the last N buckets in time
+    MOVING_AVG = 1,
+    // change of value per second since the previous bucket
+    RATE = 2,
+    // sum of all buckets so far
+    CUMSUM = 3
+  };
+
+  size_t field = 0;
+  Type type = Type::CUMSUM;
+  // number of buckets averaged by moving average
+  size_t points = 0;
+};
+
+// window functions evaluated by server on the final result of a query, see core/Rolling.h
+struct Rollings {
+  TimeBucket bucket;
+  std::vector<Rolling> columns;
+
+  inline bool empty() const noexcept {
+    return columns.empty();
+  }
+};
+
+// specs a node skips in a query since other replicas of them serve the query, keyed by node address.
+// a node finds its own specs by the in-process node address.
+using SpecSkips = nebula::common::unordered_map<std::string, nebula::common::unordered_set<std::string>>;
+
 // An execution plan that can be serialized and passed around
 // protobuf?
 class ExecutionPlan {
 public:
   ExecutionPlan(std::unique_ptr<QueryContext>,
-                std::unique_ptr<ExecutionPhase>,
+                std::shared_ptr<const ExecutionPhase>,
                 std::vector<nebula::meta::NNode>,
                 nebula::type::Schema);
   virtual ~ExecutionPlan() = default;
@@ -81,6 +144,10 @@ public:
 public:
   void display() const;
 
+  // a plan sharing compiled phases of this plan for another execution with its own context,
+  // parameters of the execution such as window are set on the new plan.
+  std::shared_ptr<ExecutionPlan> fork(std::unique_ptr<QueryContext>) const;
+
   template <PhaseType PT>
   const Phase<PT>& fetch() const;
 
@@ -88,6 +155,11 @@ public:
     return nodes_;
   }
 
+  // nodes to run the query, pruned from the ones holding the table before the query is sent
+  inline void setNodes(std::vector<nebula::meta::NNode> nodes) noexcept {
+    nodes_ = std::move(nodes);
+  }
+
   const std::string& id() const {
     return uuid_;
   }
@@ -105,6 +177,47 @@ public:
     return window_;
   }
 
+  // fraction of matched blocks to scan in (0, 1], 1 means an exact query
+  inline void setSample(double sample) noexcept {
+    sample_ = sample;
+  }
+
+  inline double getSample() const noexcept {
+    return sample_;
+  }
+
+  // round of exact distributed top N the plan is executed for, set by server before every fan-out
+  inline void setTopRound(TopRound round) noexcept {
+    round_ = std::move(round);
+  }
+
+  inline const TopRound& getTopRound() const noexcept {
+    return round_;
+  }
+
+  // window functions on the final result, their columns are DOUBLE in the output schema
+  void setRollings(Rollings rollings);
+
+  inline const Rollings& getRollings() const noexcept {
+    return rollings_;
+  }
+
+  // route every replicated spec to one of its replicas, the others skip it, set by server before fan-out
+  inline void setSkips(SpecSkips skips) noexcept {
+    skips_ = std::move(skips);
+  }
+
+  inline const SpecSkips& getSkips() const noexcept {
+    return skips_;
+  }
+
+  // specs given node skips in this query
+  inline const nebula::common::unordered_set<std::string>& skips(const nebula::meta::NNode& node) const noexcept {
+    static const nebula::common::unordered_set<std::string> NONE;
+    auto found = skips_.find(node.toString());
+    return found == skips_.end() ? NONE : found->second;
+  }
+
   inline QueryContext& ctx() const noexcept {
     return *ctx_;
   }
@@ -115,10 +228,16 @@ private:
 private:
   const std::string uuid_;
   std::unique_ptr<QueryContext> ctx_;
-  std::unique_ptr<ExecutionPhase> plan_;
+
+  // phases are read-only once compiled, they may be shared by plans of repeated queries
+  std::shared_ptr<const ExecutionPhase> plan_;
   std::vector<nebula::meta::NNode> nodes_;
   nebula::type::Schema output_;
   QueryWindow window_;
+  double sample_;
+  TopRound round_;
+  SpecSkips skips_;
+  Rollings rollings_;
 };
 
 // execution plan will be shared across multi-threads.
@@ -185,7 +304,11 @@ public:
       input_{ input },
       output_{ output },
       numAggregates_{ 0 },
-      limit_{ std::numeric_limits<size_t>::max() } {}
+      limit_{ std::numeric_limits<size_t>::max() },
+      timeRange_{ std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max() },
+      shared_{ 0 },
+      outputMap_{ nebula::surface::SchemaRow::name2index(output) },
+      serial_{ nextSerial() } {}
   virtual ~Phase() = default;
 
 public:
@@ -220,6 +343,18 @@ public:
     return *this;
   }
 
+  // signature of the compute without time predicates which require time in the given range
+  Phase& signature(std::string signature, std::pair<int64_t, int64_t> timeRange) {
+    signature_ = std::move(signature);
+    timeRange_ = timeRange;
+    return *this;
+  }
+
+  Phase& timeBucket(TimeBucket bucket) {
+    timeBucket_ = bucket;
+    return *this;
+  }
+
   Phase& aggregate(size_t numAggregates, std::vector<bool> aggregateMap) {
     numAggregates_ = numAggregates;
     aggregateMap_ = std::move(aggregateMap);
@@ -228,11 +363,51 @@ public:
   }
 
   Phase& sort(std::vector<size_t> sorts, bool desc) {
+    descs_ = std::vector<bool>(sorts.size(), desc);
     sorts_ = std::move(sorts);
     desc_ = desc;
     return *this;
   }
 
+  // sort by multiple columns, each column has its own order
+  Phase& sort(std::vector<size_t> sorts, std::vector<bool> descs) {
+    N_ENSURE_EQ(sorts.size(), descs.size(), "every sort column needs an order");
+    desc_ = !descs.empty() && descs.front();
+    sorts_ = std::move(sorts);
+    descs_ = std::move(descs);
+    return *this;
+  }
+
+  // number expressions shared by filter and fields, called once they are all set
+  Phase& share() {
+    std::vector<nebula::surface::eval::ValueEval*> roots{ filter_.get() };
+    for (auto& f : fields_) {
+      roots.push_back(f.get());
+    }
+
+    shared_ = nebula::surface::eval::number(roots);
+
+    // a script may read any column
+    columns_.clear();
+    if (hasScript()) {
+      return *this;
+    }
+
+    // time column is always read by window and time bucket, column signature is "F:{name}"
+    columns_.emplace(nebula::meta::Table::TIME_COLUMN);
+    for (auto root : roots) {
+      if (root) {
+        root->walk([this](nebula::surface::eval::ValueEval& ve) {
+          if (ve.expressionType() == nebula::surface::eval::ExpressionType::COLUMN) {
+            columns_.emplace(std::string(ve.signature().substr(2)));
+          }
+        });
+      }
+    }
+
+    return *this;
+  }
+
 public:
   virtual nebula::type::Schema outputSchema() const override {
     return output_;
@@ -268,31 +443,75 @@ public:
     return *filter_;
   }
 
+  // columns read by filter and fields, so a block loaded for this phase needs only these columns.
+  // empty if not known, such as the phase runs scripts, all columns are read then
+  inline const nebula::common::unordered_set<std::string>& columns() const {
+    return columns_;
+  }
+
   inline const std::vector<size_t>& sorts() const {
     return sorts_;
   }
 
+  // order of the first sort column
   inline bool isDesc() const {
     return desc_;
   }
 
+  // order of every sort column
+  inline const std::vector<bool>& descs() const {
+    return descs_;
+  }
+
   inline size_t top() const {
     return limit_;
   }
 
-  // decide if we want to cache expression evaluations
-  // TODO(cao) - cache evaluation is interesting, some work need to be done to have fair evaluation
-  // 1. collect both leaf and composition of evaluation expressions. asEval can open to receive and set
-  // 2. we need to push EvalContext to every level evaluation, rather than just BlockExecutor which only test top level
-  // 3. we need to keep constant evaluation from erasing, we can use signature to decide if its a const value or variables.
+  // a block with all its time in time range gets the same result from every phase of the same signature
+  inline const std::string& signature() const {
+    return signature_;
+  }
+
+  inline const std::pair<int64_t, int64_t>& timeRange() const {
+    return timeRange_;
+  }
+
+  inline const TimeBucket& timeBucket() const {
+    return timeBucket_;
+  }
+
+  // cache expression evaluations only if some expression is shared, its value is computed once per row.
+  // constants and column reads are never cached (see share).
   inline bool cacheEval() const {
-    return false;
+    return shared_ > 0;
   }
 
   inline bool hasAggregation() const {
     return numAggregates_ > 0;
   }
 
+  // output field name to index, shared by rows computed for this phase
+  inline const nebula::surface::Name2Index& outputMap() const noexcept {
+    return outputMap_;
+  }
+
+  // script data shared by evaluation contexts of all blocks, nullptr if the phase runs no script.
+  // it is built at first use when the phase is fully set
+  inline std::shared_ptr<nebula::surface::eval::ScriptData> scriptData() const {
+    std::call_once(scriptOnce_, [this]() {
+      if (hasScript()) {
+        scriptData_ = std::make_shared<nebula::surface::eval::ScriptData>(inputSchema(), customs_);
+      }
+    });
+
+    return scriptData_;
+  }
+
+  // unique number of this phase in the process, objects kept for a phase are identified by it, not its address
+  inline size_t serial() const noexcept {
+    return serial_;
+  }
+
   // TODO(cao): current implementation is not correct because it only checks the top value eval object
   // consider moving the tree structure ("children") from TypeValueEval into ValueEval
   // in fact, every value eval is a tree, it should be recursive method to check any node is script expression
@@ -335,11 +554,34 @@ private:
 
   // sorting properties
   std::vector<size_t> sorts_;
-  // TODO(cao) - every sort column may have different order, single direction now
   bool desc_;
+  std::vector<bool> descs_;
 
   // results limitation
   size_t limit_;
+
+  // compute signature and time range stripped from it, empty signature if not available
+  std::string signature_;
+  std::pair<int64_t, int64_t> timeRange_;
+
+  // time bucket key if any
+  TimeBucket timeBucket_;
+
+  // number of shared expressions
+  size_t shared_;
+
+  // columns read by this phase
+  nebula::common::unordered_set<std::string> columns_;
+
+  nebula::surface::Name2Index outputMap_;
+  size_t serial_;
+  mutable std::once_flag scriptOnce_;
+  mutable std::shared_ptr<nebula::surface::eval::ScriptData> scriptData_;
+
+  static size_t nextSerial() noexcept {
+    static std::atomic<size_t> serial{ 0 };
+    return ++serial;
+  }
 };
 
 template <>
@@ -385,6 +627,10 @@ public:
     return static_cast<const BlockPhase&>(*upstream_).isDesc();
   }
 
+  inline const std::vector<bool>& descs() const {
+    return static_cast<const BlockPhase&>(*upstream_).descs();
+  }
+
   inline size_t top() const {
     return static_cast<const BlockPhase&>(*upstream_).top();
   }
@@ -418,6 +664,10 @@ public:
     return static_cast<const NodePhase&>(*upstream_).isDesc();
   }
 
+  inline const std::vector<bool>& descs() const {
+    return static_cast<const NodePhase&>(*upstream_).descs();
+  }
+
   inline bool hasAggregation() const {
     return static_cast<const NodePhase&>(*upstream_).hasAggregation();
   }
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/Hash.h"
+#include "execution/io/BlockSnapshot.h"
+
+/**
+ * Recurring query patterns of a node, such as dashboards refreshing the same range every minute.
+ * A query is identified by its table and its window relative to query time: window width and lag of the window end,
+ * both rounded by GRAIN seconds, so "last hour of table T" is one pattern no matter when it runs.
+ * A pattern seen again learns its repeat interval, and predicts the window and columns of its next run,
+ * so that blocks in the window can be loaded back and kept resident ahead of the query.
+ */
+namespace nebula {
+namespace execution {
+
+// window and columns a recurring query is going to read
+struct Prediction {
+  std::string table;
+  std::pair<size_t, size_t> window;
+  io::BlockSnapshot::Columns columns;
+};
+
+class QueryPatterns {
+  struct Pattern {
+    std::string table;
+    size_t width;
+    size_t lag;
+    io::BlockSnapshot::Columns columns;
+    size_t last;
+    double interval;
+    size_t hits;
+  };
+
+public:
+  // seconds to round window width and lag by
+  static constexpr size_t GRAIN = 60;
+
+  // a pattern predicts after it repeats this many times
+  static constexpr size_t MIN_HITS = 3;
+
+  explicit QueryPatterns(size_t capacity = 256) : capacity_{ capacity } {}
+  virtual ~QueryPatterns() = default;
+
+public:
+  // record a query of given window and columns (all if empty) on a table at given unix time
+  void record(const std::string& table,
+              const std::pair<size_t, size_t>& window,
+              const io::BlockSnapshot::Columns& columns,
+              size_t now) {
+    // a window ending after now is a live range as well
+    const auto width = round(window.second > window.first ? window.second - window.first : 0);
+    const auto lag = round(now > window.second ? now - window.second : 0);
+    const auto key = fmt::format("{0}@{1}-{2}", table, width, lag);
+
+    std::lock_guard<std::mutex> lock(mux_);
+    auto found = patterns_.find(key);
+    if (found == patterns_.end()) {
+      if (patterns_.size() >= capacity_) {
+        prune();
+      }
+
+      patterns_.emplace(key, Pattern{ table, width, lag, columns, now, 0, 1 });
+      return;
+    }
+
+    auto& p = found->second;
+    // a query fanned out again in the same second is the same run
+    if (now <= p.last) {
+      merge(p.columns, columns);
+      return;
+    }
+
+    // interval is moving average of the recent repeats
+    const double gap = now - p.last;
+    p.interval = p.interval == 0 ? gap : (p.interval * 3 + gap) / 4;
+    p.last = now;
+    ++p.hits;
+    merge(p.columns, columns);
+  }
+
+  // windows of recurring queries expected to run within given seconds from now
+  std::vector<Prediction> predict(size_t now, size_t horizon) const {
+    std::vector<Prediction> predictions;
+    std::lock_guard<std::mutex> lock(mux_);
+    for (const auto& item : patterns_) {
+      const auto& p = item.second;
+      if (!recurring(p, now)) {
+        continue;
+      }
+
+      // next run in the horizon, a run behind by less than an interval is still expected
+      const auto next = p.last + static_cast<size_t>(p.interval);
+      if (next > now + horizon) {
+        continue;
+      }
+
+      const auto end = std::max(next, now) - p.lag;
+      predictions.push_back(Prediction{ p.table, { end > p.width ? end - p.width : 0, end }, p.columns });
+    }
+
+    return predictions;
+  }
+
+  inline size_t size() const {
+    std::lock_guard<std::mutex> lock(mux_);
+    return patterns_.size();
+  }
+
+private:
+  static inline size_t round(size_t seconds) noexcept {
+    return (seconds + GRAIN / 2) / GRAIN * GRAIN;
+  }
+
+  // a pattern missing two runs in a row is not recurring anymore
+  static inline bool recurring(const Pattern& p, size_t now) noexcept {
+    return p.hits >= MIN_HITS && p.interval > 0 && now < p.last + 2 * p.interval;
+  }
+
+  // a query reading all columns makes its pattern read all columns
+  static inline void merge(io::BlockSnapshot::Columns& columns, const io::BlockSnapshot::Columns& more) {
+    if (columns.empty()) {
+      return;
+    }
+
+    if (more.empty()) {
+      columns.clear();
+      return;
+    }
+
+    columns.insert(more.begin(), more.end());
+  }
+
+  // drop patterns not recurring, or the least recent half if all are, called with mux_ held
+  void prune() {
+    const auto now = std::max_element(patterns_.begin(), patterns_.end(), [](const auto& left, const auto& right) {
+                       return left.second.last < right.second.last;
+                     })->second.last;
+    for (auto it = patterns_.begin(); it != patterns_.end();) {
+      it = recurring(it->second, now) ? std::next(it) : patterns_.erase(it);
+    }
+
+    if (patterns_.size() >= capacity_) {
+      std::vector<size_t> times;
+      times.reserve(patterns_.size());
+      for (const auto& item : patterns_) {
+        times.push_back(item.second.last);
+      }
+
+      auto mid = times.begin() + times.size() / 2;
+      std::nth_element(times.begin(), mid, times.end());
+      for (auto it = patterns_.begin(); it != patterns_.end();) {
+        it = it->second.last <= *mid ? patterns_.erase(it) : std::next(it);
+      }
+    }
+  }
+
+private:
+  size_t capacity_;
+  // table, width and lag -> pattern
+  nebula::common::unordered_map<std::string, Pattern> patterns_;
+  mutable std::mutex mux_;
+};
+
+} // namespace execution
+} // namespace nebula
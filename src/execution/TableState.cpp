@@ -15,13 +15,14 @@
  */
 
 #include "TableState.h"
+#include <algorithm>
 
 namespace nebula {
 namespace execution {
 
 using nebula::execution::io::BatchBlock;
-using nebula::memory::BatchPtr;
 using BlockPtr = std::shared_ptr<BatchBlock>;
+using nebula::meta::BlockMemory;
 using nebula::meta::BlockSignature;
 using nebula::surface::eval::HistVector;
 
@@ -32,13 +33,34 @@ inline void update(const BlockPtr block,
                    size_t& rows,
                    size_t& bytes,
                    TableState::Window& window,
-                   HistVector& hists) {
+                   HistVector& hists,
+                   std::vector<std::string>& columns,
+                   BlockMemory& memory) {
   const auto& state = block->state();
   rows += state.numRows;
   bytes += state.rawSize;
+  memory.add(state.memory);
   window.first = std::min(block->start(), window.first);
   window.second = std::max(block->end(), window.second);
-  TableStateBase::merge(hists, state.histograms);
+  TableStateBase::merge(hists, columns, state.histograms, state.columns);
+}
+
+// take block metrics out of a list of variables, return false if the window or histograms need a rebuild
+inline bool reduce(const BlockPtr block,
+                   size_t& rows,
+                   size_t& bytes,
+                   const TableState::Window& window,
+                   HistVector& hists,
+                   const std::vector<std::string>& columns,
+                   BlockMemory& memory) {
+  const auto& state = block->state();
+  rows -= state.numRows;
+  bytes -= state.rawSize;
+  memory.subtract(state.memory);
+
+  // a block at either end of the window may be the only one there
+  auto exact = window.first < block->start() && block->end() < window.second;
+  return TableStateBase::subtract(hists, columns, state.histograms, state.columns) && exact;
 }
 
 void TableState::iterate(std::function<void(const nebula::execution::io::BatchBlock& block)> func) const {
@@ -54,26 +76,93 @@ bool TableState::add(std::shared_ptr<BatchBlock> block) {
   const auto& spec = block->spec();
 
   // collect metrics
-  update(block, rows_, bytes_, window_, hists_);
+  update(block, rows_, bytes_, window_, hists_, columns_, memory_);
   ++blocks_;
 
   // add this block to the repo
   data_.emplace(spec, block);
+  dirty_ = true;
   return true;
 }
 
 size_t TableState::remove(const std::string& spec) {
   LOCK_DATA_ACCESS
 
-  auto count = data_.erase(spec);
+  std::vector<BlockPtr> removed;
+  auto range = data_.equal_range(spec);
+  for (auto it = range.first; it != range.second; ++it) {
+    removed.push_back(it->second);
+  }
+
+  data_.erase(spec);
+  account(removed, {});
+  return removed.size();
+}
+
+size_t TableState::swap(const std::string& spec,
+                        const std::function<bool(const BatchBlock&)>& drop,
+                        const std::vector<BlockPtr>& blocks) {
+  LOCK_DATA_ACCESS
+
+  std::vector<BlockPtr> removed;
+  auto range = data_.equal_range(spec);
+  for (auto it = range.first; it != range.second;) {
+    if (drop(*it->second)) {
+      removed.push_back(it->second);
+      it = data_.erase(it);
+      continue;
+    }
+
+    ++it;
+  }
+
+  for (const auto& block : blocks) {
+    data_.emplace(block->spec(), block);
+  }
 
+  account(removed, blocks);
+  return removed.size();
+}
+
+bool TableState::merge(const std::vector<BlockPtr>& from, BlockPtr to) {
+  LOCK_DATA_ACCESS
+
+  // every merged block needs to be present
+  std::vector<std::unordered_multimap<std::string, BlockPtr>::iterator> found;
+  found.reserve(from.size());
+  auto range = data_.equal_range(to->spec());
+  for (const auto& block : from) {
+    auto it = range.first;
+    while (it != range.second && it->second != block) {
+      ++it;
+    }
+
+    if (it == range.second) {
+      return false;
+    }
+
+    found.push_back(it);
+  }
+
+  for (auto& it : found) {
+    data_.erase(it);
+  }
+
+  data_.emplace(to->spec(), to);
+  account(from, { to });
+  return true;
+}
+
+void TableState::refresh() {
   // update the metrics
   size_t rows = 0;
   size_t bytes = 0;
   std::pair<size_t, size_t> window{ std::numeric_limits<size_t>::max(), 0 };
   HistVector hists;
+  std::vector<std::string> columns;
+  BlockMemory memory;
   for (auto& b : data_) {
-    update(b.second, rows, bytes, window, hists);
+    update(b.second, rows, bytes, window, hists, columns, memory);
   }
 
   // updated state data
@@ -82,23 +171,117 @@ size_t TableState::remove(const std::string& spec) {
   bytes_ = bytes;
   std::swap(window_, window);
   std::swap(hists_, hists);
+  std::swap(columns_, columns);
+  std::swap(memory_, memory);
+  dirty_ = true;
+}
 
-  return count;
+void TableState::account(const std::vector<BlockPtr>& removed, const std::vector<BlockPtr>& added) {
+  dirty_ = true;
+  auto exact = true;
+  for (const auto& b : removed) {
+    exact = reduce(b, rows_, bytes_, window_, hists_, columns_, memory_) && exact;
+  }
+
+  // data has the added blocks already
+  if (!exact) {
+    refresh();
+    return;
+  }
+
+  for (const auto& b : added) {
+    update(b, rows_, bytes_, window_, hists_, columns_, memory_);
+  }
+
+  blocks_ = data_.size();
 }
 
-std::vector<BatchPtr> TableState::query(const Window& window) const {
+void TableState::reindex() const {
+  index_.clear();
+  index_.reserve(data_.size());
+  for (auto& b : data_) {
+    index_.push_back(b.second);
+  }
+
+  std::sort(index_.begin(), index_.end(), [](const BlockPtr& left, const BlockPtr& right) {
+    return left->start() < right->start();
+  });
+
+  ends_.clear();
+  ends_.reserve(index_.size());
+  size_t end = 0;
+  for (const auto& b : index_) {
+    end = std::max(end, b->end());
+    ends_.push_back(end);
+  }
+
+  dirty_ = false;
+}
+
+std::vector<BlockPtr> TableState::query(const Window& window) const {
   LOCK_DATA_ACCESS
 
-  std::vector<BatchPtr> batches;
-  batches.reserve(data_.size());
+  if (dirty_) {
+    reindex();
+  }
+
+  // blocks starting after the window are out of it
+  auto late = std::upper_bound(index_.begin(), index_.end(), window.second, [](size_t time, const BlockPtr& b) {
+    return time < b->start();
+  });
+  const auto last = late - index_.begin();
 
+  // blocks before the first one whose max end reaches the window all end before it
+  const auto first = std::lower_bound(ends_.begin(), ends_.begin() + last, window.first) - ends_.begin();
+
+  std::vector<BlockPtr> blocks;
+  blocks.reserve(last - first);
+  for (auto i = first; i < last; ++i) {
+    const auto& b = index_[i];
+    if (b->overlap(window)) {
+      blocks.push_back(b);
+    }
+  }
+
+  return blocks;
+}
+
+std::vector<BlockPtr> TableState::hot() const {
+  LOCK_DATA_ACCESS
+
+  std::vector<BlockPtr> blocks;
   for (auto& b : data_) {
-    if (b.second->overlap(window)) {
-      batches.push_back(b.second->data());
+    if (b.second->data() != nullptr) {
+      blocks.push_back(b.second);
+    }
+  }
+
+  return blocks;
+}
+
+bool TableState::replace(const BlockPtr& from, BlockPtr to) {
+  LOCK_DATA_ACCESS
+
+  auto range = data_.equal_range(from->spec());
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == from) {
+      // the same signature keeps its place in the index
+      if (!dirty_) {
+        auto same = std::equal_range(index_.begin(), index_.end(), from, [](const BlockPtr& left, const BlockPtr& right) {
+          return left->start() < right->start();
+        });
+        auto pos = std::find(same.first, same.second, from);
+        if (pos != same.second) {
+          *pos = to;
+        }
+      }
+
+      it->second = std::move(to);
+      return true;
     }
   }
 
-  return batches;
+  return false;
 }
 
 #undef LOCK_DATA_ACCESS
@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <algorithm>
 #include <mutex>
+#include <typeinfo>
 #include <unordered_map>
 
 #include "common/Hash.h"
@@ -64,6 +66,22 @@ public:
     return hists_;
   }
 
+  // names of columns which histograms are for, in the same order, empty if they are not known
+  inline const std::vector<std::string>& columns() const {
+    return columns_;
+  }
+
+  // histogram of given column, nullptr if no block has the column or column names are not known
+  std::shared_ptr<nebula::surface::eval::Histogram> hist(const std::string& col) const {
+    const auto index = find(columns_, col);
+    return index < columns_.size() ? hists_.at(index) : nullptr;
+  }
+
+  // memory of all blocks by column and structure
+  inline const nebula::meta::BlockMemory& memory() const {
+    return memory_;
+  }
+
   // merge metrics only from other table state object
   void merge(const TableStateBase& state, bool metricsOnly = true) {
     N_ENSURE(metricsOnly, "Only merge metrics only for now.");
@@ -75,7 +93,8 @@ public:
     window_.second = std::max(state.window_.second, window_.second);
 
     // merge histogram
-    merge(hists_, state.hists_);
+    merge(hists_, columns_, state.hists_, state.columns_);
+    memory_.add(state.memory_);
   }
 
   inline bool isEmpty() const {
@@ -87,21 +106,96 @@ public:
     return EMPTY;
   }
 
-  inline static void merge(nebula::surface::eval::HistVector& target,
-                           const nebula::surface::eval::HistVector& source) {
-    // merge histogram from state into hists
+  // merge histograms of source columns into target by column name, so blocks of different schema versions
+  // roll up: a column new to target is appended, a column of another type is skipped.
+  // histograms without column names are merged by position if they have the same size.
+  static void merge(nebula::surface::eval::HistVector& target,
+                    std::vector<std::string>& columns,
+                    const nebula::surface::eval::HistVector& source,
+                    const std::vector<std::string>& names) {
+    // a copy of the source is taken so it's never changed by later merges
     if (target.size() == 0) {
-      target = source;
+      target.reserve(source.size());
+      for (const auto& h : source) {
+        target.push_back(h->clone());
+      }
+      columns = names.size() == source.size() ? names : std::vector<std::string>{};
+      return;
+    }
+
+    if (!named(target, columns) || !named(source, names)) {
+      if (target.size() == source.size()) {
+        for (size_t i = 0; i < target.size(); ++i) {
+          target.at(i)->merge(*source.at(i));
+        }
+      }
       return;
     }
 
-    // TODO: need support for schema evolution
-    N_ENSURE(target.size() == source.size(), "expect the same number of histograms");
-    for (size_t i = 0; i < target.size(); ++i) {
-      target.at(i)->merge(*source.at(i));
+    for (size_t i = 0; i < source.size(); ++i) {
+      const auto& h = *source.at(i);
+      const auto index = find(columns, names.at(i));
+      if (index == columns.size()) {
+        target.push_back(h.clone());
+        columns.push_back(names.at(i));
+        continue;
+      }
+
+      auto& t = *target.at(index);
+      if (typeid(t) == typeid(h)) {
+        t.merge(h);
+      }
     }
   }
 
+  // take histograms of source columns out of target by column name,
+  // return false if any of them is not exact or not found and target needs a rebuild
+  static bool subtract(nebula::surface::eval::HistVector& target,
+                       const std::vector<std::string>& columns,
+                       const nebula::surface::eval::HistVector& source,
+                       const std::vector<std::string>& names) {
+    if (!named(target, columns) || !named(source, names)) {
+      if (target.size() != source.size()) {
+        return false;
+      }
+
+      auto exact = true;
+      for (size_t i = 0; i < target.size(); ++i) {
+        exact = target.at(i)->subtract(*source.at(i)) && exact;
+      }
+
+      return exact;
+    }
+
+    auto exact = true;
+    for (size_t i = 0; i < source.size(); ++i) {
+      const auto& h = *source.at(i);
+      const auto index = find(columns, names.at(i));
+      if (index == columns.size()) {
+        return false;
+      }
+
+      auto& t = *target.at(index);
+      if (typeid(t) != typeid(h)) {
+        return false;
+      }
+
+      exact = t.subtract(h) && exact;
+    }
+
+    return exact;
+  }
+
+private:
+  // position of a column in names, size of names if not found
+  static inline size_t find(const std::vector<std::string>& names, const std::string& col) {
+    return static_cast<size_t>(std::distance(names.begin(), std::find(names.begin(), names.end(), col)));
+  }
+
+  static inline bool named(const nebula::surface::eval::HistVector& hists, const std::vector<std::string>& names) {
+    return !names.empty() && names.size() == hists.size();
+  }
+
 protected:
   // table name
   std::string table_;
@@ -117,6 +211,10 @@ protected:
 
   // column histogram
   nebula::surface::eval::HistVector hists_;
+  std::vector<std::string> columns_;
+
+  // column memory
+  nebula::meta::BlockMemory memory_;
 };
 
 // a shortcut for pair set of {table name, spec id}
@@ -125,7 +223,7 @@ using TableSpecSet = nebula::common::unordered_set<std::pair<std::string, std::s
 // Table State with solid data in it
 class TableState : public TableStateBase {
 public:
-  TableState(const std::string& table) : TableStateBase(table) {}
+  TableState(const std::string& table) : TableStateBase(table), dirty_{ false } {}
   virtual ~TableState() = default;
   inline bool hasSpec(const std::string& spec) const {
     return data_.find(spec) != data_.end();
@@ -160,16 +258,55 @@ public:
   // remove all blocks for given spec
   size_t remove(const std::string&);
 
-  // get all data batch pointers by given window
-  std::vector<nebula::memory::BatchPtr> query(const Window&) const;
+  // get all blocks overlapping given window by a time index, a block evicted to cold tier has no data
+  std::vector<std::shared_ptr<nebula::execution::io::BatchBlock>> query(const Window&) const;
+
+  // get all blocks resident in memory
+  std::vector<std::shared_ptr<nebula::execution::io::BatchBlock>> hot() const;
+
+  // replace a block with another one of the same signature when it moves between memory and cold tier
+  // return false if the block is not in this table any more
+  bool replace(const std::shared_ptr<nebula::execution::io::BatchBlock>&,
+               std::shared_ptr<nebula::execution::io::BatchBlock>);
+
+  // remove blocks of given spec selected by the predicate and add given blocks in one step,
+  // so that a query sees either all blocks removed or all blocks added. Return number of blocks removed.
+  size_t swap(const std::string&,
+              const std::function<bool(const nebula::execution::io::BatchBlock&)>&,
+              const std::vector<std::shared_ptr<nebula::execution::io::BatchBlock>>&);
+
+  // replace blocks of a spec with one block merged from them, it does nothing and returns false if any of them
+  // is not in this table any more, such as removed by its spec or moved to cold tier, since merging
+  // started. All given blocks are of the spec of the merged block.
+  bool merge(const std::vector<std::shared_ptr<nebula::execution::io::BatchBlock>>&,
+             std::shared_ptr<nebula::execution::io::BatchBlock>);
 
   // iterate every single block to feed the given lambda
   void iterate(std::function<void(const nebula::execution::io::BatchBlock&)>) const;
 
+private:
+  // rebuild metrics from all blocks, called with data lock held
+  void refresh();
+
+  // take metrics of removed blocks out and add metrics of added blocks in after data is changed,
+  // metrics are rebuilt only if a removed block gives a bound of the window or a histogram.
+  // called with data lock held
+  void account(const std::vector<std::shared_ptr<nebula::execution::io::BatchBlock>>&,
+               const std::vector<std::shared_ptr<nebula::execution::io::BatchBlock>>&);
+
+  // rebuild time index from all blocks, called with data lock held
+  void reindex() const;
+
 private:
   // spec signature -> multi blocks
   std::unordered_multimap<std::string, std::shared_ptr<nebula::execution::io::BatchBlock>> data_;
   mutable std::mutex mdata_;
+
+  // all blocks ordered by start time, along with the max end time of blocks up to each of them.
+  // blocks overlapping a window are in a range found by binary search on both, rebuilt lazily after changes.
+  mutable std::vector<std::shared_ptr<nebula::execution::io::BatchBlock>> index_;
+  mutable std::vector<size_t> ends_;
+  mutable bool dirty_;
 };
 
 } // namespace execution
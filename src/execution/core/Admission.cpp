@@ -0,0 +1,191 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Admission.h"
+
+#include <algorithm>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "common/Errors.h"
+#include "common/Folly.h"
+
+DEFINE_uint64(INTERACTIVE_ROWS, 10000000, "queries scanning no more rows than this are interactive queries");
+DEFINE_uint64(BATCH_ROWS,
+              1000000000,
+              "queries scanning no more rows than this are batch queries, larger ones are background queries");
+DEFINE_uint64(INTERACTIVE_QUERIES, 0, "max number of interactive queries running at the same time, 0 means no limit");
+DEFINE_uint64(BATCH_QUERIES, 4, "max number of batch queries running at the same time, 0 means no limit");
+DEFINE_uint64(BACKGROUND_QUERIES, 1, "max number of background queries running at the same time, 0 means no limit");
+
+/**
+ * Admission control of queries on a node.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+// interval to check cancellation of a waiting query
+static constexpr auto CANCEL_POLL = std::chrono::milliseconds(100);
+
+Admission& Admission::singleton() {
+  static Admission admission{ { FLAGS_INTERACTIVE_QUERIES, FLAGS_BATCH_QUERIES, FLAGS_BACKGROUND_QUERIES } };
+  return admission;
+}
+
+Priority Admission::classify(size_t rows) noexcept {
+  if (rows <= FLAGS_INTERACTIVE_ROWS) {
+    return Priority::INTERACTIVE;
+  }
+
+  return rows <= FLAGS_BATCH_ROWS ? Priority::BATCH : Priority::BACKGROUND;
+}
+
+int8_t Admission::poolPriority(Priority priority) noexcept {
+  switch (priority) {
+  case Priority::INTERACTIVE: return folly::Executor::HI_PRI;
+  case Priority::BATCH: return folly::Executor::MID_PRI;
+  default: return folly::Executor::LO_PRI;
+  }
+}
+
+std::unique_ptr<Admission::Ticket> Admission::admit(Priority priority, const std::string& user, Cancellation& cancel) {
+  auto& c = classes_[index(priority)];
+  std::unique_lock<std::mutex> guard(lock_);
+
+  // run right away if there is a free slot and nobody is waiting before it
+  if (c.waiting == 0 && c.available()) {
+    ++c.running;
+    return std::make_unique<Ticket>(*this, priority);
+  }
+
+  Waiter waiter;
+  enqueue(c, user, &waiter);
+  VLOG(1) << "Query of " << user << " waits for admission, class=" << index(priority) << ", waiting=" << c.waiting;
+
+  while (!signal_.wait_for(guard, CANCEL_POLL, [&waiter]() { return waiter.granted; })) {
+    // check cancellation without holding the lock
+    guard.unlock();
+    const auto cancelled = cancel.poll();
+    guard.lock();
+
+    if (cancelled && !waiter.granted) {
+      remove(c, user, &waiter);
+      throw NException("Query cancelled before admitted");
+    }
+  }
+
+  // the slot was taken for this query when granted
+  return std::make_unique<Ticket>(*this, priority);
+}
+
+folly::Future<std::unique_ptr<Admission::Ticket>> Admission::admitAsync(Priority priority, const std::string& user) {
+  auto& c = classes_[index(priority)];
+  std::lock_guard<std::mutex> guard(lock_);
+  if (c.waiting == 0 && c.available()) {
+    ++c.running;
+    return folly::makeFuture(std::make_unique<Ticket>(*this, priority));
+  }
+
+  auto waiter = new Waiter;
+  waiter->promise = std::make_unique<folly::Promise<std::unique_ptr<Ticket>>>();
+  auto future = waiter->promise->getFuture();
+  enqueue(c, user, waiter);
+  VLOG(1) << "Query of " << user << " waits for async admission, class=" << index(priority);
+  return future;
+}
+
+void Admission::release(Priority priority) {
+  std::vector<Waiter*> granted;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto& c = classes_[index(priority)];
+    --c.running;
+    granted = grant(c);
+  }
+
+  signal_.notify_all();
+
+  // the slot was taken for every granted waiter, its continuation may release a ticket in turn
+  for (auto waiter : granted) {
+    waiter->promise->setValue(std::make_unique<Ticket>(*this, priority));
+    delete waiter;
+  }
+}
+
+void Admission::enqueue(Class& c, const std::string& user, Waiter* waiter) {
+  auto& queue = c.queues[user];
+  if (queue.empty()) {
+    c.users.push_back(user);
+  }
+
+  queue.push_back(waiter);
+  ++c.waiting;
+}
+
+std::vector<Admission::Waiter*> Admission::grant(Class& c) {
+  std::vector<Waiter*> granted;
+  while (c.waiting > 0 && c.available()) {
+    auto user = std::move(c.users.front());
+    c.users.pop_front();
+
+    // the first waiting query of the next user takes the slot
+    auto found = c.queues.find(user);
+    auto& queue = found->second;
+    auto waiter = queue.front();
+    waiter->granted = true;
+    if (waiter->promise) {
+      granted.push_back(waiter);
+    }
+
+    queue.pop_front();
+    ++c.running;
+    --c.waiting;
+
+    // the user goes to the end of the round if it has more queries waiting
+    if (queue.empty()) {
+      c.queues.erase(found);
+    } else {
+      c.users.push_back(std::move(user));
+    }
+  }
+
+  return granted;
+}
+
+void Admission::remove(Class& c, const std::string& user, Waiter* waiter) {
+  auto found = c.queues.find(user);
+  if (found == c.queues.end()) {
+    return;
+  }
+
+  auto& queue = found->second;
+  auto it = std::find(queue.begin(), queue.end(), waiter);
+  if (it == queue.end()) {
+    return;
+  }
+
+  queue.erase(it);
+  --c.waiting;
+  if (queue.empty()) {
+    c.queues.erase(found);
+    c.users.erase(std::find(c.users.begin(), c.users.end(), user));
+  }
+}
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
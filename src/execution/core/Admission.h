@@ -0,0 +1,151 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include "common/Folly.h"
+#include "common/Hash.h"
+#include "execution/Context.h"
+
+/**
+ * Admission control of queries on a node.
+ * A query is classified by its estimated cost (rows of all its matched blocks) into a priority class,
+ * every class runs a limited number of queries at the same time, other queries wait in the queue of the class.
+ * Waiting queries of a class are admitted in round robin of users so that one user can't starve the others.
+ * Block tasks of an admitted query are then scheduled by its class priority in the shared thread pool.
+ * A query waits on its own thread, or it's admitted asynchronously by a future completed when its slot is granted.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+enum class Priority {
+  INTERACTIVE = 0,
+  BATCH = 1,
+  BACKGROUND = 2
+};
+
+class Admission {
+public:
+  class Ticket;
+
+private:
+  static constexpr size_t CLASSES = 3;
+
+  // a waiting query, it lives on the stack of its waiting thread.
+  // an async waiter is allocated with a promise instead, it is completed by the thread releasing a slot.
+  struct Waiter {
+    bool granted = false;
+    std::unique_ptr<folly::Promise<std::unique_ptr<Ticket>>> promise;
+  };
+
+  struct Class {
+    // max number of running queries, 0 means no limit
+    size_t limit = 0;
+    size_t running = 0;
+    size_t waiting = 0;
+    // users in round robin order, every user has its own queue of waiting queries
+    std::deque<std::string> users;
+    nebula::common::unordered_map<std::string, std::deque<Waiter*>> queues;
+
+    inline bool available() const noexcept {
+      return limit == 0 || running < limit;
+    }
+  };
+
+public:
+  // a slot of a class held by an admitted query, it's released when destroyed
+  class Ticket {
+  public:
+    Ticket(Admission& admission, Priority priority) : admission_{ admission }, priority_{ priority } {}
+    ~Ticket() {
+      admission_.release(priority_);
+    }
+
+    inline Priority priority() const noexcept {
+      return priority_;
+    }
+
+  private:
+    Admission& admission_;
+    Priority priority_;
+  };
+
+public:
+  // limits of running queries for interactive, batch and background classes
+  explicit Admission(const std::array<size_t, CLASSES>& limits) {
+    for (size_t i = 0; i < CLASSES; ++i) {
+      classes_[i].limit = limits[i];
+    }
+  }
+  virtual ~Admission() = default;
+
+  static Admission& singleton();
+
+  // classify a query by number of rows it scans
+  static Priority classify(size_t rows) noexcept;
+
+  // thread pool priority of block tasks of a class
+  static int8_t poolPriority(Priority) noexcept;
+
+  // wait until the query is admitted, throw if it's cancelled before that
+  std::unique_ptr<Ticket> admit(Priority, const std::string&, Cancellation&);
+
+  // admit the query without waiting, the future completes with its ticket when a slot is granted.
+  // a ticket granted to an abandoned future (such as timed out) is released right away.
+  folly::Future<std::unique_ptr<Ticket>> admitAsync(Priority, const std::string&);
+
+  size_t running(Priority priority) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return classes_[index(priority)].running;
+  }
+
+  size_t waiting(Priority priority) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return classes_[index(priority)].waiting;
+  }
+
+private:
+  static inline size_t index(Priority priority) noexcept {
+    return static_cast<size_t>(priority);
+  }
+
+  void release(Priority);
+
+  // queue a waiter after other queries of the same user, lock is held by caller
+  void enqueue(Class&, const std::string&, Waiter*);
+
+  // admit waiting queries of a class while it has free slots, lock is held by caller
+  // async waiters granted are returned to be completed without the lock
+  std::vector<Waiter*> grant(Class&);
+
+  // remove a waiter given up, lock is held by caller
+  void remove(Class&, const std::string&, Waiter*);
+
+private:
+  mutable std::mutex lock_;
+  std::condition_variable signal_;
+  std::array<Class, CLASSES> classes_;
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -16,9 +16,13 @@
 
 #include "AggregationMerge.h"
 
+#include <deque>
 #include <fmt/format.h>
 #include <gflags/gflags.h>
+#include <mutex>
 
+#include "BlockExecutor.h"
+#include "Spill.h"
 #include "common/Fold.h"
 #include "execution/serde/RowCursorSerde.h"
 #include "memory/keyed/FlatRowCursor.h"
@@ -31,6 +35,14 @@ DEFINE_uint64(MULTI_FOLD_WIDTH, 1,
               "1: use current thread, not using pool"
               "2+: use this width to do folding parallel");
 
+DEFINE_uint64(MERGE_PARTITIONS, 0,
+              "number of key partitions to merge aggregation results in parallel."
+              "0: use pool size as number of partitions"
+              "1: merge all results in current thread");
+
+DEFINE_uint64(MERGE_PARTITION_ROWS, 65536,
+              "minimum number of total rows to merge for partitioned merge to kick in");
+
 /**
  * A logic wrapper to merge aggregation results shared by aggregators (Node Executor or Server Executor)
  */
@@ -39,6 +51,7 @@ namespace execution {
 namespace core {
 
 using nebula::common::CompositeCursor;
+using nebula::memory::keyed::FlatBuffer;
 using nebula::memory::keyed::FlatRowCursor;
 using nebula::memory::keyed::HashFlat;
 using nebula::surface::EmptyRowCursor;
@@ -48,8 +61,159 @@ using nebula::surface::eval::ValueEval;
 using nebula::type::Kind;
 using nebula::type::Schema;
 
+// merge a result into the hash flat, a result holding its own flat buffer is merged buffer by buffer
+static void fold(HashFlat& hf, const RowCursorPtr& cursor) {
+  if (auto flat = std::dynamic_pointer_cast<FlatRowCursor>(cursor)) {
+    hf.merge(flat->takeResult());
+    return;
+  }
+
+  if (auto block = std::dynamic_pointer_cast<BlockExecutor>(cursor)) {
+    hf.merge(block->takeResult());
+    return;
+  }
+
+  while (cursor->hasNext()) {
+    hf.update(cursor->next());
+  }
+}
+
+// hash of the key columns of a given row, used to assign the row to a partition
+using KeyHasher = std::function<size_t(const RowData&)>;
+
+static std::vector<KeyHasher> keyHashers(const Schema& schema, const std::vector<std::unique_ptr<ValueEval>>& fields) {
+  std::vector<KeyHasher> hashers;
+  for (size_t i = 0, size = fields.size(); i < size; ++i) {
+    if (fields.at(i)->isAggregate()) {
+      continue;
+    }
+
+    auto f = schema->childType(i);
+    const auto name = f->name();
+
+#define HASH_KEY(KIND, TYPE, FUNC)                                      \
+  case Kind::KIND: {                                                    \
+    hashers.push_back([name](const RowData& row) -> size_t {            \
+      if (row.isNull(name)) {                                           \
+        return 0;                                                       \
+      }                                                                 \
+      TYPE v = row.FUNC(name);                                          \
+      return nebula::common::Hasher::hash64(&v, sizeof(TYPE));          \
+    });                                                                 \
+    break;                                                              \
+  }
+
+    switch (f->k()) {
+      HASH_KEY(BOOLEAN, bool, readBool)
+      HASH_KEY(TINYINT, int8_t, readByte)
+      HASH_KEY(SMALLINT, int16_t, readShort)
+      HASH_KEY(INTEGER, int32_t, readInt)
+      HASH_KEY(BIGINT, int64_t, readLong)
+      HASH_KEY(REAL, float, readFloat)
+      HASH_KEY(DOUBLE, double, readDouble)
+      HASH_KEY(INT128, int128_t, readInt128)
+    case Kind::VARCHAR: {
+      hashers.push_back([name](const RowData& row) -> size_t {
+        if (row.isNull(name)) {
+          return 0;
+        }
+
+        return nebula::common::Hasher::hashString(row.readString(name));
+      });
+      break;
+    }
+    default:
+      // not supported key type, can not partition on it
+      return {};
+    }
+
+#undef HASH_KEY
+  }
+
+  return hashers;
+}
+
+// run a task in the pool and signal its completion through a future
+static folly::Future<folly::Unit> async(folly::ThreadPoolExecutor& pool, std::function<void()> task) {
+  auto p = std::make_shared<folly::Promise<folly::Unit>>();
+  pool.addWithPriority(
+    [task = std::move(task), p]() {
+      task();
+      p->setValue();
+    },
+    folly::Executor::HI_PRI);
+
+  return p->getFuture();
+}
+
+// partitioned merge: rows of every source are scattered into partitions by key hash in parallel (per source),
+// then every partition is merged into its own hash flat in parallel (per partition).
+// since a key always lands in the same partition, the final result is simple concatenation of all partitions.
+static RowCursorPtr partitionMerge(
+  folly::ThreadPoolExecutor& pool,
+  const Schema& schema,
+  const std::vector<std::unique_ptr<ValueEval>>& fields,
+  const std::vector<KeyHasher>& hashers,
+  const std::vector<RowCursorPtr>& cursors,
+  const size_t partitions) {
+  const auto size = cursors.size();
+
+  // scatter: buffers[source][partition]
+  std::vector<std::vector<std::unique_ptr<FlatBuffer>>> buffers(size);
+  std::vector<folly::Future<folly::Unit>> scatters;
+  scatters.reserve(size);
+  for (size_t s = 0; s < size; ++s) {
+    scatters.push_back(async(pool, [&schema, &fields, &hashers, &cursors, &buffers, partitions, s]() {
+      auto& parts = buffers.at(s);
+      parts.reserve(partitions);
+      for (size_t p = 0; p < partitions; ++p) {
+        parts.push_back(std::make_unique<FlatBuffer>(schema, fields));
+      }
+
+      auto& cursor = cursors.at(s);
+      while (cursor->hasNext()) {
+        const auto& row = cursor->next();
+        size_t hash = 0;
+        for (const auto& hasher : hashers) {
+          hash = hash * 31 + hasher(row);
+        }
+
+        parts.at(hash % partitions)->add(row);
+      }
+    }));
+  }
+
+  folly::collectAll(scatters).get();
+
+  // gather: merge all sources of the same partition
+  std::vector<std::unique_ptr<HashFlat>> merged(partitions);
+  std::vector<folly::Future<folly::Unit>> gathers;
+  gathers.reserve(partitions);
+  for (size_t p = 0; p < partitions; ++p) {
+    gathers.push_back(async(pool, [&schema, &fields, &buffers, &merged, p]() {
+      auto hf = std::make_unique<HashFlat>(schema, fields);
+      for (auto& parts : buffers) {
+        // release the scattered buffer right after it is merged
+        hf->merge(std::move(parts.at(p)));
+      }
+
+      merged.at(p) = std::move(hf);
+    }));
+  }
+
+  folly::collectAll(gathers).get();
+
+  // concatenate all partitions
+  auto composite = std::make_shared<CompositeCursor<RowData>>();
+  for (auto& hf : merged) {
+    composite->combine(std::make_shared<FlatRowCursor>(std::move(hf)));
+  }
+
+  return composite;
+}
+
 RowCursorPtr merge(
-  folly::ThreadPoolExecutor&,
+  folly::ThreadPoolExecutor& pool,
   const Schema schema,
   const std::vector<std::unique_ptr<ValueEval>>& fields,
   const bool hasAggregation,
@@ -67,6 +231,26 @@ RowCursorPtr merge(
     // transform folly tries into HashFlat
     // std::vector<std::unique_ptr<HashFlat>> blocks;
     // blocks.reserve(size);
+    const auto partitions = FLAGS_MERGE_PARTITIONS == 0 ? pool.numThreads() : FLAGS_MERGE_PARTITIONS;
+    if (partitions > 1 && size > 1) {
+      std::vector<RowCursorPtr> cursors;
+      cursors.reserve(size);
+      size_t rows = 0;
+      for (auto it = sources.begin(); it < sources.end(); ++it) {
+        if (it->hasValue() && it->value()) {
+          cursors.push_back(it->value());
+          rows += it->value()->size();
+        }
+      }
+
+      // partition only when there are keys to partition on and enough rows to amortize the scatter
+      auto hashers = keyHashers(schema, fields);
+      if (hashers.size() > 0 && rows >= FLAGS_MERGE_PARTITION_ROWS) {
+        LOG(INFO) << fmt::format("Partitioned merge on rows: {0} in partitions: {1}", rows, partitions);
+        return partitionMerge(pool, schema, fields, hashers, cursors, partitions);
+      }
+    }
+
     auto hf = std::make_unique<HashFlat>(schema, fields);
     for (auto it = sources.begin(); it < sources.end(); ++it) {
       // if the result is empty
@@ -74,11 +258,7 @@ RowCursorPtr merge(
         continue;
       }
 
-      auto blockResult = it->value();
-      while (blockResult->hasNext()) {
-        const auto& row = blockResult->next();
-        hf->update(row);
-      }
+      fold(*hf, it->value());
     }
 
     return std::make_shared<FlatRowCursor>(std::move(hf));
@@ -146,6 +326,187 @@ RowCursorPtr merge(
   return composite;
 }
 
+// state of a streaming merge shared by completions of its results.
+// a completed result is queued, the completing thread drains the queue if nobody else is draining it,
+// so the hash flat is never touched concurrently and no compute thread waits for another one to merge.
+// the merge is closed when all results are folded, the query is beyond its memory limit or the timeout passes,
+// whoever holds the flat at that time finishes the merged result, later results are dropped.
+class StreamMerge final {
+public:
+  StreamMerge(const Schema& schema,
+              const std::vector<std::unique_ptr<ValueEval>>& fields,
+              size_t size,
+              const std::shared_ptr<nebula::execution::Cancellation>& cancel,
+              const std::shared_ptr<nebula::execution::MemoryBudget>& memory)
+    : schema_{ schema },
+      fields_{ fields },
+      cancel_{ cancel },
+      memory_{ memory },
+      hf_{ std::make_unique<HashFlat>(schema, fields) },
+      charge_{ std::make_unique<nebula::execution::MemoryCharge>(memory.get()) },
+      pending_{ size },
+      failures_{ 0 },
+      draining_{ false },
+      closed_{ false } {}
+
+  inline folly::Future<RowCursorPtr> result() {
+    return promise_.getFuture();
+  }
+
+  void complete(folly::Try<RowCursorPtr>&& result) {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (closed_) {
+        return;
+      }
+
+      done_.push_back(std::move(result));
+      if (draining_) {
+        return;
+      }
+
+      draining_ = true;
+    }
+
+    drain();
+  }
+
+  // give up results not completed yet
+  void expire() {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (closed_) {
+        return;
+      }
+
+      // the thread draining finishes it
+      closed_ = true;
+      if (draining_) {
+        return;
+      }
+    }
+
+    finish();
+  }
+
+private:
+  void drain() {
+    while (true) {
+      folly::Try<RowCursorPtr> result;
+      {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (closed_) {
+          break;
+        }
+
+        if (done_.empty()) {
+          draining_ = false;
+          return;
+        }
+
+        result = std::move(done_.front());
+        done_.pop_front();
+      }
+
+      auto stop = --pending_ == 0;
+      if (!result.hasValue() || !result.value()) {
+        ++failures_;
+      } else {
+        // merge and release this result
+        fold(*hf_, result.value());
+
+        // too many groups are spilled to local disk and merged partition by partition in the end
+        if (hf_->allocation() > Spill::threshold() && (spill_ || (spill_ = Spill::make(schema_, fields_)))) {
+          const auto groups = hf_->getRows();
+          LOG(INFO) << fmt::format("Spill groups: {0} in bytes: {1}", groups, spill_->write(std::move(hf_)));
+          hf_ = std::make_unique<HashFlat>(schema_, fields_);
+        }
+
+        // stop merging once the query is beyond its memory limit
+        stop = stop || !charge_->update(hf_->allocation());
+      }
+
+      if (stop) {
+        std::lock_guard<std::mutex> guard(lock_);
+        closed_ = true;
+        break;
+      }
+    }
+
+    finish();
+  }
+
+  void finish() {
+    if (pending_ > 0 || failures_ > 0) {
+      LOG(WARNING) << fmt::format("Streaming merge timeout: {0}, error: {1}", pending_, failures_);
+    }
+
+    // stop computes which are still running
+    if (pending_ > 0) {
+      cancel_->cancel();
+    }
+
+    charge_ = nullptr;
+    promise_.setTry(folly::makeTryWith([this]() -> RowCursorPtr {
+      if (spill_) {
+        spill_->write(std::move(hf_));
+        return Spill::merge(std::move(spill_));
+      }
+
+      return std::make_shared<FlatRowCursor>(std::move(hf_));
+    }));
+  }
+
+private:
+  const Schema schema_;
+  const std::vector<std::unique_ptr<ValueEval>>& fields_;
+  const std::shared_ptr<nebula::execution::Cancellation> cancel_;
+  const std::shared_ptr<nebula::execution::MemoryBudget> memory_;
+  std::unique_ptr<HashFlat> hf_;
+  std::unique_ptr<nebula::execution::MemoryCharge> charge_;
+  std::shared_ptr<Spill> spill_;
+  folly::Promise<RowCursorPtr> promise_;
+
+  // touched by the thread draining only
+  size_t pending_;
+  size_t failures_;
+
+  std::mutex lock_;
+  std::deque<folly::Try<RowCursorPtr>> done_;
+  bool draining_;
+  bool closed_;
+};
+
+folly::Future<RowCursorPtr> merge(
+  folly::ThreadPoolExecutor& pool,
+  const Schema schema,
+  const std::vector<std::unique_ptr<ValueEval>>& fields,
+  std::vector<folly::Future<RowCursorPtr>>&& results,
+  const std::chrono::milliseconds timeout,
+  const std::shared_ptr<nebula::execution::Cancellation>& cancel,
+  const std::shared_ptr<nebula::execution::MemoryBudget>& memory) {
+  const auto size = results.size();
+  LOG(INFO) << fmt::format("Streaming merge sources: {0}", size);
+  auto merge = std::make_shared<StreamMerge>(schema, fields, size, cancel, memory);
+  auto result = merge->result();
+  if (size == 0) {
+    merge->expire();
+    return result;
+  }
+
+  for (auto& r : results) {
+    std::move(r).thenTry([merge](folly::Try<RowCursorPtr>&& t) { merge->complete(std::move(t)); });
+  }
+
+  folly::futures::sleep(timeout).via(&pool).thenValue([weak = std::weak_ptr<StreamMerge>(merge)](auto&&) {
+    if (auto m = weak.lock()) {
+      m->expire();
+    }
+  });
+
+  return result;
+}
+
 } // namespace core
 } // namespace execution
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "common/Folly.h"
+#include "execution/Context.h"
 #include "surface/DataSurface.h"
 #include "surface/eval/ValueEval.h"
 #include "type/Type.h"
@@ -34,6 +35,22 @@ nebula::surface::RowCursorPtr merge(
   const nebula::surface::eval::Fields&,
   const bool,
   const std::vector<folly::Try<nebula::surface::RowCursorPtr>>&);
+
+// streaming merge of aggregation results - every result is folded in its completion order.
+// so merge is overlapped with pending computes and a result is released right after it is merged.
+// results are folded by the threads completing them without waiting on each other, and no thread waits
+// for the merged result, which completes the returned future. fields should outlive the future.
+// results not completed within the timeout are given up, the query is cancelled then so that its pending computes stop.
+// memory of the merged result is charged to the query budget while merging.
+folly::Future<nebula::surface::RowCursorPtr> merge(
+  folly::ThreadPoolExecutor&,
+  const nebula::type::Schema,
+  const nebula::surface::eval::Fields&,
+  std::vector<folly::Future<nebula::surface::RowCursorPtr>>&&,
+  const std::chrono::milliseconds,
+  const std::shared_ptr<nebula::execution::Cancellation>&,
+  const std::shared_ptr<nebula::execution::MemoryBudget>&);
+
 } // namespace core
 } // namespace execution
 } // namespace nebula
\ No newline at end of file
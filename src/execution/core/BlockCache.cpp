@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlockCache.h"
+
+#include <cstring>
+#include <gflags/gflags.h>
+
+#include "memory/keyed/FlatRowCursor.h"
+#include "memory/keyed/HashFlat.h"
+#include "meta/Table.h"
+
+DEFINE_uint64(BLOCK_CACHE_MB, 256, "memory in MB to cache partial aggregation results of blocks, 0 to disable");
+
+/**
+ * Implement the block result cache.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+using nebula::common::Pool;
+using nebula::memory::EvaledBlock;
+using nebula::memory::keyed::FlatBuffer;
+using nebula::memory::keyed::FlatRowCursor;
+using nebula::memory::keyed::HashFlat;
+using nebula::surface::RowCursorPtr;
+using nebula::surface::eval::IntHistogram;
+
+BlockCache& BlockCache::singleton() {
+  static BlockCache cache{ FLAGS_BLOCK_CACHE_MB * 1024 * 1024 };
+  return cache;
+}
+
+std::string BlockCache::key(const EvaledBlock& block, const BlockPhase& plan, const Morsel& morsel) {
+  // scripts may not be deterministic
+  if (FLAGS_BLOCK_CACHE_MB == 0 || !plan.hasAggregation() || plan.hasScript() || plan.signature().empty()) {
+    return {};
+  }
+
+  // all time of the block should satisfy the time predicates stripped from the signature
+  const auto& batch = *block.first;
+  const auto& range = plan.timeRange();
+  const auto time = batch.histogram<IntHistogram>(nebula::meta::Table::TIME_COLUMN);
+  if (time.count > 0 && (time.min() < range.first || time.max() > range.second)) {
+    return {};
+  }
+
+  // block is identified by its address, entry holds a weak reference of it so the address is not reused
+  const auto rows = batch.getRows();
+  const size_t id[] = { reinterpret_cast<size_t>(&batch), morsel.first(rows), morsel.last(rows) };
+  std::string key(reinterpret_cast<const char*>(id), sizeof(id));
+  key.append(plan.signature());
+  return key;
+}
+
+RowCursorPtr BlockCache::get(const std::string& key, const EvaledBlock& block, const BlockPhase& plan) {
+  NByte* bytes = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found == entries_.end()) {
+      return nullptr;
+    }
+
+    // the block cached is gone, a new block may live in the same address
+    auto& entry = found->second;
+    if (entry.block.lock() != block.first) {
+      erase(found);
+      return nullptr;
+    }
+
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+
+    // serialized flat is owned by the flat buffer built on it
+    const auto& data = entry.data;
+    bytes = static_cast<NByte*>(Pool::getDefault().allocate(data.size()));
+    std::memcpy(bytes, data.data(), data.size());
+  }
+
+  // rebuild a writable result with its own sketches
+  const auto& fields = plan.fields();
+  auto result = std::make_unique<HashFlat>(plan.outputSchema(), fields);
+  result->merge(std::make_unique<FlatBuffer>(plan.outputSchema(), fields, bytes));
+
+  return std::make_shared<FlatRowCursor>(std::move(result));
+}
+
+void BlockCache::put(const std::string& key, const EvaledBlock& block, const FlatBuffer& result) {
+  const auto size = result.prepareSerde();
+  if (size > capacity_) {
+    return;
+  }
+
+  std::string data(size, 0);
+  result.serialize(reinterpret_cast<NByte*>(data.data()));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = entries_.find(key);
+  if (found != entries_.end()) {
+    erase(found);
+  }
+
+  // evict least recently used ones to make room
+  while (bytes_ + size > capacity_) {
+    erase(entries_.find(lru_.back()));
+  }
+
+  lru_.push_front(key);
+  entries_.emplace(key, Entry{ block.first, std::move(data), lru_.begin() });
+  bytes_ += size;
+}
+
+void BlockCache::erase(Entries::iterator entry) {
+  bytes_ -= entry->second.data.size();
+  lru_.erase(entry->second.lru);
+  entries_.erase(entry);
+}
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
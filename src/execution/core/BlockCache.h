@@ -0,0 +1,96 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+
+#include "Morsel.h"
+#include "common/Hash.h"
+#include "execution/ExecutionPlan.h"
+#include "memory/Batch.h"
+#include "memory/keyed/FlatBuffer.h"
+#include "surface/DataSurface.h"
+
+/**
+ * A node level cache of partial aggregation results of blocks.
+ * A sealed block never changes, so the block compute of the same phase signature gives the same result until
+ * the block expires. A refreshing query on a sliding window only computes newly ingested blocks and reuses the rest.
+ *
+ * A phase signature doesn't include the time predicates of the query, so a result is only cached and reused for
+ * blocks with all their time in the time range required by these predicates, eg. blocks fully inside of the window.
+ * Results are cached in serialized form and rebuilt for every use, since merging a result changes its sketches.
+ * Entries are evicted in LRU order by total bytes, an entry holds a weak reference to its block to detect expiration.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+class BlockCache final {
+public:
+  BlockCache(BlockCache&) = delete;
+  BlockCache(BlockCache&&) = delete;
+  explicit BlockCache(size_t capacity) : capacity_{ capacity }, bytes_{ 0 } {}
+  ~BlockCache() = default;
+
+  static BlockCache& singleton();
+
+public:
+  // cache key of a block compute, empty if the compute is not cacheable
+  static std::string key(const nebula::memory::EvaledBlock&, const BlockPhase&, const Morsel&);
+
+  // build a result cursor of given key from cache, nullptr if missing
+  nebula::surface::RowCursorPtr get(const std::string&, const nebula::memory::EvaledBlock&, const BlockPhase&);
+
+  // cache a result of given key and block
+  void put(const std::string&, const nebula::memory::EvaledBlock&, const nebula::memory::keyed::FlatBuffer&);
+
+  inline size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+  inline size_t bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+  }
+
+private:
+  struct Entry {
+    std::weak_ptr<nebula::memory::Batch> block;
+    std::string data;
+    std::list<std::string>::iterator lru;
+  };
+
+  using Entries = nebula::common::unordered_map<std::string, Entry>;
+
+  void erase(Entries::iterator);
+
+private:
+  // max bytes of all cached results
+  const size_t capacity_;
+  size_t bytes_;
+
+  // keys in recently used order, most recent first
+  std::list<std::string> lru_;
+  Entries entries_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
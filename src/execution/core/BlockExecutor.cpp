@@ -17,15 +17,34 @@
 #include "BlockExecutor.h"
 
 #include <gflags/gflags.h>
-#include <gperftools/profiler.h>
+#include <chrono>
+#include <limits>
+#include <thread>
 
 #include "AggregationMerge.h"
-#include "common/Likely.h"
+#include "BlockCache.h"
+#include "DictRow.h"
+#include "DirectSlots.h"
+#include "SketchRow.h"
+#include "TopHeap.h"
+#include "common/Arena.h"
 #include "memory/keyed/HashFlat.h"
 #include "surface/eval/UDF.h"
 
-DEFINE_bool(CPU_PROF, false, "Enable cpu profile");
-DEFINE_string(PROF_FILE, "/tmp/cpu_prof.out", "CPU profile output file");
+DEFINE_uint64(BLOCK_BATCH_ROWS, 1024, "number of rows processed as one batch in block compute");
+DEFINE_bool(DICT_GROUP_BY, true, "aggregate dictionary encoded string keys by dictionary index in block compute");
+DEFINE_uint64(DIRECT_AGG_SLOTS, 65536, "max slots of direct aggregation for keys with small domains, 0 to disable");
+DEFINE_bool(TIME_BUCKET_SLOTS, true, "aggregate time bucket keys (timeline window) by bucket index of time column directly");
+DEFINE_bool(METADATA_AGG, true, "answer aggregations on fully matched blocks by block metadata without scan");
+DEFINE_bool(TOP_GROUPS, true, "prune groups of block aggregation out of top N keys when sorting by a key column");
+DEFINE_bool(SCRIPT_BATCH, true, "evaluate script columns over each batch of selected rows in one call");
+DEFINE_double(PREAGG_BYPASS_RATIO,
+              0.8,
+              "groups per row of sampled rows at which block aggregation is bypassed to node merge, 0 to disable");
+DEFINE_uint64(PREAGG_SAMPLE_ROWS, 8192, "rows aggregated by a block before deciding to bypass its aggregation");
+DEFINE_uint64(GROUPS_RESERVE,
+              65536,
+              "max groups reserved upfront in block aggregation by distinct values of key columns, 0 to disable");
 
 /**
  * Nebula runtime / online meta data.
@@ -37,36 +56,167 @@ namespace core {
 using nebula::memory::EvaledBlock;
 using nebula::memory::keyed::HashFlat;
 using nebula::surface::RowCursorPtr;
-using nebula::surface::SchemaRow;
 using nebula::surface::eval::BlockEval;
 using nebula::surface::eval::EvalContext;
-using nebula::surface::eval::ScriptData;
+using nebula::surface::eval::ExpressionType;
+using nebula::surface::eval::Seeker;
+using nebula::surface::eval::Selection;
 using nebula::type::Kind;
 using nebula::type::Schema;
 
-RowCursorPtr compute(const EvaledBlock& data, const nebula::execution::BlockPhase& plan) {
+RowCursorPtr compute(const EvaledBlock& data,
+                     const nebula::execution::BlockPhase& plan,
+                     const Morsel& morsel,
+                     const nebula::execution::Cancellation* cancel,
+                     nebula::execution::MemoryBudget* memory,
+                     RowQuota* quota,
+                     nebula::execution::ComputeTime* time) {
   // TODO(cao) - SamplesExecutor seems having trouble evaluating scripts
   // see TestQuery: ApiTest.TestScriptSamples for repro
   if (plan.hasAggregation() || plan.hasScript()) {
-    return std::make_shared<BlockExecutor>(data, plan);
+    // aggregation of a block is reused from block cache if available
+    auto& cache = BlockCache::singleton();
+    const auto key = BlockCache::key(data, plan, morsel);
+    if (key.empty()) {
+      return std::make_shared<BlockExecutor>(data, plan, morsel, cancel, memory, time);
+    }
+
+    auto cached = cache.get(key, data, plan);
+    if (cached) {
+      return cached;
+    }
+
+    // partial result of a cancelled compute is never cached
+    auto executor = std::make_shared<BlockExecutor>(data, plan, morsel, cancel, memory, time);
+    if (!executor->cancelled()) {
+      cache.put(key, data, executor->result());
+    }
+
+    return executor;
   }
 
-  return std::make_shared<SamplesExecutor>(data, plan);
+  return std::make_shared<SamplesExecutor>(data, plan, morsel, quota, time);
 }
 
-void BlockExecutor::compute() {
-  // instrumentation for profiling on compute branch
-  if (N_UNLIKELY(FLAGS_CPU_PROF)) {
-    ProfilerStart(FLAGS_PROF_FILE.c_str());
+// groups of rows [0, rows) of a block estimated by distinct values of its key columns, at most rows.
+// it may overestimate as keys are taken as independent, 0 if a key is not a column or its column can't tell.
+static size_t estimateGroups(const nebula::execution::BlockPhase& plan,
+                             const nebula::surface::eval::Block& block,
+                             size_t rows) {
+  const auto& fields = plan.fields();
+  size_t groups = 1;
+  for (auto k : plan.keys()) {
+    const auto& f = fields.at(k);
+    if (f->expressionType() != ExpressionType::COLUMN) {
+      return 0;
+    }
+
+    // column signature is "F:{name}"
+    const auto values = block.distinctValues(std::string(f->signature().substr(2)));
+    if (values == 0) {
+      return 0;
+    }
+
+    groups = std::min(groups * values, rows);
   }
 
+  return groups;
+}
+
+// microseconds spent by a stage of a compute over all its runs, nothing is measured if it's disabled
+class StageTime {
+  using Clock = std::chrono::steady_clock;
+
+public:
+  explicit StageTime(bool enabled) : enabled_{ enabled }, us_{ 0 } {}
+
+  inline void start() noexcept {
+    if (enabled_) {
+      tick_ = Clock::now();
+    }
+  }
+
+  inline void stop() noexcept {
+    if (enabled_) {
+      us_ += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - tick_).count();
+    }
+  }
+
+  inline size_t us() const noexcept {
+    return us_;
+  }
+
+private:
+  const bool enabled_;
+  size_t us_;
+  Clock::time_point tick_;
+};
+
+// evaluation contexts are reused by blocks of a phase computed on the same thread.
+// a context is bound to its thread as its script runtime is, so contexts are pooled by thread,
+// for the few phases computed most recently which are identified by their serial numbers.
+class ContextPool {
+  static constexpr size_t CAPACITY = 8;
+
+  struct Entry {
+    size_t serial;
+    std::unique_ptr<EvalContext> ctx;
+  };
+
+public:
+  // a context for given phase, it goes back to the pool of this thread when its last reference is dropped
+  static std::shared_ptr<EvalContext> acquire(const nebula::execution::BlockPhase& plan) {
+    auto& entries = pool();
+    const auto serial = plan.serial();
+    std::unique_ptr<EvalContext> ctx;
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if (it->serial == serial) {
+        ctx = std::move(it->ctx);
+        entries.erase(it);
+        break;
+      }
+    }
+
+    if (!ctx) {
+      ctx = std::make_unique<EvalContext>(plan.cacheEval(), plan.scriptData());
+    }
+
+    const auto thread = std::this_thread::get_id();
+    return std::shared_ptr<EvalContext>(ctx.release(), [serial, thread](EvalContext* c) {
+      std::unique_ptr<EvalContext> owned(c);
+      if (std::this_thread::get_id() != thread) {
+        return;
+      }
+
+      // nothing of the block is held while it is pooled
+      owned->recycle();
+      auto& entries = pool();
+      entries.push_back(Entry{ serial, std::move(owned) });
+      if (entries.size() > CAPACITY) {
+        entries.erase(entries.begin());
+      }
+    });
+  }
+
+private:
+  static std::vector<Entry>& pool() {
+    static thread_local std::vector<Entry> entries;
+    return entries;
+  }
+};
+
+void BlockExecutor::compute() {
+  // aggregation states (sketches) of all groups created by this compute are allocated from one arena
+  auto arena = std::make_shared<nebula::common::Arena>();
+  nebula::common::Arena::Scope scope(arena);
+
   // process every single row and put result in HashFlat
   auto accessor = data_.first->makeAccessor();
   const auto& fields = plan_.fields();
   const auto& filter = plan_.filter();
 
-  // build context and computed row associated with this context
-  auto ctx = std::make_shared<EvalContext>(plan_.cacheEval(), makeScriptData(plan_));
+  // context and computed row associated with this context, the context is reused by next block of this thread
+  auto ctx = ContextPool::acquire(plan_);
 
   // predicate pushdown evaluation on block metadata
   auto result = data_.second;
@@ -74,9 +224,54 @@ void BlockExecutor::compute() {
   // if all rows needed, we don't need to evaluate row by row
   bool scanAll = result == BlockEval::ALL;
 
-  auto fieldMap = SchemaRow::name2index(plan_.outputSchema());
+  const auto& fieldMap = plan_.outputMap();
   ComputedRow cr(fieldMap, plan_.fields(), ctx);
-  result_ = std::make_unique<HashFlat>(plan_.outputSchema(), fields);
+
+  // all rows of the whole block match, aggregations may be answered by histograms and partition values
+  // the block gives a single pre-aggregated row and none of its rows is read
+  const auto& block = *data_.first;
+  const auto rows = block.getRows();
+  if (FLAGS_METADATA_AGG && scanAll && plan_.hasAggregation()) {
+    auto sketches = summarize(fields, block);
+    if (!sketches.empty()) {
+      // a block split into morsels is answered as a whole by its first morsel, others give nothing
+      result_ = std::make_unique<HashFlat>(plan_.outputSchema(), fields);
+      if (rows > 0 && morsel_.first(rows) == 0) {
+        result_->update(SketchRow(fieldMap, cr, sketches));
+      }
+
+      index_ = 0;
+      size_ = result_->getRows();
+      return;
+    }
+  }
+
+  // group by dictionary codes if any key reads a dictionary encoded column
+  // all rows go into a flat of codes, which is translated back to strings after the compute
+  const auto dict = FLAGS_DICT_GROUP_BY ? dictKeys(plan_, *data_.first) : DictKeys{};
+  const auto codeMode = !dict.empty();
+  DictCodeRow dcr(fieldMap, dict, cr);
+  const auto schema = codeMode ? codeSchema(plan_.outputSchema(), dict) : plan_.outputSchema();
+  result_ = std::make_unique<HashFlat>(schema, fields);
+
+  // keys with small known domains (bool, tinyint, dictionary codes, time buckets) are aggregated by slots directly
+  DirectSlots::TimeKey timeKey;
+  const auto& bucket = plan_.timeBucket();
+  if (FLAGS_TIME_BUCKET_SLOTS && bucket.window > 0) {
+    const auto time = block.histogram<nebula::surface::eval::IntHistogram>(nebula::meta::Table::TIME_COLUMN);
+    const auto index = accessor->index(nebula::meta::Table::TIME_COLUMN);
+    if (time.count > 0 && index) {
+      timeKey.bucket = bucket;
+      timeKey.low = (time.min() - bucket.begin) / bucket.window;
+      timeKey.high = (time.max() - bucket.begin) / bucket.window;
+      timeKey.raw = accessor.get();
+      timeKey.index = index.value();
+    }
+  }
+
+  auto direct = FLAGS_DIRECT_AGG_SLOTS > 0 && plan_.hasAggregation()
+                  ? DirectSlots::make(schema, fields, dict, FLAGS_DIRECT_AGG_SLOTS, timeKey)
+                  : nullptr;
 
   // we want to evaluate here for the whole block before we go to iterations of computing
   // by leveraging its metadata including histogram, bloom filter, dictionary etc.
@@ -89,34 +284,177 @@ void BlockExecutor::compute() {
   // and these methods will be used in each individual ValueEval and give result like above.
   // So we need an special operator to be implemented to have this function
 
-  for (size_t i = 0, size = data_.first->getRows(); i < size; ++i) {
-    ctx->reset(accessor->seek(i));
+  // vectorized mode: rows are processed batch by batch.
+  // for each batch, we first run the filter over all rows to build a selection vector of matched rows,
+  // then we run field computing and aggregation on the selected rows only.
+  // keeping filter and compute in separate tight loops avoids interleaving two interpreters per row.
+  const size_t batch = std::max<size_t>(FLAGS_BLOCK_BATCH_ROWS, 1);
+  const Seeker seeker = [&accessor](size_t row) -> const nebula::surface::Accessor& {
+    return accessor->seek(row);
+  };
+
+  // stripes of the block zone map which can't match the filter are skipped as a whole
+  const size_t zoneRows = scanAll ? 0 : block.zoneRows();
+  size_t stripe = std::numeric_limits<size_t>::max();
+  bool skip = false;
+
+  // rows out of the time range of the query can't match, the range is searched on encoded time column
+  size_t first = morsel_.first(rows);
+  size_t last = morsel_.last(rows);
+  const auto& time = plan_.timeRange();
+  if (time.first != std::numeric_limits<int64_t>::min() || time.second != std::numeric_limits<int64_t>::max()) {
+    const auto bound = block.rows(nebula::meta::Table::TIME_COLUMN, time.first, time.second);
+    first = std::max(first, bound.first);
+    last = std::max(first, std::min(last, bound.second));
+  }
+
+  // keys nearly unique in the block don't collapse by aggregation, such rows are passed through as their own groups
+  // after a sample of rows, so they are hashed once and aggregated by node merge only
+  const bool scripted = FLAGS_SCRIPT_BATCH && plan_.hasScript();
+  size_t sampled = FLAGS_PREAGG_BYPASS_RATIO > 0 && plan_.hasAggregation() && !direct
+                     ? 0
+                     : std::numeric_limits<size_t>::max();
+
+  // distinct values of key columns tell the groups upfront: a single key nearly unique in the block bypasses
+  // its aggregation without sampling, otherwise the key index is sized for the groups once instead of rehashing
+  const auto groups = plan_.hasAggregation() && !direct ? estimateGroups(plan_, block, last - first) : 0;
+  if (groups > 0) {
+    if (sampled == 0 && plan_.keys().size() == 1 && groups >= FLAGS_PREAGG_BYPASS_RATIO * (last - first)) {
+      bypassed_ = true;
+      sampled = std::numeric_limits<size_t>::max();
+    } else if (FLAGS_GROUPS_RESERVE > 0) {
+      result_->reserve(std::min<size_t>(groups, FLAGS_GROUPS_RESERVE));
+    }
+  }
+  StageTime filterTime{ time_ != nullptr };
+  StageTime aggregateTime{ time_ != nullptr };
+
+  // a row is consumed by its own type, so that reads of a computed row are bound statically
+  auto consume = [this, &direct](const auto& row) {
+    if (direct) {
+      direct->update(*result_, row);
+      return;
+    }
+
+    if (bypassed_) {
+      result_->append(row);
+      return;
+    }
+
+    result_->update(row);
+  };
+
+  Selection selection{ std::min(last - first, batch) };
+  for (size_t start = first, end = 0; start < last; start = end) {
+    // a cancelled query gives up the rest of the block, so does a query beyond its memory limit
+    charge_.update(result_->allocation() + arena->allocated());
+    if (cancel_ && cancel_->cancelled()) {
+      cancelled_ = true;
+      break;
+    }
+
+    end = std::min(last, start + batch);
+    if (zoneRows > 0) {
+      // evaluate filter on zone map once for every stripe, batches never cross stripe boundary
+      if (start / zoneRows != stripe) {
+        stripe = start / zoneRows;
+        skip = filter.eval(nebula::surface::eval::Stripe(block, stripe)) == BlockEval::NONE;
+      }
+
+      const auto stripeEnd = std::min(last, (stripe + 1) * zoneRows);
+      if (skip) {
+        end = stripeEnd;
+        continue;
+      }
+
+      end = std::min(end, stripeEnd);
+    }
+
+    selection.reset(start, end);
 
     // if not fullfil the condition
     // ignore valid here - if system can't determine how to act on NULL value
     // we don't know how to make decision here too
     if (N_LIKELY(!scanAll)) {
-      if (!filter.eval<bool>(*ctx).value_or(false)) {
+      filterTime.start();
+      filter.select(*ctx, *data_.first, seeker, selection);
+      filterTime.stop();
+    }
+
+    // script columns are evaluated over all selected rows of the batch in one call
+    aggregateTime.start();
+    if (scripted) {
+      ctx->span(seeker, selection);
+    }
+
+    // flat compute every new value of each field and set to corresponding column in flat
+    for (size_t pos = 0, size = selection.size(); pos < size; ++pos) {
+      const auto i = selection[pos];
+      ctx->reset(accessor->seek(i), pos);
+      if (codeMode) {
+        dcr.seek(i);
+        consume(dcr);
         continue;
       }
+
+      consume(cr);
+    }
+    aggregateTime.stop();
+
+    if (sampled < FLAGS_PREAGG_SAMPLE_ROWS) {
+      sampled += selection.size();
+      if (sampled >= FLAGS_PREAGG_SAMPLE_ROWS) {
+        bypassed_ = result_->getRows() >= FLAGS_PREAGG_BYPASS_RATIO * sampled;
+      }
     }
+  }
 
-    // flat compute every new value of each field and set to corresponding column in flat
-    result_->update(cr);
+  // translate codes back to strings, every code maps to a unique string so no duplicate keys
+  aggregateTime.start();
+  if (codeMode) {
+    auto codes = std::move(result_);
+    result_ = std::make_unique<HashFlat>(plan_.outputSchema(), fields);
+    DictItemRow dir(fieldMap, dict);
+    for (size_t i = 0, size = codes->getRows(); i < size; ++i) {
+      dir.wrap(codes->row(i));
+      if (bypassed_) {
+        result_->append(dir);
+        continue;
+      }
+
+      result_->update(dir);
+    }
+  }
+
+  // sorting by a key with limit, groups out of top N keys of this block can't make the final result
+  // a bypassed result may split a group into rows, which can't be ranked until they are merged
+  if (FLAGS_TOP_GROUPS && plan_.hasAggregation() && !bypassed_) {
+    result_ = topGroups(std::move(result_), plan_);
+  }
+
+  aggregateTime.stop();
+  if (time_) {
+    time_->add(filterTime.us(), aggregateTime.us());
   }
 
+  charge_.update(result_->allocation() + arena->allocated());
+
   // after the compute flat should contain all the data we need.
   index_ = 0;
   size_ = result_->getRows();
-
-  if (N_UNLIKELY(FLAGS_CPU_PROF)) {
-    ProfilerStop();
-  }
 }
 
 void SamplesExecutor::compute() {
+  // selecting sample rows is all filtering, their values are computed while being read
+  StageTime filterTime{ time_ != nullptr };
+  filterTime.start();
+
   // build context and computed row associated with this context
-  samples_ = std::make_unique<ReferenceRows>(plan_, *data_.first);
+  samples_ = std::make_unique<ReferenceRows>(plan_, *data_.first, morsel_, quota_);
+  filterTime.stop();
+  if (time_) {
+    time_->add(filterTime.us(), 0);
+  }
 
   // after the compute flat should contain all the data we need.
   index_ = 0;
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "ComputedRow.h"
+#include "Morsel.h"
 #include "ReferenceRows.h"
 #include "execution/ExecutionPlan.h"
 #include "memory/Batch.h"
@@ -38,8 +39,19 @@ namespace core {
 class BlockExecutor : public nebula::surface::RowCursor {
 
 public:
-  BlockExecutor(const nebula::memory::EvaledBlock& data, const nebula::execution::BlockPhase& plan)
-    : nebula::surface::RowCursor(0), data_{ data }, plan_{ plan } {
+  BlockExecutor(const nebula::memory::EvaledBlock& data,
+                const nebula::execution::BlockPhase& plan,
+                const Morsel& morsel = Morsel::all(),
+                const nebula::execution::Cancellation* cancel = nullptr,
+                nebula::execution::MemoryBudget* memory = nullptr,
+                nebula::execution::ComputeTime* time = nullptr)
+    : nebula::surface::RowCursor(0),
+      data_{ data },
+      plan_{ plan },
+      morsel_{ morsel },
+      cancel_{ cancel },
+      charge_{ memory },
+      time_{ time } {
     // compute will finish the compute and fill the data state in
     this->compute();
   }
@@ -53,6 +65,21 @@ public:
     return result_->crow(index);
   }
 
+  inline const nebula::memory::keyed::HashFlat& result() const {
+    return *result_;
+  }
+
+  // the compute was given up by a cancelled query, its result is partial
+  inline bool cancelled() const noexcept {
+    return cancelled_;
+  }
+
+  // aggregation was bypassed for nearly unique keys, the result may hold a group in multiple rows
+  // and it has to be merged before being used as an aggregated result
+  inline bool bypassed() const noexcept {
+    return bypassed_;
+  }
+
   inline std::unique_ptr<nebula::memory::keyed::FlatBuffer> takeResult() {
     auto temp = std::move(result_);
     result_ = nullptr;
@@ -65,13 +92,25 @@ private:
 private:
   const nebula::memory::EvaledBlock& data_;
   const nebula::execution::BlockPhase& plan_;
+  const Morsel morsel_;
+  const nebula::execution::Cancellation* cancel_;
+  bool cancelled_ = false;
+  bool bypassed_ = false;
+  // memory of the result and aggregation states charged to the query until this executor is released
+  nebula::execution::MemoryCharge charge_;
+  // filter and aggregation time of this compute is added to the query if given
+  nebula::execution::ComputeTime* time_;
   std::unique_ptr<nebula::memory::keyed::HashFlat> result_;
 };
 
 class SamplesExecutor : public nebula::surface::RowCursor {
 public:
-  SamplesExecutor(const nebula::memory::EvaledBlock& data, const nebula::execution::BlockPhase& plan)
-    : nebula::surface::RowCursor(0), data_{ data }, plan_{ plan } {
+  SamplesExecutor(const nebula::memory::EvaledBlock& data,
+                  const nebula::execution::BlockPhase& plan,
+                  const Morsel& morsel = Morsel::all(),
+                  RowQuota* quota = nullptr,
+                  nebula::execution::ComputeTime* time = nullptr)
+    : nebula::surface::RowCursor(0), data_{ data }, plan_{ plan }, morsel_{ morsel }, quota_{ quota }, time_{ time } {
     // compute will finish the compute and fill the data state in
     this->compute();
   }
@@ -92,10 +131,23 @@ private:
 private:
   const nebula::memory::EvaledBlock& data_;
   const nebula::execution::BlockPhase& plan_;
+  const Morsel morsel_;
+  RowQuota* quota_;
+  nebula::execution::ComputeTime* time_;
   std::unique_ptr<ReferenceRows> samples_;
 };
 
-nebula::surface::RowCursorPtr compute(const nebula::memory::EvaledBlock&, const nebula::execution::BlockPhase&);
+// compute a block phase on given row range (morsel) of a block, whole block by default
+// an aggregation compute checks the cancellation token and charges its memory to the budget between batches if given
+// a samples compute stops once the row quota shared by all blocks of the query is full if given
+// filter and aggregation time of the compute is added to the query compute time if given
+nebula::surface::RowCursorPtr compute(const nebula::memory::EvaledBlock&,
+                                      const nebula::execution::BlockPhase&,
+                                      const Morsel& = Morsel::all(),
+                                      const nebula::execution::Cancellation* = nullptr,
+                                      nebula::execution::MemoryBudget* = nullptr,
+                                      RowQuota* = nullptr,
+                                      nebula::execution::ComputeTime* = nullptr);
 
 } // namespace core
 } // namespace execution
@@ -23,30 +23,6 @@ namespace nebula {
 namespace execution {
 namespace core {
 
-bool ComputedRow::isNull(IndexType) const {
-  // TODO(cao): how to determine nullbility of output field?
-  return false;
-}
-
-// TODO(cao) - need to use the consistent interface of optional<T>
-// otherwise - this may return invalid values
-#define FORWARD_EVAL_FIELD(TYPE, NAME)                                                        \
-  TYPE ComputedRow::NAME(IndexType index) const {                                             \
-    return fields_[index]->eval<TYPE>(*ctx_).value_or(nebula::type::TypeDetect<TYPE>::value); \
-  }
-
-FORWARD_EVAL_FIELD(bool, readBool)
-FORWARD_EVAL_FIELD(int8_t, readByte)
-FORWARD_EVAL_FIELD(int16_t, readShort)
-FORWARD_EVAL_FIELD(int32_t, readInt)
-FORWARD_EVAL_FIELD(int64_t, readLong)
-FORWARD_EVAL_FIELD(float, readFloat)
-FORWARD_EVAL_FIELD(double, readDouble)
-FORWARD_EVAL_FIELD(int128_t, readInt128)
-FORWARD_EVAL_FIELD(std::string_view, readString)
-
-#undef FORWARD_EVAL_FIELD
-
 std::unique_ptr<nebula::surface::ListData> ComputedRow::readList(IndexType) const {
   throw NException("Not implemented yet");
 }
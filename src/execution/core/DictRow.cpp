@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DictRow.h"
+
+/**
+ * Nebula runtime / online meta data.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+using nebula::memory::Batch;
+using nebula::surface::eval::ExpressionType;
+using nebula::type::IntType;
+using nebula::type::Kind;
+using nebula::type::RowType;
+using nebula::type::Schema;
+using nebula::type::TreeNode;
+
+DictKeys dictKeys(const BlockPhase& plan, const Batch& batch) {
+  // only applies to aggregation where keys are hashed and compared
+  if (!plan.hasAggregation()) {
+    return {};
+  }
+
+  const auto& fields = plan.fields();
+  const auto size = fields.size();
+  DictKeys keys(size, nullptr);
+  bool found = false;
+  for (size_t i = 0; i < size; ++i) {
+    const auto& f = fields.at(i);
+    if (f->isAggregate()
+        || f->expressionType() != ExpressionType::COLUMN
+        || f->outputType() != Kind::VARCHAR) {
+      continue;
+    }
+
+    // column signature is "F:{name}"
+    const auto sign = f->signature();
+    auto node = batch.dictionary(std::string(sign.substr(2)));
+    if (node) {
+      keys[i] = node;
+      found = true;
+    }
+  }
+
+  return found ? keys : DictKeys{};
+}
+
+Schema codeSchema(const Schema& schema, const DictKeys& keys) {
+  const auto size = schema->size();
+  std::vector<TreeNode> children;
+  children.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    auto node = schema->childAt(i);
+    if (keys.at(i)) {
+      children.push_back(IntType::createTree(schema->childType(i)->name()));
+      continue;
+    }
+
+    children.push_back(node);
+  }
+
+  return std::static_pointer_cast<RowType>(RowType::create(schema->name(), children));
+}
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "ComputedRow.h"
+#include "execution/ExecutionPlan.h"
+#include "memory/Batch.h"
+#include "surface/SchemaRow.h"
+#include "surface/eval/ValueEval.h"
+
+/**
+ * Group by dictionary codes for dictionary encoded string keys.
+ * Inside a block, a key field reading a dictionary encoded column is aggregated on its int32 dictionary index,
+ * rather than hashing and comparing strings. The codes are translated back to strings when result leaves the block.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+// dictionary node of each output column, nullptr if the column is not a dictionary key
+using DictKeys = std::vector<nebula::memory::PDataNode>;
+
+// code used for null string keys
+static constexpr int32_t NULL_CODE = -1;
+
+// find all key fields which can be aggregated by dictionary codes, empty if none
+DictKeys dictKeys(const nebula::execution::BlockPhase&, const nebula::memory::Batch&);
+
+// replace every dictionary key column as INTEGER column of codes
+nebula::type::Schema codeSchema(const nebula::type::Schema&, const DictKeys&);
+
+// forward all calls to the wrapped row except the columns in given index set
+#define FORWARD_ROW_INDEX(T, F)            \
+  inline T F(IndexType i) const override { \
+    return row_->F(i);                     \
+  }
+
+class ForwardRow : public nebula::surface::SchemaRow {
+protected:
+  using IndexType = nebula::surface::IndexType;
+
+public:
+  ForwardRow(const nebula::surface::Name2Index& fieldMap, const DictKeys& keys)
+    : SchemaRow(fieldMap), keys_{ keys }, row_{ nullptr } {}
+  virtual ~ForwardRow() = default;
+
+  FORWARD_ROW_INDEX(bool, isNull)
+  FORWARD_ROW_INDEX(bool, readBool)
+  FORWARD_ROW_INDEX(int8_t, readByte)
+  FORWARD_ROW_INDEX(int16_t, readShort)
+  FORWARD_ROW_INDEX(int64_t, readLong)
+  FORWARD_ROW_INDEX(float, readFloat)
+  FORWARD_ROW_INDEX(double, readDouble)
+  FORWARD_ROW_INDEX(int128_t, readInt128)
+  FORWARD_ROW_INDEX(std::unique_ptr<nebula::surface::ListData>, readList)
+  FORWARD_ROW_INDEX(std::unique_ptr<nebula::surface::MapData>, readMap)
+
+  inline std::shared_ptr<nebula::surface::eval::Sketch> getAggregator(IndexType i) const override {
+    return row_->getAggregator(i);
+  }
+
+protected:
+  const DictKeys& keys_;
+  const nebula::surface::RowData* row_;
+};
+
+#undef FORWARD_ROW_INDEX
+
+// computed row reading dictionary codes for dictionary keys of current block row
+class DictCodeRow final : public ForwardRow {
+public:
+  DictCodeRow(const nebula::surface::Name2Index& fieldMap, const DictKeys& keys, const ComputedRow& row)
+    : ForwardRow(fieldMap, keys), computed_{ row }, index_{ 0 } {
+    row_ = &row;
+  }
+  virtual ~DictCodeRow() = default;
+
+  // set current block row
+  inline void seek(size_t index) {
+    index_ = index;
+  }
+
+  inline int32_t readInt(IndexType i) const override {
+    auto node = keys_[i];
+    if (node) {
+      return node->isNull(index_) ? NULL_CODE : node->dictCode(index_);
+    }
+
+    return row_->readInt(i);
+  }
+
+  inline std::string_view readString(IndexType i) const override {
+    return row_->readString(i);
+  }
+
+  // single pass evaluation of the computed row, a dictionary key is its code which is never null
+  template <nebula::type::Kind K>
+  inline std::optional<typename nebula::type::TypeTraits<K>::CppType> value(IndexType i) const {
+    if constexpr (K == nebula::type::Kind::INTEGER) {
+      if (keys_[i]) {
+        return readInt(i);
+      }
+    }
+
+    return computed_.value<K>(i);
+  }
+
+private:
+  const ComputedRow& computed_;
+  size_t index_;
+};
+
+// row of code flat translating dictionary codes back to strings
+class DictItemRow : public ForwardRow {
+public:
+  DictItemRow(const nebula::surface::Name2Index& fieldMap, const DictKeys& keys)
+    : ForwardRow(fieldMap, keys) {}
+  virtual ~DictItemRow() = default;
+
+  inline void wrap(const nebula::surface::RowData& row) {
+    row_ = &row;
+  }
+
+  inline int32_t readInt(IndexType i) const override {
+    return row_->readInt(i);
+  }
+
+  inline std::string_view readString(IndexType i) const override {
+    auto node = keys_[i];
+    if (node) {
+      auto code = row_->readInt(i);
+      return code == NULL_CODE ? nebula::type::TypeDetect<std::string_view>::value : node->dictItem(code);
+    }
+
+    return row_->readString(i);
+  }
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
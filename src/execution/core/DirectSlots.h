@@ -0,0 +1,160 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "DictRow.h"
+#include "execution/ExecutionPlan.h"
+#include "memory/keyed/HashFlat.h"
+
+/**
+ * Direct (perfect hash) aggregation for keys with small known domains.
+ * Every key combination is mapped to a slot in a dense array which stores its row in the hash flat,
+ * so an existing group is located by array index without hashing or comparing keys.
+ *
+ * A time bucket key (such as timeline window) has a small domain within a block too: its slot is the bucket index
+ * computed from the raw time column arithmetically, so the key expression is not evaluated for every row.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+class DirectSlots {
+  // map key value of a row into [0, domain)
+  using SlotOf = std::function<size_t(const nebula::surface::RowData&)>;
+  static constexpr size_t EMPTY = std::numeric_limits<size_t>::max();
+
+public:
+  // time bucket key read from the raw time column of a block
+  struct TimeKey {
+    TimeBucket bucket;
+    // bucket index range [low, high] of all time in the block
+    int64_t low = 0;
+    int64_t high = -1;
+    // raw row positioned at current row and index of time column in it
+    const nebula::surface::Accessor* raw = nullptr;
+    nebula::surface::IndexType index = 0;
+
+    inline bool valid() const noexcept {
+      return bucket.window > 0 && raw != nullptr && low <= high;
+    }
+  };
+
+public:
+  DirectSlots(std::vector<SlotOf> keys, std::vector<size_t> domains, size_t slots)
+    : keys_{ std::move(keys) }, domains_{ std::move(domains) }, slots_(slots, EMPTY) {}
+  virtual ~DirectSlots() = default;
+
+  // build direct slots if all keys of given schema have known small domains, otherwise nullptr.
+  // dictionary keys (in code mode) have dictionary size plus one for null code.
+  static std::unique_ptr<DirectSlots> make(const nebula::type::Schema& schema,
+                                           const nebula::surface::eval::Fields& fields,
+                                           const DictKeys& dict,
+                                           size_t maxSlots,
+                                           const TimeKey& time = {}) {
+    std::vector<SlotOf> keys;
+    std::vector<size_t> domains;
+    size_t slots = 1;
+    for (size_t i = 0, size = fields.size(); i < size; ++i) {
+      if (fields.at(i)->isAggregate()) {
+        continue;
+      }
+
+      size_t domain = 0;
+      if (time.valid() && i == time.bucket.field) {
+        domain = time.high - time.low + 1;
+        keys.push_back([time](const nebula::surface::RowData&) -> size_t {
+          // same as the bucket expression: (_time_ - begin) / window
+          const auto t = time.raw->readLong(time.index).value_or(0);
+          return (size_t)((t - time.bucket.begin) / time.bucket.window - time.low);
+        });
+      } else {
+        switch (schema->childType(i)->k()) {
+        case nebula::type::Kind::BOOLEAN: {
+          domain = 2;
+          keys.push_back([i](const nebula::surface::RowData& row) -> size_t {
+            return row.readBool(i) ? 1 : 0;
+          });
+          break;
+        }
+        case nebula::type::Kind::TINYINT: {
+          domain = 256;
+          keys.push_back([i](const nebula::surface::RowData& row) -> size_t {
+            return (size_t)((int32_t)row.readByte(i) + 128);
+          });
+          break;
+        }
+        case nebula::type::Kind::INTEGER: {
+          if (dict.empty() || dict.at(i) == nullptr) {
+            return nullptr;
+          }
+
+          domain = dict.at(i)->dictSize() + 1;
+          keys.push_back([i](const nebula::surface::RowData& row) -> size_t {
+            return (size_t)(row.readInt(i) - NULL_CODE);
+          });
+          break;
+        }
+        default:
+          return nullptr;
+        }
+      }
+
+      // too many slots for a dense array
+      slots *= domain;
+      if (slots > maxSlots) {
+        return nullptr;
+      }
+
+      domains.push_back(domain);
+    }
+
+    // no key at all, single group aggregation doesn't need slots
+    if (keys.empty()) {
+      return nullptr;
+    }
+
+    return std::make_unique<DirectSlots>(std::move(keys), std::move(domains), slots);
+  }
+
+  // aggregate a row in the flat through its slot, the row is passed on by its own type
+  template <typename R>
+  inline void update(nebula::memory::keyed::HashFlat& flat, const R& row) {
+    size_t slot = 0;
+    for (size_t i = 0, size = keys_.size(); i < size; ++i) {
+      slot = slot * domains_[i] + keys_[i](row);
+    }
+
+    auto& target = slots_[slot];
+    if (target == EMPTY) {
+      // first row of the group goes to hash flat as a new row
+      flat.update(row);
+      target = flat.getRows() - 1;
+      return;
+    }
+
+    flat.update(row, target);
+  }
+
+private:
+  std::vector<SlotOf> keys_;
+  std::vector<size_t> domains_;
+  std::vector<size_t> slots_;
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -15,7 +15,12 @@
  */
 
 #include "Finalize.h"
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <gflags/gflags.h>
+#include <mutex>
 
 #include "memory/FlatRow.h"
 #include "surface/DataSurface.h"
@@ -26,6 +31,13 @@ DEFINE_uint64(FOWARD_ROW_CACHE_SIZE,
               256,
               "bytes per slice o use for caching forward row");
 
+DEFINE_uint64(FINALIZE_PARALLEL_ROWS,
+              65536,
+              "minimum number of result rows to finalize aggregate columns in parallel chunks on the pool,"
+              "0 disables parallel finalize.");
+
+DEFINE_uint64(FINALIZE_CHUNK_ROWS, 4096, "number of rows finalized by one task in parallel finalize");
+
 /**
  * A logic wrapper to return top sort cursors when sorting and limiting are present
  */
@@ -48,25 +60,100 @@ using nebula::type::Schema;
 using nebula::type::TypeTraits;
 
 // transformers to be executed for each column if it needs a transformer
-using TransformerVector = std::vector<std::function<void(const RowData*, void*)>>;
+using Transformer = std::function<void(const RowData*, void*)>;
+using TransformerVector = std::vector<Transformer>;
+
+// finalized values of one transformed column for all rows
+// fixed width values are written by the transformer in place, strings are copied as they don't outlive their sketch
+class FinalColumn {
+public:
+  void prepare(Kind kind, size_t rows) {
+    if (kind == Kind::VARCHAR) {
+      strings_.resize(rows);
+      return;
+    }
+
+    width_ = width(kind);
+    values_.resize(rows * width_);
+  }
+
+  inline void fill(const Transformer& transform, const RowData& row, size_t index) {
+    if (width_ == 0) {
+      std::string_view v;
+      transform(&row, &v);
+      strings_[index] = v;
+      return;
+    }
+
+    transform(&row, values_.data() + index * width_);
+  }
+
+  template <typename T>
+  inline T read(size_t index) const {
+    if constexpr (std::is_same_v<T, std::string_view>) {
+      return strings_[index];
+    } else {
+      T v;
+      std::memcpy(&v, values_.data() + index * sizeof(T), sizeof(T));
+      return v;
+    }
+  }
+
+private:
+  static size_t width(Kind kind) {
+    switch (kind) {
+#define KIND_WIDTH(K) \
+  case Kind::K:       \
+    return TypeTraits<Kind::K>::width;
+
+      KIND_WIDTH(BOOLEAN)
+      KIND_WIDTH(TINYINT)
+      KIND_WIDTH(SMALLINT)
+      KIND_WIDTH(INTEGER)
+      KIND_WIDTH(BIGINT)
+      KIND_WIDTH(REAL)
+      KIND_WIDTH(DOUBLE)
+      KIND_WIDTH(INT128)
+
+#undef KIND_WIDTH
+    default:
+      throw NException(fmt::format("Unsupported finalize output type: {0}", (int)kind));
+    }
+  }
+
+private:
+  size_t width_ = 0;
+  std::vector<char> values_;
+  std::vector<std::string> strings_;
+};
+
+// empty if rows are finalized on read, otherwise indexed by column, only transformed columns are prepared
+using FinalColumns = std::vector<FinalColumn>;
 
 class ForwardRowData : public nebula::surface::SchemaRow {
 public:
   ForwardRowData(const Name2Index& fieldMap,
-                 const TransformerVector& transformers)
+                 const TransformerVector& transformers,
+                 const FinalColumns& columns)
     : SchemaRow(fieldMap),
       inner_{ nullptr },
       row_{ nullptr },
       transformers_{ transformers },
+      columns_{ columns },
+      index_{ 0 },
       cache_{ FLAGS_FOWARD_ROW_CACHE_SIZE } {
   }
   ForwardRowData(const Name2Index& fieldMap,
                  const TransformerVector& transformers,
-                 std::unique_ptr<RowData> inner)
+                 const FinalColumns& columns,
+                 std::unique_ptr<RowData> inner,
+                 size_t index)
     : SchemaRow(fieldMap),
       inner_{ std::move(inner) },
       row_{ inner_.get() },
       transformers_{ transformers },
+      columns_{ columns },
+      index_{ index },
       cache_{ FLAGS_FOWARD_ROW_CACHE_SIZE } {
   }
 
@@ -75,20 +162,23 @@ public:
     return row_->isNull(i);
   }
 
-#define DISPATCH_TRANSFORM_TYPE(T, F, C)  \
-  T F(IndexType i) const override {       \
-    auto transform = transformers_.at(i); \
-    if (transform) {                      \
-      auto key = std::to_string(i);       \
-      if (cache_.hasKey(key)) {           \
-        return cache_.F(key);             \
-      }                                   \
-      T v;                                \
-      transform(row_, &v);                \
-      C;                                  \
-      return v;                           \
-    }                                     \
-    return row_->F(i);                    \
+#define DISPATCH_TRANSFORM_TYPE(T, F, C)         \
+  T F(IndexType i) const override {              \
+    const auto& transform = transformers_.at(i); \
+    if (transform) {                             \
+      if (!columns_.empty()) {                   \
+        return columns_[i].read<T>(index_);      \
+      }                                          \
+      auto key = std::to_string(i);              \
+      if (cache_.hasKey(key)) {                  \
+        return cache_.F(key);                    \
+      }                                          \
+      T v;                                       \
+      transform(row_, &v);                       \
+      C;                                         \
+      return v;                                  \
+    }                                            \
+    return row_->F(i);                           \
   }
 
   DISPATCH_TRANSFORM_TYPE(bool, readBool, cache_.write(key, v))
@@ -115,8 +205,9 @@ public:
   }
 
 public:
-  inline void set(const RowData& row) {
+  inline void set(const RowData& row, size_t index) {
     row_ = const_cast<RowData*>(&row);
+    index_ = index;
     cache_.reset();
   }
 
@@ -124,6 +215,10 @@ private:
   std::unique_ptr<RowData> inner_;
   RowData* row_;
   const TransformerVector& transformers_;
+  const FinalColumns& columns_;
+
+  // row index into finalized columns
+  size_t index_;
 
   // value cache so it don't call into transformer repeatedly
   mutable FlatRow cache_;
@@ -131,25 +226,94 @@ private:
 
 class ForwardRowCursor : public RowCursor {
 public:
-  ForwardRowCursor(RowCursorPtr inner, const Name2Index& fieldMap, const FinalPhase& phase)
+  ForwardRowCursor(RowCursorPtr inner, const Name2Index& fieldMap, const FinalPhase& phase, double scale)
     : RowCursor(inner->size()),
       inner_{ inner },
       fieldMap_{ fieldMap },
       phase_{ phase },
-      row_{ fieldMap, transformers_ } {
+      scale_{ scale },
+      row_{ fieldMap, transformers_, columns_ } {
     // build transformers
     buildTransformers();
   }
   virtual ~ForwardRowCursor() = default;
 
   virtual const RowData& next() override {
-    row_.set(inner_->next());
+    const auto index = index_++;
+    row_.set(inner_->next(), index);
     return row_;
   }
 
   // a const interface return an unique ptr for secure randome access
   virtual std::unique_ptr<RowData> item(size_t i) const override {
-    return std::unique_ptr<RowData>(new ForwardRowData(fieldMap_, transformers_, inner_->item(i)));
+    return std::unique_ptr<RowData>(new ForwardRowData(fieldMap_, transformers_, columns_, inner_->item(i), i));
+  }
+
+  // finalize all rows into columns by chunks of rows before any row is read.
+  // workers of the pool and the calling thread all take chunks from the same counter, every chunk writes
+  // its own rows of the preallocated columns, so the caller never waits on a task which hasn't started.
+  void finalizeAll(folly::ThreadPoolExecutor& pool, size_t chunk) {
+    const auto rows = inner_->size();
+    const auto output = phase_.outputSchema();
+    FinalColumns columns(transformers_.size());
+    for (size_t i = 0, size = transformers_.size(); i < size; ++i) {
+      if (transformers_.at(i)) {
+        columns.at(i).prepare(output->childType(i)->k(), rows);
+      }
+    }
+
+    struct Chunks {
+      explicit Chunks(size_t n) : total{ n }, next{ 0 }, done{ 0 } {}
+      const size_t total;
+      std::atomic<size_t> next;
+      size_t done;
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::exception_ptr error;
+    };
+
+    auto chunks = std::make_shared<Chunks>((rows + chunk - 1) / chunk);
+    auto work = [this, chunks, &columns, rows, chunk]() {
+      for (auto c = chunks->next.fetch_add(1); c < chunks->total; c = chunks->next.fetch_add(1)) {
+        std::exception_ptr error;
+        try {
+          for (size_t r = c * chunk, end = std::min(rows, r + chunk); r < end; ++r) {
+            const auto row = inner_->item(r);
+            for (size_t i = 0, size = transformers_.size(); i < size; ++i) {
+              if (transformers_[i]) {
+                columns[i].fill(transformers_[i], *row, r);
+              }
+            }
+          }
+        } catch (...) {
+          error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(chunks->mutex);
+        if (error && !chunks->error) {
+          chunks->error = error;
+        }
+
+        if (++chunks->done == chunks->total) {
+          chunks->cv.notify_all();
+        }
+      }
+    };
+
+    // tasks starting after all chunks taken find nothing to do
+    const auto workers = std::min<size_t>(pool.numThreads(), chunks->total);
+    for (size_t i = 1; i < workers; ++i) {
+      pool.add(work);
+    }
+
+    work();
+    std::unique_lock<std::mutex> lock(chunks->mutex);
+    chunks->cv.wait(lock, [&chunks]() { return chunks->done == chunks->total; });
+    if (chunks->error) {
+      std::rethrow_exception(chunks->error);
+    }
+
+    columns_ = std::move(columns);
   }
 
 private:
@@ -162,9 +326,37 @@ private:
     *static_cast<OutputType*>(t) = agg->finalize();
   }
 
+  // finalize and scale up a number column
+  template <Kind O, Kind I>
+  static void scale(const RowData* r, void* t, size_t i, double factor) {
+    using OutputType = typename TypeTraits<O>::CppType;
+    finalize<O, I>(r, t, i);
+    if constexpr (std::is_arithmetic_v<OutputType> && !std::is_same_v<OutputType, bool>) {
+      auto& value = *static_cast<OutputType*>(t);
+      if constexpr (std::is_integral_v<OutputType>) {
+        value = static_cast<OutputType>(std::llround(value * factor));
+      } else {
+        value = static_cast<OutputType>(value * factor);
+      }
+    }
+  }
+
+  // COUNT and SUM are estimated by scaling, others (MIN, MAX, AVG...) are taken from the sample as is
+  static bool scalable(const nebula::surface::eval::ValueEval& field) {
+    using nebula::surface::eval::UdfTraits;
+    using nebula::surface::eval::UDFType;
+    const auto& signature = field.signature();
+    auto starts = [&signature](const char* name) {
+      return signature.rfind(fmt::format("{0}(", name), 0) == 0;
+    };
+
+    return starts(UdfTraits<UDFType::COUNT>::Name) || starts(UdfTraits<UDFType::SUM>::Name);
+  }
+
   void buildTransformers() {
     auto input = phase_.inputSchema();
     auto output = phase_.outputSchema();
+    const auto& fields = phase_.fields();
     // different on this column index
     const auto size = input->size();
     N_ENSURE_EQ(size, output->size(), "support the same number of columns");
@@ -175,6 +367,19 @@ private:
       transformers_.push_back({});
 
       if (phase_.isAggregateColumn(i)) {
+        if (scale_ != 1 && scalable(*fields.at(i))) {
+#define LOGIC_BY_IO(O, I)                                                                                                                 \
+  case Kind::I: {                                                                                                                         \
+    transformers_[i] = std::bind(&ForwardRowCursor::scale<Kind::O, Kind::I>, std::placeholders::_1, std::placeholders::_2, i, scale_); \
+  };                                                                                                                                      \
+    break;
+
+          ITERATE_BY_IO(oType, iType)
+
+#undef LOGIC_BY_IO
+          continue;
+        }
+
 // below provides a template to write core logic for all input / output type combinations
 #define LOGIC_BY_IO(O, I)                                                                                                         \
   case Kind::I: {                                                                                                                 \
@@ -193,18 +398,30 @@ private:
   RowCursorPtr inner_;
   const Name2Index& fieldMap_;
   const FinalPhase& phase_;
+  const double scale_;
+  FinalColumns columns_;
   ForwardRowData row_;
   TransformerVector transformers_;
 };
 
 // finalize transform data between types if needed, otherwise you get the original cursor
-RowCursorPtr finalize(RowCursorPtr cursor, const Name2Index& fieldMap, const FinalPhase& phase) {
+RowCursorPtr finalize(RowCursorPtr cursor,
+                      const Name2Index& fieldMap,
+                      const FinalPhase& phase,
+                      double scale,
+                      folly::ThreadPoolExecutor* pool) {
   if (!phase.hasAggregation()) {
     return cursor;
   }
 
   // now let's return a cursor that has transformer built in
-  return std::make_shared<ForwardRowCursor>(cursor, fieldMap, phase);
+  auto forward = std::make_shared<ForwardRowCursor>(cursor, fieldMap, phase, scale);
+  const auto rows = cursor->size();
+  if (pool && FLAGS_FINALIZE_PARALLEL_ROWS > 0 && rows >= FLAGS_FINALIZE_PARALLEL_ROWS) {
+    forward->finalizeAll(*pool, std::max<size_t>(FLAGS_FINALIZE_CHUNK_ROWS, 1));
+  }
+
+  return forward;
 }
 
 } // namespace core
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "common/Folly.h"
 #include "execution/ExecutionPlan.h"
 #include "surface/DataSurface.h"
 #include "surface/SchemaRow.h"
@@ -28,8 +29,15 @@ namespace execution {
 namespace core {
 
 // global phase will need to finalize some columns when fetching data
+// COUNT and SUM columns are multiplied by scale if it is not 1 (approximate query on sampled blocks)
+// when a pool is given and the result is large, aggregate columns of all rows are finalized up front
+// in parallel chunks on the pool into columns, otherwise every row is finalized when it is read.
 nebula::surface::RowCursorPtr finalize(
-  nebula::surface::RowCursorPtr, const nebula::surface::Name2Index&, const FinalPhase&);
+  nebula::surface::RowCursorPtr,
+  const nebula::surface::Name2Index&,
+  const FinalPhase&,
+  double scale = 1,
+  folly::ThreadPoolExecutor* pool = nullptr);
 
 } // namespace core
 } // namespace execution
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "execution/Context.h"
+
+/**
+ * Hedged node calls for tail latency.
+ * When a node's data is also served by a replica, a duplicate call is sent to the replica if the node hasn't
+ * responded after a high percentile of recent node latencies. The first call to finish wins, the other one is
+ * cancelled, so one slow node doesn't hold the whole query while only a few extra calls are made.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+// latencies of recent successful node calls in milliseconds, kept in a ring of fixed size
+class LatencyTracker {
+public:
+  explicit LatencyTracker(size_t capacity = 1024) : capacity_{ capacity }, next_{ 0 } {
+    samples_.reserve(capacity_);
+  }
+  virtual ~LatencyTracker() = default;
+
+  void record(size_t ms) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (samples_.size() < capacity_) {
+      samples_.push_back(ms);
+      return;
+    }
+
+    samples_[next_] = ms;
+    next_ = (next_ + 1) % capacity_;
+  }
+
+  // latency at percentile p in [0, 100] of recent calls, 0 if there are less than given samples
+  size_t percentile(size_t p, size_t min = 1) const {
+    std::vector<size_t> values;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (samples_.size() < std::max<size_t>(min, 1)) {
+        return 0;
+      }
+
+      values = samples_;
+    }
+
+    const auto rank = std::min(values.size() - 1, values.size() * std::min<size_t>(p, 100) / 100);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values.at(rank);
+  }
+
+private:
+  const size_t capacity_;
+  mutable std::mutex lock_;
+  std::vector<size_t> samples_;
+  size_t next_;
+};
+
+// a node call and its hedged duplicate race for one result, calls are identified by 0 (primary) and 1 (hedge).
+// only the call claiming the race contributes its result and stats, the other one is cancelled by the token.
+class HedgeRace {
+public:
+  static constexpr size_t NONE = 2;
+
+  HedgeRace() : winner_{ NONE } {}
+  virtual ~HedgeRace() = default;
+
+  // claim the race by a finished call, return false if the other call claimed it already
+  bool claim(size_t call) {
+    auto expected = NONE;
+    if (winner_.compare_exchange_strong(expected, call)) {
+      cancel_.cancel();
+      return true;
+    }
+
+    return expected == call;
+  }
+
+  inline bool decided() const noexcept {
+    return winner_.load() != NONE;
+  }
+
+  inline bool won(size_t call) const noexcept {
+    return winner_.load() == call;
+  }
+
+  // cancelled once the race is decided, a pending call listens to it to stop
+  inline Cancellation& cancellation() noexcept {
+    return cancel_;
+  }
+
+private:
+  std::atomic<size_t> winner_;
+  Cancellation cancel_;
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/**
+ * A morsel is a contiguous row range of a block, it is the smallest schedulable compute unit.
+ * Large blocks are split into multiple morsels so that they can be computed in parallel.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+struct Morsel {
+  // row range [start, end), end will be capped by number of rows in the block
+  size_t start;
+  size_t end;
+
+  inline size_t first(size_t rows) const noexcept {
+    return std::min(start, rows);
+  }
+
+  inline size_t last(size_t rows) const noexcept {
+    return std::min(end, rows);
+  }
+
+  // a morsel covering all rows of a block
+  static constexpr Morsel all() noexcept {
+    return Morsel{ 0, std::numeric_limits<size_t>::max() };
+  }
+
+  // split given number of rows into morsels with given size, size 0 means no split
+  static std::vector<Morsel> split(size_t rows, size_t size) noexcept {
+    if (size == 0 || rows <= size) {
+      return { all() };
+    }
+
+    std::vector<Morsel> morsels;
+    morsels.reserve((rows + size - 1) / size);
+    for (size_t start = 0; start < rows; start += size) {
+      morsels.push_back(Morsel{ start, std::min(rows, start + size) });
+    }
+
+    return morsels;
+  }
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
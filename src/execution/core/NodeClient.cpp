@@ -25,16 +25,25 @@ namespace execution {
 namespace core {
 
 using nebula::common::Cursor;
+using nebula::surface::EmptyRowCursor;
 using nebula::surface::RowCursorPtr;
 using nebula::surface::RowData;
 
-folly::Future<RowCursorPtr> NodeClient::execute(const PlanPtr plan) {
+folly::Future<RowCursorPtr> NodeClient::execute(const PlanPtr plan, const std::vector<nebula::meta::NNode>& peers) {
+  N_ENSURE(peers.empty(), "in-process node doesn't forward a query");
   auto p = std::make_shared<folly::Promise<RowCursorPtr>>();
 
   // start to full fill the future
-  pool_.add([plan, &pool = pool_, p]() {
+  pool_.add([plan, &pool = pool_, p, race = race_, id = call_]() {
     NodeExecutor nodeExec(BlockManager::init(), true);
-    p->setValue(nodeExec.execute(pool, plan));
+    auto result = nodeExec.execute(pool, plan);
+
+    // a hedged call losing its race gives up its result
+    if (race && !race->claim(id)) {
+      result = EmptyRowCursor::instance();
+    }
+
+    p->setValue(result);
   });
 
   return p->getFuture();
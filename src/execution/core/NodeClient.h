@@ -17,6 +17,7 @@
 #pragma once
 
 #include <glog/logging.h>
+#include "Hedge.h"
 #include "common/Folly.h"
 #include "common/Task.h"
 #include "execution/BlockManager.h"
@@ -36,7 +37,15 @@ public:
     : node_{ node }, pool_{ pool } {}
   virtual ~NodeClient() = default;
 
-  virtual folly::Future<nebula::surface::RowCursorPtr> execute(const PlanPtr plan);
+  // execute the plan on the node, and on the peers forwarded by the node if any
+  virtual folly::Future<nebula::surface::RowCursorPtr> execute(const PlanPtr plan,
+                                                               const std::vector<nebula::meta::NNode>& peers);
+
+  // make the call of this client one side of a hedged race, see Hedge.h
+  inline void hedge(std::shared_ptr<HedgeRace> race, size_t call) noexcept {
+    race_ = std::move(race);
+    call_ = call;
+  }
 
   // state is used to pull state of a node - do nothing for inproc node client
   virtual void update() {}
@@ -50,6 +59,10 @@ public:
 protected:
   nebula::meta::NNode node_;
   folly::ThreadPoolExecutor& pool_;
+
+  // hedged race this call is in if any
+  std::shared_ptr<HedgeRace> race_;
+  size_t call_ = 0;
 };
 } // namespace core
 } // namespace execution
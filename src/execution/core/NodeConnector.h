@@ -36,6 +36,17 @@ public:
   virtual std::unique_ptr<NodeClient> makeClient(const nebula::meta::NNode& node, folly::ThreadPoolExecutor& pool) {
     return std::make_unique<NodeClient>(node, pool);
   }
+
+  // nodes connected can forward a query to their peers, in-process node can't
+  virtual bool forwards() const {
+    return false;
+  }
+
+  // other nodes serving the same data as given node, a call to the node can be hedged by them.
+  // data of a node is not replicated by default.
+  virtual std::vector<nebula::meta::NNode> replicas(const nebula::meta::NNode&) const {
+    return {};
+  }
 };
 } // namespace core
 } // namespace execution
@@ -18,9 +18,14 @@
 
 #include <gflags/gflags.h>
 
+#include "Admission.h"
 #include "AggregationMerge.h"
 #include "BlockExecutor.h"
+#include "SharedScan.h"
 #include "TopSort.h"
+#include "TopThreshold.h"
+#include "common/Evidence.h"
+#include "common/Numa.h"
 #include "execution/meta/TableService.h"
 #include "surface/eval/UDF.h"
 
@@ -34,6 +39,25 @@ DEFINE_uint64(NODE_TIMEOUT,
               30000,
               "maximum time nebula can torelate for each query in miliseconds");
 
+DEFINE_uint64(MORSEL_ROWS,
+              65536,
+              "Blocks larger than this are split into row range morsels computed in parallel for aggregation queries."
+              "Each morsel produces a partial aggregation result merged at node level, 0 disables the split.");
+
+DEFINE_uint64(QUERY_MEMORY_MB,
+              8192,
+              "Maximum memory in MB of aggregation results a query can hold on a node, 0 means no limit."
+              "A query beyond the limit is cancelled and fails rather than running the node out of memory.");
+
+DEFINE_bool(STREAM_MERGE,
+            true,
+            "Merge each block aggregation result as soon as it completes instead of waiting for all blocks.");
+
+DEFINE_bool(SHARED_SCAN,
+            true,
+            "Queries computing the same morsel of a block at the same priority join the block scan waiting in the pool,"
+            "so that the morsel is read once for all of them while it stays in cache.");
+
 /**
  * Nebula runtime / online meta data.
  */
@@ -41,6 +65,9 @@ namespace nebula {
 namespace execution {
 namespace core {
 
+using nebula::execution::Cancellation;
+using nebula::execution::ComputeTime;
+using nebula::execution::MemoryBudget;
 using nebula::execution::meta::TableService;
 using nebula::memory::Batch;
 using nebula::surface::EmptyRowCursor;
@@ -50,69 +77,255 @@ using nebula::surface::eval::BlockEval;
 // set 10 seconds for now as max time to complete a query
 static const auto NODE_TIMEOUT = std::chrono::milliseconds(FLAGS_NODE_TIMEOUT);
 
+// pools of block computes for every NUMA node, threads of a pool are pinned to cpus of its node
+// with the same priorities as the node pool
+static folly::ThreadPoolExecutor& numaPool(size_t node) {
+  static const auto pools = []() {
+    auto& numa = nebula::common::Numa::singleton();
+    std::vector<std::unique_ptr<folly::CPUThreadPoolExecutor>> list;
+    for (size_t i = 0; i < numa.nodes(); ++i) {
+      list.push_back(std::make_unique<folly::CPUThreadPoolExecutor>(numa.cpus(i).size(), 3));
+    }
+
+    return list;
+  }();
+
+  return *pools.at(node);
+}
+
 // distribute the compute task into a promise
-folly::Future<RowCursorPtr> dist(
+// on a NUMA machine, a block is computed by the pool of the node its memory is placed on
+// the task holds the plan and the blocks of the query, so it can outlive the query given up by timeout
+// the compute joins a scan of the same morsel waiting in the pool if any, see SharedScans
+static folly::Future<RowCursorPtr> dist(
   folly::ThreadPoolExecutor& pool,
+  const PlanPtr& plan,
+  const std::shared_ptr<const FilteredBlocks>& blocks,
   const nebula::memory::EvaledBlock& block,
-  const BlockPhase& phase) {
+  const Morsel& morsel,
+  const std::shared_ptr<RowQuota>& quota,
+  int8_t priority) {
   auto p = std::make_shared<folly::Promise<RowCursorPtr>>();
-  pool.addWithPriority(
-    [&block, &phase, p]() {
-      // compute phase on block and return the result
-      p->setValue(nebula::execution::core::compute(block, phase));
-    },
-    folly::Executor::HI_PRI);
+  auto& numa = nebula::common::Numa::singleton();
+  const auto node = numa.enabled() ? static_cast<int>(block.first->numa()) : nebula::common::Numa::ANY;
+  auto& executor = node == nebula::common::Numa::ANY ? pool : numaPool(node);
+  auto run = [plan, blocks, &block, morsel, p, quota]() {
+    // a task of a cancelled query doesn't start at all, neither does a task of a sample query having enough rows
+    const auto& ctx = plan->ctx();
+    const auto& cancel = ctx.cancellation();
+    if (cancel->poll() || (quota && quota->full())) {
+      p->setValue(EmptyRowCursor::instance());
+      return;
+    }
+
+    // compute phase on the morsel of block and return the result
+    p->setTry(folly::makeTryWith([&]() {
+      return nebula::execution::core::compute(block,
+                                              plan->fetch<PhaseType::COMPUTE>(),
+                                              morsel,
+                                              cancel.get(),
+                                              ctx.memory().get(),
+                                              quota.get(),
+                                              ctx.computeTime().get());
+    }));
+  };
+
+  // a thread of a node pool is pinned by its first task
+  auto pin = [node]() {
+    static thread_local bool pinned = false;
+    if (node != nebula::common::Numa::ANY && !pinned) {
+      nebula::common::Numa::singleton().pin(node);
+      pinned = true;
+    }
+  };
+
+  if (!FLAGS_SHARED_SCAN) {
+    executor.addWithPriority(
+      [pin, run = std::move(run)]() {
+        pin();
+        run();
+      },
+      priority);
+    return p->getFuture();
+  }
+
+  // the first query of a morsel schedules the scan, the ones joining before it starts are computed by it too
+  auto& scans = SharedScans::singleton();
+  const ScanKey key{ block.first.get(), morsel.start, morsel.end, priority };
+  if (!scans.join(key, std::move(run))) {
+    executor.addWithPriority(
+      [pin, key, &scans]() {
+        pin();
+        for (auto& run : scans.take(key)) {
+          run();
+        }
+      },
+      priority);
+  }
 
   return p->getFuture();
 }
 
-/**
- * Execute a plan on a node level.
- * 
- * TODO(cao) - 
- * This will fanout to multiple blocks in a executor pool before return.
- * So the interfaces will be changed as async interfaces using future and promise.
- */
-RowCursorPtr NodeExecutor::execute(folly::ThreadPoolExecutor& pool, const PlanPtr plan) {
+// the node result selected from merged results of all blocks
+static RowCursorPtr finalize(const PlanPtr& plan, RowCursorPtr merged, bool single, bool local) {
+  auto& stats = plan->ctx().stats();
+  const auto& time = plan->ctx().computeTime();
+  stats.profile.filterUs += time->filterUs();
+  stats.profile.aggregateUs += time->aggregateUs();
+
+  // server ranks top groups exactly by rounds, every round asks for a subset of the result
+  const NodePhase& phase = plan->fetch<PhaseType::PARTIAL>();
+  const auto& round = plan->getTopRound();
+  if (round.step != TopRound::Step::NONE) {
+    return TopThreshold(phase.outputSchema(), phase.fields(), phase.sorts().front()).select(merged, round, phase.top());
+  }
+
+  if (single) {
+    return merged;
+  }
+
+  // if scale is 0 or this query has no limit on it
+  if (local || FLAGS_TOP_SORT_SCALE == 0 || phase.top() == 0) {
+    return merged;
+  }
+
+  return topSort<>(merged, phase, FLAGS_TOP_SORT_SCALE);
+}
+
+// a single block result is the node result as is, unless the block passed rows through without aggregation
+static bool aggregated(const RowCursorPtr& result) {
+  auto block = std::dynamic_pointer_cast<BlockExecutor>(result);
+  return block == nullptr || !block->bypassed();
+}
+
+// compute all blocks of an admitted query, the future completes with the node result
+static folly::Future<RowCursorPtr> scan(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr& plan,
+  const std::shared_ptr<const FilteredBlocks>& blocks,
+  int8_t poolPriority,
+  bool local) {
   const BlockPhase& blockPhase = plan->fetch<PhaseType::COMPUTE>();
-  // query total number of blocks to  executor on and
-  // launch block executor on each in parallel
-  // TODO(cao): this table service instance potentially can be carried by a query context on each node
-  auto ts = TableService::singleton();
-  const FilteredBlocks blocks = blockManager_->query(*ts->query(blockPhase.table()).table(), plan, pool);
+  const auto& cancel = plan->ctx().cancellation();
+  const auto& memory = plan->ctx().memory();
+
+  // unsorted samples take any N rows, so all blocks share one quota of N rows
+  const auto top = blockPhase.top();
+  const auto samples = !blockPhase.hasAggregation() && !blockPhase.hasScript() && blockPhase.sorts().empty();
+  const auto quota = samples && top > 0 && top < std::numeric_limits<size_t>::max()
+                       ? std::make_shared<RowQuota>(top)
+                       : nullptr;
 
-  LOG(INFO) << "Processing total blocks: " << blocks.size();
   std::vector<folly::Future<RowCursorPtr>> results;
   auto& stats = plan->ctx().stats();
-  results.reserve(blocks.size());
-  std::transform(blocks.begin(), blocks.end(), std::back_inserter(results),
-                 [&blockPhase, &pool, &stats](const auto& block) {
-                   // increment the stats counter
-                   stats.blocksScan += 1;
-                   stats.rowsScan += block.first->getRows();
-                   return dist(pool, block, blockPhase);
-                 });
-
-  // compile the results into a single row cursor
-  auto x = folly::collectAll(results).get(NODE_TIMEOUT);
+  results.reserve(blocks->size());
 
-  // single response optimization
-  if (x.size() == 1) {
-    return x.at(0).value();
+  // large blocks are split into morsels for aggregation queries so that a few huge blocks
+  // can still keep all cores busy, partial results of morsels are merged as separate blocks.
+  const auto morselRows = blockPhase.hasAggregation() ? FLAGS_MORSEL_ROWS : 0;
+  for (const auto& block : *blocks) {
+    // increment the stats counter
+    const auto rows = block.first->getRows();
+    stats.blocksScan += 1;
+    stats.rowsScan += rows;
+    for (const auto& morsel : Morsel::split(rows, morselRows)) {
+      results.push_back(dist(pool, plan, blocks, block, morsel, quota, poolPriority));
+    }
   }
 
   // depends on the query plan, if there is no aggregation
   // the results set from different block exeuction can be simply composite together
   // but the query needs to aggregate on keys, then we have to merge the results based on partial aggregatin plan
   const NodePhase& phase = plan->fetch<PhaseType::PARTIAL>();
-  auto merged = merge(pool, phase.outputSchema(), phase.fields(), phase.hasAggregation(), x);
+  const auto single = results.size() == 1;
+  auto finish = [plan, single, local](RowCursorPtr merged) {
+    return finalize(plan, std::move(merged), single, local);
+  };
 
-  // if scale is 0 or this query has no limit on it
-  if (local_ || FLAGS_TOP_SORT_SCALE == 0 || phase.top() == 0) {
-    return merged;
+  if (FLAGS_STREAM_MERGE && phase.hasAggregation() && !single) {
+    // fold every block result as soon as it completes, overlapping merge with block compute
+    // a streaming merge overlaps block computes, its time is counted from the start of computes
+    nebula::common::Evidence::Duration tick;
+    return merge(pool, phase.outputSchema(), phase.fields(), std::move(results), NODE_TIMEOUT, cancel, memory)
+      .thenValue([plan, tick](RowCursorPtr merged) {
+        plan->ctx().stats().profile.nodeMergeUs += tick.elapsedUs();
+        return merged;
+      })
+      .thenValue(std::move(finish));
   }
 
-  return topSort<>(merged, phase, FLAGS_TOP_SORT_SCALE);
+  // compile the results into a single row cursor
+  return folly::collectAll(results)
+    .within(NODE_TIMEOUT)
+    .via(&pool)
+    .thenTry([&pool, plan, cancel, single](folly::Try<std::vector<folly::Try<RowCursorPtr>>>&& t) {
+      // stop all running tasks of this query
+      if (t.hasException()) {
+        cancel->cancel();
+      }
+
+      auto x = std::move(t).value();
+      nebula::common::Evidence::Duration tick;
+      const NodePhase& phase = plan->fetch<PhaseType::PARTIAL>();
+
+      // single response optimization
+      auto merged = single && aggregated(x.at(0).value())
+                      ? x.at(0).value()
+                      : merge(pool, phase.outputSchema(), phase.fields(), phase.hasAggregation(), x);
+      plan->ctx().stats().profile.nodeMergeUs += tick.elapsedUs();
+      return merged;
+    })
+    .thenValue(std::move(finish));
+}
+
+/**
+ * Execute a plan on a node level.
+ * It fans out to block computes in the executor pool, the query is never waited for by any thread:
+ * admission, block results and merge are chained as futures, and every step runs on the thread completing the last.
+ */
+folly::Future<RowCursorPtr> NodeExecutor::executeAsync(folly::ThreadPoolExecutor& pool, const PlanPtr plan) {
+  const BlockPhase& blockPhase = plan->fetch<PhaseType::COMPUTE>();
+  // query total number of blocks to  executor on and
+  // launch block executor on each in parallel
+  // TODO(cao): this table service instance potentially can be carried by a query context on each node
+  auto ts = TableService::singleton();
+  auto blocks = std::make_shared<const FilteredBlocks>(
+    blockManager_->query(*ts->query(blockPhase.table()).table(), plan, pool));
+
+  // the query is given up on this node when node timeout passes before its own deadline
+  const auto& cancel = plan->ctx().cancellation();
+  const auto deadline = Cancellation::now() + FLAGS_NODE_TIMEOUT;
+  if (cancel->deadline() == 0 || cancel->deadline() > deadline) {
+    cancel->deadline(deadline);
+  }
+
+  const auto& memory = plan->ctx().memory();
+  if (memory->limit() == 0) {
+    memory->limit(FLAGS_QUERY_MEMORY_MB << 20);
+  }
+
+  // admission by estimated cost of the query, so that a huge scan doesn't line up before cheap queries
+  size_t cost = 0;
+  for (const auto& block : *blocks) {
+    cost += block.first->getRows();
+  }
+
+  LOG(INFO) << "Processing total blocks: " << blocks->size() << ", rows: " << cost;
+  const auto priority = Admission::classify(cost);
+  const auto local = local_;
+  return Admission::singleton()
+    .admitAsync(priority, plan->ctx().user())
+    .within(std::chrono::milliseconds(cancel->remaining()))
+    .via(&pool)
+    .thenValue([&pool, plan, blocks, priority, local](std::unique_ptr<Admission::Ticket> ticket) {
+      // the slot is held until the query result is ready
+      return scan(pool, plan, blocks, Admission::poolPriority(priority), local)
+        .thenValue([ticket = std::move(ticket)](RowCursorPtr result) { return result; });
+    });
+}
+
+RowCursorPtr NodeExecutor::execute(folly::ThreadPoolExecutor& pool, const PlanPtr plan) {
+  return executeAsync(pool, plan).get();
 }
 
 } // namespace core
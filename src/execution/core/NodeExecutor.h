@@ -38,8 +38,12 @@ public:
     : blockManager_{ blockManager }, local_{ local } {}
 
 public:
+  // execute the plan and wait for its result
   nebula::surface::RowCursorPtr execute(folly::ThreadPoolExecutor&, const PlanPtr);
 
+  // execute the plan without blocking, the future completes with the node result
+  folly::Future<nebula::surface::RowCursorPtr> executeAsync(folly::ThreadPoolExecutor&, const PlanPtr);
+
 private:
   const std::shared_ptr<BlockManager> blockManager_;
 
@@ -16,7 +16,12 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "ComputedRow.h"
+#include "Morsel.h"
+#include "SortKey.h"
+#include "TopHeap.h"
 #include "common/Cursor.h"
 #include "execution/ExecutionPlan.h"
 #include "memory/Batch.h"
@@ -27,32 +32,117 @@ namespace nebula {
 namespace execution {
 namespace core {
 
-static std::shared_ptr<nebula::surface::eval::ScriptData> makeScriptData(const BlockPhase& plan) noexcept {
-  if (plan.hasScript()) {
-    return std::make_shared<nebula::surface::eval::ScriptData>(plan.inputSchema(), plan.customs());
+// rows wanted by an unsorted sample query on a node, shared by all its block tasks.
+// any N rows make a correct answer, so tasks stop, or don't start, once N rows are collected in total.
+class RowQuota {
+public:
+  explicit RowQuota(size_t limit) : limit_{ limit }, rows_{ 0 } {}
+  virtual ~RowQuota() = default;
+
+  inline bool full() const noexcept {
+    return rows_.load(std::memory_order_relaxed) >= limit_;
   }
 
-  return {};
-}
+  inline void add(size_t rows) noexcept {
+    rows_.fetch_add(rows, std::memory_order_relaxed);
+  }
+
+  inline size_t rows() const noexcept {
+    return rows_.load(std::memory_order_relaxed);
+  }
+
+private:
+  const size_t limit_;
+  std::atomic<size_t> rows_;
+};
 
 class ReferenceRows : public nebula::surface::RowCursor {
 public:
-  explicit ReferenceRows(const BlockPhase& plan, const nebula::memory::Batch& data)
+  explicit ReferenceRows(const BlockPhase& plan,
+                         const nebula::memory::Batch& data,
+                         const Morsel& morsel = Morsel::all(),
+                         RowQuota* quota = nullptr)
     : nebula::surface::RowCursor(0),
       plan_{ plan },
-      fieldMap_{ nebula::surface::SchemaRow::name2index(plan_.outputSchema()) },
-      scriptData_{ makeScriptData(plan) },
+      fieldMap_{ plan.outputMap() },
+      scriptData_{ plan.scriptData() },
       data_{ data },
       accessor_{ data.makeAccessor() },
       ctx_{ std::make_shared<nebula::surface::eval::EvalContext>(plan.cacheEval(), scriptData_) },
       filter_{ plan.filter() },
       runtime_{ fieldMap_, plan_.fields(), ctx_ } {
-    // populate all reference rows
-    for (size_t i = 0, size = data_.getRows(); i < size; ++i) {
-      // if we have enough samples, just return
-      if (check(i) >= plan_.top()) {
+    // populate all reference rows, filter is evaluated batch by batch
+    const size_t rows = morsel.last(data_.getRows());
+    const size_t first = morsel.first(rows);
+    const size_t top = plan_.top();
+    const nebula::surface::eval::Seeker seeker = [this](size_t row) -> const nebula::surface::Accessor& {
+      return accessor_->seek(row);
+    };
+
+    // sorted samples are the top N rows by sort columns of all matched rows rather than the first N
+    if (hasTop(plan_)) {
+      const auto& sorts = plan_.sorts();
+      const auto sort = sorts.front();
+      const auto desc = plan_.isDesc();
+      switch (sorts.size() > 1 ? nebula::type::Kind::INVALID : plan_.outputSchema()->childType(sort)->k()) {
+#define TOP_ROWS_CASE(K, T, F)                                      \
+  case nebula::type::Kind::K: {                                     \
+    topRows<T>(first, rows, desc, seeker, [sort](const auto& row) { \
+      return T(row.F(sort));                                        \
+    });                                                             \
+    return;                                                         \
+  }
+
+        TOP_ROWS_CASE(BOOLEAN, bool, readBool)
+        TOP_ROWS_CASE(TINYINT, int8_t, readByte)
+        TOP_ROWS_CASE(SMALLINT, int16_t, readShort)
+        TOP_ROWS_CASE(INTEGER, int32_t, readInt)
+        TOP_ROWS_CASE(BIGINT, int64_t, readLong)
+        TOP_ROWS_CASE(REAL, float, readFloat)
+        TOP_ROWS_CASE(DOUBLE, double, readDouble)
+        // computed strings don't outlive the current row
+        TOP_ROWS_CASE(VARCHAR, std::string, readString)
+
+#undef TOP_ROWS_CASE
+      default: {
+        // multiple sort columns are ranked by normalized keys
+        auto key = sorts.size() > 1 ? SortKey::make(plan_) : nullptr;
+        if (key) {
+          topRows<std::string>(first, rows, false, seeker, [&key](const auto& row) {
+            return key->encode(row);
+          });
+          return;
+        }
+      }
+      }
+    }
+
+    nebula::surface::eval::Selection selection{ std::min(rows - first, BATCH) };
+    for (size_t start = first; start < rows && size_ < top; start += BATCH) {
+      // other blocks of the query have collected enough rows
+      if (quota && quota->full()) {
         break;
       }
+
+      const auto before = size_;
+      selection.reset(start, std::min(rows, start + BATCH));
+
+      // if not fullfil the condition
+      // ignore valid here - if system can't determine how to act on NULL value
+      // we don't know how to make decision here too
+      filter_.select(*ctx_, data_, seeker, selection);
+
+      // if we have enough samples, just return
+      for (auto i : selection) {
+        rows_.push_back(i);
+        if (++size_ >= top) {
+          break;
+        }
+      }
+
+      if (quota) {
+        quota->add(size_ - before);
+      }
     }
   }
 
@@ -77,23 +167,31 @@ public:
   }
 
 private:
-  size_t check(size_t index) {
-    ctx_->reset(accessor_->seek(index));
-
-    // if not fullfil the condition
-    // ignore valid here - if system can't determine how to act on NULL value
-    // we don't know how to make decision here too
-    if (!filter_.eval<bool>(*ctx_).value_or(false)) {
-      return size_;
+  // scan all matched rows in [first, last) and keep the top N of them by the sort key
+  template <typename T, typename R>
+  void topRows(size_t first, size_t last, bool desc, const nebula::surface::eval::Seeker& seeker, R read) {
+    TopHeap<T> heap(plan_.top(), desc);
+    nebula::surface::eval::Selection selection{ std::min(last - first, BATCH) };
+    for (size_t start = first; start < last; start += BATCH) {
+      selection.reset(start, std::min(last, start + BATCH));
+      filter_.select(*ctx_, data_, seeker, selection);
+      for (auto i : selection) {
+        ctx_->reset(accessor_->seek(i));
+        heap.add(read(runtime_), i);
+      }
     }
 
-    rows_.push_back(index);
-    return ++size_;
+    rows_ = heap.rows();
+    size_ = rows_.size();
   }
 
+private:
+  // number of rows evaluated by filter as one batch
+  static constexpr size_t BATCH = 1024;
+
 private:
   const BlockPhase& plan_;
-  const nebula::surface::Name2Index fieldMap_;
+  const nebula::surface::Name2Index& fieldMap_;
   const std::shared_ptr<nebula::surface::eval::ScriptData> scriptData_;
   const nebula::memory::Batch& data_;
   std::unique_ptr<nebula::memory::RowAccessor> accessor_;
@@ -0,0 +1,361 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Rolling.h"
+
+#include <algorithm>
+
+#include "common/Hash.h"
+#include "surface/SchemaRow.h"
+
+/**
+ * Window functions over timeline results.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+using nebula::common::Hasher;
+using nebula::surface::IndexType;
+using nebula::surface::Name2Index;
+using nebula::surface::RowCursor;
+using nebula::surface::RowCursorPtr;
+using nebula::surface::RowData;
+using nebula::surface::SchemaRow;
+using nebula::type::Kind;
+
+// rolled values of all rows, a row has a slot for every rolling column
+class RollingValues {
+public:
+  RollingValues(size_t columns, const std::vector<Rolling>& rollings, size_t rows)
+    : slots_(columns, -1), width_{ rollings.size() }, values_(rows * width_, 0), valid_(rows * width_, false) {
+    for (size_t i = 0; i < width_; ++i) {
+      slots_.at(rollings.at(i).field) = i;
+    }
+  }
+
+  // slot of a column, negative if it is not rolled
+  inline int32_t slot(IndexType column) const noexcept {
+    return slots_[column];
+  }
+
+  inline bool valid(size_t row, size_t slot) const noexcept {
+    return valid_[row * width_ + slot];
+  }
+
+  inline double value(size_t row, size_t slot) const noexcept {
+    return values_[row * width_ + slot];
+  }
+
+  inline void set(size_t row, size_t slot, double value) noexcept {
+    values_[row * width_ + slot] = value;
+    valid_[row * width_ + slot] = true;
+  }
+
+private:
+  std::vector<int32_t> slots_;
+  size_t width_;
+  std::vector<double> values_;
+  std::vector<bool> valid_;
+};
+
+// a row of the input with rolled columns replaced
+class RollingRow : public SchemaRow {
+public:
+  RollingRow(const Name2Index& fieldMap, const RollingValues& values)
+    : SchemaRow(fieldMap), values_{ values }, index_{ 0 } {}
+  RollingRow(const Name2Index& fieldMap, const RollingValues& values, std::unique_ptr<RowData> inner, size_t index)
+    : SchemaRow(fieldMap), values_{ values }, inner_{ std::move(inner) }, index_{ index } {}
+  virtual ~RollingRow() = default;
+
+public:
+  inline bool isNull(IndexType i) const override {
+    const auto slot = values_.slot(i);
+    return slot < 0 ? inner_->isNull(i) : !values_.valid(index_, slot);
+  }
+
+  double readDouble(IndexType i) const override {
+    const auto slot = values_.slot(i);
+    return slot < 0 ? inner_->readDouble(i) : values_.value(index_, slot);
+  }
+
+#define FORWARD_READ(T, F)          \
+  T F(IndexType i) const override { \
+    return inner_->F(i);            \
+  }
+
+  FORWARD_READ(bool, readBool)
+  FORWARD_READ(int8_t, readByte)
+  FORWARD_READ(int16_t, readShort)
+  FORWARD_READ(int32_t, readInt)
+  FORWARD_READ(int64_t, readLong)
+  FORWARD_READ(float, readFloat)
+  FORWARD_READ(int128_t, readInt128)
+  FORWARD_READ(std::string_view, readString)
+  FORWARD_READ(std::unique_ptr<nebula::surface::ListData>, readList)
+  FORWARD_READ(std::unique_ptr<nebula::surface::MapData>, readMap)
+
+#undef FORWARD_READ
+
+public:
+  inline void set(std::unique_ptr<RowData> inner, size_t index) {
+    inner_ = std::move(inner);
+    index_ = index;
+  }
+
+private:
+  const RollingValues& values_;
+  std::unique_ptr<RowData> inner_;
+  size_t index_;
+};
+
+class RollingCursor : public RowCursor {
+public:
+  RollingCursor(RowCursorPtr inner, const Name2Index& fieldMap, std::unique_ptr<RollingValues> values)
+    : RowCursor(inner->size()),
+      inner_{ std::move(inner) },
+      fieldMap_{ fieldMap },
+      values_{ std::move(values) },
+      row_{ fieldMap_, *values_ } {}
+  virtual ~RollingCursor() = default;
+
+  virtual const RowData& next() override {
+    const auto index = index_++;
+    row_.set(inner_->item(index), index);
+    return row_;
+  }
+
+  virtual std::unique_ptr<RowData> item(size_t index) const override {
+    return std::make_unique<RollingRow>(fieldMap_, *values_, inner_->item(index), index);
+  }
+
+private:
+  RowCursorPtr inner_;
+  const Name2Index& fieldMap_;
+  std::unique_ptr<RollingValues> values_;
+  RollingRow row_;
+};
+
+// numeric value of a column, false if it is null or not a number
+static bool number(const RowData& row, size_t i, Kind kind, double& value) {
+  if (row.isNull(i)) {
+    return false;
+  }
+
+  switch (kind) {
+#define NUMBER_CASE(K, F)                  \
+  case Kind::K: {                          \
+    value = static_cast<double>(row.F(i)); \
+    return true;                           \
+  }
+
+    NUMBER_CASE(TINYINT, readByte)
+    NUMBER_CASE(SMALLINT, readShort)
+    NUMBER_CASE(INTEGER, readInt)
+    NUMBER_CASE(BIGINT, readLong)
+    NUMBER_CASE(REAL, readFloat)
+    NUMBER_CASE(DOUBLE, readDouble)
+
+#undef NUMBER_CASE
+  default:
+    return false;
+  }
+}
+
+// hash of all key columns of a row but the time bucket
+static size_t series(const RowData& row, const std::vector<std::pair<size_t, Kind>>& keys) {
+  size_t hash = 0;
+  for (const auto& k : keys) {
+    const auto i = k.first;
+    size_t h = 0;
+    if (!row.isNull(i)) {
+      switch (k.second) {
+#define HASH_KEY_CASE(KIND, FUNC)      \
+  case Kind::KIND: {                   \
+    const auto v = row.FUNC(i);        \
+    h = Hasher::hash64(&v, sizeof(v)); \
+    break;                             \
+  }
+
+        HASH_KEY_CASE(BOOLEAN, readBool)
+        HASH_KEY_CASE(TINYINT, readByte)
+        HASH_KEY_CASE(SMALLINT, readShort)
+        HASH_KEY_CASE(INTEGER, readInt)
+        HASH_KEY_CASE(BIGINT, readLong)
+        HASH_KEY_CASE(REAL, readFloat)
+        HASH_KEY_CASE(DOUBLE, readDouble)
+        HASH_KEY_CASE(INT128, readInt128)
+
+#undef HASH_KEY_CASE
+      case Kind::VARCHAR: {
+        h = Hasher::hashString(row.readString(i));
+        break;
+      }
+      default: break;
+      }
+    }
+
+    hash ^= h + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  }
+
+  return hash;
+}
+
+// a row in a series at a time bucket
+struct Point {
+  size_t series;
+  int64_t time;
+  size_t row;
+};
+
+// evaluate a window function on points of one series in time order, raw values are indexed by row
+static void roll(const Rolling& rolling,
+                 int64_t window,
+                 const Point* begin,
+                 const Point* end,
+                 size_t slot,
+                 const std::vector<double>& raw,
+                 const std::vector<bool>& has,
+                 size_t width,
+                 RollingValues& values) {
+  const auto at = [&raw, width, slot](const Point& p) { return raw[p.row * width + slot]; };
+  const auto present = [&has, width, slot](const Point& p) { return has[p.row * width + slot]; };
+
+  switch (rolling.type) {
+  case Rolling::Type::CUMSUM: {
+    double sum = 0;
+    for (auto p = begin; p != end; ++p) {
+      if (present(*p)) {
+        sum += at(*p);
+      }
+
+      values.set(p->row, slot, sum);
+    }
+    break;
+  }
+  case Rolling::Type::RATE: {
+    const Point* prev = nullptr;
+    for (auto p = begin; p != end; ++p) {
+      if (!present(*p)) {
+        continue;
+      }
+
+      if (prev != nullptr && p->time > prev->time) {
+        values.set(p->row, slot, (at(*p) - at(*prev)) / (p->time - prev->time));
+      }
+
+      prev = p;
+    }
+    break;
+  }
+  case Rolling::Type::MOVING_AVG: {
+    // buckets in (time - span, time] are averaged, a window of 0 (single bucket) keeps every point alone
+    const auto span = static_cast<int64_t>(std::max<size_t>(rolling.points, 1)) * std::max<int64_t>(window, 1);
+    double sum = 0;
+    size_t count = 0;
+    auto first = begin;
+    for (auto p = begin; p != end; ++p) {
+      if (present(*p)) {
+        sum += at(*p);
+        ++count;
+      }
+
+      for (; first->time <= p->time - span; ++first) {
+        if (present(*first)) {
+          sum -= at(*first);
+          --count;
+        }
+      }
+
+      if (count > 0) {
+        values.set(p->row, slot, sum / count);
+      }
+    }
+    break;
+  }
+  }
+}
+
+RowCursorPtr rolling(
+  RowCursorPtr input, const Name2Index& fieldMap, const FinalPhase& phase, const Rollings& rollings) {
+  if (rollings.empty() || input->size() == 0) {
+    return input;
+  }
+
+  // a series is identified by keys other than the time bucket
+  const auto schema = phase.outputSchema();
+  const auto& fields = phase.fields();
+  const auto& bucket = rollings.bucket;
+  std::vector<std::pair<size_t, Kind>> keys;
+  for (size_t i = 0, size = fields.size(); i < size; ++i) {
+    if (!fields.at(i)->isAggregate() && !(bucket.window > 0 && i == bucket.field)) {
+      keys.emplace_back(i, schema->childType(i)->k());
+    }
+  }
+
+  const auto& columns = rollings.columns;
+  std::vector<Kind> kinds;
+  kinds.reserve(columns.size());
+  for (const auto& c : columns) {
+    kinds.push_back(schema->childType(c.field)->k());
+  }
+
+  // read raw values of every row once
+  const auto rows = input->size();
+  const auto width = columns.size();
+  const auto timeKind = schema->childType(bucket.field)->k();
+  std::vector<Point> points;
+  points.reserve(rows);
+  std::vector<double> raw(rows * width, 0);
+  std::vector<bool> has(rows * width, false);
+  for (size_t r = 0; input->hasNext(); ++r) {
+    const auto& row = input->next();
+    double time = 0;
+    if (bucket.window > 0) {
+      number(row, bucket.field, timeKind, time);
+    }
+
+    points.push_back({ series(row, keys), static_cast<int64_t>(time), r });
+    for (size_t c = 0; c < width; ++c) {
+      has[r * width + c] = number(row, columns[c].field, kinds[c], raw[r * width + c]);
+    }
+  }
+
+  std::sort(points.begin(), points.end(), [](const Point& left, const Point& right) {
+    return left.series < right.series || (left.series == right.series && left.time < right.time);
+  });
+
+  auto values = std::make_unique<RollingValues>(schema->size(), columns, rows);
+  const auto last = points.data() + points.size();
+  for (auto begin = points.data(); begin != last;) {
+    auto end = begin;
+    while (end != last && end->series == begin->series) {
+      ++end;
+    }
+
+    for (size_t c = 0; c < width; ++c) {
+      roll(columns[c], bucket.window, begin, end, c, raw, has, width, *values);
+    }
+
+    begin = end;
+  }
+
+  return std::make_shared<RollingCursor>(input, fieldMap, std::move(values));
+}
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "execution/ExecutionPlan.h"
+#include "surface/DataSurface.h"
+
+/**
+ * Window functions over timeline results evaluated by server (moving average, rate of change, cumulative sum).
+ * A timeline result has a row per series and time bucket, a series is all rows of the same keys but the bucket.
+ * Rows are ordered by (series, bucket) once, every window function walks each series in time order and
+ * replaces its metric column by a DOUBLE value, so clients get the series they display instead of raw buckets.
+ *
+ * Buckets without any row are absent, so moving average covers the buckets in the last N windows of time
+ * rather than the last N rows, and rate is the change since the previous present bucket per second.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+// evaluate window functions on a finalized result, the same cursor if there is none.
+// the returned cursor keeps order of the input rows, and supports random access.
+nebula::surface::RowCursorPtr rolling(
+  nebula::surface::RowCursorPtr, const nebula::surface::Name2Index&, const FinalPhase&, const Rollings&);
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
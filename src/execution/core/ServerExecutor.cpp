@@ -15,10 +15,19 @@
  */
 
 #include "ServerExecutor.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
 #include "AggregationMerge.h"
 #include "Finalize.h"
+#include "Hedge.h"
 #include "NodeConnector.h"
+#include "Rolling.h"
 #include "TopSort.h"
+#include "TopThreshold.h"
+#include "common/Evidence.h"
 #include "common/Folly.h"
 #include "surface/eval/UDF.h"
 
@@ -27,6 +36,28 @@ DEFINE_uint64(RPC_TIMEOUT,
               35000,
               "maximum time nebula can torelate for each query in miliseconds");
 
+DEFINE_bool(TOP_THRESHOLD,
+            true,
+            "Rank top groups of a query sorted by count descending exactly by threshold rounds with nodes,"
+            "which ships only candidate groups rather than all groups of every node.");
+
+DEFINE_uint64(AGG_FANIN,
+              0,
+              "Maximum number of nodes a server or a node merges results from directly, 0 means no limit."
+              "Beyond it nodes are grouped, and the first node of a group forwards the query to the others"
+              "and merges their results, so that merge cost is spread over a tree of nodes.");
+
+DEFINE_uint32(HEDGE_PERCENTILE,
+              95,
+              "Send a duplicate call to a replica of a node when the node hasn't responded after this percentile"
+              "of recent node latencies, the first one to finish is taken. 0 disables hedged calls.");
+DEFINE_uint32(HEDGE_MIN_SAMPLES, 100, "Minimum number of recent node latencies before any call is hedged.");
+
+DEFINE_uint64(PROGRESS_INTERVAL_MS,
+              1000,
+              "Minimum interval in milliseconds between two early results of a progressive query,"
+              "every early result merges all node results received so far.");
+
 /**
  * Nebula runtime / online meta data.
  */
@@ -34,56 +65,428 @@ namespace nebula {
 namespace execution {
 namespace core {
 
+using nebula::common::Evidence;
+using nebula::execution::Cancellation;
 using nebula::meta::NNode;
 using nebula::surface::EmptyRowCursor;
+using nebula::surface::RowCursor;
 using nebula::surface::RowCursorPtr;
+using nebula::surface::RowData;
 using nebula::surface::SchemaRow;
 
 // set 10 seconds for now as max time to complete a query
 static const auto RPC_TIMEOUT = std::chrono::milliseconds(FLAGS_RPC_TIMEOUT);
 
-RowCursorPtr ServerExecutor::execute(
+// interval to check cancellation of a query while waiting for nodes
+static constexpr auto CANCEL_POLL = std::chrono::milliseconds(100);
+
+// latencies of recent node calls to decide when a call is hedged
+static LatencyTracker& latencies() {
+  static LatencyTracker LATENCIES;
+  return LATENCIES;
+}
+
+// a call to the node, whose latency is recorded if it succeeds
+static folly::Future<RowCursorPtr> call(
   folly::ThreadPoolExecutor& pool,
-  const PlanPtr plan,
-  const std::shared_ptr<NodeConnector> connector) {
+  const PlanPtr& plan,
+  const std::shared_ptr<NodeConnector>& connector,
+  const NNode& node,
+  const std::vector<NNode>& peers,
+  const std::shared_ptr<HedgeRace>& race = {},
+  size_t id = 0) {
+  auto c = connector->makeClient(node, pool);
+  if (race) {
+    c->hedge(race, id);
+  }
+
+  const auto start = Cancellation::now();
+  return c->execute(plan, peers).thenValue([start](RowCursorPtr&& x) {
+    latencies().record(Cancellation::now() - start);
+    return std::move(x);
+  });
+}
+
+// call the node, and its replica as well if the node doesn't respond after the hedge delay.
+// the result of the call finishing first is taken, and the failure of the last one if both fail.
+static folly::Future<RowCursorPtr> hedge(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr& plan,
+  const std::shared_ptr<NodeConnector>& connector,
+  const NNode& node,
+  const NNode& replica,
+  std::chrono::milliseconds delay) {
+  auto race = std::make_shared<HedgeRace>();
+  auto p = std::make_shared<folly::Promise<RowCursorPtr>>();
+  auto pending = std::make_shared<std::atomic<size_t>>(2);
+  auto done = [p, race, pending](size_t id, folly::Try<RowCursorPtr>&& x) {
+    if (x.hasValue() && race->won(id)) {
+      p->setValue(std::move(x.value()));
+    }
+
+    if (pending->fetch_sub(1) == 1 && !p->isFulfilled()) {
+      p->setTry(std::move(x));
+    }
+  };
+
+  call(pool, plan, connector, node, {}, race, 0).thenTry([done](folly::Try<RowCursorPtr>&& x) {
+    done(0, std::move(x));
+  });
+
+  folly::futures::sleep(delay)
+    .via(&pool)
+    .thenValue([&pool, plan, connector, replica, race](auto&&) -> folly::Future<RowCursorPtr> {
+      // no need to hedge once the node responded or the query is over
+      if (race->decided() || plan->ctx().cancellation()->cancelled()) {
+        return folly::makeFuture<RowCursorPtr>(EmptyRowCursor::instance());
+      }
+
+      VLOG(1) << "Hedge a node call by replica: " << replica.toString();
+      return call(pool, plan, connector, replica, {}, race, 1);
+    })
+    .thenTry([done](folly::Try<RowCursorPtr>&& x) {
+      done(1, std::move(x));
+    });
+
+  return p->getFuture();
+}
+
+std::vector<folly::Future<RowCursorPtr>> dispatch(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr& plan,
+  const std::shared_ptr<NodeConnector>& connector,
+  const std::vector<NNode>& all) {
+  // a node in this process shares memory with the caller, its result is taken as it is without serialization.
+  // so it is called on its own, it can't forward to peers and there is no replica to hedge it.
+  std::vector<NNode> nodes;
+  nodes.reserve(all.size());
   std::vector<folly::Future<RowCursorPtr>> results;
-  for (const NNode& node : plan->getNodes()) {
-    auto c = connector->makeClient(node, pool);
-    auto f = c->execute(plan)
-               // set time out handling
-               // TODO(cao) - add error handling too via thenError
-               .onTimeout(RPC_TIMEOUT, [&]() -> RowCursorPtr { 
-                 LOG(WARNING) << "RPC Timeout: " << FLAGS_RPC_TIMEOUT;
-                 return EmptyRowCursor::instance(); });
-
-    results.push_back(std::move(f));
+  for (const auto& node : all) {
+    if (node.isInProc()) {
+      results.push_back(call(pool, plan, connector, node, {}).within(RPC_TIMEOUT));
+      continue;
+    }
+
+    nodes.push_back(node);
+  }
+
+  // nodes are split into at most fan-in groups of consecutive nodes when the connector's nodes can forward
+  const auto size = nodes.size();
+  const auto fanin = connector->forwards() ? FLAGS_AGG_FANIN : 0;
+  const auto group = fanin == 0 || size <= fanin ? 1 : (size + fanin - 1) / fanin;
+
+  // a node having replicas is hedged after a high percentile of recent latencies, unless there are too few
+  const auto delay = FLAGS_HEDGE_PERCENTILE == 0
+                       ? 0
+                       : latencies().percentile(FLAGS_HEDGE_PERCENTILE, FLAGS_HEDGE_MIN_SAMPLES);
+
+  results.reserve(results.size() + (size + group - 1) / group);
+  for (size_t i = 0; i < size; i += group) {
+    const auto& node = nodes.at(i);
+    const auto end = std::min(size, i + group);
+    std::vector<NNode> peers(nodes.begin() + i + 1, nodes.begin() + end);
+
+    // a node not responding in time fails with timeout
+    // a node forwarding to peers is not hedged since its replica may not reach the same peers
+    const auto replicas = delay > 0 && peers.empty() ? connector->replicas(node) : std::vector<NNode>{};
+    auto result = replicas.empty()
+                    ? call(pool, plan, connector, node, peers)
+                    : hedge(pool, plan, connector, node, replicas.front(), std::chrono::milliseconds(delay));
+    results.push_back(std::move(result).within(RPC_TIMEOUT));
+  }
+
+  return results;
+}
+
+void countFailures(const std::vector<folly::Try<RowCursorPtr>>& results, QueryStats& stats) {
+  for (const auto& r : results) {
+    if (r.hasException()) {
+      if (r.exception().is_compatible_with<folly::FutureTimeout>()) {
+        ++stats.nodesTimeout;
+      } else {
+        ++stats.nodesFailed;
+      }
+
+      LOG(WARNING) << "Node result missing: " << r.exception().what();
+    }
   }
+}
+
+// send the plan to all nodes, the future completes when all of them respond or fail
+static folly::Future<std::vector<folly::Try<RowCursorPtr>>> fanout(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr& plan,
+  const std::shared_ptr<NodeConnector>& connector) {
+  return folly::collectAll(dispatch(pool, plan, connector, plan->getNodes()))
+    .via(&pool)
+    .thenValue([plan](std::vector<folly::Try<RowCursorPtr>>&& x) {
+      countFailures(x, plan->ctx().stats());
+      return std::move(x);
+    });
+}
+
+// rank top groups exactly by three rounds of threshold algorithm, see TopThreshold.h
+// every round is chained to the results of previous one, the future completes with
+// partial results of all candidate groups of all nodes
+static folly::Future<std::vector<folly::Try<RowCursorPtr>>> threshold(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr& plan,
+  const std::shared_ptr<NodeConnector>& connector) {
+  const auto& phase = plan->fetch<PhaseType::GLOBAL>();
+  auto top = std::make_shared<TopThreshold>(phase.inputSchema(), phase.fields(), phase.sorts().front());
+  const auto n = phase.top();
+  const double nodes = plan->getNodes().size();
+
+  // N-th largest partial sum of all groups in given results, 0 if there are less than N groups.
+  // partial sums and number of results having every group are kept in given maps
+  using Sums = nebula::common::unordered_map<size_t, double>;
+  using Seen = nebula::common::unordered_map<size_t, size_t>;
+  auto nth = [top, n](const std::vector<folly::Try<RowCursorPtr>>& x, Sums& sums, Seen& seen) -> double {
+    for (const auto& r : x) {
+      if (r.hasValue()) {
+        auto& rows = *r.value();
+        while (rows.hasNext()) {
+          const auto& row = rows.next();
+          const auto key = top->key(row);
+          sums[key] += top->score(row);
+          seen[key] += 1;
+        }
+      }
+    }
+
+    if (sums.size() < n) {
+      return 0;
+    }
+
+    std::vector<double> values;
+    values.reserve(sums.size());
+    for (const auto& item : sums) {
+      values.push_back(item.second);
+    }
 
-  // collect all returns and turn it into a future
-  auto x = folly::collectAll(results).get();
+    std::nth_element(values.begin(), values.begin() + n - 1, values.end(), std::greater<>());
+    return values.at(n - 1);
+  };
 
+  // partial sums of local top N groups
+  plan->setTopRound({ TopRound::Step::TOP, 0, {} });
+  return fanout(pool, plan, connector)
+    .thenValue([&pool, plan, connector, nth, nodes](std::vector<folly::Try<RowCursorPtr>>&& x) {
+      // all groups counting at least tau / M on a node
+      Sums sums;
+      Seen seen;
+      const auto bar = nth(x, sums, seen) / nodes;
+      plan->setTopRound({ TopRound::Step::THRESHOLD, bar, {} });
+      return fanout(pool, plan, connector);
+    })
+    .thenValue([&pool, plan, connector, nth, nodes, n](std::vector<folly::Try<RowCursorPtr>>&& x) {
+      // a group less than N-th lower bound even counting up to the threshold on every other node is pruned
+      Sums sums;
+      Seen seen;
+      const auto bar = plan->getTopRound().threshold;
+      const auto lower = nth(x, sums, seen);
+      TopRound round{ TopRound::Step::KEYS, 0, {} };
+      for (const auto& item : sums) {
+        if (item.second + (nodes - seen[item.first]) * bar >= lower) {
+          round.keys.insert(item.first);
+        }
+      }
+
+      VLOG(1) << "Top " << n << " threshold: " << bar << ", candidates: " << round.keys.size() << " of " << sums.size();
+      plan->setTopRound(std::move(round));
+      return fanout(pool, plan, connector);
+    })
+    .thenValue([plan](std::vector<folly::Try<RowCursorPtr>>&& x) {
+      plan->setTopRound({});
+      return std::move(x);
+    });
+}
+
+// merge results of all nodes into the final result
+static RowCursorPtr gather(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr& plan,
+  const std::vector<folly::Try<RowCursorPtr>>& x) {
   // only one result - don't need any aggregation or composite
   const auto& phase = plan->fetch<PhaseType::GLOBAL>();
   const auto& fieldMap = phase.fieldMap();
+  auto& stats = plan->ctx().stats();
+
+  // all node stats are collected, sampled COUNT and SUM are scaled up by all matched rows
+  const auto scale = stats.scale();
   if (x.size() == 1) {
     const auto& op = x.at(0);
     if (op.hasException() || !op.hasValue()) {
       return EmptyRowCursor::instance();
     }
 
-    return topSort(finalize(op.value(), fieldMap, phase), phase);
+    Evidence::Duration tick;
+    auto rolled = rolling(finalize(op.value(), fieldMap, phase, scale, &pool), fieldMap, phase, plan->getRollings());
+    auto sorted = topSort(rolled, phase);
+    stats.profile.finalizeUs += tick.elapsedUs();
+    return sorted;
   }
 
   // multiple results using input schema as output schema used by finalize only
+  Evidence::Duration tick;
   auto result = merge(pool, phase.inputSchema(), phase.fields(), phase.hasAggregation(), x);
+  stats.profile.serverMergeUs += tick.elapsedUs();
 
   // result holds the final total rows in the query before applying limit
   auto resultSize = result->size();
-  auto& stats = plan->ctx().stats();
   stats.rowsRet = resultSize;
 
-  // apply sorting and limit if available
-  return topSort(finalize(result, fieldMap, phase), phase);
+  // apply window functions, sorting and limit if available
+  tick.reset();
+  auto rolled = rolling(finalize(result, fieldMap, phase, scale, &pool), fieldMap, phase, plan->getRollings());
+  auto sorted = topSort(rolled, phase);
+  stats.profile.finalizeUs += tick.elapsedUs();
+  return sorted;
+}
+
+// nodes give up the query by its deadline, no later than the RPC timeout
+static void bound(const PlanPtr& plan) {
+  auto& cancel = *plan->ctx().cancellation();
+  const auto deadline = Cancellation::now() + FLAGS_RPC_TIMEOUT;
+  if (cancel.deadline() == 0 || cancel.deadline() > deadline) {
+    cancel.deadline(deadline);
+  }
+}
+
+// read rows of a cursor by random access, so that the cursor is not consumed and can be read again
+class ReplayCursor : public RowCursor {
+public:
+  explicit ReplayCursor(RowCursorPtr inner) : RowCursor(inner->size()), inner_{ std::move(inner) } {}
+  virtual ~ReplayCursor() = default;
+
+  virtual const RowData& next() override {
+    row_ = inner_->item(index_++);
+    return *row_;
+  }
+
+  virtual std::unique_ptr<RowData> item(size_t index) const override {
+    return inner_->item(index);
+  }
+
+private:
+  RowCursorPtr inner_;
+  std::unique_ptr<RowData> row_;
+};
+
+// results to merge: results merged already and results received since they were merged
+static std::vector<folly::Try<RowCursorPtr>> since(
+  const RowCursorPtr& merged, const std::vector<folly::Try<RowCursorPtr>>& done, size_t from) {
+  std::vector<folly::Try<RowCursorPtr>> sources;
+  sources.reserve(done.size() - from + 1);
+  if (merged) {
+    sources.emplace_back(std::make_shared<ReplayCursor>(merged));
+  }
+
+  sources.insert(sources.end(), done.begin() + from, done.end());
+  return sources;
+}
+
+folly::Future<RowCursorPtr> ServerExecutor::executeAsync(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr plan,
+  const std::shared_ptr<NodeConnector> connector) {
+  bound(plan);
+
+  // top groups by count are fetched by threshold rounds rather than all groups of every node
+  const auto& phase = plan->fetch<PhaseType::GLOBAL>();
+  auto results = FLAGS_TOP_THRESHOLD && TopThreshold::applies(phase, plan->getNodes().size())
+                   ? threshold(pool, plan, connector)
+                   : fanout(pool, plan, connector);
+
+  return std::move(results).thenValue([&pool, plan](std::vector<folly::Try<RowCursorPtr>>&& x) {
+    return gather(pool, plan, x);
+  });
+}
+
+RowCursorPtr ServerExecutor::execute(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr plan,
+  const std::shared_ptr<NodeConnector> connector,
+  const Progress& progress) {
+  // top groups ranked by threshold rounds are known only after the last round
+  const auto& phase = plan->fetch<PhaseType::GLOBAL>();
+  if (progress && !(FLAGS_TOP_THRESHOLD && TopThreshold::applies(phase, plan->getNodes().size()))) {
+    return progressive(pool, plan, connector, progress);
+  }
+
+  // wake up periodically to check cancellation, so that calls to nodes are cancelled as soon as the query is
+  auto result = executeAsync(pool, plan, connector);
+  auto& cancel = *plan->ctx().cancellation();
+  while (!result.wait(CANCEL_POLL).isReady()) {
+    cancel.poll();
+  }
+
+  return std::move(result).get();
+}
+
+RowCursorPtr ServerExecutor::progressive(
+  folly::ThreadPoolExecutor& pool,
+  const PlanPtr& plan,
+  const std::shared_ptr<NodeConnector>& connector,
+  const Progress& progress) {
+  // completed node results, filled by pool threads and drained by current thread only
+  struct Completion {
+    std::mutex lock;
+    std::condition_variable signal;
+    std::deque<folly::Try<RowCursorPtr>> done;
+  };
+
+  bound(plan);
+  auto results = dispatch(pool, plan, connector, plan->getNodes());
+  const auto total = results.size();
+  auto completion = std::make_shared<Completion>();
+  std::vector<folly::Future<folly::Unit>> chains;
+  chains.reserve(total);
+  for (auto& result : results) {
+    chains.push_back(std::move(result).thenTry([completion](folly::Try<RowCursorPtr>&& t) {
+      {
+        std::lock_guard<std::mutex> guard(completion->lock);
+        completion->done.push_back(std::move(t));
+      }
+
+      completion->signal.notify_one();
+    }));
+  }
+
+  // every node result completes by its timeout, or earlier by failure once the query is cancelled
+  // results received before the last early result are merged and consumed already
+  const auto& phase = plan->fetch<PhaseType::GLOBAL>();
+  const auto interval = std::chrono::milliseconds(FLAGS_PROGRESS_INTERVAL_MS);
+  auto& cancel = *plan->ctx().cancellation();
+  std::vector<folly::Try<RowCursorPtr>> done;
+  done.reserve(total);
+  RowCursorPtr merged;
+  size_t folded = 0;
+  auto last = std::chrono::steady_clock::now();
+  while (done.size() < total) {
+    {
+      std::unique_lock<std::mutex> guard(completion->lock);
+      completion->signal.wait_for(guard, CANCEL_POLL, [&completion]() { return !completion->done.empty(); });
+      while (!completion->done.empty()) {
+        done.push_back(std::move(completion->done.front()));
+        completion->done.pop_front();
+      }
+    }
+
+    cancel.poll();
+
+    // the last result is not an early one
+    const auto now = std::chrono::steady_clock::now();
+    if (done.size() < total && done.size() > folded && now - last >= interval) {
+      merged = merge(pool, phase.inputSchema(), phase.fields(), phase.hasAggregation(), since(merged, done, folded));
+      folded = done.size();
+      last = now;
+      progress(gather(pool, plan, since(merged, done, folded)), folded, total);
+    }
+  }
+
+  countFailures(done, plan->ctx().stats());
+  return gather(pool, plan, since(merged, done, folded));
 }
 
 } // namespace core
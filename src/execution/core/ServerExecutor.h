@@ -38,18 +38,51 @@ class ServerExecutor {
   }
 
 public:
+  // an early result of a running query merging results of the first given number of nodes out of all
+  using Progress = std::function<void(nebula::surface::RowCursorPtr, size_t, size_t)>;
+
   ServerExecutor(const std::string& server)
     : server_{ server } {}
 
-  // execute the query plan to get a data set
+  // execute the query plan to get a data set, it blocks until the result is ready or the query is cancelled
+  // when progress is given, it is called in current thread with early results while nodes are responding,
+  // at most every PROGRESS_INTERVAL_MS. Top groups ranked by threshold rounds have no early results.
   nebula::surface::RowCursorPtr execute(folly::ThreadPoolExecutor&,
                                         const PlanPtr,
-                                        const std::shared_ptr<NodeConnector> = inproc());
+                                        const std::shared_ptr<NodeConnector> = inproc(),
+                                        const Progress& = {});
+
+  // execute the query plan without blocking the calling thread, the result is merged on the pool once all nodes
+  // respond, fail or time out. Missing nodes are counted in query stats and the result of the rest is returned.
+  // caller owns polling the query cancellation while waiting, so that calls to nodes are cancelled in time.
+  folly::Future<nebula::surface::RowCursorPtr> executeAsync(folly::ThreadPoolExecutor&,
+                                                            const PlanPtr,
+                                                            const std::shared_ptr<NodeConnector> = inproc());
+
+private:
+  nebula::surface::RowCursorPtr progressive(folly::ThreadPoolExecutor&,
+                                            const PlanPtr&,
+                                            const std::shared_ptr<NodeConnector>&,
+                                            const Progress&);
 
 private:
   const std::string server_;
 };
 
+// send the plan to given nodes and return their results, results of a node are partial results of the node phase.
+// when there are more than AGG_FANIN nodes, nodes are split into AGG_FANIN groups and the plan is sent to
+// the first node of every group, which forwards it to the rest of the group and merges their results,
+// so server merges AGG_FANIN results only and merge cost is spread over a tree of nodes.
+// a call to a node with replicas is hedged by its replica when it's slower than HEDGE_PERCENTILE of recent calls.
+// an in-process node is called on its own so that its result is taken without serialization.
+std::vector<folly::Future<nebula::surface::RowCursorPtr>> dispatch(folly::ThreadPoolExecutor&,
+                                                                   const PlanPtr&,
+                                                                   const std::shared_ptr<NodeConnector>&,
+                                                                   const std::vector<nebula::meta::NNode>&);
+
+// count results of failed or timed out nodes into given stats
+void countFailures(const std::vector<folly::Try<nebula::surface::RowCursorPtr>>&, QueryStats&);
+
 } // namespace core
 } // namespace execution
 } // namespace nebula
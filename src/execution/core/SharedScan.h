@@ -0,0 +1,106 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "common/Hash.h"
+
+/**
+ * Shared block scans of concurrent queries.
+ * Dashboards send many queries at once against the same table and time range, so they scan the same blocks.
+ * A block scan waiting in the pool is open to other queries computing the same morsel of the same block
+ * at the same priority: they join it rather than adding their own tasks. The scan computes all joined queries
+ * back to back on one thread once it starts, so the morsel is read from memory once while it stays in cache.
+ * The window to join is the time a scan waits in the pool, it is closed when the scan starts.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+struct ScanKey {
+  const void* block;
+  size_t start;
+  size_t end;
+  int8_t priority;
+
+  inline bool operator==(const ScanKey& other) const noexcept {
+    return block == other.block && start == other.start && end == other.end && priority == other.priority;
+  }
+};
+
+struct ScanKeyHash {
+  inline size_t operator()(const ScanKey& key) const noexcept {
+    size_t h = std::hash<const void*>()(key.block);
+    for (size_t v : { key.start, key.end, static_cast<size_t>(key.priority) }) {
+      h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    }
+
+    return h;
+  }
+};
+
+class SharedScans {
+public:
+  using Compute = std::function<void()>;
+
+  SharedScans() = default;
+  virtual ~SharedScans() = default;
+
+  static SharedScans& singleton() {
+    static SharedScans scans;
+    return scans;
+  }
+
+public:
+  // join the waiting scan of the key, return false if there is none and a new scan is opened with the compute,
+  // the caller is responsible to schedule a task taking it then.
+  bool join(const ScanKey& key, Compute compute) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& computes = pending_[key];
+    computes.push_back(std::move(compute));
+    return computes.size() > 1;
+  }
+
+  // close the scan of the key and take all computes joined it so far
+  std::vector<Compute> take(const ScanKey& key) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto found = pending_.find(key);
+    if (found == pending_.end()) {
+      return {};
+    }
+
+    auto computes = std::move(found->second);
+    pending_.erase(found);
+    return computes;
+  }
+
+  inline size_t pending() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return pending_.size();
+  }
+
+private:
+  mutable std::mutex mutex_;
+  nebula::common::unordered_map<ScanKey, std::vector<Compute>, ScanKeyHash> pending_;
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "surface/SchemaRow.h"
+#include "surface/eval/ValueEval.h"
+
+/**
+ * Metadata-only aggregation.
+ * When all rows of a block match the filter, aggregations like COUNT/SUM/MIN/MAX without keys
+ * (or with constant keys only) can be answered by block metadata (histograms, partition values)
+ * as a single pre-aggregated row, without reading any row of the block.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+using Sketches = std::vector<std::shared_ptr<nebula::surface::eval::Sketch>>;
+
+// sketch of every aggregate field summarized from block metadata, empty if any field can't be answered
+inline Sketches summarize(const nebula::surface::eval::Fields& fields, const nebula::surface::eval::Block& block) {
+  Sketches sketches;
+  sketches.reserve(fields.size());
+  for (const auto& f : fields) {
+    if (!f->isAggregate()) {
+      // a key varies by row unless it is a constant
+      if (f->expressionType() != nebula::surface::eval::ExpressionType::CONSTANT) {
+        return {};
+      }
+
+      sketches.push_back(nullptr);
+      continue;
+    }
+
+    auto sketch = f->summarize(block);
+    if (sketch == nullptr) {
+      return {};
+    }
+
+    sketches.push_back(std::move(sketch));
+  }
+
+  return sketches;
+}
+
+// read keys from wrapped row (constant keys need no row context) and provide pre-aggregated sketches
+// values of aggregate columns read as default, they are never merged since a sketch is present
+#define SKETCH_ROW_INDEX(T, F)                                            \
+  inline T F(IndexType i) const override {                                \
+    return sketches_[i] ? nebula::type::TypeDetect<T>::value : row_.F(i); \
+  }
+
+class SketchRow : public nebula::surface::SchemaRow {
+  using IndexType = nebula::surface::IndexType;
+
+public:
+  SketchRow(const nebula::surface::Name2Index& fieldMap, const nebula::surface::RowData& row, const Sketches& sketches)
+    : SchemaRow(fieldMap), row_{ row }, sketches_{ sketches } {}
+  virtual ~SketchRow() = default;
+
+  inline bool isNull(IndexType i) const override {
+    return sketches_[i] ? false : row_.isNull(i);
+  }
+
+  SKETCH_ROW_INDEX(bool, readBool)
+  SKETCH_ROW_INDEX(int8_t, readByte)
+  SKETCH_ROW_INDEX(int16_t, readShort)
+  SKETCH_ROW_INDEX(int32_t, readInt)
+  SKETCH_ROW_INDEX(int64_t, readLong)
+  SKETCH_ROW_INDEX(float, readFloat)
+  SKETCH_ROW_INDEX(double, readDouble)
+  SKETCH_ROW_INDEX(int128_t, readInt128)
+  SKETCH_ROW_INDEX(std::string_view, readString)
+
+  inline std::unique_ptr<nebula::surface::ListData> readList(IndexType i) const override {
+    return row_.readList(i);
+  }
+
+  inline std::unique_ptr<nebula::surface::MapData> readMap(IndexType i) const override {
+    return row_.readMap(i);
+  }
+
+  inline std::shared_ptr<nebula::surface::eval::Sketch> getAggregator(IndexType i) const override {
+    return sketches_[i];
+  }
+
+private:
+  const nebula::surface::RowData& row_;
+  const Sketches& sketches_;
+};
+
+#undef SKETCH_ROW_INDEX
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
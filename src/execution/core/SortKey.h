@@ -0,0 +1,171 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "execution/ExecutionPlan.h"
+#include "surface/DataSurface.h"
+
+/**
+ * Normalized sort key for multi-column sorting.
+ * All sort columns of a row are encoded into one byte string, so that comparing two keys by bytes (memcmp)
+ * gives the same order as comparing their columns one by one in their own orders:
+ * - integers are big endian with sign bit flipped.
+ * - floating numbers flip sign bit if positive or all bits if negative.
+ * - strings escape 0x00 as 0x00 0xFF and end with 0x00 0x00, so a prefix ranks before its extensions.
+ * - all bytes of a descending column are inverted.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+class SortKey {
+  struct Column {
+    size_t index;
+    nebula::type::Kind kind;
+    bool desc;
+  };
+
+public:
+  explicit SortKey(std::vector<Column> columns) : columns_{ std::move(columns) } {}
+  virtual ~SortKey() = default;
+
+  // sort key of given phase's sort columns, nullptr if any column type is not supported
+  template <nebula::execution::PhaseType PT>
+  static std::unique_ptr<SortKey> make(const nebula::execution::Phase<PT>& phase) {
+    const auto& sorts = phase.sorts();
+    const auto& descs = phase.descs();
+    const auto schema = phase.outputSchema();
+    std::vector<Column> columns;
+    columns.reserve(sorts.size());
+    for (size_t i = 0, size = sorts.size(); i < size; ++i) {
+      const auto kind = schema->childType(sorts.at(i))->k();
+      switch (kind) {
+      case nebula::type::Kind::BOOLEAN:
+      case nebula::type::Kind::TINYINT:
+      case nebula::type::Kind::SMALLINT:
+      case nebula::type::Kind::INTEGER:
+      case nebula::type::Kind::BIGINT:
+      case nebula::type::Kind::REAL:
+      case nebula::type::Kind::DOUBLE:
+      case nebula::type::Kind::INT128:
+      case nebula::type::Kind::VARCHAR: break;
+      default: return nullptr;
+      }
+
+      columns.push_back(Column{ sorts.at(i), kind, descs.at(i) });
+    }
+
+    return std::make_unique<SortKey>(std::move(columns));
+  }
+
+  // encode sort columns of a row into a normalized key
+  std::string encode(const nebula::surface::RowData& row) const {
+    std::string key;
+    for (const auto& c : columns_) {
+      const auto start = key.size();
+      switch (c.kind) {
+      case nebula::type::Kind::BOOLEAN: {
+        key.push_back(row.readBool(c.index) ? 1 : 0);
+        break;
+      }
+      case nebula::type::Kind::TINYINT: {
+        bigEndian<uint8_t>(key, signFlip<uint8_t>(row.readByte(c.index)));
+        break;
+      }
+      case nebula::type::Kind::SMALLINT: {
+        bigEndian<uint16_t>(key, signFlip<uint16_t>(row.readShort(c.index)));
+        break;
+      }
+      case nebula::type::Kind::INTEGER: {
+        bigEndian<uint32_t>(key, signFlip<uint32_t>(row.readInt(c.index)));
+        break;
+      }
+      case nebula::type::Kind::BIGINT: {
+        bigEndian<uint64_t>(key, signFlip<uint64_t>(row.readLong(c.index)));
+        break;
+      }
+      case nebula::type::Kind::INT128: {
+        bigEndian<uint128_t>(key, signFlip<uint128_t>(row.readInt128(c.index)));
+        break;
+      }
+      case nebula::type::Kind::REAL: {
+        bigEndian<uint32_t>(key, real<uint32_t>(row.readFloat(c.index)));
+        break;
+      }
+      case nebula::type::Kind::DOUBLE: {
+        bigEndian<uint64_t>(key, real<uint64_t>(row.readDouble(c.index)));
+        break;
+      }
+      case nebula::type::Kind::VARCHAR: {
+        for (auto ch : row.readString(c.index)) {
+          key.push_back(ch);
+          if (ch == 0) {
+            key.push_back((char)0xFF);
+          }
+        }
+
+        key.push_back(0);
+        key.push_back(0);
+        break;
+      }
+      default: break;
+      }
+
+      if (c.desc) {
+        for (size_t i = start, size = key.size(); i < size; ++i) {
+          key[i] = ~key[i];
+        }
+      }
+    }
+
+    return key;
+  }
+
+private:
+  template <typename U>
+  static inline void bigEndian(std::string& key, U value) {
+    for (size_t i = sizeof(U); i > 0; --i) {
+      key.push_back(static_cast<char>(value >> ((i - 1) * 8)));
+    }
+  }
+
+  // flip sign bit so that negative numbers rank before positive ones in unsigned order
+  template <typename U, typename T>
+  static inline U signFlip(T value) {
+    return static_cast<U>(value) ^ (U(1) << (sizeof(U) * 8 - 1));
+  }
+
+  template <typename U, typename T>
+  static inline U real(T value) {
+    static_assert(sizeof(U) == sizeof(T), "same width to hold the bits");
+    U bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    constexpr U sign = U(1) << (sizeof(U) * 8 - 1);
+    return (bits & sign) ? ~bits : (bits | sign);
+  }
+
+private:
+  std::vector<Column> columns_;
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Spill.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <gflags/gflags.h>
+
+#include "common/Evidence.h"
+
+DEFINE_string(SPILL_DIR, "", "local directory to spill aggregation results of a query merge, empty to disable");
+DEFINE_uint64(SPILL_BYTES, 1073741824,
+              "bytes of groups held by a query merge on a node to spill them to SPILL_DIR");
+DEFINE_uint64(SPILL_PARTITIONS, 16,
+              "number of key partitions of spilled groups, every partition is merged in memory at a time");
+
+/**
+ * Spill aggregation results to local disk by key partitions and merge them one partition at a time.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+namespace fs = std::filesystem;
+
+using nebula::common::Pool;
+using nebula::memory::keyed::FlatBuffer;
+using nebula::memory::keyed::HashFlat;
+using nebula::surface::RowCursor;
+using nebula::surface::RowCursorPtr;
+using nebula::surface::RowData;
+using nebula::surface::eval::Fields;
+using nebula::type::Schema;
+
+// merged groups of a spill read one partition at a time, a row read is not valid once a row of another partition is read
+class SpillCursor : public RowCursor {
+public:
+  SpillCursor(std::shared_ptr<Spill> spill, std::vector<size_t> ends)
+    : RowCursor(ends.empty() ? 0 : ends.back()),
+      spill_{ std::move(spill) },
+      ends_{ std::move(ends) },
+      partition_{ ends_.size() },
+      first_{ 0 } {}
+  virtual ~SpillCursor() = default;
+
+  virtual const RowData& next() override {
+    const auto row = locate(index_++);
+    return flat_->row(row);
+  }
+
+  virtual std::unique_ptr<RowData> item(size_t index) const override {
+    const auto row = locate(index);
+    return flat_->crow(row);
+  }
+
+private:
+  // row id in its partition, the partition is loaded in place of the current one if it's not loaded
+  size_t locate(size_t index) const {
+    if (partition_ >= ends_.size() || index < first_ || index >= ends_[partition_]) {
+      // empty partitions end at the same row as previous ones, they are skipped
+      partition_ = std::upper_bound(ends_.begin(), ends_.end(), index) - ends_.begin();
+      first_ = partition_ == 0 ? 0 : ends_[partition_ - 1];
+      flat_ = nullptr;
+      flat_ = spill_->load(partition_);
+    }
+
+    return index - first_;
+  }
+
+private:
+  std::shared_ptr<Spill> spill_;
+
+  // total rows by the end of every partition
+  std::vector<size_t> ends_;
+  mutable size_t partition_;
+  mutable size_t first_;
+  mutable std::unique_ptr<FlatBuffer> flat_;
+};
+
+// read a run at the current position of a file, null if no more runs
+static std::unique_ptr<FlatBuffer> readRun(std::ifstream& in, const Schema& schema, const Fields& fields) {
+  size_t size = 0;
+  if (!in.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+    return nullptr;
+  }
+
+  // the flat buffer owns the bytes
+  auto bytes = static_cast<NByte*>(Pool::getDefault().allocate(size));
+  if (!in.read(reinterpret_cast<char*>(bytes), size)) {
+    Pool::getDefault().free(bytes, size);
+    throw NException("Truncated spill run");
+  }
+
+  return std::make_unique<FlatBuffer>(schema, fields, bytes);
+}
+
+Spill::Spill(const Schema& schema, const Fields& fields, size_t partitions)
+  : schema_{ schema },
+    fields_{ fields },
+    partitions_{ std::max<size_t>(partitions, 1) },
+    runs_{ 0 },
+    bytes_{ 0 } {
+  static std::atomic<size_t> sequence{ 0 };
+  dir_ = fmt::format("{0}/{1}_{2}", FLAGS_SPILL_DIR, nebula::common::Evidence::unix_timestamp(), sequence++);
+  fs::create_directories(dir_);
+}
+
+Spill::~Spill() {
+  std::error_code ec;
+  fs::remove_all(dir_, ec);
+}
+
+std::shared_ptr<Spill> Spill::make(const Schema& schema, const Fields& fields) {
+  if (FLAGS_SPILL_DIR.empty()) {
+    return nullptr;
+  }
+
+  try {
+    return std::make_shared<Spill>(schema, fields, FLAGS_SPILL_PARTITIONS);
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Spill is not available: " << ex.what();
+    return nullptr;
+  }
+}
+
+size_t Spill::threshold() noexcept {
+  return FLAGS_SPILL_BYTES;
+}
+
+std::string Spill::file(size_t partition, bool merged) const {
+  return fmt::format("{0}/{1}.{2}", dir_, partition, merged ? "merged" : "runs");
+}
+
+size_t Spill::append(const std::string& file, const FlatBuffer& flat) const {
+  const auto size = flat.prepareSerde();
+  auto bytes = static_cast<NByte*>(Pool::getDefault().allocate(size));
+  const auto written = flat.serialize(bytes);
+  N_ENSURE_EQ(written, size, "serialized size should be the same as prepared");
+
+  std::ofstream out(file, std::ios::binary | std::ios::app);
+  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  out.write(reinterpret_cast<const char*>(bytes), size);
+  Pool::getDefault().free(bytes, size);
+  N_ENSURE(out.good(), "failed to write spill file");
+
+  return size + sizeof(size);
+}
+
+size_t Spill::write(std::unique_ptr<HashFlat> flat) {
+  std::vector<std::unique_ptr<FlatBuffer>> parts;
+  parts.reserve(partitions_);
+  for (size_t p = 0; p < partitions_; ++p) {
+    parts.push_back(std::make_unique<FlatBuffer>(schema_, fields_));
+  }
+
+  // partitioned buffers share sketches of the flat, so it's released before writing them
+  for (size_t i = 0, rows = flat->getRows(); i < rows; ++i) {
+    parts.at(flat->hash(i) % partitions_)->add(flat->row(i));
+  }
+
+  flat = nullptr;
+
+  size_t bytes = 0;
+  for (size_t p = 0; p < partitions_; ++p) {
+    if (parts.at(p)->getRows() > 0) {
+      bytes += append(file(p, false), *parts.at(p));
+    }
+
+    parts.at(p) = nullptr;
+  }
+
+  ++runs_;
+  bytes_ += bytes;
+  return bytes;
+}
+
+RowCursorPtr Spill::merge(std::shared_ptr<Spill> spill) {
+  const auto& schema = spill->schema_;
+  const auto& fields = spill->fields_;
+  std::vector<size_t> ends;
+  ends.reserve(spill->partitions_);
+  size_t total = 0;
+  for (size_t p = 0; p < spill->partitions_; ++p) {
+    // runs of a partition are merged into its final groups and saved as one run for reading
+    auto runs = spill->file(p, false);
+    auto hf = std::make_unique<HashFlat>(schema, fields);
+    {
+      std::ifstream in(runs, std::ios::binary);
+      while (auto run = readRun(in, schema, fields)) {
+        hf->merge(std::move(run));
+      }
+    }
+
+    std::error_code ec;
+    fs::remove(runs, ec);
+    if (hf->getRows() > 0) {
+      spill->append(spill->file(p, true), *hf);
+    }
+
+    total += hf->getRows();
+    ends.push_back(total);
+  }
+
+  LOG(INFO) << fmt::format("Merged spilled groups: {0} of runs: {1} in bytes: {2}", total, spill->runs_, spill->bytes_);
+  return std::make_shared<SpillCursor>(std::move(spill), std::move(ends));
+}
+
+std::unique_ptr<FlatBuffer> Spill::load(size_t partition) const {
+  std::ifstream in(file(partition, true), std::ios::binary);
+  auto flat = readRun(in, schema_, fields_);
+  N_ENSURE_NOT_NULL(flat, "merged partition of spill not found");
+  return flat;
+}
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
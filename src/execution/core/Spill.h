@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "memory/keyed/HashFlat.h"
+#include "surface/DataSurface.h"
+#include "surface/eval/ValueEval.h"
+#include "type/Type.h"
+
+/**
+ * Spill aggregation results of a query to local disk when they take too much memory.
+ * Groups are hash partitioned by their keys and appended to one file per partition as runs of serialized flat buffers.
+ * Partitions are merged from their runs one at a time, and the merged groups are read back one partition at a time,
+ * so that memory holds groups of one partition only rather than all groups of the query.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+class Spill {
+public:
+  Spill(const nebula::type::Schema&, const nebula::surface::eval::Fields&, size_t partitions);
+  virtual ~Spill();
+
+  // spill all groups of a hash flat into runs of their partitions, the flat is consumed, return bytes written
+  size_t write(std::unique_ptr<nebula::memory::keyed::HashFlat>);
+
+  // merge runs of every partition into its final groups, return a cursor reading them partition by partition.
+  // the cursor owns the spill, files are removed when it's released.
+  static nebula::surface::RowCursorPtr merge(std::shared_ptr<Spill>);
+
+  // merged groups of a partition
+  std::unique_ptr<nebula::memory::keyed::FlatBuffer> load(size_t partition) const;
+
+  inline size_t runs() const noexcept {
+    return runs_;
+  }
+
+  inline size_t bytes() const noexcept {
+    return bytes_;
+  }
+
+  // a spill of one merge if spill is enabled by a local directory, otherwise null
+  static std::shared_ptr<Spill> make(const nebula::type::Schema&, const nebula::surface::eval::Fields&);
+
+  // groups of a merge to spill once they take more bytes than this
+  static size_t threshold() noexcept;
+
+private:
+  std::string file(size_t, bool) const;
+
+  // append a flat buffer to a file as a run, return bytes written
+  size_t append(const std::string&, const nebula::memory::keyed::FlatBuffer&) const;
+
+private:
+  const nebula::type::Schema schema_;
+  const nebula::surface::eval::Fields& fields_;
+  const size_t partitions_;
+  std::string dir_;
+  size_t runs_;
+  size_t bytes_;
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TopHeap.h"
+
+#include <functional>
+
+#include "SortKey.h"
+
+/**
+ * Nebula runtime / online meta data.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+using nebula::memory::keyed::HashFlat;
+using nebula::surface::RowData;
+using nebula::type::Kind;
+
+// rows of the flat whose key ranks at or before the N-th key in sorting order
+template <typename T, typename R>
+static std::vector<size_t> rank(HashFlat& flat, size_t top, bool desc, R read) {
+  const auto rows = flat.getRows();
+  std::vector<T> keys;
+  keys.reserve(rows);
+  for (size_t i = 0; i < rows; ++i) {
+    keys.push_back(read(flat.row(i)));
+  }
+
+  // find the N-th key without sorting all keys
+  auto values = keys;
+  auto nth = values.begin() + (top - 1);
+  if (desc) {
+    std::nth_element(values.begin(), nth, values.end(), std::greater<T>());
+  } else {
+    std::nth_element(values.begin(), nth, values.end(), std::less<T>());
+  }
+
+  const T threshold = *nth;
+  std::vector<size_t> keep;
+  keep.reserve(top);
+  for (size_t i = 0; i < rows; ++i) {
+    if (desc ? keys[i] >= threshold : keys[i] <= threshold) {
+      keep.push_back(i);
+    }
+  }
+
+  return keep;
+}
+
+std::unique_ptr<HashFlat> topGroups(std::unique_ptr<HashFlat> flat, const BlockPhase& plan) {
+  const auto top = plan.top();
+  if (!hasTop(plan) || flat->getRows() <= top) {
+    return flat;
+  }
+
+  const auto& sorts = plan.sorts();
+  for (auto sort : sorts) {
+    if (plan.fields().at(sort)->isAggregate()) {
+      return flat;
+    }
+  }
+
+  // multiple sort columns are ranked by normalized keys
+  const auto col = sorts.front();
+  const auto desc = plan.isDesc();
+  std::vector<size_t> keep;
+  switch (sorts.size() > 1 ? Kind::INVALID : plan.outputSchema()->childType(col)->k()) {
+#define TOP_GROUPS_CASE(K, T, F)                                 \
+  case Kind::K: {                                                \
+    keep = rank<T>(*flat, top, desc, [col](const RowData& row) { \
+      return row.F(col);                                         \
+    });                                                          \
+    break;                                                       \
+  }
+
+    TOP_GROUPS_CASE(BOOLEAN, bool, readBool)
+    TOP_GROUPS_CASE(TINYINT, int8_t, readByte)
+    TOP_GROUPS_CASE(SMALLINT, int16_t, readShort)
+    TOP_GROUPS_CASE(INTEGER, int32_t, readInt)
+    TOP_GROUPS_CASE(BIGINT, int64_t, readLong)
+    TOP_GROUPS_CASE(REAL, float, readFloat)
+    TOP_GROUPS_CASE(DOUBLE, double, readDouble)
+    // strings are stable in the flat
+    TOP_GROUPS_CASE(VARCHAR, std::string_view, readString)
+
+#undef TOP_GROUPS_CASE
+  default: {
+    auto key = sorts.size() > 1 ? SortKey::make(plan) : nullptr;
+    if (!key) {
+      return flat;
+    }
+
+    keep = rank<std::string>(*flat, top, false, [&key](const RowData& row) {
+      return key->encode(row);
+    });
+  }
+  }
+
+  // move kept groups into a new flat, their aggregation states are carried over as sketches
+  auto result = std::make_unique<HashFlat>(plan.outputSchema(), plan.fields());
+  for (auto i : keep) {
+    result->update(flat->row(i));
+  }
+
+  return result;
+}
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
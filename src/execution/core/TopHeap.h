@@ -0,0 +1,102 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "execution/ExecutionPlan.h"
+#include "memory/keyed/HashFlat.h"
+
+/**
+ * Top N pushdown into block compute.
+ * When a query sorts and limits its result, a block only needs to produce rows which may end up in the final top N.
+ * Raw rows (samples) are selected by a bounded heap of (sort key, row) while scanning the block.
+ * Aggregated groups are pruned only when all sort columns are keys: a group out of the top N keys of a block
+ * can't be in the final top N, while partial aggregates of an aggregate column can't be ranked at block level.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+// the phase sorts and limits its result
+inline bool hasTop(const nebula::execution::BlockPhase& plan) {
+  const auto top = plan.top();
+  return !plan.sorts().empty() && top > 0 && top != std::numeric_limits<size_t>::max();
+}
+
+// bounded heap keeping the best N (key, row) pairs, its root is the worst pair kept
+template <typename T>
+class TopHeap {
+  using Entry = std::pair<T, size_t>;
+
+  // heap ordered by "ranks before", so its root is the one ranking last
+  struct Before {
+    bool desc;
+    inline bool operator()(const Entry& left, const Entry& right) const {
+      return desc ? left.first > right.first : left.first < right.first;
+    }
+  };
+
+public:
+  TopHeap(size_t max, bool desc) : max_{ max }, before_{ desc } {}
+  virtual ~TopHeap() = default;
+
+  inline void add(T key, size_t row) {
+    if (heap_.size() < max_) {
+      heap_.emplace_back(std::move(key), row);
+      std::push_heap(heap_.begin(), heap_.end(), before_);
+      return;
+    }
+
+    // replace the root if the new key ranks before it
+    const auto& root = heap_.front().first;
+    if (before_.desc ? key > root : key < root) {
+      std::pop_heap(heap_.begin(), heap_.end(), before_);
+      heap_.back() = Entry(std::move(key), row);
+      std::push_heap(heap_.begin(), heap_.end(), before_);
+    }
+  }
+
+  // rows kept in sorting order, the heap is consumed
+  std::vector<size_t> rows() {
+    std::sort_heap(heap_.begin(), heap_.end(), before_);
+    std::vector<size_t> rows;
+    rows.reserve(heap_.size());
+    for (const auto& e : heap_) {
+      rows.push_back(e.second);
+    }
+
+    heap_.clear();
+    return rows;
+  }
+
+private:
+  size_t max_;
+  Before before_;
+  std::vector<Entry> heap_;
+};
+
+// keep groups of the flat whose sort key (key columns only) ranks in top N, all groups tied with the N-th key are kept
+// so that no group is cut partially between blocks. Return the same flat if nothing to prune.
+std::unique_ptr<nebula::memory::keyed::HashFlat> topGroups(
+  std::unique_ptr<nebula::memory::keyed::HashFlat>, const nebula::execution::BlockPhase&);
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -16,6 +16,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <vector>
+
+#include "SortKey.h"
 #include "execution/ExecutionPlan.h"
 #include "surface/DataSurface.h"
 #include "surface/TopRows.h"
@@ -27,6 +31,36 @@ namespace nebula {
 namespace execution {
 namespace core {
 
+// extract sort key of every row once into (key, row) pairs, keys are compared in a contiguous typed array.
+// rows of top N keys are selected by nth_element and only the top N are sorted.
+template <typename T, typename R>
+std::vector<size_t> topOrder(nebula::surface::RowCursor& input, size_t top, bool desc, R read) {
+  std::vector<std::pair<T, size_t>> keys;
+  keys.reserve(input.size());
+  for (size_t i = 0; input.hasNext(); ++i) {
+    keys.emplace_back(read(input.next()), i);
+  }
+
+  auto before = [desc](const std::pair<T, size_t>& left, const std::pair<T, size_t>& right) {
+    return desc ? left.first > right.first : left.first < right.first;
+  };
+
+  const auto n = top == 0 ? keys.size() : std::min(top, keys.size());
+  const auto nth = keys.begin() + n;
+  if (n < keys.size()) {
+    std::nth_element(keys.begin(), nth, keys.end(), before);
+  }
+
+  std::sort(keys.begin(), nth, before);
+  std::vector<size_t> order;
+  order.reserve(n);
+  for (auto it = keys.begin(); it != nth; ++it) {
+    order.push_back(it->second);
+  }
+
+  return order;
+}
+
 // SCALE is used to enlarge the final set in result, by default return whatever asked
 template <nebula::execution::PhaseType PT>
 nebula::surface::RowCursorPtr topSort(
@@ -40,51 +74,49 @@ nebula::surface::RowCursorPtr topSort(
 
   // do the aggregation from all different nodes
   // sort and top of results
-  auto schema = phase.outputSchema();
-  std::function<bool(const std::unique_ptr<nebula::surface::RowData>& left,
-                     const std::unique_ptr<nebula::surface::RowData>& right)>
-    less = nullptr;
+  const auto top = phase.top() * scale;
   const auto& sorts = phase.sorts();
-  if (sorts.size() > 0) {
-    N_ENSURE(sorts.size() == 1, "support single sorting column for now");
-    const auto& col = schema->childType(sorts[0]);
-    const auto kind = col->k();
-    const auto& name = col->name();
+  if (sorts.size() > 1) {
+    // multiple sort columns are compared as one normalized key by bytes
+    auto key = SortKey::make(phase);
+    if (key) {
+      return std::make_shared<nebula::surface::TopRows>(
+        input, topOrder<std::string>(*input, top, false, [&key](const nebula::surface::RowData& row) {
+          return key->encode(row);
+        }));
+    }
+  } else if (sorts.size() == 1) {
+    const auto index = sorts[0];
+    const auto kind = phase.outputSchema()->childType(index)->k();
+    const auto desc = phase.isDesc();
 
+// sort column is read by index, strings are copied as computed rows may not keep them
 // instead of assert, we torelate column not found for sorting
-#define LESS_KIND_CASE(K, F, OP)                                             \
-  case nebula::type::Kind::K: {                                              \
-    less = [&name](const std::unique_ptr<nebula::surface::RowData>& left,    \
-                   const std::unique_ptr<nebula::surface::RowData>& right) { \
-      return left->F(name) OP right->F(name);                                \
-    };                                                                       \
-    break;                                                                   \
-  }
-#define LESS_SWITCH_DESC(OP)                \
-  switch (kind) {                           \
-    LESS_KIND_CASE(BOOLEAN, readBool, OP)   \
-    LESS_KIND_CASE(TINYINT, readByte, OP)   \
-    LESS_KIND_CASE(SMALLINT, readShort, OP) \
-    LESS_KIND_CASE(INTEGER, readInt, OP)    \
-    LESS_KIND_CASE(BIGINT, readLong, OP)    \
-    LESS_KIND_CASE(REAL, readFloat, OP)     \
-    LESS_KIND_CASE(DOUBLE, readDouble, OP)  \
-    LESS_KIND_CASE(VARCHAR, readString, OP) \
-  default:                                  \
-    less = nullptr;                         \
+#define ORDER_KIND_CASE(K, T, F)                                                           \
+  case nebula::type::Kind::K: {                                                            \
+    return std::make_shared<nebula::surface::TopRows>(                                     \
+      input, topOrder<T>(*input, top, desc, [index](const nebula::surface::RowData& row) { \
+        return T(row.F(index));                                                            \
+      }));                                                                                 \
   }
 
-    if (phase.isDesc()) {
-      LESS_SWITCH_DESC(<)
-    } else {
-      LESS_SWITCH_DESC(>)
+    switch (kind) {
+      ORDER_KIND_CASE(BOOLEAN, bool, readBool)
+      ORDER_KIND_CASE(TINYINT, int8_t, readByte)
+      ORDER_KIND_CASE(SMALLINT, int16_t, readShort)
+      ORDER_KIND_CASE(INTEGER, int32_t, readInt)
+      ORDER_KIND_CASE(BIGINT, int64_t, readLong)
+      ORDER_KIND_CASE(REAL, float, readFloat)
+      ORDER_KIND_CASE(DOUBLE, double, readDouble)
+      ORDER_KIND_CASE(VARCHAR, std::string, readString)
+    default:
+      break;
     }
 
-#undef LESS_SWITCH_DESC
-#undef LESS_KIND_CASE
+#undef ORDER_KIND_CASE
   }
 
-  return std::make_shared<nebula::surface::TopRows>(input, phase.top() * scale, std::move(less));
+  return std::make_shared<nebula::surface::TopRows>(input, top);
 }
 
 } // namespace core
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TopThreshold.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+#include <limits>
+
+#include "common/Hash.h"
+#include "surface/TopRows.h"
+#include "surface/eval/Aggregator.h"
+#include "surface/eval/UDF.h"
+
+/**
+ * Exact distributed top N by threshold rounds.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+using nebula::common::Hasher;
+using nebula::surface::RowCursorPtr;
+using nebula::surface::RowData;
+using nebula::surface::TopRows;
+using nebula::surface::eval::Aggregator;
+using nebula::surface::eval::Fields;
+using nebula::type::Kind;
+using nebula::type::Schema;
+
+// finalized value of an aggregator as a number
+template <typename T>
+static double number(const T& value) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    return static_cast<double>(value);
+  } else {
+    return 0;
+  }
+}
+
+TopThreshold::TopThreshold(const Schema& schema, const Fields& fields, size_t sort) {
+  for (size_t i = 0, size = fields.size(); i < size; ++i) {
+    if (!fields.at(i)->isAggregate()) {
+      keys_.emplace_back(i, schema->childType(i)->k());
+    }
+  }
+
+  const auto& f = fields.at(sort);
+  const auto ot = f->outputType();
+  const auto it = f->inputType();
+
+#define LOGIC_BY_IO(O, I)                                                                            \
+  case Kind::I: {                                                                                    \
+    score_ = [sort](const RowData& row) -> double {                                                  \
+      auto sketch = std::static_pointer_cast<Aggregator<Kind::O, Kind::I>>(row.getAggregator(sort)); \
+      return sketch ? number(sketch->finalize()) : 0;                                                \
+    };                                                                                               \
+    break;                                                                                           \
+  }
+
+  ITERATE_BY_IO(ot, it)
+
+#undef LOGIC_BY_IO
+
+  N_ENSURE(score_ != nullptr, "sort column of threshold rounds should be aggregated");
+}
+
+bool TopThreshold::applies(const FinalPhase& phase, size_t nodes) {
+  const auto top = phase.top();
+  const auto& sorts = phase.sorts();
+  if (nodes < 2 || !phase.hasAggregation() || top == 0 || top == std::numeric_limits<size_t>::max()
+      || sorts.size() != 1 || !phase.isDesc()) {
+    return false;
+  }
+
+  // only counts are known to be non-negative, the threshold doesn't bound sums having negative values
+  const auto& fields = phase.fields();
+  const auto& sort = *fields.at(sorts.front());
+  const auto count = fmt::format("{0}(", nebula::surface::eval::UdfTraits<nebula::surface::eval::UDFType::COUNT>::Name);
+  if (!sort.isAggregate() || sort.signature().rfind(count, 0) != 0) {
+    return false;
+  }
+
+  // groups are identified by hash of scalar keys
+  const auto schema = phase.inputSchema();
+  for (size_t i = 0, size = fields.size(); i < size; ++i) {
+    if (!fields.at(i)->isAggregate() && !nebula::type::TypeBase::isScalar(schema->childType(i)->k())) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+size_t TopThreshold::key(const RowData& row) const {
+  size_t hash = 0;
+  for (const auto& k : keys_) {
+    const auto i = k.first;
+    size_t h = 0;
+    if (!row.isNull(i)) {
+      switch (k.second) {
+#define HASH_KEY_CASE(KIND, FUNC)      \
+  case Kind::KIND: {                   \
+    const auto v = row.FUNC(i);        \
+    h = Hasher::hash64(&v, sizeof(v)); \
+    break;                             \
+  }
+
+        HASH_KEY_CASE(BOOLEAN, readBool)
+        HASH_KEY_CASE(TINYINT, readByte)
+        HASH_KEY_CASE(SMALLINT, readShort)
+        HASH_KEY_CASE(INTEGER, readInt)
+        HASH_KEY_CASE(BIGINT, readLong)
+        HASH_KEY_CASE(REAL, readFloat)
+        HASH_KEY_CASE(DOUBLE, readDouble)
+        HASH_KEY_CASE(INT128, readInt128)
+
+#undef HASH_KEY_CASE
+      case Kind::VARCHAR: {
+        h = Hasher::hashString(row.readString(i));
+        break;
+      }
+      default: break;
+      }
+    }
+
+    hash ^= h + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  }
+
+  return hash;
+}
+
+RowCursorPtr TopThreshold::select(RowCursorPtr input, const TopRound& round, size_t top) const {
+  std::vector<size_t> rows;
+  switch (round.step) {
+  case TopRound::Step::TOP: {
+    // local top N by count, ties at the N-th don't matter as the threshold is a lower bound anyway
+    std::vector<std::pair<double, size_t>> scores;
+    scores.reserve(input->size());
+    for (size_t i = 0; input->hasNext(); ++i) {
+      scores.emplace_back(score(input->next()), i);
+    }
+
+    const auto n = std::min(top, scores.size());
+    std::nth_element(scores.begin(), scores.begin() + n, scores.end(), std::greater<>());
+    rows.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      rows.push_back(scores.at(i).second);
+    }
+    break;
+  }
+  case TopRound::Step::THRESHOLD: {
+    for (size_t i = 0; input->hasNext(); ++i) {
+      if (score(input->next()) >= round.threshold) {
+        rows.push_back(i);
+      }
+    }
+    break;
+  }
+  case TopRound::Step::KEYS: {
+    // a hash collision brings an extra group only, which is harmless
+    for (size_t i = 0; input->hasNext(); ++i) {
+      if (round.keys.find(key(input->next())) != round.keys.end()) {
+        rows.push_back(i);
+      }
+    }
+    break;
+  }
+  default: return input;
+  }
+
+  return std::make_shared<TopRows>(input, std::move(rows));
+}
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
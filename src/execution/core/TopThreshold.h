@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+
+#include "execution/ExecutionPlan.h"
+#include "surface/DataSurface.h"
+
+/**
+ * Exact distributed top N (three-phase uniform threshold, TPUT) for queries ranking groups by COUNT descending.
+ * Count of a group is the sum of its non-negative counts on M nodes, so server finds the exact top N in three rounds:
+ * 1. every node returns its local top N groups, the N-th largest partial sum of them (tau) is a lower bound of the
+ *    final N-th count.
+ * 2. every node returns all groups counting at least tau / M there. A group returned by no node counts less than tau
+ *    in total and can't be in top N. A group missing on a node counts less than tau / M on it, which makes an upper
+ *    bound of its count, groups whose upper bound is below the N-th largest lower bound are pruned.
+ * 3. every node returns the remaining candidate groups identified by key hash, which are merged into exact counts.
+ * Nodes ship candidate groups only, and unlike TOP_SORT_SCALE the ranking is always correct.
+ */
+namespace nebula {
+namespace execution {
+namespace core {
+
+class TopThreshold {
+public:
+  // schema and fields of node results, sort is the index of the column ranked by
+  TopThreshold(const nebula::type::Schema&, const nebula::surface::eval::Fields&, size_t sort);
+  virtual ~TopThreshold() = default;
+
+  // the query can be ranked exactly by threshold rounds over given number of nodes
+  static bool applies(const FinalPhase&, size_t nodes);
+
+  // hash of all key columns of a row
+  size_t key(const nebula::surface::RowData&) const;
+
+  // value of the sort column of a row having partial aggregates
+  inline double score(const nebula::surface::RowData& row) const {
+    return score_(row);
+  }
+
+  // rows of a node result wanted by the round
+  nebula::surface::RowCursorPtr select(nebula::surface::RowCursorPtr, const TopRound&, size_t top) const;
+
+private:
+  std::vector<std::pair<size_t, nebula::type::Kind>> keys_;
+  std::function<double(const nebula::surface::RowData&)> score_;
+};
+
+} // namespace core
+} // namespace execution
+} // namespace nebula
@@ -54,9 +54,22 @@ HistVector hist(const Batch& b) {
   return hists;
 }
 
+// names of columns of given block in the order of its histograms
+std::vector<std::string> columns(const Batch& b) {
+  auto schema = b.schema();
+  std::vector<std::string> names;
+  names.reserve(schema->size());
+  for (size_t i = 0, size = schema->size(); i < size; ++i) {
+    names.push_back(schema->childType(i)->name());
+  }
+
+  return names;
+}
+
 std::shared_ptr<BatchBlock> BlockLoader::from(const BlockSignature& sign, std::shared_ptr<Batch> b) {
   N_ENSURE_NOT_NULL(b, "requires a solid batch");
-  return std::make_shared<BatchBlock>(sign, b, BlockState{ b->getRows(), b->getMemory(), hist(*b) });
+  return std::make_shared<BatchBlock>(
+    sign, b, BlockState{ b->getRows(), b->getMemory(), hist(*b), b->memory(), columns(*b) });
 }
 
 BlockList BlockLoader::load(const BlockSignature& block) {
@@ -178,7 +191,7 @@ BlockList BlockLoader::loadTestBlock(const BlockSignature& b) {
         b.end,
         b.spec },
       block,
-      BlockState{ block->getRows(), block->getRawSize(), hist(*block) }));
+      BlockState{ block->getRows(), block->getRawSize(), hist(*block), block->memory(), columns(*block) }));
   }
 
   return blocks;
@@ -0,0 +1,711 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlockSnapshot.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gflags/gflags.h>
+#include <unordered_map>
+
+#include "common/Hash.h"
+#include "storage/NFS.h"
+#include "type/Type.h"
+
+DEFINE_string(SNAPSHOT_DIR, "", "local directory to save sealed blocks for fast restart, empty to disable");
+
+/**
+ * Save blocks to local disk and restore them.
+ */
+namespace nebula {
+namespace execution {
+namespace io {
+
+namespace fs = std::filesystem;
+
+using nebula::memory::Batch;
+using nebula::memory::RowAccessor;
+using nebula::meta::BessType;
+using nebula::meta::BlockSignature;
+using nebula::meta::BlockState;
+using nebula::meta::NNode;
+using nebula::meta::TablePtr;
+using nebula::surface::ListData;
+using nebula::surface::MapData;
+using nebula::surface::RowData;
+using nebula::type::Kind;
+using nebula::type::TypeTraits;
+
+static constexpr auto EXT = ".nsnap";
+static constexpr auto TMP = ".tmp";
+static constexpr auto MANIFEST = "manifest";
+
+// write values in native layout
+class Writer {
+public:
+  explicit Writer(std::ostream& out) : out_{ out } {}
+
+  template <typename T>
+  inline void write(const T& value) {
+    out_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  inline void write(const char* data, size_t size) {
+    out_.write(data, size);
+  }
+
+  inline void write(std::string_view str) {
+    write<uint32_t>(str.size());
+    write(str.data(), str.size());
+  }
+
+private:
+  std::ostream& out_;
+};
+
+// read values from a loaded snapshot file, a truncated file fails the read
+class Reader {
+public:
+  explicit Reader(std::string_view data) : data_{ data }, pos_{ 0 } {}
+
+  template <typename T>
+  inline T read() {
+    T value;
+    std::memcpy(&value, bytes(sizeof(T)).data(), sizeof(T));
+    return value;
+  }
+
+  inline std::string_view bytes(size_t size) {
+    N_ENSURE_LE(pos_ + size, data_.size(), "snapshot is truncated");
+    auto view = data_.substr(pos_, size);
+    pos_ += size;
+    return view;
+  }
+
+  inline std::string_view read() {
+    return bytes(read<uint32_t>());
+  }
+
+  inline bool end() const noexcept {
+    return pos_ == data_.size();
+  }
+
+private:
+  std::string_view data_;
+  size_t pos_;
+};
+
+// one column of a snapshot: NULL bitmap and values of all rows
+struct Column {
+  Kind kind;
+  std::string_view nulls;
+  std::string_view values;
+  // string value of row i is in values [offsets[i], offsets[i + 1])
+  std::vector<size_t> offsets;
+
+  inline bool isNull(size_t row) const {
+    return (nulls[row / 8] >> (row % 8)) & 1;
+  }
+
+  template <typename T>
+  inline T value(size_t row) const {
+    T v;
+    std::memcpy(&v, values.data() + row * sizeof(T), sizeof(T));
+    return v;
+  }
+
+  inline std::string_view str(size_t row) const {
+    return values.substr(offsets[row], offsets[row + 1] - offsets[row]);
+  }
+};
+
+// a row of snapshot columns to add into a batch
+class SnapshotRow : public RowData {
+public:
+  SnapshotRow(const std::unordered_map<std::string, Column>& columns) : columns_{ columns }, row_{ 0 } {}
+  virtual ~SnapshotRow() = default;
+
+  inline void seek(size_t row) noexcept {
+    row_ = row;
+  }
+
+  // a column not loaded reads NULL
+  bool isNull(const std::string& field) const override {
+    auto found = columns_.find(field);
+    return found == columns_.end() || found->second.isNull(row_);
+  }
+
+#define READ_VALUE(TYPE, FUNC)                         \
+  TYPE FUNC(const std::string& field) const override { \
+    return columns_.at(field).value<TYPE>(row_);       \
+  }
+
+  READ_VALUE(bool, readBool)
+  READ_VALUE(int8_t, readByte)
+  READ_VALUE(int16_t, readShort)
+  READ_VALUE(int32_t, readInt)
+  READ_VALUE(int64_t, readLong)
+  READ_VALUE(float, readFloat)
+  READ_VALUE(double, readDouble)
+  READ_VALUE(int128_t, readInt128)
+
+#undef READ_VALUE
+
+  std::string_view readString(const std::string& field) const override {
+    return columns_.at(field).str(row_);
+  }
+
+  std::unique_ptr<ListData> readList(const std::string&) const override {
+    throw NException("Compound types are not in snapshot");
+  }
+
+  std::unique_ptr<MapData> readMap(const std::string&) const override {
+    throw NException("Compound types are not in snapshot");
+  }
+
+private:
+  const std::unordered_map<std::string, Column>& columns_;
+  size_t row_;
+};
+
+// bytes of a fixed-width value
+static size_t width(Kind kind) {
+  switch (kind) {
+#define WIDTH_KIND(KIND) \
+  case Kind::KIND: return sizeof(TypeTraits<Kind::KIND>::CppType);
+
+    WIDTH_KIND(BOOLEAN)
+    WIDTH_KIND(TINYINT)
+    WIDTH_KIND(SMALLINT)
+    WIDTH_KIND(INTEGER)
+    WIDTH_KIND(BIGINT)
+    WIDTH_KIND(REAL)
+    WIDTH_KIND(DOUBLE)
+    WIDTH_KIND(INT128)
+
+#undef WIDTH_KIND
+  default: throw NException(fmt::format("Not a fixed-width type: {0}", kind));
+  }
+}
+
+// write NULL bitmap of a column and its values read by given function
+template <typename T, typename R>
+static void writeColumn(Writer& writer, size_t rows, R&& read) {
+  std::vector<uint8_t> nulls((rows + 7) / 8);
+  auto mark = [&nulls](size_t row) {
+    nulls[row / 8] |= (1 << (row % 8));
+  };
+
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    std::vector<uint32_t> sizes(rows);
+    for (size_t i = 0; i < rows; ++i) {
+      auto value = read(i);
+      if (value) {
+        sizes[i] = value->size();
+      } else {
+        mark(i);
+      }
+    }
+
+    writer.write(reinterpret_cast<const char*>(nulls.data()), nulls.size());
+    writer.write(reinterpret_cast<const char*>(sizes.data()), rows * sizeof(uint32_t));
+    for (size_t i = 0; i < rows; ++i) {
+      if (sizes[i] > 0) {
+        writer.write(read(i)->data(), sizes[i]);
+      }
+    }
+  } else {
+    // bool values are written as bytes
+    std::vector<std::conditional_t<std::is_same_v<T, bool>, uint8_t, T>> values(rows);
+    for (size_t i = 0; i < rows; ++i) {
+      auto value = read(i);
+      if (value) {
+        values[i] = value.value();
+      } else {
+        mark(i);
+      }
+    }
+
+    writer.write(reinterpret_cast<const char*>(nulls.data()), nulls.size());
+    writer.write(reinterpret_cast<const char*>(values.data()), rows * sizeof(T));
+  }
+}
+
+// location of a column in a snapshot file
+struct Extent {
+  std::string name;
+  Kind kind;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// write a block into given file, return false if any column type is not supported or any column is absent
+static bool writeBlock(const BatchBlock& block, const std::string& file) {
+  const auto& batch = *block.data();
+  const auto schema = batch.schema();
+  const auto rows = batch.getRows();
+  if (!batch.complete()) {
+    return false;
+  }
+
+  for (size_t i = 0, size = schema->size(); i < size; ++i) {
+    if (nebula::type::TypeBase::isCompound(schema->childType(i)->k())) {
+      return false;
+    }
+  }
+
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  Writer writer(out);
+  writer.write(BlockSnapshot::MAGIC);
+  writer.write(BlockSnapshot::VERSION);
+
+  // columns go first, each is located by the directory at the end of file
+  std::vector<Extent> extents;
+  extents.reserve(schema->size());
+  auto accessor = batch.makeAccessor();
+  for (size_t i = 0, size = schema->size(); i < size; ++i) {
+    const auto type = schema->childType(i);
+    const auto& name = type->name();
+    const auto kind = type->k();
+    const uint64_t offset = out.tellp();
+
+    const auto index = accessor->index(name).value();
+    switch (kind) {
+#define WRITE_KIND(KIND, FUNC)                                                                  \
+  case Kind::KIND: {                                                                            \
+    writeColumn<TypeTraits<Kind::KIND>::CppType>(writer, rows, [&accessor, index](size_t row) { \
+      return accessor->seek(row).FUNC(index);                                                   \
+    });                                                                                         \
+    break;                                                                                      \
+  }
+
+      WRITE_KIND(BOOLEAN, readBool)
+      WRITE_KIND(TINYINT, readByte)
+      WRITE_KIND(SMALLINT, readShort)
+      WRITE_KIND(INTEGER, readInt)
+      WRITE_KIND(BIGINT, readLong)
+      WRITE_KIND(REAL, readFloat)
+      WRITE_KIND(DOUBLE, readDouble)
+      WRITE_KIND(INT128, readInt128)
+      WRITE_KIND(VARCHAR, readString)
+
+#undef WRITE_KIND
+    default: return false;
+    }
+
+    extents.push_back(Extent{ name, kind, offset, static_cast<uint64_t>(out.tellp()) - offset });
+  }
+
+  const uint64_t directory = out.tellp();
+  const auto& sign = block.signature();
+  writer.write(std::string_view(sign.table));
+  writer.write<uint64_t>(sign.id);
+  writer.write<uint64_t>(sign.start);
+  writer.write<uint64_t>(sign.end);
+  writer.write(std::string_view(sign.spec));
+  writer.write<uint64_t>(batch.getPid());
+  writer.write<uint64_t>(rows);
+  writer.write<uint32_t>(extents.size());
+  for (const auto& extent : extents) {
+    writer.write(std::string_view(extent.name));
+    writer.write<uint8_t>(extent.kind);
+    writer.write<uint64_t>(extent.offset);
+    writer.write<uint64_t>(extent.size);
+  }
+
+  writer.write<uint64_t>(directory);
+  out.close();
+  return out.good();
+}
+
+// parse a column of given rows from its bytes
+static Column parseColumn(Kind kind, size_t rows, std::string_view bytes) {
+  Reader reader(bytes);
+  Column column;
+  column.kind = kind;
+  column.nulls = reader.bytes((rows + 7) / 8);
+  if (kind == Kind::VARCHAR) {
+    auto sizes = reader.bytes(rows * sizeof(uint32_t));
+    column.offsets.reserve(rows + 1);
+    column.offsets.push_back(0);
+    for (size_t r = 0; r < rows; ++r) {
+      uint32_t size;
+      std::memcpy(&size, sizes.data() + r * sizeof(uint32_t), sizeof(uint32_t));
+      column.offsets.push_back(column.offsets.back() + size);
+    }
+
+    column.values = reader.bytes(column.offsets.back());
+  } else {
+    column.values = reader.bytes(rows * width(kind));
+  }
+
+  N_ENSURE(reader.end(), "unexpected bytes at the end of column");
+  return column;
+}
+
+// read a block from a snapshot file, only given columns and partition columns are read from the file
+static std::shared_ptr<BatchBlock> readBlock(std::ifstream& in,
+                                             const BlockSnapshot::TableProvider& tables,
+                                             const BlockSnapshot::Sealer& seal,
+                                             const BlockSnapshot::Columns& wanted) {
+  auto load = [&in](uint64_t offset, uint64_t size, char* buffer) {
+    in.seekg(offset);
+    in.read(buffer, size);
+    N_ENSURE_EQ(static_cast<uint64_t>(in.gcount()), size, "snapshot is truncated");
+  };
+
+  auto bytes = [&load](uint64_t offset, uint64_t size) {
+    std::string data(size, '\0');
+    load(offset, size, data.data());
+    return data;
+  };
+
+  in.seekg(0, std::ios::end);
+  const uint64_t length = in.tellg();
+  constexpr auto HEAD = 2 * sizeof(uint32_t);
+  N_ENSURE_GE(length, HEAD + sizeof(uint64_t), "snapshot is truncated");
+
+  const auto head = bytes(0, HEAD);
+  Reader header(head);
+  N_ENSURE_EQ(header.read<uint32_t>(), BlockSnapshot::MAGIC, "not a block snapshot");
+  if (header.read<uint32_t>() != BlockSnapshot::VERSION) {
+    return nullptr;
+  }
+
+  const auto footer = length - sizeof(uint64_t);
+  const auto tail = bytes(footer, sizeof(uint64_t));
+  const auto directory = Reader(tail).read<uint64_t>();
+  N_ENSURE(directory >= HEAD && directory <= footer, "bad directory offset of snapshot");
+  const auto content = bytes(directory, footer - directory);
+  Reader reader(content);
+
+  const std::string table(reader.read());
+  const auto id = reader.read<uint64_t>();
+  const auto start = reader.read<uint64_t>();
+  const auto end = reader.read<uint64_t>();
+  const std::string spec(reader.read());
+  const BlockSignature sign{ table, id, start, end, spec };
+  const auto pid = reader.read<uint64_t>();
+  const auto rows = reader.read<uint64_t>();
+  const auto numColumns = reader.read<uint32_t>();
+
+  // the table schema may have changed since the snapshot was saved
+  auto tb = tables(table);
+  if (tb == nullptr || tb->schema()->size() != numColumns) {
+    return nullptr;
+  }
+
+  // partition columns are always loaded to compute bess of every row
+  auto pod = tb->pod();
+  std::vector<Extent> extents;
+  BlockSnapshot::Columns absent;
+  uint64_t total = 0;
+  for (size_t i = 0; i < numColumns; ++i) {
+    Extent extent;
+    extent.name = reader.read();
+    extent.kind = static_cast<Kind>(reader.read<uint8_t>());
+    extent.offset = reader.read<uint64_t>();
+    extent.size = reader.read<uint64_t>();
+    auto type = tb->schema()->find(extent.name);
+    if (type == nullptr || type->k() != extent.kind) {
+      return nullptr;
+    }
+
+    N_ENSURE(extent.offset >= HEAD && extent.offset + extent.size <= directory, "bad column extent of snapshot");
+    if (wanted.empty() || wanted.find(extent.name) != wanted.end() || (pod && pod->has(extent.name))) {
+      total += extent.size;
+      extents.push_back(std::move(extent));
+    } else {
+      absent.emplace(std::move(extent.name));
+    }
+  }
+
+  N_ENSURE(reader.end(), "unexpected bytes at the end of snapshot");
+
+  // loaded columns are read into one buffer, columns are views of it
+  std::string buffer(total, '\0');
+  std::unordered_map<std::string, Column> columns;
+  uint64_t pos = 0;
+  for (const auto& extent : extents) {
+    load(extent.offset, extent.size, buffer.data() + pos);
+    columns.emplace(extent.name, parseColumn(extent.kind, rows, std::string_view(buffer).substr(pos, extent.size)));
+    pos += extent.size;
+  }
+
+  // rows are added back the same way as ingestion, bess is computed by the table pod
+  auto batch = std::make_shared<Batch>(*tb, rows, pid);
+  SnapshotRow row(columns);
+  for (size_t i = 0; i < rows; ++i) {
+    row.seek(i);
+    BessType bess = -1;
+    if (pod) {
+      N_ENSURE_EQ(pod->pod(row, bess), pid, "row out of partition");
+    }
+
+    batch->add(row, bess);
+  }
+
+  batch->setAbsent(std::move(absent));
+  seal(*batch, sign);
+  return BlockLoader::from(sign, batch);
+}
+
+// manifest of a spec: its backup location, then id, window, rows, raw size and histograms of every block
+static void writeManifest(const BlockList& blocks, const std::string& backup, const std::string& file) {
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  Writer writer(out);
+  writer.write(BlockSnapshot::MAGIC);
+  writer.write(BlockSnapshot::VERSION);
+  writer.write(std::string_view(backup));
+  writer.write<uint32_t>(std::distance(blocks.begin(), blocks.end()));
+  for (const auto& block : blocks) {
+    const auto& sign = block->signature();
+    const auto& state = block->state();
+    writer.write<uint64_t>(sign.id);
+    writer.write<uint64_t>(sign.start);
+    writer.write<uint64_t>(sign.end);
+    writer.write<uint64_t>(state.numRows);
+    writer.write<uint64_t>(state.rawSize);
+    writer.write<uint32_t>(state.histograms.size());
+    for (const auto& hist : state.histograms) {
+      writer.write(std::string_view(hist->toString()));
+    }
+  }
+}
+
+// blocks of a manifest without data, along with the backup location
+static BlockList readManifest(const std::string& file,
+                              const std::string& table,
+                              const std::string& spec,
+                              std::string& backup) {
+  std::ifstream in(file, std::ios::binary);
+  const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  Reader reader(content);
+  N_ENSURE_EQ(reader.read<uint32_t>(), BlockSnapshot::MAGIC, "not a block snapshot");
+  N_ENSURE_EQ(reader.read<uint32_t>(), BlockSnapshot::VERSION, "snapshot version not supported");
+
+  backup = reader.read();
+  BlockList blocks;
+  for (size_t i = 0, size = reader.read<uint32_t>(); i < size; ++i) {
+    const auto id = reader.read<uint64_t>();
+    const auto start = reader.read<uint64_t>();
+    const auto end = reader.read<uint64_t>();
+    const auto rows = reader.read<uint64_t>();
+    const auto raw = reader.read<uint64_t>();
+    nebula::surface::eval::HistVector hists(reader.read<uint32_t>());
+    for (auto& hist : hists) {
+      hist = nebula::surface::eval::from(std::string(reader.read()));
+    }
+
+    blocks.push_front(std::make_shared<BatchBlock>(
+      BlockSignature{ table, id, start, end, spec }, NNode::inproc(), BlockState{ rows, raw, std::move(hists) }));
+  }
+
+  return blocks;
+}
+
+// file system of a backup location, a path without schema is local
+static std::unique_ptr<nebula::storage::NFileSystem> remote(const nebula::storage::UriInfo& uri) {
+  return nebula::storage::makeFS(uri.schema.empty() ? "local" : uri.schema, uri.host);
+}
+
+BlockSnapshot::BlockSnapshot(const std::string& dir) : dir_{ dir } {
+  fs::create_directories(dir_);
+}
+
+std::shared_ptr<BlockSnapshot> BlockSnapshot::local() {
+  static const auto inst = FLAGS_SNAPSHOT_DIR.empty() ? nullptr : std::make_shared<BlockSnapshot>(FLAGS_SNAPSHOT_DIR);
+  return inst;
+}
+
+std::string BlockSnapshot::path(const std::string& table, const std::string& spec) const {
+  using nebula::common::Hasher;
+  return fmt::format("{0}/{1:x}_{2:x}", dir_, Hasher::hashString(table), Hasher::hashString(spec));
+}
+
+bool BlockSnapshot::save(const std::string& table,
+                         const std::string& spec,
+                         const BlockList& blocks,
+                         const std::string& backup) noexcept {
+  const auto target = path(table, spec);
+  const auto temp = target + TMP;
+  try {
+    fs::remove_all(temp);
+    fs::create_directories(temp);
+    for (const auto& block : blocks) {
+      const auto file = fmt::format("{0}/{1}{2}", temp, block->getId(), EXT);
+      if (!write(*block, file)) {
+        LOG(INFO) << "Skip snapshot of spec " << spec << " with block not supported: " << block->signature().toString();
+        fs::remove_all(temp);
+        remove(table, spec);
+        return false;
+      }
+    }
+
+    // the snapshot is visible only when all blocks are written
+    writeManifest(blocks, backup, fmt::format("{0}/{1}", temp, MANIFEST));
+    fs::remove_all(target);
+    fs::rename(temp, target);
+
+    // a spec failed to back up is still good to restore locally
+    if (!backup.empty()) {
+      const auto uri = nebula::storage::parse(backup);
+      const auto dest = fmt::format("{0}/{1}", uri.path, fs::path(target).filename().string());
+      if (!remote(uri)->sync(target, dest)) {
+        LOG(WARNING) << "Failed to back up snapshot of spec " << spec << " to " << backup;
+      }
+    }
+
+    return true;
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Failed to save snapshot of spec " << spec << ": " << ex.what();
+    std::error_code ec;
+    fs::remove_all(temp, ec);
+    fs::remove_all(target, ec);
+    return false;
+  }
+}
+
+BlockList BlockSnapshot::load(const std::string& table,
+                              const std::string& spec,
+                              const TableProvider& tables,
+                              const Sealer& seal) noexcept {
+  BlockList blocks;
+  const auto target = path(table, spec);
+  try {
+    if (!fs::is_directory(target)) {
+      return blocks;
+    }
+
+    for (const auto& entry : fs::directory_iterator(target)) {
+      if (entry.path().extension() != EXT) {
+        continue;
+      }
+
+      auto block = read(entry.path().string(), tables, seal);
+
+      // a snapshot of another spec sharing the same path, or not compatible with current table
+      if (block == nullptr || block->spec() != spec) {
+        LOG(INFO) << "Discard snapshot of spec " << spec << " not compatible with current table.";
+        remove(table, spec);
+        return {};
+      }
+
+      blocks.push_front(block);
+    }
+
+    // a spec registered from backup has only the blocks fetched by queries so far
+    const auto manifest = fmt::format("{0}/{1}", target, MANIFEST);
+    if (fs::exists(manifest)) {
+      std::string backup;
+      const auto all = readManifest(manifest, table, spec, backup);
+      if (std::distance(all.begin(), all.end()) != std::distance(blocks.begin(), blocks.end())) {
+        return {};
+      }
+    }
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Failed to load snapshot of spec " << spec << ": " << ex.what();
+    remove(table, spec);
+    return {};
+  }
+
+  return blocks;
+}
+
+bool BlockSnapshot::write(const BatchBlock& block, const std::string& file) noexcept {
+  try {
+    return block.data() != nullptr && writeBlock(block, file);
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Failed to write block " << block.signature().toString() << ": " << ex.what();
+    return false;
+  }
+}
+
+std::shared_ptr<BatchBlock> BlockSnapshot::read(const std::string& file,
+                                                const TableProvider& tables,
+                                                const Sealer& seal,
+                                                const Columns& columns) noexcept {
+  try {
+    std::ifstream in(file, std::ios::binary);
+    N_ENSURE(in.is_open(), "snapshot file not found");
+    return readBlock(in, tables, seal, columns);
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Failed to read block from " << file << ": " << ex.what();
+    return nullptr;
+  }
+}
+
+BlockList BlockSnapshot::stubs(const std::string& table, const std::string& spec, const std::string& backup) noexcept {
+  const auto target = path(table, spec);
+  const auto manifest = fmt::format("{0}/{1}", target, MANIFEST);
+  try {
+    if (!fs::exists(manifest) && (backup.empty() || !fetch(backup, target, MANIFEST))) {
+      return {};
+    }
+
+    std::string location;
+    return readManifest(manifest, table, spec, location);
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Failed to read manifest of spec " << spec << ": " << ex.what();
+    return {};
+  }
+}
+
+std::shared_ptr<BatchBlock> BlockSnapshot::hydrate(const BatchBlock& block,
+                                                   const TableProvider& tables,
+                                                   const Sealer& seal,
+                                                   const Columns& columns) noexcept {
+  const auto target = path(block.table(), block.spec());
+  const auto name = fmt::format("{0}{1}", block.getId(), EXT);
+  const auto file = fmt::format("{0}/{1}", target, name);
+  try {
+    if (!fs::exists(file)) {
+      // block files of a spec registered from backup are fetched one by one as queries touch them
+      std::string backup;
+      readManifest(fmt::format("{0}/{1}", target, MANIFEST), block.table(), block.spec(), backup);
+      if (backup.empty() || !fetch(backup, target, name)) {
+        return nullptr;
+      }
+    }
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Failed to hydrate block " << block.signature().toString() << ": " << ex.what();
+    return nullptr;
+  }
+
+  return read(file, tables, seal, columns);
+}
+
+bool BlockSnapshot::fetch(const std::string& backup, const std::string& dir, const std::string& file) noexcept {
+  try {
+    const auto uri = nebula::storage::parse(backup);
+    fs::create_directories(dir);
+    const auto from = fmt::format("{0}/{1}/{2}", uri.path, fs::path(dir).filename().string(), file);
+    return remote(uri)->copy(from, fmt::format("{0}/{1}", dir, file));
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Failed to fetch " << file << " from backup " << backup << ": " << ex.what();
+    return false;
+  }
+}
+
+bool BlockSnapshot::remove(const std::string& table, const std::string& spec) noexcept {
+  std::error_code ec;
+  return fs::remove_all(path(table, spec), ec) > 0;
+}
+
+} // namespace io
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+
+#include "BlockLoader.h"
+#include "meta/MetaService.h"
+
+/**
+ * Block snapshots persist sealed blocks of an ingestion spec to local disk,
+ * so that a restarted node reloads the spec from the snapshot rather than its data source.
+ *
+ * Blocks of a spec are saved in one directory which is renamed in place only when all of them are written.
+ * Each block is a file in a versioned columnar format: every column as its NULL bitmap followed by fixed-width
+ * values, or sizes and bytes of strings, then a directory of block signature, partition id, row count and
+ * location of every column, ending with offset of the directory.
+ * A restored block is rebuilt by adding its rows into a new batch and sealing it,
+ * so dictionaries, histograms, bloom filters, zone maps and bess are the same as ingestion produces.
+ * Tables with compound columns are not saved.
+ *
+ * A block loaded for a query may read only the columns used by the query (and partition columns),
+ * the other columns are absent in the batch. It is loaded again with more columns when a query needs them.
+ *
+ * A manifest of the spec keeps metadata of its blocks (signature, rows and histograms), so a spec can be
+ * registered by metadata only and hydrated block by block when a query touches it. When a backup location
+ * is given, the snapshot is uploaded there, and a node without local copy fetches the manifest and block files
+ * from it on demand.
+ */
+namespace nebula {
+namespace execution {
+namespace io {
+
+class BlockSnapshot {
+public:
+  // table of given name, nullptr if it is unknown
+  using TableProvider = std::function<nebula::meta::TablePtr(const std::string&)>;
+  // seal a restored batch of given block signature
+  using Sealer = std::function<void(nebula::memory::Batch&, const nebula::meta::BlockSignature&)>;
+
+  // columns to load, empty for all columns
+  using Columns = nebula::common::unordered_set<std::string>;
+
+  static constexpr uint32_t MAGIC = 0x504E534E;
+  static constexpr uint32_t VERSION = 2;
+
+public:
+  explicit BlockSnapshot(const std::string& dir);
+  virtual ~BlockSnapshot() = default;
+
+  // snapshot store of current node in directory given by SNAPSHOT_DIR, nullptr if it is not set
+  static std::shared_ptr<BlockSnapshot> local();
+
+public:
+  // save all blocks of a spec owned by given table, replacing its existing snapshot, and upload it to backup if given
+  // return false if the blocks can't be saved, in which case no snapshot is left for the spec
+  bool save(const std::string& table,
+            const std::string& spec,
+            const BlockList& blocks,
+            const std::string& backup = "") noexcept;
+
+  // restore all blocks of a spec saved before, empty if there is no usable snapshot
+  BlockList load(const std::string& table, const std::string& spec, const TableProvider&, const Sealer&) noexcept;
+
+  // blocks of a spec saved before with metadata only and no data, the manifest is fetched from backup if given
+  // and the spec has no local snapshot. Empty if the spec is unknown.
+  BlockList stubs(const std::string& table, const std::string& spec, const std::string& backup = "") noexcept;
+
+  // load data of a block registered by its metadata, its file is fetched from backup of the spec on first use
+  // nullptr if it can't be loaded
+  std::shared_ptr<BatchBlock> hydrate(const BatchBlock&,
+                                      const TableProvider&,
+                                      const Sealer&,
+                                      const Columns& columns = {}) noexcept;
+
+  // remove snapshot of a spec, return true if it existed
+  bool remove(const std::string& table, const std::string& spec) noexcept;
+
+  // write a single block into given file, return false if the block can't be saved, such as some column is absent
+  static bool write(const BatchBlock&, const std::string& file) noexcept;
+
+  // read a single block written into given file with given columns only, other columns are absent in its batch
+  // nullptr if it can't be read by current table
+  static std::shared_ptr<BatchBlock> read(const std::string& file,
+                                          const TableProvider&,
+                                          const Sealer&,
+                                          const Columns& columns = {}) noexcept;
+
+private:
+  // directory holding snapshot of a spec
+  std::string path(const std::string& table, const std::string& spec) const;
+
+  // copy a file of the spec directory from its backup location, return false if it failed
+  static bool fetch(const std::string& backup, const std::string& dir, const std::string& file) noexcept;
+
+private:
+  std::string dir_;
+};
+
+} // namespace io
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlockTier.h"
+
+#include <filesystem>
+#include <gflags/gflags.h>
+
+#include "execution/meta/TableService.h"
+
+DEFINE_string(COLD_DIR, "", "local directory to keep blocks evicted from memory, empty to disable cold tier");
+DEFINE_uint64(HOT_MB, 0, "memory in MB for blocks resident in memory, least recently used ones beyond it go to COLD_DIR");
+
+/**
+ * Evict blocks to local disk and load them back.
+ */
+namespace nebula {
+namespace execution {
+namespace io {
+
+using nebula::execution::meta::TableService;
+using nebula::memory::Batch;
+using nebula::meta::BlockSignature;
+using nebula::meta::NNode;
+
+BlockTier::BlockTier(const std::string& dir, size_t budget) : dir_{ dir }, budget_{ budget }, tick_{ 0 } {
+  // cold blocks don't survive a restart, spec snapshots do
+  std::filesystem::remove_all(dir_);
+  std::filesystem::create_directories(dir_);
+}
+
+std::unique_ptr<BlockTier> BlockTier::make() {
+  if (FLAGS_COLD_DIR.empty() || FLAGS_HOT_MB == 0) {
+    return nullptr;
+  }
+
+  return std::make_unique<BlockTier>(FLAGS_COLD_DIR, FLAGS_HOT_MB * 1024 * 1024);
+}
+
+std::string BlockTier::path(const BatchBlock& block) const {
+  return fmt::format("{0}/{1:x}.nsnap", dir_, block.hash());
+}
+
+std::shared_ptr<BatchBlock> BlockTier::evict(const BatchBlock& block) noexcept {
+  // a sealed block never changes, its file is still valid if it was evicted before
+  // a block with absent columns is not written, it was loaded from its file or the snapshot of its spec
+  const auto file = path(block);
+  std::error_code ec;
+  const auto partial = block.data() != nullptr && !block.data()->complete();
+  if (!partial && !std::filesystem::exists(file, ec) && !BlockSnapshot::write(block, file)) {
+    drop(block);
+    return nullptr;
+  }
+
+  return std::make_shared<BatchBlock>(block.signature(), NNode::inproc(), block.state());
+}
+
+std::shared_ptr<BatchBlock> BlockTier::load(const BatchBlock& block, const BlockSnapshot::Columns& columns) noexcept {
+  auto loaded = BlockSnapshot::read(
+    path(block),
+    [](const std::string& name) { return TableService::singleton()->query(name).table(); },
+    [](Batch& batch, const BlockSignature&) { batch.seal(); },
+    columns);
+  if (loaded == nullptr) {
+    return nullptr;
+  }
+
+  // keep metadata of the evicted block, so its table state doesn't change while moving between tiers
+  touch(block);
+  return std::make_shared<BatchBlock>(block.signature(), loaded->data(), block.state());
+}
+
+void BlockTier::drop(const BatchBlock& block) noexcept {
+  std::error_code ec;
+  std::filesystem::remove(path(block), ec);
+
+  std::lock_guard<std::mutex> lock(mux_);
+  access_.erase(block.hash());
+}
+
+} // namespace io
+} // namespace execution
+} // namespace nebula
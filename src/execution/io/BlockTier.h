@@ -0,0 +1,122 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <mutex>
+
+#include "BlockSnapshot.h"
+#include "common/Hash.h"
+
+/**
+ * A second tier of block residency on local disk.
+ * When blocks in memory exceed the budget, the ones costing most to keep are evicted into files
+ * in block snapshot format, only their metadata (signature, rows and histograms) stays in memory.
+ * A cold block is loaded back when a query touches its time window, with the columns read by the query only.
+ *
+ * Keep cost of a block grows with its size and the age of its data, and shrinks with its hotness.
+ * Hotness counts queries touching the block, decayed by half every HALF_LIFE touches of all blocks since,
+ * so it reflects both frequency and recency: a block read often and lately stays resident,
+ * a block of a rarely read (long tail) table or window goes first.
+ */
+namespace nebula {
+namespace execution {
+namespace io {
+
+class BlockTier {
+  // access history of a block
+  struct Access {
+    size_t last;
+    double hits;
+  };
+
+public:
+  // number of touches for hits of a block to decay by half
+  static constexpr size_t HALF_LIFE = 1024;
+
+  BlockTier(const std::string& dir, size_t budget);
+  virtual ~BlockTier() = default;
+
+  // tier configured by COLD_DIR and HOT_MB, nullptr if it is not enabled
+  static std::unique_ptr<BlockTier> make();
+
+public:
+  // memory budget in bytes for blocks resident in memory
+  inline size_t budget() const noexcept {
+    return budget_;
+  }
+
+  // record an access of a block
+  inline void touch(const BatchBlock& block) {
+    std::lock_guard<std::mutex> lock(mux_);
+    auto& access = access_[block.hash()];
+    ++tick_;
+    access.hits = access.hits * decay(tick_ - access.last) + 1;
+    access.last = tick_;
+  }
+
+  // decayed hits of a block, 0 if it was never touched
+  inline double hotness(const BatchBlock& block) const {
+    std::lock_guard<std::mutex> lock(mux_);
+    auto found = access_.find(block.hash());
+    if (found == access_.end()) {
+      return 0;
+    }
+
+    return found->second.hits * decay(tick_ - found->second.last);
+  }
+
+  // cost to keep a block of given bytes in memory at given unix time in seconds, higher ones are evicted first
+  inline double cost(const BatchBlock& block, size_t bytes, size_t now) const {
+    // age in hours of the newest data in the block
+    const auto end = block.end();
+    const auto age = now > end ? (now - end) / 3600.0 : 0.0;
+    return bytes * (1 + std::log1p(age)) / (1 + hotness(block));
+  }
+
+  // write a block into cold tier, return a block of the same signature and state without data
+  // nullptr if the block can't be evicted. The file is kept after the block is loaded back,
+  // so evicting it again costs nothing
+  std::shared_ptr<BatchBlock> evict(const BatchBlock&) noexcept;
+
+  // load data of a cold block back into memory with given columns only, nullptr if it failed
+  std::shared_ptr<BatchBlock> load(const BatchBlock&, const BlockSnapshot::Columns& columns = {}) noexcept;
+
+  // drop a block from cold tier when it is removed
+  void drop(const BatchBlock&) noexcept;
+
+private:
+  // cold file of a block
+  std::string path(const BatchBlock&) const;
+
+  static inline double decay(size_t ticks) {
+    return std::exp2(-static_cast<double>(ticks) / HALF_LIFE);
+  }
+
+private:
+  std::string dir_;
+  size_t budget_;
+
+  // block hash -> access history
+  nebula::common::unordered_map<size_t, Access> access_;
+  size_t tick_;
+  mutable std::mutex mux_;
+};
+
+} // namespace io
+} // namespace execution
+} // namespace nebula
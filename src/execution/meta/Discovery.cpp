@@ -0,0 +1,239 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Discovery.h"
+
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <limits>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <unordered_set>
+
+#include "storage/Fetch.h"
+
+/**
+ * Incremental discovery of time partitions for roll tables.
+ */
+namespace nebula {
+namespace execution {
+namespace meta {
+
+using nebula::meta::MetaDb;
+using nebula::storage::FetchPool;
+using nebula::storage::FileInfo;
+using nebula::storage::NFileSystem;
+
+// key prefix of discovery states in meta db
+constexpr auto DB_PREFIX = "discovery:";
+
+Discovery& Discovery::singleton() {
+  static Discovery discovery;
+  return discovery;
+}
+
+std::vector<std::vector<FileInfo>> Discovery::list(NFileSystem& fs,
+                                                   const std::string& scope,
+                                                   const std::vector<Partition>& partitions,
+                                                   MetaDb& db) {
+  std::vector<std::vector<FileInfo>> results(partitions.size());
+  std::vector<size_t> misses;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < partitions.size(); ++i) {
+      const auto& p = partitions.at(i);
+      if (p.settled) {
+        const auto& s = state(fmt::format("{0}/{1}", scope, p.pattern), db);
+        auto found = s.listings.find(p.path);
+        if (p.time <= s.mark && found != s.listings.end()) {
+          results.at(i) = found->second;
+          continue;
+        }
+      }
+
+      misses.push_back(i);
+    }
+  }
+
+  // everything else is listed in parallel
+  std::vector<folly::Future<folly::Unit>> futures;
+  futures.reserve(misses.size());
+  for (auto i : misses) {
+    futures.push_back(FetchPool::singleton().submit([&fs, &partitions, &results, i]() {
+      results.at(i) = fs.list(partitions.at(i).path);
+    }));
+  }
+
+  const auto tries = folly::collectAll(futures).get();
+
+  // progress of every pattern: newest settled partition known and oldest settled partition failed to list
+  struct Progress {
+    size_t known = 0;
+    size_t failed = std::numeric_limits<size_t>::max();
+    bool changed = false;
+    std::unordered_set<std::string_view> paths;
+  };
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<std::string, Progress> progress;
+  for (size_t i = 0, k = 0; i < partitions.size(); ++i) {
+    const auto& p = partitions.at(i);
+    const auto key = fmt::format("{0}/{1}", scope, p.pattern);
+    auto& g = progress[key];
+    const auto miss = k < misses.size() && misses.at(k) == i;
+    if (miss) {
+      const auto& t = tries.at(k++);
+      if (t.hasException()) {
+        LOG(ERROR) << "Failed to list " << p.path << ": " << t.exception().what();
+        if (p.settled) {
+          g.failed = std::min(g.failed, p.time);
+        }
+        continue;
+      }
+    }
+
+    if (p.settled) {
+      g.known = std::max(g.known, p.time);
+      g.paths.emplace(p.path);
+      if (miss) {
+        state(key, db).listings.insert_or_assign(p.path, results.at(i));
+        g.changed = true;
+      }
+    }
+  }
+
+  // move marks up to the newest settled partition before the first failure, out of window listings are dropped
+  for (auto& item : progress) {
+    auto& g = item.second;
+    auto& s = state(item.first, db);
+    for (auto it = s.listings.begin(); it != s.listings.end();) {
+      if (g.paths.count(it->first) == 0) {
+        it = s.listings.erase(it);
+        g.changed = true;
+        continue;
+      }
+
+      ++it;
+    }
+
+    const auto mark = g.failed == std::numeric_limits<size_t>::max() ? g.known : std::min(g.known, g.failed - 1);
+    if (mark != s.mark) {
+      s.mark = mark;
+      g.changed = true;
+    }
+
+    if (g.changed) {
+      db.write(fmt::format("{0}{1}", DB_PREFIX, item.first), encode(s));
+    }
+  }
+
+  return results;
+}
+
+size_t Discovery::mark(const std::string& scope, const std::string& pattern) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = states_.find(fmt::format("{0}/{1}", scope, pattern));
+  return found == states_.end() ? 0 : found->second.mark;
+}
+
+Discovery::State& Discovery::state(const std::string& key, MetaDb& db) {
+  auto found = states_.find(key);
+  if (found != states_.end()) {
+    return found->second;
+  }
+
+  // load the state persisted by previous runs if any
+  auto& s = states_[key];
+  std::string value;
+  if (db.read(fmt::format("{0}{1}", DB_PREFIX, key), value) && !decode(value, s)) {
+    LOG(WARNING) << "Discard bad discovery state of " << key;
+    s = {};
+  }
+
+  return s;
+}
+
+// state in json: {"mark": time, "paths": {path: [[name, size, timestamp, domain, isDir], ...]}}
+std::string Discovery::encode(const State& s) {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> json(buffer);
+  json.StartObject();
+  json.Key("mark");
+  json.Uint64(s.mark);
+  json.Key("paths");
+  json.StartObject();
+  for (const auto& item : s.listings) {
+    json.Key(item.first.data(), item.first.size());
+    json.StartArray();
+    for (const auto& f : item.second) {
+      json.StartArray();
+      json.String(f.name.data(), f.name.size());
+      json.Uint64(f.size);
+      json.Uint64(f.timestamp);
+      json.String(f.domain.data(), f.domain.size());
+      json.Bool(f.isDir);
+      json.EndArray();
+    }
+    json.EndArray();
+  }
+  json.EndObject();
+  json.EndObject();
+  return buffer.GetString();
+}
+
+bool Discovery::decode(const std::string& value, State& s) {
+  rapidjson::Document doc;
+  if (doc.Parse(value.data(), value.size()).HasParseError() || !doc.IsObject()) {
+    return false;
+  }
+
+  auto mark = doc.FindMember("mark");
+  auto paths = doc.FindMember("paths");
+  if (mark == doc.MemberEnd() || !mark->value.IsUint64() || paths == doc.MemberEnd() || !paths->value.IsObject()) {
+    return false;
+  }
+
+  s.mark = mark->value.GetUint64();
+  for (const auto& item : paths->value.GetObject()) {
+    if (!item.value.IsArray()) {
+      return false;
+    }
+
+    std::vector<FileInfo> files;
+    files.reserve(item.value.Size());
+    for (const auto& f : item.value.GetArray()) {
+      if (!f.IsArray() || f.Size() != 5 || !f[0].IsString() || !f[1].IsUint64() || !f[2].IsUint64()
+          || !f[3].IsString() || !f[4].IsBool()) {
+        return false;
+      }
+
+      files.emplace_back(f[4].GetBool(),
+                         f[2].GetUint64(),
+                         f[1].GetUint64(),
+                         std::string(f[0].GetString(), f[0].GetStringLength()),
+                         std::string(f[3].GetString(), f[3].GetStringLength()));
+    }
+
+    s.listings.emplace(std::string(item.name.GetString(), item.name.GetStringLength()), std::move(files));
+  }
+
+  return true;
+}
+
+} // namespace meta
+} // namespace execution
+} // namespace nebula
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "meta/MetaDb.h"
+#include "storage/NFileSystem.h"
+
+/**
+ * Incremental discovery of time partitions for roll tables.
+ * Every refresh of a roll table walks all time partitions of its retention window, so listing them all
+ * costs in proportion to the whole history. A settled partition (old enough to stop changing) is listed once:
+ * its files are remembered per path pattern along with a high-water mark, the newest time that all settled
+ * partitions up to it are known. Following refreshes only list partitions newer than the mark or not settled yet.
+ * Mark and listings of a pattern are persisted in meta db, so a restarted server doesn't list its history again.
+ */
+namespace nebula {
+namespace execution {
+namespace meta {
+
+// a time partition of a path pattern to discover
+struct Partition {
+  // path pattern with time macros in it, partitions of the same pattern share a mark
+  std::string pattern;
+  // materialized path of the partition
+  std::string path;
+  // start time of the partition
+  size_t time;
+  // the partition is not expected to change any more
+  bool settled;
+};
+
+class Discovery {
+public:
+  Discovery() = default;
+  virtual ~Discovery() = default;
+
+  static Discovery& singleton();
+
+public:
+  // files of every partition in the order of given partitions, scope identifies the file system.
+  // settled partitions at or below the mark of their pattern are served without listing.
+  // partitions of a pattern are expected to cover its whole window, anything else remembered is dropped.
+  std::vector<std::vector<nebula::storage::FileInfo>> list(nebula::storage::NFileSystem&,
+                                                           const std::string&,
+                                                           const std::vector<Partition>&,
+                                                           nebula::meta::MetaDb&);
+
+  // high-water mark of a pattern in a scope, 0 if nothing is discovered
+  size_t mark(const std::string&, const std::string&) const;
+
+private:
+  struct State {
+    size_t mark = 0;
+    std::unordered_map<std::string, std::vector<nebula::storage::FileInfo>> listings;
+  };
+
+  State& state(const std::string&, nebula::meta::MetaDb&);
+  static std::string encode(const State&);
+  static bool decode(const std::string&, State&);
+
+private:
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, State> states_;
+};
+
+} // namespace meta
+} // namespace execution
+} // namespace nebula
@@ -16,9 +16,16 @@
 
 #include "SpecProvider.h"
 
+#include <map>
+
+#include "Discovery.h"
+
 #include "common/Evidence.h"
 #include "meta/BucketHelper.h"
+#include "meta/ClusterInfo.h"
+#include "storage/Fetch.h"
 #include "storage/NFS.h"
+#include "storage/kafka/KafkaConfig.h"
 #include "storage/kafka/KafkaTopic.h"
 
 DEFINE_uint64(KAFKA_SPEC_ROWS,
@@ -26,6 +33,11 @@ DEFINE_uint64(KAFKA_SPEC_ROWS,
               "rows per sepc for kafka ingestion"
               "this value is used in spec identifier so do not modify");
 DEFINE_uint64(KAFKA_TIMEOUT_MS, 5000, "Timeout of each Kafka API call");
+DEFINE_uint64(LIST_SETTLE_SECONDS, 7200, "a time partition older than this is not expected to change, its listing is cached");
+DEFINE_uint64(KAFKA_SPEC_PARTITIONS,
+              8,
+              "max partitions consumed by one kafka spec, "
+              "this value is used in spec identifier so do not modify");
 
 /**
  *
@@ -40,6 +52,7 @@ using dsu = nebula::meta::DataSourceUtils;
 using nebula::common::Evidence;
 using nebula::common::MapKV;
 using nebula::meta::BucketHelper;
+using nebula::meta::ClusterInfo;
 using nebula::meta::DataSource;
 using nebula::meta::DataSpec;
 using nebula::meta::Macro;
@@ -51,7 +64,10 @@ using nebula::meta::SpecState;
 using nebula::meta::TableSpecPtr;
 using nebula::meta::TimeSpec;
 using nebula::meta::TimeType;
+using nebula::storage::FetchPool;
 using nebula::storage::FileInfo;
+using nebula::storage::ListRequest;
+using nebula::storage::kafka::KafkaConfig;
 using nebula::storage::kafka::KafkaSegment;
 using nebula::storage::kafka::KafkaTopic;
 
@@ -60,6 +76,11 @@ constexpr auto S_BATCH = "batch";
 // specified kafka partition /offset to consume - kafka specific
 constexpr auto S_PARTITION = "k.partition";
 constexpr auto S_OFFSET = "k.offset";
+// specified partitions per spec - kafka specific
+constexpr auto S_PARTITIONS = "k.partitions";
+// discovery mode of time partitions - roll specific, "incremental" lists settled partitions only once
+constexpr auto S_DISCOVERY = "discovery";
+constexpr auto V_INCREMENTAL = "incremental";
 
 // this method is to generate one spec per file
 void genSpecs4Files(const TableSpecPtr& table,
@@ -119,11 +140,21 @@ void genSpecs4Swap(const std::string& version,
     // making a s3 fs with given host
     auto fs = nebula::storage::makeFS(dsu::getProtocol(table->source), sourceInfo.host, table->settings);
 
-    // list all objects/files from given paths
+    // list all objects/files from given paths in parallel, files may be replaced any time so nothing is settled
     const auto& pathsWithMacros = Macro::enumeratePathsWithMacros(sourceInfo.path, table->macroValues);
+    std::vector<ListRequest> requests;
+    std::vector<const MapKV*> macros;
+    requests.reserve(pathsWithMacros.size());
+    macros.reserve(pathsWithMacros.size());
     for (const auto& pathWithCombination : pathsWithMacros) {
-      auto files = fs->list(pathWithCombination.first);
-      genSpecs4Files(table, version, files, specs, 0, pathWithCombination.second);
+      requests.push_back({ pathWithCombination.first, false });
+      macros.push_back(&pathWithCombination.second);
+    }
+
+    const auto scope = fmt::format("{0}://{1}", dsu::getProtocol(table->source), sourceInfo.host);
+    auto listings = FetchPool::singleton().list(*fs, scope, requests);
+    for (size_t i = 0; i < listings.size(); ++i) {
+      genSpecs4Files(table, version, listings.at(i), specs, 0, *macros.at(i));
     }
     return;
   }
@@ -149,19 +180,45 @@ void genPatternSpec(const PatternMacro macro,
   // fill in custom macros
   auto pathsWithMacros = Macro::enumeratePathsWithMacros(pathTemplate, table->macroValues);
 
+  // all paths of every time point are listed in parallel, an old time point is settled
+  std::vector<Partition> partitions;
+  std::vector<std::pair<size_t, const MapKV*>> points;
   for (const auto& pathMacros : pathsWithMacros) {
     // from now going back step by step until exceeding maxSeconds
     size_t count = 0;
     while (count < maxSeconds) {
       const auto watermark = now - count;
       // populate the file paths for given time point
-      const auto path = Macro::materialize(macro, pathMacros.first, watermark);
-      // list files in the path and generate spec perf file from it
-      genSpecs4Files(table, version, fs->list(path), specs, watermark, pathMacros.second);
+      partitions.push_back({ pathMacros.first,
+                             Macro::materialize(macro, pathMacros.first, watermark),
+                             watermark / step * step,
+                             count > FLAGS_LIST_SETTLE_SECONDS });
+      points.emplace_back(watermark, &pathMacros.second);
 
       count += step;
     }
   }
+
+  // generate spec per file from files of every path, in the same order as they are listed one by one
+  const auto scope = fmt::format("{0}://{1}", dsu::getProtocol(table->source), sourceInfo.host);
+  std::vector<std::vector<FileInfo>> listings;
+  auto discovery = table->settings.find(S_DISCOVERY);
+  if (discovery != table->settings.end() && discovery->second == V_INCREMENTAL) {
+    // settled partitions below the high-water mark of their pattern are not listed again
+    listings = Discovery::singleton().list(*fs, scope, partitions, ClusterInfo::singleton().db());
+  } else {
+    std::vector<ListRequest> requests;
+    requests.reserve(partitions.size());
+    for (const auto& p : partitions) {
+      requests.push_back({ p.path, p.settled });
+    }
+
+    listings = FetchPool::singleton().list(*fs, scope, requests);
+  }
+
+  for (size_t i = 0; i < listings.size(); ++i) {
+    genSpecs4Files(table, version, listings.at(i), specs, points.at(i).first, *points.at(i).second);
+  }
 }
 
 void genSpecs4Roll(const std::string& version,
@@ -175,9 +232,10 @@ void genSpecs4Roll(const std::string& version,
     auto timePt = Macro::extract(sourceInfo.path);
 
     // TODO(chenqin): don't support other macro other than dt=date/hr=hour/mi=minute/se=second yet.
+    // specs are generated for the longest retention tier of the table
     genPatternSpec(timePt,
                    sourceInfo.path,
-                   table->max_seconds,
+                   table->horizon(),
                    version,
                    table,
                    specs);
@@ -193,7 +251,7 @@ void genRocksetSpec(const std::string& version,
   // produce consistent spec for the time slice, use watermark to store the beginning of the time
   // contract: we provide data start_time and end_time as posted data (UTC time)
   const size_t now = Evidence::now();
-  const size_t earliest = now - table->max_seconds;
+  const size_t earliest = now - table->horizon();
   const size_t currentHour = Evidence::hour(now);
   const size_t interval = table->rocksetSerde.interval;
 
@@ -235,12 +293,25 @@ void genKafkaSpec(const std::string& version,
     VLOG(1) << "Table " << table->name << " overwrite batch size as " << batch;
   }
 
+  // partitions consumed together by one spec
+  auto partitions = FLAGS_KAFKA_SPEC_PARTITIONS;
+  auto itr_n = settings.find(S_PARTITIONS);
+  if (itr_n != settings.end()) {
+    partitions = std::max<size_t>(1, folly::to<size_t>(itr_n->second));
+  }
+
   // turn these segments into ingestion spec
-  auto convert = [&specs, &table, &version](const std::list<KafkaSegment>& segments) {
-    // turn these segments into ingestion spec
+  // segments of the same offset in a group of partitions (by partition / N) go to one spec,
+  // so that specs are stable for the same segments regardless of their generation order
+  auto convert = [&specs, &table, &version, partitions](const std::list<KafkaSegment>& segments) {
+    std::map<std::pair<int64_t, int32_t>, std::vector<SpecSplitPtr>> groups;
     for (auto itr = segments.cbegin(), end = segments.cend(); itr != end; ++itr) {
-      std::vector<SpecSplitPtr> splits = { std::make_shared<SpecSplit>(itr->id(), itr->size, 0) };
-      specs.push_back(std::make_shared<DataSpec>(table, version, "kafka", splits, SpecState::NEW));
+      groups[{ itr->offset, itr->partition / (int32_t)partitions }].push_back(
+        std::make_shared<SpecSplit>(itr->id(), itr->size, 0));
+    }
+
+    for (auto& group : groups) {
+      specs.push_back(std::make_shared<DataSpec>(table, version, "kafka", group.second, SpecState::NEW));
     }
   };
 
@@ -256,8 +327,9 @@ void genKafkaSpec(const std::string& version,
   }
 
   // set start time
-  const auto startMs = 1000 * (Evidence::unix_timestamp() - table->max_seconds);
-  auto segments = topic.segmentsByTimestamp(startMs, batch);
+  const auto startMs = 1000 * (Evidence::unix_timestamp() - table->horizon());
+  // streaming tables consume the segments being produced as well
+  auto segments = topic.segmentsByTimestamp(startMs, batch, KafkaConfig::streamMs(settings) > 0);
   convert(segments);
 }
 
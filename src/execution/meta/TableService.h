@@ -76,12 +76,34 @@ public:
   }
 
   // get table registry - enroll it if first time
+  // rollup and derived tables of the spec are enrolled along with it
+  // cluster info keeps the same spec for a table until its definition changes,
+  // a new spec replaces tables of its registries
   inline nebula::meta::TableRegistryPtr get(const nebula::meta::TableSpecPtr& tbSpec) {
     const auto& name = tbSpec->name;
     if (!exists(name)) {
       enroll(tbSpec->to(), tbSpec->ttl.stl);
+      for (const auto& rollup : tbSpec->rollups) {
+        enroll(tbSpec->to(rollup), tbSpec->ttl.stl);
+      }
+      for (const auto& derived : tbSpec->derived) {
+        enroll(tbSpec->to(derived), tbSpec->ttl.stl);
+      }
     }
 
+    std::lock_guard<std::mutex> lock(lock_);
+    auto& last = specs_[name];
+    if (last && last != tbSpec) {
+      replace(tbSpec->to(), tbSpec->ttl.stl);
+      for (const auto& rollup : tbSpec->rollups) {
+        replace(tbSpec->to(rollup), tbSpec->ttl.stl);
+      }
+      for (const auto& derived : tbSpec->derived) {
+        replace(tbSpec->to(derived), tbSpec->ttl.stl);
+      }
+    }
+
+    last = tbSpec;
     return tables_[name];
   }
 
@@ -110,6 +132,7 @@ public:
     // remove them all
     for (auto& name : expired) {
       tables_.erase(name);
+      specs_.erase(name);
       // remove table spec from cluster info as well
       nebula::meta::ClusterInfo::singleton().removeTable(name);
     }
@@ -132,9 +155,22 @@ private:
     return false;
   }
 
+  // replace table of its registry or enroll it, lock is held
+  void replace(const nebula::meta::TablePtr& tp, size_t stl) {
+    auto found = tables_.find(tp->name());
+    if (found != tables_.end()) {
+      found->second->replace(tp);
+      return;
+    }
+
+    tables_[tp->name()] = std::make_shared<nebula::meta::TableRegistry>(tp, stl);
+  }
+
 private:
   // preset is a list of preload table before meta service functions
   nebula::common::unordered_map<std::string, nebula::meta::TableRegistryPtr> tables_;
+  // spec of every table which its registry is built from
+  nebula::common::unordered_map<std::string, nebula::meta::TableSpecPtr> specs_;
   std::mutex lock_;
 };
 
@@ -20,6 +20,7 @@
 
 #include "execution/core/BlockExecutor.h"
 #include "memory/keyed/FlatRowCursor.h"
+#include "surface/TopRows.h"
 #include "type/Serde.h"
 
 /**
@@ -86,26 +87,44 @@ void init() {
 
 #else
 
-// by default, if yomm2 is not available or buggy, go with this dynamic cast version as fallback
-FlatBufferPtr asBuffer(nebula::surface::RowCursor& cursor,
-                       nebula::type::Schema schema,
-                       const nebula::surface::eval::Fields& fields) {
+// buffer of a cursor holding one unread flat buffer, null for other cursors
+static FlatBufferPtr take(nebula::surface::RowCursor& cursor) {
   if (auto b = dynamic_cast<nebula::execution::core::BlockExecutor*>(&cursor)) {
     return b->takeResult();
   } else if (auto f = dynamic_cast<nebula::memory::keyed::FlatRowCursor*>(&cursor)) {
     return f->takeResult();
-  } else {
-    // TODO(cao): this will lose the aggregation states by adding row by row
-    // we should ask FlatBuffer to support serializaiton with filtered rows
-    // push TOP ROWS serialization into FB instead of row by row rebuild.
-    LOG(INFO) << "Serializing row cursor as flat buffer.";
-    auto buffer = std::make_unique<nebula::memory::keyed::FlatBuffer>(schema, fields);
-    while (cursor.hasNext()) {
-      buffer->add(cursor.next());
-    }
+  }
 
+  return nullptr;
+}
+
+// by default, if yomm2 is not available or buggy, go with this dynamic cast version as fallback
+FlatBufferPtr asBuffer(nebula::surface::RowCursor& cursor,
+                       nebula::type::Schema schema,
+                       const nebula::surface::eval::Fields& fields) {
+  auto buffer = take(cursor);
+  if (buffer) {
     return buffer;
   }
+
+  // top rows of a flat buffer keep the picked rows of the buffer in place when they are at least half of it,
+  // so that bytes of dropped rows shipped with them are no more than a copy of the picked rows saves
+  if (auto t = dynamic_cast<nebula::surface::TopRows*>(&cursor)) {
+    auto& rows = *t->rows();
+    if (t->size() * 2 >= rows.size() && (buffer = take(rows))) {
+      buffer->keep(t->order());
+      return buffer;
+    }
+  }
+
+  // TODO(cao): this will lose the aggregation states by adding row by row
+  LOG(INFO) << "Serializing row cursor as flat buffer.";
+  buffer = std::make_unique<nebula::memory::keyed::FlatBuffer>(schema, fields);
+  while (cursor.hasNext()) {
+    buffer->add(cursor.next());
+  }
+
+  return buffer;
 }
 
 void init() {
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <filesystem>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "common/Hash.h"
+#include "execution/QueryPatterns.h"
+#include "execution/io/BlockSnapshot.h"
+#include "execution/io/BlockTier.h"
+#include "meta/TestTable.h"
+#include "surface/MockSurface.h"
+#include "surface/StaticData.h"
+
+namespace nebula {
+namespace execution {
+namespace test {
+
+using nebula::execution::io::BatchBlock;
+using nebula::execution::io::BlockList;
+using nebula::execution::io::BlockLoader;
+using nebula::execution::io::BlockSnapshot;
+using nebula::execution::io::BlockTier;
+using nebula::memory::Batch;
+using nebula::meta::BlockSignature;
+using nebula::meta::TablePtr;
+
+TEST(SnapshotTest, TestSaveAndLoad) {
+  auto table = std::make_shared<nebula::meta::TestPartitionedTable>();
+  const auto dir = (std::filesystem::temp_directory_path() / "nebula-snapshot-test").string();
+  std::filesystem::remove_all(dir);
+  BlockSnapshot snapshot(dir);
+
+  // distribute rows into batches by the table pod
+  size_t count = 5000;
+  nebula::surface::MockRowData mr;
+  auto pod = table->pod();
+  nebula::common::unordered_map<size_t, std::shared_ptr<Batch>> batches;
+  for (size_t i = 0; i < count; ++i) {
+    nebula::surface::StaticPartitionedRow row(mr.readLong("_time_"), mr.readByte("value"), mr.readDouble("weight"));
+    int32_t bess = -1;
+    auto pid = pod->pod(row, bess);
+    auto& batch = batches[pid];
+    if (batch == nullptr) {
+      batch = std::make_shared<Batch>(*table, count, pid);
+    }
+
+    batch->add(row, bess);
+  }
+
+  BlockList blocks;
+  for (auto& item : batches) {
+    item.second->seal();
+    blocks.push_front(BlockLoader::from(BlockSignature{ table->name(), item.first, 0, 100, "spec-1" }, item.second));
+  }
+
+  // every row of a block is printed with its partition values
+  auto lines = [](const BlockList& list) {
+    std::vector<std::string> result;
+    for (const auto& block : list) {
+      const auto& batch = *block->data();
+      auto accessor = batch.makeAccessor();
+      for (size_t i = 0; i < batch.getRows(); ++i) {
+        const auto& r = accessor->seek(i);
+        result.push_back(fmt::format("{0}: ({1}, {2}, {3}, {4}, {5}, {6})",
+                                     block->signature().toString(),
+                                     r.readLong("_time_").value_or(0),
+                                     r.readString("d1").value_or(""),
+                                     r.readByte("d2").value_or(0),
+                                     r.readInt("d3").value_or(0),
+                                     r.readByte("value").value_or(0),
+                                     r.readDouble("weight").value_or(0)));
+      }
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+  };
+
+  EXPECT_TRUE(snapshot.save(table->name(), "spec-1", blocks));
+
+  const BlockSnapshot::TableProvider tables = [&table](const std::string& name) -> TablePtr {
+    return name == table->name() ? table : nullptr;
+  };
+  const BlockSnapshot::Sealer seal = [](Batch& batch, const BlockSignature&) {
+    batch.seal();
+  };
+
+  // a spec never saved has no snapshot
+  EXPECT_TRUE(snapshot.load(table->name(), "spec-2", tables, seal).empty());
+
+  auto restored = snapshot.load(table->name(), "spec-1", tables, seal);
+  EXPECT_EQ(static_cast<size_t>(std::distance(restored.begin(), restored.end())), batches.size());
+  for (const auto& block : restored) {
+    EXPECT_EQ(block->spec(), "spec-1");
+    EXPECT_EQ(block->data()->getPid(), block->getId());
+    EXPECT_EQ(block->state().numRows, batches.at(block->getId())->getRows());
+  }
+  EXPECT_EQ(lines(restored), lines(blocks));
+
+  // another node registers the spec by metadata from backup, and fetches block files as it hydrates them
+  const auto backup = dir + "-backup";
+  const auto peerDir = dir + "-peer";
+  EXPECT_TRUE(snapshot.save(table->name(), "spec-1", blocks, backup));
+  BlockSnapshot peer(peerDir);
+  auto stubs = peer.stubs(table->name(), "spec-1", backup);
+  EXPECT_EQ(static_cast<size_t>(std::distance(stubs.begin(), stubs.end())), batches.size());
+  for (const auto& stub : stubs) {
+    EXPECT_EQ(stub->data(), nullptr);
+    EXPECT_EQ(stub->state().numRows, batches.at(stub->getId())->getRows());
+    EXPECT_EQ(stub->state().histograms.size(), batches.at(stub->getId())->schema()->size());
+  }
+
+  auto hydrated = peer.hydrate(*stubs.front(), tables, seal);
+  ASSERT_NE(hydrated, nullptr);
+  EXPECT_EQ(hydrated->data()->getRows(), stubs.front()->state().numRows);
+  EXPECT_TRUE(hydrated->data()->complete());
+
+  // a block loaded for some columns reads only them and partition columns, others are absent
+  auto partial = peer.hydrate(*stubs.front(), tables, seal, { "_time_" });
+  ASSERT_NE(partial, nullptr);
+  const auto& data = *partial->data();
+  EXPECT_FALSE(data.complete());
+  EXPECT_TRUE(data.resident("_time_"));
+  EXPECT_TRUE(data.resident("d1"));
+  EXPECT_FALSE(data.resident("weight"));
+  EXPECT_TRUE(data.resident(BlockSnapshot::Columns{ "_time_", "d2" }));
+  EXPECT_FALSE(data.resident(BlockSnapshot::Columns{ "_time_", "value" }));
+  EXPECT_FALSE(data.resident(BlockSnapshot::Columns{}));
+  EXPECT_FALSE(BlockSnapshot::write(*partial, dir + "-partial"));
+  auto full = hydrated->data()->makeAccessor();
+  auto part = data.makeAccessor();
+  for (size_t i = 0; i < data.getRows(); ++i) {
+    EXPECT_EQ(part->seek(i).readLong("_time_"), full->seek(i).readLong("_time_"));
+    EXPECT_EQ(part->readString("d1"), full->readString("d1"));
+    EXPECT_EQ(part->readDouble("weight"), std::nullopt);
+  }
+
+  // a spec partially hydrated is not restored as a whole
+  EXPECT_TRUE(peer.load(table->name(), "spec-1", tables, seal).empty());
+  std::filesystem::remove_all(backup);
+  std::filesystem::remove_all(peerDir);
+
+  // a table changed its schema can't use the snapshot, and the snapshot is discarded
+  auto other = std::make_shared<nebula::meta::TestTable>();
+  auto changed = snapshot.load(table->name(), "spec-1", [&other](const std::string&) -> TablePtr { return other; }, seal);
+  EXPECT_TRUE(changed.empty());
+  EXPECT_FALSE(snapshot.remove(table->name(), "spec-1"));
+
+  // blocks with compound columns are not saved
+  auto batch = std::make_shared<Batch>(*other, 10);
+  nebula::surface::MockRowData row;
+  batch->add(row);
+  batch->seal();
+  BlockList list;
+  list.push_front(BlockLoader::from(BlockSignature{ other->name(), 0, 0, 100, "spec-3" }, batch));
+  EXPECT_FALSE(snapshot.save(other->name(), "spec-3", list));
+  EXPECT_TRUE(snapshot.load(other->name(), "spec-3", tables, seal).empty());
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(SnapshotTest, TestTierCost) {
+  const auto dir = (std::filesystem::temp_directory_path() / "nebula-tier-test").string();
+  BlockTier tier(dir, 1024);
+
+  auto table = std::make_shared<nebula::meta::TestTable>();
+  auto make = [&table](size_t id, size_t end) {
+    return BlockLoader::from(BlockSignature{ table->name(), id, 0, end, "spec" }, std::make_shared<Batch>(*table, 1));
+  };
+
+  const size_t now = 1000000;
+  auto hot = make(1, now);
+  auto cold = make(2, now);
+  auto old = make(3, now - 30 * 24 * 3600);
+  for (auto i = 0; i < 10; ++i) {
+    tier.touch(*hot);
+  }
+  tier.touch(*cold);
+
+  // more hits, less cost to keep
+  EXPECT_GT(tier.hotness(*hot), tier.hotness(*cold));
+  EXPECT_EQ(tier.hotness(*old), 0);
+  EXPECT_LT(tier.cost(*hot, 100, now), tier.cost(*cold, 100, now));
+
+  // bigger and older blocks cost more
+  EXPECT_LT(tier.cost(*cold, 100, now), tier.cost(*cold, 200, now));
+  EXPECT_LT(tier.cost(*make(4, now), 100, now), tier.cost(*old, 100, now));
+
+  // hits decay when a block is not touched while others are
+  const auto before = tier.hotness(*hot);
+  for (size_t i = 0; i < BlockTier::HALF_LIFE; ++i) {
+    tier.touch(*cold);
+  }
+  EXPECT_NEAR(tier.hotness(*hot), before / 2, 0.01);
+  EXPECT_GT(tier.hotness(*cold), tier.hotness(*hot));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(SnapshotTest, TestQueryPatterns) {
+  QueryPatterns patterns;
+  const size_t t0 = 1000000;
+  constexpr size_t hour = 3600;
+
+  // a dashboard reading the last hour every minute, its requests jitter by a few seconds
+  patterns.record("t", { t0 - hour, t0 }, { "a" }, t0);
+  patterns.record("t", { t0 + 60 - hour, t0 + 60 }, { "b" }, t0 + 62);
+  patterns.record("t", { t0 + 120 - hour, t0 + 120 }, { "a" }, t0 + 121);
+
+  // a one-off query of another window
+  patterns.record("t", { t0 - 24 * hour, t0 }, {}, t0);
+  EXPECT_EQ(patterns.size(), 2);
+
+  // nothing runs within the horizon yet
+  EXPECT_TRUE(patterns.predict(t0 + 125, 30).empty());
+
+  auto predictions = patterns.predict(t0 + 160, 30);
+  ASSERT_EQ(predictions.size(), 1);
+  const auto& p = predictions.front();
+  EXPECT_EQ(p.table, "t");
+  EXPECT_EQ(p.window.second - p.window.first, hour);
+  EXPECT_GT(p.window.second, t0 + 160);
+  EXPECT_LT(p.window.second, t0 + 190);
+  EXPECT_EQ(p.columns.size(), 2);
+
+  // a query reading all columns makes the pattern read all columns
+  patterns.record("t", { t0 + 180 - hour, t0 + 180 }, {}, t0 + 180);
+  predictions = patterns.predict(t0 + 230, 30);
+  ASSERT_EQ(predictions.size(), 1);
+  EXPECT_TRUE(predictions.front().columns.empty());
+
+  // the dashboard stopped, so it is not predicted anymore
+  EXPECT_TRUE(patterns.predict(t0 + 180 + 10 * 60, 30).empty());
+}
+
+} // namespace test
+} // namespace execution
+} // namespace nebula
@@ -14,25 +14,55 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <thread>
 #include <fmt/format.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <yorel/yomm2/cute.hpp>
 
+#include "execution/BlockManager.h"
 #include "execution/ExecutionPlan.h"
+#include "execution/TableState.h"
+#include "execution/core/Admission.h"
 #include "execution/core/BlockExecutor.h"
+#include "execution/core/Finalize.h"
+#include "execution/core/Hedge.h"
+#include "execution/core/Rolling.h"
+#include "execution/core/ServerExecutor.h"
+#include "execution/core/SharedScan.h"
+#include "execution/core/Spill.h"
+#include "execution/core/TopSort.h"
+#include "execution/core/TopThreshold.h"
 #include "execution/serde/RowCursorSerde.h"
 #include "memory/Batch.h"
+#include "memory/keyed/FlatRowCursor.h"
 #include "meta/TestTable.h"
 #include "surface/MockSurface.h"
+#include "surface/StaticData.h"
 #include "surface/eval/UDF.h"
 #include "surface/eval/ValueEval.h"
 
+DECLARE_bool(DICT_GROUP_BY);
+DECLARE_uint64(DIRECT_AGG_SLOTS);
+DECLARE_bool(TOP_GROUPS);
+DECLARE_uint64(AGG_FANIN);
+DECLARE_string(SPILL_DIR);
+DECLARE_uint64(FINALIZE_PARALLEL_ROWS);
+DECLARE_uint64(FINALIZE_CHUNK_ROWS);
+
 namespace nebula {
 namespace execution {
 namespace test {
 
+using nebula::execution::core::Admission;
 using nebula::execution::core::BlockExecutor;
+using nebula::execution::core::Morsel;
+using nebula::execution::core::Priority;
+using nebula::execution::core::RowQuota;
 using nebula::memory::Batch;
 using nebula::memory::EvaledBlock;
 using nebula::surface::Accessor;
@@ -246,6 +276,1119 @@ TEST(ExecutionTest, TestCustomColumn) {
     auto id2 = row.readInt("id2");
     EXPECT_TRUE(id - 2000 == id2);
   }
+
+  // script data is built once for the phase, its evaluation context is reused by next blocks of this thread
+  EXPECT_NE(plan.scriptData(), nullptr);
+  EXPECT_EQ(plan.scriptData(), plan.scriptData());
+  for (auto b = 0; b < 3; ++b) {
+    auto next = std::make_shared<Batch>(test, 10);
+    for (auto i = 0; i < 10; ++i) {
+      next->add(row);
+    }
+
+    EvaledBlock neb{ next, BlockEval::PARTIAL };
+    auto rows = nebula::execution::core::compute(neb, plan);
+    size_t count = 0;
+    while (rows->hasNext()) {
+      const auto& r = rows->next();
+      EXPECT_EQ(r.readInt("id") - 2000, r.readInt("id2"));
+      ++count;
+    }
+
+    EXPECT_GT(count, 0);
+  }
+}
+
+TEST(ExecutionTest, TestMorselCompute) {
+  // split rows into morsels
+  {
+    EXPECT_EQ(Morsel::split(10, 0).size(), 1);
+    EXPECT_EQ(Morsel::split(10, 10).size(), 1);
+    auto morsels = Morsel::split(10, 3);
+    EXPECT_EQ(morsels.size(), 4);
+    EXPECT_EQ(morsels.front().start, 0);
+    EXPECT_EQ(morsels.back().start, 9);
+    EXPECT_EQ(morsels.back().end, 10);
+  }
+
+  nebula::meta::TestTable test;
+  auto size = 100;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  auto outputSchema = TypeSerializer::from("ROW<id:int, event:string, flag:bool>");
+  nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+
+  nebula::surface::eval::Fields selects;
+  selects.reserve(3);
+  selects.push_back(column<int32_t>("id"));
+  selects.push_back(column<std::string_view>("event"));
+  selects.push_back(column<bool>("flag"));
+  plan.scan(test.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .aggregate(0, { false, false, false })
+    .limit(size);
+
+  // every morsel computes its own row range, in total they cover the whole block
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  auto accessor = batch->makeAccessor();
+  size_t total = 0;
+  for (const auto& morsel : Morsel::split(size, 30)) {
+    auto cursor = nebula::execution::core::compute(eb, plan, morsel);
+    auto fb = nebula::execution::serde::asBuffer(*cursor, outputSchema, plan.fields());
+    EXPECT_EQ(fb->getRows(), morsel.end - morsel.start);
+    for (size_t i = 0; i < fb->getRows(); ++i) {
+      EXPECT_EQ(line2(accessor->seek(morsel.start + i)), line(fb->row(i)));
+    }
+
+    total += fb->getRows();
+  }
+
+  EXPECT_EQ(total, size);
+}
+
+TEST(ExecutionTest, TestDictGroupBy) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  // event column is dictionary encoded
+  EXPECT_NE(batch->dictionary("event"), nullptr);
+  EXPECT_EQ(batch->dictionary("id"), nullptr);
+
+  auto outputSchema = TypeSerializer::from("ROW<key:string, agg:int>");
+  nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+  nebula::surface::eval::Fields selects;
+  selects.reserve(2);
+  selects.push_back(column<std::string_view>("event"));
+  selects.push_back(std::make_unique<TestUdaf>());
+  plan.scan(test.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .keys({ 0 })
+    .aggregate(1, { false, true });
+
+  // group keys of both modes are the same
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  auto keys = [&eb, &plan, &outputSchema](bool dict) {
+    FLAGS_DICT_GROUP_BY = dict;
+    auto cursor = nebula::execution::core::compute(eb, plan);
+    auto fb = nebula::execution::serde::asBuffer(*cursor, outputSchema, plan.fields());
+    std::set<std::string> set;
+    for (size_t i = 0; i < fb->getRows(); ++i) {
+      set.emplace(fb->row(i).readString("key"));
+    }
+
+    EXPECT_EQ(set.size(), fb->getRows());
+    return set;
+  };
+
+  auto codes = keys(true);
+  auto strings = keys(false);
+  FLAGS_DICT_GROUP_BY = true;
+  EXPECT_GT(codes.size(), 0);
+  EXPECT_EQ(codes, strings);
+}
+
+TEST(ExecutionTest, TestDirectAggregation) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  // group by a dictionary column and a bool column, both have small domains
+  auto outputSchema = TypeSerializer::from("ROW<key:string, flag:bool, agg:int>");
+  nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+  nebula::surface::eval::Fields selects;
+  selects.reserve(3);
+  selects.push_back(column<std::string_view>("event"));
+  selects.push_back(column<bool>("flag"));
+  selects.push_back(std::make_unique<TestUdaf>());
+  plan.scan(test.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .keys({ 0, 1 })
+    .aggregate(2, { false, false, true });
+
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  auto keys = [&eb, &plan, &outputSchema](size_t slots) {
+    FLAGS_DIRECT_AGG_SLOTS = slots;
+    auto cursor = nebula::execution::core::compute(eb, plan);
+    auto fb = nebula::execution::serde::asBuffer(*cursor, outputSchema, plan.fields());
+    std::set<std::string> set;
+    for (size_t i = 0; i < fb->getRows(); ++i) {
+      const auto& r = fb->row(i);
+      set.emplace(fmt::format("{0}-{1}", r.readString("key"), r.readBool("flag")));
+    }
+
+    EXPECT_EQ(set.size(), fb->getRows());
+    return set;
+  };
+
+  auto direct = keys(65536);
+  auto hashed = keys(0);
+  FLAGS_DIRECT_AGG_SLOTS = 65536;
+  EXPECT_GT(direct.size(), 0);
+  EXPECT_EQ(direct, hashed);
+}
+
+TEST(ExecutionTest, TestTopPushdown) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  // all ids in descending order
+  auto accessor = batch->makeAccessor();
+  std::vector<int32_t> ids;
+  for (auto i = 0; i < size; ++i) {
+    ids.push_back(accessor->seek(i).readInt("id").value_or(0));
+  }
+  std::sort(ids.begin(), ids.end(), std::greater<int32_t>());
+
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  const size_t top = 10;
+
+  // samples sorted by id keep the top N rows of the block rather than the first N
+  {
+    auto outputSchema = TypeSerializer::from("ROW<id:int, event:string, flag:bool>");
+    nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+    nebula::surface::eval::Fields selects;
+    selects.reserve(3);
+    selects.push_back(column<int32_t>("id"));
+    selects.push_back(column<std::string_view>("event"));
+    selects.push_back(column<bool>("flag"));
+    plan.scan(test.name())
+      .compute(std::move(selects))
+      .filter(constant<bool>(true))
+      .aggregate(0, { false, false, false })
+      .sort({ 0 }, true)
+      .limit(top);
+
+    auto cursor = nebula::execution::core::compute(eb, plan);
+    auto fb = nebula::execution::serde::asBuffer(*cursor, outputSchema, plan.fields());
+    EXPECT_EQ(fb->getRows(), top);
+    for (size_t i = 0; i < fb->getRows(); ++i) {
+      EXPECT_EQ(fb->row(i).readInt("id"), ids.at(i));
+    }
+  }
+
+  // aggregation sorted by a key keeps groups of top N keys only
+  {
+    auto outputSchema = TypeSerializer::from("ROW<id:int, agg:int>");
+    nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+    nebula::surface::eval::Fields selects;
+    selects.reserve(2);
+    selects.push_back(column<int32_t>("id"));
+    selects.push_back(std::make_unique<TestUdaf>());
+    plan.scan(test.name())
+      .compute(std::move(selects))
+      .filter(constant<bool>(true))
+      .keys({ 0 })
+      .aggregate(1, { false, true })
+      .sort({ 0 }, true)
+      .limit(top);
+
+    auto keys = [&eb, &plan, &outputSchema](bool prune) {
+      FLAGS_TOP_GROUPS = prune;
+      auto cursor = nebula::execution::core::compute(eb, plan);
+      auto fb = nebula::execution::serde::asBuffer(*cursor, outputSchema, plan.fields());
+      std::set<int32_t> set;
+      for (size_t i = 0; i < fb->getRows(); ++i) {
+        set.emplace(fb->row(i).readInt("id"));
+      }
+
+      return set;
+    };
+
+    auto all = keys(false);
+    auto pruned = keys(true);
+    FLAGS_TOP_GROUPS = true;
+    ASSERT_GT(all.size(), top);
+    EXPECT_EQ(pruned.size(), top);
+    EXPECT_EQ(pruned, std::set<int32_t>(std::prev(all.end(), top), all.end()));
+  }
+}
+
+TEST(ExecutionTest, TestTopSort) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  auto accessor = batch->makeAccessor();
+  std::vector<int32_t> ids;
+  for (auto i = 0; i < size; ++i) {
+    ids.push_back(accessor->seek(i).readInt("id").value_or(0));
+  }
+  std::sort(ids.begin(), ids.end());
+
+  auto outputSchema = TypeSerializer::from("ROW<id:int, event:string>");
+  auto plan = [&test, &outputSchema](bool sort) {
+    auto phase = std::make_unique<nebula::execution::BlockPhase>(test.schema(), outputSchema);
+    nebula::surface::eval::Fields selects;
+    selects.reserve(2);
+    selects.push_back(column<int32_t>("id"));
+    selects.push_back(column<std::string_view>("event"));
+    phase->scan(test.name())
+      .compute(std::move(selects))
+      .filter(constant<bool>(true))
+      .aggregate(0, { false, false });
+    if (sort) {
+      phase->sort({ 0 }, false).limit(10);
+    }
+
+    return phase;
+  };
+
+  // sort all rows of an unsorted cursor by id ascending and take top 10
+  auto all = plan(false);
+  auto sorted = plan(true);
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  auto cursor = nebula::execution::core::compute(eb, *all);
+  EXPECT_EQ(cursor->size(), size);
+
+  auto top = nebula::execution::core::topSort(cursor, *sorted);
+  EXPECT_EQ(top->size(), 10);
+  for (size_t i = 0; top->hasNext(); ++i) {
+    EXPECT_EQ(top->next().readInt("id"), ids.at(i));
+  }
+}
+
+TEST(ExecutionTest, TestTopThreshold) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  // count rows of every event
+  auto outputSchema = TypeSerializer::from("ROW<event:string, agg:int>");
+  nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+  nebula::surface::eval::Fields selects;
+  selects.reserve(2);
+  selects.push_back(column<std::string_view>("event"));
+  selects.push_back(std::make_unique<TestUdaf>());
+  plan.scan(test.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .keys({ 0 })
+    .aggregate(1, { false, true })
+    .sort({ 1 }, true)
+    .limit(3);
+
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  nebula::execution::core::TopThreshold top(outputSchema, plan.fields(), 1);
+  auto all = nebula::execution::core::compute(eb, plan);
+  std::vector<double> counts;
+  std::vector<size_t> keys;
+  while (all->hasNext()) {
+    const auto& r = all->next();
+    counts.push_back(top.score(r));
+    keys.push_back(top.key(r));
+  }
+
+  std::sort(counts.begin(), counts.end(), std::greater<double>());
+  ASSERT_GT(counts.size(), 3);
+  EXPECT_EQ(std::accumulate(counts.begin(), counts.end(), 0.0), size);
+
+  // local top N groups
+  {
+    auto cursor = top.select(nebula::execution::core::compute(eb, plan), { TopRound::Step::TOP, 0, {} }, 3);
+    EXPECT_EQ(cursor->size(), 3);
+    while (cursor->hasNext()) {
+      EXPECT_GE(top.score(cursor->next()), counts.at(2));
+    }
+  }
+
+  // groups counting no less than the threshold
+  {
+    const auto threshold = counts.at(1);
+    TopRound round{ TopRound::Step::THRESHOLD, threshold, {} };
+    auto cursor = top.select(nebula::execution::core::compute(eb, plan), round, 3);
+    const size_t expected = std::count_if(counts.begin(), counts.end(), [threshold](double c) {
+      return c >= threshold;
+    });
+    EXPECT_EQ(cursor->size(), expected);
+    while (cursor->hasNext()) {
+      EXPECT_GE(top.score(cursor->next()), threshold);
+    }
+  }
+
+  // groups of given keys
+  {
+    TopRound round{ TopRound::Step::KEYS, 0, { keys.front(), keys.back() } };
+    auto cursor = top.select(nebula::execution::core::compute(eb, plan), round, 3);
+    EXPECT_EQ(cursor->size(), 2);
+    while (cursor->hasNext()) {
+      EXPECT_EQ(round.keys.count(top.key(cursor->next())), 1);
+    }
+  }
+}
+
+TEST(ExecutionTest, TestMultiColumnSort) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  // expected order: event ascending, then id descending
+  auto accessor = batch->makeAccessor();
+  std::vector<std::pair<std::string, int32_t>> expected;
+  for (auto i = 0; i < size; ++i) {
+    const auto& r = accessor->seek(i);
+    expected.emplace_back(std::string(r.readString("event").value_or("")), r.readInt("id").value_or(0));
+  }
+  std::sort(expected.begin(), expected.end(), [](const auto& left, const auto& right) {
+    return left.first == right.first ? left.second > right.second : left.first < right.first;
+  });
+
+  auto outputSchema = TypeSerializer::from("ROW<id:int, event:string>");
+  auto plan = [&test, &outputSchema](bool sort) {
+    auto phase = std::make_unique<nebula::execution::BlockPhase>(test.schema(), outputSchema);
+    nebula::surface::eval::Fields selects;
+    selects.reserve(2);
+    selects.push_back(column<int32_t>("id"));
+    selects.push_back(column<std::string_view>("event"));
+    phase->scan(test.name())
+      .compute(std::move(selects))
+      .filter(constant<bool>(true))
+      .aggregate(0, { false, false });
+    if (sort) {
+      phase->sort({ 1, 0 }, { false, true }).limit(20);
+    }
+
+    return phase;
+  };
+
+  auto all = plan(false);
+  auto sorted = plan(true);
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  auto verify = [&expected](nebula::surface::RowCursor& cursor) {
+    EXPECT_EQ(cursor.size(), 20);
+    for (size_t i = 0; cursor.hasNext(); ++i) {
+      const auto& r = cursor.next();
+      EXPECT_EQ(r.readString("event"), expected.at(i).first);
+      EXPECT_EQ(r.readInt("id"), expected.at(i).second);
+    }
+  };
+
+  // sorted by normalized keys at top sort, and at block samples
+  verify(*nebula::execution::core::topSort(nebula::execution::core::compute(eb, *all), *sorted));
+  verify(*nebula::execution::core::compute(eb, *sorted));
+}
+
+TEST(ExecutionTest, TestParallelFinalize) {
+  nebula::meta::TestTable test;
+  auto size = 1000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  // count rows of every id
+  auto outputSchema = TypeSerializer::from("ROW<id:int, agg:int>");
+  auto block = std::make_unique<nebula::execution::BlockPhase>(test.schema(), outputSchema);
+  nebula::surface::eval::Fields selects;
+  selects.reserve(2);
+  selects.push_back(column<int32_t>("id"));
+  selects.push_back(std::make_unique<TestUdaf>());
+  block->scan(test.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .keys({ 0 })
+    .aggregate(1, { false, true });
+  const auto& plan = *block;
+  auto partial = std::make_unique<NodePhase>(std::move(block));
+  FinalPhase global(std::move(partial), outputSchema);
+
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  auto serial = nebula::execution::core::finalize(
+    nebula::execution::core::compute(eb, plan), global.fieldMap(), global);
+
+  // finalize every result in chunks of 7 rows on the pool
+  const auto rows = FLAGS_FINALIZE_PARALLEL_ROWS;
+  const auto chunk = FLAGS_FINALIZE_CHUNK_ROWS;
+  FLAGS_FINALIZE_PARALLEL_ROWS = 1;
+  FLAGS_FINALIZE_CHUNK_ROWS = 7;
+  folly::CPUThreadPoolExecutor pool{ 4 };
+  auto parallel = nebula::execution::core::finalize(
+    nebula::execution::core::compute(eb, plan), global.fieldMap(), global, 1, &pool);
+  FLAGS_FINALIZE_PARALLEL_ROWS = rows;
+  FLAGS_FINALIZE_CHUNK_ROWS = chunk;
+
+  ASSERT_EQ(parallel->size(), serial->size());
+  int32_t total = 0;
+  for (size_t i = 0; serial->hasNext(); ++i) {
+    const auto& left = serial->next();
+    const auto& right = parallel->next();
+    EXPECT_EQ(left.readInt("id"), right.readInt("id"));
+    EXPECT_EQ(left.readInt("agg"), right.readInt("agg"));
+    EXPECT_EQ(parallel->item(i)->readInt("agg"), right.readInt("agg"));
+    total += right.readInt("agg");
+  }
+
+  EXPECT_EQ(total, size);
+}
+
+TEST(ExecutionTest, TestRolling) {
+  // a timeline result of 2 series "x" and "y" in buckets of 10 seconds, rows are not in time order
+  // every metric column reads the same value of a static row
+  auto schema = TypeSerializer::from("ROW<_window_:long, event:string, a:double, b:double>");
+  nebula::surface::eval::Fields columns;
+  columns.push_back(column<int64_t>("_window_"));
+  columns.push_back(column<std::string_view>("event"));
+  columns.push_back(column<double>("a"));
+  columns.push_back(column<double>("b"));
+  const std::vector<std::tuple<int64_t, std::string, double>> points{
+    { 10, "x", 3 }, { 10, "y", 10 }, { 0, "x", 1 }, { 30, "x", 7 }, { 20, "y", 20 }
+  };
+  auto result = [&schema, &columns, &points]() {
+    auto flat = std::make_unique<nebula::memory::keyed::FlatBuffer>(schema, columns);
+    for (const auto& p : points) {
+      flat->add(nebula::surface::StaticRow(std::get<0>(p), 0, std::get<1>(p), nullptr, false, 'a', 0, std::get<2>(p)));
+    }
+
+    return std::make_shared<nebula::memory::keyed::FlatRowCursor>(std::move(flat));
+  };
+
+  // keys are window and event, metrics are aggregated
+  auto block = std::make_unique<nebula::execution::BlockPhase>(schema, schema);
+  nebula::surface::eval::Fields fields;
+  fields.push_back(column<int64_t>("_window_"));
+  fields.push_back(column<std::string_view>("event"));
+  fields.push_back(std::make_unique<TestUdaf>());
+  fields.push_back(std::make_unique<TestUdaf>());
+  block->compute(std::move(fields)).keys({ 0, 1 }).aggregate(2, { false, false, true, true });
+  FinalPhase global(std::make_unique<NodePhase>(std::move(block)), schema);
+  const nebula::execution::TimeBucket bucket{ 0, 0, 10 };
+
+  using nebula::execution::Rolling;
+  auto rolled = nebula::execution::core::rolling(
+    result(),
+    global.fieldMap(),
+    global,
+    { bucket, { { 2, Rolling::Type::CUMSUM, 0 }, { 3, Rolling::Type::RATE, 0 } } });
+
+  // input order is kept, the first bucket of a series has no rate
+  const std::vector<double> sums{ 4, 10, 1, 11, 30 };
+  const std::vector<double> rates{ 0.2, 0, 0, 0.2, 1 };
+  ASSERT_EQ(rolled->size(), points.size());
+  for (size_t i = 0; rolled->hasNext(); ++i) {
+    const auto& row = rolled->next();
+    EXPECT_EQ(row.readLong("_window_"), std::get<0>(points.at(i)));
+    EXPECT_EQ(row.readString("event"), std::get<1>(points.at(i)));
+    EXPECT_DOUBLE_EQ(row.readDouble("a"), sums.at(i));
+    EXPECT_EQ(row.isNull("b"), rates.at(i) == 0);
+    if (!row.isNull("b")) {
+      EXPECT_DOUBLE_EQ(row.readDouble("b"), rates.at(i));
+    }
+
+    EXPECT_DOUBLE_EQ(rolled->item(i)->readDouble("a"), sums.at(i));
+  }
+
+  // moving average of the last 2 windows, "x" has no bucket at 20 so its bucket at 30 averages itself
+  auto averaged = nebula::execution::core::rolling(
+    result(), global.fieldMap(), global, { bucket, { { 2, Rolling::Type::MOVING_AVG, 2 } } });
+  const std::vector<double> averages{ 2, 10, 1, 7, 15 };
+  for (size_t i = 0; averaged->hasNext(); ++i) {
+    EXPECT_DOUBLE_EQ(averaged->next().readDouble("a"), averages.at(i));
+  }
+
+  // no window functions, the same result
+  auto same = result();
+  EXPECT_EQ(nebula::execution::core::rolling(same, global.fieldMap(), global, {}), same);
+}
+
+TEST(ExecutionTest, TestCancellation) {
+  // listeners are notified once, a listener registered after cancel is invoked right away
+  {
+    Cancellation cancel;
+    EXPECT_FALSE(cancel.cancelled());
+    size_t notified = 0;
+    auto id = cancel.listen([&notified]() { ++notified; });
+    auto removed = cancel.listen([&notified]() { notified += 10; });
+    cancel.unlisten(removed);
+    cancel.cancel();
+    cancel.cancel();
+    EXPECT_TRUE(cancel.cancelled());
+    EXPECT_EQ(notified, 1);
+    cancel.unlisten(id);
+    cancel.listen([&notified]() { ++notified; });
+    EXPECT_EQ(notified, 2);
+  }
+
+  // a passed deadline cancels the query, a probe cancels it when polled
+  {
+    Cancellation cancel;
+    cancel.deadline(Cancellation::now() + 60000);
+    EXPECT_FALSE(cancel.cancelled());
+    EXPECT_GT(cancel.remaining(), 0);
+    cancel.deadline(Cancellation::now() - 1);
+    EXPECT_TRUE(cancel.cancelled());
+    EXPECT_EQ(cancel.remaining(), 0);
+
+    Cancellation probed;
+    bool disconnected = false;
+    probed.watch([&disconnected]() { return disconnected; });
+    EXPECT_FALSE(probed.poll());
+    disconnected = true;
+    EXPECT_FALSE(probed.cancelled());
+    EXPECT_TRUE(probed.poll());
+    EXPECT_TRUE(probed.cancelled());
+  }
+
+  // block compute of a cancelled query gives up its rows
+  nebula::meta::TestTable test;
+  auto size = 5000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  auto outputSchema = TypeSerializer::from("ROW<key:string, agg:int>");
+  nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+  nebula::surface::eval::Fields selects;
+  selects.reserve(2);
+  selects.push_back(column<std::string_view>("event"));
+  selects.push_back(std::make_unique<TestUdaf>());
+  plan.scan(test.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .keys({ 0 })
+    .aggregate(1, { false, true });
+
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  Cancellation cancel;
+  cancel.cancel();
+  BlockExecutor cancelled(eb, plan, Morsel::all(), &cancel);
+  EXPECT_TRUE(cancelled.cancelled());
+  EXPECT_EQ(cancelled.size(), 0);
+
+  BlockExecutor full(eb, plan, Morsel::all(), nullptr);
+  EXPECT_FALSE(full.cancelled());
+  EXPECT_GT(full.size(), 0);
+}
+
+TEST(ExecutionTest, TestAdmission) {
+  EXPECT_EQ(Admission::classify(100), Priority::INTERACTIVE);
+  EXPECT_EQ(Admission::classify(std::numeric_limits<size_t>::max()), Priority::BACKGROUND);
+
+  // one batch query at a time, no limit for others
+  Admission admission({ 0, 1, 0 });
+  Cancellation cancel;
+  auto first = admission.admit(Priority::BATCH, "a", cancel);
+  auto other = admission.admit(Priority::INTERACTIVE, "a", cancel);
+  EXPECT_EQ(admission.running(Priority::BATCH), 1);
+
+  // waiting queries are admitted in round robin of users
+  std::mutex lock;
+  std::vector<std::string> order;
+  std::vector<std::thread> threads;
+  for (auto name : { "a2", "a3", "b1" }) {
+    const auto waiting = admission.waiting(Priority::BATCH);
+    threads.emplace_back([&admission, &cancel, &lock, &order, name]() {
+      auto ticket = admission.admit(Priority::BATCH, std::string(1, name[0]), cancel);
+      std::lock_guard<std::mutex> guard(lock);
+      order.push_back(name);
+    });
+
+    while (admission.waiting(Priority::BATCH) == waiting) {
+      std::this_thread::yield();
+    }
+  }
+
+  // a cancelled query gives up waiting
+  Cancellation cancelled;
+  cancelled.cancel();
+  EXPECT_THROW(admission.admit(Priority::BATCH, "c", cancelled), nebula::common::NException);
+  EXPECT_EQ(admission.waiting(Priority::BATCH), 3);
+
+  first = nullptr;
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(order, (std::vector<std::string>{ "a2", "b1", "a3" }));
+  EXPECT_EQ(admission.running(Priority::BATCH), 0);
+  EXPECT_EQ(admission.running(Priority::INTERACTIVE), 1);
+}
+
+TEST(ExecutionTest, TestAsyncAdmission) {
+  // one batch query at a time, a waiting query takes no thread
+  Admission admission({ 0, 1, 0 });
+  auto first = admission.admitAsync(Priority::BATCH, "a").get();
+  auto second = admission.admitAsync(Priority::BATCH, "b");
+  EXPECT_FALSE(second.isReady());
+  EXPECT_EQ(admission.waiting(Priority::BATCH), 1);
+
+  // a query giving up waiting releases its slot as soon as it's granted
+  auto third = admission.admitAsync(Priority::BATCH, "c").within(std::chrono::milliseconds(1)).wait();
+  EXPECT_TRUE(third.hasException());
+  EXPECT_EQ(admission.waiting(Priority::BATCH), 2);
+
+  first = nullptr;
+  EXPECT_TRUE(second.isReady());
+  auto ticket = std::move(second).get();
+  EXPECT_EQ(admission.running(Priority::BATCH), 1);
+  EXPECT_EQ(admission.waiting(Priority::BATCH), 1);
+
+  ticket = nullptr;
+  EXPECT_EQ(admission.running(Priority::BATCH), 0);
+  EXPECT_EQ(admission.waiting(Priority::BATCH), 0);
+}
+
+TEST(ExecutionTest, TestMemoryLimit) {
+  // charges are released with their owners
+  auto cancel = std::make_shared<Cancellation>();
+  MemoryBudget budget(cancel);
+  {
+    MemoryCharge charge(&budget);
+    EXPECT_TRUE(charge.update(1024));
+    EXPECT_TRUE(charge.update(512));
+    EXPECT_EQ(budget.used(), 512);
+  }
+  EXPECT_EQ(budget.used(), 0);
+
+  nebula::meta::TestTable test;
+  auto size = 5000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  auto outputSchema = TypeSerializer::from("ROW<key:string, agg:int>");
+  nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+  nebula::surface::eval::Fields selects;
+  selects.reserve(2);
+  selects.push_back(column<std::string_view>("event"));
+  selects.push_back(std::make_unique<TestUdaf>());
+  plan.scan(test.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .keys({ 0 })
+    .aggregate(1, { false, true });
+
+  // a compute beyond the limit cancels its query
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  {
+    budget.limit(1024);
+    BlockExecutor executor(eb, plan, Morsel::all(), cancel.get(), &budget);
+    EXPECT_TRUE(budget.exceeded());
+    EXPECT_TRUE(cancel->cancelled());
+    EXPECT_TRUE(executor.cancelled());
+    EXPECT_GT(budget.used(), 1024);
+  }
+  EXPECT_EQ(budget.used(), 0);
+
+  // a compute within the limit is charged for its result
+  auto another = std::make_shared<Cancellation>();
+  MemoryBudget enough(another);
+  enough.limit(1UL << 30);
+  BlockExecutor executor(eb, plan, Morsel::all(), another.get(), &enough);
+  EXPECT_FALSE(executor.cancelled());
+  EXPECT_GE(enough.used(), executor.result().allocation());
+}
+
+TEST(ExecutionTest, TestSamplesQuota) {
+  nebula::meta::TestTable test;
+  auto size = 5000;
+  auto batch = std::make_shared<Batch>(test, size);
+  MockRowData row;
+  for (auto i = 0; i < size; ++i) {
+    batch->add(row);
+  }
+
+  auto outputSchema = TypeSerializer::from("ROW<id:int, event:string, flag:bool>");
+  nebula::execution::BlockPhase plan(test.schema(), outputSchema);
+  nebula::surface::eval::Fields selects;
+  selects.reserve(3);
+  selects.push_back(column<int32_t>("id"));
+  selects.push_back(column<std::string_view>("event"));
+  selects.push_back(column<bool>("flag"));
+  plan.scan(test.name())
+    .compute(std::move(selects))
+    .filter(constant<bool>(true))
+    .aggregate(0, { false, false, false })
+    .limit(100);
+
+  // the first block fills the quota, others of the same query give nothing
+  EvaledBlock eb{ batch, BlockEval::PARTIAL };
+  RowQuota quota(100);
+  auto first = nebula::execution::core::compute(eb, plan, Morsel::all(), nullptr, nullptr, &quota);
+  EXPECT_EQ(first->size(), 100);
+  EXPECT_TRUE(quota.full());
+
+  auto second = nebula::execution::core::compute(eb, plan, Morsel::all(), nullptr, nullptr, &quota);
+  EXPECT_EQ(second->size(), 0);
+  EXPECT_EQ(quota.rows(), 100);
+}
+
+TEST(ExecutionTest, TestNodeFailures) {
+  using nebula::surface::EmptyRowCursor;
+  using nebula::surface::RowCursorPtr;
+  std::vector<folly::Try<RowCursorPtr>> results;
+  results.emplace_back(EmptyRowCursor::instance());
+  results.emplace_back(folly::make_exception_wrapper<folly::FutureTimeout>());
+  results.emplace_back(folly::make_exception_wrapper<NException>("node down"));
+  results.emplace_back(EmptyRowCursor::instance());
+
+  QueryStats stats;
+  EXPECT_FALSE(stats.partial());
+  nebula::execution::core::countFailures(results, stats);
+  EXPECT_EQ(stats.nodesFailed, 1);
+  EXPECT_EQ(stats.nodesTimeout, 1);
+  EXPECT_TRUE(stats.partial());
+}
+
+TEST(ExecutionTest, TestQueryProfile) {
+  nebula::execution::ComputeTime time;
+  time.add(10, 20);
+  time.add(5, 0);
+  EXPECT_EQ(time.filterUs(), 15);
+  EXPECT_EQ(time.aggregateUs(), 20);
+
+  // profiles of node calls are added up and their call records are kept
+  QueryStats stats;
+  QueryStats node;
+  node.profile.blocksPrunedMeta = 3;
+  node.profile.filterUs = time.filterUs();
+  node.profile.serdeBytes = 1024;
+  node.profile.nodes.push_back({ "n1:9199", 100, 1024 });
+  stats.merge(node);
+  stats.merge(node);
+  EXPECT_EQ(stats.profile.blocksPrunedMeta, 6);
+  EXPECT_EQ(stats.profile.blocksPrunedPartition, 0);
+  EXPECT_EQ(stats.profile.filterUs, 30);
+  EXPECT_EQ(stats.profile.serdeBytes, 2048);
+  EXPECT_EQ(stats.profile.nodes.size(), 2);
+  EXPECT_EQ(stats.profile.nodes.front().node, "n1:9199");
+}
+
+TEST(ExecutionTest, TestHedgeRace) {
+  nebula::execution::core::LatencyTracker latencies(10);
+  EXPECT_EQ(latencies.percentile(95, 5), 0);
+  for (size_t i = 1; i <= 20; ++i) {
+    latencies.record(i);
+  }
+
+  // only the latest 10 samples are kept
+  EXPECT_EQ(latencies.percentile(0), 11);
+  EXPECT_EQ(latencies.percentile(50), 16);
+  EXPECT_EQ(latencies.percentile(100), 20);
+
+  nebula::execution::core::HedgeRace race;
+  auto lost = false;
+  race.cancellation().listen([&lost]() { lost = true; });
+  EXPECT_FALSE(race.decided());
+  EXPECT_TRUE(race.claim(1));
+  EXPECT_TRUE(lost);
+  EXPECT_TRUE(race.decided());
+  EXPECT_TRUE(race.won(1));
+  EXPECT_FALSE(race.claim(0));
+  EXPECT_FALSE(race.won(0));
+}
+
+TEST(ExecutionTest, TestDispatchInProc) {
+  // record peers every node is called with
+  using Calls = std::vector<std::pair<nebula::meta::NNode, size_t>>;
+  class PeerClient : public nebula::execution::core::NodeClient {
+  public:
+    PeerClient(const nebula::meta::NNode& node, folly::ThreadPoolExecutor& pool, Calls& calls)
+      : NodeClient(node, pool), calls_{ calls } {}
+    folly::Future<nebula::surface::RowCursorPtr> execute(const PlanPtr,
+                                                         const std::vector<nebula::meta::NNode>& peers) override {
+      calls_.emplace_back(node_, peers.size());
+      return folly::makeFuture<nebula::surface::RowCursorPtr>(nebula::surface::EmptyRowCursor::instance());
+    }
+
+  private:
+    Calls& calls_;
+  };
+
+  class PeerConnector : public nebula::execution::core::NodeConnector {
+  public:
+    std::unique_ptr<nebula::execution::core::NodeClient> makeClient(const nebula::meta::NNode& node,
+                                                                    folly::ThreadPoolExecutor& pool) override {
+      return std::make_unique<PeerClient>(node, pool, calls);
+    }
+
+    bool forwards() const override {
+      return true;
+    }
+
+    Calls calls;
+  };
+
+  const auto fanin = FLAGS_AGG_FANIN;
+  FLAGS_AGG_FANIN = 2;
+  std::vector<nebula::meta::NNode> nodes{ nebula::meta::NNode::inproc(),
+                                          { nebula::meta::NRole::NODE, "n1", 9199 },
+                                          { nebula::meta::NRole::NODE, "n2", 9199 },
+                                          { nebula::meta::NRole::NODE, "n3", 9199 },
+                                          { nebula::meta::NRole::NODE, "n4", 9199 } };
+  folly::CPUThreadPoolExecutor pool{ 2 };
+  auto connector = std::make_shared<PeerConnector>();
+  auto results = nebula::execution::core::dispatch(pool, nullptr, connector, nodes);
+  folly::collectAll(results).get();
+  FLAGS_AGG_FANIN = fanin;
+
+  // the in-process node is called on its own, the other nodes are grouped to forward
+  ASSERT_EQ(results.size(), 3);
+  ASSERT_EQ(connector->calls.size(), 3);
+  EXPECT_TRUE(connector->calls.at(0).first.isInProc());
+  EXPECT_EQ(connector->calls.at(0).second, 0);
+  EXPECT_EQ(connector->calls.at(1).second, 1);
+  EXPECT_EQ(connector->calls.at(2).second, 1);
+}
+
+TEST(ExecutionTest, TestSpillMerge) {
+  const auto dir = FLAGS_SPILL_DIR;
+  FLAGS_SPILL_DIR = "/tmp/nebula/spill_test";
+
+  auto schema = TypeSerializer::from("ROW<id:int, event:string>");
+  nebula::surface::eval::Fields f;
+  f.reserve(2);
+  f.emplace_back(constant(1));
+  f.emplace_back(constant("2"));
+  auto build = [&schema, &f](int from, int to) {
+    auto hf = std::make_unique<nebula::memory::keyed::HashFlat>(schema, f);
+    for (auto i = from; i < to; ++i) {
+      const auto event = std::to_string(i % 10);
+      nebula::surface::StaticRow row{ 0, i, event, nullptr, false, 'a', 1, 1.0 };
+      hf->update(row);
+    }
+
+    return hf;
+  };
+
+  // groups spilled in different runs are merged by partitions
+  auto spill = std::make_shared<nebula::execution::core::Spill>(schema, f, 4);
+  EXPECT_GT(spill->write(build(0, 1000)), 0);
+  EXPECT_GT(spill->write(build(500, 1500)), 0);
+  EXPECT_EQ(spill->runs(), 2);
+
+  auto cursor = nebula::execution::core::Spill::merge(std::move(spill));
+  EXPECT_EQ(cursor->size(), 1500);
+  std::set<int> ids;
+  while (cursor->hasNext()) {
+    const auto& row = cursor->next();
+    const auto id = row.readInt(0);
+    EXPECT_EQ(row.readString(1), std::to_string(id % 10));
+    ids.insert(id);
+  }
+
+  EXPECT_EQ(ids.size(), 1500);
+
+  // rows are read by random access across partitions too
+  EXPECT_EQ(cursor->item(1499)->readString(1), std::to_string(cursor->item(1499)->readInt(0) % 10));
+  EXPECT_EQ(cursor->item(0)->readString(1), std::to_string(cursor->item(0)->readInt(0) % 10));
+
+  // files are removed with the cursor
+  cursor = nullptr;
+  EXPECT_TRUE(std::filesystem::is_empty(FLAGS_SPILL_DIR));
+  FLAGS_SPILL_DIR = dir;
+}
+
+TEST(ExecutionTest, TestTableStateQuery) {
+  using nebula::execution::io::BatchBlock;
+  using nebula::meta::BlockSignature;
+  using nebula::meta::BlockState;
+  using nebula::meta::NNode;
+
+  // blocks of 10 seconds each in random order, with a long one covering [0, 500]
+  nebula::execution::TableState state{ "test" };
+  for (size_t i = 0; i < 100; ++i) {
+    const auto start = ((i * 37) % 100) * 10;
+    state.add(std::make_shared<BatchBlock>(
+      BlockSignature{ "test", i, start, start + 9, "s" }, NNode::inproc(), BlockState{ 1, 1, {} }));
+  }
+  state.add(std::make_shared<BatchBlock>(
+    BlockSignature{ "test", 100, 0, 500, "l" }, NNode::inproc(), BlockState{ 1, 1, {} }));
+
+  auto count = [&state](size_t start, size_t end) {
+    return state.query({ start, end }).size();
+  };
+
+  EXPECT_EQ(count(0, 2000), 101);
+  EXPECT_EQ(count(995, 2000), 1);
+  EXPECT_EQ(count(1000, 2000), 0);
+  EXPECT_EQ(count(600, 619), 2);
+  EXPECT_EQ(count(495, 505), 3);
+  EXPECT_EQ(count(9, 10), 3);
+
+  // index is rebuilt after blocks change
+  EXPECT_EQ(state.remove("l"), 1);
+  EXPECT_EQ(count(495, 505), 2);
+}
+
+TEST(ExecutionTest, TestTableStateMetrics) {
+  using nebula::execution::io::BatchBlock;
+  using nebula::meta::BlockSignature;
+  using nebula::meta::BlockState;
+  using nebula::meta::NNode;
+  using nebula::surface::eval::IntHistogram;
+
+  // block i covers [i * 10, i * 10 + 9] with values in [i, i + 10]
+  nebula::execution::TableState state{ "test" };
+  std::vector<std::shared_ptr<BatchBlock>> blocks;
+  for (size_t i = 0; i < 5; ++i) {
+    const int64_t v = i;
+    BlockState bs{ 10, 100, { std::make_shared<IntHistogram>(10, v, v + 10, v * 10) } };
+    blocks.push_back(std::make_shared<BatchBlock>(
+      BlockSignature{ "test", i, i * 10, i * 10 + 9, std::to_string(i) }, NNode::inproc(), bs));
+    state.add(blocks.back());
+  }
+
+  auto hist = [&state]() {
+    return std::static_pointer_cast<IntHistogram>(state.hists().at(0));
+  };
+
+  EXPECT_EQ(state.numRows(), 50);
+  EXPECT_EQ(hist()->count, 50);
+  EXPECT_EQ(hist()->v_max, 14);
+
+  // histograms of blocks are not changed by the table
+  EXPECT_EQ(std::static_pointer_cast<IntHistogram>(blocks.front()->state().histograms.at(0))->count, 10);
+
+  // a block in the middle is taken out, and one at the end rebuilds the metrics
+  EXPECT_EQ(state.remove("2"), 1);
+  EXPECT_EQ(state.numBlocks(), 4);
+  EXPECT_EQ(state.rawBytes(), 400);
+  EXPECT_EQ(hist()->count, 40);
+  EXPECT_EQ(hist()->v_sum, 80);
+  EXPECT_EQ(state.remove("4"), 1);
+  EXPECT_EQ(hist()->count, 30);
+  EXPECT_EQ(hist()->v_max, 13);
+  EXPECT_EQ(state.timeWindow(), std::pair<size_t, size_t>(0, 39));
+}
+
+TEST(ExecutionTest, TestTableStateSchemaEvolution) {
+  using nebula::execution::io::BatchBlock;
+  using nebula::meta::BlockSignature;
+  using nebula::meta::BlockState;
+  using nebula::meta::NNode;
+  using nebula::surface::eval::IntHistogram;
+  using nebula::surface::eval::StringHistogram;
+
+  // block "0" has columns (a, b), block "1" of a newer schema drops b and adds c before a
+  nebula::execution::TableState state{ "test" };
+  auto make = [](size_t id, std::vector<std::string> columns, int64_t v) {
+    nebula::surface::eval::HistVector hists;
+    for (const auto& c : columns) {
+      if (c == "b") {
+        hists.push_back(std::make_shared<StringHistogram>(10, "x", "y"));
+      } else {
+        hists.push_back(std::make_shared<IntHistogram>(10, v, v + 10, v * 10));
+      }
+    }
+
+    return std::make_shared<BatchBlock>(BlockSignature{ "test", id, id * 10, id * 10 + 9, std::to_string(id) },
+                                        NNode::inproc(),
+                                        BlockState{ 10, 100, std::move(hists), {}, std::move(columns) });
+  };
+
+  state.add(make(0, { "a", "b" }, 0));
+  state.add(make(1, { "c", "a" }, 5));
+  auto count = [&state](const std::string& col) {
+    auto hist = state.hist(col);
+    return hist ? hist->count : 0;
+  };
+
+  EXPECT_EQ(state.columns(), std::vector<std::string>({ "a", "b", "c" }));
+  EXPECT_EQ(count("a"), 20);
+  EXPECT_EQ(count("b"), 10);
+  EXPECT_EQ(count("c"), 10);
+  EXPECT_EQ(count("d"), 0);
+  EXPECT_EQ(std::static_pointer_cast<IntHistogram>(state.hist("a"))->v_max, 15);
+
+  // a block is taken out by column names too
+  EXPECT_EQ(state.remove("1"), 1);
+  EXPECT_EQ(count("a"), 10);
+  EXPECT_EQ(count("c"), 0);
+}
+
+TEST(ExecutionTest, TestBlockExpiration) {
+  using nebula::execution::io::BatchBlock;
+  using nebula::meta::BlockSignature;
+  using nebula::meta::BlockState;
+  using nebula::meta::NNode;
+
+  // spec i holds blocks ending at i * 100 and i * 100 + 50, the table keeps blocks for 1000 seconds
+  auto bm = nebula::execution::BlockManager::init();
+  const std::string table = "expire.test";
+  bm->retain(table, 1000);
+  for (size_t i = 0; i < 10; ++i) {
+    for (size_t end : { i * 100, i * 100 + 50 }) {
+      bm->add(std::make_shared<BatchBlock>(
+        BlockSignature{ table, end, end, end, std::to_string(i) }, NNode::inproc(), BlockState{ 1, 1, {} }));
+    }
+  }
+
+  EXPECT_EQ(bm->state(table).numBlocks(), 20);
+  EXPECT_TRUE(bm->expire(1000).empty());
+
+  // a spec expires with its latest block
+  auto expired = bm->expire(1200);
+  EXPECT_EQ(expired.size(), 2);
+  EXPECT_EQ(expired.count(std::make_pair(table, std::string("0"))), 1);
+  EXPECT_EQ(expired.count(std::make_pair(table, std::string("1"))), 1);
+  EXPECT_EQ(bm->state(table).numBlocks(), 16);
+
+  // a spec removed otherwise is not expired again
+  EXPECT_EQ(bm->removeBySpec(table, "2"), 2);
+  EXPECT_EQ(bm->expire(1300).size(), 0);
+  EXPECT_EQ(bm->expire(10000).size(), 7);
+  EXPECT_EQ(bm->state(table).numBlocks(), 0);
+}
+
+TEST(ExecutionTest, TestSharedScans) {
+  nebula::execution::core::SharedScans scans;
+  int block = 0;
+  const nebula::execution::core::ScanKey key{ &block, 0, 100, 1 };
+  size_t runs = 0;
+  auto run = [&runs]() { ++runs; };
+
+  // the first query opens a scan, others of the same morsel and priority join it
+  EXPECT_FALSE(scans.join(key, run));
+  EXPECT_TRUE(scans.join(key, run));
+  EXPECT_FALSE(scans.join({ &block, 100, 200, 1 }, run));
+  EXPECT_FALSE(scans.join({ &block, 0, 100, 2 }, run));
+  EXPECT_EQ(scans.pending(), 3);
+
+  // a started scan computes all joined queries, a query coming later opens a new scan
+  for (auto& c : scans.take(key)) {
+    c();
+  }
+  EXPECT_EQ(runs, 2);
+  EXPECT_TRUE(scans.take(key).empty());
+  EXPECT_FALSE(scans.join(key, run));
+  EXPECT_EQ(scans.pending(), 3);
 }
 
 } // namespace test
@@ -14,19 +14,25 @@
  * limitations under the License.
  */
 
+#include <filesystem>
 #include <fmt/format.h>
+#include <fstream>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
 #include "common/Evidence.h"
+#include "execution/meta/Discovery.h"
 #include "execution/meta/TableService.h"
 #include "meta/TestUtils.h"
+#include "storage/NFS.h"
 
 namespace nebula {
 namespace execution {
 namespace test {
 
 using nebula::common::Evidence;
+using nebula::execution::meta::Discovery;
+using nebula::execution::meta::Partition;
 using nebula::execution::meta::TableService;
 using nebula::meta::DataSpec;
 using nebula::meta::NNode;
@@ -96,6 +102,87 @@ TEST(TableServiceTest, TestTableService) {
   }
 }
 
+// a meta db in memory
+class MapDb : public nebula::meta::MetaDb {
+public:
+  virtual bool read(const std::string& key, std::string& value) const override {
+    auto found = kv.find(key);
+    if (found == kv.end()) {
+      return false;
+    }
+
+    value = found->second;
+    return true;
+  }
+
+  virtual bool write(const std::string& key, const std::string& value) override {
+    kv[key] = value;
+    return true;
+  }
+
+  virtual bool backup() noexcept override { return false; }
+  virtual void close() noexcept override {}
+
+  std::unordered_map<std::string, std::string> kv;
+};
+
+TEST(TableServiceTest, TestIncrementalDiscovery) {
+  auto fs = nebula::storage::makeFS("local");
+  auto dir = fs->temp(true);
+
+  // 6 hourly partitions, old ones (first 4) are settled, partition i has i files
+  auto partitions = [&dir](size_t hours) {
+    std::vector<Partition> list;
+    for (size_t i = 0; i < hours; ++i) {
+      list.push_back({ "hr={hour}", fmt::format("{0}/{1}", dir, i), i * 3600, i < 4 });
+    }
+    return list;
+  };
+
+  for (auto i = 0; i < 6; ++i) {
+    auto sub = fmt::format("{0}/{1}", dir, i);
+    std::filesystem::create_directory(sub);
+    for (auto j = 0; j < i; ++j) {
+      std::ofstream(fmt::format("{0}/f{1}", sub, j)).put('a');
+    }
+  }
+
+  MapDb db;
+  Discovery discovery;
+  auto listings = discovery.list(*fs, "local", partitions(6), db);
+  for (size_t i = 0; i < listings.size(); ++i) {
+    EXPECT_EQ(listings.at(i).size(), i);
+  }
+  EXPECT_EQ(discovery.mark("local", "hr={hour}"), 3 * 3600);
+
+  // settled partitions are not listed again, new files show up in the others
+  for (auto i = 0; i < 6; ++i) {
+    std::ofstream(fmt::format("{0}/{1}/new", dir, i)).put('a');
+  }
+
+  listings = discovery.list(*fs, "local", partitions(6), db);
+  for (size_t i = 0; i < listings.size(); ++i) {
+    EXPECT_EQ(listings.at(i).size(), i < 4 ? i : i + 1);
+  }
+
+  // a new discovery (restarted server) picks up the state from meta db
+  Discovery restarted;
+  listings = restarted.list(*fs, "local", partitions(6), db);
+  for (size_t i = 0; i < listings.size(); ++i) {
+    EXPECT_EQ(listings.at(i).size(), i < 4 ? i : i + 1);
+  }
+  EXPECT_EQ(restarted.mark("local", "hr={hour}"), 3 * 3600);
+  EXPECT_EQ(listings.at(1).front().size, 1);
+
+  // partitions out of window are dropped, so they are listed once they come back
+  restarted.list(*fs, "local", partitions(1), db);
+  EXPECT_EQ(restarted.mark("local", "hr={hour}"), 0);
+  listings = restarted.list(*fs, "local", partitions(6), db);
+  EXPECT_EQ(listings.at(3).size(), 4);
+
+  std::filesystem::remove_all(dir);
+}
+
 } // namespace test
 } // namespace execution
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
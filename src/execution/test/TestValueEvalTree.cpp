@@ -300,6 +300,156 @@ TEST(ValueEvalTest, TestEvaluationContext) {
   }
 }
 
+// a block carrying no metadata, used for selection tests only
+class EmptyBlock : public nebula::surface::eval::Block {
+public:
+  nebula::type::Schema schema() const override {
+    return nullptr;
+  }
+  size_t getRows() const override {
+    return 0;
+  }
+  nebula::type::TypeNode columnType(const std::string&) const override {
+    return nullptr;
+  }
+  std::shared_ptr<nebula::surface::eval::Histogram> histogram(const std::string&) const override {
+    return nullptr;
+  }
+  std::vector<std::any> partitionValues(const std::string&) const override {
+    return {};
+  }
+  bool probably(const std::string&, std::any) const override {
+    return true;
+  }
+};
+
+TEST(ValueEvalTest, TestSelection) {
+  // row i has value i in column "a" and NULL in column "x" for even rows
+  constexpr auto size = 10;
+  std::vector<std::unique_ptr<MockRow>> rows;
+  for (auto i = 0; i < size; ++i) {
+    auto row = std::make_unique<MockRow>();
+    EXPECT_CALL(*row, readInt("a")).WillRepeatedly(testing::Return(i));
+    EXPECT_CALL(*row, readInt("x")).WillRepeatedly(testing::Return(i % 2 == 0 ? std::nullopt : std::optional<int32_t>(i)));
+    rows.push_back(std::move(row));
+  }
+
+  const nebula::surface::eval::Seeker seeker = [&rows](size_t row) -> const nebula::surface::Accessor& {
+    return *rows.at(row);
+  };
+
+  EmptyBlock block;
+  EvalContext ctx{ false };
+  auto verify = [&](const ValueEval& filter) {
+    nebula::surface::eval::Selection selection;
+    selection.reset(0, size);
+    filter.select(ctx, block, seeker, selection);
+
+    // batch result should be the same as row by row evaluation
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < size; ++i) {
+      ctx.reset(seeker(i));
+      if (filter.eval<bool>(ctx).value_or(false)) {
+        expected.push_back(i);
+      }
+    }
+
+    EXPECT_EQ(std::vector<size_t>(selection.begin(), selection.end()), expected);
+    return selection.size();
+  };
+
+  using nebula::surface::eval::band;
+  using nebula::surface::eval::bor;
+  using nebula::surface::eval::lt;
+
+  // (a > 2 and a < 8) or a == 9
+  auto f1 = bor<bool, bool>(
+    band<bool, bool>(gt<int, int>(column<int>("a"), constant(2)), lt<int, int>(column<int>("a"), constant(8))),
+    eq<int, int>(column<int>("a"), constant(9)));
+  EXPECT_EQ(verify(*f1), 6);
+
+  // a < 3 or x > 5: NULL on right side doesn't disqualify rows matched by left side
+  auto f2 = bor<bool, bool>(lt<int, int>(column<int>("a"), constant(3)), gt<int, int>(column<int>("x"), constant(5)));
+  EXPECT_EQ(verify(*f2), 5);
+
+  // x > 0 and a > 4: only odd rows have x
+  auto f3 = band<bool, bool>(gt<int, int>(column<int>("x"), constant(0)), gt<int, int>(column<int>("a"), constant(4)));
+  EXPECT_EQ(verify(*f3), 3);
+}
+
+TEST(ValueEvalTest, TestFoldAndOrder) {
+  using nebula::surface::eval::add;
+  using nebula::surface::eval::band;
+  using nebula::surface::eval::bor;
+  using nebula::surface::eval::custom;
+  using nebula::surface::eval::ExpressionType;
+  using nebula::surface::eval::LogicalOp;
+  using nebula::surface::eval::neq;
+
+  // constants are folded
+  auto c = add<int, int, int>(constant(1), constant(2));
+  EXPECT_EQ(c->expressionType(), ExpressionType::CONSTANT);
+  EXPECT_EQ(c->signature(), "C:3");
+  auto a3 = gt<int, int>(column<int>("a"), add<int, int, int>(constant(1), constant(2)));
+  EXPECT_EQ(a3->signature(), "(F:a>C:3)");
+
+  // a constant either decides AND/OR or drops out of it, so does a duplicate predicate
+  auto f1 = band<bool, bool>(constant(true), gt<int, int>(column<int>("a"), constant(3)));
+  EXPECT_EQ(f1->signature(), "(F:a>C:3)");
+  auto f2 = bor<bool, bool>(gt<int, int>(column<int>("a"), constant(3)), constant(true));
+  EXPECT_EQ(f2->signature(), "C:true");
+  auto f3 = band<bool, bool>(gt<int, int>(column<int>("a"), constant(3)), gt<int, int>(column<int>("a"), constant(3)));
+  EXPECT_EQ(f3->signature(), "(F:a>C:3)");
+
+  // a script costs more than comparing a column, and equality rejects more rows than inequality
+  auto f4 = band<bool, bool>(
+    band<bool, bool>(custom<bool>("s", "var s = () => true;"), neq<int, int>(column<int>("a"), constant(1))),
+    eq<int, int>(column<int>("b"), constant(2)));
+  std::vector<const ValueEval*> terms;
+  f4->chain(LogicalOp::AND, terms);
+  ASSERT_EQ(terms.size(), 3);
+  EXPECT_EQ(terms.at(0)->signature(), "(F:b==C:2)");
+  EXPECT_EQ(terms.at(1)->signature(), "(F:a!=C:1)");
+  EXPECT_EQ(terms.at(2)->signature(), "s");
+
+  // OR runs first the predicate accepting more rows
+  terms.clear();
+  auto f5 = bor<bool, bool>(eq<int, int>(column<int>("b"), constant(2)), neq<int, int>(column<int>("a"), constant(1)));
+  f5->chain(LogicalOp::OR, terms);
+  ASSERT_EQ(terms.size(), 2);
+  EXPECT_EQ(terms.at(0)->signature(), "(F:a!=C:1)");
+}
+
+TEST(ValueEvalTest, TestSharedExpression) {
+  using nebula::surface::eval::add;
+
+  // a + 1 is shared by both trees, a column read or a predicate appearing once is not numbered
+  auto f1 = gt<int, int>(add<int, int, int>(column<int>("a"), constant(1)), constant(2));
+  auto f2 = gt<int, int>(add<int, int, int>(column<int>("a"), constant(1)), constant(3));
+  EXPECT_EQ(nebula::surface::eval::number({ f1.get(), f2.get() }), 1);
+  EXPECT_EQ(f1->id(), ValueEval::NO_ID);
+
+  size_t ids = 0;
+  f1->walk([&ids](ValueEval& ve) {
+    if (ve.id() != ValueEval::NO_ID) {
+      EXPECT_EQ(ve.id(), 0);
+      EXPECT_EQ(ve.signature(), "(F:a+C:1)");
+      ++ids;
+    }
+  });
+  EXPECT_EQ(ids, 1);
+
+  // the shared expression reads its column once per row
+  MockRow row;
+  EXPECT_CALL(row, readInt("a")).Times(2).WillRepeatedly(testing::Return(10));
+  EvalContext ctx{ true };
+  for (auto i = 0; i < 2; ++i) {
+    ctx.reset(row);
+    EXPECT_EQ(f1->eval<bool>(ctx), true);
+    EXPECT_EQ(f2->eval<bool>(ctx), true);
+  }
+}
+
 } // namespace test
 } // namespace execution
 } // namespace nebula
\ No newline at end of file
@@ -20,6 +20,7 @@
 #include "common/Hash.h"
 #include "common/Task.h"
 #include "execution/BlockManager.h"
+#include "execution/io/BlockSnapshot.h"
 
 /**
  * Define node server that does the work as nebula server asks.
@@ -59,18 +60,43 @@ public:
 
   bool work() const {
     auto bm = nebula::execution::BlockManager::init();
+    auto snapshot = nebula::execution::io::BlockSnapshot::local();
 
     // process the block expire list
     auto removed = 0;
     for (auto& spec : specs_) {
       // if system has this block, remove it, otherwise skip it
       removed += bm->removeBySpec(spec.first, spec.second);
+
+      // expired spec should not come back from snapshot after restart
+      if (snapshot) {
+        snapshot->remove(spec.first, spec.second);
+      }
     }
 
     LOG(INFO) << "Removed expired specs: " << removed;
     return removed > 0;
   }
 
+  // expire specs past retention of their table in local node by the time index of block manager,
+  // so a node drops its old data by itself without server scanning all its specs.
+  // return number of specs removed.
+  static size_t local(size_t now) {
+    auto expired = nebula::execution::BlockManager::init()->expire(now);
+    auto snapshot = nebula::execution::io::BlockSnapshot::local();
+    if (snapshot) {
+      for (auto& spec : expired) {
+        snapshot->remove(spec.first, spec.second);
+      }
+    }
+
+    if (!expired.empty()) {
+      LOG(INFO) << "Removed specs past retention: " << expired.size();
+    }
+
+    return expired.size();
+  }
+
 private:
   // table-spec pairs
   nebula::common::unordered_set<std::pair<std::string, std::string>> specs_;
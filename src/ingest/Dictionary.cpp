@@ -0,0 +1,107 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Dictionary.h"
+
+#include <glog/logging.h>
+
+#include "common/Evidence.h"
+#include "common/Finally.h"
+#include "storage/NFS.h"
+#include "storage/http/Http.h"
+
+namespace nebula {
+namespace ingest {
+
+using nebula::common::Evidence;
+using nebula::meta::LookupInfo;
+using nebula::meta::LookupTablePtr;
+using nebula::type::Kind;
+
+LookupTablePtr Dictionaries::get(const LookupInfo& lookup) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto now = Evidence::unix_timestamp();
+  auto found = entries_.find(lookup.source);
+  if (found != entries_.end()) {
+    auto& entry = found->second;
+    if (lookup.refresh == 0 || now < entry.loaded + lookup.refresh) {
+      return entry.dictionary;
+    }
+  }
+
+  try {
+    auto dictionary = load(lookup.source);
+    entries_[lookup.source] = Entry{ dictionary, now };
+    return dictionary;
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Failed to load dictionary " << lookup.source << ": " << ex.what();
+  }
+
+  // keep serving the last loaded one, and retry it after another refresh interval
+  if (found != entries_.end()) {
+    found->second.loaded = now;
+    return found->second.dictionary;
+  }
+
+  return nullptr;
+}
+
+std::shared_ptr<const Enrichment> Dictionaries::enrichment(const nebula::meta::Table& table) {
+  const auto& schema = table.schema();
+  auto enrich = std::make_shared<Enrichment>();
+  for (size_t i = 0, size = schema->size(); i < size; ++i) {
+    const auto& name = schema->childType(i)->name();
+    const auto& lookup = table.column(name).lookup;
+    if (!lookup.valid()) {
+      continue;
+    }
+
+    auto key = schema->find(lookup.key);
+    if (schema->childType(i)->k() != Kind::VARCHAR || key == nullptr) {
+      LOG(ERROR) << "Enriched column " << name << " should be a string looked up by a column: " << lookup.key;
+      continue;
+    }
+
+    enrich->emplace(name, Enriched{ lookup.key, key->k(), get(lookup) });
+  }
+
+  return enrich->empty() ? nullptr : enrich;
+}
+
+LookupTablePtr Dictionaries::load(const std::string& source) {
+  auto uri = nebula::storage::parse(source);
+  if (uri.schema.empty()) {
+    return nebula::meta::Lookups::load(source, source);
+  }
+
+  // a remote dictionary is copied to a local temp file to be loaded
+  auto local = nebula::storage::makeFS("local");
+  auto tmp = local->temp();
+  bool copied = false;
+  if (uri.schema == "http" || uri.schema == "https") {
+    nebula::storage::http::HttpService http;
+    copied = http.download(source, {}, {}, tmp);
+  } else {
+    copied = nebula::storage::makeFS(uri.schema, uri.host)->copy(uri.path, tmp);
+  }
+
+  N_ENSURE(copied, fmt::format("failed to copy dictionary {0}", source));
+  nebula::common::Finally cleanup([&local, &tmp]() { local->rm(tmp); });
+  return nebula::meta::Lookups::load(source, tmp);
+}
+
+} // namespace ingest
+} // namespace nebula
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <mutex>
+
+#include "MacroRow.h"
+#include "common/Hash.h"
+#include "meta/Lookup.h"
+#include "meta/Table.h"
+
+/**
+ * Dictionaries enrich ingested rows: a column configured with a lookup gets its value from a dictionary
+ * by the key column of the same row, so expensive transforms of every query turn into one hash lookup per row.
+ * Dictionaries are cached per node by source, a dictionary is loaded once per refresh interval
+ * and shared by all specs and workers ingesting tables using it.
+ */
+namespace nebula {
+namespace ingest {
+
+class Dictionaries {
+private:
+  Dictionaries() = default;
+  Dictionaries(Dictionaries&) = delete;
+  Dictionaries(Dictionaries&&) = delete;
+
+public:
+  virtual ~Dictionaries() = default;
+
+  static Dictionaries& singleton() {
+    static Dictionaries dictionaries;
+    return dictionaries;
+  }
+
+public:
+  // dictionary of the lookup, loaded if not cached or older than its refresh interval
+  // the last loaded dictionary is kept if a reload fails, nullptr if it never loaded
+  nebula::meta::LookupTablePtr get(const nebula::meta::LookupInfo&);
+
+  // enrichment of all lookup columns of a table, nullptr if there is none
+  std::shared_ptr<const Enrichment> enrichment(const nebula::meta::Table&);
+
+private:
+  // read a dictionary from its source
+  static nebula::meta::LookupTablePtr load(const std::string&);
+
+private:
+  struct Entry {
+    nebula::meta::LookupTablePtr dictionary;
+    // unix time in seconds the dictionary loaded
+    size_t loaded;
+  };
+
+  // loads are serialized, so that a dictionary is loaded once by whoever asks first
+  std::mutex mutex_;
+  nebula::common::unordered_map<std::string, Entry> entries_;
+};
+
+} // namespace ingest
+} // namespace nebula
@@ -5,8 +5,12 @@ set(NEBULA_INGEST NIngest)
 
 # build nebula.ingest library
 add_library(${NEBULA_INGEST} STATIC 
+    ${NEBULA_SRC}/ingest/Dictionary.cpp
+    ${NEBULA_SRC}/ingest/IngestMetrics.cpp
     ${NEBULA_SRC}/ingest/IngestSpec.cpp
-    ${NEBULA_SRC}/ingest/SpecRepo.cpp)
+    ${NEBULA_SRC}/ingest/Rollup.cpp
+    ${NEBULA_SRC}/ingest/SpecRepo.cpp
+    ${NEBULA_SRC}/ingest/StreamHead.cpp)
 target_link_libraries(${NEBULA_INGEST}
     PUBLIC ${NEBULA_COMMON}
     PUBLIC ${NEBULA_TYPE}
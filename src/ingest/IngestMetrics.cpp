@@ -0,0 +1,211 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "IngestMetrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <gflags/gflags.h>
+
+#include "common/Memory.h"
+
+DEFINE_uint64(NINGEST_MEMORY_MB, 0, "memory in MB in use over which files are not fetched ahead for ingest, 0 to disable");
+
+/**
+ * Ingest metrics of every spec.
+ */
+namespace nebula {
+namespace ingest {
+
+using nebula::common::Pool;
+using nebula::common::PoolCategory;
+
+static size_t nowMs() noexcept {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::system_clock::now().time_since_epoch())
+    .count();
+}
+
+size_t IngestRecord::duration() const noexcept {
+  const auto last = end == 0 ? nowMs() : end;
+  return last > start ? last - start : 0;
+}
+
+IngestStats::IngestStats(const std::string& table, const std::string& spec)
+  : table_{ table },
+    spec_{ spec },
+    start_{ nowMs() },
+    end_{ 0 },
+    rows_{ 0 },
+    bytes_{ 0 },
+    errors_{ 0 },
+    blocks_{ 0 },
+    lag_{ 0 },
+    throttles_{ 0 },
+    ms_{ 0, 0, 0 } {}
+
+void IngestStats::finish() noexcept {
+  end_.store(nowMs(), std::memory_order_relaxed);
+}
+
+IngestRecord IngestStats::record() const {
+#define LOAD(NAME) NAME##_.load(std::memory_order_relaxed)
+  return IngestRecord{ table_,
+                       spec_,
+                       start_,
+                       LOAD(end),
+                       LOAD(rows),
+                       LOAD(bytes),
+                       LOAD(errors),
+                       LOAD(blocks),
+                       LOAD(lag),
+                       LOAD(throttles),
+                       { ms_[0].load(std::memory_order_relaxed),
+                         ms_[1].load(std::memory_order_relaxed),
+                         ms_[2].load(std::memory_order_relaxed) } };
+#undef LOAD
+}
+
+IngestMetrics& IngestMetrics::singleton() {
+  static IngestMetrics metrics;
+  return metrics;
+}
+
+bool IngestMetrics::tight() noexcept {
+  if (FLAGS_NINGEST_MEMORY_MB == 0) {
+    return false;
+  }
+
+  const auto& pool = Pool::getDefault();
+  size_t used = 0;
+  for (auto category : { PoolCategory::SMALL, PoolCategory::LARGE, PoolCategory::HUGE_PAGE }) {
+    const auto freed = pool.freed(category);
+    const auto total = pool.allocated(category) + pool.extended(category);
+    used += total > freed ? total - freed : 0;
+  }
+
+  return used > FLAGS_NINGEST_MEMORY_MB * 1024 * 1024;
+}
+
+std::shared_ptr<IngestStats> IngestMetrics::begin(const std::string& table, const std::string& spec) {
+  auto stats = std::make_shared<IngestStats>(table, spec);
+  std::lock_guard<std::mutex> lock(mutex_);
+  running_.emplace(stats.get(), stats);
+  return stats;
+}
+
+void IngestMetrics::end(const std::shared_ptr<IngestStats>& stats) {
+  stats->finish();
+  std::lock_guard<std::mutex> lock(mutex_);
+  running_.erase(stats.get());
+  recent_.push_back(stats->record());
+  const auto& r = recent_.back();
+  ++done_.specs;
+  done_.rows += r.rows;
+  done_.bytes += r.bytes;
+  done_.errors += r.errors;
+  done_.throttles += r.throttles;
+  done_.ms += r.duration();
+  if (recent_.size() > MAX_RECENT) {
+    recent_.pop_front();
+  }
+}
+
+std::vector<IngestRecord> IngestMetrics::records() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<IngestRecord> records;
+  records.reserve(running_.size() + recent_.size());
+  for (const auto& item : running_) {
+    records.push_back(item.second->record());
+  }
+
+  records.insert(records.end(), recent_.begin(), recent_.end());
+  return records;
+}
+
+IngestSummary IngestMetrics::totals() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto totals = done_;
+  for (const auto& item : running_) {
+    const auto r = item.second->record();
+    ++totals.specs;
+    ++totals.running;
+    totals.rows += r.rows;
+    totals.bytes += r.bytes;
+    totals.errors += r.errors;
+    totals.lag += r.lag;
+    totals.throttles += r.throttles;
+    totals.ms += r.duration();
+  }
+
+  return totals;
+}
+
+void IngestMetrics::update(const std::string& node, std::vector<IngestRecord> records) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  nodes_[node] = std::move(records);
+}
+
+bool IngestMetrics::running(const std::string& node, const std::string& spec) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = nodes_.find(node);
+  if (found == nodes_.end()) {
+    return false;
+  }
+
+  const auto& records = found->second;
+  return std::any_of(records.begin(), records.end(), [&spec](const IngestRecord& r) {
+    return r.spec == spec && r.end == 0;
+  });
+}
+
+IngestSummary IngestMetrics::summary(const std::string& table) const {
+  IngestSummary summary;
+  auto add = [&summary, &table](const IngestRecord& r) {
+    if (r.table != table) {
+      return;
+    }
+
+    summary.specs++;
+    summary.running += r.end == 0;
+    summary.rows += r.rows;
+    summary.bytes += r.bytes;
+    summary.errors += r.errors;
+    summary.lag += r.lag;
+    summary.throttles += r.throttles;
+    summary.ms += r.duration();
+    for (size_t i = 0; i < r.ms.size(); ++i) {
+      summary.stages[i] += r.ms[i];
+    }
+  };
+
+  // specs ingested in process count too, such as a server acting as a node
+  for (const auto& r : records()) {
+    add(r);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& node : nodes_) {
+    for (const auto& r : node.second) {
+      add(r);
+    }
+  }
+
+  return summary;
+}
+
+} // namespace ingest
+} // namespace nebula
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Ingest metrics of every spec: rows, bytes, errors and kafka lag, as well as time spent in each stage.
+ * A spec being ingested has live counters shared by all its workers, a node keeps them for specs running
+ * and recently done, and reports them to the server by node state polling.
+ * Stage time tells where loads are bound: fetch (waiting for data from network or disk),
+ * parse (reading rows into batches) and build (sealing/compressing blocks).
+ *
+ * Ingest is throttled when memory in use goes beyond NINGEST_MEMORY_MB, files are not fetched ahead then.
+ */
+namespace nebula {
+namespace ingest {
+
+enum class Stage : uint8_t {
+  FETCH = 0,
+  PARSE = 1,
+  BUILD = 2
+};
+
+// a snapshot of metrics of a spec
+struct IngestRecord {
+  std::string table;
+  std::string spec;
+  // unix time in ms, end is 0 while the spec is being ingested
+  size_t start;
+  size_t end;
+  size_t rows;
+  size_t bytes;
+  size_t errors;
+  size_t blocks;
+  // kafka messages behind the head of the partitions when the spec starts
+  size_t lag;
+  // times fetching is held back by memory
+  size_t throttles;
+  // time in ms of every stage, summed across workers
+  std::array<size_t, 3> ms;
+
+  // time in ms from start to end, or to now if running
+  size_t duration() const noexcept;
+};
+
+// live counters of a spec being ingested, shared by all its workers
+class IngestStats {
+public:
+  IngestStats(const std::string& table, const std::string& spec);
+  virtual ~IngestStats() = default;
+
+public:
+#define COUNTER(NAME)                                    \
+  inline void NAME(size_t value) noexcept {              \
+    NAME##_.fetch_add(value, std::memory_order_relaxed); \
+  }
+
+  COUNTER(rows)
+  COUNTER(bytes)
+  COUNTER(errors)
+  COUNTER(blocks)
+  COUNTER(lag)
+  COUNTER(throttles)
+
+#undef COUNTER
+
+  inline void add(Stage stage, size_t ms) noexcept {
+    ms_[static_cast<size_t>(stage)].fetch_add(ms, std::memory_order_relaxed);
+  }
+
+  // spec is done
+  void finish() noexcept;
+
+  IngestRecord record() const;
+
+private:
+  const std::string table_;
+  const std::string spec_;
+  const size_t start_;
+  std::atomic<size_t> end_;
+  std::atomic<size_t> rows_;
+  std::atomic<size_t> bytes_;
+  std::atomic<size_t> errors_;
+  std::atomic<size_t> blocks_;
+  std::atomic<size_t> lag_;
+  std::atomic<size_t> throttles_;
+  std::array<std::atomic<size_t>, 3> ms_;
+};
+
+// metrics of all specs of a table, summed across specs and nodes
+struct IngestSummary {
+  size_t specs = 0;
+  size_t running = 0;
+  size_t rows = 0;
+  size_t bytes = 0;
+  size_t errors = 0;
+  size_t lag = 0;
+  size_t throttles = 0;
+  // duration of all specs in ms
+  size_t ms = 0;
+  std::array<size_t, 3> stages{ 0, 0, 0 };
+
+  inline double rowsPerSecond() const noexcept {
+    return ms == 0 ? 0 : rows * 1000.0 / ms;
+  }
+
+  inline double bytesPerSecond() const noexcept {
+    return ms == 0 ? 0 : bytes * 1000.0 / ms;
+  }
+};
+
+class IngestMetrics {
+public:
+  IngestMetrics() = default;
+  virtual ~IngestMetrics() = default;
+
+  static IngestMetrics& singleton();
+
+  // memory in use is beyond the ingest budget
+  static bool tight() noexcept;
+
+public:
+  // node: counters of a spec starting to ingest, and moves them to recent ones when it is done
+  std::shared_ptr<IngestStats> begin(const std::string&, const std::string&);
+  void end(const std::shared_ptr<IngestStats>&);
+
+  // node: records of specs running and recently done
+  std::vector<IngestRecord> records() const;
+
+  // node: totals of all specs ingested (done or running) by this process since it started
+  IngestSummary totals() const;
+
+  // server: records reported by a node replace the ones before
+  void update(const std::string&, std::vector<IngestRecord>);
+
+  // server: summary of records of a table from all nodes and this process
+  IngestSummary summary(const std::string&) const;
+
+  // server: the node reported the spec is being ingested
+  bool running(const std::string&, const std::string&) const;
+
+private:
+  // recent specs kept in a node
+  static constexpr size_t MAX_RECENT = 256;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<const IngestStats*, std::shared_ptr<IngestStats>> running_;
+  std::deque<IngestRecord> recent_;
+  // totals of all specs done
+  IngestSummary done_;
+  std::unordered_map<std::string, std::vector<IngestRecord>> nodes_;
+};
+
+} // namespace ingest
+} // namespace nebula
@@ -16,22 +16,37 @@
 
 #include "IngestSpec.h"
 
+#include <algorithm>
+#include <atomic>
+#include <future>
 #include <gflags/gflags.h>
 #include <gperftools/heap-profiler.h>
+#include <mutex>
 #include <rapidjson/document.h>
+#include <thread>
 
-#include "MacroRow.h"
+#include "Dictionary.h"
+#include "IngestMetrics.h"
+#include "Rollup.h"
+#include "RowFilter.h"
+#include "StreamHead.h"
 #include "common/Evidence.h"
+#include "common/Numa.h"
 #include "execution/BlockManager.h"
+#include "execution/io/BlockSnapshot.h"
 #include "execution/meta/TableService.h"
+#include "memory/Synthetic.h"
 #include "meta/Macro.h"
 #include "meta/TestTable.h"
 #include "storage/CsvReader.h"
+#include "storage/Decompress.h"
+#include "storage/Fetch.h"
 #include "storage/JsonReader.h"
 #include "storage/NFS.h"
 #include "storage/ParquetReader.h"
 #include "storage/VectorReader.h"
 #include "storage/http/Http.h"
+#include "storage/kafka/KafkaConfig.h"
 #include "storage/kafka/KafkaReader.h"
 #include "type/Serde.h"
 
@@ -39,6 +54,21 @@
 // table-wise customization
 DEFINE_string(NTEST_LOADER, "NebulaTest", "define the loader name for loading nebula test data");
 DEFINE_uint64(NBLOCK_MAX_ROWS, 1000000, "max rows per block");
+DEFINE_uint64(NBLOCK_TARGET_MB, 256, "a block is sealed once its data allocates this many MB, 0 to seal blocks by rows only");
+DEFINE_uint32(NBLOCKS_PER_CORE, 2, "a spec is cut into blocks small enough to make this many blocks for every core, 0 to disable");
+DEFINE_uint32(NPARQUET_WORKERS, 0, "max threads decoding row groups of a parquet file in parallel, 0 for all cores");
+DEFINE_uint32(NCSV_WORKERS, 0, "max threads parsing ranges of a csv file in parallel, 0 for all cores");
+DEFINE_uint64(NCSV_SPLIT_MB, 64, "min size in MB of a csv file range parsed by one thread");
+DEFINE_uint32(NINGEST_DOWNLOADS, 2, "max files of a spec downloaded ahead of the one being parsed");
+DEFINE_bool(NSTREAM_PARQUET, true, "read remote parquet files by ranges in place rather than local copies");
+DEFINE_bool(NHTTP_STREAM, true, "parse csv/json bodies of HTTP sources while they are received rather than downloaded");
+DEFINE_uint64(NHTTP_BUFFER_KB, 8192, "max size in KB of a HTTP body received and not parsed yet");
+DEFINE_bool(NSTREAM_COMPRESSED, true, "read remote compressed csv/json files as decompressed streams rather than local copies");
+DEFINE_uint32(NHOT_HOURS,
+              0,
+              "specs with data older than these hours are registered by their snapshot metadata and loaded when queried, "
+              "0 to load all specs");
+DEFINE_uint32(NKAFKA_WORKERS, 0, "max threads consuming partitions of a kafka spec in parallel, 0 for all cores");
 
 /**
  * We will sync etcd configs for cluster info into this memory object
@@ -55,6 +85,7 @@ using nebula::execution::BlockManager;
 using nebula::execution::io::BatchBlock;
 using nebula::execution::io::BlockList;
 using nebula::execution::io::BlockLoader;
+using nebula::execution::io::BlockSnapshot;
 using nebula::execution::meta::TableService;
 using nebula::memory::Batch;
 using nebula::meta::BessType;
@@ -65,15 +96,21 @@ using nebula::meta::Macro;
 using nebula::meta::SpecSplitPtr;
 using nebula::meta::Table;
 using nebula::meta::TablePtr;
+using nebula::meta::TableSpec;
 using nebula::meta::TableSpecPtr;
 using nebula::meta::TestTable;
 using nebula::meta::TimeSpec;
 using nebula::meta::TimeType;
+using nebula::storage::Compression;
+using nebula::storage::compressionOf;
 using nebula::storage::CsvReader;
+using nebula::storage::InputStream;
 using nebula::storage::JsonVectorReader;
 using nebula::storage::makeJsonReader;
 using nebula::storage::ParquetReader;
 using nebula::storage::http::HttpService;
+using nebula::storage::http::HttpStream;
+using nebula::storage::kafka::KafkaConfig;
 using nebula::storage::kafka::KafkaReader;
 using nebula::storage::kafka::KafkaSegment;
 using nebula::surface::RowCursor;
@@ -87,6 +124,460 @@ static constexpr auto LOADER_API = "Api";
 
 // a settings to overwrite batch size of a table
 static constexpr auto BATCH_SIZE = "batch";
+static constexpr auto COMPRESSION = "compression";
+
+// settings of a test table to generate synthetic rows by its own schema, see nebula::memory::Synthetic::parse
+// rows of every block and number of blocks, which are generated on all cores
+static constexpr auto SYNTHETIC = "synthetic";
+static constexpr auto SYNTHETIC_ROWS = "synthetic.rows";
+static constexpr auto SYNTHETIC_BLOCKS = "synthetic.blocks";
+
+// a settings to sort rows of every batch of a table by an integer column (usually _time_) before it's sealed
+static constexpr auto SORT = "sort";
+
+// compression of a source file by the table setting or its path, an unknown setting is taken as no compression
+static Compression compression(const nebula::meta::TableSpec& table, const std::string& path) noexcept {
+  try {
+    auto itr = table.settings.find(COMPRESSION);
+    return compressionOf(path, itr == table.settings.end() ? "" : itr->second);
+  } catch (const std::exception& exp) {
+    LOG(ERROR) << "Invalid compression of table " << table.name << ": " << exp.what();
+    return Compression::NONE;
+  }
+}
+
+// seal a batch, and compress it if all its rows are older than the compression age of the table
+static void seal(Batch& batch, const nebula::meta::TableSpec& spec, size_t highTime) {
+  batch.seal();
+  if (spec.compress_seconds > 0 && highTime + spec.compress_seconds < Evidence::unix_timestamp()) {
+    batch.compress();
+  }
+}
+
+// collects rows of a spec into partitioned batches and rollups, a full batch or rollup is pushed as a block.
+// rows meeting conditions of a derived table go to a sink of the derived table as well.
+// block ids are drawn from a counter shared by all sinks of the spec.
+// a sink also accounts time of its worker into stats of the spec when it is flushed.
+class BlockSink {
+  struct Derived {
+    TablePtr table;
+    RowFilter filter;
+    std::unique_ptr<BlockSink> sink;
+  };
+
+  // bytes of a batch are checked every these rows while rows are added one by one
+  static constexpr size_t CHECK_ROWS = 4096;
+
+public:
+  // a batch is sealed when it has max rows or its data allocates given bytes, 0 bytes for rows only.
+  // a sink of a derived table, given the derived spec, keeps batches of the rows only
+  BlockSink(const nebula::meta::TableSpec& spec,
+            const TablePtr& table,
+            const std::string& specId,
+            size_t rows,
+            size_t bytes,
+            std::atomic<size_t>& blockId,
+            IngestStats& stats,
+            const nebula::meta::DerivedSpec* derived = nullptr)
+    : spec_{ spec },
+      table_{ table },
+      specId_{ specId },
+      pod_{ table->pod() },
+      rows_{ rows },
+      bytes_{ bytes },
+      fit_{ rows },
+      blockId_{ blockId },
+      range_{ std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() },
+      stats_{ stats },
+      busyMs_{ 0 },
+      fetchMs_{ 0 },
+      buildMs_{ 0 } {
+    if (derived != nullptr) {
+      return;
+    }
+
+    rollups_.reserve(spec.rollups.size());
+    for (const auto& r : spec.rollups) {
+      rollups_.push_back(std::make_unique<Rollup>(spec, r));
+    }
+
+    // conditions of derived tables are on source columns, a derived sink refers to the table it holds
+    if (!spec.derived.empty()) {
+      const auto schema = TypeSerializer::from(spec.schema);
+      derived_.reserve(spec.derived.size());
+      for (const auto& d : spec.derived) {
+        auto& entry = derived_.emplace_back(Derived{ spec.to(d), RowFilter(d.filters, schema), nullptr });
+        entry.sink = std::make_unique<BlockSink>(spec, entry.table, specId, rows, bytes, blockId, stats, &d);
+      }
+    }
+  }
+
+  void add(const RowData& row) {
+    // for non-partitioned, all batch's pid will be 0
+    size_t pid = 0;
+    BessType bess = -1;
+    if (pod_) {
+      pid = pod_->pod(row, bess);
+    }
+
+    // get the batch
+    auto& batch = batches_[pid];
+    if (batch == nullptr) {
+      batch = make(pid);
+    }
+
+    // if this is already full
+    const auto rows = batch->getRows();
+    if (rows >= rows_ || (rows % CHECK_ROWS == 0 && oversize(*batch))) {
+      // move it to the manager and make a new batch
+      blocks_.push_front(block(batch));
+      batch = make(pid);
+      range_ = { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() };
+    }
+
+    // update time range before adding the row to the batch
+    // get time column value
+    size_t time = row.readLong(Table::TIME_COLUMN);
+    if (time < range_.first) {
+      range_.first = time;
+    }
+
+    if (time > range_.second) {
+      range_.second = time;
+    }
+
+    // add a new entry
+    batch->add(row, bess);
+
+    for (auto& rollup : rollups_) {
+      rollup->add(row);
+      if (rollup->size() >= rows_) {
+        blocks_.push_front(block(*rollup));
+      }
+    }
+
+    for (auto& d : derived_) {
+      if (d.filter.match(row)) {
+        d.sink->add(row);
+      }
+    }
+  }
+
+  // rows to fill the batch of a non-partitioned table, a full batch is replaced by a new one on next add
+  size_t room() {
+    auto found = batches_.find(0);
+    if (found == batches_.end() || found->second->getRows() >= rows_ || oversize(*found->second)) {
+      return rows_;
+    }
+
+    return rows_ - found->second->getRows();
+  }
+
+  // add rows column by column into the batch of a non-partitioned table without rollups or derived tables
+  // times are values of the time column, no more rows than room() are given
+  void add(const std::vector<nebula::memory::ColumnVector>& columns, size_t rows, const int64_t* times) {
+    auto& batch = batches_[0];
+    if (batch == nullptr) {
+      batch = make(0);
+    }
+
+    if (batch->getRows() >= rows_ || oversize(*batch)) {
+      blocks_.push_front(block(batch));
+      batch = make(0);
+      range_ = { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() };
+    }
+
+    N_ENSURE_LE(batch->getRows() + rows, rows_, "rows exceed room of the batch");
+    for (size_t i = 0; i < rows; ++i) {
+      const size_t time = times[i];
+      range_.first = std::min(range_.first, time);
+      range_.second = std::max(range_.second, time);
+    }
+
+    batch->add(columns, rows);
+  }
+
+  // time in ms spent in reading rows into this sink, including fetching and building blocks in between
+  inline void busy(size_t ms) noexcept {
+    busyMs_ += ms;
+  }
+
+  // time in ms waiting for data while reading rows
+  inline void fetched(size_t ms) noexcept {
+    fetchMs_ += ms;
+  }
+
+  // push all batches and rollups left into given blocks, along with all blocks built so far
+  void flush(BlockList& blocks) {
+    // rows are parsed in the busy time except fetching and building
+    stats_.add(Stage::FETCH, fetchMs_);
+    stats_.add(Stage::PARSE, busyMs_ > fetchMs_ + buildMs_ ? busyMs_ - fetchMs_ - buildMs_ : 0);
+
+    // TODO(cao) - the block maybe too small
+    // to waste lots of memory especially in case of sparse storage
+    // we need to try to compress them if useful to save memory
+    for (auto& itr : batches_) {
+      blocks_.push_front(block(itr.second));
+    }
+    batches_.clear();
+
+    for (auto& rollup : rollups_) {
+      if (rollup->size() > 0) {
+        blocks_.push_front(block(*rollup));
+      }
+    }
+
+    for (auto& d : derived_) {
+      d.sink->flush(blocks_);
+    }
+
+    stats_.add(Stage::BUILD, buildMs_);
+    busyMs_ = fetchMs_ = buildMs_ = 0;
+    blocks.splice_after(blocks.before_begin(), blocks_);
+  }
+
+private:
+  // a new batch reserves rows a batch of this sink is expected to hold
+  inline std::shared_ptr<Batch> make(size_t pid) const {
+    return std::make_shared<Batch>(*table_, fit_, pid);
+  }
+
+  // a batch with rows allocating target bytes is full, its rows are expected by next batches
+  inline bool oversize(const Batch& batch) {
+    const auto rows = batch.getRows();
+    if (bytes_ == 0 || rows == 0 || batch.allocation() < bytes_) {
+      return false;
+    }
+
+    fit_ = rows;
+    return true;
+  }
+
+  std::shared_ptr<BatchBlock> block(std::shared_ptr<Batch> b) {
+    // seal the block, rows are sorted first if the table asks for it
+    Evidence::Duration timer;
+    auto sort = spec_.settings.find(SORT);
+    if (sort != spec_.settings.end()) {
+      auto sorted = b->sorted(*table_, sort->second);
+      if (sorted) {
+        b = std::move(sorted);
+      }
+    }
+
+    seal(*b, spec_, range_.second);
+    buildMs_ += timer.elapsedMs();
+    stats_.rows(b->getRows());
+    stats_.blocks(1);
+    LOG(INFO) << "Push a block: " << b->state();
+
+    // build up a block signature with table name, sequence and spec
+    return BlockLoader::from(
+      BlockSignature{ table_->name(), blockId_++, range_.first, range_.second, specId_ }, b);
+  }
+
+  std::shared_ptr<BatchBlock> block(Rollup& rollup) {
+    auto b = rollup.batch();
+    const auto& range = rollup.range();
+    Evidence::Duration timer;
+    seal(*b, spec_, range.second);
+    buildMs_ += timer.elapsedMs();
+    stats_.blocks(1);
+    LOG(INFO) << "Push a rollup block: " << b->state();
+    return BlockLoader::from(
+      BlockSignature{ rollup.table()->name(), blockId_++, range.first, range.second, specId_ }, b);
+  }
+
+private:
+  const nebula::meta::TableSpec& spec_;
+  const TablePtr& table_;
+  const std::string& specId_;
+  std::shared_ptr<nebula::meta::Pod> pod_;
+  const size_t rows_;
+  const size_t bytes_;
+  size_t fit_;
+  std::atomic<size_t>& blockId_;
+  std::unordered_map<size_t, std::shared_ptr<Batch>> batches_;
+  std::vector<std::unique_ptr<Rollup>> rollups_;
+  std::vector<Derived> derived_;
+  std::pair<size_t, size_t> range_;
+  BlockList blocks_;
+
+  // worker time accounted to stats on flush
+  IngestStats& stats_;
+  size_t busyMs_;
+  size_t fetchMs_;
+  size_t buildMs_;
+};
+
+// decode a parquet file by typed batches and append them into the sink column by column.
+// only simple tables qualify: no partition, no rollup or derived table, no ingest filter, no macro column,
+// and time is not parsed from strings.
+// return false without reading any row if the table or the file doesn't qualify.
+static bool ingestColumns(ParquetReader& reader,
+                          const nebula::meta::TableSpec& spec,
+                          const TablePtr& table,
+                          const nebula::type::Schema& schema,
+                          MacroRow& macroRow,
+                          BlockSink& sink) {
+  if (table->pod() != nullptr || !spec.rollups.empty() || !spec.derived.empty() || !spec.filters.empty()) {
+    return false;
+  }
+
+  // time column is decoded along with other columns
+  const auto& ts = spec.timeSpec;
+  size_t scale = 0;
+  if (ts.type == TimeType::COLUMN) {
+    auto type = schema->find(ts.column);
+    scale = MacroRow::unixScale(ts.pattern);
+    if (scale == 0 || type == nullptr
+        || (type->k() != nebula::type::Kind::BIGINT && type->k() != nebula::type::Kind::INTEGER)) {
+      return false;
+    }
+  } else if (ts.type != TimeType::STATIC && ts.type != TimeType::CURRENT && ts.type != TimeType::MACRO) {
+    return false;
+  }
+
+  // columns to decode in order of the table schema, time column is the last if present
+  const auto& tableSchema = table->schema();
+  std::vector<std::string> names;
+  names.reserve(tableSchema->size());
+  for (size_t i = 0, size = tableSchema->size(); i < size; ++i) {
+    const auto& name = tableSchema->childType(i)->name();
+    if (name == Table::TIME_COLUMN) {
+      continue;
+    }
+
+    if (!table->fromMacro(name).empty() || table->column(name).lookup.valid()) {
+      return false;
+    }
+
+    names.push_back(name);
+  }
+
+  if (scale > 0) {
+    names.push_back(ts.column);
+  }
+
+  if (!reader.columnar(names)) {
+    return false;
+  }
+
+  static constexpr size_t CHUNK = 4096;
+  std::vector<nebula::storage::ParquetColumn> columns;
+  std::vector<nebula::memory::ColumnVector> vectors(tableSchema->size(), nebula::memory::ColumnVector{ nullptr, nullptr });
+  std::vector<int64_t> times;
+  size_t rows = 0;
+  while ((rows = reader.read(names, std::min(CHUNK, sink.room()), columns)) > 0) {
+    // time of every row
+    times.resize(rows);
+    if (scale > 0) {
+      // null time is 1 as the row path does
+      const auto& time = columns.back();
+      for (size_t r = 0; r < rows; ++r) {
+        if (time.isNull(r)) {
+          times[r] = 1;
+          continue;
+        }
+
+        const auto value = time.kind == nebula::type::Kind::BIGINT
+                             ? reinterpret_cast<const int64_t*>(time.values.data())[r]
+                             : reinterpret_cast<const int32_t*>(time.values.data())[r];
+        times[r] = (size_t)value / scale;
+      }
+    } else {
+      std::fill(times.begin(), times.end(), macroRow.set(nullptr).readLong(Table::TIME_COLUMN));
+    }
+
+    for (size_t i = 0, c = 0, size = vectors.size(); i < size; ++i) {
+      vectors[i] = tableSchema->childType(i)->name() == Table::TIME_COLUMN
+                     ? nebula::memory::ColumnVector{ times.data(), nullptr }
+                     : columns.at(c++).vector();
+    }
+
+    sink.add(vectors, rows, times.data());
+  }
+
+  return true;
+}
+
+// bytes of data a block allocates before it is sealed, 0 if blocks are sealed by rows only.
+// a spec of given input bytes makes at least NBLOCKS_PER_CORE blocks for every core if it is big enough,
+// so that it is scanned by all cores, while blocks too small to pay off their overhead are not made.
+static size_t blockBytes(size_t specBytes) {
+  constexpr size_t MIN_BLOCK_BYTES = 8 * 1024 * 1024;
+  const size_t target = FLAGS_NBLOCK_TARGET_MB * 1024 * 1024;
+  if (target == 0 || FLAGS_NBLOCKS_PER_CORE == 0 || specBytes == 0) {
+    return target;
+  }
+
+  const size_t blocks = FLAGS_NBLOCKS_PER_CORE * std::max(1u, std::thread::hardware_concurrency());
+  return std::clamp(specBytes / blocks, std::min(MIN_BLOCK_BYTES, target), target);
+}
+
+// run workers in parallel, each adds rows into its own sink, all blocks are moved into given blocks at the end.
+// rows added by a worker before any failure are kept as a sequential reader does
+static void parallel(const nebula::meta::TableSpec& spec,
+                     const TablePtr& table,
+                     const std::string& specId,
+                     size_t rows,
+                     size_t bytes,
+                     size_t workers,
+                     std::atomic<size_t>& blockId,
+                     BlockList& blocks,
+                     IngestStats& stats,
+                     const std::function<void(size_t, BlockSink&)>& work) {
+  std::vector<BlockList> lists(workers);
+  std::vector<std::thread> threads;
+  threads.reserve(workers);
+  for (size_t w = 0; w < workers; ++w) {
+    threads.emplace_back([&, w]() {
+      BlockSink sink(spec, table, specId, rows, bytes, blockId, stats);
+      Evidence::Duration timer;
+      try {
+        work(w, sink);
+      } catch (const std::exception& exp) {
+        LOG(ERROR) << "Exception in ingestion worker " << w << " of table " << spec.name << ", exception: " << exp.what();
+        stats.errors(1);
+      }
+
+      sink.busy(timer.elapsedMs());
+      sink.flush(lists[w]);
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  for (auto& list : lists) {
+    blocks.splice_after(blocks.before_begin(), list);
+  }
+}
+
+// move blocks of a spec into block manager, they are saved in local snapshot too if it is enabled,
+// and backed up to the backup location of the table if it has one
+// replace - blocks published by the streaming heads of the spec are replaced by these blocks in one step
+static size_t commit(const TableSpec& table, const std::string& spec, BlockList& blocks, bool replace = false) {
+  // a spec out of raw retention is still ingested for rollups kept longer, its raw blocks are dropped
+  if (table.max_seconds > 0 && table.horizon() > table.max_seconds) {
+    const auto earliest = Evidence::unix_timestamp() - table.max_seconds;
+    blocks.remove_if([&table, earliest](const auto& b) { return b->table() == table.name && b->end() < earliest; });
+  }
+
+  auto snapshot = BlockSnapshot::local();
+  if (snapshot) {
+    snapshot->save(table.name, spec, blocks, table.backup);
+  }
+
+  auto bm = BlockManager::init();
+  if (replace) {
+    const size_t count = std::distance(blocks.begin(), blocks.end());
+    bm->swap(table.name, spec, [](const BatchBlock&) { return true; }, blocks);
+    return count;
+  }
+
+  return bm->add(blocks);
+}
 
 // load some nebula test data into current process
 void loadNebulaTestData(const TableSpecPtr& table, const std::string& spec) {
@@ -99,8 +590,38 @@ void loadNebulaTestData(const TableSpecPtr& table, const std::string& spec) {
   auto end = start + table->max_seconds;
 
   // let's plan these many data std::thread::hardware_concurrency()
-  TestTable testTable;
   auto numBlocks = std::thread::hardware_concurrency();
+  const auto& settings = table->settings;
+  auto synthetic = settings.find(SYNTHETIC);
+  if (synthetic != settings.end()) {
+    auto setting = [&settings](const char* key, size_t value) {
+      auto found = settings.find(key);
+      return found == settings.end() ? value : std::stoul(found->second);
+    };
+
+    const auto rows = setting(SYNTHETIC_ROWS, FLAGS_NBLOCK_MAX_ROWS);
+    const auto blocks = setting(SYNTHETIC_BLOCKS, numBlocks);
+    const auto schema = TableService::singleton()->query(table->name).table();
+    nebula::memory::Synthetic generator{ *schema, { start, end }, nebula::memory::Synthetic::parse(synthetic->second) };
+
+    // a block generates a batch for every partition, all of them are added at once
+    std::mutex mutex;
+    BlockList list;
+    std::atomic<size_t> id{ 0 };
+    generator.generate(
+      blocks, rows, Evidence::unix_timestamp(), numBlocks, [&](size_t block, std::shared_ptr<Batch> batch) {
+        batch->seal();
+        const size_t begin = start + (end - start) * block / blocks;
+        const size_t last = start + (end - start) * (block + 1) / blocks;
+        auto b = BlockLoader::from(BlockSignature{ table->name, id++, begin, last, spec }, batch);
+        std::lock_guard<std::mutex> lock(mutex);
+        list.push_front(b);
+      });
+
+    LOG(INFO) << "Generated synthetic blocks of table " << table->name << ": " << bm->add(list);
+    return;
+  }
+
   auto window = (end - start) / numBlocks;
   for (unsigned i = 0; i < numBlocks; i++) {
     size_t begin = start + i * window;
@@ -110,6 +631,18 @@ void loadNebulaTestData(const TableSpecPtr& table, const std::string& spec) {
 }
 
 size_t IngestSpec::work() noexcept {
+  // metrics of the spec are reported in node state while it is running and for a while after it's done
+  auto& metrics = IngestMetrics::singleton();
+  stats_ = metrics.begin(table_->name, id_);
+
+  // blocks of a spec are built on one NUMA node, specs are spread over all nodes
+  nebula::common::Numa::Scope numa{ nebula::common::Numa::singleton().next() };
+  const auto numBlocks = this->run();
+  metrics.end(stats_);
+  return numBlocks;
+}
+
+size_t IngestSpec::run() noexcept {
   // register the table in the working node
   // in case it is the first time
   auto registry = TableService::singleton()->get(table_);
@@ -121,6 +654,49 @@ size_t IngestSpec::work() noexcept {
     return 1;
   }
 
+  // blocks of the spec expire in this node once they are older than the table keeps
+  // a rollup kept for its own retention is a coarser tier outliving raw rows
+  auto bm = BlockManager::init();
+  bm->retain(table_->name, table_->max_seconds);
+  for (const auto& rollup : table_->rollups) {
+    if (rollup.retention > 0) {
+      bm->retain(TableSpec::rollupName(table_->name, rollup.name), rollup.retention);
+    }
+  }
+
+  // a restarted node reloads the spec from its local snapshot rather than the data source
+  auto snapshot = BlockSnapshot::local();
+  if (snapshot && FLAGS_NHOT_HOURS > 0) {
+    // a spec with all data out of hot horizon is registered by metadata only, its blocks are hydrated
+    // from local snapshot or backup when queries touch them
+    auto stubs = snapshot->stubs(table_->name, id_, table_->backup);
+    const auto horizon = Evidence::unix_timestamp() - FLAGS_NHOT_HOURS * Evidence::HOUR_SECONDS;
+    const auto cold = std::all_of(stubs.begin(), stubs.end(), [horizon](const auto& b) { return b->end() < horizon; });
+    if (!stubs.empty() && cold) {
+      bm->removeBySpec(table_->name, id_);
+      const auto numBlocks = bm->add(stubs);
+      LOG(INFO) << "Registered " << numBlocks << " blocks of spec " << id_ << " by metadata.";
+      return numBlocks;
+    }
+  }
+
+  if (snapshot) {
+    auto blocks = snapshot->load(
+      table_->name,
+      id_,
+      [](const std::string& name) { return TableService::singleton()->query(name).table(); },
+      [this](Batch& batch, const BlockSignature& sign) { seal(batch, *table_, sign.end); });
+    if (!blocks.empty()) {
+      for (const auto& b : blocks) {
+        bm->removeBySpec(b->table(), b->spec());
+      }
+
+      const auto numBlocks = bm->add(blocks);
+      LOG(INFO) << "Restored " << numBlocks << " blocks of spec " << id_ << " from snapshot.";
+      return numBlocks;
+    }
+  }
+
   // either swap, they are reading files
   if (loader == LOADER_SWAP) {
     return this->loadSwap();
@@ -136,7 +712,7 @@ size_t IngestSpec::work() noexcept {
   }
 
   if (DataSource::KAFKA == table_->source) {
-    return this->loadKafka(split());
+    return this->loadKafka(splits());
   }
 
   if (DataSource::ROCKSET == table_->source) {
@@ -147,38 +723,114 @@ size_t IngestSpec::work() noexcept {
   return 0;
 }
 
-bool IngestSpec::load(BlockList& blocks) noexcept {
-  // if domain is present - assume it's S3 file
-  auto fs = nebula::storage::makeFS(dsu::getProtocol(table_->source), domain_, table_->settings);
-  auto localFs = nebula::storage::makeFS("local");
-
-  // attach a local file to each split
-  for (auto& split : splits_) {
-    // attach a local file for this split
-    split->local = localFs->temp();
+// downloads files of splits to local temp files ahead of parsing.
+// at most `window` files are downloaded while one is being parsed, so network of next files overlaps cpu of
+// current one, and disk taken by temp files is bounded since a file is removed once its split is read.
+// nothing is downloaded ahead when memory is tight, so fetching slows down to the pace of building batches.
+class SplitDownloads {
+public:
+  SplitDownloads(nebula::storage::NFileSystem& fs,
+                 const std::vector<SpecSplitPtr>& splits,
+                 size_t window,
+                 IngestStats& stats)
+    : fs_{ fs },
+      local_{ nebula::storage::makeFS("local") },
+      splits_{ splits },
+      window_{ std::max<size_t>(window, 1) },
+      stats_{ stats },
+      next_{ 0 } {
+    downloads_.reserve(splits.size());
+  }
 
-    // there might be S3 error which returns tmpFile as empty
-    if (!fs->copy(split->path, split->local)) {
-      LOG(WARNING) << "Failed to copy file to local: " << split->path;
-      continue;
+  ~SplitDownloads() {
+    for (size_t i = 0; i < next_; ++i) {
+      release(i);
     }
   }
 
-  // check if data blocks with the same ingest ID exists
-  // since it is a swap loader, we will remove those blocks
-  bool result = this->ingest(blocks);
+  // wait for the file of the split at given index, return true if it is downloaded
+  bool wait(size_t index) {
+    // splits are read in order, files of the ones before are not needed any more
+    for (size_t i = 0; i < index && i < next_; ++i) {
+      release(i);
+    }
+
+    // nothing is downloaded ahead of the split waited when memory is tight
+    auto window = window_;
+    if (IngestMetrics::tight()) {
+      window = 0;
+      stats_.throttles(1);
+    }
+
+    for (; next_ < splits_.size() && next_ <= index + window; ++next_) {
+      auto& split = splits_.at(next_);
+      split->local = local_->temp();
+      // downloads of all specs share the fetch pool
+      downloads_.push_back(nebula::storage::FetchPool::singleton().submit([this, split]() {
+        return fs_.copy(split->path, split->local);
+      }));
+    }
+
+    auto& download = downloads_.at(index);
+    auto done = download.valid() ? std::move(download).getTry() : folly::Try<bool>(false);
+    if (!done.hasValue() || !done.value()) {
+      LOG(WARNING) << "Failed to copy file to local: " << splits_.at(index)->path;
+      return false;
+    }
+
+    return true;
+  }
 
+private:
   // NOTE: assuming tmp file is created by mkstemp API
   // we unlink it for os to recycle it (linux), ignoring the result
   // https://stackoverflow.com/questions/32445579/when-a-file-created-with-mkstemp-is-deleted
-  for (auto& split : splits_) {
-    unlink(split->local.c_str());
-    split->local.resize(0);
+  void release(size_t index) {
+    auto& download = downloads_.at(index);
+    if (download.valid()) {
+      download.wait();
+    }
+
+    auto& split = splits_.at(index);
+    if (!split->local.empty()) {
+      unlink(split->local.c_str());
+      split->local.resize(0);
+    }
   }
 
-  // swap each of the blocks into block manager
-  // as long as they share the same table / spec
-  return result;
+private:
+  nebula::storage::NFileSystem& fs_;
+  std::unique_ptr<nebula::storage::NFileSystem> local_;
+  const std::vector<SpecSplitPtr>& splits_;
+  std::vector<folly::Future<bool>> downloads_;
+  const size_t window_;
+  IngestStats& stats_;
+
+  // index of the next split to download
+  size_t next_;
+};
+
+bool IngestSpec::load(BlockList& blocks) noexcept {
+  // if domain is present - assume it's S3 file
+  auto fs = nebula::storage::makeFS(dsu::getProtocol(table_->source), domain_, table_->settings);
+
+  // parquet readers seek to footer and column chunks of a remote file, so it is not copied
+  if (FLAGS_NSTREAM_PARQUET && table_->format == DataFormat::PARQUET && table_->source != DataSource::LOCAL) {
+    return this->ingest(blocks, fs.get());
+  }
+
+  // compressed csv/json files are read through decompressed streams as they can't be split for parallel parsing
+  if (FLAGS_NSTREAM_COMPRESSED && table_->source != DataSource::LOCAL
+      && (table_->format == DataFormat::CSV || table_->format == DataFormat::JSON)
+      && std::all_of(splits_.begin(), splits_.end(), [this](const SpecSplitPtr& split) {
+           return compression(*table_, split->path) != Compression::NONE;
+         })) {
+    return this->ingest(blocks, fs.get());
+  }
+
+  // every file is downloaded while files before it are parsed
+  SplitDownloads downloads(*fs, splits_, FLAGS_NINGEST_DOWNLOADS, *stats_);
+  return this->ingest(blocks, nullptr, [&downloads](size_t index) { return downloads.wait(index); });
 }
 
 size_t IngestSpec::loadSwap() noexcept {
@@ -206,7 +858,7 @@ size_t IngestSpec::loadSwap() noexcept {
       }
 
       // move all new blocks in
-      numBlocks = bm->add(blocks);
+      numBlocks = commit(*table_, id_, blocks);
     }
 
     return numBlocks;
@@ -223,9 +875,8 @@ size_t IngestSpec::loadRoll() noexcept {
     size_t numBlocks = 0;
     auto result = this->load(blocks);
     if (result) {
-      auto bm = BlockManager::init();
       // move all new blocks in
-      numBlocks = bm->add(blocks);
+      numBlocks = commit(*table_, id_, blocks);
     }
 
     return numBlocks;
@@ -254,9 +905,8 @@ size_t IngestSpec::loadApi() noexcept {
   }
 
   if (result) {
-    auto bm = BlockManager::init();
     // move all new blocks in
-    numBlocks = bm->add(blocks);
+    numBlocks = commit(*table_, id_, blocks);
   }
 
   return numBlocks;
@@ -269,12 +919,6 @@ bool IngestSpec::loadHttp(BlockList& blocks,
                           SpecSplitPtr split,
                           std::vector<std::string> headers,
                           std::string_view data) noexcept {
-  // id is the file path, copy it from s3 to a local folder
-  auto local = nebula::storage::makeFS("local");
-  split->local = local->temp();
-
-  // download the HTTP file to local as temp file
-  HttpService http;
   const auto& url = split->path;
 
   // set access token if present
@@ -288,6 +932,41 @@ bool IngestSpec::loadHttp(BlockList& blocks,
     headers.push_back(header);
   }
 
+  // a csv/json body is parsed while it is being received, at most a bounded buffer of it is in memory
+  if (FLAGS_NHTTP_STREAM && (table_->format == DataFormat::CSV || table_->format == DataFormat::JSON)) {
+    std::shared_ptr<HttpStream> body;
+    const auto codec = compression(*table_, url);
+    auto open = [&](const nebula::meta::SpecSplit& s) -> std::unique_ptr<std::istream> {
+      if (&s != split.get()) {
+        return nullptr;
+      }
+
+      body = std::make_shared<HttpStream>(url, headers, std::string(data), FLAGS_NHTTP_BUFFER_KB * 1024);
+      return nebula::storage::openStream(
+        [body](char* buf, size_t size) {
+          return body->read(buf, size);
+        },
+        codec);
+    };
+
+    auto result = this->ingest(blocks, nullptr, {}, open);
+
+    // a body received partially is not taken
+    if (!body || !body->ok()) {
+      LOG(WARNING) << "Failed to read from: " << url;
+      return false;
+    }
+
+    return result;
+  }
+
+  // id is the file path, copy it from s3 to a local folder
+  auto local = nebula::storage::makeFS("local");
+  split->local = local->temp();
+
+  // download the HTTP file to local as temp file
+  HttpService http;
+
   // the sheet content in this json objects
   if (!http.download(url, headers, data, split->local)) {
     LOG(WARNING) << "Failed to download to local: " << url;
@@ -385,9 +1064,8 @@ size_t IngestSpec::loadRockset(SpecSplitPtr split) noexcept {
 
   size_t numBlocks = 0;
   if (this->loadHttp(blocks, split, std::move(headers), data)) {
-    auto bm = BlockManager::init();
     // move all new blocks in
-    numBlocks = bm->add(blocks);
+    numBlocks = commit(*table_, id_, blocks);
   }
 
   // rockset use HTTP rest api to load data but, we need to send
@@ -395,66 +1073,103 @@ size_t IngestSpec::loadRockset(SpecSplitPtr split) noexcept {
 }
 
 // current is a kafka spec
-size_t IngestSpec::loadKafka(SpecSplitPtr split) noexcept {
+size_t IngestSpec::loadKafka(const std::vector<SpecSplitPtr>& splits) noexcept {
 #ifdef PPROF
   HeapProfilerStart("/tmp/heap_ingest_kafka.out");
 #endif
-  // build up the segment to consume
+  // build up the segments to consume
   // note that: Kafka path is composed by this pattern: "{partition}_{offset}_{size}"
-  auto segment = KafkaSegment::from(split->path);
-  KafkaReader reader(table_, std::move(segment));
-
-  // time function
-  MacroRow macroRow(table_->timeSpec, split->watermark, split->macros);
+  std::vector<KafkaSegment> segments;
+  segments.reserve(splits.size());
+  size_t width = 0;
+  for (const auto& split : splits) {
+    segments.push_back(KafkaSegment::from(split->path));
+    width = std::max(width, segments.back().size);
+  }
 
   // get a table definition
   auto table = table_->to();
+  const auto schema = TypeSerializer::from(table_->schema);
+  const auto enrich = Dictionaries::singleton().enrichment(*table);
+
+  // every worker consumes its share of partitions by its own consumer and parses them into its own batches
+  const auto workers = std::min<size_t>(
+    segments.size(), FLAGS_NKAFKA_WORKERS > 0 ? FLAGS_NKAFKA_WORKERS : std::thread::hardware_concurrency());
+  const auto& split = splits.front();
+
+  // a block holds all rows of a worker's share of segments
+  const auto rows = std::min<size_t>(FLAGS_NBLOCK_MAX_ROWS, width * ((segments.size() + workers - 1) / workers));
+  const auto bytes = blockBytes(0);
+
+  // streaming publishes rows of every worker while they are being ingested, until the spec completes
+  auto streamMs = KafkaConfig::streamMs(table_->settings);
+  if (streamMs > 0 && !StreamHead::supports(*table)) {
+    LOG(WARNING) << "Streaming is not supported by partitioned table or compound column: " << table_->name;
+    streamMs = 0;
+  }
 
-  // build a batch
-  auto batch = std::make_shared<Batch>(*table, reader.size());
+  std::atomic<size_t> blockId{ 0 };
+  BlockList blocks;
+  parallel(*table_, table, id(), rows, bytes, workers, blockId, blocks, *stats_, [&](size_t w, BlockSink& sink) {
+    std::vector<KafkaSegment> share;
+    for (size_t i = w; i < segments.size(); i += workers) {
+      share.push_back(segments.at(i));
+    }
 
-  auto lowTime = std::numeric_limits<size_t>::max();
-  auto highTime = std::numeric_limits<size_t>::min();
+    // a fetch waits no longer than publish interval so that the head is published on time
+    std::unique_ptr<StreamHead> head;
+    std::unique_ptr<KafkaReader> reader;
+    if (streamMs > 0) {
+      head = std::make_unique<StreamHead>(table, id(), blockId, streamMs);
+      reader = std::make_unique<KafkaReader>(
+        table_, std::move(share), streamMs, KafkaConfig::idleMs(table_->settings), [&head]() { head->tick(); });
+    } else {
+      reader = std::make_unique<KafkaReader>(table_, std::move(share));
+    }
 
-  while (reader.hasNext()) {
-    auto& r = reader.next();
-    const auto& row = macroRow.set(&r);
+    // time function
+    MacroRow macroRow(table_->timeSpec, split->watermark, split->macros, enrich);
+    RowFilter filter(table_->filters, schema);
+    while (reader->hasNext()) {
+      auto& r = reader->next();
+      if (!filter.match(r)) {
+        continue;
+      }
 
-    // TODO(cao) - Kafka may produce NULL row due to corruption or exception
-    // ideally we can handle nulls in our system, however, let's skip null row for now.
-    size_t time = row.readLong(Table::TIME_COLUMN);
-    if (time == 0) {
-      continue;
-    }
+      const auto& row = macroRow.set(&r);
 
-    // update time range before adding the row to the batch
-    if (time < lowTime) {
-      lowTime = time;
-    }
+      // TODO(cao) - Kafka may produce NULL row due to corruption or exception
+      // ideally we can handle nulls in our system, however, let's skip null row for now.
+      if (row.readLong(Table::TIME_COLUMN) == 0) {
+        continue;
+      }
 
-    if (time > highTime) {
-      highTime = time;
+      sink.add(row);
+      if (head) {
+        head->add(row);
+      }
     }
 
-    // add a new entry
-    batch->add(row);
-  }
+    sink.fetched(reader->fetchMs());
+    stats_->bytes(reader->bytes());
+    stats_->errors(reader->errors());
+    stats_->lag(reader->lag());
+  });
 
-  // build a block and add it to block manager
-  batch->seal();
-  BlockManager::init()->add(
-    BlockLoader::from(
-      BlockSignature{ table->name(), 0, lowTime, highTime, id_ }, batch));
+  // move all new blocks in, replacing blocks published by streaming heads
+  const auto numBlocks = commit(*table_, id_, blocks, streamMs > 0);
 
 #ifdef PPROF
   HeapProfilerStop();
 #endif
 
-  // iterate this read until it reaches end of the segment - blocking queue?
-  return 1;
+  return numBlocks;
 }
 
-bool IngestSpec::ingest(BlockList& blocks) noexcept {
+bool IngestSpec::ingest(BlockList& blocks,
+                        nebula::storage::NFileSystem* remote,
+                        const std::function<bool(size_t)>& ready,
+                        const std::function<std::unique_ptr<std::istream>(const nebula::meta::SpecSplit&)>& open) noexcept {
   auto table = table_->to();
 
   // load the data into batch based on block.id * 50000 as offset so that we can keep every 50K rows per block
@@ -464,6 +1179,9 @@ bool IngestSpec::ingest(BlockList& blocks) noexcept {
   // get table schema and create a table
   const auto schema = TypeSerializer::from(table_->schema);
 
+  // columns enriched by dictionaries, which are loaded once per refresh by all specs
+  const auto enrich = Dictionaries::singleton().enrichment(*table);
+
   // list all columns that we could read from given data file
   std::vector<std::string> columns;
   columns.reserve(schema->size());
@@ -471,7 +1189,7 @@ bool IngestSpec::ingest(BlockList& blocks) noexcept {
     auto type = schema->childType(i);
     auto name = type->name();
     auto macro = table->fromMacro(name);
-    if (macro.size() == 0) {
+    if (macro.size() == 0 && (enrich == nullptr || !enrich->contains(name))) {
       columns.push_back(name);
     }
   }
@@ -483,43 +1201,112 @@ bool IngestSpec::ingest(BlockList& blocks) noexcept {
     bRows = folly::to<size_t>(itr->second);
   }
 
-  // a lambda to build batch block
-  std::pair<size_t, size_t> range{ std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() };
-  auto makeBlock = [&table, &range, &specId](size_t bid, std::shared_ptr<Batch> b) {
-    // seal the block
-    b->seal();
-    LOG(INFO) << "Push a block: " << b->state();
-
-    return BlockLoader::from(
-      // build up a block signature with table name, sequence and spec
-      BlockSignature{
-        table->name(),
-        bid,
-        range.first,
-        range.second,
-        specId },
-      b);
-  };
+  // blocks are sealed by bytes as well, sized by the spec for its blocks to be scanned by all cores
+  const auto bBytes = blockBytes(size());
 
   // This may result in many blocks since it's partitioned in each ingestion spec.
-  std::unordered_map<size_t, std::shared_ptr<Batch>> batches;
-  auto pod = table->pod();
-  size_t blockId = 0;
+  std::atomic<size_t> blockId{ 0 };
+  BlockSink sink(*table_, table, specId, bRows, bBytes, blockId, *stats_);
+  RowFilter filter(table_->filters, schema);
 
   // TODO: introduce a flag to fail whole spec when bad file hit
   // ISSUE: https://github.com/varchar-io/nebula/issues/175
-  for (const auto& split : splits_) {
+  for (size_t i = 0, size = splits_.size(); i < size; ++i) {
+    const auto& split = splits_.at(i);
+
+    // time waiting for the file of the split
+    Evidence::Duration timer;
+    if (ready) {
+      const auto ok = ready(i);
+      stats_->add(Stage::FETCH, timer.elapsedMs());
+      if (!ok) {
+        stats_->errors(1);
+        continue;
+      }
+    }
+
+    stats_->bytes(split->size);
+
+    // time reading the split into the sink, from creating its reader
+    timer.reset();
+
     std::unique_ptr<RowCursor> source = nullptr;
     try {
+      const auto codec = compression(*table_, split->path);
       if (table_->source == DataSource::GSHEET) {
         source = this->readGSheet();
+      } else if (table_->format != DataFormat::PARQUET && (codec != Compression::NONE || remote || open)) {
+        // a compressed file is decompressed while being parsed, a remote file is read as one stream
+        auto stream = open     ? open(*split)
+                      : remote ? nebula::storage::openStream(remote->open(split->path), codec)
+                               : nebula::storage::openFile(split->local, codec);
+        if (!stream) {
+          continue;
+        }
+
+        if (table_->format == DataFormat::CSV) {
+          source = std::make_unique<CsvReader>(split->path, std::move(stream), table_->csv, columns);
+        } else if (table_->format == DataFormat::JSON) {
+          source = makeJsonReader(std::move(stream), table_->json, schema, columns);
+        } else {
+          LOG(ERROR) << "Compressed files are supported for formats: csv, json.";
+          continue;
+        }
       } else if (table_->format == DataFormat::CSV) {
+        // a large file is split into ranges of whole records parsed by multiple workers
+        const auto ranges = CsvReader::splits(
+          split->local,
+          FLAGS_NCSV_WORKERS > 0 ? FLAGS_NCSV_WORKERS : std::thread::hardware_concurrency(),
+          FLAGS_NCSV_SPLIT_MB * 1024 * 1024);
+        if (ranges.size() > 1) {
+          LOG(INFO) << "Parsing " << split->local << " by " << ranges.size() << " workers";
+          const auto workers = ranges.size();
+          parallel(*table_, table, specId, bRows, bBytes, workers, blockId, blocks, *stats_, [&](size_t w, BlockSink& sink) {
+            CsvReader reader(split->local, table_->csv, columns, ranges.at(w));
+            MacroRow macroRow(table_->timeSpec, split->watermark, split->macros, enrich);
+            while (reader.hasNext()) {
+              auto& r = reader.next();
+              if (filter.match(r)) {
+                sink.add(macroRow.set(&r));
+              }
+            }
+          });
+          continue;
+        }
+
         source = std::make_unique<CsvReader>(split->local, table_->csv, columns);
       } else if (table_->format == DataFormat::JSON) {
         source = makeJsonReader(split->local, table_->json, schema, columns);
       } else if (table_->format == DataFormat::PARQUET) {
+        // a remote file is read through one stream by all its readers
+        std::shared_ptr<InputStream> stream = remote ? remote->open(split->path) : nullptr;
+
         // schema is modified with time column, we need original schema here
-        source = std::make_unique<ParquetReader>(split->local, schema, columns);
+        auto parquet = stream ? std::make_unique<ParquetReader>(stream, schema, columns)
+                              : std::make_unique<ParquetReader>(split->local, schema, columns);
+
+        // row groups of a large file are decoded by multiple workers into their own batches
+        const auto groups = parquet->groups();
+        const auto workers = std::min<size_t>(
+          groups, FLAGS_NPARQUET_WORKERS > 0 ? FLAGS_NPARQUET_WORKERS : std::thread::hardware_concurrency());
+        if (workers > 1) {
+          parquet = nullptr;
+          const ParquetPlan plan{ table, bRows, bBytes, groups, workers, filter, stream, enrich };
+          ingestParquet(*split, schema, columns, plan, blockId, blocks);
+          continue;
+        }
+
+        // row groups without any matched row are not read
+        parquet->prune(table_->filters);
+
+        // a file decoded by typed batches doesn't go through rows
+        MacroRow macroRow(table_->timeSpec, split->watermark, split->macros, enrich);
+        if (ingestColumns(*parquet, *table_, table, schema, macroRow, sink)) {
+          sink.busy(timer.elapsedMs());
+          continue;
+        }
+
+        source = std::move(parquet);
       } else {
         LOG(ERROR) << "Supported data formats: csv, json, parquet.";
         continue;
@@ -531,71 +1318,63 @@ bool IngestSpec::ingest(BlockList& blocks) noexcept {
       }
 
       // build time row to handle time column and macro columns reading
-      MacroRow macroRow(table_->timeSpec, split->watermark, split->macros);
+      MacroRow macroRow(table_->timeSpec, split->watermark, split->macros, enrich);
 
       // ingest current reader into the blocks
       while (source->hasNext()) {
         auto& r = source->next();
-        const auto& row = macroRow.set(&r);
-
-        // for non-partitioned, all batch's pid will be 0
-        size_t pid = 0;
-        BessType bess = -1;
-        if (pod) {
-          pid = pod->pod(row, bess);
-        }
-
-        // get the batch
-        auto batch = batches[pid];
-        if (batch == nullptr) {
-          batch = std::make_shared<Batch>(*table, bRows, pid);
-          batches[pid] = batch;
+        if (filter.match(r)) {
+          sink.add(macroRow.set(&r));
         }
-
-        // if this is already full
-        if (batch->getRows() >= bRows) {
-          // move it to the manager and erase it from the map
-          blocks.push_front(makeBlock(blockId++, batch));
-
-          // make a new batch
-          batch = std::make_shared<Batch>(*table, bRows, pid);
-          batches[pid] = batch;
-          range = { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() };
-        }
-
-        // update time range before adding the row to the batch
-        // get time column value
-        size_t time = row.readLong(Table::TIME_COLUMN);
-        if (time < range.first) {
-          range.first = time;
-        }
-
-        if (time > range.second) {
-          range.second = time;
-        }
-
-        // add a new entry
-        batch->add(row, bess);
       }
+      sink.busy(timer.elapsedMs());
     } catch (const std::exception& exp) {
       LOG(ERROR) << "Exception in creating reader for table " << table_->toString() << ", file: " << split->path << ", exception: " << exp.what();
+      stats_->errors(1);
       continue;
     }
   }
 
   // build all data blocks
   // move all blocks in map into block manager
-  for (auto& itr : batches) {
-    // TODO(cao) - the block maybe too small
-    // to waste lots of memory especially in case of sparse storage
-    // we need to try to compress them if useful to save memory
-    blocks.push_front(makeBlock(blockId++, itr.second));
-  }
+  sink.flush(blocks);
 
   // return all blocks built up so far
   LOG(INFO) << "Memory Pool Report: " << nebula::common::Pool::getDefault().report();
   return true;
 }
 
+void IngestSpec::ingestParquet(const nebula::meta::SpecSplit& split,
+                               const nebula::type::Schema& schema,
+                               const std::vector<std::string>& columns,
+                               const ParquetPlan& plan,
+                               std::atomic<size_t>& blockId,
+                               BlockList& blocks) {
+  // every worker reads a contiguous range of row groups from its own reader
+  const auto& table = plan.table;
+  const auto bRows = plan.rows;
+  const auto bBytes = plan.bytes;
+  const auto groups = plan.groups;
+  const auto workers = plan.workers;
+  LOG(INFO) << "Decoding " << groups << " row groups of " << split.path << " by " << workers << " workers";
+
+  parallel(*table_, table, id(), bRows, bBytes, workers, blockId, blocks, *stats_, [&](size_t w, BlockSink& sink) {
+    const auto first = w * groups / workers;
+    const auto last = (w + 1) * groups / workers;
+    auto reader = plan.stream ? std::make_unique<ParquetReader>(plan.stream, schema, columns, first, last - first)
+                              : std::make_unique<ParquetReader>(split.local, schema, columns, first, last - first);
+    reader->prune(table_->filters);
+    MacroRow macroRow(table_->timeSpec, split.watermark, split.macros, plan.enrich);
+    if (!ingestColumns(*reader, *table_, table, schema, macroRow, sink)) {
+      while (reader->hasNext()) {
+        auto& r = reader->next();
+        if (plan.filter.match(r)) {
+          sink.add(macroRow.set(&r));
+        }
+      }
+    }
+  });
+}
+
 } // namespace ingest
 } // namespace nebula
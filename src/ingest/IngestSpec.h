@@ -16,10 +16,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <fmt/format.h>
 #include <forward_list>
+#include <functional>
+#include <istream>
+#include <memory>
 #include <mutex>
 
+#include "MacroRow.h"
 #include "common/Task.h"
 #include "execution/io/BlockLoader.h"
 #include "meta/DataSpec.h"
@@ -39,8 +44,16 @@
  * This principle should apply in nebula as well.
  */
 namespace nebula {
+namespace storage {
+class InputStream;
+class NFileSystem;
+} // namespace storage
+
 namespace ingest {
 
+class IngestStats;
+class RowFilter;
+
 // a ingest spec defines a task specification to ingest some data
 class IngestSpec : public nebula::meta::DataSpec {
 public:
@@ -57,6 +70,9 @@ public:
   size_t work() noexcept;
 
 private:
+  // ingest by the loader of the table, metrics of this run go to stats
+  size_t run() noexcept;
+
   // load swap
   size_t loadSwap() noexcept;
 
@@ -66,8 +82,8 @@ private:
   // load api - on demand ingestion
   size_t loadApi() noexcept;
 
-  // load kafka
-  size_t loadKafka(nebula::meta::SpecSplitPtr) noexcept;
+  // load kafka, every split is a segment of a distinct partition
+  size_t loadKafka(const std::vector<nebula::meta::SpecSplitPtr>&) noexcept;
 
   // load rockset data
   size_t loadRockset(nebula::meta::SpecSplitPtr) noexcept;
@@ -84,8 +100,42 @@ private:
   // load current spec as blocks
   bool load(nebula::execution::io::BlockList&) noexcept;
 
-  // ingest will expect all files are downloaded
-  bool ingest(nebula::execution::io::BlockList&) noexcept;
+  // ingest will expect all files are downloaded, except those read from the remote file system directly
+  // if given, ready is called with index of a split before reading it, the split is skipped if it returns false
+  // if given, open provides a csv/json split as a stream, such as a HTTP body, the split is skipped if it's null
+  bool ingest(nebula::execution::io::BlockList&,
+              nebula::storage::NFileSystem* = nullptr,
+              const std::function<bool(size_t)>& = {},
+              const std::function<std::unique_ptr<std::istream>(const nebula::meta::SpecSplit&)>& = {}) noexcept;
+
+  // how row groups of a parquet file are decoded in parallel
+  struct ParquetPlan {
+    const nebula::meta::TablePtr& table;
+    // max rows and bytes per batch
+    size_t rows;
+    size_t bytes;
+    // row groups of the file and number of workers to decode them
+    size_t groups;
+    size_t workers;
+    // rows dropped by the ingest filter
+    const RowFilter& filter;
+    // stream of a remote file shared by all workers, null for a local file
+    const std::shared_ptr<nebula::storage::InputStream>& stream;
+    // columns enriched by dictionaries, null if there is none
+    const std::shared_ptr<const Enrichment>& enrich;
+  };
+
+  // decode row groups of a parquet file by workers in parallel, each into its own batches
+  void ingestParquet(const nebula::meta::SpecSplit&,
+                     const nebula::type::Schema&,
+                     const std::vector<std::string>&,
+                     const ParquetPlan&,
+                     std::atomic<size_t>&,
+                     nebula::execution::io::BlockList&);
+
+private:
+  // metrics of current run of the spec
+  std::shared_ptr<IngestStats> stats_;
 };
 
 } // namespace ingest
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include "common/TimeParser.h"
+#include "meta/Lookup.h"
 #include "meta/TableSpec.h"
 
 /**
@@ -24,13 +26,27 @@
 namespace nebula {
 namespace ingest {
 
+// a column looked up in a dictionary by a key column of given kind, the dictionary is null if it failed to load
+struct Enriched {
+  std::string key;
+  nebula::type::Kind kind;
+  nebula::meta::LookupTablePtr dictionary;
+};
+
+// all enriched columns of a table by name
+using Enrichment = nebula::common::unordered_map<std::string, Enriched>;
+
 // row wrapper to
 // 1. translate "date" value into reserved "_time_" column
 // 2. replace macros for special column
+// 3. look up enriched columns in their dictionaries
 class MacroRow : public nebula::surface::RowData {
 public:
-  MacroRow(const nebula::meta::TimeSpec& ts, size_t watermark, nebula::common::MapKV macros)
-    : timeFunc_{ makeTimeFunc(ts, watermark) }, macros_(macros) {}
+  MacroRow(const nebula::meta::TimeSpec& ts,
+           size_t watermark,
+           nebula::common::MapKV macros,
+           std::shared_ptr<const Enrichment> enrich = nullptr)
+    : timeFunc_{ makeTimeFunc(ts, watermark) }, macros_(macros), enrich_{ std::move(enrich) } {}
   ~MacroRow() = default;
 
   const MacroRow& set(const nebula::surface::RowData* row) {
@@ -56,10 +72,17 @@ public:
 
   bool isNull(const std::string& field) const override {
     if (N_UNLIKELY(field == nebula::meta::Table::TIME_COLUMN)
-        || macros_.find(field) != macros_.end()) {
+        || (!macros_.empty() && macros_.find(field) != macros_.end())) {
       return false;
     }
 
+    if (N_UNLIKELY(enrich_ != nullptr)) {
+      auto found = enrich_->find(field);
+      if (found != enrich_->end()) {
+        return enriched(found->second) == nullptr;
+      }
+    }
+
     return row_->isNull(field);
   }
 
@@ -73,16 +96,64 @@ public:
     return row_->readLong(field);
   }
 
-  // read from macro combinations if present there
+  // read from macro combinations if present there, the view refers the macro value owned by this row
   std::string_view readString(const std::string& field) const override {
-    if (N_UNLIKELY(macros_.find(field) != macros_.end())) {
-      return macros_.at(field);
+    if (N_UNLIKELY(!macros_.empty())) {
+      auto found = macros_.find(field);
+      if (found != macros_.end()) {
+        return found->second;
+      }
+    }
+
+    // the view refers the value owned by the dictionary
+    if (N_UNLIKELY(enrich_ != nullptr)) {
+      auto found = enrich_->find(field);
+      if (found != enrich_->end()) {
+        auto value = enriched(found->second);
+        return value == nullptr ? std::string_view{} : std::string_view(*value);
+      }
     }
 
     return row_->readString(field);
   }
 
+  // divisor to get unix seconds from a bigint time column of given pattern, 0 if it is not unix time
+  static size_t unixScale(const std::string& pattern) noexcept {
+    constexpr auto UNIX_TS = "UNIXTIME";
+    constexpr auto UNIX_MS = "UNIXTIME_MS";
+    constexpr auto UNIX_NANO = "UNIXTIME_NANO";
+    if (pattern == UNIX_TS) {
+      return 1;
+    }
+
+    if (pattern == UNIX_MS) {
+      return 1000;
+    }
+
+    if (pattern == UNIX_NANO) {
+      return 1000000000;
+    }
+
+    return 0;
+  }
+
 private:
+  // value of an enriched column in the current row, nullptr if its key is null or not found
+  const std::string* enriched(const Enriched& e) const {
+    if (e.dictionary == nullptr || row_->isNull(e.key)) {
+      return nullptr;
+    }
+
+    switch (e.kind) {
+    case nebula::type::Kind::TINYINT: return e.dictionary->find((int64_t)row_->readByte(e.key));
+    case nebula::type::Kind::SMALLINT: return e.dictionary->find((int64_t)row_->readShort(e.key));
+    case nebula::type::Kind::INTEGER: return e.dictionary->find((int64_t)row_->readInt(e.key));
+    case nebula::type::Kind::BIGINT: return e.dictionary->find(row_->readLong(e.key));
+    case nebula::type::Kind::VARCHAR: return e.dictionary->find(row_->readString(e.key));
+    default: return nullptr;
+    }
+  }
+
   // A method to convert time spec into a time function
   std::function<int64_t(const nebula::surface::RowData*)> makeTimeFunc(const nebula::meta::TimeSpec& ts, size_t watermark) {
     // static time spec
@@ -104,9 +175,6 @@ private:
       // unfortunately if the data has it as null, we return 1 as indicator
       // we can not use 0, because Nebula doesn't allow query time range fall into 0 start/end.
       static constexpr size_t NULL_TIME = 1;
-      constexpr auto UNIX_TS = "UNIXTIME";
-      constexpr auto UNIX_MS = "UNIXTIME_MS";
-      constexpr auto UNIX_NANO = "UNIXTIME_NANO";
       constexpr auto SERIAL_NUMBER = "SERIAL_NUMBER";
 
       // SERIAL_NUMBER translation
@@ -121,14 +189,7 @@ private:
         };
       }
 
-      auto scale = 0;
-      if (ts.pattern == UNIX_TS) {
-        scale = 1;
-      } else if (ts.pattern == UNIX_MS) {
-        scale = 1000;
-      } else if (ts.pattern == UNIX_NANO) {
-        scale = 1000000000;
-      }
+      const auto scale = unixScale(ts.pattern);
 
       // unix time (bigint) conversion
       if (scale > 0) {
@@ -141,6 +202,25 @@ private:
         };
       }
 
+      // fixed width layouts such as 'yyyy-mm-dd hh:mm:ss' are parsed by a specialized parser selected once here,
+      // values not matching the layout still go through the general parser
+      auto parser = nebula::common::TimeParser::make(ts.pattern);
+      if (parser) {
+        return [col = ts.column, pattern = ts.pattern, parser = *parser](const nebula::surface::RowData* r) {
+          if (N_UNLIKELY(r->isNull(col))) {
+            return NULL_TIME;
+          }
+
+          const auto value = r->readString(col);
+          int64_t seconds;
+          if (N_LIKELY(parser.parse(value, seconds))) {
+            return (size_t)seconds;
+          }
+
+          return nebula::common::Evidence::time(value, pattern);
+        };
+      }
+
       // last option: string of time pattern such as 'yyyy-mm-dd'
       return [col = ts.column, pattern = ts.pattern](const nebula::surface::RowData* r) {
         if (N_UNLIKELY(r->isNull(col))) {
@@ -173,6 +253,7 @@ private:
   std::function<int64_t(const nebula::surface::RowData*)> timeFunc_;
   const nebula::surface::RowData* row_;
   const nebula::common::MapKV macros_;
+  const std::shared_ptr<const Enrichment> enrich_;
 };
 
 } // namespace ingest
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+
+#include "common/Hash.h"
+#include "meta/NodeManager.h"
+
+/**
+ * Load of nodes for spec placement.
+ * Load of a node is measured in three dimensions: memory of its blocks, number of its blocks and its query heat.
+ * Every dimension is relative to the average among all nodes, and the load is the largest of them,
+ * so a node is hot when it holds too much data, or too many small blocks, or serves too many queries.
+ * For example, load 1.5 means the node is 50% above the average in its worst dimension.
+ */
+namespace nebula {
+namespace ingest {
+
+class NodeLoad {
+  struct Load {
+    double memory;
+    double blocks;
+    double heat;
+  };
+
+public:
+  NodeLoad() : memory_{ 0 }, blocks_{ 0 }, heat_{ 0 } {}
+  virtual ~NodeLoad() = default;
+
+  inline void add(const std::string& node, const nebula::meta::NodeStats& stats) {
+    loads_[node] = Load{ (double)stats.memory, (double)stats.blocks, stats.heat };
+    memory_ += stats.memory;
+    blocks_ += stats.blocks;
+    heat_ += stats.heat;
+  }
+
+  // charge the node for a new spec of given bytes, before it reports the blocks of the spec
+  inline void charge(const std::string& node, size_t bytes) {
+    auto found = loads_.find(node);
+    if (found != loads_.end()) {
+      found->second.memory += bytes;
+      memory_ += bytes;
+    }
+  }
+
+  // move a spec of given bytes between two nodes, blocks and heat of the source move along in proportion to bytes
+  inline void move(const std::string& from, const std::string& to, size_t bytes) {
+    auto source = loads_.find(from);
+    auto target = loads_.find(to);
+    if (source == loads_.end() || target == loads_.end()) {
+      return;
+    }
+
+    auto& s = source->second;
+    auto& t = target->second;
+    const auto share = s.memory > 0 ? std::min(1.0, bytes / s.memory) : 0;
+    const auto blocks = s.blocks * share;
+    const auto heat = s.heat * share;
+    const auto memory = std::min(s.memory, (double)bytes);
+    s.memory -= memory;
+    s.blocks -= blocks;
+    s.heat -= heat;
+    t.memory += memory;
+    t.blocks += blocks;
+    t.heat += heat;
+  }
+
+  // load of the node relative to the average, 0 for unknown node
+  inline double load(const std::string& node) const {
+    auto found = loads_.find(node);
+    if (found == loads_.end()) {
+      return 0;
+    }
+
+    const auto& l = found->second;
+    const auto n = loads_.size();
+    return std::max({ relative(l.memory, memory_, n), relative(l.blocks, blocks_, n), relative(l.heat, heat_, n) });
+  }
+
+  inline size_t size() const {
+    return loads_.size();
+  }
+
+private:
+  static inline double relative(double value, double total, size_t n) {
+    return total > 0 ? value * n / total : 0;
+  }
+
+private:
+  nebula::common::unordered_map<std::string, Load> loads_;
+  double memory_;
+  double blocks_;
+  double heat_;
+};
+
+} // namespace ingest
+} // namespace nebula
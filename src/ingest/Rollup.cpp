@@ -0,0 +1,225 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Rollup.h"
+
+#include <cstring>
+#include <limits>
+
+#include "memory/FlatRow.h"
+
+/**
+ * Aggregate raw rows into rollup groups.
+ */
+namespace nebula {
+namespace ingest {
+
+using nebula::memory::Batch;
+using nebula::memory::FlatRow;
+using nebula::meta::RollupSpec;
+using nebula::meta::Table;
+using nebula::meta::TableSpec;
+using nebula::surface::RowData;
+using nebula::type::Kind;
+
+Rollup::Rollup(const TableSpec& spec, const RollupSpec& rollup)
+  : table_{ spec.to(rollup) },
+    window_{ rollup.window },
+    range_{ std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() } {
+  auto raw = spec.to()->schema();
+  auto kind = [&raw](const std::string& name) {
+    return raw->find(name)->k();
+  };
+
+  for (const auto& d : rollup.dimensions) {
+    dimensions_.push_back({ d, kind(d) });
+  }
+
+  for (const auto& m : rollup.metrics) {
+    const auto k = kind(m);
+    auto& list = (k == Kind::REAL || k == Kind::DOUBLE) ? doubles_ : longs_;
+    list.push_back({ m, k });
+  }
+}
+
+template <typename T>
+static inline void append(std::string& key, T value) {
+  key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static inline T extract(const char*& cursor) {
+  T value;
+  std::memcpy(&value, cursor, sizeof(T));
+  cursor += sizeof(T);
+  return value;
+}
+
+static int64_t readIntegral(const RowData& row, const std::string& name, Kind kind) {
+  switch (kind) {
+  case Kind::TINYINT: return row.readByte(name);
+  case Kind::SMALLINT: return row.readShort(name);
+  case Kind::INTEGER: return row.readInt(name);
+  default: return row.readLong(name);
+  }
+}
+
+static double readReal(const RowData& row, const std::string& name, Kind kind) {
+  return kind == Kind::REAL ? row.readFloat(name) : row.readDouble(name);
+}
+
+void Rollup::add(const RowData& row) {
+  // key = time bucket + [null flag, value] of every dimension
+  const size_t time = row.readLong(Table::TIME_COLUMN) / window_ * window_;
+  key_.clear();
+  append(key_, time);
+  for (const auto& d : dimensions_) {
+    const auto isNull = row.isNull(d.name);
+    append(key_, isNull);
+    if (isNull) {
+      continue;
+    }
+
+    switch (d.kind) {
+#define ENCODE_KIND(KIND, FUNC)     \
+  case Kind::KIND: {                \
+    append(key_, row.FUNC(d.name)); \
+    break;                          \
+  }
+
+      ENCODE_KIND(BOOLEAN, readBool)
+      ENCODE_KIND(TINYINT, readByte)
+      ENCODE_KIND(SMALLINT, readShort)
+      ENCODE_KIND(INTEGER, readInt)
+      ENCODE_KIND(BIGINT, readLong)
+      ENCODE_KIND(REAL, readFloat)
+      ENCODE_KIND(DOUBLE, readDouble)
+      ENCODE_KIND(INT128, readInt128)
+
+#undef ENCODE_KIND
+    case Kind::VARCHAR: {
+      auto sv = row.readString(d.name);
+      append(key_, (uint32_t)sv.size());
+      key_.append(sv.data(), sv.size());
+      break;
+    }
+    default: throw NException(fmt::format("unsupported rollup dimension: {0}", d.name));
+    }
+  }
+
+  auto found = groups_.find(key_);
+  if (found == groups_.end()) {
+    found = groups_.emplace(key_, Group{ 0,
+                                         std::vector<Measure<int64_t>>(longs_.size(), Measure<int64_t>{ 0, 0, 0, 0 }),
+                                         std::vector<Measure<double>>(doubles_.size(), Measure<double>{ 0, 0, 0, 0 }) })
+              .first;
+    range_.first = std::min(range_.first, time);
+    range_.second = std::max(range_.second, time);
+  }
+
+  auto& group = found->second;
+  ++group.count;
+  for (size_t i = 0, size = longs_.size(); i < size; ++i) {
+    const auto& m = longs_[i];
+    if (!row.isNull(m.name)) {
+      group.longs[i].add(readIntegral(row, m.name, m.kind));
+    }
+  }
+
+  for (size_t i = 0, size = doubles_.size(); i < size; ++i) {
+    const auto& m = doubles_[i];
+    if (!row.isNull(m.name)) {
+      group.doubles[i].add(readReal(row, m.name, m.kind));
+    }
+  }
+}
+
+std::shared_ptr<Batch> Rollup::batch() {
+  auto batch = std::make_shared<Batch>(*table_, groups_.size());
+
+  // a metric without any value is null in the group
+  auto write = [](FlatRow& row, const std::string& name, const auto& measure) {
+    if (measure.count == 0) {
+      row.writeNull(RollupSpec::sum(name));
+      row.writeNull(RollupSpec::min(name));
+      row.writeNull(RollupSpec::max(name));
+      return;
+    }
+
+    row.write(RollupSpec::sum(name), measure.sum);
+    row.write(RollupSpec::min(name), measure.min);
+    row.write(RollupSpec::max(name), measure.max);
+  };
+
+  FlatRow row(1024, true);
+  for (const auto& item : groups_) {
+    row.reset();
+    const auto& key = item.first;
+    const char* cursor = key.data();
+    row.write(Table::TIME_COLUMN, (int64_t)extract<size_t>(cursor));
+    for (const auto& d : dimensions_) {
+      if (extract<bool>(cursor)) {
+        row.writeNull(d.name);
+        continue;
+      }
+
+      switch (d.kind) {
+#define DECODE_KIND(KIND, T)               \
+  case Kind::KIND: {                       \
+    row.write(d.name, extract<T>(cursor)); \
+    break;                                 \
+  }
+
+        DECODE_KIND(BOOLEAN, bool)
+        DECODE_KIND(TINYINT, int8_t)
+        DECODE_KIND(SMALLINT, int16_t)
+        DECODE_KIND(INTEGER, int32_t)
+        DECODE_KIND(BIGINT, int64_t)
+        DECODE_KIND(REAL, float)
+        DECODE_KIND(DOUBLE, double)
+        DECODE_KIND(INT128, int128_t)
+
+#undef DECODE_KIND
+      case Kind::VARCHAR: {
+        auto size = extract<uint32_t>(cursor);
+        row.write(d.name, cursor, size);
+        cursor += size;
+        break;
+      }
+      default: break;
+      }
+    }
+
+    const auto& group = item.second;
+    row.write(RollupSpec::COUNT, (int64_t)group.count);
+    for (size_t i = 0, size = longs_.size(); i < size; ++i) {
+      write(row, longs_[i].name, group.longs[i]);
+    }
+
+    for (size_t i = 0, size = doubles_.size(); i < size; ++i) {
+      write(row, doubles_[i].name, group.doubles[i]);
+    }
+
+    batch->add(row);
+  }
+
+  groups_.clear();
+  range_ = { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() };
+  return batch;
+}
+
+} // namespace ingest
+} // namespace nebula
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "common/Hash.h"
+#include "memory/Batch.h"
+#include "meta/TableSpec.h"
+#include "surface/DataSurface.h"
+
+/**
+ * A rollup aggregates raw rows of a table into groups of (dimensions, time bucket) while ingesting.
+ * Every group keeps row count, and sum, min and max of each metric, which are written as rows of the rollup table.
+ * A group key is the binary encoding of its dimension values and time bucket, which is decoded back when
+ * building the batch, so a group doesn't keep its own copy of the values.
+ */
+namespace nebula {
+namespace ingest {
+
+class Rollup {
+  template <typename T>
+  struct Measure {
+    // number of non-null values
+    size_t count;
+    T sum;
+    T min;
+    T max;
+
+    inline void add(T v) noexcept {
+      if (count++ == 0) {
+        sum = min = max = v;
+        return;
+      }
+
+      sum += v;
+      min = std::min(min, v);
+      max = std::max(max, v);
+    }
+  };
+
+  struct Group {
+    size_t count;
+    std::vector<Measure<int64_t>> longs;
+    std::vector<Measure<double>> doubles;
+  };
+
+  struct Column {
+    std::string name;
+    nebula::type::Kind kind;
+  };
+
+public:
+  Rollup(const nebula::meta::TableSpec&, const nebula::meta::RollupSpec&);
+  virtual ~Rollup() = default;
+
+public:
+  // aggregate a raw row into its group
+  void add(const nebula::surface::RowData&);
+
+  // build a batch out of all groups and reset the rollup
+  std::shared_ptr<nebula::memory::Batch> batch();
+
+  inline size_t size() const noexcept {
+    return groups_.size();
+  }
+
+  inline const nebula::meta::TablePtr& table() const noexcept {
+    return table_;
+  }
+
+  // time range of all groups
+  inline const std::pair<size_t, size_t>& range() const noexcept {
+    return range_;
+  }
+
+private:
+  const nebula::meta::TablePtr table_;
+  const size_t window_;
+  std::vector<Column> dimensions_;
+  std::vector<Column> longs_;
+  std::vector<Column> doubles_;
+
+  nebula::common::unordered_map<std::string, Group> groups_;
+  std::pair<size_t, size_t> range_;
+
+  // reused buffer to encode a group key
+  std::string key_;
+};
+
+} // namespace ingest
+} // namespace nebula
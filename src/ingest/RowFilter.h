@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/Conv.h>
+
+#include "meta/TableSpec.h"
+#include "surface/DataSurface.h"
+
+/**
+ * Ingest filter to drop source rows not meeting conditions of the table spec.
+ */
+namespace nebula {
+namespace ingest {
+
+// all conditions are compiled into functions by column type once, a row is kept if all of them are true
+class RowFilter {
+  using Condition = std::function<bool(const nebula::surface::RowData&)>;
+
+public:
+  RowFilter(const std::vector<nebula::meta::FilterSpec>& filters, const nebula::type::Schema& schema) {
+    conditions_.reserve(filters.size());
+    for (const auto& filter : filters) {
+      auto type = schema->find(filter.column);
+      N_ENSURE_NOT_NULL(type, fmt::format("filter column not in schema: {0}", filter.column));
+      conditions_.push_back(make(filter, type->k()));
+    }
+  }
+  ~RowFilter() = default;
+
+  inline bool empty() const noexcept {
+    return conditions_.empty();
+  }
+
+  inline bool match(const nebula::surface::RowData& row) const {
+    for (const auto& c : conditions_) {
+      if (!c(row)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  template <typename T>
+  static bool compare(nebula::meta::FilterOp op, const T& left, const T& right) {
+    switch (op) {
+    case nebula::meta::FilterOp::EQ: return left == right;
+    case nebula::meta::FilterOp::NE: return left != right;
+    case nebula::meta::FilterOp::LT: return left < right;
+    case nebula::meta::FilterOp::LE: return left <= right;
+    case nebula::meta::FilterOp::GT: return left > right;
+    case nebula::meta::FilterOp::GE: return left >= right;
+    default: return false;
+    }
+  }
+
+  static Condition make(const nebula::meta::FilterSpec& filter, nebula::type::Kind kind) {
+    if (filter.op == nebula::meta::FilterOp::NOTNULL) {
+      return [col = filter.column](const nebula::surface::RowData& r) { return !r.isNull(col); };
+    }
+
+    switch (kind) {
+#define COMPARE_CASE(K, F)                                                        \
+  case nebula::type::Kind::K: {                                                   \
+    using T = nebula::type::TypeTraits<nebula::type::Kind::K>::CppType;           \
+    return [col = filter.column, op = filter.op, v = folly::to<T>(filter.value)]( \
+             const nebula::surface::RowData& r) {                                 \
+      return !r.isNull(col) && compare<T>(op, r.F(col), v);                       \
+    };                                                                            \
+  }
+
+      COMPARE_CASE(BOOLEAN, readBool)
+      COMPARE_CASE(TINYINT, readByte)
+      COMPARE_CASE(SMALLINT, readShort)
+      COMPARE_CASE(INTEGER, readInt)
+      COMPARE_CASE(BIGINT, readLong)
+      COMPARE_CASE(REAL, readFloat)
+      COMPARE_CASE(DOUBLE, readDouble)
+
+#undef COMPARE_CASE
+    case nebula::type::Kind::VARCHAR: {
+      // the value is owned by the condition
+      return [col = filter.column, op = filter.op, v = filter.value](const nebula::surface::RowData& r) {
+        return !r.isNull(col) && compare<std::string_view>(op, r.readString(col), v);
+      };
+    }
+    default:
+      throw NException(fmt::format("Type not supported in ingest filter: {0}", filter.column));
+    }
+  }
+
+private:
+  std::vector<Condition> conditions_;
+};
+
+} // namespace ingest
+} // namespace nebula
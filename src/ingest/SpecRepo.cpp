@@ -16,17 +16,36 @@
 
 #include <fmt/format.h>
 #include <folly/Conv.h>
+#include <gflags/gflags.h>
 
 #include "SpecRepo.h"
 
 #include "common/Evidence.h"
+#include "common/HashRing.h"
 #include "execution/BlockManager.h"
 #include "execution/meta/SpecProvider.h"
 #include "execution/meta/TableService.h"
 #include "ingest/BlockExpire.h"
+#include "ingest/IngestMetrics.h"
+#include "ingest/NodeLoad.h"
 #include "storage/NFS.h"
 #include "storage/kafka/KafkaTopic.h"
 
+DEFINE_double(SPEC_LOAD_FACTOR,
+              1.25,
+              "A node loaded more than this factor of the average among active nodes in memory, blocks or query heat"
+              " is passed over when new specs are assigned, the next node on the hash ring takes them instead."
+              " Such a hot node also moves its specs to nodes below the average.");
+DEFINE_uint32(SPEC_MIGRATIONS,
+              4,
+              "Max number of specs moving off hot nodes at the same time, every sync cycle starts new ones"
+              " only when earlier ones are done. 0 to disable rebalance of specs.");
+DEFINE_uint32(KAFKA_CATCHUP_SPECS,
+              64,
+              "A kafka table having at least this many new specs in a cycle, such as a backlog after an outage,"
+              " is catching up: its new specs are dealt to all active nodes in turn rather than by hash affinity."
+              " Affinity resumes once the backlog is below it. 0 to disable.");
+
 /**
  * We will sync etcd configs for cluster info into this memory object
  * To understand cluster status - total nodes.
@@ -58,6 +77,7 @@ using nebula::meta::SpecPtr;
 using nebula::meta::SpecSplit;
 using nebula::meta::SpecSplitPtr;
 using nebula::meta::SpecState;
+using nebula::meta::TableSpec;
 using nebula::meta::TableSpecPtr;
 using nebula::meta::TimeSpec;
 using nebula::meta::TimeType;
@@ -98,7 +118,9 @@ size_t SpecRepo::refresh() noexcept {
   return numSpecs;
 }
 
-// remove (or take it offline) all expired blocks from active nodes
+// remove (or take it offline) all expired blocks from active nodes.
+// blocks past retention of their table are removed by nodes themselves, this catches specs taken offline
+// for other reasons, such as a table removed or a spec replaced by a new version.
 size_t SpecRepo::expire(const ClientMaker& clientMaker) noexcept {
   std::lock_guard<std::mutex> lock(specsMutex_);
 
@@ -125,11 +147,13 @@ size_t SpecRepo::expire(const ClientMaker& clientMaker) noexcept {
       // recording expired block ID for given node
       TableSpecSet expired;
       size_t memorySize = 0;
+      size_t numBlocks = 0;
       for (auto itr = states.begin(); itr != states.end(); ++itr) {
         const auto& state = itr->second;
         auto pairs = state->expired([&ts](const std::string& table, const std::string& spec) -> bool {
           // find the spec from table registery who tracks all online specs
-          const auto& registry = ts->query(table);
+          // rollup blocks are ingested by specs of their base table
+          const auto& registry = ts->query(TableSpec::base(table));
 
           // check if the table registry has this spec online
           if (!registry.empty() && registry.online(spec)) {
@@ -148,6 +172,7 @@ size_t SpecRepo::expire(const ClientMaker& clientMaker) noexcept {
         // TODO(cao): use memory size rather than data raw size
         // accumulate memory usage for this node
         memorySize += state->rawBytes();
+        numBlocks += state->numBlocks();
       }
 
       // sync expire task to node
@@ -158,8 +183,8 @@ size_t SpecRepo::expire(const ClientMaker& clientMaker) noexcept {
         LOG(INFO) << fmt::format("Expire {0} specs in node {1}: {2}", expireSize, node.server, (char)state);
       }
 
-      // update size of the node
-      ci.updateNodeSize(node, memorySize);
+      // update size and load of the node
+      ci.updateNodeLoad(node, memorySize, numBlocks);
       numExpired += expireSize;
     }
   }
@@ -169,15 +194,35 @@ size_t SpecRepo::expire(const ClientMaker& clientMaker) noexcept {
 }
 
 void resetSpec(SpecPtr& spec) {
+  spec->cancel();
   spec->affinity(nebula::meta::NNode::invalid());
+  spec->replicas({});
   spec->state(nebula::meta::SpecState::NEW);
 }
 
+// a node on the hash ring placing copies of specs
+class SpecHost final : public Identifiable {
+public:
+  explicit SpecHost(const NNode& n) : node{ n }, id_{ n.toString() } {}
+  virtual ~SpecHost() = default;
+
+  virtual const std::string& id() const override {
+    return id_;
+  }
+
+  inline virtual void construct() override {}
+
+  const NNode node;
+
+private:
+  std::string id_;
+};
+
+using SpecRing = nebula::common::HashRing<SpecHost, nebula::meta::DataSpec>;
+
 std::pair<size_t, size_t> SpecRepo::assign(const ClientMaker& clientMaker) noexcept {
   std::lock_guard<std::mutex> lock(specsMutex_);
 
-  // TODO(cao) - build resource constaints here to reach a balance
-  // for now, we just spin new specs into nodes with lower memory size
   auto nodes = ClusterInfo::singleton().nodes();
   const auto size = nodes.size();
   if (size == 0) {
@@ -185,13 +230,111 @@ std::pair<size_t, size_t> SpecRepo::assign(const ClientMaker& clientMaker) noexc
     return { 0, 0 };
   }
 
-  // allocate resource to less occupied node first
-  std::sort(nodes.begin(), nodes.end(), [](auto& n1, auto& n2) {
-    return n1.size < n2.size;
-  });
+  // specs are placed by a consistent hash ring of active nodes with virtual nodes, so a node joining or leaving
+  // moves about 1/N of specs only, and copies of a replicated spec land on distinct nodes.
+  // load is bounded: a node loaded more than SPEC_LOAD_FACTOR of the average in memory, blocks or query heat
+  // is passed over for new copies in favor of the next node on the ring, unless all nodes are over the bound.
+  auto& ci = ClusterInfo::singleton();
+  std::vector<std::unique_ptr<SpecHost>> hosts;
+  NodeLoad load;
+  for (const auto& n : nodes) {
+    if (n.isActive()) {
+      hosts.push_back(std::make_unique<SpecHost>(n));
+      load.add(hosts.back()->id(), ci.nodeStats(n));
+    }
+  }
+
+  const auto numHosts = hosts.size();
+  if (numHosts == 0) {
+    LOG(ERROR) << "No active node found to assign a spec.";
+    return { 0, size };
+  }
+
+  SpecRing ring(hosts);
+
+  // up to count nodes to host new copies of the spec besides the nodes holding it already
+  auto place = [&ring, &load, numHosts](const SpecPtr& spec, const std::vector<NNode>& held, size_t count) {
+    std::vector<NNode> picked;
+    std::vector<NNode> over;
+    for (auto host : ring.locate(*spec, numHosts)) {
+      if (picked.size() >= count) {
+        break;
+      }
+
+      const auto& node = host->node;
+      if (std::any_of(held.begin(), held.end(), [&node](const auto& n) { return n.equals(node); })) {
+        continue;
+      }
+
+      if (load.load(host->id()) > FLAGS_SPEC_LOAD_FACTOR) {
+        over.push_back(node);
+        continue;
+      }
+
+      picked.push_back(node);
+    }
+
+    for (size_t i = 0; i < over.size() && picked.size() < count; ++i) {
+      picked.push_back(over.at(i));
+    }
+
+    // picked nodes are charged right away so that one cycle doesn't pile new specs on the same node
+    for (const auto& node : picked) {
+      load.charge(node.toString(), spec->size());
+    }
+
+    return picked;
+  };
+
+  // new specs of a catching up table are dealt to active nodes in turn, so that every ingest pool takes a share
+  // of the backlog rather than the node owning it by hash, such as a restarted one, taking all of it.
+  // hot nodes are left out unless all nodes are hot.
+  std::vector<NNode> turns;
+  for (const auto& host : hosts) {
+    if (load.load(host->id()) <= FLAGS_SPEC_LOAD_FACTOR) {
+      turns.push_back(host->node);
+    }
+  }
+
+  if (turns.empty()) {
+    for (const auto& host : hosts) {
+      turns.push_back(host->node);
+    }
+  }
+
+  size_t turn = 0;
+  auto deal = [&turns, &turn, &load](const SpecPtr& spec, const std::vector<NNode>& held, size_t count) {
+    std::vector<NNode> picked;
+    for (size_t i = 0, size = turns.size(); i < size && picked.size() < count; ++i) {
+      const auto& node = turns.at(turn++ % size);
+      if (std::none_of(held.begin(), held.end(), [&node](const auto& n) { return n.equals(node); })) {
+        picked.push_back(node);
+      }
+    }
+
+    for (const auto& node : picked) {
+      load.charge(node.toString(), spec->size());
+    }
+
+    return picked;
+  };
+
+  // send the spec to a node to ingest
+  auto sync = [&clientMaker](const SpecPtr& spec, const NNode& node) {
+    auto client = clientMaker(node);
+    Task t(TaskType::INGESTION, std::static_pointer_cast<Identifiable>(spec));
+    TaskState state = client->task(t);
+    if (state == TaskState::FAILED || state == TaskState::QUEUE) {
+      // TODO(cao) - post process for case if this task failed?
+      LOG(WARNING) << "Task state: " << (char)state
+                   << " at node: " << node.toString()
+                   << " | " << t.signature();
+    }
+
+    return state;
+  };
 
   const auto& ts = TableService::singleton();
-  size_t idx = 0;
 
   // all active specs seen from active nodes in current cycle
   const auto& bm = BlockManager::init();
@@ -199,13 +342,11 @@ std::pair<size_t, size_t> SpecRepo::assign(const ClientMaker& clientMaker) noexc
   const auto activeSpecs = bm->activeSpecs();
 
   // for each spec
-  // TODO(cao): should we do hash-based shuffling here to ensure a stable assignment?
-  // Round-robin is easy to break the position affinity whenever new spec is coming
-  // Or we can keep order of the specs so that any old spec is associated.
   auto numTasks = 0;
   auto tables = ts->all();
   for (auto& registry : tables) {
     auto specs = registry->all();
+    size_t backlog = 0;
     for (auto& spec : specs) {
       // if current spec is assigned but somehow it's lost as we don't see it in active spec
       // we will need to make sure it's assigned again
@@ -216,43 +357,71 @@ std::pair<size_t, size_t> SpecRepo::assign(const ClientMaker& clientMaker) noexc
         resetSpec(spec);
       }
 
-      // if the spec is not assigned to a node yet
-      if (!spec->assigned()) {
-        auto startId = idx;
-        while (true) {
-          auto& n = nodes.at(idx);
-          if (n.isActive()) {
-            spec->affinity(n);
-            idx = (idx + 1) % size;
-            break;
-          }
+      backlog += !spec->assigned();
+    }
 
-          idx = (idx + 1) % size;
-          if (idx == startId) {
-            LOG(ERROR) << "No active node found to assign a spec.";
-            return { numTasks, size };
+    const auto catchup = FLAGS_KAFKA_CATCHUP_SPECS > 0
+                         && backlog >= FLAGS_KAFKA_CATCHUP_SPECS
+                         && specs.front()->table()->source == DataSource::KAFKA;
+    if (catchup) {
+      LOG(INFO) << fmt::format("Table {0} catches up {1} new specs on {2} nodes",
+                               specs.front()->table()->name, backlog, turns.size());
+    }
+
+    for (auto& spec : specs) {
+      // a new spec is placed on all its nodes at once, and copies on lost nodes are placed again
+      const auto replicas = spec->table()->replicas;
+      const auto copies = spec->copies();
+      if (copies.size() < replicas) {
+        // nodes taking over or giving up a copy don't get another one
+        auto held = copies;
+        if (spec->migrating()) {
+          held.push_back(spec->target());
+        }
+
+        const auto& retired = spec->retired();
+        held.insert(held.end(), retired.begin(), retired.end());
+
+        const auto count = replicas - copies.size();
+        auto added = catchup && !spec->assigned() ? deal(spec, held, count) : place(spec, held, count);
+
+        // a new spec is synced to all its nodes below, otherwise only new replicas are synced
+        if (!spec->assigned()) {
+          spec->affinity(added.front());
+          spec->replicas(std::vector<NNode>(added.begin() + 1, added.end()));
+          added.clear();
+        }
+
+        auto current = spec->replicas();
+        for (const auto& node : added) {
+          ++numTasks;
+          if (sync(spec, node) == TaskState::SUCCEEDED) {
+            current.push_back(node);
           }
         }
+
+        spec->replicas(std::move(current));
       }
 
       // check if the spec needs to be communicated to the node
       if (spec->needSync()) {
         ++numTasks;
 
-        // get the client
-        auto client = clientMaker(spec->affinity());
-        Task t(TaskType::INGESTION, std::static_pointer_cast<Identifiable>(spec));
-        TaskState state = client->task(t);
-
         // udpate spec state so that it won't be resent
-        if (state == TaskState::SUCCEEDED) {
+        if (sync(spec, spec->affinity()) == TaskState::SUCCEEDED) {
           spec->state(SpecState::READY);
-        } else if (state == TaskState::FAILED || state == TaskState::QUEUE) {
-          // TODO(cao) - post process for case if this task failed?
-          LOG(WARNING) << "Task state: " << (char)state
-                       << " at node: " << spec->affinity().toString()
-                       << " | " << t.signature();
         }
+
+        // a replica failing to take the spec is placed again in next cycle
+        std::vector<NNode> current;
+        for (const auto& node : spec->replicas()) {
+          ++numTasks;
+          if (sync(spec, node) == TaskState::SUCCEEDED) {
+            current.push_back(node);
+          }
+        }
+
+        spec->replicas(std::move(current));
       }
     }
   }
@@ -261,6 +430,140 @@ std::pair<size_t, size_t> SpecRepo::assign(const ClientMaker& clientMaker) noexc
   return { numTasks, size };
 }
 
+std::pair<size_t, size_t> SpecRepo::rebalance(const ClientMaker& clientMaker) noexcept {
+  std::lock_guard<std::mutex> lock(specsMutex_);
+
+  auto& ci = ClusterInfo::singleton();
+  std::vector<std::unique_ptr<SpecHost>> hosts;
+  NodeLoad load;
+  for (const auto& n : ci.nodes()) {
+    if (n.isActive()) {
+      hosts.push_back(std::make_unique<SpecHost>(n));
+      load.add(hosts.back()->id(), ci.nodeStats(n));
+    }
+  }
+
+  const auto numHosts = hosts.size();
+  if (numHosts < 2) {
+    return { 0, 0 };
+  }
+
+  const auto& bm = BlockManager::init();
+  const auto& emptySpecs = bm->emptySpecs();
+  const auto& metrics = IngestMetrics::singleton();
+
+  // blocks of the spec in the node, including blocks of its rollup tables
+  auto held = [&bm](const SpecPtr& spec, const NNode& node) {
+    TableSpecSet blocks;
+    const auto& states = bm->states(node);
+    for (auto itr = states.begin(); itr != states.end(); ++itr) {
+      if (itr->second->hasSpec(spec->id())) {
+        blocks.emplace(itr->first, spec->id());
+      }
+    }
+
+    return blocks;
+  };
+
+  // 1. complete migrations whose target holds the spec, and expire blocks of retired copies until they are gone.
+  // a retired copy stays skipped by queries in the meantime so that no block is counted twice.
+  size_t numMoving = 0;
+  size_t numDone = 0;
+  std::vector<SpecPtr> ready;
+  auto tables = TableService::singleton()->all();
+  for (auto& registry : tables) {
+    for (auto& spec : registry->all()) {
+      const auto& id = spec->id();
+      if (spec->migrating()) {
+        const auto& target = spec->target();
+        if (emptySpecs.contains(id)
+            || (!metrics.running(target.server, id) && !held(spec, target).empty())) {
+          LOG(INFO) << fmt::format("Spec {0} moved from {1} to {2}", id, spec->source().server, target.server);
+          spec->migrated();
+          ++numDone;
+        } else {
+          ++numMoving;
+        }
+      }
+
+      const auto retired = spec->retired();
+      for (const auto& node : retired) {
+        auto blocks = held(spec, node);
+        if (blocks.empty()) {
+          spec->release(node.toString());
+          continue;
+        }
+
+        Task t(TaskType::EXPIRATION, std::shared_ptr<Identifiable>(new BlockExpire(std::move(blocks))));
+        clientMaker(node)->task(t);
+      }
+
+      if (!spec->migrating() && spec->state() == SpecState::READY) {
+        ready.push_back(spec);
+      }
+    }
+  }
+
+  // 2. move ready specs off hot nodes, hottest first, to the next nodes on the hash ring below the average load.
+  // new migrations are limited so that a cluster doesn't spend its capacity on shuffling data around.
+  if (numMoving >= FLAGS_SPEC_MIGRATIONS) {
+    return { 0, numDone };
+  }
+
+  std::vector<NNode> hot;
+  for (const auto& host : hosts) {
+    if (load.load(host->id()) > FLAGS_SPEC_LOAD_FACTOR) {
+      hot.push_back(host->node);
+    }
+  }
+
+  std::sort(hot.begin(), hot.end(), [&load](const NNode& left, const NNode& right) {
+    return load.load(left.toString()) > load.load(right.toString());
+  });
+
+  SpecRing ring(hosts);
+  size_t numStarted = 0;
+  for (const auto& node : hot) {
+    const auto source = node.toString();
+    for (auto& spec : ready) {
+      if (numMoving + numStarted >= FLAGS_SPEC_MIGRATIONS || load.load(source) <= FLAGS_SPEC_LOAD_FACTOR) {
+        break;
+      }
+
+      const auto copies = spec->copies();
+      const auto& retired = spec->retired();
+      auto in = [](const std::vector<NNode>& nodes, const NNode& n) {
+        return std::any_of(nodes.begin(), nodes.end(), [&n](const auto& c) { return c.equals(n); });
+      };
+
+      if (spec->migrating() || !in(copies, node)) {
+        continue;
+      }
+
+      for (auto host : ring.locate(*spec, numHosts)) {
+        const auto& target = host->node;
+        if (in(copies, target) || in(retired, target) || load.load(host->id()) >= 1) {
+          continue;
+        }
+
+        Task t(TaskType::INGESTION, std::static_pointer_cast<Identifiable>(spec));
+        const auto state = clientMaker(target)->task(t);
+        if (state == TaskState::FAILED) {
+          LOG(WARNING) << "Failed to move spec " << spec->id() << " to node " << target.toString();
+          break;
+        }
+
+        spec->migrate(node, target);
+        load.move(source, host->id(), spec->size());
+        ++numStarted;
+        break;
+      }
+    }
+  }
+
+  return { numStarted, numDone };
+}
+
 size_t SpecRepo::lost(const std::string& addr) noexcept {
   // most likely called in the path of assign or expire
   // std::lock_guard<std::mutex> lock(specsMutex_);
@@ -271,8 +574,12 @@ size_t SpecRepo::lost(const std::string& addr) noexcept {
   for (auto& registry : tables) {
     auto specs = registry->all();
     for (auto& spec : specs) {
-      if (spec->assigned() && spec->affinity().toString() == addr) {
-        resetSpec(spec);
+      // a spec having other copies fails over to them, it's ingested again only if no copy is left
+      if (spec->drop(addr)) {
+        if (!spec->assigned()) {
+          resetSpec(spec);
+        }
+
         ++numSpecs;
       }
     }
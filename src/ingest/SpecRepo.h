@@ -70,6 +70,10 @@ public:
   // this method can be sub-routine of refresh
   std::pair<size_t, size_t> assign(const ClientMaker&) noexcept;
 
+  // move specs off hot nodes to cool ones, a spec is served by its old node until the new one ingests it.
+  // return number of migrations started and completed.
+  std::pair<size_t, size_t> rebalance(const ClientMaker&) noexcept;
+
   // unassign spec when we lost a node
   size_t lost(const std::string&) noexcept;
 
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StreamHead.h"
+
+#include <chrono>
+#include <glog/logging.h>
+
+#include "execution/BlockManager.h"
+#include "memory/BatchRow.h"
+
+/**
+ * Streaming head of a spec still being ingested.
+ */
+namespace nebula {
+namespace ingest {
+
+using nebula::execution::BlockManager;
+using nebula::execution::io::BatchBlock;
+using nebula::execution::io::BlockList;
+using nebula::execution::io::BlockLoader;
+using nebula::memory::Batch;
+using nebula::memory::BatchRow;
+using nebula::meta::BlockSignature;
+using nebula::meta::Table;
+using nebula::meta::TablePtr;
+using nebula::surface::RowData;
+
+static inline size_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+StreamHead::StreamHead(const TablePtr& table,
+                       const std::string& specId,
+                       std::atomic<size_t>& blockId,
+                       size_t intervalMs)
+  : table_{ table },
+    specId_{ specId },
+    blockId_{ blockId },
+    intervalMs_{ intervalMs },
+    range_{ std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() },
+    last_{ nowMs() },
+    watermark_{ 0 } {
+  // blocks published by this head are replaced by itself, they are not compacted by block manager
+  BlockManager::init()->hold(specId_);
+}
+
+StreamHead::~StreamHead() {
+  BlockManager::init()->release(specId_);
+}
+
+bool StreamHead::supports(const Table& table) {
+  if (table.pod() != nullptr) {
+    return false;
+  }
+
+  return BatchRow::supports(table.schema());
+}
+
+std::shared_ptr<Batch> StreamHead::batch(size_t capacity) const {
+  return std::make_shared<Batch>(*table_, capacity);
+}
+
+void StreamHead::add(const RowData& row) {
+  if (delta_ == nullptr) {
+    delta_ = batch(1024);
+  }
+
+  const size_t time = row.readLong(Table::TIME_COLUMN);
+  range_.first = std::min(range_.first, time);
+  range_.second = std::max(range_.second, time);
+  delta_->add(row);
+}
+
+void StreamHead::tick() {
+  if (nowMs() - last_ >= intervalMs_) {
+    publish();
+  }
+}
+
+void StreamHead::publish() {
+  last_ = nowMs();
+  if (delta_ == nullptr || delta_->getRows() == 0) {
+    return;
+  }
+
+  // a sealed delta is never modified, queries read it as any other block
+  delta_->seal();
+  const auto rows = delta_->getRows();
+  auto block = BlockLoader::from(BlockSignature{ table_->name(), blockId_++, range_.first, range_.second, specId_ }, delta_);
+  delta_ = nullptr;
+  range_ = { std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() };
+
+  BlockList list{ block };
+  BlockManager::init()->swap(
+    table_->name(), specId_, [](const BatchBlock&) { return false; }, list);
+  published_.push_back(block);
+  ids_.emplace(block->getId());
+  watermark_ += rows;
+
+  if (published_.size() > MAX_DELTAS) {
+    merge();
+  }
+}
+
+void StreamHead::merge() {
+  size_t rows = 0;
+  std::pair<size_t, size_t> range{ std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::min() };
+  for (const auto& block : published_) {
+    rows += block->data()->getRows();
+    range.first = std::min(range.first, block->start());
+    range.second = std::max(range.second, block->end());
+  }
+
+  auto merged = batch(rows);
+  for (const auto& block : published_) {
+    const auto& data = *block->data();
+    BatchRow row(data);
+    for (size_t i = 0, size = data.getRows(); i < size; ++i) {
+      merged->add(row.seek(i));
+    }
+  }
+
+  merged->seal();
+  auto block = BlockLoader::from(BlockSignature{ table_->name(), blockId_++, range.first, range.second, specId_ }, merged);
+
+  // the merged block replaces all deltas of this head in one step
+  BlockList list{ block };
+  auto ids = std::move(ids_);
+  BlockManager::init()->swap(
+    table_->name(), specId_, [&ids](const BatchBlock& b) { return ids.find(b.getId()) != ids.end(); }, list);
+
+  published_.clear();
+  published_.push_back(block);
+  ids_.clear();
+  ids_.emplace(block->getId());
+}
+
+} // namespace ingest
+} // namespace nebula
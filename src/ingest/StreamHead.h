@@ -0,0 +1,97 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "common/Hash.h"
+#include "execution/io/BlockLoader.h"
+#include "memory/Batch.h"
+#include "meta/MetaService.h"
+#include "surface/DataSurface.h"
+
+/**
+ * Streaming head of a spec still being ingested, it makes rows visible to queries before the spec completes.
+ * Rows added are buffered in a delta batch, which is sealed and published as a block of the spec every interval.
+ * Published blocks are never modified, so a query sees a consistent prefix of the rows of the head,
+ * which is all rows published before the query starts (watermark).
+ * Deltas are merged into one block when there are too many of them, and all of them are replaced by the
+ * final blocks in one swap when the spec completes, so final blocks are as large as they are without streaming.
+ */
+namespace nebula {
+namespace ingest {
+
+class StreamHead {
+public:
+  StreamHead(const nebula::meta::TablePtr& table,
+             const std::string& specId,
+             std::atomic<size_t>& blockId,
+             size_t intervalMs);
+  virtual ~StreamHead();
+
+  // only a table without partition or compound column can publish its head
+  static bool supports(const nebula::meta::Table&);
+
+public:
+  // buffer a row into the delta
+  void add(const nebula::surface::RowData&);
+
+  // publish the delta if the interval passes since last publish
+  void tick();
+
+  // seal and publish rows buffered since last publish
+  void publish();
+
+  // number of rows published
+  inline size_t watermark() const noexcept {
+    return watermark_;
+  }
+
+  // number of blocks published and not merged yet
+  inline size_t deltas() const noexcept {
+    return published_.size();
+  }
+
+private:
+  // merge all published deltas into one block
+  void merge();
+
+  // new delta batch
+  std::shared_ptr<nebula::memory::Batch> batch(size_t) const;
+
+private:
+  // deltas more than this are merged into one
+  static constexpr size_t MAX_DELTAS = 16;
+
+  const nebula::meta::TablePtr& table_;
+  const std::string& specId_;
+  std::atomic<size_t>& blockId_;
+  const size_t intervalMs_;
+
+  std::shared_ptr<nebula::memory::Batch> delta_;
+  std::pair<size_t, size_t> range_;
+  size_t last_;
+  size_t watermark_;
+
+  // published blocks of this head and their block ids
+  std::vector<std::shared_ptr<nebula::execution::io::BatchBlock>> published_;
+  nebula::common::unordered_set<size_t> ids_;
+};
+
+} // namespace ingest
+} // namespace nebula
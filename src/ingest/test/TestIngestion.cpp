@@ -16,17 +16,26 @@
 
 #include <common/Evidence.h>
 #include <fmt/format.h>
+#include <fstream>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 // TODO: https://github.com/varchar-io/nebula/issues/178
 // #include <pg_query.h>
 #include <storage/NFS.h>
 
+#include "execution/BlockManager.h"
 #include "execution/meta/SpecProvider.h"
+#include "ingest/Dictionary.h"
+#include "ingest/IngestMetrics.h"
 #include "ingest/IngestSpec.h"
+#include "ingest/NodeLoad.h"
+#include "ingest/Rollup.h"
+#include "ingest/RowFilter.h"
 #include "ingest/SpecRepo.h"
+#include "ingest/StreamHead.h"
 #include "meta/ClusterInfo.h"
 #include "meta/MetaDb.h"
+#include "memory/FlatRow.h"
 #include "meta/TableSpec.h"
 
 namespace nebula {
@@ -68,6 +77,12 @@ TEST(IngestTest, TestIngestSpec) {
   EXPECT_EQ(spec.domain(), "nebula");
   EXPECT_EQ(spec.table()->name, "test");
   EXPECT_EQ(spec.version(), "1.0");
+
+  // size of a spec sizes its blocks, it can be beyond 32 bits
+  const size_t large = 5ULL << 30;
+  nebula::ingest::IngestSpec big(
+    table, "1.0", "nebula", { std::make_shared<SpecSplit>("nebula/v2.x", large, 0) }, SpecState::NEW);
+  EXPECT_EQ(big.size(), large);
 }
 
 TEST(IngestTest, TestSpecGeneration) {
@@ -143,6 +158,301 @@ TEST(IngestTest, TestTimePatternSpecGeneration) {
     }
   }
 }
+TEST(IngestTest, TestRollup) {
+  TableSpec spec;
+  spec.name = "events";
+  spec.schema = "ROW<country:string, device:int, duration:bigint, score:double>";
+  spec.timeSpec.type = TimeType::STATIC;
+  spec.rollups.push_back(RollupSpec{ "hourly", { "country" }, { "duration", "score" }, 3600 });
+
+  auto table = spec.to(spec.rollups.front());
+  EXPECT_EQ(table->name(), "events@hourly");
+  EXPECT_EQ(TableSpec::base(table->name()), "events");
+  EXPECT_EQ(TableSpec::base("events"), "events");
+  EXPECT_EQ(table->schema()->size(), 9);
+  EXPECT_EQ(table->schema()->find("duration_sum")->k(), nebula::type::Kind::BIGINT);
+  EXPECT_EQ(table->schema()->find("score_max")->k(), nebula::type::Kind::DOUBLE);
+
+  // 10 rows into 2 countries x 2 hours
+  Rollup rollup(spec, spec.rollups.front());
+  nebula::memory::FlatRow row(1024);
+  for (auto i = 0; i < 10; ++i) {
+    row.reset();
+    row.write(Table::TIME_COLUMN, (int64_t)(7200 + (i % 2) * 3600 + i));
+    row.write("country", std::string(i < 5 ? "us" : "uk"));
+    row.write("device", (int32_t)i);
+    row.write("duration", (int64_t)i);
+    row.write("score", i * 0.5);
+    rollup.add(row);
+  }
+
+  EXPECT_EQ(rollup.size(), 4);
+  EXPECT_EQ(rollup.range().first, 7200);
+  EXPECT_EQ(rollup.range().second, 10800);
+
+  auto batch = rollup.batch();
+  EXPECT_EQ(rollup.size(), 0);
+  EXPECT_EQ(batch->getRows(), 4);
+
+  auto accessor = batch->makeAccessor();
+  int64_t count = 0;
+  int64_t sum = 0;
+  for (size_t i = 0; i < batch->getRows(); ++i) {
+    const auto& r = accessor->seek(i);
+    count += r.readLong(RollupSpec::COUNT);
+    sum += r.readLong("duration_sum");
+
+    // us at hour 2: rows 0, 2, 4
+    if (r.readString("country") == "us" && r.readLong(Table::TIME_COLUMN) == 7200) {
+      EXPECT_EQ(r.readLong(RollupSpec::COUNT), 3);
+      EXPECT_EQ(r.readLong("duration_min"), 0);
+      EXPECT_EQ(r.readLong("duration_max"), 4);
+      EXPECT_EQ(r.readDouble("score_sum"), 3);
+    }
+  }
+
+  EXPECT_EQ(count, 10);
+  EXPECT_EQ(sum, 45);
+}
+
+TEST(IngestTest, TestDerivedTable) {
+  TableSpec spec;
+  spec.name = "events";
+  spec.schema = "ROW<country:string, device:int, duration:bigint, score:double>";
+  spec.timeSpec.type = TimeType::STATIC;
+  spec.columnProps["country"] = Column{ true };
+  spec.columnProps["score"] = Column{ false, false, true };
+  spec.derived.push_back(DerivedSpec{ "us", { "score", "country" }, { { "country", FilterOp::EQ, "us" } } });
+  spec.derived.push_back(DerivedSpec{ "all", {}, {} });
+
+  // columns in order of the raw schema along with time, and their properties
+  auto table = spec.to(spec.derived.front());
+  EXPECT_EQ(table->name(), "events@us");
+  EXPECT_EQ(TableSpec::base(table->name()), "events");
+  const auto schema = table->schema();
+  ASSERT_EQ(schema->size(), 3);
+  EXPECT_EQ(schema->childType(0)->name(), "country");
+  EXPECT_EQ(schema->childType(1)->name(), "score");
+  EXPECT_EQ(schema->childType(2)->name(), Table::TIME_COLUMN);
+  EXPECT_TRUE(table->column("country").withBloomFilter);
+  EXPECT_TRUE(table->column("score").withCompress);
+
+  EXPECT_EQ(spec.to(spec.derived.back())->schema()->size(), 5);
+  EXPECT_THROW(spec.to(DerivedSpec{ "bad", { "none" }, {} }), nebula::common::NException);
+
+  // conditions of a derived table are on source columns
+  RowFilter filter(spec.derived.front().filters, nebula::type::TypeSerializer::from(spec.schema));
+  nebula::memory::FlatRow row(1024);
+  row.write("country", std::string("uk"));
+  EXPECT_FALSE(filter.match(row));
+  row.reset();
+  row.write("country", std::string("us"));
+  EXPECT_TRUE(filter.match(row));
+}
+
+TEST(IngestTest, TestRowFilter) {
+  auto schema = nebula::type::TypeSerializer::from("ROW<id:bigint, country:string, score:double>");
+  RowFilter filter({ { "id", FilterOp::GE, "5" },
+                     { "country", FilterOp::NOTNULL, "" },
+                     { "score", FilterOp::LT, "2.5" } },
+                   schema);
+  EXPECT_FALSE(filter.empty());
+  EXPECT_TRUE(RowFilter({}, schema).empty());
+
+  nebula::memory::FlatRow row(1024);
+  auto matches = 0;
+  for (auto i = 0; i < 10; ++i) {
+    row.reset();
+    row.write("id", (int64_t)i);
+    if (i % 3 == 0) {
+      row.writeNull("country");
+    } else {
+      row.write("country", std::string("us"));
+    }
+
+    row.write("score", i * 0.3);
+    if (filter.match(row)) {
+      // 5, 7, 8: country is not null, score under 2.5
+      EXPECT_TRUE(i == 5 || i == 7 || i == 8);
+      ++matches;
+    }
+  }
+
+  EXPECT_EQ(matches, 3);
+  EXPECT_THROW(RowFilter({ { "none", FilterOp::EQ, "1" } }, schema), nebula::common::NException);
+}
+
+TEST(IngestTest, TestEnrichment) {
+  auto local = nebula::storage::makeFS("local");
+  auto file = local->temp();
+  {
+    std::ofstream out(file);
+    out << "1,red\n2,blue\nbad line\n3,green,dark\n";
+  }
+
+  // color is looked up by id, it is not read from the source
+  ColumnProps props;
+  props["color"] = Column{ false, false, false, "", "", {}, {}, false, LookupInfo{ file, "id", 0 } };
+  Table table("enrich", nebula::type::TypeSerializer::from("ROW<id:int, color:string>"), props, {});
+  auto enrich = Dictionaries::singleton().enrichment(table);
+  ASSERT_TRUE(enrich != nullptr);
+  EXPECT_EQ(enrich->size(), 1);
+
+  // the dictionary is loaded once and shared
+  auto dictionary = enrich->at("color").dictionary;
+  ASSERT_TRUE(dictionary != nullptr);
+  EXPECT_EQ(dictionary->size(), 3);
+  EXPECT_EQ(Dictionaries::singleton().get(LookupInfo{ file, "id", 0 }), dictionary);
+
+  TimeSpec ts;
+  ts.type = TimeType::CURRENT;
+  MacroRow row(ts, 0, {}, enrich);
+  nebula::memory::FlatRow raw(1024);
+  for (auto i = 0; i < 5; ++i) {
+    raw.reset();
+    if (i == 0) {
+      raw.writeNull("id");
+    } else {
+      raw.write("id", (int32_t)i);
+    }
+
+    raw.writeNull("color");
+    const auto& r = row.set(&raw);
+    if (i == 0 || i == 4) {
+      EXPECT_TRUE(r.isNull("color"));
+      continue;
+    }
+
+    EXPECT_FALSE(r.isNull("color"));
+    EXPECT_EQ(r.readString("color"), i == 1 ? "red" : (i == 2 ? "blue" : "green,dark"));
+  }
+
+  local->rm(file);
+}
+
+TEST(IngestTest, TestStreamHead) {
+  TableSpec spec;
+  spec.name = "stream_head";
+  spec.schema = "ROW<id:bigint, country:string>";
+  spec.timeSpec.type = TimeType::STATIC;
+  auto table = spec.to();
+  EXPECT_TRUE(StreamHead::supports(*table));
+
+  const std::string specId = "stream_head@[0_0_100,]";
+  std::atomic<size_t> blockId{ 0 };
+  StreamHead head(table, specId, blockId, 3600000);
+  auto bm = nebula::execution::BlockManager::init();
+
+  // every publish adds a delta, they are merged into one once over 16
+  nebula::memory::FlatRow row(1024);
+  for (auto i = 0; i < 20; ++i) {
+    for (auto j = 0; j < 5; ++j) {
+      row.reset();
+      row.write(Table::TIME_COLUMN, (int64_t)(1000 + i));
+      row.write("id", (int64_t)(i * 5 + j));
+      row.write("country", std::string(j % 2 ? "us" : "uk"));
+      head.add(row);
+    }
+
+    head.publish();
+    EXPECT_EQ(head.watermark(), (i + 1) * 5);
+    EXPECT_EQ(bm->state(spec.name).numRows(), head.watermark());
+  }
+
+  // 17 deltas merged into 1, followed by 3 deltas
+  EXPECT_EQ(head.deltas(), 4);
+  EXPECT_EQ(bm->state(spec.name).numBlocks(), 4);
+
+  // nothing to publish
+  head.publish();
+  EXPECT_EQ(head.deltas(), 4);
+
+  // final blocks replace all published ones in one step
+  nebula::execution::io::BlockList none;
+  EXPECT_EQ(bm->swap(spec.name, specId, [](const auto&) { return true; }, none), 4);
+  EXPECT_EQ(bm->state(spec.name).numRows(), 0);
+}
+
+TEST(IngestTest, TestIngestMetrics) {
+  IngestMetrics metrics;
+  auto s1 = metrics.begin("t1", "s1");
+  auto s2 = metrics.begin("t2", "s2");
+  s1->rows(100);
+  s1->bytes(1000);
+  s1->add(Stage::PARSE, 20);
+  s1->add(Stage::FETCH, 10);
+  s2->errors(2);
+
+  // running specs are reported by the node
+  auto records = metrics.records();
+  EXPECT_EQ(records.size(), 2);
+  for (const auto& r : records) {
+    EXPECT_EQ(r.end, 0);
+  }
+
+  metrics.end(s1);
+  records = metrics.records();
+  EXPECT_EQ(records.size(), 2);
+  EXPECT_EQ(records.back().spec, "s1");
+  EXPECT_GT(records.back().end, 0);
+  EXPECT_EQ(records.back().rows, 100);
+  EXPECT_EQ(records.back().ms[static_cast<size_t>(Stage::PARSE)], 20);
+
+  // a server sums records of all nodes by table, along with its own
+  metrics.update("n1", { records.back() });
+  metrics.update("n2", { records.back() });
+  auto summary = metrics.summary("t1");
+  EXPECT_EQ(summary.specs, 3);
+  EXPECT_EQ(summary.running, 0);
+  EXPECT_EQ(summary.rows, 300);
+  EXPECT_EQ(summary.bytes, 3000);
+  EXPECT_EQ(summary.stages[static_cast<size_t>(Stage::FETCH)], 30);
+
+  // records of a node are replaced by its next report
+  metrics.update("n2", {});
+  EXPECT_EQ(metrics.summary("t1").specs, 2);
+  summary = metrics.summary("t2");
+  EXPECT_EQ(summary.specs, 1);
+  EXPECT_EQ(summary.running, 1);
+  EXPECT_EQ(summary.errors, 2);
+
+  // memory budget is disabled by default
+  EXPECT_FALSE(IngestMetrics::tight());
+}
+
+TEST(IngestTest, TestNodeLoad) {
+  NodeLoad load;
+  NodeStats s1{};
+  s1.memory = 100;
+  s1.blocks = 10;
+  NodeStats s2{};
+  s2.memory = 100;
+  s2.blocks = 10;
+  s2.heat = 0.5;
+  NodeStats s3{};
+  s3.memory = 100;
+  s3.blocks = 40;
+  load.add("n1", s1);
+  load.add("n2", s2);
+  load.add("n3", s3);
+  EXPECT_EQ(load.size(), 3);
+
+  // the worst dimension decides: n2 serves all queries, n3 holds too many blocks
+  EXPECT_DOUBLE_EQ(load.load("n1"), 1);
+  EXPECT_DOUBLE_EQ(load.load("n2"), 3);
+  EXPECT_DOUBLE_EQ(load.load("n3"), 2);
+  EXPECT_DOUBLE_EQ(load.load("n4"), 0);
+
+  // blocks and heat move along with bytes
+  load.move("n2", "n1", 50);
+  EXPECT_DOUBLE_EQ(load.load("n1"), 1.5);
+  EXPECT_DOUBLE_EQ(load.load("n2"), 1.5);
+
+  // a new spec is charged by its bytes
+  load.charge("n1", 300);
+  EXPECT_DOUBLE_EQ(load.load("n1"), 2.25);
+}
+
 } // namespace test
 } // namespace ingest
 } // namespace nebula
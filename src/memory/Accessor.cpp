@@ -42,19 +42,20 @@ RowAccessor& RowAccessor::seek(size_t rowId) {
   return *this;
 }
 
-#define READ_TYPE_BY_FIELD(TYPE, FUNC)                                    \
-  std::optional<TYPE> RowAccessor::FUNC(const std::string& field) const { \
-    if (N_UNLIKELY(batch_.pod_ != nullptr)) {                               \
-      TYPE v;                                                             \
-      if (batch_.pod_->value(field, batch_.spaces_, bessValue_, v)) {     \
-        return v;                                                         \
-      }                                                                   \
-    }                                                                     \
-    const auto& d = dnMap_.at(field);                                     \
-    if (N_UNLIKELY(d->isNull(current_))) {                                  \
-      return std::nullopt;                                                \
-    }                                                                     \
-    return d->read<TYPE>(current_);                                       \
+// a column not in the batch, such as one added to the table after the batch was ingested, reads as NULL
+#define READ_TYPE_BY_FIELD(TYPE, FUNC)                                        \
+  std::optional<TYPE> RowAccessor::FUNC(const std::string& field) const {     \
+    if (N_UNLIKELY(batch_.pod_ != nullptr)) {                                 \
+      TYPE v;                                                                 \
+      if (batch_.pod_->value(field, batch_.spaces_, bessValue_, v)) {         \
+        return v;                                                             \
+      }                                                                       \
+    }                                                                         \
+    auto node = dnMap_.find(field);                                           \
+    if (N_UNLIKELY(node == dnMap_.end() || node->second->isNull(current_))) { \
+      return std::nullopt;                                                    \
+    }                                                                         \
+    return node->second->read<TYPE>(current_);                                \
   }
 
 READ_TYPE_BY_FIELD(bool, readBool)
@@ -69,20 +70,64 @@ READ_TYPE_BY_FIELD(std::string_view, readString)
 
 #undef READ_TYPE_BY_FIELD
 
-// // compound types
-// // TODO(cao) - return a unique ptr seems unncessary expensive to create list accessor object every time
-// // we may want to maintain single instance and return a reference instead
-// std::unique_ptr<ListData> RowAccessor::readList(const std::string& field) const {
-//   // initilize a list data with child data node with
-//   auto listNode = dnMap_.at(field);
+std::optional<IndexType> RowAccessor::index(const std::string& field) const {
+  // partition column values are decoded from bess by name
+  if (N_UNLIKELY(batch_.pod_ != nullptr)) {
+    auto node = dnMap_.find(field);
+    if (node == dnMap_.end() || node->second->isPartition()) {
+      return std::nullopt;
+    }
+  }
 
-//   // list node has only one child - can be saved if list accessor is created once
-//   auto child = listNode->childAt<PDataNode>(0).value();
-//   auto os = listNode->offsetSize(current_);
+  const auto& schema = batch_.schema_;
+  for (size_t i = 0, size = schema->size(); i < size; ++i) {
+    if (schema->childType(i)->name() == field) {
+      return i;
+    }
+  }
 
-//   // calculate the offset in terms of number of items
-//   return std::make_unique<ListAccessor>(os.first, os.second, child);
-// }
+  return std::nullopt;
+}
+
+#define READ_TYPE_BY_INDEX(TYPE, FUNC)                           \
+  std::optional<TYPE> RowAccessor::FUNC(IndexType index) const { \
+    const auto& d = batch_.nodes_[index];                        \
+    if (N_UNLIKELY(d->isNull(current_))) {                       \
+      return std::nullopt;                                       \
+    }                                                            \
+    return d->read<TYPE>(current_);                              \
+  }
+
+READ_TYPE_BY_INDEX(bool, readBool)
+READ_TYPE_BY_INDEX(int8_t, readByte)
+READ_TYPE_BY_INDEX(int16_t, readShort)
+READ_TYPE_BY_INDEX(int32_t, readInt)
+READ_TYPE_BY_INDEX(int64_t, readLong)
+READ_TYPE_BY_INDEX(float, readFloat)
+READ_TYPE_BY_INDEX(double, readDouble)
+READ_TYPE_BY_INDEX(int128_t, readInt128)
+READ_TYPE_BY_INDEX(std::string_view, readString)
+
+#undef READ_TYPE_BY_INDEX
+
+// compound types
+// TODO(cao) - return a unique ptr seems unncessary expensive to create list accessor object every time
+// we may want to maintain single instance and return a reference instead
+std::unique_ptr<ListData> RowAccessor::readList(const std::string& field) const {
+  auto node = dnMap_.find(field);
+  if (node == dnMap_.end() || node->second->isNull(current_)) {
+    return nullptr;
+  }
+
+  // elements of the list are a range of its only child, an empty list has no accessor
+  const auto& d = node->second;
+  auto os = d->offsetSize(current_);
+  if (os.second == 0) {
+    return nullptr;
+  }
+
+  return std::make_unique<ListAccessor>(os.first, os.second, d->childAt<PDataNode>(0).value());
+}
 
 // std::unique_ptr<MapData> RowAccessor::readMap(const std::string&) const {
 //   return nullptr;
@@ -92,8 +137,8 @@ READ_TYPE_BY_FIELD(std::string_view, readString)
 ////////////////////////////////////////// List Accessor //////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-inline bool ListAccessor::isNull(IndexType index) const {
-  return node_->isNull(index);
+bool ListAccessor::isNull(IndexType index) const {
+  return node_->isNull(offset_ + index);
 }
 
 #define READ_TYPE_BY_ENTRY(TYPE, FUNC)             \
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ArrowBatch.h"
+
+#include <arrow/io/memory.h>
+#include <arrow/ipc/writer.h>
+#include <cstring>
+
+#include "common/Errors.h"
+
+/**
+ * Arrow export of batches and row cursors.
+ */
+namespace nebula {
+namespace memory {
+
+using nebula::surface::RowCursor;
+using nebula::surface::RowData;
+using nebula::type::Kind;
+using nebula::type::Schema;
+
+namespace {
+
+// a buffer referencing memory of a batch, the batch is kept alive as long as the buffer
+class BatchBuffer : public arrow::Buffer {
+public:
+  BatchBuffer(std::shared_ptr<Batch> batch, const void* data, int64_t size)
+    : arrow::Buffer(static_cast<const uint8_t*>(data), size), batch_{ std::move(batch) } {}
+  virtual ~BatchBuffer() = default;
+
+private:
+  std::shared_ptr<Batch> batch_;
+};
+
+inline void check(const arrow::Status& status) {
+  N_ENSURE(status.ok(), status.ToString());
+}
+
+template <typename T>
+inline T value(arrow::Result<T> result) {
+  check(result.status());
+  return std::move(result).ValueUnsafe();
+}
+
+inline arrow::Decimal128 decimal(int128_t v) {
+  return arrow::Decimal128(static_cast<int64_t>(v >> 64), static_cast<uint64_t>(v));
+}
+
+std::shared_ptr<arrow::DataType> arrowType(Kind kind) {
+  switch (kind) {
+  case Kind::BOOLEAN: return arrow::boolean();
+  case Kind::TINYINT: return arrow::int8();
+  case Kind::SMALLINT: return arrow::int16();
+  case Kind::INTEGER: return arrow::int32();
+  case Kind::BIGINT: return arrow::int64();
+  case Kind::REAL: return arrow::float32();
+  case Kind::DOUBLE: return arrow::float64();
+  case Kind::INT128: return arrow::decimal128(38, 0);
+  case Kind::VARCHAR: return arrow::utf8();
+  default:
+    throw NException(fmt::format("Arrow export not supporting type: {0}", nebula::type::TypeBase::kname(kind)));
+  }
+}
+
+// validity bitmap of a column with nulls and the number of nulls
+std::pair<std::shared_ptr<arrow::Buffer>, int64_t> validity(const Batch& batch, const std::string& col, size_t rows) {
+  nebula::surface::eval::Selection nulls;
+  batch.nulls(col, 0, rows, nulls);
+  if (nulls.empty()) {
+    return { nullptr, 0 };
+  }
+
+  std::shared_ptr<arrow::Buffer> bitmap = value(arrow::AllocateBuffer((rows + 7) / 8));
+  auto bits = bitmap->mutable_data();
+  std::memset(bits, 0xFF, bitmap->size());
+  for (auto row : nulls) {
+    bits[row >> 3] &= ~(1 << (row & 7));
+  }
+
+  return { bitmap, nulls.size() };
+}
+
+template <typename B, typename T>
+inline arrow::Status append(B& builder, const T& v) {
+  return builder.Append(v);
+}
+
+inline arrow::Status append(arrow::StringBuilder& builder, std::string_view v) {
+  return builder.Append(v.data(), v.size());
+}
+
+// build an array by reading optional values of every row
+template <typename B, typename R>
+std::shared_ptr<arrow::Array> build(B& builder, size_t rows, R&& read) {
+  check(builder.Reserve(rows));
+  for (size_t i = 0; i < rows; ++i) {
+    const auto v = read(i);
+    check(v ? append(builder, *v) : builder.AppendNull());
+  }
+
+  std::shared_ptr<arrow::Array> array;
+  check(builder.Finish(&array));
+  return array;
+}
+
+// fixed width values of a column taken from its memory or decoded from its encoding, nullptr if not available
+std::shared_ptr<arrow::Array> values(const std::shared_ptr<Batch>& batch,
+                                     const std::string& col,
+                                     const std::shared_ptr<arrow::DataType>& type,
+                                     size_t width) {
+  auto column = batch->scalar(col);
+  // default value replaces NULL values which are stored as 0
+  if (!column || column->defaultValue.has_value()) {
+    return nullptr;
+  }
+
+  const auto rows = batch->getRows();
+  std::shared_ptr<arrow::Buffer> buffer;
+  if (column->data != nullptr) {
+    buffer = std::make_shared<BatchBuffer>(batch, column->data, rows * width);
+  } else {
+    std::shared_ptr<arrow::Buffer> decoded = value(arrow::AllocateBuffer(rows * width));
+    if (!batch->decode(col, 0, rows, decoded->mutable_data())) {
+      return nullptr;
+    }
+
+    buffer = decoded;
+  }
+
+  std::pair<std::shared_ptr<arrow::Buffer>, int64_t> bitmap{ nullptr, 0 };
+  if (column->nullable) {
+    bitmap = validity(*batch, col, rows);
+  }
+
+  return arrow::MakeArray(arrow::ArrayData::Make(type, rows, { bitmap.first, buffer }, bitmap.second));
+}
+
+} // namespace
+
+std::shared_ptr<arrow::Schema> ArrowBatch::schema(const Schema& schema) {
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  fields.reserve(schema->size());
+  for (size_t i = 0, size = schema->size(); i < size; ++i) {
+    auto type = schema->childType(i);
+    fields.push_back(arrow::field(type->name(), arrowType(type->k())));
+  }
+
+  return arrow::schema(fields);
+}
+
+std::shared_ptr<arrow::RecordBatch> ArrowBatch::from(const std::shared_ptr<Batch>& batch) {
+  auto schema = batch->schema();
+  const auto rows = batch->getRows();
+  auto accessor = batch->makeAccessor();
+  std::vector<std::shared_ptr<arrow::Array>> arrays;
+  arrays.reserve(schema->size());
+  for (size_t i = 0, size = schema->size(); i < size; ++i) {
+    auto node = schema->childType(i);
+    const auto& name = node->name();
+    const auto type = arrowType(node->k());
+
+#define VALUES_CASE(K)                                                           \
+  case Kind::K: {                                                                \
+    array = values(batch, name, type, nebula::type::TypeTraits<Kind::K>::width); \
+    break;                                                                       \
+  }
+
+#define ARRAY_CASE(K, B, F)                                                                               \
+  case Kind::K: {                                                                                         \
+    B builder;                                                                                            \
+    array = build(builder, rows, [&accessor, &name](size_t row) { return accessor->seek(row).F(name); }); \
+    break;                                                                                                \
+  }
+
+    // layout of fixed width values is the same as arrow, no copy
+    std::shared_ptr<arrow::Array> array;
+    switch (node->k()) {
+      VALUES_CASE(TINYINT)
+      VALUES_CASE(SMALLINT)
+      VALUES_CASE(INTEGER)
+      VALUES_CASE(BIGINT)
+      VALUES_CASE(REAL)
+      VALUES_CASE(DOUBLE)
+    default:
+      break;
+    }
+
+    if (array == nullptr) {
+      switch (node->k()) {
+        ARRAY_CASE(BOOLEAN, arrow::BooleanBuilder, readBool)
+        ARRAY_CASE(TINYINT, arrow::Int8Builder, readByte)
+        ARRAY_CASE(SMALLINT, arrow::Int16Builder, readShort)
+        ARRAY_CASE(INTEGER, arrow::Int32Builder, readInt)
+        ARRAY_CASE(BIGINT, arrow::Int64Builder, readLong)
+        ARRAY_CASE(REAL, arrow::FloatBuilder, readFloat)
+        ARRAY_CASE(DOUBLE, arrow::DoubleBuilder, readDouble)
+        ARRAY_CASE(VARCHAR, arrow::StringBuilder, readString)
+      case Kind::INT128: {
+        arrow::Decimal128Builder builder(type);
+        array = build(builder, rows, [&accessor, &name](size_t row) -> std::optional<arrow::Decimal128> {
+          auto v = accessor->seek(row).readInt128(name);
+          return v ? std::optional<arrow::Decimal128>(decimal(*v)) : std::nullopt;
+        });
+        break;
+      }
+      default:
+        throw NException(fmt::format("Arrow export not supporting column: {0}", name));
+      }
+    }
+
+#undef ARRAY_CASE
+#undef VALUES_CASE
+
+    arrays.push_back(array);
+  }
+
+  return arrow::RecordBatch::Make(ArrowBatch::schema(schema), rows, arrays);
+}
+
+std::shared_ptr<arrow::RecordBatch> ArrowBatch::from(RowCursor& cursor, const Schema& schema) {
+  // a builder of every column, and a call appending a row value to it
+  const auto numColumns = schema->size();
+  std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders;
+  std::vector<std::function<arrow::Status(const RowData&)>> appends;
+  builders.reserve(numColumns);
+  appends.reserve(numColumns);
+  for (size_t i = 0; i < numColumns; ++i) {
+    auto node = schema->childType(i);
+    const auto& name = node->name();
+
+#define APPEND_CASE(K, B, F)                                                   \
+  case Kind::K: {                                                              \
+    auto builder = std::make_unique<B>();                                      \
+    auto ptr = builder.get();                                                  \
+    appends.push_back([ptr, name](const RowData& row) {                        \
+      return row.isNull(name) ? ptr->AppendNull() : append(*ptr, row.F(name)); \
+    });                                                                        \
+    builders.push_back(std::move(builder));                                    \
+    break;                                                                     \
+  }
+
+    switch (node->k()) {
+      APPEND_CASE(BOOLEAN, arrow::BooleanBuilder, readBool)
+      APPEND_CASE(TINYINT, arrow::Int8Builder, readByte)
+      APPEND_CASE(SMALLINT, arrow::Int16Builder, readShort)
+      APPEND_CASE(INTEGER, arrow::Int32Builder, readInt)
+      APPEND_CASE(BIGINT, arrow::Int64Builder, readLong)
+      APPEND_CASE(REAL, arrow::FloatBuilder, readFloat)
+      APPEND_CASE(DOUBLE, arrow::DoubleBuilder, readDouble)
+      APPEND_CASE(VARCHAR, arrow::StringBuilder, readString)
+    case Kind::INT128: {
+      auto builder = std::make_unique<arrow::Decimal128Builder>(arrowType(Kind::INT128));
+      auto ptr = builder.get();
+      appends.push_back([ptr, name](const RowData& row) {
+        return row.isNull(name) ? ptr->AppendNull() : append(*ptr, decimal(row.readInt128(name)));
+      });
+      builders.push_back(std::move(builder));
+      break;
+    }
+    default:
+      throw NException(fmt::format("Arrow export not supporting column: {0}", name));
+    }
+
+#undef APPEND_CASE
+  }
+
+  size_t rows = 0;
+  while (cursor.hasNext()) {
+    const auto& row = cursor.next();
+    for (auto& append : appends) {
+      check(append(row));
+    }
+
+    ++rows;
+  }
+
+  std::vector<std::shared_ptr<arrow::Array>> arrays;
+  arrays.reserve(numColumns);
+  for (auto& builder : builders) {
+    std::shared_ptr<arrow::Array> array;
+    check(builder->Finish(&array));
+    arrays.push_back(array);
+  }
+
+  return arrow::RecordBatch::Make(ArrowBatch::schema(schema), rows, arrays);
+}
+
+std::string ArrowBatch::ipc(const std::shared_ptr<arrow::Schema>& schema,
+                            const std::vector<std::shared_ptr<arrow::RecordBatch>>& batches) {
+  auto sink = value(arrow::io::BufferOutputStream::Create());
+  auto writer = value(arrow::ipc::MakeStreamWriter(sink.get(), schema));
+  for (const auto& batch : batches) {
+    check(writer->WriteRecordBatch(*batch));
+  }
+
+  check(writer->Close());
+  return value(sink->Finish())->ToString();
+}
+
+} // namespace memory
+} // namespace nebula
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <arrow/api.h>
+
+#include "Batch.h"
+#include "surface/DataSurface.h"
+#include "type/Type.h"
+
+/**
+ * Export data as Arrow record batches for external consumers such as pandas or pyarrow.
+ * Fixed width columns of a sealed batch are exposed without copying when their layouts match Arrow:
+ * values buffer of an array points to the column memory directly and keeps the batch alive.
+ * Boolean (bit packed in Arrow), string, int128, encoded, partition and default-valued columns are copied.
+ * Compound columns are not supported.
+ */
+namespace nebula {
+namespace memory {
+
+class ArrowBatch {
+public:
+  // arrow schema of given schema, throws if it has a compound column
+  static std::shared_ptr<arrow::Schema> schema(const nebula::type::Schema&);
+
+  // columns of a sealed batch in a record batch, the batch lives as long as any array referencing it
+  static std::shared_ptr<arrow::RecordBatch> from(const std::shared_ptr<Batch>&);
+
+  // all rows of a cursor in a record batch of given schema, rows are consumed
+  static std::shared_ptr<arrow::RecordBatch> from(nebula::surface::RowCursor&, const nebula::type::Schema&);
+
+  // serialize record batches of the same schema in Arrow IPC stream format
+  static std::string ipc(const std::shared_ptr<arrow::Schema>&, const std::vector<std::shared_ptr<arrow::RecordBatch>>&);
+};
+
+} // namespace memory
+} // namespace nebula
@@ -15,20 +15,43 @@
  */
 
 #include "Batch.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <numeric>
+#include <thread>
+
+#include "BatchRow.h"
+#include "common/Numa.h"
+#include "common/Sum.h"
 
 DEFINE_int32(BESS_PAGE_SIZE, 1024, "page size for bess encoded data");
+DEFINE_uint64(ZONE_ROWS, 8192, "rows of every stripe in zone map built at batch seal, 0 to disable");
+DEFINE_uint64(COMPRESS_PAGE, 16384, "page size in bytes of LZ4 compressed columns of cold batches");
+DEFINE_double(DICT_RATIO, 0.1, "string columns are dictionary encoded at batch seal if distinct values are within the ratio of values, 0 to disable");
+DEFINE_double(BLOOM_FPP, 0.001, "target false positive rate of bloom filters built at batch seal");
+DEFINE_uint32(BLOOM_THREADS, 1, "threads to build bloom filters of columns at batch seal, 1 to build them in place");
+DEFINE_uint64(BITMAP_VALUES, 4096, "bitmap index of a column in a batch is dropped if it has more distinct values");
+DEFINE_double(ENCODE_RATIO, 0.5, "integer columns are RLE encoded at batch seal if encoded size is within the ratio of raw size, 0 to disable");
 
 namespace nebula {
 namespace memory {
 
 using nebula::meta::BessType;
+using nebula::surface::eval::Histogram;
+using nebula::surface::eval::IntHistogram;
+using nebula::surface::eval::RealHistogram;
 using nebula::meta::Table;
 using nebula::surface::RowData;
 using nebula::type::Schema;
 using nebula::type::TreeBase;
 using nebula::type::TypeBase;
 
+// name of the element column of an array column
+inline std::string items(const std::string& col) {
+  return col + "[]";
+}
+
 Batch::Batch(const Table& table, size_t capacity, size_t pid)
   : schema_{ table.schema() },
     data_{ DataNode::buildDataTree(table, capacity) },
@@ -36,12 +59,45 @@ Batch::Batch(const Table& table, size_t capacity, size_t pid)
     pid_{ pid },
     bess_{ pod_ != nullptr ? (size_t)FLAGS_BESS_PAGE_SIZE : 0 },
     rows_{ 0 },
+    zoneRows_{ 0 },
     fields_{ schema_->size() },
-    sealed_{ false } {
+    reclaimed_{ 0 },
+    sealed_{ false },
+    numa_{ nebula::common::Numa::singleton().home() } {
   // build a field name to data node
   for (size_t i = 0, size = schema_->size(); i < size; ++i) {
     auto f = dynamic_cast<TypeBase*>(schema_->TreeBase::childAt(i).get());
-    fields_[f->name()] = data_->childAt<PDataNode>(i).value();
+    auto node = data_->childAt<PDataNode>(i).value();
+    fields_[f->name()] = node;
+    nodes_.push_back(node);
+
+    // elements of all lists are read as a column of the batch by the kernels
+    if (f->k() == nebula::type::Kind::ARRAY) {
+      fields_[items(f->name())] = node->childAt<PDataNode>(0).value();
+    }
+
+    const auto& column = table.column(f->name());
+    if (f->k() == nebula::type::Kind::VARCHAR && column.withTokens) {
+      tokens_[f->name()] = std::make_unique<TokenIndex>();
+    }
+
+    // partition columns are indexed by bess already
+    if (column.withBitmap && !node->isPartition()) {
+      const size_t limit = FLAGS_BITMAP_VALUES;
+      switch (f->k()) {
+      case nebula::type::Kind::TINYINT:
+      case nebula::type::Kind::SMALLINT:
+      case nebula::type::Kind::INTEGER:
+      case nebula::type::Kind::BIGINT:
+        bitmaps_[f->name()] = std::make_unique<Bitmap>(std::in_place_type<BitmapIndex<int64_t>>, limit);
+        break;
+      case nebula::type::Kind::VARCHAR:
+        bitmaps_[f->name()] = std::make_unique<Bitmap>(std::in_place_type<BitmapIndex<std::string>>, limit);
+        break;
+      default:
+        break;
+      }
+    }
   }
 
   // if current batch belongs to a pod, then we can decode spaces for each dimensions
@@ -73,6 +129,25 @@ size_t Batch::add(const RowData& row, BessType bess) {
   return rows_++;
 }
 
+// add rows column by column, which is the same as adding them one by one
+size_t Batch::add(const std::vector<ColumnVector>& columns, size_t rows, const BessType* bess) {
+  N_ENSURE(!sealed_, "can not add rows into sealed batch");
+  N_ENSURE_EQ(columns.size(), nodes_.size(), "a column vector for every column is expected");
+  if (pod_ != nullptr) {
+    N_ENSURE_NOT_NULL(bess, "bess of every row is required for partitioned batch");
+    for (size_t i = 0; i < rows; ++i) {
+      bess_.writeBits((rows_ + i) * bessBits_, bessBits_, bess[i]);
+    }
+  }
+
+  auto result = data_->append(columns, rows);
+  VLOG(1) << "Total size of " << rows << " rows = " << result;
+
+  const auto first = rows_;
+  rows_ += rows;
+  return first;
+}
+
 // random access to a row - may require internal seek
 std::unique_ptr<RowAccessor> Batch::makeAccessor() const {
   return std::make_unique<RowAccessor>(const_cast<const Batch&>(*this));
@@ -98,15 +173,262 @@ std::string Batch::state() const {
     });
 
   // TODO(cao): output a JSON string
-  return fmt::format("[raw: {0}, size: {1}, allocation: {2}, rows: {3}, bess: {4}]",
-                     data_->rawSize(), std::get<1>(s), std::get<0>(s), rows_, bess_.size());
+  return fmt::format("[raw: {0}, size: {1}, allocation: {2}, rows: {3}, bess: {4}, reclaimed: {5}]",
+                     data_->rawSize(), std::get<1>(s), std::get<0>(s), rows_, bess_.size(), reclaimed_);
+}
+
+nebula::meta::BlockMemory Batch::memory() const {
+  nebula::meta::BlockMemory memory;
+  memory.columns.resize(nodes_.size());
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    auto& column = memory.columns[i];
+    nodes_[i]->memory(column);
+
+    // zone maps of the column
+    const auto& name = schema_->childType(i)->name();
+    auto zones = zones_.find(name);
+    if (zones != zones_.end()) {
+      for (const auto& z : zones->second) {
+        column.histogram += z->bytes();
+      }
+    }
+
+    // token and bitmap indexes are value indexes as bloom filter is
+    auto tokens = tokens_.find(name);
+    if (tokens != tokens_.end()) {
+      column.bloom += tokens->second->bytes();
+    }
+
+    auto bitmap = bitmaps_.find(name);
+    if (bitmap != bitmaps_.end()) {
+      column.bloom += std::visit([](const auto& index) { return index.bytes(); }, *bitmap->second);
+    }
+  }
+
+  memory.bess = bess_.size();
+  return memory;
+}
+
+std::optional<nebula::surface::eval::ScalarColumn> Batch::scalar(const std::string& col) const {
+  auto node = fields_.find(col);
+  if (node == fields_.end()) {
+    return std::nullopt;
+  }
+
+  // partition column values are encoded in bess rather than data stream
+  const auto dn = node->second;
+  if (dn->isPartition()) {
+    return std::nullopt;
+  }
+
+  // an encoded column has no raw data, its values are decoded in batches
+  if (dn->raw() == nullptr && !dn->encoded()) {
+    return std::nullopt;
+  }
+
+#define DISPATCH_KIND(KIND)                                                                       \
+  case nebula::type::Kind::KIND: {                                                                \
+    using ET = nebula::type::TypeTraits<nebula::type::Kind::KIND>::CppType;                       \
+    return nebula::surface::eval::ScalarColumn{                                                   \
+      dn->raw(), dn->hasNulls(), dn->hasDefault() ? std::any(dn->defaultValue<ET>()) : std::any() \
+    };                                                                                            \
+  }
+
+  switch (dn->kind()) {
+    DISPATCH_KIND(BOOLEAN)
+    DISPATCH_KIND(TINYINT)
+    DISPATCH_KIND(SMALLINT)
+    DISPATCH_KIND(INTEGER)
+    DISPATCH_KIND(BIGINT)
+    DISPATCH_KIND(REAL)
+    DISPATCH_KIND(DOUBLE)
+  default:
+    return std::nullopt;
+  }
+
+#undef DISPATCH_KIND
+}
+
+std::optional<nebula::surface::eval::StringColumn> Batch::strings(const std::string& col) const {
+  auto node = fields_.find(col);
+  if (node == fields_.end()) {
+    return std::nullopt;
+  }
+
+  // NULL rows of a column having default value read as the default, which is not in any head
+  const auto dn = node->second;
+  if (dn->isPartition() || dn->hasDefault()) {
+    return std::nullopt;
+  }
+
+  const auto heads = dn->heads();
+  if (heads == nullptr) {
+    return std::nullopt;
+  }
+
+  return nebula::surface::eval::StringColumn{
+    heads, dn->hasNulls(), [dn](const nebula::common::StringHead& head) { return dn->heap(head); }
+  };
+}
+
+std::optional<nebula::surface::eval::ListColumn> Batch::list(const std::string& col) const {
+  auto node = fields_.find(col);
+  if (node == fields_.end() || node->second->kind() != nebula::type::Kind::ARRAY) {
+    return std::nullopt;
+  }
+
+  const auto dn = node->second;
+  return nebula::surface::eval::ListColumn{
+    dn->offsets(), dn->spans(), items(col), dn->childAt<PDataNode>(0).value()->kind()
+  };
+}
+
+bool Batch::decode(const std::string& col, size_t start, size_t count, void* out) const {
+  auto node = fields_.find(col);
+  if (node == fields_.end() || node->second->isPartition()) {
+    return false;
+  }
+
+#define DISPATCH_KIND(KIND)                                                 \
+  case nebula::type::Kind::KIND: {                                          \
+    using ET = nebula::type::TypeTraits<nebula::type::Kind::KIND>::CppType; \
+    return node->second->decode<ET>(start, count, static_cast<ET*>(out));   \
+  }
+
+  switch (node->second->kind()) {
+    DISPATCH_KIND(SMALLINT)
+    DISPATCH_KIND(INTEGER)
+    DISPATCH_KIND(BIGINT)
+  default:
+    return false;
+  }
+
+#undef DISPATCH_KIND
+}
+
+std::pair<size_t, size_t> Batch::rows(const std::string& col, int64_t low, int64_t high) const {
+  // NULL rows are stored as 0 which breaks the order of values
+  auto node = fields_.find(col);
+  if (node != fields_.end() && !node->second->isPartition() && !node->second->hasNulls()) {
+    auto range = node->second->rows(low, high);
+    if (range) {
+      return range.value();
+    }
+  }
+
+  return { 0, rows_ };
+}
+
+bool Batch::match(const std::string& col, int64_t low, int64_t high, size_t start, size_t count, uint8_t* mask) const {
+  auto node = fields_.find(col);
+  return node != fields_.end() && !node->second->isPartition() && node->second->match(low, high, start, count, mask);
+}
+
+void Batch::nulls(const std::string& col, size_t start, size_t end, nebula::surface::eval::Selection& rows) const {
+  fields_.at(col)->nulls(start, end, [&rows](size_t row) { rows.add(row); });
+}
+
+bool Batch::valid(const std::string& col, size_t start, size_t count, uint8_t* mask) const {
+  auto node = fields_.find(col);
+  return node != fields_.end() && !node->second->isPartition() && node->second->valid(start, count, mask);
+}
+
+bool Batch::exact(const std::string& col) const {
+  auto node = fields_.find(col);
+  if (node == fields_.end()) {
+    return false;
+  }
+
+  const auto dn = node->second;
+  return !dn->isPartition() && !dn->hasDefault();
+}
+
+PDataNode Batch::dictionary(const std::string& col) const {
+  auto node = fields_.find(col);
+  if (node == fields_.end()) {
+    return nullptr;
+  }
+
+  const auto dn = node->second;
+  if (!dn->hasDict() || dn->isPartition() || dn->hasDefault()) {
+    return nullptr;
+  }
+
+  return dn;
+}
+
+size_t Batch::dictSize(const std::string& col) const {
+  auto dn = dictionary(col);
+  return dn ? dn->dictSize() : 0;
+}
+
+std::string_view Batch::dictItem(const std::string& col, int32_t code) const {
+  return fields_.at(col)->dictItem(code);
+}
+
+size_t Batch::distinctValues(const std::string& col) const {
+  auto node = fields_.find(col);
+  if (node == fields_.end()) {
+    return 0;
+  }
+
+  // values of a partition column are those in the space of this batch
+  if (node->second->isPartition()) {
+    return partitionValues(col).size();
+  }
+
+  return node->second->distinctValues();
+}
+
+void Batch::selectCodes(const std::string& col,
+                        const std::vector<bool>& codes,
+                        nebula::surface::eval::Selection& selection) const {
+  const auto& dn = fields_.at(col);
+  selection.keep([&dn, &codes](size_t row) {
+    return !dn->isNull(row) && codes[dn->dictCode(row)];
+  });
+}
+
+bool Batch::runs(const std::string& col,
+                 size_t start,
+                 size_t end,
+                 std::vector<nebula::surface::eval::Run>& runs) const {
+  if (pod_ == nullptr) {
+    return false;
+  }
+
+  const auto bits = pod_->bits(col);
+  if (!bits) {
+    return false;
+  }
+
+  // value index of the column is the bits at its shift in bess of every row, rows of a batch are mostly
+  // ingested in runs of the same partition value so they are merged into runs while decoding.
+  const auto [shift, width] = bits.value();
+  for (size_t row = start, last = std::min(end, rows_); row < last; ++row) {
+    const size_t code = bess_.readBits(row * bessBits_ + shift, width);
+    if (runs.empty() || runs.back().last != row || runs.back().code != code) {
+      runs.push_back({ row, row + 1, code });
+      continue;
+    }
+
+    ++runs.back().last;
+  }
+
+  return true;
 }
 
 void Batch::seal() {
   N_ENSURE(!sealed_, "batch is already sealed.");
   sealed_ = true;
 
-  // seal every node
+  // low cardinality strings are moved into dictionary before they are sealed
+  if (FLAGS_DICT_RATIO > 0) {
+    data_->dictEncode(FLAGS_DICT_RATIO);
+  }
+
+  // seal every node, every slice is compacted to its exact size
+  const auto before = data_->capacity() + bess_.size();
   data_->seal();
 
   // seal bess as well
@@ -114,6 +436,306 @@ void Batch::seal() {
     auto bits = (rows_ * bessBits_);
     bess_.seal(bits / 8 + 1);
   }
+
+  const auto after = data_->capacity() + bess_.size();
+  reclaimed_ = before > after ? before - after : 0;
+
+  // bloom filters are sized by distinct values known at seal, built before values are encoded
+  buildBlooms();
+
+  // zone map is only useful when the batch has more than one stripe
+  if (FLAGS_ZONE_ROWS > 0 && rows_ > FLAGS_ZONE_ROWS) {
+    buildZones(FLAGS_ZONE_ROWS);
+  }
+
+  if (!tokens_.empty()) {
+    buildTokens();
+  }
+
+  if (!bitmaps_.empty()) {
+    buildBitmaps();
+  }
+
+  // zone map is built from raw data, so encode data after it
+  if (FLAGS_ENCODE_RATIO > 0) {
+    data_->encode(FLAGS_ENCODE_RATIO);
+  }
+}
+
+std::shared_ptr<Batch> Batch::sorted(const Table& table, const std::string& col) const {
+  N_ENSURE(!sealed_, "only unsealed batch can be sorted.");
+  auto type = schema_->find(col);
+  if (pod_ != nullptr || !type || !BatchRow::supports(schema_)) {
+    return nullptr;
+  }
+
+  // sort key of every row
+  std::vector<int64_t> keys;
+  keys.reserve(rows_);
+  auto accessor = makeAccessor();
+  switch (type->k()) {
+#define KEY_KIND(KIND, FUNC)                                                                \
+  case nebula::type::Kind::KIND: {                                                          \
+    for (size_t i = 0; i < rows_; ++i) {                                                    \
+      const auto value = accessor->seek(i).FUNC(col);                                       \
+      keys.push_back(value ? (int64_t)value.value() : std::numeric_limits<int64_t>::min()); \
+    }                                                                                       \
+    break;                                                                                  \
+  }
+
+    KEY_KIND(TINYINT, readByte)
+    KEY_KIND(SMALLINT, readShort)
+    KEY_KIND(INTEGER, readInt)
+    KEY_KIND(BIGINT, readLong)
+
+#undef KEY_KIND
+  default: return nullptr;
+  }
+
+  if (std::is_sorted(keys.begin(), keys.end())) {
+    return nullptr;
+  }
+
+  std::vector<size_t> order(rows_);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&keys](size_t left, size_t right) {
+    return keys[left] < keys[right];
+  });
+
+  auto batch = std::make_shared<Batch>(table, rows_, pid_);
+  BatchRow row(*this);
+  for (auto i : order) {
+    batch->add(row.seek(i));
+  }
+
+  return batch;
+}
+
+void Batch::compress() {
+  N_ENSURE(sealed_, "only sealed batch can be compressed.");
+  data_->compress(FLAGS_COMPRESS_PAGE);
+}
+
+// min/max/count of every stripe of a number column, NULL rows are not counted unless default value is set
+template <typename T>
+static std::vector<std::shared_ptr<Histogram>> stripes(
+  const PDataNode& dn, const nebula::surface::eval::ScalarColumn& sc, size_t rows, size_t zoneRows) {
+  using HT = std::conditional_t<std::is_floating_point_v<T>, RealHistogram, IntHistogram>;
+  const auto data = static_cast<const T*>(sc.data);
+  const auto hasDefault = sc.defaultValue.has_value();
+  const auto def = hasDefault ? std::any_cast<T>(sc.defaultValue) : T{};
+  std::vector<std::shared_ptr<Histogram>> zones;
+  zones.reserve((rows + zoneRows - 1) / zoneRows);
+  for (size_t start = 0; start < rows; start += zoneRows) {
+    auto histo = std::make_shared<HT>();
+    const auto end = std::min(rows, start + zoneRows);
+
+    // a column without NULL is reduced by kernels over the stripe, integer sums are clamped rather than wrapped
+    if (!sc.nullable && start < end) {
+      const auto [min, max] = std::minmax_element(data + start, data + end);
+      histo->v_min = *min;
+      histo->v_max = *max;
+      histo->count = end - start;
+      if constexpr (std::is_floating_point_v<T>) {
+        nebula::common::FloatSum sum;
+        sum.add(data + start, end - start);
+        histo->v_sum = sum.value();
+      } else {
+        nebula::common::SafeSum sum;
+        sum.add(data + start, end - start);
+        histo->v_sum = sum.narrow();
+      }
+
+      zones.push_back(std::move(histo));
+      continue;
+    }
+
+    for (size_t i = start; i < end; ++i) {
+      T v = data[i];
+      if (sc.nullable && dn->isNull(i)) {
+        if (!hasDefault) {
+          continue;
+        }
+
+        v = def;
+      }
+
+      histo->v_min = std::min<decltype(histo->v_min)>(histo->v_min, v);
+      histo->v_max = std::max<decltype(histo->v_max)>(histo->v_max, v);
+      histo->v_sum += v;
+      ++histo->count;
+    }
+
+    zones.push_back(std::move(histo));
+  }
+
+  return zones;
+}
+
+void Batch::buildZones(size_t zoneRows) {
+  zoneRows_ = zoneRows;
+  for (size_t i = 0, size = schema_->size(); i < size; ++i) {
+    auto f = dynamic_cast<TypeBase*>(schema_->TreeBase::childAt(i).get());
+    const auto& name = f->name();
+    auto sc = scalar(name);
+    if (!sc || !sc->data) {
+      continue;
+    }
+
+#define DISPATCH_KIND(KIND)                                                                           \
+  case nebula::type::Kind::KIND: {                                                                    \
+    zones_[name] = stripes<nebula::type::TypeTraits<nebula::type::Kind::KIND>::CppType>(nodes_.at(i), \
+                                                                                       sc.value(),    \
+                                                                                       rows_,         \
+                                                                                       zoneRows);     \
+    break;                                                                                            \
+  }
+
+    switch (f->k()) {
+      DISPATCH_KIND(TINYINT)
+      DISPATCH_KIND(SMALLINT)
+      DISPATCH_KIND(INTEGER)
+      DISPATCH_KIND(BIGINT)
+      DISPATCH_KIND(REAL)
+      DISPATCH_KIND(DOUBLE)
+    default:
+      break;
+    }
+
+#undef DISPATCH_KIND
+  }
+}
+
+void Batch::buildBlooms() {
+  const auto fpp = FLAGS_BLOOM_FPP;
+  const auto threads = std::min<size_t>(FLAGS_BLOOM_THREADS, nodes_.size());
+  if (threads <= 1) {
+    for (auto& node : nodes_) {
+      node->buildBloom(fpp);
+    }
+    return;
+  }
+
+  // columns are independent, every worker takes the next column until all are built
+  std::atomic<size_t> next{ 0 };
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([this, fpp, &next]() {
+      for (auto i = next++; i < nodes_.size(); i = next++) {
+        nodes_[i]->buildBloom(fpp);
+      }
+    });
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+void Batch::buildTokens() {
+  auto accessor = makeAccessor();
+  for (auto& item : tokens_) {
+    const auto& name = item.first;
+    auto& index = *item.second;
+    for (size_t i = 0; i < rows_; ++i) {
+      const auto value = accessor->seek(i).readString(name);
+      if (value) {
+        index.add(i, value.value());
+      }
+    }
+
+    index.seal();
+  }
+}
+
+size_t Batch::terms(const std::string& col) const {
+  auto tokens = tokens_.find(col);
+  return tokens == tokens_.end() ? 0 : tokens->second->size();
+}
+
+std::vector<bool> Batch::matchTerms(const std::string& col,
+                                    const std::function<bool(std::string_view)>& pred) const {
+  return tokens_.at(col)->match(pred, rows_);
+}
+
+void Batch::buildBitmaps() {
+  auto accessor = makeAccessor();
+  for (auto& item : bitmaps_) {
+    const auto& name = item.first;
+    auto& bitmap = *item.second;
+    const auto kind = schema_->find(name)->k();
+
+#define INDEX_KIND(KIND, FUNC)                             \
+  case nebula::type::Kind::KIND: {                         \
+    auto& index = std::get<BitmapIndex<int64_t>>(bitmap);  \
+    for (size_t i = 0; i < rows_; ++i) {                   \
+      const auto value = accessor->seek(i).FUNC(name);     \
+      if (value) {                                         \
+        index.add(i, static_cast<int64_t>(value.value())); \
+      }                                                    \
+    }                                                      \
+    index.seal();                                          \
+    break;                                                 \
+  }
+
+    switch (kind) {
+      INDEX_KIND(TINYINT, readByte)
+      INDEX_KIND(SMALLINT, readShort)
+      INDEX_KIND(INTEGER, readInt)
+      INDEX_KIND(BIGINT, readLong)
+    case nebula::type::Kind::VARCHAR: {
+      auto& index = std::get<BitmapIndex<std::string>>(bitmap);
+      for (size_t i = 0; i < rows_; ++i) {
+        const auto value = accessor->seek(i).readString(name);
+        if (value) {
+          index.add(i, value.value());
+        }
+      }
+      index.seal();
+      break;
+    }
+    default:
+      break;
+    }
+
+#undef INDEX_KIND
+  }
+}
+
+// values are given to predicates as int64_t for integer columns and string_view for string columns
+template <typename P>
+static inline auto onBitmap(P&& pred) {
+  return [&pred](const auto& value) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(value)>, std::string>) {
+      return pred(std::any(std::string_view(value)));
+    } else {
+      return pred(std::any(value));
+    }
+  };
+}
+
+size_t Batch::bitmapValues(const std::string& col) const {
+  auto bitmap = bitmaps_.find(col);
+  return bitmap == bitmaps_.end() ? 0 : std::visit([](const auto& index) { return index.size(); }, *bitmap->second);
+}
+
+std::vector<bool> Batch::matchBitmap(const std::string& col, const std::function<bool(const std::any&)>& pred) const {
+  return std::visit([this, &pred](const auto& index) { return index.match(onBitmap(pred), rows_); },
+                    *bitmaps_.at(col));
+}
+
+size_t Batch::countBitmap(const std::string& col, const std::function<bool(const std::any&)>& pred) const {
+  return std::visit([&pred](const auto& index) { return index.count(onBitmap(pred)); }, *bitmaps_.at(col));
+}
+
+std::shared_ptr<Histogram> Batch::zone(const std::string& col, size_t stripe) const {
+  auto zones = zones_.find(col);
+  if (zones == zones_.end() || stripe >= zones->second.size()) {
+    return nullptr;
+  }
+
+  return zones->second.at(stripe);
 }
 
 } // namespace memory
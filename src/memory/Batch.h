@@ -16,9 +16,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <string_view>
+#include <variant>
 
+#include "BitmapIndex.h"
 #include "DataNode.h"
+#include "TokenIndex.h"
 
 #include "meta/Table.h"
 #include "surface/DataSurface.h"
@@ -45,6 +49,10 @@ public: // read row from and write row to
   // add a row into current batch
   size_t add(const nebula::surface::RowData& row, nebula::meta::BessType bess = 0);
 
+  // add rows by a vector of every column in schema order, bess of every row is required if the batch is partitioned.
+  // compound columns are not supported. Return row ID of the first row added.
+  size_t add(const std::vector<ColumnVector>& columns, size_t rows, const nebula::meta::BessType* bess = nullptr);
+
   // random access to a row - may require internal seek
   std::unique_ptr<RowAccessor> makeAccessor() const;
 
@@ -61,24 +69,37 @@ public: /* implement interface of Block.h */
     return schema_->find(col);
   }
 
+  // a column not in the batch, such as one added to the table later, has no histogram
   std::shared_ptr<nebula::surface::eval::Histogram> histogram(const std::string& col) const override {
-    return fields_.at(col)->histogram();
+    auto node = fields_.find(col);
+    return node == fields_.end() ? nullptr : node->second->histogram();
   }
 
+  bool exact(const std::string&) const override;
+
   std::vector<std::any> partitionValues(const std::string& col) const override {
     // if block is not partitioned
     if (pod_ == nullptr) {
       return {};
     }
 
-#define DISPATCH_KIND(KIND)                                                                              \
-  case nebula::type::Kind::KIND: {                                                                       \
-    auto list = pod_->values<nebula::type::TypeTraits<nebula::type::Kind::KIND>::CppType>(col, spaces_); \
-    return std::vector<std::any>(list.begin(), list.end());                                              \
+// values are copied one by one since a bool list yields proxies instead of values
+#define DISPATCH_KIND(KIND)                                                 \
+  case nebula::type::Kind::KIND: {                                          \
+    using ET = nebula::type::TypeTraits<nebula::type::Kind::KIND>::CppType; \
+    std::vector<std::any> values;                                           \
+    for (ET v : pod_->values<ET>(col, spaces_)) {                           \
+      values.emplace_back(v);                                               \
+    }                                                                       \
+    return values;                                                          \
   }
 
     // if column is not partitioned column
     auto ct = schema_->find(col);
+    if (!ct) {
+      return {};
+    }
+
     switch (ct->k()) {
       DISPATCH_KIND(BOOLEAN)
       DISPATCH_KIND(TINYINT)
@@ -103,7 +124,12 @@ public: /* implement interface of Block.h */
     return probably<ET>(col, std::any_cast<ET>(v));                         \
   }
 
-    // if column is not partitioned column
+    // partition column values and default value are not recorded in bloom filter
+    auto node = fields_.find(col);
+    if (node == fields_.end() || node->second->isPartition() || node->second->hasDefault()) {
+      return true;
+    }
+
     auto ct = schema_->find(col);
     switch (ct->k()) {
       DISPATCH_KIND(BOOLEAN)
@@ -111,6 +137,14 @@ public: /* implement interface of Block.h */
       DISPATCH_KIND(SMALLINT)
       DISPATCH_KIND(INTEGER)
       DISPATCH_KIND(BIGINT)
+    case nebula::type::Kind::VARCHAR: {
+      // string value may be passed in as a view or an owned string
+      if (auto str = std::any_cast<std::string>(&v)) {
+        return probably<std::string_view>(col, *str);
+      }
+
+      return probably<std::string_view>(col, std::any_cast<std::string_view>(v));
+    }
     default:
       return true;
     }
@@ -118,6 +152,52 @@ public: /* implement interface of Block.h */
 #undef DISPATCH_KIND
   }
 
+  std::optional<nebula::surface::eval::ScalarColumn> scalar(const std::string&) const override;
+
+  std::optional<nebula::surface::eval::StringColumn> strings(const std::string&) const override;
+
+  std::optional<nebula::surface::eval::ListColumn> list(const std::string&) const override;
+
+  bool decode(const std::string&, size_t, size_t, void*) const override;
+
+  std::pair<size_t, size_t> rows(const std::string&, int64_t, int64_t) const override;
+
+  bool match(const std::string&, int64_t, int64_t, size_t, size_t, uint8_t*) const override;
+
+  void nulls(const std::string&, size_t, size_t, nebula::surface::eval::Selection&) const override;
+
+  bool valid(const std::string&, size_t, size_t, uint8_t*) const override;
+
+  inline size_t zoneRows() const override {
+    return zoneRows_;
+  }
+
+  std::shared_ptr<nebula::surface::eval::Histogram> zone(const std::string&, size_t) const override;
+
+  size_t dictSize(const std::string&) const override;
+
+  std::string_view dictItem(const std::string&, int32_t) const override;
+
+  size_t distinctValues(const std::string&) const override;
+
+  void selectCodes(const std::string&, const std::vector<bool>&, nebula::surface::eval::Selection&) const override;
+
+  bool runs(const std::string&, size_t, size_t, std::vector<nebula::surface::eval::Run>&) const override;
+
+  size_t terms(const std::string&) const override;
+
+  std::vector<bool> matchTerms(const std::string&, const std::function<bool(std::string_view)>&) const override;
+
+  size_t bitmapValues(const std::string&) const override;
+
+  std::vector<bool> matchBitmap(const std::string&, const std::function<bool(const std::any&)>&) const override;
+
+  size_t countBitmap(const std::string&, const std::function<bool(const std::any&)>&) const override;
+
+  // data node of a dictionary encoded string column whose rows can be grouped by dictionary index
+  // nullptr if the column is not dictionary encoded, partitioned or has default value
+  PDataNode dictionary(const std::string&) const;
+
 public:
   inline size_t getMemory() const {
     return data_->storageAllocation();
@@ -131,13 +211,75 @@ public:
     return data_->rawSize();
   }
 
+  // partition id of this batch in its table pod
+  inline size_t getPid() const {
+    return pid_;
+  }
+
+  // bytes released by compacting slices to their exact size at seal
+  inline size_t getReclaimed() const {
+    return reclaimed_;
+  }
+
+  // NUMA node where memory of this batch is placed, by the thread building it
+  inline size_t numa() const {
+    return numa_;
+  }
+
+  // a column not loaded is absent, all its rows read NULL.
+  // a batch restored from snapshot may load only the columns read by a query, see BlockSnapshot
+  inline bool resident(const std::string& col) const {
+    return absent_.find(col) == absent_.end();
+  }
+
+  // all columns are loaded
+  inline bool complete() const noexcept {
+    return absent_.empty();
+  }
+
+  // all given columns are loaded, empty columns stands for all columns
+  inline bool resident(const nebula::common::unordered_set<std::string>& cols) const {
+    if (complete()) {
+      return true;
+    }
+
+    if (cols.empty()) {
+      return false;
+    }
+
+    return std::all_of(cols.begin(), cols.end(), [this](const std::string& col) { return resident(col); });
+  }
+
+  // mark columns not loaded, called before seal
+  inline void setAbsent(nebula::common::unordered_set<std::string> cols) {
+    absent_ = std::move(cols);
+  }
+
   // basic metrics in JSON
   std::string state() const;
 
+  // bytes of every column by its structures, and partition values of rows
+  nebula::meta::BlockMemory memory() const;
+
+  // bytes allocated by data and partition values of this batch at the moment, cheap to check while it is built
+  inline size_t allocation() const {
+    return data_->capacity() + bess_.size();
+  }
+
   // Place seal on current batch when building
   // This helps release some necessary memory used in batch building
   void seal();
 
+  // a copy of this batch with its rows ordered by an integer column such as time, to seal in place of it.
+  // NULLs go first and rows of the same value keep their order. Sorted values are delta encoded at seal,
+  // so rows of a value range are found by binary search rather than a scan.
+  // null if rows are in order already, or they can't be copied: partitioned, compound or non integer column.
+  std::shared_ptr<Batch> sorted(const nebula::meta::Table&, const std::string&) const;
+
+  // compress column values which are not encoded, for cold data rarely scanned.
+  // compressed columns are read row by row, it is only called on a sealed batch before publishing it.
+  void compress();
+
   // a bloom filter tester
   template <typename T>
   inline bool probably(const std::string& col, const T& value) const {
@@ -168,13 +310,39 @@ private:
   // recording number of rows
   size_t rows_;
 
+  // zone map: histogram of every stripe of rows for number columns, built at seal
+  void buildZones(size_t);
+  size_t zoneRows_;
+  nebula::common::unordered_map<std::string, std::vector<std::shared_ptr<nebula::surface::eval::Histogram>>> zones_;
+
+  // bloom filters of columns configured with bloom filter, built at seal
+  void buildBlooms();
+
+  // token index of every string column configured with tokens, built at seal
+  void buildTokens();
+  nebula::common::unordered_map<std::string, std::unique_ptr<TokenIndex>> tokens_;
+
+  // bitmap index of every integer or string column configured with bitmap, built at seal
+  using Bitmap = std::variant<BitmapIndex<int64_t>, BitmapIndex<std::string>>;
+  void buildBitmaps();
+  nebula::common::unordered_map<std::string, std::unique_ptr<Bitmap>> bitmaps_;
+
   // A row accessor cursor to read data of given row
   friend class RowAccessor;
 
   // fast lookup from column name to column index
+  // element column of an array column is registered as well, see list()
   DnMap fields_;
 
+  // data node of each column in schema order
+  std::vector<PDataNode> nodes_;
+
+  // columns not loaded
+  nebula::common::unordered_set<std::string> absent_;
+
+  size_t reclaimed_;
   bool sealed_;
+  size_t numa_;
 };
 
 using BatchPtr = std::shared_ptr<Batch>;
@@ -195,6 +363,19 @@ public:
   std::optional<double> readDouble(const std::string& field) const override;
   std::optional<int128_t> readInt128(const std::string& field) const override;
   std::optional<std::string_view> readString(const std::string& field) const override;
+  std::unique_ptr<nebula::surface::ListData> readList(const std::string& field) const override;
+
+  // index based reads, index is position of the column in batch schema
+  std::optional<IndexType> index(const std::string& field) const override;
+  std::optional<bool> readBool(IndexType) const override;
+  std::optional<int8_t> readByte(IndexType) const override;
+  std::optional<int16_t> readShort(IndexType) const override;
+  std::optional<int32_t> readInt(IndexType) const override;
+  std::optional<int64_t> readLong(IndexType) const override;
+  std::optional<float> readFloat(IndexType) const override;
+  std::optional<double> readDouble(IndexType) const override;
+  std::optional<int128_t> readInt128(IndexType) const override;
+  std::optional<std::string_view> readString(IndexType) const override;
 
 public:
   RowAccessor& seek(size_t);
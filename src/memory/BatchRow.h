@@ -0,0 +1,107 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Batch.h"
+
+/**
+ * Row data over rows of a batch, used to copy rows of sealed batches into a new one.
+ */
+namespace nebula {
+namespace memory {
+
+// read a row of a batch as row data to add it into another batch, flat schema only
+class BatchRow : public nebula::surface::RowData {
+public:
+  explicit BatchRow(const Batch& batch) : accessor_{ batch.makeAccessor() } {
+    const auto& schema = batch.schema();
+    for (size_t i = 0, size = schema->size(); i < size; ++i) {
+      const auto type = schema->childType(i);
+      kinds_.emplace(type->name(), type->k());
+    }
+  }
+  virtual ~BatchRow() = default;
+
+  // a batch of given schema can be read by rows if it has no compound column
+  static bool supports(const nebula::type::Schema& schema) {
+    for (size_t i = 0, size = schema->size(); i < size; ++i) {
+      if (nebula::type::TypeBase::isCompound(schema->childType(i)->k())) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  inline const BatchRow& seek(size_t row) {
+    accessor_->seek(row);
+    return *this;
+  }
+
+  bool isNull(const std::string& field) const override {
+#define NULL_CASE(K, F) \
+  case nebula::type::Kind::K: return !accessor_->F(field).has_value();
+
+    switch (kinds_.at(field)) {
+      NULL_CASE(BOOLEAN, readBool)
+      NULL_CASE(TINYINT, readByte)
+      NULL_CASE(SMALLINT, readShort)
+      NULL_CASE(INTEGER, readInt)
+      NULL_CASE(BIGINT, readLong)
+      NULL_CASE(REAL, readFloat)
+      NULL_CASE(DOUBLE, readDouble)
+      NULL_CASE(INT128, readInt128)
+      NULL_CASE(VARCHAR, readString)
+    default:
+      throw NException(fmt::format("Compound column not supported: {0}", field));
+    }
+
+#undef NULL_CASE
+  }
+
+#define READ_FIELD(TYPE, FUNC)                         \
+  TYPE FUNC(const std::string& field) const override { \
+    return accessor_->FUNC(field).value_or(TYPE{});    \
+  }
+
+  READ_FIELD(bool, readBool)
+  READ_FIELD(int8_t, readByte)
+  READ_FIELD(int16_t, readShort)
+  READ_FIELD(int32_t, readInt)
+  READ_FIELD(int64_t, readLong)
+  READ_FIELD(float, readFloat)
+  READ_FIELD(double, readDouble)
+  READ_FIELD(int128_t, readInt128)
+  READ_FIELD(std::string_view, readString)
+
+#undef READ_FIELD
+
+  std::unique_ptr<nebula::surface::ListData> readList(const std::string&) const override {
+    throw NException("Compound column not supported");
+  }
+
+  std::unique_ptr<nebula::surface::MapData> readMap(const std::string&) const override {
+    throw NException("Compound column not supported");
+  }
+
+private:
+  std::unique_ptr<RowAccessor> accessor_;
+  nebula::common::unordered_map<std::string, nebula::type::Kind> kinds_;
+};
+
+} // namespace memory
+} // namespace nebula
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <limits>
+#include <roaring.hh>
+#include <string>
+#include <vector>
+
+#include "common/Hash.h"
+
+/**
+ * Bitmap index of a column in a block: every distinct value maps to a roaring bitmap of the rows having it.
+ * It is built at seal, a predicate on values (EQ, IN) runs once per distinct value rather than once per row,
+ * and rows having matched values are counted by cardinality of their bitmaps without reading the column.
+ * An index growing over its limit of distinct values is dropped, its bitmaps would cost more than they save.
+ */
+namespace nebula {
+namespace memory {
+
+template <typename K>
+class BitmapIndex {
+public:
+  explicit BitmapIndex(size_t limit = std::numeric_limits<size_t>::max()) : limit_{ limit }, bytes_{ 0 } {}
+  virtual ~BitmapIndex() = default;
+
+  // index value of given row, a dropped index takes nothing
+  template <typename V>
+  inline void add(size_t row, const V& value) {
+    if (limit_ == 0) {
+      return;
+    }
+
+    building_[K(value)].add(row);
+    if (building_.size() > limit_) {
+      limit_ = 0;
+      building_ = decltype(building_)();
+    }
+  }
+
+  // move values into compact lists once all rows are added
+  void seal() {
+    values_.reserve(building_.size());
+    rows_.reserve(building_.size());
+    for (auto& item : building_) {
+      values_.push_back(item.first);
+      rows_.push_back(std::move(item.second));
+      auto& rows = rows_.back();
+      rows.runOptimize();
+      rows.shrinkToFit();
+      bytes_ += sizeof(K) + rows.getSizeInBytes();
+      if constexpr (std::is_same_v<K, std::string>) {
+        bytes_ += item.first.size();
+      }
+    }
+
+    building_ = decltype(building_)();
+  }
+
+  // number of distinct values, 0 if the index is dropped
+  inline size_t size() const noexcept {
+    return values_.size();
+  }
+
+  // flag of every row having a value matched by the predicate, out of given number of rows
+  template <typename P>
+  std::vector<bool> match(P&& pred, size_t rows) const {
+    std::vector<bool> flags(rows, false);
+    for (size_t i = 0, size = values_.size(); i < size; ++i) {
+      if (pred(values_[i])) {
+        for (auto row : rows_[i]) {
+          flags[row] = true;
+        }
+      }
+    }
+
+    return flags;
+  }
+
+  // number of rows having a value matched by the predicate
+  template <typename P>
+  size_t count(P&& pred) const {
+    size_t count = 0;
+    for (size_t i = 0, size = values_.size(); i < size; ++i) {
+      if (pred(values_[i])) {
+        count += rows_[i].cardinality();
+      }
+    }
+
+    return count;
+  }
+
+  inline size_t bytes() const noexcept {
+    return bytes_;
+  }
+
+private:
+  size_t limit_;
+  nebula::common::unordered_map<K, roaring::Roaring> building_;
+  std::vector<K> values_;
+  std::vector<roaring::Roaring> rows_;
+  size_t bytes_;
+};
+
+} // namespace memory
+} // namespace nebula
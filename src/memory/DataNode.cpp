@@ -50,7 +50,20 @@ DataTree DataNode::buildDataTree(const Table& table, size_t capacity) {
     {},
     [&table, capacity](const auto& v, const std::vector<TreeNode>& children) {
       const auto& t = dynamic_cast<const TypeBase&>(v);
-      return TreeNode(new DataNode(t, table.column(t.name()), capacity, children));
+      const auto& column = table.column(t.name());
+      if (t.name() == Table::TIME_COLUMN && !column.sorted) {
+        auto time = column;
+        time.sorted = true;
+        return TreeNode(new DataNode(t, time, capacity, children));
+      }
+
+      // a partition column keeps its values in bess
+      if (column.sharedDict && t.k() == Kind::VARCHAR && !column.partition.valid()) {
+        auto dict = nebula::memory::encode::SharedDict::of(table.name(), t.name());
+        return TreeNode(new DataNode(t, column, capacity, children, std::move(dict)));
+      }
+
+      return TreeNode(new DataNode(t, column, capacity, children));
     });
 
   return std::static_pointer_cast<DataNode>(dataTree);
@@ -123,15 +136,16 @@ size_t DataNode::append(std::string_view str) {
   meta_->histogram(str);
 
   if (meta_->hasDict()) {
-    auto dictIdx = meta_->dictItem(str);
+    // value is stored in dictionary rather than data, dictionary items are recorded in bloom filter at seal
+    bool added = false;
+    auto dictIdx = meta_->dictItem(str, added);
     meta_->setOffsetSize(index, dictIdx);
     INCREMENT_RAW_SIZE_AND_RETURN()
   }
 
-  // this new value will be appended at the data chunk
-  // and we record its offset and size
+  // this new value is stored by its head in data, offset and size are kept in the head
   data_->add(index, str);
-  meta_->setOffsetSize(index, size);
+  meta_->distinct(str);
   INCREMENT_RAW_SIZE_AND_RETURN()
 }
 
@@ -272,17 +286,124 @@ size_t DataNode::append(const nebula::surface::RowData& row) {
 
 #undef DISPATCH_KIND
 
+template <typename T>
+size_t DataNode::append(const T* values, const ColumnVector& column, size_t rows) {
+  size_t size = 0;
+  for (size_t i = 0; i < rows; ++i) {
+    if (column.isNull(i)) {
+      size += appendNull();
+      continue;
+    }
+
+    size += append(values[i]);
+  }
+
+  return size;
+}
+
+size_t DataNode::appendCodes(const ColumnVector& column, size_t rows) {
+  N_ENSURE(type_.k() == nebula::type::StringType::kind, "string type expected");
+  const auto codes = static_cast<const int32_t*>(column.values);
+  size_t size = 0;
+
+  // without dictionary in this node, every item is stored as a normal string
+  if (!meta_->hasDict()) {
+    for (size_t i = 0; i < rows; ++i) {
+      size += column.isNull(i) ? appendNull() : append(column.dict[codes[i]]);
+    }
+
+    return size;
+  }
+
+  // source code => code in dictionary of this node, looked up at its first occurrence
+  std::vector<int32_t> mapping(column.items, -1);
+  for (size_t i = 0; i < rows; ++i) {
+    if (column.isNull(i)) {
+      size += appendNull();
+      continue;
+    }
+
+    const auto code = codes[i];
+    const auto str = column.dict[code];
+    auto& mapped = mapping[code];
+    if (mapped < 0) {
+      bool added = false;
+      mapped = meta_->dictItem(str, added);
+    }
+
+    meta_->histogram(str);
+    meta_->setOffsetSize(cursorAndAdvance(), mapped);
+    size += str.size();
+  }
+
+  INCREMENT_RAW_SIZE_AND_RETURN()
+}
+
+// same as row append, partition column saves nulls only, its values are kept in bess
+#define DISPATCH_KIND(KIND)                                                          \
+  case Kind::KIND: {                                                                 \
+    using T = nebula::type::TypeTraits<Kind::KIND>::CppType;                         \
+    if (!child->meta_->isPartition()) {                                              \
+      size += column.dict != nullptr                                                 \
+                ? child->appendCodes(column, rows)                                   \
+                : child->append(static_cast<const T*>(column.values), column, rows); \
+      break;                                                                         \
+    }                                                                                \
+                                                                                     \
+    for (size_t r = 0; r < rows; ++r) {                                              \
+      if (column.isNull(r)) {                                                        \
+        size += child->appendNull();                                                 \
+      }                                                                              \
+    }                                                                                \
+    break;                                                                           \
+  }
+
+size_t DataNode::append(const std::vector<ColumnVector>& columns, size_t rows) {
+  N_ENSURE(type_.k() == Kind::STRUCT, "struct type expected");
+  N_ENSURE_EQ(columns.size(), this->size(), "a column vector for every child is expected");
+
+  // column by column, every value is read from its vector directly
+  size_t size = 0;
+  for (size_t i = 0, count = this->size(); i < count; ++i) {
+    const auto& child = this->childAt<PDataNode>(i).value();
+    const auto& column = columns.at(i);
+    const auto kind = child->type_.k();
+    switch (kind) {
+      DISPATCH_KIND(BOOLEAN)
+      DISPATCH_KIND(TINYINT)
+      DISPATCH_KIND(SMALLINT)
+      DISPATCH_KIND(INTEGER)
+      DISPATCH_KIND(BIGINT)
+      DISPATCH_KIND(REAL)
+      DISPATCH_KIND(DOUBLE)
+      DISPATCH_KIND(INT128)
+      DISPATCH_KIND(VARCHAR)
+    default:
+      throw NException(fmt::format("Not supported type in column vector: {0}", child->type_.name()));
+    }
+  }
+
+  // histogram recording of every row
+  for (size_t r = 0; r < rows; ++r) {
+    meta_->histogram(nullptr);
+  }
+
+  INCREMENT_RAW_SIZE_AND_RETURN()
+}
+
+#undef DISPATCH_KIND
+
 #undef INCREMENT_RAW_SIZE_AND_RETURN
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define TYPE_READ_DELEGATE(TYPE)              \
-  template <>                                 \
-  TYPE DataNode::read(size_t index) {         \
+#define TYPE_READ_DELEGATE(TYPE)                \
+  template <>                                   \
+  TYPE DataNode::read(size_t index) {           \
     if (N_UNLIKELY(meta_->isRealNull(index))) { \
-      return data_->defaultValue<TYPE>();     \
-    }                                         \
-    return data_->read<TYPE>(index);          \
+      return data_->defaultValue<TYPE>();       \
+    }                                           \
+    return data_->read<TYPE>(index);            \
   }
 
 TYPE_READ_DELEGATE(bool)
@@ -308,8 +429,7 @@ std::string_view DataNode::read(size_t index) {
     return meta_->dictItem(os.second);
   }
 
-  auto os = meta_->offsetSize(index);
-  return data_->read(os.first, os.second);
+  return data_->read<std::string_view>(index);
 }
 
 #undef TYPE_READ_DELEGATE
@@ -43,6 +43,21 @@ using DataTree = std::shared_ptr<DataNode>;
 using TDataNode = DataNode;
 using PDataNode = DataNode*;
 
+// values of a column for a number of rows, to append rows into a batch column by column.
+// values points to an array of native type of the column (std::string_view for VARCHAR),
+// valid is a bitmap of non-null rows (bit i % 8 of byte i / 8 for row i), nullptr if no row is null.
+// strings can be dictionary coded instead, then values points to int32 codes of items in dict.
+struct ColumnVector {
+  const void* values;
+  const uint8_t* valid;
+  const std::string_view* dict = nullptr;
+  size_t items = 0;
+
+  inline bool isNull(size_t row) const {
+    return valid != nullptr && !(valid[row >> 3] & (1 << (row & 7)));
+  }
+};
+
 class DataNode : public nebula::type::Tree<PDataNode> {
 public:
   static DataTree buildDataTree(const nebula::meta::Table&, size_t capacity);
@@ -53,13 +68,15 @@ public:
     LOG(INFO) << fmt::format("Create data node w/o children [{0}].", type.name());
   }
 
+  // a string column encoded by a dictionary shared by the table is given the dictionary
   DataNode(const nebula::type::TypeBase& type,
            const nebula::meta::Column& column,
            size_t capacity,
-           const std::vector<nebula::type::TreeNode>& children)
+           const std::vector<nebula::type::TreeNode>& children,
+           std::shared_ptr<nebula::memory::encode::SharedDict> dict = nullptr)
     : nebula::type::Tree<DataNode*>(this, children),
       type_{ type },
-      meta_{ nebula::memory::serde::TypeDataFactory::createMeta(type.k(), column) },
+      meta_{ nebula::memory::serde::TypeDataFactory::createMeta(type.k(), column, std::move(dict)) },
       data_{ nebula::memory::serde::TypeDataFactory::createData(type.k(), column, capacity) },
       count_{ 0 },
       rawSize_{ 0 },
@@ -79,6 +96,16 @@ public: // data appending API
   template <typename T>
   size_t append(T v);
 
+  // append values of given number of rows, null rows are those not valid
+  template <typename T>
+  size_t append(const T* values, const ColumnVector& column, size_t rows);
+
+  // append dictionary coded strings, every distinct item of the source dictionary is looked up only once
+  size_t appendCodes(const ColumnVector& column, size_t rows);
+
+  // append rows of a struct by a vector of each child node, no row or value is read through RowData
+  size_t append(const std::vector<ColumnVector>& columns, size_t rows);
+
 public: // data reading API
   // use std::optional to simplify the interface
   // instead of
@@ -110,6 +137,94 @@ public: // data reading API
     return meta_->histogram();
   }
 
+  // raw data of scalar values, value of row i is at (i * width)
+  // nullptr if values are encoded, read them by decode instead, or compressed, read them row by row
+  inline const NByte* raw() const {
+    return data_ ? data_->raw() : nullptr;
+  }
+
+  inline bool encoded() const {
+    return data_ && data_->encoded();
+  }
+
+  // rows [first, last) out of which no value is in range [low, high], searched on encoded values
+  inline std::optional<std::pair<size_t, size_t>> rows(int64_t low, int64_t high) const {
+    return data_ ? data_->rows(low, high) : std::nullopt;
+  }
+
+  // evaluate low <= value <= high for rows [start, start + count) into mask, return false if values are not bit packed
+  inline bool match(int64_t low, int64_t high, size_t start, size_t count, uint8_t* mask) const {
+    return data_ && data_->match(low, high, start, count, mask);
+  }
+
+  // decode values of rows [start, start + count) into given buffer, return false if values are not encoded
+  template <typename T>
+  inline bool decode(size_t start, size_t count, T* out) const {
+    return data_ && data_->decode<T>(start, count, out);
+  }
+
+  inline bool hasNulls() const {
+    return meta_->hasNulls();
+  }
+
+  inline bool hasDefault() const {
+    return meta_->hasDefault();
+  }
+
+  inline bool isPartition() const {
+    return meta_->isPartition();
+  }
+
+  template <typename T>
+  inline T defaultValue() const {
+    return data_->defaultValue<T>();
+  }
+
+  // dictionary encoded string column: every value is stored as an index into the dictionary
+  inline bool hasDict() const {
+    return meta_->hasDict();
+  }
+
+  // dictionary index of given row, only valid for non-null rows
+  inline int32_t dictCode(size_t index) const {
+    return meta_->offsetSize(index).second;
+  }
+
+  inline std::string_view dictItem(int32_t code) {
+    return meta_->dictItem(code);
+  }
+
+  // string heads of all rows of a string column not dictionary encoded, nullptr otherwise
+  inline const nebula::common::StringHead* heads() const {
+    return data_ && !meta_->hasDict() ? data_->heads() : nullptr;
+  }
+
+  // string not inlined in its head
+  inline std::string_view heap(const nebula::common::StringHead& head) const {
+    return data_->read(head.offset(), head.size);
+  }
+
+  // number of distinct values in the dictionary
+  inline size_t dictSize() const {
+    return meta_->dictSize();
+  }
+
+  // number of distinct values of a sealed node, 0 if unknown
+  inline size_t distinctValues() const {
+    return meta_->distinctValues();
+  }
+
+  // iterate null rows in range [start, end)
+  template <typename F>
+  inline void nulls(size_t start, size_t end, F&& f) const {
+    meta_->nulls(start, end, std::forward<F>(f));
+  }
+
+  // mask non-null rows in [start, start + count) as 1, false if NULLs are not in a dense bitmap
+  inline bool valid(size_t start, size_t count, uint8_t* mask) const {
+    return meta_->valid(start, count, mask);
+  }
+
 public: // basic metadata exposure
   inline size_t entries() const {
     return count_;
@@ -129,40 +244,137 @@ public: // basic metadata exposure
     return storage_;
   }
 
+  // bytes allocated by this node and its children at the moment, storage allocation is only rolled up at seal
+  inline size_t capacity() const {
+    size_t alloc = meta_->capacity();
+    for (size_t i = 0, count = TreeBase::size(); i < count; ++i) {
+      alloc += this->childAt(i).value()->capacity();
+    }
+
+    return data_ ? alloc + data_->capacity() : alloc;
+  }
+
+  // add bytes of this node and its children by their structures to given column memory
+  inline void memory(nebula::meta::ColumnMemory& memory) const {
+    meta_->memory(memory);
+    for (size_t i = 0, count = TreeBase::size(); i < count; ++i) {
+      this->childAt(i).value()->memory(memory);
+    }
+
+    if (data_) {
+      data_->memory(memory);
+    }
+  }
+
   // list/map retrieve child's offset and length at some position
   inline std::pair<IndexType, IndexType> offsetSize(IndexType index) {
     return meta_->offsetSize(index);
   }
 
+  // list offsets of all rows, elements of row i are [offsets[i], offsets[i + 1]) of child for rows before spans()
+  inline const IndexType* offsets() const {
+    return meta_->offsets();
+  }
+
+  inline size_t spans() const {
+    return meta_->spans();
+  }
+
+  inline nebula::type::Kind kind() const {
+    return type_.k();
+  }
+
   inline void seal() {
-    meta_->seal();
+    meta_->seal(count_);
+    for (size_t i = 0, count = TreeBase::size(); i < count; ++i) {
+      this->childAt(i).value()->seal();
+    }
+
+    if (data_) {
+      data_->seal();
+    }
+
+    rollup();
+  }
+
+  // build bloom filters of this node and its children after seal, sized by their distinct values.
+  // strings in dictionary are recorded by dictionary items, partition values are known by their pod.
+  inline void buildBloom(double fpp) {
+    for (size_t i = 0, count = TreeBase::size(); i < count; ++i) {
+      this->childAt(i).value()->buildBloom(fpp);
+    }
+
+    if (!data_ || !data_->hasBloomFilter() || meta_->isPartition()) {
+      return;
+    }
+
+    const auto distinct = meta_->distinctValues();
+    data_->buildBloom(distinct > 0 ? distinct : count_, fpp);
+    if (meta_->hasDict()) {
+      meta_->dictItems([this](std::string_view item) { data_->bloom(item); });
+    }
+  }
 
-    // rollup the storage size and storage allocation
+  // switch strings of this node and its children to dictionary if distinct values are within given ratio of values
+  // it happens right before seal while the data is still writable
+  inline void dictEncode(double ratio) {
+    for (size_t i = 0, count = TreeBase::size(); i < count; ++i) {
+      this->childAt(i).value()->dictEncode(ratio);
+    }
+
+    if (data_ && meta_->dictEncode(ratio, count_, [this](IndexType index) {
+          return data_->read<std::string_view>(index);
+        })) {
+      data_->clear();
+    }
+  }
+
+  // encode sealed data of this node and its children if encoded size is within given ratio of raw size
+  inline void encode(double ratio) {
+    for (size_t i = 0, count = TreeBase::size(); i < count; ++i) {
+      this->childAt(i).value()->encode(ratio);
+    }
+
+    if (data_) {
+      data_->encode(ratio);
+    }
+
+    rollup();
+  }
+
+  // compress sealed data of this node and its children into pages of given size
+  inline void compress(size_t page) {
+    for (size_t i = 0, count = TreeBase::size(); i < count; ++i) {
+      this->childAt(i).value()->compress(page);
+    }
+
+    if (data_) {
+      data_->compress(page);
+    }
+
+    rollup();
+  }
+
+private:
+  // rollup the storage size and storage allocation of children and my own data
+  inline void rollup() {
     size_t alloc = 0;
     size_t size = 0;
     for (size_t i = 0, count = TreeBase::size(); i < count; ++i) {
-      // seal this child
       auto child = this->childAt(i).value();
-      child->seal();
-
-      // accumulate its size and allocation into current
       size += child->storageSize();
       alloc += child->storageAllocation();
     }
 
-    // accumulate my metrics
     if (data_) {
-      data_->seal();
       size += data_->size();
       alloc += data_->capacity();
     }
 
-    // update my own size_ and storage_
     size_ = size;
-    storage_ = alloc;
+    storage_ = alloc + meta_->capacity();
   }
 
-private:
   // called for every single value added in current node
   inline size_t cursorAndAdvance() {
     return count_++;
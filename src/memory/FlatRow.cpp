@@ -26,18 +26,17 @@ bool FlatRow::isNull(const std::string& field) const {
   // Note: this is a convinient method but is it performant?
   // we're adding this check for all isNull calls,
   // the advantage is we don't need to ensure all fields are present by purpose.
-  if (nullIfMissing_ && meta_.find(field) == meta_.end()) {
+  if (nullIfMissing_ && !hasKey(field)) {
     return true;
   }
 
-  auto offset = meta_.at(field);
   // it is null if value at current offset is 0
-  return slice_.read<int8_t>(offset) == 0;
+  return slice_.read<int8_t>(offset(field)) == 0;
 }
 
 #define READ_SCALAR(RT, NAME)                        \
   RT FlatRow::NAME(const std::string& field) const { \
-    auto offset = meta_.at(field);                   \
+    auto offset = this->offset(field);               \
     return slice_.read<RT>(offset + 1);              \
   }
 
@@ -53,14 +52,14 @@ READ_SCALAR(int128_t, readInt128)
 #undef READ_SCALAR
 
 std::string_view FlatRow::readString(const std::string& field) const {
-  auto offset = meta_.at(field);
+  auto offset = this->offset(field);
 
   // type check: we can check first byte is string flag
   return slice_.read(offset + 5, slice_.read<int32_t>(offset + 1));
 }
 
 std::unique_ptr<ListData> FlatRow::readList(const std::string& field) const {
-  auto offset = meta_.at(field);
+  auto offset = this->offset(field);
   auto header = slice_.read<int16_t>(offset);
   auto size = slice_.read<int32_t>(offset + 2);
 
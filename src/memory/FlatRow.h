@@ -32,7 +32,8 @@
  * Supporting null value indicator in the storage. 
  * 
  * Reset will reset the writing cursor to beginning and wipe out all meta data.
- * Metadata is <key, offset>
+ * Metadata is <key, offset, row>, keys are kept across rows and only the current row's offsets are valid,
+ * so a reused row doesn't allocate once it has seen all keys.
  * 
  * Every value has size prefix, 1byte flag indicating if its null or not
  * Compound types are struct, map and list
@@ -74,13 +75,13 @@ public:
   static constexpr int16_t LIST_FLAG = 99 << 8;
 
   FlatRow(size_t initSliceSize, bool nullIfMissing = false)
-    : slice_{ initSliceSize }, nullIfMissing_{ nullIfMissing }, cursor_{ 0 } {}
+    : slice_{ initSliceSize }, nullIfMissing_{ nullIfMissing }, cursor_{ 0 }, row_{ 1 } {}
   virtual ~FlatRow() = default;
 
   // initialize states for writing a new row
   void reset() {
     cursor_ = 0;
-    meta_.clear();
+    ++row_;
   }
 
   void writeNull(const std::string& key) {
@@ -181,7 +182,8 @@ public:
   }
 
   inline bool hasKey(const std::string& key) const noexcept {
-    return meta_.find(key) != meta_.end();
+    auto found = meta_.find(key);
+    return found != meta_.end() && found->second.row == row_;
   }
 
 public:
@@ -204,11 +206,24 @@ public:
 #undef INTERFACE_IMPL
 
 private:
+  // offset of the value of given key in current row
+  inline size_t offset(const std::string& key) const {
+    auto found = meta_.find(key);
+    if (N_UNLIKELY(found == meta_.end() || found->second.row != row_)) {
+      throw NException(fmt::format("key not found in flat row: {0}", key));
+    }
+
+    return found->second.offset;
+  }
+
   inline size_t moveKey(const std::string& key, size_t size) {
-    N_ENSURE(meta_.find(key) == meta_.end(), "do not overwrite key");
+    // a key is inserted only the first time it is seen
+    auto& slot = meta_[key];
+    N_ENSURE(slot.row != row_, "do not overwrite key");
     // record key offset
     auto current = cursor_;
-    meta_[key] = current;
+    slot.offset = current;
+    slot.row = row_;
 
     // move cursor
     cursor_ = current + size;
@@ -222,8 +237,14 @@ private:
   bool nullIfMissing_;
 
   // write states
+  struct Slot {
+    size_t offset = 0;
+    size_t row = 0;
+  };
   size_t cursor_;
-  nebula::common::unordered_map<std::string, size_t> meta_;
+  // current row sequence, a slot belongs to current row if it has the same sequence
+  size_t row_;
+  nebula::common::unordered_map<std::string, Slot> meta_;
 };
 
 class FlatList : public nebula::surface::ListData {
@@ -7,8 +7,11 @@ add_library(${NEBULA_MEMORY} STATIC
     ${NEBULA_SRC}/memory/DataNode.cpp
     ${NEBULA_SRC}/memory/Batch.cpp
     ${NEBULA_SRC}/memory/Accessor.cpp
+    ${NEBULA_SRC}/memory/ArrowBatch.cpp
+    ${NEBULA_SRC}/memory/Synthetic.cpp
     ${NEBULA_SRC}/memory/encode/RleEncoder.cpp
     ${NEBULA_SRC}/memory/encode/RleDecoder.cpp
+    ${NEBULA_SRC}/memory/encode/SharedDict.cpp
     ${NEBULA_SRC}/memory/keyed/FlatBuffer.cpp
     ${NEBULA_SRC}/memory/keyed/HashFlat.cpp
     ${NEBULA_SRC}/memory/serde/TypeData.cpp
@@ -22,7 +25,8 @@ target_link_libraries(${NEBULA_MEMORY}
     PUBLIC ${FOLLY_LIBRARY}
     PUBLIC ${ROARING_LIBRARY}
     PUBLIC ${JSON_LIBRARY}
-    PUBLIC ${QJS_LIBRARY})
+    PUBLIC ${QJS_LIBRARY}
+    PUBLIC ${ARROW_LIBRARY})
 
 # build test binary
 add_executable(MemoryTests 
@@ -0,0 +1,474 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Synthetic.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <fmt/format.h>
+#include <mutex>
+#include <thread>
+
+#include "DataNode.h"
+#include "common/Errors.h"
+#include "type/Type.h"
+
+/**
+ * Generate synthetic rows into batches.
+ */
+namespace nebula {
+namespace memory {
+
+using nebula::meta::BessType;
+using nebula::meta::Table;
+using nebula::surface::ListData;
+using nebula::surface::MapData;
+using nebula::type::Kind;
+using nebula::type::TypeBase;
+
+struct Synthetic::Column {
+  std::string name;
+  Kind kind;
+  ColumnGen gen;
+  uint64_t salt;
+
+  // the time column or a compound column which is always null
+  bool time;
+  bool compound;
+
+  // cumulative probability of every value of a zipf column
+  std::vector<double> cdf;
+
+  // dictionary of a string column, or partition values of a partition column
+  std::vector<std::string> values;
+  std::vector<std::string_view> dict;
+  std::vector<double> numbers;
+};
+
+// values of every column for some rows, a column is one vector, strings not coded are views of chunk strings
+struct Synthetic::Chunk {
+  struct Data {
+    std::vector<uint8_t> valid;
+    std::vector<size_t> keys;
+
+    // 16 bytes aligned storage of native values
+    std::vector<int128_t> values;
+    std::vector<std::string> strings;
+    std::vector<std::string_view> views;
+  };
+
+  size_t size;
+  std::vector<int64_t> times;
+  std::vector<Data> data;
+  std::vector<ColumnVector> vectors;
+};
+
+// a row of a chunk for partitioned tables and compound columns added row by row
+class Synthetic::ChunkRow : public nebula::surface::RowData {
+public:
+  ChunkRow(const Synthetic& synthetic, const Chunk& chunk) : synthetic_{ synthetic }, chunk_{ chunk }, row_{ 0 } {}
+  virtual ~ChunkRow() = default;
+
+  inline void seek(size_t row) noexcept {
+    row_ = row;
+  }
+
+  bool isNull(const std::string& field) const override {
+    const auto i = synthetic_.index_.at(field);
+    return synthetic_.columns_[i].compound || chunk_.vectors[i].isNull(row_);
+  }
+
+#define READ_FIELD(TYPE, FUNC)                                                                 \
+  TYPE FUNC(const std::string& field) const override {                                         \
+    return static_cast<const TYPE*>(chunk_.vectors[synthetic_.index_.at(field)].values)[row_]; \
+  }
+
+  READ_FIELD(bool, readBool)
+  READ_FIELD(int8_t, readByte)
+  READ_FIELD(int16_t, readShort)
+  READ_FIELD(int32_t, readInt)
+  READ_FIELD(int64_t, readLong)
+  READ_FIELD(float, readFloat)
+  READ_FIELD(double, readDouble)
+  READ_FIELD(int128_t, readInt128)
+
+#undef READ_FIELD
+
+  std::string_view readString(const std::string& field) const override {
+    const auto& v = chunk_.vectors[synthetic_.index_.at(field)];
+    if (v.dict != nullptr) {
+      return v.dict[static_cast<const int32_t*>(v.values)[row_]];
+    }
+
+    return static_cast<const std::string_view*>(v.values)[row_];
+  }
+
+  std::unique_ptr<ListData> readList(const std::string&) const override {
+    return nullptr;
+  }
+
+  std::unique_ptr<MapData> readMap(const std::string&) const override {
+    return nullptr;
+  }
+
+private:
+  const Synthetic& synthetic_;
+  const Chunk& chunk_;
+  size_t row_;
+};
+
+// counter based random bits of (seed, row, salt), splitmix64 finalizer
+static inline uint64_t draw(uint64_t seed, uint64_t row, uint64_t salt) noexcept {
+  uint64_t x = seed * 0x9e3779b97f4a7c15ULL ^ salt ^ (row * 0xd1b54a32d192ed03ULL);
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// uniform in [0, 1) by top 53 bits
+static inline double unit(uint64_t bits) noexcept {
+  return (bits >> 11) * 0x1.0p-53;
+}
+
+Synthetic::Synthetic(const Table& table,
+                     std::pair<size_t, size_t> window,
+                     const ColumnGens& gens,
+                     const ColumnGen& def)
+  : table_{ table }, window_{ window }, columnar_{ table.pod() == nullptr } {
+  N_ENSURE_LE(window.first, window.second, "window of synthetic rows starts before it ends");
+  const auto schema = table.schema();
+  const auto size = schema->size();
+  columns_.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    const auto type = schema->childType(i);
+    Column c;
+    c.name = type->name();
+    c.kind = type->k();
+    auto found = gens.find(c.name);
+    c.gen = found == gens.end() ? def : found->second;
+    c.salt = std::hash<std::string>()(c.name);
+    c.time = c.name == Table::TIME_COLUMN;
+    c.compound = TypeBase::isCompound(c.kind);
+    if (c.compound) {
+      columnar_ = false;
+    }
+
+    // a partition column takes its partition values, it is never null
+    const auto& partition = table.column(c.name).partition;
+    if (partition.valid()) {
+      c.values = partition.values;
+      c.gen.cardinality = c.values.size();
+      c.gen.nulls = 0;
+      if (c.kind != Kind::VARCHAR) {
+        for (const auto& v : c.values) {
+          c.numbers.push_back(v == "true" ? 1 : (v == "false" ? 0 : std::stod(v)));
+        }
+      }
+    }
+
+    N_ENSURE_GT(c.gen.cardinality, 0, "cardinality of a synthetic column");
+    if (c.gen.distribution == Distribution::ZIPF) {
+      const auto items = std::min(c.gen.cardinality, MAX_DICT);
+      c.cdf.reserve(items);
+      double sum = 0;
+      for (size_t k = 0; k < items; ++k) {
+        sum += 1 / std::pow(k + 1, c.gen.skew);
+        c.cdf.push_back(sum);
+      }
+
+      for (auto& p : c.cdf) {
+        p /= sum;
+      }
+    }
+
+    if (c.kind == Kind::VARCHAR) {
+      if (c.values.empty() && c.gen.cardinality <= MAX_DICT) {
+        c.values.reserve(c.gen.cardinality);
+        for (size_t k = 0; k < c.gen.cardinality; ++k) {
+          c.values.push_back(fmt::format("{0}-{1}", c.name, k));
+        }
+      }
+
+      c.dict.assign(c.values.begin(), c.values.end());
+    }
+
+    index_[c.name] = i;
+    columns_.push_back(std::move(c));
+  }
+}
+
+Synthetic::~Synthetic() = default;
+
+ColumnGens Synthetic::parse(const std::string& text) {
+  ColumnGens gens;
+  auto split = [](const std::string& str, char delimiter) {
+    std::vector<std::string> items;
+    size_t begin = 0;
+    for (auto end = str.find(delimiter); end != std::string::npos; end = str.find(delimiter, begin)) {
+      items.push_back(str.substr(begin, end - begin));
+      begin = end + 1;
+    }
+
+    items.push_back(str.substr(begin));
+    return items;
+  };
+
+  for (const auto& column : split(text, ',')) {
+    if (column.empty()) {
+      continue;
+    }
+
+    const auto parts = split(column, ':');
+    N_ENSURE_GT(parts.size(), 1, "synthetic column requires a distribution: column:distribution");
+    ColumnGen gen;
+    const auto& name = parts.at(1);
+    if (name == "uniform") {
+      gen.distribution = Distribution::UNIFORM;
+    } else if (name == "zipf") {
+      gen.distribution = Distribution::ZIPF;
+    } else if (name == "time") {
+      gen.distribution = Distribution::TIME;
+    } else {
+      throw NException(fmt::format("Unknown distribution of synthetic column: {0}", column));
+    }
+
+    if (parts.size() > 2) {
+      gen.cardinality = std::stoul(parts.at(2));
+    }
+
+    if (parts.size() > 3) {
+      gen.nulls = std::stod(parts.at(3));
+    }
+
+    if (parts.size() > 4) {
+      gen.skew = std::stod(parts.at(4));
+    }
+
+    gens[parts.at(0)] = gen;
+  }
+
+  return gens;
+}
+
+void Synthetic::fill(
+  Chunk& chunk, size_t first, size_t size, size_t rows, size_t seed, std::pair<size_t, size_t> window) const {
+  chunk.size = size;
+  chunk.data.resize(columns_.size());
+  chunk.vectors.resize(columns_.size(), ColumnVector{ nullptr, nullptr });
+
+  // time of rows spreads over the window in ascending order, jittered within the step of a row
+  const auto span = window.second - window.first;
+  const auto step = std::max<size_t>(span / rows, 1);
+  chunk.times.resize(size);
+  for (size_t r = 0; r < size; ++r) {
+    const auto row = first + r;
+    const auto time = window.first + span * row / rows + draw(seed, row, 0) % step;
+    chunk.times[r] = std::min(time, window.second);
+  }
+
+  const auto total = window_.second - window_.first + 1;
+  for (size_t i = 0, count = columns_.size(); i < count; ++i) {
+    const auto& c = columns_[i];
+    auto& d = chunk.data[i];
+    auto& v = chunk.vectors[i];
+    d.valid.assign((size + 7) / 8, 0xFF);
+    v = ColumnVector{ nullptr, d.valid.data() };
+    if (c.compound) {
+      std::fill(d.valid.begin(), d.valid.end(), 0);
+      continue;
+    }
+
+    // value index of every row
+    const auto card = c.gen.cardinality;
+    d.keys.resize(size);
+    for (size_t r = 0; r < size; ++r) {
+      const auto row = first + r;
+      if (c.time) {
+        d.keys[r] = chunk.times[r];
+        continue;
+      }
+
+      const auto bits = draw(seed, row, c.salt);
+      if (c.gen.nulls > 0 && unit(draw(seed, row, ~c.salt)) < c.gen.nulls) {
+        d.valid[r >> 3] &= ~(1 << (r & 7));
+      }
+
+      switch (c.gen.distribution) {
+      case Distribution::ZIPF: {
+        const auto pos = std::upper_bound(c.cdf.begin(), c.cdf.end(), unit(bits)) - c.cdf.begin();
+        d.keys[r] = std::min<size_t>(pos, c.cdf.size() - 1);
+        break;
+      }
+      case Distribution::TIME: {
+        // one of every four rows is off by one value
+        const auto time = std::max<size_t>(chunk.times[r], window_.first);
+        auto key = std::min<size_t>((time - window_.first) * card / total, card - 1);
+        if ((bits & 3) == 0 && key + 1 < card) {
+          ++key;
+        }
+        d.keys[r] = key;
+        break;
+      }
+      default: d.keys[r] = bits % card; break;
+      }
+    }
+
+    // native values by the value indexes
+    auto native = [&c, &d, size](auto type) {
+      using T = decltype(type);
+      d.values.resize((size * sizeof(T) + sizeof(int128_t) - 1) / sizeof(int128_t));
+      auto values = reinterpret_cast<T*>(d.values.data());
+      for (size_t r = 0; r < size; ++r) {
+        const auto key = d.keys[r];
+        if constexpr (std::is_same_v<T, bool>) {
+          values[r] = c.numbers.empty() ? (key & 1) : c.numbers[key] != 0;
+        } else {
+          values[r] = c.numbers.empty() ? static_cast<T>(key) : static_cast<T>(c.numbers[key]);
+        }
+      }
+
+      return values;
+    };
+
+    switch (c.kind) {
+#define NATIVE_CASE(K, T)   \
+  case Kind::K: {           \
+    v.values = native(T{}); \
+    break;                  \
+  }
+
+      NATIVE_CASE(BOOLEAN, bool)
+      NATIVE_CASE(TINYINT, int8_t)
+      NATIVE_CASE(SMALLINT, int16_t)
+      NATIVE_CASE(INTEGER, int32_t)
+      NATIVE_CASE(BIGINT, int64_t)
+      NATIVE_CASE(REAL, float)
+      NATIVE_CASE(DOUBLE, double)
+      NATIVE_CASE(INT128, int128_t)
+
+#undef NATIVE_CASE
+    case Kind::VARCHAR: {
+      if (!c.dict.empty()) {
+        v.values = native(int32_t{});
+        v.dict = c.dict.data();
+        v.items = c.dict.size();
+        break;
+      }
+
+      // too many distinct strings to code, every chunk has its own copy
+      d.strings.resize(size);
+      d.views.resize(size);
+      for (size_t r = 0; r < size; ++r) {
+        d.strings[r] = fmt::format("{0}-{1}", c.name, d.keys[r]);
+        d.views[r] = d.strings[r];
+      }
+
+      v.values = d.views.data();
+      break;
+    }
+    default: throw NException(fmt::format("Not supported type in synthetic column: {0}", c.name));
+    }
+  }
+}
+
+nebula::common::unordered_map<size_t, std::shared_ptr<Batch>> Synthetic::generate(
+  size_t rows, size_t seed, std::pair<size_t, size_t> window) const {
+  nebula::common::unordered_map<size_t, std::shared_ptr<Batch>> batches;
+  const auto pod = table_.pod();
+  Chunk chunk;
+  ChunkRow row(*this, chunk);
+  for (size_t first = 0; first < rows; first += CHUNK) {
+    const auto size = std::min(CHUNK, rows - first);
+    fill(chunk, first, size, rows, seed, window);
+
+    if (columnar_) {
+      auto& batch = batches[0];
+      if (batch == nullptr) {
+        batch = std::make_shared<Batch>(table_, rows, 0);
+      }
+
+      batch->add(chunk.vectors, size);
+      continue;
+    }
+
+    // rows go to the batch of their partition
+    for (size_t r = 0; r < size; ++r) {
+      row.seek(r);
+      size_t pid = 0;
+      BessType bess = 0;
+      if (pod) {
+        pid = pod->pod(row, bess);
+      }
+
+      auto& batch = batches[pid];
+      if (batch == nullptr) {
+        batch = std::make_shared<Batch>(table_, rows, pid);
+      }
+
+      batch->add(row, bess);
+    }
+  }
+
+  return batches;
+}
+
+void Synthetic::generate(size_t blocks,
+                         size_t rows,
+                         size_t seed,
+                         size_t threads,
+                         const std::function<void(size_t, std::shared_ptr<Batch>)>& sink) const {
+  const auto span = window_.second - window_.first;
+  std::atomic<size_t> next{ 0 };
+  std::exception_ptr error;
+  std::mutex emux;
+  auto work = [&]() {
+    for (size_t i = next++; i < blocks; i = next++) {
+      try {
+        const std::pair<size_t, size_t> window{ window_.first + span * i / blocks,
+                                                window_.first + span * (i + 1) / blocks };
+        for (auto& item : generate(rows, seed + i, window)) {
+          sink(i, item.second);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(emux);
+        if (!error) {
+          error = std::current_exception();
+        }
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  const auto size = std::max<size_t>(1, std::min(threads, blocks));
+  workers.reserve(size);
+  for (size_t t = 0; t < size; ++t) {
+    workers.emplace_back(work);
+  }
+
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace memory
+} // namespace nebula
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Batch.h"
+#include "common/Hash.h"
+#include "meta/Table.h"
+
+/**
+ * Synthetic rows of a table for benchmarks and capacity tests.
+ * Every column draws a value index from its distribution over its cardinality, null by its null rate:
+ * - UNIFORM: all values are equally likely.
+ * - ZIPF: value k is the k-th most frequent one, with probability proportional to 1 / (k + 1) ^ skew.
+ * - TIME: value grows with time of the row over the whole window, so it is correlated with the time column.
+ * An index is the value itself for a number, "<column>-<index>" for a string, or the index-th partition value
+ * of a partition column. Time of rows in a block spreads over its window in ascending order.
+ *
+ * Values are a pure function of (seed, row, column), so blocks are generated in parallel, each by its own seed.
+ * Flat columns of a table not partitioned are appended into a batch column by column, strings are dictionary coded.
+ */
+namespace nebula {
+namespace memory {
+
+enum class Distribution { UNIFORM, ZIPF, TIME };
+
+struct ColumnGen {
+  Distribution distribution = Distribution::UNIFORM;
+  size_t cardinality = 1000;
+  double nulls = 0;
+  double skew = 1;
+};
+
+using ColumnGens = nebula::common::unordered_map<std::string, ColumnGen>;
+
+class Synthetic {
+  struct Column;
+  struct Chunk;
+  class ChunkRow;
+
+public:
+  // rows of the table in given window of unix time, columns not given are generated by the default
+  Synthetic(const nebula::meta::Table&,
+            std::pair<size_t, size_t>,
+            const ColumnGens& = {},
+            const ColumnGen& = {});
+  virtual ~Synthetic();
+
+  // column generators by a list of "column:distribution[:cardinality[:nulls[:skew]]]" separated by comma,
+  // such as "event:zipf:10000:0.01:1.2,value:time:100". Throws on an unknown distribution.
+  static ColumnGens parse(const std::string&);
+
+public:
+  // given rows in a window by partition, the same seed generates the same rows
+  nebula::common::unordered_map<size_t, std::shared_ptr<Batch>> generate(
+    size_t rows, size_t seed, std::pair<size_t, size_t>) const;
+
+  // blocks of given rows on given threads, block i covers the i-th even split of the window by seed + i.
+  // sink receives every batch with its block index, it is called by the threads concurrently.
+  void generate(size_t blocks,
+                size_t rows,
+                size_t seed,
+                size_t threads,
+                const std::function<void(size_t, std::shared_ptr<Batch>)>&) const;
+
+private:
+  // fill a chunk of rows [first, first + size) of a block having given rows
+  void fill(Chunk&, size_t first, size_t size, size_t rows, size_t seed, std::pair<size_t, size_t>) const;
+
+private:
+  // rows appended into a batch at a time
+  static constexpr size_t CHUNK = 4096;
+
+  // max distinct values of a zipf column or a dictionary coded string column
+  static constexpr size_t MAX_DICT = 1 << 20;
+
+  const nebula::meta::Table& table_;
+  std::pair<size_t, size_t> window_;
+  std::vector<Column> columns_;
+  nebula::common::unordered_map<std::string, size_t> index_;
+
+  // all columns are appended by vectors
+  bool columnar_;
+};
+
+} // namespace memory
+} // namespace nebula
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BitmapIndex.h"
+#include "common/Chars.h"
+
+/**
+ * Token inverted index of a string column in a block, built at seal for columns configured with tokens.
+ * A value is split into terms of token chars (see Chars::token), every distinct term maps to a bitmap of its rows.
+ * A substring made of token chars can't cross a term boundary, so rows having it are exactly the rows having a term
+ * containing it: LIKE '%term%' is answered by matching distinct terms once rather than every value.
+ */
+namespace nebula {
+namespace memory {
+
+class TokenIndex {
+public:
+  TokenIndex() = default;
+  virtual ~TokenIndex() = default;
+
+  // index terms of the value of given row
+  void add(size_t row, std::string_view value) {
+    const auto size = value.size();
+    size_t i = 0;
+    while (i < size) {
+      while (i < size && !nebula::common::Chars::token(value[i])) {
+        ++i;
+      }
+
+      const auto start = i;
+      while (i < size && nebula::common::Chars::token(value[i])) {
+        ++i;
+      }
+
+      if (i > start) {
+        terms_.add(row, value.substr(start, i - start));
+      }
+    }
+  }
+
+  // move terms into compact lists once all rows are added
+  inline void seal() {
+    terms_.seal();
+  }
+
+  // number of distinct terms
+  inline size_t size() const noexcept {
+    return terms_.size();
+  }
+
+  // flag of every row having any term matched by the predicate, out of given number of rows
+  template <typename P>
+  inline std::vector<bool> match(P&& pred, size_t rows) const {
+    return terms_.match([&pred](const std::string& term) { return pred(std::string_view(term)); }, rows);
+  }
+
+  inline size_t bytes() const noexcept {
+    return terms_.bytes();
+  }
+
+private:
+  BitmapIndex<std::string> terms_;
+};
+
+} // namespace memory
+} // namespace nebula
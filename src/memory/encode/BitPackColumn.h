@@ -0,0 +1,234 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "common/Memory.h"
+
+/**
+ * Integer values of a sealed column stored by frame of reference and bit packing.
+ * Values are packed in chunks: every chunk keeps its min value as reference, and packs value - reference
+ * in the fewest bits holding the chunk's value range, value i of a chunk takes bits [i * width, (i + 1) * width)
+ * of the chunk's 64-bit words. Any packed value is extracted from the two words it may span by shifts and a mask,
+ * so a chunk is unpacked by a branch-free loop which compiler vectorizes (gathers), and a random read doesn't need
+ * any decoded chunk.
+ *
+ * Range predicates run on packed values: bounds are adjusted by the reference of every chunk,
+ * and a chunk entirely in or out of the range is decided by its reference and max without touching its values.
+ */
+namespace nebula {
+namespace memory {
+namespace encode {
+
+template <typename T>
+class BitPackColumn {
+  static_assert(std::is_integral_v<T> && std::is_signed_v<T>, "bit packed column for signed integers only");
+
+public:
+  // number of values in every chunk
+  static constexpr size_t CHUNK = 512;
+
+  explicit BitPackColumn(size_t capacity)
+    : slice_{ std::max<size_t>(capacity, 1024) },
+      size_{ 0 },
+      count_{ 0 } {}
+  virtual ~BitPackColumn() = default;
+
+public:
+  // encode count values given by reader(index)
+  template <typename R>
+  void encode(size_t count, R&& reader) {
+    const auto chunks = (count + CHUNK - 1) / CHUNK;
+    refs_.reserve(chunks);
+    highs_.reserve(chunks);
+    widths_.reserve(chunks);
+    offsets_.reserve(chunks);
+
+    T values[CHUNK];
+    uint64_t words[CHUNK];
+    for (size_t start = 0; start < count; start += CHUNK) {
+      const auto size = std::min(CHUNK, count - start);
+      T min = reader(start);
+      T max = min;
+      for (size_t i = 0; i < size; ++i) {
+        values[i] = reader(start + i);
+        min = std::min(min, values[i]);
+        max = std::max(max, values[i]);
+      }
+
+      const uint64_t range = static_cast<uint64_t>(max) - static_cast<uint64_t>(min);
+      const size_t width = range == 0 ? 0 : 64 - __builtin_clzll(range);
+      refs_.push_back(min);
+      highs_.push_back(max);
+      widths_.push_back(width);
+      offsets_.push_back(size_);
+
+      // pack values into whole words, a value may spill into the next word
+      const auto bytes = (size * width + 63) / 64 * sizeof(uint64_t);
+      std::memset(words, 0, bytes);
+      for (size_t i = 0; width > 0 && i < size; ++i) {
+        const uint64_t code = static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(min);
+        const auto bit = i * width;
+        const auto shift = bit % 64;
+        words[bit / 64] |= code << shift;
+        if (shift + width > 64) {
+          words[bit / 64 + 1] |= code >> (64 - shift);
+        }
+      }
+
+      size_ += slice_.write(size_, reinterpret_cast<const char*>(words), bytes);
+    }
+
+    // pad the stream so that the word after the last value can be loaded as well, even it is an empty chunk
+    constexpr size_t PAD = 2 * sizeof(uint64_t);
+    slice_.write(size_ + PAD - 1, (char)0);
+    slice_.seal(size_ + PAD);
+    count_ = count;
+  }
+
+  inline T read(size_t index) const {
+    const auto c = index / CHUNK;
+    return value(c, packed(words(c), widths_[c], mask(c), index % CHUNK));
+  }
+
+  // unpack values [start, start + count) into given buffer
+  void read(size_t start, size_t count, T* out) const {
+    scan(start, count, [this, &out](size_t c, size_t from, size_t size) {
+      const auto words = this->words(c);
+      const size_t width = widths_[c];
+      const auto mask = this->mask(c);
+      const auto ref = static_cast<uint64_t>(refs_[c]);
+      const auto dst = out;
+      for (size_t i = 0; i < size; ++i) {
+        dst[i] = static_cast<T>(ref + packed(words, width, mask, from + i));
+      }
+
+      out += size;
+    });
+  }
+
+  // evaluate low <= value <= high for values [start, start + count) into mask, 1 for true and 0 for false.
+  // packed values are compared against the bounds adjusted by chunk reference, they are never decoded.
+  void match(int64_t low, int64_t high, size_t start, size_t count, uint8_t* out) const {
+    scan(start, count, [this, low, high, &out](size_t c, size_t from, size_t size) {
+      const int64_t ref = refs_[c];
+      const int64_t max = highs_[c];
+      if (low > high || high < ref || low > max) {
+        std::memset(out, 0, size);
+      } else if (low <= ref && high >= max) {
+        std::memset(out, 1, size);
+      } else {
+        // packed value p matches if p - lo <= hi - lo in unsigned arithmetic
+        const auto dst = out;
+        const auto words = this->words(c);
+        const size_t width = widths_[c];
+        const auto mask = this->mask(c);
+        const uint64_t lo = low <= ref ? 0 : static_cast<uint64_t>(low) - static_cast<uint64_t>(ref);
+        const uint64_t span = static_cast<uint64_t>(std::min(high, max)) - static_cast<uint64_t>(ref) - lo;
+        // packed values are compared in 64-bit lanes before narrowed into the mask
+        uint64_t codes[LANES];
+        for (size_t base = 0; base < size; base += LANES) {
+          const auto n = std::min(LANES, size - base);
+          unpack(words, width, mask, from + base, n, codes);
+          for (size_t i = 0; i < n; ++i) {
+            dst[base + i] = codes[i] - lo <= span;
+          }
+        }
+      }
+
+      out += size;
+    });
+  }
+
+  // number of values
+  inline size_t count() const {
+    return count_;
+  }
+
+  // bytes of encoded data
+  inline size_t size() const {
+    return size_ + (sizeof(T) * 2 + sizeof(size_t) + 1) * refs_.size();
+  }
+
+  inline size_t capacity() const {
+    return slice_.size() + (sizeof(T) * 2 + sizeof(size_t) + 1) * refs_.capacity();
+  }
+
+private:
+  static constexpr size_t LANES = 64;
+
+  // packed value i of a chunk of given width, the next word is shifted twice to avoid a shift by 64
+  static inline uint64_t packed(const uint64_t* words, size_t width, uint64_t mask, size_t i) {
+    const auto bit = i * width;
+    const auto index = bit / 64;
+    const auto shift = bit % 64;
+    return ((words[index] >> shift) | ((words[index + 1] << 1) << (63 - shift))) & mask;
+  }
+
+  // packed values [first, first + n) of a chunk, out never overlaps the chunk words
+  static inline void unpack(
+    const uint64_t* __restrict words, size_t width, uint64_t mask, size_t first, size_t n, uint64_t* __restrict out) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = packed(words, width, mask, first + i);
+    }
+  }
+
+  // chunks start at word boundaries of the slice
+  inline const uint64_t* words(size_t c) const {
+    return reinterpret_cast<const uint64_t*>(slice_.ptr() + offsets_[c]);
+  }
+
+  inline uint64_t mask(size_t c) const {
+    return widths_[c] == 0 ? 0 : ~0ULL >> (64 - widths_[c]);
+  }
+
+  inline T value(size_t c, uint64_t code) const {
+    return static_cast<T>(static_cast<uint64_t>(refs_[c]) + code);
+  }
+
+  // call f(chunk, first index in chunk, number of values) for every chunk piece of values [start, start + count)
+  template <typename F>
+  inline void scan(size_t start, size_t count, F&& f) const {
+    const auto end = start + count;
+    while (start < end) {
+      const auto c = start / CHUNK;
+      const auto from = start % CHUNK;
+      const auto size = std::min(CHUNK - from, end - start);
+      f(c, from, size);
+      start += size;
+    }
+  }
+
+private:
+  nebula::common::ExtendableSlice slice_;
+  size_t size_;
+  size_t count_;
+
+  // reference (min) and max value, bit width and byte offset of every chunk
+  std::vector<T> refs_;
+  std::vector<T> highs_;
+  std::vector<uint8_t> widths_;
+  std::vector<size_t> offsets_;
+};
+
+} // namespace encode
+} // namespace memory
+} // namespace nebula
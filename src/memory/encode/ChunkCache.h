@@ -0,0 +1,61 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+
+/**
+ * Encoded columns store values in chunks of fixed number of values, reading a value decodes its chunk.
+ * Every reading thread keeps the last chunk it decoded, so a scan reading rows in order decodes each chunk once
+ * while readers of the same column never share mutable state.
+ */
+namespace nebula {
+namespace memory {
+namespace encode {
+
+// identifier of a new encoded column to tell its cached chunks, 0 is never used
+inline size_t columnId() {
+  static std::atomic<size_t> sequence{ 0 };
+  return ++sequence;
+}
+
+template <typename T, size_t N>
+class ChunkCache {
+  struct Chunk {
+    size_t column;
+    size_t index;
+    T values[N];
+  };
+
+public:
+  // values of chunk of given index in a column, decode(index, T*) fills them if not cached by current thread
+  template <typename D>
+  static inline const T* get(size_t column, size_t index, D&& decode) {
+    thread_local Chunk cache{ 0, 0, {} };
+    if (cache.column != column || cache.index != index) {
+      decode(index, cache.values);
+      cache.column = column;
+      cache.index = index;
+    }
+
+    return cache.values;
+  }
+};
+
+} // namespace encode
+} // namespace memory
+} // namespace nebula
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "ChunkCache.h"
+#include "common/Memory.h"
+
+/**
+ * Integer values of a sealed column stored as deltas of adjacent values, it fits (nearly) sorted columns
+ * such as time column where most deltas are small.
+ * Values are encoded in chunks, every chunk keeps its first value as base and byte offset of its deltas.
+ * Deltas are zigzag encoded in 32 bits by group varint: every group of 4 deltas is led by a tag byte
+ * of their byte lengths (2 bits each), so a group is decoded by masked loads without a branch per byte.
+ *
+ * Every chunk records its min and max value as well. Prefix max and suffix min of chunks are monotonic
+ * even if values are not fully sorted, so rows in a value range are found by binary search on chunks,
+ * and refined into exact rows inside the boundary chunks if the column is sorted.
+ */
+namespace nebula {
+namespace memory {
+namespace encode {
+
+template <typename T>
+class DeltaColumn {
+  static_assert(std::is_integral_v<T> && std::is_signed_v<T>, "delta column for signed integers only");
+
+public:
+  // number of values in every chunk
+  static constexpr size_t CHUNK = 1024;
+
+  explicit DeltaColumn(size_t capacity)
+    : id_{ columnId() },
+      slice_{ std::max<size_t>(capacity, 1024) },
+      size_{ 0 },
+      count_{ 0 },
+      sorted_{ true } {}
+  virtual ~DeltaColumn() = default;
+
+public:
+  // encode count values given by reader(index), return false if a delta doesn't fit in 32 bits
+  template <typename R>
+  bool encode(size_t count, R&& reader) {
+    const auto chunks = (count + CHUNK - 1) / CHUNK;
+    bases_.reserve(chunks);
+    offsets_.reserve(chunks);
+    highs_.reserve(chunks);
+    lows_.reserve(chunks);
+
+    T prev = count > 0 ? reader(0) : 0;
+    uint32_t group[4];
+    for (size_t start = 0; start < count; start += CHUNK) {
+      const auto end = std::min(count, start + CHUNK);
+      const T base = reader(start);
+      sorted_ = sorted_ && base >= prev;
+      prev = base;
+      T min = base;
+      T max = base;
+
+      bases_.push_back(base);
+      offsets_.push_back(size_);
+      for (size_t i = start + 1; i < end; i += 4) {
+        for (size_t k = 0; k < 4; ++k) {
+          group[k] = 0;
+          if (i + k < end) {
+            const T value = reader(i + k);
+            int64_t delta;
+            if (__builtin_sub_overflow((int64_t)value, (int64_t)prev, &delta)) {
+              return false;
+            }
+
+            const uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+            if (zigzag > std::numeric_limits<uint32_t>::max()) {
+              return false;
+            }
+
+            sorted_ = sorted_ && delta >= 0;
+            group[k] = zigzag;
+            prev = value;
+            min = std::min(min, value);
+            max = std::max(max, value);
+          }
+        }
+
+        write(group);
+      }
+
+      highs_.push_back(highs_.empty() ? max : std::max(highs_.back(), max));
+      lows_.push_back(min);
+    }
+
+    // suffix min of chunks
+    for (size_t i = lows_.size(); i > 1; --i) {
+      lows_[i - 2] = std::min(lows_[i - 2], lows_[i - 1]);
+    }
+
+    // pad the stream so that the last value is loaded by 4 bytes as well
+    slice_.write(size_, (uint32_t)0);
+    slice_.seal(size_ + sizeof(uint32_t));
+    count_ = count;
+    return true;
+  }
+
+  inline T read(size_t index) const {
+    return chunk(index / CHUNK)[index % CHUNK];
+  }
+
+  // decode values [start, start + count) into given buffer
+  void read(size_t start, size_t count, T* out) const {
+    const auto end = start + count;
+    while (start < end) {
+      const auto values = chunk(start / CHUNK);
+      const auto offset = start % CHUNK;
+      const auto size = std::min(CHUNK - offset, end - start);
+      std::copy(values + offset, values + offset + size, out);
+      out += size;
+      start += size;
+    }
+  }
+
+  // rows [first, last) which may have values in [low, high], no row out of it has value in the range.
+  // it is exact when the column is sorted.
+  std::pair<size_t, size_t> rows(T low, T high) const {
+    if (count_ == 0 || low > high) {
+      return { 0, 0 };
+    }
+
+    // chunks before first have all values < low, chunks from last have all values > high
+    const size_t fc = std::lower_bound(highs_.begin(), highs_.end(), low) - highs_.begin();
+    const size_t lc = std::upper_bound(lows_.begin(), lows_.end(), high) - lows_.begin();
+    if (fc >= lc) {
+      return { 0, 0 };
+    }
+
+    size_t first = fc * CHUNK;
+    size_t last = std::min(count_, lc * CHUNK);
+    if (sorted_) {
+      const auto fv = chunk(fc);
+      first += std::lower_bound(fv, fv + rowsOf(fc), low) - fv;
+      const auto lv = chunk(lc - 1);
+      last = (lc - 1) * CHUNK + (std::upper_bound(lv, lv + rowsOf(lc - 1), high) - lv);
+    }
+
+    return { first, std::max(first, last) };
+  }
+
+  // all values are in ascending order
+  inline bool sorted() const {
+    return sorted_;
+  }
+
+  // number of values
+  inline size_t count() const {
+    return count_;
+  }
+
+  // bytes of encoded data
+  inline size_t size() const {
+    return size_ + (sizeof(T) * 3 + sizeof(size_t)) * bases_.size();
+  }
+
+  inline size_t capacity() const {
+    return slice_.size() + (sizeof(T) * 3 + sizeof(size_t)) * bases_.capacity();
+  }
+
+private:
+  static constexpr uint32_t MASKS[] = { 0xFF, 0xFFFF, 0xFFFFFF, 0xFFFFFFFF };
+
+  // write a group of 4 deltas led by their byte lengths
+  inline void write(const uint32_t* group) {
+    const auto tag = size_++;
+    uint8_t lengths = 0;
+    for (size_t k = 0; k < 4; ++k) {
+      const auto value = group[k];
+      const size_t bytes = value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+      lengths |= (bytes - 1) << (k * 2);
+      size_ += slice_.write(size_, reinterpret_cast<const char*>(&value), bytes);
+    }
+
+    slice_.write(tag, lengths);
+  }
+
+  inline size_t rowsOf(size_t chunk) const {
+    return std::min(CHUNK, count_ - chunk * CHUNK);
+  }
+
+  // decoded values of chunk of given index
+  inline const T* chunk(size_t index) const {
+    return ChunkCache<T, CHUNK>::get(id_, index, [this](size_t c, T* out) {
+      const auto size = rowsOf(c);
+      const NByte* bytes = slice_.ptr() + offsets_.at(c);
+      T value = bases_.at(c);
+      out[0] = value;
+      for (size_t i = 1; i < size; i += 4) {
+        const auto lengths = *bytes++;
+        uint32_t group[4];
+        for (size_t k = 0; k < 4; ++k) {
+          const auto code = (lengths >> (k * 2)) & 0x03;
+          uint32_t word;
+          std::memcpy(&word, bytes, sizeof(word));
+          group[k] = word & MASKS[code];
+          bytes += code + 1;
+        }
+
+        for (size_t k = 0, n = std::min<size_t>(4, size - i); k < n; ++k) {
+          value += static_cast<T>((group[k] >> 1) ^ -(int64_t)(group[k] & 1));
+          out[i + k] = value;
+        }
+      }
+    });
+  }
+
+private:
+  const size_t id_;
+  nebula::common::ExtendableSlice slice_;
+  size_t size_;
+  size_t count_;
+  bool sorted_;
+
+  // base value and byte offset of every chunk
+  std::vector<T> bases_;
+  std::vector<size_t> offsets_;
+
+  // prefix max and suffix min of chunk values
+  std::vector<T> highs_;
+  std::vector<T> lows_;
+};
+
+} // namespace encode
+} // namespace memory
+} // namespace nebula
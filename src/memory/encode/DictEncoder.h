@@ -16,7 +16,9 @@
 
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <vector>
 
 #include "common/Hash.h"
 #include "common/Memory.h"
@@ -26,88 +28,177 @@ namespace memory {
 namespace encode {
 /**
  * Dictionary encoding for text values.
- * It works like this:
- * 1. Reading tokens from the text value separated by <space>
- * 2. It applies only first 255 characters for using one byte store position info.
- * 3. It only works for token which length is longer than 2.
- * 4. An encoded string are stored like this 
- *      [number dict items(0~255)][p0(0-255)][c0(0-65536)][p1(0-255)]...[pN(0-255)]
+ * Every distinct item is assigned a code in order of arrival while building, items are found by a flat
+ * open addressing table of (hash tag, code) probed linearly, so no allocation per item.
+ * At seal, items are sorted and re-coded so that code order is the same as item order,
+ * callers rewrite their codes by the mapping returned by seal, after which ranges and order of items
+ * can be evaluated on codes directly.
  */
 class DictEncoder {
   // assuming dictionary item can not exceeding max integer
   using IndexType = int32_t;
 
-  // all items share the same hash value
-  using HashItems = std::unordered_multimap<size_t, IndexType>;
+  // a slot of the lookup table, tag is high bits of item hash to skip most string comparisons
+  struct Slot {
+    uint32_t tag;
+    IndexType index;
+  };
 
   // 6K page size per each dictinoary
   static constexpr auto INDICE_PAGE = 2048;
   static constexpr auto DICT_PAGE = 4096;
   static constexpr auto IndexWidth = sizeof(IndexType);
+  static constexpr IndexType EMPTY = -1;
+  static constexpr size_t INIT_SLOTS = 64;
 
 public:
   DictEncoder()
-    : hashItems_{ std::make_unique<HashItems>() },
-      offsets_{ INDICE_PAGE },
-      dict_{ DICT_PAGE },
+    : slots_(INIT_SLOTS, Slot{ 0, EMPTY }),
+      offsets_{ std::make_unique<nebula::common::ExtendableSlice>(INDICE_PAGE) },
+      dict_{ std::make_unique<nebula::common::ExtendableSlice>(DICT_PAGE) },
       items_{ 0 },
       size_{ 0 } {
-    offsets_.write(0, 0);
+    offsets_->write(0, 0);
   }
+
+  virtual ~DictEncoder() = default;
+
   // set item and return its index in dictionary
   int32_t set(std::string_view item) {
     // check if this item is already in our dictionary
-    auto hash = nebula::common::Hasher::hash64(item.data(), item.size());
-    auto range = hashItems_->equal_range(hash);
-    for (auto it = range.first; it != range.second; ++it) {
-      // get offset and length of given index
-
-      const auto index = it->second;
-      auto str = get(index);
-
-      // string view equals
-      if (item == str) {
-        return index;
+    const auto hash = nebula::common::Hasher::hash64(item.data(), item.size());
+    const auto tag = static_cast<uint32_t>(hash >> 32);
+    const auto mask = slots_.size() - 1;
+    auto pos = hash & mask;
+    for (; slots_[pos].index != EMPTY; pos = (pos + 1) & mask) {
+      const auto& slot = slots_[pos];
+      if (slot.tag == tag && get(slot.index) == item) {
+        return slot.index;
       }
     }
 
     // not found, we're adding this new item
     // write offset of the new item
-    size_ += dict_.write(size_, item.data(), item.size());
-    // add the hash value to the list for next value to lookup
-    hashItems_->emplace(hash, items_);
-    offsets_.write((items_ + 1) * IndexWidth, size_);
-    return items_++;
+    size_ += dict_->write(size_, item.data(), item.size());
+    offsets_->write((items_ + 1) * IndexWidth, size_);
+    slots_[pos] = Slot{ tag, items_ };
+
+    // keep load factor under 1/2 for short probes
+    if (static_cast<size_t>(++items_) * 2 > slots_.size()) {
+      grow();
+    }
+
+    return items_ - 1;
   }
 
   // get the item by its index
   inline std::string_view get(int32_t index) const {
     const auto pos = index * IndexWidth;
     const auto pos2 = pos + IndexWidth;
-    auto offset = offsets_.read<IndexType>(pos);
-    auto offset2 = offsets_.read<IndexType>(pos2);
-    return dict_.read(offset, offset2 - offset);
+    auto offset = offsets_->read<IndexType>(pos);
+    auto offset2 = offsets_->read<IndexType>(pos2);
+    return dict_->read(offset, offset2 - offset);
+  }
+
+  // number of items in the dictionary
+  inline int32_t size() const {
+    return items_;
+  }
+
+  // bytes allocated for items and their offsets
+  inline size_t capacity() const {
+    return offsets_->size() + dict_->size();
+  }
+
+  // the first code whose item is not less than given value, size() if none, only valid after seal
+  inline int32_t lowerBound(std::string_view value) const {
+    IndexType low = 0;
+    IndexType high = items_;
+    while (low < high) {
+      const auto mid = low + (high - low) / 2;
+      if (get(mid) < value) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+
+    return low;
   }
 
-  void seal() {
+  // sort items and release the lookup table, return new code of every old code,
+  // an empty mapping means codes are not changed
+  std::vector<IndexType> seal() {
     // release the assitant data structure
-    hashItems_ = nullptr;
+    slots_ = {};
+
+    std::vector<IndexType> sorted(items_);
+    std::iota(sorted.begin(), sorted.end(), 0);
+    std::sort(sorted.begin(), sorted.end(), [this](IndexType left, IndexType right) {
+      return get(left) < get(right);
+    });
+
+    std::vector<IndexType> codes;
+    for (IndexType i = 0; i < items_; ++i) {
+      if (sorted[i] != i) {
+        codes.resize(items_, 0);
+        break;
+      }
+    }
+
+    if (!codes.empty()) {
+      auto offsets = std::make_unique<nebula::common::ExtendableSlice>((items_ + 1) * IndexWidth);
+      auto dict = std::make_unique<nebula::common::ExtendableSlice>(size_);
+      int32_t size = 0;
+      offsets->write(0, 0);
+      for (IndexType i = 0; i < items_; ++i) {
+        const auto item = get(sorted[i]);
+        size += dict->write(size, item.data(), item.size());
+        offsets->write((i + 1) * IndexWidth, size);
+        codes[sorted[i]] = i;
+      }
+
+      offsets_ = std::move(offsets);
+      dict_ = std::move(dict);
+    }
+
+    offsets_->seal((items_ + 1) * IndexWidth);
+    dict_->seal(size_);
+    return codes;
+  }
+
+private:
+  // double the lookup table and place every item again
+  void grow() {
+    std::vector<Slot> slots(slots_.size() * 2, Slot{ 0, EMPTY });
+    const auto mask = slots.size() - 1;
+    for (const auto& slot : slots_) {
+      if (slot.index != EMPTY) {
+        const auto item = get(slot.index);
+        auto pos = nebula::common::Hasher::hash64(item.data(), item.size()) & mask;
+        while (slots[pos].index != EMPTY) {
+          pos = (pos + 1) & mask;
+        }
+
+        slots[pos] = slot;
+      }
+    }
 
-    offsets_.seal((items_ + 1) * IndexWidth);
-    dict_.seal(size_);
+    std::swap(slots_, slots);
   }
 
 private:
-  std::unique_ptr<HashItems> hashItems_;
+  // lookup table of items while building, its size is power of 2
+  std::vector<Slot> slots_;
 
   // every value has offset and length of the dict item
-  nebula::common::ExtendableSlice offsets_;
+  std::unique_ptr<nebula::common::ExtendableSlice> offsets_;
   // store all dictionary items in order
-  nebula::common::ExtendableSlice dict_;
+  std::unique_ptr<nebula::common::ExtendableSlice> dict_;
   // current size of the dictinaary slice
   int32_t items_;
   int32_t size_;
 };
 } // namespace encode
 } // namespace memory
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
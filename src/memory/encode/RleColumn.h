@@ -0,0 +1,127 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "ChunkCache.h"
+#include "RleDecoder.h"
+#include "RleEncoder.h"
+#include "common/Memory.h"
+
+/**
+ * Integer values of a sealed column stored by RLE encoding.
+ * Values are encoded in chunks of fixed number of values, and every chunk is located by its byte offset,
+ * so reading a value decodes its chunk only, refer ChunkCache for how decoded chunks are kept.
+ */
+namespace nebula {
+namespace memory {
+namespace encode {
+
+template <typename T>
+class RleColumn {
+  static_assert(std::is_integral_v<T> && std::is_signed_v<T>, "RLE column for signed integers only");
+
+public:
+  // number of values in every chunk
+  static constexpr size_t CHUNK = 1024;
+
+  explicit RleColumn(size_t capacity)
+    : id_{ columnId() },
+      slice_{ std::max<size_t>(capacity, 1024) },
+      size_{ 0 },
+      count_{ 0 } {}
+  virtual ~RleColumn() = default;
+
+public:
+  // encode count values given by reader(index)
+  template <typename R>
+  void encode(size_t count, R&& reader) {
+    chunks_.reserve((count + CHUNK - 1) / CHUNK);
+    for (size_t start = 0; start < count; start += CHUNK) {
+      chunks_.push_back(size_);
+      RleEncoder encoder(true, slice_, true, size_);
+      for (size_t i = start, end = std::min(count, start + CHUNK); i < end; ++i) {
+        encoder.write(reader(i));
+      }
+
+      encoder.flush();
+      size_ = encoder.position();
+    }
+
+    count_ = count;
+    slice_.seal(size_);
+  }
+
+  inline T read(size_t index) const {
+    return chunk(index / CHUNK)[index % CHUNK];
+  }
+
+  // decode values [start, start + count) into given buffer
+  void read(size_t start, size_t count, T* out) const {
+    const auto end = start + count;
+    while (start < end) {
+      const auto values = chunk(start / CHUNK);
+      const auto offset = start % CHUNK;
+      const auto size = std::min(CHUNK - offset, end - start);
+      std::copy(values + offset, values + offset + size, out);
+      out += size;
+      start += size;
+    }
+  }
+
+  // number of values
+  inline size_t count() const {
+    return count_;
+  }
+
+  // bytes of encoded data
+  inline size_t size() const {
+    return size_;
+  }
+
+  inline size_t capacity() const {
+    return slice_.size() + chunks_.capacity() * sizeof(size_t);
+  }
+
+private:
+  // decoded values of chunk of given index
+  inline const T* chunk(size_t index) const {
+    return ChunkCache<T, CHUNK>::get(id_, index, [this](size_t c, T* out) {
+      const auto size = std::min(CHUNK, count_ - c * CHUNK);
+      int64_t values[CHUNK];
+      RleDecoder decoder(true, slice_, chunks_.at(c));
+      decoder.next(values, size);
+      std::copy(values, values + size, out);
+    });
+  }
+
+private:
+  const size_t id_;
+  nebula::common::ExtendableSlice slice_;
+  size_t size_;
+  size_t count_;
+
+  // byte offset of every chunk
+  std::vector<size_t> chunks_;
+};
+
+} // namespace encode
+} // namespace memory
+} // namespace nebula
@@ -24,7 +24,8 @@ namespace nebula {
 namespace memory {
 namespace encode {
 
-static constexpr auto UNPACK_MAX = 256;
+// a patched run holds up to MAX_LITERAL_SIZE values
+static constexpr auto UNPACK_MAX = MAX_LITERAL_SIZE;
 
 // Implement run length encoding for numbers.
 // this code is mostly inspired and copied from Apache ORC implementation.
@@ -32,10 +33,11 @@ static constexpr auto UNPACK_MAX = 256;
 // https://github.com/apache/orc/blob/master/c%2B%2B/src/RleDecoderV2.cc
 class RleDecoder {
 public:
-  RleDecoder(bool isSigned, nebula::common::ExtendableSlice& buffer)
+  // decode values from buffer starting at byte offset
+  RleDecoder(bool isSigned, const nebula::common::ExtendableSlice& buffer, size_t offset = 0)
     : isSigned_{ isSigned },
       buffer_{ buffer },
-      cursor_(0),
+      cursor_(offset),
       firstByte_(0),
       runLength_(0),
       runRead_(0),
@@ -91,7 +93,7 @@ private:
 private:
   // basic input data to decode
   bool isSigned_;
-  nebula::common::ExtendableSlice& buffer_;
+  const nebula::common::ExtendableSlice& buffer_;
   uint64_t cursor_;
 
   // decoding state
@@ -114,7 +116,6 @@ private:
   int64_t patchMask_;     // Used by PATCHED_BASE
   int64_t actualGap_;     // Used by PATCHED_BASE
 
-  // TODO: auto grow this packaged and unpacked
   int64_t unpacked_[UNPACK_MAX];      // Used by PATCHED_BASE
   int64_t unpackedPatch_[UNPACK_MAX]; // Used by PATCHED_BASE
 };
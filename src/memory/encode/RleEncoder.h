@@ -53,11 +53,12 @@ public:
   // signed: signed value
   // buffer: encoder doesn't own any memory, it writes to external allocated slice
   // alignBp: align bit packing
-  RleEncoder(bool isSigned, nebula::common::ExtendableSlice& buffer, bool alignBp = true)
+  // offset: position in buffer to start writing at
+  RleEncoder(bool isSigned, nebula::common::ExtendableSlice& buffer, bool alignBp = true, size_t offset = 0)
     : isSigned_{ isSigned },
       alignBp_{ alignBp },
       buffer_{ buffer },
-      bufferPos_{ 0 },
+      bufferPos_{ offset },
       prevDelta_{ 0 },
       fixedRunLength_{ 0 },
       variableRunLength_{ 0 },
@@ -70,6 +71,11 @@ public:
   // encode 8 bytes in
   void write(int64_t);
 
+  // position in buffer after all bytes written so far
+  inline size_t position() const {
+    return bufferPos_;
+  }
+
 private:
   void determineEncoding(EncodingOption& option);
   void computeZigZagLiterals(EncodingOption& option);
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedDict.h"
+
+#include <gflags/gflags.h>
+
+DEFINE_uint64(SHARED_DICT_ITEMS,
+              65536,
+              "max items of a table-wide shared dictionary of a string column in a node, "
+              "blocks created after it is full build their own dictionaries");
+
+namespace nebula {
+namespace memory {
+namespace encode {
+
+std::shared_ptr<SharedDict> SharedDict::of(const std::string& table, const std::string& column) {
+  static std::mutex lock;
+  static nebula::common::unordered_map<std::string, std::weak_ptr<SharedDict>> dicts;
+
+  const auto key = table + "/" + column;
+  std::lock_guard<std::mutex> guard(lock);
+  auto dict = dicts[key].lock();
+  if (dict) {
+    return dict->full() ? nullptr : dict;
+  }
+
+  // dictionaries no longer held by any block are forgotten
+  for (auto it = dicts.begin(); it != dicts.end();) {
+    it = it->second.expired() && it->first != key ? dicts.erase(it) : std::next(it);
+  }
+
+  dict = std::make_shared<SharedDict>(FLAGS_SHARED_DICT_ITEMS);
+  dicts[key] = dict;
+  return dict;
+}
+
+} // namespace encode
+} // namespace memory
+} // namespace nebula
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/Arena.h"
+#include "common/Errors.h"
+#include "common/Hash.h"
+
+/**
+ * Dictionary of a string column shared by all blocks of a table in a node, enabled by column setting "shared_dict".
+ * Items are only appended and a code never changes once assigned, so an item is stored once for the table
+ * and has the same code in every block. Blocks hold the dictionary by shared pointer, it is released
+ * along with the last block holding it.
+ *
+ * Items are appended under a lock by ingesting blocks, reading the item of a known code takes no lock:
+ * items live in pages never moved, and a page is published before any code in it is handed out.
+ * Unlike a block dictionary, codes are not sorted by item at seal since other blocks share them.
+ */
+namespace nebula {
+namespace memory {
+namespace encode {
+
+class SharedDict {
+  static constexpr size_t PAGE_BITS = 12;
+  static constexpr size_t PAGE = 1 << PAGE_BITS;
+  static constexpr size_t MAX_PAGES = 4096;
+  static constexpr size_t ARENA_BLOCK = 64 * 1024;
+
+public:
+  // a dictionary is full when it reaches given number of items, blocks created after that use their own
+  explicit SharedDict(size_t capacity)
+    : capacity_{ std::min(capacity, PAGE * MAX_PAGES) },
+      pages_{ std::make_unique<std::atomic<std::string_view*>[]>(MAX_PAGES) },
+      arena_{ ARENA_BLOCK },
+      size_{ 0 } {
+    for (size_t i = 0; i < MAX_PAGES; ++i) {
+      pages_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+  virtual ~SharedDict() = default;
+
+  // code of given item, the item is appended if it is new
+  int32_t set(std::string_view item) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto found = codes_.find(item);
+    if (found != codes_.end()) {
+      return found->second;
+    }
+
+    const auto code = size_.load(std::memory_order_relaxed);
+    N_ENSURE_LT(static_cast<size_t>(code), PAGE * MAX_PAGES, "shared dictionary is out of pages");
+    if ((code & (PAGE - 1)) == 0) {
+      owned_.push_back(std::make_unique<std::string_view[]>(PAGE));
+      pages_[code >> PAGE_BITS].store(owned_.back().get(), std::memory_order_release);
+    }
+
+    // copy of item lives in the arena as long as the dictionary
+    auto chars = static_cast<char*>(arena_.allocate(item.size(), 1));
+    if (item.size() > 0) {
+      std::memcpy(chars, item.data(), item.size());
+    }
+
+    const std::string_view copy(chars, item.size());
+    owned_.back()[code & (PAGE - 1)] = copy;
+    codes_.emplace(copy, code);
+    size_.store(code + 1, std::memory_order_release);
+    return code;
+  }
+
+  // item of a code handed out by set
+  inline std::string_view get(int32_t code) const {
+    return pages_[code >> PAGE_BITS].load(std::memory_order_acquire)[code & (PAGE - 1)];
+  }
+
+  // number of items in the dictionary
+  inline int32_t size() const {
+    return size_.load(std::memory_order_acquire);
+  }
+
+  inline bool full() const {
+    return static_cast<size_t>(size()) >= capacity_;
+  }
+
+  // bytes allocated for items and their pages, the lookup table is not counted
+  inline size_t capacity() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return arena_.allocated() + owned_.size() * PAGE * sizeof(std::string_view);
+  }
+
+  // shared dictionary of a column of a table in this node, a new one if none is held by any block.
+  // nullptr if the dictionary is full, so that a new block builds its own dictionary.
+  static std::shared_ptr<SharedDict> of(const std::string& table, const std::string& column);
+
+private:
+  const size_t capacity_;
+
+  // item views by code in pages, pointers of pages are read without lock
+  std::unique_ptr<std::atomic<std::string_view*>[]> pages_;
+  std::vector<std::unique_ptr<std::string_view[]>> owned_;
+
+  // item bytes and lookup of code by item, guarded by lock
+  nebula::common::Arena arena_;
+  nebula::common::unordered_map<std::string_view, int32_t> codes_;
+  mutable std::mutex lock_;
+
+  std::atomic<int32_t> size_;
+};
+
+} // namespace encode
+} // namespace memory
+} // namespace nebula
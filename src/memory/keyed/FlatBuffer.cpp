@@ -16,6 +16,7 @@
 
 #include "FlatBuffer.h"
 
+#include <cstring>
 #include <gflags/gflags.h>
 DEFINE_uint64(FB_MAIN_PAGE, 1024 * 1024, "Main memory page size");
 DEFINE_uint64(FB_DATA_PAGE, 4096 * 1024, "Data memory page size");
@@ -33,10 +34,16 @@ using nebula::type::Kind;
 using nebula::type::ListType;
 using nebula::type::TypeNode;
 
+// strings are deduplicated as long as at least 1 of 4 in the first 1024 lookups repeats, up to 64K distinct strings
+static constexpr size_t DEDUP_SAMPLE = 1024;
+static constexpr size_t DEDUP_RATIO = 4;
+static constexpr size_t DEDUP_ITEMS = 64 * 1024;
+
 void FlatBuffer::initSchema() noexcept {
   // build name to index look up
   nm_.reserve(numColumns_);
   cops_.reserve(numColumns_);
+  columns_.resize(numColumns_);
 
   // initialize keys and values
   for (size_t i = 0; i < numColumns_; ++i) {
@@ -68,7 +75,10 @@ FlatBuffer::FlatBuffer(const nebula::type::Schema& schema,
     chunkSize_{ 0 },
     main_{ std::make_unique<Buffer>(FLAGS_FB_MAIN_PAGE) },
     data_{ std::make_unique<Buffer>(FLAGS_FB_DATA_PAGE) },
-    list_{ std::make_unique<Buffer>(FLAGS_FB_LIST_PAGE) } {
+    list_{ std::make_unique<Buffer>(FLAGS_FB_LIST_PAGE) },
+    probes_{ 0 },
+    hits_{ 0 },
+    dedup_{ true } {
   this->initSchema();
 }
 
@@ -83,7 +93,10 @@ FlatBuffer::FlatBuffer(const nebula::type::Schema& schema,
     numColumns_{ schema->size() },
     fields_{ fields },
     chunk_{ data },
-    chunkSize_{ 0 } {
+    chunkSize_{ 0 },
+    probes_{ 0 },
+    hits_{ 0 },
+    dedup_{ false } {
   // 1. initialize the column align property based on the meta blob
   this->initSchema();
 
@@ -130,13 +143,22 @@ FlatBuffer::FlatBuffer(const nebula::type::Schema& schema,
 
   // populate all rows properties
   rows_.reserve(numRows);
+  for (size_t i = 0; i < numColumns_; ++i) {
+    auto& column = columns_.at(i);
+    column.nulls.reserve(numRows);
+    column.offsets.reserve(numRows);
+    if (isAggregate(i)) {
+      column.sketches.reserve(numRows);
+    }
+  }
 
   // reset back to read each offset value
   offset = offsetOffset;
   for (size_t i = 0; i < numRows; ++i) {
     // read each column props of all rows (should it be lazy?)
     auto rowOffset = readSizeT();
-    rows_.emplace_back(rowOffset, rebuildColumnProps(rowOffset));
+    rows_.push_back(rowOffset);
+    loadColumns(rowOffset);
   }
 }
 
@@ -179,28 +201,6 @@ size_t FlatBuffer::appendNull(bool isNull, nebula::type::Kind kind, Buffer& dest
   return dest.slice.write<int8_t>(offset, byte);
 }
 
-template <typename T>
-size_t FlatBuffer::append(T value, Buffer& dest, size_t align) {
-  size_t len = dest.slice.writeAlign(dest.offset, value, align);
-  dest.offset += len;
-
-  // return current offset
-  return dest.offset;
-}
-
-template <>
-size_t FlatBuffer::append(std::string_view str, Buffer& dest, size_t) {
-  // write variable data into dirty buffer and get offset and length
-  auto len = data_->slice.write(data_->offset, (NByte*)str.data(), str.size());
-
-  // write offset and length in main chunk
-  dest.offset += Range::write(dest.slice, dest.offset, data_->offset, len);
-
-  // move forward data offset for next
-  data_->offset += len;
-  return len;
-}
-
 // TODO(cao) - right now, we're adding list at first level buffer
 // which makes it's impossible to update list type in place.
 // If we want to support updating list, we should move its data to next level (like string).
@@ -246,11 +246,47 @@ size_t FlatBuffer::appendList(Kind itemKind, std::unique_ptr<ListData> list) {
   return offset;
 }
 
+Range FlatBuffer::intern(std::string_view str) {
+  const uint32_t len = str.size();
+  size_t hash = 0;
+  if (dedup_ && len > 0) {
+    hash = nebula::common::Hasher::hashBytes(str.data(), len);
+    ++probes_;
+    auto found = strings_.find(hash);
+    if (found != strings_.end()) {
+      // a range of a rolled back row is beyond data offset, and bytes differ on a hash collision
+      const auto& r = found->second;
+      if (r.size == len && r.offset + len <= data_->offset
+          && std::memcmp(data_->slice.ptr() + r.offset, str.data(), len) == 0) {
+        ++hits_;
+        return r;
+      }
+    }
+
+    // strings barely repeat, stop paying for the lookups
+    if (probes_ == DEDUP_SAMPLE && hits_ * DEDUP_RATIO < probes_) {
+      dedup_ = false;
+      strings_ = {};
+    }
+  }
+
+  Range r{ static_cast<uint32_t>(data_->offset), len };
+  data_->offset += data_->slice.write(data_->offset, (NByte*)str.data(), len);
+  if (dedup_ && len > 0 && strings_.size() < DEDUP_ITEMS) {
+    strings_.insert_or_assign(hash, r);
+  }
+
+  return r;
+}
+
 bool FlatBuffer::rollback() {
   // has last row to roll back
   if (rows_.size() > 0) {
     // remove last row
     rows_.pop_back();
+    for (auto& column : columns_) {
+      column.pop();
+    }
 
     // every buffer reset offset
     main_->offset = std::get<0>(last_);
@@ -333,45 +369,53 @@ Sketcher FlatBuffer::genSketcher(size_t i) noexcept {
 
 // add a row into current batch
 // if cols is not empty, we only populate those fileds, otherwise, populate all
-size_t FlatBuffer::add(const nebula::surface::RowData& row) {
-  // current row offset
-  const auto rowOffset = main_->offset;
-  // begining position for this row
-  // [nulls] = number of columns (byte per column)
-  auto nullsbeginning = rowOffset;
+bool FlatBuffer::adoptable(const FlatBuffer& other) const noexcept {
+  if (other.numColumns_ != numColumns_) {
+    return false;
+  }
 
-  // record current state before adding a new row - used for rollback
-  last_ = std::make_tuple(rowOffset, data_->offset, list_->offset);
+  // strings and lists refer to bytes in data and list buffer of their own
+  for (size_t i = 0; i < numColumns_; ++i) {
+    const auto& cop = cops_.at(i);
+    const auto& another = other.cops_.at(i);
+    if (cop.kind >= Kind::VARCHAR
+        || cop.kind != another.kind
+        || cop.width != another.width
+        || cop.isAggregate() != another.isAggregate()) {
+      return false;
+    }
+  }
 
-  // in the main memory, we're push all nulls for first X bytes (x = numColumns)
-  // This is designed for nulls fast load of memory locality
-  // this is why we have two loops
-  FlatColumnProps columnProps;
-  columnProps.reserve(numColumns_);
+  return true;
+}
 
-  // skip null section moving main offset for data
-  main_->offset += numColumns_;
+size_t FlatBuffer::adopt(FlatBuffer& other, size_t row) {
+  const auto rowOffset = main_->offset;
+  last_ = std::make_tuple(rowOffset, data_->offset, list_->offset);
 
-  // write data of each column through its parser
+  // values keep their offsets in the row, a row ends at the end of its last value
+  size_t length = numColumns_;
   for (size_t i = 0; i < numColumns_; ++i) {
-    // get null value of this column
-    auto nv = row.isNull(i);
-    // backfill the null value
-    appendNull(nv, cops_.at(i).kind, *main_, nullsbeginning++);
     const auto& cop = cops_.at(i);
-    auto ia = cop.isAggregate();
-    auto sketch = ia ? row.getAggregator(i) : nullptr;
-    columnProps.emplace_back(nv, main_->offset - rowOffset, sketch);
-    if (!nv) {
-      cop.parser(row);
-    } else if (ia) {
-      // reserve space for aligned column
-      main_->offset += main_->slice.writeAlign(main_->offset, 0, cop.width);
+    auto& from = other.columns_[i];
+    const auto nv = from.nulls[row];
+    const auto offset = from.offsets[row];
+
+    // null values take no space except reserved aggregate ones
+    if (!nv || cop.isAggregate()) {
+      length = std::max<size_t>(length, offset + cop.width);
+    }
+
+    auto& column = columns_[i];
+    column.nulls.push_back(nv);
+    column.offsets.push_back(offset);
+    if (cop.isAggregate()) {
+      column.sketches.push_back(std::move(from.sketches[row]));
     }
   }
 
-  // after processing all columns, we got the row offset and length, record it here
-  rows_.emplace_back(rowOffset, std::move(columnProps));
+  main_->offset += main_->slice.write(rowOffset, other.main_->slice.ptr() + other.rows_[row], length);
+  rows_.push_back(rowOffset);
 
   return rowOffset;
 }
@@ -386,15 +430,13 @@ size_t FlatBuffer::resume(const nebula::surface::RowData& row,
 
   auto origin = main_->offset;
   // get row properties for this existing row
-  auto& rowProps = rows_.at(rowId);
-  auto& colPropsList = rows_.at(rowId).colProps;
-  auto rowOffset = rowProps.offset;
+  auto rowOffset = rows_.at(rowId);
   for (size_t i : cols) {
     // if the column is null, we keep what it is
     // otherwise we fill the value and update its column props
-    auto& colProps = colPropsList.at(i);
-    colProps.offset = main_->offset - rowOffset;
-    if (!colProps.isNull) {
+    auto& column = columns_.at(i);
+    column.offsets[rowId] = main_->offset - rowOffset;
+    if (!column.nulls[rowId]) {
       cops_.at(i).parser(row);
     }
   }
@@ -403,75 +445,113 @@ size_t FlatBuffer::resume(const nebula::surface::RowData& row,
   return main_->offset - origin;
 }
 
+void FlatColumn::keep(const std::vector<size_t>& rows) {
+  std::vector<bool> n;
+  std::vector<uint32_t> o;
+  n.reserve(rows.size());
+  o.reserve(rows.size());
+  for (auto row : rows) {
+    n.push_back(nulls[row]);
+    o.push_back(offsets[row]);
+  }
+
+  nulls = std::move(n);
+  offsets = std::move(o);
+  if (!sketches.empty()) {
+    std::vector<std::shared_ptr<nebula::surface::eval::Sketch>> s;
+    s.reserve(rows.size());
+    for (auto row : rows) {
+      s.push_back(std::move(sketches[row]));
+    }
+
+    sketches = std::move(s);
+  }
+}
+
+void FlatBuffer::keep(const std::vector<size_t>& rows) {
+  std::vector<size_t> offsets;
+  offsets.reserve(rows.size());
+  for (auto row : rows) {
+    N_ENSURE_LT(row, rows_.size(), "row out of range");
+    offsets.push_back(rows_[row]);
+  }
+
+  rows_ = std::move(offsets);
+  for (auto& column : columns_) {
+    column.keep(rows);
+  }
+
+  current_ = nullptr;
+}
+
 // random access to a row - may require internal seek
 const std::unique_ptr<RowData> FlatBuffer::crow(size_t rowId) const {
-  // pass in row offset and column props of this row
-  return std::make_unique<RowAccessor>(*this, rows_.at(rowId));
+  N_ENSURE_LT(rowId, rows_.size(), "row out of range");
+  return std::make_unique<RowAccessor>(*this, rowId);
 }
 
 const RowData& FlatBuffer::row(size_t rowId) {
-  // pass in row offset and column props of this row
-  current_ = std::make_unique<RowAccessor>(*this, rows_.at(rowId));
+  N_ENSURE_LT(rowId, rows_.size(), "row out of range");
+  current_ = std::make_unique<RowAccessor>(*this, rowId);
   return *current_;
 }
 
-FlatColumnProps FlatBuffer::rebuildColumnProps(size_t rowOffset) {
-  // do not use constructor with count instances of T
-  FlatColumnProps colProps;
-  colProps.reserve(numColumns_);
-
+void FlatBuffer::loadColumns(size_t rowOffset) {
   // first numCols bytes store nulls for all columns
-  auto colOffset = numColumns_;
+  uint32_t colOffset = numColumns_;
   for (size_t i = 0; i < numColumns_; ++i) {
     auto nullByte = main_->slice.read<int8_t>(rowOffset + i);
     bool nv = (nullByte & HIGH6_1) != 0;
     const auto& cop = cops_.at(i);
 
-    // build column properties without sketch
-    auto& cp = colProps.emplace_back(nv, colOffset);
+    // column properties without sketch
+    auto& column = columns_[i];
+    column.nulls.push_back(nv);
+    column.offsets.push_back(colOffset);
+    const auto offset = rowOffset + colOffset;
     if (!nv) {
       colOffset += cop.width;
     }
 
     // for aggregated fields, rebuild its sketch from the serialized binary
     if (cop.isAggregate()) {
-      cp.sketch = cop.sketcher();
-      N_ENSURE_NOT_NULL(cp.sketch, "aggregated field should have sketch");
+      auto sketch = cop.sketcher();
+      N_ENSURE_NOT_NULL(sketch, "aggregated field should have sketch");
       // load data of the sketch from main buffer since it's fit
-      auto offset = rowOffset + cp.offset;
-      if (cp.sketch->fit(cop.width)) {
-        auto size = cp.sketch->load(main_->slice, offset);
+      if (sketch->fit(cop.width)) {
+        auto size = sketch->load(main_->slice, offset);
         N_ENSURE(size <= cop.width, "sketch guranteed data size smaller than alignment");
       } else {
         auto r = Range::make(main_->slice, offset);
-        auto size = cp.sketch->load(data_->slice, r.offset);
+        auto size = sketch->load(data_->slice, r.offset);
         N_ENSURE(size == r.size, "loaded size should be the same as it stored");
       }
+
+      column.sketches.push_back(std::move(sketch));
     }
   }
-
-  return colProps;
 }
 
 // serialize sketches into data section and mark its offset/length at field
 // if the sketch serialized data is fixed within aignment, we can use it directly
 size_t FlatBuffer::serializeSketches() const {
   // data size incremented for sketch serialization
+  // column by column, only aggregate columns have sketches
   size_t size = 0;
-  for (auto& cp : rows_) {
-    for (size_t i = 0; i < numColumns_; ++i) {
-      // for (auto& p : cp.colProps) {
-      auto& p = cp.colProps.at(i);
+  for (size_t i = 0; i < numColumns_; ++i) {
+    const auto& sketches = columns_[i].sketches;
+    const auto& cop = cops_.at(i);
+    for (size_t row = 0, rows = sketches.size(); row < rows; ++row) {
+      const auto& sketch = sketches[row];
       // if we have sketch to serialize out
-      if (p.sketch) {
-        auto offset = (cp.offset + p.offset);
-        const auto& cop = cops_.at(i);
+      if (sketch) {
+        auto offset = this->offset(row, i);
         // if fit within main
-        if (p.sketch->fit(cop.width)) {
-          N_ENSURE(p.sketch->serialize(main_->slice, offset) <= cop.width,
+        if (sketch->fit(cop.width)) {
+          N_ENSURE(sketch->serialize(main_->slice, offset) <= cop.width,
                    "serialzied size should not out of space");
         } else {
-          auto len = p.sketch->serialize(data_->slice, data_->offset);
+          auto len = sketch->serialize(data_->slice, data_->offset);
           // record the data offset and length for this binary in main
           Range::write(main_->slice, offset, data_->offset, len);
           // grow data size
@@ -505,7 +585,7 @@ size_t FlatBuffer::serialize(NByte* buffer) const {
 
   // write all rows' offset
   for (size_t i = 0; i < numRows; ++i) {
-    writeSizeT(rows_.at(i).offset);
+    writeSizeT(rows_.at(i));
   }
 
   // write main block size
@@ -534,17 +614,17 @@ size_t FlatBuffer::serialize(NByte* buffer) const {
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-RowAccessor::RowAccessor(const FlatBuffer& fb, const RowProps& rowProps)
-  : fb_{ fb }, rowProps_{ rowProps } {}
+RowAccessor::RowAccessor(const FlatBuffer& fb, size_t row)
+  : fb_{ fb }, row_{ row } {}
 
 bool RowAccessor::isNull(IndexType index) const {
   // null position for given field
-  return rowProps_.colProps.at(index).isNull;
+  return fb_.isNull(row_, index);
 }
 
-#define READ_FIELD(TYPE, FUNC)                                                               \
-  TYPE RowAccessor::FUNC(IndexType index) const {                                            \
-    return fb_.main_->slice.read<TYPE>(rowProps_.offset + rowProps_.colProps[index].offset); \
+#define READ_FIELD(TYPE, FUNC)                                   \
+  TYPE RowAccessor::FUNC(IndexType index) const {                \
+    return fb_.main_->slice.read<TYPE>(fb_.offset(row_, index)); \
   }
 
 READ_FIELD(bool, readBool)
@@ -559,16 +639,13 @@ READ_FIELD(int128_t, readInt128)
 #undef READ_FIELD
 
 std::string_view RowAccessor::readString(IndexType index) const {
-  auto colOffset = rowProps_.colProps[index].offset;
-  return fb_.read(rowProps_.offset, colOffset);
+  return fb_.read(fb_.offset(row_, index));
 }
 
 // compound types
 std::unique_ptr<nebula::surface::ListData> RowAccessor::readList(IndexType index) const {
-  auto colOffset = rowProps_.colProps[index].offset;
   // read 4 bytes offset and 4 bytes length
-  auto lo = rowProps_.offset + colOffset;
-  auto r = Range::make(fb_.main_->slice, lo);
+  auto r = Range::make(fb_.main_->slice, fb_.offset(row_, index));
 
   // can we cache this query or cache listAccessor?
   auto listType = std::dynamic_pointer_cast<nebula::type::ListType>(fb_.schema_->childType(index));
@@ -586,7 +663,7 @@ std::unique_ptr<nebula::surface::MapData> RowAccessor::readMap(const std::string
 }
 
 inline std::shared_ptr<nebula::surface::eval::Sketch> RowAccessor::getAggregator(IndexType index) const {
-  return rowProps_.colProps[index].sketch;
+  return fb_.sketch(row_, index);
 }
 
 #define FORWARD_NAME_2_INDEX(TYPE, FUNC)                   \
@@ -40,6 +40,13 @@
  * So In main_, we know exactly size of each type if it has non-null value
  * map type: not support for now 
  * struct type: not support for now
+ *
+ * Properties of every value (null, offset in its row and aggregator object) are kept column at a time
+ * in one FlatColumn per column, so a row costs a few bytes per column rather than a vector of its own.
+ *
+ * Strings are deduplicated in data_: a string written already is referenced by its range rather than copied again,
+ * so a low-cardinality string column costs its distinct values only in memory and on the wire.
+ * Dedup turns itself off for the buffer if strings barely repeat in a sample of them.
  */
 namespace nebula {
 namespace memory {
@@ -65,33 +72,32 @@ struct Buffer {
   nebula::common::ExtendableSlice slice;
 };
 
-struct ColumnProps {
-  explicit ColumnProps(bool nv, uint32_t os)
-    : ColumnProps(nv, os, nullptr) {}
-  explicit ColumnProps(bool nv, uint32_t os, std::shared_ptr<nebula::surface::eval::Sketch> s)
-    : isNull{ nv }, offset{ os }, sketch{ s } {}
+// properties of one column in all rows, indexed by row id
+struct FlatColumn {
+  // whether the value of a row is null
+  std::vector<bool> nulls;
 
-  // whether it is a null value
-  bool isNull;
+  // relative offset of the value in its row in main buffer
+  std::vector<uint32_t> offsets;
 
-  // its relative offset in current row in main buffer
-  uint32_t offset;
-
-  // if current field has aggregator object
-  std::shared_ptr<nebula::surface::eval::Sketch> sketch;
-};
+  // aggregator object of every row, only for aggregate column
+  std::vector<std::shared_ptr<nebula::surface::eval::Sketch>> sketches;
 
-// define column properties of given row: nullable, kind, column offset in main.
-using FlatColumnProps = std::vector<ColumnProps>;
+  inline void pop() {
+    nulls.pop_back();
+    offsets.pop_back();
+    if (!sketches.empty()) {
+      sketches.pop_back();
+    }
+  }
 
-struct RowProps {
-  explicit RowProps(size_t of, FlatColumnProps cp)
-    : offset{ of }, colProps{ std::move(cp) } {}
-  // row offset in buffer
-  size_t offset;
+  // keep properties of given rows only in given order
+  void keep(const std::vector<size_t>& rows);
 
-  // column properties
-  FlatColumnProps colProps;
+  inline size_t allocation() const noexcept {
+    return nulls.capacity() / 8 + offsets.capacity() * sizeof(uint32_t)
+           + sketches.capacity() * sizeof(std::shared_ptr<nebula::surface::eval::Sketch>);
+  }
 };
 
 // column parser to read data in from a row
@@ -138,12 +144,17 @@ public:
     }
   }
 
-  // add a row into current batch
-  size_t add(const nebula::surface::RowData&);
+  // add a row into current batch, values of a final row type are read by static calls
+  template <typename R>
+  size_t add(const R&);
 
   // this method only rollback last added row and the only one row only.
   bool rollback();
 
+  // keep only given rows in given order, rows are indexed by their offsets so no data is moved.
+  // bytes of dropped rows stay in the buffer and are serialized too, and it can't be added or looked up any more.
+  virtual void keep(const std::vector<size_t>&);
+
   // instead of rollback, we continue the same row to fill data with remainings
   size_t resume(const nebula::surface::RowData&, const nebula::common::unordered_set<size_t>&, const size_t);
 
@@ -170,23 +181,55 @@ public:
 
   size_t serialize(NByte*) const;
 
+  // bytes of rows added so far, which is about their serialized size except sketches not serialized yet
+  inline size_t bytes() const noexcept {
+    return rows_.size() * SIZET_SIZE + main_->offset + data_->offset + list_->offset;
+  }
+
   const nebula::type::Schema& schema() const {
     return schema_;
   }
 
+  inline const nebula::surface::eval::Fields& fields() const {
+    return fields_;
+  }
+
   inline const void* chunk() const {
     return chunk_;
   }
 
+  // bytes of memory held by this flat buffer
+  virtual size_t allocation() const noexcept {
+    auto bytes = chunk_ ? chunkSize_ : main_->slice.size() + data_->slice.size() + list_->slice.size();
+    bytes += rows_.capacity() * sizeof(size_t);
+    bytes += strings_.size() * (sizeof(size_t) + sizeof(nebula::common::PRange));
+    for (const auto& c : columns_) {
+      bytes += c.allocation();
+    }
+
+    return bytes;
+  }
+
 private:
   size_t appendNull(bool, nebula::type::Kind, Buffer&, size_t offset);
 
   template <typename T>
   size_t append(T, Buffer&, size_t = 0);
 
+  // write a non-null value of a column read from given row, lists go through the column parser
+  template <typename R>
+  void parse(const R&, size_t);
+
+  // evaluate a column of an evaluated row once, write its value if valid and return its validity
+  template <typename R>
+  bool evaluate(const R&, size_t);
+
   // goes to list_
   size_t appendList(nebula::type::Kind, std::unique_ptr<nebula::surface::ListData>);
 
+  // write a string into data buffer unless the same string is there already, return its range
+  nebula::common::PRange intern(std::string_view);
+
   static size_t widthInMain(nebula::type::Kind) noexcept;
 
   void initSchema() noexcept;
@@ -195,8 +238,8 @@ private:
 
   Sketcher genSketcher(size_t) noexcept;
 
-  // build column properties of given row offset
-  FlatColumnProps rebuildColumnProps(size_t);
+  // load column properties of a serialized row at given row offset
+  void loadColumns(size_t);
 
   // the method is used to write all sketch into the data buffer
   // it is supposed to call once before flat buffer is serialized into wire
@@ -217,6 +260,12 @@ protected:
   std::unique_ptr<Buffer> data_;
   std::unique_ptr<Buffer> list_;
 
+  // range of every distinct string in data_ by its hash, and stats of the lookups to tell if dedup pays off
+  nebula::common::unordered_map<size_t, nebula::common::PRange> strings_;
+  size_t probes_;
+  size_t hits_;
+  bool dedup_;
+
   // name map for name->index mapping
   nebula::common::unordered_map<std::string, size_t> nm_;
 
@@ -226,8 +275,11 @@ protected:
   // offset of last row used for supporting roll back
   std::tuple<size_t, size_t, size_t> last_;
 
-  // record each row's offset and length
-  std::vector<RowProps> rows_;
+  // offset of each row in main buffer
+  std::vector<size_t> rows_;
+
+  // properties of each column in all rows
+  std::vector<FlatColumn> columns_;
 
   // A row accessor cursor to read data of given row
   friend class RowAccessor;
@@ -238,10 +290,35 @@ protected:
     return cops_.at(col).isAggregate();
   }
 
-  // read a string from given row offset and col offset
-  inline std::string_view read(size_t rowOffset, size_t colOffset) const noexcept {
-    auto so = rowOffset + colOffset;
-    auto r = nebula::common::PRange::make(main_->slice, so);
+  inline bool isNull(size_t row, size_t col) const noexcept {
+    return columns_[col].nulls[row];
+  }
+
+  // offset of a value in main buffer
+  inline size_t offset(size_t row, size_t col) const noexcept {
+    return rows_[row] + columns_[col].offsets[row];
+  }
+
+  // aggregator object of a value, only valid for aggregate column
+  inline std::shared_ptr<nebula::surface::eval::Sketch>& sketch(size_t row, size_t col) noexcept {
+    return columns_[col].sketches[row];
+  }
+
+  inline std::shared_ptr<nebula::surface::eval::Sketch> sketch(size_t row, size_t col) const noexcept {
+    const auto& sketches = columns_[col].sketches;
+    return sketches.empty() ? nullptr : sketches[row];
+  }
+
+  // another buffer has the same layout in fixed width columns only, so its rows can be adopted by bytes
+  bool adoptable(const FlatBuffer&) const noexcept;
+
+  // append a row of an adoptable buffer by copying its bytes, its sketches are moved over.
+  // same as add, the adopted row can be rolled back.
+  size_t adopt(FlatBuffer&, size_t);
+
+  // read a string whose range is at given offset in main buffer
+  inline std::string_view read(size_t offset) const noexcept {
+    auto r = nebula::common::PRange::make(main_->slice, offset);
 
     // read the real data from data_
     return data_->slice.read(r.offset, r.size);
@@ -250,7 +327,7 @@ protected:
 
 class RowAccessor : public nebula::surface::RowData {
 public:
-  RowAccessor(const FlatBuffer&, const RowProps&);
+  RowAccessor(const FlatBuffer&, size_t);
   virtual ~RowAccessor() = default;
 
 public:
@@ -291,8 +368,8 @@ public:
 private:
   const FlatBuffer& fb_;
 
-  // current row offset and all column properties
-  const RowProps& rowProps_;
+  // current row id
+  const size_t row_;
 };
 
 using nebula::surface::IndexType;
@@ -345,6 +422,139 @@ private:
   std::vector<size_t> itemOffsets_;
 };
 
+template <typename T>
+size_t FlatBuffer::append(T value, Buffer& dest, size_t align) {
+  size_t len = dest.slice.writeAlign(dest.offset, value, align);
+  dest.offset += len;
+
+  // return current offset
+  return dest.offset;
+}
+
+template <>
+inline size_t FlatBuffer::append(std::string_view str, Buffer& dest, size_t) {
+  // write variable data into dirty buffer (or find it there) and get offset and length
+  const auto r = intern(str);
+
+  // write offset and length in main chunk
+  dest.offset += r.write(dest.slice, dest.offset);
+  return r.size;
+}
+
+template <typename R>
+void FlatBuffer::parse(const R& row, size_t i) {
+#define PARSE_KIND(KIND)                                                                 \
+  case nebula::type::Kind::KIND: {                                                       \
+    append(nebula::surface::read<nebula::type::Kind::KIND>(row, i), *main_, cop.width); \
+    return;                                                                              \
+  }
+
+  const auto& cop = cops_[i];
+  switch (cop.kind) {
+    PARSE_KIND(BOOLEAN)
+    PARSE_KIND(TINYINT)
+    PARSE_KIND(SMALLINT)
+    PARSE_KIND(INTEGER)
+    PARSE_KIND(BIGINT)
+    PARSE_KIND(REAL)
+    PARSE_KIND(DOUBLE)
+    PARSE_KIND(INT128)
+    PARSE_KIND(VARCHAR)
+  default: cop.parser(row);
+  }
+
+#undef PARSE_KIND
+}
+
+template <typename R>
+bool FlatBuffer::evaluate(const R& row, size_t i) {
+#define EVALUATE_KIND(KIND)                                              \
+  case nebula::type::Kind::KIND: {                                       \
+    const auto value = row.template value<nebula::type::Kind::KIND>(i); \
+    if (value) {                                                         \
+      append(*value, *main_, cop.width);                                 \
+    }                                                                    \
+    return value.has_value();                                            \
+  }
+
+  const auto& cop = cops_[i];
+  switch (cop.kind) {
+    EVALUATE_KIND(BOOLEAN)
+    EVALUATE_KIND(TINYINT)
+    EVALUATE_KIND(SMALLINT)
+    EVALUATE_KIND(INTEGER)
+    EVALUATE_KIND(BIGINT)
+    EVALUATE_KIND(REAL)
+    EVALUATE_KIND(DOUBLE)
+    EVALUATE_KIND(INT128)
+    EVALUATE_KIND(VARCHAR)
+  default: {
+    if (row.isNull(i)) {
+      return false;
+    }
+
+    cop.parser(row);
+    return true;
+  }
+  }
+
+#undef EVALUATE_KIND
+}
+
+template <typename R>
+size_t FlatBuffer::add(const R& row) {
+  // current row offset
+  const auto rowOffset = main_->offset;
+  // begining position for this row
+  // [nulls] = number of columns (byte per column)
+  auto nullsbeginning = rowOffset;
+
+  // record current state before adding a new row - used for rollback
+  last_ = std::make_tuple(rowOffset, data_->offset, list_->offset);
+
+  // in the main memory, we're push all nulls for first X bytes (x = numColumns)
+  // This is designed for nulls fast load of memory locality
+  // this is why we have two loops
+  // skip null section moving main offset for data
+  main_->offset += numColumns_;
+
+  // write data of each column
+  for (size_t i = 0; i < numColumns_; ++i) {
+    const auto& cop = cops_[i];
+    auto& column = columns_[i];
+    column.offsets.push_back(main_->offset - rowOffset);
+
+    // get null value of this column, an evaluated row writes the value in the same evaluation
+    bool nv;
+    if constexpr (nebula::surface::Evaluated<R>::value) {
+      nv = !evaluate(row, i);
+    } else {
+      nv = row.isNull(i);
+      if (!nv) {
+        parse(row, i);
+      }
+    }
+
+    // backfill the null value
+    appendNull(nv, cop.kind, *main_, nullsbeginning++);
+    auto ia = cop.isAggregate();
+    column.nulls.push_back(nv);
+    if (ia) {
+      column.sketches.push_back(row.getAggregator(i));
+    }
+
+    if (nv && ia) {
+      // reserve space for aligned column
+      main_->offset += main_->slice.writeAlign(main_->offset, 0, cop.width);
+    }
+  }
+
+  // after processing all columns, we got the row offset and length, record it here
+  rows_.push_back(rowOffset);
+
+  return rowOffset;
+}
+
 } // namespace keyed
 } // namespace memory
 } // namespace nebula
\ No newline at end of file
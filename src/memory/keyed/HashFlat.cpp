@@ -30,23 +30,37 @@ using nebula::type::Kind;
 using nebula::type::TypeTraits;
 
 void HashFlat::init() {
-  ops_.reserve(numColumns_);
+  copiers_.reserve(numColumns_);
   keys_.reserve(numColumns_);
   values_.reserve(numColumns_);
+  layout_.reserve(numColumns_);
 
+  size_t normalized = 0;
   for (size_t i = 0; i < numColumns_; ++i) {
-    // every column may have its own operations
-    ops_.emplace_back(genComparator(i), genHasher(i), genCopier(i));
+    // every value column has its own merge operation
+    copiers_.push_back(genCopier(i));
     if (!isAggregate(i)) {
       keys_.push_back(i);
+
+      // keys are compared by raw bytes: scalars by value bytes, strings by bytes in data slice
+      const auto& cop = cops_.at(i);
+      const auto scalar = cop.kind < Kind::VARCHAR;
+      const auto variable = cop.kind == Kind::VARCHAR;
+      const auto width = (scalar || variable) ? cop.width : 0;
+      if (!scalar && !variable) {
+        LOG(ERROR) << "Hash a non-supported column: " << i;
+      }
+
+      layout_.emplace_back(i, width, variable);
+      normalized += width + 1;
     } else {
       values_.push_back(i);
     }
   }
 
-  // reserve a memory chunk to store hash values
+  // reserve a memory chunk to store normalized key
   if (keys_.size() > 0) {
-    keyHash_ = std::make_unique<OneSlice>(sizeof(size_t) * keys_.size());
+    keyHash_ = std::make_unique<OneSlice>(normalized);
 
     // optimization - if the keys are all primmitive (non-strings), and index are continous
     // we can just hash the memory chunk (row.offset+col-offset, total-size)
@@ -67,138 +81,6 @@ void HashFlat::init() {
   }
 }
 
-Comparator HashFlat::genComparator(size_t i) noexcept {
-  // only need for key
-  if (isAggregate(i)) {
-    return {};
-  }
-
-#define PREPARE_AND_NULLCHECK()                     \
-  const auto& row1Props = rows_[row1];              \
-  const auto& row2Props = rows_[row2];              \
-  auto row1Offset = row1Props.offset;               \
-  auto row2Offset = row2Props.offset;               \
-  const auto& colProps1 = row1Props.colProps.at(i); \
-  const auto& colProps2 = row2Props.colProps.at(i); \
-  if (colProps1.isNull != colProps2.isNull) {       \
-    return -1;                                      \
-  }                                                 \
-  if (colProps1.isNull) {                           \
-    return 0;                                       \
-  }
-
-#define TYPE_COMPARE(KIND, TYPE)                                                                       \
-  case Kind::KIND: {                                                                                   \
-    return [this, i](size_t row1, size_t row2) -> int {                                                \
-      PREPARE_AND_NULLCHECK()                                                                          \
-      return main_->slice.compare<TYPE>(row1Offset + colProps1.offset, row2Offset + colProps2.offset); \
-    };                                                                                                 \
-  }
-
-  // fetch value
-  Kind k = cops_.at(i).kind;
-  // we only support primitive types for keys
-  switch (k) {
-    TYPE_COMPARE(BOOLEAN, bool)
-    TYPE_COMPARE(TINYINT, int8_t)
-    TYPE_COMPARE(SMALLINT, int16_t)
-    TYPE_COMPARE(INTEGER, int32_t)
-    TYPE_COMPARE(BIGINT, int64_t)
-    TYPE_COMPARE(REAL, int32_t)
-    TYPE_COMPARE(DOUBLE, int64_t)
-    TYPE_COMPARE(INT128, int128_t)
-  case Kind::VARCHAR: {
-    // read the real data from data_
-    // TODO(cao) - we don't need convert strings from bytes for hash
-    // instead, slice should be able to compare two byte range
-    return [this, i](size_t row1, size_t row2) -> int {
-      PREPARE_AND_NULLCHECK()
-
-      // offset and length of each
-      auto r1 = Range::make(main_->slice, row1Offset + colProps1.offset);
-      auto r2 = Range::make(main_->slice, row2Offset + colProps2.offset);
-
-      // length has to be the same
-      if (r1.size != r2.size) {
-        return r1.size - r2.size;
-      }
-
-      return data_->slice.compare(r1.offset, r2.offset, r1.size);
-    };
-  }
-  default:
-    return [i](size_t, size_t) -> int {
-      LOG(ERROR) << "Compare a non-supported column: " << i;
-      return 0;
-    };
-  }
-
-#undef PREPARE_AND_NULLCHECK
-#undef TYPE_COMPARE
-}
-
-Hasher HashFlat::genHasher(size_t i) noexcept {
-  // only need for key
-  if (isAggregate(i)) {
-    return {};
-  }
-
-#define PREPARE_AND_NULL()                        \
-  const auto& rowProps = rows_.at(row);           \
-  auto rowOffset = rowProps.offset;               \
-  const auto& colProps = rowProps.colProps.at(i); \
-  if (colProps.isNull) {                          \
-    return 0L;                                    \
-  }
-
-#define TYPE_HASH(KIND, TYPE)                                      \
-  case Kind::KIND: {                                               \
-    return [this, i](size_t row) -> size_t {                       \
-      PREPARE_AND_NULL()                                           \
-      return main_->slice.hash<TYPE>(rowOffset + colProps.offset); \
-    };                                                             \
-  }
-
-  // fetch value
-  Kind k = cops_.at(i).kind;
-  switch (k) {
-    TYPE_HASH(BOOLEAN, bool)
-    TYPE_HASH(TINYINT, int8_t)
-    TYPE_HASH(SMALLINT, int16_t)
-    TYPE_HASH(INTEGER, int32_t)
-    TYPE_HASH(BIGINT, int64_t)
-    TYPE_HASH(REAL, int32_t)
-    TYPE_HASH(DOUBLE, int64_t)
-    TYPE_HASH(INT128, int128_t)
-  case Kind::VARCHAR: {
-    // read 4 bytes offset and 4 bytes length
-    return [this, i](size_t row) -> size_t {
-      PREPARE_AND_NULL()
-
-      auto so = rowOffset + colProps.offset;
-      auto r = Range::make(main_->slice, so);
-
-      // read the real data from data_
-      // TODO(cao) - we don't need convert strings from bytes for hash
-      // instead, slice should be able to hash the range[offset, len] much cheaper
-      if (r.size == 0) {
-        return 0L;
-      }
-
-      return data_->slice.hash(r.offset, r.size);
-    };
-  }
-  default:
-    return [i](size_t) -> size_t {
-      LOG(ERROR) << "Hash a non-supported column: " << i;
-      return 0;
-    };
-  }
-
-#undef PREPARE_AND_NULL
-#undef TYPE_HASH
-}
-
 // TODO(cao): I spent a couple of days trying to nail down which GCC optimization
 // causing the SIGSEGV on the returned function from this method
 // CMakeList.txt has more details in the problem.
@@ -227,16 +109,13 @@ Copier HashFlat::genCopier(size_t i) noexcept {
 }
 
 std::pair<size_t, size_t> HashFlat::optimalKeys(size_t row) const noexcept {
-  const auto& rowProps = rows_.at(row);
-
   // starting offset of all sequential keys = row offset + first key offset
-  auto offset = rowProps.offset + rowProps.colProps.at(0).offset;
+  auto offset = this->offset(row, 0);
   auto length = keyWidth_;
 
   // remove nulls
   for (auto index : keys_) {
-    const auto& colProps = rowProps.colProps.at(index);
-    if (colProps.isNull) {
+    if (isNull(row, index)) {
       length -= cops_.at(index).width;
     }
   }
@@ -252,20 +131,32 @@ size_t HashFlat::hash(size_t rowId) const {
     auto kp = optimalKeys(rowId);
     auto ptr = main_->slice.ptr();
     // just hash the key set
-    return nebula::common::Hasher::hash64(ptr + kp.first, kp.second);
+    return nebula::common::Hasher::hashBytes(ptr + kp.first, kp.second);
   }
 
-  // hash on every column and write value into keyHash_ chunk
+  // pack all keys into the normalized key and hash it once
   if (N_LIKELY(keyHash_ != nullptr)) {
-    size_t* ptr = (size_t*)keyHash_->ptr();
-    auto len = keyHash_->size();
-    std::memset(ptr, 0, len);
+    auto key = keyHash_->ptr();
+    const auto main = main_->slice.ptr();
+    size_t pos = 0;
+    for (const auto& kc : layout_) {
+      const auto nv = isNull(rowId, kc.column);
+      key[pos++] = nv;
+      if (nv) {
+        std::memset(key + pos, 0, kc.width);
+      } else if (kc.variable) {
+        // strings are represented by hash of its bytes
+        auto r = Range::make(main_->slice, offset(rowId, kc.column));
+        size_t h = r.size == 0 ? 0 : nebula::common::Hasher::hashBytes(data_->slice.ptr() + r.offset, r.size);
+        std::memcpy(key + pos, &h, sizeof(size_t));
+      } else {
+        std::memcpy(key + pos, main + offset(rowId, kc.column), kc.width);
+      }
 
-    for (size_t i = 0, size = keys_.size(); i < size; ++i) {
-      *(ptr + i) = ops_.at(keys_.at(i)).hasher(rowId);
+      pos += kc.width;
     }
 
-    return nebula::common::Hasher::hash64(ptr, len);
+    return nebula::common::Hasher::hashBytes(key, pos);
   }
 
   return 0;
@@ -286,8 +177,37 @@ bool HashFlat::equal(size_t row1, size_t row2) const {
     return std::memcmp(ptr + kp1.first, ptr + kp2.first, kp1.second) == 0;
   }
 
-  for (auto index : keys_) {
-    if (ops_.at(index).comparator(row1, row2) != 0) {
+  const auto main = main_->slice.ptr();
+  for (const auto& kc : layout_) {
+    const auto nv = isNull(row1, kc.column);
+    if (nv != isNull(row2, kc.column)) {
+      return false;
+    }
+
+    if (nv) {
+      continue;
+    }
+
+    const auto offset1 = offset(row1, kc.column);
+    const auto offset2 = offset(row2, kc.column);
+    if (kc.variable) {
+      auto r1 = Range::make(main_->slice, offset1);
+      auto r2 = Range::make(main_->slice, offset2);
+
+      // length has to be the same
+      if (r1.size != r2.size) {
+        return false;
+      }
+
+      auto data = data_->slice.ptr();
+      if (std::memcmp(data + r1.offset, data + r2.offset, r1.size) != 0) {
+        return false;
+      }
+
+      continue;
+    }
+
+    if (std::memcmp(main + offset1, main + offset2, kc.width) != 0) {
       return false;
     }
   }
@@ -295,21 +215,15 @@ bool HashFlat::equal(size_t row1, size_t row2) const {
   return true;
 }
 
-bool HashFlat::update(const nebula::surface::RowData& row) {
-  // add a new row to the buffer may be expensive
-  // if there are object values to be created such as customized aggregation
-  // to have consistent way - we're taking this approach
-  this->add(row);
-
+bool HashFlat::resolve(size_t hValue) {
   auto newRow = getRows() - 1;
-  auto hValue = hash(newRow);
   Key key{ *this, newRow, hValue };
   auto itr = rowKeys_.find(key);
   if (itr != rowKeys_.end()) {
     // copy the new row data into target for non-keys
     auto oldRow = std::get<1>(*itr);
     for (size_t i : values_) {
-      ops_.at(i).copier(newRow, oldRow);
+      copiers_.at(i)(newRow, oldRow);
     }
 
     // rollback the new added row
@@ -320,19 +234,47 @@ bool HashFlat::update(const nebula::surface::RowData& row) {
 
   // resume all values population and add a new row key
   rowKeys_.insert(key);
+  hashes_.push_back(hValue);
+  seed(newRow);
+  return false;
+}
 
+void HashFlat::seed(size_t newRow) {
   // since this is a new row, create aggregator for all its value fields
-  auto& rowProps = rows_.at(newRow);
   for (size_t i : values_) {
-    auto& sketch = rowProps.colProps.at(i).sketch;
+    auto& sketch = this->sketch(newRow, i);
     if (sketch == nullptr) {
       sketch = cops_.at(i).sketcher();
       // since this is the first time sketch created, merge its own value
-      ops_.at(i).copier(newRow, newRow);
+      copiers_.at(i)(newRow, newRow);
     }
   }
+}
 
-  return false;
+void HashFlat::merge(std::unique_ptr<FlatBuffer> other) {
+  const auto rows = other->getRows();
+  if (!optimal_ || !adoptable(*other)) {
+    for (size_t i = 0; i < rows; ++i) {
+      update(other->row(i));
+    }
+
+    return;
+  }
+
+  // key hashes of another hash flat are reused as both are in the same layout,
+  // otherwise the adopted row is hashed by its sequential key bytes
+  auto hf = dynamic_cast<const HashFlat*>(other.get());
+  const auto hashed = hf && hf->hashes_.size() == rows;
+  for (size_t i = 0; i < rows; ++i) {
+    adopt(*other, i);
+    resolve(hashed ? hf->hashes_[i] : hash(getRows() - 1));
+  }
+}
+
+void HashFlat::keep(const std::vector<size_t>& rows) {
+  FlatBuffer::keep(rows);
+  rowKeys_.clear();
+  hashes_.clear();
 }
 
 } // namespace keyed
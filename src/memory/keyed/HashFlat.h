@@ -30,24 +30,23 @@ namespace keyed {
 * And, hash flat will not allow duplicate keys in the data set.
 */
 
-// column comparator between two rows
-using Comparator = std::function<int32_t(size_t, size_t)>;
-
-// Hasher on one column of given row and base hash value
-using Hasher = std::function<size_t(size_t)>;
-
 // Copier on one column from given row1 to row2 which using external updater
 using Copier = std::function<void(size_t, size_t)>;
 
-struct ColOps {
-  explicit ColOps(Comparator c, Hasher h, Copier o)
-    : comparator{ std::move(c) },
-      hasher{ std::move(h) },
-      copier{ std::move(o) } {}
+// compiled layout of one key column, resolved once by schema so that hash and equal
+// work on raw row bytes directly instead of calling a function per column
+struct KeyColumn {
+  explicit KeyColumn(size_t c, size_t w, bool v)
+    : column{ c }, width{ w }, variable{ v } {}
+
+  // column index in the row
+  size_t column;
 
-  Comparator comparator;
-  Hasher hasher;
-  Copier copier;
+  // width of the key in main slice (0 if not hashable)
+  size_t width;
+
+  // variable length key (string) stored as offset and length to data slice
+  bool variable;
 };
 
 class HashFlat : public FlatBuffer {
@@ -81,7 +80,61 @@ public:
 
   // update a row in hash flat, if same key existings, update the row and return true
   // otherwise we get a new row, return false
-  bool update(const nebula::surface::RowData&);
+  // rows of all methods below are taken by their own types, see FlatBuffer::add
+  template <typename R>
+  inline bool update(const R& row) {
+    // add a new row to the buffer may be expensive
+    // if there are object values to be created such as customized aggregation
+    // to have consistent way - we're taking this approach
+    this->add(row);
+    return resolve(hash(getRows() - 1));
+  }
+
+  // update a row into an existing row whose keys are known to be the same
+  // used by direct aggregation which locates the target row without hashing or comparing keys
+  template <typename R>
+  inline void update(const R& row, size_t target) {
+    // same as the path of existing key in update: add, merge values to target and rollback
+    this->add(row);
+
+    auto newRow = getRows() - 1;
+    for (size_t i : values_) {
+      copiers_[i](newRow, target);
+    }
+
+    rollback();
+  }
+
+  // add a row as a new group without looking up its key, so the flat may hold duplicate keys afterwards.
+  // used when keys are nearly unique, such a flat is only merged into another hash flat reusing its key hashes.
+  template <typename R>
+  inline void append(const R& row) {
+    this->add(row);
+    const auto newRow = getRows() - 1;
+    hashes_.push_back(hash(newRow));
+    seed(newRow);
+  }
+
+  // merge all rows of another flat buffer of the same schema and fields, the buffer is consumed.
+  // when keys are laid out sequentially and all columns are fixed width, a row is adopted by copying its bytes
+  // and its sketches are mixed into a matched row directly, otherwise rows are updated one by one.
+  void merge(std::unique_ptr<FlatBuffer>);
+
+  // kept rows are not indexed any more
+  virtual void keep(const std::vector<size_t>&) override;
+
+  // size the key index for given number of groups upfront, so it doesn't rehash while growing to them
+  inline void reserve(size_t groups) {
+    rowKeys_.reserve(groups);
+    hashes_.reserve(groups);
+  }
+
+  // buffers plus the key index, which is a robin hood table filled up to 60%
+  virtual size_t allocation() const noexcept override {
+    return FlatBuffer::allocation()
+           + rowKeys_.size() * (sizeof(Key) + 1) * 10 / 6
+           + hashes_.capacity() * sizeof(size_t);
+  }
 
   struct Hash {
     inline size_t operator()(const Key& key) const noexcept {
@@ -100,53 +153,53 @@ public:
 
 private:
   void init();
-  Comparator genComparator(size_t) noexcept;
-  Hasher genHasher(size_t) noexcept;
   Copier genCopier(size_t) noexcept;
 
+  // merge the last added row of given key hash into the row of the same key and roll it back if found
+  // and return true, otherwise index it as a new row with its own sketches
+  bool resolve(size_t);
+
+  // create sketches of a new row, seeded by its own values
+  void seed(size_t);
+
   // merge template to merge row1 into row2
   template <nebula::type::Kind O, nebula::type::Kind I>
   inline void merge(size_t row1, size_t row2, size_t i) noexcept {
     using InputType = typename nebula::type::TypeTraits<I>::CppType;
     using TAggregator = nebula::surface::eval::Aggregator<O, I>;
-    const auto& row1Props = rows_.at(row1);
-    const auto& row2Props = rows_.at(row2);
-    const auto& colProps1 = row1Props.colProps.at(i);
-    auto& colProps2 = row2Props.colProps.at(i);
+    const auto& sketch1 = sketch(row1, i);
+    auto& sketch2 = sketch(row2, i);
 
     // mix another sketch if it has
-    if (N_UNLIKELY(row1 != row2 && colProps1.sketch != nullptr)) {
-      colProps2.sketch->mix(*colProps1.sketch);
+    if (N_UNLIKELY(row1 != row2 && sketch1 != nullptr)) {
+      sketch2->mix(*sketch1);
       return;
     }
 
     // merge value into existing sketch skipping null
-    if (N_LIKELY(!colProps1.isNull)) {
-      InputType value = main_->slice.read<InputType>(row1Props.offset + colProps1.offset);
-      auto agg = std::static_pointer_cast<TAggregator>(colProps2.sketch);
-      agg->merge(value);
+    // use raw pointer as the row owns the sketch, avoiding ref count changes per value
+    if (N_LIKELY(!isNull(row1, i))) {
+      InputType value = main_->slice.read<InputType>(offset(row1, i));
+      static_cast<TAggregator*>(sketch2.get())->merge(value);
     }
   }
 
   template <nebula::type::Kind O>
   inline void merge_string(size_t row1, size_t row2, size_t i) noexcept {
     using TAggregator = typename nebula::surface::eval::Aggregator<O, nebula::type::Kind::VARCHAR>;
-    const auto& row1Props = rows_.at(row1);
-    const auto& row2Props = rows_.at(row2);
-    const auto& colProps1 = row1Props.colProps.at(i);
-    auto& colProps2 = row2Props.colProps.at(i);
+    const auto& sketch1 = sketch(row1, i);
+    auto& sketch2 = sketch(row2, i);
 
     // mix two sketches
-    if (N_UNLIKELY(row1 != row2 && colProps1.sketch != nullptr)) {
-      colProps2.sketch->mix(*colProps1.sketch);
+    if (N_UNLIKELY(row1 != row2 && sketch1 != nullptr)) {
+      sketch2->mix(*sketch1);
       return;
     }
 
     // merge individual value skip nulls
-    if (N_LIKELY(!colProps1.isNull)) {
-      std::string_view value = read(row1Props.offset, colProps1.offset);
-      auto agg = std::static_pointer_cast<TAggregator>(colProps2.sketch);
-      agg->merge(value);
+    if (N_LIKELY(!isNull(row1, i))) {
+      std::string_view value = read(offset(row1, i));
+      static_cast<TAggregator*>(sketch2.get())->merge(value);
     }
   }
 
@@ -163,7 +216,7 @@ private:
   std::pair<size_t, size_t> optimalKeys(size_t) const noexcept;
 
 private:
-  // lay all hash values in this fixed slice
+  // normalized key bytes of a row to hash in one go: [null byte][key bytes] per key
   std::unique_ptr<nebula::common::OneSlice> keyHash_;
   // optimal indicates the hash/compare/copy on keys can be optimized
   // since will be laid out sequentially in main slice only
@@ -173,9 +226,15 @@ private:
   size_t keyWidth_;
   std::vector<size_t> keys_;
   std::vector<size_t> values_;
-  // customized operations for each column
 
-  std::vector<ColOps> ops_;
+  // compiled key layout in key order
+  std::vector<KeyColumn> layout_;
+
+  // key hash of every row, it is passed along with the rows merged into another hash flat
+  std::vector<size_t> hashes_;
+
+  // value merge operations for each column (empty for keys)
+  std::vector<Copier> copiers_;
 
   // TODO(cao):
   // build error Undefined symbols for architecture x86_64: "folly::f14::detail::F14LinkCheck
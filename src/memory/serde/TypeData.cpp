@@ -32,18 +32,21 @@ void* void_any(const std::string&) {
 }
 
 // we allocate slice as `unit * batch_size / 16` to control maximum 8 slics for stream
-#define TYPE_DATA_CONSTR(TYPE, CONV)                                         \
-  template <>                                                                \
-  TYPE::TypeDataImpl(const Column& column, size_t batchSize)                 \
-    : slice_{ Unit * batchSize / 4 },                                        \
-      bf_{ nullptr } {                                                       \
-    if (column.withBloomFilter && Scalar) {                                  \
-      bf_ = std::make_unique<nebula::common::BloomFilter<NType>>(batchSize); \
-    }                                                                        \
-                                                                             \
-    if (column.defaultValue.size() > 0) {                                    \
-      default_ = CONV(column.defaultValue);                                  \
-    }                                                                        \
+#define TYPE_DATA_CONSTR(TYPE, CONV)                              \
+  template <>                                                     \
+  TYPE::TypeDataImpl(const Column& column, size_t batchSize)      \
+    : slice_{ Unit * batchSize / 4 },                             \
+      bf_{ nullptr },                                             \
+      bloom_{ column.withBloomFilter && Bloom },                  \
+      sorted_{ column.sorted } {                                  \
+    if constexpr (Heads) {                                        \
+      heads_ = std::make_unique<nebula::common::ExtendableSlice>( \
+        sizeof(nebula::common::StringHead) * batchSize / 4);      \
+    }                                                             \
+                                                                  \
+    if (column.defaultValue.size() > 0) {                         \
+      default_ = CONV(column.defaultValue);                       \
+    }                                                             \
   }
 
 TYPE_DATA_CONSTR(BoolData, folly::to<NType>)
@@ -59,20 +62,23 @@ TYPE_DATA_CONSTR(EmptyData, void_any)
 
 #undef TYPE_DATA_CONSTR
 
-// string void data
+// string void data has an empty head
 template <>
-void StringData::addVoid(IndexType) {
-  size_ += slice_.write(size_, "", 0);
+void StringData::addVoid(IndexType index) {
+  constexpr nebula::common::StringHead empty{};
+  heads_->write(index * sizeof(empty), reinterpret_cast<const char*>(&empty), sizeof(empty));
+  rows_ = index + 1;
 }
 
+// a string not inlined in its head is appended to slice
 template <>
-void StringData::add(IndexType, std::string_view value) {
-  size_ += slice_.write(size_, value.data(), value.size());
-  // TODO(cao) - disable bloom filter string type for now
-  // Due to hash function missing for string_view type
-  // if (N_UNLIKELY(bf_ != nullptr)) {
-  //   bf_->add(value.);
-  // }
+void StringData::add(IndexType index, std::string_view value) {
+  const auto head = nebula::common::StringHead::make(value, size_);
+  heads_->write(index * sizeof(head), reinterpret_cast<const char*>(&head), sizeof(head));
+  rows_ = index + 1;
+  if (!head.inlined()) {
+    size_ += slice_.write(size_, value.data(), value.size());
+  }
 }
 
 #define TYPE_PROBABLY(DT, VT, BE)    \
@@ -92,6 +98,7 @@ TYPE_PROBABLY(LongData, int64_t, LIKELY)
 TYPE_PROBABLY(FloatData, float, UNLIKELY)
 TYPE_PROBABLY(DoubleData, double, UNLIKELY)
 TYPE_PROBABLY(Int128Data, int128_t, UNLIKELY)
+TYPE_PROBABLY(StringData, std::string_view, UNLIKELY)
 
 #undef TYPE_PROBABLY
 
@@ -157,6 +164,7 @@ TYPE_PROBABLY_PROXY(int64_t, ld_)
 TYPE_PROBABLY_PROXY(float, fd_)
 TYPE_PROBABLY_PROXY(double, dd_)
 TYPE_PROBABLY_PROXY(int128_t, i128d_)
+TYPE_PROBABLY_PROXY(std::string_view, std_)
 
 #undef TYPE_PROBABLY_PROXY
 
@@ -192,9 +200,22 @@ TYPE_READ_PROXY(int64_t, ld_)
 TYPE_READ_PROXY(float, fd_)
 TYPE_READ_PROXY(double, dd_)
 TYPE_READ_PROXY(int128_t, i128d_)
+TYPE_READ_PROXY(std::string_view, std_)
 
 #undef TYPE_READ_PROXY
 
+#define TYPE_DECODE_PROXY(TYPE, OBJ)                                           \
+  template <>                                                                  \
+  bool TypeDataProxy::decode(IndexType start, size_t count, TYPE* out) const { \
+    return OBJ->decode(start, count, out);                                     \
+  }
+
+TYPE_DECODE_PROXY(int16_t, sd_)
+TYPE_DECODE_PROXY(int32_t, id_)
+TYPE_DECODE_PROXY(int64_t, ld_)
+
+#undef TYPE_DECODE_PROXY
+
 } // namespace serde
 } // namespace memory
 } // namespace nebula
\ No newline at end of file
@@ -18,10 +18,17 @@
 
 #include <cmath>
 #include <glog/logging.h>
+#include <limits>
+#include <optional>
 
 #include "common/BloomFilter.h"
 #include "common/Likely.h"
 #include "common/Memory.h"
+#include "common/StringHead.h"
+#include "memory/encode/BitPackColumn.h"
+#include "memory/encode/DeltaColumn.h"
+#include "memory/encode/RleColumn.h"
+#include "meta/NBlock.h"
 #include "meta/Table.h"
 #include "type/Type.h"
 
@@ -51,8 +58,52 @@ public:
 
   virtual size_t capacity() const = 0;
 
+  // add bytes of values and their bloom filter to given column memory
+  virtual void memory(nebula::meta::ColumnMemory& memory) const {
+    memory.data += capacity();
+  }
+
+  // raw memory of values, fixed-width values are laid out contiguously
+  // nullptr if values are encoded or compressed
+  virtual const NByte* raw() const = 0;
+
   virtual void seal() = 0;
 
+  // build bloom filter of sealed values if configured
+  virtual void buildBloom(size_t, double) {}
+
+  // drop all values when they are kept somewhere else, such as strings moved into a dictionary
+  virtual void clear() {}
+
+  // encode sealed values if encoded size is within given ratio of raw size, return true if encoded
+  virtual bool encode(double) {
+    return false;
+  }
+
+  // rows [first, last) out of which no value is in range [low, high], nullopt if not known
+  virtual std::optional<std::pair<size_t, size_t>> rows(int64_t, int64_t) const {
+    return std::nullopt;
+  }
+
+  // evaluate low <= value <= high for rows [start, start + count) into mask on bit packed values
+  // return false if values are not bit packed
+  virtual bool match(int64_t, int64_t, size_t, size_t, uint8_t*) const {
+    return false;
+  }
+
+  virtual bool encoded() const {
+    return false;
+  }
+
+  // move sealed raw values into compressed pages of given size if it saves memory, return true if compressed
+  virtual bool compress(size_t) {
+    return false;
+  }
+
+  virtual bool compressed() const {
+    return false;
+  }
+
 protected:
   // data size in slice_
   size_t size_;
@@ -76,6 +127,18 @@ class TypeDataImpl : public TypeData {
   using NType = typename nebula::type::TypeTraits<KIND>::CppType;
   static constexpr auto Scalar = nebula::type::TypeBase::isScalar(KIND);
   static constexpr auto Unit = Scalar ? nebula::type::TypeTraits<KIND>::width : 16;
+  // bloom filter is supported for scalars and strings
+  static constexpr auto Bloom = Scalar || KIND == nebula::type::Kind::VARCHAR;
+  // integers are encoded at seal, deltas for sorted values, otherwise RLE or bit packing
+  static constexpr auto Encodable = KIND == nebula::type::Kind::SMALLINT
+                                    || KIND == nebula::type::Kind::INTEGER
+                                    || KIND == nebula::type::Kind::BIGINT;
+  using EType = std::conditional_t<Encodable, NType, int64_t>;
+  using Rle = nebula::memory::encode::RleColumn<EType>;
+  using Delta = nebula::memory::encode::DeltaColumn<EType>;
+  using BitPack = nebula::memory::encode::BitPackColumn<EType>;
+  // strings are stored as a 16 bytes head per row, only strings not inlined in heads are in slice
+  static constexpr auto Heads = KIND == nebula::type::Kind::VARCHAR;
 
 public:
   TypeDataImpl(const nebula::meta::Column&, size_t);
@@ -84,33 +147,131 @@ public:
 public:
   void add(IndexType, NType value) {
     size_ += slice_.write(size_, value);
-    if (N_UNLIKELY(bf_ != nullptr)) {
-      if (!bf_->add(value)) {
-        bf_ = nullptr;
-        LOG(INFO) << "Failed to add value to bloom filter: " << size()
-                  << ",  type=" << nebula::type::TypeTraits<KIND>::name;
-      }
-    }
   }
 
   void addVoid(IndexType) {
     size_ += slice_.write(size_, (NType)0);
   }
 
+  // build bloom filter of all values in data, sized by given distinct values for the false positive rate.
+  // it happens at seal before values are encoded, so the filter never fills up and ingestion doesn't pay for it.
+  virtual void buildBloom(size_t items, double fpp) override {
+    if (!bloom_) {
+      return;
+    }
+
+    bf_ = std::make_unique<nebula::common::BloomFilter<NType>>(std::max<size_t>(items, 1), fpp);
+    if constexpr (Bloom) {
+      const size_t rows = Heads ? rows_ : size_ / Unit;
+      for (size_t i = 0; i < rows; ++i) {
+        bf_->add(read(i));
+      }
+    }
+  }
+
+  // record a value in built bloom filter, for values not stored in data such as dictionary items
+  inline void bloom(NType value) {
+    if (N_UNLIKELY(bf_ != nullptr)) {
+      bf_->add(value);
+    }
+  }
+
   NType read(IndexType index) const {
-    return slice_.template read<NType>(index * Unit);
+    if constexpr (Heads) {
+      const auto& h = head(index);
+      return h.inlined() ? h.view() : read(h.offset(), h.size);
+    } else {
+      if constexpr (Encodable) {
+        if (delta_) {
+          return delta_->read(index);
+        }
+
+        if (bitpack_) {
+          return bitpack_->read(index);
+        }
+
+        if (rle_) {
+          return rle_->read(index);
+        }
+      }
+
+      if (N_UNLIKELY(paged_ != nullptr)) {
+        return paged_->template read<NType>(index * Unit);
+      }
+
+      return slice_.template read<NType>(index * Unit);
+    }
+  }
+
+  // decode values [start, start + count) in one batch, return false if values are not encoded
+  bool decode(IndexType start, size_t count, NType* out) const {
+    if constexpr (Encodable) {
+      if (delta_) {
+        delta_->read(start, count, out);
+        return true;
+      }
+
+      if (bitpack_) {
+        bitpack_->read(start, count, out);
+        return true;
+      }
+
+      if (rle_) {
+        rle_->read(start, count, out);
+        return true;
+      }
+    }
+
+    return false;
   }
 
-  inline std::string_view read(IndexType offset, IndexType size) {
+  inline std::string_view read(IndexType offset, IndexType size) const {
+    if (N_UNLIKELY(paged_ != nullptr)) {
+      return paged_->read(offset, size);
+    }
+
     return slice_.read(offset, size);
   }
 
+  inline const nebula::common::StringHead& head(IndexType index) const {
+    return reinterpret_cast<const nebula::common::StringHead*>(heads_->ptr())[index];
+  }
+
+  // string heads of all rows, nullptr if values are not stored as heads
+  inline const nebula::common::StringHead* heads() const {
+    return heads_ ? reinterpret_cast<const nebula::common::StringHead*>(heads_->ptr()) : nullptr;
+  }
+
   inline size_t capacity() const override {
-    return slice_.size();
+    if (delta_) {
+      return delta_->capacity();
+    }
+
+    if (bitpack_) {
+      return bitpack_->capacity();
+    }
+
+    if (paged_) {
+      return paged_->size();
+    }
+
+    return (rle_ ? rle_->capacity() : slice_.size()) + (heads_ ? heads_->size() : 0);
   }
 
+  inline const NByte* raw() const override {
+    return encoded() || compressed() ? nullptr : slice_.ptr();
+  }
+
+  // bloom filter is configured, it is built at seal
   inline bool hasBloomFilter() const {
-    return bf_ != nullptr;
+    return bloom_;
+  }
+
+  inline void memory(nebula::meta::ColumnMemory& memory) const override {
+    memory.data += capacity();
+    if (bf_) {
+      memory.bloom += bf_->bytes();
+    }
   }
 
   bool probably(NType) const;
@@ -121,12 +282,149 @@ public:
 
   inline virtual void seal() override {
     slice_.seal(size_);
+    // values of a dictionary encoded column never reach data
+    if (heads_) {
+      if (rows_ > 0) {
+        heads_->seal(rows_ * sizeof(nebula::common::StringHead));
+      } else {
+        heads_ = nullptr;
+      }
+    }
+  }
+
+  inline virtual void clear() override {
+    slice_.release();
+    size_ = 0;
+    heads_ = nullptr;
+    rows_ = 0;
+  }
+
+  inline virtual bool encoded() const override {
+    return delta_ != nullptr || bitpack_ != nullptr || rle_ != nullptr;
+  }
+
+  // keep values encoded and release raw slice if it saves enough memory
+  virtual bool encode(double ratio) override {
+    if constexpr (Encodable) {
+      const auto count = size_ / Unit;
+      if (encoded() || compressed() || count == 0) {
+        return false;
+      }
+
+      const auto reader = [this](size_t index) { return slice_.template read<NType>(index * Unit); };
+      const size_t limit = size_ * ratio;
+      if (sorted_) {
+        auto delta = std::make_unique<Delta>(limit);
+        if (delta->encode(count, reader) && delta->size() <= limit) {
+          delta_ = std::move(delta);
+          size_ = delta_->size();
+          slice_.release();
+          return true;
+        }
+      }
+
+      // runs are kept by RLE only if it is smaller than bit packing which is faster to scan
+      auto rle = std::make_unique<Rle>(limit);
+      rle->encode(count, reader);
+      auto bitpack = std::make_unique<BitPack>(limit);
+      bitpack->encode(count, reader);
+      if (bitpack->size() <= std::min(limit, rle->size())) {
+        bitpack_ = std::move(bitpack);
+        size_ = bitpack_->size();
+        slice_.release();
+        return true;
+      }
+
+      if (rle->size() > limit) {
+        return false;
+      }
+
+      rle_ = std::move(rle);
+      size_ = rle_->size();
+      slice_.release();
+      return true;
+    }
+
+    return false;
+  }
+
+  // encoded values are compact already, other values are compressed page by page,
+  // a value may be laid across pages which is read through the spill buffer of reader's cursor
+  virtual bool compress(size_t page) override {
+    if (encoded() || compressed() || size_ == 0) {
+      return false;
+    }
+
+    auto paged = std::make_unique<nebula::common::PagedSlice>(page);
+    const auto data = slice_.ptr();
+    for (size_t pos = 0; pos < size_; pos += page) {
+      paged->write(pos, data + pos, std::min(page, size_ - pos));
+    }
+
+    paged->seal();
+    if (paged->size() >= size_) {
+      return false;
+    }
+
+    paged_ = std::move(paged);
+    size_ = paged_->size();
+    slice_.release();
+    return true;
+  }
+
+  inline virtual bool compressed() const override {
+    return paged_ != nullptr;
+  }
+
+  // row range of values in [low, high] is searched on delta encoded values
+  virtual std::optional<std::pair<size_t, size_t>> rows(int64_t low, int64_t high) const override {
+    if constexpr (Encodable) {
+      if (delta_) {
+        constexpr int64_t MIN = std::numeric_limits<NType>::min();
+        constexpr int64_t MAX = std::numeric_limits<NType>::max();
+        if (low > MAX || high < MIN) {
+          return std::pair<size_t, size_t>(0, 0);
+        }
+
+        return delta_->rows(std::max(low, MIN), std::min(high, MAX));
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // range predicate is compared with bit packed values without decoding them
+  virtual bool match(int64_t low, int64_t high, size_t start, size_t count, uint8_t* mask) const override {
+    if constexpr (Encodable) {
+      if (bitpack_) {
+        bitpack_->match(low, high, start, count, mask);
+        return true;
+      }
+    }
+
+    return false;
   }
 
 private:
   // memory chunk managed by paged slice
   nebula::common::ExtendableSlice slice_;
   std::unique_ptr<nebula::common::BloomFilter<NType>> bf_;
+  bool bloom_;
+
+  // values are mostly in ascending order
+  bool sorted_;
+
+  // encoded values replacing slice after seal
+  std::unique_ptr<Delta> delta_;
+  std::unique_ptr<BitPack> bitpack_;
+  std::unique_ptr<Rle> rle_;
+
+  // compressed pages replacing slice of cold data
+  std::unique_ptr<nebula::common::PagedSlice> paged_;
+
+  // string heads of rows [0, rows_)
+  std::unique_ptr<nebula::common::ExtendableSlice> heads_;
+  size_t rows_ = 0;
 
   // default value of this data node
   NType default_;
@@ -162,6 +460,14 @@ public:
     return std_->read(offset, size);
   }
 
+  inline const nebula::common::StringHead* heads() const {
+    return std_ ? std_->heads() : nullptr;
+  }
+
+  inline void bloom(std::string_view value) {
+    std_->bloom(value);
+  }
+
   template <typename T>
   bool probably(T) const;
 
@@ -177,6 +483,14 @@ public:
     return data_->capacity();
   }
 
+  inline void memory(nebula::meta::ColumnMemory& memory) const {
+    data_->memory(memory);
+  }
+
+  inline const NByte* raw() const {
+    return data_->raw();
+  }
+
   inline bool hasBloomFilter() const {
     return hasBf_;
   }
@@ -185,6 +499,42 @@ public:
     data_->seal();
   }
 
+  inline void buildBloom(size_t items, double fpp) {
+    data_->buildBloom(items, fpp);
+  }
+
+  inline void clear() {
+    data_->clear();
+  }
+
+  inline bool encode(double ratio) {
+    return data_->encode(ratio);
+  }
+
+  inline bool encoded() const {
+    return data_->encoded();
+  }
+
+  inline bool compress(size_t page) {
+    return data_->compress(page);
+  }
+
+  inline bool compressed() const {
+    return data_->compressed();
+  }
+
+  inline std::optional<std::pair<size_t, size_t>> rows(int64_t low, int64_t high) const {
+    return data_->rows(low, high);
+  }
+
+  inline bool match(int64_t low, int64_t high, size_t start, size_t count, uint8_t* mask) const {
+    return data_->match(low, high, start, count, mask);
+  }
+
+  // batch decode of encoded values, return false if values are not encoded
+  template <typename T>
+  bool decode(IndexType, size_t, T*) const;
+
 private:
   // data_ is owned object while other plain pointers are internal refs
   PTypeData data_;
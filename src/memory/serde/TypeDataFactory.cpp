@@ -58,8 +58,10 @@ std::unique_ptr<TypeDataProxy> TypeDataFactory::createData(
 
 #undef TYPE_DATA_PROXY
 
-std::unique_ptr<TypeMetadata> TypeDataFactory::createMeta(Kind kind, const Column& column) {
-  return std::make_unique<TypeMetadata>(kind, column);
+std::unique_ptr<TypeMetadata> TypeDataFactory::createMeta(Kind kind,
+                                                          const Column& column,
+                                                          std::shared_ptr<nebula::memory::encode::SharedDict> dict) {
+  return std::make_unique<TypeMetadata>(kind, column, std::move(dict));
 }
 
 } // namespace serde
@@ -31,15 +31,25 @@ size_t TypeMetadata::histogram(bool v) {
 }
 
 // define varchar histogram method
+#define STRING_HISTOGRAM_RECORD(T)      \
+  template <>                           \
+  size_t TypeMetadata::histogram(T v) { \
+    sh_->add(v);                        \
+    return histo_->count;               \
+  }
+
+STRING_HISTOGRAM_RECORD(char const*);
+STRING_HISTOGRAM_RECORD(const std::string&);
+STRING_HISTOGRAM_RECORD(std::string_view);
+
+#undef STRING_HISTOGRAM_RECORD
+
 #define DEFAULT_HISTOGRAM_RECORD(T)   \
   template <>                         \
   size_t TypeMetadata::histogram(T) { \
     return ++(histo_->count);         \
   }
 
-DEFAULT_HISTOGRAM_RECORD(char const*);
-DEFAULT_HISTOGRAM_RECORD(const std::string&);
-DEFAULT_HISTOGRAM_RECORD(std::string_view);
 DEFAULT_HISTOGRAM_RECORD(int128_t);
 
 // TODO(cao) - we can not assume the object type is like this
@@ -62,6 +72,7 @@ DEFAULT_HISTOGRAM_RECORD(std::nullptr_t);
     }                                   \
                                         \
     P->v_sum += v;                      \
+    distinct(v);                        \
                                         \
     return ++(histo_->count);           \
   }
@@ -16,12 +16,16 @@
 
 #pragma once
 
+#include <algorithm>
 #include <roaring.hh>
 #include <unordered_map>
+#include <vector>
 
 #include "TypeData.h"
+#include "common/HyperLogLog.h"
 #include "common/Likely.h"
 #include "memory/encode/DictEncoder.h"
+#include "memory/encode/SharedDict.h"
 #include "surface/eval/Histogram.h"
 #include "type/Type.h"
 
@@ -34,14 +38,38 @@ namespace serde {
  * This is a super set that works for any type. 
  * 
  * Eventually this metadata can be serailized into a flat buffer to persistence.
+ *
+ * NULL rows are recorded in a roaring bitmap while building. At seal, a column without NULL skips null checks,
+ * and a column with many NULLs moves them into a dense bitmap, one bit per row, tested without container lookup
+ * and expanded into byte masks of scan kernels.
+ *
+ * A string column is encoded by either its own dictionary or a dictionary shared by the table (see SharedDict),
+ * codes of a shared dictionary used by this column are recorded to tell items new to the column.
  */
 class TypeMetadata {
   static constexpr size_t N_ITEMS = 4096;
   static constexpr auto INDEX_WIDTH = sizeof(IndexType);
+  // 1K registers, the estimate is within a few percent which is enough to tell low cardinality
+  static constexpr uint8_t DISTINCT_WIDTH = 10;
+  // NULLs are kept in a dense bitmap when more than 1/DENSE_RATIO rows are NULL,
+  // where a roaring array container (2 bytes per NULL) is no smaller than 1 bit per row
+  static constexpr size_t DENSE_RATIO = 16;
+
+  // how NULL rows are stored
+  enum class Nulls : uint8_t {
+    // roaring bitmap
+    SPARSE,
+    // no NULL at all, sealed only
+    NONE,
+    // one bit per row, sealed only
+    DENSE
+  };
 
 public:
   static constexpr IndexType INVALID_INDEX = std::numeric_limits<IndexType>::max();
-  TypeMetadata(nebula::type::Kind kind, const nebula::meta::Column& column)
+  TypeMetadata(nebula::type::Kind kind,
+               const nebula::meta::Column& column,
+               std::shared_ptr<nebula::memory::encode::SharedDict> shared = nullptr)
     : partition_{ column.partition.valid() },
       count_{ 0 },
       offsetSize_{
@@ -49,8 +77,16 @@ public:
           nullptr :
           std::make_unique<nebula::common::ExtendableSlice>(N_ITEMS)
       },
-      dict_{ column.withDict ? std::make_unique<nebula::memory::encode::DictEncoder>() : nullptr },
+      // a block gets its own dictionary if the shared one is full
+      dict_{ !shared && (column.withDict || (column.sharedDict && kind == nebula::type::Kind::VARCHAR)) ?
+               std::make_unique<nebula::memory::encode::DictEncoder>() :
+               nullptr },
+      shared_{ std::move(shared) },
+      sharedSize_{ 0 },
       default_{ column.defaultValue.size() > 0 },
+      distinct_{ nullptr },
+      distinctValues_{ 0 },
+      mode_{ Nulls::SPARSE },
       histo_{ nullptr } {
 
     if (offsetSize_ != nullptr) {
@@ -64,6 +100,7 @@ public:
     bh_ = nullptr;
     ih_ = nullptr;
     rh_ = nullptr;
+    sh_ = nullptr;
     switch (kind) {
     case nebula::type::Kind::BOOLEAN: {
       auto temp = std::make_unique<nebula::surface::eval::BoolHistogram>();
@@ -78,6 +115,7 @@ public:
       auto temp = std::make_unique<nebula::surface::eval::IntHistogram>();
       ih_ = temp.get();
       histo_ = std::move(temp);
+      estimateDistinct();
       break;
     }
     case nebula::type::Kind::REAL:
@@ -85,6 +123,18 @@ public:
       auto temp = std::make_unique<nebula::surface::eval::RealHistogram>();
       rh_ = temp.get();
       histo_ = std::move(temp);
+      estimateDistinct();
+      break;
+    }
+    case nebula::type::Kind::VARCHAR: {
+      auto temp = std::make_unique<nebula::surface::eval::StringHistogram>();
+      sh_ = temp.get();
+      histo_ = std::move(temp);
+
+      // distinct values are estimated to decide if the column should be switched to dictionary at seal
+      if (!hasDict()) {
+        estimateDistinct();
+      }
       break;
     }
     default:
@@ -102,15 +152,77 @@ public:
 
   inline bool isNull(size_t index) {
     // column/node with default value will never be null
-    if (default_) {
+    if (default_ || mode_ == Nulls::NONE) {
       return false;
     }
 
-    return nulls_.contains(index);
+    return contains(index);
   }
 
   inline bool isRealNull(size_t index) const {
-    return default_ && nulls_.contains(index);
+    return default_ && mode_ != Nulls::NONE && contains(index);
+  }
+
+  inline bool hasNulls() const {
+    switch (mode_) {
+    case Nulls::NONE: return false;
+    case Nulls::DENSE: return true;
+    default: return !nulls_.isEmpty();
+    }
+  }
+
+  // iterate every null row in range [start, end)
+  template <typename F>
+  inline void nulls(size_t start, size_t end, F&& f) const {
+    if (mode_ == Nulls::DENSE) {
+      end = std::min(end, rows_);
+      for (size_t w = start >> 6, last = (end + 63) >> 6; w < last; ++w) {
+        auto word = dense_[w];
+        while (word) {
+          const size_t row = (w << 6) + __builtin_ctzll(word);
+          if (row >= end) {
+            return;
+          }
+
+          if (row >= start) {
+            f(row);
+          }
+          word &= word - 1;
+        }
+      }
+
+      return;
+    }
+
+    auto it = nulls_.begin();
+    it.equalorlarger(start);
+    for (auto last = nulls_.end(); it != last && *it < end; ++it) {
+      f(*it);
+    }
+  }
+
+  // write 1 into mask for every non-null row in [start, start + count), 0 for NULL rows.
+  // return false if NULLs are not in a dense bitmap, caller collects them by nulls instead
+  inline bool valid(size_t start, size_t count, uint8_t* mask) const {
+    if (mode_ == Nulls::NONE) {
+      std::fill(mask, mask + count, 1);
+      return true;
+    }
+
+    if (mode_ != Nulls::DENSE) {
+      return false;
+    }
+
+    // rows out of the bitmap are not NULL
+    const auto rows = start < rows_ ? std::min(count, rows_ - start) : 0;
+    const auto words = dense_.data();
+    for (size_t i = 0; i < rows; ++i) {
+      const auto row = start + i;
+      mask[i] = ((words[row >> 6] >> (row & 63)) & 1) ^ 1;
+    }
+
+    std::fill(mask + rows, mask + count, 1);
+    return true;
   }
 
   void setOffsetSize(size_t index, IndexType items) {
@@ -136,26 +248,149 @@ public:
     return { offset, length };
   }
 
+  // offsets of rows in one contiguous array, row i spans [offsets[i], offsets[i + 1]) for every i < spans()
+  inline const IndexType* offsets() const {
+    return offsetSize_ ? reinterpret_cast<const IndexType*>(offsetSize_->ptr()) : nullptr;
+  }
+
+  // number of rows having offsets, rows after them are NULL
+  inline size_t spans() const {
+    return offsetSize_ ? count_ - 1 : 0;
+  }
+
   inline bool hasDict() const {
-    return dict_ != nullptr;
+    return dict_ != nullptr || shared_ != nullptr;
   }
 
-  inline int32_t dictItem(std::string_view item) {
-    return dict_->set(item);
+  // dictionary code of given item, added tells if the item is new to this column
+  inline int32_t dictItem(std::string_view item, bool& added) {
+    if (shared_) {
+      const auto code = shared_->set(item);
+      added = used_.addChecked(code);
+      return code;
+    }
+
+    const auto items = dict_->size();
+    const auto code = dict_->set(item);
+    added = dict_->size() > items;
+    return code;
   }
 
   inline std::string_view dictItem(size_t index) {
-    return dict_->get(index);
+    return shared_ ? shared_->get(index) : dict_->get(index);
+  }
+
+  // visit every dictionary item used by this column
+  template <typename F>
+  inline void dictItems(F&& f) const {
+    if (shared_) {
+      for (auto code : used_) {
+        f(shared_->get(code));
+      }
+      return;
+    }
+
+    for (int32_t i = 0, size = dict_->size(); i < size; ++i) {
+      f(dict_->get(i));
+    }
+  }
+
+  // number of codes of the dictionary, a shared dictionary has codes of other blocks too,
+  // its size is fixed when the column is sealed as no code of this column is beyond it.
+  inline size_t dictSize() const {
+    if (shared_) {
+      return sharedSize_ > 0 ? sharedSize_ : shared_->size();
+    }
+
+    return dict_->size();
+  }
+
+  // record a value stored in data for the estimate of distinct values
+  template <typename T>
+  inline void distinct(T value) {
+    if (distinct_) {
+      distinct_->add(value);
+    }
   }
 
-  inline void seal() {
-    // release hash items for lookup
+  // number of distinct values of a sealed column, exact for a dictionary, estimated for others.
+  // 0 if unknown, such as partition columns, bool and compound columns.
+  inline size_t distinctValues() const {
+    if (shared_) {
+      return used_.cardinality();
+    }
+
+    return dict_ ? dict_->size() : distinctValues_;
+  }
+
+  // move values of all rows into a dictionary if estimated distinct values are within given ratio of values,
+  // reader returns the value of a row in data. Return true if the values are in dictionary now.
+  template <typename R>
+  bool dictEncode(double ratio, size_t rows, R&& reader) {
+    if (!distinct_ || !sh_) {
+      return false;
+    }
+
+    const auto values = rows - nulls_.cardinality();
+    sealDistinct();
+    if (values == 0 || distinctValues_ > ratio * values) {
+      return false;
+    }
+
+    // offset size of a row is replaced by its dictionary code, NULL rows keep code 0
+    auto dict = std::make_unique<nebula::memory::encode::DictEncoder>();
+    auto offsets = std::make_unique<nebula::common::ExtendableSlice>(N_ITEMS);
+    offsets->write<IndexType>(0, 0);
+    IndexType last = 0;
+    for (size_t i = 0; i < rows; ++i) {
+      if (!nulls_.contains(i)) {
+        last += dict->set(reader(i));
+      }
+
+      offsets->write((i + 1) * INDEX_WIDTH, last);
+    }
+
+    dict_ = std::move(dict);
+    offsetSize_ = std::move(offsets);
+    count_ = rows + 1;
+    return true;
+  }
+
+  // seal the metadata of given number of values
+  inline void seal(size_t rows) {
+    // only the estimate is kept
+    sealDistinct();
+
+    // release hash items for lookup, codes are rewritten if they are changed to follow item order
     if (dict_) {
-      dict_->seal();
+      const auto codes = dict_->seal();
+      if (!codes.empty()) {
+        recode(codes);
+      }
     }
 
-    // shrink bitmap
-    nulls_.shrinkToFit();
+    // codes of a shared dictionary never change
+    if (shared_) {
+      sharedSize_ = shared_->size();
+      used_.shrinkToFit();
+    }
+
+    // pick the NULL storage by density, shrink bitmap if it stays
+    const auto numNulls = nulls_.cardinality();
+    if (numNulls == 0) {
+      mode_ = Nulls::NONE;
+    } else if (numNulls * DENSE_RATIO > rows && nulls_.maximum() < rows) {
+      rows_ = rows;
+      dense_.assign((rows + 63) >> 6, 0);
+      for (auto row : nulls_) {
+        dense_[row >> 6] |= (1ULL << (row & 63));
+      }
+
+      mode_ = Nulls::DENSE;
+      nulls_ = roaring::Roaring();
+    } else {
+      nulls_.shrinkToFit();
+    }
 
     // seal the slice to release unused memory
     if (offsetSize_) {
@@ -167,16 +402,29 @@ public:
     return default_;
   }
 
+  // bytes allocated for offset sizes and dictionary, a shared dictionary is owned by the table, not counted
+  inline size_t capacity() const {
+    return (offsetSize_ ? offsetSize_->size() : 0) + (dict_ ? dict_->capacity() : 0);
+  }
+
   inline bool isPartition() const {
     return partition_;
   }
 
+  // add bytes of null bitmap, offset sizes, dictionary and histogram to given column memory
+  inline void memory(nebula::meta::ColumnMemory& memory) const {
+    memory.nulls += nulls_.getSizeInBytes() + dense_.capacity() * sizeof(uint64_t);
+    memory.offsets += offsetSize_ ? offsetSize_->size() : 0;
+    memory.dict += dict_ ? dict_->capacity() : used_.getSizeInBytes();
+    memory.histogram += histo_ ? histo_->bytes() : 0;
+  }
+
 public:
   // build up histogram in metadata for supported types
   // including:
   //    bool type: true count, false count will be computed by "total - null count - true count"
   //    number type: min, max, count, sum (here valid count = "total - null count")
-  //    string type: <TBD - total length?>
+  //    string type: lexicographic min, max, count
   template <typename T>
   size_t histogram(T);
 
@@ -191,6 +439,45 @@ public:
     return histo_;
   }
 
+private:
+  // partition values are known by their pod
+  inline void estimateDistinct() {
+    if (!partition_) {
+      distinct_ = std::make_unique<nebula::common::HyperLogLog>(DISTINCT_WIDTH);
+    }
+  }
+
+  inline void sealDistinct() {
+    if (distinct_) {
+      distinctValues_ = static_cast<size_t>(distinct_->estimate() + 0.5);
+      distinct_ = nullptr;
+    }
+  }
+
+  inline bool contains(size_t index) const {
+    if (mode_ == Nulls::DENSE) {
+      return index < rows_ && ((dense_[index >> 6] >> (index & 63)) & 1);
+    }
+
+    return nulls_.contains(index);
+  }
+
+  // replace dictionary code of every row by given mapping, NULL rows keep code 0
+  void recode(const std::vector<int32_t>& codes) {
+    IndexType last = 0;
+    IndexType code = 0;
+    for (size_t i = 1; i < count_; ++i) {
+      const auto pos = i * INDEX_WIDTH;
+      const auto value = offsetSize_->read<IndexType>(pos);
+      if (!nulls_.contains(i - 1)) {
+        code += codes.at(value - last);
+      }
+
+      last = value;
+      offsetSize_->write(pos, code);
+    }
+  }
+
 private:
   // store all null positions
   // call runOptimize() to compress the bitmap when finalizing.
@@ -217,10 +504,24 @@ private:
   // dictionary link one index to another index which has the value
   std::unique_ptr<nebula::memory::encode::DictEncoder> dict_;
 
+  // dictionary shared by the table instead, codes used by this column and size of the dictionary at seal
+  std::shared_ptr<nebula::memory::encode::SharedDict> shared_;
+  roaring::Roaring used_;
+  size_t sharedSize_;
+
+  // estimate of distinct values of a number or string column before it is sealed, then its result
+  std::unique_ptr<nebula::common::HyperLogLog> distinct_;
+  size_t distinctValues_;
+
   // indicate if this column has default value setting
   // if yes, it will never be NULL, default value will be returned instead of NULLs
   bool default_;
 
+  // NULL storage, and the dense bitmap of rows_ bits if it is dense
+  Nulls mode_;
+  std::vector<uint64_t> dense_;
+  size_t rows_ = 0;
+
   // a histogram object storing concrete typed histogram
   // to avoid runtime casting, we use 3 different pointers internally pointing to the same object
   // they don't maintain referneces.
@@ -228,6 +529,7 @@ private:
   nebula::surface::eval::BoolHistogram* bh_;
   nebula::surface::eval::IntHistogram* ih_;
   nebula::surface::eval::RealHistogram* rh_;
+  nebula::surface::eval::StringHistogram* sh_;
 };
 
 } // namespace serde
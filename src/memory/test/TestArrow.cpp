@@ -24,6 +24,7 @@
 #include "arrow/io/api.h"
 #include "common/Memory.h"
 #include "fmt/format.h"
+#include "memory/ArrowBatch.h"
 #include "memory/Batch.h"
 #include "memory/DataNode.h"
 #include "memory/FlatRow.h"
@@ -183,6 +184,64 @@ TEST(ArrowTest, DISABLED_BasicArrowData) {
   EXPECT_EQ(rows.size(), expected_rows.size());
 }
 
+TEST(ArrowTest, TestBatchExport) {
+  nebula::meta::TestPartitionedTable test;
+  auto pod = test.pod();
+  MockRowData mr;
+
+  // rows of one partition in a sealed batch
+  std::shared_ptr<Batch> batch;
+  std::vector<nebula::surface::StaticPartitionedRow> rows;
+  while (rows.size() < 1000) {
+    nebula::surface::StaticPartitionedRow row(mr.readLong("_time_"), mr.readByte("value"), mr.readDouble("weight"));
+    int32_t bess = -1;
+    auto pid = pod->pod(row, bess);
+    if (batch == nullptr) {
+      batch = std::make_shared<Batch>(test, 1000, pid);
+    }
+
+    if (pid == batch->getPid()) {
+      batch->add(row, bess);
+      rows.push_back(row);
+    }
+  }
+  batch->seal();
+
+  auto record = ArrowBatch::from(batch);
+  EXPECT_EQ(record->num_rows(), rows.size());
+  EXPECT_EQ(record->num_columns(), 6);
+  EXPECT_EQ(record->schema()->field(1)->type()->id(), arrow::Type::STRING);
+
+  // weight values are not copied
+  auto weight = std::static_pointer_cast<arrow::DoubleArray>(record->column(5));
+  EXPECT_EQ(static_cast<const void*>(weight->raw_values()), batch->scalar("weight")->data);
+
+  auto d1 = std::static_pointer_cast<arrow::StringArray>(record->column(1));
+  auto d3 = std::static_pointer_cast<arrow::Int32Array>(record->column(3));
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const auto& r = rows.at(i);
+    EXPECT_EQ(weight->Value(i), r.weight_);
+    EXPECT_EQ(d1->GetString(i), r.d1_);
+    EXPECT_EQ(d3->Value(i), r.d3_);
+  }
+
+  // exported arrays keep the batch alive
+  batch = nullptr;
+  EXPECT_EQ(weight->Value(0), rows.front().weight_);
+
+  // a round trip of IPC stream
+  auto bytes = ArrowBatch::ipc(record->schema(), { record, record });
+  auto input = std::make_shared<arrow::io::BufferReader>(arrow::Buffer::FromString(bytes));
+  auto reader = arrow::ipc::RecordBatchStreamReader::Open(input).ValueOrDie();
+  size_t total = 0;
+  std::shared_ptr<arrow::RecordBatch> next;
+  while (reader->ReadNext(&next).ok() && next != nullptr) {
+    EXPECT_TRUE(next->Equals(*record));
+    total += next->num_rows();
+  }
+  EXPECT_EQ(total, rows.size() * 2);
+}
+
 } // namespace test
 } // namespace memory
 } // namespace nebula
\ No newline at end of file
@@ -15,20 +15,29 @@
  */
 
 #include <fmt/format.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <mutex>
 #include <valarray>
 
 #include "common/Memory.h"
 #include "memory/Batch.h"
 #include "memory/DataNode.h"
 #include "memory/FlatRow.h"
+#include "memory/Synthetic.h"
 #include "meta/TestTable.h"
 #include "surface/DataSurface.h"
 #include "surface/MockSurface.h"
 #include "surface/StaticData.h"
+#include "surface/eval/Kernel.h"
 #include "type/Serde.h"
 
+DECLARE_uint64(ZONE_ROWS);
+DECLARE_double(ENCODE_RATIO);
+DECLARE_uint64(BITMAP_VALUES);
+DECLARE_uint32(BLOOM_THREADS);
+
 namespace nebula {
 namespace memory {
 namespace test {
@@ -102,6 +111,22 @@ TEST(BatchTest, TestBatch) {
   EXPECT_EQ(batch1.state(), batch2.state());
 }
 
+TEST(BatchTest, TestSealCompaction) {
+  nebula::meta::TestTable test;
+  auto rows = 1000;
+  Batch batch(test, rows);
+  MockRowData row(Evidence::unix_timestamp());
+  for (auto i = 0; i < rows; ++i) {
+    batch.add(row);
+  }
+
+  // slices are over allocated while building, seal compacts them to their usage
+  EXPECT_EQ(batch.getReclaimed(), 0);
+  batch.seal();
+  EXPECT_GT(batch.getReclaimed(), 0);
+  EXPECT_NE(batch.state().find(fmt::format("reclaimed: {0}", batch.getReclaimed())), std::string::npos);
+}
+
 TEST(BatchTest, TestBatchRead) {
   nebula::meta::TestTable test;
   auto count = 10000;
@@ -211,6 +236,9 @@ TEST(BatchTest, TestBloomFilter) {
     batch.add(row);
   }
 
+  // bloom filter is built at seal
+  batch.seal();
+
   // check this batch has bloom filter on ID
   // assuming no false positive on this individual value
   // if the test becomes unstable, we can change the test
@@ -221,8 +249,111 @@ TEST(BatchTest, TestBloomFilter) {
     }
   }
 
-  // false positive rate should be less than 0.1%
-  EXPECT_LT(falsePositives * 100.0 / count, 0.1f);
+  // false positive rate should be less than 0.5%
+  EXPECT_LT(falsePositives * 100.0 / count, 0.5f);
+}
+
+TEST(BatchTest, TestBloomFilterSizedAtSeal) {
+  nebula::meta::TestTable test;
+  const auto threads = FLAGS_BLOOM_THREADS;
+  FLAGS_BLOOM_THREADS = 4;
+
+  // a block holds many more rows than its capacity, its filter is sized by distinct values at seal
+  int32_t count = 20000;
+  Batch batch(test, 100);
+  for (int32_t i = 0; i < count; ++i) {
+    nebula::surface::StaticRow row{ i, i, "events", nullptr, false, 0, 0, 0 };
+    batch.add(row);
+  }
+
+  // nothing is pruned before seal
+  EXPECT_TRUE(batch.probably("id", count * 2));
+  batch.seal();
+  FLAGS_BLOOM_THREADS = threads;
+
+  for (int32_t i = 0; i < count; ++i) {
+    EXPECT_TRUE(batch.probably("id", i));
+  }
+
+  auto falsePositives = 0;
+  for (int32_t i = count; i < count * 2; ++i) {
+    if (batch.probably("id", i)) {
+      falsePositives++;
+    }
+  }
+
+  EXPECT_LT(falsePositives * 100.0 / count, 0.5f);
+}
+
+TEST(BatchTest, TestStringBloomFilter) {
+  nebula::meta::TestTable test;
+  int32_t count = 1000;
+
+  // event column is dictionary encoded with bloom filter
+  Batch batch(test, count);
+  for (int32_t i = 0; i < count; ++i) {
+    auto event = fmt::format("event-{0}", i % 100);
+    nebula::surface::StaticRow row{ i,
+                                    i,
+                                    event,
+                                    nullptr,
+                                    false,
+                                    0,
+                                    0,
+                                    0 };
+    batch.add(row);
+  }
+
+  batch.seal();
+  auto histo = batch.histogram<nebula::surface::eval::StringHistogram>("event");
+  EXPECT_EQ(histo.count, count);
+  EXPECT_EQ(histo.min(), "event-0");
+  EXPECT_EQ(histo.max(), "event-99");
+
+  // no false negatives, and few false positives
+  using SV = std::string_view;
+  auto falsePositives = 0;
+  for (int32_t i = 0; i < 100; ++i) {
+    EXPECT_TRUE(batch.probably("event", std::any(SV(fmt::format("event-{0}", i)))));
+    if (batch.probably("event", std::any(std::string(fmt::format("event-{0}x", i))))) {
+      falsePositives++;
+    }
+  }
+
+  EXPECT_LT(falsePositives, 10);
+
+  // equality on a value out of lexicographic range or not in bloom filter skips the block
+  using nebula::surface::eval::BlockEval;
+  using nebula::surface::eval::column;
+  using nebula::surface::eval::constant;
+  EXPECT_EQ(nebula::surface::eval::eq<SV, SV>(column<SV>("event"), constant(std::string("zzz")))->eval(batch),
+            BlockEval::NONE);
+  EXPECT_EQ(nebula::surface::eval::eq<SV, SV>(column<SV>("event"), constant(std::string("event-5")))->eval(batch),
+            BlockEval::PARTIAL);
+  EXPECT_EQ(nebula::surface::eval::neq<SV, SV>(column<SV>("event"), constant(std::string("aaa")))->eval(batch),
+            BlockEval::ALL);
+}
+
+TEST(BatchTest, TestDistinctValues) {
+  nebula::meta::TestTable test;
+  int32_t count = 10000;
+  Batch batch(test, count);
+  for (int32_t i = 0; i < count; ++i) {
+    auto event = fmt::format("event-{0}", i % 100);
+    nebula::surface::StaticRow row{ i, i % 500, event, nullptr, false, 0, 0, 0 };
+    batch.add(row);
+  }
+
+  // unknown before seal
+  EXPECT_EQ(batch.distinctValues("id"), 0);
+  batch.seal();
+
+  // dictionary tells exactly, others are estimated within a few percent
+  EXPECT_EQ(batch.distinctValues("event"), 100);
+  EXPECT_NEAR(batch.distinctValues("id"), 500, 50);
+  EXPECT_NEAR(batch.distinctValues("_time_"), count, count / 10);
+  EXPECT_EQ(batch.distinctValues("flag"), 0);
+  EXPECT_EQ(batch.distinctValues("x"), 0);
 }
 
 TEST(BatchTest, TestStringDictionary) {
@@ -264,6 +395,41 @@ TEST(BatchTest, TestStringDictionary) {
   LOG(INFO) << "Verified total rows: " << count;
 }
 
+TEST(BatchTest, TestAutoDictionary) {
+  nebula::meta::TestTable test;
+  int32_t count = 10000;
+
+  // stack column has no dictionary setting, it is switched to dictionary at seal by its cardinality
+  auto build = [&test, count](size_t distinct) {
+    auto batch = std::make_unique<Batch>(test, count);
+    for (int32_t i = 0; i < count; ++i) {
+      nebula::surface::StaticRow row{ i,
+                                      i,
+                                      fmt::format("stack-{0}", i % distinct),
+                                      nullptr,
+                                      false,
+                                      0,
+                                      0,
+                                      0 };
+      batch->add(row);
+    }
+
+    batch->seal();
+    return batch;
+  };
+
+  auto low = build(20);
+  EXPECT_EQ(low->dictSize("stack"), 20);
+  auto high = build(count);
+  EXPECT_EQ(high->dictSize("stack"), 0);
+  EXPECT_LT(low->getMemory(), high->getMemory());
+
+  auto accessor = low->makeAccessor();
+  for (auto i : { 0, 19, 20, 4321, 9999 }) {
+    EXPECT_EQ(accessor->seek(i).readString("stack"), fmt::format("stack-{0}", i % 20));
+  }
+}
+
 TEST(BatchTest, TestDefaultValue) {
   nebula::meta::TestTable test;
   int32_t count = 1000;
@@ -308,6 +474,286 @@ TEST(BatchTest, TestDefaultValue) {
   }
 }
 
+TEST(BatchTest, TestScalarKernel) {
+  nebula::meta::TestTable test;
+  int32_t count = 1000;
+
+  // even values will be null for "value" column which has default value as "23"
+  Batch batch(test, count);
+  for (int32_t i = 0; i < count; ++i) {
+    nebula::surface::StaticRow row{ i,
+                                    i,
+                                    "events",
+                                    nullptr,
+                                    i % 3 == 0,
+                                    (char)(i % 32),
+                                    128,
+                                    1.1 };
+    batch.add(row);
+  }
+
+  auto column = batch.scalar("id");
+  EXPECT_TRUE(column.has_value());
+  EXPECT_FALSE(column->nullable);
+  EXPECT_FALSE(batch.scalar("event").has_value());
+  EXPECT_TRUE(batch.scalar("value")->nullable);
+
+  using nebula::surface::eval::column;
+  using nebula::surface::eval::constant;
+  auto accessor = batch.makeAccessor();
+  const nebula::surface::eval::Seeker seeker = [&accessor](size_t row) -> const nebula::surface::Accessor& {
+    return accessor->seek(row);
+  };
+
+  // kernel selection should be the same as row by row evaluation
+  nebula::surface::eval::EvalContext ctx{ false };
+  auto verify = [&](const nebula::surface::eval::ValueEval& filter) {
+    nebula::surface::eval::Selection selection;
+    selection.reset(0, count);
+    filter.select(ctx, batch, seeker, selection);
+
+    std::vector<size_t> expected;
+    for (auto i = 0; i < count; ++i) {
+      ctx.reset(seeker(i));
+      if (filter.eval<bool>(ctx).value_or(false)) {
+        expected.push_back(i);
+      }
+    }
+
+    EXPECT_EQ(std::vector<size_t>(selection.begin(), selection.end()), expected);
+    return selection.size();
+  };
+
+  EXPECT_EQ(verify(*nebula::surface::eval::gt<int32_t, int32_t>(column<int32_t>("id"), constant(899))), 100);
+  EXPECT_EQ(verify(*nebula::surface::eval::eq<int8_t, int32_t>(column<int8_t>("value"), constant(23))), 531);
+  EXPECT_EQ(verify(*nebula::surface::eval::lt<int8_t, int32_t>(column<int8_t>("value"), constant(10))), 159);
+  EXPECT_EQ(verify(*nebula::surface::eval::eq<bool, bool>(column<bool>("flag"), constant(true))), 334);
+
+  // string column is read through bound accessor index
+  using SV = std::string_view;
+  EXPECT_EQ(verify(*nebula::surface::eval::eq<SV, SV>(column<SV>("event"), constant(std::string("events")))), count);
+  EXPECT_EQ(verify(*nebula::surface::eval::gt<SV, SV>(column<SV>("event"), constant(std::string("x")))), 0);
+}
+
+TEST(BatchTest, TestStringHeads) {
+  nebula::meta::TestTable test;
+  int32_t count = 1000;
+
+  // stack values of all lengths, short ones are inlined in their heads and long ones are in heap
+  auto value = [](int32_t i) {
+    return fmt::format("s{0}{1}", i % 500, std::string(i % 24, 'x'));
+  };
+
+  Batch batch(test, count);
+  for (int32_t i = 0; i < count; ++i) {
+    nebula::surface::StaticRow row{ i, i, value(i), nullptr, false, 0, 0, 0 };
+    batch.add(row);
+  }
+
+  batch.seal();
+  EXPECT_EQ(batch.dictSize("stack"), 0);
+  EXPECT_TRUE(batch.strings("stack").has_value());
+  EXPECT_FALSE(batch.strings("event").has_value());
+
+  auto accessor = batch.makeAccessor();
+  for (auto i = 0; i < count; ++i) {
+    EXPECT_EQ(accessor->seek(i).readString("stack"), value(i));
+  }
+
+  using nebula::surface::eval::column;
+  using nebula::surface::eval::constant;
+  const nebula::surface::eval::Seeker seeker = [&accessor](size_t row) -> const nebula::surface::Accessor& {
+    return accessor->seek(row);
+  };
+
+  // heads selection should be the same as row by row evaluation
+  nebula::surface::eval::EvalContext ctx{ false };
+  auto verify = [&](const nebula::surface::eval::ValueEval& filter) {
+    nebula::surface::eval::Selection selection;
+    selection.reset(0, count);
+    filter.select(ctx, batch, seeker, selection);
+
+    std::vector<size_t> expected;
+    for (auto i = 0; i < count; ++i) {
+      ctx.reset(seeker(i));
+      if (filter.eval<bool>(ctx).value_or(false)) {
+        expected.push_back(i);
+      }
+    }
+
+    EXPECT_EQ(std::vector<size_t>(selection.begin(), selection.end()), expected);
+    return selection.size();
+  };
+
+  using SV = std::string_view;
+  using nebula::surface::eval::eq;
+  EXPECT_EQ(verify(*eq<SV, SV>(column<SV>("stack"), constant(value(3)))), 1);
+  EXPECT_EQ(verify(*eq<SV, SV>(column<SV>("stack"), constant(value(20)))), 1);
+  EXPECT_EQ(verify(*eq<SV, SV>(column<SV>("stack"), constant(std::string("s20xxx")))), 0);
+  verify(*nebula::surface::eval::neq<SV, SV>(column<SV>("stack"), constant(value(21))));
+  verify(*nebula::surface::eval::lt<SV, SV>(column<SV>("stack"), constant(std::string("s2"))));
+  verify(*nebula::surface::eval::ge<SV, SV>(column<SV>("stack"), constant(value(17))));
+  verify(*nebula::surface::eval::gt<SV, SV>(column<SV>("stack"), constant(std::string("s4"))));
+}
+
+TEST(BatchTest, TestZoneMap) {
+  nebula::meta::TestTable test;
+  int32_t count = 10000;
+  FLAGS_ZONE_ROWS = 1000;
+
+  // id is ascending, every stripe covers a small id range
+  Batch batch(test, count);
+  for (int32_t i = 0; i < count; ++i) {
+    nebula::surface::StaticRow row{ i,
+                                    i,
+                                    "events",
+                                    nullptr,
+                                    i % 3 == 0,
+                                    (char)(i % 32),
+                                    128,
+                                    1.1 };
+    batch.add(row);
+  }
+
+  EXPECT_EQ(batch.zoneRows(), 0);
+  batch.seal();
+  FLAGS_ZONE_ROWS = 8192;
+  EXPECT_EQ(batch.zoneRows(), 1000);
+
+  auto zone = std::dynamic_pointer_cast<nebula::surface::eval::IntHistogram>(batch.zone("id", 3));
+  EXPECT_EQ(zone->min(), 3000);
+  EXPECT_EQ(zone->max(), 3999);
+  EXPECT_EQ(zone->count, 1000);
+  EXPECT_EQ(batch.zone("id", 10), nullptr);
+  EXPECT_EQ(batch.zone("event", 0), nullptr);
+
+  // stripes out of the range of a predicate are evaluated as NONE
+  using nebula::surface::eval::BlockEval;
+  using nebula::surface::eval::column;
+  using nebula::surface::eval::constant;
+  using nebula::surface::eval::Stripe;
+  auto filter = nebula::surface::eval::gt<int32_t, int32_t>(column<int32_t>("id"), constant(8500));
+  EXPECT_EQ(filter->eval(batch), BlockEval::PARTIAL);
+  EXPECT_EQ(filter->eval(Stripe(batch, 0)), BlockEval::NONE);
+  EXPECT_EQ(filter->eval(Stripe(batch, 8)), BlockEval::PARTIAL);
+  EXPECT_EQ(filter->eval(Stripe(batch, 9)), BlockEval::ALL);
+  EXPECT_EQ(Stripe(batch, 9).getRows(), 1000);
+
+  // a block summary synced to server evaluates the same way as the block by its histograms
+  nebula::surface::eval::HistVector hists;
+  const auto schema = batch.schema();
+  for (size_t i = 0; i < schema->size(); ++i) {
+    hists.push_back(batch.histogram(schema->childType(i)->name()));
+  }
+
+  using nebula::surface::eval::SummaryView;
+  EXPECT_EQ(filter->eval(SummaryView(schema, batch.getRows(), hists)), BlockEval::PARTIAL);
+  auto none = nebula::surface::eval::gt<int32_t, int32_t>(column<int32_t>("id"), constant(count));
+  EXPECT_EQ(none->eval(SummaryView(schema, batch.getRows(), hists)), BlockEval::NONE);
+}
+
+TEST(BatchTest, TestEncodedColumn) {
+  nebula::meta::TestTable test;
+  int32_t count = 10000;
+
+  // id has short runs of the same value, encoded batch is compared with a raw one
+  auto build = [&test, count](double ratio) {
+    FLAGS_ENCODE_RATIO = ratio;
+    auto batch = std::make_unique<Batch>(test, count);
+    for (int32_t i = 0; i < count; ++i) {
+      nebula::surface::StaticRow row{ i,
+                                      i / 7,
+                                      "events",
+                                      nullptr,
+                                      i % 3 == 0,
+                                      (char)(i % 32),
+                                      128,
+                                      1.1 };
+      batch->add(row);
+    }
+
+    batch->seal();
+    return batch;
+  };
+
+  auto raw = build(0);
+  auto encoded = build(0.5);
+  FLAGS_ENCODE_RATIO = 0.5;
+  EXPECT_NE(raw->scalar("id")->data, nullptr);
+  EXPECT_EQ(encoded->scalar("id")->data, nullptr);
+  EXPECT_LT(encoded->getMemory(), raw->getMemory());
+
+  // random reads across chunks
+  auto accessor = encoded->makeAccessor();
+  for (auto i : { 9999, 0, 5000, 1023, 1024, 7777, 1 }) {
+    EXPECT_EQ(accessor->seek(i).readInt("id"), i / 7);
+  }
+
+  // batch decode of a range
+  std::vector<int32_t> values(1500);
+  EXPECT_TRUE(encoded->decode("id", 1000, values.size(), values.data()));
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], (int32_t)((1000 + i) / 7));
+  }
+  EXPECT_FALSE(raw->decode("id", 0, 1, values.data()));
+
+  // kernel runs on decoded values
+  using nebula::surface::eval::column;
+  using nebula::surface::eval::constant;
+  const nebula::surface::eval::Seeker seeker = [&accessor](size_t row) -> const nebula::surface::Accessor& {
+    return accessor->seek(row);
+  };
+  nebula::surface::eval::EvalContext ctx{ false };
+  auto filter = nebula::surface::eval::lt<int32_t, int32_t>(column<int32_t>("id"), constant(100));
+  nebula::surface::eval::Selection selection;
+  selection.reset(0, 1024);
+  filter->select(ctx, *encoded, seeker, selection);
+  EXPECT_EQ(selection.size(), 700);
+  EXPECT_EQ(selection.back(), 699);
+
+  // time column is delta encoded, rows of a time range are searched on it
+  EXPECT_EQ(encoded->scalar("_time_")->data, nullptr);
+  EXPECT_EQ(accessor->seek(4321).readLong("_time_"), 4321);
+  EXPECT_EQ(encoded->rows("_time_", 1500, 1600), std::pair<size_t, size_t>(1500, 1601));
+  EXPECT_EQ(encoded->rows("_time_", 20000, 30000).first, encoded->rows("_time_", 20000, 30000).second);
+  EXPECT_EQ(raw->rows("_time_", 1500, 1600), std::pair<size_t, size_t>(0, count));
+}
+
+TEST(BatchTest, TestIndexRead) {
+  nebula::meta::TestTable test;
+  int32_t count = 1000;
+
+  Batch batch(test, count);
+  for (int32_t i = 0; i < count; ++i) {
+    nebula::surface::StaticRow row{ i,
+                                    i,
+                                    "events",
+                                    nullptr,
+                                    i % 3 == 0,
+                                    (char)(i % 32),
+                                    128,
+                                    1.1 };
+    batch.add(row);
+  }
+
+  // reads by index should be the same as reads by name
+  auto accessor = batch.makeAccessor();
+  auto id = accessor->index("id");
+  auto event = accessor->index("event");
+  auto value = accessor->index("value");
+  EXPECT_TRUE(id.has_value());
+  EXPECT_TRUE(event.has_value());
+  EXPECT_TRUE(value.has_value());
+  EXPECT_FALSE(accessor->index("not_exist").has_value());
+
+  for (auto i = 0; i < count; ++i) {
+    const auto& row = accessor->seek(i);
+    EXPECT_EQ(row.readInt(*id), row.readInt("id"));
+    EXPECT_EQ(row.readString(*event), row.readString("event"));
+    EXPECT_EQ(row.readByte(*value), row.readByte("value"));
+  }
+}
+
 TEST(BatchTest, TestPartitionedBatch) {
   nebula::meta::TestPartitionedTable test;
   size_t count = 10000;
@@ -393,6 +839,490 @@ TEST(BatchTest, TestPartitionedBatch) {
     // all lines are the same
     EXPECT_EQ(lines, results);
   }
+
+  // partition view of a batch prunes by its partition values only
+  using SV = std::string_view;
+  using nebula::surface::eval::BlockEval;
+  using nebula::surface::eval::column;
+  using nebula::surface::eval::constant;
+  const auto& batch = *batches.begin()->second;
+  nebula::surface::eval::PartitionView view(batch);
+  const auto d1 = std::any_cast<std::string>(batch.partitionValues("d1").front());
+  auto in = nebula::surface::eval::eq<SV, SV>(column<SV>("d1"), constant(d1));
+  auto out = nebula::surface::eval::eq<SV, SV>(column<SV>("d1"), constant(std::string("x")));
+  auto value = nebula::surface::eval::eq<int8_t, int8_t>(column<int8_t>("value"), constant<int8_t>(3));
+  EXPECT_NE(in->eval(view), BlockEval::NONE);
+  EXPECT_EQ(out->eval(view), BlockEval::NONE);
+  EXPECT_EQ(out->eval(batch), BlockEval::NONE);
+  EXPECT_EQ(value->eval(view), BlockEval::PARTIAL);
+
+  // runs of a partition column decode the same values as row by row reading
+  for (auto& b : batches) {
+    const auto& pb = *b.second;
+    const auto rows = pb.getRows();
+    std::vector<nebula::surface::eval::Run> runs;
+    EXPECT_TRUE(pb.runs("d2", 0, rows, runs));
+    EXPECT_FALSE(pb.runs("value", 0, rows, runs));
+    EXPECT_EQ(runs.front().first, 0u);
+    EXPECT_EQ(runs.back().last, rows);
+
+    const auto d2 = pb.partitionValues("d2");
+    auto accessor = pb.makeAccessor();
+    for (const auto& run : runs) {
+      for (auto i = run.first; i < run.last; ++i) {
+        EXPECT_EQ(accessor->seek(i).readByte("d2").value(), std::any_cast<int8_t>(d2.at(run.code)));
+      }
+    }
+
+    // partition column is selected by its runs
+    nebula::surface::eval::Selection selection;
+    selection.reset(0, rows);
+    EXPECT_TRUE(nebula::surface::eval::selectScalar<int8_t>(pb, "d2", selection, [](int8_t v) { return v > 2; }));
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < rows; ++i) {
+      if (accessor->seek(i).readByte("d2").value() > 2) {
+        expected.push_back(i);
+      }
+    }
+
+    EXPECT_EQ(std::vector<size_t>(selection.begin(), selection.end()), expected);
+  }
+}
+
+TEST(BatchTest, TestColumnAppend) {
+  nebula::meta::TestPartitionedTable test;
+  auto pod = test.pod();
+  MockRowData mr;
+
+  // rows of the same partition
+  std::vector<nebula::surface::StaticPartitionedRow> rows;
+  std::vector<nebula::meta::BessType> bess;
+  size_t pid = 0;
+  for (size_t i = 0; rows.size() < 1000; ++i) {
+    nebula::surface::StaticPartitionedRow row(mr.readLong("_time_"), mr.readByte("value"), mr.readDouble("weight"));
+    int32_t b = -1;
+    auto p = pod->pod(row, b);
+    if (rows.empty()) {
+      pid = p;
+    }
+
+    if (p == pid) {
+      rows.push_back(row);
+      bess.push_back(b);
+    }
+  }
+
+  // the same rows added row by row and column by column
+  const auto count = rows.size();
+  Batch byRow(test, count, pid);
+  for (size_t i = 0; i < count; ++i) {
+    byRow.add(rows.at(i), bess.at(i));
+  }
+
+  std::vector<int64_t> times;
+  std::vector<std::string_view> d1;
+  std::vector<int8_t> d2;
+  std::vector<int32_t> d3;
+  std::vector<int8_t> values;
+  std::vector<double> weights;
+  for (const auto& r : rows) {
+    times.push_back(r.time_);
+    d1.push_back(r.d1_);
+    d2.push_back(r.d2_);
+    d3.push_back(r.d3_);
+    values.push_back(r.value_);
+    weights.push_back(r.weight_);
+  }
+
+  // every 7th weight is null in another batch
+  std::vector<uint8_t> valid((count + 7) / 8, 0xFF);
+  for (size_t i = 0; i < count; i += 7) {
+    valid[i >> 3] &= ~(1 << (i & 7));
+  }
+
+  Batch byColumn(test, count, pid);
+  Batch withNulls(test, count, pid);
+  std::vector<ColumnVector> columns{
+    { times.data(), nullptr }, { d1.data(), nullptr }, { d2.data(), nullptr },
+    { d3.data(), nullptr }, { values.data(), nullptr }, { weights.data(), nullptr }
+  };
+
+  // appended in two slices
+  const auto half = count / 2;
+  EXPECT_EQ(byColumn.add(columns, half, bess.data()), 0);
+  columns = { { times.data() + half, nullptr }, { d1.data() + half, nullptr }, { d2.data() + half, nullptr },
+              { d3.data() + half, nullptr }, { values.data() + half, nullptr }, { weights.data() + half, nullptr } };
+  EXPECT_EQ(byColumn.add(columns, count - half, bess.data() + half), half);
+
+  columns = { { times.data(), nullptr }, { d1.data(), nullptr }, { d2.data(), nullptr },
+              { d3.data(), nullptr }, { values.data(), nullptr }, { weights.data(), valid.data() } };
+  withNulls.add(columns, count, bess.data());
+
+  byRow.seal();
+  byColumn.seal();
+  withNulls.seal();
+  EXPECT_EQ(byColumn.getRows(), count);
+  EXPECT_EQ(byColumn.getRawSize(), byRow.getRawSize());
+  EXPECT_EQ(byColumn.histogram("weight")->count, byRow.histogram("weight")->count);
+
+  auto line = [](const nebula::surface::Accessor& r) {
+    return fmt::format("({0}, {1}, {2}, {3}, {4}, {5})",
+                       r.readLong("_time_").value_or(0),
+                       r.readString("d1").value_or(""),
+                       r.readByte("d2").value_or(0),
+                       r.readInt("d3").value_or(0),
+                       r.readByte("value").value_or(0),
+                       r.readDouble("weight").value_or(0));
+  };
+
+  auto a1 = byRow.makeAccessor();
+  auto a2 = byColumn.makeAccessor();
+  auto a3 = withNulls.makeAccessor();
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(line(a1->seek(i)), line(a2->seek(i)));
+    EXPECT_EQ(a3->seek(i).readDouble("weight").has_value(), i % 7 != 0);
+    if (i % 7 != 0) {
+      EXPECT_EQ(line(a1->seek(i)), line(a3->seek(i)));
+    }
+  }
+
+  // NULL weights are dense enough to be a bitmap, no null check is needed for a column without NULL
+  std::vector<uint8_t> mask(100);
+  EXPECT_TRUE(withNulls.valid("weight", 500, mask.size(), mask.data()));
+  for (size_t i = 0; i < mask.size(); ++i) {
+    EXPECT_EQ(mask[i] == 1, (500 + i) % 7 != 0);
+  }
+
+  EXPECT_TRUE(byRow.valid("weight", 0, mask.size(), mask.data()));
+  EXPECT_EQ(static_cast<size_t>(std::count(mask.begin(), mask.end(), 1)), mask.size());
+  EXPECT_FALSE(byRow.scalar("weight")->nullable);
+  EXPECT_TRUE(withNulls.scalar("weight")->nullable);
+
+  nebula::surface::eval::Selection nulls;
+  withNulls.nulls("weight", 10, 30, nulls);
+  EXPECT_EQ(std::vector<size_t>(nulls.begin(), nulls.end()), std::vector<size_t>({ 14, 21, 28 }));
+
+  // kernel masks out NULL rows by the bitmap
+  nebula::surface::eval::Selection selection;
+  selection.reset(0, count);
+  EXPECT_TRUE(nebula::surface::eval::selectScalar<double>(withNulls, "weight", selection, [](double) { return true; }));
+  EXPECT_EQ(selection.size(), count - (count + 6) / 7);
+
+  // compound columns are not supported
+  nebula::meta::TestTable other;
+  Batch compound(other, 10);
+  std::vector<ColumnVector> list(10, ColumnVector{ nullptr, nullptr });
+  EXPECT_THROW(compound.add(list, 0), nebula::common::NException);
+}
+
+TEST(BatchTest, TestCodedColumnAppend) {
+  nebula::meta::ColumnProps props;
+  props.emplace("name", nebula::meta::Column{ false, true });
+  nebula::meta::Table table("coded", TypeSerializer::from("ROW<_time_:bigint, name:string, tag:string>"), props, {});
+
+  // strings coded by a source dictionary, every 5th row is null
+  const std::vector<std::string_view> dict{ "red", "green", "blue" };
+  const size_t count = 100;
+  std::vector<int64_t> times(count, 1);
+  std::vector<int32_t> codes;
+  std::vector<uint8_t> valid((count + 7) / 8, 0xFF);
+  for (size_t i = 0; i < count; ++i) {
+    codes.push_back((i * 7) % dict.size());
+    if (i % 5 == 0) {
+      valid[i >> 3] &= ~(1 << (i & 7));
+    }
+  }
+
+  // with and without dictionary in the batch column
+  Batch batch(table, count);
+  ColumnVector coded{ codes.data(), valid.data(), dict.data(), dict.size() };
+  batch.add({ { times.data(), nullptr }, coded, coded }, count);
+  batch.seal();
+
+  auto accessor = batch.makeAccessor();
+  for (size_t i = 0; i < count; ++i) {
+    const auto& r = accessor->seek(i);
+    if (i % 5 == 0) {
+      EXPECT_FALSE(r.readString("name").has_value());
+      EXPECT_FALSE(r.readString("tag").has_value());
+      continue;
+    }
+
+    EXPECT_EQ(r.readString("name").value(), dict[codes[i]]);
+    EXPECT_EQ(r.readString("tag").value(), dict[codes[i]]);
+  }
+}
+
+TEST(BatchTest, TestSharedDictionary) {
+  nebula::meta::ColumnProps props;
+  props.emplace("name", nebula::meta::Column{ false, false, false, "", "", {}, {}, false, {}, true });
+  nebula::meta::Table table("shared", TypeSerializer::from("ROW<_time_:bigint, name:string>"), props, {});
+
+  // two blocks of the table share one dictionary, codes of the same string are the same in both
+  const std::vector<int64_t> times(4, 1);
+  const std::vector<std::string_view> first{ "red", "green", "red", "green" };
+  const std::vector<std::string_view> second{ "blue", "red", "blue", "blue" };
+  Batch a(table, 4);
+  a.add({ { times.data(), nullptr }, { first.data(), nullptr } }, 4);
+  a.seal();
+  Batch b(table, 4);
+  b.add({ { times.data(), nullptr }, { second.data(), nullptr } }, 4);
+  b.seal();
+
+  // a sealed block has codes of the dictionary at its seal
+  EXPECT_EQ(a.dictSize("name"), 2);
+  EXPECT_EQ(b.dictSize("name"), 3);
+  EXPECT_EQ(a.distinctValues("name"), 2);
+  EXPECT_EQ(b.distinctValues("name"), 2);
+  EXPECT_EQ(b.dictItem("name", 0), "red");
+  EXPECT_EQ(b.dictItem("name", 2), "blue");
+
+  auto accessor = b.makeAccessor();
+  for (size_t i = 0; i < second.size(); ++i) {
+    EXPECT_EQ(accessor->seek(i).readString("name").value(), second[i]);
+  }
+}
+
+TEST(BatchTest, TestSortedBatch) {
+  nebula::meta::Table table("sorted", TypeSerializer::from("ROW<_time_:bigint, id:int>"), {}, {});
+
+  // times are shuffled, id records the original order
+  const size_t count = 1000;
+  std::vector<int64_t> times;
+  std::vector<int32_t> ids;
+  for (size_t i = 0; i < count; ++i) {
+    times.push_back((i * 37) % count);
+    ids.push_back(i);
+  }
+
+  Batch batch(table, count);
+  batch.add({ { times.data(), nullptr }, { ids.data(), nullptr } }, count);
+  auto sorted = batch.sorted(table, "_time_");
+  ASSERT_NE(sorted, nullptr);
+  EXPECT_EQ(sorted->getRows(), count);
+  EXPECT_EQ(batch.sorted(table, "id"), nullptr);
+
+  FLAGS_ENCODE_RATIO = 0.5;
+  sorted->seal();
+  auto accessor = sorted->makeAccessor();
+  for (size_t i = 0; i < count; ++i) {
+    const auto& r = accessor->seek(i);
+    EXPECT_EQ(r.readLong("_time_").value(), i);
+    EXPECT_EQ(times.at(r.readInt("id").value()), i);
+  }
+
+  EXPECT_EQ(sorted->rows("_time_", 100, 199), std::pair<size_t, size_t>(100, 200));
+}
+
+TEST(BatchTest, TestMemoryBreakdown) {
+  nebula::meta::TestTable test;
+  int32_t count = 10000;
+  Batch batch(test, count);
+  for (int32_t i = 0; i < count; ++i) {
+    nebula::surface::StaticRow row{ i,
+                                    i,
+                                    "nebula",
+                                    nullptr,
+                                    false,
+                                    0,
+                                    0,
+                                    1.1 };
+    batch.add(row);
+  }
+
+  batch.seal();
+  const auto memory = batch.memory();
+  ASSERT_EQ(memory.columns.size(), batch.schema()->size());
+
+  // id has a bloom filter and event is dictionary encoded, items is a list
+  const auto& id = memory.columns.at(1);
+  EXPECT_GT(id.data, 0);
+  EXPECT_GT(id.bloom, 0);
+  EXPECT_GT(id.histogram, 0);
+  const auto& event = memory.columns.at(2);
+  EXPECT_GT(event.dict, 0);
+  EXPECT_GT(event.offsets, 0);
+  EXPECT_GT(memory.columns.at(4).offsets, 0);
+
+  size_t total = memory.bess;
+  for (const auto& c : memory.columns) {
+    total += c.total();
+  }
+
+  // storage allocation doesn't count bloom filters, bitmaps and histograms
+  EXPECT_EQ(memory.total(), total);
+  EXPECT_GT(memory.total(), batch.getMemory());
+}
+
+TEST(BatchTest, TestBitmapIndex) {
+  nebula::meta::ColumnProps props;
+  const nebula::meta::Column bitmap{ false, false, false, "", "", {}, {}, false, {}, false, false, true };
+  for (auto col : { "status", "country", "kind", "id" }) {
+    props.emplace(col, bitmap);
+  }
+
+  const auto schema = TypeSerializer::from("ROW<_time_:bigint, status:int, country:string, kind:string, id:int>");
+  nebula::meta::Table table{ "bitmap", schema, props, {} };
+
+  // status is NULL every 10 rows, id is unique so its index is dropped over the limit
+  const size_t size = 1000;
+  const std::vector<std::string_view> names{ "us", "cn", "de", "fr" };
+  std::vector<int64_t> times(size, 1);
+  std::vector<int32_t> status;
+  std::vector<int32_t> ids;
+  std::vector<std::string_view> countries;
+  std::vector<std::string_view> kinds(size, "log");
+  std::vector<uint8_t> valid(size / 8 + 1, 0xFF);
+  for (size_t i = 0; i < size; ++i) {
+    status.push_back(i % 5);
+    ids.push_back(i);
+    countries.push_back(names.at(i % names.size()));
+    if (i % 10 == 0) {
+      valid[i >> 3] &= ~(1 << (i & 7));
+    }
+  }
+
+  FLAGS_BITMAP_VALUES = 100;
+  Batch batch(table, size);
+  batch.add({ { times.data(), nullptr },
+              { status.data(), valid.data() },
+              { countries.data(), nullptr },
+              { kinds.data(), nullptr },
+              { ids.data(), nullptr } },
+            size);
+  batch.seal();
+  FLAGS_BITMAP_VALUES = 4096;
+
+  EXPECT_EQ(batch.bitmapValues("status"), 5);
+  EXPECT_EQ(batch.bitmapValues("country"), 4);
+  EXPECT_EQ(batch.bitmapValues("id"), 0);
+  EXPECT_EQ(batch.bitmapValues("_time_"), 0);
+  EXPECT_EQ(batch.countBitmap("status", [](const std::any& v) { return std::any_cast<int64_t>(v) == 0; }), 100);
+  EXPECT_EQ(batch.countBitmap("country", [](const std::any& v) { return std::any_cast<std::string_view>(v) == "us"; }),
+            250);
+  EXPECT_GT(batch.memory().columns.at(1).bloom, 0);
+
+  // blocks are evaluated by counts of matched rows
+  using nebula::surface::eval::BlockEval;
+  using nebula::surface::eval::column;
+  using nebula::surface::eval::constant;
+  using SV = std::string_view;
+  EXPECT_EQ(nebula::surface::eval::eq<int32_t, int32_t>(column<int32_t>("status"), constant(7))->eval(batch),
+            BlockEval::NONE);
+  EXPECT_EQ(nebula::surface::eval::eq<SV, SV>(column<SV>("country"), constant(std::string("us")))->eval(batch),
+            BlockEval::PARTIAL);
+  EXPECT_EQ(nebula::surface::eval::eq<SV, SV>(column<SV>("kind"), constant(std::string("log")))->eval(batch),
+            BlockEval::ALL);
+  EXPECT_EQ(nebula::surface::eval::neq<SV, SV>(column<SV>("kind"), constant(std::string("log")))->eval(batch),
+            BlockEval::NONE);
+
+  // rows selected by bitmaps should be the same as row by row evaluation
+  auto accessor = batch.makeAccessor();
+  const nebula::surface::eval::Seeker seeker = [&accessor](size_t row) -> const nebula::surface::Accessor& {
+    return accessor->seek(row);
+  };
+
+  nebula::surface::eval::EvalContext ctx{ false };
+  auto verify = [&](const nebula::surface::eval::ValueEval& filter) {
+    nebula::surface::eval::Selection selection;
+    selection.reset(0, size);
+    filter.select(ctx, batch, seeker, selection);
+
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < size; ++i) {
+      ctx.reset(seeker(i));
+      if (filter.eval<bool>(ctx).value_or(false)) {
+        expected.push_back(i);
+      }
+    }
+
+    EXPECT_EQ(std::vector<size_t>(selection.begin(), selection.end()), expected);
+  };
+
+  for (auto v : { 0, 3, 7 }) {
+    verify(*nebula::surface::eval::eq<int32_t, int32_t>(column<int32_t>("status"), constant(v)));
+    verify(*nebula::surface::eval::neq<int32_t, int32_t>(column<int32_t>("status"), constant(v)));
+  }
+
+  for (auto v : { "us", "fr", "xx" }) {
+    verify(*nebula::surface::eval::eq<SV, SV>(column<SV>("country"), constant(std::string(v))));
+    verify(*nebula::surface::eval::neq<SV, SV>(column<SV>("country"), constant(std::string(v))));
+  }
+}
+
+TEST(BatchTest, TestSyntheticData) {
+  nebula::meta::Table table{ "synthetic",
+                             TypeSerializer::from("ROW<_time_:bigint, id:int, event:string, value:double>"),
+                             {},
+                             {} };
+  const auto gens = Synthetic::parse("id:uniform:100:0.1,event:zipf:50:0:1.5,value:time:10");
+  ASSERT_EQ(gens.size(), 3);
+  EXPECT_THROW(Synthetic::parse("id:normal"), nebula::common::NException);
+
+  const size_t rows = 10000;
+  Synthetic synthetic{ table, { 1000, 2000 }, gens };
+  auto batches = synthetic.generate(rows, 7, { 1000, 2000 });
+  ASSERT_EQ(batches.size(), 1);
+  const auto& batch = *batches.at(0);
+  EXPECT_EQ(batch.getRows(), rows);
+
+  // the same seed generates the same rows
+  const auto& same = *synthetic.generate(rows, 7, { 1000, 2000 }).at(0);
+  auto a1 = batch.makeAccessor();
+  auto a2 = same.makeAccessor();
+  size_t nulls = 0;
+  int64_t last = 0;
+  nebula::common::unordered_map<std::string, size_t> events;
+  for (size_t i = 0; i < rows; ++i) {
+    const auto& r1 = a1->seek(i);
+    const auto& r2 = a2->seek(i);
+    const auto time = r1.readLong("_time_").value();
+    EXPECT_EQ(time, r2.readLong("_time_").value());
+    EXPECT_GE(time, last);
+    EXPECT_LE(time, 2000);
+    last = time;
+
+    const auto id = r1.readInt("id");
+    EXPECT_EQ(id, r2.readInt("id"));
+    if (!id.has_value()) {
+      ++nulls;
+    } else {
+      EXPECT_LT(id.value(), 100);
+    }
+
+    events[std::string(r1.readString("event").value())]++;
+
+    // value grows with time
+    const auto value = r1.readDouble("value").value();
+    EXPECT_LE(std::abs(value - (time - 1000) / 100), 1);
+  }
+
+  EXPECT_NEAR(nulls, rows / 10, rows / 50);
+  EXPECT_LE(events.size(), 50);
+  EXPECT_GT(events.at("event-0"), events.at("event-1"));
+  EXPECT_GT(events.at("event-0"), rows / 4);
+
+  // blocks of a partitioned table are generated in parallel by partition
+  nebula::meta::TestPartitionedTable partitioned;
+  Synthetic parallel{ partitioned, { 0, 4000 } };
+  std::mutex mutex;
+  std::vector<std::pair<size_t, std::shared_ptr<Batch>>> blocks;
+  parallel.generate(4, 1000, 1, 4, [&](size_t block, std::shared_ptr<Batch> b) {
+    std::lock_guard<std::mutex> lock(mutex);
+    blocks.emplace_back(block, std::move(b));
+  });
+
+  size_t total = 0;
+  for (const auto& b : blocks) {
+    total += b.second->getRows();
+    EXPECT_LT(b.second->getPid(), partitioned.pod()->capacity());
+    auto accessor = b.second->makeAccessor();
+    const auto time = accessor->seek(0).readLong("_time_").value();
+    EXPECT_GE(time, static_cast<int64_t>(b.first * 1000));
+    EXPECT_LE(time, static_cast<int64_t>(b.first * 1000 + 1000));
+  }
+  EXPECT_EQ(total, 4000);
+  EXPECT_GT(blocks.size(), 4);
 }
 
 } // namespace test
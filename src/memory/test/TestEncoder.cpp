@@ -23,9 +23,12 @@
 #include "memory/Batch.h"
 #include "memory/DataNode.h"
 #include "memory/FlatRow.h"
+#include "memory/encode/BitPackColumn.h"
+#include "memory/encode/DeltaColumn.h"
 #include "memory/encode/DictEncoder.h"
 #include "memory/encode/RleDecoder.h"
 #include "memory/encode/RleEncoder.h"
+#include "memory/encode/SharedDict.h"
 #include "memory/encode/Utils.h"
 #include "meta/Table.h"
 #include "surface/DataSurface.h"
@@ -159,6 +162,75 @@ TEST(RleTest, TestZigzag) {
   }
 }
 
+TEST(DeltaTest, TestNearlySorted) {
+  // time with jitters, a few values go back
+  constexpr size_t count = 5000;
+  std::vector<int64_t> values(count);
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = 1600000000 + (int64_t)i * 10 - (i % 7 == 0 ? 25 : 0);
+  }
+
+  nebula::memory::encode::DeltaColumn<int64_t> column(1024);
+  EXPECT_TRUE(column.encode(count, [&values](size_t i) { return values[i]; }));
+  EXPECT_FALSE(column.sorted());
+  EXPECT_LT(column.size(), count * sizeof(int64_t) / 4);
+  for (auto i : { 4999, 0, 1023, 1024, 3000, 1 }) {
+    EXPECT_EQ(column.read(i), values[i]);
+  }
+
+  std::vector<int64_t> decoded(count);
+  column.read(0, count, decoded.data());
+  EXPECT_EQ(decoded, values);
+
+  // no row out of the range has value in it
+  const int64_t low = 1600020000;
+  const int64_t high = 1600030000;
+  const auto range = column.rows(low, high);
+  EXPECT_LT(range.first, range.second);
+  for (size_t i = 0; i < count; ++i) {
+    if (values[i] >= low && values[i] <= high) {
+      EXPECT_TRUE(i >= range.first && i < range.second);
+    }
+  }
+
+  // deltas beyond 32 bits are not encoded
+  nebula::memory::encode::DeltaColumn<int64_t> wide(1024);
+  EXPECT_FALSE(wide.encode(2, [](size_t i) { return i == 0 ? 0 : std::numeric_limits<int64_t>::max(); }));
+}
+
+TEST(BitPackTest, TestPackedRange) {
+  // values around a few different bases, a constant chunk and full 64 bit range
+  constexpr size_t count = 3000;
+  std::vector<int64_t> values(count);
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = (i < 512 ? 42 : (int64_t)(i / 1000) * 100000 + (int64_t)(i * 37 % 301) - 150);
+  }
+  values[2999] = std::numeric_limits<int64_t>::min();
+  values[2998] = std::numeric_limits<int64_t>::max();
+
+  nebula::memory::encode::BitPackColumn<int64_t> column(1024);
+  column.encode(count, [&values](size_t i) { return values[i]; });
+  for (auto i : { 2999, 0, 511, 512, 1000, 2998, 1 }) {
+    EXPECT_EQ(column.read(i), values[i]);
+  }
+
+  std::vector<int64_t> decoded(count - 100);
+  column.read(100, decoded.size(), decoded.data());
+  for (size_t i = 0; i < decoded.size(); ++i) {
+    EXPECT_EQ(decoded[i], values[100 + i]);
+  }
+
+  // range predicates evaluated on packed values
+  std::vector<uint8_t> mask(count);
+  for (auto [low, high] : std::vector<std::pair<int64_t, int64_t>>{
+         { 42, 42 }, { -150, 0 }, { 100000, 100100 }, { 100, 50 }, { std::numeric_limits<int64_t>::min(), 99999 } }) {
+    column.match(low, high, 0, count, mask.data());
+    for (size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(mask[i], values[i] >= low && values[i] <= high);
+    }
+  }
+}
+
 TEST(DictTest, TestDictionary) {
   std::string data[] = { "139", "222", "34543245", "23232", "232334" };
   nebula::memory::encode::DictEncoder dict;
@@ -171,13 +243,77 @@ TEST(DictTest, TestDictionary) {
     indices[i] = dict.set(data[i % size]);
   }
 
-  dict.seal();
+  // codes are changed to follow item order at seal
+  auto codes = dict.seal();
+  EXPECT_EQ(codes.size(), size);
 
   // decode
   for (size_t i = 0; i < 100; ++i) {
-    LOG(INFO) << "item " << i << " stored at dict " << indices[i];
-    EXPECT_EQ(dict.get(indices[i]), data[i % size]);
+    LOG(INFO) << "item " << i << " stored at dict " << codes[indices[i]];
+    EXPECT_EQ(dict.get(codes[indices[i]]), data[i % size]);
+  }
+}
+
+TEST(DictTest, TestOrderedCodes) {
+  nebula::memory::encode::DictEncoder dict;
+  constexpr auto items = 5000;
+
+  // enough items to grow the lookup table several times
+  std::vector<int32_t> indices;
+  for (size_t i = 0; i < 3 * items; ++i) {
+    indices.push_back(dict.set(fmt::format("item-{0}", (i * 7919) % items)));
+  }
+
+  EXPECT_EQ(dict.size(), items);
+  auto codes = dict.seal();
+  for (size_t i = 0; i < indices.size(); ++i) {
+    EXPECT_EQ(dict.get(codes[indices[i]]), fmt::format("item-{0}", (i * 7919) % items));
+  }
+
+  // code order is the same as item order
+  for (int32_t i = 1; i < dict.size(); ++i) {
+    EXPECT_LT(dict.get(i - 1), dict.get(i));
   }
+
+  EXPECT_EQ(dict.lowerBound(""), 0);
+  EXPECT_EQ(dict.get(dict.lowerBound("item-42")), "item-42");
+  EXPECT_EQ(dict.get(dict.lowerBound("item-42a")), "item-43");
+  EXPECT_EQ(dict.lowerBound("z"), items);
+
+  // codes already in item order are not changed
+  nebula::memory::encode::DictEncoder sorted;
+  sorted.set("a");
+  sorted.set("b");
+  sorted.set("a");
+  EXPECT_TRUE(sorted.seal().empty());
+}
+
+TEST(DictTest, TestSharedDictionary) {
+  using nebula::memory::encode::SharedDict;
+  auto dict = SharedDict::of("dict.test", "name");
+  EXPECT_EQ(SharedDict::of("dict.test", "name"), dict);
+  EXPECT_NE(SharedDict::of("dict.test", "tag"), dict);
+
+  // codes are given in order of arrival across pages and never change
+  constexpr auto items = 5000;
+  for (size_t i = 0; i < 2 * items; ++i) {
+    EXPECT_EQ(dict->set(fmt::format("item-{0}", i % items)), static_cast<int32_t>(i % items));
+  }
+
+  EXPECT_EQ(dict->size(), items);
+  EXPECT_EQ(dict->get(4096), "item-4096");
+  EXPECT_EQ(dict->set(""), items);
+  EXPECT_EQ(dict->get(items), "");
+  EXPECT_FALSE(dict->full());
+
+  // a dictionary no longer held is released, the next one starts over
+  dict = nullptr;
+  EXPECT_EQ(SharedDict::of("dict.test", "name")->size(), 0);
+
+  SharedDict small(2);
+  small.set("a");
+  small.set("b");
+  EXPECT_TRUE(small.full());
 }
 
 #undef SIZE
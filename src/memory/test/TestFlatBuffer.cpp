@@ -16,6 +16,7 @@
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <set>
 #include <valarray>
 
 #include "common/Memory.h"
@@ -185,6 +186,74 @@ TEST(FlatBufferTest, TestSerde) {
   // delete[] buffer;
 }
 
+TEST(FlatBufferTest, TestKeepRows) {
+  nebula::meta::TestTable test;
+  FlatBuffer fb(test.schema(), test.testFields());
+  constexpr auto rows2test = 100;
+  MockRowData row(Evidence::unix_timestamp());
+  for (auto i = 0; i < rows2test; ++i) {
+    fb.add(row);
+  }
+
+  std::vector<std::string> lines;
+  for (auto i = 0; i < rows2test; ++i) {
+    lines.push_back(line(fb.row(i)));
+  }
+
+  // kept rows are served in the given order, and survive serde
+  const std::vector<size_t> keep{ 7, 3, 99, 0, 42 };
+  fb.keep(keep);
+  EXPECT_EQ(fb.getRows(), keep.size());
+
+  auto size = fb.prepareSerde();
+  auto buffer = static_cast<NByte*>(nebula::common::Pool::getDefault().allocate(size));
+  EXPECT_EQ(size, fb.serialize(buffer));
+  FlatBuffer fb2(test.schema(), test.testFields(), buffer);
+  EXPECT_EQ(fb2.getRows(), keep.size());
+  for (size_t i = 0; i < keep.size(); ++i) {
+    EXPECT_EQ(line(fb.row(i)), lines.at(keep.at(i)));
+    EXPECT_EQ(line(fb2.row(i)), lines.at(keep.at(i)));
+  }
+}
+
+TEST(FlatBufferTest, TestStringDedup) {
+  auto schema = TypeSerializer::from("ROW<id:int, event:string>");
+  nebula::surface::eval::Fields f;
+  f.emplace_back(nebula::surface::eval::constant(1));
+  f.emplace_back(nebula::surface::eval::constant("2"));
+
+  // a few distinct events repeat in all rows, rolled back rows don't leave stale strings behind
+  const std::vector<std::string> events{ "event-of-type-a", "event-of-type-b", "event-of-type-c", "" };
+  constexpr auto rows2test = 4000;
+  FlatBuffer repeated(schema, f);
+  FlatBuffer unique(schema, f);
+  for (auto i = 0; i < rows2test; ++i) {
+    const auto event = events.at(i % events.size());
+    repeated.add(nebula::surface::StaticRow{ i, i, event, nullptr, true, 'a', 1, 1.0 });
+    if (i % 3 == 0) {
+      repeated.rollback();
+      repeated.add(nebula::surface::StaticRow{ i, i, event, nullptr, true, 'a', 1, 1.0 });
+    }
+
+    const auto value = fmt::format("{0}-{1}", event, i);
+    unique.add(nebula::surface::StaticRow{ i, i, value, nullptr, true, 'a', 1, 1.0 });
+  }
+
+  // every row still has 8 bytes of range in main, but only distinct strings take data bytes
+  EXPECT_EQ(repeated.getRows(), rows2test);
+  EXPECT_GT(unique.bytes() - repeated.bytes(), rows2test * 10);
+
+  auto size = repeated.prepareSerde();
+  auto buffer = static_cast<NByte*>(nebula::common::Pool::getDefault().allocate(size));
+  EXPECT_EQ(size, repeated.serialize(buffer));
+  FlatBuffer fb2(schema, f, buffer);
+  EXPECT_EQ(fb2.getRows(), rows2test);
+  for (auto i = 0; i < rows2test; ++i) {
+    EXPECT_EQ(fb2.row(i).readString("event"), events.at(i % events.size()));
+    EXPECT_EQ(unique.row(i).readString("event"), fmt::format("{0}-{1}", events.at(i % events.size()), i));
+  }
+}
+
 TEST(FlatBufferTest, TestHashFlatSerde) {
   auto schema = TypeSerializer::from("ROW<id:int, count:int>");
 
@@ -243,6 +312,174 @@ TEST(FlatBufferTest, TestHashFlatSerde) {
   }
 }
 
+TEST(FlatBufferTest, TestHashFlatMixedKeys) {
+  // string key makes keys not optimal, they go through normalized key layout
+  auto schema = TypeSerializer::from("ROW<id:int, event:string, flag:bool>");
+  nebula::surface::eval::Fields f;
+  f.reserve(3);
+  f.emplace_back(nebula::surface::eval::constant(1));
+  f.emplace_back(nebula::surface::eval::constant("2"));
+  f.emplace_back(nebula::surface::eval::constant(true));
+  HashFlat hf(schema, f);
+
+  const std::vector<std::string> events{ "a", "bb", "ccc", "" };
+  std::set<std::string> keys;
+  for (auto i = 0; i < 1000; ++i) {
+    const auto& event = events.at(i % events.size());
+    bool flag = (i % 5) == 0;
+    nebula::surface::StaticRow row{ i, i % 7, event, nullptr, flag, 'a', 1, 1.0 };
+    auto exists = !keys.emplace(fmt::format("{0}-{1}-{2}", i % 7, event, flag)).second;
+    EXPECT_EQ(hf.update(row), exists);
+  }
+
+  EXPECT_EQ(hf.getRows(), keys.size());
+  for (size_t i = 0; i < hf.getRows(); ++i) {
+    const auto& r = hf.row(i);
+    EXPECT_EQ(keys.count(fmt::format("{0}-{1}-{2}", r.readInt("id"), r.readString("event"), r.readBool("flag"))), 1);
+  }
+}
+
+TEST(FlatBufferTest, TestHashFlatMerge) {
+  // fixed width keys laid out sequentially, rows of another flat are adopted by bytes
+  auto schema = TypeSerializer::from("ROW<id:int, time:long, flag:bool>");
+  nebula::surface::eval::Fields f;
+  f.reserve(3);
+  f.emplace_back(nebula::surface::eval::constant(1));
+  f.emplace_back(nebula::surface::eval::constant(2L));
+  f.emplace_back(nebula::surface::eval::constant(true));
+
+  auto build = [&schema, &f](int from, int to) {
+    auto hf = std::make_unique<HashFlat>(schema, f);
+    for (auto i = from; i < to; ++i) {
+      nebula::surface::StaticRow row{ i * 10, i, "", nullptr, i % 2 == 0, 'a', 1, 1.0 };
+      hf->update(row);
+    }
+
+    return hf;
+  };
+
+  auto hf = build(0, 100);
+  hf->merge(build(50, 150));
+  EXPECT_EQ(hf->getRows(), 150);
+
+  // a serialized flat has no key index, its rows are hashed again when merged
+  auto other = build(100, 200);
+  auto size = other->prepareSerde();
+  auto buffer = static_cast<NByte*>(nebula::common::Pool::getDefault().allocate(size));
+  EXPECT_EQ(size, other->serialize(buffer));
+  hf->merge(std::make_unique<FlatBuffer>(schema, f, buffer));
+  EXPECT_EQ(hf->getRows(), 200);
+
+  std::set<int> ids;
+  for (size_t i = 0; i < hf->getRows(); ++i) {
+    const auto& r = hf->row(i);
+    auto id = r.readInt(0);
+    EXPECT_EQ(r.readLong(1), id * 10);
+    EXPECT_EQ(r.readBool(2), id % 2 == 0);
+    ids.insert(id);
+  }
+
+  EXPECT_EQ(ids.size(), 200);
+  EXPECT_EQ(*ids.begin(), 0);
+  EXPECT_EQ(*ids.rbegin(), 199);
+
+  // a merged row can still be matched by update
+  nebula::surface::StaticRow row{ 1990, 199, "", nullptr, false, 'a', 1, 1.0 };
+  EXPECT_TRUE(hf->update(row));
+  EXPECT_EQ(hf->getRows(), 200);
+}
+
+TEST(FlatBufferTest, TestHashFlatAppend) {
+  // appended rows are not deduped until they are merged into another hash flat
+  auto schema = TypeSerializer::from("ROW<id:int, time:long, flag:bool>");
+  nebula::surface::eval::Fields f;
+  f.reserve(3);
+  f.emplace_back(nebula::surface::eval::constant(1));
+  f.emplace_back(nebula::surface::eval::constant(2L));
+  f.emplace_back(nebula::surface::eval::constant(true));
+
+  auto appended = std::make_unique<HashFlat>(schema, f);
+  for (auto i = 0; i < 100; ++i) {
+    nebula::surface::StaticRow row{ i % 40, i % 40, "", nullptr, i % 2 == 0, 'a', 1, 1.0 };
+    appended->append(row);
+  }
+  EXPECT_EQ(appended->getRows(), 100);
+
+  HashFlat hf(schema, f);
+  for (auto i = 30; i < 50; ++i) {
+    nebula::surface::StaticRow row{ i, i, "", nullptr, i % 2 == 0, 'a', 1, 1.0 };
+    hf.update(row);
+  }
+
+  hf.merge(std::move(appended));
+  EXPECT_EQ(hf.getRows(), 50);
+
+  std::set<int> ids;
+  for (size_t i = 0; i < hf.getRows(); ++i) {
+    const auto& r = hf.row(i);
+    EXPECT_EQ(r.readLong(1), r.readInt(0));
+    EXPECT_TRUE(ids.insert(r.readInt(0)).second);
+  }
+  EXPECT_EQ(*ids.begin(), 0);
+  EXPECT_EQ(*ids.rbegin(), 49);
+}
+
+// a row giving value and validity of every column in one evaluation
+class EvaluatedRow : public nebula::surface::StaticRow {
+public:
+  EvaluatedRow(int i, bool null) : StaticRow(i, i, "", nullptr, false, 'a', 1, 1.0), null_{ null }, evals_{ 0 } {}
+
+  bool isNull(nebula::surface::IndexType) const override {
+    throw NException("null is given by value");
+  }
+
+  template <nebula::type::Kind K>
+  std::optional<typename nebula::type::TypeTraits<K>::CppType> value(nebula::surface::IndexType i) const {
+    ++evals_;
+    if (i == 1 && null_) {
+      return std::nullopt;
+    }
+
+    return nebula::surface::read<K>(*this, i);
+  }
+
+  inline size_t evals() const {
+    return evals_;
+  }
+
+private:
+  bool null_;
+  mutable size_t evals_;
+};
+
+TEST(FlatBufferTest, TestEvaluatedRow) {
+  static_assert(nebula::surface::Evaluated<EvaluatedRow>::value);
+  static_assert(!nebula::surface::Evaluated<nebula::surface::StaticRow>::value);
+
+  auto schema = TypeSerializer::from("ROW<id:int, time:long>");
+  nebula::surface::eval::Fields f;
+  f.reserve(2);
+  f.emplace_back(nebula::surface::eval::constant(1));
+  f.emplace_back(nebula::surface::eval::constant(2L));
+
+  FlatBuffer fb(schema, f);
+  for (auto i = 0; i < 10; ++i) {
+    EvaluatedRow row{ i, i % 2 == 0 };
+    fb.add(row);
+    EXPECT_EQ(row.evals(), 2);
+  }
+
+  EXPECT_EQ(fb.getRows(), 10);
+  for (auto i = 0; i < 10; ++i) {
+    const auto& r = fb.row(i);
+    EXPECT_EQ(r.readInt(0), i);
+    EXPECT_EQ(r.isNull(1), i % 2 == 0);
+    if (i % 2 != 0) {
+      EXPECT_EQ(r.readLong(1), i);
+    }
+  }
+}
+
 } // namespace test
 } // namespace memory
 } // namespace nebula
\ No newline at end of file
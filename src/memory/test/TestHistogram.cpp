@@ -38,6 +38,7 @@ using nebula::surface::eval::BoolHistogram;
 using nebula::surface::eval::Histogram;
 using nebula::surface::eval::IntHistogram;
 using nebula::surface::eval::RealHistogram;
+using nebula::surface::eval::StringHistogram;
 
 TEST(HistogramTest, TestHistogramTypes) {
   std::unique_ptr<Histogram> histo = std::make_unique<Histogram>();
@@ -108,7 +109,7 @@ TEST(HistogramTest, TestHistogramTypes) {
 
 #undef REAL_TYPE_TEST
 
-  // other types are all using basic histogram with only count
+  // string histogram records lexicographic range
   {
     nebula::meta::Column column;
     auto m = TypeDataFactory::createMeta(nebula::type::Kind::VARCHAR, column);
@@ -117,6 +118,18 @@ TEST(HistogramTest, TestHistogramTypes) {
     m->histogram("xyz");
     const auto& h = m->histogram();
     EXPECT_EQ(h->count, 3);
+    const auto& sh = m->histogram<StringHistogram>();
+    EXPECT_EQ(sh.min(), "abc");
+    EXPECT_EQ(sh.max(), "xyz");
+
+    // serde and merge
+    auto sh2 = std::dynamic_pointer_cast<StringHistogram>(nebula::surface::eval::from(sh.toString()));
+    EXPECT_EQ(sh2->count, 3);
+    EXPECT_EQ(sh2->min(), "abc");
+    sh2->merge(StringHistogram(1, "aaa", "b"));
+    EXPECT_EQ(sh2->count, 4);
+    EXPECT_EQ(sh2->min(), "aaa");
+    EXPECT_EQ(sh2->max(), "xyz");
   }
 }
 
@@ -16,6 +16,7 @@
 
 #include "ClusterInfo.h"
 
+#include "Lookup.h"
 #include "type/Serde.h"
 
 namespace YAML {
@@ -210,6 +211,18 @@ Column col(const YAML::Node& settings) {
   std::string fm;
   EVAL_SETTING(from_macro, fm, std::string)
 
+  bool s = false;
+  EVAL_SETTING(sorted, s, bool)
+
+  bool sd = false;
+  EVAL_SETTING(shared_dict, sd, bool)
+
+  bool t = false;
+  EVAL_SETTING(tokens, t, bool)
+
+  bool bm = false;
+  EVAL_SETTING(bitmap, bm, bool)
+
   // if access spec defined
   const auto& access = settings["access"];
   AccessSpec as;
@@ -230,7 +243,18 @@ Column col(const YAML::Node& settings) {
     pi.chunk = chunk ? chunk.as<size_t>() : 1;
   }
 
-  return Column{ bf, d, c, std::move(dv), std::move(fm), std::move(as), std::move(pi) };
+  // if the column is enriched by a lookup dictionary
+  const auto& lookup = settings["lookup"];
+  LookupInfo li;
+  if (lookup) {
+    N_ENSURE(lookup["source"] && lookup["key"], "lookup requires source and key");
+    li.source = lookup["source"].as<std::string>();
+    li.key = lookup["key"].as<std::string>();
+    const auto& refresh = lookup["refresh"];
+    li.refresh = refresh ? refresh.as<size_t>() : 0;
+  }
+
+  return Column{ bf, d, c, std::move(dv), std::move(fm), std::move(as), std::move(pi), s, std::move(li), sd, t, bm };
 
 #undef EVAL_SETTING
 }
@@ -414,6 +438,87 @@ BucketInfo asBucketInfo(const YAML::Node& node) {
   return BucketInfo::empty();
 }
 
+/** [example]
+    rollups:
+      - name: hourly
+        dimensions: [country, device]
+        metrics: [duration]
+        window: 3600
+        # optional, hours to keep rollup blocks, raw rows retention (max-hr) by default
+        max-hr: 720
+*/
+std::vector<RollupSpec> asRollups(const YAML::Node& node) {
+  std::vector<RollupSpec> rollups;
+  if (node) {
+    for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
+      const auto& r = *it;
+      RollupSpec rollup;
+      rollup.name = r["name"].as<std::string>();
+      rollup.dimensions = r["dimensions"].as<std::vector<std::string>>();
+      rollup.metrics = r["metrics"] ? r["metrics"].as<std::vector<std::string>>() : std::vector<std::string>{};
+      rollup.window = r["window"] ? r["window"].as<size_t>() : Evidence::HOUR_SECONDS;
+      rollup.retention = r["max-hr"] ? r["max-hr"].as<double>() * Evidence::HOUR_SECONDS : 0;
+      rollups.push_back(std::move(rollup));
+    }
+  }
+
+  return rollups;
+}
+
+/** [example]
+    filter:
+      - column: event_time
+        op: ">="
+        value: 1600000000
+      - column: user_id
+        op: notnull
+*/
+std::vector<FilterSpec> asFilters(const YAML::Node& node, const std::string& schema) {
+  std::vector<FilterSpec> filters;
+  if (node) {
+    auto type = TypeSerializer::from(schema);
+    for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
+      const auto& f = *it;
+      FilterSpec filter;
+      filter.column = f["column"].as<std::string>();
+      filter.op = FilterOpUtils::from(f["op"].as<std::string>());
+      filter.value = f["value"] ? f["value"].as<std::string>() : "";
+      N_ENSURE(filter.op != FilterOp::UNKNOWN, fmt::format("unknown filter op on column {0}", filter.column));
+      N_ENSURE(filter.op == FilterOp::NOTNULL || f["value"], fmt::format("filter value is required on column {0}", filter.column));
+      N_ENSURE_NOT_NULL(type->find(filter.column), fmt::format("filter column not in schema: {0}", filter.column));
+      filters.push_back(std::move(filter));
+    }
+  }
+
+  return filters;
+}
+
+/** [example]
+    derived:
+      - name: clicks
+        # optional, all columns by default
+        columns: [user_id, country]
+        filter:
+          - column: event
+            op: "="
+            value: click
+*/
+std::vector<DerivedSpec> asDerived(const YAML::Node& node, const std::string& schema) {
+  std::vector<DerivedSpec> derived;
+  if (node) {
+    for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
+      const auto& d = *it;
+      DerivedSpec spec;
+      spec.name = d["name"].as<std::string>();
+      spec.columns = d["columns"] ? d["columns"].as<std::vector<std::string>>() : std::vector<std::string>{};
+      spec.filters = asFilters(d["filter"], schema);
+      derived.push_back(std::move(spec));
+    }
+  }
+
+  return derived;
+}
+
 // load table from a given table definition section
 // td = table definition
 std::shared_ptr<TableSpec> loadTable(std::string name, const YAML::Node& td) {
@@ -443,7 +548,7 @@ std::shared_ptr<TableSpec> loadTable(std::string name, const YAML::Node& td) {
   // in fact, we allow multiple tables connecting to the same streaming topic
   // max-hr could be fractional value to help us get granularity to seconds
   try {
-    return std::make_shared<TableSpec>(
+    auto spec = std::make_shared<TableSpec>(
       name,
       retention["max-mb"].as<size_t>(),
       retention["max-hr"].as<double>() * Evidence::HOUR_SECONDS,
@@ -466,14 +571,51 @@ std::shared_ptr<TableSpec> loadTable(std::string name, const YAML::Node& td) {
       asMacroValues(td["macros"]),
       asHeaders(td["headers"]),
       (td["optimal_block_size"] ? td["optimal_block_size"].as<size_t>() : 0));
+
+    // validate rollups by building their tables
+    spec->rollups = asRollups(td["rollups"]);
+    for (const auto& rollup : spec->rollups) {
+      spec->to(rollup);
+    }
+
+    // rows are filtered by source columns when ingested
+    spec->filters = asFilters(td["filter"], spec->schema);
+
+    // validate derived tables by building their tables
+    spec->derived = asDerived(td["derived"], spec->schema);
+    for (const auto& derived : spec->derived) {
+      spec->to(derived);
+    }
+
+    // cold blocks older than compress-hr are kept compressed
+    if (retention["compress-hr"]) {
+      spec->compress_seconds = retention["compress-hr"].as<double>() * Evidence::HOUR_SECONDS;
+    }
+
+    // every spec is ingested by this many nodes
+    if (td["replicas"]) {
+      spec->replicas = std::max<size_t>(1, td["replicas"].as<size_t>());
+    }
+
+    return spec;
   } catch (std::exception& ex) {
     LOG(ERROR) << "Error creating table spec: " << name << " - " << ex.what();
     return nullptr;
   }
 }
 
+// signature of a yaml section by its normalized text
+inline size_t sign(const YAML::Node& node) {
+  const auto text = YAML::Dump(node);
+  return nebula::common::Hasher::hash64(text.data(), text.size());
+}
+
+// build specs of table definitions, a table whose definition is not changed since last load reuses current spec
 inline void processTableDefinitions(
   const unordered_map<std::string, YAML::Node>& defs,
+  const unordered_map<std::string, TableSpecPtr>& current,
+  const unordered_map<std::string, size_t>& lastSigns,
+  unordered_map<std::string, size_t>& signs,
   unordered_set<std::string>& names,
   TableSpecSet& tables) noexcept {
   // loading all dynamic table definitions from service calls
@@ -487,6 +629,15 @@ inline void processTableDefinitions(
     // put the name in
     names.emplace(name);
 
+    const auto s = sign(it->second);
+    signs.emplace(name, s);
+    auto last = lastSigns.find(name);
+    auto spec = current.find(name);
+    if (last != lastSigns.end() && last->second == s && spec != current.end()) {
+      tables.emplace(spec->second);
+      continue;
+    }
+
     // max-hr could be fractional value to help us get granularity to seconds
     auto tsp = loadTable(name, it->second);
     if (tsp) {
@@ -516,10 +667,10 @@ void ClusterInfo::load(const std::string& file, CreateMetaDB createDb) {
 
   // load all nodes configured for the cluster
   topLevels++;
-  if (server_.discovery == Discovery::CONFIG) {
+  const auto& nodes = config["nodes"];
+  const auto nodesSign = (nodes ? sign(nodes) : 0) ^ server_.anode;
+  if (server_.discovery == Discovery::CONFIG && nodesSign != nodesSign_) {
     NNodeSet nodeSet;
-    const auto& nodes = config["nodes"];
-
     for (size_t i = 0, size = nodes.size(); i < size; ++i) {
       const auto& node = nodes[i]["node"];
       nodeSet.emplace(NRole::NODE, node["host"].as<std::string>(), node["port"].as<size_t>());
@@ -533,6 +684,7 @@ void ClusterInfo::load(const std::string& file, CreateMetaDB createDb) {
     // replace the default node manager use pre-configured one
     // this will overwrite all existing node states - "bad->active" as reset event
     this->nodeManager_ = NodeManager::create(std::move(nodeSet));
+    nodesSign_ = nodesSign;
   }
 
   // load all table specs
@@ -548,25 +700,41 @@ void ClusterInfo::load(const std::string& file, CreateMetaDB createDb) {
   }
 
   // load tables from config first and then runtime tables
-  processTableDefinitions(configTables, nameSet, tableSet);
-  processTableDefinitions(runtimeTables_, nameSet, tableSet);
+  // only tables added or changed since last load are built
+  unordered_map<std::string, TableSpecPtr> current;
+  for (const auto& table : tables_) {
+    current.emplace(table->name, table);
+  }
+
+  unordered_map<std::string, size_t> signs;
+  processTableDefinitions(configTables, current, tableSigns_, signs, nameSet, tableSet);
+  processTableDefinitions(runtimeTables_, current, tableSigns_, signs, nameSet, tableSet);
+  std::swap(tableSigns_, signs);
 
   // update table spec
   // 1. if table is not found in new set, remove it from tables_
-  // 2. if table is new, add it to tables_
+  // 2. if table is new or changed, put it in tables_
   // 3. if table is expired, remove it.
-  for (auto itr = tables_.cbegin(); itr != tables_.cend(); ++itr) {
+  for (auto itr = tables_.begin(); itr != tables_.end();) {
     // table is deleted or expired
-    const auto& ptr = *itr;
-    const auto& ttl = ptr->ttl;
-    if ((ttl.never() && !nameSet.contains(ptr->name)) || ttl.expired()) {
-      tables_.erase(itr);
+    const auto& ttl = (*itr)->ttl;
+    if ((ttl.never() && !nameSet.contains((*itr)->name)) || ttl.expired()) {
+      itr = tables_.erase(itr);
+      continue;
     }
+
+    ++itr;
   }
 
-  // add new table if not existing
+  // a changed table replaces its current spec
   for (auto& newTb : tableSet) {
-    if (!tables_.contains(newTb)) {
+    auto found = tables_.find(newTb);
+    if (found == tables_.end() || *found != newTb) {
+      if (found != tables_.end()) {
+        LOG(INFO) << "Table definition changed: " << newTb->name;
+        tables_.erase(found);
+      }
+
       tables_.emplace(newTb);
     }
   }
@@ -574,9 +742,38 @@ void ClusterInfo::load(const std::string& file, CreateMetaDB createDb) {
   // std::swap(tables_, tableSet);
   stateChanged_ = false;
 
+  // lookup tables are optional, each is loaded from a "key,value" file or given by an inline map
+  // lookups:
+  //   country:
+  //     file: /etc/nebula/country.csv
+  //   os:
+  //     values: { 1: ios, 2: android }
+  const auto& lookups = config["lookups"];
+  if (lookups) {
+    topLevels++;
+    for (YAML::const_iterator it = lookups.begin(); it != lookups.end(); ++it) {
+      const auto name = it->first.as<std::string>();
+      const auto& def = it->second;
+      if (def["file"]) {
+        Lookups::singleton().put(Lookups::load(name, def["file"].as<std::string>()));
+        continue;
+      }
+
+      std::vector<std::string> keys;
+      std::vector<std::string> values;
+      const auto& map = def["values"];
+      for (YAML::const_iterator kv = map.begin(); kv != map.end(); ++kv) {
+        keys.push_back(kv->first.as<std::string>());
+        values.push_back(kv->second.as<std::string>());
+      }
+
+      Lookups::singleton().put(std::make_shared<const LookupTable>(name, std::move(keys), std::move(values)));
+    }
+  }
+
   // if user mistakenly config things at top level
   // (I made mistake to place a new table the same level as "tables")
-  // let's fail this case as mis-config [version, server, nodes, tables]
+  // let's fail this case as mis-config [version, server, nodes, tables, lookups]
   if (config.size() > topLevels) {
     throw NException("Un-recoganized config at the top level");
   }
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <mutex>
 #include <yaml-cpp/yaml.h>
 
@@ -124,6 +126,82 @@ public:
     nodeManager_->setSize(node, size);
   }
 
+  // data load of a node collected from its block states, memory is also the node size
+  inline void updateNodeLoad(const nebula::meta::NNode& node, size_t memory, size_t blocks) noexcept {
+    nodeManager_->setSize(node, memory);
+    std::lock_guard<std::mutex> lock(statsLock_);
+    auto& stats = stats_[node.toString()];
+    stats.memory = memory;
+    stats.blocks = blocks;
+  }
+
+  // query time reported by a node, its heat is the query time per wall time since last report
+  inline void updateNodeQueries(const nebula::meta::NNode& node, size_t queryMs) noexcept {
+    const size_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count();
+    std::lock_guard<std::mutex> lock(statsLock_);
+    auto& stats = stats_[node.toString()];
+
+    // a restarted node counts from 0 again
+    if (stats.lastPing > 0 && now > stats.lastPing && queryMs >= stats.queryMs) {
+      const auto busy = (double)(queryMs - stats.queryMs) / (now - stats.lastPing);
+      stats.heat = HEAT_DECAY * stats.heat + (1 - HEAT_DECAY) * busy;
+    }
+
+    stats.queryMs = queryMs;
+    stats.lastPing = now;
+  }
+
+  // memory of a node not held by data blocks
+  inline void updateNodeMemory(const nebula::meta::NNode& node, size_t queryBytes, size_t poolCached) noexcept {
+    std::lock_guard<std::mutex> lock(statsLock_);
+    auto& stats = stats_[node.toString()];
+    stats.queryBytes = queryBytes;
+    stats.poolCached = poolCached;
+  }
+
+  // load statistics of a node, all zero if it never reported
+  inline NodeStats nodeStats(const nebula::meta::NNode& node) const noexcept {
+    std::lock_guard<std::mutex> lock(statsLock_);
+    auto found = stats_.find(node.toString());
+    if (found == stats_.end()) {
+      return NodeStats{};
+    }
+
+    return found->second;
+  }
+
+  // loading progress of tables in a node as it reported, it only has tables the node has taken specs of
+  inline void updateNodeReadiness(const nebula::meta::NNode& node,
+                                  nebula::common::unordered_map<std::string, TableReadiness> tables) noexcept {
+    std::lock_guard<std::mutex> lock(statsLock_);
+    readiness_[node.toString()] = std::move(tables);
+  }
+
+  // loading progress of a table in all nodes reporting it, by node address
+  inline std::vector<std::pair<std::string, TableReadiness>> readiness(const std::string& table) const noexcept {
+    std::vector<std::pair<std::string, TableReadiness>> nodes;
+    std::lock_guard<std::mutex> lock(statsLock_);
+    for (const auto& [node, tables] : readiness_) {
+      auto found = tables.find(table);
+      if (found != tables.end()) {
+        nodes.emplace_back(node, found->second);
+      }
+    }
+
+    return nodes;
+  }
+
+  // all nodes having the table are ready for it, that is no node has recent specs of the table still loading
+  inline bool ready(const std::string& table) const noexcept {
+    std::lock_guard<std::mutex> lock(statsLock_);
+    return std::all_of(readiness_.begin(), readiness_.end(), [&table](const auto& node) {
+      auto found = node.second.find(table);
+      return found == node.second.end() || found->second.ready;
+    });
+  }
+
   inline const nebula::meta::TableSpecSet& tables() const {
     return tables_;
   }
@@ -142,6 +220,12 @@ public:
 
   inline void mark(const std::string& node, NState state = NState::BAD) {
     nodeManager_->mark(node, state);
+
+    // a bad node doesn't hold tables back from being ready
+    if (state == NState::BAD) {
+      std::lock_guard<std::mutex> lock(statsLock_);
+      readiness_.erase(node);
+    }
   }
 
   inline NodeManager& nodeManager() const {
@@ -157,6 +241,10 @@ public:
     }
   }
 
+private:
+  // weight of the previous heat in every new report
+  static constexpr double HEAT_DECAY = 0.8;
+
 private:
   std::mutex lock_;
   nebula::meta::TableSpecSet tables_;
@@ -166,6 +254,16 @@ private:
   std::unique_ptr<MetaDb> db_;
   nebula::common::unordered_map<std::string, YAML::Node> runtimeTables_;
   bool stateChanged_;
+
+  // signature of every table definition and of nodes section as last loaded,
+  // an unchanged table keeps its spec and unchanged nodes keep their states across loads
+  nebula::common::unordered_map<std::string, size_t> tableSigns_;
+  size_t nodesSign_ = 0;
+
+  // load statistics of nodes by their address
+  mutable std::mutex statsLock_;
+  nebula::common::unordered_map<std::string, NodeStats> stats_;
+  nebula::common::unordered_map<std::string, nebula::common::unordered_map<std::string, TableReadiness>> readiness_;
 };
 } // namespace meta
 } // namespace nebula
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <fmt/format.h>
 #include <glog/logging.h>
 #include <sstream>
@@ -97,7 +98,10 @@ using SpecPtr = std::shared_ptr<DataSpec>;
 class DataSpec : public nebula::common::Identifiable {
 public:
   // default constructor for serde
-  DataSpec() : node_{ nebula::meta::NNode::invalid() } {}
+  DataSpec()
+    : node_{ nebula::meta::NNode::invalid() },
+      source_{ nebula::meta::NNode::invalid() },
+      target_{ nebula::meta::NNode::invalid() } {}
   DataSpec(nebula::meta::TableSpecPtr table,
            const std::string& version,
            const std::string& domain,
@@ -108,7 +112,9 @@ public:
       domain_{ domain },
       splits_{ splits },
       state_{ state },
-      node_{ nebula::meta::NNode::invalid() } {
+      node_{ nebula::meta::NNode::invalid() },
+      source_{ nebula::meta::NNode::invalid() },
+      target_{ nebula::meta::NNode::invalid() } {
     construct();
   }
 
@@ -123,7 +129,7 @@ public:
     N_ENSURE(splits_.size() > 0, "Requires at least one split for a spec.");
     // computed value for reuse
     id_ = genId();
-    size_ = std::accumulate(splits_.begin(), splits_.end(), 0, [](size_t x, const auto& s) {
+    size_ = std::accumulate(splits_.begin(), splits_.end(), size_t{ 0 }, [](size_t x, const auto& s) {
       return x + s->size;
     });
   }
@@ -156,6 +162,16 @@ public:
     return splits_;
   }
 
+  // the latest watermark of its splits, 0 if splits are not bound to time such as kafka segments
+  inline size_t watermark() const {
+    size_t watermark = 0;
+    for (const auto& s : splits_) {
+      watermark = std::max(watermark, s->watermark);
+    }
+
+    return watermark;
+  }
+
   // a spec needs to sync to a node when it's NEW or RENEW
   inline bool needSync() const {
     return state_ == SpecState::NEW;
@@ -174,6 +190,113 @@ public:
     return !node_.isInvalid();
   }
 
+  // other nodes holding a copy of the spec when its table is replicated, the affinity node holds the primary copy
+  inline void replicas(std::vector<nebula::meta::NNode> nodes) {
+    replicas_ = std::move(nodes);
+  }
+
+  inline const std::vector<nebula::meta::NNode>& replicas() const {
+    return replicas_;
+  }
+
+  // all nodes holding a copy of the spec, the primary first
+  inline std::vector<nebula::meta::NNode> copies() const {
+    std::vector<nebula::meta::NNode> nodes;
+    if (assigned()) {
+      nodes.reserve(replicas_.size() + 1);
+      nodes.push_back(node_);
+      nodes.insert(nodes.end(), replicas_.begin(), replicas_.end());
+    }
+
+    return nodes;
+  }
+
+  // move the copy held by source node to target node, the target ingests the spec while the source keeps serving it
+  inline void migrate(const nebula::meta::NNode& source, const nebula::meta::NNode& target) {
+    source_ = source;
+    target_ = target;
+  }
+
+  inline bool migrating() const {
+    return !target_.isInvalid();
+  }
+
+  inline const nebula::meta::NNode& source() const {
+    return source_;
+  }
+
+  inline const nebula::meta::NNode& target() const {
+    return target_;
+  }
+
+  // the target takes over the copy of the source once it holds the spec, the source retires until its blocks expire
+  void migrated() {
+    takeover();
+    retired_.push_back(source_);
+    source_ = nebula::meta::NNode::invalid();
+  }
+
+  // give up the migration, blocks the target may have ingested are retired
+  void cancel() {
+    if (migrating()) {
+      retired_.push_back(target_);
+      source_ = nebula::meta::NNode::invalid();
+      target_ = nebula::meta::NNode::invalid();
+    }
+  }
+
+  // nodes still holding blocks of the spec which is no longer theirs, queries skip them
+  inline const std::vector<nebula::meta::NNode>& retired() const {
+    return retired_;
+  }
+
+  inline void retired(std::vector<nebula::meta::NNode> nodes) {
+    retired_ = std::move(nodes);
+  }
+
+  inline void release(const std::string& addr) {
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [&addr](const auto& n) {
+                     return n.toString() == addr;
+                   }),
+                   retired_.end());
+  }
+
+  // remove the copy held by given node, a lost primary fails over to its first replica right away,
+  // a lost migration source is taken over by the target and a lost target ends the migration.
+  // return true if the node held a copy of the spec.
+  bool drop(const std::string& addr) {
+    release(addr);
+    if (migrating()) {
+      if (target_.toString() == addr) {
+        source_ = nebula::meta::NNode::invalid();
+        target_ = nebula::meta::NNode::invalid();
+      } else if (source_.toString() == addr) {
+        takeover();
+        source_ = nebula::meta::NNode::invalid();
+        return true;
+      }
+    }
+
+    if (node_.toString() == addr) {
+      node_ = replicas_.empty() ? nebula::meta::NNode::invalid() : replicas_.front();
+      if (!replicas_.empty()) {
+        replicas_.erase(replicas_.begin());
+      }
+
+      return true;
+    }
+
+    auto found = std::find_if(replicas_.begin(), replicas_.end(), [&addr](const auto& n) {
+      return n.toString() == addr;
+    });
+    if (found != replicas_.end()) {
+      replicas_.erase(found);
+      return true;
+    }
+
+    return false;
+  }
+
 protected:
   // get the first and the only split for most single split use cases
   inline SpecSplitPtr split() const {
@@ -185,6 +308,18 @@ protected:
   }
 
 private:
+  // replace the copy of the source by the target
+  inline void takeover() {
+    release(target_.toString());
+    if (node_.equals(source_)) {
+      node_ = target_;
+    } else {
+      std::replace_if(replicas_.begin(), replicas_.end(), [this](const auto& n) { return n.equals(source_); }, target_);
+    }
+
+    target_ = nebula::meta::NNode::invalid();
+  }
+
   // id: "<table>@[split,...]"
   inline std::string genId() const noexcept {
     std::stringstream ss;
@@ -205,6 +340,14 @@ protected:
   SpecState state_;
   nebula::meta::NNode node_;
 
+  // replicas are tracked by server only, a node ingests its own copy
+  std::vector<nebula::meta::NNode> replicas_;
+
+  // a copy moving from source to target, and nodes which gave up their copies
+  nebula::meta::NNode source_;
+  nebula::meta::NNode target_;
+  std::vector<nebula::meta::NNode> retired_;
+
   // computed identifier during construction
   size_t size_;
   std::string id_;
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Lookup.h"
+
+#include <charconv>
+#include <fmt/format.h>
+#include <fstream>
+#include <glog/logging.h>
+
+#include "common/Errors.h"
+
+namespace nebula {
+namespace meta {
+
+LookupTable::LookupTable(const std::string& name, std::vector<std::string> keys, std::vector<std::string> values)
+  : name_{ name }, keys_{ std::move(keys) }, values_{ std::move(values) } {
+  N_ENSURE_EQ(keys_.size(), values_.size(), "lookup table keys and values should match");
+  strings_.reserve(keys_.size());
+  for (size_t i = 0, size = keys_.size(); i < size; ++i) {
+    // the first one wins for duplicate keys
+    const std::string_view key = keys_[i];
+    if (!strings_.emplace(key, i).second) {
+      continue;
+    }
+
+    int64_t value;
+    const auto last = key.data() + key.size();
+    auto [ptr, ec] = std::from_chars(key.data(), last, value);
+    if (ec == std::errc() && ptr == last && !key.empty()) {
+      ints_.emplace(value, i);
+    }
+  }
+}
+
+void Lookups::put(LookupTablePtr table) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tables_[table->name()] = std::move(table);
+}
+
+LookupTablePtr Lookups::get(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = tables_.find(name);
+  return found == tables_.end() ? nullptr : found->second;
+}
+
+LookupTablePtr Lookups::load(const std::string& name, const std::string& file) {
+  std::ifstream input(file);
+  N_ENSURE(input.good(), fmt::format("unable to read lookup table {0} from {1}", name, file));
+
+  std::vector<std::string> keys;
+  std::vector<std::string> values;
+  std::string line;
+  while (std::getline(input, line)) {
+    auto comma = line.find(',');
+    if (comma == std::string::npos) {
+      continue;
+    }
+
+    keys.push_back(line.substr(0, comma));
+    values.push_back(line.substr(comma + 1));
+  }
+
+  LOG(INFO) << "Loaded lookup table " << name << " of size " << keys.size();
+  return std::make_shared<const LookupTable>(name, std::move(keys), std::move(values));
+}
+
+} // namespace meta
+} // namespace nebula
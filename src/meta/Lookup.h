@@ -0,0 +1,114 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/Hash.h"
+
+/**
+ * Lookup tables are small (key -> value) mappings registered on the server, such as id to name of a dimension.
+ * A query resolves lookup(table, key) per row in block compute, so it can filter or group by looked up values
+ * without joining. A table is shipped to nodes inside the query expression that uses it, so nodes need no state.
+ */
+namespace nebula {
+namespace meta {
+
+class LookupTable {
+public:
+  LookupTable(const std::string& name, std::vector<std::string> keys, std::vector<std::string> values);
+  // index refers to the keys in place
+  LookupTable(const LookupTable&) = delete;
+  virtual ~LookupTable() = default;
+
+public:
+  // value of an integer key, nullptr if not found
+  inline const std::string* find(int64_t key) const noexcept {
+    auto found = ints_.find(key);
+    return found == ints_.end() ? nullptr : &values_[found->second];
+  }
+
+  // value of a string key, nullptr if not found
+  inline const std::string* find(std::string_view key) const noexcept {
+    auto found = strings_.find(key);
+    return found == strings_.end() ? nullptr : &values_[found->second];
+  }
+
+  inline const std::string& name() const noexcept {
+    return name_;
+  }
+
+  inline const std::vector<std::string>& keys() const noexcept {
+    return keys_;
+  }
+
+  inline const std::vector<std::string>& values() const noexcept {
+    return values_;
+  }
+
+  inline size_t size() const noexcept {
+    return keys_.size();
+  }
+
+private:
+  const std::string name_;
+  const std::vector<std::string> keys_;
+  const std::vector<std::string> values_;
+
+  // keys index into values, keys which are integers are indexed by their integer values too
+  nebula::common::unordered_map<std::string_view, size_t> strings_;
+  nebula::common::unordered_map<int64_t, size_t> ints_;
+};
+
+using LookupTablePtr = std::shared_ptr<const LookupTable>;
+
+// registry of all lookup tables by name
+class Lookups {
+private:
+  Lookups() = default;
+  Lookups(Lookups&) = delete;
+  Lookups(Lookups&&) = delete;
+
+public:
+  virtual ~Lookups() = default;
+
+  static Lookups& singleton() {
+    static Lookups lookups;
+    return lookups;
+  }
+
+public:
+  // register a table, replacing existing one of the same name
+  void put(LookupTablePtr);
+
+  // table by name, nullptr if not registered
+  LookupTablePtr get(const std::string&) const;
+
+  // load a table from a local file of "key,value" lines, the first comma splits a line
+  static LookupTablePtr load(const std::string& name, const std::string& file);
+
+private:
+  mutable std::mutex mutex_;
+  nebula::common::unordered_map<std::string, LookupTablePtr> tables_;
+};
+
+} // namespace meta
+} // namespace nebula
@@ -5,6 +5,7 @@ set(NEBULA_META NMeta)
 add_library(${NEBULA_META} STATIC
     ${NEBULA_SRC}/meta/ClusterInfo.cpp
     ${NEBULA_SRC}/meta/DataSpec.cpp
+    ${NEBULA_SRC}/meta/Lookup.cpp
     ${NEBULA_SRC}/meta/MetaService.cpp
     ${NEBULA_SRC}/meta/NodeManager.cpp
     ${NEBULA_SRC}/meta/Table.cpp
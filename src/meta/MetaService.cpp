@@ -49,10 +49,15 @@ void TableRegistry::update(const std::vector<SpecPtr>& specs) noexcept {
       const auto& node = prev->affinity();
       specPtr->affinity(node);
       specPtr->state(prev->state());
+      specPtr->replicas(prev->replicas());
+      specPtr->migrate(prev->source(), prev->target());
+      specPtr->retired(prev->retired());
 
       // if the node is not active, reassign
       if (!node.isActive()) {
+        specPtr->cancel();
         specPtr->affinity(NNode::invalid());
+        specPtr->replicas({});
         specPtr->state(SpecState::NEW);
         renewed++;
       }
@@ -51,7 +51,12 @@ public:
   }
 
   inline TablePtr table() const {
-    return table_;
+    return std::atomic_load(&table_);
+  }
+
+  // a changed definition replaces the table while queries may be reading it, online specs are kept
+  inline void replace(const TablePtr& table) {
+    std::atomic_store(&table_, table);
   }
 
   // check if current registry is expired
@@ -29,13 +29,98 @@
 namespace nebula {
 namespace meta {
 
+// bytes of a column in memory by its structures, children of a compound column are rolled up into it
+struct ColumnMemory {
+  // values, encoded or compressed values if so, including string heads
+  size_t data = 0;
+  // null bitmap
+  size_t nulls = 0;
+  // offset and size of every row of a string or compound column, dictionary code of a dictionary encoded one
+  size_t offsets = 0;
+  size_t dict = 0;
+  size_t bloom = 0;
+  // column histogram and zone maps
+  size_t histogram = 0;
+
+  inline size_t total() const noexcept {
+    return data + nulls + offsets + dict + bloom + histogram;
+  }
+
+  inline ColumnMemory& operator+=(const ColumnMemory& other) noexcept {
+    data += other.data;
+    nulls += other.nulls;
+    offsets += other.offsets;
+    dict += other.dict;
+    bloom += other.bloom;
+    histogram += other.histogram;
+    return *this;
+  }
+
+  inline ColumnMemory& operator-=(const ColumnMemory& other) noexcept {
+    data -= other.data;
+    nulls -= other.nulls;
+    offsets -= other.offsets;
+    dict -= other.dict;
+    bloom -= other.bloom;
+    histogram -= other.histogram;
+    return *this;
+  }
+};
+
+// bytes of a block in memory, columns are in schema order
+struct BlockMemory {
+  std::vector<ColumnMemory> columns;
+  // partition values (bess) of every row in a partitioned block
+  size_t bess = 0;
+
+  inline size_t total() const noexcept {
+    size_t bytes = bess;
+    for (const auto& c : columns) {
+      bytes += c.total();
+    }
+
+    return bytes;
+  }
+
+  // blocks of a table share the same schema, columns of a block of another schema are not summed
+  inline void add(const BlockMemory& other) noexcept {
+    if (columns.empty()) {
+      columns.resize(other.columns.size());
+    }
+
+    if (columns.size() == other.columns.size()) {
+      for (size_t i = 0; i < columns.size(); ++i) {
+        columns[i] += other.columns[i];
+      }
+    }
+
+    bess += other.bess;
+  }
+
+  inline void subtract(const BlockMemory& other) noexcept {
+    if (columns.size() == other.columns.size()) {
+      for (size_t i = 0; i < columns.size(); ++i) {
+        columns[i] -= other.columns[i];
+      }
+    }
+
+    bess -= other.bess;
+  }
+};
+
 struct BlockState {
   size_t numRows;
   size_t rawSize;
 
   // serialized histograms of each column
-  // (assuming all blocks share the same schama, otherwise we may need mapping)
   nebula::surface::eval::HistVector histograms;
+
+  // memory of the block when it is loaded, it is kept while the block is evicted to cold tier
+  BlockMemory memory = {};
+
+  // names of columns in the same order as histograms, so that blocks of different schema versions are
+  // rolled up by column name. It is empty if unknown, such as a block synced from a node of older version.
+  std::vector<std::string> columns = {};
 };
 
 struct BlockSignature {
@@ -115,6 +200,11 @@ public:
     return state_;
   }
 
+  // identify the block along with its state, the key changes when data of the block changes
+  inline std::string key() const {
+    return fmt::format("{0}_{1}_{2}", sign_.toString(), state_.numRows, state_.rawSize);
+  }
+
   inline const NNode& residence() const {
     return residence_;
   }
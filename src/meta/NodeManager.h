@@ -34,6 +34,38 @@ namespace meta {
 struct NodeStats {
   // last ping timestamp in unix time milliseconds
   size_t lastPing;
+
+  // memory used by data blocks of the node in bytes
+  size_t memory;
+
+  // number of data blocks held by the node
+  size_t blocks;
+
+  // total milliseconds the node spent in executing queries since it started
+  size_t queryMs;
+
+  // share of recent wall time the node spent in queries, smoothed over reports
+  double heat;
+
+  // bytes charged by queries running in the node at last report
+  size_t queryBytes;
+
+  // bytes of freed chunks held by allocator caches of the node at last report
+  size_t poolCached;
+};
+
+// loading progress of specs of a table taken by a node since it started
+struct TableReadiness {
+  // specs of the table taken and loaded by the node
+  size_t specs;
+  size_t loaded;
+
+  // all recent specs of the table are loaded, older ones may still be loading
+  bool ready;
+
+  inline size_t percent() const noexcept {
+    return specs == 0 ? 100 : loaded * 100 / specs;
+  }
 };
 
 using NNodeSet = nebula::common::unordered_set<NNode, NodeHash, NodeEqual>;
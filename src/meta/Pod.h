@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <optional>
+
 #include "Partition.h"
 
 #include "common/Hash.h"
@@ -81,6 +83,11 @@ public:
     return offsets_.at(index);
   }
 
+  // if a column is one of the partition keys
+  inline bool has(const std::string& name) const {
+    return colMap_.find(name) != colMap_.end();
+  }
+
 #define POD_COMPUTE(P)                               \
   bess = 0;                                          \
   size_t pod = 0;                                    \
@@ -173,6 +180,18 @@ public:
     return bessBits_;
   }
 
+  // bit shift and width of a partition column in bess value, its bits are the value index in its space.
+  // nullopt if the column is not a partition column.
+  inline std::optional<std::pair<size_t, size_t>> bits(const std::string& name) const {
+    auto itr = colMap_.find(name);
+    if (itr == colMap_.end()) {
+      return std::nullopt;
+    }
+
+    const auto i = itr->second;
+    return std::make_pair(shifts_[i], keys_.at(i)->width());
+  }
+
 private:
   KeyList keys_;
   // column name to index mapping for keys
@@ -107,6 +107,23 @@ struct CustomColumn {
   MSGPACK_DEFINE(name, kind, expr)
 };
 
+// value of a column looked up in a dictionary by the key column of the same row at ingestion
+struct LookupInfo {
+  // dictionary of "key,value" lines, a local file or an uri such as s3://, gs://, http(s)://
+  std::string source;
+  // key column read from the source data
+  std::string key;
+  // seconds to reuse a loaded dictionary before loading it again, 0 means never reload
+  size_t refresh = 0;
+
+  inline bool valid() const {
+    return !source.empty() && !key.empty();
+  }
+
+  // make it serializable with msgpack
+  MSGPACK_DEFINE(source, key, refresh)
+};
+
 /**
  * Define column properties that fetched from meta data system
  */
@@ -117,14 +134,24 @@ struct Column {
                   const std::string& dv = "",
                   const std::string& fm = "",
                   std::vector<AccessRule> rls = {},
-                  PartitionInfo pi = {})
+                  PartitionInfo pi = {},
+                  bool s = false,
+                  LookupInfo li = {},
+                  bool sd = false,
+                  bool t = false,
+                  bool bm = false)
     : withBloomFilter{ bf },
       withDict{ d },
       withCompress{ c },
       defaultValue{ dv },
       fromMacro{ fm },
       rules{ std::move(rls) },
-      partition{ std::move(pi) } {}
+      partition{ std::move(pi) },
+      sorted{ s },
+      lookup{ std::move(li) },
+      sharedDict{ sd },
+      withTokens{ t },
+      withBitmap{ bm } {}
 
   // by default, we don't build bloom filter
   bool withBloomFilter;
@@ -151,8 +178,25 @@ struct Column {
   // partition info - can be used to convert as PartitionKey
   PartitionInfo partition;
 
+  // values are mostly in ascending order, stored as deltas when a block is sealed
+  // time column is always treated as sorted
+  bool sorted;
+
+  // enriched by a lookup dictionary rather than read from the source
+  LookupInfo lookup;
+
+  // strings are encoded by a dictionary shared by all blocks of the table in a node rather than one per block
+  bool sharedDict;
+
+  // words of a string column are indexed in every block for text search, see TokenIndex
+  bool withTokens;
+
+  // rows of every distinct value of an integer or string column are indexed by bitmaps in every block
+  bool withBitmap;
+
   // make it serializable with msgpack
-  MSGPACK_DEFINE(withBloomFilter, withDict, withCompress, defaultValue, fromMacro, rules, partition)
+  MSGPACK_DEFINE(withBloomFilter, withDict, withCompress, defaultValue, fromMacro, rules, partition, sorted, lookup,
+                 sharedDict, withTokens, withBitmap)
 };
 
 using ColumnProps = std::unordered_map<std::string, Column>;
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <rapidjson/document.h>
 #include <unordered_map>
 
@@ -186,6 +187,67 @@ struct ThriftProps {
   MSGPACK_DEFINE(protocol, columnsMap);
 };
 
+// a rollup pre-aggregates a table by a set of dimensions and a time window while ingesting.
+// its table has all dimensions, the bucketed time column, a row count column,
+// and a sum, min and max column for every metric.
+// a rollup can be kept longer than raw rows as a coarser retention tier, e.g. raw rows for a day
+// and hourly rollups for weeks, queries out of raw retention are answered by such a tier.
+struct RollupSpec {
+  // rollup name, unique within its table
+  std::string name;
+  // columns to group by besides time
+  std::vector<std::string> dimensions;
+  // numeric columns to aggregate
+  std::vector<std::string> metrics;
+  // time bucket in seconds
+  size_t window;
+  // seconds to keep rollup blocks after their end time, 0 to keep them as long as raw rows
+  size_t retention = 0;
+
+  static constexpr auto COUNT = "_count_";
+
+  static inline std::string sum(const std::string& metric) {
+    return fmt::format("{0}_sum", metric);
+  }
+
+  static inline std::string min(const std::string& metric) {
+    return fmt::format("{0}_min", metric);
+  }
+
+  static inline std::string max(const std::string& metric) {
+    return fmt::format("{0}_max", metric);
+  }
+
+  // make it msgpack serializable
+  MSGPACK_DEFINE(name, dimensions, metrics, window, retention);
+};
+
+// a condition every ingested row meets, on a column of the source schema.
+// value is converted to the column type, a row with null in the column doesn't match a comparison.
+struct FilterSpec {
+  std::string column;
+  FilterOp op;
+  std::string value;
+
+  // make it msgpack serializable
+  MSGPACK_DEFINE(column, op, value);
+};
+
+// a derived table takes some columns of the rows ingested for its table which meet its own conditions too.
+// it shares fetching and parsing of the source with its table, so tables over the same source with different
+// columns or filters cost one ingestion. Its table is named {table}@{name} and has the same retention.
+struct DerivedSpec {
+  // derived name, unique within its table
+  std::string name;
+  // columns of the table to keep besides time, all if empty
+  std::vector<std::string> columns;
+  // conditions on source columns, in addition to the ones of its table
+  std::vector<FilterSpec> filters;
+
+  // make it msgpack serializable
+  MSGPACK_DEFINE(name, columns, filters);
+};
+
 struct TableSpec;
 // define table spec pointer
 using TableSpecPtr = std::shared_ptr<TableSpec>;
@@ -237,8 +299,18 @@ struct TableSpec {
   size_t optimalBlockSize;
   // unix time in seconds to indicate when the table expires for ephemeral table only, use 0 for never expire
   nebula::meta::TTL ttl;
-
-  explicit TableSpec() : ttl{ 0 } {}
+  // rollups maintained along with the raw data
+  std::vector<RollupSpec> rollups;
+  // blocks whose newest data is older than this many seconds are compressed when ingested, 0 to never compress
+  size_t compress_seconds;
+  // rows not meeting all these conditions are dropped when ingested
+  std::vector<FilterSpec> filters;
+  // number of nodes holding a copy of every spec, queries are served by one live copy of each spec
+  size_t replicas;
+  // tables built from the same rows ingested for this table
+  std::vector<DerivedSpec> derived;
+
+  explicit TableSpec() : ttl{ 0 }, compress_seconds{ 0 }, replicas{ 1 } {}
   explicit TableSpec(std::string _name, size_t maxMb, size_t maxSeconds, std::string _schema,
                      DataSource ds, std::string _loader, std::string _location, std::string _backup,
                      DataFormat _format, CsvProps csvProps, JsonProps jsonProps, ThriftProps thriftProps,
@@ -269,14 +341,16 @@ struct TableSpec {
       macroValues{ std::move(_macroValues) },
       headers{ std::move(_headers) },
       optimalBlockSize{ _optimalBlockSize },
-      ttl{ 0 } {}
+      ttl{ 0 },
+      compress_seconds{ 0 },
+      replicas{ 1 } {}
 
   // make it msgpack serializable
   MSGPACK_DEFINE(name, max_mb, max_seconds, schema,
                  source, loader, location, backup, format,
                  csv, json, thrift, kafkaSerde, rocksetSerde,
                  columnProps, timeSpec, accessSpec, bucketInfo, settings,
-                 macroValues, headers, ttl);
+                 macroValues, headers, ttl, rollups, compress_seconds, filters, derived);
 
   inline std::string toString() const {
     // table name @ location - format: time
@@ -303,10 +377,119 @@ struct TableSpec {
     return std::make_shared<Table>(name, schemaPtr, columnProps, accessSpec);
   }
 
+  // seconds blocks of a rollup are kept, raw retention unless the rollup has its own
+  inline size_t retention(const RollupSpec& rollup) const noexcept {
+    return rollup.retention > 0 ? rollup.retention : max_seconds;
+  }
+
+  // time span in seconds covered by any retention tier of the table, specs of this span are ingested
+  // while raw rows out of max_seconds only feed rollups kept longer
+  inline size_t horizon() const noexcept {
+    auto seconds = max_seconds;
+    for (const auto& rollup : rollups) {
+      seconds = std::max(seconds, retention(rollup));
+    }
+
+    return seconds;
+  }
+
+  // name of the table holding data of a rollup: {table}@{rollup}
+  static inline std::string rollupName(const std::string& table, const std::string& rollup) {
+    return fmt::format("{0}{1}{2}", table, ROLLUP_SEP, rollup);
+  }
+
+  // base table name of a given table name, a table not a rollup is its own base
+  static inline std::string base(const std::string& table) {
+    return table.substr(0, table.rfind(ROLLUP_SEP));
+  }
+
+  // generate the table of a rollup, whose schema is
+  // dimensions + _time_ + _count_ + {metric}_sum/_min/_max of every metric
+  // integral metrics are aggregated as BIGINT, floating ones as DOUBLE.
+  std::shared_ptr<Table> to(const RollupSpec& rollup) const {
+    N_ENSURE_GT(rollup.window, 0, "rollup window should be at least 1 second");
+    auto raw = to()->schema();
+    auto column = [&raw](const std::string& col) -> nebula::type::TreeNode {
+      for (size_t i = 0, size = raw->size(); i < size; ++i) {
+        if (raw->childType(i)->name() == col) {
+          return raw->childAt(i);
+        }
+      }
+
+      throw NException(fmt::format("rollup column not found: {0}", col));
+    };
+
+    // macro and partition only apply to raw data
+    ColumnProps props;
+    auto copy = [this, &props](const std::string& from, const std::string& target) {
+      auto found = columnProps.find(from);
+      if (found != columnProps.end()) {
+        const auto& c = found->second;
+        props[target] = Column{ c.withBloomFilter, c.withDict, c.withCompress, "", "", c.rules };
+      }
+    };
+
+    std::vector<nebula::type::TreeNode> children;
+    for (const auto& d : rollup.dimensions) {
+      auto node = column(d);
+      N_ENSURE(!nebula::type::TypeBase::isCompound(nebula::type::TypeBase::k(node)),
+               fmt::format("rollup dimension should be primitive: {0}", d));
+      children.push_back(node);
+      copy(d, d);
+    }
+
+    children.push_back(nebula::type::LongType::createTree(Table::TIME_COLUMN));
+    children.push_back(nebula::type::LongType::createTree(RollupSpec::COUNT));
+    for (const auto& m : rollup.metrics) {
+      const auto kind = nebula::type::TypeBase::k(column(m));
+      N_ENSURE(kind >= Kind::TINYINT && kind <= Kind::DOUBLE,
+               fmt::format("rollup metric should be numeric: {0}", m));
+      const auto real = kind == Kind::REAL || kind == Kind::DOUBLE;
+      for (const auto& agg : { RollupSpec::sum(m), RollupSpec::min(m), RollupSpec::max(m) }) {
+        children.push_back(real ? nebula::type::DoubleType::createTree(agg) : nebula::type::LongType::createTree(agg));
+        copy(m, agg);
+      }
+    }
+
+    auto schemaPtr = std::static_pointer_cast<nebula::type::RowType>(nebula::type::RowType::create("", children));
+    return std::make_shared<Table>(rollupName(name, rollup.name), schemaPtr, props, accessSpec);
+  }
+
+  // generate the table of a derived spec, whose schema is the given columns of the raw table and _time_
+  // in order of the raw schema, with their column properties
+  std::shared_ptr<Table> to(const DerivedSpec& derived) const {
+    auto raw = to()->schema();
+    nebula::common::unordered_set<std::string> wanted(derived.columns.begin(), derived.columns.end());
+    for (const auto& col : derived.columns) {
+      N_ENSURE_NOT_NULL(raw->find(col), fmt::format("derived column not found: {0}", col));
+    }
+
+    ColumnProps props;
+    std::vector<nebula::type::TreeNode> children;
+    for (size_t i = 0, size = raw->size(); i < size; ++i) {
+      const auto& col = raw->childType(i)->name();
+      if (col != Table::TIME_COLUMN && !wanted.empty() && wanted.find(col) == wanted.end()) {
+        continue;
+      }
+
+      children.push_back(raw->childAt(i));
+      auto found = columnProps.find(col);
+      if (found != columnProps.end()) {
+        props.emplace(col, found->second);
+      }
+    }
+
+    auto schemaPtr = std::static_pointer_cast<nebula::type::RowType>(nebula::type::RowType::create("", children));
+    return std::make_shared<Table>(rollupName(name, derived.name), schemaPtr, props, accessSpec);
+  }
+
   // serialize a table spec into a string
   static std::string serialize(const TableSpec&) noexcept;
   // deserialize a table spec from a string
   static TableSpecPtr deserialize(const std::string_view);
+
+private:
+  static constexpr auto ROLLUP_SEP = '@';
 };
 
 // Current hash and equal are based on table name only
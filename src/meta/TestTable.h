@@ -33,8 +33,9 @@ class TestTable : public Table {
   static auto CP() {
     static const Column COL_ID{ true, false, false, "", "", {}, {} };
     // place an access rule on event column requiring user to be in nebula-users to read
+    // event column is dictionary encoded with bloom filter
     static const Column COL_EVENT{
-      false,
+      true,
       true,
       false,
       "",
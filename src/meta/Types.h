@@ -113,6 +113,18 @@ enum class DataFormat {
   UNKNOWN
 };
 
+// comparison of an ingest filter, a null value matches NOTNULL only
+enum class FilterOp {
+  NOTNULL,
+  EQ,
+  NE,
+  LT,
+  LE,
+  GT,
+  GE,
+  UNKNOWN
+};
+
 // given variable str
 #define SAME_STR_THEN_ITEM(STR, ITEM)          \
   if (nebula::common::Chars::same(str, STR)) { \
@@ -144,6 +156,19 @@ struct DataFormatUtils {
   }
 };
 
+struct FilterOpUtils {
+  static FilterOp from(const std::string& str) noexcept {
+    SAME_STR_THEN_ITEM("notnull", FilterOp::NOTNULL)
+    SAME_STR_THEN_ITEM("=", FilterOp::EQ)
+    SAME_STR_THEN_ITEM("!=", FilterOp::NE)
+    SAME_STR_THEN_ITEM("<", FilterOp::LT)
+    SAME_STR_THEN_ITEM("<=", FilterOp::LE)
+    SAME_STR_THEN_ITEM(">", FilterOp::GT)
+    SAME_STR_THEN_ITEM(">=", FilterOp::GE)
+    return FilterOp::UNKNOWN;
+  }
+};
+
 struct DataSourceUtils {
   static bool isFileSystem(const DataSource& ds) {
     return ds == DataSource::S3
@@ -198,6 +223,7 @@ MSGPACK_ADD_ENUM(nebula::meta::TimeType)
 MSGPACK_ADD_ENUM(nebula::meta::AccessType)
 MSGPACK_ADD_ENUM(nebula::meta::ActionType)
 MSGPACK_ADD_ENUM(nebula::meta::DataFormat)
+MSGPACK_ADD_ENUM(nebula::meta::FilterOp)
 MSGPACK_ADD_ENUM(nebula::type::Kind)
 MSGPACK_ADD_ENUM(nebula::meta::SpecState)
 MSGPACK_ADD_ENUM(nebula::meta::NRole)
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <fmt/format.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -96,6 +97,33 @@ TEST(ClusterInfoTest, TestTableSpecManagement) {
   EXPECT_EQ(ci.tables().size(), 4);
 }
 
+TEST(ClusterInfoTest, TestTableReadiness) {
+  auto& ci = ClusterInfo::singleton();
+  const NNode n1{ NRole::NODE, "readiness-1", 9199 };
+  const NNode n2{ NRole::NODE, "readiness-2", 9199 };
+
+  // a table no node reports is ready
+  EXPECT_TRUE(ci.ready("boot"));
+  ci.updateNodeReadiness(n1, { { "boot", TableReadiness{ 10, 10, true } } });
+  ci.updateNodeReadiness(n2, { { "boot", TableReadiness{ 8, 2, false } }, { "other", TableReadiness{ 4, 1, true } } });
+  EXPECT_FALSE(ci.ready("boot"));
+  EXPECT_TRUE(ci.ready("other"));
+
+  auto nodes = ci.readiness("boot");
+  EXPECT_EQ(nodes.size(), 2);
+  std::sort(nodes.begin(), nodes.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+  EXPECT_EQ(nodes.front().second.percent(), 100);
+  EXPECT_EQ(nodes.back().second.percent(), 25);
+
+  // node 2 has loaded its recent specs
+  ci.updateNodeReadiness(n2, { { "boot", TableReadiness{ 8, 3, true } } });
+  EXPECT_TRUE(ci.ready("boot"));
+  EXPECT_EQ(ci.readiness("other").size(), 0);
+
+  ci.updateNodeReadiness(n1, {});
+  ci.updateNodeReadiness(n2, {});
+}
+
 } // namespace test
 } // namespace meta
 } // namespace nebula
@@ -80,6 +80,75 @@ TEST(SpecTest, TestDataSpec) {
   }
 }
 
+TEST(SpecTest, TestSpecReplicas) {
+  DataSpec spec{ nebula::meta::genTableSpec(), "1.0", "s3://test", genSplits(), SpecState::NEW };
+  EXPECT_TRUE(spec.copies().empty());
+
+  NNode n1{ NRole::NODE, "n1", 9199 };
+  NNode n2{ NRole::NODE, "n2", 9199 };
+  NNode n3{ NRole::NODE, "n3", 9199 };
+  spec.affinity(n1);
+  spec.replicas({ n2, n3 });
+  EXPECT_EQ(spec.copies().size(), 3);
+
+  // a lost replica is removed
+  EXPECT_FALSE(spec.drop("n4:9199"));
+  EXPECT_TRUE(spec.drop("n3:9199"));
+  EXPECT_EQ(spec.copies().size(), 2);
+
+  // a lost primary fails over to its replica
+  EXPECT_TRUE(spec.drop("n1:9199"));
+  EXPECT_TRUE(spec.assigned());
+  EXPECT_TRUE(spec.affinity().equals(n2));
+  EXPECT_TRUE(spec.replicas().empty());
+
+  // no copy left
+  EXPECT_TRUE(spec.drop("n2:9199"));
+  EXPECT_FALSE(spec.assigned());
+}
+
+TEST(SpecTest, TestSpecMigration) {
+  DataSpec spec{ nebula::meta::genTableSpec(), "1.0", "s3://test", genSplits(), SpecState::READY };
+  NNode n1{ NRole::NODE, "n1", 9199 };
+  NNode n2{ NRole::NODE, "n2", 9199 };
+  NNode n3{ NRole::NODE, "n3", 9199 };
+  spec.affinity(n1);
+  spec.replicas({ n2 });
+
+  // the source keeps its copy until the target takes over
+  spec.migrate(n2, n3);
+  EXPECT_TRUE(spec.migrating());
+  EXPECT_EQ(spec.copies().size(), 2);
+  spec.migrated();
+  EXPECT_FALSE(spec.migrating());
+  EXPECT_TRUE(spec.affinity().equals(n1));
+  EXPECT_TRUE(spec.replicas().front().equals(n3));
+  EXPECT_EQ(spec.retired().size(), 1);
+  EXPECT_TRUE(spec.retired().front().equals(n2));
+  spec.release("n2:9199");
+  EXPECT_TRUE(spec.retired().empty());
+
+  // a cancelled migration retires the target
+  spec.migrate(n1, n2);
+  spec.cancel();
+  EXPECT_FALSE(spec.migrating());
+  EXPECT_TRUE(spec.affinity().equals(n1));
+  EXPECT_TRUE(spec.retired().front().equals(n2));
+
+  // a lost source is taken over by the target right away
+  spec.migrate(n1, n2);
+  EXPECT_TRUE(spec.drop("n1:9199"));
+  EXPECT_FALSE(spec.migrating());
+  EXPECT_TRUE(spec.affinity().equals(n2));
+  EXPECT_TRUE(spec.retired().empty());
+
+  // a lost target ends the migration
+  spec.migrate(n3, n1);
+  EXPECT_FALSE(spec.drop("n1:9199"));
+  EXPECT_FALSE(spec.migrating());
+  EXPECT_EQ(spec.copies().size(), 2);
+}
+
 } // namespace test
 } // namespace meta
 } // namespace nebula
\ No newline at end of file
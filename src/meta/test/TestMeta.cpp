@@ -54,6 +54,13 @@ TEST(MetaTest, TestNBlock) {
   ASSERT_TRUE(b1.overlap({ 2, 5 }));
   ASSERT_FALSE(b1.overlap({ 2, 4 }));
   ASSERT_FALSE(b1.overlap({ 12, 18 }));
+
+  // a block changes its key when its data changes
+  NNode n1{ NRole::NODE, "n1", 9199 };
+  NBlock<int> b2(BlockSignature{ "mock", 0, 5, 10 }, n1, BlockState{ 10, 100, {} });
+  NBlock<int> b3(BlockSignature{ "mock", 0, 5, 10 }, n1, BlockState{ 20, 200, {} });
+  ASSERT_EQ(b2.key(), NBlock<int>(BlockSignature{ "mock", 0, 5, 10 }, n1, BlockState{ 10, 100, {} }).key());
+  ASSERT_NE(b2.key(), b3.key());
 }
 
 TEST(MetaTest, TestNNode) {
@@ -220,6 +227,62 @@ TEST(MetaTest, TestRuntimeTableDefinition) {
   EXPECT_EQ(runtime->settings.at("kafka.timeout"), "100");
 }
 
+TEST(MetaTest, TestIncrementalConfigLoad) {
+  auto yamlFile = "configs/test.yml";
+  auto& clusterInfo = nebula::meta::ClusterInfo::singleton();
+  auto load = [&clusterInfo, yamlFile]() {
+    clusterInfo.load(yamlFile, [](const nebula::meta::MetaConf&) {
+      return std::unique_ptr<nebula::meta::MetaDb>(new nebula::meta::VoidDb());
+    });
+  };
+
+  auto find = [&clusterInfo](const std::string& name) -> nebula::meta::TableSpecPtr {
+    for (const auto& table : clusterInfo.tables()) {
+      if (table->name == name) {
+        return table;
+      }
+    }
+
+    return nullptr;
+  };
+
+  const std::string tableDef = R"(
+    retention:
+      max-mb: 100
+      max-hr: 24
+    schema: "ROW<name:string, value:int>"
+    data: kafka
+    loader: Streaming
+    source: broker:9092
+    backup: s3://nebula/n116/
+    format: json
+    kafka:
+      topic: test3
+    time:
+      type: provided
+    settings:
+      batch: )";
+  EXPECT_EQ(clusterInfo.addTable("k.diff", tableDef + "100").size(), 0);
+  load();
+  auto test = find("nebula.test");
+  auto diff = find("k.diff");
+  EXPECT_TRUE(test != nullptr);
+  EXPECT_TRUE(diff != nullptr);
+
+  // tables not changed keep their specs
+  load();
+  EXPECT_EQ(find("nebula.test"), test);
+  EXPECT_EQ(find("k.diff"), diff);
+
+  // only the changed table gets a new spec
+  EXPECT_EQ(clusterInfo.addTable("k.diff", tableDef + "200").size(), 0);
+  load();
+  EXPECT_EQ(find("nebula.test"), test);
+  auto changed = find("k.diff");
+  EXPECT_NE(changed, diff);
+  EXPECT_EQ(changed->settings.at("batch"), "200");
+}
+
 TEST(MetaTest, TestAccessRules) {
   auto schema = nebula::type::TypeSerializer::from(
     "ROW<_time_: bigint, id:int, event:string, email:string, fund:bigint>");
@@ -92,6 +92,26 @@ TEST(MetaTest, TestTableSpecSerde) {
   EXPECT_EQ(spec2.settings.at("key1"), "value1");
   EXPECT_EQ(spec2.settings.at("key2"), "value2");
 }
+
+TEST(MetaTest, TestRetentionTiers) {
+  TableSpec spec;
+  spec.name = "t";
+  spec.max_seconds = 86400;
+  EXPECT_EQ(spec.horizon(), 86400);
+
+  // an hourly rollup kept as long as raw rows and a daily one kept for 30 days
+  spec.rollups.push_back(RollupSpec{ "hourly", { "country" }, { "value" }, 3600 });
+  spec.rollups.push_back(RollupSpec{ "daily", { "country" }, { "value" }, 86400, 30 * 86400 });
+  EXPECT_EQ(spec.retention(spec.rollups.at(0)), 86400);
+  EXPECT_EQ(spec.retention(spec.rollups.at(1)), 30 * 86400);
+  EXPECT_EQ(spec.horizon(), 30 * 86400);
+
+  auto copy = TableSpec::deserialize(TableSpec::serialize(spec));
+  EXPECT_EQ(copy->rollups.size(), 2);
+  EXPECT_EQ(copy->rollups.at(0).retention, 0);
+  EXPECT_EQ(copy->rollups.at(1).retention, 30 * 86400);
+  EXPECT_EQ(copy->horizon(), 30 * 86400);
+}
 } // namespace test
 } // namespace meta
 } // namespace nebula
@@ -79,14 +79,24 @@ set_property(SOURCE ${nodegrpc_srcs} PROPERTY GENERATED 1)
 
 # build everything else as library except executable of NebulaServer and NebulaClient
 add_library(${NEBULA_SERVICE} STATIC
+    ${NEBULA_SRC}/service/base/ColumnarBatch.cpp
     ${NEBULA_SRC}/service/base/NativeMetaDb.cpp
     ${NEBULA_SRC}/service/base/NebulaService.cpp
+    ${NEBULA_SRC}/service/base/MetricsEndpoint.cpp
+    ${NEBULA_SRC}/service/client/Replay.cpp
     ${NEBULA_SRC}/service/node/ConnectionPool.cpp
+    ${NEBULA_SRC}/service/node/CpuProfiler.cpp
     ${NEBULA_SRC}/service/node/NodeClient.cpp
+    ${NEBULA_SRC}/service/node/PlanCache.cpp
     ${NEBULA_SRC}/service/node/TaskExecutor.cpp
     ${NEBULA_SRC}/service/server/LoadHandler.cpp
     ${NEBULA_SRC}/service/server/NodeSync.cpp
+    ${NEBULA_SRC}/service/server/QueryCache.cpp
+    ${NEBULA_SRC}/service/server/QueryCapture.cpp
+    ${NEBULA_SRC}/service/server/QueryFlights.cpp
     ${NEBULA_SRC}/service/server/QueryHandler.cpp
+    ${NEBULA_SRC}/service/server/ResultPages.cpp
+    ${NEBULA_SRC}/service/server/SlowQueryLog.cpp
     ${nproto_srcs}
     ${ngrpc_srcs}
     ${nodegrpc_srcs})
@@ -124,12 +134,15 @@ endif()
 
 # Targets: 
 #   client/NebulaClient
+#   client/NebulaReplay
 #   server/NebulaServer
 #   node/NodeServer
 list(APPEND dirs "client")
+list(APPEND dirs "client")
 list(APPEND dirs "server")
 list(APPEND dirs "node")
 list(APPEND targets "NebulaClient")
+list(APPEND targets "NebulaReplay")
 list(APPEND targets "NebulaServer")
 list(APPEND targets "NodeServer")
 list(LENGTH dirs count)
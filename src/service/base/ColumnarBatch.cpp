@@ -0,0 +1,373 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ColumnarBatch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+
+#include "surface/eval/Aggregator.h"
+
+/**
+ * Columnar batch writer and reader.
+ */
+namespace nebula {
+namespace service {
+namespace base {
+
+using nebula::common::ExtendableSlice;
+using nebula::memory::keyed::FlatBuffer;
+using nebula::surface::IndexType;
+using nebula::surface::ListData;
+using nebula::surface::MapData;
+using nebula::surface::RowData;
+using nebula::surface::eval::Fields;
+using nebula::surface::eval::Sketch;
+using nebula::surface::eval::ValueEval;
+using nebula::type::Kind;
+using nebula::type::Schema;
+
+// sketch of an aggregate field, same as the one created by flat buffer
+static std::shared_ptr<Sketch> makeSketch(const ValueEval& f) {
+  const auto ot = f.outputType();
+  const auto it = f.inputType();
+
+#define LOGIC_BY_IO(O, I)                \
+  case Kind::I: {                        \
+    return f.sketch<Kind::O, Kind::I>(); \
+  }
+
+  ITERATE_BY_IO(ot, it)
+
+#undef LOGIC_BY_IO
+
+  return nullptr;
+}
+
+bool ColumnarBatch::supports(const Schema& schema) noexcept {
+  for (size_t i = 0, size = schema->size(); i < size; ++i) {
+    switch (schema->childType(i)->k()) {
+    case Kind::BOOLEAN:
+    case Kind::TINYINT:
+    case Kind::SMALLINT:
+    case Kind::INTEGER:
+    case Kind::BIGINT:
+    case Kind::REAL:
+    case Kind::DOUBLE:
+    case Kind::INT128:
+    case Kind::VARCHAR: break;
+    default: return false;
+    }
+  }
+
+  return true;
+}
+
+// values of all rows of a column are written into the builder in place, null as default value
+template <typename T, typename R>
+static flatbuffers::Offset<flatbuffers::Vector<T>> vectorOf(
+  flatbuffers::FlatBufferBuilder& fbb, FlatBuffer& fb, size_t column, size_t width, R read) {
+  const auto rows = fb.getRows();
+  T* data;
+  auto offset = fbb.CreateUninitializedVector<T>(rows * width, &data);
+  for (size_t r = 0; r < rows; ++r) {
+    const auto& row = fb.row(r);
+    if (row.isNull(column)) {
+      std::fill(data, data + width, T());
+    } else {
+      read(row, data);
+    }
+
+    data += width;
+  }
+
+  return offset;
+}
+
+flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Column>>> ColumnarBatch::write(
+  flatbuffers::FlatBufferBuilder& fbb, FlatBuffer& fb, const Fields& fields) {
+  const auto& schema = fb.schema();
+  const auto numColumns = schema->size();
+  const auto rows = fb.getRows();
+
+  // validity of all columns in one pass of rows
+  const auto bitmap = (rows + 7) / 8;
+  std::vector<std::vector<uint8_t>> valid(numColumns, std::vector<uint8_t>(bitmap, 0));
+  std::vector<bool> nulls(numColumns, false);
+  for (size_t r = 0; r < rows; ++r) {
+    const auto& row = fb.row(r);
+    for (size_t i = 0; i < numColumns; ++i) {
+      if (row.isNull(i)) {
+        nulls[i] = true;
+      } else {
+        valid[i][r / 8] |= (1 << (r % 8));
+      }
+    }
+  }
+
+  std::vector<flatbuffers::Offset<Column>> columns;
+  columns.reserve(numColumns);
+  for (size_t i = 0; i < numColumns; ++i) {
+    // all vectors of a column are created before the column table
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> validity;
+    if (nulls[i]) {
+      validity = fbb.CreateVector(valid[i]);
+    }
+
+    // aggregate column has its sketches only
+    if (fields.at(i)->isAggregate()) {
+      ExtendableSlice slice(1024);
+      std::vector<uint64_t> ends;
+      ends.reserve(rows);
+      size_t offset = 0;
+      for (size_t r = 0; r < rows; ++r) {
+        auto sketch = fb.row(r).getAggregator(i);
+        if (sketch) {
+          offset += sketch->serialize(slice, offset);
+        }
+
+        ends.push_back(offset);
+      }
+
+      const auto bytes = slice.read(0, offset);
+      auto sketches = fbb.CreateVector(reinterpret_cast<const int8_t*>(bytes.data()), bytes.size());
+      auto endsOffset = fbb.CreateVector(ends);
+      ColumnBuilder cb(fbb);
+      cb.add_valid(validity);
+      cb.add_sketches(sketches);
+      cb.add_ends(endsOffset);
+      columns.push_back(cb.Finish());
+      continue;
+    }
+
+    const auto kind = schema->childType(i)->k();
+
+#define SCALAR_COLUMN(KIND, STORE, FUNC, FIELD)                                         \
+  case Kind::KIND: {                                                                    \
+    auto values = vectorOf<STORE>(fbb, fb, i, 1, [i](const RowData& row, STORE* data) { \
+      *data = row.FUNC(i);                                                              \
+    });                                                                                 \
+    ColumnBuilder cb(fbb);                                                              \
+    cb.add_valid(validity);                                                             \
+    cb.add_##FIELD(values);                                                             \
+    columns.push_back(cb.Finish());                                                     \
+    break;                                                                              \
+  }
+
+    switch (kind) {
+      SCALAR_COLUMN(BOOLEAN, uint8_t, readBool, bools)
+      SCALAR_COLUMN(TINYINT, int8_t, readByte, bytes)
+      SCALAR_COLUMN(SMALLINT, int16_t, readShort, shorts)
+      SCALAR_COLUMN(INTEGER, int32_t, readInt, ints)
+      SCALAR_COLUMN(BIGINT, int64_t, readLong, longs)
+      SCALAR_COLUMN(REAL, float, readFloat, floats)
+      SCALAR_COLUMN(DOUBLE, double, readDouble, doubles)
+    case Kind::INT128: {
+      auto values = vectorOf<int64_t>(fbb, fb, i, 2, [i](const RowData& row, int64_t* data) {
+        const auto v = row.readInt128(i);
+        std::memcpy(data, &v, sizeof(v));
+      });
+      ColumnBuilder cb(fbb);
+      cb.add_valid(validity);
+      cb.add_longs(values);
+      columns.push_back(cb.Finish());
+      break;
+    }
+    case Kind::VARCHAR: {
+      // string views refer to the flat buffer which outlives this method
+      nebula::common::unordered_map<std::string_view, uint32_t> codes;
+      std::vector<std::string_view> dict;
+      auto values = vectorOf<uint32_t>(fbb, fb, i, 1, [i, &codes, &dict](const RowData& row, uint32_t* data) {
+        const auto v = row.readString(i);
+        auto found = codes.find(v);
+        if (found != codes.end()) {
+          *data = found->second;
+          return;
+        }
+
+        *data = dict.size();
+        codes.emplace(v, *data);
+        dict.push_back(v);
+      });
+
+      std::vector<flatbuffers::Offset<flatbuffers::String>> strings;
+      strings.reserve(dict.size());
+      for (const auto& s : dict) {
+        strings.push_back(fbb.CreateString(s.data(), s.size()));
+      }
+
+      auto dictOffset = fbb.CreateVector(strings);
+      ColumnBuilder cb(fbb);
+      cb.add_valid(validity);
+      cb.add_dict(dictOffset);
+      cb.add_codes(values);
+      columns.push_back(cb.Finish());
+      break;
+    }
+    default: throw NException(fmt::format("Column type not supported in columnar batch: {0}", (int)kind));
+    }
+
+#undef SCALAR_COLUMN
+  }
+
+  return fbb.CreateVector(columns);
+}
+
+ColumnarRowCursor::ColumnarRowCursor(const Schema& schema, const Fields& fields, const BatchRows& batch)
+  : nebula::surface::RowCursor(batch.rows()),
+    fields_{ nebula::surface::SchemaRow::name2index(schema) },
+    current_{ *this, 0 } {
+  const auto columns = batch.columns();
+  const auto numColumns = schema->size();
+  N_ENSURE(columns != nullptr && columns->size() == numColumns, "columnar batch should have all columns");
+
+  // copy raw bytes of a typed vector
+  auto copy = [](auto vector, std::vector<char>& values) {
+    if (vector) {
+      const auto bytes = vector->size() * sizeof(*vector->data());
+      values.resize(bytes);
+      std::memcpy(values.data(), vector->data(), bytes);
+    }
+  };
+
+  columns_.resize(numColumns);
+  for (size_t i = 0; i < numColumns; ++i) {
+    const auto c = columns->Get(i);
+    auto& data = columns_[i];
+    if (c->valid()) {
+      data.valid.assign(c->valid()->begin(), c->valid()->end());
+    }
+
+    // sketches are loaded from the binary of the column
+    if (fields.at(i)->isAggregate()) {
+      const auto bytes = c->sketches();
+      const auto ends = c->ends();
+      N_ENSURE(bytes != nullptr && ends != nullptr && ends->size() == size_, "sketches of every row expected");
+      ExtendableSlice slice(reinterpret_cast<const NByte*>(bytes->data()), bytes->size());
+      data.sketches.reserve(size_);
+      uint64_t offset = 0;
+      for (auto end : *ends) {
+        std::shared_ptr<Sketch> sketch;
+        if (end > offset) {
+          sketch = makeSketch(*fields.at(i));
+          N_ENSURE_NOT_NULL(sketch, "aggregated field should have sketch");
+          N_ENSURE_EQ(sketch->load(slice, offset), end - offset, "loaded size should be the same as it stored");
+        }
+
+        data.sketches.push_back(std::move(sketch));
+        offset = end;
+      }
+
+      continue;
+    }
+
+    switch (schema->childType(i)->k()) {
+    case Kind::BOOLEAN: copy(c->bools(), data.values); break;
+    case Kind::TINYINT: copy(c->bytes(), data.values); break;
+    case Kind::SMALLINT: copy(c->shorts(), data.values); break;
+    case Kind::INTEGER: copy(c->ints(), data.values); break;
+    case Kind::BIGINT:
+    case Kind::INT128: copy(c->longs(), data.values); break;
+    case Kind::REAL: copy(c->floats(), data.values); break;
+    case Kind::DOUBLE: copy(c->doubles(), data.values); break;
+    case Kind::VARCHAR: {
+      if (c->dict()) {
+        data.dict.reserve(c->dict()->size());
+        for (auto s : *c->dict()) {
+          data.dict.push_back(s->str());
+        }
+      }
+
+      if (c->codes()) {
+        data.codes.assign(c->codes()->begin(), c->codes()->end());
+      }
+      break;
+    }
+    default: throw NException("Column type not supported in columnar batch");
+    }
+  }
+}
+
+ColumnarRow::ColumnarRow(const ColumnarRowCursor& cursor, size_t row)
+  : nebula::surface::SchemaRow(cursor.fields_), cursor_{ cursor }, row_{ row } {}
+
+bool ColumnarRow::isNull(IndexType i) const {
+  const auto& valid = cursor_.columns_[i].valid;
+  return !valid.empty() && (valid[row_ / 8] & (1 << (row_ % 8))) == 0;
+}
+
+template <typename T>
+T ColumnarRow::value(IndexType i) const {
+  // no value for aggregate column, its sketch is read instead
+  const auto& values = cursor_.columns_[i].values;
+  if (values.empty()) {
+    return T();
+  }
+
+  T v;
+  std::memcpy(&v, values.data() + row_ * sizeof(T), sizeof(T));
+  return v;
+}
+
+bool ColumnarRow::readBool(IndexType i) const {
+  return value<uint8_t>(i) != 0;
+}
+
+#define READ_VALUE(TYPE, FUNC)                \
+  TYPE ColumnarRow::FUNC(IndexType i) const { \
+    return value<TYPE>(i);                    \
+  }
+
+READ_VALUE(int8_t, readByte)
+READ_VALUE(int16_t, readShort)
+READ_VALUE(int32_t, readInt)
+READ_VALUE(int64_t, readLong)
+READ_VALUE(float, readFloat)
+READ_VALUE(double, readDouble)
+READ_VALUE(int128_t, readInt128)
+
+#undef READ_VALUE
+
+std::string_view ColumnarRow::readString(IndexType i) const {
+  const auto& column = cursor_.columns_[i];
+  if (column.codes.empty()) {
+    return {};
+  }
+
+  return column.dict[column.codes[row_]];
+}
+
+std::unique_ptr<ListData> ColumnarRow::readList(IndexType) const {
+  throw NException("List is not supported in columnar batch");
+}
+
+std::unique_ptr<MapData> ColumnarRow::readMap(IndexType) const {
+  throw NException("Map is not supported in columnar batch");
+}
+
+std::shared_ptr<Sketch> ColumnarRow::getAggregator(IndexType i) const {
+  const auto& sketches = cursor_.columns_[i].sketches;
+  return sketches.empty() ? nullptr : sketches[row_];
+}
+
+std::shared_ptr<Sketch> ColumnarRow::getAggregator(const std::string& field) const {
+  return getAggregator(cursor_.fields_.at(field));
+}
+
+} // namespace base
+} // namespace service
+} // namespace nebula
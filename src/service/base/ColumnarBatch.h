@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "common/Hash.h"
+#include "memory/keyed/FlatBuffer.h"
+#include "node/node_generated.h"
+#include "surface/DataSurface.h"
+#include "surface/SchemaRow.h"
+#include "surface/eval/ValueEval.h"
+#include "type/Type.h"
+
+/**
+ * Columnar batch is a wire format of query result between node and server, as an alternative to flat.
+ * Every column is a typed vector with a validity bitmap, strings are coded by a dictionary of the column,
+ * and sketches of an aggregate column are serialized in binary one after another.
+ * Server reads values from column vectors directly rather than rebuilding rows of a flat buffer.
+ * Compound types are not supported, a result having them is sent in flat format.
+ */
+namespace nebula {
+namespace service {
+namespace base {
+
+class ColumnarBatch {
+public:
+  // all columns of the schema can be in columnar batch
+  static bool supports(const nebula::type::Schema&) noexcept;
+
+  // write all rows of the flat buffer as columns
+  static flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<Column>>> write(
+    flatbuffers::FlatBufferBuilder&,
+    nebula::memory::keyed::FlatBuffer&,
+    const nebula::surface::eval::Fields&);
+};
+
+class ColumnarRowCursor;
+
+// a row of columnar batch by its position
+class ColumnarRow : public nebula::surface::SchemaRow {
+public:
+  ColumnarRow(const ColumnarRowCursor& cursor, size_t row);
+  virtual ~ColumnarRow() = default;
+
+  inline void seek(size_t row) noexcept {
+    row_ = row;
+  }
+
+  bool isNull(nebula::surface::IndexType) const override;
+  bool readBool(nebula::surface::IndexType) const override;
+  int8_t readByte(nebula::surface::IndexType) const override;
+  int16_t readShort(nebula::surface::IndexType) const override;
+  int32_t readInt(nebula::surface::IndexType) const override;
+  int64_t readLong(nebula::surface::IndexType) const override;
+  float readFloat(nebula::surface::IndexType) const override;
+  double readDouble(nebula::surface::IndexType) const override;
+  int128_t readInt128(nebula::surface::IndexType) const override;
+  std::string_view readString(nebula::surface::IndexType) const override;
+  std::unique_ptr<nebula::surface::ListData> readList(nebula::surface::IndexType) const override;
+  std::unique_ptr<nebula::surface::MapData> readMap(nebula::surface::IndexType) const override;
+  std::shared_ptr<nebula::surface::eval::Sketch> getAggregator(nebula::surface::IndexType) const override;
+  std::shared_ptr<nebula::surface::eval::Sketch> getAggregator(const std::string&) const override;
+
+  // make name based methods of base class visible
+  using nebula::surface::SchemaRow::isNull;
+  using nebula::surface::SchemaRow::readBool;
+  using nebula::surface::SchemaRow::readByte;
+  using nebula::surface::SchemaRow::readShort;
+  using nebula::surface::SchemaRow::readInt;
+  using nebula::surface::SchemaRow::readLong;
+  using nebula::surface::SchemaRow::readFloat;
+  using nebula::surface::SchemaRow::readDouble;
+  using nebula::surface::SchemaRow::readInt128;
+  using nebula::surface::SchemaRow::readString;
+  using nebula::surface::SchemaRow::readList;
+  using nebula::surface::SchemaRow::readMap;
+
+private:
+  template <typename T>
+  T value(nebula::surface::IndexType) const;
+
+private:
+  const ColumnarRowCursor& cursor_;
+  size_t row_;
+};
+
+// row cursor over a columnar batch, column data is copied out so the message can be released
+class ColumnarRowCursor : public nebula::surface::RowCursor {
+  friend class ColumnarRow;
+
+  struct ColumnData {
+    // validity bitmap, empty if no null
+    std::vector<uint8_t> valid;
+    // raw values of fixed width, empty for string and aggregate column
+    std::vector<char> values;
+    std::vector<std::string> dict;
+    std::vector<uint32_t> codes;
+    std::vector<std::shared_ptr<nebula::surface::eval::Sketch>> sketches;
+  };
+
+public:
+  ColumnarRowCursor(const nebula::type::Schema&, const nebula::surface::eval::Fields&, const BatchRows&);
+  virtual ~ColumnarRowCursor() = default;
+
+  virtual const nebula::surface::RowData& next() override {
+    current_.seek(index_++);
+    return current_;
+  }
+
+  virtual std::unique_ptr<nebula::surface::RowData> item(size_t index) const override {
+    return std::make_unique<ColumnarRow>(*this, index);
+  }
+
+private:
+  const nebula::surface::Name2Index fields_;
+  std::vector<ColumnData> columns_;
+  ColumnarRow current_;
+};
+
+} // namespace base
+} // namespace service
+} // namespace nebula
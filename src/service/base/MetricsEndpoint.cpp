@@ -0,0 +1,162 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MetricsEndpoint.h"
+
+#include <arpa/inet.h>
+#include <array>
+#include <cstring>
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common/Memory.h"
+#include "common/Metrics.h"
+
+/**
+ * Implement the metrics endpoint.
+ */
+namespace nebula {
+namespace service {
+namespace base {
+
+using nebula::common::Metrics;
+using nebula::common::Pool;
+using nebula::common::PoolCategory;
+
+MetricsEndpoint::MetricsEndpoint(int port) : fd_{ -1 }, stopped_{ false } {
+  if (port <= 0) {
+    return;
+  }
+
+  const auto fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    LOG(ERROR) << "Failed to create socket for metrics endpoint";
+    return;
+  }
+
+  int on = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 16) != 0) {
+    LOG(ERROR) << "Failed to listen on port " << port << " for metrics endpoint";
+    ::close(fd);
+    return;
+  }
+
+  fd_ = fd;
+  thread_ = std::thread([this]() { serve(); });
+  LOG(INFO) << "Metrics endpoint listening on " << port;
+}
+
+MetricsEndpoint::~MetricsEndpoint() {
+  if (fd_ < 0) {
+    return;
+  }
+
+  // shutting down the socket wakes up the blocking accept
+  stopped_ = true;
+  ::shutdown(fd_, SHUT_RDWR);
+  ::close(fd_);
+  thread_.join();
+}
+
+void MetricsEndpoint::serve() {
+  while (!stopped_) {
+    const auto client = ::accept(fd_, nullptr, nullptr);
+    if (client < 0) {
+      continue;
+    }
+
+    // a slow client doesn't hold the endpoint
+    timeval timeout{ 5, 0 };
+    ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    reply(client);
+    ::close(client);
+  }
+}
+
+void MetricsEndpoint::reply(int client) const {
+  // the request line is all we need, the rest of the request is ignored
+  char buffer[1024];
+  const auto size = ::recv(client, buffer, sizeof(buffer) - 1, 0);
+  if (size <= 0) {
+    return;
+  }
+
+  buffer[size] = '\0';
+  constexpr std::string_view GET = "GET /metrics";
+  std::string response;
+  if (std::string_view(buffer, size).substr(0, GET.size()) == GET) {
+    const auto body = Metrics::singleton().expose();
+    response = fmt::format(
+      "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {0}\r\nConnection: close\r\n\r\n{1}",
+      body.size(),
+      body);
+  } else {
+    response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+  }
+
+  for (size_t sent = 0; sent < response.size();) {
+    const auto n = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+
+    sent += n;
+  }
+}
+
+void registerProcessMetrics() {
+  auto& metrics = Metrics::singleton();
+  constexpr std::array<std::pair<PoolCategory, const char*>, 3> CATEGORIES{
+    { { PoolCategory::SMALL, "small" }, { PoolCategory::LARGE, "large" }, { PoolCategory::HUGE_PAGE, "huge" } }
+  };
+
+  for (const auto& [category, name] : CATEGORIES) {
+    const auto labels = fmt::format("{{category=\"{0}\"}}", name);
+    metrics.counter(
+      "nebula_pool_allocated_bytes_total",
+      "bytes allocated by memory pool",
+      [c = category]() { return Pool::getDefault().allocated(c); },
+      labels);
+    metrics.counter(
+      "nebula_pool_extended_bytes_total",
+      "bytes extended by memory pool",
+      [c = category]() { return Pool::getDefault().extended(c); },
+      labels);
+    metrics.counter(
+      "nebula_pool_freed_bytes_total",
+      "bytes freed to memory pool",
+      [c = category]() { return Pool::getDefault().freed(c); },
+      labels);
+  }
+
+  metrics.counter("nebula_pool_cache_hits_total", "small allocations served by thread caches", []() {
+    return Pool::getDefault().hits();
+  });
+}
+
+} // namespace base
+} // namespace service
+} // namespace nebula
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+/**
+ * A minimal HTTP endpoint serving process metrics for Prometheus to scrape at "GET /metrics".
+ * It runs one thread accepting connections one by one, every scrape is a short request replied with all metrics.
+ */
+namespace nebula {
+namespace service {
+namespace base {
+
+class MetricsEndpoint final {
+public:
+  // listen on given port, no endpoint for port 0
+  explicit MetricsEndpoint(int port);
+  ~MetricsEndpoint();
+
+  inline bool running() const noexcept {
+    return fd_ >= 0;
+  }
+
+private:
+  void serve();
+  void reply(int) const;
+
+private:
+  int fd_;
+  std::atomic<bool> stopped_;
+  std::thread thread_;
+};
+
+// metrics of memory pool shared by server and nodes
+void registerProcessMetrics();
+
+} // namespace base
+} // namespace service
+} // namespace nebula
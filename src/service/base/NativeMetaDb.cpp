@@ -19,12 +19,14 @@
 #include <fstream>
 #include <gflags/gflags.h>
 
+#include "common/Chars.h"
 #include "common/Errors.h"
 #include "meta/TableSpec.h"
 
 // default 100mb memory cache for the meta db
 DEFINE_uint64(DB_CACHE_SIZE, 100 * 1048576, "memory cache size of the db.");
 DEFINE_int64(DB_BACKUP_INTERVAL, 5 * 60000, "time interval milliseconds to backup the DB");
+DEFINE_uint64(DB_COMMIT_WINDOW, 20, "milliseconds queued writes wait to be committed in one batch");
 
 /**
  * provide common data operations for service
@@ -35,13 +37,18 @@ namespace base {
 
 using dsu = nebula::meta::DataSourceUtils;
 
+// leveldb table files are immutable once written, all others (manifest, log, current) change
+static bool immutable(std::string_view name) {
+  const auto ext = name.substr(name.size() < 4 ? 0 : name.size() - 4);
+  return ext == ".ldb" || ext == ".sst";
+}
+
 void NativeMetaDb::open() {
   leveldb::Status status = leveldb::DB::Open(options_, local_, &db_);
   N_ENSURE(status.ok(), "Failed to open native meta db");
 }
 
 void NativeMetaDb::restore() noexcept {
-  auto localFs = nebula::storage::makeFS("local", "");
   auto uriInfo = nebula::storage::parse(remote_);
   if (!uriInfo.schema.empty()) {
     // sync all remote data into a local folder
@@ -51,12 +58,41 @@ void NativeMetaDb::restore() noexcept {
     const auto versionKey = fmt::format("{0}/version", uriInfo.path);
     char version[32];
     auto size = fs->read(versionKey, version, sizeof(version));
-    if (size > 0) {
-      // if existing the version, we download it to local to start with
-      auto snapshot = fmt::format("{0}/{1}", uriInfo.path, std::string_view(version, size));
+    if (size == 0) {
+      return;
+    }
+
+    // if existing the version, we download it to local to start with
+    auto snapshot = fmt::format("{0}/{1}", uriInfo.path, std::string_view(version, size));
+    try {
+      // files of the snapshot may be held by earlier snapshots as listed by its manifest
+      const auto manifest = fs_->temp();
+      if (fs->copy(fmt::format("{0}/{1}", snapshot, MANIFEST), manifest)) {
+        std::ifstream lines(manifest);
+        std::string name;
+        std::string holder;
+        while (lines >> name >> holder) {
+          if (!fs->copy(fmt::format("{0}/{1}/{2}", uriInfo.path, holder, name), fmt::format("{0}/{1}", local_, name))) {
+            LOG(ERROR) << "Failed to restore file " << name << " of metadb snapshot: " << snapshot;
+            return;
+          }
+
+          if (immutable(name)) {
+            remoteFiles_.emplace(name, holder);
+          }
+        }
+
+        fs_->rm(manifest);
+        LOG(INFO) << "Reuse metadb saved at: " << snapshot << ", files: " << remoteFiles_.size();
+        return;
+      }
+
+      // a snapshot without manifest holds all its files
       if (fs->sync(snapshot, local_)) {
         LOG(INFO) << "Reuse metadb saved at: " << snapshot;
       }
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Failed to restore metadb snapshot " << snapshot << ": " << ex.what();
     }
 
     return;
@@ -73,7 +109,9 @@ NativeMetaDb::NativeMetaDb(
   size_t cacheSize)
   : remote_{ remote },
     fs_{ nebula::storage::makeFS("local") },
-    dirty_{ false } {
+    dirty_{ false },
+    stopped_{ false },
+    db_{ nullptr } {
   // if cache size is not provided by method call, use the default one
   if (cacheSize == 0) {
     cacheSize = FLAGS_DB_CACHE_SIZE;
@@ -94,9 +132,18 @@ NativeMetaDb::NativeMetaDb(
   options_.create_if_missing = true;
   options_.block_cache = leveldb::NewLRUCache(cacheSize);
   open();
+
+  committer_ = std::thread([this]() { commit(); });
 }
 
 NativeMetaDb::~NativeMetaDb() {
+  stop();
+
+  // do one more time backup if dirty data available since last sync
+  if (dirty_ && !remote_.empty()) {
+    upload();
+  }
+
   // we want this destroy order so not using smart pointers
   if (db_) {
     delete db_;
@@ -105,75 +152,181 @@ NativeMetaDb::~NativeMetaDb() {
   if (options_.block_cache) {
     delete options_.block_cache;
   }
+}
 
-  // do one more time backup if dirty data available since last sync
-  backup();
+bool NativeMetaDb::read(const std::string& key, std::string& value) const {
+  // queued writes are read first as they are the latest
+  {
+    std::lock_guard<std::mutex> lock(writes_);
+    for (const auto* writes : { &pending_, &committing_ }) {
+      auto found = writes->find(key);
+      if (found != writes->end()) {
+        value = found->second;
+        return true;
+      }
+    }
+  }
+
+  std::shared_lock<std::shared_mutex> lock(dbLock_);
+  return db_ && db_->Get(ropts_, key, &value).ok();
 }
 
 bool NativeMetaDb::write(const std::string& key, const std::string& value) {
-  auto status = db_->Put(wopts_, key, value);
-  auto ok = status.ok();
-  if (ok) {
-    // any successful write will cause the db dirty (in terms of in sync with backup)
-    if (remote_.size() > 0
-        && !dirty_
-        && tick_.elapsedMs() > FLAGS_DB_BACKUP_INTERVAL) {
-      // close db
-      close();
-
-      // reopen the same db
-      open();
-
-      // reset tick
-      tick_.reset();
+  std::lock_guard<std::mutex> lock(writes_);
+  if (stopped_) {
+    return false;
+  }
+
+  batch_.Put(key, value);
+  pending_[key] = value;
+  if (pending_.size() == 1 || pending_.size() >= BATCH_MAX) {
+    queued_.notify_one();
+  }
+
+  return true;
+}
+
+void NativeMetaDb::commit() {
+  std::unique_lock<std::mutex> lock(writes_);
+  while (!stopped_) {
+    queued_.wait(lock, [this]() { return stopped_ || !pending_.empty(); });
+
+    // writes arriving in the window are committed together (group commit)
+    queued_.wait_for(lock, std::chrono::milliseconds(FLAGS_DB_COMMIT_WINDOW), [this]() {
+      return stopped_ || pending_.size() >= BATCH_MAX;
+    });
+
+    flush(lock);
+  }
+
+  flush(lock);
+}
+
+void NativeMetaDb::flush(std::unique_lock<std::mutex>& lock) {
+  if (pending_.empty()) {
+    return;
+  }
+
+  // writes being committed stay visible to reads until they are in db
+  leveldb::WriteBatch batch;
+  batch.Append(batch_);
+  batch_.Clear();
+  std::swap(pending_, committing_);
+  lock.unlock();
+
+  {
+    std::shared_lock<std::shared_mutex> db(dbLock_);
+    auto status = db_ ? db_->Write(wopts_, &batch) : leveldb::Status::IOError("db closed");
+    if (status.ok()) {
+      dirty_ = true;
+    } else {
+      LOG(ERROR) << "Failed to commit metadb writes: " << status.ToString();
     }
   }
 
-  return ok;
+  lock.lock();
+  committing_.clear();
+}
+
+void NativeMetaDb::stop() {
+  {
+    std::lock_guard<std::mutex> lock(writes_);
+    stopped_ = true;
+  }
+
+  queued_.notify_one();
+  if (committer_.joinable()) {
+    committer_.join();
+  }
 }
 
 bool NativeMetaDb::backup() noexcept {
-  // upload data from backup_ to remote_
-  if (dirty_) {
-    auto uriInfo = nebula::storage::parse(remote_);
-    // sync all remote data into a local folder
-    auto fs = nebula::storage::makeFS(uriInfo.schema, uriInfo.host);
+  // upload changes if any since last backup, not more often than the backup interval
+  if (remote_.empty() || !dirty_ || tick_.elapsedMs() < FLAGS_DB_BACKUP_INTERVAL) {
+    return false;
+  }
 
-    // generate a new unique snapshot
-    auto version = std::to_string(nebula::common::Evidence::unix_timestamp());
-    auto snapshot = fmt::format("{0}/{1}", uriInfo.path, version);
+  tick_.reset();
+  return upload();
+}
 
-    // failed to upload this snapshot
-    if (!fs->sync(backup_, snapshot)) {
-      return false;
+bool NativeMetaDb::upload() noexcept {
+  auto uriInfo = nebula::storage::parse(remote_);
+  auto fs = nebula::storage::makeFS(uriInfo.schema, uriInfo.host);
+
+  // generate a new unique snapshot
+  auto version = std::to_string(nebula::common::Evidence::unix_timestamp());
+  auto snapshot = fmt::format("{0}/{1}", uriInfo.path, version);
+
+  // stage a consistent copy of changed files while db is closed, writes queue up in the meantime
+  resetBackup();
+  std::vector<std::pair<std::string, std::string>> files;
+  {
+    std::unique_lock<std::shared_mutex> lock(dbLock_);
+    dirty_ = false;
+    if (db_) {
+      delete db_;
+      db_ = nullptr;
     }
 
-    LOG(INFO) << "Sync DB from " << backup_ << " to snapshot=" << snapshot;
-    // write this version into version file
-    auto versionFile = fmt::format("{0}/version", backup_);
-    auto remoteVersion = fmt::format("{0}/version", uriInfo.path);
-    std::ofstream ofs;
-    ofs.open(versionFile, std::ofstream::out);
-    ofs << version;
-    ofs.close();
-
-    // upload this file into S3
-    auto versionUpdated = fs->copy(versionFile, remoteVersion);
-
-    // clean backup folder for next sync
-    if (versionUpdated) {
-      dirty_ = false;
-      resetBackup();
+    for (const auto& f : fs_->list(local_)) {
+      std::string name(nebula::common::Chars::last(f.name));
+      auto found = remoteFiles_.find(name);
+      if (found != remoteFiles_.end()) {
+        files.emplace_back(std::move(name), found->second);
+        continue;
+      }
+
+      fs_->copy(f.name, fmt::format("{0}/{1}", backup_, name));
+      files.emplace_back(std::move(name), version);
     }
 
-    return versionUpdated;
+    open();
   }
 
-  return false;
+  // the manifest lists all files of the snapshot and where they are
+  {
+    std::ofstream manifest(fmt::format("{0}/{1}", backup_, MANIFEST));
+    for (const auto& [name, holder] : files) {
+      manifest << name << ' ' << holder << '\n';
+    }
+  }
+
+  // failed to upload this snapshot
+  if (!fs->sync(backup_, snapshot)) {
+    dirty_ = true;
+    return false;
+  }
+
+  LOG(INFO) << "Sync DB from " << backup_ << " to snapshot=" << snapshot << ", files: " << files.size();
+  // write this version into version file
+  auto versionFile = fmt::format("{0}/version", backup_);
+  auto remoteVersion = fmt::format("{0}/version", uriInfo.path);
+  std::ofstream ofs;
+  ofs.open(versionFile, std::ofstream::out);
+  ofs << version;
+  ofs.close();
+
+  // upload this file into S3
+  if (!fs->copy(versionFile, remoteVersion)) {
+    dirty_ = true;
+    return false;
+  }
+
+  // table files uploaded are referenced by later snapshots
+  for (const auto& [name, holder] : files) {
+    if (holder == version && immutable(name)) {
+      remoteFiles_.emplace(name, holder);
+    }
+  }
+
+  // clean backup folder for next sync
+  resetBackup();
+  return true;
 }
 
 void NativeMetaDb::resetBackup() {
-  if (fs_->list(backup_).size() != 0) {
+  if (!backup_.empty() && fs_->list(backup_).size() != 0) {
     fs_->rm(backup_);
   }
 
@@ -182,21 +335,19 @@ void NativeMetaDb::resetBackup() {
 }
 
 void NativeMetaDb::close() noexcept {
-  // shut db and copy data to backup folder
-  // and kick off async upload process
-  // reopen the DB
+  // commit all queued writes and backup changes before closing
+  stop();
+  if (dirty_ && !remote_.empty()) {
+    upload();
+  }
+
+  std::unique_lock<std::shared_mutex> lock(dbLock_);
   if (db_) {
     delete db_;
     db_ = nullptr;
   }
-
-  if (!backup_.empty()) {
-    // indicate we can upload backup_ now
-    dirty_ = fs_->sync(local_, backup_);
-    LOG(INFO) << "Prepare local=" << local_ << " to backup=" << backup_ << ", ready=" << dirty_;
-  }
 }
 
 } // namespace base
 } // namespace service
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
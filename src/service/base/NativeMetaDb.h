@@ -16,14 +16,27 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <leveldb/cache.h>
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 
 #include "common/Evidence.h"
+#include "common/Hash.h"
 #include "meta/MetaDb.h"
 #include "storage/NFS.h"
 
+/**
+ * Meta DB on a local leveldb, backed up to a remote store.
+ * Writes are queued and committed by a background thread in batches, a write returns once it's queued
+ * and it is visible to reads right away. A backup closes the DB shortly to stage a consistent copy,
+ * table files of leveldb never change once written, so a table file already in remote store is referenced by
+ * the manifest of a new snapshot rather than uploaded again. A backup uploads files changed since last one only.
+ */
 namespace nebula {
 namespace service {
 namespace base {
@@ -39,18 +52,15 @@ public:
 public:
   // read a given key, if not found, return false
   // otherwise the object will be filled with the bytes.
-  virtual inline bool read(const std::string& key, std::string& value) const override {
-    auto status = db_->Get(ropts_, key, &value);
-    return status.ok();
-  }
+  virtual bool read(const std::string& key, std::string& value) const override;
 
-  // write a k-v into the db
+  // queue a k-v to be written into the db by next commit
   virtual bool write(const std::string& key, const std::string& value) override;
 
-  // backup db data into remote location - called by async scheduler
+  // backup db data into remote location if changed and backup interval passed - called by async scheduler
   virtual bool backup() noexcept override;
 
-  // close DB and move its data to backup folder
+  // commit all queued writes, close DB and backup its changes if any
   virtual void close() noexcept override;
 
   inline const std::string& local() const {
@@ -71,14 +81,48 @@ private:
   // reset backup
   void resetBackup();
 
+  // commit queued writes batch by batch until stopped
+  void commit();
+
+  // write current batch into db, lock is held on writes queue
+  void flush(std::unique_lock<std::mutex>&);
+
+  // stop committing and write all queued
+  void stop();
+
+  // stage changed files and upload them as a new snapshot
+  bool upload() noexcept;
+
+  // name of file manifest in every snapshot, one line per file: "name snapshot"
+  static constexpr auto MANIFEST = "files";
+
+  // commit a batch without waiting for its window when it reaches this number of writes
+  static constexpr size_t BATCH_MAX = 1024;
+
 private:
   std::string local_;
   std::string remote_;
   // local file system
   std::unique_ptr<nebula::storage::NFileSystem> fs_;
-  bool dirty_;
+  // committed since last backup
+  std::atomic<bool> dirty_;
   std::string backup_;
 
+  // table files in remote store by name, and the snapshot holding each
+  nebula::common::unordered_map<std::string, std::string> remoteFiles_;
+
+  // queued writes as a batch, and by key for reads before they are committed
+  mutable std::mutex writes_;
+  std::condition_variable queued_;
+  leveldb::WriteBatch batch_;
+  nebula::common::unordered_map<std::string, std::string> pending_;
+  nebula::common::unordered_map<std::string, std::string> committing_;
+  bool stopped_;
+  std::thread committer_;
+
+  // DB is closed exclusively for a backup
+  mutable std::shared_mutex dbLock_;
+
   // leveldb related options
   leveldb::Options options_;
   leveldb::DB* db_;
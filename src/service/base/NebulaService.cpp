@@ -17,10 +17,14 @@
 #include "NebulaService.h"
 
 #include <curl/curl.h>
+#include <gflags/gflags.h>
+#include <lz4.h>
 #include <msgpack.hpp>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
+#include <zstd.h>
 
+#include "ColumnarBatch.h"
 #include "NativeMetaDb.h"
 #include "api/dsl/Serde.h"
 #include "common/Evidence.h"
@@ -34,6 +38,10 @@
 #include "storage/NFS.h"
 #include "type/Serde.h"
 
+DEFINE_string(RESULT_CODEC, "lz4", "codec nodes may compress query results with to send to server: none, lz4 or zstd");
+DEFINE_uint64(RESULT_COMPRESS_BYTES, 65536, "query results smaller than this are sent to server uncompressed");
+DEFINE_bool(RESULT_COLUMNAR, false, "ask nodes to send query results in columnar batch rather than flat");
+
 /**
  * provide common data operations for service
  */
@@ -42,6 +50,7 @@ namespace service {
 namespace base {
 
 using nebula::api::dsl::Expression;
+using nebula::api::dsl::ExpressionData;
 using nebula::api::dsl::Query;
 using nebula::api::dsl::Serde;
 using nebula::api::dsl::SortType;
@@ -52,10 +61,13 @@ using nebula::common::TaskState;
 using nebula::common::TaskType;
 using nebula::common::unordered_map;
 using nebula::common::unordered_set;
+using nebula::execution::ExecutionPlan;
 using nebula::execution::PlanPtr;
 using nebula::execution::QueryContext;
 using nebula::execution::QueryStats;
 using nebula::execution::QueryWindow;
+using nebula::execution::SpecSkips;
+using nebula::execution::TopRound;
 using nebula::ingest::BlockExpire;
 using nebula::ingest::IngestSpec;
 using nebula::memory::keyed::FlatBuffer;
@@ -68,6 +80,8 @@ using nebula::meta::DataSpec;
 using nebula::meta::DBType;
 using nebula::meta::MetaConf;
 using nebula::meta::MetaDb;
+using nebula::meta::NNode;
+using nebula::meta::NRole;
 using nebula::meta::SpecState;
 using nebula::meta::TableSpec;
 using nebula::meta::TimeSpec;
@@ -75,6 +89,10 @@ using nebula::meta::TimeType;
 using nebula::surface::EmptyRowCursor;
 using nebula::surface::RowCursorPtr;
 using nebula::surface::RowData;
+using nebula::surface::eval::ArthmeticOp;
+using nebula::surface::eval::ExpressionType;
+using nebula::surface::eval::LogicalOp;
+using nebula::surface::eval::UDFType;
 using nebula::type::Kind;
 using nebula::type::Schema;
 
@@ -95,6 +113,9 @@ const std::string ServiceProperties::errorMessage(ErrorCode error) {
     ERROR_MESSSAGE_CASE(AUTH_REQUIRED)
     ERROR_MESSSAGE_CASE(PERMISSION_REQUIRED)
     ERROR_MESSSAGE_CASE(TABLE_NOT_FOUND)
+    ERROR_MESSSAGE_CASE(MEMORY_LIMIT)
+    ERROR_MESSSAGE_CASE(NODE_FAILURE)
+    ERROR_MESSSAGE_CASE(CURSOR_EXPIRED)
   default: throw NException("Error Code Not Covered");
   }
 }
@@ -187,13 +208,139 @@ const std::string ServiceProperties::jsonify(const RowCursorPtr data, const Sche
   return buffer.GetString();
 }
 
+// append an expression tree to nodes in post order, return index of its root
+static uint32_t flatten(flatbuffers::FlatBufferBuilder& fb,
+                        const ExpressionData& data,
+                        std::vector<flatbuffers::Offset<ExprNode>>& nodes) {
+  int32_t left = -1;
+  int32_t right = -1;
+  int32_t op = 0;
+  auto flag = false;
+  auto flag2 = false;
+  switch (data.type) {
+  case ExpressionType::LOGICAL:
+  case ExpressionType::ARTHMETIC: {
+    op = data.type == ExpressionType::LOGICAL ? static_cast<int32_t>(data.b_lop) : static_cast<int32_t>(data.b_aop);
+    left = flatten(fb, *data.b_left, nodes);
+    right = flatten(fb, *data.b_right, nodes);
+    break;
+  }
+  case ExpressionType::FUNCTION: {
+    op = static_cast<int32_t>(data.u_type);
+    left = flatten(fb, *data.inner, nodes);
+    flag = data.flag;
+    flag2 = data.flag2;
+    break;
+  }
+  default: break;
+  }
+
+  // absent strings and vectors take no space
+  auto str = [&fb](const std::string& s) {
+    return s.empty() ? 0 : fb.CreateString(s);
+  };
+
+  const auto alias = str(data.alias);
+  const auto cType = str(data.c_type);
+  const auto cValue = str(data.c_value);
+  const auto cName = str(data.c_name);
+  const auto custom = data.custom.empty() ?
+                        0 :
+                        fb.CreateVector(reinterpret_cast<const uint8_t*>(data.custom.data()), data.custom.size());
+  const auto longs = data.i_longs.empty() ? 0 : fb.CreateVector(data.i_longs);
+  const auto doubles = data.i_doubles.empty() ? 0 : fb.CreateVector(data.i_doubles);
+  const auto strings = data.i_strings.empty() ? 0 : fb.CreateVectorOfStrings(data.i_strings);
+  nodes.push_back(CreateExprNode(fb, static_cast<int8_t>(data.type), alias, cType, cValue, cName, op, left, right,
+                                 custom, flag, flag2, longs, doubles, strings));
+  return nodes.size() - 1;
+}
+
+// expression data tree rooted at given node, children always come before their parent
+static std::unique_ptr<ExpressionData> unflatten(const flatbuffers::Vector<flatbuffers::Offset<ExprNode>>& nodes,
+                                                 uint32_t index) {
+  N_ENSURE_LT(index, nodes.size(), "expression node out of range");
+  auto child = [&nodes, index](int32_t c) {
+    N_ENSURE(c >= 0 && (uint32_t)c < index, "expression child should precede its parent");
+    return unflatten(nodes, c);
+  };
+
+  const auto node = nodes.Get(index);
+  auto data = std::make_unique<ExpressionData>();
+  data->type = static_cast<ExpressionType>(node->type());
+  data->alias = flatbuffers::GetString(node->alias());
+  data->c_type = flatbuffers::GetString(node->c_type());
+  data->c_value = flatbuffers::GetString(node->c_value());
+  data->c_name = flatbuffers::GetString(node->c_name());
+  switch (data->type) {
+  case ExpressionType::LOGICAL: {
+    data->b_lop = static_cast<LogicalOp>(node->op());
+    data->b_left = child(node->left());
+    data->b_right = child(node->right());
+    break;
+  }
+  case ExpressionType::ARTHMETIC: {
+    data->b_aop = static_cast<ArthmeticOp>(node->op());
+    data->b_left = child(node->left());
+    data->b_right = child(node->right());
+    break;
+  }
+  case ExpressionType::FUNCTION: {
+    data->u_type = static_cast<UDFType>(node->op());
+    data->inner = child(node->left());
+    data->flag = node->flag();
+    data->flag2 = node->flag2();
+    if (node->custom()) {
+      data->custom.assign(reinterpret_cast<const char*>(node->custom()->data()), node->custom()->size());
+    }
+
+    if (node->longs()) {
+      data->i_longs.assign(node->longs()->begin(), node->longs()->end());
+    }
+
+    if (node->doubles()) {
+      data->i_doubles.assign(node->doubles()->begin(), node->doubles()->end());
+    }
+
+    if (node->strings()) {
+      data->i_strings.reserve(node->strings()->size());
+      for (auto s : *node->strings()) {
+        data->i_strings.push_back(s->str());
+      }
+    }
+    break;
+  }
+  default: break;
+  }
+
+  return data;
+}
+
 // serialize a query and meta data
-flatbuffers::grpc::Message<QueryPlan> QuerySerde::serialize(const Query& q, const std::string& id, const QueryWindow& window) {
+flatbuffers::grpc::Message<QueryPlan> QuerySerde::serialize(
+  const Query& q,
+  const std::string& id,
+  const QueryWindow& window,
+  size_t deadline,
+  const std::string& user,
+  const TopRound& round,
+  const std::vector<NNode>& peers,
+  const SpecSkips& skips) {
   flatbuffers::grpc::MessageBuilder mb;
-  std::vector<flatbuffers::Offset<flatbuffers::String>> fields;
-  fields.reserve(q.selects_.size());
-  for (auto& f : q.selects_) {
-    fields.push_back(mb.CreateString(Serde::serialize(*f)));
+
+  // filter and fields are flattened into expression trees
+  std::vector<uint8_t> exprs;
+  {
+    flatbuffers::FlatBufferBuilder fb;
+    std::vector<flatbuffers::Offset<ExprNode>> nodes;
+    std::vector<uint32_t> roots;
+    roots.reserve(q.selects_.size() + 1);
+    roots.push_back(flatten(fb, *q.filter_->serialize(), nodes));
+    for (auto& f : q.selects_) {
+      roots.push_back(flatten(fb, *f->serialize(), nodes));
+    }
+
+    fb.Finish(CreateExprTreesDirect(fb, &nodes, &roots));
+    exprs.assign(fb.GetBufferPointer(), fb.GetBufferPointer() + fb.GetSize());
   }
 
   std::vector<uint32_t> groups;
@@ -208,13 +355,39 @@ flatbuffers::grpc::Message<QueryPlan> QuerySerde::serialize(const Query& q, cons
     sorts.push_back(i);
   }
 
+  std::vector<uint8_t> descs;
+  descs.reserve(q.sorts_.size());
+  for (size_t i = 0, size = q.sorts_.size(); i < size; ++i) {
+    descs.push_back(q.sortType(i) == SortType::DESC);
+  }
+
   auto tbl = q.table_->name();
-  auto filter = Serde::serialize(*q.filter_);
   // customs serialization
   auto customs = Serde::serialize(q.customs_);
+  std::vector<uint64_t> keys(round.keys.begin(), round.keys.end());
+  std::vector<flatbuffers::Offset<flatbuffers::String>> nodes;
+  nodes.reserve(peers.size());
+  for (const auto& peer : peers) {
+    nodes.push_back(mb.CreateString(peer.toString()));
+  }
+
+  std::vector<flatbuffers::Offset<NodeSkips>> nodeSkips;
+  nodeSkips.reserve(skips.size());
+  for (const auto& item : skips) {
+    std::vector<flatbuffers::Offset<flatbuffers::String>> specs;
+    specs.reserve(item.second.size());
+    for (const auto& spec : item.second) {
+      specs.push_back(mb.CreateString(spec));
+    }
+
+    nodeSkips.push_back(CreateNodeSkipsDirect(mb, item.first.c_str(), &specs));
+  }
+
   auto request_offset = CreateQueryPlanDirect(
-    mb, id.c_str(), tbl.c_str(), filter.c_str(), customs.c_str(), &fields, &groups, &sorts,
-    q.sortType_ == SortType::DESC, q.limit_, window.first, window.second);
+    mb, id.c_str(), tbl.c_str(), nullptr, customs.c_str(), nullptr, &groups, &sorts,
+    q.sortType_ == SortType::DESC, q.limit_, window.first, window.second, &descs, q.sample_, deadline, user.c_str(),
+    BatchSerde::codec(FLAGS_RESULT_CODEC), FLAGS_RESULT_COLUMNAR, static_cast<int8_t>(round.step), round.threshold,
+    keys.empty() ? nullptr : &keys, nodes.empty() ? nullptr : &nodes, nodeSkips.empty() ? nullptr : &nodeSkips, &exprs);
   mb.Finish(request_offset);
   return mb.ReleaseMessage<QueryPlan>();
 }
@@ -229,19 +402,23 @@ nebula::api::dsl::Query QuerySerde::deserialize(
   const auto table = flatbuffers::GetString(plan->tbl());
   Query q(table, ms);
 
-  // set filter
-  {
-    q.filter_ = Serde::deserialize(plan->filter()->c_str());
-  }
+  // set filter and fields, walked in expression trees, or parsed from text sent by a server before them
+  if (plan->exprs()) {
+    auto trees = plan->exprs_nested_root();
+    const auto& nodes = *trees->nodes();
+    const auto& roots = *trees->roots();
+    N_ENSURE_GT(roots.size(), 0, "filter is the first expression tree");
+    q.filter_ = Serde::deserialize(*unflatten(nodes, roots.Get(0)));
 
-  // set customs
-  {
-    auto cc = plan->customs();
-    q.customs_ = Serde::deserialize(cc->data(), cc->size());
-  }
+    std::vector<std::shared_ptr<Expression>> fields;
+    fields.reserve(roots.size() - 1);
+    for (uint32_t i = 1, size = roots.size(); i < size; ++i) {
+      fields.push_back(Serde::deserialize(*unflatten(nodes, roots.Get(i))));
+    }
+    q.selects_ = std::move(fields);
+  } else {
+    q.filter_ = Serde::deserialize(plan->filter()->c_str());
 
-  // set fields
-  {
     auto fs = plan->fields();
     auto size = fs->size();
     std::vector<std::shared_ptr<Expression>> fields;
@@ -252,6 +429,12 @@ nebula::api::dsl::Query QuerySerde::deserialize(
     q.selects_ = std::move(fields);
   }
 
+  // set customs
+  {
+    auto cc = plan->customs();
+    q.customs_ = Serde::deserialize(cc->data(), cc->size());
+  }
+
   // set groups
   {
     auto gs = plan->groups();
@@ -279,16 +462,81 @@ nebula::api::dsl::Query QuerySerde::deserialize(
   // sort type
   q.sortType_ = plan->desc() ? SortType::DESC : SortType::ASC;
 
+  // sort type of every column
+  {
+    auto ds = plan->descs();
+    q.sortTypes_.clear();
+    if (ds && ds->size() == q.sorts_.size()) {
+      for (uint32_t i = 0, size = ds->size(); i < size; ++i) {
+        q.sortTypes_.push_back(ds->Get(i) ? SortType::DESC : SortType::ASC);
+      }
+    }
+  }
+
   // set limit
   q.limit_ = plan->limit();
 
+  // set sample fraction, it's 1 if not present
+  q.sample_ = plan->sample();
+
   // return this deserialized query
   return q;
 }
 
-PlanPtr QuerySerde::from(Query& q, size_t start, size_t end) {
+TopRound QuerySerde::topRound(const QueryPlan& plan) {
+  TopRound round{ static_cast<TopRound::Step>(plan.top_step()), plan.top_threshold(), {} };
+  auto keys = plan.top_keys();
+  if (keys) {
+    for (uint32_t i = 0, size = keys->size(); i < size; ++i) {
+      round.keys.insert(keys->Get(i));
+    }
+  }
+
+  return round;
+}
+
+std::vector<NNode> QuerySerde::peers(const QueryPlan& plan) {
+  std::vector<NNode> nodes;
+  auto peers = plan.peers();
+  if (peers) {
+    nodes.reserve(peers->size());
+    for (uint32_t i = 0, size = peers->size(); i < size; ++i) {
+      const auto address = flatbuffers::GetString(peers->Get(i));
+      const auto colon = address.rfind(':');
+      N_ENSURE(colon != std::string::npos, "peer address is host:port");
+      nodes.emplace_back(NRole::NODE, address.substr(0, colon), std::stoul(address.substr(colon + 1)));
+    }
+  }
+
+  return nodes;
+}
+
+SpecSkips QuerySerde::skips(const QueryPlan& plan) {
+  SpecSkips skips;
+  auto nodes = plan.skips();
+  if (nodes) {
+    for (uint32_t i = 0, size = nodes->size(); i < size; ++i) {
+      const auto node = nodes->Get(i);
+      auto& specs = skips[flatbuffers::GetString(node->node())];
+      if (node->specs()) {
+        for (uint32_t j = 0, count = node->specs()->size(); j < count; ++j) {
+          specs.emplace(flatbuffers::GetString(node->specs()->Get(j)));
+        }
+      }
+    }
+  }
+
+  return skips;
+}
+
+// nodes don't authorize queries, the user is only used to admit queries fairly
+static std::unique_ptr<QueryContext> nodeContext(const std::string& user) {
+  return user.empty() ? QueryContext::def() : QueryContext::def(user);
+}
+
+PlanPtr QuerySerde::from(Query& q, size_t start, size_t end, const std::string& user) {
   // TODO(cao): serialize query context to nodes and mark compile method as const
-  auto plan = q.compile(QueryContext::def());
+  auto plan = q.compile(nodeContext(user));
 
   // set a few other properties associated with execution plan
   plan->setWindow({ start, end });
@@ -297,32 +545,147 @@ PlanPtr QuerySerde::from(Query& q, size_t start, size_t end) {
   return plan;
 }
 
-flatbuffers::grpc::Message<BatchRows> BatchSerde::serialize(const FlatBuffer& fb, const PlanPtr plan) {
+PlanPtr QuerySerde::from(const ExecutionPlan& compiled, size_t start, size_t end, const std::string& user) {
+  auto plan = compiled.fork(nodeContext(user));
+  plan->setWindow({ start, end });
+  return plan;
+}
+
+// stats of the query in the node, absent if not asked
+// serde time and bytes are of the result being serialized, in addition to what the node has received from its peers
+static flatbuffers::Offset<Stats> nodeStats(flatbuffers::FlatBufferBuilder& fbb,
+                                            const PlanPtr& plan,
+                                            bool withStats,
+                                            size_t serdeUs,
+                                            size_t serdeBytes) {
+  if (!withStats) {
+    return 0;
+  }
+
+  const auto& stats = plan->ctx().stats();
+  const auto& profile = stats.profile;
+  return CreateStats(fbb,
+                     stats.blocksScan,
+                     stats.rowsScan,
+                     stats.rowsRet,
+                     stats.blocksTotal,
+                     stats.rowsTotal,
+                     stats.nodesFailed,
+                     stats.nodesTimeout,
+                     profile.blocksPrunedMeta,
+                     profile.blocksPrunedPartition,
+                     profile.filterUs,
+                     profile.aggregateUs,
+                     profile.nodeMergeUs,
+                     profile.serdeBytes + serdeBytes,
+                     profile.serdeUs + serdeUs);
+}
+
+flatbuffers::grpc::Message<BatchRows> BatchSerde::serialize(const FlatBuffer& fb,
+                                                         const PlanPtr plan,
+                                                         bool withStats,
+                                                         Codec codec) {
+  nebula::common::Evidence::Duration tick;
   flatbuffers::grpc::MessageBuilder mb;
   auto schema = mb.CreateString(nebula::type::TypeSerializer::to(fb.schema()));
   int8_t* buffer;
   auto size = fb.prepareSerde();
-  auto bytes = mb.CreateUninitializedVector<int8_t>(size, &buffer);
-  fb.serialize(buffer);
-
-  auto& stats = plan->ctx().stats();
-  auto batch = CreateBatchRows(
-    mb,
-    schema,
-    BatchType::BatchType_Flat,
-    CreateStats(mb, stats.blocksScan, stats.rowsScan, stats.rowsRet),
-    bytes);
+  flatbuffers::Offset<flatbuffers::Vector<int8_t>> bytes;
+
+  // a large payload is compressed if the codec is accepted by server and it does shrink the payload,
+  // otherwise it's serialized into the message in place
+  if (codec != Codec::Codec_None && size >= FLAGS_RESULT_COMPRESS_BYTES) {
+    std::vector<char> raw(size);
+    fb.serialize(reinterpret_cast<NByte*>(raw.data()));
+    std::vector<char> compressed;
+    if (compress(codec, raw, compressed) && compressed.size() < size) {
+      bytes = mb.CreateVector(reinterpret_cast<const int8_t*>(compressed.data()), compressed.size());
+    } else {
+      codec = Codec::Codec_None;
+      bytes = mb.CreateVector(reinterpret_cast<const int8_t*>(raw.data()), size);
+    }
+  } else {
+    codec = Codec::Codec_None;
+    bytes = mb.CreateUninitializedVector<int8_t>(size, &buffer);
+    fb.serialize(buffer);
+  }
+
+  const auto stats = nodeStats(mb, plan, withStats, tick.elapsedUs(), mb.GetSize());
+  auto batch = CreateBatchRows(mb, schema, BatchType::BatchType_Flat, stats, bytes, codec, size);
   mb.Finish(batch);
   return mb.ReleaseMessage<BatchRows>();
 }
 
+flatbuffers::grpc::Message<BatchRows> BatchSerde::columnar(FlatBuffer& fb,
+                                                        const PlanPtr plan,
+                                                        bool withStats,
+                                                        Codec codec) {
+  if (!ColumnarBatch::supports(fb.schema())) {
+    return serialize(fb, plan, withStats, codec);
+  }
+
+  nebula::common::Evidence::Duration tick;
+  flatbuffers::grpc::MessageBuilder mb;
+  auto schema = mb.CreateString(nebula::type::TypeSerializer::to(fb.schema()));
+  auto columns = ColumnarBatch::write(mb, fb, fb.fields());
+
+  // stats table is built before the batch table, flatbuffers doesn't build tables nested
+  const auto stats = nodeStats(mb, plan, withStats, tick.elapsedUs(), mb.GetSize());
+  BatchRowsBuilder builder(mb);
+  builder.add_schema(schema);
+  builder.add_type(BatchType::BatchType_Columnar);
+  builder.add_stats(stats);
+  builder.add_rows(fb.getRows());
+  builder.add_columns(columns);
+  mb.Finish(builder.Finish());
+  return mb.ReleaseMessage<BatchRows>();
+}
+
 RowCursorPtr BatchSerde::deserialize(const flatbuffers::grpc::Message<BatchRows>* batch,
                                      const nebula::surface::eval::Fields& fields,
                                      QueryStats& stats) {
+  nebula::common::Evidence::Duration tick;
   auto ptr = batch->GetRoot();
 
   const auto schema = nebula::type::TypeSerializer::from(flatbuffers::GetString(ptr->schema()));
-  N_ENSURE(ptr->type() == BatchType::BatchType_Flat, "only support flat for now");
+
+  // get stats of this compute node - threadsafe?
+  // a chunk of streamed result carries no stats unless it's the first one
+  auto nodeStats = ptr->stats();
+  auto addStats = [&stats, &tick, nodeStats]() {
+    if (nodeStats) {
+      stats.blocksScan += nodeStats->blocks_scan();
+      stats.rowsScan += nodeStats->rows_scan();
+      stats.blocksTotal += nodeStats->blocks_total();
+      stats.rowsTotal += nodeStats->rows_total();
+      stats.nodesFailed += nodeStats->nodes_failed();
+      stats.nodesTimeout += nodeStats->nodes_timeout();
+
+      auto& profile = stats.profile;
+      profile.blocksPrunedMeta += nodeStats->blocks_pruned_meta();
+      profile.blocksPrunedPartition += nodeStats->blocks_pruned_partition();
+      profile.filterUs += nodeStats->filter_us();
+      profile.aggregateUs += nodeStats->aggregate_us();
+      profile.nodeMergeUs += nodeStats->merge_us();
+      profile.serdeBytes += nodeStats->serde_bytes();
+      profile.serdeUs += nodeStats->serde_us();
+    }
+
+    // time to read the result on this side
+    stats.profile.serdeUs += tick.elapsedUs();
+  };
+
+  // columnar batch is read by its columns directly
+  if (ptr->type() == BatchType::BatchType_Columnar) {
+    addStats();
+    if (ptr->rows() == 0) {
+      return EmptyRowCursor::instance();
+    }
+
+    return std::make_shared<ColumnarRowCursor>(schema, fields, *ptr);
+  }
+
+  N_ENSURE(ptr->type() == BatchType::BatchType_Flat, "only support flat or columnar for now");
 
   // TODO(cao) - can we avoid this allocation?
   auto data = ptr->data();
@@ -333,19 +696,84 @@ RowCursorPtr BatchSerde::deserialize(const flatbuffers::grpc::Message<BatchRows>
     return EmptyRowCursor::instance();
   }
 
-  auto bytes = static_cast<NByte*>(Pool::getDefault().allocate(size));
-  std::memcpy(bytes, data->data(), size);
+  NByte* bytes = nullptr;
+  const auto codec = ptr->codec();
+  if (codec == Codec::Codec_None) {
+    bytes = static_cast<NByte*>(Pool::getDefault().allocate(size));
+    std::memcpy(bytes, data->data(), size);
+  } else {
+    const auto raw = ptr->raw_size();
+    bytes = static_cast<NByte*>(Pool::getDefault().allocate(raw));
+    if (!decompress(codec, reinterpret_cast<const char*>(data->data()), size, reinterpret_cast<char*>(bytes), raw)) {
+      Pool::getDefault().free(bytes, raw);
+      throw NException(fmt::format("Failed to decompress query result of codec {0}", EnumNameCodec(codec)));
+    }
+  }
 
-  // get stats of this compute node - threadsafe?
-  auto nodeStats = ptr->stats();
-  stats.blocksScan += nodeStats->blocks_scan();
-  stats.rowsScan += nodeStats->rows_scan();
+  addStats();
 
   // TODO(cao) - It is not good, we're reference some data from batch but actually not owning it.
   auto fb = std::make_unique<FlatBuffer>(schema, fields, bytes);
   return std::make_shared<FlatRowCursor>(std::move(fb));
 }
 
+Codec BatchSerde::codec(const std::string& name) noexcept {
+  if (name == "lz4") {
+    return Codec::Codec_Lz4;
+  }
+
+  if (name == "zstd") {
+    return Codec::Codec_Zstd;
+  }
+
+  return Codec::Codec_None;
+}
+
+bool BatchSerde::compress(Codec codec, const std::vector<char>& raw, std::vector<char>& out) noexcept {
+  const auto size = raw.size();
+  if (codec == Codec::Codec_Lz4) {
+    // lz4 works on int sized buffer only
+    if (size > LZ4_MAX_INPUT_SIZE) {
+      return false;
+    }
+
+    out.resize(LZ4_compressBound(size));
+    auto bytes = LZ4_compress_default(raw.data(), out.data(), size, out.size());
+    if (bytes <= 0) {
+      return false;
+    }
+
+    out.resize(bytes);
+    return true;
+  }
+
+  if (codec == Codec::Codec_Zstd) {
+    // fast level, the result is on the query path
+    out.resize(ZSTD_compressBound(size));
+    auto bytes = ZSTD_compress(out.data(), out.size(), raw.data(), size, 1);
+    if (ZSTD_isError(bytes)) {
+      return false;
+    }
+
+    out.resize(bytes);
+    return true;
+  }
+
+  return false;
+}
+
+bool BatchSerde::decompress(Codec codec, const char* data, size_t size, char* raw, size_t rawSize) noexcept {
+  if (codec == Codec::Codec_Lz4) {
+    return LZ4_decompress_safe(data, raw, size, rawSize) == (int)rawSize;
+  }
+
+  if (codec == Codec::Codec_Zstd) {
+    return ZSTD_decompress(raw, rawSize, data, size) == rawSize;
+  }
+
+  return false;
+}
+
 // serialize a ingest spec into a task spec to be sent over
 flatbuffers::grpc::Message<TaskSpec> TaskSerde::serialize(const Task& task) {
   flatbuffers::grpc::MessageBuilder mb;
@@ -63,7 +63,10 @@ enum ErrorCode {
   FAIL_EXECUTE_QUERY = 6,
   AUTH_REQUIRED = 7,
   PERMISSION_REQUIRED = 8,
-  TABLE_NOT_FOUND = 9
+  TABLE_NOT_FOUND = 9,
+  MEMORY_LIMIT = 10,
+  NODE_FAILURE = 11,
+  CURSOR_EXPIRED = 12
 };
 
 template <ErrorCode E>
@@ -119,6 +122,21 @@ struct ErrorTraits<ErrorCode::TABLE_NOT_FOUND> {
   static constexpr auto MESSAGE = "Table in query not found";
 };
 
+template <>
+struct ErrorTraits<ErrorCode::MEMORY_LIMIT> {
+  static constexpr auto MESSAGE = "Query Exceeds Memory Limit";
+};
+
+template <>
+struct ErrorTraits<ErrorCode::NODE_FAILURE> {
+  static constexpr auto MESSAGE = "Some Nodes Failed To Return Results";
+};
+
+template <>
+struct ErrorTraits<ErrorCode::CURSOR_EXPIRED> {
+  static constexpr auto MESSAGE = "Result Cursor Expired, Please Query Again";
+};
+
 class ServiceProperties final {
 public:
   // nebula server listening port
@@ -147,10 +165,24 @@ class QuerySerde {
 public:
   static flatbuffers::grpc::Message<QueryPlan> serialize(const nebula::api::dsl::Query&,
                                                          const std::string&,
-                                                         const nebula::execution::QueryWindow&);
+                                                         const nebula::execution::QueryWindow&,
+                                                         size_t = 0,
+                                                         const std::string& = "",
+                                                         const nebula::execution::TopRound& = {},
+                                                         const std::vector<nebula::meta::NNode>& = {},
+                                                         const nebula::execution::SpecSkips& = {});
   static nebula::api::dsl::Query deserialize(const std::shared_ptr<nebula::meta::MetaService>,
                                              const flatbuffers::grpc::Message<QueryPlan>*);
-  static nebula::execution::PlanPtr from(nebula::api::dsl::Query&, size_t, size_t);
+  // round of exact distributed top N asked by the query plan
+  static nebula::execution::TopRound topRound(const QueryPlan&);
+  // peer nodes which the query plan is forwarded to
+  static std::vector<nebula::meta::NNode> peers(const QueryPlan&);
+  // specs skipped by the node receiving the query plan and its peers
+  static nebula::execution::SpecSkips skips(const QueryPlan&);
+  static nebula::execution::PlanPtr from(nebula::api::dsl::Query&, size_t, size_t, const std::string& = "");
+  // bind window and user of an execution to a plan compiled before
+  static nebula::execution::PlanPtr from(
+    const nebula::execution::ExecutionPlan&, size_t, size_t, const std::string& = "");
 };
 
 /**
@@ -158,11 +190,27 @@ public:
  */
 class BatchSerde {
 public:
+  // query stats are left out if not asked, such as all chunks but the first of a streamed result
+  // payload is compressed by the codec if it's large enough and compressible
   static flatbuffers::grpc::Message<BatchRows> serialize(const nebula::memory::keyed::FlatBuffer&,
-                                                         const nebula::execution::PlanPtr);
+                                                         const nebula::execution::PlanPtr,
+                                                         bool = true,
+                                                         Codec = Codec::Codec_None);
+  // serialize in columnar batch if all columns are supported, otherwise the same as serialize in flat
+  static flatbuffers::grpc::Message<BatchRows> columnar(nebula::memory::keyed::FlatBuffer&,
+                                                        const nebula::execution::PlanPtr,
+                                                        bool = true,
+                                                        Codec = Codec::Codec_None);
   static nebula::surface::RowCursorPtr deserialize(const flatbuffers::grpc::Message<BatchRows>*,
                                                    const nebula::surface::eval::Fields&,
                                                    nebula::execution::QueryStats&);
+
+  // codec of given name: none, lz4 or zstd
+  static Codec codec(const std::string&) noexcept;
+
+private:
+  static bool compress(Codec, const std::vector<char>&, std::vector<char>&) noexcept;
+  static bool decompress(Codec, const char*, size_t, char*, size_t) noexcept;
 };
 
 /**
@@ -18,12 +18,19 @@
 
 #include <glog/logging.h>
 #include <grpcpp/grpcpp.h>
+#include <mutex>
+#include <thread>
 
+#include "common/Errors.h"
+#include "common/Folly.h"
 #include "nebula.grpc.pb.h"
 
 /**
- * A cursor template that help iterating a container.
- * (should we use std::iterator instead?)
+ * Client of nebula server, blocking calls and async queries share one channel (connection).
+ * Async queries are multiplexed on the channel as concurrent streams, so a caller can have many queries
+ * in flight without a thread for each: their completions are polled by one thread of the client,
+ * which fulfills the future of every query. Cancelling a future cancels its call, the server sees it cancelled
+ * and stops the query.
  */
 namespace nebula {
 namespace service {
@@ -33,7 +40,16 @@ namespace client {
 class NebulaClient {
 public:
   NebulaClient(std::shared_ptr<grpc::Channel> channel)
-    : stub_(V1::NewStub(channel)) {}
+    : stub_(V1::NewStub(channel)), async_{ std::make_unique<Async>() } {}
+
+  // calls in flight are waited for
+  virtual ~NebulaClient() {
+    if (async_) {
+      async_->stop();
+    }
+  }
+
+  NebulaClient(NebulaClient&&) = default;
 
   // ping nebula server with my data for service discoverys
   std::unique_ptr<PingResponse> ping(const ServiceInfo& si) const noexcept {
@@ -49,12 +65,141 @@ public:
     }
   }
 
+  // state of a table in the cluster such as its rows and blocks loaded in nodes
+  std::unique_ptr<TableStateResponse> state(const std::string& table) const noexcept {
+    grpc::ClientContext context;
+    TableStateRequest request;
+    request.set_table(table);
+    auto re = std::make_unique<TableStateResponse>();
+    grpc::Status status = stub_->State(&context, request, re.get());
+    if (status.ok()) {
+      return re;
+    }
+
+    LOG(INFO) << "Failed to get table state: " << status.error_code() << ", " << status.error_message();
+    return {};
+  }
+
+  // run a query on nebula server, as given user if it's not empty, no deadline if timeout is 0
+  grpc::Status query(const QueryRequest& request,
+                     QueryResponse& response,
+                     const std::string& user = "",
+                     size_t timeoutMs = 0) const noexcept {
+    grpc::ClientContext context;
+    if (!user.empty()) {
+      // the same user info metadata as web server sends
+      context.AddMetadata("nebula-auth", "1");
+      context.AddMetadata("nebula-user", user);
+    }
+
+    if (timeoutMs > 0) {
+      context.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(timeoutMs));
+    }
+
+    return stub_->Query(&context, request, &response);
+  }
+
+  // run a query asynchronously, the same options as a blocking query.
+  // the future fails by folly::FutureTimeout if deadline is exceeded, folly::FutureCancellation if cancelled,
+  // otherwise by NException of the error message.
+  folly::Future<QueryResponse> queryAsync(const QueryRequest& request,
+                                          const std::string& user = "",
+                                          size_t timeoutMs = 0) const {
+    auto call = std::make_shared<Call>();
+    call->self = call;
+    if (!user.empty()) {
+      call->context.AddMetadata("nebula-auth", "1");
+      call->context.AddMetadata("nebula-user", user);
+    }
+
+    if (timeoutMs > 0) {
+      call->context.set_deadline(std::chrono::system_clock::now() + std::chrono::milliseconds(timeoutMs));
+    }
+
+    // a cancelled future cancels the call if it's still in flight
+    std::weak_ptr<Call> weak = call;
+    call->promise.setInterruptHandler([weak](const folly::exception_wrapper&) {
+      if (auto c = weak.lock()) {
+        c->context.TryCancel();
+      }
+    });
+
+    auto future = call->promise.getFuture();
+    auto queue = async_->start();
+    call->reader = stub_->PrepareAsyncQuery(&call->context, request, queue);
+    call->reader->StartCall();
+    call->reader->Finish(&call->response, &call->status, call.get());
+    return future;
+  }
+
   static NebulaClient make(const std::string& hostAndPort) {
     return NebulaClient(grpc::CreateChannel(hostAndPort, grpc::InsecureChannelCredentials()));
   }
 
+private:
+  // an async query in flight, it owns itself until its completion is polled
+  struct Call {
+    grpc::ClientContext context;
+    QueryResponse response;
+    grpc::Status status;
+    std::unique_ptr<grpc::ClientAsyncResponseReader<QueryResponse>> reader;
+    folly::Promise<QueryResponse> promise;
+    std::shared_ptr<Call> self;
+
+    void complete() {
+      if (status.ok()) {
+        promise.setValue(std::move(response));
+      } else if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+        promise.setException(folly::FutureTimeout());
+      } else if (status.error_code() == grpc::StatusCode::CANCELLED) {
+        promise.setException(folly::FutureCancellation());
+      } else {
+        promise.setException(NException(status.error_message()));
+      }
+
+      self.reset();
+    }
+  };
+
+  // completion queue of async queries and its polling thread, started by the first async query
+  class Async {
+  public:
+    grpc::CompletionQueue* start() {
+      std::call_once(started_, [this]() {
+        poller_ = std::thread([this]() {
+          void* tag = nullptr;
+          bool ok = false;
+          while (queue_.Next(&tag, &ok)) {
+            static_cast<Call*>(tag)->complete();
+          }
+        });
+      });
+
+      return &queue_;
+    }
+
+    void stop() {
+      queue_.Shutdown();
+      if (poller_.joinable()) {
+        poller_.join();
+      } else {
+        // drain the queue which is never polled
+        void* tag = nullptr;
+        bool ok = false;
+        while (queue_.Next(&tag, &ok)) {
+        }
+      }
+    }
+
+  private:
+    grpc::CompletionQueue queue_;
+    std::once_flag started_;
+    std::thread poller_;
+  };
+
 private:
   std::unique_ptr<V1::Stub> stub_;
+  std::unique_ptr<Async> async_;
 };
 
 } // namespace client
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fmt/format.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "Replay.h"
+#include "common/Folly.h"
+#include "service/base/NebulaService.h"
+
+/**
+ * Replay queries captured by NebulaServer (--QUERY_CAPTURE) against a server and report QPS, latency and errors.
+ * For example, replay a day of dashboard traffic in an hour with 32 senders:
+ *   NebulaReplay --CAPTURE=queries.jsonl --SERVER=host:9190 --SPEEDUP=24 --CONCURRENCY=32
+ */
+DEFINE_string(CAPTURE, "", "file of captured queries as JSON lines");
+DEFINE_string(SERVER, "", "nebula server address (host:port) to replay against, localhost by default");
+DEFINE_double(SPEEDUP, 1, "replay speed relative to the capture, 0 to send queries back to back");
+DEFINE_uint32(CONCURRENCY, 8, "number of queries in flight at most");
+DEFINE_bool(SHIFT_TIME, true, "move time range of every query by the time passed since it was captured");
+DEFINE_bool(AS_USERS, false, "send queries as their captured users");
+DEFINE_uint32(TIMEOUT_MS, 0, "deadline of every query in milliseconds, 0 for none");
+DEFINE_uint32(LOOPS, 1, "number of times to replay the workload");
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  FLAGS_logtostderr = 1;
+
+  const auto queries = nebula::service::client::Replay::load(FLAGS_CAPTURE);
+  if (queries.empty()) {
+    LOG(ERROR) << "No queries to replay from: " << FLAGS_CAPTURE;
+    return 1;
+  }
+
+  const auto server = FLAGS_SERVER.empty()
+                        ? fmt::format("localhost:{0}", nebula::service::base::ServiceProperties::PORT)
+                        : FLAGS_SERVER;
+  const auto client = nebula::service::client::NebulaClient::make(server);
+  nebula::service::client::Replay replay{ client };
+
+  nebula::service::client::ReplayOptions options;
+  options.speedup = FLAGS_SPEEDUP;
+  options.concurrency = FLAGS_CONCURRENCY;
+  options.shiftTime = FLAGS_SHIFT_TIME;
+  options.asUsers = FLAGS_AS_USERS;
+  options.timeoutMs = FLAGS_TIMEOUT_MS;
+
+  auto failed = false;
+  for (size_t i = 0; i < FLAGS_LOOPS; ++i) {
+    const auto report = replay.run(queries, options);
+    LOG(INFO) << "[Replay " << i << "] " << server << ": " << report.toString();
+    failed = failed || report.errors > 0;
+  }
+
+  return failed ? 2 : 0;
+}
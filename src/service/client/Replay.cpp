@@ -0,0 +1,180 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Replay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fmt/format.h>
+#include <fstream>
+#include <google/protobuf/util/json_util.h>
+#include <mutex>
+#include <thread>
+
+#include "common/Hash.h"
+
+/**
+ * Implement workload replay.
+ */
+namespace nebula {
+namespace service {
+namespace client {
+
+using Clock = std::chrono::steady_clock;
+
+std::string ReplayReport::toString() const {
+  return fmt::format(
+    "queries={0}, seconds={1:.1f}, qps={2:.2f}, errors={3} ({4:.2f}%), late={5}, "
+    "latency(ms): p50={6}, p90={7}, p99={8}, max={9}",
+    queries, seconds, qps(), errors, errorRate() * 100, late, p50, p90, p99, max);
+}
+
+std::vector<CapturedQuery> Replay::load(const std::string& file) {
+  std::vector<CapturedQuery> queries;
+  std::ifstream input(file);
+  if (!input.is_open()) {
+    LOG(ERROR) << "Failed to open captured queries: " << file;
+    return queries;
+  }
+
+  std::string line;
+  size_t skipped = 0;
+  while (std::getline(input, line)) {
+    if (line.empty()) {
+      continue;
+    }
+
+    CapturedQuery query;
+    if (!google::protobuf::util::JsonStringToMessage(line, &query).ok()) {
+      ++skipped;
+      continue;
+    }
+
+    queries.push_back(std::move(query));
+  }
+
+  // lines are appended in arrival order mostly, concurrent queries may be off by a little
+  std::stable_sort(queries.begin(), queries.end(), [](const CapturedQuery& left, const CapturedQuery& right) {
+    return left.timems() < right.timems();
+  });
+
+  LOG(INFO) << "Loaded " << queries.size() << " captured queries, skipped " << skipped << " lines";
+  return queries;
+}
+
+ReplayReport Replay::summarize(std::vector<size_t>& latencies, size_t errors, size_t late, double seconds) {
+  ReplayReport report;
+  report.queries = latencies.size();
+  report.errors = errors;
+  report.late = late;
+  report.seconds = seconds;
+  if (latencies.empty()) {
+    return report;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  const auto at = [&latencies](double q) {
+    return latencies.at(std::min(latencies.size() - 1, static_cast<size_t>(q * latencies.size())));
+  };
+
+  report.p50 = at(0.5);
+  report.p90 = at(0.9);
+  report.p99 = at(0.99);
+  report.max = latencies.back();
+  return report;
+}
+
+ReplayReport Replay::run(const std::vector<CapturedQuery>& queries, const ReplayOptions& options) const {
+  std::vector<size_t> latencies(queries.size(), 0);
+  if (queries.empty()) {
+    return summarize(latencies, 0, 0, 0);
+  }
+
+  const auto first = queries.front().timems();
+  const auto start = Clock::now();
+  std::atomic<size_t> next{ 0 };
+  std::atomic<size_t> errors{ 0 };
+  std::atomic<size_t> late{ 0 };
+
+  // errors by message, logged once each
+  std::mutex mutex;
+  nebula::common::unordered_map<std::string, size_t> messages;
+
+  auto send = [&]() {
+    for (auto i = next++; i < queries.size(); i = next++) {
+      const auto& captured = queries.at(i);
+
+      // wait for the time of the query in the replay
+      if (options.speedup > 0) {
+        const auto offset = std::chrono::milliseconds(
+          static_cast<int64_t>((captured.timems() - first) / options.speedup));
+        const auto due = start + offset;
+        if (Clock::now() > due + std::chrono::milliseconds(100)) {
+          ++late;
+        }
+        std::this_thread::sleep_until(due);
+      }
+
+      QueryRequest request{ captured.request() };
+      if (options.shiftTime) {
+        const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+        const auto shift = now - static_cast<int64_t>(captured.timems() / 1000);
+        if (shift > 0) {
+          request.set_start(request.start() + shift);
+          request.set_end(request.end() + shift);
+        }
+      }
+
+      QueryResponse response;
+      const auto sent = Clock::now();
+      const auto status = client_.query(
+        request, response, options.asUsers ? captured.user() : "", options.timeoutMs);
+      latencies[i] = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - sent).count();
+      if (!status.ok()) {
+        ++errors;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (messages[status.error_message()]++ == 0) {
+          LOG(WARNING) << "Replayed query failed: " << status.error_message() << ", table=" << request.table();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> senders;
+  const auto concurrency = std::max<size_t>(1, std::min(options.concurrency, queries.size()));
+  senders.reserve(concurrency);
+  for (size_t i = 0; i < concurrency; ++i) {
+    senders.emplace_back(send);
+  }
+
+  for (auto& s : senders) {
+    s.join();
+  }
+
+  for (const auto& m : messages) {
+    LOG(INFO) << "Errors: " << m.second << " x " << m.first;
+  }
+
+  const std::chrono::duration<double> seconds = Clock::now() - start;
+  return summarize(latencies, errors, late, seconds.count());
+}
+
+} // namespace client
+} // namespace service
+} // namespace nebula
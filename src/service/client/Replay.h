@@ -0,0 +1,92 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "NebulaClient.h"
+#include "nebula.pb.h"
+
+/**
+ * Replay a workload captured by server (--QUERY_CAPTURE) against a nebula server to load test it
+ * with the real mix of queries, such as sizing new hardware or validating a release.
+ * Queries are sent at their captured pace divided by a speed-up, by a number of concurrent senders.
+ * When all senders are busy, later queries are sent as soon as one is free, so the offered load
+ * is bounded by concurrency. The report has QPS, latency percentiles and error rate.
+ */
+namespace nebula {
+namespace service {
+namespace client {
+
+struct ReplayOptions {
+  // 2 replays the workload twice as fast as captured, 0 sends queries back to back
+  double speedup = 1;
+  size_t concurrency = 8;
+  // move time range of every query by the time passed since it was captured, so dashboards querying
+  // recent data query recent data again
+  bool shiftTime = true;
+  // send queries as their captured users, otherwise as unauthenticated
+  bool asUsers = false;
+  // deadline of every query, 0 for none
+  size_t timeoutMs = 0;
+};
+
+struct ReplayReport {
+  size_t queries = 0;
+  size_t errors = 0;
+  double seconds = 0;
+  // latency percentiles of queries in milliseconds
+  size_t p50 = 0;
+  size_t p90 = 0;
+  size_t p99 = 0;
+  size_t max = 0;
+  // queries sent later than scheduled because all senders were busy
+  size_t late = 0;
+
+  inline double qps() const noexcept {
+    return seconds > 0 ? queries / seconds : 0;
+  }
+
+  inline double errorRate() const noexcept {
+    return queries > 0 ? (double)errors / queries : 0;
+  }
+
+  std::string toString() const;
+};
+
+class Replay final {
+public:
+  explicit Replay(const NebulaClient& client) : client_{ client } {}
+  ~Replay() = default;
+
+public:
+  // load captured queries from a file of JSON lines in time order, malformed lines are skipped
+  static std::vector<CapturedQuery> load(const std::string& file);
+
+  // summary of latencies of all queries, the list is sorted in place
+  static ReplayReport summarize(std::vector<size_t>& latencies, size_t errors, size_t late, double seconds);
+
+  ReplayReport run(const std::vector<CapturedQuery>&, const ReplayOptions&) const;
+
+private:
+  const NebulaClient& client_;
+};
+
+} // namespace client
+} // namespace service
+} // namespace nebula
@@ -4994,7 +4994,8 @@ proto.nebula.service.Rollup = {
   P99_99: 12,
   TREEMERGE: 13,
   CARD_EST: 14,
-  HIST: 15
+  HIST: 15,
+  TOPK: 16
 };
 
 /**
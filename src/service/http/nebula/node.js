@@ -145,6 +145,28 @@ const getTables = (query, handler, client) => {
     });
 };
 
+// memory breakdown of a table by column and structure
+const memoryState = (m) => {
+    if (!m) {
+        return null;
+    }
+
+    return {
+        cl: m.getColumnsList().map(c => ({
+            c: c.getColumn(),
+            data: c.getData(),
+            nulls: c.getNulls(),
+            offsets: c.getOffsets(),
+            dict: c.getDict(),
+            bloom: c.getBloom(),
+            hist: c.getHistogram()
+        })),
+        bess: m.getBess(),
+        qb: m.getQuerybytes(),
+        pc: m.getPoolcached()
+    };
+};
+
 const getTableState = (q, handler, client) => {
     const req = new TableStateRequest();
     req.setTable(q.table);
@@ -164,7 +186,8 @@ const getTableState = (q, handler, client) => {
             xt: reply.getMaxtime(),
             dl: reply.getDimensionList(),
             ml: reply.getMetricList(),
-            ht: reply.getHistsList()
+            ht: reply.getHistsList(),
+            mem: memoryState(reply.getMemory())
         }));
     });
 }
@@ -287,6 +310,7 @@ const webq = (q, handler, client) => {
             rows_scan: stats.getRowsscanned(),
             blocks_scan: stats.getBlocksscanned(),
             rows_ret: stats.getRowsreturn(),
+            profile: stats.hasProfile() ? stats.getProfile().toObject() : null,
             data: data
         }));
     });
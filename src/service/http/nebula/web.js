@@ -140,6 +140,22 @@ const makeCalendar = (obj, id, btn, def, min, max) => {
     });
 };
 
+// memory breakdown of a table as lines, columns using the most memory go first
+const memoryText = (m) => {
+    if (!m) {
+        return '';
+    }
+
+    const mb = (bytes) => Math.round(bytes / 10000) / 100;
+    const parts = ['data', 'nulls', 'offsets', 'dict', 'bloom', 'hist'];
+    const total = (c) => parts.reduce((s, p) => s + c[p], 0);
+    const lines = (m.cl || []).slice()
+        .sort((a, b) => total(b) - total(a))
+        .map(c => `${c.c}: ${mb(total(c))}MB (${parts.map(p => `${p}=${mb(c[p])}`).join(', ')})`);
+    lines.push(`bess: ${mb(m.bess)}MB, queries: ${mb(m.qb)}MB, allocator cached: ${mb(m.pc)}MB`);
+    return lines.join('\n');
+};
+
 const onTableState = (tb, stats, callback) => {
     // save current selected table
     tableInfo = tb;
@@ -150,6 +166,8 @@ const onTableState = (tb, stats, callback) => {
     const maxts = time.format(tb.xt * 1000 + 1);
 
     stats.text(`[Blocks: ${bc}, Rows: ${rc}M, Mem: ${ms}GB, Min UTC: ${mints}, Max UTC: ${maxts}]`);
+    // memory breakdown shows up when hovering on the stats
+    stats.attr('title', memoryText(tb.mem));
 
     makeCalendar(fpcs, startId, '#startc', mints, mints, maxts);
     makeCalendar(fpce, endId, '#endc', maxts, mints, maxts);
@@ -179,7 +197,7 @@ const onTableState = (tb, stats, callback) => {
             targetColumns = strColumns;
         }
 
-        if (r === 'CARD_EST') {
+        if (r === 'CARD_EST' || r === 'CARD_EXACT' || r === 'TOPK') {
             // tree merge applies on string column (list column in future)
             targetColumns = [...strColumns, ...numColumns];
         }
@@ -419,6 +437,19 @@ const restore = () => {
     }
 };
 
+// brief query profile: blocks pruned, time (ms) of every phase and result bytes sent by nodes
+const profileText = (p) => {
+    if (!p) {
+        return "";
+    }
+
+    const ms = (us) => (us / 1000).toFixed(1);
+    return ` [pruned: meta=${p.blocksprunedmeta}, partition=${p.blocksprunedpartition}]`
+        + ` [filter=${ms(p.filterus)}ms, agg=${ms(p.aggregateus)}ms, node merge=${ms(p.nodemergeus)}ms,`
+        + ` serde=${ms(p.serdeus)}ms/${(p.serdebytes / 1024).toFixed(1)}KB,`
+        + ` server merge=${ms(p.servermergeus)}ms, finalize=${ms(p.finalizeus)}ms]`;
+};
+
 const onQueryResult = (state, r) => {
     if (r.error) {
         msg(`[query: error=${r.error}, latency=${r.duration} ms]`);
@@ -426,7 +457,7 @@ const onQueryResult = (state, r) => {
     }
 
     // print query result in stats
-    msg(`[query: latency=${r.duration}ms, scan=${r.rows_scan}, blocks=${r.blocks_scan}, rows=${r.rows_ret}]`);
+    msg(`[query: latency=${r.duration}ms, scan=${r.rows_scan}, blocks=${r.blocks_scan}, rows=${r.rows_ret}]${profileText(r.profile)}`);
 
     // JSON result
     ds.timeline = state.timeline;
@@ -16,12 +16,16 @@
 
 #include "ConnectionPool.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <tuple>
 
+#include "common/Metrics.h"
 #include "execution/BlockManager.h"
 #include "ingest/SpecRepo.h"
 
 DEFINE_uint64(CONNECTION_WAIT_SECONDS, 5, "Seconds to wait for connection to be done");
+DEFINE_uint32(DATA_CHANNELS, 4, "Channels to a node for query traffic used in turn, each has its own connection");
 
 namespace nebula {
 namespace service {
@@ -37,41 +41,101 @@ std::shared_ptr<ConnectionPool> ConnectionPool::init() noexcept {
   return inst;
 }
 
-// TODO(cao): we don't have maintainance yet,
-// ideally to have health check peridically and recreate channel when necessary.
-// api to get maintained channel
-std::shared_ptr<grpc::Channel> ConnectionPool::connection(const std::string& addr) {
-  // lock here for new connection creation?
-  auto located = connections_.find(addr);
-  if (located != connections_.end()) {
-    // do a little maintainance here
-    auto channel = located->second;
-    auto state = channel->GetState(true);
-    if (state != grpc_connectivity_state::GRPC_CHANNEL_SHUTDOWN) {
-      return channel;
+std::shared_ptr<grpc::Channel> ConnectionPool::connection(const std::string& addr, Traffic traffic) {
+  // pick the slot of the channel, data channels are used in turn
+  size_t slot = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& channels = connections_[addr];
+    auto& list = channels.list(traffic);
+    if (list.empty()) {
+      list.resize(traffic == Traffic::DATA ? std::max<size_t>(FLAGS_DATA_CHANNELS, 1) : 1);
     }
 
-    // will be replaced by channel recreation below
-    connections_.erase(addr);
-    LOG(INFO) << "Seeing a dead channel to " << addr;
+    if (traffic == Traffic::DATA) {
+      slot = channels.next++ % list.size();
+    }
+
+    auto channel = list.at(slot);
+    if (channel) {
+      if (channel->GetState(true) != grpc_connectivity_state::GRPC_CHANNEL_SHUTDOWN) {
+        return channel;
+      }
+
+      // will be replaced by channel recreation below
+      LOG(INFO) << "Seeing a dead channel to " << addr;
+    }
   }
 
   // create new connection
   LOG(INFO) << "Creating a channel to " << addr;
   auto channel = this->connect(addr);
-  auto state = channel->GetState(false);
-  if (state == grpc_connectivity_state::GRPC_CHANNEL_SHUTDOWN
-      || state == grpc_connectivity_state::GRPC_CHANNEL_TRANSIENT_FAILURE) {
+  if (!healthy(channel->GetState(false))) {
     // a bad channel when creating
     recordReset(addr);
     return channel;
   }
 
   // good connection (ready) or potential good (connecting)
-  connections_[addr] = channel;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& list = connections_[addr].list(traffic);
+  if (slot < list.size()) {
+    list[slot] = channel;
+  }
+
   return channel;
 }
 
+size_t ConnectionPool::probe() {
+  // collect broken channels, asking for state also wakes up an idle channel to connect
+  std::vector<std::tuple<std::string, Traffic, size_t>> broken;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& item : connections_) {
+      for (auto traffic : { Traffic::CONTROL, Traffic::DATA }) {
+        const auto& list = item.second.list(traffic);
+        for (size_t i = 0; i < list.size(); ++i) {
+          if (list.at(i) && !healthy(list.at(i)->GetState(true))) {
+            broken.emplace_back(item.first, traffic, i);
+          }
+        }
+      }
+    }
+  }
+
+  // reconnect them, a node failing to connect again is counted for one reset
+  size_t reconnected = 0;
+  nebula::common::unordered_set<std::string> failed;
+  for (const auto& [addr, traffic, slot] : broken) {
+    if (failed.find(addr) != failed.end()) {
+      continue;
+    }
+
+    auto channel = this->connect(addr);
+    if (!healthy(channel->GetState(false))) {
+      failed.emplace(addr);
+      recordReset(addr);
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto located = connections_.find(addr);
+    if (located != connections_.end()) {
+      auto& list = located->second.list(traffic);
+      if (slot < list.size()) {
+        list[slot] = channel;
+        ++reconnected;
+      }
+    }
+  }
+
+  if (reconnected > 0) {
+    LOG(INFO) << "Reconnected " << reconnected << " broken channels";
+  }
+
+  return reconnected;
+}
+
 std::shared_ptr<grpc::Channel> ConnectionPool::connect(const std::string& addr) const noexcept {
   // wait the connection to have clear state - ready or failure
   const auto deadline = Evidence::later(FLAGS_CONNECTION_WAIT_SECONDS);
@@ -82,12 +146,21 @@ std::shared_ptr<grpc::Channel> ConnectionPool::connect(const std::string& addr)
 
 void ConnectionPool::reset(const nebula::meta::NNode& node) {
   const auto addr = node.toString();
-  connections_.erase(addr);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_.erase(addr);
+  }
+
   LOG(INFO) << "Removing a channel to " << addr;
   recordReset(addr);
 }
 
 void ConnectionPool::recordReset(const std::string& addr) {
+  static auto& RESETS = nebula::common::Metrics::singleton().counter(
+    "nebula_connection_resets_total", "channels to nodes reset for failures");
+  RESETS.fetch_add(1, std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(resetsMutex_);
   auto reported = resets_.find(addr);
   if (reported != resets_.end()) {
     // increment the size
@@ -16,6 +16,7 @@
 #pragma once
 
 #include <grpcpp/grpcpp.h>
+#include <mutex>
 
 #include "common/Evidence.h"
 #include "common/Hash.h"
@@ -26,10 +27,28 @@ namespace nebula {
 namespace service {
 namespace node {
 
+// control traffic is short calls such as poll and task, data traffic is queries transferring results
+enum class Traffic : uint8_t {
+  CONTROL = 0,
+  DATA = 1
+};
+
 /**
- * Create a connection pool to maintain connections with nodes in cluster
+ * Create a connection pool to maintain connections with nodes in cluster.
+ * Every node has one channel for control calls and a few channels for queries used in turn, every channel has
+ * its own HTTP/2 connection, so a large result transfer doesn't hold up small queries or control calls behind it.
+ * Channels are probed periodically, a broken one is replaced before a call runs into it.
  */
 class ConnectionPool {
+  struct Channels {
+    std::vector<std::shared_ptr<grpc::Channel>> lists[2];
+    size_t next = 0;
+
+    inline std::vector<std::shared_ptr<grpc::Channel>>& list(Traffic traffic) {
+      return lists[static_cast<size_t>(traffic)];
+    }
+  };
+
 public:
   static std::shared_ptr<ConnectionPool> init() noexcept;
 
@@ -38,14 +57,15 @@ public:
   ConnectionPool(ConnectionPool&&) = delete;
   virtual ~ConnectionPool() = default;
 
-  // TODO(cao): we don't have maintainance yet,
-  // ideally to have health check peridically and recreate channel when necessary.
-  // api to get maintained channel
-  std::shared_ptr<grpc::Channel> connection(const std::string&);
+  // api to get maintained channel of given traffic to the address
+  std::shared_ptr<grpc::Channel> connection(const std::string&, Traffic = Traffic::CONTROL);
 
-  // reset the connection to this node
+  // reset all connections to this node
   void reset(const nebula::meta::NNode&);
 
+  // check state of all channels and reconnect broken ones, return number of channels reconnected
+  size_t probe();
+
   // test if a node is connectable
   inline bool test(const nebula::meta::NNode& node) const noexcept {
     auto channel = this->connect(node.toString());
@@ -69,19 +89,33 @@ private:
     // chArgs.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
     static grpc::ChannelArguments chArgs;
     chArgs.SetMaxReceiveMessageSize(-1);
+
+    // channels to the same node don't share their connection
+    chArgs.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
     return chArgs;
   }
 
   // try to connect to the address
   std::shared_ptr<grpc::Channel> connect(const std::string&) const noexcept;
 
+  // a channel is ready for calls or potentially good (connecting or idle)
+  static inline bool healthy(grpc_connectivity_state state) noexcept {
+    return state != grpc_connectivity_state::GRPC_CHANNEL_SHUTDOWN
+           && state != grpc_connectivity_state::GRPC_CHANNEL_TRANSIENT_FAILURE;
+  }
+
   // record node reset events
   void recordReset(const std::string&);
 
 private:
   ConnectionPool() = default;
-  nebula::common::unordered_map<std::string, std::shared_ptr<grpc::Channel>> connections_;
+
+  // channels are created outside of the lock as connecting may take a while
+  std::mutex mutex_;
+  nebula::common::unordered_map<std::string, Channels> connections_;
+
   // recording resets times, firs time stamp to reset and total reset count
+  std::mutex resetsMutex_;
   nebula::common::unordered_map<std::string, std::pair<size_t, size_t>> resets_;
 };
 
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CpuProfiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gperftools/profiler.h>
+#include <sstream>
+#include <thread>
+
+#include "common/Errors.h"
+
+DEFINE_string(PROFILE_FILE, "/tmp/nebula_cpu.prof", "file gperftools writes an on demand cpu profile into");
+DEFINE_uint32(PROFILE_MAX_SECONDS, 300, "max seconds an on demand cpu profile runs or waits for a query");
+
+/**
+ * Implement on demand cpu profile.
+ */
+namespace nebula {
+namespace service {
+namespace node {
+
+static std::chrono::seconds bounded(size_t seconds) {
+  return std::chrono::seconds(std::min<size_t>(seconds, FLAGS_PROFILE_MAX_SECONDS));
+}
+
+std::string CpuProfiler::timed(size_t seconds) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    N_ENSURE(state_ == State::IDLE, "a profile is running on this node");
+    start();
+    state_ = State::RUNNING;
+  }
+
+  std::this_thread::sleep_for(bounded(seconds));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto data = stop();
+  state_ = State::IDLE;
+  return data;
+}
+
+std::string CpuProfiler::next(const std::string& table, size_t seconds) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  N_ENSURE(state_ == State::IDLE, "a profile is running on this node");
+  table_ = table;
+  state_ = State::ARMED;
+  armed_ = true;
+
+  // a query started in time is waited for until it ends, which is bounded by its own deadline
+  auto done = [this]() { return state_ == State::DONE; };
+  if (!cv_.wait_for(lock, bounded(seconds), done)) {
+    if (state_ == State::ARMED) {
+      armed_ = false;
+      state_ = State::IDLE;
+      return {};
+    }
+
+    cv_.wait(lock, done);
+  }
+
+  state_ = State::IDLE;
+  return std::move(data_);
+}
+
+bool CpuProfiler::begin(const std::string& table) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (state_ != State::ARMED || (table_ != "*" && table_ != table)) {
+    return false;
+  }
+
+  armed_ = false;
+  try {
+    start();
+  } catch (const std::exception& exp) {
+    LOG(ERROR) << "Failed to profile query: " << exp.what();
+    data_.clear();
+    state_ = State::DONE;
+    cv_.notify_all();
+    return false;
+  }
+
+  state_ = State::RUNNING;
+  return true;
+}
+
+void CpuProfiler::end() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  data_ = stop();
+  state_ = State::DONE;
+  cv_.notify_all();
+}
+
+void CpuProfiler::start() {
+  N_ENSURE(ProfilerStart(FLAGS_PROFILE_FILE.c_str()) != 0, "failed to start cpu profiler");
+}
+
+std::string CpuProfiler::stop() {
+  ProfilerStop();
+  std::ifstream file(FLAGS_PROFILE_FILE, std::ios::binary);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+} // namespace node
+} // namespace service
+} // namespace nebula
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+/**
+ * On demand CPU profile of a node by gperftools sampling, so that a node in production is profiled without restart.
+ * A profile is taken for a number of seconds, or for the next query of a given table ("*" for any table).
+ * There is at most one profile at a time since gperftools profiler is process wide. For the same reason,
+ * samples are taken from all threads, a profile of a query includes whatever else the node is running along with it.
+ * The profile is returned as gperftools binary output, which is read by pprof with the node binary.
+ */
+namespace nebula {
+namespace service {
+namespace node {
+
+class CpuProfiler {
+  enum class State {
+    IDLE,
+    // waiting for the next query of the table
+    ARMED,
+    RUNNING,
+    // profile of a query is taken and not returned yet
+    DONE
+  };
+
+public:
+  CpuProfiler() : armed_{ false }, state_{ State::IDLE } {}
+  virtual ~CpuProfiler() = default;
+
+public:
+  // profile the node for given seconds and return the profile
+  std::string timed(size_t seconds);
+
+  // profile the next query of the table starting in given seconds and return the profile.
+  // empty if no query of the table starts in time.
+  std::string next(const std::string& table, size_t seconds);
+
+  // a query of given table executing while the scope lives, it's profiled if a profile is waiting for it
+  class Scope {
+  public:
+    Scope(CpuProfiler& profiler, const std::string& table)
+      : profiler_{ profiler }, owner_{ profiler.armed_.load(std::memory_order_relaxed) && profiler.begin(table) } {}
+    virtual ~Scope() {
+      if (owner_) {
+        profiler_.end();
+      }
+    }
+
+  private:
+    CpuProfiler& profiler_;
+    const bool owner_;
+  };
+
+private:
+  // start profile for a query of the table if it's waited for
+  bool begin(const std::string& table);
+  void end();
+
+  // start and stop gperftools profiler, stop returns the profile
+  static void start();
+  static std::string stop();
+
+private:
+  // fast check for every query without taking the lock
+  std::atomic<bool> armed_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  State state_;
+  std::string table_;
+  std::string data_;
+};
+
+} // namespace node
+} // namespace service
+} // namespace nebula
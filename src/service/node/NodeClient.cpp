@@ -16,7 +16,12 @@
 
 #include "NodeClient.h"
 
+#include <mutex>
+
+#include "common/Evidence.h"
 #include "execution/BlockManager.h"
+#include "ingest/IngestMetrics.h"
+#include "meta/ClusterInfo.h"
 
 /**
  * Define node server that does the work as nebula server asks.
@@ -25,23 +30,53 @@ namespace nebula {
 namespace service {
 namespace node {
 
+using nebula::common::CompositeCursor;
 using nebula::common::Task;
 using nebula::common::TaskState;
 using nebula::execution::BlockManager;
 using nebula::execution::PhaseType;
 using nebula::execution::PlanPtr;
+using nebula::execution::QueryStats;
+using nebula::execution::SpecSkips;
 using nebula::execution::TableStates;
+using nebula::execution::core::HedgeRace;
 using nebula::execution::io::BatchBlock;
+using nebula::ingest::IngestMetrics;
+using nebula::ingest::IngestRecord;
+using nebula::meta::BlockMemory;
 using nebula::meta::BlockSignature;
 using nebula::meta::BlockState;
+using nebula::meta::ClusterInfo;
+using nebula::meta::ColumnMemory;
+using nebula::meta::NNode;
 using nebula::service::base::BatchSerde;
 using nebula::service::base::QuerySerde;
 using nebula::service::base::TaskSerde;
 using nebula::surface::EmptyRowCursor;
 using nebula::surface::RowCursorPtr;
+using nebula::surface::RowData;
 using nebula::surface::eval::Fields;
 using nebula::surface::eval::HistVector;
 
+// make a call to node which ends by the query deadline, and it's cancelled along with the query
+// or when the hedged race it's in is decided by the other call
+template <typename F>
+static grpc::Status call(nebula::execution::Cancellation& cancel, HedgeRace* race, F&& rpc) {
+  grpc::ClientContext context;
+  if (cancel.deadline() > 0) {
+    context.set_deadline(std::chrono::system_clock::time_point(std::chrono::milliseconds(cancel.deadline())));
+  }
+
+  const auto listener = cancel.listen([&context]() { context.TryCancel(); });
+  const auto lost = race ? race->cancellation().listen([&context]() { context.TryCancel(); }) : 0;
+  auto status = rpc(context);
+  if (race) {
+    race->cancellation().unlisten(lost);
+  }
+  cancel.unlisten(listener);
+  return status;
+}
+
 void NodeClient::echo(const std::string& name) {
   // build request message through fb builder
   flatbuffers::grpc::MessageBuilder mb;
@@ -88,46 +123,156 @@ void NodeClient::echos(const std::string& name, size_t count) {
   }
 }
 
-folly::Future<RowCursorPtr> NodeClient::execute(const PlanPtr plan) {
+folly::Future<RowCursorPtr> NodeClient::execute(const PlanPtr plan, const std::vector<NNode>& peers) {
   auto p = std::make_shared<folly::Promise<RowCursorPtr>>();
   auto addr = node_.toString();
 
   // pass values since we reutrn the whole lambda - don't reference temporary things
   // such as local stack allocated variables, including "this" the client itself.
-  pool_.add([p, addr, q = query_, plan]() {
+  pool_.add([p, node = node_, addr, q = query_, plan, peers, race = race_, id = call_]() {
     // a response message placeholder
     flatbuffers::grpc::Message<BatchRows> qr;
 
     const Fields& f = plan->fetch<PhaseType::PARTIAL>().fields();
-    auto qp = QuerySerde::serialize(*q, plan->id(), plan->getWindow());
-    grpc::ClientContext context;
-    auto channel = ConnectionPool::init()->connection(addr);
+    auto& cancel = *plan->ctx().cancellation();
+    if (cancel.cancelled() || (race && race->decided())) {
+      p->setValue(EmptyRowCursor::instance());
+      return;
+    }
+
+    // the node finds its own skipped specs by in-process address, and its peers' by their addresses
+    SpecSkips skips;
+    if (!plan->getSkips().empty()) {
+      const auto& own = plan->skips(node);
+      if (!own.empty()) {
+        skips.emplace(NNode::inproc().toString(), own);
+      }
+
+      for (const auto& peer : peers) {
+        const auto& specs = plan->skips(peer);
+        if (!specs.empty()) {
+          skips.emplace(peer.toString(), specs);
+        }
+      }
+    }
+
+    auto qp = QuerySerde::serialize(*q,
+                                    plan->id(),
+                                    plan->getWindow(),
+                                    cancel.deadline(),
+                                    plan->ctx().user(),
+                                    plan->getTopRound(),
+                                    peers,
+                                    skips);
+    auto channel = ConnectionPool::init()->connection(addr, Traffic::DATA);
     N_ENSURE(channel != nullptr, "requires a valid channel");
     auto stub = nebula::service::NodeServer::NewStub(channel);
-    auto status = stub->Query(&context, qp, &qr);
+
+    // chunks of the result are deserialized as they arrive while the node is sending the rest
+    // their stats are added to the query once the result is taken, a hedged call may lose its race
+    QueryStats stats;
+    std::vector<RowCursorPtr> chunks;
+    nebula::common::Evidence::Duration tick;
+    size_t bytes = 0;
+    auto status = call(cancel, race.get(), [&](grpc::ClientContext& context) {
+      auto reader = stub->QueryStream(&context, qp);
+      while (reader->Read(&qr)) {
+        bytes += qr.BytesSize();
+        chunks.push_back(BatchSerde::deserialize(&qr, f, stats));
+      }
+
+      return reader->Finish();
+    });
+
+    // a node of older version doesn't stream its result
+    if (status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+      chunks.clear();
+      bytes = 0;
+      status = call(cancel, race.get(), [&](grpc::ClientContext& context) { return stub->Query(&context, qp, &qr); });
+      if (status.ok()) {
+        bytes = qr.BytesSize();
+        chunks.push_back(BatchSerde::deserialize(&qr, f, stats));
+      }
+    }
+
+    // the other call of the race finished first, this one is given up quietly
+    if (race) {
+      const auto won = status.ok() && race->claim(id);
+      if (!won && race->decided()) {
+        p->setValue(EmptyRowCursor::instance());
+        return;
+      }
+    }
+
     if (status.ok()) {
-      auto& stats = plan->ctx().stats();
-      auto fb = BatchSerde::deserialize(&qr, f, stats);
-      stats.rowsRet += fb->size();
-      VLOG(1) << "Received batch as number of rows: " << fb->size();
+      RowCursorPtr result = EmptyRowCursor::instance();
+      if (chunks.size() == 1) {
+        result = chunks.front();
+      } else if (chunks.size() > 1) {
+        auto composite = std::make_shared<CompositeCursor<RowData>>();
+        for (auto& chunk : chunks) {
+          composite->combine(chunk);
+        }
+        result = composite;
+      }
+
+      stats.rowsRet += result->size();
+      stats.profile.nodes.push_back({ addr, static_cast<size_t>(tick.elapsedUs()), bytes });
+      plan->ctx().stats().merge(stats);
+      VLOG(1) << "Received batch as number of rows: " << result->size() << " in chunks: " << chunks.size();
 
       // update into current server block management
-      p->setValue(fb);
+      p->setValue(result);
       return;
     }
 
+    // a node beyond memory limit fails the whole query, other nodes stop computing it
+    if (status.error_code() == grpc::StatusCode::RESOURCE_EXHAUSTED) {
+      plan->ctx().setError(nebula::execution::Error::MEMORY_LIMIT);
+      cancel.cancel();
+    }
+
+    // a call stopped by the query's own cancellation is not a node failure
+    if (cancel.cancelled()) {
+      p->setValue(EmptyRowCursor::instance());
+      return;
+    }
+
+    // otherwise server is told by exception, a timeout is told apart from other failures
     LOG(ERROR) << "Node failure: " << status.error_message() << ". Node: " << addr;
-    // else return empty result set
-    p->setValue(EmptyRowCursor::instance());
+    if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+      p->setException(folly::FutureTimeout());
+      return;
+    }
+
+    p->setException(NException(fmt::format("Node failure: {0}. Node: {1}", status.error_message(), addr)));
   });
 
   return p->getFuture();
 }
 
+// blocks of a node as server knows them by table and block key, every poll applies the changes node reports
+struct NodeView {
+  size_t version = 0;
+  nebula::common::unordered_map<std::string, nebula::common::unordered_map<std::string, std::shared_ptr<BatchBlock>>>
+    tables;
+};
+
+static std::mutex viewsMutex;
+static nebula::common::unordered_map<std::string, NodeView> views;
+
 void NodeClient::update() {
+  auto bm = BlockManager::init();
+  std::lock_guard<std::mutex> lock(viewsMutex);
+  auto& view = views[node_.toString()];
+
+  // ask for changes since the version we hold, or all blocks if block manager no longer has that version
+  // such as the node was removed
+  const auto version = bm->synced(node_) == view.version ? view.version : 0;
+
   // build request message through fb builder
   flatbuffers::grpc::MessageBuilder mb;
-  mb.Finish(nebula::service::CreateNodeStateRequest(mb, 1));
+  mb.Finish(nebula::service::CreateNodeStateRequest(mb, 1, version));
   auto nsRequest = mb.ReleaseMessage<NodeStateRequest>();
 
   // a response message placeholder
@@ -140,9 +285,27 @@ void NodeClient::update() {
     auto blocks = response->blocks();
     size_t size = blocks->size();
 
-    auto bm = BlockManager::init();
-    // update into current server block management
-    TableStates states;
+    // tables changed by this poll, a node of older version always sends all blocks without version
+    nebula::common::unordered_set<std::string> changed;
+    const auto full = response->full() || response->version() == 0;
+    if (full) {
+      for (const auto& t : view.tables) {
+        changed.emplace(t.first);
+      }
+
+      view.tables.clear();
+    } else if (response->removed()) {
+      for (auto itr = response->removed()->begin(); itr != response->removed()->end(); ++itr) {
+        const auto key = itr->str();
+        for (auto& t : view.tables) {
+          if (t.second.erase(key) > 0) {
+            changed.emplace(t.first);
+            break;
+          }
+        }
+      }
+    }
+
     for (size_t i = 0; i < size; ++i) {
       const DataBlock* db = blocks->Get(i);
       // convert serialized histograms
@@ -152,13 +315,34 @@ void NodeClient::update() {
       std::transform(hists->begin(), hists->end(),
                      std::back_inserter(histograms),
                      [](auto h) { return nebula::surface::eval::from(h->str()); });
+      // memory of columns, a node of older version doesn't have it
+      BlockMemory memory;
+      if (db->memory()) {
+        memory.columns.reserve(db->memory()->size());
+        for (auto c : *db->memory()) {
+          memory.columns.push_back(
+            ColumnMemory{ c->data(), c->nulls(), c->offsets(), c->dict(), c->bloom(), c->histogram() });
+        }
+        memory.bess = db->bess();
+      }
+
+      // histograms are merged by column name, or by position if a node of older version doesn't send them
+      std::vector<std::string> columns;
+      if (db->columns()) {
+        columns.reserve(db->columns()->size());
+        for (auto c : *db->columns()) {
+          columns.push_back(c->str());
+        }
+      }
+
       auto block = std::make_shared<BatchBlock>(
         BlockSignature{ db->table()->str(), db->id(), db->time_start(), db->time_end(), db->spec()->str() },
         node_,
-        BlockState{ db->rows(), db->raw_size(), std::move(histograms) });
+        BlockState{ db->rows(), db->raw_size(), std::move(histograms), std::move(memory), std::move(columns) });
 
-      // add this block in the new states
-      BlockManager::addBlock(states, block);
+      // add this block in its table
+      changed.emplace(block->table());
+      view.tables[block->table()][block->key()] = block;
     }
 
     // append empty spec from this node
@@ -167,9 +351,72 @@ void NodeClient::update() {
       bm->recordEmptySpec(itr->str());
     }
 
-    // TODO(cao): only swap when there is change?
-    // swap the new states in
-    bm->swap(node_, states);
+    // ingest metrics of the node, a node of older version doesn't have them
+    std::vector<IngestRecord> records;
+    auto ingest = response->ingest();
+    if (ingest) {
+      records.reserve(ingest->size());
+      for (auto itr = ingest->begin(); itr != ingest->end(); ++itr) {
+        records.push_back(IngestRecord{ itr->table()->str(),
+                                        itr->spec()->str(),
+                                        itr->start_ms(),
+                                        itr->end_ms(),
+                                        itr->rows(),
+                                        itr->bytes(),
+                                        itr->errors(),
+                                        itr->blocks(),
+                                        itr->lag(),
+                                        itr->throttles(),
+                                        { itr->fetch_ms(), itr->parse_ms(), itr->build_ms() } });
+      }
+    }
+    IngestMetrics::singleton().update(node_.server, std::move(records));
+
+    // query time of the node measures its heat for spec placement
+    ClusterInfo::singleton().updateNodeQueries(node_, response->query_ms());
+    ClusterInfo::singleton().updateNodeMemory(node_, response->query_bytes(), response->pool_cached());
+
+    // loading progress of tables in the node, a node of older version doesn't report it and is always ready
+    nebula::common::unordered_map<std::string, nebula::meta::TableReadiness> readiness;
+    if (response->tables()) {
+      for (auto t : *response->tables()) {
+        readiness.emplace(t->table()->str(), nebula::meta::TableReadiness{ t->specs(), t->loaded(), t->ready() });
+      }
+    }
+    ClusterInfo::singleton().updateNodeReadiness(node_, std::move(readiness));
+
+    // rebuild states of changed tables only, states of other tables are shared with current ones
+    view.version = response->version();
+    if (full || !changed.empty()) {
+      TableStates states;
+      if (!full) {
+        states = bm->states(node_);
+      }
+
+      for (const auto& table : changed) {
+        states.erase(table);
+        auto found = view.tables.find(table);
+        if (found == view.tables.end()) {
+          continue;
+        }
+
+        if (found->second.empty()) {
+          view.tables.erase(found);
+          continue;
+        }
+
+        TableStates rebuilt;
+        for (const auto& b : found->second) {
+          BlockManager::addBlock(rebuilt, b.second);
+        }
+
+        states.emplace(table, rebuilt.at(table));
+      }
+
+      // swap the new states in
+      bm->swap(node_, std::move(states), view.version);
+    }
+
     return;
   }
 
@@ -191,6 +438,33 @@ TaskState NodeClient::task(const Task& task) {
   return TaskState::UNKNOWN;
 }
 
+std::string NodeClient::profile(size_t seconds, const std::string& table, std::string& message) {
+  flatbuffers::grpc::MessageBuilder mb;
+  flatbuffers::Offset<flatbuffers::String> name;
+  if (!table.empty()) {
+    name = mb.CreateString(table);
+  }
+  mb.Finish(CreateCpuProfileRequest(mb, seconds, name));
+  auto request = mb.ReleaseMessage<CpuProfileRequest>();
+
+  grpc::ClientContext context;
+  flatbuffers::grpc::Message<CpuProfileReply> reply;
+  auto status = stub_->Profile(&context, request, &reply);
+  if (!status.ok()) {
+    message = status.error_message();
+    return {};
+  }
+
+  auto r = reply.GetRoot();
+  message = flatbuffers::GetString(r->message());
+  auto data = r->data();
+  if (data == nullptr) {
+    return {};
+  }
+
+  return std::string(reinterpret_cast<const char*>(data->data()), data->size());
+}
+
 } // namespace node
 } // namespace service
 } // namespace nebula
\ No newline at end of file
@@ -58,7 +58,8 @@ public:
   void echos(const std::string&, size_t);
 
   // execute a plan on remote node
-  virtual folly::Future<nebula::surface::RowCursorPtr> execute(const nebula::execution::PlanPtr plan) override;
+  virtual folly::Future<nebula::surface::RowCursorPtr> execute(
+    const nebula::execution::PlanPtr plan, const std::vector<nebula::meta::NNode>& peers) override;
 
   // pull node state
   virtual void update() override;
@@ -66,6 +67,10 @@ public:
   // send a task to a node
   virtual nebula::common::TaskState task(const nebula::common::Task&) override;
 
+  // take a cpu profile of the node for seconds, or of the next query of the table if given.
+  // return the profile, empty with the reason in message if no profile taken
+  std::string profile(size_t seconds, const std::string& table, std::string& message);
+
 private:
   std::shared_ptr<nebula::api::dsl::Query> query_;
   std::unique_ptr<NodeServer::Stub> stub_;
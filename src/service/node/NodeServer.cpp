@@ -18,22 +18,43 @@
 // #define USE_YOMM2_MD
 // #endif
 
+#include <atomic>
 #include <gflags/gflags.h>
+#include <thread>
 
 #include "NodeServer.h"
+#include "RemoteNodeConnector.h"
 #include "TaskExecutor.h"
 #include "common/Chars.h"
+#include "common/Evidence.h"
 #include "common/Ip.h"
+#include "common/Metrics.h"
 #include "common/TaskScheduler.h"
 #include "execution/BlockManager.h"
+#include "execution/core/AggregationMerge.h"
 #include "execution/core/NodeExecutor.h"
+#include "execution/core/ServerExecutor.h"
+#include "execution/meta/TableService.h"
 #include "execution/serde/RowCursorSerde.h"
+#include "ingest/BlockExpire.h"
+#include "ingest/IngestMetrics.h"
+#include "memory/keyed/FlatRowCursor.h"
+#include "service/base/MetricsEndpoint.h"
 #include "service/client/NebulaClient.h"
 #include "surface/DataSurface.h"
 
 DEFINE_int32(MAX_MSG_SIZE, 1073741824, "max message size sending between node and server, default to 1G");
+DEFINE_uint64(QUERY_CHUNK_BYTES, 4194304, "max bytes of a result chunk streamed from node to server, default to 4M");
 DEFINE_string(NSERVER, "", "discovery server address - host and port");
 DEFINE_int32(NODE_PORT, 9199, "port for current node server");
+DEFINE_int32(METRICS_PORT, 9198, "port of the metrics endpoint of the node for Prometheus to scrape, 0 to disable");
+DEFINE_uint32(COMPACT_SECONDS, 60, "interval in seconds to merge small blocks of the same spec, 0 to disable");
+DEFINE_uint64(COMPACT_MIN_ROWS, 100000, "blocks with fewer rows are merged by compaction");
+DEFINE_uint64(COMPACT_MAX_ROWS, 1000000, "max rows of a block merged by compaction");
+DEFINE_uint32(WARMUP_SECONDS, 10, "interval in seconds to load blocks predicted for recurring queries, 0 to disable");
+DEFINE_uint32(EXPIRE_SECONDS, 10, "interval in seconds to remove local blocks past retention of their table, 0 to disable");
+DEFINE_uint32(QUERY_POLLERS, 2, "threads polling async query calls, they dispatch calls and send results only");
+DEFINE_uint64(PLAN_CACHE_SIZE, 1024, "max number of compiled query plans cached for repeated queries, 0 to disable");
 
 /**
  * Define node server that does the work as nebula server asks.
@@ -42,18 +63,32 @@ namespace nebula {
 namespace service {
 namespace node {
 
+using nebula::common::Pool;
 using nebula::common::TaskState;
 using nebula::common::TaskType;
 using nebula::execution::BlockManager;
+using nebula::execution::MemoryBudget;
 using nebula::execution::PhaseType;
+using nebula::execution::PlanPtr;
 using nebula::execution::core::NodeExecutor;
 using nebula::execution::io::BatchBlock;
+using nebula::execution::serde::FlatBufferPtr;
+using nebula::ingest::IngestMetrics;
 using nebula::memory::keyed::FlatBuffer;
+using nebula::memory::keyed::FlatRowCursor;
 using nebula::service::base::BatchSerde;
 using nebula::service::base::QuerySerde;
 using nebula::service::base::TaskSerde;
 using nebula::surface::RowCursorPtr;
 
+// number of threads for tasks, at least one
+NodeServerImpl::NodeServerImpl()
+  : tableService_{ nebula::execution::meta::TableService::singleton() },
+    threadPool_{ std::thread::hardware_concurrency(), 3 },
+    plans_{ FLAGS_PLAN_CACHE_SIZE },
+    queryMs_{ 0 },
+    version_{ 0 } {}
+
 // Single echo implementation
 grpc::Status NodeServerImpl::Echo(
   grpc::ServerContext*,
@@ -106,38 +141,355 @@ grpc::Status NodeServerImpl::Echos(
   return grpc::Status::OK;
 }
 
-// TODO(cao) - we may want to change this endpoint as streaming
-// So that we don't need to do aggregation here, instead push all block executor results to server for aggregation.
-// Single aggregation - perf?
-grpc::Status NodeServerImpl::Query(
-  grpc::ServerContext*,
-  const flatbuffers::grpc::Message<QueryPlan>* query,
-  flatbuffers::grpc::Message<BatchRows>* batch) {
-#ifdef PPROF
-  ProfilerStart("/tmp/ns_query.out");
-#endif
+// shared by both query endpoints, they differ in how the result is sent back
+// add elapsed time of a query to the counter when it goes out of scope, whichever way the query ends
+class QueryTimer final {
+public:
+  explicit QueryTimer(std::atomic<size_t>& total) : total_{ total } {}
+  ~QueryTimer() {
+    static auto& LATENCY = nebula::common::Metrics::singleton().histogram(
+      "nebula_node_query_ms", "latency of queries executed by the node in milliseconds");
+    const auto ms = duration_.elapsedMs();
+    total_.fetch_add(ms, std::memory_order_relaxed);
+    LATENCY.observe(ms);
+  }
+
+private:
+  std::atomic<size_t>& total_;
+  nebula::common::Evidence::Duration duration_;
+};
+
+folly::Future<QueryResult> NodeServerImpl::execute(
+  grpc::ServerContext* context,
+  const flatbuffers::grpc::Message<QueryPlan>* query) {
+  auto timer = std::make_shared<QueryTimer>(queryMs_);
   try {
     auto r = query->GetRoot();
-    auto q = QuerySerde::deserialize(tableService_, query);
-    auto plan = QuerySerde::from(q, r->tstart(), r->tend());
+    auto profile = std::make_shared<CpuProfiler::Scope>(profiler_, flatbuffers::GetString(r->tbl()));
+
+    // a repeated query reuses its compiled plan, bound to window and user of this execution
+    const auto key = PlanCache::key(*r);
+    const auto user = flatbuffers::GetString(r->user());
+    const auto table = tableService_->query(flatbuffers::GetString(r->tbl())).table();
+    auto cached = plans_.get(key, table);
+    auto q = cached.first;
+    auto compiled = cached.second;
+    PlanPtr plan;
+    if (compiled) {
+      plan = QuerySerde::from(*compiled, r->tstart(), r->tend(), user);
+    } else {
+      q = std::make_shared<nebula::api::dsl::Query>(QuerySerde::deserialize(tableService_, query));
+      plan = QuerySerde::from(*q, r->tstart(), r->tend(), user);
+      if (table && plan->ctx().getError() == nebula::execution::Error::NONE) {
+        plans_.put(key, table, q, plan);
+      }
+    }
+
+    plan->setTopRound(QuerySerde::topRound(*r));
+    plan->setSkips(QuerySerde::skips(*r));
+
+    // the query is given up by its deadline, or when server cancels the call such as its client disconnected
+    auto& cancel = *plan->ctx().cancellation();
+    cancel.deadline(r->deadline());
+    cancel.watch([context]() { return context->IsCancelled(); });
 
     // execute this plan and get results
+    // as an intermediate node of the aggregation tree, results of peers are merged with the local one
     NodeExecutor executor(BlockManager::init());
-    auto cursor = executor.execute(threadPool_, plan);
-    const auto& phase = plan->fetch<PhaseType::PARTIAL>();
-    const auto& buffer = nebula::execution::serde::asBuffer(*cursor, phase.outputSchema(), phase.fields());
-
-    // serialize row cursor back
-    *batch = BatchSerde::serialize(*buffer, plan);
+    const auto peers = QuerySerde::peers(*r);
+    folly::Future<RowCursorPtr> cursor = executor.executeAsync(threadPool_, plan);
+    if (!peers.empty()) {
+      std::vector<folly::Future<RowCursorPtr>> results;
+      results.push_back(std::move(cursor));
+      for (auto& result : nebula::execution::core::dispatch(
+             threadPool_, plan, std::make_shared<RemoteNodeConnector>(q), peers)) {
+        results.push_back(std::move(result));
+      }
+
+      cursor = folly::collectAll(results).via(&threadPool_).thenValue(
+        [this, plan](std::vector<folly::Try<RowCursorPtr>>&& x) {
+          // the local result is the first one, its failure fails the query
+          if (x.front().hasException()) {
+            x.front().exception().throw_exception();
+          }
+
+          nebula::execution::core::countFailures(
+            std::vector<folly::Try<RowCursorPtr>>(x.begin() + 1, x.end()), plan->ctx().stats());
+          const auto& phase = plan->fetch<PhaseType::PARTIAL>();
+          return nebula::execution::core::merge(
+            threadPool_, phase.outputSchema(), phase.fields(), phase.hasAggregation(), x);
+        });
+    }
+
+    return std::move(cursor).thenTry(
+      [context, plan, timer, profile](folly::Try<RowCursorPtr>&& t) -> QueryResult {
+        if (t.hasException()) {
+          return { grpc::Status(grpc::StatusCode::INTERNAL, t.exception().what().toStdString()), nullptr, nullptr };
+        }
+
+        // a peer beyond memory limit fails the whole query
+        if (plan->ctx().getError() == nebula::execution::Error::MEMORY_LIMIT) {
+          return { grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "query exceeds memory limit on a peer"),
+                   nullptr,
+                   nullptr };
+        }
+
+        if (context->IsCancelled()) {
+          return { grpc::Status(grpc::StatusCode::CANCELLED, "query cancelled"), nullptr, nullptr };
+        }
+
+        const auto& memory = *plan->ctx().memory();
+        if (memory.exceeded()) {
+          return { grpc::Status(
+                     grpc::StatusCode::RESOURCE_EXHAUSTED,
+                     fmt::format("query exceeds memory limit of {0} bytes", memory.limit())),
+                   nullptr,
+                   nullptr };
+        }
+
+        try {
+          const auto& phase = plan->fetch<PhaseType::PARTIAL>();
+          return { grpc::Status::OK,
+                   plan,
+                   nebula::execution::serde::asBuffer(*t.value(), phase.outputSchema(), phase.fields()) };
+        } catch (const std::exception& exp) {
+          return { grpc::Status(grpc::StatusCode::INTERNAL, exp.what()), nullptr, nullptr };
+        }
+      });
   } catch (const std::exception& exp) {
-    return grpc::Status(grpc::StatusCode::INTERNAL, exp.what());
+    return folly::makeFuture(QueryResult{ grpc::Status(grpc::StatusCode::INTERNAL, exp.what()), nullptr, nullptr });
   }
+}
 
-#ifdef PPROF
-  ProfilerStop();
-#endif
+// serialize a result buffer in the batch format asked by the query
+static flatbuffers::grpc::Message<BatchRows> serialize(
+  const QueryPlan& query, FlatBuffer& buffer, const PlanPtr& plan, bool stats) {
+  if (query.columnar()) {
+    return BatchSerde::columnar(buffer, plan, stats, query.codec());
+  }
 
-  return grpc::Status::OK;
+  return BatchSerde::serialize(buffer, plan, stats, query.codec());
+}
+
+// an async query call lives from the time it's requested until it's finished.
+// it is the tag of all its operations on the completion queue, proceed is called when an operation completes.
+// it takes no thread while its query is running, its result is sent by the thread completing the execution.
+class QueryCall {
+public:
+  QueryCall(NodeServerImpl& node, grpc::ServerCompletionQueue* queue)
+    : node_{ node }, queue_{ queue }, state_{ State::REQUESTED } {}
+  virtual ~QueryCall() = default;
+
+  void proceed(bool ok) {
+    switch (state_) {
+    case State::REQUESTED: {
+      // the queue is shut down
+      if (!ok) {
+        delete this;
+        return;
+      }
+
+      // the next call is accepted before this one is served
+      renew();
+      state_ = State::RUNNING;
+      node_.execute(&context_, &request_).thenTry([this](folly::Try<QueryResult>&& result) {
+        if (result.hasException()) {
+          finish(grpc::Status(grpc::StatusCode::INTERNAL, result.exception().what().toStdString()));
+          return;
+        }
+
+        respond(std::move(result).value());
+      });
+      return;
+    }
+    case State::WRITING: {
+      written(ok);
+      return;
+    }
+    default: {
+      delete this;
+      return;
+    }
+    }
+  }
+
+protected:
+  enum class State {
+    REQUESTED,
+    RUNNING,
+    WRITING,
+    FINISHED
+  };
+
+  inline void* tag() noexcept {
+    return static_cast<QueryCall*>(this);
+  }
+
+  // request a new call of the same endpoint
+  virtual void renew() = 0;
+
+  // send the result of the execution back
+  virtual void respond(QueryResult&&) = 0;
+
+  // end the call with an error
+  virtual void finish(const grpc::Status&) = 0;
+
+  // a write of a result chunk is done
+  virtual void written(bool) {}
+
+protected:
+  NodeServerImpl& node_;
+  grpc::ServerCompletionQueue* queue_;
+  grpc::ServerContext context_;
+  flatbuffers::grpc::Message<QueryPlan> request_;
+  State state_;
+};
+
+// the whole result is sent back in one message, which is bound by MAX_MSG_SIZE
+class UnaryCall final : public QueryCall {
+public:
+  UnaryCall(NodeServerImpl& node, grpc::ServerCompletionQueue* queue)
+    : QueryCall(node, queue), responder_{ &context_ } {
+    node_.RequestQuery(&context_, &request_, &responder_, queue_, queue_, tag());
+  }
+
+private:
+  virtual void renew() override {
+    new UnaryCall(node_, queue_);
+  }
+
+  virtual void respond(QueryResult&& result) override {
+    if (!result.status.ok()) {
+      finish(result.status);
+      return;
+    }
+
+    try {
+      // serialize row cursor back
+      reply_ = serialize(*request_.GetRoot(), *result.buffer, result.plan, true);
+    } catch (const std::exception& exp) {
+      finish(grpc::Status(grpc::StatusCode::INTERNAL, exp.what()));
+      return;
+    }
+
+    state_ = State::FINISHED;
+    responder_.Finish(reply_, grpc::Status::OK, tag());
+  }
+
+  virtual void finish(const grpc::Status& status) override {
+    state_ = State::FINISHED;
+    responder_.FinishWithError(status, tag());
+  }
+
+private:
+  grpc::ServerAsyncResponseWriter<flatbuffers::grpc::Message<BatchRows>> responder_;
+  flatbuffers::grpc::Message<BatchRows> reply_;
+};
+
+// result rows are copied into chunks of bounded size, every chunk is serialized and sent once it's full,
+// so the server deserializes a chunk while the next one is built, and no message is over the size limit.
+// rows of a node result have distinct keys, so chunks of an aggregated result are simply concatenated.
+// one chunk is written at a time, the next one is built in the pool when the last write is done.
+class StreamCall final : public QueryCall {
+public:
+  StreamCall(NodeServerImpl& node, grpc::ServerCompletionQueue* queue)
+    : QueryCall(node, queue), writer_{ &context_ }, stats_{ true } {
+    node_.RequestQueryStream(&context_, &request_, &writer_, queue_, queue_, tag());
+  }
+
+private:
+  virtual void renew() override {
+    new StreamCall(node_, queue_);
+  }
+
+  virtual void respond(QueryResult&& result) override {
+    if (!result.status.ok()) {
+      finish(result.status);
+      return;
+    }
+
+    plan_ = result.plan;
+    buffer_ = std::move(result.buffer);
+    next();
+  }
+
+  virtual void finish(const grpc::Status& status) override {
+    state_ = State::FINISHED;
+    writer_.Finish(status, tag());
+  }
+
+  virtual void written(bool ok) override {
+    if (!ok) {
+      finish(grpc::Status(grpc::StatusCode::CANCELLED, "query result not delivered"));
+      return;
+    }
+
+    node_.pool().add([this]() { next(); });
+  }
+
+  // write the next chunk, the last one is written with the call status
+  void next() {
+    const auto& root = *request_.GetRoot();
+    try {
+      // small result is sent as is
+      if (buffer_) {
+        if (buffer_->bytes() <= FLAGS_QUERY_CHUNK_BYTES) {
+          message_ = serialize(root, *buffer_, plan_, true);
+          buffer_ = nullptr;
+          state_ = State::FINISHED;
+          writer_.WriteAndFinish(message_, grpc::WriteOptions(), grpc::Status::OK, tag());
+          return;
+        }
+
+        cursor_ = std::make_unique<FlatRowCursor>(std::move(buffer_));
+      }
+
+      const auto& phase = plan_->fetch<PhaseType::PARTIAL>();
+      auto chunk = std::make_unique<FlatBuffer>(phase.outputSchema(), phase.fields());
+      while (cursor_->hasNext()) {
+        chunk->add(cursor_->next());
+        if (chunk->bytes() >= FLAGS_QUERY_CHUNK_BYTES) {
+          break;
+        }
+      }
+
+      message_ = serialize(root, *chunk, plan_, stats_);
+      stats_ = false;
+    } catch (const std::exception& exp) {
+      finish(grpc::Status(grpc::StatusCode::INTERNAL, exp.what()));
+      return;
+    }
+
+    if (!cursor_->hasNext()) {
+      state_ = State::FINISHED;
+      writer_.WriteAndFinish(message_, grpc::WriteOptions(), grpc::Status::OK, tag());
+      return;
+    }
+
+    state_ = State::WRITING;
+    writer_.Write(message_, tag());
+  }
+
+private:
+  grpc::ServerAsyncWriter<flatbuffers::grpc::Message<BatchRows>> writer_;
+  PlanPtr plan_;
+  FlatBufferPtr buffer_;
+  std::unique_ptr<FlatRowCursor> cursor_;
+  flatbuffers::grpc::Message<BatchRows> message_;
+  bool stats_;
+};
+
+void NodeServerImpl::accept(grpc::ServerCompletionQueue* queue) {
+  new UnaryCall(*this, queue);
+  new StreamCall(*this, queue);
+}
+
+void NodeServerImpl::serve(grpc::ServerCompletionQueue* queue) {
+  void* tag = nullptr;
+  bool ok = false;
+  while (queue->Next(&tag, &ok)) {
+    static_cast<QueryCall*>(tag)->proceed(ok);
+  }
 }
 
 // poll block status of a node
@@ -160,10 +512,25 @@ grpc::Status NodeServerImpl::Poll(
   const auto bm = BlockManager::init();
   flatbuffers::grpc::MessageBuilder mb;
   std::vector<flatbuffers::Offset<DataBlock>> db;
-  db.reserve(bm->numBlocks());
+
+  // only blocks changed since the version server holds are sent, every block is sent if server holds another version
+  std::lock_guard<std::mutex> lock(pollMutex_);
+  const auto full = request->version() == 0 || request->version() != version_;
+  if (full) {
+    db.reserve(bm->numBlocks());
+  }
+
+  nebula::common::unordered_set<std::string> current;
   const auto& states = bm->states();
   for (const auto& s : states) {
-    s.second->iterate([&mb, &db](const BatchBlock& bb) {
+    s.second->iterate([this, full, &current, &mb, &db](const BatchBlock& bb) {
+      auto key = bb.key();
+      const auto sent = !full && sent_.find(key) != sent_.end();
+      current.emplace(std::move(key));
+      if (sent) {
+        return;
+      }
+
       const auto& state = bb.state();
       // serialize histograms
       std::vector<flatbuffers::Offset<flatbuffers::String>> hists;
@@ -173,12 +540,42 @@ grpc::Status NodeServerImpl::Poll(
                      [&mb](auto h) {
                        return mb.CreateString(h->toString());
                      });
+
+      std::vector<flatbuffers::Offset<flatbuffers::String>> columns;
+      columns.reserve(state.columns.size());
+      for (const auto& c : state.columns) {
+        columns.push_back(mb.CreateString(c));
+      }
+
+      // memory of every column
+      std::vector<ColumnBytes> memory;
+      memory.reserve(state.memory.columns.size());
+      for (const auto& c : state.memory.columns) {
+        memory.emplace_back(c.data, c.nulls, c.offsets, c.dict, c.bloom, c.histogram);
+      }
+
       db.push_back(CreateDataBlockDirect(
         mb, bb.table().c_str(), bb.getId(), bb.start(), bb.end(),
-        bb.spec().c_str(), bb.storage().c_str(), state.numRows, state.rawSize, &hists));
+        bb.spec().c_str(), bb.storage().c_str(), state.numRows, state.rawSize, &hists, &memory, state.memory.bess,
+        &columns));
     });
   }
 
+  std::vector<flatbuffers::Offset<flatbuffers::String>> removed;
+  if (!full) {
+    for (const auto& key : sent_) {
+      if (current.find(key) == current.end()) {
+        removed.push_back(mb.CreateString(key));
+      }
+    }
+  }
+
+  if (full || !db.empty() || !removed.empty()) {
+    ++version_;
+  }
+
+  sent_ = std::move(current);
+
   // empty specs
   const auto& specSet = bm->emptySpecs();
   std::vector<flatbuffers::Offset<flatbuffers::String>> specs;
@@ -187,7 +584,25 @@ grpc::Status NodeServerImpl::Poll(
     specs.push_back(mb.CreateString(spec));
   }
 
-  mb.Finish(CreateNodeStateReplyDirect(mb, &db, &specs));
+  // ingest metrics of specs running and recently done
+  const auto records = IngestMetrics::singleton().records();
+  std::vector<flatbuffers::Offset<IngestStat>> ingest;
+  ingest.reserve(records.size());
+  for (const auto& r : records) {
+    ingest.push_back(CreateIngestStatDirect(
+      mb, r.table.c_str(), r.spec.c_str(), r.start, r.end, r.rows, r.bytes, r.errors, r.blocks, r.lag, r.throttles,
+      r.ms[0], r.ms[1], r.ms[2]));
+  }
+
+  // loading progress of tables
+  std::vector<flatbuffers::Offset<TableLoad>> tables;
+  for (const auto& [table, r] : TaskExecutor::singleton().readiness()) {
+    tables.push_back(CreateTableLoadDirect(mb, table.c_str(), r.specs, r.loaded, r.ready));
+  }
+
+  mb.Finish(CreateNodeStateReplyDirect(
+    mb, &db, &specs, &ingest, queryMs_.load(std::memory_order_relaxed), version_, full, &removed,
+    MemoryBudget::inUse(), Pool::getDefault().cached(), &tables));
 
   // The `ReleaseMessage<T>()` function detaches the message from the
   // builder, so we can transfer the resopnse to gRPC while simultaneously
@@ -223,10 +638,86 @@ grpc::Status NodeServerImpl::Task(
   return grpc::Status::OK;
 }
 
+// the call holds until the profile is taken, the profile is dropped if server has given up the call
+grpc::Status NodeServerImpl::Profile(
+  grpc::ServerContext* context,
+  const flatbuffers::grpc::Message<CpuProfileRequest>* req,
+  flatbuffers::grpc::Message<CpuProfileReply>* rep) {
+  auto r = req->GetRoot();
+  const auto table = flatbuffers::GetString(r->table());
+  std::string data;
+  std::string message;
+  try {
+    data = table.empty() ? profiler_.timed(r->seconds()) : profiler_.next(table, r->seconds());
+    if (data.empty()) {
+      message = fmt::format("no query of table {0} in {1} seconds", table, r->seconds());
+    }
+  } catch (const std::exception& exp) {
+    message = exp.what();
+  }
+
+  if (context->IsCancelled()) {
+    return grpc::Status(grpc::StatusCode::CANCELLED, "profile call cancelled");
+  }
+
+  LOG(INFO) << "Cpu profile of " << (table.empty() ? fmt::format("{0} seconds", r->seconds()) : table)
+            << ": bytes=" << data.size() << ", message=" << message;
+  flatbuffers::grpc::MessageBuilder mb;
+  auto bytes = mb.CreateVector(reinterpret_cast<const int8_t*>(data.data()), data.size());
+  mb.Finish(CreateCpuProfileReply(mb, bytes, mb.CreateString(message)));
+  *rep = mb.ReleaseMessage<CpuProfileReply>();
+  return grpc::Status::OK;
+}
+
 } // namespace node
 } // namespace service
 } // namespace nebula
 
+// node metrics read at scrape: queues, blocks in memory and ingestion
+static void registerNodeMetrics(folly::ThreadPoolExecutor& pool) {
+  using nebula::common::TaskType;
+  auto& metrics = nebula::common::Metrics::singleton();
+  nebula::service::base::registerProcessMetrics();
+  metrics.gauge("nebula_query_tasks_pending", "block tasks of queries waiting in the node thread pool", [&pool]() {
+    return pool.getPendingTaskCount();
+  });
+
+  for (const auto& [type, name] : { std::pair{ TaskType::INGESTION, "ingestion" },
+                                    std::pair{ TaskType::EXPIRATION, "expiration" } }) {
+    metrics.gauge(
+      "nebula_tasks_pending",
+      "tasks of the type waiting or running in task executor",
+      [t = type]() { return nebula::service::node::TaskExecutor::singleton().pending(t); },
+      fmt::format("{{type=\"{0}\"}}", name));
+  }
+
+  // blocks of this node summed across tables
+  auto blocks = [](auto read) {
+    return [read]() {
+      size_t total = 0;
+      const auto states = nebula::execution::BlockManager::init()->states();
+      for (const auto& ts : states) {
+        total += read(*ts.second);
+      }
+      return total;
+    };
+  };
+  metrics.gauge("nebula_blocks", "blocks in memory of the node", blocks([](const auto& s) { return s.numBlocks(); }));
+  metrics.gauge("nebula_rows", "rows in memory of the node", blocks([](const auto& s) { return s.numRows(); }));
+  metrics.gauge(
+    "nebula_raw_bytes", "raw bytes of blocks in memory of the node", blocks([](const auto& s) { return s.rawBytes(); }));
+
+  // ingest rates are given by rates of the totals
+  auto ingest = [](auto read) {
+    return [read]() { return read(nebula::ingest::IngestMetrics::singleton().totals()); };
+  };
+  metrics.counter("nebula_ingest_rows_total", "rows ingested", ingest([](const auto& t) { return t.rows; }));
+  metrics.counter("nebula_ingest_bytes_total", "bytes ingested", ingest([](const auto& t) { return t.bytes; }));
+  metrics.counter("nebula_ingest_errors_total", "rows failed to ingest", ingest([](const auto& t) { return t.errors; }));
+  metrics.gauge("nebula_ingest_running", "specs being ingested", ingest([](const auto& t) { return t.running; }));
+  metrics.gauge("nebula_ingest_lag", "lag of specs being ingested", ingest([](const auto& t) { return t.lag; }));
+}
+
 std::string ReadNServer() {
   // NCONF is one enviroment variable to overwrite cluster config in the runtime
   if (const char* nConf = std::getenv("NSERVER")) {
@@ -257,9 +748,21 @@ void RunServer() {
   builder.SetMaxSendMessageSize(FLAGS_MAX_MSG_SIZE);
   builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
   builder.RegisterService(&node);
+
+  // query calls are served by a few threads polling the queue, they never wait for a query
+  auto queries = builder.AddCompletionQueue();
   std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
   LOG(INFO) << "Nebula node listening on " << server_address;
 
+  node.accept(queries.get());
+  std::vector<std::thread> pollers;
+  for (size_t i = 0, size = std::max<size_t>(1, FLAGS_QUERY_POLLERS); i < size; ++i) {
+    pollers.emplace_back([&queries]() { nebula::service::node::NodeServerImpl::serve(queries.get()); });
+  }
+
+  registerNodeMetrics(node.pool());
+  nebula::service::base::MetricsEndpoint metrics{ FLAGS_METRICS_PORT };
+
   // run a task executor to
   // NOTE that, this is blocking main thread to wait for server down
   // this may prevent system to exit properly, will revisit and revise.
@@ -277,10 +780,66 @@ void RunServer() {
 
   taskScheduler.setInterval(
     1000,
-    [shutdownHandler, &priorityPool = node.pool()] {
-      nebula::service::node::TaskExecutor::singleton().process(shutdownHandler, priorityPool);
+    [shutdownHandler] {
+      nebula::service::node::TaskExecutor::singleton().process(shutdownHandler);
     });
 
+  // small blocks, such as kafka segments, are merged in background at low priority so queries touch fewer blocks
+  std::atomic<bool> compacting{ false };
+  if (FLAGS_COMPACT_SECONDS > 0) {
+    taskScheduler.setInterval(
+      FLAGS_COMPACT_SECONDS * 1000,
+      [&compacting, &pool = node.pool()] {
+        if (compacting.exchange(true)) {
+          return;
+        }
+
+        pool.addWithPriority(
+          [&compacting] {
+            auto table = [](const std::string& name) {
+              return nebula::execution::meta::TableService::singleton()->query(name).table();
+            };
+            nebula::execution::BlockManager::init()->compact(FLAGS_COMPACT_MIN_ROWS, FLAGS_COMPACT_MAX_ROWS, table);
+            compacting = false;
+          },
+          folly::Executor::LO_PRI);
+      });
+  }
+
+  // blocks of the windows recurring queries (dashboards) read next are loaded back before they run
+  std::atomic<bool> warming{ false };
+  if (FLAGS_WARMUP_SECONDS > 0) {
+    taskScheduler.setInterval(
+      FLAGS_WARMUP_SECONDS * 1000,
+      [&warming, &pool = node.pool()] {
+        if (warming.exchange(true)) {
+          return;
+        }
+
+        pool.addWithPriority(
+          [&warming] {
+            // look ahead by two intervals so a run is not missed between two warmups
+            nebula::execution::BlockManager::init()->warmup(
+              nebula::common::Evidence::unix_timestamp(), 2 * FLAGS_WARMUP_SECONDS);
+            warming = false;
+          },
+          folly::Executor::LO_PRI);
+      });
+  }
+
+  // blocks past retention are removed by the node itself, only specs due by now are visited
+  if (FLAGS_EXPIRE_SECONDS > 0) {
+    taskScheduler.setInterval(
+      FLAGS_EXPIRE_SECONDS * 1000,
+      [&pool = node.pool()] {
+        pool.addWithPriority(
+          [] {
+            nebula::ingest::BlockExpire::local(nebula::common::Evidence::unix_timestamp());
+          },
+          folly::Executor::LO_PRI);
+      });
+  }
+
   // for every second, ping discovery server
   const auto discovery = ReadNServer();
   const auto client = nebula::service::client::NebulaClient::make(discovery);
@@ -312,6 +871,12 @@ void RunServer() {
   // Wait for the server to shutdown. Note that some other thread must be
   // responsible for shutting down the server for this call to ever return.
   server->Wait();
+
+  // calls left in the queue are dropped
+  queries->Shutdown();
+  for (auto& poller : pollers) {
+    poller.join();
+  }
 }
 
 int main(int argc, char** argv) {
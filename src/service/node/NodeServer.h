@@ -15,23 +15,39 @@
  */
 #pragma once
 
-#include <gperftools/profiler.h>
+#include <atomic>
 #include <grpcpp/grpcpp.h>
+#include <mutex>
 
+#include "CpuProfiler.h"
+#include "PlanCache.h"
 #include "common/Folly.h"
+#include "common/Hash.h"
 #include "execution/meta/TableService.h"
+#include "execution/serde/RowCursorSerde.h"
 #include "node/node.grpc.fb.h"
 #include "node/node_generated.h"
 #include "service/base/NebulaService.h"
 
 /**
  * Define node server that does the work as nebula server asks.
+ * Query endpoints are served by the async gRPC API: a query call holds no thread while it runs,
+ * its execution is chained as futures in the pool and its result is sent once the execution completes.
+ * So concurrent queries are bounded by the pool (cpus) rather than by handler threads waiting for results.
  */
 namespace nebula {
 namespace service {
 namespace node {
 
-class NodeServerImpl final : public NodeServer::Service {
+// result of a query execution: its status, and its plan and result buffer if the status is OK
+struct QueryResult {
+  grpc::Status status;
+  nebula::execution::PlanPtr plan;
+  nebula::execution::serde::FlatBufferPtr buffer;
+};
+
+class NodeServerImpl final
+  : public NodeServer::WithAsyncMethod_Query<NodeServer::WithAsyncMethod_QueryStream<NodeServer::Service>> {
   virtual grpc::Status Echo(
     grpc::ServerContext*,
     const flatbuffers::grpc::Message<EchoPing>*,
@@ -43,12 +59,6 @@ class NodeServerImpl final : public NodeServer::Service {
     grpc::ServerWriter<flatbuffers::grpc::Message<EchoReply>>*)
     override;
 
-  virtual grpc::Status Query(
-    grpc::ServerContext*,
-    const flatbuffers::grpc::Message<QueryPlan>*,
-    flatbuffers::grpc::Message<BatchRows>*)
-    override;
-
   virtual grpc::Status Poll(
     grpc::ServerContext*,
     const flatbuffers::grpc::Message<NodeStateRequest>*,
@@ -61,25 +71,51 @@ class NodeServerImpl final : public NodeServer::Service {
     flatbuffers::grpc::Message<TaskReply>*)
     override;
 
+  virtual grpc::Status Profile(
+    grpc::ServerContext*,
+    const flatbuffers::grpc::Message<CpuProfileRequest>*,
+    flatbuffers::grpc::Message<CpuProfileReply>*)
+    override;
+
 public:
-  NodeServerImpl()
-    : tableService_{ nebula::execution::meta::TableService::singleton() },
-      threadPool_{ std::thread::hardware_concurrency(), 2 } {}
+  NodeServerImpl();
   virtual ~NodeServerImpl() = default;
 
   folly::ThreadPoolExecutor& pool() {
     return threadPool_;
   }
 
+  // accept query calls from the queue, it is called once before the queue is served
+  void accept(grpc::ServerCompletionQueue*);
+
+  // serve calls of the queue until it is shut down, called by every thread polling the queue
+  static void serve(grpc::ServerCompletionQueue*);
+
+  // execute a query plan, the future completes with its result when the execution is done
+  folly::Future<QueryResult> execute(grpc::ServerContext*, const flatbuffers::grpc::Message<QueryPlan>*);
+
 private:
   std::shared_ptr<nebula::execution::meta::TableService> tableService_;
 
   // by default if not specified, CPUThreadPoolExecutor will use UnboundedBlockingQueue
   // so we can add as many task as we want.
-  // Initialize this pool with two priority queues:
-  //    higher for query execution.
-  //    lower for task execution.
+  // Initialize this pool with three priority queues for block tasks of
+  // interactive, batch and background queries.
   folly::CPUThreadPoolExecutor threadPool_;
+
+  // compiled plans of repeated queries
+  PlanCache plans_;
+
+  // on demand cpu profile of a period or a query
+  CpuProfiler profiler_;
+
+  // total time spent in executing queries, reported to server as query heat of this node
+  std::atomic<size_t> queryMs_;
+
+  // version of block states polled by server and keys of blocks in it, a poll sends the difference to it
+  std::mutex pollMutex_;
+  size_t version_;
+  nebula::common::unordered_set<std::string> sent_;
 };
 
 } // namespace node
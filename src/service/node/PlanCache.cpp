@@ -0,0 +1,119 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PlanCache.h"
+
+#include <fmt/format.h>
+
+/**
+ * Implement the compiled plan cache.
+ */
+namespace nebula {
+namespace service {
+namespace node {
+
+using nebula::api::dsl::Query;
+using nebula::execution::PlanPtr;
+using nebula::meta::TablePtr;
+
+std::string PlanCache::key(const QueryPlan& plan) {
+  // every string is prefixed by its size so that no two different plans make the same key
+  std::string key;
+  auto append = [&key](const flatbuffers::String* str) {
+    const auto value = flatbuffers::GetString(str);
+    key.append(fmt::format("{0}:", value.size()));
+    key.append(value);
+  };
+
+  append(plan.tbl());
+  append(plan.filter());
+  append(plan.customs());
+  if (plan.fields()) {
+    key.append(fmt::format("{0}|", plan.fields()->size()));
+    for (auto itr = plan.fields()->begin(); itr != plan.fields()->end(); ++itr) {
+      append(*itr);
+    }
+  }
+
+  // expression trees are the same bytes for the same expressions
+  if (plan.exprs()) {
+    const auto exprs = plan.exprs();
+    key.append(fmt::format("{0}:", exprs->size()));
+    key.append(reinterpret_cast<const char*>(exprs->data()), exprs->size());
+  }
+
+  auto numbers = [&key](const auto* list) {
+    key.append("|");
+    if (list) {
+      for (auto itr = list->begin(); itr != list->end(); ++itr) {
+        key.append(fmt::format("{0},", *itr));
+      }
+    }
+  };
+
+  numbers(plan.groups());
+  numbers(plan.sorts());
+  numbers(plan.descs());
+  key.append(fmt::format("|{0}|{1}|{2}", plan.desc(), plan.limit(), plan.sample()));
+  return key;
+}
+
+std::pair<std::shared_ptr<Query>, PlanPtr> PlanCache::get(const std::string& key, const TablePtr& table) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = entries_.find(key);
+  if (found == entries_.end()) {
+    return { nullptr, nullptr };
+  }
+
+  // the table changed since the plan was compiled
+  if (found->second.table != table) {
+    erase(found);
+    return { nullptr, nullptr };
+  }
+
+  // move it to the most recent
+  lru_.splice(lru_.begin(), lru_, found->second.lru);
+  return { found->second.query, found->second.plan };
+}
+
+void PlanCache::put(const std::string& key, const TablePtr& table, std::shared_ptr<Query> query, PlanPtr plan) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = entries_.find(key);
+  if (found != entries_.end()) {
+    erase(found);
+  }
+
+  if (capacity_ == 0) {
+    return;
+  }
+
+  // evict least recently used ones to make room
+  while (entries_.size() >= capacity_) {
+    erase(entries_.find(lru_.back()));
+  }
+
+  lru_.push_front(key);
+  entries_.emplace(key, Entry{ table, std::move(query), std::move(plan), lru_.begin() });
+}
+
+void PlanCache::erase(nebula::common::unordered_map<std::string, Entry>::iterator entry) {
+  lru_.erase(entry->second.lru);
+  entries_.erase(entry);
+}
+
+} // namespace node
+} // namespace service
+} // namespace nebula
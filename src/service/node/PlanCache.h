@@ -0,0 +1,87 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+
+#include "api/dsl/Query.h"
+#include "common/Hash.h"
+#include "execution/ExecutionPlan.h"
+#include "meta/MetaService.h"
+#include "node/node_generated.h"
+
+/**
+ * Cache compiled plans of queries on a node.
+ * Dashboards keep sending the same queries, compiling a query rebuilds its expressions, UDFs and schemas
+ * from strings every time, which is a noticeable part of a short query.
+ * An entry is keyed by the fields of a query plan message which compile depends on, parameters of every execution
+ * such as window, deadline, user or top round are bound to a plan forked from the cached one.
+ * It is tagged by the table object compiled against, a lookup with a different table (such as schema updated)
+ * invalidates the entry. Entries are evicted in LRU order by count.
+ */
+namespace nebula {
+namespace service {
+namespace node {
+
+class PlanCache final {
+public:
+  explicit PlanCache(size_t capacity) : capacity_{ capacity } {}
+  ~PlanCache() = default;
+
+public:
+  // cache key of the compiled plan of given query plan message
+  static std::string key(const QueryPlan&);
+
+  // compiled query and plan of given key compiled against given table, nullptr if absent
+  std::pair<std::shared_ptr<nebula::api::dsl::Query>, nebula::execution::PlanPtr> get(
+    const std::string&, const nebula::meta::TablePtr&);
+
+  // cache compiled query and plan of given key
+  void put(const std::string&,
+           const nebula::meta::TablePtr&,
+           std::shared_ptr<nebula::api::dsl::Query>,
+           nebula::execution::PlanPtr);
+
+  inline size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+private:
+  struct Entry {
+    nebula::meta::TablePtr table;
+    std::shared_ptr<nebula::api::dsl::Query> query;
+    nebula::execution::PlanPtr plan;
+    std::list<std::string>::iterator lru;
+  };
+
+  void erase(nebula::common::unordered_map<std::string, Entry>::iterator);
+
+private:
+  // max number of cached plans
+  const size_t capacity_;
+
+  // keys in recently used order, most recent first
+  std::list<std::string> lru_;
+  nebula::common::unordered_map<std::string, Entry> entries_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace node
+} // namespace service
+} // namespace nebula
@@ -49,6 +49,10 @@ public:
     return std::make_unique<NodeClient>(node, pool, this->query_);
   }
 
+  virtual bool forwards() const override {
+    return true;
+  }
+
 private:
   std::shared_ptr<nebula::api::dsl::Query> query_;
 };
@@ -15,15 +15,24 @@
  */
 #include "TaskExecutor.h"
 
+#include <algorithm>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/executors/thread_factory/PriorityThreadFactory.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <thread>
 
 #include "execution/BlockManager.h"
 #include "ingest/BlockExpire.h"
 #include "ingest/IngestSpec.h"
 
-DEFINE_uint32(TASK_QUEUE_SIZE, 5000, "task queue size for bounded queue");
-DEFINE_int32(TASK_PRIORITY, -1, "0 is medium priority");
+DEFINE_uint32(TASK_QUEUE_SIZE, 5000, "max tasks waiting in a lane of the task executor");
+DEFINE_uint32(TASK_THREADS, 0, "number of threads to run ingestion tasks, 0 means a quarter of cores");
+DEFINE_uint32(TASK_EXPIRE_THREADS, 1, "number of threads to run expiration tasks");
+DEFINE_int32(TASK_NICE, 10, "nice value of task threads, higher value gives queries more CPU time");
+DEFINE_uint64(TASK_RECENT_SECONDS,
+              86400,
+              "specs of a table within this many seconds to its latest one are loaded before the table is ready");
 
 /**
  * Define node server that does the work as nebula server asks.
@@ -40,40 +49,44 @@ using nebula::execution::BlockManager;
 using nebula::ingest::BlockExpire;
 using nebula::ingest::IngestSpec;
 
+// a pool of task threads with lower OS priority, so they don't compete with queries
+static std::unique_ptr<folly::CPUThreadPoolExecutor> makePool(size_t threads, const std::string& name) {
+  return std::make_unique<folly::CPUThreadPoolExecutor>(
+    std::max<size_t>(1, threads),
+    std::make_shared<folly::PriorityThreadFactory>(
+      std::make_shared<folly::NamedThreadFactory>(name), FLAGS_TASK_NICE));
+}
+
+// states are sized for tasks of a few cycles, the map grows beyond that
+TaskExecutor::TaskExecutor(uint32_t size) : size_{ size }, state_{ size * 2 }, seq_{ 0 } {
+  const auto ingest = FLAGS_TASK_THREADS > 0 ? FLAGS_TASK_THREADS : std::thread::hardware_concurrency() / 4;
+  lane(TaskType::INGESTION).pool = makePool(ingest, "NodeIngest");
+  lane(TaskType::EXPIRATION).pool = makePool(FLAGS_TASK_EXPIRE_THREADS, "NodeExpire");
+  for (auto& l : lanes_) {
+    l.pending = 0;
+  }
+}
+
 TaskExecutor& TaskExecutor::singleton() {
   static TaskExecutor executor{ FLAGS_TASK_QUEUE_SIZE };
   return executor;
 }
 
-void TaskExecutor::process(std::function<void()> shutdown, folly::ThreadPoolExecutor& pool) {
-  // process all items in sequence
-  while (!queue_.isEmpty()) {
-    Task* task = queue_.frontPtr();
-
-    // mark this task state as processing
-    auto sign = task->signature();
-    state_[sign] = TaskState::PROCESSING;
-
-    // fast command execution
-    if (task->type() == TaskType::COMMAND) {
-      auto c = task->spec<SingleCommandTask>();
-      if (c->isShutdown()) {
-        if (shutdown) {
-          shutdown();
-        }
-      }
-    }
+void TaskExecutor::process(std::function<void()> shutdown) {
+  std::deque<Task> commands;
+  {
+    std::lock_guard<std::mutex> guard(commandLock_);
+    std::swap(commands, commands_);
+  }
 
-    // process this task in async way
-    // if the task failed, the task state may stay as "PROCESSING" forever.
-    pool.addWithPriority(
-      [this, s = std::move(sign), t = *task]() {
-        setState(t.type(), s, process(t) ? TaskState::SUCCEEDED : TaskState::FAILED);
-      },
-      FLAGS_TASK_PRIORITY);
+  // fast command execution
+  for (const auto& task : commands) {
+    auto c = task.spec<SingleCommandTask>();
+    if (c->isShutdown() && shutdown) {
+      shutdown();
+    }
 
-    // remove this task from queue
-    queue_.popFront();
+    setState(task.type(), task.signature(), TaskState::SUCCEEDED);
   }
 }
 
@@ -81,7 +94,7 @@ void TaskExecutor::process(std::function<void()> shutdown, folly::ThreadPoolExec
 TaskState TaskExecutor::execute(Task task) {
   // unique ID in the running system to avoid duplicate task
   const auto& sign = task.signature();
-  TaskState found = search(sign);
+  TaskState found = acquire(sign, TaskState::PROCESSING);
   if (found != TaskState::NOTFOUND) {
     // TODO(cao) - if a task failed once, it may never get retried.
     // state stored with a timestamp and use a timer to scan and change states
@@ -89,42 +102,122 @@ TaskState TaskExecutor::execute(Task task) {
   }
 
   // execute the task and record its state
-  setState(task.type(), sign, TaskState::PROCESSING);
   auto state = process(task) ? TaskState::SUCCEEDED : TaskState::FAILED;
   setState(task.type(), sign, state);
 
   return state;
 }
 
-// enqueue could be called by multiple session, need sync
+// enqueue could be called by multiple session, a task is taken by the session recording its state first
 TaskState TaskExecutor::enqueue(Task task) {
-  std::lock_guard<std::mutex> guard(stateLock_);
-
   // unique ID in the running system to avoid duplicate task
   const auto& sign = task.signature();
-  TaskState found = search(sign);
+  TaskState found = acquire(sign, TaskState::WAITING);
   if (found != TaskState::NOTFOUND) {
     VLOG(1) << "Task already in node, state=" << (char)found;
     return found;
   }
 
-  // if not found, we queue this task, and set its state as waiting
-  if (queue_.isFull()) {
-    VLOG(1) << "Queue is full, can not enqueue task at this moment. Q-size: " << queue_.capacity();
+  if (task.type() == TaskType::COMMAND) {
+    std::lock_guard<std::mutex> guard(commandLock_);
+    commands_.push_back(task);
+    return TaskState::WAITING;
+  }
+
+  // if not found, we queue this task in its lane as waiting
+  auto& l = lane(task.type());
+  if (l.pending.fetch_add(1) >= size_) {
+    --l.pending;
+    state_.erase(sign);
+    VLOG(1) << "Queue is full, can not enqueue task at this moment. Q-size: " << size_;
     return TaskState::QUEUE;
   }
 
-  // enqueue it for sure
-  if (!queue_.write(std::move(task))) {
-    LOG(ERROR) << "Failed to enqueue the task, unknown reason.";
-    return TaskState::FAILED;
+  // every ingestion run takes the most recent task waiting by then rather than the one added with it.
+  if (task.type() == TaskType::INGESTION) {
+    wait(std::move(task));
+    l.pool->add([this, &l]() {
+      const auto t = next();
+      run(t);
+      auto spec = t.spec<IngestSpec>();
+      loading(spec->table()->name, spec->watermark(), true);
+      --l.pending;
+    });
+
+    return TaskState::WAITING;
   }
 
-  // save its state
-  state_[sign] = TaskState::WAITING;
+  l.pool->add([this, &l, t = std::move(task)]() {
+    run(t);
+    --l.pending;
+  });
+
   return TaskState::WAITING;
 }
 
+// the task state may stay as "PROCESSING" forever if it fails unexpectedly.
+void TaskExecutor::run(const Task& task) {
+  const auto& s = task.signature();
+  setState(task.type(), s, TaskState::PROCESSING);
+  setState(task.type(), s, process(task) ? TaskState::SUCCEEDED : TaskState::FAILED);
+}
+
+void TaskExecutor::wait(Task task) {
+  auto spec = task.spec<IngestSpec>();
+  const auto watermark = spec->watermark();
+  loading(spec->table()->name, watermark, false);
+
+  std::lock_guard<std::mutex> guard(waitingLock_);
+  waiting_.push_back(Waiting{ watermark, seq_++, std::move(task) });
+  std::push_heap(waiting_.begin(), waiting_.end());
+}
+
+// every run is added along with a waiting task, so there is always one to take
+Task TaskExecutor::next() {
+  std::lock_guard<std::mutex> guard(waitingLock_);
+  std::pop_heap(waiting_.begin(), waiting_.end());
+  auto task = std::move(waiting_.back().task);
+  waiting_.pop_back();
+  return task;
+}
+
+void TaskExecutor::loading(const std::string& table, size_t watermark, bool done) {
+  std::lock_guard<std::mutex> guard(loadingLock_);
+  auto& l = loading_.try_emplace(table, Loading{ 0, 0, 0, {}, false }).first->second;
+  if (!done) {
+    ++l.specs;
+    l.newest = std::max(l.newest, watermark);
+    l.pending.insert(watermark);
+    return;
+  }
+
+  ++l.loaded;
+  auto found = l.pending.find(watermark);
+  if (found != l.pending.end()) {
+    l.pending.erase(found);
+  }
+
+  // specs without watermark, such as kafka segments, are all recent
+  const auto recent = l.newest > FLAGS_TASK_RECENT_SECONDS ? l.newest - FLAGS_TASK_RECENT_SECONDS : 0;
+  if (l.pending.empty() || *l.pending.rbegin() < recent) {
+    if (!l.ready) {
+      LOG(INFO) << "Table " << table << " is ready with " << l.loaded << " of " << l.specs << " specs loaded";
+    }
+
+    l.ready = true;
+  }
+}
+
+nebula::common::unordered_map<std::string, nebula::meta::TableReadiness> TaskExecutor::readiness() const {
+  nebula::common::unordered_map<std::string, nebula::meta::TableReadiness> tables;
+  std::lock_guard<std::mutex> guard(loadingLock_);
+  for (const auto& [table, l] : loading_) {
+    tables.emplace(table, nebula::meta::TableReadiness{ l.specs, l.loaded, l.ready });
+  }
+
+  return tables;
+}
+
 bool TaskExecutor::process(const Task& task) {
   // handle all different type of tasks assigned by server
   LOG(INFO) << "processed task: " << task.signature();
@@ -165,4 +258,4 @@ bool TaskExecutor::process(const Task& task) {
 
 } // namespace node
 } // namespace service
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
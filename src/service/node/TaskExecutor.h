@@ -13,16 +13,33 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+
 #pragma once
 
-#include <folly/ProducerConsumerQueue.h>
-#include <folly/executors/ThreadPoolExecutor.h>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <folly/concurrency/ConcurrentHashMap.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <vector>
 
 #include "common/Hash.h"
 #include "common/Task.h"
+#include "meta/NodeManager.h"
 
 /**
  * Define a task executor which maintains queues for task status query.
+ * Tasks run in lanes by their types, every lane has its own threads sharing one queue (multiple producers and
+ * consumers), so that many ingestion tasks run in parallel while an expiration task never waits behind them.
+ * Task states are kept in a concurrent map, so submissions, status polls and state updates of running tasks
+ * don't contend on one lock, and a task is deduplicated by inserting its state only if it's absent.
+ *
+ * Waiting ingestion tasks are taken by their recency rather than arrival, the spec of the latest data goes first,
+ * so that a booting node has fresh data of every table in first. Loading progress of every table is tracked,
+ * a table is ready in the node once its recent specs are loaded, and it stays ready.
  */
 namespace nebula {
 namespace service {
@@ -30,7 +47,7 @@ namespace node {
 
 class TaskExecutor {
 private:
-  TaskExecutor(uint32_t size) : queue_{ size } {};
+  TaskExecutor(uint32_t size);
   TaskExecutor(TaskExecutor&) = delete;
   TaskExecutor(TaskExecutor&&) = delete;
 
@@ -41,7 +58,8 @@ public:
   static TaskExecutor& singleton();
 
 public:
-  void process(std::function<void()>, folly::ThreadPoolExecutor&);
+  // run queued commands in current thread, shutdown is called for a shutdown command
+  void process(std::function<void()>);
 
   // put the task in async queue
   nebula::common::TaskState enqueue(nebula::common::Task);
@@ -49,9 +67,24 @@ public:
   // execute the task in current thread as in-sync
   nebula::common::TaskState execute(nebula::common::Task);
 
+  // number of async tasks of the type waiting or running
+  inline size_t pending(nebula::common::TaskType type) noexcept {
+    return lane(type).pending.load(std::memory_order_relaxed);
+  }
+
+  // loading progress of every table having ingestion tasks in this node since it started
+  nebula::common::unordered_map<std::string, nebula::meta::TableReadiness> readiness() const;
+
 private:
   bool process(const nebula::common::Task&);
 
+  // run an async task and record its states
+  void run(const nebula::common::Task&);
+
+  // queue an ingestion task by its recency, and take the most recent one waiting to run
+  void wait(nebula::common::Task);
+  nebula::common::Task next();
+
   inline void setState(nebula::common::TaskType type,
                        const std::string& sign,
                        nebula::common::TaskState state) noexcept {
@@ -61,36 +94,82 @@ private:
       return;
     }
 
-    std::lock_guard<std::mutex> guard(stateLock_);
-    state_[sign] = state;
+    state_.insert_or_assign(sign, state);
   }
 
-  nebula::common::TaskState search(const std::string& sign) const noexcept {
+  // record a new task in the state if it's not known yet, otherwise return its current state
+  inline nebula::common::TaskState acquire(const std::string& sign, nebula::common::TaskState state) {
     // unique ID in the running system to avoid duplicate task
-    auto itr = state_.find(sign);
+    auto result = state_.insert(sign, state);
 
     // found this task, it is already acked
-    if (itr != state_.end()) {
-      return itr->second;
+    if (!result.second) {
+      return result.first->second;
     }
 
     return nebula::common::TaskState::NOTFOUND;
   }
 
 private:
-  // TODO(cao): this is a quick shortcut implementation
-  // It uses two maps for fast lookup:
-  //    one is for tasks waiting for process
-  //    the other is for tasks already processed
-  // it has thread-safe issue and may require redesign soon.
-  // the task in process may still in pending_
-  // use folly::ProducerConsumerQueue<folly::fbstring> queue{size}; for processing
-  // use std::unordered_map<signature, state> for query (not cleared up)
-  folly::ProducerConsumerQueue<nebula::common::Task> queue_;
-  nebula::common::unordered_map<std::string, nebula::common::TaskState> state_;
-  std::mutex stateLock_;
+  // threads running tasks of one type and number of its tasks waiting or running
+  struct Lane {
+    std::unique_ptr<folly::CPUThreadPoolExecutor> pool;
+    std::atomic<size_t> pending;
+  };
+
+  // lanes of ingestion and expiration tasks
+  static constexpr size_t LANES = 2;
+  inline Lane& lane(nebula::common::TaskType type) noexcept {
+    return lanes_[type == nebula::common::TaskType::EXPIRATION];
+  }
+
+  // an ingestion task waiting for a thread, a later watermark runs first, then the one arriving first
+  struct Waiting {
+    size_t watermark;
+    size_t seq;
+    nebula::common::Task task;
+
+    inline bool operator<(const Waiting& other) const noexcept {
+      return watermark < other.watermark || (watermark == other.watermark && seq > other.seq);
+    }
+  };
+
+  // ingestion tasks of a table since the node started, watermarks of the ones not done yet
+  struct Loading {
+    size_t specs;
+    size_t loaded;
+    size_t newest;
+    std::multiset<size_t> pending;
+    bool ready;
+  };
+
+  // an ingestion task of the table is queued or done
+  void loading(const std::string&, size_t, bool);
+
+private:
+  // max tasks waiting in a lane
+  const size_t size_;
+
+  // commands are executed by the thread calling process
+  std::deque<nebula::common::Task> commands_;
+  std::mutex commandLock_;
+
+  // task signature -> state for query (not cleared up)
+  folly::ConcurrentHashMap<std::string, nebula::common::TaskState> state_;
+
+  // heap of waiting ingestion tasks
+  std::vector<Waiting> waiting_;
+  size_t seq_;
+  std::mutex waitingLock_;
+
+  // loading progress by table
+  nebula::common::unordered_map<std::string, Loading> loading_;
+  mutable std::mutex loadingLock_;
+
+  // declared last so that lane threads are joined before states are destroyed
+  std::array<Lane, LANES> lanes_;
 };
 
 } // namespace node
 } // namespace service
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
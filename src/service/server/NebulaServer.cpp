@@ -16,36 +16,47 @@
 
 #include "NebulaServer.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <fmt/format.h>
+#include <folly/ScopeGuard.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <grpcpp/grpcpp.h>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <rapidjson/document.h>
 #include <signal.h>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "NodeSync.h"
 #include "common/Chars.h"
 #include "common/Evidence.h"
 #include "common/Folly.h"
 #include "common/Format.h"
+#include "common/Metrics.h"
 #include "common/Params.h"
 #include "common/Spark.h"
 #include "common/TaskScheduler.h"
 #include "execution/BlockManager.h"
 #include "execution/meta/TableService.h"
+#include "ingest/IngestMetrics.h"
+#include "memory/ArrowBatch.h"
 #include "memory/Batch.h"
 #include "meta/ClusterInfo.h"
 #include "meta/NBlock.h"
 #include "meta/NNode.h"
 #include "meta/TableSpec.h"
 #include "nebula.grpc.pb.h"
+#include "service/base/MetricsEndpoint.h"
 #include "service/base/NebulaService.h"
 #include "service/node/ConnectionPool.h"
+#include "service/node/NodeClient.h"
 #include "service/node/RemoteNodeConnector.h"
 #include "storage/NFS.h"
 #include "storage/NFileSystem.h"
@@ -56,6 +67,19 @@ DEFINE_uint64(CLS_CONF_UPDATE_INTERVAL, 3000, "interval in milliseconds to updat
 DEFINE_uint64(NODE_SYNC_INTERVAL, 500, "interval in ms to conduct node sync");
 DEFINE_uint32(MAX_TABLES_RETURN, 500, "max tables to fetch to display");
 DEFINE_int32(MAX_MSG_SIZE, 67108864, "max message size sending between server and client, default to 64M");
+DEFINE_uint64(QUERY_CACHE_MB, 64, "memory in MB to cache query responses, 0 to disable the cache");
+DEFINE_bool(QUERY_FLIGHTS, true, "identical queries arriving while one of them is executing wait for its response");
+DEFINE_uint64(QUERY_FLIGHT_WAIT_MS, 30000, "max time in milliseconds to wait for an identical query in flight");
+DEFINE_uint64(RESULT_PAGES, 256, "max number of paginated query results held for their next pages");
+DEFINE_uint64(RESULT_PAGE_TTL_MS, 60000, "time in milliseconds to hold a paginated result for its next page");
+DEFINE_uint64(SLOW_QUERY_MS, 3000, "queries taking longer than this in milliseconds are recorded as slow queries");
+DEFINE_uint64(SLOW_QUERIES, 256, "max number of recent slow queries kept by server, 0 to disable");
+DEFINE_string(SLOW_QUERY_LOG, "", "file to append slow queries to as JSON lines, none if empty");
+DEFINE_string(QUERY_CAPTURE, "", "file to append incoming queries to as JSON lines for replay, none if empty");
+DEFINE_uint32(QUERY_QUEUES, 2, "completion queues of async query calls, each is polled by a dedicated thread");
+DEFINE_uint32(QUERY_REQUEST_THREADS, 64, "threads executing query calls, a call holds one until its response is built");
+DEFINE_uint32(NODE_SYNC_THREADS, 4, "threads syncing states of nodes in background");
+DEFINE_int32(METRICS_PORT, 9191, "port of the metrics endpoint of the server for Prometheus to scrape, 0 to disable");
 
 /**
  * A cursor template that help iterating a container.
@@ -79,9 +103,13 @@ using nebula::common::TaskState;
 using nebula::common::TaskType;
 using nebula::execution::BlockManager;
 using nebula::execution::QueryContext;
+using nebula::execution::core::ServerExecutor;
 using nebula::execution::io::BlockLoader;
 using nebula::execution::meta::TableService;
+using nebula::ingest::IngestMetrics;
 using nebula::ingest::IngestSpec;
+using nebula::ingest::Stage;
+using nebula::memory::ArrowBatch;
 using nebula::memory::Batch;
 using nebula::meta::BlockSignature;
 using nebula::meta::ClusterInfo;
@@ -104,6 +132,55 @@ using nebula::type::Schema;
 using nebula::type::TypeNode;
 using nebula::type::TypeSerializer;
 
+V1ServiceImpl::V1ServiceImpl()
+  : threadPool_{ std::thread::hardware_concurrency() },
+    requests_{ std::max<size_t>(1, FLAGS_QUERY_REQUEST_THREADS) },
+    syncPool_{ std::max<size_t>(1, FLAGS_NODE_SYNC_THREADS) },
+    cache_{ FLAGS_QUERY_CACHE_MB * 1024 * 1024 },
+    capture_{ FLAGS_QUERY_CAPTURE },
+    pages_{ FLAGS_RESULT_PAGES, std::chrono::milliseconds(FLAGS_RESULT_PAGE_TTL_MS) },
+    slow_{ FLAGS_SLOW_QUERIES, FLAGS_SLOW_QUERY_MS, FLAGS_SLOW_QUERY_LOG } {
+  nebula::common::Metrics::singleton().gauge(
+    "nebula_server_tasks_pending", "tasks of queries waiting in the server thread pool", [this]() {
+      return threadPool_.getPendingTaskCount();
+    });
+  nebula::common::Metrics::singleton().gauge(
+    "nebula_server_requests_pending", "query calls waiting for a thread of the request pool", [this]() {
+      return requests_.getPendingTaskCount();
+    });
+}
+
+// histogram of time of a query phase
+static nebula::common::Histogram& phase(const char* name) {
+  return nebula::common::Metrics::singleton().histogram(
+    "nebula_query_phase_ms", "time of query phases in milliseconds", fmt::format("{{phase=\"{0}\"}}", name));
+}
+
+// latency of a query served and its phases, times of node side phases are summed over all nodes
+static void observe(const nebula::execution::QueryStats& stats, size_t latencyMs) {
+  static auto& metrics = nebula::common::Metrics::singleton();
+  static auto& LATENCY = metrics.histogram("nebula_query_ms", "latency of queries served in milliseconds");
+  static auto& NODE_CALL = metrics.histogram("nebula_node_call_ms", "latency of query calls to nodes in milliseconds");
+  static auto& FILTER = phase("filter");
+  static auto& AGGREGATE = phase("aggregate");
+  static auto& NODE_MERGE = phase("node_merge");
+  static auto& SERDE = phase("serde");
+  static auto& SERVER_MERGE = phase("server_merge");
+  static auto& FINALIZE = phase("finalize");
+
+  LATENCY.observe(latencyMs);
+  const auto& profile = stats.profile;
+  FILTER.observe(profile.filterUs / 1000);
+  AGGREGATE.observe(profile.aggregateUs / 1000);
+  NODE_MERGE.observe(profile.nodeMergeUs / 1000);
+  SERDE.observe(profile.serdeUs / 1000);
+  SERVER_MERGE.observe(profile.serverMergeUs / 1000);
+  FINALIZE.observe(profile.finalizeUs / 1000);
+  for (const auto& node : profile.nodes) {
+    NODE_CALL.observe(node.callUs / 1000);
+  }
+}
+
 Status V1ServiceImpl::Tables(ServerContext*, const ListTables* request, TableList* reply) {
   auto bm = BlockManager::init();
   auto limit = request->limit();
@@ -149,8 +226,6 @@ Status V1ServiceImpl::State(ServerContext*, const TableStateRequest* request, Ta
   reply->set_mintime(window.first);
   reply->set_maxtime(window.second);
 
-  auto& h = metrics.hists();
-
   // TODO(cao) - need meta data system to query table info
   auto schema = table->schema();
   for (size_t i = 0, size = schema->size(); i < size; ++i) {
@@ -163,9 +238,59 @@ Status V1ServiceImpl::State(ServerContext*, const TableStateRequest* request, Ta
       reply->add_metric(column->name());
     }
 
-    // send all colummn histograms
-    // bm->hist(tbl, i) = h.at(i)
-    reply->add_hists(h.at(i)->toString());
+    // send all colummn histograms, a column not in any block yet has an empty one
+    auto hist = metrics.hist(column->name());
+    reply->add_hists(hist ? hist->toString() : nebula::surface::eval::Histogram().toString());
+  }
+
+  // ingest metrics of the table reported by nodes
+  const auto summary = IngestMetrics::singleton().summary(table->name());
+  auto ingest = reply->mutable_ingest();
+  ingest->set_specs(summary.specs);
+  ingest->set_running(summary.running);
+  ingest->set_rows(summary.rows);
+  ingest->set_bytes(summary.bytes);
+  ingest->set_errors(summary.errors);
+  ingest->set_lag(summary.lag);
+  ingest->set_throttles(summary.throttles);
+  ingest->set_rowspersecond(summary.rowsPerSecond());
+  ingest->set_bytespersecond(summary.bytesPerSecond());
+  ingest->set_fetchms(summary.stages[static_cast<size_t>(Stage::FETCH)]);
+  ingest->set_parsems(summary.stages[static_cast<size_t>(Stage::PARSE)]);
+  ingest->set_buildms(summary.stages[static_cast<size_t>(Stage::BUILD)]);
+
+  // loading progress of the table in nodes
+  size_t specs = 0;
+  size_t loaded = 0;
+  bool ready = true;
+  for (const auto& [node, r] : ClusterInfo::singleton().readiness(table->name())) {
+    specs += r.specs;
+    loaded += r.loaded;
+    ready = ready && r.ready;
+  }
+  ingest->set_readypercent(nebula::meta::TableReadiness{ specs, loaded, ready }.percent());
+  ingest->set_ready(ready);
+
+  // memory of the table in all nodes, columns are in schema order
+  const auto& memory = metrics.memory();
+  auto ms = reply->mutable_memory();
+  for (size_t i = 0, size = std::min(memory.columns.size(), schema->size()); i < size; ++i) {
+    const auto& c = memory.columns.at(i);
+    auto column = ms->add_columns();
+    column->set_column(schema->childType(i)->name());
+    column->set_data(c.data);
+    column->set_nulls(c.nulls);
+    column->set_offsets(c.offsets);
+    column->set_dict(c.dict);
+    column->set_bloom(c.bloom);
+    column->set_histogram(c.histogram);
+  }
+
+  ms->set_bess(memory.bess);
+  for (const auto& node : ClusterInfo::singleton().nodes()) {
+    const auto stats = ClusterInfo::singleton().nodeStats(node);
+    ms->set_querybytes(ms->querybytes() + stats.queryBytes);
+    ms->set_poolcached(ms->poolcached() + stats.poolCached);
   }
 
   LOG(INFO) << "Served table stats request for " << request->table();
@@ -198,6 +323,31 @@ Status V1ServiceImpl::Nuclear(ServerContext* ctx, const EchoRequest* req, EchoRe
   return Status::CANCELLED;
 }
 
+Status V1ServiceImpl::Profile(ServerContext*, const ProfileRequest* req, ProfileResponse* reply) {
+  auto nodes = ClusterInfo::singleton().nodes();
+  auto node = nodes.begin();
+  if (!req->node().empty()) {
+    node = std::find_if(nodes.begin(), nodes.end(), [&req](const NNode& n) { return n.toString() == req->node(); });
+  }
+
+  if (node == nodes.end()) {
+    return Status(StatusCode::NOT_FOUND, fmt::format("node not found: {0}", req->node()));
+  }
+
+  LOG(INFO) << "Profile node " << node->toString() << " for " << req->seconds() << " seconds, table=" << req->table();
+  nebula::service::node::NodeClient client(*node, threadPool_, nullptr);
+  std::string message;
+  reply->set_node(node->toString());
+  reply->set_data(client.profile(req->seconds(), req->table(), message));
+  reply->set_message(message);
+  return Status::OK;
+}
+
+Status V1ServiceImpl::SlowQueries(ServerContext*, const SlowQueryRequest* req, SlowQueryList* reply) {
+  *reply = slow_.list(req->table(), req->limit());
+  return Status::OK;
+}
+
 std::unique_ptr<QueryContext> buildQueryContext(ServerContext* ctx) {
   // build query context
   const auto& metadata = ctx->client_metadata();
@@ -278,27 +428,353 @@ Status V1ServiceImpl::Load(ServerContext* ctx, const LoadRequest* req, LoadRespo
   return Status::OK;
 }
 
-Status V1ServiceImpl::Query(ServerContext* ctx, const QueryRequest* request, QueryResponse* reply) {
+// serialize query result in the format asked by the request
+static void serialize(const QueryRequest& request, RowCursorPtr result, const Schema& schema, QueryResponse* reply) {
+  // client can ask for Arrow IPC stream to read result natively, JSON otherwise
+  if (request.format() == DataType::ARROW) {
+    reply->set_type(DataType::ARROW);
+    reply->set_data(ArrowBatch::ipc(ArrowBatch::schema(schema), { ArrowBatch::from(*result, schema) }));
+  } else {
+    reply->set_type(DataType::JSON);
+    reply->set_data(ServiceProperties::jsonify(result, schema));
+  }
+}
+
+// a tag of an operation on the completion queue, proceed is called when the operation completes
+class CallTag {
+public:
+  virtual ~CallTag() = default;
+  virtual void proceed(bool) = 0;
+};
+
+// an async query call lives from the time it's requested until it's finished, similar to query calls of nodes.
+// it's executed in the request pool, so threads polling the queues only dispatch calls and send responses.
+// a started call gets two tags back: its own one when its response is sent, and done when the call is over,
+// which tells if its client has cancelled it too. The call is deleted when both are back.
+class QueryCall : public CallTag {
+  class Done final : public CallTag {
+  public:
+    explicit Done(QueryCall& call) : call_{ call } {}
+    virtual ~Done() = default;
+
+    virtual void proceed(bool) override {
+      call_.done();
+    }
+
+  private:
+    QueryCall& call_;
+  };
+
+public:
+  QueryCall(V1ServiceImpl& service, grpc::ServerCompletionQueue* queue)
+    : service_{ service }, queue_{ queue }, done_{ *this }, started_{ false }, cancelled_{ false }, pending_{ 2 } {
+    context_.AsyncNotifyWhenDone(static_cast<CallTag*>(&done_));
+  }
+  virtual ~QueryCall() = default;
+
+  virtual void proceed(bool ok) override {
+    if (!started_) {
+      // the queue is shut down, a call never started gets no done tag
+      if (!ok) {
+        delete this;
+        return;
+      }
+
+      // the next call is accepted before this one is served
+      started_ = true;
+      renew();
+      service_.requests().add([this]() { run(); });
+      return;
+    }
+
+    sent(ok);
+  }
+
+protected:
+  inline void* tag() noexcept {
+    return static_cast<CallTag*>(this);
+  }
+
+  // request a new call of the same endpoint
+  virtual void renew() = 0;
+
+  // execute the query and send its response
+  virtual void run() = 0;
+
+  // an operation sending the response is complete
+  virtual void sent(bool) = 0;
+
+  Status execute(const V1ServiceImpl::Partial& partial) {
+    try {
+      // cancellation is known once the call is done, it's not safe to ask the context before that
+      return service_.execute(&context_, &request_, &reply_, partial, [this]() { return cancelled_.load(); });
+    } catch (const std::exception& exp) {
+      LOG(ERROR) << "[Query] failed: " << exp.what();
+      return Status(StatusCode::INTERNAL, exp.what());
+    }
+  }
+
+  // one of the two tags of a started call is back
+  inline void release() {
+    if (--pending_ == 0) {
+      delete this;
+    }
+  }
+
+private:
+  void done() {
+    cancelled_ = context_.IsCancelled();
+    release();
+  }
+
+protected:
+  V1ServiceImpl& service_;
+  grpc::ServerCompletionQueue* queue_;
+  grpc::ServerContext context_;
+  QueryRequest request_;
+  QueryResponse reply_;
+
+private:
+  Done done_;
+  bool started_;
+  std::atomic<bool> cancelled_;
+  std::atomic<int> pending_;
+};
+
+class UnaryCall final : public QueryCall {
+public:
+  UnaryCall(V1ServiceImpl& service, grpc::ServerCompletionQueue* queue)
+    : QueryCall(service, queue), responder_{ &context_ } {
+    service_.RequestQuery(&context_, &request_, &responder_, queue_, queue_, tag());
+  }
+
+private:
+  virtual void renew() override {
+    new UnaryCall(service_, queue_);
+  }
+
+  virtual void run() override {
+    auto status = execute({});
+    if (status.ok()) {
+      responder_.Finish(reply_, status, tag());
+      return;
+    }
+
+    responder_.FinishWithError(status, tag());
+  }
+
+  virtual void sent(bool) override {
+    release();
+  }
+
+private:
+  grpc::ServerAsyncResponseWriter<QueryResponse> responder_;
+};
+
+// early results are written as nodes respond, the final response follows them the same as Query's.
+// one message is written at a time, an early result waiting for the write before it is replaced by a later one
+// since the later one refines it.
+class StreamCall final : public QueryCall {
+public:
+  StreamCall(V1ServiceImpl& service, grpc::ServerCompletionQueue* queue)
+    : QueryCall(service, queue),
+      writer_{ &context_ },
+      writing_{ false },
+      final_{ false },
+      finishing_{ false },
+      broken_{ false } {
+    service_.RequestQueryStream(&context_, &request_, &writer_, queue_, queue_, tag());
+  }
+
+private:
+  virtual void renew() override {
+    new StreamCall(service_, queue_);
+  }
+
+  virtual void run() override {
+    auto status = execute([this](const QueryResponse& partial) { write(partial); });
+    std::lock_guard<std::mutex> lock(lock_);
+    status_ = status;
+    final_ = true;
+    next_.reset();
+    if (!writing_) {
+      finish();
+    }
+  }
+
+  virtual void sent(bool ok) override {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (finishing_) {
+      lock.unlock();
+      release();
+      return;
+    }
+
+    // a failed write means the client has gone, the rest is not written but the call is still finished
+    if (ok && next_) {
+      message_ = std::move(*next_);
+      next_.reset();
+      writer_.Write(message_, tag());
+      return;
+    }
+
+    writing_ = false;
+    broken_ = !ok;
+    if (final_) {
+      finish();
+    }
+  }
+
+  // write an early result now, or after the write in progress
+  void write(const QueryResponse& partial) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (final_ || broken_) {
+      return;
+    }
+
+    if (writing_) {
+      next_ = partial;
+      return;
+    }
+
+    writing_ = true;
+    message_ = partial;
+    writer_.Write(message_, tag());
+  }
+
+  // send the final response with the call status, it's called with the lock held
+  void finish() {
+    finishing_ = true;
+    if (status_.ok() && !broken_) {
+      writer_.WriteAndFinish(reply_, grpc::WriteOptions(), status_, tag());
+      return;
+    }
+
+    writer_.Finish(status_, tag());
+  }
+
+private:
+  grpc::ServerAsyncWriter<QueryResponse> writer_;
+  std::mutex lock_;
+  QueryResponse message_;
+  std::optional<QueryResponse> next_;
+  Status status_;
+  bool writing_;
+  bool final_;
+  bool finishing_;
+  bool broken_;
+};
+
+void V1ServiceImpl::accept(grpc::ServerCompletionQueue* queue) {
+  new UnaryCall(*this, queue);
+  new StreamCall(*this, queue);
+}
+
+void V1ServiceImpl::serve(grpc::ServerCompletionQueue* queue) {
+  void* tag = nullptr;
+  bool ok = false;
+  while (queue->Next(&tag, &ok)) {
+    static_cast<CallTag*>(tag)->proceed(ok);
+  }
+}
+
+Status V1ServiceImpl::execute(ServerContext* ctx,
+                              const QueryRequest* request,
+                              QueryResponse* reply,
+                              const Partial& partial,
+                              Cancelled cancelled) {
   // validate the query request and build the call
   Evidence::Duration tick;
   ErrorCode error = ErrorCode::NONE;
 
+  // next page of a result held by the server
+  if (!request->cursor().empty()) {
+    ResultPages::Result held;
+    if (!pages_.take(request->cursor(), held)) {
+      return replyError(ErrorCode::CURSOR_EXPIRED, reply, 0);
+    }
+
+    if (held.user != buildQueryContext(ctx)->user()) {
+      pages_.put(request->cursor(), std::move(held));
+      return replyError(ErrorCode::PERMISSION_REQUIRED, reply, 0);
+    }
+
+    page(*request, std::move(held), reply);
+    LOG(INFO) << "[Query] page of: " << request->cursor() << ", ttime=" << tick.elapsedMs();
+    return Status::OK;
+  }
+
   const auto tableName = request->table();
   // get the table registry and activate it by recording latest used time
   // so whenever a data set is queried, its expire time will be extended.
   auto tr = TableService::singleton()->query(tableName);
   tr.activate();
 
+  // get query context
+  auto context = buildQueryContext(ctx);
+  const auto user = context->user();
+  capture_.capture(*request, user);
+
+  // the same request on the same table data gets the same response
+  // data version is taken before execution, so data changed during execution invalidates the result
+  const auto cacheKey = QueryCache::key(*request, user);
+  const auto version = BlockManager::init()->version(tableName);
+  if (FLAGS_QUERY_CACHE_MB > 0 && cache_.get(cacheKey, version, *reply)) {
+    const auto durationMs = tick.elapsedMs();
+    auto stats = reply->mutable_stats();
+    stats->set_querytimems(durationMs);
+    stats->set_cached(true);
+    LOG(INFO) << "[Query] id=" << handler_.meta()->incrementQueryServed()
+              << ", table=" << tableName
+              << ", user=" << user
+              << ", latency=" << durationMs
+              << ", cached=true";
+    return Status::OK;
+  }
+
+  // an identical query in flight gets the response for this one, so a stampede of a dashboard executes once.
+  // the waiting query executes itself if the response can't be shared or it doesn't come in time
+  const auto flightKey = fmt::format("{0}@{1}", cacheKey, version);
+  auto flight = FLAGS_QUERY_FLIGHTS ? flights_.join(flightKey) : std::nullopt;
+  const auto leader = FLAGS_QUERY_FLIGHTS && !flight;
+  if (flight) {
+    auto wait = std::chrono::milliseconds(FLAGS_QUERY_FLIGHT_WAIT_MS);
+    const auto deadline = ctx->deadline();
+    if (deadline != std::chrono::system_clock::time_point::max()) {
+      wait = std::min(wait,
+                      std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::system_clock::now()));
+    }
+
+    flight->wait(wait);
+    if (flight->isReady() && flight->hasValue() && flight->value()) {
+      *reply = *flight->value();
+      const auto durationMs = tick.elapsedMs();
+      auto stats = reply->mutable_stats();
+      stats->set_querytimems(durationMs);
+      stats->set_cached(true);
+      LOG(INFO) << "[Query] id=" << handler_.meta()->incrementQueryServed()
+                << ", table=" << tableName
+                << ", user=" << user
+                << ", latency=" << durationMs
+                << ", shared=true";
+      return Status::OK;
+    }
+  }
+
+  // the leader always lands its flight, with no response if it doesn't reply one to share
+  QueryFlights::Reply shared;
+  auto land = folly::makeGuard([this, leader, &flightKey, &shared]() {
+    if (leader) {
+      flights_.land(flightKey, std::move(shared));
+    }
+  });
+
   // build the query
   auto query = handler_.build(*tr.table(), *request, error);
   if (error != ErrorCode::NONE) {
     return replyError(error, reply, 0);
   }
 
-  // get query context
-  auto context = buildQueryContext(ctx);
-  const auto user = context->user();
-
   // compile query into a query plan
   auto plan = handler_.compile(
     query, { request->start(), request->end() }, std::move(context), error);
@@ -306,10 +782,41 @@ Status V1ServiceImpl::Query(ServerContext* ctx, const QueryRequest* request, Que
     return replyError(error, reply, 0);
   }
 
+  // the query is cancelled when its client disconnects, and it never runs beyond the client's deadline
+  auto& cancel = *plan->ctx().cancellation();
+  cancel.watch(cancelled);
+  const auto deadline = ctx->deadline();
+  if (deadline != std::chrono::system_clock::time_point::max()) {
+    cancel.deadline(std::chrono::duration_cast<std::chrono::milliseconds>(deadline.time_since_epoch()).count());
+  }
+
+  // every early result carries stats of nodes responded so far, it is refined by later ones until the final
+  ServerExecutor::Progress progress;
+  if (partial) {
+    progress = [&tick, &plan, &partial, request](RowCursorPtr rows, size_t done, size_t total) {
+      QueryResponse early;
+      const auto& queryStats = plan->ctx().stats();
+      auto stats = early.mutable_stats();
+      stats->set_querytimems(tick.elapsedMs());
+      stats->set_rowsscanned(queryStats.rowsScan);
+      stats->set_blocksscanned(queryStats.blocksScan);
+      stats->set_nodesdone(done);
+      stats->set_nodestotal(total);
+      stats->set_progress(true);
+      serialize(*request, rows, plan->getOutputSchema(), &early);
+      partial(early);
+    };
+  }
+
   // create a remote connector and execute the query plan
   auto connector = std::make_shared<RemoteNodeConnector>(query);
-  RowCursorPtr result = handler_.query(threadPool_, plan, connector, error);
+  RowCursorPtr result = handler_.query(threadPool_, plan, connector, error, progress);
   const auto durationMs = tick.elapsedMs();
+  if (cancelled()) {
+    LOG(INFO) << "[Query] cancelled: table=" << tableName << ", user=" << user << ", latency=" << durationMs;
+    return Status::CANCELLED;
+  }
+
   if (error != ErrorCode::NONE) {
     return replyError(error, reply, durationMs);
   }
@@ -321,12 +828,67 @@ Status V1ServiceImpl::Query(ServerContext* ctx, const QueryRequest* request, Que
   stats->set_rowsscanned(queryStats.rowsScan);
   stats->set_blocksscanned(queryStats.blocksScan);
   stats->set_rowsreturn(queryStats.rowsRet);
+  if (queryStats.sampled()) {
+    stats->set_sample(1 / queryStats.scale());
+    stats->set_rowstotal(queryStats.rowsTotal);
+    stats->set_margin(queryStats.margin());
+  }
+  if (queryStats.partial()) {
+    stats->set_nodesfailed(queryStats.nodesFailed);
+    stats->set_nodestimeout(queryStats.nodesTimeout);
+    stats->set_partial(true);
+  }
+
+  // a node is not ready for the table until its recent specs are loaded, the result may miss fresh data
+  size_t loading = 0;
+  for (const auto& [node, r] : ClusterInfo::singleton().readiness(tableName)) {
+    loading += !r.ready;
+  }
+  if (loading > 0) {
+    stats->set_nodesloading(loading);
+    stats->set_partial(true);
+  }
+  const auto incomplete = stats->partial();
+
+  const auto& queryProfile = queryStats.profile;
+  auto profile = stats->mutable_profile();
+  profile->set_blocksprunedmeta(queryProfile.blocksPrunedMeta);
+  profile->set_blocksprunedpartition(queryProfile.blocksPrunedPartition);
+  profile->set_filterus(queryProfile.filterUs);
+  profile->set_aggregateus(queryProfile.aggregateUs);
+  profile->set_nodemergeus(queryProfile.nodeMergeUs);
+  profile->set_serdebytes(queryProfile.serdeBytes);
+  profile->set_serdeus(queryProfile.serdeUs);
+  profile->set_servermergeus(queryProfile.serverMergeUs);
+  profile->set_finalizeus(queryProfile.finalizeUs);
+  for (const auto& n : queryProfile.nodes) {
+    auto node = profile->add_nodes();
+    node->set_node(n.node);
+    node->set_callus(n.callUs);
+    node->set_bytes(n.bytes);
+  }
+  slow_.record(*request, user, durationMs, *stats);
+  observe(queryStats, durationMs);
   tick.reset();
 
-  // TODO(cao) - use JSON for now, this should come from message request
-  // User/client can specify what kind of format of result it expects
-  reply->set_type(DataType::JSON);
-  reply->set_data(ServiceProperties::jsonify(result, plan->getOutputSchema()));
+  // a result larger than a page is replied page by page
+  const auto pageSize = request->pagesize();
+  if (pageSize > 0 && result->size() > pageSize) {
+    page(*request, { plan, result, 0, *stats, user }, reply);
+  } else {
+    serialize(*request, result, plan->getOutputSchema(), reply);
+  }
+  // a partial result is not cached so that the query is retried with all nodes next time
+  // neither is a page since its cursor serves the rest of the result once
+  if (!incomplete && reply->cursor().empty()) {
+    if (FLAGS_QUERY_CACHE_MB > 0) {
+      cache_.put(cacheKey, version, *reply);
+    }
+
+    if (leader) {
+      shared = std::make_shared<QueryResponse>(*reply);
+    }
+  }
 
   // ttime: transfer time = result serialization time
   LOG(INFO) << "[Query] id=" << handler_.meta()->incrementQueryServed()
@@ -339,6 +901,21 @@ Status V1ServiceImpl::Query(ServerContext* ctx, const QueryRequest* request, Que
   return Status::OK;
 }
 
+void V1ServiceImpl::page(const QueryRequest& request, ResultPages::Result held, QueryResponse* reply) {
+  auto& rows = *held.rows;
+  const auto size = std::min<size_t>(request.pagesize(), rows.size() - held.served);
+  serialize(request, std::make_shared<PageCursor>(rows, held.served, size), held.plan->getOutputSchema(), reply);
+  *reply->mutable_stats() = held.stats;
+
+  // the cursor is the same query for all its pages
+  held.served += size;
+  if (held.served < rows.size()) {
+    const auto cursor = held.plan->id();
+    reply->set_cursor(cursor);
+    pages_.put(cursor, std::move(held));
+  }
+}
+
 Status V1ServiceImpl::replyError(ErrorCode code, QueryResponse* reply, size_t durationMs) const {
   N_ENSURE_NE(code, ErrorCode::NONE, "Error Reply Code Not 0");
 
@@ -441,14 +1018,38 @@ void RunServer() {
   // Listen on the given address without any authentication mechanism.
   builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
   // Register "service" as the instance through which we'll communicate with
-  // clients. In this case it corresponds to an *synchronous* service.
+  // clients. Queries are async calls served by completion queues, other endpoints are synchronous.
   builder.RegisterService(&v1Service);
   // set compression level as medium
   builder.SetDefaultCompressionLevel(GRPC_COMPRESS_LEVEL_MED);
+  // query calls are spread over a few queues, each is polled by a dedicated thread which never waits for a query
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> queues;
+  for (size_t i = 0, size = std::max<size_t>(1, FLAGS_QUERY_QUEUES); i < size; ++i) {
+    queues.push_back(builder.AddCompletionQueue());
+  }
+
   // Finally assemble the server.
   std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
   LOG(INFO) << "Nebula server listening on " << server_address;
 
+  std::vector<std::thread> pollers;
+  pollers.reserve(queues.size());
+  for (auto& queue : queues) {
+    v1Service.accept(queue.get());
+    pollers.emplace_back([q = queue.get()]() { nebula::service::server::V1ServiceImpl::serve(q); });
+  }
+
+  // metrics of the cluster as seen by server, nodes serve their own
+  auto& metrics = nebula::common::Metrics::singleton();
+  nebula::service::base::registerProcessMetrics();
+  metrics.gauge("nebula_cluster_blocks", "blocks in memory of all nodes", []() {
+    return nebula::execution::BlockManager::init()->numBlocks();
+  });
+  metrics.gauge("nebula_cluster_nodes", "nodes in the cluster", []() {
+    return nebula::meta::ClusterInfo::singleton().nodes().size();
+  });
+  nebula::service::base::MetricsEndpoint metricsEndpoint{ FLAGS_METRICS_PORT };
+
   // TODO (cao): start a thread to sync up with etcd setup for cluster info.
   // register cluster info, we're using two different time based scheduelr currently
   // one is NodeSync uses folly::FunctionScheduler and TaskScheduler is built on top of EventBase
@@ -525,6 +1126,10 @@ void RunServer() {
         }
       }
 
+      { // probe channels to nodes and reconnect broken ones before queries run into them
+        nebula::service::node::ConnectionPool::init()->probe();
+      }
+
       { // re-activate bad nodes by checking if they are back.
         // iterate all non-active nodes from node manager
         // ask connection pool to connect - if get valid channel, reactivate it
@@ -542,7 +1147,7 @@ void RunServer() {
   // node sync let it keep going using a unique spec repo per server
   // NOTE: our task scheduler schedule function run in sequence
   // interval is the time gap between any sequential two runs
-  auto& pool = v1Service.pool();
+  auto& pool = v1Service.syncPool();
   taskScheduler.setInterval(FLAGS_NODE_SYNC_INTERVAL, [&pool]() {
     nebula::service::server::NodeSync::sync(pool);
   });
@@ -555,6 +1160,15 @@ void RunServer() {
   // Wait for the server to shutdown. Note that some other thread must be
   // responsible for shutting down the server for this call to ever return.
   server->Wait();
+
+  // calls left in the queues are dropped
+  for (auto& queue : queues) {
+    queue->Shutdown();
+  }
+
+  for (auto& poller : pollers) {
+    poller.join();
+  }
 }
 
 int main(int argc, char** argv) {
@@ -19,7 +19,12 @@
 #include <grpcpp/grpcpp.h>
 
 #include "LoadHandler.h"
+#include "QueryCache.h"
+#include "QueryCapture.h"
+#include "QueryFlights.h"
 #include "QueryHandler.h"
+#include "ResultPages.h"
+#include "SlowQueryLog.h"
 #include "meta/TestTable.h"
 #include "nebula.grpc.pb.h"
 
@@ -31,34 +36,70 @@ namespace nebula {
 namespace service {
 namespace server {
 
-class V1ServiceImpl final : public V1::Service {
+// queries are served asynchronously by calls on completion queues, other endpoints are synchronous
+class V1ServiceImpl final : public V1::WithAsyncMethod_Query<V1::WithAsyncMethod_QueryStream<V1::Service>> {
   grpc::Status Tables(grpc::ServerContext*, const ListTables*, TableList*);
   grpc::Status State(grpc::ServerContext*, const TableStateRequest*, TableStateResponse*);
-  grpc::Status Query(grpc::ServerContext*, const QueryRequest*, QueryResponse*);
   grpc::Status Nuclear(grpc::ServerContext*, const EchoRequest*, EchoResponse*);
   grpc::Status Load(grpc::ServerContext*, const LoadRequest*, LoadResponse*);
   grpc::Status Url(grpc::ServerContext*, const UrlData*, UrlData*);
   grpc::Status Ping(grpc::ServerContext*, const ServiceInfo*, PingResponse*);
+  grpc::Status Profile(grpc::ServerContext*, const ProfileRequest*, ProfileResponse*);
+  grpc::Status SlowQueries(grpc::ServerContext*, const SlowQueryRequest*, SlowQueryList*);
 
   // query handler to handle all the queries
   QueryHandler handler_;
 
 public:
-  V1ServiceImpl() : threadPool_{ std::thread::hardware_concurrency() } {}
+  V1ServiceImpl();
   virtual ~V1ServiceImpl() = default;
 
   folly::ThreadPoolExecutor& pool() {
     return threadPool_;
   }
 
+  // query calls are executed by this pool, a call takes a thread until its response is built
+  folly::ThreadPoolExecutor& requests() {
+    return requests_;
+  }
+
+  // background node sync has its own pool so it never waits behind queries, nor they behind it
+  folly::ThreadPoolExecutor& syncPool() {
+    return syncPool_;
+  }
+
   void setShutdownHandler(std::function<void()>&& handler) {
     this->shutdownHandler_ = handler;
   }
 
+  // accept query calls from the queue, it is called once before the queue is served
+  void accept(grpc::ServerCompletionQueue*);
+
+  // serve calls of the queue until it is shut down, every queue is polled by a dedicated thread
+  static void serve(grpc::ServerCompletionQueue*);
+
+  // a response of early result of a running query
+  using Partial = std::function<void(const QueryResponse&)>;
+
+  // tell if the client of a query has gone
+  using Cancelled = std::function<bool()>;
+
+  // execute a query request, early results are given to partial if it is set
+  grpc::Status execute(grpc::ServerContext*, const QueryRequest*, QueryResponse*, const Partial&, Cancelled);
+
 private:
+  // reply the next page of a held result, the rest of it is held again if any
+  void page(const QueryRequest&, ResultPages::Result, QueryResponse*);
   grpc::Status replyError(nebula::service::base::ErrorCode, QueryResponse*, size_t) const;
   folly::CPUThreadPoolExecutor threadPool_;
+  folly::CPUThreadPoolExecutor requests_;
+  folly::CPUThreadPoolExecutor syncPool_;
   LoadHandler loadHandler_;
+  QueryCache cache_;
+  QueryCapture capture_;
+  QueryFlights flights_;
+  ResultPages pages_;
+  SlowQueryLog slow_;
   std::function<void()> shutdownHandler_;
 };
 
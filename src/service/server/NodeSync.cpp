@@ -56,10 +56,15 @@ void NodeSync::sync(folly::ThreadPoolExecutor& pool) noexcept {
 
   // assign all specs to available nodes, and reutrn number of tasks communicated
   auto tasksNodes = specRepo.assign(clientMaker);
-  if (tasksNodes.first > 0) {
+
+  // move specs off hot nodes, number of migrations started and completed
+  auto moves = specRepo.rebalance(clientMaker);
+  if (tasksNodes.first > 0 || moves.first > 0 || moves.second > 0) {
     LOG(INFO) << "Communicated tasks=" << tasksNodes.first
               << " expired=" << numExpired
               << " to nodes=" << tasksNodes.second
+              << " moving=" << moves.first
+              << " moved=" << moves.second
               << " using ms=" << duration.elapsedMs();
   }
 }
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "QueryCache.h"
+
+/**
+ * Implement the query response cache.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+std::string QueryCache::key(const QueryRequest& request, const std::string& user) {
+  // query request has no map field, so its serialization is deterministic for the same content
+  auto key = request.SerializeAsString();
+  key.append(user);
+  return key;
+}
+
+bool QueryCache::get(const std::string& key, size_t version, QueryResponse& reply) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = entries_.find(key);
+  if (found == entries_.end()) {
+    return false;
+  }
+
+  // data of the table changed since the response was cached
+  if (found->second.version != version) {
+    erase(found);
+    return false;
+  }
+
+  // move it to the most recent
+  lru_.splice(lru_.begin(), lru_, found->second.lru);
+  reply = found->second.reply;
+  return true;
+}
+
+void QueryCache::put(const std::string& key, size_t version, const QueryResponse& reply) {
+  const auto bytes = key.size() + reply.ByteSizeLong();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = entries_.find(key);
+  if (found != entries_.end()) {
+    erase(found);
+  }
+
+  // too large to cache
+  if (bytes > capacity_) {
+    return;
+  }
+
+  // evict least recently used ones to make room
+  while (bytes_ + bytes > capacity_) {
+    erase(entries_.find(lru_.back()));
+  }
+
+  lru_.push_front(key);
+  entries_.emplace(key, Entry{ version, reply, bytes, lru_.begin() });
+  bytes_ += bytes;
+}
+
+void QueryCache::erase(nebula::common::unordered_map<std::string, Entry>::iterator entry) {
+  bytes_ -= entry->second.bytes;
+  lru_.erase(entry->second.lru);
+  entries_.erase(entry);
+}
+
+} // namespace server
+} // namespace service
+} // namespace nebula
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+
+#include "common/Hash.h"
+#include "nebula.pb.h"
+
+/**
+ * Cache finalized query responses on the server.
+ * Dashboards keep sending the same query request, a response is valid as long as the queried table has the same data.
+ * An entry is keyed by the normalized request (its serialized bytes) together with the user since access rules
+ * may give different users different results. It is tagged by the table data version when the query starts,
+ * a lookup with a different version invalidates the entry. Entries are evicted in LRU order by total bytes.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+class QueryCache final {
+public:
+  explicit QueryCache(size_t capacity) : capacity_{ capacity }, bytes_{ 0 } {}
+  ~QueryCache() = default;
+
+public:
+  // normalized cache key of a query request made by given user
+  static std::string key(const QueryRequest&, const std::string&);
+
+  // fill reply by the cached response of given key if its data version matches
+  bool get(const std::string&, size_t, QueryResponse&);
+
+  // cache a response of given key and data version
+  void put(const std::string&, size_t, const QueryResponse&);
+
+  inline size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+  inline size_t bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+  }
+
+private:
+  struct Entry {
+    size_t version;
+    QueryResponse reply;
+    size_t bytes;
+    std::list<std::string>::iterator lru;
+  };
+
+  void erase(nebula::common::unordered_map<std::string, Entry>::iterator);
+
+private:
+  // max bytes of all cached responses
+  const size_t capacity_;
+  size_t bytes_;
+
+  // keys in recently used order, most recent first
+  std::list<std::string> lru_;
+  nebula::common::unordered_map<std::string, Entry> entries_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace server
+} // namespace service
+} // namespace nebula
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "QueryCapture.h"
+
+#include <chrono>
+#include <glog/logging.h>
+#include <google/protobuf/util/json_util.h>
+
+/**
+ * Implement the query capture.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+QueryCapture::QueryCapture(const std::string& file) {
+  if (!file.empty()) {
+    sink_.open(file, std::ios::out | std::ios::app);
+    if (!sink_.is_open()) {
+      LOG(ERROR) << "Failed to open query capture file: " << file;
+    } else {
+      LOG(INFO) << "Capturing queries to " << file;
+    }
+  }
+}
+
+void QueryCapture::capture(const QueryRequest& request, const std::string& user) {
+  if (!enabled()) {
+    return;
+  }
+
+  CapturedQuery query;
+  query.set_timems(std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count());
+  query.set_user(user);
+  *query.mutable_request() = request;
+
+  std::string json;
+  google::protobuf::util::MessageToJsonString(query, &json);
+
+  // lines of concurrent queries are not interleaved
+  std::lock_guard<std::mutex> lock(mutex_);
+  sink_ << json << '\n';
+  sink_.flush();
+}
+
+} // namespace server
+} // namespace service
+} // namespace nebula
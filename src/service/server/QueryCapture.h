@@ -0,0 +1,55 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <mutex>
+
+#include "nebula.pb.h"
+
+/**
+ * Capture incoming queries on the server to replay the real workload later, such as sizing new hardware
+ * or validating a release by NebulaReplay against it.
+ * Every query request is appended to the capture file as a JSON line of CapturedQuery along with
+ * its arrival time and user, pages of a held result are not queries and are not captured.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+class QueryCapture final {
+public:
+  // capture nothing if file is empty
+  explicit QueryCapture(const std::string& file);
+  ~QueryCapture() = default;
+
+public:
+  inline bool enabled() const noexcept {
+    return sink_.is_open();
+  }
+
+  // append a query request received now
+  void capture(const QueryRequest&, const std::string& user);
+
+private:
+  std::mutex mutex_;
+  std::ofstream sink_;
+};
+
+} // namespace server
+} // namespace service
+} // namespace nebula
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "QueryFlights.h"
+
+/**
+ * Implement single flight of identical queries.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+std::optional<folly::SemiFuture<QueryFlights::Reply>> QueryFlights::join(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = flights_.find(key);
+  if (found != flights_.end()) {
+    return found->second->getSemiFuture();
+  }
+
+  flights_.emplace(key, std::make_shared<folly::SharedPromise<Reply>>());
+  return std::nullopt;
+}
+
+void QueryFlights::land(const std::string& key, Reply reply) {
+  std::shared_ptr<folly::SharedPromise<Reply>> flight;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = flights_.find(key);
+    if (found == flights_.end()) {
+      return;
+    }
+
+    flight = std::move(found->second);
+    flights_.erase(found);
+  }
+
+  // followers are resumed out of the lock, a new identical query takes off a new flight by then
+  flight->setValue(std::move(reply));
+}
+
+} // namespace server
+} // namespace service
+} // namespace nebula
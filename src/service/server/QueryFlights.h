@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/futures/SharedPromise.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "common/Hash.h"
+#include "nebula.pb.h"
+
+/**
+ * Single flight of identical queries on the server.
+ * When many users open the same dashboard, identical query requests arrive within milliseconds of each other,
+ * they all miss the query cache before the first one completes. The first request of a key takes off a flight
+ * and executes the query, the identical ones arriving while it is in flight join it and wait for its reply
+ * rather than fanning out to all nodes again. A flight is keyed the same as the query cache plus the data version.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+class QueryFlights final {
+public:
+  // reply of a landed flight, null if it can't be shared, so that its followers execute the query themselves
+  using Reply = std::shared_ptr<const QueryResponse>;
+
+  QueryFlights() = default;
+  ~QueryFlights() = default;
+
+public:
+  // join the flight of given key in flight and get the future of its reply.
+  // none if there is no such flight, a new flight of the key is taken off and the caller leads it then.
+  std::optional<folly::SemiFuture<Reply>> join(const std::string&);
+
+  // the leader lands its flight with its reply, all followers joined it receive the reply
+  void land(const std::string&, Reply);
+
+  inline size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flights_.size();
+  }
+
+private:
+  nebula::common::unordered_map<std::string, std::shared_ptr<folly::SharedPromise<Reply>>> flights_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace server
+} // namespace service
+} // namespace nebula
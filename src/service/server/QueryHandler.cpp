@@ -19,14 +19,25 @@
 #include <folly/Conv.h>
 #include <gflags/gflags.h>
 
+#include "common/Evidence.h"
 #include "common/Zip.h"
 #include "execution/BlockManager.h"
 #include "execution/core/ServerExecutor.h"
+#include "execution/meta/TableService.h"
 #include "service/node/RemoteNodeConnector.h"
 
 DEFINE_uint32(AUTO_WINDOW_SIZE, 100, "maximum data point when selecting auto window");
 // TODO(cao): read setting from API call rather than env setting - filter most of value=1 frames
 DEFINE_uint64(TREE_PATH_MIN_SIZE, 3, "min size of tree merge path to return - should be passed from client.");
+DEFINE_uint64(TOPK_SIZE, 10, "number of most frequent values returned by top k rollup - should be passed from client.");
+DEFINE_bool(PARTIAL_RESULT,
+            true,
+            "Return results of the rest nodes when some nodes fail or time out, the result is flagged partial in stats."
+            "Otherwise the query fails with node failure.");
+DEFINE_bool(PRUNE_NODES,
+            true,
+            "Send a query only to nodes holding blocks which may match it by its time window and filter "
+            "evaluated on block histograms synced from nodes.");
 
 /**
  * Define some basic sharable proerpties for nebula service
@@ -44,10 +55,12 @@ using nebula::api::dsl::sum;
 using nebula::api::dsl::between;
 using nebula::api::dsl::ColumnExpression;
 using nebula::api::dsl::ConstExpression;
+using nebula::api::dsl::contains;
 using nebula::api::dsl::Expression;
 using nebula::api::dsl::in;
 using nebula::api::dsl::like;
 using nebula::api::dsl::LogicalExpression;
+using nebula::api::dsl::lookup;
 using nebula::api::dsl::nin;
 using nebula::api::dsl::Query;
 using nebula::api::dsl::reverse;
@@ -59,13 +72,17 @@ using nebula::common::Zip;
 using nebula::common::ZipFormat;
 using nebula::execution::BlockManager;
 using nebula::execution::Error;
+using nebula::execution::PhaseType;
 using nebula::execution::PlanPtr;
 using nebula::execution::QueryContext;
 using nebula::execution::QueryWindow;
+using nebula::execution::SpecSkips;
 using nebula::execution::core::NodeConnector;
 using nebula::execution::core::ServerExecutor;
+using nebula::execution::meta::TableService;
 using nebula::meta::NNode;
 using nebula::meta::Table;
+using nebula::meta::TableSpec;
 using nebula::service::Operation;
 using nebula::service::base::ErrorCode;
 using nebula::service::base::ServiceProperties;
@@ -130,15 +147,94 @@ PlanPtr QueryHandler::compile(
   return plan;
 }
 
+// route every replicated spec of the queried table to one of its copies on the nodes of the query,
+// the other copies skip it. Copies are picked by the query so that load of a hot table is spread over replicas.
+// blocks of a spec on a node taking it over or giving it up are always skipped.
+static SpecSkips route(const PlanPtr& plan) {
+  SpecSkips skips;
+  const auto& nodes = plan->getNodes();
+  const auto& registry = TableService::singleton()->query(TableSpec::base(plan->fetch<PhaseType::COMPUTE>().table()));
+  if (registry.empty()) {
+    return skips;
+  }
+
+  const auto seed = nebula::common::Hasher::hashString(plan->id());
+  for (const auto& spec : registry.all()) {
+    if (spec->migrating()) {
+      skips[spec->target().toString()].emplace(spec->id());
+    }
+
+    for (const auto& node : spec->retired()) {
+      skips[node.toString()].emplace(spec->id());
+    }
+
+    if (spec->replicas().empty()) {
+      continue;
+    }
+
+    std::vector<NNode> live;
+    for (const auto& copy : spec->copies()) {
+      if (std::any_of(nodes.begin(), nodes.end(), [&copy](const NNode& n) { return n.equals(copy); })) {
+        live.push_back(copy);
+      }
+    }
+
+    if (live.empty()) {
+      continue;
+    }
+
+    const auto serving = (seed + nebula::common::Hasher::hashString(spec->id())) % live.size();
+    for (size_t i = 0; i < live.size(); ++i) {
+      if (i != serving) {
+        skips[live.at(i).toString()].emplace(spec->id());
+      }
+    }
+  }
+
+  return skips;
+}
+
 RowCursorPtr QueryHandler::query(
   folly::ThreadPoolExecutor& pool,
   const PlanPtr plan,
   const std::shared_ptr<NodeConnector> connector,
-  ErrorCode& err) const noexcept {
+  ErrorCode& err,
+  const ServerExecutor::Progress& progress) const noexcept {
   // execute the query plan
   try {
+    // every replicated spec is scanned by one of its live copies only
+    plan->setSkips(route(plan));
+
+    // nodes whose blocks can't match the query are not called
+    if (FLAGS_PRUNE_NODES) {
+      const auto table = TableService::singleton()->query(plan->fetch<PhaseType::COMPUTE>().table()).table();
+      if (table) {
+        const auto all = plan->getNodes().size();
+        plan->setNodes(BlockManager::init()->nodes(*table, plan));
+        VLOG(1) << "Query " << plan->id() << " is sent to " << plan->getNodes().size() << " of " << all << " nodes";
+      }
+    }
+
     // create a node connector for this executor
-    return ServerExecutor(NNode::local().toString()).execute(pool, plan, connector);
+    auto result = ServerExecutor(NNode::local().toString()).execute(pool, plan, connector, progress);
+
+    // partial result of a query beyond memory limit is never returned
+    const auto& ctx = plan->ctx();
+    if (ctx.getError() == nebula::execution::Error::MEMORY_LIMIT || ctx.memory()->exceeded()) {
+      LOG(ERROR) << "Query exceeds memory limit: " << plan->id();
+      err = ErrorCode::MEMORY_LIMIT;
+      return EmptyRowCursor::instance();
+    }
+
+    // missing results of some nodes fail the query unless partial result is accepted
+    const auto& stats = plan->ctx().stats();
+    if (stats.partial() && !FLAGS_PARTIAL_RESULT) {
+      LOG(ERROR) << "Query misses results of some nodes: " << plan->id() << ", " << stats.toString();
+      err = ErrorCode::NODE_FAILURE;
+      return EmptyRowCursor::instance();
+    }
+
+    return result;
   } catch (const std::exception& exp) {
     LOG(ERROR) << "Error in executing query: " << exp.what();
     err = ErrorCode::FAIL_EXECUTE_QUERY;
@@ -167,9 +263,131 @@ std::shared_ptr<Query> QueryHandler::build(const Table& tb, const QueryRequest&
   }
 }
 
+// number of buckets and window size in seconds of a timeline query
+static std::pair<int64_t, int32_t> timeline(const QueryRequest& req) {
+  // we have minimum size of window as 1 second to be enforced
+  // so if buckets is smaller than range (seconds), we use each range as
+  auto range = req.end() - req.start();
+  N_ENSURE_GT(range, 0, "timeline requires end time greater than start time");
+
+  int32_t window = (int32_t)req.window();
+  int64_t buckets = window == 0 ? FLAGS_AUTO_WINDOW_SIZE : range / window;
+  if (buckets == 0 || buckets > range) {
+    buckets = range;
+  }
+
+  // recalculate window based on buckets
+  window = range / buckets;
+  N_ENSURE_GT(window, 0, "window should be at least 1 second");
+  return { buckets, window };
+}
+
+std::string QueryHandler::route(const QueryRequest& req) const noexcept {
+  if (req.custom_size() > 0) {
+    return {};
+  }
+
+  // a rollup table is only routed to when its rows cover whole time buckets of the query range
+  // and every column the query touches is one of its dimensions or metrics.
+  // rollups are retention tiers too, a query older than raw retention goes to a tier still keeping its range.
+  const auto& tables = nebula::meta::ClusterInfo::singleton().tables();
+  auto spec = std::find_if(tables.begin(), tables.end(), [&req](const auto& t) {
+    return t->name == req.table();
+  });
+  if (spec == tables.end() || (*spec)->rollups.empty()) {
+    return {};
+  }
+
+  // a tier covers the query if it keeps rows as old as the query start, 0 keeps rows until their spec is offline
+  const auto& table = **spec;
+  const auto now = (int64_t)nebula::common::Evidence::unix_timestamp();
+  auto covers = [&req, now](size_t seconds) {
+    return seconds == 0 || req.start() >= now - (int64_t)seconds;
+  };
+  const auto raw = covers(table.max_seconds);
+
+  // rank of an eligible rollup: covering the query, least dimensions which has least rows, coarser window
+  const nebula::meta::RollupSpec* best = nullptr;
+  std::tuple<bool, int64_t, size_t> bestRank;
+  for (const auto& rollup : table.rollups) {
+    const auto w = (int64_t)rollup.window;
+    if (req.start() % w != 0 || (req.end() + 1) % w != 0) {
+      continue;
+    }
+
+    if (req.timeline()) {
+      try {
+        auto tl = timeline(req);
+        if (tl.first > 1 && tl.second % w != 0) {
+          continue;
+        }
+      } catch (const std::exception&) {
+        return {};
+      }
+    }
+
+    auto isDimension = [&rollup](const std::string& c) {
+      return std::find(rollup.dimensions.begin(), rollup.dimensions.end(), c) != rollup.dimensions.end();
+    };
+
+    auto eligible = true;
+    for (auto i = 0, size = req.dimension_size(); i < size && eligible; ++i) {
+      eligible = isDimension(req.dimension(i));
+    }
+
+    for (auto i = 0, size = req.lookup_size(); i < size && eligible; ++i) {
+      eligible = isDimension(req.lookup(i).key());
+    }
+
+#define FILTER_ELIGIBLE(PREDS)                                                        \
+  for (auto i = 0, size = req.PREDS().expression_size(); i < size && eligible; ++i) { \
+    eligible = isDimension(req.PREDS().expression(i).column());                       \
+  }
+
+    FILTER_ELIGIBLE(filtera)
+    FILTER_ELIGIBLE(filtero)
+
+#undef FILTER_ELIGIBLE
+
+    for (auto i = 0, size = req.metric_size(); i < size && eligible; ++i) {
+      const auto& m = req.metric(i);
+      switch (m.method()) {
+      case Rollup::COUNT: break;
+      case Rollup::SUM:
+      case Rollup::MIN:
+      case Rollup::MAX: {
+        eligible = std::find(rollup.metrics.begin(), rollup.metrics.end(), m.column()) != rollup.metrics.end();
+        break;
+      }
+      default: eligible = false;
+      }
+    }
+
+    // raw rows answer a query out of the rollup retention completely
+    const auto covered = covers(table.retention(rollup));
+    if (!eligible || (!covered && raw)) {
+      continue;
+    }
+
+    const auto rank = std::make_tuple(covered, -(int64_t)rollup.dimensions.size(), rollup.window);
+    if (best == nullptr || rank > bestRank) {
+      best = &rollup;
+      bestRank = rank;
+    }
+  }
+
+  return best == nullptr ? std::string{} : nebula::meta::TableSpec::rollupName(req.table(), best->name);
+}
+
 std::shared_ptr<Query> QueryHandler::buildQuery(const Table& tb, const QueryRequest& req, ErrorCode& err) const {
+  // route to a pre-aggregated rollup table if there is one to answer the query
+  const auto rollup = route(req);
+  if (!rollup.empty()) {
+    VLOG(1) << "Route query of table " << req.table() << " to rollup " << rollup;
+  }
+
   // build filter
-  auto q = std::make_shared<Query>(req.table(), ms_);
+  auto q = std::make_shared<Query>(rollup.empty() ? req.table() : rollup, ms_);
   // table not found
   if (q->table_ == nullptr) {
     err = ErrorCode::TABLE_NOT_FOUND;
@@ -238,20 +456,7 @@ std::shared_ptr<Query> QueryHandler::buildQuery(const Table& tb, const QueryRequ
   if (isTimeline) {
     columns.push_back(Table::TIME_COLUMN);
 
-    // we have minimum size of window as 1 second to be enforced
-    // so if buckets is smaller than range (seconds), we use each range as
-    auto range = req.end() - req.start();
-    N_ENSURE_GT(range, 0, "timeline requires end time greater than start time");
-
-    int32_t window = (int32_t)req.window();
-    auto buckets = window == 0 ? FLAGS_AUTO_WINDOW_SIZE : range / window;
-    if (buckets == 0 || buckets > range) {
-      buckets = range;
-    }
-
-    // recalculate window based on buckets
-    window = range / buckets;
-    N_ENSURE_GT(window, 0, "window should be at least 1 second");
+    auto [buckets, window] = timeline(req);
 
     // only one bucket?
     std::shared_ptr<Expression> windowExpr = nullptr;
@@ -286,14 +491,29 @@ std::shared_ptr<Query> QueryHandler::buildQuery(const Table& tb, const QueryRequ
     keys.push_back(columns.size());
   }
 
+  // push looked up dimensions, the table is resolved here and shipped with the query
+  for (auto i = 0, size = req.lookup_size(); i < size; ++i) {
+    const auto& l = req.lookup(i);
+    columns.push_back(l.column());
+    auto expr = lookup(l.table(), col(l.key())).as(l.column());
+    fields.push_back(std::make_shared<decltype(expr)>(expr));
+    keys.push_back(columns.size());
+  }
+
+  std::vector<nebula::execution::Rolling> rollings;
   for (auto i = 0, size = req.metric_size(); i < size; ++i) {
     const auto& m = req.metric(i);
     // build metric may change column name, using its alais
     columns.push_back(m.column());
-    fields.push_back(buildMetric(m, tb));
+    fields.push_back(rollup.empty() ? buildMetric(m, tb, req.relativepct()) : buildRollupMetric(m));
+
+    // window functions run along time buckets of timeline only
+    if (isTimeline && m.rolling() != Rolling::RAW) {
+      rollings.push_back({ columns.size(), static_cast<nebula::execution::Rolling::Type>(m.rolling()), m.points() });
+    }
   }
 
-  q->select(fields).groupby(keys);
+  q->select(fields).groupby(keys).roll(std::move(rollings));
 
   // build sorting and limit/top property
   // TODO(cao): BUG investigation - turn on sort by 1 field on samples
@@ -326,10 +546,16 @@ std::shared_ptr<Query> QueryHandler::buildQuery(const Table& tb, const QueryRequ
     q->limit(limit);
   }
 
+  // approximate query on a sample of blocks
+  const auto sample = req.sample();
+  if (sample > 0 && sample < 1) {
+    q->sample(sample);
+  }
+
   return q;
 }
 
-std::shared_ptr<Expression> QueryHandler::buildMetric(const Metric& metric, const Table& table) const {
+std::shared_ptr<Expression> QueryHandler::buildMetric(const Metric& metric, const Table& table, bool relative) const {
   const auto& colName = metric.column();
 #define BUILD_METRIC_EXP(TYPE, NAME, ...)                                                  \
   auto exp = NAME(col(colName), ##__VA_ARGS__).as(fmt::format("{0}.{1}", colName, #TYPE)); \
@@ -346,25 +572,28 @@ std::shared_ptr<Expression> QueryHandler::buildMetric(const Metric& metric, cons
     BUILD_METRIC_CASE(COUNT, count)
     BUILD_METRIC_CASE(SUM, sum)
     BUILD_METRIC_CASE(AVG, avg)
-    BUILD_METRIC_CASE(P10, pct, 10)
-    BUILD_METRIC_CASE(P25, pct, 25)
-    BUILD_METRIC_CASE(P50, pct, 50)
-    BUILD_METRIC_CASE(P75, pct, 75)
-    BUILD_METRIC_CASE(P90, pct, 90)
-    BUILD_METRIC_CASE(P99, pct, 99)
-    BUILD_METRIC_CASE(P99_9, pct, 99.9)
-    BUILD_METRIC_CASE(P99_99, pct, 99.99)
+    BUILD_METRIC_CASE(P10, pct, 10, relative)
+    BUILD_METRIC_CASE(P25, pct, 25, relative)
+    BUILD_METRIC_CASE(P50, pct, 50, relative)
+    BUILD_METRIC_CASE(P75, pct, 75, relative)
+    BUILD_METRIC_CASE(P90, pct, 90, relative)
+    BUILD_METRIC_CASE(P99, pct, 99, relative)
+    BUILD_METRIC_CASE(P99_9, pct, 99.9, relative)
+    BUILD_METRIC_CASE(P99_99, pct, 99.99, relative)
     BUILD_METRIC_CASE(TREEMERGE, tpm, FLAGS_TREE_PATH_MIN_SIZE)
     BUILD_METRIC_CASE(CARD_EST, card, true)
+    BUILD_METRIC_CASE(CARD_EXACT, card, false)
+    BUILD_METRIC_CASE(TOPK, topk, FLAGS_TOPK_SIZE)
   case Rollup::HIST: {
     auto bm = BlockManager::init();
     auto schema = table.schema();
     Kind columnType = Kind::INVALID;
-    // check column type and index
-    auto index = schema->onChild(colName, [&columnType](const TypeNode& found) {
+    // check column type
+    schema->onChild(colName, [&columnType](const TypeNode& found) {
       columnType = found->k();
     });
-    auto histogram = bm->hist(table.name(), index);
+    auto histogram = bm->hist(table.name(), colName);
+    N_ENSURE_NOT_NULL(histogram, "no histogram of the column in any block");
     switch (columnType) {
     case nebula::type::Kind::TINYINT:
     case nebula::type::Kind::SMALLINT:
@@ -391,6 +620,28 @@ std::shared_ptr<Expression> QueryHandler::buildMetric(const Metric& metric, cons
 #undef BUILD_METRIC_EXP
 }
 
+std::shared_ptr<Expression> QueryHandler::buildRollupMetric(const Metric& metric) const {
+  using nebula::meta::RollupSpec;
+  const auto& colName = metric.column();
+#define BUILD_ROLLUP_CASE(TYPE, NAME, COLUMN)                                \
+  case Rollup::TYPE: {                                                       \
+    auto exp = NAME(col(COLUMN)).as(fmt::format("{0}.{1}", colName, #TYPE)); \
+    return std::make_shared<decltype(exp)>(exp);                             \
+  }
+
+  // count of rows is the sum of group row counts
+  switch (metric.method()) {
+    BUILD_ROLLUP_CASE(COUNT, sum, RollupSpec::COUNT)
+    BUILD_ROLLUP_CASE(SUM, sum, RollupSpec::sum(colName))
+    BUILD_ROLLUP_CASE(MIN, min, RollupSpec::min(colName))
+    BUILD_ROLLUP_CASE(MAX, max, RollupSpec::max(colName))
+  default:
+    throw NException("Rollup method not supported by rollup table.");
+  }
+
+#undef BUILD_ROLLUP_CASE
+}
+
 #define CHAIN_AND_RET                                  \
   if (prev != nullptr) {                               \
     if (op == LogicalOp::AND) {                        \
@@ -476,6 +727,41 @@ std::shared_ptr<Expression> QueryHandler::buildPredicate(
   // if specified multiple values for EQ and NEQ, they should convert to
   // IN and NOT IN expression isntead
   const auto pop = pred.op();
+
+  // an array column is matched by its elements, EQ selects lists having any element in the values
+  if (columnType == Kind::ARRAY) {
+    N_ENSURE(pop == Operation::EQ, "array column supports EQ predicate only");
+    Kind elementType = Kind::INVALID;
+    schema->onChild(columnName, [&elementType](const TypeNode& found) {
+      elementType = std::static_pointer_cast<nebula::type::ListType>(found)->childType(0)->k();
+    });
+
+#define BUILD_CONTAINS(KIND)                                           \
+  case Kind::KIND: {                                                   \
+    using ValueType = std::conditional<                                \
+      Kind::KIND == Kind::VARCHAR,                                     \
+      std::string,                                                     \
+      typename TypeTraits<Kind::KIND>::CppType>::type;                 \
+    auto exp = contains(columnExpression, vectorize<ValueType>(pred)); \
+    CHAIN_AND_RET                                                      \
+  }
+
+    switch (elementType) {
+      BUILD_CONTAINS(BOOLEAN)
+      BUILD_CONTAINS(TINYINT)
+      BUILD_CONTAINS(SMALLINT)
+      BUILD_CONTAINS(INTEGER)
+      BUILD_CONTAINS(BIGINT)
+      BUILD_CONTAINS(REAL)
+      BUILD_CONTAINS(DOUBLE)
+      BUILD_CONTAINS(VARCHAR)
+    default:
+      throw NException("Not supported element type in predicates");
+    }
+
+#undef BUILD_CONTAINS
+  }
+
   if (valueCount > 1) {
     // in expression
     if (pop == Operation::EQ || pop == Operation::NEQ) {
@@ -635,7 +921,7 @@ ErrorCode QueryHandler::validate(const QueryRequest& req) const noexcept {
   }
 
   // at least has more than 1 column (dimensions or metrics)
-  if (req.dimension_size() + req.metric_size() == 0) {
+  if (req.dimension_size() + req.lookup_size() + req.metric_size() == 0) {
     return ErrorCode::MISSING_OUTPUT_FIELDS;
   }
 
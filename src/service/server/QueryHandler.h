@@ -20,6 +20,7 @@
 #include "api/dsl/Expressions.h"
 #include "execution/ExecutionPlan.h"
 #include "execution/core/NodeConnector.h"
+#include "execution/core/ServerExecutor.h"
 #include "execution/meta/TableService.h"
 #include "meta/Table.h"
 #include "nebula.grpc.pb.h"
@@ -48,11 +49,13 @@ public:
     std::unique_ptr<nebula::execution::QueryContext>,
     nebula::service::base::ErrorCode&) const noexcept;
 
+  // execute the plan, early results are reported to progress if given
   nebula::surface::RowCursorPtr query(
     folly::ThreadPoolExecutor&,
     const nebula::execution::PlanPtr,
     const std::shared_ptr<nebula::execution::core::NodeConnector> connector,
-    nebula::service::base::ErrorCode&) const noexcept;
+    nebula::service::base::ErrorCode&,
+    const nebula::execution::core::ServerExecutor::Progress& = {}) const noexcept;
 
   inline std::shared_ptr<nebula::meta::MetaService> meta() const noexcept {
     return ms_;
@@ -73,7 +76,15 @@ private:
     const nebula::surface::eval::LogicalOp = nebula::surface::eval::LogicalOp::AND) const;
 
   // build metric into the query
-  std::shared_ptr<nebula::api::dsl::Expression> buildMetric(const Metric&, const nebula::meta::Table&) const;
+  std::shared_ptr<nebula::api::dsl::Expression> buildMetric(const Metric&,
+                                                            const nebula::meta::Table&,
+                                                            bool relative) const;
+
+  // build metric into a query against a rollup table, aliased the same as the raw metric
+  std::shared_ptr<nebula::api::dsl::Expression> buildRollupMetric(const Metric&) const;
+
+  // name of the rollup table able to answer the request, empty if none
+  std::string route(const QueryRequest&) const noexcept;
 
   // validate the query request
   nebula::service::base::ErrorCode validate(const QueryRequest&) const noexcept;
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ResultPages.h"
+
+/**
+ * Implement the store of paginated query results.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+void ResultPages::put(const std::string& cursor, Result result) {
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  expire(now);
+  auto found = entries_.find(cursor);
+  if (found != entries_.end()) {
+    erase(found);
+  }
+
+  if (capacity_ == 0) {
+    return;
+  }
+
+  // drop the oldest ones to make room
+  while (entries_.size() >= capacity_) {
+    erase(entries_.find(order_.front()));
+  }
+
+  order_.push_back(cursor);
+  entries_.emplace(cursor, Entry{ std::move(result), now + ttl_, std::prev(order_.end()) });
+}
+
+bool ResultPages::take(const std::string& cursor, Result& result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  expire(Clock::now());
+  auto found = entries_.find(cursor);
+  if (found == entries_.end()) {
+    return false;
+  }
+
+  result = std::move(found->second.result);
+  erase(found);
+  return true;
+}
+
+void ResultPages::expire(Clock::time_point now) {
+  while (!order_.empty()) {
+    auto first = entries_.find(order_.front());
+    if (first->second.expire > now) {
+      return;
+    }
+
+    erase(first);
+  }
+}
+
+void ResultPages::erase(nebula::common::unordered_map<std::string, Entry>::iterator entry) {
+  order_.erase(entry->second.order);
+  entries_.erase(entry);
+}
+
+} // namespace server
+} // namespace service
+} // namespace nebula
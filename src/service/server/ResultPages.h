@@ -0,0 +1,115 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <mutex>
+
+#include "common/Hash.h"
+#include "execution/ExecutionPlan.h"
+#include "nebula.pb.h"
+#include "surface/DataSurface.h"
+
+/**
+ * Hold results of paginated queries on the server for a short while.
+ * A query asking for pages is replied with its first page and a cursor, the rest of its result is kept
+ * under the cursor so that the client fetches the next page by it rather than receiving one huge payload.
+ * A result is taken out while a page of it is read, so one cursor is served by one request at a time.
+ * Results not fetched within the TTL expire, and the oldest ones are dropped beyond the capacity.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+// a view of the next given number of rows of a cursor which starts at given offset
+class PageCursor : public nebula::surface::RowCursor {
+public:
+  PageCursor(nebula::surface::RowCursor& inner, size_t offset, size_t rows)
+    : nebula::surface::RowCursor(rows), inner_{ inner }, offset_{ offset } {}
+  virtual ~PageCursor() = default;
+
+  virtual const nebula::surface::RowData& next() override {
+    ++index_;
+    return inner_.next();
+  }
+
+  virtual std::unique_ptr<nebula::surface::RowData> item(size_t index) const override {
+    return inner_.item(offset_ + index);
+  }
+
+private:
+  nebula::surface::RowCursor& inner_;
+  const size_t offset_;
+};
+
+class ResultPages final {
+public:
+  struct Result {
+    // the plan owns phases which its result rows are read through
+    nebula::execution::PlanPtr plan;
+    nebula::surface::RowCursorPtr rows;
+    // rows served in previous pages
+    size_t served;
+    // stats of the query replied with every page
+    Statistics stats;
+    // only the user making the query reads its pages
+    std::string user;
+  };
+
+public:
+  ResultPages(size_t capacity, std::chrono::milliseconds ttl) : capacity_{ capacity }, ttl_{ ttl } {}
+  ~ResultPages() = default;
+
+public:
+  // keep the rest of a result under given cursor
+  void put(const std::string&, Result);
+
+  // take the result out by its cursor, false if it is unknown or expired
+  bool take(const std::string&, Result&);
+
+  inline size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct Entry {
+    Result result;
+    Clock::time_point expire;
+    std::list<std::string>::iterator order;
+  };
+
+  // drop expired results, they are in the order of their expire time
+  void expire(Clock::time_point);
+  void erase(nebula::common::unordered_map<std::string, Entry>::iterator);
+
+private:
+  // max number of results held
+  const size_t capacity_;
+  const std::chrono::milliseconds ttl_;
+
+  // cursors in the order they are put, oldest first
+  std::list<std::string> order_;
+  nebula::common::unordered_map<std::string, Entry> entries_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace server
+} // namespace service
+} // namespace nebula
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SlowQueryLog.h"
+
+#include <chrono>
+#include <glog/logging.h>
+#include <google/protobuf/util/json_util.h>
+
+/**
+ * Implement the slow query log.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+SlowQueryLog::SlowQueryLog(size_t capacity, size_t thresholdMs, const std::string& sink)
+  : capacity_{ capacity }, thresholdMs_{ thresholdMs } {
+  if (!sink.empty()) {
+    sink_.open(sink, std::ios::out | std::ios::app);
+    if (!sink_.is_open()) {
+      LOG(ERROR) << "Failed to open slow query log: " << sink;
+    }
+  }
+}
+
+std::string SlowQueryLog::normalize(const QueryRequest& request) {
+  QueryRequest shape{ request };
+  shape.clear_start();
+  shape.clear_end();
+  shape.clear_format();
+  shape.clear_pagesize();
+  shape.clear_cursor();
+  return shape.ShortDebugString();
+}
+
+bool SlowQueryLog::record(const QueryRequest& request,
+                         const std::string& user,
+                         size_t latencyMs,
+                         const Statistics& stats) {
+  if (capacity_ == 0 || latencyMs < thresholdMs_) {
+    return false;
+  }
+
+  SlowQuery query;
+  query.set_table(request.table());
+  query.set_user(user);
+  query.set_plan(normalize(request));
+  query.set_signature(std::hash<std::string>()(query.plan()));
+  query.set_start(request.start());
+  query.set_end(request.end());
+  query.set_latencyms(latencyMs);
+  query.set_timems(std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count());
+  *query.mutable_stats() = stats;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.size() >= capacity_) {
+    auto found = repeats_.find(entries_.front().signature());
+    if (--found->second == 0) {
+      repeats_.erase(found);
+    }
+    entries_.pop_front();
+  }
+
+  const auto repeats = ++repeats_[query.signature()];
+  query.set_repeats(repeats);
+  LOG(WARNING) << "[SlowQuery] table=" << query.table()
+               << ", user=" << user
+               << ", latency=" << latencyMs
+               << ", blocks=" << stats.blocksscanned()
+               << ", signature=" << query.signature()
+               << ", repeats=" << repeats;
+
+  if (sink_.is_open()) {
+    std::string json;
+    google::protobuf::util::MessageToJsonString(query, &json);
+    sink_ << json << std::endl;
+  }
+
+  entries_.push_back(std::move(query));
+  return true;
+}
+
+SlowQueryList SlowQueryLog::list(const std::string& table, size_t limit) const {
+  SlowQueryList list;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+    if (limit > 0 && static_cast<size_t>(list.queries_size()) >= limit) {
+      break;
+    }
+
+    if (!table.empty() && it->table() != table) {
+      continue;
+    }
+
+    // repeats are of all entries in the buffer now
+    auto query = list.add_queries();
+    *query = *it;
+    query->set_repeats(repeats_.at(it->signature()));
+  }
+
+  return list;
+}
+
+} // namespace server
+} // namespace service
+} // namespace nebula
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <fstream>
+#include <mutex>
+
+#include "common/Hash.h"
+#include "nebula.pb.h"
+
+/**
+ * Keep recent slow queries on the server to find out which queries need rollups or indexes.
+ * A query slower than the threshold is recorded in a bounded ring buffer, the oldest one is dropped beyond capacity.
+ * Every entry has the normalized query (the request without time range and paging), so that repeats of the same
+ * query shape are counted by their signature, along with its time range, latency and stats of the query.
+ * Entries are also appended as JSON lines to an optional sink file which is tailed by alerting.
+ */
+namespace nebula {
+namespace service {
+namespace server {
+
+class SlowQueryLog final {
+public:
+  SlowQueryLog(size_t capacity, size_t thresholdMs, const std::string& sink);
+  ~SlowQueryLog() = default;
+
+public:
+  // normalized form of a query request, which is the same for the same query on different time ranges
+  static std::string normalize(const QueryRequest&);
+
+  // record a query if it is slow, return true if recorded
+  bool record(const QueryRequest&, const std::string& user, size_t latencyMs, const Statistics&);
+
+  // slow queries of given table (all tables if empty) latest first, up to limit (0 means all)
+  SlowQueryList list(const std::string& table, size_t limit) const;
+
+  inline size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+private:
+  const size_t capacity_;
+  const size_t thresholdMs_;
+  mutable std::mutex mutex_;
+  std::deque<SlowQuery> entries_;
+  // signature => number of entries in the buffer
+  nebula::common::unordered_map<uint64_t, size_t> repeats_;
+  std::ofstream sink_;
+};
+
+} // namespace server
+} // namespace service
+} // namespace nebula
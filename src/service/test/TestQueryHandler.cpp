@@ -24,13 +24,22 @@
 #include "execution/core/ServerExecutor.h"
 #include "execution/meta/TableService.h"
 #include "fmt/format.h"
+#include "memory/keyed/FlatBuffer.h"
 #include "meta/NBlock.h"
 #include "meta/TestTable.h"
 #include "service/base/NebulaService.h"
+#include "service/client/Replay.h"
+#include "service/node/PlanCache.h"
 #include "service/node/RemoteNodeConnector.h"
+#include "service/server/QueryCache.h"
+#include "service/server/QueryCapture.h"
+#include "service/server/QueryFlights.h"
 #include "service/server/QueryHandler.h"
+#include "service/server/ResultPages.h"
+#include "service/server/SlowQueryLog.h"
 #include "surface/DataSurface.h"
 #include "surface/MockSurface.h"
+#include "surface/StaticData.h"
 #include "type/Serde.h"
 
 namespace nebula {
@@ -50,6 +59,9 @@ using nebula::meta::TestTable;
 using nebula::service::base::ErrorCode;
 using nebula::service::base::QuerySerde;
 using nebula::service::base::ServiceProperties;
+using nebula::service::node::PlanCache;
+using nebula::service::server::QueryCache;
+using nebula::service::server::QueryFlights;
 using nebula::service::server::QueryHandler;
 using nebula::surface::RowCursorPtr;
 using nebula::surface::RowData;
@@ -309,6 +321,72 @@ TEST(ServiceTest, TestQuerySerde) {
   LOG(INFO) << "result is " << str1;
 }
 
+TEST(ServiceTest, TestQueryForwardSerde) {
+  auto ms = TableService::singleton();
+  nebula::meta::TestTable testTable;
+  auto query = table(testTable.name(), ms).select(col("event"), count(1).as("count")).groupby({ 1 });
+
+  // peers of an intermediate node and the top round travel with the query plan
+  using nebula::execution::TopRound;
+  std::vector<nebula::meta::NNode> peers{ { nebula::meta::NRole::NODE, "10.0.0.1", 9199 },
+                                          { nebula::meta::NRole::NODE, "node-2.nebula", 9200 } };
+  TopRound round{ TopRound::Step::KEYS, 0.5, { 7, 11 } };
+  auto ser = QuerySerde::serialize(query, "id", { 0, 10 }, 0, "", round, peers);
+  const auto& root = *ser.GetRoot();
+
+  auto nodes = QuerySerde::peers(root);
+  ASSERT_EQ(nodes.size(), 2);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    EXPECT_TRUE(nodes.at(i).equals(peers.at(i)));
+  }
+
+  auto r = QuerySerde::topRound(root);
+  EXPECT_EQ(r.step, TopRound::Step::KEYS);
+  EXPECT_EQ(r.threshold, 0.5);
+  EXPECT_EQ(r.keys.size(), 2);
+  EXPECT_EQ(r.keys.count(11), 1);
+
+  // a plan sent to a leaf node has neither
+  auto leaf = QuerySerde::serialize(query, "id", { 0, 10 });
+  EXPECT_EQ(QuerySerde::peers(*leaf.GetRoot()).size(), 0);
+  EXPECT_EQ(QuerySerde::topRound(*leaf.GetRoot()).step, TopRound::Step::NONE);
+}
+
+TEST(ServiceTest, TestQueryExpressionTrees) {
+  auto ms = TableService::singleton();
+  nebula::meta::TestTable testTable;
+
+  // a large IN list travels delta packed in expression trees, not as text
+  std::vector<int32_t> ids;
+  for (int32_t i = 0; i < 5000; ++i) {
+    ids.push_back(i * 3);
+  }
+
+  auto query = table(testTable.name(), ms)
+                 .where(in(col("id"), std::move(ids)) && nin(col("event"), std::vector<std::string>{ "a", "b" }))
+                 .select(col("event"), pct(col("value"), 90).as("p90"), count(1).as("count"))
+                 .groupby({ 1 });
+  auto ser = QuerySerde::serialize(query, "id", { 0, 10 });
+  const auto& root = *ser.GetRoot();
+  EXPECT_EQ(root.filter(), nullptr);
+  EXPECT_EQ(root.fields(), nullptr);
+  ASSERT_NE(root.exprs(), nullptr);
+  EXPECT_EQ(root.exprs_nested_root()->roots()->size(), 4);
+
+  // the same expressions are rebuilt from the trees
+  auto q = QuerySerde::deserialize(ms, &ser);
+  EXPECT_EQ(Serde::serialize(*q.filter_), Serde::serialize(*query.filter_));
+  ASSERT_EQ(q.selects_.size(), query.selects_.size());
+  for (size_t i = 0; i < q.selects_.size(); ++i) {
+    EXPECT_EQ(Serde::serialize(*q.selects_.at(i)), Serde::serialize(*query.selects_.at(i)));
+  }
+
+  // and compile to the same plan
+  auto plan = QuerySerde::from(q, 0, 10);
+  EXPECT_EQ(TypeSerializer::to(plan->getOutputSchema()),
+            TypeSerializer::to(query.compile(QueryContext::def())->getOutputSchema()));
+}
+
 TEST(ServiceTest, TestDataSerde) {
   // load test data to run this query
   auto data = nebula::api::test::genData();
@@ -356,6 +434,342 @@ TEST(ServiceTest, TestDataSerde) {
   LOG(INFO) << "result is " << str1;
 }
 
+TEST(ServiceTest, TestQueryCache) {
+  QueryRequest request;
+  request.set_table("x");
+  request.set_start(1);
+  request.set_end(2);
+  request.add_dimension("tag");
+
+  QueryResponse response;
+  response.set_data(std::string(100, 'a'));
+  response.mutable_stats()->set_rowsscanned(10);
+
+  QueryCache cache{ 1024 };
+  QueryResponse reply;
+  const auto key = QueryCache::key(request, "u1");
+  EXPECT_FALSE(cache.get(key, 1, reply));
+
+  cache.put(key, 1, response);
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_TRUE(cache.get(key, 1, reply));
+  EXPECT_EQ(reply.data(), response.data());
+  EXPECT_EQ(reply.stats().rowsscanned(), 10);
+
+  // the same request by another user or on a different request doesn't hit
+  EXPECT_FALSE(cache.get(QueryCache::key(request, "u2"), 1, reply));
+  request.set_end(3);
+  const auto key2 = QueryCache::key(request, "u1");
+  EXPECT_FALSE(cache.get(key2, 1, reply));
+
+  // a new data version invalidates the entry
+  EXPECT_FALSE(cache.get(key, 2, reply));
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.bytes(), 0);
+
+  // least recently used entries are evicted by capacity
+  for (auto i = 0; i < 20; ++i) {
+    request.set_top(i);
+    cache.put(QueryCache::key(request, "u1"), 1, response);
+  }
+
+  EXPECT_LE(cache.bytes(), 1024);
+  EXPECT_LT(cache.size(), 20);
+  EXPECT_TRUE(cache.get(QueryCache::key(request, "u1"), 1, reply));
+  request.set_top(0);
+  EXPECT_FALSE(cache.get(QueryCache::key(request, "u1"), 1, reply));
+}
+
+TEST(ServiceTest, TestQueryFlights) {
+  QueryFlights flights;
+
+  // the first query takes off, identical ones join its flight
+  EXPECT_FALSE(flights.join("q1"));
+  auto f1 = flights.join("q1");
+  auto f2 = flights.join("q1");
+  ASSERT_TRUE(f1 && f2);
+  EXPECT_FALSE(flights.join("q2"));
+  EXPECT_EQ(flights.size(), 2);
+  EXPECT_FALSE(f1->isReady());
+
+  // all followers get the reply of the leader
+  auto response = std::make_shared<QueryResponse>();
+  response->set_data("rows");
+  flights.land("q1", response);
+  EXPECT_EQ(flights.size(), 1);
+  EXPECT_EQ(std::move(*f1).get()->data(), "rows");
+  EXPECT_EQ(std::move(*f2).get()->data(), "rows");
+
+  // a landed flight is not joined, and a reply not to share lands as none
+  EXPECT_FALSE(flights.join("q1"));
+  auto f3 = flights.join("q2");
+  ASSERT_TRUE(f3);
+  flights.land("q2", nullptr);
+  EXPECT_EQ(std::move(*f3).get(), nullptr);
+}
+
+TEST(ServiceTest, TestPlanCache) {
+  auto ms = TableService::singleton();
+  nebula::meta::TestTable testTable;
+  auto query = table(testTable.name(), ms)
+                 .where(like(col("event"), "NN%"))
+                 .select(col("event"), count(1).as("count"))
+                 .groupby({ 1 })
+                 .limit(10);
+
+  // the same query in different windows shares a key, but not a different query
+  auto s1 = QuerySerde::serialize(query, "q1", { 0, 10 });
+  auto s2 = QuerySerde::serialize(query, "q2", { 20, 30 });
+  const auto key = PlanCache::key(*s1.GetRoot());
+  EXPECT_EQ(key, PlanCache::key(*s2.GetRoot()));
+
+  auto s3 = QuerySerde::serialize(query.limit(20), "q3", { 0, 10 });
+  EXPECT_NE(key, PlanCache::key(*s3.GetRoot()));
+
+  PlanCache cache{ 1 };
+  const auto tbl = ms->query(testTable.name()).table();
+  EXPECT_EQ(cache.get(key, tbl).second, nullptr);
+
+  auto q = std::make_shared<nebula::api::dsl::Query>(QuerySerde::deserialize(ms, &s1));
+  auto plan = QuerySerde::from(*q, 0, 10);
+  cache.put(key, tbl, q, plan);
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_EQ(cache.get(key, tbl).second, plan);
+
+  // a cached plan is bound to a new window by a fork
+  auto bound = QuerySerde::from(*plan, 20, 30);
+  EXPECT_NE(bound, plan);
+  EXPECT_EQ(TypeSerializer::to(bound->getOutputSchema()), TypeSerializer::to(plan->getOutputSchema()));
+
+  // a different table object invalidates the entry
+  EXPECT_EQ(cache.get(key, std::make_shared<nebula::meta::TestTable>()).second, nullptr);
+  EXPECT_EQ(cache.size(), 0);
+
+  // least recently used entries are evicted by capacity
+  cache.put(key, tbl, q, plan);
+  cache.put(PlanCache::key(*s3.GetRoot()), tbl, q, plan);
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_EQ(cache.get(key, tbl).second, nullptr);
+}
+
+TEST(ServiceTest, TestResultPages) {
+  using nebula::service::server::PageCursor;
+  using nebula::service::server::ResultPages;
+  auto rows = std::make_shared<nebula::surface::MockRowCursor>(10);
+
+  // a page reads the next rows of the result only
+  PageCursor page(*rows, 0, 4);
+  EXPECT_EQ(page.size(), 4);
+  while (page.hasNext()) {
+    page.next();
+  }
+  EXPECT_TRUE(rows->hasNext());
+
+  ResultPages pages{ 2, std::chrono::milliseconds(10000) };
+  ResultPages::Result held;
+  EXPECT_FALSE(pages.take("c1", held));
+  pages.put("c1", { nullptr, rows, 4, {}, "u1" });
+  EXPECT_EQ(pages.size(), 1);
+
+  // a result is taken out while its page is read
+  EXPECT_TRUE(pages.take("c1", held));
+  EXPECT_EQ(held.served, 4);
+  EXPECT_EQ(held.user, "u1");
+  EXPECT_EQ(held.rows, rows);
+  EXPECT_FALSE(pages.take("c1", held));
+
+  // the oldest result is dropped beyond capacity
+  pages.put("c1", held);
+  pages.put("c2", held);
+  pages.put("c3", held);
+  EXPECT_EQ(pages.size(), 2);
+  EXPECT_FALSE(pages.take("c1", held));
+  EXPECT_TRUE(pages.take("c3", held));
+
+  // results expire after the TTL
+  ResultPages expiring{ 2, std::chrono::milliseconds(0) };
+  expiring.put("c1", held);
+  EXPECT_FALSE(expiring.take("c1", held));
+}
+
+TEST(ServiceTest, TestSlowQueryLog) {
+  using nebula::service::server::SlowQueryLog;
+  SlowQueryLog log{ 3, 100, "" };
+
+  QueryRequest request;
+  request.set_table("t1");
+  request.add_dimension("event");
+  request.set_start(100);
+  request.set_end(200);
+  Statistics stats;
+  stats.set_blocksscanned(5);
+
+  // fast queries are not recorded
+  EXPECT_FALSE(log.record(request, "u1", 99, stats));
+  EXPECT_TRUE(log.record(request, "u1", 100, stats));
+
+  // the same query on another time range has the same normalized plan
+  QueryRequest later{ request };
+  later.set_start(300);
+  later.set_end(400);
+  EXPECT_EQ(SlowQueryLog::normalize(request), SlowQueryLog::normalize(later));
+  EXPECT_TRUE(log.record(later, "u2", 500, stats));
+
+  QueryRequest other{ request };
+  other.set_table("t2");
+  EXPECT_NE(SlowQueryLog::normalize(request), SlowQueryLog::normalize(other));
+  EXPECT_TRUE(log.record(other, "u1", 200, stats));
+
+  auto all = log.list("", 0);
+  EXPECT_EQ(all.queries_size(), 3);
+  EXPECT_EQ(all.queries(0).table(), "t2");
+  EXPECT_EQ(all.queries(1).start(), 300);
+  EXPECT_EQ(all.queries(1).repeats(), 2);
+  EXPECT_EQ(all.queries(1).stats().blocksscanned(), 5);
+  EXPECT_EQ(log.list("t1", 1).queries_size(), 1);
+
+  // the oldest one is dropped beyond capacity, and so is its repeat
+  EXPECT_TRUE(log.record(other, "u1", 200, stats));
+  EXPECT_EQ(log.size(), 3);
+  auto t1 = log.list("t1", 0);
+  EXPECT_EQ(t1.queries_size(), 1);
+  EXPECT_EQ(t1.queries(0).repeats(), 1);
+  EXPECT_EQ(log.list("t2", 0).queries(0).repeats(), 2);
+}
+
+TEST(ServiceTest, TestQueryCaptureReplay) {
+  using nebula::service::client::Replay;
+  using nebula::service::server::QueryCapture;
+  const auto file = fmt::format("/tmp/nebula.capture.{0}.jsonl", std::rand());
+  {
+    QueryCapture capture{ file };
+    EXPECT_TRUE(capture.enabled());
+    QueryRequest request;
+    request.set_table("t1");
+    request.add_dimension("event");
+    request.set_start(100);
+    request.set_end(200);
+    capture.capture(request, "u1");
+    request.set_table("t2");
+    capture.capture(request, "u2");
+  }
+
+  // captured queries are loaded in time order
+  auto queries = Replay::load(file);
+  std::remove(file.c_str());
+  ASSERT_EQ(queries.size(), 2);
+  EXPECT_EQ(queries.at(0).request().table(), "t1");
+  EXPECT_EQ(queries.at(0).user(), "u1");
+  EXPECT_EQ(queries.at(1).request().dimension(0), "event");
+  EXPECT_LE(queries.at(0).timems(), queries.at(1).timems());
+
+  EXPECT_FALSE(QueryCapture{ "" }.enabled());
+
+  std::vector<size_t> latencies;
+  for (size_t i = 100; i > 0; --i) {
+    latencies.push_back(i);
+  }
+
+  auto report = Replay::summarize(latencies, 5, 0, 10);
+  EXPECT_EQ(report.queries, 100);
+  EXPECT_EQ(report.p50, 51);
+  EXPECT_EQ(report.p90, 91);
+  EXPECT_EQ(report.p99, 100);
+  EXPECT_EQ(report.max, 100);
+  EXPECT_DOUBLE_EQ(report.qps(), 10);
+  EXPECT_DOUBLE_EQ(report.errorRate(), 0.05);
+}
+
+TEST(ServiceTest, TestResultCompression) {
+  auto ms = TableService::singleton();
+  nebula::meta::TestTable testTable;
+  auto query = table(testTable.name(), ms).select(col("id"), col("event")).limit(10);
+  auto plan = query.compile(QueryContext::def());
+
+  // repeated rows are large enough to compress and compressible
+  constexpr size_t rows = 4096;
+  nebula::memory::keyed::FlatBuffer fb(testTable.schema(), testTable.testFields());
+  nebula::surface::StaticRow row(1, 7, "nebula", nullptr, true, 3, 0, 1.5);
+  for (size_t i = 0; i < rows; ++i) {
+    fb.add(row);
+  }
+
+  using nebula::service::Codec;
+  using nebula::service::base::BatchSerde;
+  EXPECT_EQ(BatchSerde::codec("zstd"), Codec::Codec_Zstd);
+  EXPECT_EQ(BatchSerde::codec("gzip"), Codec::Codec_None);
+  for (auto codec : { Codec::Codec_None, Codec::Codec_Lz4, Codec::Codec_Zstd }) {
+    auto batch = BatchSerde::serialize(fb, plan, true, codec);
+    const auto root = batch.GetRoot();
+    EXPECT_EQ(root->codec(), codec);
+    if (codec != Codec::Codec_None) {
+      EXPECT_LT(root->data()->size(), root->raw_size());
+    }
+
+    nebula::execution::QueryStats stats;
+    auto cursor = BatchSerde::deserialize(&batch, testTable.testFields(), stats);
+    EXPECT_EQ(cursor->size(), rows);
+    while (cursor->hasNext()) {
+      const auto& r = cursor->next();
+      EXPECT_EQ(r.readInt("id"), 7);
+      EXPECT_EQ(r.readString("event"), "nebula");
+    }
+  }
+}
+
+TEST(ServiceTest, TestColumnarBatch) {
+  auto ms = TableService::singleton();
+  nebula::meta::TestTable testTable;
+  auto plan = table(testTable.name(), ms).select(col("id"), col("event")).limit(10).compile(QueryContext::def());
+
+  // all scalar columns, value is null in every other row
+  auto schema = TypeSerializer::from(
+    "ROW<_time_:bigint, id:int, event:string, tag:string, flag:bool, weight:double, value:tinyint>");
+  nebula::surface::eval::Fields fields;
+  fields.emplace_back(nebula::surface::eval::constant(1));
+  fields.emplace_back(nebula::surface::eval::constant(2));
+  fields.emplace_back(nebula::surface::eval::constant("3"));
+  fields.emplace_back(nebula::surface::eval::constant("4"));
+  fields.emplace_back(nebula::surface::eval::constant(true));
+  fields.emplace_back(nebula::surface::eval::constant(0.1));
+  fields.emplace_back(nebula::surface::eval::constant((int8_t)0));
+
+  constexpr size_t rows = 100;
+  nebula::memory::keyed::FlatBuffer fb(schema, fields);
+  for (size_t i = 0; i < rows; ++i) {
+    nebula::surface::StaticRow row(i, i * 2, i % 3 == 0 ? "a" : "b", nullptr, true, i, 0, 0.5 * i);
+    fb.add(row);
+  }
+
+  using nebula::service::base::BatchSerde;
+  auto batch = BatchSerde::columnar(fb, plan);
+  const auto root = batch.GetRoot();
+  EXPECT_EQ(root->type(), nebula::service::BatchType::BatchType_Columnar);
+  EXPECT_EQ(root->rows(), rows);
+
+  // strings are coded by a dictionary of distinct values
+  EXPECT_EQ(root->columns()->Get(2)->dict()->size(), 2u);
+
+  nebula::execution::QueryStats stats;
+  auto cursor = BatchSerde::deserialize(&batch, fields, stats);
+  EXPECT_EQ(cursor->size(), rows);
+  for (size_t i = 0; cursor->hasNext(); ++i) {
+    const auto& r = cursor->next();
+    EXPECT_EQ(r.readLong("_time_"), (int64_t)i);
+    EXPECT_EQ(r.readInt("id"), (int32_t)i * 2);
+    EXPECT_EQ(r.readString("event"), i % 3 == 0 ? "a" : "b");
+    EXPECT_EQ(r.readDouble("weight"), 0.5 * i);
+    EXPECT_EQ(r.isNull("value"), i % 2 == 0);
+    if (i % 2 == 1) {
+      EXPECT_EQ(r.readByte("value"), (int8_t)i);
+    }
+  }
+
+  // compound types are sent in flat
+  nebula::memory::keyed::FlatBuffer flat(testTable.schema(), testTable.testFields());
+  EXPECT_EQ(BatchSerde::columnar(flat, plan).GetRoot()->type(), nebula::service::BatchType::BatchType_Flat);
+}
+
 } // namespace test
 } // namespace service
 } // namespace nebula
@@ -19,6 +19,7 @@
 #include <gtest/gtest.h>
 #include "execution/core/NodeConnector.h"
 #include "execution/core/ServerExecutor.h"
+#include "service/base/NativeMetaDb.h"
 #include "service/base/NebulaService.h"
 #include "service/server/QueryHandler.h"
 #include "surface/DataSurface.h"
@@ -36,12 +37,53 @@ using nebula::execution::BlockManager;
 using nebula::execution::core::NodeConnector;
 using nebula::execution::core::ServerExecutor;
 using nebula::service::base::ErrorCode;
+using nebula::service::base::NativeMetaDb;
 using nebula::service::base::ServiceProperties;
 using nebula::service::server::QueryHandler;
 using nebula::surface::RowData;
 using nebula::type::Schema;
 using nebula::type::TypeSerializer;
 
+TEST(ServiceTest, TestMetaDbBackup) {
+  auto fs = nebula::storage::makeFS("local");
+  const auto remote = fs->temp(true);
+  const auto uri = fmt::format("local://{0}", remote);
+  {
+    NativeMetaDb db(uri);
+    for (auto i = 0; i < 100; ++i) {
+      EXPECT_TRUE(db.write(fmt::format("k{0}", i), fmt::format("v{0}", i)));
+    }
+
+    // queued writes are read before they are committed
+    std::string value;
+    EXPECT_TRUE(db.read("k99", value));
+    EXPECT_EQ(value, "v99");
+    db.close();
+  }
+
+  // a new db restores the snapshot, and its changes are backed up on top of it
+  {
+    NativeMetaDb db(uri);
+    std::string value;
+    EXPECT_TRUE(db.read("k1", value));
+    EXPECT_EQ(value, "v1");
+    EXPECT_TRUE(db.write("k1", "x"));
+    db.close();
+  }
+
+  {
+    NativeMetaDb db(uri);
+    std::string value;
+    EXPECT_TRUE(db.read("k1", value));
+    EXPECT_EQ(value, "x");
+    EXPECT_TRUE(db.read("k2", value));
+    EXPECT_EQ(value, "v2");
+    EXPECT_FALSE(db.read("k100", value));
+  }
+
+  fs->rm(remote);
+}
+
 } // namespace test
 } // namespace service
 } // namespace nebula
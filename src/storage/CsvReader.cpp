@@ -16,6 +16,19 @@
 #include <sstream>
 
 #include "CsvReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "common/Errors.h"
 
 /**
@@ -121,19 +134,425 @@ int32_t field(std::istream& str, std::string& cell, const char deli, const bool
 }
 
 // follow RFC4180 for CSV rules
+// cells of the previous row are cleared and refilled to reuse their buffers
 bool CsvRow::readNext(std::istream& str) {
-  data_.clear();
+  size_t cells = 0;
   int state = -1;
   do {
-    std::string cell;
-    state = field(str, cell, delimiter_, data_.empty());
-    if (state != -1 || data_.size() > 0) {
-      data_.emplace_back(std::move(cell));
+    if (cells == data_.size()) {
+      data_.emplace_back();
+    }
+
+    auto& cell = data_[cells];
+    cell.clear();
+    state = field(str, cell, delimiter_, cells == 0);
+    if (state != -1 || cells > 0) {
+      ++cells;
     }
   } while (state == 0);
 
+  data_.resize(cells);
+
   // if read valid data in
-  return !data_.empty();
+  return cells > 0;
+}
+
+// the first byte equal to any of a, b, c in [p, e), e if none
+static inline const char* findAny(const char* p, const char* e, char a, char b, char c) {
+#ifdef __AVX2__
+  const auto va = _mm256_set1_epi8(a);
+  const auto vb = _mm256_set1_epi8(b);
+  const auto vc = _mm256_set1_epi8(c);
+  for (; p + 32 <= e; p += 32) {
+    const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const auto m = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)), _mm256_cmpeq_epi8(v, vc));
+    const auto bits = static_cast<uint32_t>(_mm256_movemask_epi8(m));
+    if (bits != 0) {
+      return p + __builtin_ctz(bits);
+    }
+  }
+#endif
+
+  for (; p < e; ++p) {
+    if (*p == a || *p == b || *p == c) {
+      return p;
+    }
+  }
+
+  return e;
+}
+
+// number of double quotes in [p, e)
+static size_t countQuotes(const char* p, const char* e) {
+  size_t count = 0;
+#ifdef __AVX2__
+  const auto dq = _mm256_set1_epi8(DQ);
+  for (; p + 32 <= e; p += 32) {
+    const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    count += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, dq))));
+  }
+#endif
+
+  return count + std::count(p, e, DQ);
+}
+
+// consume a line break of LF or CRLF at cursor
+static inline void lineBreak(const char*& p, const char* e) {
+  if (*p++ == CR) {
+    N_ENSURE(p < e && *p == LF, "end line as CRLF");
+    ++p;
+  }
+}
+
+// the same rules as reading a field from stream, return state: -1=no cell,0=non-last field, 1=last
+static int32_t field(const char*& p, const char* e, std::string& cell, const char deli, const bool skip) {
+  // 1. do not start with any LF/CR when there is no any fields yet (empty lines)
+  if (skip) {
+    while (p < e && (*p == CR || *p == LF)) {
+      ++p;
+    }
+  } else if (p < e && (*p == CR || *p == LF)) {
+    lineBreak(p, e);
+    return 1;
+  }
+
+  // nothing valid to produce
+  if (p == e) {
+    return -1;
+  }
+
+  // seeing first letter as deli produces empty cell
+  if (*p == deli) {
+    ++p;
+    return 0;
+  }
+
+  // non-escaped: stop at delimeter, end line or end of the buffer
+  if (*p != DQ) {
+    auto q = findAny(p, e, deli, CR, LF);
+    cell.append(p, q - p);
+    p = q;
+    if (p == e) {
+      return 1;
+    }
+
+    if (*p == deli) {
+      ++p;
+      return 0;
+    }
+
+    lineBreak(p, e);
+    return 1;
+  }
+
+  // escaped: ending DQ, two DQs is an escaped DQ
+  ++p;
+  while (p < e) {
+    auto q = static_cast<const char*>(std::memchr(p, DQ, e - p));
+    if (q == nullptr) {
+      break;
+    }
+
+    cell.append(p, q - p);
+    p = q + 1;
+    if (p < e && *p == DQ) {
+      cell += DQ;
+      ++p;
+      continue;
+    }
+
+    // ending the field with buffer, line break or delimeter
+    if (p == e) {
+      return 1;
+    }
+
+    if (*p == deli) {
+      ++p;
+      return 0;
+    }
+
+    N_ENSURE(*p == CR || *p == LF, "has to be delimeter");
+    lineBreak(p, e);
+    return 1;
+  }
+
+  // not closed until the end
+  cell.append(p, e - p);
+  p = e;
+  return 1;
+}
+
+bool CsvRow::readNext(const char*& cursor, const char* end) {
+  size_t cells = 0;
+  int state = -1;
+  do {
+    if (cells == data_.size()) {
+      data_.emplace_back();
+    }
+
+    auto& cell = data_[cells];
+    cell.clear();
+    state = field(cursor, end, cell, delimiter_, cells == 0);
+    if (state != -1 || cells > 0) {
+      ++cells;
+    }
+  } while (state == 0);
+
+  data_.resize(cells);
+  return cells > 0;
+}
+
+CsvReader::CsvReader(const std::string& file,
+                     const nebula::meta::CsvProps& csv,
+                     const std::vector<std::string>& columns,
+                     CsvRange range)
+  : nebula::surface::RowCursor(0),
+    data_{ nullptr },
+    length_{ 0 },
+    filled_{ 0 },
+    row_{ csv.delimiter.at(0) },
+    cacheRow_{ csv.delimiter.at(0) } {
+  // map the whole file, an empty file has no rows
+  auto fd = ::open(file.c_str(), O_RDONLY);
+  N_ENSURE(fd >= 0, fmt::format("failed to open csv file: {0}", file));
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    length_ = st.st_size;
+    auto p = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      throw NException(fmt::format("failed to map csv file: {0}", file));
+    }
+
+    ::madvise(p, length_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(p);
+  }
+  ::close(fd);
+
+  cursor_ = data_;
+  end_ = data_ + length_;
+  init(file, csv, columns, range);
+}
+
+CsvReader::CsvReader(const std::string& file,
+                     std::unique_ptr<std::istream> stream,
+                     const nebula::meta::CsvProps& csv,
+                     const std::vector<std::string>& columns,
+                     size_t window)
+  : nebula::surface::RowCursor(0),
+    data_{ nullptr },
+    length_{ 0 },
+    stream_{ std::move(stream) },
+    filled_{ 0 },
+    row_{ csv.delimiter.at(0) },
+    cacheRow_{ csv.delimiter.at(0) } {
+  window_.resize(std::max<size_t>(window, 1));
+  cursor_ = end_ = window_.data();
+  refill();
+  init(file, csv, columns, { 0, std::numeric_limits<size_t>::max() });
+}
+
+void CsvReader::init(const std::string& file,
+                     const nebula::meta::CsvProps& csv,
+                     const std::vector<std::string>& columns,
+                     CsvRange range) {
+  // a few scenarios need to be handled
+  // 1. schema provided
+  // 1.a: csv has header - let's match column index to column name by reading header.
+  // 1.b: csv has no header - let's assuming the schema is sequential columns of the csv file
+  // 2. schema not provided:
+  // 2.a: csv has header - we need to read headers to use them as the schema.
+  // 2.b: csv has no header - fail, don't know how to process schema
+  LOG(INFO) << "Reading a delimiter separated file: " << file << " by " << csv.delimiter;
+  std::vector<std::string> names;
+  const auto hasSchema = columns.size() > 0;
+
+  // scenario 1.b: if the schema is given, has no header
+  if (!csv.hasHeader) {
+    // 2.b - don't know how to handle
+    if (columns.size() == 0) {
+      throw NException("Can't figure out schema without header");
+    }
+
+    // schema names provided
+    names = columns;
+  } else {
+    // read the header
+    N_ENSURE(read(row_), "Failed to read csv header unexpectedly.");
+
+    // extract all names
+    const auto& raw = row_.rawData();
+    for (size_t i = 0, size = raw.size(); i < size; ++i) {
+      names.emplace_back(nebula::common::normalize(raw.at(i)));
+    }
+
+    // dedup column names
+    dedup(names);
+  }
+
+  // build the name to index map
+  for (size_t i = 0, size = names.size(); i < size; ++i) {
+    const auto name = names.at(i);
+    // notes: columns could be partial of all data and it should be already deduped
+    if (!hasSchema || std::find(columns.begin(), columns.end(), name) != columns.end()) {
+      columns_[name] = i;
+    }
+  }
+
+  cacheRow_.setSchema([this](const std::string& name) -> size_t {
+    return columns_.at(name);
+  });
+
+  // if data has meta in the second row, skip it
+  if (csv.hasMeta) {
+    auto lf = static_cast<const char*>(std::memchr(cursor_, LF, end_ - cursor_));
+    while (lf == nullptr && stream_ && refill()) {
+      lf = static_cast<const char*>(std::memchr(cursor_, LF, end_ - cursor_));
+    }
+
+    cursor_ = lf == nullptr ? end_ : lf + 1;
+  }
+
+  // rows of given range only, a stream is always read as a whole
+  if (!stream_) {
+    end_ = data_ + std::min(range.second, length_);
+    cursor_ = std::min(end_, std::max(cursor_, data_ + std::min(range.first, length_)));
+  }
+
+  // read one row
+  if (read(row_)) {
+    size_ = 1;
+  }
+}
+
+bool CsvReader::refill() {
+  // move bytes not parsed yet to the front
+  const size_t left = filled_ - (cursor_ - window_.data());
+  std::memmove(window_.data(), cursor_, left);
+  filled_ = left;
+
+  while (true) {
+    // a record larger than the window grows it
+    if (filled_ == window_.size()) {
+      window_.resize(window_.size() * 2);
+    }
+
+    stream_->read(window_.data() + filled_, window_.size() - filled_);
+    const size_t bytes = stream_->gcount();
+    filled_ += bytes;
+
+    const auto begin = window_.data();
+    const auto last = begin + filled_;
+    cursor_ = begin;
+
+    // the rest of the stream is in the window
+    if (bytes == 0 || stream_->eof()) {
+      stream_ = nullptr;
+      end_ = last;
+      return filled_ > 0;
+    }
+
+    // cursor is always at a record start, so a line break after even quotes ends a record
+    auto quoted = false;
+    const char* boundary = nullptr;
+    for (auto q = begin; (q = findAny(q, last, DQ, LF, LF)) < last;) {
+      if (*q++ == DQ) {
+        quoted = !quoted;
+      } else if (!quoted) {
+        boundary = q;
+      }
+    }
+
+    if (boundary != nullptr) {
+      end_ = boundary;
+      return true;
+    }
+  }
+}
+
+CsvReader::~CsvReader() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<char*>(data_), length_);
+  }
+}
+
+std::vector<CsvRange> CsvReader::splits(const std::string& file, size_t max, size_t minBytes) {
+  struct stat st;
+  N_ENSURE(::stat(file.c_str(), &st) == 0, fmt::format("failed to stat csv file: {0}", file));
+  const size_t length = st.st_size;
+  const auto n = std::min(max, length / std::max<size_t>(minBytes, 1));
+  if (n <= 1) {
+    return { { 0, length } };
+  }
+
+  auto fd = ::open(file.c_str(), O_RDONLY);
+  N_ENSURE(fd >= 0, fmt::format("failed to open csv file: {0}", file));
+  auto p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  N_ENSURE(p != MAP_FAILED, fmt::format("failed to map csv file: {0}", file));
+  const auto data = static_cast<const char*>(p);
+
+  // quotes of every chunk are counted in parallel
+  std::vector<size_t> bounds(n + 1);
+  for (size_t i = 0; i <= n; ++i) {
+    bounds[i] = i * length / n;
+  }
+
+  std::vector<size_t> quotes(n);
+  std::vector<std::thread> threads;
+  threads.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    threads.emplace_back([&, i]() {
+      quotes[i] = countQuotes(data + bounds[i], data + bounds[i + 1]);
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // a chunk starts in a quoted field if odd quotes before it, its first record starts after the next line break
+  // which is not quoted. A chunk is skipped if the previous range goes beyond its start already.
+  std::vector<CsvRange> ranges;
+  ranges.reserve(n);
+  size_t start = 0;
+  size_t before = 0;
+  for (size_t i = 1; i < n; ++i) {
+    before += quotes[i - 1];
+    if (start >= bounds[i]) {
+      continue;
+    }
+
+    auto quoted = (before & 1) == 1;
+    auto q = data + bounds[i];
+    const auto end = data + length;
+    while (q < end) {
+      q = findAny(q, end, DQ, LF, LF);
+      if (q == end) {
+        break;
+      }
+
+      if (*q++ == DQ) {
+        quoted = !quoted;
+        continue;
+      }
+
+      if (!quoted) {
+        break;
+      }
+    }
+
+    const size_t boundary = q - data;
+    if (boundary > start && boundary < length) {
+      ranges.emplace_back(start, boundary);
+      start = boundary;
+    }
+  }
+
+  ranges.emplace_back(start, length);
+  ::munmap(p, length);
+  return ranges;
 }
 
 std::istream& operator>>(std::istream& str, CsvRow& data) {
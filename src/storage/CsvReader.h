@@ -18,6 +18,8 @@
 
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 #include "SchemaHelper.h"
 #include "common/Conv.h"
@@ -28,7 +30,10 @@
 #include "surface/DataSurface.h"
 
 /**
- * A CSV file reader, with or without header for schema
+ * A CSV file reader, with or without header for schema.
+ * The file is memory mapped and parsed in place, structural characters are located by a vectorized scan.
+ * A large file can be split into ranges of whole records which are parsed by multiple readers in parallel.
+ * A stream, such as a decompressed file, is parsed in the same way through a window of whole records.
  */
 namespace nebula {
 namespace storage {
@@ -80,10 +85,15 @@ public:
     throw NException("Map not supported yet.");
   }
 
-  void setData(const std::vector<std::string> data) {
+  void setData(std::vector<std::string> data) {
     data_ = std::move(data);
   }
 
+  // exchange cells with another row, both keep their string buffers for the next rows
+  inline void swapData(CsvRow& other) noexcept {
+    data_.swap(other.data_);
+  }
+
   void setSchema(const std::function<size_t(const std::string&)>& columnLookup) {
     columnLookup_ = columnLookup;
   }
@@ -91,6 +101,9 @@ public:
 public:
   // true if read a valid row, otherwise false
   bool readNext(std::istream&);
+
+  // read a row from a buffer in [cursor, end), cursor is moved to the end of the row
+  bool readNext(const char*& cursor, const char* end);
   inline const std::vector<std::string>& rawData() const {
     return data_;
   }
@@ -99,87 +112,43 @@ private:
   char delimiter_;
   // reference a line generated by reader
   std::vector<std::string> data_;
-  std::function<size_t(std::string)> columnLookup_;
+  std::function<size_t(const std::string&)> columnLookup_;
 };
 
 // declare a operator to feed in stream to a csv row
 std::istream& operator>>(std::istream&, CsvRow&);
 
-class CsvReader : public nebula::surface::RowCursor {
-public:
-  CsvReader(const std::string& file, const nebula::meta::CsvProps& csv, const std::vector<std::string>& columns)
-    : nebula::surface::RowCursor(0), fstream_{ file }, row_{ csv.delimiter.at(0) }, cacheRow_{ csv.delimiter.at(0) } {
-
-    // a few scenarios need to be handled
-    // 1. schema provided
-    // 1.a: csv has header - let's match column index to column name by reading header.
-    // 1.b: csv has no header - let's assuming the schema is sequential columns of the csv file
-    // 2. schema not provided:
-    // 2.a: csv has header - we need to read headers to use them as the schema.
-    // 2.b: csv has no header - fail, don't know how to process schema
-    LOG(INFO) << "Reading a delimiter separated file: " << file << " by " << csv.delimiter;
-    std::vector<std::string> names;
-    const auto hasSchema = columns.size() > 0;
-
-    // scenario 1.b: if the schema is given, has no header
-    if (!csv.hasHeader) {
-      // 2.b - don't know how to handle
-      if (columns.size() == 0) {
-        throw NException("Can't figure out schema without header");
-      }
-
-      // schema names provided
-      names = columns;
-    } else {
-      // read the header
-      N_ENSURE(row_.readNext(fstream_), "Failed to read csv header unexpectedly.");
+// a byte range of a file [first, second)
+using CsvRange = std::pair<size_t, size_t>;
 
-      // extract all names
-      const auto& raw = row_.rawData();
-      for (size_t i = 0, size = raw.size(); i < size; ++i) {
-        names.emplace_back(nebula::common::normalize(raw.at(i)));
-      }
-
-      // dedup column names
-      dedup(names);
-    }
-
-    // build the name to index map
-    for (size_t i = 0, size = names.size(); i < size; ++i) {
-      const auto name = names.at(i);
-      // notes: columns could be partial of all data and it should be already deduped
-      if (!hasSchema || std::find(columns.begin(), columns.end(), name) != columns.end()) {
-        columns_[name] = i;
-      }
-    }
-
-    cacheRow_.setSchema([this](const std::string& name) -> size_t {
-      return columns_.at(name);
-    });
+class CsvReader : public nebula::surface::RowCursor {
+  // initial window size of a stream
+  static constexpr size_t WINDOW = 4 * 1024 * 1024;
 
-    // if data has header and header was not consumed yet (to build schema), we have to skip the first row
-    DevNull devnull;
-    // if data has meta in the second row, skip it too
-    if (csv.hasMeta) {
-      fstream_ >> devnull;
-    }
+public:
+  // read rows starting in given range of the file, header and meta rows are always read from the beginning
+  CsvReader(const std::string& file,
+            const nebula::meta::CsvProps& csv,
+            const std::vector<std::string>& columns,
+            CsvRange range = { 0, std::numeric_limits<size_t>::max() });
 
-    // read one row
-    if (row_.readNext(fstream_)) {
-      size_ = 1;
-    }
-  }
+  // read all rows of a stream, named by the file for logging, through a window of given initial bytes
+  CsvReader(const std::string& file,
+            std::unique_ptr<std::istream> stream,
+            const nebula::meta::CsvProps& csv,
+            const std::vector<std::string>& columns,
+            size_t window = WINDOW);
 
-  virtual ~CsvReader() = default;
+  virtual ~CsvReader();
 
   // next row data of CsvRow
   virtual const nebula::surface::RowData& next() override {
-    // consume a row and read a new row
-    cacheRow_.setData(std::move(row_.rawData()));
+    // consume a row and read a new row into the cells of the consumed one
+    cacheRow_.swapData(row_);
 
     // read next row
     // we should handle those to skip less rows
-    while (row_.readNext(fstream_)) {
+    while (read(row_)) {
       // sometimes the data has trailing delimeter
       // and we may have one more collected than column size
       if (row_.rawData().size() >= columns_.size()) {
@@ -196,8 +165,44 @@ public:
     throw NException("CSV Reader does not support random access by row number");
   }
 
+  // split a file into at most given number of ranges, each has at least given bytes.
+  // a range starts at a record, found by counting quotes of all bytes before it in parallel,
+  // so a line break is known to be in a quoted field or not. This requires quotes only enclose fields (RFC4180).
+  static std::vector<CsvRange> splits(const std::string& file, size_t max, size_t minBytes);
+
 private:
-  std::ifstream fstream_;
+  // read header and meta rows, then the first row of given range
+  void init(const std::string&, const nebula::meta::CsvProps&, const std::vector<std::string>&, CsvRange);
+
+  // read a row at cursor, the window of a stream moves forward when the cursor reaches its end
+  inline bool read(CsvRow& row) {
+    while (!row.readNext(cursor_, end_)) {
+      if (!stream_ || !refill()) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // keep bytes from cursor and append following bytes of the stream to the window,
+  // parsing range ends after the last line break which is not quoted. Return false if no more bytes.
+  bool refill();
+
+private:
+  // mapped file content
+  const char* data_;
+  size_t length_;
+
+  // a stream is read through a window of its bytes
+  std::unique_ptr<std::istream> stream_;
+  std::string window_;
+  size_t filled_;
+
+  // current position and end of the range to read
+  const char* cursor_;
+  const char* end_;
+
   CsvRow row_;
   CsvRow cacheRow_;
   nebula::common::unordered_map<std::string, size_t> columns_;
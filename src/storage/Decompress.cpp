@@ -0,0 +1,271 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Decompress.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <lz4frame.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include "common/Errors.h"
+
+/**
+ * Compressed source files (gzip, zstd, lz4 frame) are decompressed while they are read.
+ */
+namespace nebula {
+namespace storage {
+
+static inline bool endsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+Compression compressionOf(const std::string& path, const std::string& setting) {
+  // explicit setting wins over file extension
+  if (!setting.empty()) {
+    auto name = setting;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (name == "gzip" || name == "gz") {
+      return Compression::GZIP;
+    }
+
+    if (name == "zstd" || name == "zst") {
+      return Compression::ZSTD;
+    }
+
+    if (name == "lz4") {
+      return Compression::LZ4;
+    }
+
+    N_ENSURE(name == "none", fmt::format("unsupported compression: {0}", setting));
+    return Compression::NONE;
+  }
+
+  if (endsWith(path, ".gz") || endsWith(path, ".gzip")) {
+    return Compression::GZIP;
+  }
+
+  if (endsWith(path, ".zst") || endsWith(path, ".zstd")) {
+    return Compression::ZSTD;
+  }
+
+  if (endsWith(path, ".lz4")) {
+    return Compression::LZ4;
+  }
+
+  return Compression::NONE;
+}
+
+// decode bytes of [in, in + avail) into out of given capacity, in and avail are moved by consumed bytes.
+// return number of bytes written to out, 0 if more input is needed.
+class Decoder {
+public:
+  virtual ~Decoder() = default;
+  virtual size_t decode(const char*& in, size_t& avail, char* out, size_t capacity) = 0;
+};
+
+class CopyDecoder : public Decoder {
+public:
+  virtual size_t decode(const char*& in, size_t& avail, char* out, size_t capacity) override {
+    const auto n = std::min(avail, capacity);
+    std::memcpy(out, in, n);
+    in += n;
+    avail -= n;
+    return n;
+  }
+};
+
+// gzip or zlib stream, a gzip file of concatenated members is read as one
+class GzipDecoder : public Decoder {
+public:
+  GzipDecoder() {
+    std::memset(&stream_, 0, sizeof(stream_));
+    // 32 - detect gzip or zlib header automatically
+    N_ENSURE_EQ(inflateInit2(&stream_, 15 + 32), Z_OK, "init gzip decoder");
+  }
+
+  virtual ~GzipDecoder() {
+    inflateEnd(&stream_);
+  }
+
+  virtual size_t decode(const char*& in, size_t& avail, char* out, size_t capacity) override {
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+    stream_.avail_in = avail;
+    stream_.next_out = reinterpret_cast<Bytef*>(out);
+    stream_.avail_out = capacity;
+    const auto ret = inflate(&stream_, Z_NO_FLUSH);
+    N_ENSURE(ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR,
+             fmt::format("gzip decoding error: {0}", stream_.msg ? stream_.msg : ""));
+
+    // next member starts
+    if (ret == Z_STREAM_END) {
+      inflateReset(&stream_);
+    }
+
+    in = reinterpret_cast<const char*>(stream_.next_in);
+    avail = stream_.avail_in;
+    return capacity - stream_.avail_out;
+  }
+
+private:
+  z_stream stream_;
+};
+
+class ZstdDecoder : public Decoder {
+public:
+  ZstdDecoder() : stream_{ ZSTD_createDStream() } {
+    N_ENSURE_NOT_NULL(stream_, "init zstd decoder");
+    ZSTD_initDStream(stream_);
+  }
+
+  virtual ~ZstdDecoder() {
+    ZSTD_freeDStream(stream_);
+  }
+
+  virtual size_t decode(const char*& in, size_t& avail, char* out, size_t capacity) override {
+    ZSTD_inBuffer input{ in, avail, 0 };
+    ZSTD_outBuffer output{ out, capacity, 0 };
+    const auto ret = ZSTD_decompressStream(stream_, &output, &input);
+    N_ENSURE(!ZSTD_isError(ret), fmt::format("zstd decoding error: {0}", ZSTD_getErrorName(ret)));
+
+    in += input.pos;
+    avail -= input.pos;
+    return output.pos;
+  }
+
+private:
+  ZSTD_DStream* stream_;
+};
+
+class Lz4Decoder : public Decoder {
+public:
+  Lz4Decoder() : ctx_{ nullptr } {
+    N_ENSURE(!LZ4F_isError(LZ4F_createDecompressionContext(&ctx_, LZ4F_VERSION)), "init lz4 decoder");
+  }
+
+  virtual ~Lz4Decoder() {
+    LZ4F_freeDecompressionContext(ctx_);
+  }
+
+  virtual size_t decode(const char*& in, size_t& avail, char* out, size_t capacity) override {
+    size_t produced = capacity;
+    size_t consumed = avail;
+    const auto ret = LZ4F_decompress(ctx_, out, &produced, in, &consumed, nullptr);
+    N_ENSURE(!LZ4F_isError(ret), fmt::format("lz4 decoding error: {0}", LZ4F_getErrorName(ret)));
+
+    in += consumed;
+    avail -= consumed;
+    return produced;
+  }
+
+private:
+  LZ4F_dctx* ctx_;
+};
+
+static std::unique_ptr<Decoder> makeDecoder(Compression compression) {
+  switch (compression) {
+  case Compression::GZIP: return std::make_unique<GzipDecoder>();
+  case Compression::ZSTD: return std::make_unique<ZstdDecoder>();
+  case Compression::LZ4: return std::make_unique<Lz4Decoder>();
+  default: return std::make_unique<CopyDecoder>();
+  }
+}
+
+DecompressBuffer::DecompressBuffer(Compression compression, ByteSource source, size_t chunk)
+  : decoder_{ makeDecoder(compression) },
+    source_{ std::move(source) },
+    in_(chunk),
+    next_{ in_.data() },
+    avail_{ 0 },
+    end_{ false },
+    out_(chunk) {
+  setg(out_.data(), out_.data(), out_.data());
+}
+
+DecompressBuffer::~DecompressBuffer() = default;
+
+DecompressBuffer::int_type DecompressBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  while (true) {
+    if (avail_ == 0 && !end_) {
+      avail_ = source_(in_.data(), in_.size());
+      next_ = in_.data();
+      end_ = avail_ == 0;
+    }
+
+    // a decoder may still flush output it holds after all input is consumed
+    const auto produced = decoder_->decode(next_, avail_, out_.data(), out_.size());
+    if (produced > 0) {
+      setg(out_.data(), out_.data(), out_.data() + produced);
+      return traits_type::to_int_type(*gptr());
+    }
+
+    if (end_) {
+      return traits_type::eof();
+    }
+  }
+}
+
+DecompressStream::DecompressStream(Compression compression, std::unique_ptr<std::istream> file)
+  : std::istream(nullptr),
+    file_{ std::move(file) },
+    buffer_{ compression, [this](char* buf, size_t size) -> size_t {
+              file_->read(buf, size);
+              return file_->gcount();
+            } } {
+  rdbuf(&buffer_);
+}
+
+DecompressStream::DecompressStream(Compression compression, std::shared_ptr<InputStream> stream)
+  : std::istream(nullptr),
+    stream_{ std::move(stream) },
+    buffer_{ compression, [this](char* buf, size_t size) {
+              return stream_->read(buf, size);
+            } } {
+  rdbuf(&buffer_);
+}
+
+DecompressStream::DecompressStream(Compression compression, ByteSource source)
+  : std::istream(nullptr), buffer_{ compression, std::move(source) } {
+  rdbuf(&buffer_);
+}
+
+std::unique_ptr<std::istream> openFile(const std::string& file, Compression compression) {
+  auto fs = std::make_unique<std::ifstream>(file, std::ios::binary);
+  N_ENSURE(fs->is_open(), fmt::format("failed to open file: {0}", file));
+  if (compression == Compression::NONE) {
+    return fs;
+  }
+
+  return std::make_unique<DecompressStream>(compression, std::move(fs));
+}
+
+std::unique_ptr<std::istream> openStream(std::shared_ptr<InputStream> stream, Compression compression) {
+  return std::make_unique<DecompressStream>(compression, std::move(stream));
+}
+
+std::unique_ptr<std::istream> openStream(ByteSource source, Compression compression) {
+  return std::make_unique<DecompressStream>(compression, std::move(source));
+}
+
+} // namespace storage
+} // namespace nebula
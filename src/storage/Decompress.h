@@ -0,0 +1,99 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "InputStream.h"
+
+/**
+ * Compressed source files (gzip, zstd, lz4 frame) are decompressed while they are read,
+ * so neither a local copy nor a remote stream is ever landed uncompressed.
+ */
+namespace nebula {
+namespace storage {
+
+enum class Compression {
+  NONE,
+  GZIP,
+  ZSTD,
+  LZ4
+};
+
+// compression named by a setting (gzip, zstd, lz4, none), or detected by extension of the path if not set
+Compression compressionOf(const std::string& path, const std::string& setting = "");
+
+// fill a buffer with up to given bytes of the source, return bytes read, 0 at the end of the source
+using ByteSource = std::function<size_t(char*, size_t)>;
+
+class Decoder;
+
+// a stream buffer of the bytes decompressed from a source, one chunk of compressed and decompressed bytes at a time
+class DecompressBuffer : public std::streambuf {
+public:
+  DecompressBuffer(Compression, ByteSource, size_t chunk = CHUNK);
+  virtual ~DecompressBuffer();
+
+protected:
+  virtual int_type underflow() override;
+
+private:
+  static constexpr size_t CHUNK = 1024 * 1024;
+
+  std::unique_ptr<Decoder> decoder_;
+  ByteSource source_;
+
+  // compressed bytes read from the source and not decoded yet
+  std::vector<char> in_;
+  const char* next_;
+  size_t avail_;
+  bool end_;
+
+  // decompressed bytes
+  std::vector<char> out_;
+};
+
+// an input stream of a local file or a remote stream, decompressed transparently
+class DecompressStream : public std::istream {
+public:
+  DecompressStream(Compression, std::unique_ptr<std::istream>);
+  DecompressStream(Compression, std::shared_ptr<InputStream>);
+  DecompressStream(Compression, ByteSource);
+  virtual ~DecompressStream() = default;
+
+private:
+  std::unique_ptr<std::istream> file_;
+  std::shared_ptr<InputStream> stream_;
+  DecompressBuffer buffer_;
+};
+
+// open a local file to read, a compressed file is decompressed while reading
+std::unique_ptr<std::istream> openFile(const std::string&, Compression);
+
+// read a remote stream through std::istream, a compressed object is decompressed while reading
+std::unique_ptr<std::istream> openStream(std::shared_ptr<InputStream>, Compression);
+
+// read bytes of any source through std::istream, such as a HTTP body, decompressed if compressed
+std::unique_ptr<std::istream> openStream(ByteSource, Compression);
+
+} // namespace storage
+} // namespace nebula
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Fetch.h"
+
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_uint32(NFETCH_THREADS, 32, "max remote listings and downloads in flight of all specs");
+DEFINE_uint64(NLIST_CACHE_SECONDS, 3600, "seconds to keep listings of settled paths between spec refreshes, 0 to disable");
+
+/**
+ * Remote listings and downloads of all specs share one pool of fetch threads.
+ */
+namespace nebula {
+namespace storage {
+
+FetchPool::FetchPool(size_t threads, size_t cacheSeconds)
+  : ttl_{ cacheSeconds },
+    pool_{ std::max<size_t>(threads, 1), std::make_shared<folly::NamedThreadFactory>("fetch") } {}
+
+FetchPool& FetchPool::singleton() {
+  static FetchPool pool(FLAGS_NFETCH_THREADS, FLAGS_NLIST_CACHE_SECONDS);
+  return pool;
+}
+
+std::vector<std::vector<FileInfo>> FetchPool::list(NFileSystem& fs,
+                                                   const std::string& scope,
+                                                   const std::vector<ListRequest>& requests) {
+  std::vector<std::vector<FileInfo>> results(requests.size());
+  std::vector<folly::Future<folly::Unit>> futures;
+  futures.reserve(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const auto& request = requests.at(i);
+    const auto key = fmt::format("{0}/{1}", scope, request.path);
+    if (request.settled && cached(key, results.at(i))) {
+      continue;
+    }
+
+    futures.push_back(submit([this, &fs, &request, &results, i, key]() {
+      auto& files = results.at(i);
+      files = fs.list(request.path);
+      if (request.settled) {
+        cache(key, files);
+      }
+    }));
+  }
+
+  // a failed listing lists nothing
+  for (auto& t : folly::collectAll(futures).get()) {
+    if (t.hasException()) {
+      LOG(ERROR) << "Failed to list in " << scope << ": " << t.exception().what();
+    }
+  }
+
+  return results;
+}
+
+void FetchPool::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  listings_.clear();
+}
+
+bool FetchPool::cached(const std::string& key, std::vector<FileInfo>& files) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = listings_.find(key);
+  if (found == listings_.end()) {
+    return false;
+  }
+
+  if (found->second.expire < Clock::now()) {
+    listings_.erase(found);
+    return false;
+  }
+
+  files = found->second.files;
+  return true;
+}
+
+void FetchPool::cache(const std::string& key, const std::vector<FileInfo>& files) {
+  if (ttl_.count() == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto now = Clock::now();
+  if (listings_.size() >= MAX_LISTINGS) {
+    for (auto it = listings_.begin(); it != listings_.end();) {
+      it = it->second.expire < now ? listings_.erase(it) : std::next(it);
+    }
+
+    // all alive, start over
+    if (listings_.size() >= MAX_LISTINGS) {
+      listings_.clear();
+    }
+  }
+
+  listings_.insert_or_assign(key, Listing{ now + ttl_, files });
+}
+
+} // namespace storage
+} // namespace nebula
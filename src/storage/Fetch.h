@@ -0,0 +1,95 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/futures/Future.h>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "NFileSystem.h"
+
+/**
+ * Remote listings and downloads of all specs share one pool of fetch threads,
+ * so requests in flight to object stores are bounded no matter how many specs are refreshed or loaded.
+ */
+namespace nebula {
+namespace storage {
+
+// a path to list, a settled path (e.g. an old time partition) is not expected to change any more
+struct ListRequest {
+  std::string path;
+  bool settled;
+};
+
+class FetchPool {
+public:
+  FetchPool(size_t threads, size_t cacheSeconds);
+  virtual ~FetchPool() = default;
+
+  static FetchPool& singleton();
+
+public:
+  // run a remote request in the pool
+  template <typename F, typename T = folly::lift_unit_t<std::invoke_result_t<F>>>
+  folly::Future<T> submit(F&& f) {
+    auto p = std::make_shared<folly::Promise<T>>();
+    auto future = p->getFuture();
+    pool_.add([p, f = std::forward<F>(f)]() mutable {
+      p->setWith(f);
+    });
+
+    return future;
+  }
+
+  // list paths of a file system in parallel, results are in the order of the requests.
+  // scope identifies the file system (protocol and domain), listings of settled paths are cached
+  // in the scope for a while, so that they are not listed again by following refreshes.
+  // It shouldn't be called by a fetch thread as it waits for the listings.
+  std::vector<std::vector<FileInfo>> list(NFileSystem&, const std::string&, const std::vector<ListRequest>&);
+
+  // drop all cached listings
+  void clear();
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct Listing {
+    Clock::time_point expire;
+    std::vector<FileInfo> files;
+  };
+
+  bool cached(const std::string&, std::vector<FileInfo>&);
+  void cache(const std::string&, const std::vector<FileInfo>&);
+
+private:
+  // max listings cached
+  static constexpr size_t MAX_LISTINGS = 100000;
+
+  const std::chrono::seconds ttl_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, Listing> listings_;
+
+  // declared last so fetch threads are joined before the cache is gone
+  folly::CPUThreadPoolExecutor pool_;
+};
+
+} // namespace storage
+} // namespace nebula
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InputStream.h"
+
+#include <cstring>
+#include <gflags/gflags.h>
+#include <vector>
+
+DEFINE_uint64(NSTREAM_CHUNK_KB, 8192, "size in KB of one ranged read of a remote file/object stream");
+DEFINE_uint32(NSTREAM_WINDOW, 4, "max ranged reads in flight for a remote file/object stream");
+
+/**
+ * A read only stream of a file/object, bytes are fetched by ranged reads rather than a local copy.
+ */
+namespace nebula {
+namespace storage {
+
+std::unique_ptr<InputStream> NFileSystem::open(const std::string& path) {
+  return std::make_unique<InputStream>(
+    *this, path, info(path).size, FLAGS_NSTREAM_CHUNK_KB * 1024, FLAGS_NSTREAM_WINDOW);
+}
+
+InputStream::InputStream(NFileSystem& fs, const std::string& path, size_t size, size_t chunk, size_t window)
+  : fs_{ fs },
+    path_{ path },
+    size_{ size },
+    chunk_{ std::max<size_t>(chunk, 1) },
+    window_{ std::max<size_t>(window, 1) },
+    pos_{ 0 },
+    base_{ 0 },
+    next_{ 0 } {}
+
+InputStream::~InputStream() {
+  // wait for reads in flight as they refer to this stream
+  ahead_.clear();
+}
+
+size_t InputStream::read(char* buf, size_t size) {
+  size_t bytes = 0;
+  while (bytes < size && pos_ < size_) {
+    // current chunk doesn't cover the position
+    if (pos_ < base_ || pos_ >= base_ + current_.size()) {
+      load(pos_ - pos_ % chunk_);
+    }
+
+    const auto n = std::min(size - bytes, base_ + current_.size() - pos_);
+    std::memcpy(buf + bytes, current_.data() + (pos_ - base_), n);
+    bytes += n;
+    pos_ += n;
+  }
+
+  return bytes;
+}
+
+void InputStream::load(size_t offset) {
+  // chunks fetched ahead are not wanted after a seek
+  if (ahead_.empty() || ahead_.front().offset != offset) {
+    ahead_.clear();
+    next_ = offset;
+    fetch();
+  }
+
+  auto chunk = std::move(ahead_.front());
+  ahead_.pop_front();
+  fetch();
+
+  current_ = chunk.data.get();
+  base_ = offset;
+}
+
+void InputStream::fetch() {
+  while (ahead_.size() < window_ && next_ < size_) {
+    const auto offset = next_;
+    const auto length = std::min(chunk_, size_ - offset);
+    ahead_.push_back({ offset, std::async(std::launch::async, [this, offset, length]() {
+                         std::string data(length, '\0');
+                         range(offset, length, data.data());
+                         return data;
+                       }) });
+    next_ += length;
+  }
+}
+
+size_t InputStream::pread(size_t offset, size_t size, char* buf) const {
+  if (offset >= size_ || size == 0) {
+    return 0;
+  }
+
+  // a large range is split into parts of the window read in parallel
+  size = std::min(size, size_ - offset);
+  const auto part = std::max(chunk_, (size + window_ - 1) / window_);
+  std::vector<std::future<size_t>> parts;
+  for (size_t p = part; p < size; p += part) {
+    parts.push_back(std::async(std::launch::async, [this, offset, size, part, p, buf]() {
+      return range(offset + p, std::min(part, size - p), buf + p);
+    }));
+  }
+
+  auto bytes = range(offset, std::min(part, size), buf);
+  for (auto& f : parts) {
+    bytes += f.get();
+  }
+
+  return bytes;
+}
+
+size_t InputStream::range(size_t offset, size_t size, char* buf) const {
+  const auto bytes = fs_.read(path_, offset, size, buf);
+  N_ENSURE_EQ(bytes, size, fmt::format("short read of {0} at {1}: {2}/{3}", path_, offset, bytes, size));
+  return bytes;
+}
+
+} // namespace storage
+} // namespace nebula
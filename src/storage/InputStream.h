@@ -0,0 +1,98 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <future>
+#include <string>
+
+#include "NFileSystem.h"
+
+/**
+ * A read only stream of a file/object, bytes are fetched by ranged reads rather than a local copy.
+ */
+namespace nebula {
+namespace storage {
+
+// Sequential reads are served from fixed size chunks, a window of following chunks is fetched ahead in parallel.
+// Positioned reads (pread) go to the file system directly, a large range is split into parallel ranged reads.
+// Positioned reads are thread safe, sequential reads (read/seek) are meant for one consumer.
+// The file system needs to outlive the stream.
+class InputStream {
+public:
+  InputStream(NFileSystem& fs, const std::string& path, size_t size, size_t chunk, size_t window);
+  virtual ~InputStream();
+
+public:
+  // read up to given bytes from current position, return bytes read
+  size_t read(char*, size_t);
+
+  // read up to given bytes at given offset, current position is not changed
+  size_t pread(size_t, size_t, char*) const;
+
+  inline void seek(size_t pos) noexcept {
+    pos_ = std::min(pos, size_);
+  }
+
+  inline size_t tell() const noexcept {
+    return pos_;
+  }
+
+  inline size_t size() const noexcept {
+    return size_;
+  }
+
+  inline const std::string& path() const noexcept {
+    return path_;
+  }
+
+private:
+  struct Chunk {
+    size_t offset;
+    std::future<std::string> data;
+  };
+
+  // make the chunk at given offset current
+  void load(size_t);
+
+  // fetch following chunks until the window is full
+  void fetch();
+
+  // one ranged read which needs to be fulfilled
+  size_t range(size_t, size_t, char*) const;
+
+private:
+  NFileSystem& fs_;
+  const std::string path_;
+  const size_t size_;
+  const size_t chunk_;
+  const size_t window_;
+
+  // current position
+  size_t pos_;
+
+  // current chunk and its offset
+  std::string current_;
+  size_t base_;
+
+  // chunks being fetched ahead and offset of the next one to fetch
+  std::deque<Chunk> ahead_;
+  size_t next_;
+};
+
+} // namespace storage
+} // namespace nebula
@@ -21,12 +21,14 @@
 #include <rapidjson/istreamwrapper.h>
 #include <string>
 
+#include "Decompress.h"
 #include "JsonRow.h"
 #include "surface/DataSurface.h"
 
 /**
  * A JSON file reader, the expected file is list of json objects separated by new line.
- * It reads line by line as string, and let JSON parse each line as object
+ * It reads line by line as string, and let JSON parse each line as object.
+ * A file or remote stream can be given as an input stream, such as a decompressing one.
  */
 namespace nebula {
 namespace storage {
@@ -44,13 +46,21 @@ public:
     nebula::type::Schema schema,
     const std::vector<std::string>& columns = {},
     bool nullDefault = true)
+    : LineJsonReader(std::make_unique<std::ifstream>(file), props, schema, columns, nullDefault) {}
+
+  LineJsonReader(
+    std::unique_ptr<std::istream> stream,
+    const nebula::meta::JsonProps& props,
+    nebula::type::Schema schema,
+    const std::vector<std::string>& columns = {},
+    bool nullDefault = true)
     : nebula::surface::RowCursor(0),
-      fstream_{ file },
+      stream_{ std::move(stream) },
       json_{ schema, props.columnsMap, columns, nullDefault },
       row_{ SLICE_SIZE } {
 
     // read first line to initialize cursor state
-    if (std::getline(fstream_, line_)) {
+    if (std::getline(*stream_, line_)) {
       ++size_;
     }
   }
@@ -66,7 +76,7 @@ public:
     json_.parse(line_.data(), line_.size(), row_);
 
     // read next row, if true, then it has data
-    if (std::getline(fstream_, line_)) {
+    if (std::getline(*stream_, line_)) {
       ++size_;
     }
 
@@ -78,7 +88,7 @@ public:
   }
 
 private:
-  std::ifstream fstream_;
+  std::unique_ptr<std::istream> stream_;
   JsonRow json_;
   nebula::memory::FlatRow row_;
   std::string line_;
@@ -97,6 +107,14 @@ public:
     nebula::type::Schema schema,
     const std::vector<std::string>& columns = {},
     bool nullDefault = true)
+    : ObjectJsonReader(std::make_unique<std::ifstream>(file), props, schema, columns, nullDefault) {}
+
+  ObjectJsonReader(
+    std::unique_ptr<std::istream> stream,
+    const nebula::meta::JsonProps& props,
+    nebula::type::Schema schema,
+    const std::vector<std::string>& columns = {},
+    bool nullDefault = true)
     : nebula::surface::RowCursor(0),
       json_{ schema, props.columnsMap, columns, nullDefault },
       row_{ SLICE_SIZE },
@@ -104,9 +122,8 @@ public:
     const auto& rf = props.rowsField;
     N_ENSURE(rf.size() > 0, "rows field has to be set.");
 
-    // parse the file into json object
-    std::ifstream ifs{ file };
-    rapidjson::IStreamWrapper isw(ifs);
+    // parse the stream into json object
+    rapidjson::IStreamWrapper isw(*stream);
     if (doc_.ParseStream(isw).HasParseError()) {
       throw NException("Failed to parse the json document.");
     }
@@ -147,19 +164,29 @@ private:
   rapidjson::Value* array_;
 };
 
-std::unique_ptr<nebula::surface::RowCursor> makeJsonReader(
-  const std::string& file,
+inline std::unique_ptr<nebula::surface::RowCursor> makeJsonReader(
+  std::unique_ptr<std::istream> stream,
   const nebula::meta::JsonProps& props,
   nebula::type::Schema schema,
   const std::vector<std::string>& columns,
   bool nullDefault = true) {
   // empty rows field - every line of the file is a row object in json
   if (props.rowsField.size() == 0) {
-    return std::make_unique<LineJsonReader>(file, props, schema, columns, nullDefault);
+    return std::make_unique<LineJsonReader>(std::move(stream), props, schema, columns, nullDefault);
   } else {
-    return std::make_unique<ObjectJsonReader>(file, props, schema, columns, nullDefault);
+    return std::make_unique<ObjectJsonReader>(std::move(stream), props, schema, columns, nullDefault);
   }
 }
 
+inline std::unique_ptr<nebula::surface::RowCursor> makeJsonReader(
+  const std::string& file,
+  const nebula::meta::JsonProps& props,
+  nebula::type::Schema schema,
+  const std::vector<std::string>& columns,
+  bool nullDefault = true,
+  Compression compression = Compression::NONE) {
+  return makeJsonReader(openFile(file, compression), props, schema, columns, nullDefault);
+}
+
 } // namespace storage
 } // namespace nebula
\ No newline at end of file
@@ -16,8 +16,13 @@
 
 #pragma once
 
+#include <folly/Conv.h>
+#include <limits>
 #include <rapidjson/document.h>
+#include <rapidjson/encodedstream.h>
+#include <rapidjson/memorystream.h>
 #include <rapidjson/pointer.h>
+#include <rapidjson/reader.h>
 
 #include "RowParser.h"
 #include "common/Chars.h"
@@ -37,40 +42,109 @@ inline rapidjson::Value* locate(rapidjson::GenericObject<false, rapidjson::Value
   return rapidjson::Pointer(path.c_str()).Get(parent);
 }
 
+// a scalar value found at a column path.
+// numbers of a parsed document are typed, numbers of a streaming parse are raw text converted only when written.
+struct JsonScalar {
+  enum class Type {
+    NUL,
+    BOOL,
+    INT,
+    DOUBLE,
+    RAW,
+    STRING,
+    // object or array
+    OTHER
+  };
+
+  Type type = Type::NUL;
+  bool b = false;
+  int64_t i = 0;
+  double d = 0;
+  std::string_view s;
+
+  static JsonScalar from(const rapidjson::Value* v) noexcept {
+    JsonScalar scalar;
+    if (v == nullptr || v->IsNull()) {
+      return scalar;
+    }
+
+    if (v->IsBool()) {
+      scalar.type = Type::BOOL;
+      scalar.b = v->GetBool();
+    } else if (v->IsInt64()) {
+      scalar.type = Type::INT;
+      scalar.i = v->GetInt64();
+    } else if (v->IsNumber()) {
+      scalar.type = Type::DOUBLE;
+      scalar.d = v->GetDouble();
+    } else if (v->IsString()) {
+      scalar.type = Type::STRING;
+      scalar.s = std::string_view(v->GetString(), v->GetStringLength());
+    } else {
+      scalar.type = Type::OTHER;
+    }
+
+    return scalar;
+  }
+
+  // value as a number, a string is converted by safe_to without exception
+  template <typename T>
+  T number() const noexcept {
+    switch (type) {
+    case Type::BOOL: return static_cast<T>(b);
+    case Type::INT: return static_cast<T>(i);
+    case Type::DOUBLE: return static_cast<T>(d);
+    case Type::RAW: {
+      // a number without fraction or exponent is an integer
+      const folly::StringPiece text(s.data(), s.size());
+      if (s.find_first_of(".eE") == std::string_view::npos) {
+        auto v = folly::tryTo<int64_t>(text);
+        if (v.hasValue()) {
+          return static_cast<T>(v.value());
+        }
+      }
+
+      return static_cast<T>(nebula::common::safe_to<double>(text));
+    }
+    case Type::STRING: return nebula::common::safe_to<T>(folly::StringPiece(s.data(), s.size()));
+    default: return T();
+    }
+  }
+};
+
 // define column properties: column name to path mapping, and action to read value
-using fop = std::function<void(nebula::memory::FlatRow&, const std::string&, const rapidjson::Value*)>;
+using fop = std::function<void(nebula::memory::FlatRow&, const std::string&, const JsonScalar&)>;
 struct JsonColumn {
   // maybe empty - but storing parsed path if the name maps to a path
   std::string path;
 
+  // the path compiled once, so locating a node doesn't parse the path for every row
+  rapidjson::Pointer pointer;
+
   // action to convert data from json node to given storage (eg. FlatRow)
   fop action;
 };
 
 // define how each column read and write to row object
 // if the provided value is string, we use safe_to to convert it to desired type without exception
-// other excpetions, we let it throw
-#define CASE_POP(K, C, F)                                                                                          \
-  case nebula::type::Kind::K: {                                                                                    \
-    using T = nebula::type::TypeTraits<nebula::type::Kind::K>;                                                     \
-    columns_.emplace(name,                                                                                         \
-                     JsonColumn{ nebula::common::Chars::path(path.data(), path.size()),                            \
-                                 [](nebula::memory::FlatRow& r, const std::string& n, const rapidjson::Value* v) { \
-                                   if (v == nullptr || v->IsNull()) {                                              \
-                                     r.write(n, nebula::type::TypeDetect<T::CppType>::value);                      \
-                                   } else if (v->IsString()) {                                                     \
-                                     r.write(n, nebula::common::safe_to<T::CppType>(v->GetString()));              \
-                                   } else if (v->C()) {                                                            \
-                                     r.write(n, (T::CppType)v->F());                                               \
-                                   } else {                                                                        \
-                                     r.write(n, static_cast<T::CppType>(v->GetDouble()));                          \
-                                   }                                                                               \
-                                 } });                                                                             \
-    break;                                                                                                         \
+#define CASE_POP(K)                                                                                           \
+  case nebula::type::Kind::K: {                                                                               \
+    using T = nebula::type::TypeTraits<nebula::type::Kind::K>;                                                \
+    columns_.emplace(name,                                                                                    \
+                     column(path, [](nebula::memory::FlatRow& r, const std::string& n, const JsonScalar& v) { \
+                       if (v.type == JsonScalar::Type::NUL) {                                                 \
+                         r.write(n, nebula::type::TypeDetect<T::CppType>::value);                             \
+                       } else {                                                                               \
+                         r.write(n, v.number<T::CppType>());                                                  \
+                       }                                                                                      \
+                     }));                                                                                     \
+    break;                                                                                                    \
   }
 
 // represent a reusable row object with single line content
-// we can always parse line for a row object
+// we can always parse line for a row object.
+// A single line is parsed by streaming events rather than into a document: only values at column paths
+// are written and the parse stops once all columns are found, so the rest of the line is not even scanned.
 class JsonRow final : public RowParser {
 public:
   // to support flat data from nested structure in JSON, introduce "pathInName" variable
@@ -80,7 +154,9 @@ public:
           std::unordered_map<std::string, std::string> columnsMap = {},
           const std::vector<std::string>& columns = {},
           bool defaultNull = false)
-    : defaultNull_{ defaultNull }, hasTime_{ false } {
+    : defaultNull_{ defaultNull },
+      hasTime_{ false },
+      generation_{ 0 } {
 
     for (size_t i = 0; i < schema->size(); ++i) {
       auto type = schema->childType(i);
@@ -112,31 +188,47 @@ public:
       }
 
       switch (type->k()) {
-        CASE_POP(BOOLEAN, IsBool, GetBool)
-        CASE_POP(TINYINT, IsInt, GetInt)
-        CASE_POP(SMALLINT, IsInt, GetInt)
-        CASE_POP(INTEGER, IsInt, GetInt)
-        CASE_POP(BIGINT, IsInt64, GetInt64)
-        CASE_POP(REAL, IsFloat, GetFloat)
-        CASE_POP(DOUBLE, IsDouble, GetDouble)
+        CASE_POP(BOOLEAN)
+        CASE_POP(TINYINT)
+        CASE_POP(SMALLINT)
+        CASE_POP(INTEGER)
+        CASE_POP(BIGINT)
+        CASE_POP(REAL)
+        CASE_POP(DOUBLE)
       case nebula::type::Kind::VARCHAR:
         columns_.emplace(name,
-                         JsonColumn{ nebula::common::Chars::path(path.data(), path.size()),
-                                     [](nebula::memory::FlatRow& r, const std::string& n, const rapidjson::Value* v) {
-                                       // is null or is not expected string type (malformed data) - Nebula enforce types.
-                                       // we have chance to compatible with other types and convert them into string, such as numbers.
-                                       if (v == nullptr || v->IsNull() || !v->IsString()) {
-                                         r.write(n, "");
-                                       } else {
-                                         r.write(n, v->GetString(), v->GetStringLength());
-                                       }
-                                     } });
+                         column(path, [](nebula::memory::FlatRow& r, const std::string& n, const JsonScalar& v) {
+                           // is null or is not expected string type (malformed data) - Nebula enforce types.
+                           // we have chance to compatible with other types and convert them into string, such as numbers.
+                           if (v.type != JsonScalar::Type::STRING) {
+                             r.write(n, "", 0);
+                           } else {
+                             r.write(n, v.s.data(), v.s.size());
+                           }
+                         }));
         break;
 
       default:
         throw NException("Type not supported in Json Reader");
       }
     }
+
+    // a path tree of all columns, every column at a path has a slot
+    trie_.emplace_back();
+    for (const auto& item : columns_) {
+      size_t node = 0;
+      const auto& pointer = item.second.pointer;
+      for (size_t t = 0, size = pointer.GetTokenCount(); t < size; ++t) {
+        const auto& token = pointer.GetTokens()[t];
+        node = child(node, std::string_view(token.name, token.length), true);
+      }
+
+      trie_[node].slot = slots_.size();
+      slots_.emplace_back(item.first, item.second.action);
+    }
+
+    seen_.resize(slots_.size(), 0);
+    frames_.reserve(DEPTH);
   }
 
   ~JsonRow() = default;
@@ -153,27 +245,38 @@ public:
       return false;
     }
 
-    auto ptr = static_cast<char*>(buf);
-
     // (Worth A Note)
-    // we create a new doc object for each row, seems like it's not expensive
-    // but we can try make a reusable doc as member and use Clear method to release resources - not tested
-    // Previously, putting this as a member cause lots of memory leak as internal buffer not released.
-    rapidjson::Document doc;
-    auto& parsed = doc.Parse(ptr, size);
-    if (parsed.HasParseError()) {
-      LOG(WARNING) << "Error parsing json: " << parsed.GetParseError();
+    // no document is built, values are visited by the reader and written into the row by their paths.
+    // numbers are parsed as raw text and converted only if they are written.
+    // the reader keeps its stack between rows, so a row doesn't touch the heap in steady state.
+    row_ = &row;
+    ++generation_;
+    found_ = 0;
+    valid_ = true;
+    frames_.clear();
+    next_ = NONE;
+
+    rapidjson::MemoryStream ms(static_cast<const char*>(buf), size);
+    rapidjson::EncodedInputStream<rapidjson::UTF8<>, rapidjson::MemoryStream> is(ms);
+    auto result = reader_.Parse<rapidjson::kParseNumbersAsStringsFlag | rapidjson::kParseStopWhenDoneFlag>(is, *this);
+
+    if (!valid_) {
+      LOG(WARNING) << "Unexpected input - Not an JSON object.";
       return false;
     }
 
-    if (!doc.IsObject()) {
-      LOG(WARNING) << "Unexpected input - Not an JSON object.";
+    // termination is made by this visitor when all columns are found
+    if (result.IsError() && result.Code() != rapidjson::kParseErrorTermination) {
+      LOG(WARNING) << "Error parsing json: " << result.Code();
       return false;
     }
 
-    // fill the row object with json doc
-    auto root = doc.GetObject();
-    fill(root, row);
+    // columns not in the object
+    for (size_t i = 0, size = slots_.size(); i < size; ++i) {
+      if (seen_[i] != generation_) {
+        write(i, JsonScalar{});
+      }
+    }
 
     return true;
   }
@@ -187,7 +290,7 @@ public:
 
       // use the pointer to get value pointer by path
       // https://rapidjson.org/md_doc_pointer.html
-      const rapidjson::Value* node = locate(json, prop.path);
+      const rapidjson::Value* node = prop.pointer.Get(json);
 
       // if not found the node or node has null value
       if ((node == nullptr || node->IsNull()) && !defaultNull_) {
@@ -195,7 +298,7 @@ public:
         continue;
       }
 
-      prop.action(row, name, node);
+      prop.action(row, name, JsonScalar::from(node));
     }
   }
 
@@ -211,6 +314,180 @@ public:
     }
   }
 
+public:
+  // handler of reader events, returning false stops the parse
+  bool Null() {
+    return scalar(JsonScalar{});
+  }
+
+  bool Bool(bool b) {
+    JsonScalar v;
+    v.type = JsonScalar::Type::BOOL;
+    v.b = b;
+    return scalar(v);
+  }
+
+  // numbers are always raw text by the parse flag
+  bool Int(int) { return true; }
+  bool Uint(unsigned) { return true; }
+  bool Int64(int64_t) { return true; }
+  bool Uint64(uint64_t) { return true; }
+  bool Double(double) { return true; }
+
+  bool RawNumber(const char* str, rapidjson::SizeType length, bool) {
+    return text(JsonScalar::Type::RAW, str, length);
+  }
+
+  bool String(const char* str, rapidjson::SizeType length, bool) {
+    return text(JsonScalar::Type::STRING, str, length);
+  }
+
+  bool Key(const char* str, rapidjson::SizeType length, bool) {
+    const auto node = frames_.back().node;
+    next_ = node == NONE ? NONE : child(node, std::string_view(str, length));
+    return true;
+  }
+
+  bool StartObject() {
+    return open(false);
+  }
+
+  bool EndObject(rapidjson::SizeType) {
+    frames_.pop_back();
+    return true;
+  }
+
+  bool StartArray() {
+    // a row is an object
+    if (frames_.empty()) {
+      valid_ = false;
+      return false;
+    }
+
+    return open(true);
+  }
+
+  bool EndArray(rapidjson::SizeType) {
+    frames_.pop_back();
+    return true;
+  }
+
+private:
+  static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+  static constexpr size_t DEPTH = 64;
+
+  // a node of the path tree, slot of the column if a column is at this path
+  struct PathNode {
+    std::vector<std::pair<std::string, size_t>> children;
+    size_t slot = NONE;
+  };
+
+  // an object or array being visited, and its node in the path tree
+  struct Frame {
+    size_t node;
+    bool array;
+    size_t index;
+  };
+
+  static JsonColumn column(const std::string& path, fop action) {
+    auto parsed = nebula::common::Chars::path(path.data(), path.size());
+    rapidjson::Pointer pointer(parsed.c_str());
+    return JsonColumn{ std::move(parsed), std::move(pointer), std::move(action) };
+  }
+
+  size_t child(size_t node, std::string_view key, bool add = false) {
+    for (const auto& c : trie_[node].children) {
+      if (c.first == key) {
+        return c.second;
+      }
+    }
+
+    if (!add) {
+      return NONE;
+    }
+
+    const auto index = trie_.size();
+    trie_[node].children.emplace_back(std::string(key), index);
+    trie_.emplace_back();
+    return index;
+  }
+
+  // node of the value being visited
+  size_t target() {
+    if (frames_.empty()) {
+      return 0;
+    }
+
+    auto& frame = frames_.back();
+    if (!frame.array) {
+      return next_;
+    }
+
+    // array items are matched by index
+    const auto index = frame.index++;
+    if (frame.node == NONE || trie_[frame.node].children.empty()) {
+      return NONE;
+    }
+
+    char digits[24];
+    const auto length = folly::uint64ToBufferUnsafe(index, digits);
+    return child(frame.node, std::string_view(digits, length));
+  }
+
+  bool open(bool array) {
+    const auto node = target();
+    if (node != NONE && trie_[node].slot != NONE) {
+      JsonScalar v;
+      v.type = JsonScalar::Type::OTHER;
+      visit(trie_[node].slot, v);
+    }
+
+    frames_.push_back(Frame{ node, array, 0 });
+    return true;
+  }
+
+  bool text(JsonScalar::Type type, const char* str, size_t length) {
+    JsonScalar v;
+    v.type = type;
+    v.s = std::string_view(str, length);
+    return scalar(v);
+  }
+
+  bool scalar(const JsonScalar& v) {
+    // a row is an object
+    if (frames_.empty()) {
+      valid_ = false;
+      return false;
+    }
+
+    const auto node = target();
+    if (node != NONE && trie_[node].slot != NONE) {
+      visit(trie_[node].slot, v);
+    }
+
+    // stop once all columns are found
+    return found_ < slots_.size();
+  }
+
+  // the first value of a path is taken
+  inline void visit(size_t slot, const JsonScalar& v) {
+    if (seen_[slot] != generation_) {
+      seen_[slot] = generation_;
+      ++found_;
+      write(slot, v);
+    }
+  }
+
+  inline void write(size_t slot, const JsonScalar& v) {
+    const auto& column = slots_[slot];
+    if (v.type == JsonScalar::Type::NUL && !defaultNull_) {
+      row_->writeNull(column.first);
+      return;
+    }
+
+    column.second(*row_, column.first, v);
+  }
+
 private:
   // use default value for null case
   bool defaultNull_;
@@ -219,9 +496,26 @@ private:
 
   // column writer lambda
   nebula::common::unordered_map<std::string, JsonColumn> columns_;
+
+  // path tree of all columns and the column of every slot
+  std::vector<PathNode> trie_;
+  std::vector<std::pair<std::string, fop>> slots_;
+
+  // reader keeps its stack for the next rows
+  rapidjson::Reader reader_;
+
+  // state of current parse: the row, frames of open objects and arrays, node of the next value in an object,
+  // and generation of current parse when a slot is seen
+  nebula::memory::FlatRow* row_ = nullptr;
+  std::vector<Frame> frames_;
+  size_t next_ = NONE;
+  std::vector<size_t> seen_;
+  size_t generation_;
+  size_t found_ = 0;
+  bool valid_ = true;
 };
 
 #undef CASE_POP
 
 } // namespace storage
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
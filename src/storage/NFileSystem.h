@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "common/Errors.h"
@@ -42,6 +44,7 @@ struct FileInfo {
   }
 };
 
+class InputStream;
 class NFileSystem {
 public:
   NFileSystem() = default;
@@ -59,6 +62,10 @@ public:
   // return file info of given file handler
   virtual FileInfo info(const std::string&) = 0;
 
+  // open a file/object as a stream read by ranges, rather than copying it to a local file
+  // it relies on ranged read and info of the file system, which needs to outlive the stream
+  virtual std::unique_ptr<InputStream> open(const std::string&);
+
   // copy a file to an tmp file - most likely used for remote file download scenario
   // two path - from, to
   virtual bool copy(const std::string&, const std::string&) = 0;
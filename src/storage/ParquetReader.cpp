@@ -16,9 +16,19 @@
 
 #include "ParquetReader.h"
 
+#include <algorithm>
+#include <arrow/buffer.h>
+#include <arrow/io/caching.h>
+#include <arrow/io/interfaces.h>
+#include <arrow/result.h>
+#include <gflags/gflags.h>
+
 #include "common/Conv.h"
 #include "common/Likely.h"
 
+DEFINE_bool(NPARQUET_MMAP, true, "memory map local parquet files to read");
+DEFINE_bool(NPARQUET_PREFETCH, true, "prefetch column chunks of next row group while decoding current one");
+
 /**
  * Parquet reader to read a local parquet file and produce Nebula Rows
  */
@@ -56,19 +66,408 @@ void writeAsKind(Kind kind, FlatRow& row, const std::string& name, const T& valu
 #undef KIND_CONVERT
 }
 
-const RowData& ParquetReader::next() {
-  // TODO build a flat row out of a reader
+std::unique_ptr<parquet::ParquetFileReader> ParquetReader::open(const std::string& file) {
+  return parquet::ParquetFileReader::OpenFile(file, FLAGS_NPARQUET_MMAP);
+}
+
+// arrow file over a stream, every read is a positioned read of the stream so that it can be shared
+class StreamFile : public ::arrow::io::RandomAccessFile {
+public:
+  explicit StreamFile(std::shared_ptr<InputStream> stream) : stream_{ std::move(stream) }, pos_{ 0 }, closed_{ false } {}
+  virtual ~StreamFile() = default;
+
+  ::arrow::Status Close() override {
+    closed_ = true;
+    return ::arrow::Status::OK();
+  }
+
+  bool closed() const override {
+    return closed_;
+  }
+
+  ::arrow::Result<int64_t> Tell() const override {
+    return pos_;
+  }
+
+  ::arrow::Status Seek(int64_t position) override {
+    pos_ = position;
+    return ::arrow::Status::OK();
+  }
+
+  ::arrow::Result<int64_t> GetSize() override {
+    return stream_->size();
+  }
+
+  ::arrow::Result<int64_t> Read(int64_t nbytes, void* out) override {
+    ARROW_ASSIGN_OR_RAISE(auto bytes, ReadAt(pos_, nbytes, out));
+    pos_ += bytes;
+    return bytes;
+  }
+
+  ::arrow::Result<std::shared_ptr<::arrow::Buffer>> Read(int64_t nbytes) override {
+    ARROW_ASSIGN_OR_RAISE(auto buffer, ReadAt(pos_, nbytes));
+    pos_ += buffer->size();
+    return buffer;
+  }
+
+  ::arrow::Result<int64_t> ReadAt(int64_t position, int64_t nbytes, void* out) override {
+    try {
+      return stream_->pread(position, nbytes, static_cast<char*>(out));
+    } catch (const std::exception& ex) {
+      return ::arrow::Status::IOError(ex.what());
+    }
+  }
+
+  ::arrow::Result<std::shared_ptr<::arrow::Buffer>> ReadAt(int64_t position, int64_t nbytes) override {
+    ARROW_ASSIGN_OR_RAISE(auto buffer, ::arrow::AllocateResizableBuffer(nbytes));
+    ARROW_ASSIGN_OR_RAISE(auto bytes, ReadAt(position, nbytes, buffer->mutable_data()));
+    ARROW_RETURN_NOT_OK(buffer->Resize(bytes));
+    return std::shared_ptr<::arrow::Buffer>(std::move(buffer));
+  }
+
+private:
+  std::shared_ptr<InputStream> stream_;
+  int64_t pos_;
+  bool closed_;
+};
+
+std::unique_ptr<parquet::ParquetFileReader> ParquetReader::open(const std::shared_ptr<InputStream>& stream) {
+  return parquet::ParquetFileReader::Open(std::make_shared<StreamFile>(stream));
+}
+
+void ParquetReader::prefetch(size_t group) {
+  if (!FLAGS_NPARQUET_PREFETCH || group >= lastGroup_ || columns_.empty()) {
+    return;
+  }
+
+  // column readers of current group hold their chunks already, so the cache is replaced by the next group
+  std::vector<int> indices;
+  indices.reserve(columns_.size());
+  for (const auto& item : columns_) {
+    indices.push_back(item.second.columnIndex);
+  }
+
+  reader_->PreBuffer({ (int)group }, indices, ::arrow::io::IOContext(), ::arrow::io::CacheOptions::Defaults());
+}
+
+// a column chunk can be read by dictionary codes if all its data pages are dictionary encoded
+static bool dictionaryOnly(const parquet::ColumnChunkMetaData& chunk) {
+  if (!chunk.has_dictionary_page()) {
+    return false;
+  }
+
+  const auto& stats = chunk.encoding_stats();
+  return !stats.empty() && std::all_of(stats.begin(), stats.end(), [](const parquet::PageEncodingStats& s) {
+    return s.page_type == parquet::PageType::DICTIONARY_PAGE
+           || s.encoding == parquet::Encoding::RLE_DICTIONARY
+           || s.encoding == parquet::Encoding::PLAIN_DICTIONARY;
+  });
+}
+
+void ParquetReader::nextGroup() {
+  group_ = following(group_);
+  N_ENSURE_LT(group_, lastGroup_, "no more row group to read");
+  auto metadata = reader_->metadata()->RowGroup(group_);
+  groupReader_ = reader_->RowGroup(group_++);
+  cursorInGroup_ = 0;
+  groupRows_ = groupReader_->metadata()->num_rows();
+
+  // initialize all column readers in the meta store
+  for (auto& item : this->columns_) {
+    auto& info = item.second;
+    info.reader = groupReader_->Column(info.columnIndex);
+    info.coded = info.realKind == Kind::VARCHAR && dictionaryOnly(*metadata->ColumnChunk(info.columnIndex));
+  }
+
+  // decoding this group while the next one is being read
+  prefetch(following(group_));
+}
+
+bool ParquetReader::columnar(const std::vector<std::string>& names) const {
+  return std::all_of(names.begin(), names.end(), [this](const std::string& name) {
+    auto found = columns_.find(name);
+    if (found == columns_.end()) {
+      return false;
+    }
+
+    const auto& info = found->second;
+    if (info.kind == info.realKind) {
+      return true;
+    }
+
+    // numbers are converted by cast, no string conversion in batch reads
+    auto number = [](Kind k) { return k >= Kind::BOOLEAN && k <= Kind::DOUBLE; };
+    return number(info.kind) && number(info.realKind);
+  });
+}
+
+size_t ParquetReader::read(const std::vector<std::string>& names, size_t max, std::vector<ParquetColumn>& columns) {
   if (N_UNLIKELY(groupReader_ == nullptr) || cursorInGroup_ == groupRows_) {
-    groupReader_ = reader_->RowGroup(group_++);
-    cursorInGroup_ = 0;
-    groupRows_ = groupReader_->metadata()->num_rows();
+    if (following(group_) >= lastGroup_) {
+      return 0;
+    }
+
+    nextGroup();
+  }
+
+  const auto rows = std::min<size_t>(max, groupRows_ - cursorInGroup_);
+  columns.resize(names.size());
+  for (size_t i = 0, size = names.size(); i < size; ++i) {
+    decode(columns_.at(names.at(i)), rows, columns.at(i));
+  }
+
+  cursorInGroup_ += rows;
+  index_ += rows;
+  return rows;
+}
+
+// if no value in [min, max] meets the comparison
+template <typename T>
+static bool outside(nebula::meta::FilterOp op, const T& min, const T& max, const T& v) {
+  switch (op) {
+  case nebula::meta::FilterOp::EQ: return v < min || max < v;
+  case nebula::meta::FilterOp::NE: return min == v && max == v;
+  case nebula::meta::FilterOp::LT: return !(min < v);
+  case nebula::meta::FilterOp::LE: return v < min;
+  case nebula::meta::FilterOp::GT: return !(v < max);
+  case nebula::meta::FilterOp::GE: return max < v;
+  default: return false;
+  }
+}
+
+// if no row of a column chunk meets the filter by its statistics
+static bool excludes(const parquet::Statistics& stats, Kind kind, const nebula::meta::FilterSpec& filter, int64_t rows) {
+  // a null matches no comparison, and a column of nulls only matches nothing
+  if (stats.HasNullCount() && stats.null_count() == rows) {
+    return true;
+  }
 
-    // initialize all column readers in the meta store
-    for (auto& item : this->columns_) {
-      item.second.reader = groupReader_->Column(item.second.columnIndex);
+  if (filter.op == nebula::meta::FilterOp::NOTNULL || !stats.HasMinMax()) {
+    return false;
+  }
+
+  try {
+    switch (kind) {
+#define STATS_CASE(K, S, T)                                                     \
+  case Kind::K: {                                                               \
+    const auto& s = static_cast<const parquet::S&>(stats);                      \
+    return outside<T>(filter.op, s.min(), s.max(), folly::to<T>(filter.value)); \
+  }
+
+      STATS_CASE(BOOLEAN, BoolStatistics, bool)
+      STATS_CASE(INTEGER, Int32Statistics, int32_t)
+      STATS_CASE(BIGINT, Int64Statistics, int64_t)
+      STATS_CASE(REAL, FloatStatistics, float)
+      STATS_CASE(DOUBLE, DoubleStatistics, double)
+
+#undef STATS_CASE
+    case Kind::VARCHAR: {
+      // byte arrays are ordered as unsigned bytes, the same as string view comparison
+      const auto& s = static_cast<const parquet::ByteArrayStatistics&>(stats);
+      auto view = [](const parquet::ByteArray& b) { return std::string_view((const char*)b.ptr, b.len); };
+      return outside<std::string_view>(filter.op, view(s.min()), view(s.max()), filter.value);
+    }
+    default: return false;
+    }
+  } catch (const std::exception&) {
+    // value not convertible, leave it to row filter
+    return false;
+  }
+}
+
+size_t ParquetReader::prune(const std::vector<nebula::meta::FilterSpec>& filters) {
+  N_ENSURE(groupReader_ == nullptr, "row groups are pruned before reading");
+  if (filters.empty()) {
+    return 0;
+  }
+
+  pruned_.assign(lastGroup_, false);
+  size_t count = 0;
+  for (auto g = group_; g < lastGroup_; ++g) {
+    auto group = meta_->RowGroup(g);
+    for (const auto& filter : filters) {
+      // statistics are comparable only if the column is read as it is stored
+      auto found = columns_.find(filter.column);
+      if (found == columns_.end() || found->second.kind != found->second.realKind) {
+        continue;
+      }
+
+      auto chunk = group->ColumnChunk(found->second.columnIndex);
+      if (chunk->is_stats_set() && excludes(*chunk->statistics(), found->second.realKind, filter, group->num_rows())) {
+        pruned_[g] = true;
+        size_ -= group->num_rows();
+        ++count;
+        break;
+      }
     }
   }
 
+  // the first group to read may be a different one
+  if (count > 0) {
+    prefetch(following(group_));
+  }
+
+  return count;
+}
+
+// read levels and packed values of non-null rows until given number of rows are read
+// a single read doesn't go beyond current data page
+template <typename R, typename T>
+static size_t readRows(R* reader, size_t rows, int16_t* levels, T* packed) {
+  size_t done = 0;
+  size_t values = 0;
+  while (done < rows) {
+    int64_t read = 0;
+    auto n = reader->ReadBatch(rows - done, levels + done, nullptr, packed + values, &read);
+    N_ENSURE_GT(n, 0, "unexpected end of column chunk");
+    done += n;
+    values += read;
+  }
+
+  return values;
+}
+
+// spread packed values of non-null rows to their rows and mark null rows
+template <typename S, typename T>
+static size_t spread(const S* packed, const int16_t* levels, int16_t maxDef, size_t rows, T* out, uint8_t* valid) {
+  size_t nulls = 0;
+  for (size_t r = 0, j = 0; r < rows; ++r) {
+    if (maxDef == 0 || levels[r] == maxDef) {
+      out[r] = static_cast<T>(packed[j++]);
+      continue;
+    }
+
+    out[r] = T();
+    valid[r >> 3] &= ~(1 << (r & 7));
+    ++nulls;
+  }
+
+  return nulls;
+}
+
+void ParquetReader::decode(const ColumnInfo& info, size_t rows, ParquetColumn& column) {
+  const auto maxDef = info.reader->descr()->max_definition_level();
+  column.kind = info.kind;
+  column.nulls = 0;
+  column.valid.assign((rows + 7) / 8, 0xFF);
+  const auto source = column.source;
+  column.source = nullptr;
+  levels_.resize(rows);
+  packed_.resize(rows);
+
+  // strings as dictionary codes, dictionary items stay valid through the row group
+  if (info.coded) {
+    auto reader = static_cast<parquet::ByteArrayReader*>(info.reader.get());
+    auto packed = reinterpret_cast<int32_t*>(packed_.data());
+    const parquet::ByteArray* dict = nullptr;
+    int32_t items = 0;
+    size_t done = 0;
+    size_t values = 0;
+    while (done < rows) {
+      int64_t read = 0;
+      auto n = reader->ReadBatchWithDictionary(
+        rows - done, levels_.data() + done, nullptr, packed + values, &read, &dict, &items);
+      N_ENSURE_GT(n, 0, "unexpected end of column chunk");
+      done += n;
+      values += read;
+    }
+
+    column.codes.resize(rows);
+    column.nulls = spread(packed, levels_.data(), maxDef, rows, column.codes.data(), column.valid.data());
+    if (source != dict || column.dict.size() != (size_t)items) {
+      column.dict.clear();
+      column.dict.reserve(items);
+      for (int32_t i = 0; i < items; ++i) {
+        column.dict.emplace_back((const char*)dict[i].ptr, (size_t)dict[i].len);
+      }
+    }
+
+    column.source = dict;
+    return;
+  }
+
+  // strings copied out of data pages since a page is released when next page is read
+  if (info.realKind == Kind::VARCHAR) {
+    auto reader = static_cast<parquet::ByteArrayReader*>(info.reader.get());
+    std::vector<parquet::ByteArray> packed(rows);
+    std::vector<size_t> ends;
+    ends.reserve(rows);
+    column.bytes.clear();
+    size_t done = 0;
+    while (done < rows) {
+      int64_t read = 0;
+      auto n = reader->ReadBatch(rows - done, levels_.data() + done, nullptr, packed.data(), &read);
+      N_ENSURE_GT(n, 0, "unexpected end of column chunk");
+      done += n;
+      for (int64_t i = 0; i < read; ++i) {
+        column.bytes.append((const char*)packed[i].ptr, packed[i].len);
+        ends.push_back(column.bytes.size());
+      }
+    }
+
+    // views are made after all bytes are copied
+    column.views.resize(rows);
+    for (size_t r = 0, j = 0, begin = 0; r < rows; ++r) {
+      if (maxDef == 0 || levels_[r] == maxDef) {
+        column.views[r] = std::string_view(column.bytes.data() + begin, ends[j] - begin);
+        begin = ends[j++];
+        continue;
+      }
+
+      column.views[r] = {};
+      column.valid[r >> 3] &= ~(1 << (r & 7));
+      ++column.nulls;
+    }
+
+    return;
+  }
+
+#define TARGET_CASE(K)                                                                                      \
+  case Kind::K: {                                                                                           \
+    using T = nebula::type::TypeTraits<Kind::K>::CppType;                                                   \
+    column.nulls = spread(packed, levels_.data(), maxDef, rows, column.data<T>(rows), column.valid.data()); \
+    break;                                                                                                  \
+  }
+
+#define SOURCE_CASE(K, R, S)                                                             \
+  case Kind::K: {                                                                        \
+    auto packed = reinterpret_cast<S*>(packed_.data());                                  \
+    readRows(static_cast<parquet::R*>(info.reader.get()), rows, levels_.data(), packed); \
+    switch (info.kind) {                                                                 \
+      TARGET_CASE(BOOLEAN)                                                               \
+      TARGET_CASE(TINYINT)                                                               \
+      TARGET_CASE(SMALLINT)                                                              \
+      TARGET_CASE(INTEGER)                                                               \
+      TARGET_CASE(BIGINT)                                                                \
+      TARGET_CASE(REAL)                                                                  \
+      TARGET_CASE(DOUBLE)                                                                \
+    default:                                                                             \
+      throw NException("Type not supported in batch read");                              \
+    }                                                                                    \
+    break;                                                                               \
+  }
+
+  // numbers are read as packed values then placed in their rows by target type
+  switch (info.realKind) {
+    SOURCE_CASE(BOOLEAN, BoolReader, bool)
+    SOURCE_CASE(INTEGER, Int32Reader, int32_t)
+    SOURCE_CASE(BIGINT, Int64Reader, int64_t)
+    SOURCE_CASE(REAL, FloatReader, float)
+    SOURCE_CASE(DOUBLE, DoubleReader, double)
+  default:
+    throw NException("Type not supported in batch read");
+  }
+
+#undef SOURCE_CASE
+#undef TARGET_CASE
+}
+
+const RowData& ParquetReader::next() {
+  // TODO build a flat row out of a reader
+  if (N_UNLIKELY(groupReader_ == nullptr) || cursorInGroup_ == groupRows_) {
+    nextGroup();
+  }
+
   // read current data from current group reader and set it to current FlatRow
   row_.reset();
 #define TRANSFER_FROM_PARQUET(T, K, R)                         \
@@ -90,8 +489,8 @@ const RowData& ParquetReader::next() {
   }
 
   for (auto itr = this->columns_.begin(), end = this->columns_.end(); itr != end; ++itr) {
-    auto name = itr->first;
-    auto info = itr->second;
+    const auto& name = itr->first;
+    const auto& info = itr->second;
     // number of non-nulls read
     int64_t vread = 0;
 
@@ -115,11 +514,11 @@ const RowData& ParquetReader::next() {
       if (vread == 0) {
         row_.writeNull(name);
       } else {
-        std::string str((const char*)value.ptr, (size_t)value.len);
+        // bytes are written or converted in place without a temporary string
         if (info.kind == Kind::VARCHAR) {
-          row_.write(name, str);
+          row_.write(name, (const char*)value.ptr, (size_t)value.len);
         } else {
-          writeAsKind(info.kind, row_, name, str);
+          writeAsKind(info.kind, row_, name, folly::StringPiece((const char*)value.ptr, (size_t)value.len));
         }
       }
       break;
@@ -20,16 +20,20 @@
 #include <folly/String.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <parquet/api/reader.h>
 #include <string>
 
+#include "InputStream.h"
 #include "common/Errors.h"
+#include "memory/DataNode.h"
 #include "memory/FlatRow.h"
+#include "meta/TableSpec.h"
 #include "surface/DataSurface.h"
 #include "type/Type.h"
 
 /**
- * Parquet reader to read a local parquet file and produce Nebula Rows
+ * Parquet reader to read a local or remote parquet file and produce Nebula Rows
  */
 namespace nebula {
 namespace storage {
@@ -44,31 +48,99 @@ struct ColumnInfo {
   // the data type/kind that lives in parquet file
   nebula::type::Kind realKind;
   std::shared_ptr<parquet::ColumnReader> reader;
+  // all data pages of the column chunk in current group are dictionary encoded
+  bool coded;
+};
+
+// a column of rows decoded by batch, values are typed by the kind of the column.
+// strings are views of bytes copied out of data pages, or codes of items in the dictionary of current row group.
+// buffers are kept to decode next rows.
+struct ParquetColumn {
+  nebula::type::Kind kind;
+  size_t nulls;
+  std::vector<uint8_t> valid;
+  // fixed width values, 8 bytes aligned
+  std::vector<int64_t> values;
+  std::vector<std::string_view> views;
+  std::string bytes;
+  std::vector<int32_t> codes;
+  std::vector<std::string_view> dict;
+  const void* source = nullptr;
+
+  inline bool isNull(size_t row) const {
+    return nulls > 0 && !(valid[row >> 3] & (1 << (row & 7)));
+  }
+
+  template <typename T>
+  inline T* data(size_t rows) {
+    values.resize((rows * sizeof(T) + sizeof(int64_t) - 1) / sizeof(int64_t));
+    return reinterpret_cast<T*>(values.data());
+  }
+
+  // vector to append decoded rows into a batch
+  nebula::memory::ColumnVector vector() const {
+    const auto bits = nulls > 0 ? valid.data() : nullptr;
+    if (source != nullptr) {
+      return { codes.data(), bits, dict.data(), dict.size() };
+    }
+
+    if (kind == nebula::type::Kind::VARCHAR) {
+      return { views.data(), bits };
+    }
+
+    return { values.data(), bits };
+  }
 };
 
 // create a parquet reader to provide nebula rows
-// open file without memory mapping - possible optimize for smaller file.
+// local file is memory mapped unless disabled by flag, column chunks of next row group are prefetched
+// while current row group is decoded.
 // passed-in schema specified columns needed using name matching
+// a reader may cover a range of row groups only, so that row groups of one file can be decoded in parallel.
 class ParquetReader : public nebula::surface::RowCursor {
   static constexpr size_t SLICE_SIZE = 1024;
 
 public:
-  ParquetReader(const std::string& file, nebula::type::Schema schema, const std::vector<std::string>& columns = {})
+  ParquetReader(const std::string& file,
+                nebula::type::Schema schema,
+                const std::vector<std::string>& columns = {},
+                size_t firstGroup = 0,
+                size_t numGroups = std::numeric_limits<size_t>::max())
+    : ParquetReader(open(file), schema, columns, firstGroup, numGroups) {}
+
+  // read a remote file by ranges of its stream, readers of different row groups can share the same stream
+  ParquetReader(const std::shared_ptr<InputStream>& stream,
+                nebula::type::Schema schema,
+                const std::vector<std::string>& columns = {},
+                size_t firstGroup = 0,
+                size_t numGroups = std::numeric_limits<size_t>::max())
+    : ParquetReader(open(stream), schema, columns, firstGroup, numGroups) {}
+
+  ParquetReader(std::unique_ptr<parquet::ParquetFileReader> reader,
+                nebula::type::Schema schema,
+                const std::vector<std::string>& columns,
+                size_t firstGroup,
+                size_t numGroups)
     : nebula::surface::RowCursor(0),
-      reader_{ parquet::ParquetFileReader::OpenFile(file, false) },
-      group_{ 0 },
+      reader_{ std::move(reader) },
+      group_{ firstGroup },
       schema_{ schema },
       row_{ SLICE_SIZE } {
     // fetch schema from the given file
     N_ENSURE_NOT_NULL(reader_, "valid parquet reader is required");
     this->meta_ = reader_->metadata();
-    // set total rows as
-    size_ = this->meta_->num_rows();
+
+    // set total rows as rows of all covered groups
+    const size_t groups = this->meta_->num_row_groups();
+    lastGroup_ = std::min(groups, firstGroup + std::min(numGroups, groups));
+    for (auto g = group_; g < lastGroup_; ++g) {
+      size_ += this->meta_->RowGroup(g)->num_rows();
+    }
 
 // TODO(cao): by default - we allow unsafe type conversion, introduce a flag to allow user turn it off
 #define PTYPE_CONV_CASE_VALIDATION(PT, NT)                                                                \
   case parquet::Type::type::PT: {                                                                         \
-    this->columns_[cname] = { i, kind, nebula::type::Kind::NT, nullptr };                                 \
+    this->columns_[cname] = { i, kind, nebula::type::Kind::NT, nullptr, false };                          \
     auto typeConvertible = nebula::type::ConvertibleFrom<nebula::type::Kind::NT>::convertibleFrom(kind);  \
     auto valueConvertible = nebula::type::ValueFrom<nebula::type::Kind::NT>::convertibleFrom(kind);       \
     if (!typeConvertible && !valueConvertible) {                                                          \
@@ -114,6 +186,7 @@ public:
     N_ENSURE(found >= columns.size(), "every node in desired schema should be present");
 
 #undef PTYPE_CONV_CASE_VALIDATION
+    prefetch(group_);
   }
 
   ParquetReader(const std::string& file)
@@ -128,11 +201,11 @@ public:
 // FLOAT = 4,
 // DOUBLE = 5,
 // BYTE_ARRAY = 6
-#define PTYPE_CONV_CASE(PT, NT)                                                             \
-  case parquet::Type::type::PT: {                                                           \
-    this->columns_[cname] = { i, nebula::type::NT::kind, nebula::type::NT::kind, nullptr }; \
-    nodes.push_back(nebula::type::NT::createTree(cd->name()));                              \
-    break;                                                                                  \
+#define PTYPE_CONV_CASE(PT, NT)                                                                    \
+  case parquet::Type::type::PT: {                                                                  \
+    this->columns_[cname] = { i, nebula::type::NT::kind, nebula::type::NT::kind, nullptr, false }; \
+    nodes.push_back(nebula::type::NT::createTree(cd->name()));                                     \
+    break;                                                                                         \
   }
 
     const auto* schema = this->meta_->schema();
@@ -159,6 +232,7 @@ public:
     // row name indicating this schema is from parquet
     this->schema_ = std::static_pointer_cast<nebula::type::RowType>(
       nebula::type::RowType::create("parquet", nodes));
+    prefetch(group_);
   }
 
   virtual ~ParquetReader() = default;
@@ -170,9 +244,53 @@ public:
     throw NException("Parquet Reader does not support random access by row number");
   }
 
+  // number of row groups in the file
+  inline size_t groups() const noexcept {
+    return meta_->num_row_groups();
+  }
+
+  // if given columns can be decoded by batch: they are present with primitive types,
+  // and numbers are read as numbers, strings as strings
+  bool columnar(const std::vector<std::string>&) const;
+
+  // decode up to max rows of given columns into buffers of the same order by typed batch reads, column at a time.
+  // rows never span row groups, return number of rows decoded, 0 if no more rows. It is not mixed with next()
+  size_t read(const std::vector<std::string>&, size_t max, std::vector<ParquetColumn>&);
+
+  // skip row groups in which no row meets all given filters by column chunk statistics before reading any row.
+  // return number of row groups skipped
+  size_t prune(const std::vector<nebula::meta::FilterSpec>&);
+
+private:
+  // the first row group not skipped from given one
+  inline size_t following(size_t group) const noexcept {
+    while (group < pruned_.size() && pruned_[group]) {
+      ++group;
+    }
+
+    return group;
+  }
+
+  // move to next row group and initialize all column readers
+  void nextGroup();
+
+  // decode given number of rows of a column from its reader
+  void decode(const ColumnInfo&, size_t, ParquetColumn&);
+
+  // open a local parquet file, memory mapped if enabled
+  static std::unique_ptr<parquet::ParquetFileReader> open(const std::string&);
+
+  // open a remote parquet file, only its footer and column chunks of wanted columns are read
+  static std::unique_ptr<parquet::ParquetFileReader> open(const std::shared_ptr<InputStream>&);
+
+  // start reading column chunks of given row group in background if it is covered by this reader
+  void prefetch(size_t group);
+
 private:
   std::unique_ptr<parquet::ParquetFileReader> reader_;
   size_t group_;
+  size_t lastGroup_;
+  std::vector<bool> pruned_;
   nebula::type::Schema schema_;
 
   std::shared_ptr<parquet::FileMetaData> meta_;
@@ -185,6 +303,10 @@ private:
 
   // the row to be visited
   nebula::memory::FlatRow row_;
+
+  // buffers of definition levels and packed values of typed batch reads
+  std::vector<int16_t> levels_;
+  std::vector<int64_t> packed_;
 }; // namespace storage
 } // namespace storage
 } // namespace nebula
\ No newline at end of file
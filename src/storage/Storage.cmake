@@ -4,6 +4,9 @@ set(NEBULA_STORAGE NStorage)
 # target_include_directories(${NEBULA_META} INTERFACE src/meta)
 add_library(${NEBULA_STORAGE} STATIC 
     ${NEBULA_SRC}/storage/CsvReader.cpp
+    ${NEBULA_SRC}/storage/Decompress.cpp
+    ${NEBULA_SRC}/storage/Fetch.cpp
+    ${NEBULA_SRC}/storage/InputStream.cpp
     ${NEBULA_SRC}/storage/NFS.cpp
     ${NEBULA_SRC}/storage/ParquetReader.cpp
     ${NEBULA_SRC}/storage/ThriftReader.cpp
@@ -27,7 +30,10 @@ target_link_libraries(${NEBULA_STORAGE}
     PUBLIC ${KAFKA_LIBRARY}
     PUBLIC ${JSON_LIBRARY}
     PUBLIC ${THRIFT_LIBRARY}
-    PUBLIC ${YAML_LIBRARY})
+    PUBLIC ${YAML_LIBRARY}
+    PUBLIC ${ZLIB_LIBRARY}
+    PUBLIC ${ZSTD_LIBRARY}
+    PUBLIC ${LZ4_LIBRARY})
 
 #build test binary
 add_executable(StorageTests
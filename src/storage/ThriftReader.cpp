@@ -16,9 +16,9 @@
 
 #include "ThriftReader.h"
 
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/protocol/TCompactProtocol.h>
-#include <thrift/transport/TBufferTransports.h>
+#include <cstring>
+#include <folly/lang/Bits.h>
+#include <thrift/protocol/TProtocol.h>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -31,10 +31,7 @@
 namespace nebula {
 namespace storage {
 
-using apache::thrift::protocol::TBinaryProtocol;
-using apache::thrift::protocol::TCompactProtocol;
 using apache::thrift::protocol::TType;
-using apache::thrift::transport::TMemoryBuffer;
 using nebula::common::Evidence;
 using nebula::common::unordered_map;
 using nebula::common::unordered_set;
@@ -43,117 +40,339 @@ using nebula::meta::Table;
 
 constexpr auto LEVEL = 1'000;
 
-void readStruct(uint64_t base,
-                TBinaryProtocol& proto,
-                unordered_map<uint32_t, std::string>& fields,
-                unordered_set<uint32_t>& fieldsWritten,
-                FlatRow& row) {
-  // field name?
-  std::string name;
-
-  while (true) {
-    TType type = apache::thrift::protocol::T_STOP;
-    int16_t id = 0;
-
-    proto.readFieldBegin(name, type, id);
-
-    // no more fields to read
-    if (id == 0) {
-      proto.skip(type);
-      proto.readFieldEnd();
-      break;
-    }
-
-    // adjustment based on base
-    auto levelId = id + base;
-
-    // look up which column name this is for
-    // TODO(cao): I don't know why the same ID will hit twice here
-    // let use the first one before figuring out the reason
-    auto w = fieldsWritten.find(levelId);
-    auto f = fields.find(levelId);
-
-    // if this is not written yet and it's a desired field
-    if (w == fieldsWritten.end() && f != fields.end()) {
-      auto name = f->second;
-
-      // time field special handling
-      if (N_UNLIKELY(name == Table::TIME_COLUMN)) {
-        int64_t time = Evidence::unix_timestamp();
-        proto.readI64(time);
-        row.write(name, Evidence::to_seconds(time));
-        fieldsWritten.emplace(levelId);
-        proto.readFieldEnd();
-        continue;
-      }
-
-#define TYPE_EXTRACT(T, CT, M)      \
-  case TType::T: {                  \
-    CT v;                           \
-    proto.M(v);                     \
-    row.write(name, v);             \
-    fieldsWritten.emplace(levelId); \
-    break;                          \
+// a cursor reading thrift binary protocol values in place, every read is bounds checked.
+// strings are views into the message buffer, so nothing is copied before it is written into the row.
+class BinaryCursor {
+public:
+  BinaryCursor(const uint8_t* data, size_t size) : pos_{ data }, end_{ data + size } {}
+
+  template <typename T>
+  inline bool read(T& value) noexcept {
+    static_assert(std::is_integral_v<T>, "integral type only");
+    if (N_UNLIKELY(!has(sizeof(T)))) {
+      return false;
+    }
+
+    std::memcpy(&value, pos_, sizeof(T));
+    value = folly::Endian::big(value);
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  inline bool read(double& value) noexcept {
+    uint64_t bits;
+    if (!read(bits)) {
+      return false;
+    }
+
+    std::memcpy(&value, &bits, sizeof(double));
+    return true;
+  }
+
+  inline bool read(std::string_view& value) noexcept {
+    int32_t size;
+    if (!read(size) || size < 0 || !has(size)) {
+      return false;
+    }
+
+    value = std::string_view(reinterpret_cast<const char*>(pos_), size);
+    pos_ += size;
+    return true;
   }
 
-      switch (type) {
-        TYPE_EXTRACT(T_STRING, std::string, readBinary)
-        TYPE_EXTRACT(T_BOOL, bool, readBool)
-        TYPE_EXTRACT(T_BYTE, int8_t, readByte)
-        TYPE_EXTRACT(T_I16, int16_t, readI16)
-        TYPE_EXTRACT(T_I32, int32_t, readI32)
-        TYPE_EXTRACT(T_I64, int64_t, readI64)
-        TYPE_EXTRACT(T_DOUBLE, double, readDouble)
-      case TType::T_LIST: {
-        // TODO(cao): we only support size of list for now
-        TType elemType = apache::thrift::protocol::T_STOP;
-        uint32_t listSize;
-        proto.readListBegin(elemType, listSize);
-        row.write(name, listSize);
-        fieldsWritten.emplace(levelId);
-        proto.readListEnd();
-        break;
-      }
-      default: {
-        VLOG(1) << "Type not supported at field: " << levelId << " with type=" << type;
-        proto.skip(type);
-        break;
+  // skip a value of given type without decoding it, only containers of variable width items are walked
+  bool skip(uint8_t type) noexcept {
+    const auto width = fixed(type);
+    if (width > 0) {
+      return forward(width);
+    }
+
+    switch (type) {
+    case TType::T_STRING: {
+      int32_t size;
+      return read(size) && size >= 0 && forward(size);
+    }
+    case TType::T_STRUCT: {
+      while (true) {
+        uint8_t field;
+        if (!read(field)) {
+          return false;
+        }
+
+        if (field == TType::T_STOP) {
+          return true;
+        }
+
+        if (!forward(sizeof(int16_t)) || !skip(field)) {
+          return false;
+        }
+      }
+    }
+    case TType::T_MAP: {
+      uint8_t key;
+      uint8_t value;
+      int32_t size;
+      if (!read(key) || !read(value) || !read(size) || size < 0) {
+        return false;
+      }
+
+      const auto kw = fixed(key);
+      const auto vw = fixed(value);
+      if (kw > 0 && vw > 0) {
+        return forward(size * (kw + vw));
+      }
+
+      for (int32_t i = 0; i < size; ++i) {
+        if (!skip(key) || !skip(value)) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+    case TType::T_SET:
+    case TType::T_LIST: {
+      uint8_t elem;
+      int32_t size;
+      if (!read(elem) || !read(size) || size < 0) {
+        return false;
+      }
+
+      const auto ew = fixed(elem);
+      if (ew > 0) {
+        return forward(size * ew);
       }
+
+      for (int32_t i = 0; i < size; ++i) {
+        if (!skip(elem)) {
+          return false;
+        }
       }
+
+      return true;
+    }
+    default: return false;
+    }
+  }
+
+private:
+  inline bool has(size_t size) const noexcept {
+    return static_cast<size_t>(end_ - pos_) >= size;
+  }
+
+  inline bool forward(size_t size) noexcept {
+    if (N_UNLIKELY(!has(size))) {
+      return false;
+    }
+
+    pos_ += size;
+    return true;
+  }
+
+  static inline size_t fixed(uint8_t type) noexcept {
+    switch (type) {
+    case TType::T_BOOL:
+    case TType::T_BYTE: return 1;
+    case TType::T_I16: return 2;
+    case TType::T_I32: return 4;
+    case TType::T_I64:
+    case TType::T_DOUBLE: return 8;
+    default: return 0;
+    }
+  }
+
+private:
+  const uint8_t* pos_;
+  const uint8_t* end_;
+};
+
+// decoding plan of the requested fields, reused by every message.
+// a field is identified by its level id: field id + LEVEL x level id of its parent struct.
+struct ThriftRow::State {
+  struct Field {
+    std::string name;
+    bool time;
+  };
+
+  // level id -> slot of a requested field
+  unordered_map<uint64_t, size_t> slots;
+  std::vector<Field> fields;
+
+  // level ids of structs having requested fields inside, other structs are skipped as a whole
+  unordered_set<uint64_t> structs;
+
+  // fields written of current message and number of requested fields not written yet
+  std::vector<bool> written;
+  size_t remaining;
+
+  // read fields of a struct until its end, or all requested fields are written
+  bool readStruct(uint64_t base, BinaryCursor& cursor, FlatRow& row) noexcept {
+    while (true) {
+      uint8_t type;
+      if (!cursor.read(type)) {
+        return false;
+      }
+
+      // no more fields to read
+      if (type == TType::T_STOP) {
+        return true;
+      }
+
+      int16_t id;
+      if (!cursor.read(id)) {
+        return false;
+      }
+
+      // the first one wins if the same field appears multiple times
+      const uint64_t levelId = id + base;
+      auto slot = slots.find(levelId);
+      if (slot != slots.end() && !written[slot->second]) {
+        if (!readField(slot->second, type, cursor, row)) {
+          return false;
+        }
+      } else if (type == TType::T_STRUCT && structs.find(levelId) != structs.end()) {
+        // support simple nesting
+        if (!readStruct(levelId * LEVEL, cursor, row)) {
+          return false;
+        }
+      } else if (!cursor.skip(type)) {
+        return false;
+      }
+
+      // the rest of the message is not needed
+      if (remaining == 0) {
+        return true;
+      }
+    }
+  }
+
+  bool readField(size_t slot, uint8_t type, BinaryCursor& cursor, FlatRow& row) noexcept {
+    const auto& field = fields[slot];
+    const auto& name = field.name;
+
+    // time field special handling
+    if (N_UNLIKELY(field.time && type == TType::T_I64)) {
+      int64_t time;
+      if (!cursor.read(time)) {
+        return false;
+      }
+
+      row.write(name, Evidence::to_seconds(time));
+      return write(slot);
+    }
+
+#define TYPE_EXTRACT(T, CT) \
+  case TType::T: {          \
+    CT v;                   \
+    if (!cursor.read(v)) {  \
+      return false;         \
+    }                       \
+    row.write(name, v);     \
+    return write(slot);     \
+  }
+
+    switch (type) {
+    case TType::T_STRING: {
+      // string is written from the message buffer directly
+      std::string_view v;
+      if (!cursor.read(v)) {
+        return false;
+      }
+
+      row.write(name, v.data(), v.size());
+      return write(slot);
+    }
+    case TType::T_BOOL: {
+      int8_t v;
+      if (!cursor.read(v)) {
+        return false;
+      }
+
+      row.write(name, v != 0);
+      return write(slot);
+    }
+      TYPE_EXTRACT(T_BYTE, int8_t)
+      TYPE_EXTRACT(T_I16, int16_t)
+      TYPE_EXTRACT(T_I32, int32_t)
+      TYPE_EXTRACT(T_I64, int64_t)
+      TYPE_EXTRACT(T_DOUBLE, double)
+    case TType::T_SET:
+    case TType::T_LIST: {
+      // TODO(cao): we only support size of list for now
+      uint8_t elem;
+      int32_t size;
+      if (!cursor.read(elem) || !cursor.read(size) || size < 0) {
+        return false;
+      }
+
+      row.write(name, static_cast<uint32_t>(size));
+      write(slot);
+
+      // elements are skipped
+      for (int32_t i = 0; i < size; ++i) {
+        if (!cursor.skip(elem)) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+    default: {
+      VLOG(1) << "Type not supported at field: " << name << " with type=" << (int)type;
+      return cursor.skip(type);
+    }
+    }
+
 #undef TYPE_EXTRACT
-    } else if (type == TType::T_STRUCT) {
-      // support simple nesting
-      proto.readStructBegin(name);
-      // recursively
-      readStruct(levelId * LEVEL, proto, fields, fieldsWritten, row);
-      proto.readStructEnd();
-    } else {
-      proto.skip(type);
+  }
+
+  inline bool write(size_t slot) noexcept {
+    written[slot] = true;
+    --remaining;
+    return true;
+  }
+};
+
+ThriftRow::ThriftRow(const std::unordered_map<std::string, uint32_t>& columnsMap)
+  : hasTime_{ false }, state_{ std::make_unique<State>() } {
+  // reverse mapping of name -> id
+  for (auto itr = columnsMap.begin(); itr != columnsMap.end(); ++itr) {
+    fields_.emplace(itr->second, itr->first);
+    if (itr->first == Table::TIME_COLUMN) {
+      hasTime_ = true;
     }
+  }
 
-    proto.readFieldEnd();
+  // every requested field gets a slot, and all structs on its path are marked to read into
+  for (auto itr = fields_.cbegin(); itr != fields_.cend(); ++itr) {
+    state_->slots.emplace(itr->first, state_->fields.size());
+    state_->fields.push_back({ itr->second, itr->second == Table::TIME_COLUMN });
+    for (uint64_t parent = itr->first / LEVEL; parent > 0; parent /= LEVEL) {
+      state_->structs.emplace(parent);
+    }
   }
+
+  state_->written.resize(state_->fields.size());
 }
 
-bool ThriftRow::parse(void* buf, size_t size, nebula::memory::FlatRow& row) noexcept {
-  auto buffer = std::make_shared<TMemoryBuffer>(static_cast<uint8_t*>(buf), size);
-  TBinaryProtocol proto(buffer);
+ThriftRow::~ThriftRow() = default;
 
-  // read all fields
-  const auto numFields = fields_.size();
-  unordered_set<uint32_t> fieldsWritten;
-  fieldsWritten.reserve(numFields);
+bool ThriftRow::parse(void* buf, size_t size, nebula::memory::FlatRow& row) noexcept {
+  auto& state = *state_;
+  std::fill(state.written.begin(), state.written.end(), false);
+  state.remaining = state.fields.size();
 
-  // TODO(cao): ID path hack, every time it enter into a new level, it times 10K to get next field ID
-  // current field;
-  readStruct(0, proto, fields_, fieldsWritten, row);
+  // only requested fields are decoded, the rest are skipped by their sizes
+  BinaryCursor cursor(static_cast<const uint8_t*>(buf), size);
+  if (state.remaining > 0 && !state.readStruct(0, cursor, row)) {
+    return false;
+  }
 
   // in case anything happened, not all fields found from this message
-  const auto numWritten = fieldsWritten.size();
-  if (N_UNLIKELY(numWritten < numFields)) {
-    for (auto itr = fields_.cbegin(); itr != fields_.cend(); ++itr) {
-      if (fieldsWritten.find(itr->first) == fieldsWritten.end()) {
-        row.writeNull(itr->second);
+  if (N_UNLIKELY(state.remaining > 0)) {
+    for (size_t i = 0, count = state.fields.size(); i < count; ++i) {
+      if (!state.written[i]) {
+        row.writeNull(state.fields[i].name);
       }
     }
   }
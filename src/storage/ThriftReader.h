@@ -29,18 +29,8 @@ namespace storage {
 // Represents a reusable thrift object.
 class ThriftRow final : public RowParser {
 public:
-  ThriftRow(const std::unordered_map<std::string, uint32_t>& columnsMap)
-    : hasTime_{ false } {
-    // reverse mapping of name -> id
-    for (auto itr = columnsMap.begin(); itr != columnsMap.end(); ++itr) {
-      fields_.emplace(itr->second, itr->first);
-      if (itr->first == nebula::meta::Table::TIME_COLUMN) {
-        hasTime_ = true;
-      }
-    }
-  }
-
-  ~ThriftRow() = default;
+  ThriftRow(const std::unordered_map<std::string, uint32_t>& columnsMap);
+  ~ThriftRow();
 
 public:
   virtual inline bool hasTime() const noexcept override {
@@ -61,10 +51,15 @@ public:
     }
   }
 
+private:
+  // parsing states reused by every message, defined with thrift headers
+  struct State;
+
 private:
   bool hasTime_;
   // reverse the fields mapping from field ID -> name
   nebula::common::unordered_map<uint32_t, std::string> fields_;
+  std::unique_ptr<State> state_;
 };
 } // namespace storage
 } // namespace nebula
\ No newline at end of file
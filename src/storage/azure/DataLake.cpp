@@ -42,6 +42,7 @@ constexpr ull operator"" _MB(ull no) {
 
 using Azure::Storage::Blobs::BlobContainerClient;
 using Azure::Storage::Blobs::BlockBlobClient;
+using Azure::Storage::Blobs::DownloadBlobToOptions;
 using Azure::Storage::Blobs::ListBlobsOptions;
 using Azure::Storage::Blobs::UploadBlockBlobFromOptions;
 using Azure::Storage::Blobs::Models::BlobHttpHeaders;
@@ -53,6 +54,7 @@ using Azure::Storage::Files::DataLake::DataLakeDirectoryClient;
 using Azure::Storage::Files::DataLake::DataLakeFileClient;
 using Azure::Storage::Files::DataLake::DataLakeFileSystemClient;
 using Azure::Storage::Files::DataLake::DownloadFileOptions;
+using Azure::Storage::Files::DataLake::DownloadFileToOptions;
 using Azure::Storage::Files::DataLake::ListPathsOptions;
 using Azure::Storage::Files::DataLake::UploadFileFromOptions;
 using Azure::Storage::Files::DataLake::Models::PathHttpHeaders;
@@ -245,6 +247,40 @@ size_t DataLake::read(const std::string& remote, char* buf, size_t size) {
   }
 }
 
+size_t DataLake::read(const std::string& remote, const size_t offset, const size_t size, char* buf) {
+  if (size == 0) {
+    return 0;
+  }
+
+  // only bytes of the range are downloaded
+  Azure::Core::Http::HttpRange range;
+  range.Offset = offset;
+  range.Length = size;
+  if (this->client_) {
+    DownloadFileToOptions options;
+    options.Range = range;
+    auto fileClient = this->client_->GetFileClient(remote);
+    auto res = fileClient.DownloadTo((uint8_t*)buf, size, options);
+    return res.Value.ContentRange.Length.ValueOr(0);
+  }
+
+  DownloadBlobToOptions options;
+  options.Range = range;
+  auto bbc = this->blobClient_->GetBlockBlobClient(remote);
+  auto res = bbc.DownloadTo((uint8_t*)buf, size, options);
+  return res.Value.ContentRange.Length.ValueOr(0);
+}
+
+FileInfo DataLake::info(const std::string& remote) {
+  if (this->client_) {
+    auto props = this->client_->GetFileClient(remote).GetProperties().Value;
+    return FileInfo(false, 0, props.FileSize, remote, bucket_);
+  }
+
+  auto props = this->blobClient_->GetBlockBlobClient(remote).GetProperties().Value;
+  return FileInfo(false, 0, props.BlobSize, remote, bucket_);
+}
+
 bool uploadFile(const std::shared_ptr<DataLakeFileSystemClient> client,
                 const std::string& remote,
                 const std::string& local) {
@@ -317,9 +353,8 @@ bool downloadBlob(const std::shared_ptr<BlobContainerClient> client,
   }
 }
 
+// clients are thread safe, files are copied in parallel by fetch threads
 inline bool DataLake::copy(const std::string& from, const std::string& to) {
-  std::lock_guard<std::mutex> lock(mtx_);
-
   if (from.at(0) == '/') {
     if (this->client_) {
       return uploadFile(this->client_, to, from);
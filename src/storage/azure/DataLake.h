@@ -44,13 +44,9 @@ public:
   // directory level copy
   virtual bool sync(const std::string&, const std::string&, bool recursive = false) override;
 
-  virtual size_t read(const std::string&, const size_t, const size_t, char*) override {
-    throw NException("Not implemented");
-  }
+  virtual size_t read(const std::string&, const size_t, const size_t, char*) override;
 
-  virtual FileInfo info(const std::string&) override {
-    throw NException("Not implemented");
-  }
+  virtual FileInfo info(const std::string&) override;
 
   virtual std::string temp(bool = false) override {
     throw NException("Not implemented");
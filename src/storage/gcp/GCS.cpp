@@ -38,6 +38,7 @@ using google::cloud::storage::ObjectMetadata;
 using google::cloud::storage::ObjectReadStream;
 using google::cloud::storage::ObjectWriteStream;
 using google::cloud::storage::Prefix;
+using google::cloud::storage::ReadRange;
 
 std::vector<FileInfo> GCS::list(const std::string& key) {
   std::vector<FileInfo> objects;
@@ -55,15 +56,13 @@ size_t GCS::read(const std::string& key, char* buf, size_t size) {
 }
 
 size_t GCS::read(const std::string& key, const size_t offset, const size_t size, char* buf) {
-  ObjectReadStream stream = client_->ReadObject(bucket_, key);
+  // only bytes of the range are downloaded
+  ObjectReadStream stream = client_->ReadObject(bucket_, key, ReadRange(offset, offset + size));
   if (stream.bad()) {
     LOG(ERROR) << "Failed to read object " << bucket_ << "/" << key;
-    return -1;
+    return 0;
   }
 
-  if (offset > 0) {
-    stream.seekg(offset, std::ios::beg);
-  }
   stream.read(buf, size);
   return stream.gcount();
 }
@@ -99,9 +98,8 @@ bool GCS::download(const std::string& key, const std::string& local) {
   return status.ok();
 }
 
+// the client is thread safe, files are copied in parallel by fetch threads
 bool GCS::copy(const std::string& from, const std::string& to) {
-  std::lock_guard<std::mutex> lock(mutex_);
-
   if (from.at(0) == '/') {
     return upload(to, from);
   } else if (to.at(0) == '/') {
@@ -17,7 +17,6 @@
 #pragma once
 
 #include <google/cloud/storage/client.h>
-#include <mutex>
 
 #include "common/Errors.h"
 #include "storage/NFileSystem.h"
@@ -79,7 +78,6 @@ private:
 private:
   std::string bucket_;
   google::cloud::StatusOr<google::cloud::storage::Client> client_;
-  std::mutex mutex_;
 };
 
 } // namespace gcp
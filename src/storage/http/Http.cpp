@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 #include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
 #include <stdio.h>
 
 #include "Http.h"
@@ -199,8 +201,110 @@ bool HttpService::download(const std::string& url,
   return false;
 }
 
+bool HttpService::fetch(const std::string& url,
+                        const std::vector<std::string>& headers,
+                        const std::string_view post,
+                        const std::function<bool(const char*, size_t)>& receiver) const {
+  curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+
+  // if custom headers are present - set them
+  SET_HTTP_HEADERS
+
+  // if we have data to post, then post it
+  if (post.size() > 0) {
+    curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, post.size());
+    curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, post.data());
+  }
+
+  // a body encoded by any supported content encoding is decoded by curl
+  curl_easy_setopt(curl_, CURLOPT_ACCEPT_ENCODING, "");
+  curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 1L);
+  curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, +[](char* data, size_t size, size_t nmemb, void* receiver) -> size_t {
+    const auto len = size * nmemb;
+    // less bytes taken than given aborts the transfer
+    return (*static_cast<const std::function<bool(const char*, size_t)>*>(receiver))(data, len) ? len : 0;
+  });
+  curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &receiver);
+
+  CURLcode res = curl_easy_perform(curl_);
+  if (res != CURLE_OK) {
+    LOG(ERROR) << "Failed to read URL: " << url << "; Code=" << res;
+    diagnoseInfo(curl_);
+    return false;
+  }
+
+  return true;
+}
+
 #undef SET_HTTP_HEADERS
 
+HttpStream::HttpStream(const std::string& url, std::vector<std::string> headers, std::string post, size_t capacity)
+  : capacity_{ std::max<size_t>(capacity, 1) },
+    offset_{ 0 },
+    buffered_{ 0 },
+    done_{ false },
+    ok_{ false },
+    closed_{ false } {
+  thread_ = std::thread([this, url, headers = std::move(headers), post = std::move(post)]() {
+    HttpService http;
+    const auto ok = http.fetch(url, headers, post, [this](const char* data, size_t size) {
+      return receive(data, size);
+    });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    ok_ = ok;
+    cv_.notify_all();
+  });
+}
+
+HttpStream::~HttpStream() {
+  // a transfer not finished is aborted
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    cv_.notify_all();
+  }
+
+  thread_.join();
+}
+
+bool HttpStream::receive(const char* data, size_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() { return closed_ || buffered_ < capacity_; });
+  if (closed_) {
+    return false;
+  }
+
+  chunks_.emplace_back(data, size);
+  buffered_ += size;
+  cv_.notify_all();
+  return true;
+}
+
+size_t HttpStream::read(char* buf, size_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() { return done_ || !chunks_.empty(); });
+
+  size_t bytes = 0;
+  while (bytes < size && !chunks_.empty()) {
+    const auto& chunk = chunks_.front();
+    const auto n = std::min(size - bytes, chunk.size() - offset_);
+    std::memcpy(buf + bytes, chunk.data() + offset_, n);
+    bytes += n;
+    offset_ += n;
+    buffered_ -= n;
+    if (offset_ == chunk.size()) {
+      chunks_.pop_front();
+      offset_ = 0;
+    }
+  }
+
+  // the receiver may wait for room
+  cv_.notify_all();
+  return bytes;
+}
+
 } // namespace http
 } // namespace storage
 } // namespace nebula
\ No newline at end of file
@@ -21,8 +21,14 @@
 // ref: examples https://curl.haxx.se/libcurl/c/example.html
 //      https://curl.haxx.se/libcurl/c/simple.html
 //      https://curl.haxx.se/libcurl/c/https.html
+#include <condition_variable>
 #include <curl/curl.h>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 /**
  * An data exchange channel through HTTP.
@@ -52,9 +58,55 @@ public:
     const std::string_view,
     const std::string&) const;
 
+  // fetch a URL and pass its body to the receiver piece by piece as it arrives,
+  // the transfer is aborted if the receiver returns false. Return true if the whole body is received.
+  bool fetch(
+    const std::string&,
+    const std::vector<std::string>&,
+    const std::string_view,
+    const std::function<bool(const char*, size_t)>&) const;
+
 private:
   CURL* curl_;
 };
+
+// The body of a HTTP request, received by its own thread and read as bytes arrive.
+// Received bytes are buffered up to the given capacity, the transfer waits for the reader beyond that,
+// so memory is bounded no matter how large the body is. A stream is read by one reader.
+class HttpStream {
+public:
+  HttpStream(const std::string& url, std::vector<std::string> headers, std::string post, size_t capacity);
+  virtual ~HttpStream();
+
+  // read up to given bytes, wait for bytes to arrive, return 0 at the end of the body
+  size_t read(char*, size_t);
+
+  // the whole body is received, valid after the end is read
+  inline bool ok() const noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return done_ && ok_;
+  }
+
+private:
+  // buffer a piece of the body, return false if the stream is closed
+  bool receive(const char*, size_t);
+
+private:
+  const size_t capacity_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::string> chunks_;
+
+  // bytes read of the front chunk and total bytes buffered
+  size_t offset_;
+  size_t buffered_;
+  bool done_;
+  bool ok_;
+  bool closed_;
+
+  std::thread thread_;
+};
 } // namespace http
 } // namespace storage
 } // namespace nebula
\ No newline at end of file
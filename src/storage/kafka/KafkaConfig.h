@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <array>
+#include <folly/Conv.h>
 #include <glog/logging.h>
 #include <rdkafkacpp.h>
 #include <string>
@@ -36,6 +38,66 @@ namespace kafka {
 struct KafkaConfig {
   static constexpr std::string_view KAFKA_PFX = "kafka.";
   static constexpr size_t KAFKA_PFX_LEN = KAFKA_PFX.size();
+
+  // prefetch queue of a consumer, it keeps fetching messages of all assigned partitions in background.
+  // the defaults bound memory of a consumer assigned to many partitions, "kafka." settings overwrite them.
+  static constexpr std::array<std::pair<std::string_view, std::string_view>, 4> PREFETCH{ {
+    // min messages per partition to keep in the queue
+    { "queued.min.messages", "20000" },
+    // max KB per partition to keep in the queue
+    { "queued.max.messages.kbytes", "16384" },
+    // max bytes per partition in one fetch request
+    { "fetch.message.max.bytes", "4194304" },
+    // max time a broker may wait to fill a fetch response
+    { "fetch.wait.max.ms", "100" },
+  } };
+
+  // max messages taken from the prefetch queue by one fetch call, table setting "k.fetch" overwrites it
+  static constexpr std::string_view FETCH_KEY = "k.fetch";
+  static constexpr size_t FETCH_SIZE = 1024;
+  static size_t fetchSize(const std::unordered_map<std::string, std::string>& settings) noexcept {
+    return number(settings, FETCH_KEY, FETCH_SIZE);
+  }
+
+  // a fetcher whose partitions are ahead of its segments by more than "k.catchup" times of the segments is catching up
+  // a backlog, such as after an outage, it takes CATCHUP_FETCH times of fetch size by one fetch call
+  static constexpr std::string_view CATCHUP_KEY = "k.catchup";
+  static constexpr size_t CATCHUP_LAG = 10;
+  static constexpr size_t CATCHUP_FETCH = 4;
+  static size_t catchupLag(const std::unordered_map<std::string, std::string>& settings) noexcept {
+    return number(settings, CATCHUP_KEY, CATCHUP_LAG);
+  }
+
+  // streaming mode is on when table setting "k.stream" gives interval in ms to publish rows being ingested,
+  // a segment still open waits for new messages up to "k.idle" ms before it gives up
+  static constexpr std::string_view STREAM_KEY = "k.stream";
+  static constexpr std::string_view IDLE_KEY = "k.idle";
+  static constexpr size_t IDLE_MS = 600000;
+  static size_t streamMs(const std::unordered_map<std::string, std::string>& settings) noexcept {
+    return number(settings, STREAM_KEY, 0);
+  }
+
+  static size_t idleMs(const std::unordered_map<std::string, std::string>& settings) noexcept {
+    return number(settings, IDLE_KEY, IDLE_MS);
+  }
+
+  // positive number of given setting, or the default value if not set or invalid
+  static size_t number(const std::unordered_map<std::string, std::string>& settings,
+                       std::string_view key,
+                       size_t defaultValue) noexcept {
+    auto itr = settings.find(std::string(key));
+    if (itr != settings.end()) {
+      auto value = folly::tryTo<size_t>(itr->second);
+      if (value.hasValue() && value.value() > 0) {
+        return value.value();
+      }
+
+      LOG(WARNING) << "Invalid kafka setting " << key << ": " << itr->second;
+    }
+
+    return defaultValue;
+  }
+
   static bool setAndCheck(
     std::unique_ptr<RdKafka::Conf>& conf,
     const std::string& key,
@@ -58,6 +120,11 @@ struct KafkaConfig {
     : globalConf{ RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL) },
       topicConf{ RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC) } {
 
+    // prefetch defaults
+    for (const auto& [key, value] : PREFETCH) {
+      setAndCheck(globalConf, std::string(key), std::string(value));
+    }
+
     // apply user settings
     for (auto itr = settings.begin(); itr != settings.end(); ++itr) {
       const auto& key = itr->first;
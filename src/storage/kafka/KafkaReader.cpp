@@ -15,6 +15,7 @@
  */
 
 #include "KafkaReader.h"
+#include "KafkaConfig.h"
 
 // we know TCompactProtocol will define LIKELY AND UNLIKELY
 #ifdef UNLIKELY
@@ -27,6 +28,7 @@
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <iterator>
 
 #include "common/Evidence.h"
 #include "meta/Table.h"
@@ -43,120 +45,209 @@ using nebula::memory::FlatRow;
 using nebula::meta::DataFormat;
 using nebula::meta::Table;
 
-class SegmentedRebalanceCb : public RdKafka::RebalanceCb {
-public:
-  SegmentedRebalanceCb(KafkaSegment segment) : segment_{ std::move(segment) } {
-  }
+KafkaFetcher::KafkaFetcher(nebula::meta::TableSpecPtr table,
+                           std::vector<KafkaSegment> segments,
+                           size_t timeoutMs,
+                           size_t idleMs)
+  : table_{ table },
+    segments_{ std::move(segments) },
+    timeoutMs_{ timeoutMs },
+    idleMs_{ std::max(idleMs, timeoutMs) },
+    idle_{ 0 },
+    fetchSize_{ KafkaConfig::fetchSize(table_->settings) },
+    served_(segments_.size(), 0),
+    done_(segments_.size(), false),
+    open_{ segments_.size() },
+    errors_{ 0 },
+    maxErrors_{ 0 },
+    lag_{ 0 } {
+  const auto& topic = table_->kafkaSerde.topic;
+  consumer_ = KafkaProvider::getConsumer(table_->location, table_->settings);
 
-public:
-  virtual void rebalance_cb(RdKafka::KafkaConsumer* consumer,
-                            RdKafka::ErrorCode err,
-                            std::vector<RdKafka::TopicPartition*>& partitions) override {
+  // subscribe is designed for group balance, we assign all partitions directly
+  std::vector<RdKafka::TopicPartition*> assignment;
+  assignment.reserve(segments_.size());
+  partitions_.reserve(segments_.size());
+  for (size_t i = 0, size = segments_.size(); i < size; ++i) {
+    const auto& segment = segments_.at(i);
+    N_ENSURE(index_.emplace(segment.partition, i).second,
+             fmt::format("Partition {0} has multiple segments to fetch", segment.partition));
+    LOG(INFO) << "Consume " << table_->location << "/" << topic << ":" << segment.id();
+
+    // a segment can have offset even smaller than valid range of the partition
+    // due to range chunking, adjust partition offset if this is the case
+    auto offset = segment.offset;
+    int64_t lowOffset = -1;
+    int64_t highOffset = -1;
+    if (consumer_->query_watermark_offsets(
+          topic, segment.partition, &lowOffset, &highOffset, timeoutMs_)
+          == RdKafka::ERR_NO_ERROR) {
+      if (lowOffset > offset) {
+        offset = lowOffset;
+        LOG(INFO) << "Adjust partition offset to low bound.";
+      }
 
-    // pick the partition we want to target
-    RdKafka::TopicPartition* target = nullptr;
-    for (auto p : partitions) {
-      if (p->partition() == segment_.partition) {
-        target = p;
-        break;
+      // messages produced after the segment
+      const auto end = segment.offset + static_cast<int64_t>(segment.size);
+      if (highOffset > end) {
+        lag_ += highOffset - end;
       }
     }
 
-    N_ENSURE_NOT_NULL(target, "target partition not found!!");
+    partitions_.emplace_back(RdKafka::TopicPartition::create(topic, segment.partition, offset));
+    assignment.push_back(partitions_.back().get());
+    maxErrors_ += segment.size / 5;
+  }
 
-    // set offset of this partition
-    target->set_offset(segment_.offset);
+  consumer_->assign(assignment);
 
-    if (err == RdKafka::ERR__ASSIGN_PARTITIONS) {
-      consumer->assign({ target });
-    } else {
-      consumer->unassign();
-    }
+  // messages are taken in larger batches while the backlog lasts, a later spec fetches normally once it clears
+  size_t total = 0;
+  for (const auto& segment : segments_) {
+    total += segment.size;
   }
 
-private:
-  KafkaSegment segment_;
-};
+  if (lag_ > total * KafkaConfig::catchupLag(table_->settings)) {
+    fetchSize_ *= KafkaConfig::CATCHUP_FETCH;
+    LOG(INFO) << fmt::format("Catch up {0} messages behind {1}/{2}", lag_, table_->location, topic);
+  }
+}
 
-// build the subscription pipeline
-void KafkaReader::init() {
-  // properties
-  const auto& topic = table_->kafkaSerde.topic;
+void KafkaFetcher::finish(size_t i) {
+  if (done_[i]) {
+    return;
+  }
 
-  // subscribe is designed for group balance, we use assign directly
-  LOG(INFO) << "Consume " << table_->location << "/" << topic << ":" << segment_.id();
-  partition_ = std::unique_ptr<RdKafka::TopicPartition>(
-    RdKafka::TopicPartition::create(topic, segment_.partition, timeoutMs_));
+  // stop fetching this partition to save prefetch queue for others
+  done_[i] = true;
+  --open_;
+  std::vector<RdKafka::TopicPartition*> partitions{ partitions_.at(i).get() };
+  consumer_->pause(partitions);
+}
 
-  auto offset = segment_.offset;
+bool KafkaFetcher::fetch(std::vector<Messages>& batches) {
+  batches.resize(segments_.size());
+  for (auto& batch : batches) {
+    batch.clear();
+  }
 
-  // assign the partition to start consuming
-  consumer_ = KafkaProvider::getConsumer(table_->location, table_->settings);
+  // only the first message waits, the rest are taken from what is prefetched already
+  size_t count = 0;
+  size_t polls = 0;
+  while (open_ > 0 && polls++ < fetchSize_) {
+    std::unique_ptr<RdKafka::Message> msg(consumer_->consume(count == 0 ? timeoutMs_ : 0));
+    const auto err = msg ? msg->err() : RdKafka::ERR__TIMED_OUT;
+    if (err == RdKafka::ERR__TIMED_OUT) {
+      if (count == 0 && (idle_ += timeoutMs_) >= idleMs_) {
+        LOG(WARNING) << "No kafka message in " << idle_ << "ms, give up " << open_ << " segments";
+        open_ = 0;
+      }
+      break;
+    }
 
-  // a segment can have offset even smaller than valid range of the partition
-  // due to range chunking, adjust partition offset if this is the case
-  int64_t lowOffset = -1;
-  int64_t highOffset = -1;
-  if (consumer_->query_watermark_offsets(
-        topic, segment_.partition, &lowOffset, &highOffset, timeoutMs_)
-        == RdKafka::ERR_NO_ERROR
-      && lowOffset > offset) {
-    offset = lowOffset;
-    LOG(INFO) << "Adjust partition offset to low bound.";
+    idle_ = 0;
+
+    auto found = index_.find(msg->partition());
+    if (err == RdKafka::ERR__PARTITION_EOF) {
+      if (found != index_.end()) {
+        finish(found->second);
+      }
+      continue;
+    }
+
+    if (err != RdKafka::ERR_NO_ERROR) {
+      LOG(ERROR) << "Error in reading kafka message: " << msg->errstr();
+
+      // more than 20% messages are error, not waiting any more
+      if (errors_++ >= maxErrors_) {
+        LOG(ERROR) << "More than 20% messages are error, give up...";
+        open_ = 0;
+        break;
+      }
+      continue;
+    }
+
+    if (found == index_.end() || done_[found->second]) {
+      continue;
+    }
+
+    // for unpredictable element beyond the segment
+    const auto i = found->second;
+    const auto& segment = segments_[i];
+    if (msg->offset() >= segment.offset + static_cast<int64_t>(segment.size)) {
+      finish(i);
+      continue;
+    }
+
+    batches[i].push_back(std::move(msg));
+    ++count;
+    if (++served_[i] >= segment.size) {
+      finish(i);
+    }
   }
 
-  // set partition offset to read and assign to current consumer
-  partition_->set_offset(offset);
-  consumer_->assign({ partition_.get() });
+  return count > 0 || open_ > 0;
+}
 
-  // create parser
+static std::unique_ptr<RowParser> makeParser(const nebula::meta::TableSpec& table) {
   // support thrift binary and json
-  if (table_->format == DataFormat::THRIFT && table_->thrift.protocol == "binary") {
-    parser_ = std::make_unique<ThriftRow>(table_->thrift.columnsMap);
-  } else if (table_->format == DataFormat::JSON) {
-    parser_ = std::make_unique<JsonRow>(nebula::type::TypeSerializer::from(table_->schema));
-  } else {
-    throw NException("Only support thrift(TBinaryProtocol) and JSON for now.");
+  if (table.format == DataFormat::THRIFT && table.thrift.protocol == "binary") {
+    return std::make_unique<ThriftRow>(table.thrift.columnsMap);
   }
 
-  // set errors to 0 and set maximum messages to load
-  errors_ = 0;
-  max_ = segment_.offset + segment_.size;
+  if (table.format == DataFormat::JSON) {
+    return std::make_unique<JsonRow>(nebula::type::TypeSerializer::from(table.schema));
+  }
 
-  // load the first message
-  msg_ = message();
+  throw NException("Only support thrift(TBinaryProtocol) and JSON for now.");
 }
 
-std::unique_ptr<RdKafka::Message> KafkaReader::message() {
-  // no more message as we have served requested size
-  if (this->size_ >= segment_.size) {
-    return nullptr;
-  }
-
-  // when this message is consumed from queue, please delete it
-  std::unique_ptr<RdKafka::Message> msg(consumer_->consume(timeoutMs_));
+KafkaReader::KafkaReader(nebula::meta::TableSpecPtr table,
+                         std::vector<KafkaSegment> segments,
+                         size_t timeoutMs,
+                         size_t idleMs,
+                         std::function<void()> fetched)
+  : nebula::surface::RowCursor(0),
+    table_{ table },
+    row_{ SLICE_SIZE, true },
+    fetcher_{ std::make_unique<KafkaFetcher>(table, std::move(segments), timeoutMs, idleMs) },
+    parser_{ makeParser(*table) },
+    fetched_{ std::move(fetched) },
+    pos_{ 0 },
+    lag_{ fetcher_->lag() },
+    errors_{ 0 },
+    bytes_{ 0 },
+    fetchMs_{ 0 } {
+  // load the first batch
+  fill();
+}
 
-  // message may be empty
-  if (msg && msg->len() > 0) {
-    // check if the message has error
-    if (msg->err() != RdKafka::ERR_NO_ERROR) {
-      LOG(ERROR) << "Error in reading kafka message: " << msg->errstr();
+void KafkaReader::fill() {
+  while (fetcher_ && pos_ >= messages_.size()) {
+    messages_.clear();
+    pos_ = 0;
+
+    // all segments are served, release the consumer
+    Evidence::Duration timer;
+    const auto more = fetcher_->fetch(batches_);
+    fetchMs_ += timer.elapsedMs();
+    if (fetched_) {
+      fetched_();
+    }
 
-      // more than half messages are error, not waiting any more
-      if (errors_++ >= segment_.size / 5) {
-        LOG(ERROR) << "More than 20% messages are error, give up...";
-        return nullptr;
-      }
+    if (!more) {
+      errors_ += fetcher_->errors();
+      fetcher_ = nullptr;
+      break;
     }
 
-    // for unpredictable element beyond max limit
-    if (msg->offset() > max_) {
-      return nullptr;
+    for (auto& batch : batches_) {
+      std::move(batch.begin(), batch.end(), std::back_inserter(messages_));
+      batch.clear();
     }
   }
 
-  ++this->size_;
-  return msg;
+  this->size_ = index_ + messages_.size() - pos_;
 }
 
 // next row data of CsvRow
@@ -166,21 +257,24 @@ const nebula::surface::RowData& KafkaReader::next() {
   row_.reset();
 
   // always write message timestamp into time column
-  const size_t msgSize = msg_->len();
-  const size_t msgTime = msg_->timestamp().timestamp / 1000;
+  auto msg = std::move(messages_.at(pos_++));
+  const size_t msgSize = msg->len();
+  const size_t msgTime = msg->timestamp().timestamp / 1000;
+  bytes_ += msgSize;
 
   // message is empty or failed in parsing its payload
   if (msgSize == 0
-      || !parser_->parse(msg_->payload(), msgSize, row_)) {
+      || !parser_->parse(msg->payload(), msgSize, row_)) {
     LOG(WARNING) << "Invalid kafka message in parsing, size=" << msgSize;
     parser_->nullify(row_, msgTime);
+    ++errors_;
   } else if (!parser_->hasTime()) {
     row_.write(Table::TIME_COLUMN, msgTime);
   }
 
-  // move index and load next message
+  // move index and load next batch if needed
   index_++;
-  msg_ = message();
+  fill();
 
   // return the parsed row object
   return row_;
@@ -16,10 +16,13 @@
 
 #pragma once
 
+#include <functional>
+
 #include "KafkaProvider.h"
 #include "KafkaTopic.h"
 
 #include "common/Errors.h"
+#include "common/Hash.h"
 #include "memory/FlatRow.h"
 #include "meta/TableSpec.h"
 #include "storage/JsonRow.h"
@@ -33,31 +36,89 @@ namespace nebula {
 namespace storage {
 namespace kafka {
 
-// Represents a reader of a kafka segment
-class KafkaReader : public nebula::surface::RowCursor {
-  static constexpr size_t SLICE_SIZE = 1024;
+using Messages = std::vector<std::unique_ptr<RdKafka::Message>>;
 
+// Fetch a few segments of distinct partitions of a topic by one consumer assigned to all of them.
+// Messages are taken from the prefetch queue of the consumer in batches and grouped by segment,
+// a partition is paused once its segment is served.
+// A fetch waits for the first message up to timeout, it gives up all segments once no message comes
+// in idle time (same as timeout by default), which is longer for segments still being produced.
+class KafkaFetcher {
 public:
-  KafkaReader(nebula::meta::TableSpecPtr table,
-              KafkaSegment segment,
-              size_t timeoutMs = 3000)
-    : nebula::surface::RowCursor(0),
-      table_{ table },
-      segment_{ std::move(segment) },
-      timeoutMs_{ timeoutMs },
-      row_{ SLICE_SIZE, true } {
-    // initialize consumer and parser
-    init();
-  }
+  KafkaFetcher(nebula::meta::TableSpecPtr table,
+               std::vector<KafkaSegment> segments,
+               size_t timeoutMs = 3000,
+               size_t idleMs = 0);
 
-  virtual ~KafkaReader() {
-    // unassign the partition
+  virtual ~KafkaFetcher() {
+    // unassign the partitions
     consumer_->unassign();
-    // consumer->unsubscribe();
     // TODO(cao): calling close will hanging forever.
     consumer_->close();
   }
 
+public:
+  // fetch next batch of messages into the list of their segments (cleared first)
+  // return false if all segments are served and nothing is fetched
+  bool fetch(std::vector<Messages>& batches);
+
+  inline const std::vector<KafkaSegment>& segments() const noexcept {
+    return segments_;
+  }
+
+  // messages in the partitions beyond the segments when they are assigned
+  inline size_t lag() const noexcept {
+    return lag_;
+  }
+
+  // error messages fetched
+  inline size_t errors() const noexcept {
+    return errors_;
+  }
+
+private:
+  // no more messages wanted from segment i
+  void finish(size_t i);
+
+private:
+  nebula::meta::TableSpecPtr table_;
+  std::vector<KafkaSegment> segments_;
+  size_t timeoutMs_;
+  size_t idleMs_;
+  size_t idle_;
+  size_t fetchSize_;
+
+  // kafka consumer and its assigned partitions
+  std::unique_ptr<RdKafka::KafkaConsumer> consumer_;
+  std::vector<std::unique_ptr<RdKafka::TopicPartition>> partitions_;
+  nebula::common::unordered_map<int32_t, size_t> index_;
+
+  // messages served and done flag of each segment
+  std::vector<size_t> served_;
+  std::vector<bool> done_;
+  size_t open_;
+  size_t errors_;
+  size_t maxErrors_;
+  size_t lag_;
+};
+
+// Represents a reader of kafka segments, rows are parsed from messages fetched in batches
+class KafkaReader : public nebula::surface::RowCursor {
+public:
+  KafkaReader(nebula::meta::TableSpecPtr table,
+              KafkaSegment segment,
+              size_t timeoutMs = 3000)
+    : KafkaReader(table, std::vector<KafkaSegment>{ std::move(segment) }, timeoutMs) {}
+
+  // fetched is called after every fetch, whether it gets messages or not
+  KafkaReader(nebula::meta::TableSpecPtr table,
+              std::vector<KafkaSegment> segments,
+              size_t timeoutMs = 3000,
+              size_t idleMs = 0,
+              std::function<void()> fetched = {});
+
+  virtual ~KafkaReader() = default;
+
 public:
   // next row data of CsvRow
   virtual const nebula::surface::RowData& next() override;
@@ -66,28 +127,53 @@ public:
     throw NException("Kafka Reader does not support random access by row number");
   }
 
-private:
-  // load all messages in the repo
-  void init();
+  // kafka lag of the segments when they are assigned
+  inline size_t lag() const noexcept {
+    return lag_;
+  }
 
-  // next message
-  std::unique_ptr<RdKafka::Message> message();
+  // messages failed in fetching or parsing
+  inline size_t errors() const noexcept {
+    return errors_ + (fetcher_ ? fetcher_->errors() : 0);
+  }
+
+  // payload bytes of messages read
+  inline size_t bytes() const noexcept {
+    return bytes_;
+  }
+
+  // time in ms spent in fetching messages
+  inline size_t fetchMs() const noexcept {
+    return fetchMs_;
+  }
+
+private:
+  // fetch next batch once all messages in buffer are served
+  void fill();
 
 private:
+  static constexpr size_t SLICE_SIZE = 1024;
+
   nebula::meta::TableSpecPtr table_;
-  KafkaSegment segment_;
-  size_t timeoutMs_;
 
-  // queue of messages, when reader starts it will pumping messages into this queue
+  // current flat row
   nebula::memory::FlatRow row_;
 
-  // kafka consumer and parser
-  std::unique_ptr<RdKafka::TopicPartition> partition_;
-  std::unique_ptr<RdKafka::KafkaConsumer> consumer_;
+  // fetcher (released when all served) and parser
+  std::unique_ptr<KafkaFetcher> fetcher_;
   std::unique_ptr<RowParser> parser_;
-  int64_t max_;
+  std::function<void()> fetched_;
+
+  // messages of the current batch of all segments
+  std::vector<Messages> batches_;
+  Messages messages_;
+  size_t pos_;
+
+  // metrics of the segments read
+  size_t lag_;
   size_t errors_;
-  std::unique_ptr<RdKafka::Message> msg_;
+  size_t bytes_;
+  size_t fetchMs_;
 };
 
 } // namespace kafka
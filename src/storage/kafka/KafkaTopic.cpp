@@ -56,7 +56,7 @@ bool KafkaTopic::init(const std::unordered_map<std::string, std::string>& settin
 // it is querying the start and end offset by the time condition of each partition
 // and figure out "STARTING point" of each segment by width (W) in the line of
 //  [0, W) [W, 2W) [2W, 3W) .... [NW, (N+1)W)
-std::list<KafkaSegment> KafkaTopic::segmentsByTimestamp(size_t timeMs, size_t width) noexcept {
+std::list<KafkaSegment> KafkaTopic::segmentsByTimestamp(size_t timeMs, size_t width, bool open) noexcept {
   std::list<KafkaSegment> segments;
   std::string error;
 
@@ -155,6 +155,11 @@ std::list<KafkaSegment> KafkaTopic::segmentsByTimestamp(size_t timeMs, size_t wi
     // any future updates will cover uncovered ranges
     auto start = startOffset / width;
     auto end = highOffset / width;
+
+    // streaming consumes the band being produced as well, its spec is open until the band is full
+    if (open) {
+      ++end;
+    }
     // if no segements to generate, log a warning
     if (start >= end) {
       LOG(WARNING) << "No segments to produce: batch=" << width
@@ -166,7 +171,8 @@ std::list<KafkaSegment> KafkaTopic::segmentsByTimestamp(size_t timeMs, size_t wi
     // so any message in current band not full to a batch will not be consumed.
     // for example, width is 1000, the last number of message passing x*1000,
     // let's say 900 won't be consumed until it's filled up
-    // This problem potentially will apply a latency between latest message and time when it show up in Nebula.
+    // This problem potentially will apply a latency between latest message and time when it show up in Nebula,
+    // unless the open band is consumed by streaming.
     while (start < end) {
       segments.emplace_back(part, width * start++, width);
     }
@@ -75,7 +75,8 @@ public:
   virtual ~KafkaTopic() = default;
 
 public:
-  std::list<KafkaSegment> segmentsByTimestamp(size_t, size_t) noexcept;
+  // open - include the last segment of every partition which is not full yet
+  std::list<KafkaSegment> segmentsByTimestamp(size_t, size_t, bool open = false) noexcept;
 
   // raw pointer for reference only
   inline RdKafka::Conf* conf() const {
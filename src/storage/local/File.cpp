@@ -93,10 +93,22 @@ FileInfo File::info(const std::string& file) {
 
 size_t File::read(const std::string& file, char* buf, size_t size) {
   std::ifstream fs(file);
+  if (!fs) {
+    return 0;
+  }
+
   fs.seekg(0, std::ios::end);
   auto bytes = std::min<size_t>(fs.tellg(), size);
+  fs.seekg(0, std::ios::beg);
   fs.read(buf, bytes);
-  return bytes;
+  return fs.gcount();
+}
+
+size_t File::read(const std::string& file, const size_t offset, const size_t size, char* buf) {
+  std::ifstream fs(file, std::ios::binary);
+  fs.seekg(offset, std::ios::beg);
+  fs.read(buf, size);
+  return fs.gcount();
 }
 
 constexpr char TEMPLATE[] = "/tmp/nebula.XXXXXX";
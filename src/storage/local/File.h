@@ -34,9 +34,7 @@ public:
   virtual std::vector<FileInfo> list(const std::string& dir) override;
 
   // read a file/object at given offset and length into buffer address provided
-  virtual size_t read(const std::string&, const size_t, const size_t, char*) override {
-    throw NException("Not implemented");
-  }
+  virtual size_t read(const std::string&, const size_t, const size_t, char*) override;
 
   // read a file/object fully into a memory buffer
   virtual size_t read(const std::string&, char*, size_t) override;
@@ -47,6 +45,11 @@ public:
   virtual inline bool copy(const std::string& from, const std::string& to) override {
     // TODO(cao): it doesn't copy anything if options specified (e.g replace_existing)
     using co = std::filesystem::copy_options;
+    std::error_code ec;
+    if (!std::filesystem::exists(from, ec)) {
+      return false;
+    }
+
     std::filesystem::copy(from, to, co::overwrite_existing | co::recursive);
     return true;
   }
@@ -18,8 +18,10 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <sstream>
+#include <zlib.h>
 
 #include "storage/CsvReader.h"
+#include "storage/Decompress.h"
 
 namespace nebula {
 namespace storage {
@@ -220,6 +222,104 @@ TEST(CsvTest, TestParseFormattedNumber) {
   EXPECT_EQ(row.readInt("rank"), 99);
 }
 
+TEST(CsvTest, TestBufferParseSameAsStream) {
+  // long fields cross vectorized scan widths
+  const std::string long32(40, 'x');
+  std::vector<std::string> cases = {
+    "a,b,c\n\n\nx,y,z\r\n",
+    "a,\"b,\r\nx\"\"y\"\"\", c\na,, c\r\n,,",
+    "a,b,c,\n" + long32 + "," + long32 + "\r\n\"" + long32 + "\"\"\n\"\n",
+  };
+
+  for (const auto& text : cases) {
+    std::stringstream stream(text);
+    const char* cursor = text.data();
+    const char* end = cursor + text.size();
+    nebula::storage::CsvRow expected(',');
+    nebula::storage::CsvRow row(',');
+    while (expected.readNext(stream)) {
+      EXPECT_TRUE(row.readNext(cursor, end));
+      EXPECT_EQ(row.rawData(), expected.rawData());
+    }
+
+    EXPECT_FALSE(row.readNext(cursor, end));
+  }
+
+  const std::string bad = "a,\" \"b,c";
+  const char* cursor = bad.data();
+  nebula::storage::CsvRow row(',');
+  EXPECT_THROW(row.readNext(cursor, cursor + bad.size()), nebula::common::NebulaException);
+}
+
+TEST(CsvTest, TestSplitRanges) {
+  // every record has a quoted line break, so a chunk may start inside a quoted field
+  const auto file = "split_ranges.csv";
+  const auto rows = 1000;
+  {
+    std::ofstream out(file);
+    out << "id,note\n";
+    for (auto i = 0; i < rows; ++i) {
+      out << i << ",\"line\n" << std::string(i % 7, '"') << std::string(i % 7, '"') << "break\"\n";
+    }
+  }
+
+  nebula::meta::CsvProps csv{ true, false, "," };
+  auto ranges = nebula::storage::CsvReader::splits(file, 8, 1024);
+  EXPECT_EQ(ranges.size(), 8);
+  EXPECT_EQ(ranges.front().first, 0);
+  for (size_t i = 1; i < ranges.size(); ++i) {
+    EXPECT_EQ(ranges.at(i).first, ranges.at(i - 1).second);
+  }
+
+  // all rows are read once in order across ranges
+  auto count = 0;
+  for (const auto& range : ranges) {
+    nebula::storage::CsvReader reader(file, csv, {}, range);
+    while (reader.hasNext()) {
+      auto& r = reader.next();
+      EXPECT_EQ(r.readInt("id"), count);
+      EXPECT_EQ(r.readString("note").substr(0, 5), "line\n");
+      ++count;
+    }
+  }
+
+  EXPECT_EQ(count, rows);
+
+  // a small file is not split
+  EXPECT_EQ(nebula::storage::CsvReader::splits(file, 8, 1024 * 1024).size(), 1);
+}
+
+TEST(CsvTest, TestReadCompressedStream) {
+  // records with quoted line breaks cross windows of the stream
+  const auto file = "compressed_stream.csv.gz";
+  const auto rows = 1000;
+  {
+    auto gz = gzopen(file, "wb");
+    auto header = std::string("id,note\n");
+    gzwrite(gz, header.data(), header.size());
+    for (auto i = 0; i < rows; ++i) {
+      auto line = fmt::format("{0},\"line\n{1}break\"\n", i, std::string(2 * (i % 7), '"'));
+      gzwrite(gz, line.data(), line.size());
+    }
+    gzclose(gz);
+  }
+
+  EXPECT_EQ(nebula::storage::compressionOf(file), nebula::storage::Compression::GZIP);
+
+  nebula::meta::CsvProps csv{ true, false, "," };
+  nebula::storage::CsvReader reader(
+    file, nebula::storage::openFile(file, nebula::storage::compressionOf(file)), csv, {}, 64);
+  auto count = 0;
+  while (reader.hasNext()) {
+    auto& r = reader.next();
+    EXPECT_EQ(r.readInt("id"), count);
+    EXPECT_EQ(r.readString("note"), fmt::format("line\n{0}break", std::string(count % 7, '"')));
+    ++count;
+  }
+
+  EXPECT_EQ(count, rows);
+}
+
 } // namespace test
 } // namespace storage
 } // namespace nebula
\ No newline at end of file
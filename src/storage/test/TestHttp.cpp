@@ -15,6 +15,7 @@
  */
 
 #include <fmt/format.h>
+#include <fstream>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -51,6 +52,44 @@ TEST(HttpTest, TestBasicDownload) {
   EXPECT_EQ(info.size, 476920);
 }
 
+TEST(HttpTest, TestStreamBody) {
+  auto fs = nebula::storage::makeFS("local");
+  auto file = fs->temp();
+  std::string content;
+  for (auto i = 0; i < 100'000; ++i) {
+    content += fmt::format("{0}\n", i);
+  }
+
+  {
+    std::ofstream out(file, std::ios::binary);
+    out.write(content.data(), content.size());
+  }
+
+  // a small buffer makes the transfer wait for the reader
+  const auto url = fmt::format("file://{0}", file);
+  {
+    nebula::storage::http::HttpStream stream(url, {}, "", 1024);
+    std::string data;
+    char buf[777];
+    while (auto n = stream.read(buf, sizeof(buf))) {
+      data.append(buf, n);
+    }
+
+    EXPECT_TRUE(stream.ok());
+    EXPECT_EQ(data, content);
+  }
+
+  // a stream closed before the end aborts the transfer
+  {
+    nebula::storage::http::HttpStream stream(url, {}, "", 1024);
+    char buf[100];
+    EXPECT_GT(stream.read(buf, sizeof(buf)), 0);
+    EXPECT_FALSE(stream.ok());
+  }
+
+  fs->rm(file);
+}
+
 // disable this test and remove the api key and access token from public source.
 TEST(HttpTest, DISABLED_TestReadGoogleSheets) {
   auto url = "https://sheets.googleapis.com/v4/spreadsheets/10FP5MEDG-iGtWO8y4Wd6dyKSHcETg4sKCkBFf8DvqFQ/values:batchGet?majorDimension=COLUMNS&ranges=A%3AZ&key=<api_key>";
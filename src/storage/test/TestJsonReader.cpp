@@ -14,15 +14,35 @@
  * limitations under the License.
  */
 
+#include <cstdlib>
 #include <fmt/format.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <istream>
+#include <new>
 
 #include "memory/FlatRow.h"
 #include "storage/JsonReader.h"
 #include "type/Serde.h"
 
+// a counting allocator to verify steady state parsing doesn't allocate per row
+namespace {
+thread_local size_t allocations = 0;
+}
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (auto p = std::malloc(size)) {
+    return p;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
 namespace nebula {
 namespace storage {
 namespace test {
@@ -144,6 +164,71 @@ TEST(JsonTest, TestJsonToFlatRow) {
             << ", metadata.platform: " << flat.readString("metadata.platform");
 }
 
+TEST(JsonTest, TestRowReuseNoAllocation) {
+  auto schema = TypeSerializer::from("ROW<id:int, name:string, value:double, flag:bool, missing:bigint>");
+  std::string line = R"({"id": 7, "name": "a name longer than small string buffer", "value": 2.5, "flag": true})";
+
+  FlatRow flat{ 1024 };
+  JsonRow json{ schema };
+
+  // the first rows warm up keys of the flat row and buffers of the parser
+  for (auto i = 0; i < 2; ++i) {
+    flat.reset();
+    EXPECT_TRUE(json.parse(line.data(), line.size(), flat));
+  }
+
+  // no allocation for every following row
+  constexpr auto ROWS = 1000;
+  const auto before = allocations;
+  int64_t sum = 0;
+  for (auto i = 0; i < ROWS; ++i) {
+    flat.reset();
+    json.parse(line.data(), line.size(), flat);
+    sum += flat.readInt("id") + flat.readString("name").size();
+  }
+  const auto count = allocations - before;
+
+  EXPECT_EQ(count, 0);
+  EXPECT_EQ(sum, ROWS * (7 + 38));
+  EXPECT_TRUE(flat.isNull("missing"));
+  EXPECT_EQ(flat.readDouble("value"), 2.5);
+  EXPECT_TRUE(flat.readBool("flag"));
+}
+
+TEST(JsonTest, TestStreamingPaths) {
+  auto schema = TypeSerializer::from("ROW<id:bigint, a.b:string, list.1.v:int, ratio:int, flag:bool, none:string>");
+  FlatRow flat{ 1024 };
+  JsonRow json{ schema };
+
+  // nested objects and array items by index, numbers of other types are converted when written
+  std::string line = R"({"skip": {"a": [1, {"b": "no"}]}, "a": {"b": "yes", "c": 3},)"
+                     R"( "list": [{"v": 1}, {"v": 2}], "ratio": 2.75, "flag": 1, "none": null, "id": 12345678901})";
+  EXPECT_TRUE(json.parse(line.data(), line.size(), flat));
+  EXPECT_EQ(flat.readLong("id"), 12345678901);
+  EXPECT_EQ(flat.readString("a.b"), "yes");
+  EXPECT_EQ(flat.readInt("list.1.v"), 2);
+  EXPECT_EQ(flat.readInt("ratio"), 2);
+  EXPECT_TRUE(flat.readBool("flag"));
+  EXPECT_TRUE(flat.isNull("none"));
+
+  // parse stops once all columns are found, trailing content is not scanned
+  std::string partial = R"({"id": 1, "a": {"b": "x"}, "list": [0, {"v": 5}], "ratio": "7", "flag": false, "none": "n", ]]])";
+  flat.reset();
+  EXPECT_TRUE(json.parse(partial.data(), partial.size(), flat));
+  EXPECT_EQ(flat.readInt("list.1.v"), 5);
+  EXPECT_EQ(flat.readInt("ratio"), 7);
+  EXPECT_EQ(flat.readString("none"), "n");
+
+  // a row has to be an object
+  std::string array = "[1, 2]";
+  flat.reset();
+  EXPECT_FALSE(json.parse(array.data(), array.size(), flat));
+
+  std::string broken = R"({"id": 1, "a": )";
+  flat.reset();
+  EXPECT_FALSE(json.parse(broken.data(), broken.size(), flat));
+}
+
 } // namespace test
 } // namespace storage
-} // namespace nebula
\ No newline at end of file
+} // namespace nebula
@@ -23,7 +23,10 @@
 #include <thrift/transport/TBufferTransports.h>
 
 #include "common/Evidence.h"
+#include "memory/FlatRow.h"
 #include "meta/TableSpec.h"
+#include "storage/ThriftReader.h"
+#include "storage/kafka/KafkaConfig.h"
 #include "storage/kafka/KafkaReader.h"
 
 namespace nebula {
@@ -396,6 +399,86 @@ TEST(KafkaTest, TestKafkaSegmentSerde) {
   // EXPECT_EQ(seg, seg2);
 }
 
+TEST(KafkaTest, TestPrefetchConfig) {
+  using nebula::storage::kafka::KafkaConfig;
+  nebula::type::Settings settings;
+  {
+    KafkaConfig config{ settings };
+    std::string value;
+    EXPECT_EQ(config.globalConf->get("queued.max.messages.kbytes", value), RdKafka::Conf::CONF_OK);
+    EXPECT_EQ(value, "16384");
+    EXPECT_EQ(KafkaConfig::fetchSize(settings), KafkaConfig::FETCH_SIZE);
+  }
+
+  // user settings overwrite prefetch defaults
+  settings["kafka.queued.max.messages.kbytes"] = "4096";
+  settings["k.fetch"] = "500";
+  {
+    KafkaConfig config{ settings };
+    std::string value;
+    EXPECT_EQ(config.globalConf->get("queued.max.messages.kbytes", value), RdKafka::Conf::CONF_OK);
+    EXPECT_EQ(value, "4096");
+    EXPECT_EQ(KafkaConfig::fetchSize(settings), 500);
+  }
+
+  // invalid fetch size falls back to default
+  settings["k.fetch"] = "0";
+  EXPECT_EQ(KafkaConfig::fetchSize(settings), KafkaConfig::FETCH_SIZE);
+
+  // backlog ratio of catch up mode
+  EXPECT_EQ(KafkaConfig::catchupLag(settings), KafkaConfig::CATCHUP_LAG);
+  settings["k.catchup"] = "3";
+  EXPECT_EQ(KafkaConfig::catchupLag(settings), 3);
+}
+
+TEST(KafkaTest, TestThriftProjection) {
+  auto buffer = std::make_shared<TMemoryBuffer>();
+  TBinaryProtocol proto(buffer);
+
+  // time, a wide string not requested, a nested struct, a list and an int after it
+  proto.writeFieldBegin("", TType::T_I64, 1);
+  proto.writeI64(1600000000000);
+  proto.writeFieldBegin("", TType::T_STRING, 2);
+  proto.writeString(std::string(4096, 'x'));
+  proto.writeFieldBegin("", TType::T_STRUCT, 3);
+  proto.writeFieldBegin("", TType::T_MAP, 2);
+  proto.writeMapBegin(TType::T_STRING, TType::T_I32, 2);
+  proto.writeString("a");
+  proto.writeI32(1);
+  proto.writeString("b");
+  proto.writeI32(2);
+  proto.writeFieldBegin("", TType::T_STRING, 1);
+  proto.writeString("nebula");
+  proto.writeFieldStop();
+  proto.writeFieldBegin("", TType::T_LIST, 4);
+  proto.writeListBegin(TType::T_STRING, 3);
+  proto.writeString("1");
+  proto.writeString("22");
+  proto.writeString("333");
+  proto.writeFieldBegin("", TType::T_I32, 5);
+  proto.writeI32(42);
+  proto.writeFieldStop();
+
+  uint8_t* data;
+  uint32_t size;
+  buffer->getBuffer(&data, &size);
+
+  nebula::storage::ThriftRow thrift{
+    { { nebula::meta::Table::TIME_COLUMN, 1 }, { "name", 3001 }, { "items", 4 }, { "count", 5 }, { "missing", 6 } }
+  };
+  nebula::memory::FlatRow row{ 1024 };
+  EXPECT_TRUE(thrift.parse(data, size, row));
+  EXPECT_EQ(row.readLong(nebula::meta::Table::TIME_COLUMN), 1600000000);
+  EXPECT_EQ(row.readString("name"), "nebula");
+  EXPECT_EQ(row.readInt("items"), 3);
+  EXPECT_EQ(row.readInt("count"), 42);
+  EXPECT_TRUE(row.isNull("missing"));
+
+  // a truncated message is rejected
+  row.reset();
+  EXPECT_FALSE(thrift.parse(data, size / 2, row));
+}
+
 TEST(KafkaTest, DISABLED_TestSimpleNestedSchema) {
   nebula::meta::KafkaSerde serde;
   nebula::meta::RocksetSerde rockset;
@@ -573,8 +573,8 @@ TEST(ParquetTest, DISABLED_TestReadStatsigFile) {
   EXPECT_EQ(rows, reader.size());
 }
 
-void writeFakeFile() {
-  const auto file = "fake.parquet";
+// write a fake file of given row groups, each has 10 rows
+void writeFakeFile(const char* file = "fake.parquet", size_t groups = 1) {
   const size_t rows = 10;
   // Create a local file output stream instance.
   using FileClass = ::arrow::io::FileOutputStream;
@@ -598,52 +598,55 @@ void writeFakeFile() {
   // Create a ParquetFileWriter instance
   std::shared_ptr<parquet::ParquetFileWriter> file_writer = parquet::ParquetFileWriter::Open(out_file, schema, props);
 
-  // Append a BufferedRowGroup to keep the RowGroup open until a certain size
-  parquet::RowGroupWriter* rg_writer = file_writer->AppendBufferedRowGroup();
-  for (size_t i = 0; i < rows; i++) {
-    int col_id = 0;
-    // write name
-    {
-      parquet::ByteArrayWriter* name_writer = static_cast<parquet::ByteArrayWriter*>(rg_writer->column(col_id));
-      parquet::ByteArray value;
-      const char* name = "parquet";
-      value.ptr = reinterpret_cast<const uint8_t*>(name);
-      value.len = 7;
-      int16_t definition_level = 1;
-      name_writer->WriteBatch(1, &definition_level, nullptr, &value);
-    }
+  for (size_t g = 0; g < groups; ++g) {
+    // Append a BufferedRowGroup to keep the RowGroup open until a certain size
+    parquet::RowGroupWriter* rg_writer = file_writer->AppendBufferedRowGroup();
+    for (size_t i = g * rows; i < (g + 1) * rows; i++) {
+      int col_id = 0;
+      // write name
+      {
+        parquet::ByteArrayWriter* name_writer = static_cast<parquet::ByteArrayWriter*>(rg_writer->column(col_id));
+        parquet::ByteArray value;
+        const char* name = "parquet";
+        value.ptr = reinterpret_cast<const uint8_t*>(name);
+        value.len = 7;
+        int16_t definition_level = 1;
+        name_writer->WriteBatch(1, &definition_level, nullptr, &value);
+      }
 
-    // write isMale
-    {
-      col_id++;
-      parquet::BoolWriter* bool_writer = static_cast<parquet::BoolWriter*>(rg_writer->column(col_id));
-      bool bool_value = ((i % 2) == 0) ? true : false;
-      bool_writer->WriteBatch(1, nullptr, nullptr, &bool_value);
-    }
+      // write isMale
+      {
+        col_id++;
+        parquet::BoolWriter* bool_writer = static_cast<parquet::BoolWriter*>(rg_writer->column(col_id));
+        bool bool_value = ((i % 2) == 0) ? true : false;
+        bool_writer->WriteBatch(1, nullptr, nullptr, &bool_value);
+      }
 
-    // write age
-    {
-      col_id++;
-      parquet::Int32Writer* int32_writer = static_cast<parquet::Int32Writer*>(rg_writer->column(col_id));
-      int32_t int32_value = i;
-      int32_writer->WriteBatch(1, nullptr, nullptr, &int32_value);
-    }
+      // write age
+      {
+        col_id++;
+        parquet::Int32Writer* int32_writer = static_cast<parquet::Int32Writer*>(rg_writer->column(col_id));
+        int32_t int32_value = i;
+        int32_writer->WriteBatch(1, nullptr, nullptr, &int32_value);
+      }
 
-    // write score as a string
-    {
-      col_id++;
-      parquet::ByteArrayWriter* score_writer = static_cast<parquet::ByteArrayWriter*>(rg_writer->column(col_id));
-      parquet::ByteArray value;
-      const char* score = "123.45";
-      value.ptr = reinterpret_cast<const uint8_t*>(score);
-      value.len = 6;
-      int16_t definition_level = 1;
-      score_writer->WriteBatch(1, &definition_level, nullptr, &value);
+      // write score as a string
+      {
+        col_id++;
+        parquet::ByteArrayWriter* score_writer = static_cast<parquet::ByteArrayWriter*>(rg_writer->column(col_id));
+        parquet::ByteArray value;
+        const char* score = "123.45";
+        value.ptr = reinterpret_cast<const uint8_t*>(score);
+        value.len = 6;
+        int16_t definition_level = 1;
+        score_writer->WriteBatch(1, &definition_level, nullptr, &value);
+      }
     }
+
+    // Close the RowGroupWriter
+    rg_writer->Close();
   }
 
-  // Close the RowGroupWriter
-  rg_writer->Close();
   // Close the ParquetFileWriter
   file_writer->Close();
 
@@ -669,6 +672,119 @@ TEST(ParquetTest, TestTypeConversion) {
   EXPECT_EQ(rows, 10);
 }
 
+TEST(ParquetTest, TestRowGroupRange) {
+  auto localFile = "fake_groups.parquet";
+  writeFakeFile(localFile, 3);
+  auto schema = TypeSerializer::from("ROW<name:string, age:int>");
+
+  // every reader covers a range of row groups only
+  ParquetReader first(localFile, schema, {}, 0, 1);
+  ParquetReader rest(localFile, schema, {}, 1, 5);
+  EXPECT_EQ(first.groups(), 3);
+  EXPECT_EQ(first.size(), 10);
+  EXPECT_EQ(rest.size(), 20);
+
+  auto rows = 0;
+  for (auto reader : { &first, &rest }) {
+    while (reader->hasNext()) {
+      const auto& r = reader->next();
+      EXPECT_EQ(r.readString("name"), "parquet");
+      EXPECT_EQ(r.readInt("age"), rows++);
+    }
+  }
+
+  EXPECT_EQ(rows, 30);
+}
+
+TEST(ParquetTest, TestReadStream) {
+  auto localFile = "fake_stream.parquet";
+  writeFakeFile(localFile, 3);
+  auto schema = TypeSerializer::from("ROW<name:string, age:int>");
+
+  // the file is read by ranges as if it is a remote object
+  nebula::storage::local::File fs;
+  std::shared_ptr<nebula::storage::InputStream> stream = fs.open(localFile);
+  ParquetReader first(stream, schema, {}, 0, 2);
+  ParquetReader rest(stream, schema, {}, 2, 1);
+  EXPECT_EQ(first.size(), 20);
+  EXPECT_EQ(rest.size(), 10);
+
+  auto rows = 0;
+  for (auto reader : { &first, &rest }) {
+    while (reader->hasNext()) {
+      const auto& r = reader->next();
+      EXPECT_EQ(r.readString("name"), "parquet");
+      EXPECT_EQ(r.readInt("age"), rows++);
+    }
+  }
+
+  EXPECT_EQ(rows, 30);
+}
+
+TEST(ParquetTest, TestColumnarRead) {
+  auto localFile = "fake_columns.parquet";
+  writeFakeFile(localFile, 3);
+  auto schema = TypeSerializer::from("ROW<name:string, isMale:boolean, age:bigint, score:double>");
+  ParquetReader reader(localFile, schema);
+
+  // strings are not parsed into numbers by batch reads
+  const std::vector<std::string> names{ "name", "isMale", "age" };
+  EXPECT_TRUE(reader.columnar(names));
+  EXPECT_FALSE(reader.columnar({ "score" }));
+  EXPECT_FALSE(reader.columnar({ "nothing" }));
+
+  // a batch doesn't span row groups
+  std::vector<ParquetColumn> columns;
+  std::vector<size_t> batches;
+  size_t rows = 0;
+  size_t read = 0;
+  while ((read = reader.read(names, 4, columns)) > 0) {
+    batches.push_back(read);
+    ASSERT_EQ(columns.size(), 3);
+    const auto& name = columns.at(0);
+    const auto isMale = reinterpret_cast<const bool*>(columns.at(1).values.data());
+    const auto age = reinterpret_cast<const int64_t*>(columns.at(2).values.data());
+    for (size_t i = 0; i < read; ++i, ++rows) {
+      EXPECT_FALSE(name.isNull(i));
+      const auto str = name.source != nullptr ? name.dict.at(name.codes.at(i)) : name.views.at(i);
+      EXPECT_EQ(str, "parquet");
+      EXPECT_EQ(isMale[i], rows % 2 == 0);
+      EXPECT_EQ(age[i], rows);
+    }
+  }
+
+  EXPECT_EQ(rows, 30);
+  EXPECT_EQ(batches, std::vector<size_t>({ 4, 4, 2, 4, 4, 2, 4, 4, 2 }));
+}
+
+TEST(ParquetTest, TestPruneRowGroups) {
+  auto localFile = "fake_prune.parquet";
+  writeFakeFile(localFile, 3);
+  auto schema = TypeSerializer::from("ROW<name:string, age:int>");
+
+  // ages of the 3 groups are [0, 9], [10, 19], [20, 29]
+  ParquetReader reader(localFile, schema);
+  EXPECT_EQ(reader.prune({ { "age", nebula::meta::FilterOp::GE, "12" }, { "age", nebula::meta::FilterOp::LT, "20" } }), 2);
+  EXPECT_EQ(reader.size(), 10);
+
+  auto rows = 0;
+  while (reader.hasNext()) {
+    const auto& r = reader.next();
+    EXPECT_EQ(r.readInt("age"), 10 + rows++);
+  }
+
+  EXPECT_EQ(rows, 10);
+
+  // statistics of strings and values not in any group
+  ParquetReader none(localFile, schema);
+  EXPECT_EQ(none.prune({ { "name", nebula::meta::FilterOp::NE, "parquet" } }), 3);
+  EXPECT_FALSE(none.hasNext());
+
+  ParquetReader all(localFile, schema);
+  EXPECT_EQ(all.prune({ { "age", nebula::meta::FilterOp::EQ, "abc" }, { "name", nebula::meta::FilterOp::NOTNULL, "" } }), 0);
+  EXPECT_EQ(all.size(), 30);
+}
+
 } // namespace test
 } // namespace storage
 } // namespace nebula
\ No newline at end of file
@@ -14,13 +14,20 @@
  * limitations under the License.
  */
 
+#include <cstring>
 #include <filesystem>
 #include <fmt/format.h>
 #include <fstream>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <lz4frame.h>
+#include <zstd.h>
 
 #include "common/Chars.h"
+#include "common/Errors.h"
+#include "storage/Decompress.h"
+#include "storage/Fetch.h"
+#include "storage/InputStream.h"
 #include "storage/NFS.h"
 #include "storage/aws/S3.h"
 #include "storage/azure/DataLake.h"
@@ -86,6 +93,145 @@ TEST(StorageTest, TestLocalCopy) {
   EXPECT_TRUE(fs->sync("configs", "/tmp/testconfigs"));
 }
 
+TEST(StorageTest, TestInputStream) {
+  auto fs = nebula::storage::makeFS("local");
+  auto file = fs->temp();
+  std::string content(100'000, '\0');
+  for (size_t i = 0; i < content.size(); ++i) {
+    content[i] = 'a' + i % 26;
+  }
+
+  {
+    std::ofstream out(file, std::ios::binary);
+    out.write(content.data(), content.size());
+  }
+
+  // small chunks to cross many of them
+  nebula::storage::InputStream stream(*fs, file, content.size(), 1000, 4);
+  std::string data(content.size(), '\0');
+  size_t bytes = 0;
+  size_t step = 1;
+  while (auto n = stream.read(data.data() + bytes, step)) {
+    bytes += n;
+    step = step * 3 % 4099 + 1;
+  }
+
+  EXPECT_EQ(bytes, content.size());
+  EXPECT_EQ(data, content);
+
+  // seek backward and read across chunks
+  char buf[2500];
+  stream.seek(12345);
+  EXPECT_EQ(stream.read(buf, sizeof(buf)), sizeof(buf));
+  EXPECT_EQ(std::string_view(buf, sizeof(buf)), std::string_view(content).substr(12345, sizeof(buf)));
+
+  // positioned read of a large range in parallel parts, clipped by the end
+  std::string tail(50'000, '\0');
+  EXPECT_EQ(stream.pread(60'000, tail.size(), tail.data()), 40'000);
+  EXPECT_EQ(tail.substr(0, 40'000), content.substr(60'000));
+  EXPECT_EQ(stream.pread(content.size(), 10, buf), 0);
+
+  // the file system opens the stream by file info
+  auto opened = fs->open(file);
+  EXPECT_EQ(opened->size(), content.size());
+  fs->rm(file);
+}
+
+TEST(StorageTest, TestDecompressStream) {
+  std::string content;
+  for (auto i = 0; i < 10'000; ++i) {
+    content += fmt::format("line {0}\n", i);
+  }
+
+  // two frames in one source are read as one
+  auto zstd = [](const std::string& data) {
+    std::string out(ZSTD_compressBound(data.size()), '\0');
+    out.resize(ZSTD_compress(out.data(), out.size(), data.data(), data.size(), 3));
+    return out;
+  };
+
+  auto lz4 = [](const std::string& data) {
+    std::string out(LZ4F_compressFrameBound(data.size(), nullptr), '\0');
+    out.resize(LZ4F_compressFrame(out.data(), out.size(), data.data(), data.size(), nullptr));
+    return out;
+  };
+
+  const auto half = content.size() / 2;
+  const std::vector<std::pair<nebula::storage::Compression, std::string>> cases = {
+    { nebula::storage::Compression::NONE, content },
+    { nebula::storage::Compression::ZSTD, zstd(content.substr(0, half)) + zstd(content.substr(half)) },
+    { nebula::storage::Compression::LZ4, lz4(content.substr(0, half)) + lz4(content.substr(half)) },
+  };
+
+  for (const auto& c : cases) {
+    // small chunks to decode across many of them
+    size_t offset = 0;
+    const auto& source = c.second;
+    nebula::storage::DecompressBuffer buffer(
+      c.first,
+      [&source, &offset](char* buf, size_t size) {
+        const auto n = std::min(size, source.size() - offset);
+        std::memcpy(buf, source.data() + offset, n);
+        offset += n;
+        return n;
+      },
+      100);
+
+    std::istream stream(&buffer);
+    std::string data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(data, content);
+  }
+
+  EXPECT_EQ(nebula::storage::compressionOf("s3://bucket/a.json.zst"), nebula::storage::Compression::ZSTD);
+  EXPECT_EQ(nebula::storage::compressionOf("a.csv.lz4"), nebula::storage::Compression::LZ4);
+  EXPECT_EQ(nebula::storage::compressionOf("a.csv"), nebula::storage::Compression::NONE);
+  EXPECT_EQ(nebula::storage::compressionOf("a.csv", "GZIP"), nebula::storage::Compression::GZIP);
+  EXPECT_THROW(nebula::storage::compressionOf("a.csv", "xz"), nebula::common::NebulaException);
+}
+
+TEST(StorageTest, TestFetchPoolList) {
+  auto fs = nebula::storage::makeFS("local");
+  auto dir = fs->temp(true);
+  std::vector<nebula::storage::ListRequest> requests;
+  for (auto i = 0; i < 10; ++i) {
+    auto sub = fmt::format("{0}/{1}", dir, i);
+    std::filesystem::create_directory(sub);
+    for (auto j = 0; j < i; ++j) {
+      std::ofstream(fmt::format("{0}/f{1}", sub, j)).put('a');
+    }
+
+    // odd ones are settled
+    requests.push_back({ sub, i % 2 == 1 });
+  }
+
+  nebula::storage::FetchPool pool(4, 3600);
+  auto listings = pool.list(*fs, "local", requests);
+  EXPECT_EQ(listings.size(), requests.size());
+  for (size_t i = 0; i < listings.size(); ++i) {
+    EXPECT_EQ(listings.at(i).size(), i);
+  }
+
+  // a new file is seen by unsettled paths only, settled ones are served from cache
+  for (auto i = 0; i < 10; ++i) {
+    std::ofstream(fmt::format("{0}/{1}/new", dir, i)).put('a');
+  }
+
+  listings = pool.list(*fs, "local", requests);
+  for (size_t i = 0; i < listings.size(); ++i) {
+    EXPECT_EQ(listings.at(i).size(), i % 2 == 1 ? i : i + 1);
+  }
+
+  pool.clear();
+  listings = pool.list(*fs, "local", requests);
+  for (size_t i = 0; i < listings.size(); ++i) {
+    EXPECT_EQ(listings.at(i).size(), i + 1);
+  }
+
+  // requests run in the pool
+  EXPECT_EQ(pool.submit([]() { return 7; }).get(), 7);
+  std::filesystem::remove_all(dir);
+}
+
 TEST(StorageTest, DISABLED_TestS3Api) {
   auto fs = nebula::storage::makeFS("s3", "<bucket>");
   auto keys = fs->list("nebula/pin_messages/");
@@ -19,10 +19,12 @@
 #include <cstdint>
 #include <optional>
 #include <string_view>
+#include <type_traits>
 
 #include "common/Cursor.h"
 #include "common/Errors.h"
 #include "common/Int128.h"
+#include "type/Type.h"
 
 #include "eval/Aggregator.h"
 
@@ -67,7 +69,9 @@ public:
   }
 };
 
-// (TODO) CRTP - avoid virtual methods?
+// row data is read through virtual methods across modules.
+// internal hot paths take the concrete row type as a template parameter instead (see read below),
+// so reading a row type declared final is bound statically and can be inlined.
 class RowData {
 public:
   RowData() {
@@ -124,6 +128,41 @@ public:
 #undef NOT_IMPL_FUNC
 };
 
+// read a value of kind K by index from a row of type R, which is a static call if R is final
+template <nebula::type::Kind K, typename R>
+inline typename nebula::type::TypeTraits<K>::CppType read(const R& row, IndexType index) {
+  static_assert(std::is_base_of_v<RowData, R>, "read from a row data");
+  if constexpr (K == nebula::type::Kind::BOOLEAN) {
+    return row.readBool(index);
+  } else if constexpr (K == nebula::type::Kind::TINYINT) {
+    return row.readByte(index);
+  } else if constexpr (K == nebula::type::Kind::SMALLINT) {
+    return row.readShort(index);
+  } else if constexpr (K == nebula::type::Kind::INTEGER) {
+    return row.readInt(index);
+  } else if constexpr (K == nebula::type::Kind::BIGINT) {
+    return row.readLong(index);
+  } else if constexpr (K == nebula::type::Kind::REAL) {
+    return row.readFloat(index);
+  } else if constexpr (K == nebula::type::Kind::DOUBLE) {
+    return row.readDouble(index);
+  } else if constexpr (K == nebula::type::Kind::INT128) {
+    return row.readInt128(index);
+  } else {
+    static_assert(K == nebula::type::Kind::VARCHAR, "scalar kinds only");
+    return row.readString(index);
+  }
+}
+
+// a row type computing its values on read (eg. computed row) may give a scalar value and its validity
+// in one evaluation by "std::optional<CppType> value<K>(IndexType) const", which is used in place of isNull + readX
+template <typename R, typename = void>
+struct Evaluated : std::false_type {};
+
+template <typename R>
+struct Evaluated<R, std::void_t<decltype(std::declval<const R&>().template value<nebula::type::Kind::BOOLEAN>(0))>>
+  : std::true_type {};
+
 class ListData {
 public:
   ListData(IndexType items) : items_{ items } {
@@ -179,6 +218,35 @@ public:
   virtual std::optional<double> readDouble(const std::string&) const = 0;
   virtual std::optional<int128_t> readInt128(const std::string&) const = 0;
   virtual std::optional<std::string_view> readString(const std::string&) const = 0;
+
+  // list of an array column, nullptr if the list is NULL or empty, or the accessor doesn't support lists
+  virtual std::unique_ptr<ListData> readList(const std::string&) const {
+    return nullptr;
+  }
+
+  // resolve a column to an index which can be used by index based reads below
+  // nullopt if the accessor doesn't support index based reads for the column
+  virtual std::optional<IndexType> index(const std::string&) const {
+    return std::nullopt;
+  }
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+#define NOT_IMPL_FUNC(TYPE, FUNC)                                 \
+  virtual std::optional<TYPE> FUNC(IndexType) const {             \
+    throw NException(#FUNC " (IndexType index) not implemented"); \
+  }
+
+  NOT_IMPL_FUNC(bool, readBool)
+  NOT_IMPL_FUNC(int8_t, readByte)
+  NOT_IMPL_FUNC(int16_t, readShort)
+  NOT_IMPL_FUNC(int32_t, readInt)
+  NOT_IMPL_FUNC(int64_t, readLong)
+  NOT_IMPL_FUNC(float, readFloat)
+  NOT_IMPL_FUNC(double, readDouble)
+  NOT_IMPL_FUNC(int128_t, readInt128)
+  NOT_IMPL_FUNC(std::string_view, readString)
+
+#undef NOT_IMPL_FUNC
 };
 
 } // namespace surface
@@ -17,7 +17,8 @@
 #pragma once
 
 #include <algorithm>
-#include <queue>
+#include <numeric>
+#include <vector>
 #include "DataSurface.h"
 #include "common/Cursor.h"
 
@@ -27,42 +28,24 @@
 namespace nebula {
 namespace surface {
 class TopRows : public RowCursor {
-  using Less = std::function<bool(const std::unique_ptr<RowData>&, const std::unique_ptr<RowData>&)>;
-
 public:
-  // top rows will pick sorted top N rows, if max is 0, it means we don't apply limit and return all
-  TopRows(const RowCursorPtr& rows, size_t max, Less less)
-    : RowCursor(max == 0 ? rows->size() : std::min(max, rows->size())),
-      heap_(rows->size()),
-      rows_{ rows } {
-    // build heap / priority queue
-    if (less != nullptr) {
-      compare_ = [this, func = std::move(less)](size_t left, size_t right) -> bool {
-        return func(rows_->item(left), rows_->item(right));
-      };
+  // top rows returns rows of given indices in the order, which are sorted top N rows of the cursor
+  TopRows(const RowCursorPtr& rows, std::vector<size_t> order)
+    : RowCursor(order.size()), sorted_{ true }, order_{ std::move(order) }, rows_{ rows } {}
 
-      // fill the vector with its index
-      std::iota(heap_.begin(), heap_.end(), 0);
-      std::make_heap(heap_.begin(), heap_.end(), compare_);
-    }
-  }
+  // no sorting, top rows pick the first N rows, if max is 0, it means we don't apply limit and return all
+  TopRows(const RowCursorPtr& rows, size_t max)
+    : RowCursor(max == 0 ? rows->size() : std::min(max, rows->size())), sorted_{ false }, rows_{ rows } {}
 
-  // TODO(cao) - might be too expensive if there are many items/rows to iterate on
   virtual const RowData& next() override {
-    // stop condition
-    index_++;
-
-    // no need heap
-    if (!compare_) {
+    // no order needed
+    if (!sorted_) {
+      index_++;
       return rows_->next();
     }
 
-    // fetch the top one and return its value
-    std::pop_heap(heap_.begin(), heap_.end(), compare_);
-    auto top = heap_.back();
-    heap_.pop_back();
-
-    current_ = rows_->item(top);
+    // only top N rows are materialized, one at a time
+    current_ = rows_->item(order_.at(index_++));
     return *current_;
   }
 
@@ -70,13 +53,29 @@ public:
     throw NException("Top rows do not support random access.");
   }
 
+  // the cursor rows are picked from
+  inline const RowCursorPtr& rows() const noexcept {
+    return rows_;
+  }
+
+  // indices of the picked rows in the order
+  std::vector<size_t> order() const {
+    if (sorted_) {
+      return order_;
+    }
+
+    std::vector<size_t> first(size_);
+    std::iota(first.begin(), first.end(), 0);
+    return first;
+  }
+
 private:
-  std::vector<size_t> heap_;
+  bool sorted_;
+  std::vector<size_t> order_;
   RowCursorPtr rows_;
-  std::function<bool(size_t, size_t)> compare_;
 
   std::unique_ptr<RowData> current_;
-}; // namespace surface
+};
 
 } // namespace surface
 } // namespace nebula
\ No newline at end of file
@@ -16,7 +16,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <any>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include "Histogram.h"
+#include "Selection.h"
+#include "common/StringHead.h"
 #include "type/Type.h"
 
 /**
@@ -27,6 +38,45 @@
 namespace nebula {
 namespace surface {
 namespace eval {
+
+// raw view of a fixed-width scalar column in a data block
+// value of row i is laid out at data + i * width, NULL rows are filled with 0
+// data is nullptr if the column is encoded, values are read by Block::decode in batches instead
+struct ScalarColumn {
+  const void* data;
+  // column has NULL rows or not
+  bool nullable;
+  // if column has default value, NULL rows read as default value instead of NULL
+  std::any defaultValue;
+};
+
+// raw view of a string column in a data block by a 16 bytes head per row
+// a string longer than StringHead::INLINE is read from heap by its head, NULL rows have empty heads
+struct StringColumn {
+  const nebula::common::StringHead* heads;
+  // column has NULL rows or not
+  bool nullable;
+  std::function<std::string_view(const nebula::common::StringHead&)> heap;
+};
+
+// raw view of an array column in a data block, elements of all lists are stored in one flat element column.
+// elements of row i are [offsets[i], offsets[i + 1]) of the element column for every row before rows,
+// which is read as a column named by items in the same block. NULL and empty lists have no elements.
+struct ListColumn {
+  const size_t* offsets;
+  size_t rows;
+  std::string items;
+  // kind of elements
+  nebula::type::Kind kind;
+};
+
+// rows [first, last) of a block sharing the same value of a partition column, the value is partition values[code]
+struct Run {
+  size_t first;
+  size_t last;
+  size_t code;
+};
+
 class Block {
 public:
   virtual ~Block() = default;
@@ -44,11 +94,301 @@ public:
   // get column histogram
   virtual std::shared_ptr<Histogram> histogram(const std::string&) const = 0;
 
+  // check if column histogram covers every stored row of the block
+  // false for columns whose values are not recorded in histogram, eg. partition columns, columns having default value
+  virtual bool exact(const std::string&) const {
+    return false;
+  }
+
   // get column partition values - empty if not a partition column
   virtual std::vector<std::any> partitionValues(const std::string&) const = 0;
 
   // check if a value is probably in the block
   virtual bool probably(const std::string&, std::any) const = 0;
+
+  // get raw data of a scalar column, nullopt if the column is not stored contiguously
+  // such as partition columns, in which case callers should read values row by row
+  virtual std::optional<ScalarColumn> scalar(const std::string&) const {
+    return std::nullopt;
+  }
+
+  // get string heads of a string column, nullopt if values are not stored by heads
+  // such as partition columns, dictionary encoded columns or columns having default value
+  virtual std::optional<StringColumn> strings(const std::string&) const {
+    return std::nullopt;
+  }
+
+  // get offsets and element column of an array column, nullopt if the column is not an array column
+  virtual std::optional<ListColumn> list(const std::string&) const {
+    return std::nullopt;
+  }
+
+  // decode values of an encoded scalar column for rows [start, start + count) into given buffer
+  // buffer type is the column's native type, return false if the column is not encoded
+  virtual bool decode(const std::string&, size_t, size_t, void*) const {
+    return false;
+  }
+
+  // rows [first, last) of the block, out of which no row has value of given integer column in range [low, high]
+  // it is the whole block if the column can't tell.
+  virtual std::pair<size_t, size_t> rows(const std::string&, int64_t, int64_t) const {
+    return { 0, getRows() };
+  }
+
+  // evaluate low <= value <= high of an integer column for rows [start, start + count) into mask on its packed values,
+  // NULL rows are evaluated as value 0. return false if the column is not bit packed
+  virtual bool match(const std::string&, int64_t, int64_t, size_t, size_t, uint8_t*) const {
+    return false;
+  }
+
+  // collect NULL rows of a column in range [start, end)
+  virtual void nulls(const std::string&, size_t, size_t, Selection&) const {}
+
+  // write 1 into mask for non-null rows of a column in [start, start + count) and 0 for NULL rows,
+  // from a dense validity bitmap. return false if the column has none, NULL rows are collected by nulls then
+  virtual bool valid(const std::string&, size_t, size_t, uint8_t*) const {
+    return false;
+  }
+
+  // number of rows in every stripe of zone map, 0 if the block has no zone map
+  virtual size_t zoneRows() const {
+    return 0;
+  }
+
+  // histogram of a column in given stripe of rows, nullptr if the column has no zone map
+  virtual std::shared_ptr<Histogram> zone(const std::string&, size_t) const {
+    return nullptr;
+  }
+
+  // number of distinct items of a dictionary encoded string column, 0 if the column is not dictionary encoded
+  virtual size_t dictSize(const std::string&) const {
+    return 0;
+  }
+
+  // dictionary item of given code in a dictionary encoded string column
+  virtual std::string_view dictItem(const std::string&, int32_t) const {
+    return {};
+  }
+
+  // number of distinct values of a column, estimated by the block when it is sealed, 0 if unknown
+  virtual size_t distinctValues(const std::string&) const {
+    return 0;
+  }
+
+  // keep selected rows whose dictionary codes are marked in the given code map, NULL rows are removed
+  virtual void selectCodes(const std::string&, const std::vector<bool>&, Selection&) const {}
+
+  // number of distinct terms in the token index of a string column, 0 if the column has no token index
+  virtual size_t terms(const std::string&) const {
+    return 0;
+  }
+
+  // flag of every row of a string column having any term in its token index matched by the predicate
+  virtual std::vector<bool> matchTerms(const std::string&, const std::function<bool(std::string_view)>&) const {
+    return {};
+  }
+
+  // number of distinct values in the bitmap index of a column, 0 if the column has no bitmap index.
+  // indexed values are given to predicates as int64_t for integer columns and string_view for string columns.
+  virtual size_t bitmapValues(const std::string&) const {
+    return 0;
+  }
+
+  // flag of every row of a column whose value in its bitmap index is matched by the predicate
+  virtual std::vector<bool> matchBitmap(const std::string&, const std::function<bool(const std::any&)>&) const {
+    return {};
+  }
+
+  // number of rows of a column whose value in its bitmap index is matched by the predicate
+  virtual size_t countBitmap(const std::string&, const std::function<bool(const std::any&)>&) const {
+    return 0;
+  }
+
+  // append runs of a partition column over rows [start, end) in order, codes index its partition values.
+  // return false if the column is not a partition column
+  virtual bool runs(const std::string&, size_t, size_t, std::vector<Run>&) const {
+    return false;
+  }
+};
+
+// a stripe of rows in a block viewed as a block, its histogram comes from zone map of the stripe
+// so that block evaluation of an expression can tell if a stripe could be skipped.
+// columns without zone map use histogram of the whole block which still bounds the stripe.
+class Stripe : public Block {
+public:
+  Stripe(const Block& block, size_t index)
+    : block_{ block },
+      index_{ index },
+      rows_{ std::min(block.zoneRows(), block.getRows() - std::min(block.getRows(), index * block.zoneRows())) } {}
+  virtual ~Stripe() = default;
+
+public:
+  inline nebula::type::Schema schema() const override {
+    return block_.schema();
+  }
+
+  inline size_t getRows() const override {
+    return rows_;
+  }
+
+  inline nebula::type::TypeNode columnType(const std::string& col) const override {
+    return block_.columnType(col);
+  }
+
+  inline std::shared_ptr<Histogram> histogram(const std::string& col) const override {
+    auto zone = block_.zone(col, index_);
+    return zone ? zone : block_.histogram(col);
+  }
+
+  inline std::vector<std::any> partitionValues(const std::string& col) const override {
+    return block_.partitionValues(col);
+  }
+
+  inline bool probably(const std::string& col, std::any v) const override {
+    return block_.probably(col, v);
+  }
+
+private:
+  const Block& block_;
+  size_t index_;
+  size_t rows_;
+};
+
+// histogram covering the whole range of a column type, a block having it for the column can't be pruned by it
+inline std::shared_ptr<Histogram> fullRange(const nebula::type::TypeNode& type, size_t rows) {
+  switch (type->k()) {
+#define FULL_RANGE(KIND, HT)                                                                               \
+  case nebula::type::Kind::KIND: {                                                                         \
+    using T = nebula::type::TypeTraits<nebula::type::Kind::KIND>::CppType;                                 \
+    return std::make_shared<HT>(rows, std::numeric_limits<T>::lowest(), std::numeric_limits<T>::max(), 0); \
+  }
+
+    FULL_RANGE(TINYINT, IntHistogram)
+    FULL_RANGE(SMALLINT, IntHistogram)
+    FULL_RANGE(INTEGER, IntHistogram)
+    FULL_RANGE(BIGINT, IntHistogram)
+    FULL_RANGE(REAL, RealHistogram)
+    FULL_RANGE(DOUBLE, RealHistogram)
+
+#undef FULL_RANGE
+  case nebula::type::Kind::BOOLEAN: return std::make_shared<BoolHistogram>(rows, rows / 2);
+  case nebula::type::Kind::VARCHAR: return std::make_shared<StringHistogram>(rows, "", "");
+  default: return std::make_shared<Histogram>(rows);
+  }
+}
+
+// partition values of a block viewed as a block, every other column is taken as having all values of its type.
+// block evaluation of an expression on it can only tell by partition values, so a result other than PARTIAL
+// holds for every block of the same partition, partitioned blocks are pruned once per partition this way.
+class PartitionView : public Block {
+public:
+  explicit PartitionView(const Block& block) : block_{ block } {}
+  virtual ~PartitionView() = default;
+
+public:
+  inline nebula::type::Schema schema() const override {
+    return block_.schema();
+  }
+
+  inline size_t getRows() const override {
+    return block_.getRows();
+  }
+
+  inline nebula::type::TypeNode columnType(const std::string& col) const override {
+    return block_.columnType(col);
+  }
+
+  // histogram covering the whole range of the column type
+  inline std::shared_ptr<Histogram> histogram(const std::string& col) const override {
+    return fullRange(columnType(col), getRows());
+  }
+
+  inline std::vector<std::any> partitionValues(const std::string& col) const override {
+    return block_.partitionValues(col);
+  }
+
+  inline bool probably(const std::string&, std::any) const override {
+    return true;
+  }
+
+private:
+  const Block& block_;
+};
+
+// a block known by its summary only: number of rows and histogram of every column in schema order,
+// or in order of given column names for a block of another schema version, such as a block of another node
+// synced to server. Block evaluation of an expression on it tells
+// if the block could match without its data, a column with no histogram of its type is taken as having all values.
+// it has no partition values nor bloom filters, so it can't be used for partitioned blocks.
+class SummaryView : public Block {
+public:
+  SummaryView(nebula::type::Schema schema,
+              size_t rows,
+              const HistVector& histograms,
+              const std::vector<std::string>* columns = nullptr)
+    : schema_{ std::move(schema) }, rows_{ rows }, histograms_{ histograms }, columns_{ columns } {}
+  virtual ~SummaryView() = default;
+
+public:
+  inline nebula::type::Schema schema() const override {
+    return schema_;
+  }
+
+  inline size_t getRows() const override {
+    return rows_;
+  }
+
+  inline nebula::type::TypeNode columnType(const std::string& col) const override {
+    return schema_->find(col);
+  }
+
+  std::shared_ptr<Histogram> histogram(const std::string& col) const override {
+    nebula::type::TypeNode type;
+    auto index = schema_->onChild(col, [&type](const nebula::type::TypeNode& t) { type = t; });
+    if (!type) {
+      return std::make_shared<Histogram>(rows_);
+    }
+
+    if (columns_) {
+      index = static_cast<size_t>(std::distance(columns_->begin(), std::find(columns_->begin(), columns_->end(), col)));
+    }
+
+    if (index < histograms_.size() && typed(type->k(), histograms_.at(index))) {
+      return histograms_.at(index);
+    }
+
+    return fullRange(type, rows_);
+  }
+
+  inline std::vector<std::any> partitionValues(const std::string&) const override {
+    return {};
+  }
+
+  inline bool probably(const std::string&, std::any) const override {
+    return true;
+  }
+
+private:
+  // histogram is of the type which block evaluation casts it to for the column kind
+  static bool typed(nebula::type::Kind kind, const std::shared_ptr<Histogram>& h) {
+    switch (kind) {
+    case nebula::type::Kind::TINYINT:
+    case nebula::type::Kind::SMALLINT:
+    case nebula::type::Kind::INTEGER:
+    case nebula::type::Kind::BIGINT: return std::dynamic_pointer_cast<IntHistogram>(h) != nullptr;
+    case nebula::type::Kind::REAL:
+    case nebula::type::Kind::DOUBLE: return std::dynamic_pointer_cast<RealHistogram>(h) != nullptr;
+    case nebula::type::Kind::BOOLEAN: return std::dynamic_pointer_cast<BoolHistogram>(h) != nullptr;
+    case nebula::type::Kind::VARCHAR: return std::dynamic_pointer_cast<StringHistogram>(h) != nullptr;
+    default: return h != nullptr;
+    }
+  }
+
+private:
+  nebula::type::Schema schema_;
+  size_t rows_;
+  const HistVector& histograms_;
+  const std::vector<std::string>* columns_;
 };
 
 } // namespace eval
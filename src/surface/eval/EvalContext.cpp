@@ -16,6 +16,10 @@
 
 #include "EvalContext.h"
 
+#include <mutex>
+
+#include "common/Errors.h"
+
 /**
  * Value evaluation context.
  * It provides same expression evaluation cache.
@@ -26,17 +30,67 @@ namespace nebula {
 namespace surface {
 namespace eval {
 
+size_t ColumnRef::intern(const std::string& name) {
+  // number of distinct column names is small, ids are never recycled
+  static std::mutex lock;
+  static nebula::common::unordered_map<std::string, size_t> ids;
+
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = ids.find(name);
+  if (it != ids.end()) {
+    return it->second;
+  }
+
+  const auto id = ids.size();
+  ids.emplace(name, id);
+  return id;
+}
+
 // reset to a new row
 void EvalContext::reset(const nebula::surface::Accessor& row) {
   // std::addressof ?
   this->row_ = &row;
+  this->pos_ = NPOS;
 
   if (N_UNLIKELY(cache_ != nullptr)) {
-    // clear t he evaluation map
-    cache_.reset();
+    // values cached for previous row are stale
+    cache_->reset();
   }
 }
 
+void EvalContext::span(const Seeker& seeker, const Selection& selection) {
+  seeker_ = &seeker;
+  span_ = &selection;
+  spans_.clear();
+}
+
+void EvalContext::reset(const nebula::surface::Accessor& row, size_t pos) {
+  reset(row);
+  pos_ = span_ != nullptr && pos < span_->size() ? pos : NPOS;
+}
+
+void EvalContext::recycle() {
+  row_ = data_ ? data_.get() : nullptr;
+  bound_ = nullptr;
+  seeker_ = nullptr;
+  span_ = nullptr;
+  pos_ = NPOS;
+  spans_.clear();
+  codes_.clear();
+
+  if (cache_ != nullptr) {
+    cache_->reset();
+  }
+}
+
+void ValueEval::scan(EvalContext& ctx, const Seeker& seek, Selection& selection) const {
+  N_ENSURE_EQ(output_, nebula::type::Kind::BOOLEAN, "only predicate can be used to select rows");
+  selection.keep([this, &ctx, &seek](size_t row) -> bool {
+    ctx.reset(seek(row));
+    return this->eval<bool>(ctx).value_or(false);
+  });
+}
+
 } // namespace eval
 } // namespace surface
 } // namespace nebula
\ No newline at end of file
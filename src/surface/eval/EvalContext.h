@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <cstring>
 #include <glog/logging.h>
+#include <limits>
+#include <unordered_map>
 
 #include <quickjs.h>
 extern "C" {
@@ -26,6 +29,7 @@ extern "C" {
 #include "Block.h"
 #include "Operation.h"
 #include "Script.h"
+#include "Selection.h"
 
 #include "common/Hash.h"
 #include "surface/DataSurface.h"
@@ -61,6 +65,25 @@ inline BlockEval uncertain(const Block&) {
   return BlockEval::PARTIAL;
 }
 
+// batch evaluation of a predicate over a selection of rows in a block
+// it keeps rows evaluated as true only, NULL is treated as false as in row-by-row filtering
+// returns false if it can't handle the block, so that row-by-row evaluation is used instead
+using Selector = std::function<bool(EvalContext&, const Block&, const Seeker&, Selection&)>;
+
+// aggregate all rows of a block from its metadata (histogram, partition values) without reading rows
+// returns nullptr if the metadata can't answer the aggregation exactly
+using Summarizer = std::function<std::shared_ptr<Sketch>(const Block&)>;
+
+// estimated cost to evaluate an expression on one row excluding its children, in units of reading a column value
+inline size_t weight(ExpressionType et) noexcept {
+  switch (et) {
+  case ExpressionType::CONSTANT: return 0;
+  case ExpressionType::FUNCTION: return 4;
+  case ExpressionType::SCRIPT: return 64;
+  default: return 1;
+  }
+}
+
 // this is a tree, with each node to be either macro/value or operator
 // this is translated from expression.
 class ValueEval {
@@ -74,7 +97,10 @@ public:
       et_{ et },
       input_{ input },
       output_{ output },
-      aggregate_{ aggregate } {}
+      aggregate_{ aggregate },
+      cost_{ weight(et) },
+      selectivity_{ 0.5 },
+      id_{ NO_ID } {}
   virtual ~ValueEval() = default;
 
   // TODO(cao) - we definitely need to revisit and reevaluate if we should use std::optional<T> here
@@ -113,13 +139,71 @@ public:
   // evaluate the whole block of data and determine if process the block or not
   virtual BlockEval eval(const Block&) const = 0;
 
+  // vectorized predicate evaluation on rows in the selection of given block
+  // every row not qualified by this predicate will be removed from the selection.
+  // expression nodes having a batch implementation (eg. AND/OR, column compare) set a selector,
+  // others fall back to row-by-row evaluation over the selection.
+  inline void select(EvalContext& ctx, const Block& b, const Seeker& seek, Selection& selection) const {
+    if (selection.empty()) {
+      return;
+    }
+
+    if (selector_ && selector_(ctx, b, seek, selection)) {
+      return;
+    }
+
+    scan(ctx, seek, selection);
+  }
+
+  // install a batch selector for this expression
+  inline void selector(Selector selector) {
+    selector_ = std::move(selector);
+  }
+
+  // sketch of all rows in given block answered by block metadata, nullptr if not available
+  inline std::shared_ptr<Sketch> summarize(const Block& b) const {
+    return summarizer_ ? summarizer_(b) : nullptr;
+  }
+
+  // install a metadata summarizer for this aggregation
+  inline void summarizer(Summarizer summarizer) {
+    summarizer_ = std::move(summarizer);
+  }
+
+private:
+  // default but slow path - evaluate every selected row
+  void scan(EvalContext&, const Seeker&, Selection&) const;
+
 public:
-  // identify a unique value evaluation object in given query context
-  // TODO(cao) - consider using number instead for fast hashing
+  // identify a unique value evaluation object in given query context.
+  // it is compared by plan compile only, evaluation uses the numeric id of a shared expression instead.
   inline const std::string_view signature() const {
     return sign_;
   }
 
+  // parameters of a function are not in the signature built from its name and inner expression,
+  // they are appended so that the signature still identifies the expression.
+  inline void qualify(const std::string& params) {
+    sign_ += params;
+  }
+
+  // id of an expression appearing multiple times in a plan, assigned by plan compile (see number in ValueEval.h).
+  // its value is evaluated once per row and read from the eval context cache by the id afterwards.
+  static constexpr size_t NO_ID = std::numeric_limits<size_t>::max();
+
+  inline size_t id() const noexcept {
+    return id_;
+  }
+
+  inline void id(size_t id) noexcept {
+    id_ = id;
+  }
+
+  // visit all sub expressions and this expression
+  virtual void walk(const std::function<void(ValueEval&)>& visit) {
+    visit(*this);
+  }
+
   inline nebula::type::Kind inputType() const {
     return input_;
   }
@@ -136,12 +220,50 @@ public:
     return aggregate_;
   }
 
+  // estimated cost to evaluate this expression on one row, including all its children
+  inline size_t cost() const noexcept {
+    return cost_;
+  }
+
+  // estimated fraction of rows qualified by this expression as a predicate
+  inline double selectivity() const noexcept {
+    return selectivity_;
+  }
+
+  inline void estimate(size_t cost, double selectivity) noexcept {
+    cost_ = cost;
+    selectivity_ = selectivity;
+  }
+
+  // predicates of the AND (or OR) chain headed by this expression, in the order they are evaluated.
+  // an expression not connecting predicates by the given operation is a chain of itself.
+  inline void chain(LogicalOp op, std::vector<const ValueEval*>& terms) const {
+    if (connector_ == op) {
+      terms.insert(terms.end(), terms_.begin(), terms_.end());
+      return;
+    }
+
+    terms.push_back(this);
+  }
+
+  inline void connect(LogicalOp op, std::vector<const ValueEval*> terms) {
+    connector_ = op;
+    terms_ = std::move(terms);
+  }
+
 protected:
   std::string sign_;
   ExpressionType et_;
   nebula::type::Kind input_;
   nebula::type::Kind output_;
   bool aggregate_;
+  Selector selector_;
+  Summarizer summarizer_;
+  size_t cost_;
+  double selectivity_;
+  std::optional<LogicalOp> connector_;
+  std::vector<const ValueEval*> terms_;
+  size_t id_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -179,12 +301,23 @@ public:
       op_{ std::move(op) },
       eb_{ std::move(eb) },
       st_{ std::move(st) },
-      children_{ std::move(children) } {}
+      children_{ std::move(children) } {
+    for (const auto& c : children_) {
+      this->cost_ += c->cost();
+    }
+  }
 
   virtual ~TypeValueEval() = default;
 
-  inline std::optional<EvalType> eval(EvalContext& ctx) const {
-    return op_(ctx, this->children_);
+  // a shared expression is evaluated through the cache of context, defined after EvalContext
+  inline std::optional<EvalType> eval(EvalContext& ctx) const;
+
+  virtual void walk(const std::function<void(ValueEval&)>& visit) override {
+    for (auto& c : children_) {
+      c->walk(visit);
+    }
+
+    visit(*this);
   }
 
   inline std::shared_ptr<Aggregator<OutputTD::kind, InputTD::kind>> sketch() const {
@@ -204,23 +337,28 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// cache evaluation result for reuse purpose in evaluaation context
+// cache evaluation result of shared expressions for reuse purpose in evaluaation context.
+// slots are indexed by expression id, a slot holds a value of current row only if it is stamped by current row,
+// so moving to next row is just a counter increment.
 struct EvalCache {
-  explicit EvalCache(size_t size) : slice{ size } {
-    reset();
-  }
+  // widest scalar values are int128 and string view
+  static constexpr size_t WIDTH = 16;
 
-  void reset() {
-    cursor = 1;
-    map.clear();
+  template <typename T>
+  static constexpr bool CACHEABLE = std::is_trivially_copyable_v<T> && sizeof(T) <= WIDTH;
+
+  struct Slot {
+    size_t row = 0;
+    bool valid = false;
+    alignas(WIDTH) char value[WIDTH];
+  };
+
+  inline void reset() noexcept {
+    ++row;
   }
 
-  // a signature keyed tuples indicating if this expr evaluated (having entry) or not.
-  nebula::common::unordered_map<std::string_view, std::pair<size_t, size_t>> map;
-  // layout all cached data, when reset, just move the cursor to 1
-  // 0 is reserved, any evaluated data points to 0 if it is NULL
-  size_t cursor;
-  nebula::common::ExtendableSlice slice;
+  size_t row = 1;
+  std::vector<Slot> slots;
 };
 
 // define a global type to represent runtime fields in schema
@@ -263,6 +401,18 @@ struct ScriptData {
   const Fields& customs;
 };
 
+// a column referenced by expressions, its name is interned to a process-wide id when built
+// so that evaluation context can bind it to accessor index once and read values without name lookup
+struct ColumnRef {
+  explicit ColumnRef(const std::string& n) : name{ n }, id{ intern(n) } {}
+
+  // get a unique id for given column name
+  static size_t intern(const std::string&);
+
+  std::string name;
+  size_t id;
+};
+
 class EvalContext {
 public:
   // standard shared context across rows through reset row object interface
@@ -279,83 +429,220 @@ public:
   // and start build cache based on evaluation signautre.
   void reset(const nebula::surface::Accessor&);
 
-  template <typename T>
-  inline std::optional<T> read(const std::string& col) {
-    // TODO(cao) - not ideal branching. we should be able to compile this before execution
-    // fast lookup - best to turn all column's value materialization into a function pointer - type agnostic?
-    // we exactly know what method to call for every single column
+  // rows of a selection are going to be evaluated one by one as a span,
+  // script columns are evaluated over all rows of the span in one call at their first access.
+  void span(const Seeker&, const Selection&);
+
+  // reset to the row at given position of current span
+  void reset(const nebula::surface::Accessor&, size_t pos);
+
+  // forget rows, accessor bindings and code maps of previous block, so the context is reused for another block.
+  // allocated cache and column slots are kept.
+  void recycle();
+
+  // value of a shared expression (by its id) on current row, it is evaluated by given function at first access
+  template <typename T, typename F>
+  inline std::optional<T> shared(size_t id, F&& eval) {
+    if constexpr (!EvalCache::CACHEABLE<T>) {
+      return eval();
+    } else {
+      if (cache_ == nullptr) {
+        return eval();
+      }
+
+      if (N_UNLIKELY(id >= cache_->slots.size())) {
+        cache_->slots.resize(id + 1);
+      }
+
+      const auto& slot = cache_->slots[id];
+      if (slot.row == cache_->row) {
+        if (!slot.valid) {
+          return std::nullopt;
+        }
+
+        T value;
+        std::memcpy(&value, slot.value, sizeof(T));
+        return value;
+      }
 
+      // evaluation may add slots of inner shared expressions, so the slot is located again
+      const auto value = eval();
+      auto& update = cache_->slots[id];
+      update.row = cache_->row;
+      update.valid = value.has_value();
+      if (value) {
+        std::memcpy(update.value, &value.value(), sizeof(T));
+      }
+
+      return value;
+    }
+  }
+
+  template <typename T>
+  inline std::optional<T> read(const ColumnRef& col) {
     // perf: we pay this check for every read
     if (N_UNLIKELY(scriptData_ != nullptr)) {
-      ValueEval* ve = scriptData_->column(col);
+      ValueEval* ve = scriptData_->column(col.name);
       if (ve) {
         return ve->eval<T>(*this);
       }
     }
 
-    // return *row_;
+    // read by bound index if the accessor supports it, otherwise by name
+    const auto index = bind(col);
+    if (N_LIKELY(index != UNBOUND)) {
+      return readBy<T>(index);
+    }
+
+    return readBy<T>(col.name);
+  }
+
+#undef NULL_CHECK
+
+  // list of an array column in current row, nullptr if it is NULL or empty
+  inline std::unique_ptr<nebula::surface::ListData> list(const std::string& name) const {
+    return row_->readList(name);
+  }
+
+  inline ScriptContext& script() const {
+    return *script_;
+  }
+
+  // value of a script column (by its function name) at current position of the span.
+  // returns false if current row is not in a span or the script can't be evaluated in batch.
+  template <typename T>
+  bool spanned(const std::string& name, std::optional<T>& value) {
+    if (pos_ == NPOS) {
+      return false;
+    }
+
+    auto it = spans_.find(name);
+    if (it == spans_.end()) {
+      auto values = script_->batch<T>(name, span_->size(), [this](size_t i) -> const nebula::surface::Accessor& {
+        return (*seeker_)((*span_)[i]);
+      });
+
+      // batch evaluation moved the accessor, seek it back to current row
+      row_ = &(*seeker_)((*span_)[pos_]);
+
+      // failed one is recorded as well, so that rows fall back to row-by-row evaluation without retry
+      it = spans_.emplace(name, std::move(values)).first;
+    }
+
+    if (!it->second) {
+      return false;
+    }
+
+    value = static_cast<const ScriptContext::Values<T>*>(it->second.get())->at(pos_);
+    return true;
+  }
+
+  // code map of a dictionary column matched by a predicate (identified by owner), built once for each block
+  // it is rebuilt when the block changes or its dictionary grows. owner is held so its address is not reused.
+  template <typename F>
+  inline const std::vector<bool>& codes(const std::shared_ptr<const void>& owner,
+                                        const Block& block,
+                                        size_t size,
+                                        F&& build) {
+    auto& entry = codes_[owner.get()];
+    if (entry.owner != owner || entry.block != &block || entry.codes.size() != size) {
+      entry.owner = owner;
+      entry.block = &block;
+      entry.codes = build();
+    }
+
+    return entry.codes;
+  }
+
+private:
+  using IndexType = nebula::surface::IndexType;
+  static constexpr IndexType UNRESOLVED = std::numeric_limits<IndexType>::max();
+  static constexpr IndexType UNBOUND = UNRESOLVED - 1;
+  static constexpr size_t NPOS = std::numeric_limits<size_t>::max();
+
+  // resolve accessor index of given column once for current accessor
+  inline IndexType bind(const ColumnRef& col) {
+    // rebind all columns if row is coming from a different accessor
+    if (N_UNLIKELY(bound_ != row_)) {
+      bound_ = row_;
+      std::fill(slots_.begin(), slots_.end(), UNRESOLVED);
+    }
+
+    if (N_UNLIKELY(col.id >= slots_.size())) {
+      slots_.resize(col.id + 1, UNRESOLVED);
+    }
+
+    auto& slot = slots_[col.id];
+    if (N_UNLIKELY(slot == UNRESOLVED)) {
+      slot = row_->index(col.name).value_or(UNBOUND);
+    }
+
+    return slot;
+  }
+
+  // K is either column name or column index
+  template <typename T, typename K>
+  inline std::optional<T> readBy(const K& key) const {
     // compile time branching based on template type T
     // I think it's better than using template specialization for this case
     if constexpr (std::is_same<T, bool>::value) {
-      return row_->readBool(col);
+      return row_->readBool(key);
     }
 
     if constexpr (std::is_same<T, int8_t>::value) {
-      return row_->readByte(col);
+      return row_->readByte(key);
     }
 
     if constexpr (std::is_same<T, int16_t>::value) {
-      return row_->readShort(col);
+      return row_->readShort(key);
     }
 
     if constexpr (std::is_same<T, int32_t>::value) {
-      return row_->readInt(col);
+      return row_->readInt(key);
     }
 
     if constexpr (std::is_same<T, int64_t>::value) {
-      return row_->readLong(col);
+      return row_->readLong(key);
     }
 
     if constexpr (std::is_same<T, float>::value) {
-      return row_->readFloat(col);
+      return row_->readFloat(key);
     }
 
     if constexpr (std::is_same<T, double>::value) {
-      return row_->readDouble(col);
+      return row_->readDouble(key);
     }
 
     if constexpr (std::is_same<T, int128_t>::value) {
-      return row_->readInt128(col);
+      return row_->readInt128(key);
     }
 
     if constexpr (std::is_same<T, std::string_view>::value) {
-      return row_->readString(col);
+      return row_->readString(key);
     }
 
     // TODO(cao): other types supported in DSL? for example: UDF on list or map
     throw NException("not supported template type");
   }
 
-#undef NULL_CHECK
-
-  inline ScriptContext& script() const {
-    return *script_;
-  }
-
 private:
   EvalContext(bool cache,
               std::shared_ptr<ScriptData> scriptData,
               std::unique_ptr<nebula::surface::Accessor> data)
-    : cache_{ !cache ? nullptr : std::make_unique<EvalCache>(1024) },
+    : cache_{ !cache ? nullptr : std::make_unique<EvalCache>() },
       scriptData_{ scriptData },
       script_{ scriptData == nullptr ? nullptr :
-                                       std::make_unique<ScriptContext>(
+                                       ScriptContext::acquire(
                                          [this]() -> const nebula::surface::Accessor& { return *row_; },
                                          [this](const std::string& col) -> auto {
                                            return scriptData_->name2type->at(col);
                                          }) },
       data_{ std::move(data) },
-      row_{ data_ ? data_.get() : nullptr } {}
+      row_{ data_ ? data_.get() : nullptr },
+      bound_{ nullptr },
+      seeker_{ nullptr },
+      span_{ nullptr },
+      pos_{ NPOS } {}
 
 private:
   std::unique_ptr<EvalCache> cache_;
@@ -364,15 +651,46 @@ private:
   std::shared_ptr<ScriptData> scriptData_;
 
   // script context to evaluate script for value residing in current context
-  std::unique_ptr<ScriptContext> script_;
+  ScriptContext::Handle script_;
 
   // the context may own a row object directly
   std::unique_ptr<nebula::surface::Accessor> data_;
 
   // row object pointer
   const nebula::surface::Accessor* row_;
+
+  // accessor which column slots are bound to
+  const nebula::surface::Accessor* bound_;
+
+  // accessor index of each column indexed by column id
+  std::vector<IndexType> slots_;
+
+  // matched dictionary codes of every predicate in current block
+  struct Codes {
+    std::shared_ptr<const void> owner;
+    const Block* block;
+    std::vector<bool> codes;
+  };
+  std::unordered_map<const void*, Codes> codes_;
+
+  // span of rows being evaluated and position of current row in it
+  const Seeker* seeker_;
+  const Selection* span_;
+  size_t pos_;
+
+  // batch evaluated values of script columns in current span, nullptr if failed
+  nebula::common::unordered_map<std::string, std::shared_ptr<void>> spans_;
 };
 
+template <typename T, typename I, bool EvalInput>
+inline auto TypeValueEval<T, I, EvalInput>::eval(EvalContext& ctx) const -> std::optional<EvalType> {
+  if (N_UNLIKELY(this->id_ != NO_ID)) {
+    return ctx.shared<EvalType>(this->id_, [this, &ctx]() { return op_(ctx, this->children_); });
+  }
+
+  return op_(ctx, this->children_);
+}
+
 } // namespace eval
 } // namespace surface
 } // namespace nebula
\ No newline at end of file
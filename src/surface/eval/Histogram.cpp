@@ -44,7 +44,7 @@ std::shared_ptr<Histogram> from(const std::string& str) {
   }
 
   std::string_view s(type->value.GetString(), type->value.GetStringLength());
-  // 4 types are supported BASE, BOOL, INT, REAL
+  // 5 types are supported BASE, BOOL, INT, REAL, STRING
   if (s == "BASE") {
     return std::make_shared<Histogram>(obj["count"].GetUint64());
   }
@@ -69,6 +69,15 @@ std::shared_ptr<Histogram> from(const std::string& str) {
       obj["sum"].GetInt64());
   }
 
+  if (s == "STRING") {
+    const auto& min = obj["min"];
+    const auto& max = obj["max"];
+    return std::make_shared<StringHistogram>(
+      obj["count"].GetUint64(),
+      std::string(min.GetString(), min.GetStringLength()),
+      std::string(max.GetString(), max.GetStringLength()));
+  }
+
   throw NException(fmt::format("Histogram type not supported {0}", s));
 }
 
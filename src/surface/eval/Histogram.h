@@ -16,8 +16,11 @@
 
 #pragma once
 
+#include <memory>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "common/Likely.h"
@@ -29,6 +32,8 @@ namespace eval {
 
 /**
  * Define histogram data - Count is common value indicating total valid values.
+ * A merged histogram can take out one of its parts by subtract, counts and sums are exact after it,
+ * but min and max given by the part can't be recovered, such a histogram needs to be merged again from the rest.
  */
 
 #define TOSTRING_JSON_START(TYPE)                   \
@@ -64,6 +69,21 @@ struct Histogram {
     count += other.count;
   }
 
+  // take a merged histogram out, return false if the result is not exact and needs a rebuild
+  virtual inline bool subtract(const Histogram& other) {
+    count -= other.count;
+    return true;
+  }
+
+  virtual inline std::shared_ptr<Histogram> clone() const {
+    return std::make_shared<Histogram>(*this);
+  }
+
+  // bytes of this histogram in memory
+  virtual inline size_t bytes() const {
+    return sizeof(Histogram);
+  }
+
   uint64_t count;
 };
 
@@ -88,6 +108,20 @@ struct BoolHistogram : public Histogram {
     trueValues += bh.trueValues;
   }
 
+  virtual inline bool subtract(const Histogram& other) override {
+    Histogram::subtract(other);
+    trueValues -= static_cast<const BoolHistogram&>(other).trueValues;
+    return true;
+  }
+
+  virtual inline std::shared_ptr<Histogram> clone() const override {
+    return std::make_shared<BoolHistogram>(*this);
+  }
+
+  virtual inline size_t bytes() const override {
+    return sizeof(BoolHistogram);
+  }
+
   uint64_t trueValues;
 };
 
@@ -157,11 +191,114 @@ struct NumberHistogram : public Histogram {
     v_sum += nh.v_sum;
   }
 
+  // exact if min and max of the rest are given by other parts, that is, strictly out of the removed range
+  virtual inline bool subtract(const Histogram& other) override {
+    Histogram::subtract(other);
+
+    const auto& nh = static_cast<const NumberHistogram<T>&>(other);
+    v_sum -= nh.v_sum;
+    if (count == 0) {
+      *this = NumberHistogram<T>();
+      return true;
+    }
+
+    return nh.count == 0 || (v_min < nh.v_min && nh.v_max < v_max);
+  }
+
+  virtual inline std::shared_ptr<Histogram> clone() const override {
+    return std::make_shared<NumberHistogram<T>>(*this);
+  }
+
+  virtual inline size_t bytes() const override {
+    return sizeof(NumberHistogram<T>);
+  }
+
   T v_min;
   T v_max;
   T v_sum;
 };
 
+// string histogram records lexicographic min and max of all values
+// both are empty when count is 0
+struct StringHistogram : public Histogram {
+  StringHistogram() : StringHistogram(0, "", "") {}
+  StringHistogram(uint64_t c, std::string min, std::string max)
+    : Histogram(c), v_min{ std::move(min) }, v_max{ std::move(max) } {}
+  virtual ~StringHistogram() = default;
+
+  inline const std::string& min() const {
+    return v_min;
+  }
+
+  inline const std::string& max() const {
+    return v_max;
+  }
+
+  // record a new string value in
+  inline void add(std::string_view v) {
+    if (count == 0 || v < v_min) {
+      v_min = v;
+    }
+
+    if (count == 0 || v > v_max) {
+      v_max = v;
+    }
+
+    ++count;
+  }
+
+  virtual inline std::string toString() const override {
+    TOSTRING_JSON_START("STRING")
+    json.Key("count");
+    json.Uint64(count);
+    json.Key("min");
+    json.String(v_min.data(), v_min.size());
+    json.Key("max");
+    json.String(v_max.data(), v_max.size());
+    TOSTRING_JSON_END
+  }
+
+  virtual inline void merge(const Histogram& other) override {
+    // histogram serialized by older versions may carry count only
+    auto sh = dynamic_cast<const StringHistogram*>(&other);
+    if (sh != nullptr && sh->count > 0) {
+      if (count == 0 || sh->v_min < v_min) {
+        v_min = sh->v_min;
+      }
+
+      if (count == 0 || sh->v_max > v_max) {
+        v_max = sh->v_max;
+      }
+    }
+
+    Histogram::merge(other);
+  }
+
+  virtual inline bool subtract(const Histogram& other) override {
+    Histogram::subtract(other);
+    if (count == 0) {
+      v_min.clear();
+      v_max.clear();
+      return true;
+    }
+
+    auto sh = dynamic_cast<const StringHistogram*>(&other);
+    return sh == nullptr || sh->count == 0 || (v_min < sh->v_min && sh->v_max < v_max);
+  }
+
+  virtual inline std::shared_ptr<Histogram> clone() const override {
+    return std::make_shared<StringHistogram>(*this);
+  }
+
+  // strings may be inlined in the object
+  virtual inline size_t bytes() const override {
+    return sizeof(StringHistogram) + v_min.capacity() + v_max.capacity() - 2 * std::string().capacity();
+  }
+
+  std::string v_min;
+  std::string v_max;
+};
+
 // cover all integers - we may have overflow issue for bigint
 using IntHistogram = struct NumberHistogram<int64_t>;
 
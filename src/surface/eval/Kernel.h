@@ -0,0 +1,510 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <any>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "Block.h"
+#include "EvalContext.h"
+#include "Operation.h"
+#include "Selection.h"
+#include "common/Likely.h"
+
+/**
+ * Predicate kernels running directly on raw column data of a block.
+ * Loops are kept branch-free over contiguous values so that compiler can vectorize them
+ * for the target ISA (SSE/AVX2/AVX-512/NEON) without hand-written intrinsics.
+ */
+namespace nebula {
+namespace surface {
+namespace eval {
+
+// kernels are available for fixed-width scalar types only
+static constexpr bool hasKernel(nebula::type::Kind kind) noexcept {
+  return kind >= nebula::type::Kind::BOOLEAN && kind <= nebula::type::Kind::DOUBLE;
+}
+
+// compare functor for each logical operation
+template <LogicalOp>
+struct Compare {};
+
+#define DEFINE_COMPARE(OP, SIGN)                                \
+  template <>                                                   \
+  struct Compare<LogicalOp::OP> {                               \
+    template <typename L, typename R>                           \
+    static inline bool apply(const L& left, const R& right) {   \
+      return left SIGN right;                                   \
+    }                                                           \
+  };
+
+DEFINE_COMPARE(EQ, ==)
+DEFINE_COMPARE(NEQ, !=)
+DEFINE_COMPARE(GT, >)
+DEFINE_COMPARE(GE, >=)
+DEFINE_COMPARE(LT, <)
+DEFINE_COMPARE(LE, <=)
+
+#undef DEFINE_COMPARE
+
+// apply predicate on values of selected rows, keep rows evaluated as true only
+// values start at row offset, value of row i is values[i - offset].
+// for a dense selection, a mask is computed over the contiguous range first.
+// if valid is given, it masks non-null rows from the first selected row, NULL rows are not kept.
+template <typename T, typename P>
+inline void kernel(const T* values, size_t offset, Selection& selection, P&& pred, const uint8_t* valid = nullptr) {
+  if (selection.dense()) {
+    const auto first = selection.front();
+    const auto size = selection.size();
+    const auto base = values + (first - offset);
+    std::vector<uint8_t> mask(size);
+    if (valid) {
+      for (size_t i = 0; i < size; ++i) {
+        mask[i] = pred(base[i]) & valid[i];
+      }
+    } else {
+      for (size_t i = 0; i < size; ++i) {
+        mask[i] = pred(base[i]);
+      }
+    }
+
+    selection.keep([&mask, first](size_t row) { return mask[row - first]; });
+    return;
+  }
+
+  if (valid) {
+    const auto first = selection.front();
+    selection.keep([values, offset, valid, first, &pred](size_t row) {
+      return valid[row - first] && pred(values[row - offset]);
+    });
+    return;
+  }
+
+  selection.keep([values, offset, &pred](size_t row) { return pred(values[row - offset]); });
+}
+
+// value of a partition column read from block partition values
+template <typename T>
+inline T partitionValue(const std::any& value) {
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    return std::any_cast<const std::string&>(value);
+  } else {
+    return std::any_cast<T>(value);
+  }
+}
+
+// run predicate once on every partition value of a partition column, then selected rows are kept by runs of rows
+// sharing the same value, which is decoded from partition encoding of the range of selected rows in one batch.
+// return false if the column is not a partition column, caller needs to fall back to other evaluation.
+template <typename T, typename P>
+bool selectRuns(const Block& b, const std::string& name, Selection& selection, P&& pred) {
+  const auto first = selection.empty() ? 0 : selection.front();
+  const auto end = selection.empty() ? 0 : selection.back() + 1;
+  std::vector<Run> runs;
+  if (!b.runs(name, first, end, runs)) {
+    return false;
+  }
+
+  if (selection.empty()) {
+    return true;
+  }
+
+  const auto values = b.partitionValues(name);
+  std::vector<uint8_t> matched(values.size());
+  for (size_t i = 0, size = values.size(); i < size; ++i) {
+    matched[i] = pred(partitionValue<T>(values[i]));
+  }
+
+  // rows out of any run are not in the block
+  std::vector<uint8_t> mask(end - first, 0);
+  for (const auto& run : runs) {
+    std::fill(mask.begin() + (run.first - first), mask.begin() + (run.last - first), matched.at(run.code));
+  }
+
+  selection.keep([&mask, first](size_t row) { return mask[row - first]; });
+  return true;
+}
+
+// run predicate kernel on a scalar column of given block over the selection.
+// NULL rows are evaluated separately: they use default value if column has one, otherwise excluded.
+// an encoded column is decoded for the range of selected rows in one batch before running kernel,
+// and a partition column is evaluated by its runs.
+// return false if column raw data is not available, caller needs to fall back to row evaluation.
+template <typename T, typename P>
+bool selectScalar(const Block& b, const std::string& name, Selection& selection, P&& pred) {
+  auto column = b.scalar(name);
+  if (!column) {
+    return selectRuns<T>(b, name, selection, pred);
+  }
+
+  if (selection.empty()) {
+    return true;
+  }
+
+  auto values = static_cast<const T*>(column->data);
+  size_t offset = 0;
+  std::vector<T> decoded;
+  if (values == nullptr) {
+    offset = selection.front();
+    decoded.resize(selection.back() + 1 - offset);
+    if (!b.decode(name, offset, decoded.size(), decoded.data())) {
+      return false;
+    }
+
+    values = decoded.data();
+  }
+
+  if (N_LIKELY(!column->nullable)) {
+    kernel(values, offset, selection, pred);
+    return true;
+  }
+
+  // NULL rows in a dense bitmap are masked out by the kernel, a column having default value reads them as default
+  if (!column->defaultValue.has_value()) {
+    const auto first = selection.front();
+    std::vector<uint8_t> valid(selection.back() + 1 - first);
+    if (b.valid(name, first, valid.size(), valid.data())) {
+      kernel(values, offset, selection, pred, valid.data());
+      return true;
+    }
+  }
+
+  // null slots are filled with 0, exclude them from the kernel
+  Selection nulls;
+  b.nulls(name, selection.front(), selection.back() + 1, nulls);
+  nulls.intersect(selection);
+  selection.subtract(nulls);
+  kernel(values, offset, selection, pred);
+
+  if (column->defaultValue.has_value() && pred(std::any_cast<T>(column->defaultValue))) {
+    selection.merge(nulls);
+  }
+
+  return true;
+}
+
+// run "low <= value <= high" (or its negation) on an integer column over the selection.
+// a bit packed column is evaluated on its packed values without decoding them, otherwise it runs as selectScalar.
+// return false if column raw data is not available, caller needs to fall back to row evaluation.
+template <typename T>
+bool selectRange(const Block& b, const std::string& name, Selection& selection, int64_t low, int64_t high, bool negate = false) {
+  static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>, "range kernel for integers only");
+  const auto pred = [low, high, negate](const T v) {
+    return ((v >= low) & (v <= high)) != negate;
+  };
+
+  auto column = b.scalar(name);
+  if (!column || column->data != nullptr || selection.empty()) {
+    return selectScalar<T>(b, name, selection, pred);
+  }
+
+  const auto first = selection.front();
+  const auto end = selection.back() + 1;
+  std::vector<uint8_t> mask(end - first);
+  if (!b.match(name, low, high, first, mask.size(), mask.data())) {
+    return selectScalar<T>(b, name, selection, pred);
+  }
+
+  // null slots are packed as 0, they are masked out by a dense bitmap or evaluated separately
+  Selection nulls;
+  if (N_UNLIKELY(column->nullable)) {
+    std::vector<uint8_t> valid(mask.size());
+    if (!column->defaultValue.has_value() && b.valid(name, first, valid.size(), valid.data())) {
+      for (size_t i = 0, size = mask.size(); i < size; ++i) {
+        mask[i] = (mask[i] != negate) & valid[i];
+      }
+
+      selection.keep([&mask, first](size_t row) { return mask[row - first]; });
+      return true;
+    }
+
+    b.nulls(name, first, end, nulls);
+    nulls.intersect(selection);
+    selection.subtract(nulls);
+  }
+
+  selection.keep([&mask, first, negate](size_t row) { return mask[row - first] != negate; });
+  if (column->nullable && column->defaultValue.has_value() && pred(std::any_cast<T>(column->defaultValue))) {
+    selection.merge(nulls);
+  }
+
+  return true;
+}
+
+// run predicate on string values read from accessor for selected rows, NULL values are excluded.
+// strings have no raw form in a block, instead the column is bound to accessor index once
+// so there is no name lookup and no expression tree walking per row.
+// return false if the accessor can't bind the column, caller needs to fall back to row evaluation.
+template <typename P>
+bool selectStrings(const Seeker& seek, const std::string& name, Selection& selection, P&& pred) {
+  if (selection.empty()) {
+    return true;
+  }
+
+  const auto index = seek(selection.front()).index(name);
+  if (!index) {
+    return false;
+  }
+
+  const auto column = index.value();
+  selection.keep([&seek, column, &pred](size_t row) {
+    const auto value = seek(row).readString(column);
+    return value.has_value() && pred(value.value());
+  });
+
+  return true;
+}
+
+// remove NULL rows of a column from a non-empty selection
+inline void dropNulls(const Block& b, const std::string& name, Selection& selection) {
+  const auto first = selection.front();
+  std::vector<uint8_t> valid(selection.back() + 1 - first);
+  if (b.valid(name, first, valid.size(), valid.data())) {
+    selection.keep([&valid, first](size_t row) { return valid[row - first]; });
+    return;
+  }
+
+  Selection nulls;
+  b.nulls(name, first, selection.back() + 1, nulls);
+  nulls.intersect(selection);
+  selection.subtract(nulls);
+}
+
+// run "string column OP target" on string heads of a column over the selection.
+// most rows are decided by the size and prefix in their heads, only long strings sharing the prefix with target
+// are read from heap. return false if the column has no string heads, caller needs to fall back to other evaluation.
+template <LogicalOp OP>
+bool selectHeads(const Block& b, const std::string& name, Selection& selection, std::string_view target) {
+  auto column = b.strings(name);
+  if (!column) {
+    return false;
+  }
+
+  if (selection.empty()) {
+    return true;
+  }
+
+  // NULL values are excluded
+  if (N_UNLIKELY(column->nullable)) {
+    dropNulls(b, name, selection);
+  }
+
+  const auto heads = column->heads;
+  const auto& heap = column->heap;
+  if constexpr (OP == LogicalOp::EQ || OP == LogicalOp::NEQ) {
+    const auto probe = nebula::common::StringHead::make(target, 0);
+    selection.keep([heads, &heap, &probe, target](size_t row) {
+      return heads[row].equals(probe, target, heap) == (OP == LogicalOp::EQ);
+    });
+  } else {
+    selection.keep([heads, &heap, target](size_t row) {
+      return Compare<OP>::apply(heads[row].compare(target, heap), 0);
+    });
+  }
+
+  return true;
+}
+
+// run predicate on string values of a column read by their heads over the selection, NULL values are excluded.
+// return false if the column has no string heads, caller needs to fall back to other evaluation.
+template <typename P>
+bool selectViews(const Block& b, const std::string& name, Selection& selection, P&& pred) {
+  auto column = b.strings(name);
+  if (!column) {
+    return false;
+  }
+
+  if (selection.empty()) {
+    return true;
+  }
+
+  if (N_UNLIKELY(column->nullable)) {
+    dropNulls(b, name, selection);
+  }
+
+  const auto heads = column->heads;
+  const auto& heap = column->heap;
+  selection.keep([heads, &heap, &pred](size_t row) {
+    const auto& head = heads[row];
+    return pred(head.inlined() ? head.view() : heap(head));
+  });
+
+  return true;
+}
+
+// run predicate once on every distinct item of a dictionary encoded string column,
+// then rows are selected by membership of their codes in matched code map, NULL values are excluded.
+// the code map is kept in eval context for the owner predicate so it is built once per block.
+// a partition column is evaluated once per partition value by its runs in the same way.
+// return false if the column is not dictionary encoded, caller needs to fall back to other evaluation.
+template <typename P>
+bool selectDict(EvalContext& ctx,
+                const std::shared_ptr<const void>& owner,
+                const Block& b,
+                const std::string& name,
+                Selection& selection,
+                P&& pred) {
+  const auto size = b.dictSize(name);
+  if (size == 0) {
+    return selectRuns<std::string_view>(b, name, selection, pred);
+  }
+
+  if (selection.empty()) {
+    return true;
+  }
+
+  const auto& codes = ctx.codes(owner, b, size, [&b, &name, size, &pred]() {
+    std::vector<bool> codes(size);
+    for (size_t i = 0; i < size; ++i) {
+      codes[i] = pred(b.dictItem(name, i));
+    }
+
+    return codes;
+  });
+
+  b.selectCodes(name, codes, selection);
+  return true;
+}
+
+// keep selected rows of a string column having any term matched by the predicate in its token index,
+// rows are flagged once per block and kept in eval context for the owner predicate as dictionary codes are.
+// return false if the column has no token index, caller needs to fall back to other evaluation.
+template <typename P>
+bool selectTerms(EvalContext& ctx,
+                 const std::shared_ptr<const void>& owner,
+                 const Block& b,
+                 const std::string& name,
+                 Selection& selection,
+                 P&& pred) {
+  if (b.terms(name) == 0) {
+    return false;
+  }
+
+  if (selection.empty()) {
+    return true;
+  }
+
+  const auto& rows = ctx.codes(owner, b, b.getRows(), [&b, &name, &pred]() { return b.matchTerms(name, pred); });
+  selection.keep([&rows](size_t row) { return rows[row]; });
+  return true;
+}
+
+// value of a column in its bitmap index as the column type, see Block::bitmapValues
+template <typename T>
+inline T bitmapValue(const std::any& value) {
+  if constexpr (std::is_same_v<T, std::string_view>) {
+    return std::any_cast<std::string_view>(value);
+  } else {
+    return static_cast<T>(std::any_cast<int64_t>(value));
+  }
+}
+
+// rows of a column having a value matched by the predicate counted by its bitmap index:
+// NONE if no row has, ALL if every row has, PARTIAL if some rows have or the column has no bitmap index.
+template <typename T, typename P>
+BlockEval evalBitmap(const Block& b, const std::string& name, P&& pred) {
+  if (b.bitmapValues(name) == 0) {
+    return BlockEval::PARTIAL;
+  }
+
+  const auto rows = b.countBitmap(name, [&pred](const std::any& v) { return pred(bitmapValue<T>(v)); });
+  return rows == 0 ? BlockEval::NONE : (rows == b.getRows() ? BlockEval::ALL : BlockEval::PARTIAL);
+}
+
+// keep selected rows of a column having a value matched by the predicate in its bitmap index,
+// rows are flagged once per block and kept in eval context for the owner predicate as dictionary codes are.
+// return false if the column has no bitmap index, caller needs to fall back to other evaluation.
+template <typename T, typename P>
+bool selectBitmap(EvalContext& ctx,
+                  const std::shared_ptr<const void>& owner,
+                  const Block& b,
+                  const std::string& name,
+                  Selection& selection,
+                  P&& pred) {
+  if (b.bitmapValues(name) == 0) {
+    return false;
+  }
+
+  if (selection.empty()) {
+    return true;
+  }
+
+  const auto& rows = ctx.codes(owner, b, b.getRows(), [&b, &name, &pred]() {
+    return b.matchBitmap(name, [&pred](const std::any& v) { return pred(bitmapValue<T>(v)); });
+  });
+  selection.keep([&rows](size_t row) { return rows[row]; });
+  return true;
+}
+
+// keep rows of an array column having any element selected by given element selector, NULL and empty lists are not kept.
+// elements of all rows in the selection range are selected as rows of the element column in one batch (see ListColumn),
+// then a row is kept if the count of selected elements grows over its span.
+// return false if the column is not an array column or the selector can't select elements in batch,
+// caller needs to fall back to row evaluation.
+template <typename S>
+bool selectList(const Block& b, const std::string& name, Selection& selection, S&& select) {
+  auto list = b.list(name);
+  if (!list) {
+    return false;
+  }
+
+  if (selection.empty()) {
+    return true;
+  }
+
+  // no row has a list
+  if (list->rows == 0) {
+    selection.clear();
+    return true;
+  }
+
+  // rows after the last span have no elements
+  const auto offsets = list->offsets;
+  const auto first = std::min(selection.front(), list->rows);
+  const auto last = std::min(selection.back() + 1, list->rows);
+  const auto base = offsets[first];
+  Selection elements{ offsets[last] - base };
+  elements.reset(base, offsets[last]);
+  if (!elements.empty() && !select(*list, elements)) {
+    return false;
+  }
+
+  // counts[i] = number of selected elements before element (base + i)
+  std::vector<uint32_t> counts(offsets[last] - base + 1, 0);
+  for (auto e : elements) {
+    counts[e - base + 1] = 1;
+  }
+
+  for (size_t i = 1; i < counts.size(); ++i) {
+    counts[i] += counts[i - 1];
+  }
+
+  selection.keep([offsets, last, base, &counts](size_t row) {
+    return row < last && counts[offsets[row + 1] - base] > counts[offsets[row] - base];
+  });
+
+  return true;
+}
+
+} // namespace eval
+} // namespace surface
+} // namespace nebula
@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <cmath>
 #include <glog/logging.h>
+#include <thread>
 
 #include "common/Finally.h"
 #include "common/Hash.h"
@@ -33,6 +35,10 @@ extern "C" {
  *
  * It's asked to execute a piece of script code (ES2015/ES6) through quickjs engine.
  * The input will be binding with a native row object through which we can read column value for computation.
+ *
+ * Besides row by row evaluation, a declared function can be evaluated over a span of rows in one call (batch),
+ * where every referenced column is read into one JS array for the whole span on its first access.
+ * Script contexts are expensive to create, released contexts are kept warm in a per-thread pool.
  */
 namespace nebula {
 namespace surface {
@@ -41,6 +47,43 @@ namespace eval {
 class ScriptContext final {
   using RowGetter = std::function<const nebula::surface::Accessor&()>;
   using ColTyper = std::function<nebula::type::Kind(const std::string&)>;
+  using SpanGetter = std::function<const nebula::surface::Accessor&(size_t)>;
+
+  // max number of warm contexts kept by each thread
+  static constexpr size_t POOL_SIZE = 8;
+
+  // a context evaluated too many distinct scripts is not reused to bound its memory
+  static constexpr size_t MAX_SCRIPTS = 256;
+
+  // nebula module exposed to scripts, "nebula.column" reads value of current row through native module,
+  // or value of current position from column arrays when a span is being evaluated.
+  static constexpr auto PRELUDE =
+    "import * as native from 'nebula';"
+    "globalThis.__nebula_columns = null;"
+    "globalThis.__nebula_pos = 0;"
+    "globalThis.nebula = {"
+    "  column: (c) => {"
+    "    const span = __nebula_columns;"
+    "    if (span === null) return native.column(c);"
+    "    let values = span[c];"
+    "    if (values === undefined) {"
+    "      values = native.columns(c);"
+    "      if (values instanceof ArrayBuffer) values = new Float64Array(values);"
+    "      span[c] = values;"
+    "    }"
+    "    return values === null ? null : values[__nebula_pos];"
+    "  }"
+    "};"
+    "globalThis.__nebula_span = (f, n, numeric) => {"
+    "  const out = numeric ? new Float64Array(n) : new Array(n);"
+    "  __nebula_columns = {};"
+    "  try {"
+    "    for (__nebula_pos = 0; __nebula_pos < n; ++__nebula_pos) out[__nebula_pos] = f();"
+    "  } finally {"
+    "    __nebula_columns = null;"
+    "  }"
+    "  return out;"
+    "};";
 
   static JSValue eval_buf(JSContext* ctx, const std::string& buf, const std::string& file, int eval_flags) noexcept {
     JSValue val;
@@ -141,9 +184,76 @@ class ScriptContext final {
     }
   }
 
+  // read a column over all rows of current span, use column index if the accessor supports it
+  template <typename T, typename R, typename S>
+  static void each(const ScriptContext& script, const std::string& col, R read, S set) {
+    const auto& first = script.span_(0);
+    const auto index = first.index(col);
+    for (size_t i = 0; i < script.size_; ++i) {
+      const auto& r = script.span_(i);
+      std::optional<T> value = index ? read(r, index.value()) : read(r, col);
+      set(i, value.value_or(T{}));
+    }
+  }
+
+  // column values of all rows in current span: numbers in a buffer of doubles, others in an array
+  static JSValue js_columns(JSContext* ctx, JSValue, int, JSValue* args) {
+    auto col = to<std::string>(ctx, args[0]);
+    ScriptContext* script = (ScriptContext*)JS_GetContextOpaque(ctx);
+    if (col.size() == 0 || script->size_ == 0) {
+      return JS_NULL;
+    }
+
+    const auto size = script->size_;
+    auto kind = script->type(col);
+    switch (kind) {
+#define SPAN_NUMBERS(K, T, F)                                                                                  \
+  case nebula::type::Kind::K: {                                                                                \
+    std::vector<double> values(size);                                                                          \
+    each<T>(                                                                                                   \
+      *script, col, [](const auto& r, const auto& key) { return r.F(key); },                                   \
+      [&values](size_t i, T v) { values[i] = v; });                                                            \
+    return JS_NewArrayBufferCopy(ctx, reinterpret_cast<const uint8_t*>(values.data()), size * sizeof(double)); \
+  }
+
+      SPAN_NUMBERS(TINYINT, int8_t, readByte)
+      SPAN_NUMBERS(SMALLINT, int16_t, readShort)
+      SPAN_NUMBERS(INTEGER, int32_t, readInt)
+      SPAN_NUMBERS(BIGINT, int64_t, readLong)
+      SPAN_NUMBERS(REAL, float, readFloat)
+      SPAN_NUMBERS(DOUBLE, double, readDouble)
+
+#undef SPAN_NUMBERS
+
+    case nebula::type::Kind::BOOLEAN: {
+      auto array = JS_NewArray(ctx);
+      each<bool>(
+        *script, col, [](const auto& r, const auto& key) { return r.readBool(key); },
+        [ctx, &array](size_t i, bool v) { JS_SetPropertyUint32(ctx, array, i, JS_NewBool(ctx, v ? 1 : 0)); });
+      return array;
+    }
+    case nebula::type::Kind::VARCHAR: {
+      auto array = JS_NewArray(ctx);
+      each<std::string_view>(
+        *script, col, [](const auto& r, const auto& key) { return r.readString(key); },
+        [ctx, &array](size_t i, std::string_view v) {
+          JS_SetPropertyUint32(ctx, array, i, JS_NewStringLen(ctx, v.data(), v.size()));
+        });
+      return array;
+    }
+    default: {
+      LOG(WARNING) << "Not supported type for column value: " << col;
+      return JS_NULL;
+    }
+    }
+  }
+
   // function list to register
   static inline const JSCFunctionListEntry* funcs(int* size) {
-    static const JSCFunctionListEntry FUNCS[] = { JS_CFUNC_DEF("column", 1, js_column) };
+    static const JSCFunctionListEntry FUNCS[] = {
+      JS_CFUNC_DEF("column", 1, js_column),
+      JS_CFUNC_DEF("columns", 1, js_columns)
+    };
     *size = ALEN(FUNCS);
     return FUNCS;
   };
@@ -168,7 +278,7 @@ class ScriptContext final {
 
 public:
   ScriptContext(RowGetter&& getter, ColTyper&& typer)
-    : getter_{ std::move(getter) }, typer_{ std::move(typer) } {
+    : getter_{ std::move(getter) }, typer_{ std::move(typer) }, size_{ 0 }, thread_{ std::this_thread::get_id() } {
     rt_ = JS_NewRuntime();
     js_std_init_handlers(rt_);
     ctx_ = JS_NewContext(rt_);
@@ -191,11 +301,7 @@ public:
 
     // evaluate the script, load the module nebula to be available to all scripts to be evaluated
     // all future script can call functions like "nebula.column('a') to get value of column 'a'"
-    auto result = eval_buf(ctx_,
-                           "import * as nebula from 'nebula';"
-                           "globalThis.nebula = nebula;",
-                           "<nebula-module>",
-                           JS_EVAL_TYPE_MODULE);
+    auto result = eval_buf(ctx_, PRELUDE, "<nebula-module>", JS_EVAL_TYPE_MODULE);
 
     if (JS_IsException(result)) {
       js_std_dump_error(ctx_);
@@ -215,6 +321,29 @@ public:
   ScriptContext& operator=(const ScriptContext&) = delete;     // copy assignment
   ScriptContext& operator=(ScriptContext&&) noexcept = delete; // move assignment
 
+  // return a context to the pool of current thread when it is released
+  struct Recycler {
+    void operator()(ScriptContext* script) const noexcept {
+      release(script);
+    }
+  };
+
+  using Handle = std::unique_ptr<ScriptContext, Recycler>;
+
+  // get a warm context from the pool of current thread, scripts evaluated with cache flag are still cached
+  static Handle acquire(RowGetter&& getter, ColTyper&& typer) {
+    auto& contexts = pool();
+    if (contexts.empty()) {
+      return Handle(new ScriptContext(std::move(getter), std::move(typer)));
+    }
+
+    auto script = std::move(contexts.back());
+    contexts.pop_back();
+    script->getter_ = std::move(getter);
+    script->typer_ = std::move(typer);
+    return Handle(script.release());
+  }
+
 public: // API
   const inline nebula::surface::Accessor& row() const {
     return getter_();
@@ -275,12 +404,96 @@ public: // API
     return std::nullopt;
   }
 
+  template <typename T>
+  using Values = std::vector<std::conditional_t<std::is_same_v<T, std::string_view>, std::string, T>>;
+
+  // evaluate a declared function (by name) over a span of rows in one call, getter seeks to i-th row of the span.
+  // returns nullptr if the function can't be evaluated in batch, caller should evaluate row by row then.
+  template <typename T>
+  std::shared_ptr<Values<T>> batch(const std::string& name, size_t size, SpanGetter&& getter) noexcept {
+    constexpr auto numeric = !std::is_same_v<T, std::string_view> && !std::is_same_v<T, std::string>;
+    span_ = std::move(getter);
+    size_ = size;
+    auto global = JS_GetGlobalObject(ctx_);
+    auto runner = JS_GetPropertyStr(ctx_, global, "__nebula_span");
+    JSValue args[] = { JS_GetPropertyStr(ctx_, global, name.c_str()), JS_NewInt64(ctx_, size), JS_NewBool(ctx_, numeric) };
+    auto out = JS_Call(ctx_, runner, global, 3, args);
+    nebula::common::Finally onExit([this, global, runner, &args, out]() {
+      JS_FreeValue(ctx_, out);
+      for (auto& arg : args) {
+        JS_FreeValue(ctx_, arg);
+      }
+      JS_FreeValue(ctx_, runner);
+      JS_FreeValue(ctx_, global);
+      span_ = {};
+      size_ = 0;
+    });
+
+    if (JS_IsException(out)) {
+      JS_FreeValue(ctx_, JS_GetException(ctx_));
+      return nullptr;
+    }
+
+    auto values = std::make_shared<Values<T>>(size);
+    if constexpr (numeric) {
+      // numbers come back in a Float64Array
+      auto buffer = JS_GetPropertyStr(ctx_, out, "buffer");
+      nebula::common::Finally freeBuffer([this, buffer]() { JS_FreeValue(ctx_, buffer); });
+      size_t bytes = 0;
+      auto data = JS_GetArrayBuffer(ctx_, &bytes, buffer);
+      if (data == nullptr || bytes != size * sizeof(double)) {
+        JS_FreeValue(ctx_, JS_GetException(ctx_));
+        return nullptr;
+      }
+
+      const double* numbers = reinterpret_cast<const double*>(data);
+      for (size_t i = 0; i < size; ++i) {
+        (*values)[i] = std::isnan(numbers[i]) ? T{} : (T)numbers[i];
+      }
+    } else {
+      for (size_t i = 0; i < size; ++i) {
+        auto v = JS_GetPropertyUint32(ctx_, out, i);
+        (*values)[i] = to<std::string>(ctx_, v);
+        JS_FreeValue(ctx_, v);
+      }
+    }
+
+    return values;
+  }
+
+private:
+  // per-thread pool of warm contexts, a runtime is bound to the thread creating it
+  static std::vector<std::unique_ptr<ScriptContext>>& pool() {
+    static thread_local std::vector<std::unique_ptr<ScriptContext>> contexts;
+    return contexts;
+  }
+
+  static void release(ScriptContext* script) noexcept {
+    std::unique_ptr<ScriptContext> ptr(script);
+    auto& contexts = pool();
+    if (ptr->thread_ == std::this_thread::get_id()
+        && ptr->flags_.size() < MAX_SCRIPTS
+        && contexts.size() < POOL_SIZE) {
+      // drop references to the owner as it goes away
+      ptr->getter_ = {};
+      ptr->typer_ = {};
+      contexts.push_back(std::move(ptr));
+    }
+  }
+
 private:
   RowGetter getter_;
   ColTyper typer_;
   JSRuntime* rt_;
   JSContext* ctx_;
 
+  // rows of the span being evaluated in batch
+  SpanGetter span_;
+  size_t size_;
+
+  // thread which created the runtime
+  std::thread::id thread_;
+
   // record if a script is already evaluated
   nebula::common::unordered_set<std::string> flags_;
 };
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2017-present varchar.io
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include "surface/DataSurface.h"
+
+/**
+ * Selection vector used by batch (vectorized) predicate evaluation.
+ * It holds sorted row ids of a block which are still qualified by the predicate.
+ */
+namespace nebula {
+namespace surface {
+namespace eval {
+
+// seek to a given row in current block and return accessor reading its values
+using Seeker = std::function<const nebula::surface::Accessor&(size_t)>;
+
+class Selection {
+public:
+  explicit Selection(size_t capacity = 0) {
+    rows_.reserve(capacity);
+  }
+
+  virtual ~Selection() = default;
+
+  // reset the selection to cover all rows in range [start, end)
+  inline void reset(size_t start, size_t end) {
+    rows_.resize(end - start);
+    for (size_t i = 0, size = rows_.size(); i < size; ++i) {
+      rows_[i] = start + i;
+    }
+  }
+
+  inline void clear() noexcept {
+    rows_.clear();
+  }
+
+  // keep rows satisfying given predicate only, order is preserved
+  template <typename P>
+  inline void keep(P&& pred) {
+    size_t cursor = 0;
+    for (size_t i = 0, size = rows_.size(); i < size; ++i) {
+      const auto row = rows_[i];
+      rows_[cursor] = row;
+      cursor += pred(row);
+    }
+
+    rows_.resize(cursor);
+  }
+
+  // union with another sorted selection (rows are disjoint or not)
+  inline void merge(const Selection& other) {
+    if (other.empty()) {
+      return;
+    }
+
+    std::vector<size_t> result;
+    result.reserve(rows_.size() + other.size());
+    std::set_union(rows_.begin(), rows_.end(), other.begin(), other.end(), std::back_inserter(result));
+    std::swap(rows_, result);
+  }
+
+  // remove all rows which appear in another sorted selection
+  inline void subtract(const Selection& other) {
+    if (other.empty()) {
+      return;
+    }
+
+    std::vector<size_t> result;
+    result.reserve(rows_.size());
+    std::set_difference(rows_.begin(), rows_.end(), other.begin(), other.end(), std::back_inserter(result));
+    std::swap(rows_, result);
+  }
+
+  // keep rows which also appear in another sorted selection
+  inline void intersect(const Selection& other) {
+    std::vector<size_t> result;
+    result.reserve(std::min(rows_.size(), other.size()));
+    std::set_intersection(rows_.begin(), rows_.end(), other.begin(), other.end(), std::back_inserter(result));
+    std::swap(rows_, result);
+  }
+
+  inline void add(size_t row) {
+    rows_.push_back(row);
+  }
+
+  inline size_t size() const noexcept {
+    return rows_.size();
+  }
+
+  inline bool empty() const noexcept {
+    return rows_.empty();
+  }
+
+  // first and last row of a non-empty selection
+  inline size_t front() const noexcept {
+    return rows_.front();
+  }
+
+  inline size_t back() const noexcept {
+    return rows_.back();
+  }
+
+  // all rows in [front, back] are selected
+  inline bool dense() const noexcept {
+    return !rows_.empty() && rows_.back() - rows_.front() + 1 == rows_.size();
+  }
+
+  inline size_t operator[](size_t index) const noexcept {
+    return rows_[index];
+  }
+
+  inline std::vector<size_t>::const_iterator begin() const noexcept {
+    return rows_.cbegin();
+  }
+
+  inline std::vector<size_t>::const_iterator end() const noexcept {
+    return rows_.cend();
+  }
+
+private:
+  std::vector<size_t> rows_;
+};
+
+} // namespace eval
+} // namespace surface
+} // namespace nebula
@@ -20,6 +20,7 @@
 
 #include "Aggregator.h"
 #include "ValueEval.h"
+#include "common/Arena.h"
 #include "surface/DataSurface.h"
 #include "type/Type.h"
 
@@ -68,9 +69,22 @@ public:
       },
       std::move(eb)),
       expr_{ std::move(expr) },
-      logic_{ std::move(logic) } {}
+      logic_{ std::move(logic) } {
+    this->cost_ += expr_->cost();
+  }
   virtual ~UDF() = default;
 
+  virtual void walk(const std::function<void(ValueEval&)>& visit) override {
+    expr_->walk(visit);
+    BaseType::walk(visit);
+  }
+
+protected:
+  // inner expression which the UDF is applied to
+  inline const nebula::surface::eval::ValueEval& expr() const {
+    return *expr_;
+  }
+
 private:
   std::unique_ptr<nebula::surface::eval::ValueEval> expr_;
   Logic logic_;
@@ -109,13 +123,68 @@ public:
       std::move(maker),
       {}),
       expr_{ std::move(expr) } {
+    this->cost_ += expr_->cost();
   }
   virtual ~UDAF() = default;
 
+  virtual void walk(const std::function<void(ValueEval&)>& visit) override {
+    expr_->walk(visit);
+    BaseType::walk(visit);
+  }
+
+protected:
+  // inner expression which the UDAF is applied to
+  inline const ValueEval& expr() const {
+    return *expr_;
+  }
+
 private:
   std::unique_ptr<ValueEval> expr_;
 };
 
+// histogram value type used by the statistics of a number column
+template <typename T>
+using StatsType = std::conditional_t<std::is_floating_point_v<T>, double, int64_t>;
+
+// exact statistics [count, min, max, sum] of a column expression over all rows of a block
+// count is number of non-null values, a partition column having single value in the block is constant.
+// nullopt if the expression is not a number column or block metadata doesn't cover every row of it
+template <typename T>
+std::optional<NumberHistogram<StatsType<T>>> columnStats(const ValueEval& expr, const Block& b) {
+  using S = StatsType<T>;
+  if constexpr (!std::is_arithmetic_v<T> || std::is_same_v<T, bool> || std::is_same_v<T, int128_t>) {
+    return std::nullopt;
+  } else {
+    if (expr.expressionType() != ExpressionType::COLUMN) {
+      return std::nullopt;
+    }
+
+    // column expr signature is composed by "F:{col}"
+    std::string col(expr.signature().substr(2));
+    auto values = b.partitionValues(col);
+    if (!values.empty()) {
+      if (values.size() != 1) {
+        return std::nullopt;
+      }
+
+      auto rows = b.getRows();
+      S v = std::any_cast<T>(values.front());
+      return NumberHistogram<S>(rows, v, v, v * rows);
+    }
+
+    if (!b.exact(col)) {
+      return std::nullopt;
+    }
+
+    auto histo = std::dynamic_pointer_cast<NumberHistogram<S>>(b.histogram(col));
+    if (histo == nullptr) {
+      return std::nullopt;
+    }
+
+    return *histo;
+  }
+}
+
 #undef TYPE_VALUE_EVAL_KIND
 
 enum class UDFType {
@@ -134,7 +203,11 @@ enum class UDFType {
   PCT,
   TPM,
   CARD,
-  HIST
+  HIST,
+  TOPK,
+  // UDF
+  LOOKUP,
+  CONTAINS
 };
 
 // UDF traits tells us:
@@ -328,6 +401,36 @@ UDF_NOT_SUPPORT(HIST, nebula::type::Kind::BOOLEAN)
 UDF_NOT_SUPPORT(HIST, nebula::type::Kind::VARCHAR)
 UDF_NOT_SUPPORT(HIST, nebula::type::Kind::INT128)
 
+// TOPK (heavy hitters) counts values of any type except int128 and output the top ones in a JSON list
+STATIC_TRAITS(TOPK, true)
+UDF_TRAITS(TOPK, nebula::type::Kind::VARCHAR, nebula::type::Kind::BOOLEAN)
+UDF_TRAITS(TOPK, nebula::type::Kind::VARCHAR, nebula::type::Kind::TINYINT)
+UDF_TRAITS(TOPK, nebula::type::Kind::VARCHAR, nebula::type::Kind::SMALLINT)
+UDF_TRAITS(TOPK, nebula::type::Kind::VARCHAR, nebula::type::Kind::INTEGER)
+UDF_TRAITS(TOPK, nebula::type::Kind::VARCHAR, nebula::type::Kind::BIGINT)
+UDF_TRAITS(TOPK, nebula::type::Kind::VARCHAR, nebula::type::Kind::REAL)
+UDF_TRAITS(TOPK, nebula::type::Kind::VARCHAR, nebula::type::Kind::DOUBLE)
+UDF_TRAITS(TOPK, nebula::type::Kind::VARCHAR, nebula::type::Kind::VARCHAR)
+UDF_NOT_SUPPORT(TOPK, nebula::type::Kind::INVALID)
+UDF_NOT_SUPPORT(TOPK, nebula::type::Kind::INT128)
+
+// LOOKUP maps an integer or string key to its value in a lookup table, missing keys are null
+STATIC_TRAITS(LOOKUP, false)
+UDF_TRAITS(LOOKUP, nebula::type::Kind::VARCHAR, nebula::type::Kind::TINYINT)
+UDF_TRAITS(LOOKUP, nebula::type::Kind::VARCHAR, nebula::type::Kind::SMALLINT)
+UDF_TRAITS(LOOKUP, nebula::type::Kind::VARCHAR, nebula::type::Kind::INTEGER)
+UDF_TRAITS(LOOKUP, nebula::type::Kind::VARCHAR, nebula::type::Kind::BIGINT)
+UDF_TRAITS(LOOKUP, nebula::type::Kind::VARCHAR, nebula::type::Kind::VARCHAR)
+UDF_NOT_SUPPORT(LOOKUP, nebula::type::Kind::INVALID)
+UDF_NOT_SUPPORT(LOOKUP, nebula::type::Kind::BOOLEAN)
+UDF_NOT_SUPPORT(LOOKUP, nebula::type::Kind::REAL)
+UDF_NOT_SUPPORT(LOOKUP, nebula::type::Kind::DOUBLE)
+UDF_NOT_SUPPORT(LOOKUP, nebula::type::Kind::INT128)
+
+// CONTAINS looks for any element of an array column in given list of values, input kind is the element kind
+STATIC_TRAITS(CONTAINS, false)
+REPEAT_ALL_TYPES(UDF_TRAITS_INPUT1, CONTAINS, nebula::type::Kind::BOOLEAN)
+
 #undef UDF_SAME_AS_INPUT_ALL
 #undef UDF_SAME_AS_INPUT
 #undef UDF_NOT_SUPPORT
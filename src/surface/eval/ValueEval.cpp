@@ -16,11 +16,18 @@
 
 #include "ValueEval.h"
 
+#include <algorithm>
+#include <limits>
+#include <tuple>
+
+#include "Kernel.h"
+
 /**
  * This class is mostly placing all optimizations we can do at block level.
  * What do we have to support these fast decisions?
  * - Histogram: range[min, max], nulls
  * - Bloom Filter: probability
+ * - Bitmap index: rows of every value
  * - Partition columns
  */
 namespace nebula {
@@ -100,8 +107,12 @@ EvalBlock buildEvalBlock<LogicalOp::GT>(const std::unique_ptr<ValueEval>& left,
     std::string colName(left->signature().substr(2));
     return [name = std::move(colName), c = right.get()](const Block& b) -> BlockEval {
       EvalContext ctx{ false };
-      // logic
+      // logic - a column not in the block can't prune it
       auto ct = b.columnType(name);
+      if (!ct) {
+        return BlockEval::PARTIAL;
+      }
+
       switch (ct->k()) {
         DISPATCH_CASES(max <= value, min > value)
       default: break;
@@ -126,8 +137,12 @@ EvalBlock buildEvalBlock<LogicalOp::GE>(const std::unique_ptr<ValueEval>& left,
     std::string colName(left->signature().substr(2));
     return [name = std::move(colName), c = right.get()](const Block& b) -> BlockEval {
       EvalContext ctx{ false };
-      // logic
+      // logic - a column not in the block can't prune it
       auto ct = b.columnType(name);
+      if (!ct) {
+        return BlockEval::PARTIAL;
+      }
+
       switch (ct->k()) {
         DISPATCH_CASES(max < value, min >= value)
       default: break;
@@ -152,8 +167,12 @@ EvalBlock buildEvalBlock<LogicalOp::LT>(const std::unique_ptr<ValueEval>& left,
     std::string colName(left->signature().substr(2));
     return [name = std::move(colName), c = right.get()](const Block& b) -> BlockEval {
       EvalContext ctx{ false };
-      // logic
+      // logic - a column not in the block can't prune it
       auto ct = b.columnType(name);
+      if (!ct) {
+        return BlockEval::PARTIAL;
+      }
+
       switch (ct->k()) {
         DISPATCH_CASES(min >= value, max < value)
       default: break;
@@ -178,8 +197,12 @@ EvalBlock buildEvalBlock<LogicalOp::LE>(const std::unique_ptr<ValueEval>& left,
     std::string colName(left->signature().substr(2));
     return [name = std::move(colName), c = right.get()](const Block& b) -> BlockEval {
       EvalContext ctx{ false };
-      // logic
+      // logic - a column not in the block can't prune it
       auto ct = b.columnType(name);
+      if (!ct) {
+        return BlockEval::PARTIAL;
+      }
+
       switch (ct->k()) {
         DISPATCH_CASES(min > value, max <= value)
       default: break;
@@ -223,6 +246,14 @@ EvalBlock buildEvalBlock<LogicalOp::LE>(const std::unique_ptr<ValueEval>& left,
     }                                                                          \
     return N;                                                                  \
   }                                                                            \
+  if (value != std::nullopt) {                                                 \
+    const auto counted = evalBitmap<ET>(b, name, [&value](const ET& v) {       \
+      return v == value.value();                                               \
+    });                                                                        \
+    if (counted == BlockEval::ALL || (counted == BlockEval::NONE && !NOT)) {   \
+      return counted == BlockEval::ALL ? A : N;                                \
+    }                                                                          \
+  }                                                                            \
   if (value != std::nullopt && !b.probably(name, value.value())) {             \
     return N;                                                                  \
   }
@@ -245,8 +276,12 @@ EvalBlock buildEvalBlock<LogicalOp::EQ>(const std::unique_ptr<ValueEval>& left,
     std::string colName(left->signature().substr(2));
     return [name = std::move(colName), c = right.get()](const Block& b) -> BlockEval {
       EvalContext ctx{ false };
-      // logic
+      // logic - a column not in the block can't prune it
       auto ct = b.columnType(name);
+      if (!ct) {
+        return BlockEval::PARTIAL;
+      }
+
       switch (ct->k()) {
         DISPATCH_CASE(TINYINT, false, IntHistogram)
         DISPATCH_CASE(SMALLINT, false, IntHistogram)
@@ -256,6 +291,10 @@ EvalBlock buildEvalBlock<LogicalOp::EQ>(const std::unique_ptr<ValueEval>& left,
         DISPATCH_CASE(DOUBLE, false, RealHistogram)
       case Kind::VARCHAR: {
         EQUAL_COMPARE(VARCHAR, false)
+        // lexicographic range only covers stored values, not default value
+        if (b.exact(name)) {
+          CHECK_HIST(StringHistogram)
+        }
         break;
       }
       default: break;
@@ -280,8 +319,12 @@ EvalBlock buildEvalBlock<LogicalOp::NEQ>(const std::unique_ptr<ValueEval>& left,
     std::string colName(left->signature().substr(2));
     return [name = std::move(colName), c = right.get()](const Block& b) -> BlockEval {
       EvalContext ctx{ false };
-      // logic
+      // logic - a column not in the block can't prune it
       auto ct = b.columnType(name);
+      if (!ct) {
+        return BlockEval::PARTIAL;
+      }
+
       switch (ct->k()) {
         DISPATCH_CASE(TINYINT, true, IntHistogram)
         DISPATCH_CASE(SMALLINT, true, IntHistogram)
@@ -291,6 +334,10 @@ EvalBlock buildEvalBlock<LogicalOp::NEQ>(const std::unique_ptr<ValueEval>& left,
         DISPATCH_CASE(DOUBLE, true, RealHistogram)
       case Kind::VARCHAR: {
         EQUAL_COMPARE(VARCHAR, true)
+        // lexicographic range only covers stored values, not default value
+        if (b.exact(name)) {
+          CHECK_HIST(StringHistogram)
+        }
         break;
       }
       default: break;
@@ -385,6 +432,259 @@ EvalBlock buildEvalBlock<LogicalOp::OR>(const std::unique_ptr<ValueEval>& left,
 
 #undef EvalBlock
 
+// value range [low, high] where "value OP constant" is true for integers, the range is negated for NEQ.
+// the range is empty (low > high) if no integer is greater than MAX or less than MIN.
+template <LogicalOp OP>
+std::tuple<int64_t, int64_t, bool> asRange(int64_t value) {
+  constexpr auto MIN = std::numeric_limits<int64_t>::min();
+  constexpr auto MAX = std::numeric_limits<int64_t>::max();
+  switch (OP) {
+  case LogicalOp::EQ: return { value, value, false };
+  case LogicalOp::NEQ: return { value, value, true };
+  case LogicalOp::GT: return value == MAX ? std::make_tuple(MAX, MIN, false) : std::make_tuple(value + 1, MAX, false);
+  case LogicalOp::GE: return { value, MAX, false };
+  case LogicalOp::LT: return value == MIN ? std::make_tuple(MAX, MIN, false) : std::make_tuple(MIN, value - 1, false);
+  case LogicalOp::LE: return { MIN, value, false };
+  default: throw NException("not a comparison");
+  }
+}
+
+template <typename T>
+static constexpr bool isInteger = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+// equality of a column and a constant is selected by bitmap index of the column if it has one
+template <LogicalOp OP>
+static constexpr bool isEquality = OP == LogicalOp::EQ || OP == LogicalOp::NEQ;
+
+// kernel selector for "column OP constant" running on raw column data
+// an integer column compared with an integer constant is selected by value range, which runs on packed values
+template <LogicalOp OP, typename T, typename C>
+Selector compareKernel(std::string name, const C value) {
+  if constexpr (isInteger<T> && isInteger<C>) {
+    const auto [low, high, negate] = asRange<OP>(value);
+
+    // the shared constant identifies this predicate for its flagged rows in eval context
+    return [name = std::move(name), low = low, high = high, negate = negate, owner = std::make_shared<const C>(value)](
+             EvalContext& ctx, const Block& b, const Seeker&, Selection& selection) -> bool {
+      if constexpr (isEquality<OP>) {
+        const auto target = *owner;
+        if (selectBitmap<T>(ctx, owner, b, name, selection, [target](const T v) {
+              return Compare<OP>::apply(v, target);
+            })) {
+          return true;
+        }
+      }
+
+      return selectRange<T>(b, name, selection, low, high, negate);
+    };
+  }
+
+  return [name = std::move(name), value](EvalContext&, const Block& b, const Seeker&, Selection& selection) -> bool {
+    return selectScalar<T>(b, name, selection, [value](const T v) { return Compare<OP>::apply(v, value); });
+  };
+}
+
+#define CONSTANT_CASE(KIND)                             \
+  case Kind::KIND: {                                    \
+    using CT = TypeTraits<Kind::KIND>::CppType;         \
+    auto value = c.eval<CT>(ctx);                       \
+    if (value == std::nullopt) {                        \
+      return {};                                        \
+    }                                                   \
+    return compareKernel<OP, T>(std::move(name), *value); \
+  }
+
+template <LogicalOp OP, typename T>
+Selector compareKernel(std::string name, const ValueEval& c) {
+  // constant is evaluated once without any row
+  EvalContext ctx{ false };
+  switch (c.outputType()) {
+    CONSTANT_CASE(BOOLEAN)
+    CONSTANT_CASE(TINYINT)
+    CONSTANT_CASE(SMALLINT)
+    CONSTANT_CASE(INTEGER)
+    CONSTANT_CASE(BIGINT)
+    CONSTANT_CASE(REAL)
+    CONSTANT_CASE(DOUBLE)
+  default: return {};
+  }
+}
+
+#undef CONSTANT_CASE
+
+// "string column OP constant" reads bound column directly for selected rows
+template <LogicalOp OP>
+Selector stringKernel(std::string name, const ValueEval& c) {
+  EvalContext ctx{ false };
+  auto value = c.eval<std::string_view>(ctx);
+  if (value == std::nullopt) {
+    return {};
+  }
+
+  return [name = std::move(name), value = std::make_shared<const std::string>(value.value())](
+           EvalContext& ctx, const Block& b, const Seeker& seek, Selection& selection) -> bool {
+    const std::string_view target(*value);
+    if constexpr (isEquality<OP>) {
+      if (selectBitmap<std::string_view>(ctx, value, b, name, selection, [target](std::string_view v) {
+            return Compare<OP>::apply(v, target);
+          })) {
+        return true;
+      }
+    }
+
+    return selectHeads<OP>(b, name, selection, target) || selectStrings(seek, name, selection, [target](std::string_view v) {
+      return Compare<OP>::apply(v, target);
+    });
+  };
+}
+
+#define COLUMN_CASE(KIND) \
+  case Kind::KIND: return compareKernel<OP, TypeTraits<Kind::KIND>::CppType>(std::move(colName), *right);
+
+template <LogicalOp OP>
+Selector compareSelector(const std::unique_ptr<ValueEval>& left, const std::unique_ptr<ValueEval>& right) {
+  if (left->expressionType() == ExpressionType::COLUMN
+      && right->expressionType() == ExpressionType::CONSTANT) {
+    // column expr signature is composed by "F:{col}"
+    std::string colName(left->signature().substr(2));
+    switch (left->outputType()) {
+      COLUMN_CASE(BOOLEAN)
+      COLUMN_CASE(TINYINT)
+      COLUMN_CASE(SMALLINT)
+      COLUMN_CASE(INTEGER)
+      COLUMN_CASE(BIGINT)
+      COLUMN_CASE(REAL)
+      COLUMN_CASE(DOUBLE)
+    case Kind::VARCHAR: {
+      if (right->outputType() == Kind::VARCHAR) {
+        return stringKernel<OP>(std::move(colName), *right);
+      }
+      break;
+    }
+    default: break;
+    }
+  }
+
+  return {};
+}
+
+#undef COLUMN_CASE
+
+#define COMPARE_SELECTOR(LOP)                                                                \
+  template <>                                                                                \
+  Selector buildSelector<LogicalOp::LOP>(const std::unique_ptr<ValueEval>& left,             \
+                                         const std::unique_ptr<ValueEval>& right) {          \
+    return compareSelector<LogicalOp::LOP>(left, right);                                     \
+  }
+
+COMPARE_SELECTOR(GT)
+COMPARE_SELECTOR(GE)
+COMPARE_SELECTOR(EQ)
+COMPARE_SELECTOR(NEQ)
+COMPARE_SELECTOR(LT)
+COMPARE_SELECTOR(LE)
+
+#undef COMPARE_SELECTOR
+
+std::vector<const ValueEval*> chain(LogicalOp op, const ValueEval& left, const ValueEval& right) {
+  std::vector<const ValueEval*> all;
+  left.chain(op, all);
+  right.chain(op, all);
+
+  std::vector<const ValueEval*> terms;
+  terms.reserve(all.size());
+  for (auto t : all) {
+    auto same = [t](const ValueEval* e) { return e->signature() == t->signature(); };
+    if (std::none_of(terms.begin(), terms.end(), same)) {
+      terms.push_back(t);
+    }
+  }
+
+  // a row is decided by an AND predicate rejecting it, or an OR predicate accepting it.
+  // ordering by cost per decided row minimizes expected cost of independent predicates, ties keep user order.
+  auto rank = [op](const ValueEval* e) {
+    const auto decided = op == LogicalOp::AND ? 1 - e->selectivity() : e->selectivity();
+    return (e->cost() + 1) / std::max(decided, 0.01);
+  };
+
+  std::stable_sort(terms.begin(), terms.end(), [&rank](const ValueEval* left, const ValueEval* right) {
+    return rank(left) < rank(right);
+  });
+
+  return terms;
+}
+
+Selector chainSelector(LogicalOp op, std::vector<const ValueEval*> terms) {
+  // AND: rows qualified by a predicate are further refined by the next one
+  if (op == LogicalOp::AND) {
+    return [terms = std::move(terms)](EvalContext& ctx, const Block& b, const Seeker& seek, Selection& selection) -> bool {
+      for (auto t : terms) {
+        t->select(ctx, b, seek, selection);
+      }
+
+      return true;
+    };
+  }
+
+  // OR: a predicate is only evaluated on rows not qualified by any predicate before it
+  // and the final selection is union of all
+  return [terms = std::move(terms)](EvalContext& ctx, const Block& b, const Seeker& seek, Selection& selection) -> bool {
+    Selection matched{ selection };
+    terms.front()->select(ctx, b, seek, matched);
+    if (matched.size() == selection.size()) {
+      return true;
+    }
+
+    selection.subtract(matched);
+    for (size_t i = 1, last = terms.size() - 1; i < last && !selection.empty(); ++i) {
+      Selection hit{ selection };
+      terms[i]->select(ctx, b, seek, hit);
+      selection.subtract(hit);
+      matched.merge(hit);
+    }
+
+    terms.back()->select(ctx, b, seek, selection);
+    selection.merge(matched);
+    return true;
+  };
+}
+
+size_t number(const std::vector<ValueEval*>& roots) {
+  // the same signature of different output kinds is not the same expression
+  auto key = [](const ValueEval& ve) {
+    return fmt::format("{0}:{1}", static_cast<int>(ve.outputType()), ve.signature());
+  };
+
+  nebula::common::unordered_map<std::string, size_t> counts;
+  for (auto root : roots) {
+    if (root) {
+      root->walk([&key, &counts](ValueEval& ve) {
+        ve.id(ValueEval::NO_ID);
+        if (ve.cost() > 1) {
+          ++counts[key(ve)];
+        }
+      });
+    }
+  }
+
+  nebula::common::unordered_map<std::string, size_t> ids;
+  for (auto root : roots) {
+    if (root) {
+      root->walk([&key, &counts, &ids](ValueEval& ve) {
+        if (ve.cost() > 1) {
+          auto k = key(ve);
+          if (counts.at(k) > 1) {
+            const auto id = ids.size();
+            ve.id(ids.emplace(std::move(k), id).first->second);
+          }
+        }
+      });
+    }
+  }
+
+  return ids.size();
+}
+
 } // namespace eval
 } // namespace surface
 } // namespace nebula
\ No newline at end of file
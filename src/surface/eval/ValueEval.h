@@ -67,10 +67,23 @@ std::unique_ptr<ValueEval> column(const std::string& name) {
     new TypeValueEval<T>(
       fmt::format("F:{0}", name),
       ExpressionType::COLUMN,
-      [name](EvalContext& ctx, const std::vector<std::unique_ptr<ValueEval>>&)
+      [col = ColumnRef(name)](EvalContext& ctx, const std::vector<std::unique_ptr<ValueEval>>&)
         -> std::optional<T> {
         // dedicate the read function to context as it knows how to handle special cases
-        return ctx.read<T>(name);
+        return ctx.read<T>(col);
+      },
+      uncertain));
+}
+
+// an array column read as a whole by a function over its elements (eg. contains),
+// so that the column is known to be read by the expression. it has no value of its own.
+inline std::unique_ptr<ValueEval> list(const std::string& name) {
+  return std::unique_ptr<ValueEval>(
+    new TypeValueEval<bool>(
+      fmt::format("F:{0}", name),
+      ExpressionType::COLUMN,
+      [](EvalContext&, const std::vector<std::unique_ptr<ValueEval>>&) -> std::optional<bool> {
+        return std::nullopt;
       },
       uncertain));
 }
@@ -95,6 +108,12 @@ std::unique_ptr<ValueEval> custom(const std::string& name, const std::string& ex
         // we are good as long as it's not nullopt
         // next let's invote it ot get the value we want
         if (decl) {
+          // rows evaluated as a span get their values from one batch call of the function
+          std::optional<T> value;
+          if (ctx.spanned<T>(name, value)) {
+            return value;
+          }
+
           return ctx.script().eval<T>(fmt::format("{0}();", name));
         }
 
@@ -104,18 +123,36 @@ std::unique_ptr<ValueEval> custom(const std::string& name, const std::string& ex
       uncertain));
 }
 
-// TODO(cao): optimization - fold constant nodes, we don't need keep a constant nodes
-#define ARTHMETIC_VE(NAME, SIGN)                                                                  \
+// an expression of constants only is evaluated once into a constant
+template <typename T>
+std::unique_ptr<ValueEval> fold(std::unique_ptr<ValueEval> ve) {
+  EvalContext ctx{ false };
+  auto value = ve->eval<T>(ctx);
+  if (value == std::nullopt) {
+    return ve;
+  }
+
+  return constant<T>(value.value());
+}
+
+// DIVIDE - constants are not folded if the divisor is zero, so that it fails as it would do on rows
+#define ARTHMETIC_VE(NAME, SIGN, DIVIDE)                                                          \
   template <typename T, typename T1, typename T2>                                                 \
   std::unique_ptr<ValueEval> NAME(std::unique_ptr<ValueEval> v1, std::unique_ptr<ValueEval> v2) { \
     const auto s1 = v1->signature();                                                              \
     const auto s2 = v2->signature();                                                              \
+    auto foldable = v1->expressionType() == ExpressionType::CONSTANT                              \
+                    && v2->expressionType() == ExpressionType::CONSTANT;                          \
+    if (DIVIDE && foldable) {                                                                     \
+      EvalContext ctx{ false };                                                                   \
+      foldable = v2->eval<T2>(ctx) != T2(0);                                                      \
+    }                                                                                             \
     std::vector<std::unique_ptr<ValueEval>> branch;                                               \
     branch.reserve(2);                                                                            \
     branch.push_back(std::move(v1));                                                              \
     branch.push_back(std::move(v2));                                                              \
                                                                                                   \
-    return std::unique_ptr<ValueEval>(                                                            \
+    auto ve = std::unique_ptr<ValueEval>(                                                         \
       new TypeValueEval<T>(                                                                       \
         fmt::format("({0}{1}{2})", s1, #SIGN, s2),                                                \
         ExpressionType::ARTHMETIC,                                                                \
@@ -131,13 +168,14 @@ std::unique_ptr<ValueEval> custom(const std::string& name, const std::string& ex
           return T(v1.value() SIGN v2.value());                                                   \
         }),                                                                                       \
         uncertain, {}, std::move(branch)));                                                       \
+    return foldable ? fold<T>(std::move(ve)) : std::move(ve);                                     \
   }
 
-ARTHMETIC_VE(add, +)
-ARTHMETIC_VE(sub, -)
-ARTHMETIC_VE(mul, *)
-ARTHMETIC_VE(div, /)
-ARTHMETIC_VE(mod, %)
+ARTHMETIC_VE(add, +, false)
+ARTHMETIC_VE(sub, -, false)
+ARTHMETIC_VE(mul, *, false)
+ARTHMETIC_VE(div, /, true)
+ARTHMETIC_VE(mod, %, true)
 
 #undef ARTHMETIC_VE
 
@@ -163,18 +201,54 @@ BEB_LOGICAL(OR)
 
 #undef BEB_LOGICAL
 
+// build batch selector based on left and right expression connected with logical op
+// by default no selector, expression is evaluated row by row over the selection
+template <LogicalOp op>
+Selector buildSelector(const std::unique_ptr<ValueEval>&, const std::unique_ptr<ValueEval>&) {
+  return {};
+}
+
+// build selector function for each logical operation
+#define BSL_LOGICAL(LOP) \
+  template <>            \
+  Selector buildSelector<LogicalOp::LOP>(const std::unique_ptr<ValueEval>&, const std::unique_ptr<ValueEval>&);
+
+BSL_LOGICAL(GT)
+BSL_LOGICAL(GE)
+BSL_LOGICAL(EQ)
+BSL_LOGICAL(NEQ)
+BSL_LOGICAL(LT)
+BSL_LOGICAL(LE)
+
+#undef BSL_LOGICAL
+
+// predicates of an AND/OR chain connecting left and right, each distinct predicate appears once.
+// they are ordered by cost per row decided, so cheap and selective ones run first (see ValueEval::estimate)
+std::vector<const ValueEval*> chain(LogicalOp, const ValueEval&, const ValueEval&);
+
+// batch selector evaluating predicates of an AND/OR chain in the given order
+Selector chainSelector(LogicalOp, std::vector<const ValueEval*>);
+
+// plan compile: every expression appearing more than once in given trees gets a dense id in [0, N), return N.
+// expressions as cheap as reading a column are not numbered, they cost more to cache than to evaluate.
+size_t number(const std::vector<ValueEval*>&);
+
 // TODO(cao) - merge with ARTHMETIC_VE since they are pretty much the same
-#define COMPARE_VE(NAME, SIGN, LOP)                                                               \
+// SELECTIVITY - estimated fraction of rows qualified by the comparison, without knowing values
+#define COMPARE_VE(NAME, SIGN, LOP, SELECTIVITY)                                                  \
   template <typename T1, typename T2>                                                             \
   std::unique_ptr<ValueEval> NAME(std::unique_ptr<ValueEval> v1, std::unique_ptr<ValueEval> v2) { \
     const auto s1 = v1->signature();                                                              \
     const auto s2 = v2->signature();                                                              \
+    const auto foldable = v1->expressionType() == ExpressionType::CONSTANT                        \
+                          && v2->expressionType() == ExpressionType::CONSTANT;                    \
     auto eb = buildEvalBlock<LOP>(v1, v2);                                                        \
+    auto sl = buildSelector<LOP>(v1, v2);                                                         \
     std::vector<std::unique_ptr<ValueEval>> branch;                                               \
     branch.reserve(2);                                                                            \
     branch.push_back(std::move(v1));                                                              \
     branch.push_back(std::move(v2));                                                              \
-    return std::unique_ptr<ValueEval>(                                                            \
+    auto ve = std::unique_ptr<ValueEval>(                                                         \
       new TypeValueEval<bool>(                                                                    \
         fmt::format("({0}{1}{2})", s1, #SIGN, s2),                                                \
         ExpressionType::LOGICAL,                                                                  \
@@ -190,21 +264,81 @@ BEB_LOGICAL(OR)
           return v1.value() SIGN v2.value();                                                      \
         }),                                                                                       \
         std::move(eb), {}, std::move(branch)));                                                   \
+    ve->selector(std::move(sl));                                                                  \
+    ve->estimate(ve->cost(), SELECTIVITY);                                                        \
+    return foldable ? fold<bool>(std::move(ve)) : std::move(ve);                                  \
   }
 
-COMPARE_VE(gt, >, LogicalOp::GT)
-COMPARE_VE(ge, >=, LogicalOp::GE)
-COMPARE_VE(eq, ==, LogicalOp::EQ)
-COMPARE_VE(neq, !=, LogicalOp::NEQ)
-COMPARE_VE(lt, <, LogicalOp::LT)
-COMPARE_VE(le, <=, LogicalOp::LE)
-
-// unncessary compare but same signatures
-COMPARE_VE(band, &&, LogicalOp::AND)
-COMPARE_VE(bor, ||, LogicalOp::OR)
+COMPARE_VE(gt, >, LogicalOp::GT, 0.33)
+COMPARE_VE(ge, >=, LogicalOp::GE, 0.33)
+COMPARE_VE(eq, ==, LogicalOp::EQ, 0.1)
+COMPARE_VE(neq, !=, LogicalOp::NEQ, 0.9)
+COMPARE_VE(lt, <, LogicalOp::LT, 0.33)
+COMPARE_VE(le, <=, LogicalOp::LE, 0.33)
 
 #undef COMPARE_VE
 
+// connect two predicates with AND/OR, NULL is handled in three-valued logic:
+// (false AND NULL) is false, (true OR NULL) is true, otherwise NULL.
+// so that row-by-row evaluation produces the same result as combined selections.
+// T1 and T2 are always bool, they are kept for the same signatures as compare functions.
+// a constant operand either decides the result or leaves the other one, and (x op x) is x.
+// SELECTIVITY - fraction of rows qualified by both, given fractions of each (p1, p2) as independent predicates
+#define CONNECT_VE(NAME, SIGN, LOP, SHORT, SELECTIVITY)                                           \
+  template <typename T1, typename T2>                                                             \
+  std::unique_ptr<ValueEval> NAME(std::unique_ptr<ValueEval> v1, std::unique_ptr<ValueEval> v2) { \
+    if (v1->expressionType() == ExpressionType::CONSTANT) {                                       \
+      EvalContext ctx{ false };                                                                   \
+      return v1->eval<bool>(ctx) == SHORT ? std::move(v1) : std::move(v2);                        \
+    }                                                                                             \
+    if (v2->expressionType() == ExpressionType::CONSTANT) {                                       \
+      EvalContext ctx{ false };                                                                   \
+      return v2->eval<bool>(ctx) == SHORT ? std::move(v2) : std::move(v1);                        \
+    }                                                                                             \
+    const auto s1 = v1->signature();                                                              \
+    const auto s2 = v2->signature();                                                              \
+    if (s1 == s2) {                                                                               \
+      return v1;                                                                                  \
+    }                                                                                             \
+    const auto p1 = v1->selectivity();                                                            \
+    const auto p2 = v2->selectivity();                                                            \
+    auto eb = buildEvalBlock<LOP>(v1, v2);                                                        \
+    auto terms = chain(LOP, *v1, *v2);                                                            \
+    auto sl = chainSelector(LOP, terms);                                                          \
+    std::vector<std::unique_ptr<ValueEval>> branch;                                               \
+    branch.reserve(2);                                                                            \
+    branch.push_back(std::move(v1));                                                              \
+    branch.push_back(std::move(v2));                                                              \
+    auto ve = std::unique_ptr<ValueEval>(                                                         \
+      new TypeValueEval<bool>(                                                                    \
+        fmt::format("({0}{1}{2})", s1, #SIGN, s2),                                                \
+        ExpressionType::LOGICAL,                                                                  \
+        OPT_LAMBDA(bool, {                                                                        \
+          auto v1 = children.at(0)->eval<T1>(ctx);                                                \
+          if (v1 == SHORT) {                                                                      \
+            return SHORT;                                                                         \
+          }                                                                                       \
+          auto v2 = children.at(1)->eval<T2>(ctx);                                                \
+          if (v2 == SHORT) {                                                                      \
+            return SHORT;                                                                         \
+          }                                                                                       \
+          if (N_UNLIKELY(v1 == std::nullopt || v2 == std::nullopt)) {                             \
+            return std::nullopt;                                                                  \
+          }                                                                                       \
+          return !SHORT;                                                                          \
+        }),                                                                                       \
+        std::move(eb), {}, std::move(branch)));                                                   \
+    ve->selector(std::move(sl));                                                                  \
+    ve->estimate(ve->cost(), SELECTIVITY);                                                        \
+    ve->connect(LOP, std::move(terms));                                                           \
+    return ve;                                                                                    \
+  }
+
+CONNECT_VE(band, &&, LogicalOp::AND, false, p1 * p2)
+CONNECT_VE(bor, ||, LogicalOp::OR, true, p1 + p2 - p1 * p2)
+
+#undef CONNECT_VE
+
 #undef OPT_LAMBDA
 #undef OPT
 #undef SketchMaker
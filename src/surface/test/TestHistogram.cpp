@@ -133,6 +133,47 @@ TEST(HistogramTest, TestFailOver) {
   }
 }
 
+TEST(HistogramTest, TestSubtract) {
+  {
+    BoolHistogram h{ 7, 5 };
+    EXPECT_TRUE(h.subtract(BoolHistogram{ 3, 1 }));
+    EXPECT_EQ(h.count, 4);
+    EXPECT_EQ(h.trueValues, 4);
+  }
+
+  // bounds in the middle are exact, otherwise the histogram needs a rebuild
+  {
+    IntHistogram h{ 2, 1, 3, 4 };
+    h.merge(IntHistogram{ 1, 2, 2, 2 });
+    h.merge(IntHistogram{ 1, 4, 4, 4 });
+    EXPECT_TRUE(h.subtract(IntHistogram{ 1, 2, 2, 2 }));
+    EXPECT_EQ(h.count, 3);
+    EXPECT_EQ(h.v_min, 1);
+    EXPECT_EQ(h.v_max, 4);
+    EXPECT_EQ(h.v_sum, 8);
+    EXPECT_FALSE(h.subtract(IntHistogram{ 1, 4, 4, 4 }));
+    EXPECT_EQ(h.count, 2);
+    EXPECT_EQ(h.v_sum, 4);
+  }
+
+  {
+    nebula::surface::eval::StringHistogram h{ 2, "a", "z" };
+    EXPECT_TRUE(h.subtract(nebula::surface::eval::StringHistogram{ 1, "b", "c" }));
+    EXPECT_TRUE(h.subtract(nebula::surface::eval::StringHistogram{ 1, "a", "z" }));
+    EXPECT_EQ(h.count, 0);
+    EXPECT_EQ(h.min(), "");
+  }
+
+  // a clone is not changed by merges into the origin
+  {
+    IntHistogram h{ 2, 1, 3, 4 };
+    auto copy = h.clone();
+    h.merge(IntHistogram{ 1, 9, 9, 9 });
+    EXPECT_EQ(copy->count, 2);
+    EXPECT_EQ(static_cast<IntHistogram*>(copy.get())->v_max, 3);
+  }
+}
+
 } // namespace test
 } // namespace surface
 } // namespace nebula
\ No newline at end of file
@@ -115,6 +115,48 @@ TEST(SurfaceTest, TestScriptContext) {
   }
 }
 
+TEST(SurfaceTest, TestScriptBatch) {
+  const auto seed = Evidence::unix_timestamp();
+  nebula::surface::MockRowData mock(seed);
+  nebula::surface::MockAccessor mockA(seed);
+  auto typer = [](const std::string& col) -> auto {
+    if (col == "c") {
+      return nebula::type::Kind::INTEGER;
+    }
+
+    return nebula::type::Kind::INVALID;
+  };
+
+  auto script = nebula::surface::eval::ScriptContext::acquire(
+    [&mockA]() -> const nebula::surface::Accessor& { return mockA; }, typer);
+  script->eval<bool>("var x = () => nebula.column('c') - 100 + nebula.column('c');", true);
+
+  // every column is read once for each row of the span, no matter how many times it is referenced
+  constexpr size_t size = 16;
+  auto values = script->batch<int64_t>("x", size, [&mockA](size_t) -> const nebula::surface::Accessor& {
+    return mockA;
+  });
+  ASSERT_NE(values, nullptr);
+  EXPECT_EQ(values->size(), size);
+  for (size_t i = 0; i < size; ++i) {
+    int64_t c = mock.readInt("c").value();
+    EXPECT_EQ(values->at(i), c * 2 - 100);
+  }
+
+  // unknown function can't be evaluated in batch
+  EXPECT_EQ(script->batch<int64_t>("y", size, [&mockA](size_t) -> const nebula::surface::Accessor& {
+    return mockA;
+  }),
+            nullptr);
+
+  // a released context is reused by the same thread with its evaluated scripts
+  auto ptr = script.get();
+  script.reset();
+  auto again = nebula::surface::eval::ScriptContext::acquire(
+    [&mockA]() -> const nebula::surface::Accessor& { return mockA; }, typer);
+  EXPECT_EQ(again.get(), ptr);
+}
+
 } // namespace test
 } // namespace surface
 } // namespace nebula
\ No newline at end of file